@@ -0,0 +1,653 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+// Benchmarks of the core library hot paths. Benchmarks, which don't need
+// any document, use synthetic data. Benchmarks of document processing use
+// documents listed in the corpus manifest, which is a JSON file of form
+//
+//     { "documents": [ { "name": "manual", "file": "manual.pdf" }, ... ] }
+//
+// File names are relative to the manifest. Path to the manifest is taken from
+// the environment variable PDF4QT_BENCHMARK_CORPUS. If it is not set, document
+// benchmarks are skipped. Results can be written in machine-readable form
+// using standard Qt Test output options, for example:
+//
+//     Pdf4QtBenchmarks -o results.xml,xml
+//     Pdf4QtBenchmarks -o results.csv,csv
+
+#include <QtTest>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include "pdfparser.h"
+#include "pdfconstants.h"
+#include "pdfdocument.h"
+#include "pdfdocumentreader.h"
+#include "pdfstreamfilters.h"
+#include "pdffunction.h"
+#include "pdfimage.h"
+#include "pdfcms.h"
+#include "pdfcolorspaces.h"
+#include "pdffont.h"
+#include "pdfrenderer.h"
+#include "pdfpainter.h"
+#include "pdfoptionalcontent.h"
+#include "pdftextlayoutgenerator.h"
+#include "pdfdiff.h"
+#include "pdfexception.h"
+
+#include <map>
+#include <cstring>
+#include <memory>
+
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Benchmarks() = default;
+    virtual ~Benchmarks() override = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void lexicalAnalyzer();
+    void parser();
+    void documentReading_data();
+    void documentReading();
+    void streamFilter_data();
+    void streamFilter();
+    void imageDecoding_data();
+    void imageDecoding();
+    void functionEvaluation_data();
+    void functionEvaluation();
+    void colorConversion_data();
+    void colorConversion();
+    void pageCompilation_data();
+    void pageCompilation();
+    void rasterization_data();
+    void rasterization();
+    void textLayout_data();
+    void textLayout();
+    void diff_data();
+    void diff();
+
+private:
+    struct CorpusDocument
+    {
+        QString name;
+        QByteArray data;
+        pdf::PDFDocument document;
+    };
+
+    /// Resources needed to process document pages
+    struct DocumentContext
+    {
+        explicit DocumentContext(const pdf::PDFDocument* document);
+
+        const pdf::PDFDocument* document;
+        pdf::PDFOptionalContentActivity optionalContentActivity;
+        pdf::PDFCMSManager cmsManager;
+        pdf::PDFCMSPointer cms;
+        pdf::PDFFontCache fontCache;
+        pdf::PDFMeshQualitySettings meshQualitySettings;
+    };
+
+    /// Adds one data row per corpus document (column 'document' contains index of the document)
+    void addDocumentRows();
+
+    /// Returns image streams of the corpus grouped by the image filter
+    std::map<QByteArray, std::vector<std::pair<const pdf::PDFDocument*, const pdf::PDFStream*>>> getImageStreams() const;
+
+    /// Returns name of the last filter of the stream
+    static QByteArray getLastFilterName(const pdf::PDFDocument* document, const pdf::PDFStream* stream);
+
+    std::vector<CorpusDocument> m_documents;
+};
+
+Benchmarks::DocumentContext::DocumentContext(const pdf::PDFDocument* document) :
+    document(document),
+    optionalContentActivity(document, pdf::OCUsage::View, nullptr),
+    cmsManager(nullptr),
+    fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT)
+{
+    cmsManager.setDocument(document);
+    cms = cmsManager.getCurrentCMS();
+
+    pdf::PDFModifiedDocument modifiedDocument(const_cast<pdf::PDFDocument*>(document), &optionalContentActivity);
+    fontCache.setDocument(modifiedDocument);
+}
+
+void Benchmarks::initTestCase()
+{
+    const QString manifestFileName = qEnvironmentVariable("PDF4QT_BENCHMARK_CORPUS");
+    if (manifestFileName.isEmpty())
+    {
+        qInfo("PDF4QT_BENCHMARK_CORPUS is not set, document benchmarks are skipped.");
+        return;
+    }
+
+    QFile manifestFile(manifestFileName);
+    if (!manifestFile.open(QFile::ReadOnly))
+    {
+        QFAIL(qPrintable(QString("Cannot open corpus manifest '%1'.").arg(manifestFileName)));
+    }
+
+    const QDir manifestDirectory = QFileInfo(manifestFileName).absoluteDir();
+    const QJsonArray documents = QJsonDocument::fromJson(manifestFile.readAll()).object().value("documents").toArray();
+    for (const QJsonValue& value : documents)
+    {
+        const QJsonObject object = value.toObject();
+        const QString fileName = manifestDirectory.absoluteFilePath(object.value("file").toString());
+
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            QFAIL(qPrintable(QString("Cannot open corpus document '%1'.").arg(fileName)));
+        }
+
+        CorpusDocument corpusDocument;
+        corpusDocument.name = object.value("name").toString(QFileInfo(fileName).completeBaseName());
+        corpusDocument.data = file.readAll();
+
+        pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, true, false);
+        corpusDocument.document = reader.readFromBuffer(corpusDocument.data);
+        if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+        {
+            QFAIL(qPrintable(QString("Cannot read corpus document '%1'.").arg(fileName)));
+        }
+
+        m_documents.emplace_back(qMove(corpusDocument));
+    }
+}
+
+void Benchmarks::cleanupTestCase()
+{
+    m_documents.clear();
+}
+
+void Benchmarks::lexicalAnalyzer()
+{
+    QByteArray content;
+    for (int i = 0; i < 10000; ++i)
+    {
+        content += "q 1 0 0 1 10.5 -20.25 cm BT /F1 12 Tf (Hello, world!) Tj ET 0.5 g 10 10 m 20 20 l 30 10 l h f Q\n";
+    }
+
+    QBENCHMARK
+    {
+        pdf::PDFLexicalAnalyzer analyzer(content.constData(), content.constData() + content.size());
+        while (!analyzer.isAtEnd())
+        {
+            analyzer.fetch();
+        }
+    }
+}
+
+void Benchmarks::parser()
+{
+    QByteArray content = "[ ";
+    for (int i = 0; i < 10000; ++i)
+    {
+        content += QString("<< /Type /Annot /Subtype /Link /Rect [ %1 0 %2 100 ] /Border [ 0 0 1 ] /A << /S /URI /URI (https://example.com) >> >> ").arg(i).arg(i + 10).toLatin1();
+    }
+    content += "]";
+
+    QBENCHMARK
+    {
+        pdf::PDFParser parser(content, nullptr, pdf::PDFParser::None);
+        pdf::PDFObject object = parser.getObject();
+        Q_UNUSED(object);
+    }
+}
+
+void Benchmarks::documentReading_data()
+{
+    addDocumentRows();
+}
+
+void Benchmarks::documentReading()
+{
+    QFETCH(int, document);
+    const CorpusDocument& corpusDocument = m_documents.at(document);
+
+    QBENCHMARK
+    {
+        // Reading includes cross-reference table loading and object parsing
+        pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, true, false);
+        pdf::PDFDocument document = reader.readFromBuffer(corpusDocument.data);
+        Q_UNUSED(document);
+    }
+}
+
+void Benchmarks::streamFilter_data()
+{
+    QTest::addColumn<QByteArray>("filter");
+    QTest::addColumn<QByteArray>("data");
+
+    // Synthetic data - mix of repeated and noisy bytes
+    QByteArray decodedData;
+    decodedData.reserve(4 << 20);
+    quint32 seed = 1;
+    while (decodedData.size() < (4 << 20))
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const char value = char(seed >> 24);
+        decodedData.append((seed & 0x300) ? 32 : 1, value);
+    }
+
+    QByteArray runLengthData;
+    for (qsizetype offset = 0; offset < decodedData.size(); offset += 128)
+    {
+        const QByteArray chunk = decodedData.mid(offset, 128);
+        runLengthData.append(char(chunk.size() - 1));
+        runLengthData.append(chunk);
+    }
+    runLengthData.append(char(128));
+
+    QTest::newRow("synthetic/FlateDecode") << QByteArray("FlateDecode") << pdf::PDFFlateDecodeFilter::compress(decodedData);
+    QTest::newRow("synthetic/ASCIIHexDecode") << QByteArray("ASCIIHexDecode") << QByteArray(decodedData.toHex() + ">");
+    QTest::newRow("synthetic/RunLengthDecode") << QByteArray("RunLengthDecode") << runLengthData;
+
+    // Streams from corpus documents, concatenated per filter (only single-filter
+    // streams are used, so each stream can be decoded by one filter).
+    std::map<QByteArray, std::vector<QByteArray>> corpusStreams;
+    for (const CorpusDocument& corpusDocument : m_documents)
+    {
+        for (const pdf::PDFObjectStorage::Entry& entry : corpusDocument.document.getStorage().getObjects())
+        {
+            if (!entry.object.isStream())
+            {
+                continue;
+            }
+
+            const pdf::PDFStream* stream = entry.object.getStream();
+            const pdf::PDFObject& filterObject = corpusDocument.document.getObject(stream->getDictionary()->get("Filter"));
+            if (filterObject.isName() && pdf::PDFStreamFilterStorage::getFilter(filterObject.getString()))
+            {
+                corpusStreams[filterObject.getString()].push_back(*stream->getContent());
+            }
+        }
+    }
+
+    for (const auto& [filter, streams] : corpusStreams)
+    {
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            QTest::newRow(qPrintable(QString("corpus/%1/%2").arg(QString::fromLatin1(filter)).arg(i))) << filter << streams[i];
+        }
+    }
+}
+
+void Benchmarks::streamFilter()
+{
+    QFETCH(QByteArray, filter);
+    QFETCH(QByteArray, data);
+
+    const pdf::PDFStreamFilter* streamFilter = pdf::PDFStreamFilterStorage::getFilter(filter);
+    QVERIFY(streamFilter);
+
+    auto fetcher = [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; };
+
+    QBENCHMARK
+    {
+        QByteArray decodedData = streamFilter->apply(data, fetcher, pdf::PDFObject(), nullptr);
+        Q_UNUSED(decodedData);
+    }
+}
+
+void Benchmarks::imageDecoding_data()
+{
+    QTest::addColumn<QByteArray>("filter");
+
+    for (const auto& [filter, streams] : getImageStreams())
+    {
+        Q_UNUSED(streams);
+        QTest::newRow(filter.constData()) << filter;
+    }
+}
+
+void Benchmarks::imageDecoding()
+{
+    QFETCH(QByteArray, filter);
+
+    const auto imageStreams = getImageStreams();
+    const auto& streams = imageStreams.at(filter);
+
+    pdf::PDFCMSManager cmsManager(nullptr);
+    pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
+    pdf::PDFRenderErrorReporterDummy reporter;
+
+    QBENCHMARK
+    {
+        for (const auto& [document, stream] : streams)
+        {
+            try
+            {
+                pdf::PDFColorSpacePointer colorSpace;
+                const pdf::PDFObject& colorSpaceObject = document->getObject(stream->getDictionary()->get("ColorSpace"));
+                if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+                {
+                    colorSpace = pdf::PDFAbstractColorSpace::createColorSpace(nullptr, document, colorSpaceObject);
+                }
+
+                pdf::PDFImage image = pdf::PDFImage::createImage(document, stream, qMove(colorSpace), false, pdf::RenderingIntent::Perceptual, &reporter);
+                QImage decodedImage = image.getImage(cms.data(), &reporter, nullptr);
+                Q_UNUSED(decodedImage);
+            }
+            catch (const pdf::PDFException&)
+            {
+                // Some images can't be decoded without page resources, skip them
+            }
+        }
+    }
+}
+
+void Benchmarks::functionEvaluation_data()
+{
+    QTest::addColumn<QByteArray>("function");
+    QTest::addColumn<int>("inputs");
+
+    QByteArray sampledFunction(" << /FunctionType 0 /Domain [ 0 1 0 1 ] /Range [ 0 1 0 1 0 1 ] /Size [ 16 16 ] /BitsPerSample 8 /Length 768 >> stream\n");
+    for (int i = 0; i < 768; ++i)
+    {
+        sampledFunction.append(char(i * 37));
+    }
+    sampledFunction.append(" endstream ");
+
+    QTest::newRow("sampled") << sampledFunction << 2;
+    QTest::newRow("exponential") << QByteArray(" << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 0 0 ] /C1 [ 1 0.5 0.25 ] /N 2.2 >> ") << 1;
+    QTest::newRow("stitching") << QByteArray(" << /FunctionType 3 /Domain [ 0 1 ] /Bounds [ 0.5 ] /Encode [ 0 1 0 1 ] "
+                                             " /Functions [ << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 ] /C1 [ 1 ] /N 1 >> "
+                                             "              << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 1 ] /C1 [ 0 ] /N 2 >> ] >> ") << 1;
+
+    const char postscriptProgram[] = "{ dup 0.5 mul exch dup mul add sqrt 1 exch sub }";
+    QTest::newRow("postscript") << (QString(" << /FunctionType 4 /Domain [ 0 1 ] /Range [ 0 1 ] /Length %1 >> stream\n").arg(std::strlen(postscriptProgram)).toLatin1() + postscriptProgram + " endstream ") << 1;
+}
+
+void Benchmarks::functionEvaluation()
+{
+    QFETCH(QByteArray, function);
+    QFETCH(int, inputs);
+
+    pdf::PDFDocument document;
+    pdf::PDFParser parser(function, nullptr, pdf::PDFParser::AllowStreams);
+    pdf::PDFFunctionPtr functionPtr = pdf::PDFFunction::createFunction(&document, parser.getObject());
+    QVERIFY(functionPtr);
+
+    constexpr int POINT_COUNT = 100000;
+    std::vector<pdf::PDFReal> x(inputs, 0.0);
+    std::vector<pdf::PDFReal> y(3, 0.0);
+
+    QBENCHMARK
+    {
+        for (int i = 0; i < POINT_COUNT; ++i)
+        {
+            std::fill(x.begin(), x.end(), pdf::PDFReal(i) / POINT_COUNT);
+            functionPtr->apply(x.data(), x.data() + x.size(), y.data(), y.data() + y.size());
+        }
+    }
+}
+
+void Benchmarks::colorConversion_data()
+{
+    QTest::addColumn<int>("system");
+    QTest::addColumn<QByteArray>("colorSpace");
+
+    for (const auto& [systemName, system] : { std::make_pair("Generic", pdf::PDFCMSSettings::System::Generic), std::make_pair("LittleCMS2", pdf::PDFCMSSettings::System::LittleCMS2) })
+    {
+        for (const char* colorSpace : { pdf::COLOR_SPACE_NAME_DEVICE_GRAY, pdf::COLOR_SPACE_NAME_DEVICE_RGB, pdf::COLOR_SPACE_NAME_DEVICE_CMYK })
+        {
+            QTest::newRow(qPrintable(QString("%1/%2").arg(systemName, colorSpace))) << int(system) << QByteArray(colorSpace);
+        }
+    }
+}
+
+void Benchmarks::colorConversion()
+{
+    QFETCH(int, system);
+    QFETCH(QByteArray, colorSpace);
+
+    pdf::PDFCMSSettings settings;
+    settings.system = pdf::PDFCMSSettings::System(system);
+
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setSettings(settings);
+    pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
+
+    pdf::PDFDocument document;
+    pdf::PDFColorSpacePointer colorSpacePtr = pdf::PDFAbstractColorSpace::createColorSpace(nullptr, &document, pdf::PDFObject::createName(colorSpace));
+    QVERIFY(colorSpacePtr);
+
+    constexpr size_t PIXEL_COUNT = 1 << 20;
+    const size_t componentCount = colorSpacePtr->getColorComponentCount();
+    std::vector<float> colors(PIXEL_COUNT * componentCount);
+    for (size_t i = 0; i < colors.size(); ++i)
+    {
+        colors[i] = float(i % 255) / 255.0f;
+    }
+    std::vector<unsigned char> outputBuffer(PIXEL_COUNT * 4);
+    pdf::PDFRenderErrorReporterDummy reporter;
+
+    QBENCHMARK
+    {
+        colorSpacePtr->fillRGBBuffer(colors, outputBuffer.data(), pdf::RenderingIntent::Perceptual, cms.data(), &reporter);
+    }
+}
+
+void Benchmarks::pageCompilation_data()
+{
+    addDocumentRows();
+}
+
+void Benchmarks::pageCompilation()
+{
+    QFETCH(int, document);
+    const CorpusDocument& corpusDocument = m_documents.at(document);
+    DocumentContext context(&corpusDocument.document);
+
+    pdf::PDFRenderer renderer(&corpusDocument.document, &context.fontCache, context.cms.data(), &context.optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), context.meshQualitySettings);
+    const size_t pageCount = corpusDocument.document.getCatalog()->getPageCount();
+
+    QBENCHMARK
+    {
+        for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+        {
+            pdf::PDFPrecompiledPage precompiledPage;
+            renderer.compile(&precompiledPage, pageIndex);
+        }
+    }
+}
+
+void Benchmarks::rasterization_data()
+{
+    QTest::addColumn<int>("document");
+    QTest::addColumn<int>("engine");
+
+    const std::pair<const char*, pdf::RendererEngine> engines[] =
+    {
+        { "QPainter", pdf::RendererEngine::QPainter },
+        { "Blend2D_SingleThread", pdf::RendererEngine::Blend2D_SingleThread },
+        { "Blend2D_MultiThread", pdf::RendererEngine::Blend2D_MultiThread }
+    };
+
+    for (size_t i = 0; i < m_documents.size(); ++i)
+    {
+        for (const auto& [engineName, engine] : engines)
+        {
+            QTest::newRow(qPrintable(QString("%1/%2").arg(m_documents[i].name, engineName))) << int(i) << int(engine);
+        }
+    }
+}
+
+void Benchmarks::rasterization()
+{
+    QFETCH(int, document);
+    QFETCH(int, engine);
+
+    const CorpusDocument& corpusDocument = m_documents.at(document);
+    DocumentContext context(&corpusDocument.document);
+
+    const pdf::PDFRenderer::Features features = pdf::PDFRenderer::getDefaultFeatures();
+    pdf::PDFRenderer renderer(&corpusDocument.document, &context.fontCache, context.cms.data(), &context.optionalContentActivity, features, context.meshQualitySettings);
+
+    // Pages are compiled before the benchmark, so only rasterization is measured
+    const size_t pageCount = corpusDocument.document.getCatalog()->getPageCount();
+    std::vector<pdf::PDFPrecompiledPage> precompiledPages(pageCount);
+    for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+    {
+        renderer.compile(&precompiledPages[pageIndex], pageIndex);
+    }
+
+    pdf::PDFRasterizer rasterizer(nullptr);
+    rasterizer.reset(pdf::RendererEngine(engine));
+
+    QBENCHMARK
+    {
+        for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+        {
+            const pdf::PDFPage* page = corpusDocument.document.getCatalog()->getPage(pageIndex);
+            const QSize imageSize = page->getRotatedMediaBox().size().toSize() * 2;
+            QImage image = rasterizer.render(pdf::PDFInteger(pageIndex), page, &precompiledPages[pageIndex], imageSize, features, nullptr, context.cms.data(), pdf::PageRotation::None);
+            Q_UNUSED(image);
+        }
+    }
+}
+
+void Benchmarks::textLayout_data()
+{
+    addDocumentRows();
+}
+
+void Benchmarks::textLayout()
+{
+    QFETCH(int, document);
+    const CorpusDocument& corpusDocument = m_documents.at(document);
+    DocumentContext context(&corpusDocument.document);
+    const size_t pageCount = corpusDocument.document.getCatalog()->getPageCount();
+
+    QBENCHMARK
+    {
+        for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+        {
+            const pdf::PDFPage* page = corpusDocument.document.getCatalog()->getPage(pageIndex);
+            pdf::PDFTextLayoutGenerator generator(pdf::PDFRenderer::getDefaultFeatures(), page, &corpusDocument.document, &context.fontCache, context.cms.data(),
+                                                  &context.optionalContentActivity, QTransform(), context.meshQualitySettings);
+            generator.processContents();
+            pdf::PDFTextLayout textLayout = generator.createTextLayout();
+            Q_UNUSED(textLayout);
+        }
+    }
+}
+
+void Benchmarks::diff_data()
+{
+    addDocumentRows();
+}
+
+void Benchmarks::diff()
+{
+    QFETCH(int, document);
+    const CorpusDocument& corpusDocument = m_documents.at(document);
+    const pdf::PDFInteger pageCount = pdf::PDFInteger(corpusDocument.document.getCatalog()->getPageCount());
+
+    pdf::PDFClosedIntervalSet pages;
+    pages.addInterval(0, pageCount - 1);
+
+    QBENCHMARK
+    {
+        // Document is compared with itself, so all pages are matched
+        pdf::PDFDiff diff(nullptr);
+        diff.setOption(pdf::PDFDiff::Asynchronous, false);
+        diff.setLeftDocument(&corpusDocument.document);
+        diff.setRightDocument(&corpusDocument.document);
+        diff.setPagesForLeftDocument(pages);
+        diff.setPagesForRightDocument(pages);
+        diff.start();
+    }
+}
+
+void Benchmarks::addDocumentRows()
+{
+    QTest::addColumn<int>("document");
+
+    for (size_t i = 0; i < m_documents.size(); ++i)
+    {
+        QTest::newRow(qPrintable(m_documents[i].name)) << int(i);
+    }
+}
+
+std::map<QByteArray, std::vector<std::pair<const pdf::PDFDocument*, const pdf::PDFStream*>>> Benchmarks::getImageStreams() const
+{
+    std::map<QByteArray, std::vector<std::pair<const pdf::PDFDocument*, const pdf::PDFStream*>>> result;
+
+    for (const CorpusDocument& corpusDocument : m_documents)
+    {
+        const pdf::PDFDocument* document = &corpusDocument.document;
+        for (const pdf::PDFObjectStorage::Entry& entry : document->getStorage().getObjects())
+        {
+            if (!entry.object.isStream())
+            {
+                continue;
+            }
+
+            const pdf::PDFStream* stream = entry.object.getStream();
+            const pdf::PDFObject& subtype = document->getObject(stream->getDictionary()->get("Subtype"));
+            if (subtype.isName() && subtype.getString() == "Image")
+            {
+                QByteArray filter = getLastFilterName(document, stream);
+                if (filter != "DCTDecode" && filter != "JPXDecode" && filter != "JBIG2Decode" && filter != "CCITTFaxDecode")
+                {
+                    filter = "Other";
+                }
+
+                result[filter].emplace_back(document, stream);
+            }
+        }
+    }
+
+    return result;
+}
+
+QByteArray Benchmarks::getLastFilterName(const pdf::PDFDocument* document, const pdf::PDFStream* stream)
+{
+    const pdf::PDFObject& filterObject = document->getObject(stream->getDictionary()->get("Filter"));
+    if (filterObject.isName())
+    {
+        return filterObject.getString();
+    }
+
+    if (filterObject.isArray() && filterObject.getArray()->getCount() > 0)
+    {
+        const pdf::PDFArray* filterArray = filterObject.getArray();
+        const pdf::PDFObject& lastFilterObject = document->getObject(filterArray->getItem(filterArray->getCount() - 1));
+        if (lastFilterObject.isName())
+        {
+            return lastFilterObject.getString();
+        }
+    }
+
+    return QByteArray();
+}
+
+QTEST_MAIN(Benchmarks)
+
+#include "tst_benchmarks.moc"
@@ -178,6 +178,7 @@ MainWindow::MainWindow(QWidget* parent) :
     m_diff.setProgress(m_progress);
     m_diff.setOption(pdf::PDFDiff::Asynchronous, true);
     connect(&m_diff, &pdf::PDFDiff::comparationFinished, this, &MainWindow::onComparationFinished);
+    connect(&m_diff, &pdf::PDFDiff::partialResultAvailable, this, &MainWindow::onPartialResultAvailable);
 
     m_diff.setLeftDocument(&m_leftDocument);
     m_diff.setRightDocument(&m_rightDocument);
@@ -259,6 +260,31 @@ void MainWindow::onComparationFinished()
     updateAll(true);
 }
 
+void MainWindow::onPartialResultAvailable()
+{
+    // Display differences found so far. Filters of newly
+    // found difference types are enabled. Document view is updated,
+    // when comparation is finished.
+    pdf::PDFDiffResult previousResult = std::move(m_diffResult);
+    m_diffResult = m_diff.getPartialResult();
+
+    auto updateFilter = [](QAction* action, bool hadDifferences, bool hasDifferences)
+    {
+        if (!hadDifferences && hasDifferences)
+        {
+            action->setChecked(true);
+        }
+    };
+
+    updateFilter(ui->actionFilter_Page_Movement, previousResult.hasPageMoveDifferences(), m_diffResult.hasPageMoveDifferences());
+    updateFilter(ui->actionFilter_Text, previousResult.hasTextDifferences(), m_diffResult.hasTextDifferences());
+    updateFilter(ui->actionFilter_Vector_Graphics, previousResult.hasVectorGraphicsDifferences(), m_diffResult.hasVectorGraphicsDifferences());
+    updateFilter(ui->actionFilter_Images, previousResult.hasImageDifferences(), m_diffResult.hasImageDifferences());
+    updateFilter(ui->actionFilter_Shading, previousResult.hasShadingDifferences(), m_diffResult.hasShadingDifferences());
+
+    updateFilteredResult();
+}
+
 void MainWindow::onColorsChanged()
 {
     updateFilteredResult();
@@ -99,6 +99,7 @@ private slots:
 private:
     void onMappedActionTriggered(int actionId);
     void onComparationFinished();
+    void onPartialResultAvailable();
     void onColorsChanged();
 
     void onProgressStarted(pdf::ProgressStartupInfo info);
@@ -16,18 +16,126 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "audiobookcreator.h"
+#include "pdfaudiobookwriter.h"
+#include "pdfexecutionpolicy.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
 #include <sapi.h>
 #if defined(PDF4QT_USE_PRAGMA_LIB)
 #pragma comment(lib, "ole32")
+#pragma comment(lib, "sapi")
 #endif
 #endif
 
 namespace pdfplugin
 {
 
+#ifdef Q_OS_WIN
+/// Returns voice token matching the settings, or nullptr,
+/// if no such voice exists. Returned token must be released.
+/// \param settings Settings
+static ISpObjectToken* getVoiceToken(const AudioBookCreator::Settings& settings)
+{
+    ISpObjectToken* token = nullptr;
+
+    QStringList voiceSelector;
+    if (!settings.voiceName.isEmpty())
+    {
+        voiceSelector << QString("Name=%1").arg(settings.voiceName);
+    }
+    if (!settings.voiceGender.isEmpty())
+    {
+        voiceSelector << QString("Gender=%1").arg(settings.voiceGender);
+    }
+    if (!settings.voiceAge.isEmpty())
+    {
+        voiceSelector << QString("Age=%1").arg(settings.voiceAge);
+    }
+    if (!settings.voiceLangCode.isEmpty())
+    {
+        voiceSelector << QString("Language=%1").arg(settings.voiceLangCode);
+    }
+    QString voiceSelectorString = voiceSelector.join(";");
+    LPCWSTR requiredAttributes = !voiceSelectorString.isEmpty() ? (LPCWSTR)voiceSelectorString.utf16() : nullptr;
+
+    ISpObjectTokenCategory* category = nullptr;
+    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpObjectTokenCategory, NULL, CLSCTX_ALL, __uuidof(ISpObjectTokenCategory), (LPVOID*)&category)))
+    {
+        return token;
+    }
+
+    if (!SUCCEEDED(category->SetId(SPCAT_VOICES, FALSE)))
+    {
+        category->Release();
+        return token;
+    }
+
+    IEnumSpObjectTokens* enumTokensObject = nullptr;
+    if (SUCCEEDED(category->EnumTokens(requiredAttributes, NULL, &enumTokensObject)))
+    {
+        enumTokensObject->Next(1, &token, NULL);
+    }
+
+    if (enumTokensObject)
+    {
+        enumTokensObject->Release();
+    }
+
+    if (category)
+    {
+        category->Release();
+    }
+
+    return token;
+}
+
+/// Synthesizes text to raw PCM audio data in the memory
+/// \param voice Voice
+/// \param waveFormat Format of the audio data
+/// \param text Text to be synthesized
+/// \param audioData Audio data
+static bool synthesizeText(ISpVoice* voice, const WAVEFORMATEX& waveFormat, const QString& text, QByteArray& audioData)
+{
+    IStream* memoryStream = nullptr;
+    if (!SUCCEEDED(::CreateStreamOnHGlobal(NULL, TRUE, &memoryStream)))
+    {
+        return false;
+    }
+
+    ISpStream* stream = nullptr;
+    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpStream, NULL, CLSCTX_ALL, __uuidof(ISpStream), (LPVOID*)&stream)))
+    {
+        memoryStream->Release();
+        return false;
+    }
+
+    bool result = false;
+    if (SUCCEEDED(stream->SetBaseStream(memoryStream, SPDFID_WaveFormatEx, &waveFormat)) &&
+        SUCCEEDED(voice->SetOutput(stream, FALSE)) &&
+        SUCCEEDED(voice->Speak((LPCWSTR)text.utf16(), SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL)))
+    {
+        STATSTG statistics = { };
+        HGLOBAL global = NULL;
+        if (SUCCEEDED(memoryStream->Stat(&statistics, STATFLAG_NONAME)) && SUCCEEDED(::GetHGlobalFromStream(memoryStream, &global)))
+        {
+            if (const char* data = static_cast<const char*>(::GlobalLock(global)))
+            {
+                audioData = QByteArray(data, qsizetype(statistics.cbSize.QuadPart));
+                ::GlobalUnlock(global);
+                result = true;
+            }
+        }
+    }
+
+    voice->SetOutput(NULL, FALSE);
+    stream->Release();
+    memoryStream->Release();
+
+    return result;
+}
+#endif
+
 AudioBookCreator::AudioBookCreator() :
     m_initialized(false)
 {
@@ -50,128 +158,120 @@ AudioBookCreator::~AudioBookCreator()
 pdf::PDFOperationResult AudioBookCreator::createAudioBook(const Settings& settings, pdf::PDFDocumentTextFlow& flow)
 {
 #ifdef Q_OS_WIN
-    QString audioString;
-    QTextStream textStream(&audioString);
-
+    // Each text item is a segment, so when text of one item is
+    // edited, only this segment must be synthesized again.
+    std::vector<QString> segments;
     for (const pdf::PDFDocumentTextFlow::Item& item : flow.getItems())
     {
         QString trimmedText = item.text.trimmed();
         if (!trimmedText.isEmpty())
         {
-            textStream << trimmedText << Qt::endl;
+            segments.emplace_back(qMove(trimmedText));
         }
     }
 
-    auto getVoiceToken = [](const Settings& settings)
+    // Do we have any voice?
+    if (ISpObjectToken* voiceToken = getVoiceToken(settings))
     {
-        ISpObjectToken* token = nullptr;
+        voiceToken->Release();
+    }
+    else
+    {
+        return tr("No suitable voice found.");
+    }
 
-        QStringList voiceSelector;
-        if (!settings.voiceName.isEmpty())
-        {
-            voiceSelector << QString("Name=%1").arg(settings.voiceName);
-        }
-        if (!settings.voiceGender.isEmpty())
-        {
-            voiceSelector << QString("Gender=%1").arg(settings.voiceGender);
-        }
-        if (!settings.voiceAge.isEmpty())
-        {
-            voiceSelector << QString("Age=%1").arg(settings.voiceAge);
-        }
-        if (!settings.voiceLangCode.isEmpty())
-        {
-            voiceSelector << QString("Language=%1").arg(settings.voiceLangCode);
-        }
-        QString voiceSelectorString = voiceSelector.join(";");
-        LPCWSTR requiredAttributes = !voiceSelectorString.isEmpty() ? (LPCWSTR)voiceSelectorString.utf16() : nullptr;
+    pdf::PDFAudioBookWriter::AudioFormat format;
 
-        ISpObjectTokenCategory* category = nullptr;
-        if (!SUCCEEDED(::CoCreateInstance(CLSID_SpObjectTokenCategory, NULL, CLSCTX_ALL, __uuidof(ISpObjectTokenCategory), (LPVOID*)&category)))
-        {
-            return token;
-        }
+    WAVEFORMATEX waveFormat = { };
+    waveFormat.wFormatTag = WAVE_FORMAT_PCM;
+    waveFormat.nChannels = WORD(format.channelCount);
+    waveFormat.nSamplesPerSec = DWORD(format.sampleRate);
+    waveFormat.wBitsPerSample = WORD(format.bitsPerSample);
+    waveFormat.nBlockAlign = WORD(format.channelCount * format.bitsPerSample / 8);
+    waveFormat.nAvgBytesPerSec = waveFormat.nSamplesPerSec * waveFormat.nBlockAlign;
+    waveFormat.cbSize = 0;
 
-        if (!SUCCEEDED(category->SetId(SPCAT_VOICES, FALSE)))
-        {
-            category->Release();
-            return token;
-        }
+    const QByteArray cacheKey = QString("%1;%2;%3;%4;%5;%6").arg(settings.voiceName, settings.voiceGender, settings.voiceAge, settings.voiceLangCode).arg(settings.rate).arg(settings.volume).toUtf8();
+    const size_t workerCount = pdf::PDFExecutionPolicy::getIdealThreadCount(pdf::PDFExecutionPolicy::Scope::Unknown);
+
+    // Each worker has its own COM apartment and voice instance
+    std::vector<ISpVoice*> voices(workerCount, nullptr);
+    std::vector<char> isComInitialized(workerCount, false);
 
-        IEnumSpObjectTokens* enumTokensObject = nullptr;
-        if (SUCCEEDED(category->EnumTokens(requiredAttributes, NULL, &enumTokensObject)))
+    auto startWorker = [&](size_t workerIndex, QString& errorMessage)
+    {
+        if (!SUCCEEDED(::CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
         {
-            enumTokensObject->Next(1, &token, NULL);
+            errorMessage = tr("Audio book creator cannot be initialized.");
+            return false;
         }
+        isComInitialized[workerIndex] = true;
 
-        if (enumTokensObject)
+        ISpObjectToken* voiceToken = getVoiceToken(settings);
+        if (!voiceToken)
         {
-            enumTokensObject->Release();
+            errorMessage = tr("No suitable voice found.");
+            return false;
         }
 
-        if (category)
+        ISpVoice* voice = nullptr;
+        if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
         {
-            category->Release();
+            voiceToken->Release();
+            errorMessage = tr("Cannot create voice.");
+            return false;
         }
 
-        return token;
-    };
+        voices[workerIndex] = voice;
 
-    ISpObjectToken* voiceToken = getVoiceToken(settings);
+        const bool isVoiceSet = SUCCEEDED(voice->SetVoice(voiceToken));
+        voiceToken->Release();
 
-    // Do we have any voice?
-    if (!voiceToken)
-    {
-        return tr("No suitable voice found.");
-    }
+        if (!isVoiceSet)
+        {
+            errorMessage = tr("Failed to set requested voice.");
+            return false;
+        }
 
-    QString outputFile = settings.audioFileName;
-    BSTR outputFileName = (BSTR)outputFile.utf16();
+        voice->SetRate(settings.rate * 10.0);
+        voice->SetVolume(settings.volume * 100.0);
+        return true;
+    };
 
-    ISpeechFileStream* stream = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpFileStream, NULL, CLSCTX_ALL, __uuidof(ISpeechFileStream), (LPVOID*)&stream)))
+    auto finishWorker = [&](size_t workerIndex, QString&)
     {
-        voiceToken->Release();
-        return tr("Cannot create output stream '%1'.").arg(outputFile);
-    }
+        if (voices[workerIndex])
+        {
+            voices[workerIndex]->Release();
+            voices[workerIndex] = nullptr;
+        }
 
-    ISpVoice* voice = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
-    {
-        voiceToken->Release();
-        stream->Release();
-        return tr("Cannot create voice.");
-    }
+        if (isComInitialized[workerIndex])
+        {
+            ::CoUninitialize();
+        }
 
-    if (!SUCCEEDED(stream->Open(outputFileName, SSFMCreateForWrite)))
-    {
-        voiceToken->Release();
-        voice->Release();
-        stream->Release();
-        return tr("Cannot create output stream '%1'.").arg(outputFile);
-    }
+        return true;
+    };
 
-    if (!SUCCEEDED(voice->SetVoice(voiceToken)))
+    auto synthesize = [&](size_t workerIndex, const QString& text, QByteArray& audioData, QString& errorMessage)
     {
-        voiceToken->Release();
-        voice->Release();
-        stream->Release();
-        return tr("Failed to set requested voice.");
-    }
-
-    LPCWSTR stringToSpeak = (LPCWSTR)audioString.utf16();
-
-    voice->SetOutput(stream, FALSE);
-    voice->SetRate(settings.rate * 10.0);
-    voice->SetVolume(settings.volume * 100.0);
-    voice->Speak(stringToSpeak, SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL);
+        if (!synthesizeText(voices[workerIndex], waveFormat, text, audioData))
+        {
+            errorMessage = tr("Cannot synthesize text '%1'.").arg(text.left(64));
+            return false;
+        }
 
-    voice->Release();
-    stream->Release();
-    voiceToken->Release();
+        return true;
+    };
 
-    return true;
+    pdf::PDFAudioBookWriter writer(format, settings.cacheDirectory, cacheKey);
+    writer.setWorkerCount(workerCount);
+    writer.setWorkerFunctions(startWorker, finishWorker);
+    return writer.write(settings.audioFileName, segments, synthesize);
 #else
+    Q_UNUSED(settings);
+    Q_UNUSED(flow);
     return tr("Audio book plugin is unsupported on your system.");
 #endif
 }
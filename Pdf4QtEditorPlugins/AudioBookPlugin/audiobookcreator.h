@@ -42,10 +42,19 @@ public:
         QString voiceLangCode;
         double rate = 0.0;
         double volume = 1.0;
+
+        /// Directory of the persistent cache of synthesized segments,
+        /// if it is empty, then cache is not used.
+        QString cacheDirectory;
     };
 
     bool isInitialized() const { return m_initialized; }
 
+    /// Creates audio book (WAV file) from the text flow. Each text item
+    /// of the text flow is a segment, segments are synthesized in parallel
+    /// using multiple voice instances and written in order to the file.
+    /// \param settings Settings
+    /// \param flow Text flow
     pdf::PDFOperationResult createAudioBook(const Settings& settings, pdf::PDFDocumentTextFlow& flow);
 
 private:
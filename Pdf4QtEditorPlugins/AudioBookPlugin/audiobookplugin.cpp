@@ -30,7 +30,9 @@
 #include <QMouseEvent>
 #include <QTableView>
 #include <QFileDialog>
+#include <QStandardPaths>
 #include <QRegularExpression>
+#include <QtConcurrent/QtConcurrent>
 
 namespace pdfplugin
 {
@@ -54,12 +56,12 @@ AudioBookPlugin::AudioBookPlugin() :
     m_audioTextStreamDockWidget(nullptr),
     m_audioTextStreamEditorModel(nullptr)
 {
-
+    connect(&m_selectionFutureWatcher, &QFutureWatcher<std::vector<size_t>>::finished, this, &AudioBookPlugin::onSelectionFinished);
 }
 
 AudioBookPlugin::~AudioBookPlugin()
 {
-
+    cancelSelection();
 }
 
 void AudioBookPlugin::setWidget(pdf::PDFWidget* widget)
@@ -138,6 +140,9 @@ void AudioBookPlugin::setDocument(const pdf::PDFModifiedDocument& document)
 
     if (document.hasReset())
     {
+        // Running selection accesses the text flow, which is being cleared
+        cancelSelection();
+
         if (m_audioTextStreamEditorModel)
         {
             m_audioTextStreamEditorModel->beginFlowChange();
@@ -295,7 +300,7 @@ void AudioBookPlugin::onSelectByContainedText()
     if (!text.isEmpty())
     {
         m_audioTextStreamDockWidget->clearSelectionText();
-        m_audioTextStreamEditorModel->selectByContainedText(text);
+        startSelection(pdf::PDFDocumentTextFlowEditor::createContainedTextPredicate(text));
     }
     else
     {
@@ -314,7 +319,7 @@ void AudioBookPlugin::onSelectByRegularExpression()
         if (expression.isValid())
         {
             m_audioTextStreamDockWidget->clearSelectionText();
-            m_audioTextStreamEditorModel->selectByRegularExpression(expression);
+            startSelection(pdf::PDFDocumentTextFlowEditor::createRegularExpressionPredicate(expression));
         }
         else
         {
@@ -339,7 +344,7 @@ void AudioBookPlugin::onSelectByPageList()
         if (errorMessage.isEmpty())
         {
             m_audioTextStreamDockWidget->clearSelectionText();
-            m_audioTextStreamEditorModel->selectByPageIndices(pageIndices);
+            startSelection(pdf::PDFDocumentTextFlowEditor::createPageIndicesPredicate(pageIndices));
         }
         else
         {
@@ -379,7 +384,7 @@ void AudioBookPlugin::onEditedTextFlowChanged()
 void AudioBookPlugin::onTextStreamTableSelectionChanged()
 {
     QTableView* tableView = m_audioTextStreamDockWidget->getTextStreamView();
-    QModelIndexList indices = tableView->selectionModel()->selectedIndexes();
+    QModelIndexList indices = tableView->selectionModel()->selectedRows();
 
     if (m_actionSynchronizeFromTableToGraphics->isChecked() && !indices.empty())
     {
@@ -403,7 +408,7 @@ void AudioBookPlugin::onTextStreamTableSelectionChanged()
         m_textFlowEditor.select(index.row(), true);
     }
 
-    m_audioTextStreamEditorModel->notifyDataChanged();
+    notifyVisibleRowsChanged();
 }
 
 void AudioBookPlugin::onClear()
@@ -436,7 +441,7 @@ void AudioBookPlugin::onCreateAudioBook()
 {
     pdf::IPluginDataExchange::VoiceSettings voiceSettings = m_dataExchangeInterface->getVoiceSettings();
 
-    QString fileName = QFileDialog::getSaveFileName(m_widget, tr("Select Audio File"), voiceSettings.directory, tr("Audio stream (*.mp3)"));
+    QString fileName = QFileDialog::getSaveFileName(m_widget, tr("Select Audio File"), voiceSettings.directory, tr("Audio stream (*.wav)"));
     if (fileName.isEmpty())
     {
         return;
@@ -451,6 +456,7 @@ void AudioBookPlugin::onCreateAudioBook()
         settings.voiceName = voiceSettings.voiceName;
         settings.rate = voiceSettings.rate;
         settings.volume = voiceSettings.volume;
+        settings.cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/AudioBookSegments";
         pdf::PDFDocumentTextFlow textFlow = m_textFlowEditor.createEditedTextFlow();
         result = audioBookCreator.createAudioBook(settings, textFlow);
     }
@@ -471,22 +477,92 @@ void AudioBookPlugin::onRectanglePicked(pdf::PDFInteger pageIndex, QRectF rectan
     m_audioTextStreamEditorModel->selectByRectangle(rectangle);
 }
 
+void AudioBookPlugin::onSelectionFinished()
+{
+    if (!m_selectionFutureWatcher.isFinished())
+    {
+        // Notification of the cancelled selection, new selection is running
+        return;
+    }
+
+    std::shared_ptr<SelectionOperationControl> operationControl = qMove(m_selectionOperationControl);
+    m_selectionOperationControl.reset();
+
+    if (operationControl && !operationControl->isOperationCancelled() && m_audioTextStreamEditorModel)
+    {
+        m_audioTextStreamEditorModel->selectItems(m_selectionFutureWatcher.result());
+    }
+
+    updateActions();
+}
+
+void AudioBookPlugin::startSelection(pdf::PDFDocumentTextFlowEditor::ItemPredicate predicate)
+{
+    cancelSelection();
+
+    std::shared_ptr<SelectionOperationControl> operationControl = std::make_shared<SelectionOperationControl>();
+    m_selectionOperationControl = operationControl;
+
+    const pdf::PDFDocumentTextFlowEditor* editor = &m_textFlowEditor;
+    pdf::PDFProgress* progress = m_widget->getDrawWidgetProxy()->getProgress();
+
+    auto findItems = [editor, predicate, operationControl, progress]()
+    {
+        return editor->findItems(predicate, operationControl.get(), progress);
+    };
+
+    m_selectionFutureWatcher.setFuture(QtConcurrent::run(findItems));
+
+    // Items can't be edited, while they are searched
+    updateActions();
+}
+
+void AudioBookPlugin::cancelSelection()
+{
+    if (m_selectionOperationControl)
+    {
+        m_selectionOperationControl->cancel();
+        m_selectionOperationControl.reset();
+    }
+
+    m_selectionFutureWatcher.waitForFinished();
+}
+
+void AudioBookPlugin::notifyVisibleRowsChanged()
+{
+    if (m_audioTextStreamEditorModel)
+    {
+        std::pair<int, int> visibleRowRange = m_audioTextStreamDockWidget->getVisibleRowRange();
+        m_audioTextStreamEditorModel->notifyRowsChanged(visibleRowRange.first, visibleRowRange.second);
+    }
+
+    // Model may not notify about any row, so we must update graphics here
+    onEditedTextFlowChanged();
+}
+
 void AudioBookPlugin::updateActions()
 {
-    m_actionCreateTextStream->setEnabled(m_document);
+    const bool isEditable = !m_textFlowEditor.isEmpty() && !isSelectionRunning();
+
+    m_actionCreateTextStream->setEnabled(m_document && !isSelectionRunning());
     m_actionSynchronizeFromTableToGraphics->setEnabled(true);
     m_actionSynchronizeFromGraphicsToTable->setEnabled(true);
-    m_actionActivateSelection->setEnabled(!m_textFlowEditor.isSelectionEmpty());
-    m_actionDeactivateSelection->setEnabled(!m_textFlowEditor.isSelectionEmpty());
-    m_actionSelectByRectangle->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionSelectByContainedText->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionSelectByRegularExpression->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionSelectByPageList->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionRestoreOriginalText->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionMoveSelectionUp->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionMoveSelectionDown->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionCreateAudioBook->setEnabled(!m_textFlowEditor.isEmpty());
-    m_actionClear->setEnabled(!m_textFlowEditor.isEmpty());
+    m_actionActivateSelection->setEnabled(isEditable && !m_textFlowEditor.isSelectionEmpty());
+    m_actionDeactivateSelection->setEnabled(isEditable && !m_textFlowEditor.isSelectionEmpty());
+    m_actionSelectByRectangle->setEnabled(isEditable);
+    m_actionSelectByContainedText->setEnabled(isEditable);
+    m_actionSelectByRegularExpression->setEnabled(isEditable);
+    m_actionSelectByPageList->setEnabled(isEditable);
+    m_actionRestoreOriginalText->setEnabled(isEditable);
+    m_actionMoveSelectionUp->setEnabled(isEditable);
+    m_actionMoveSelectionDown->setEnabled(isEditable);
+    m_actionCreateAudioBook->setEnabled(isEditable);
+    m_actionClear->setEnabled(isEditable);
+
+    if (m_audioTextStreamDockWidget)
+    {
+        m_audioTextStreamDockWidget->getTextStreamView()->setEnabled(!isSelectionRunning());
+    }
 }
 
 std::optional<size_t> AudioBookPlugin::getItemIndexForPagePoint(QPoint pos) const
@@ -568,11 +644,7 @@ void AudioBookPlugin::mousePressEvent(QWidget* widget, QMouseEvent* event)
             }
 
             m_textFlowEditor.select(*index, !remove);
-
-            if (m_audioTextStreamEditorModel)
-            {
-                m_audioTextStreamEditorModel->notifyDataChanged();
-            }
+            notifyVisibleRowsChanged();
         }
     }
 }
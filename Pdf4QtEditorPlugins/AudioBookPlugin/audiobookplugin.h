@@ -23,8 +23,13 @@
 #include "pdfdocumenttextfloweditormodel.h"
 #include "pdfdocumentdrawinterface.h"
 #include "audiotextstreameditordockwidget.h"
+#include "pdfoperationcontrol.h"
 
 #include <QObject>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <memory>
 
 namespace pdfplugin
 {
@@ -87,6 +92,33 @@ private:
     void onCreateAudioBook();
 
     void onRectanglePicked(pdf::PDFInteger pageIndex, QRectF rectangle);
+    void onSelectionFinished();
+
+    /// Operation control of the background selection, each selection has its
+    /// own, so newly started selection isn't affected by cancelling the old one.
+    class SelectionOperationControl : public pdf::PDFOperationControl
+    {
+    public:
+        void cancel() { m_isCancelled = true; }
+        virtual bool isOperationCancelled() const override { return m_isCancelled; }
+
+    private:
+        std::atomic_bool m_isCancelled = false;
+    };
+
+    /// Starts selection of the items matching the predicate in the background.
+    /// Items are selected, when the search is finished.
+    /// \param predicate Predicate
+    void startSelection(pdf::PDFDocumentTextFlowEditor::ItemPredicate predicate);
+
+    /// Cancels running selection and waits until it is finished
+    void cancelSelection();
+
+    bool isSelectionRunning() const { return m_selectionFutureWatcher.isRunning(); }
+
+    /// Notifies the table view, that selection of the visible rows has
+    /// changed, other rows are updated, when they are scrolled into the view.
+    void notifyVisibleRowsChanged();
 
     void updateActions();
 
@@ -110,6 +142,8 @@ private:
     pdf::PDFDocumentTextFlowEditor m_textFlowEditor;
     AudioTextStreamEditorDockWidget* m_audioTextStreamDockWidget;
     pdf::PDFDocumentTextFlowEditorModel* m_audioTextStreamEditorModel;
+    QFutureWatcher<std::vector<size_t>> m_selectionFutureWatcher;
+    std::shared_ptr<SelectionOperationControl> m_selectionOperationControl;
 
     QString m_toolTip;
     std::optional<QCursor> m_cursor;
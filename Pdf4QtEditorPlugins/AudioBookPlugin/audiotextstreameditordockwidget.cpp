@@ -22,6 +22,7 @@
 
 #include <QToolBar>
 #include <QLineEdit>
+#include <QTableView>
 
 namespace pdfplugin
 {
@@ -103,8 +104,38 @@ void AudioTextStreamEditorDockWidget::clearSelectionText()
 
 void AudioTextStreamEditorDockWidget::goToIndex(size_t index)
 {
-    QModelIndex modelIndex = ui->textStreamTableView->model()->index(int(index), 0);
+    // Rows are fetched on demand, row of the item may not be fetched yet
+    m_model->fetchRow(int(index));
+
+    QModelIndex modelIndex = m_model->index(int(index), 0);
     ui->textStreamTableView->scrollTo(modelIndex);
 }
 
+std::pair<int, int> AudioTextStreamEditorDockWidget::getVisibleRowRange() const
+{
+    QTableView* tableView = ui->textStreamTableView;
+    const int rowCount = tableView->model() ? tableView->model()->rowCount(QModelIndex()) : 0;
+
+    if (rowCount == 0)
+    {
+        return std::make_pair(0, -1);
+    }
+
+    int firstRow = tableView->rowAt(0);
+    int lastRow = tableView->rowAt(tableView->viewport()->height() - 1);
+
+    if (firstRow == -1)
+    {
+        return std::make_pair(0, -1);
+    }
+
+    if (lastRow == -1)
+    {
+        // Viewport isn't fully covered by the rows
+        lastRow = rowCount - 1;
+    }
+
+    return std::make_pair(firstRow, lastRow);
+}
+
 } // namespace pdfplugin
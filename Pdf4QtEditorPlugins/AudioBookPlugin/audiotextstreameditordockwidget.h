@@ -71,6 +71,10 @@ public:
 
     void goToIndex(size_t index);
 
+    /// Returns range of rows visible in the text stream view
+    /// (first and last row), range is empty, if no row is visible.
+    std::pair<int, int> getVisibleRowRange() const;
+
 private:
     Ui::AudioTextStreamEditorDockWidget* ui;
     pdf::PDFDocumentTextFlowEditorModel* m_model;
@@ -371,6 +371,31 @@ bool EditorPlugin::updatePageContent(pdf::PDFInteger pageIndex,
     return true;
 }
 
+bool EditorPlugin::isPageContentModified(pdf::PDFInteger pageIndex,
+                                         const std::vector<const pdf::PDFPageContentElement*>& elements) const
+{
+    const pdf::PDFEditedPageContent& editedPageContent = m_editedPageContent.at(pageIndex);
+
+    if (elements.size() != editedPageContent.getElementCount())
+    {
+        return true;
+    }
+
+    // Page content is unmodified, if the page contains only the elements
+    // created from the page content, in the same order, and none of them
+    // was modified (they have the same revision as the original elements).
+    for (size_t i = 0; i < elements.size(); ++i)
+    {
+        const pdf::PDFPageContentElementEdited* editedElement = elements[i]->asElementEdited();
+        if (!editedElement || editedElement->getElement()->getRevision() != editedPageContent.getElement(i)->getRevision())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool EditorPlugin::save()
 {
     pdf::PDFTemporaryValueChange guard(&m_isSaving, true);
@@ -408,6 +433,12 @@ bool EditorPlugin::save()
                 elements = std::move(it->second);
             }
 
+            if (!isPageContentModified(pageIndex, elements))
+            {
+                // Page content was not modified, keep the original content stream
+                continue;
+            }
+
             if (!updatePageContent(pageIndex, elements, builder))
             {
                 return false;
@@ -115,6 +115,8 @@ private:
     bool updatePageContent(pdf::PDFInteger pageIndex,
                            const std::vector<const pdf::PDFPageContentElement*>& elements,
                            pdf::PDFDocumentBuilder* builder);
+    bool isPageContentModified(pdf::PDFInteger pageIndex,
+                               const std::vector<const pdf::PDFPageContentElement*>& elements) const;
     bool updateTextElement(pdf::PDFPageContentElementEdited* element);
 
     void onDrawSpaceChanged();
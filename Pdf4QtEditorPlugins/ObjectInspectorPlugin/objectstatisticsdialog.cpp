@@ -20,14 +20,29 @@
 
 #include "pdfwidgetutils.h"
 
+#include <QtConcurrent/QtConcurrent>
+
 namespace pdfplugin
 {
 
+static void copyStatistics(const pdf::PDFObjectClassifier::Statistics& source, pdf::PDFObjectClassifier::Statistics& target)
+{
+    target.objectCountByType = source.objectCountByType;
+
+    for (const auto& item : source.statistics)
+    {
+        pdf::PDFObjectClassifier::StatisticsItem& targetItem = target.statistics[item.first];
+        targetItem.count = item.second.count.load();
+        targetItem.bytes = item.second.bytes.load();
+    }
+}
+
 ObjectStatisticsDialog::ObjectStatisticsDialog(const pdf::PDFDocument* document, QWidget *parent) :
     QDialog(parent, Qt::Dialog | Qt::WindowMaximizeButtonHint | Qt::WindowCloseButtonHint),
     ui(new Ui::ObjectStatisticsDialog),
     m_document(document),
-    m_statisticsGraphWidget(new StatisticsGraphWidget(this))
+    m_statisticsGraphWidget(new StatisticsGraphWidget(this)),
+    m_isCancelled(false)
 {
     ui->setupUi(this);
 
@@ -38,9 +53,12 @@ ObjectStatisticsDialog::ObjectStatisticsDialog(const pdf::PDFDocument* document,
     ui->comboBox->setCurrentIndex(ui->comboBox->findData(int(ByObjectClass), Qt::UserRole, Qt::MatchExactly));
     connect(ui->comboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ObjectStatisticsDialog::updateStatisticsWidget);
 
-    pdf::PDFObjectClassifier classifier;
-    classifier.classify(document);
-    m_statistics = classifier.calculateStatistics(document);
+    ui->progressBar->setRange(0, 100);
+    ui->progressBar->setValue(0);
+
+    // Statistics are calculated in the background, so dialog is shown
+    // immediately and graphs are updated, as objects are processed.
+    m_future = QtConcurrent::run([this]() { calculateStatistics(); });
 
     updateStatisticsWidget();
     pdf::PDFWidgetUtils::style(this);
@@ -48,11 +66,51 @@ ObjectStatisticsDialog::ObjectStatisticsDialog(const pdf::PDFDocument* document,
 
 ObjectStatisticsDialog::~ObjectStatisticsDialog()
 {
+    m_isCancelled = true;
+    m_future.waitForFinished();
+
     delete ui;
 }
 
+void ObjectStatisticsDialog::calculateStatistics()
+{
+    pdf::PDFObjectClassifier classifier;
+    classifier.classify(m_document);
+
+    pdf::PDFObjectClassifier::Statistics statistics;
+    classifier.prepareStatistics(statistics);
+
+    const size_t objectCount = classifier.getObjectCount();
+    const size_t chunkSize = qMax(size_t(1024), objectCount / 100);
+
+    size_t first = 0;
+    do
+    {
+        const size_t last = qMin(first + chunkSize, objectCount);
+        classifier.calculateStatistics(m_document, statistics, first, last);
+        first = last;
+
+        {
+            QMutexLocker lock(&m_statisticsMutex);
+            copyStatistics(statistics, m_statistics);
+        }
+
+        const int progress = objectCount > 0 ? int(100 * first / objectCount) : 100;
+        QMetaObject::invokeMethod(this, [this, progress]() { onStatisticsProgress(progress); }, Qt::QueuedConnection);
+    } while (first < objectCount && !m_isCancelled);
+}
+
+void ObjectStatisticsDialog::onStatisticsProgress(int progress)
+{
+    ui->progressBar->setValue(progress);
+    ui->progressBar->setVisible(progress < 100);
+    updateStatisticsWidget();
+}
+
 void ObjectStatisticsDialog::updateStatisticsWidget()
 {
+    QMutexLocker lock(&m_statisticsMutex);
+
     StatisticsGraphWidget::Statistics statistics;
 
     QLocale locale;
@@ -99,7 +157,7 @@ void ObjectStatisticsDialog::updateStatisticsWidget()
 
                 const pdf::PDFObjectClassifier::StatisticsItem& statisticsItem = it->second;
 
-                qreal percentage = qreal(100.0) * qreal(statisticsItem.bytes) / qreal(totalBytesCount);
+                qreal percentage = totalBytesCount > 0 ? qreal(100.0) * qreal(statisticsItem.bytes) / qreal(totalBytesCount) : qreal(0.0);
 
                 StatisticsGraphWidget::StatisticsItem item;
                 item.portion = percentage / qreal(100.0);
@@ -22,7 +22,11 @@
 #include "pdfobjectutils.h"
 #include "statisticsgraphwidget.h"
 
+#include <QMutex>
 #include <QDialog>
+#include <QFuture>
+
+#include <atomic>
 
 namespace Ui
 {
@@ -51,9 +55,22 @@ private:
 
     void updateStatisticsWidget();
 
+    /// Calculates statistics incrementally, it is called from background
+    /// thread. After each part of objects is processed, statistics are
+    /// updated and progress is reported.
+    void calculateStatistics();
+
+    /// Called from main thread, when part of objects is processed
+    /// \param progress Progress in percents
+    void onStatisticsProgress(int progress);
+
     const pdf::PDFDocument* m_document;
-    pdf::PDFObjectClassifier::Statistics m_statistics;
     StatisticsGraphWidget* m_statisticsGraphWidget;
+
+    QMutex m_statisticsMutex;
+    pdf::PDFObjectClassifier::Statistics m_statistics;
+    QFuture<void> m_future;
+    std::atomic_bool m_isCancelled;
 };
 
 }   // namespace pdfplugin
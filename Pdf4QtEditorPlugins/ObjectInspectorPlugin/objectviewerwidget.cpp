@@ -23,6 +23,8 @@
 #include "pdfdocumentwriter.h"
 #include "pdfexception.h"
 
+#include <QTimer>
+
 namespace pdfplugin
 {
 
@@ -38,10 +40,18 @@ ObjectViewerWidget::ObjectViewerWidget(bool isPinned, QWidget* parent) :
     m_cms(nullptr),
     m_document(nullptr),
     m_isPinned(isPinned),
-    m_isRootObject(false)
+    m_isRootObject(false),
+    m_isPreviewDirty(false),
+    m_previewTimer(new QTimer(this))
 {
     ui->setupUi(this);
 
+    // Preview is updated with a delay, so quick browsing trough the
+    // objects doesn't decode each stream or image on the way.
+    m_previewTimer->setSingleShot(true);
+    m_previewTimer->setInterval(PREVIEW_UPDATE_DELAY);
+    connect(m_previewTimer, &QTimer::timeout, this, &ObjectViewerWidget::updatePreview);
+
     m_printableCharacters = pdf::PDFEncoding::getPrintableCharacters();
     m_printableCharacters.push_back('\n');
 
@@ -199,6 +209,38 @@ void ObjectViewerWidget::updateUi()
             break;
     }
 
+    // Preview is created only when it is shown
+    m_isPreviewDirty = true;
+    ui->contentTextBrowser->clear();
+    ui->imageBrowser->clear();
+    ui->stackedWidget->setCurrentWidget(ui->contentTextBrowserPage);
+
+    if (isVisible())
+    {
+        m_previewTimer->start();
+    }
+}
+
+void ObjectViewerWidget::showEvent(QShowEvent* event)
+{
+    BaseClass::showEvent(event);
+
+    if (m_isPreviewDirty)
+    {
+        m_previewTimer->start();
+    }
+}
+
+void ObjectViewerWidget::updatePreview()
+{
+    if (!m_isPreviewDirty)
+    {
+        return;
+    }
+
+    m_isPreviewDirty = false;
+    QLocale locale;
+
     if (m_currentObject.isStream())
     {
         try
@@ -246,9 +288,18 @@ void ObjectViewerWidget::updateUi()
             else
             {
                 QByteArray dataToBeAdjusted = m_document->getDecodedStream(stream);
+                const qsizetype hiddenDataSize = qMax(dataToBeAdjusted.size() - MAX_PREVIEW_TEXT_SIZE, qsizetype(0));
+                dataToBeAdjusted.truncate(MAX_PREVIEW_TEXT_SIZE);
                 dataToBeAdjusted.replace('\r', ' ');
                 QByteArray percentEncodedData = dataToBeAdjusted.toPercentEncoding(m_printableCharacters);
-                ui->contentTextBrowser->setText(QString::fromLatin1(percentEncodedData));
+                QString text = QString::fromLatin1(percentEncodedData);
+
+                if (hiddenDataSize > 0)
+                {
+                    text += tr("\n\n[%1 more data bytes are not shown]").arg(locale.toString(hiddenDataSize));
+                }
+
+                ui->contentTextBrowser->setText(text);
                 ui->stackedWidget->setCurrentWidget(ui->contentTextBrowserPage);
             }
         }
@@ -23,6 +23,8 @@
 
 #include <QWidget>
 
+class QTimer;
+
 namespace Ui
 {
 class ObjectViewerWidget;
@@ -35,6 +37,9 @@ class ObjectViewerWidget : public QWidget
 {
     Q_OBJECT
 
+private:
+    using BaseClass = QWidget;
+
 public:
     explicit ObjectViewerWidget(QWidget* parent);
     explicit ObjectViewerWidget(bool isPinned, QWidget* parent);
@@ -57,8 +62,18 @@ signals:
     void pinRequest();
     void unpinRequest();
 
+protected:
+    virtual void showEvent(QShowEvent* event) override;
+
 private:
+    /// Delay of the preview update [ms]
+    static constexpr int PREVIEW_UPDATE_DELAY = 100;
+
+    /// Maximal size of decoded stream data shown in the preview
+    static constexpr qsizetype MAX_PREVIEW_TEXT_SIZE = 1024 * 1024;
+
     void updateUi();
+    void updatePreview();
     void updatePinnedUi();
 
     Ui::ObjectViewerWidget* ui;
@@ -70,6 +85,8 @@ private:
     pdf::PDFObject m_currentObject;
     bool m_isRootObject;
     QByteArray m_printableCharacters;
+    bool m_isPreviewDirty;
+    QTimer* m_previewTimer;
 };
 
 }   // pdfplugin
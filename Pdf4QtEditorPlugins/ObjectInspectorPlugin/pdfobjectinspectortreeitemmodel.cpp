@@ -17,11 +17,8 @@
 
 #include "pdfobjectinspectortreeitemmodel.h"
 #include "pdfdocument.h"
-#include "pdfvisitor.h"
 #include "pdfencoding.h"
 
-#include <stack>
-
 #include <QLocale>
 
 namespace pdfplugin
@@ -36,6 +33,7 @@ public:
     inline explicit PDFObjectInspectorTreeItem(pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_object(std::move(object)) { }
     inline explicit PDFObjectInspectorTreeItem(QByteArray dictionaryKey, pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_dictionaryKey(std::move(dictionaryKey)), m_object(std::move(object)) { }
     inline explicit PDFObjectInspectorTreeItem(pdf::PDFObjectReference reference, pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_reference(std::move(reference)), m_object(std::move(object)) { }
+    inline explicit PDFObjectInspectorTreeItem(pdf::PDFObjectReference reference, QByteArray dictionaryKey, pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_dictionaryKey(std::move(dictionaryKey)), m_reference(std::move(reference)), m_object(std::move(object)) { }
 
     virtual ~PDFObjectInspectorTreeItem() override { }
 
@@ -49,10 +47,20 @@ public:
     const pdf::PDFObject& getObject() const;
     void setObject(const pdf::PDFObject& object);
 
+    /// Returns row of the item in the parent. Row is stored in the item,
+    /// because searching the item in the parent is slow for large lists.
+    int getItemRow() const { return m_row; }
+    void setItemRow(int row) { m_row = row; }
+
+    bool isChildrenCreated() const { return m_isChildrenCreated; }
+    void setChildrenCreated(bool isChildrenCreated) { m_isChildrenCreated = isChildrenCreated; }
+
 private:
     QByteArray m_dictionaryKey;
     pdf::PDFObjectReference m_reference;
     pdf::PDFObject m_object;
+    int m_row = 0;
+    bool m_isChildrenCreated = false;
 };
 
 QByteArray PDFObjectInspectorTreeItem::getDictionaryKey() const
@@ -187,24 +195,114 @@ QVariant PDFObjectInspectorTreeItemModel::data(const QModelIndex& index, int rol
     return data.join(" ");
 }
 
+QModelIndex PDFObjectInspectorTreeItemModel::parent(const QModelIndex& child) const
+{
+    if (child.isValid())
+    {
+        const PDFObjectInspectorTreeItem* childItem = static_cast<const PDFObjectInspectorTreeItem*>(child.internalPointer());
+        const PDFObjectInspectorTreeItem* parentItem = static_cast<const PDFObjectInspectorTreeItem*>(childItem->getParent());
+
+        if (parentItem != m_rootItem.get())
+        {
+            return createIndex(parentItem->getItemRow(), child.column(), const_cast<PDFObjectInspectorTreeItem*>(parentItem));
+        }
+    }
+
+    return QModelIndex();
+}
+
+bool PDFObjectInspectorTreeItemModel::hasChildren(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+    {
+        return rowCount(parent) > 0 || canFetchMore(parent);
+    }
+
+    const PDFObjectInspectorTreeItem* item = static_cast<const PDFObjectInspectorTreeItem*>(parent.internalPointer());
+    return item->isChildrenCreated() ? item->getChildCount() > 0 : hasChildObjects(item);
+}
+
+bool PDFObjectInspectorTreeItemModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+    {
+        return m_rootItem && m_rootEntriesFetched < m_rootEntries.size();
+    }
+
+    const PDFObjectInspectorTreeItem* item = static_cast<const PDFObjectInspectorTreeItem*>(parent.internalPointer());
+    return !item->isChildrenCreated() && hasChildObjects(item);
+}
+
+void PDFObjectInspectorTreeItemModel::fetchMore(const QModelIndex& parent)
+{
+    if (!parent.isValid())
+    {
+        if (!canFetchMore(parent))
+        {
+            return;
+        }
+
+        const size_t count = qMin(ROOT_ITEMS_FETCH_COUNT, m_rootEntries.size() - m_rootEntriesFetched);
+        const int firstRow = m_rootItem->getChildCount();
+
+        beginInsertRows(parent, firstRow, firstRow + int(count) - 1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const RootEntry& entry = m_rootEntries[m_rootEntriesFetched++];
+            createObjectItem(getRootItem(), entry.reference, QByteArray(), entry.object);
+        }
+        endInsertRows();
+        return;
+    }
+
+    PDFObjectInspectorTreeItem* item = static_cast<PDFObjectInspectorTreeItem*>(parent.internalPointer());
+    if (item->isChildrenCreated())
+    {
+        return;
+    }
+
+    item->setChildrenCreated(true);
+    std::vector<std::pair<QByteArray, pdf::PDFObject>> childObjects = takeChildObjects(item);
+
+    if (childObjects.empty())
+    {
+        return;
+    }
+
+    beginInsertRows(parent, 0, int(childObjects.size()) - 1);
+    for (auto& childObject : childObjects)
+    {
+        createObjectItem(item, item->getReference(), qMove(childObject.first), qMove(childObject.second));
+    }
+    endInsertRows();
+}
+
 void PDFObjectInspectorTreeItemModel::update()
 {
     beginResetModel();
 
     m_rootItem.reset();
+    m_rootEntries.clear();
+    m_rootEntriesFetched = 0;
+    m_usedReferences.clear();
+    m_followReferences = m_mode != List;
 
     if (m_document)
     {
-        std::set<pdf::PDFObjectReference> usedReferences;
+        // Root items are not created here, they are created on demand,
+        // when view requests them, together with their children.
+        m_rootItem.reset(new PDFObjectInspectorTreeItem());
 
-        auto createObjectsFromClassifier = [this, &usedReferences](pdf::PDFObjectClassifier::Type type)
+        auto addRootEntry = [this](pdf::PDFObjectReference reference, pdf::PDFObject object)
         {
-            m_rootItem.reset(new PDFObjectInspectorTreeItem());
+            m_rootEntries.push_back(RootEntry{ reference, qMove(object) });
+        };
 
+        auto createObjectsFromClassifier = [this, &addRootEntry](pdf::PDFObjectClassifier::Type type)
+        {
             for (pdf::PDFObjectReference reference : m_classifier->getObjectsByType(type))
             {
-                pdf::PDFObject object = m_document->getStorage().getObjectByReference(reference);
-                createObjectItem(getRootItem(), reference, object, true, usedReferences);
+                addRootEntry(reference, m_document->getStorage().getObjectByReference(reference));
             }
         };
 
@@ -212,24 +310,20 @@ void PDFObjectInspectorTreeItemModel::update()
         {
             case pdfplugin::PDFObjectInspectorTreeItemModel::Document:
             {
-                m_rootItem.reset(new PDFObjectInspectorTreeItem());
                 const pdf::PDFObjectStorage& storage = m_document->getStorage();
-                createObjectItem(getRootItem(), pdf::PDFObjectReference(), storage.getTrailerDictionary(), true, usedReferences);
+                addRootEntry(pdf::PDFObjectReference(), storage.getTrailerDictionary());
                 break;
             }
 
             case pdfplugin::PDFObjectInspectorTreeItemModel::Page:
             {
-                m_rootItem.reset(new PDFObjectInspectorTreeItem());
-
                 const size_t pageCount = m_document->getCatalog()->getPageCount();
                 for (size_t i = 0; i < pageCount; ++i)
                 {
                     if (const pdf::PDFPage* page = m_document->getCatalog()->getPage(i))
                     {
                         pdf::PDFObjectReference reference = page->getPageReference();
-                        pdf::PDFObject object = m_document->getStorage().getObjectByReference(reference);
-                        createObjectItem(getRootItem(), reference, object, true, usedReferences);
+                        addRootEntry(reference, m_document->getStorage().getObjectByReference(reference));
                     }
                 }
 
@@ -278,15 +372,14 @@ void PDFObjectInspectorTreeItemModel::update()
 
             case pdfplugin::PDFObjectInspectorTreeItemModel::List:
             {
-                m_rootItem.reset(new PDFObjectInspectorTreeItem());
-
                 const pdf::PDFObjectStorage& storage = m_document->getStorage();
-                createObjectItem(getRootItem(), pdf::PDFObjectReference(), storage.getTrailerDictionary(), false, usedReferences);
+                addRootEntry(pdf::PDFObjectReference(), storage.getTrailerDictionary());
                 const pdf::PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+                m_rootEntries.reserve(objects.size() + 1);
                 for (size_t i = 0; i < objects.size(); ++i)
                 {
                     pdf::PDFObjectReference reference(i, objects[i].generation);
-                    pdf::PDFObject object = objects[i].object;
+                    const pdf::PDFObject& object = objects[i].object;
 
                     if (object.isNull())
                     {
@@ -294,7 +387,7 @@ void PDFObjectInspectorTreeItemModel::update()
                         continue;
                     }
 
-                    createObjectItem(getRootItem(), reference, object, false, usedReferences);
+                    addRootEntry(reference, object);
                 }
 
                 break;
@@ -304,6 +397,14 @@ void PDFObjectInspectorTreeItemModel::update()
                 Q_ASSERT(false);
                 break;
         }
+
+        // Create first batch of the root items, so view has something to show
+        const size_t count = qMin(ROOT_ITEMS_FETCH_COUNT, m_rootEntries.size());
+        for (; m_rootEntriesFetched < count; ++m_rootEntriesFetched)
+        {
+            const RootEntry& entry = m_rootEntries[m_rootEntriesFetched];
+            createObjectItem(getRootItem(), entry.reference, QByteArray(), entry.object);
+        }
     }
 
     endResetModel();
@@ -345,155 +446,98 @@ bool PDFObjectInspectorTreeItemModel::isRootObject(const QModelIndex& index) con
     return index.isValid() && !index.parent().isValid();
 }
 
-class PDFCreateObjectInspectorTreeItemFromObjectVisitor : public pdf::PDFAbstractVisitor
-{
-public:
-    explicit PDFCreateObjectInspectorTreeItemFromObjectVisitor(std::set<pdf::PDFObjectReference>* usedReferences,
-                                                               const pdf::PDFDocument* document,
-                                                               bool followReferences,
-                                                               pdf::PDFObjectReference reference,
-                                                               PDFObjectInspectorTreeItem* parent) :
-        m_usedReferences(usedReferences),
-        m_document(document),
-        m_followReferences(followReferences),
-        m_reference(reference)
-    {
-        m_parents.push(parent);
-    }
-
-    virtual ~PDFCreateObjectInspectorTreeItemFromObjectVisitor() override
-    {
-        m_parents.pop();
-        Q_ASSERT(m_parents.empty());
-    }
-
-    virtual void visitNull() override;
-    virtual void visitBool(bool value) override;
-    virtual void visitInt(pdf::PDFInteger value) override;
-    virtual void visitReal(pdf::PDFReal value) override;
-    virtual void visitString(pdf::PDFStringRef string) override;
-    virtual void visitName(pdf::PDFStringRef name) override;
-    virtual void visitArray(const pdf::PDFArray* array) override;
-    virtual void visitDictionary(const pdf::PDFDictionary* dictionary) override;
-    virtual void visitStream(const pdf::PDFStream* stream) override;
-    virtual void visitReference(const pdf::PDFObjectReference reference) override;
-
-private:
-    std::set<pdf::PDFObjectReference>* m_usedReferences;
-    const pdf::PDFDocument* m_document;
-    bool m_followReferences;
-    pdf::PDFObjectReference m_reference;
-    std::stack<PDFObjectInspectorTreeItem*> m_parents;
-};
-
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitNull()
+void PDFObjectInspectorTreeItemModel::createObjectItem(PDFObjectInspectorTreeItem* parent,
+                                                       pdf::PDFObjectReference reference,
+                                                       QByteArray dictionaryKey,
+                                                       pdf::PDFObject object) const
 {
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createNull(), m_parents.top()));
+    PDFObjectInspectorTreeItem* item = new PDFObjectInspectorTreeItem(reference, qMove(dictionaryKey), qMove(object), parent);
+    item->setItemRow(parent->getChildCount());
+    parent->addCreatedChild(item);
 }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitBool(bool value)
+bool PDFObjectInspectorTreeItemModel::hasChildObjects(const PDFObjectInspectorTreeItem* item) const
 {
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createBool(value), m_parents.top()));
-}
+    const pdf::PDFObject& object = item->getObject();
+    switch (object.getType())
+    {
+        case pdf::PDFObject::Type::Array:
+            return object.getArray()->getCount() > 0;
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitInt(pdf::PDFInteger value)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createInteger(value), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Dictionary:
+            return object.getDictionary()->getCount() > 0;
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitReal(pdf::PDFReal value)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createReal(value), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Stream:
+            return object.getStream()->getDictionary()->getCount() > 0;
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitString(pdf::PDFStringRef string)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createString(string.getString()), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Reference:
+        {
+            const pdf::PDFObjectReference reference = object.getReference();
+            return m_followReferences && reference.isValid() && !m_usedReferences.count(reference);
+        }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitName(pdf::PDFStringRef name)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createName(name), m_parents.top()));
-}
+        default:
+            break;
+    }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitArray(const pdf::PDFArray* array)
-{
-    PDFObjectInspectorTreeItem* arrayRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(*array)), m_parents.top());
-    m_parents.top()->addCreatedChild(arrayRoot);
-    m_parents.push(arrayRoot);
-    acceptArray(array);
-    m_parents.pop();
+    return false;
 }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitDictionary(const pdf::PDFDictionary* dictionary)
+std::vector<std::pair<QByteArray, pdf::PDFObject>> PDFObjectInspectorTreeItemModel::takeChildObjects(const PDFObjectInspectorTreeItem* item)
 {
-    PDFObjectInspectorTreeItem* dictionaryRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(*dictionary)), m_parents.top());
-    m_parents.top()->addCreatedChild(dictionaryRoot);
-    m_parents.push(dictionaryRoot);
-
-    acceptDictionary(dictionary);
+    std::vector<std::pair<QByteArray, pdf::PDFObject>> result;
 
-    Q_ASSERT(dictionaryRoot->getChildCount() == dictionary->getCount());
-    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    if (!hasChildObjects(item))
     {
-        PDFObjectInspectorTreeItem* child = static_cast<PDFObjectInspectorTreeItem*>(dictionaryRoot->getChild(int(i)));
-        child->setDictionaryKey(dictionary->getKey(i).getString());
+        return result;
     }
 
-    m_parents.pop();
-}
-
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitStream(const pdf::PDFStream* stream)
-{
-    PDFObjectInspectorTreeItem* streamRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(*stream)), m_parents.top());
-    m_parents.top()->addCreatedChild(streamRoot);
-    m_parents.push(streamRoot);
-
-    const pdf::PDFDictionary* dictionary = stream->getDictionary();
-    acceptDictionary(dictionary);
-
-    Q_ASSERT(streamRoot->getChildCount() == dictionary->getCount());
-    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    auto addDictionary = [&result](const pdf::PDFDictionary* dictionary)
     {
-        PDFObjectInspectorTreeItem* child = static_cast<PDFObjectInspectorTreeItem*>(streamRoot->getChild(int(i)));
-        child->setDictionaryKey(dictionary->getKey(i).getString());
-    }
+        result.reserve(dictionary->getCount());
+        for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+        {
+            result.emplace_back(dictionary->getKey(i).getString(), dictionary->getValue(i));
+        }
+    };
 
-    m_parents.pop();
-}
+    const pdf::PDFObject& object = item->getObject();
+    switch (object.getType())
+    {
+        case pdf::PDFObject::Type::Array:
+        {
+            const pdf::PDFArray* array = object.getArray();
+            result.reserve(array->getCount());
+            for (size_t i = 0, count = array->getCount(); i < count; ++i)
+            {
+                result.emplace_back(QByteArray(), array->getItem(i));
+            }
+            break;
+        }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitReference(const pdf::PDFObjectReference reference)
-{
-    PDFObjectInspectorTreeItem* referenceRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createReference(reference), m_parents.top());
-    m_parents.top()->addCreatedChild(referenceRoot);
+        case pdf::PDFObject::Type::Dictionary:
+            addDictionary(object.getDictionary());
+            break;
 
-    if (m_followReferences && reference.isValid())
-    {
-        Q_ASSERT(m_usedReferences);
+        case pdf::PDFObject::Type::Stream:
+            addDictionary(object.getStream()->getDictionary());
+            break;
 
-        if (m_usedReferences->count(reference))
+        case pdf::PDFObject::Type::Reference:
         {
-            // Reference already followed
-            return;
+            // Reference is followed only once
+            const pdf::PDFObjectReference reference = object.getReference();
+            m_usedReferences.insert(reference);
+            result.emplace_back(QByteArray(), m_document->getObjectByReference(reference));
+            break;
         }
 
-        m_usedReferences->insert(reference);
-
-        m_parents.push(referenceRoot);
-        const pdf::PDFObject& object = m_document->getObjectByReference(reference);
-        object.accept(this);
-        m_parents.pop();
+        default:
+            Q_ASSERT(false);
+            break;
     }
-}
 
-void PDFObjectInspectorTreeItemModel::createObjectItem(PDFObjectInspectorTreeItem* parent,
-                                                       pdf::PDFObjectReference reference,
-                                                       pdf::PDFObject object,
-                                                       bool followRef,
-                                                       std::set<pdf::PDFObjectReference>& usedReferences) const
-{
-    PDFCreateObjectInspectorTreeItemFromObjectVisitor visitor(&usedReferences, m_document, followRef, reference, parent);
-    object.accept(&visitor);
+    return result;
 }
 
 PDFObjectInspectorTreeItem* PDFObjectInspectorTreeItemModel::getRootItem()
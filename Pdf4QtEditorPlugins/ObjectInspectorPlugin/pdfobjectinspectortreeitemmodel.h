@@ -22,6 +22,7 @@
 #include "pdfobjectutils.h"
 
 #include <set>
+#include <vector>
 
 namespace pdfplugin
 {
@@ -56,6 +57,10 @@ public:
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     virtual int columnCount(const QModelIndex& parent) const override;
     virtual QVariant data(const QModelIndex& index, int role) const override;
+    virtual QModelIndex parent(const QModelIndex& child) const override;
+    virtual bool hasChildren(const QModelIndex& parent) const override;
+    virtual bool canFetchMore(const QModelIndex& parent) const override;
+    virtual void fetchMore(const QModelIndex& parent) override;
     virtual void update() override;
 
     void setMode(Mode mode);
@@ -65,16 +70,47 @@ public:
     bool isRootObject(const QModelIndex& index) const;
 
 private:
+    /// Count of root items, which are created at once, when
+    /// view requests more items.
+    static constexpr size_t ROOT_ITEMS_FETCH_COUNT = 1024;
+
+    struct RootEntry
+    {
+        pdf::PDFObjectReference reference;
+        pdf::PDFObject object;
+    };
+
+    /// Creates new item and adds it to the parent
+    /// \param parent Parent item
+    /// \param reference Reference of the root object
+    /// \param dictionaryKey Dictionary key (can be empty)
+    /// \param object Object
     void createObjectItem(PDFObjectInspectorTreeItem* parent,
                           pdf::PDFObjectReference reference,
-                          pdf::PDFObject object,
-                          bool followRef,
-                          std::set<pdf::PDFObjectReference>& usedReferences) const;
+                          QByteArray dictionaryKey,
+                          pdf::PDFObject object) const;
+
+    /// Returns true, if child items can be created for given item
+    /// \param item Item
+    bool hasChildObjects(const PDFObjectInspectorTreeItem* item) const;
+
+    /// Returns child objects of the item (together with dictionary keys). If item
+    /// is a reference, which should be followed, then it is marked as used.
+    /// \param item Item
+    std::vector<std::pair<QByteArray, pdf::PDFObject>> takeChildObjects(const PDFObjectInspectorTreeItem* item);
 
     PDFObjectInspectorTreeItem* getRootItem();
 
     const pdf::PDFObjectClassifier* m_classifier;
     Mode m_mode = List;
+
+    /// Root objects, items are created on demand
+    std::vector<RootEntry> m_rootEntries;
+    size_t m_rootEntriesFetched = 0;
+
+    /// Follow references (each reference is followed only once)
+    bool m_followReferences = false;
+    std::set<pdf::PDFObjectReference> m_usedReferences;
 };
 
 }   // namespace pdfplugin
@@ -25,6 +25,7 @@
 
 #include <QCloseEvent>
 #include <QColorDialog>
+#include <QMutex>
 #include <QtConcurrent/QtConcurrent>
 
 namespace pdfplugin
@@ -39,7 +40,9 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     m_widget(widget),
     m_needUpdateImage(false),
     m_outputPreviewWidget(new OutputPreviewWidget(this)),
-    m_futureWatcher(nullptr)
+    m_futureWatcher(nullptr),
+    m_isPrefetching(false),
+    m_inkMapperRevision(0)
 {
     ui->setupUi(this);
 
@@ -90,6 +93,9 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
 
 OutputPreviewDialog::~OutputPreviewDialog()
 {
+    // Background prefetch may still be running
+    m_future.waitForFinished();
+    delete m_futureWatcher;
     delete ui;
 }
 
@@ -101,7 +107,8 @@ void OutputPreviewDialog::resizeEvent(QResizeEvent* event)
 
 void OutputPreviewDialog::closeEvent(QCloseEvent* event)
 {
-    if (!isRenderingDone())
+    // Background prefetch doesn't block closing of the dialog
+    if (!isRenderingDone() && !m_isPrefetching)
     {
         event->ignore();
     }
@@ -220,6 +227,7 @@ void OutputPreviewDialog::onAlarmColorButtonClicked()
 void OutputPreviewDialog::onSimulateSeparationsChecked(bool checked)
 {
     m_inkMapper.setSpotColorsActive(checked);
+    clearImageCache();
     updateInks();
     updatePageImage();
 }
@@ -268,16 +276,37 @@ void OutputPreviewDialog::updatePageImage()
 
     m_needUpdateImage = false;
 
-    const pdf::PDFPage* page = m_document->getCatalog()->getPage(ui->pageIndexScrollBar->value() - 1);
+    const pdf::PDFInteger pageIndex = ui->pageIndexScrollBar->value() - 1;
+    const pdf::PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
     if (!page)
     {
         m_outputPreviewWidget->clear();
         return;
     }
 
+    const RenderKey key = getRenderKey(pageIndex);
+
+    // Ink visibility and paper color are often toggled back
+    // and forth, or the user steps through the pages. Already rendered
+    // separations are reused, so we do not need to process the page again.
+    if (const RenderedImage* cachedImage = findCachedImage(key))
+    {
+        m_outputPreviewWidget->setPageImage(cachedImage->image, cachedImage->originalProcessImage, cachedImage->pageSize);
+        prefetchNeighbourPages();
+        return;
+    }
+
     QApplication::setOverrideCursor(Qt::WaitCursor);
+    startRendering(key, false);
+}
 
-    pdf::PDFRGB paperColor = pdf::PDFRGB{ 1.0f, 1.0f, 1.0f };
+OutputPreviewDialog::RenderKey OutputPreviewDialog::getRenderKey(pdf::PDFInteger pageIndex) const
+{
+    RenderKey key;
+    key.pageIndex = pageIndex;
+    key.renderSize = m_outputPreviewWidget->getPageImageSizeHint();
+    key.paperColor = pdf::PDFRGB{ 1.0f, 1.0f, 1.0f };
+    key.inkMapperRevision = m_inkMapperRevision;
 
     // Active color mask
     uint32_t activeColorMask = pdf::PDFPixelFormat::getAllColorsMask();
@@ -304,12 +333,14 @@ void OutputPreviewDialog::updatePageImage()
         }
     }
 
+    key.activeColorMask = activeColorMask;
+
     // Paper color
     if (ui->simulatePaperColorCheckBox)
     {
-        paperColor[0] = ui->redPaperColorEdit->value();
-        paperColor[1] = ui->greenPaperColorEdit->value();
-        paperColor[2] = ui->bluePaperColorEdit->value();
+        key.paperColor[0] = ui->redPaperColorEdit->value();
+        key.paperColor[1] = ui->greenPaperColorEdit->value();
+        key.paperColor[2] = ui->bluePaperColorEdit->value();
     }
 
     pdf::PDFTransparencyRendererSettings::Flags flags = pdf::PDFTransparencyRendererSettings::None;
@@ -319,12 +350,21 @@ void OutputPreviewDialog::updatePageImage()
     flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayShadings, ui->displayShadingCheckBox->isChecked());
     flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayTilingPatterns, ui->displayTilingPatternsCheckBox->isChecked());
     flags.setFlag(pdf::PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::ReducedPrecisionStorage, true);
+    key.flags = flags;
+
+    return key;
+}
 
+void OutputPreviewDialog::startRendering(const RenderKey& key, bool isPrefetch)
+{
+    Q_ASSERT(isRenderingDone());
+
+    m_isPrefetching = isPrefetch;
     m_inkMapperForRendering = m_inkMapper;
-    QSize renderSize = m_outputPreviewWidget->getPageImageSizeHint();
-    auto renderImage = [this, page, renderSize, paperColor, activeColorMask, flags]() -> RenderedImage
+    auto renderImage = [this, key]() -> RenderedImage
     {
-        return renderPage(page, renderSize, paperColor, activeColorMask, flags);
+        return renderPage(key);
     };
 
     m_future = QtConcurrent::run(renderImage);
@@ -333,17 +373,99 @@ void OutputPreviewDialog::updatePageImage()
     m_futureWatcher->setFuture(m_future);
 }
 
-OutputPreviewDialog::RenderedImage OutputPreviewDialog::renderPage(const pdf::PDFPage* page,
-                                                                   QSize renderSize,
-                                                                   pdf::PDFRGB paperColor,
-                                                                   uint32_t activeColorMask,
-                                                                   pdf::PDFTransparencyRendererSettings::Flags additionalFlags)
+void OutputPreviewDialog::prefetchNeighbourPages()
+{
+    if (!isRenderingDone() || !isVisible())
+    {
+        return;
+    }
+
+    const pdf::PDFInteger pageIndex = ui->pageIndexScrollBar->value() - 1;
+    const pdf::PDFInteger pageCount = pdf::PDFInteger(m_document->getCatalog()->getPageCount());
+
+    // Next page is preferred, as pages are usually browsed forward
+    for (const pdf::PDFInteger neighbourPageIndex : { pageIndex + 1, pageIndex - 1 })
+    {
+        if (neighbourPageIndex < 0 || neighbourPageIndex >= pageCount)
+        {
+            continue;
+        }
+
+        const RenderKey key = getRenderKey(neighbourPageIndex);
+        auto it = std::find_if(m_imageCache.cbegin(), m_imageCache.cend(), [&key](const RenderedImage& image) { return image.key == key; });
+        if (it == m_imageCache.cend())
+        {
+            startRendering(key, true);
+            return;
+        }
+    }
+}
+
+const OutputPreviewDialog::RenderedImage* OutputPreviewDialog::findCachedImage(const RenderKey& key)
+{
+    auto it = std::find_if(m_imageCache.begin(), m_imageCache.end(), [&key](const RenderedImage& image) { return image.key == key; });
+    if (it == m_imageCache.end())
+    {
+        return nullptr;
+    }
+
+    // Move the image to the end (most recently used)
+    std::rotate(it, std::next(it), m_imageCache.end());
+    return &m_imageCache.back();
+}
+
+void OutputPreviewDialog::insertCachedImage(RenderedImage image)
+{
+    // Original process image contains float value for each
+    // process color, spot color, shape and opacity, so it is much larger than
+    // displayed image. We keep only a few pages around the current one.
+    constexpr qint64 MAX_CACHE_SIZE = 512 * 1024 * 1024;
+
+    auto getImageSize = [](const RenderedImage& renderedImage) -> qint64
+    {
+        const pdf::PDFFloatBitmapWithColorSpace& bitmap = renderedImage.originalProcessImage;
+        return renderedImage.image.sizeInBytes() + qint64(bitmap.getWidth() * bitmap.getHeight() * bitmap.getPixelSize() * sizeof(pdf::PDFColorComponent));
+    };
+
+    m_imageCache.erase(std::remove_if(m_imageCache.begin(), m_imageCache.end(), [&image](const RenderedImage& cachedImage) { return cachedImage.key == image.key; }), m_imageCache.end());
+    m_imageCache.emplace_back(qMove(image));
+
+    qint64 cacheSize = 0;
+    for (const RenderedImage& cachedImage : m_imageCache)
+    {
+        cacheSize += getImageSize(cachedImage);
+    }
+
+    // Remove least recently used images, but always keep the last inserted one
+    auto it = m_imageCache.begin();
+    while (cacheSize > MAX_CACHE_SIZE && std::next(it) != m_imageCache.end())
+    {
+        cacheSize -= getImageSize(*it);
+        ++it;
+    }
+    m_imageCache.erase(m_imageCache.begin(), it);
+}
+
+void OutputPreviewDialog::clearImageCache()
+{
+    m_imageCache.clear();
+    ++m_inkMapperRevision;
+}
+
+OutputPreviewDialog::RenderedImage OutputPreviewDialog::renderPage(const RenderKey& key)
 {
     RenderedImage result;
+    result.key = key;
+
+    const pdf::PDFPage* page = m_document->getCatalog()->getPage(key.pageIndex);
+    if (!page)
+    {
+        return result;
+    }
 
     QRectF pageRect = page->getRotatedMediaBox();
     QSizeF pageSize = pageRect.size();
-    pageSize.scale(renderSize.width(), renderSize.height(), Qt::KeepAspectRatio);
+    pageSize.scale(key.renderSize.width(), key.renderSize.height(), Qt::KeepAspectRatio);
     QSize imageSize = pageSize.toSize();
 
     if (!imageSize.isValid())
@@ -352,39 +474,69 @@ OutputPreviewDialog::RenderedImage OutputPreviewDialog::renderPage(const pdf::PD
     }
 
     pdf::PDFTransparencyRendererSettings settings;
-    settings.flags = additionalFlags;
+    settings.flags = key.flags;
 
     // Jakub Melka: debug is very slow, use multithreading
 #ifdef QT_DEBUG
     settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::MultithreadedPathSampler, true);
 #endif
 
-    settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::ActiveColorMask, activeColorMask != pdf::PDFPixelFormat::getAllColorsMask());
+    settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::ActiveColorMask, key.activeColorMask != pdf::PDFPixelFormat::getAllColorsMask());
     settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::SeparationSimulation, m_inkMapperForRendering.getActiveSpotColorCount() > 0);
-    settings.activeColorMask = activeColorMask;
+    settings.activeColorMask = key.activeColorMask;
 
     QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
     pdf::PDFDrawWidgetProxy* proxy = m_widget->getDrawWidgetProxy();
     pdf::PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
-    pdf::PDFTransparencyRenderer renderer(page, m_document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(),
-                                          &m_inkMapperForRendering, settings, pagePointToDevicePoint);
+    pdf::PDFTransparencyTileRenderer renderer(page, m_document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(),
+                                              &m_inkMapperForRendering, settings, pagePointToDevicePoint);
+
+    // Page is rendered in tiles, tile images are composed into page images
+    const pdf::PDFRGB paperColor = key.paperColor;
+    QMutex mutex;
+    auto composeTile = [&](const QRect& tileRect, const pdf::PDFTransparencyRenderer& tileRenderer)
+    {
+        QImage tileImage = tileRenderer.toImage(false, true, paperColor);
+        pdf::PDFFloatBitmapWithColorSpace tileOriginalProcessImage = tileRenderer.getOriginalProcessBitmap();
 
-    renderer.beginPaint(imageSize);
-    result.errors = renderer.processContents();
-    renderer.endPaint();
+        QMutexLocker lock(&mutex);
 
-    QImage image = renderer.toImage(false, true, paperColor);
+        if (!tileImage.isNull())
+        {
+            if (result.image.isNull())
+            {
+                result.image = QImage(imageSize, tileImage.format());
+                result.image.fill(Qt::transparent);
+            }
 
-    result.image = qMove(image);
-    result.originalProcessImage = renderer.getOriginalProcessBitmap();
+            const int bytesPerPixel = tileImage.depth() / 8;
+            const qsizetype tileLineSize = qsizetype(tileImage.width()) * bytesPerPixel;
+            for (int y = 0; y < tileImage.height(); ++y)
+            {
+                const uchar* sourceLine = tileImage.constScanLine(y);
+                uchar* targetLine = result.image.scanLine(tileRect.top() + y) + tileRect.left() * bytesPerPixel;
+                std::copy(sourceLine, sourceLine + tileLineSize, targetLine);
+            }
+        }
+
+        if (tileOriginalProcessImage.getWidth() > 0)
+        {
+            if (result.originalProcessImage.getWidth() == 0)
+            {
+                result.originalProcessImage = pdf::PDFFloatBitmapWithColorSpace(imageSize.width(), imageSize.height(), tileOriginalProcessImage.getPixelFormat(), tileOriginalProcessImage.getColorSpace());
+            }
+
+            result.originalProcessImage.copyBitmap(tileOriginalProcessImage, tileRect.topLeft());
+        }
+    };
+
+    result.errors = renderer.render(imageSize, composeTile);
     result.pageSize = page->getRotatedMediaBoxMM().size();
     return result;
 }
 
 void OutputPreviewDialog::onPageImageRendered()
 {
-    QApplication::restoreOverrideCursor();
-
     if (m_future.isFinished())
     {
         RenderedImage result = m_future.result();
@@ -392,12 +544,27 @@ void OutputPreviewDialog::onPageImageRendered()
         m_futureWatcher->deleteLater();
         m_futureWatcher = nullptr;
 
-        m_outputPreviewWidget->setPageImage(qMove(result.image), qMove(result.originalProcessImage), result.pageSize);
+        if (!m_isPrefetching)
+        {
+            QApplication::restoreOverrideCursor();
+            m_outputPreviewWidget->setPageImage(result.image, result.originalProcessImage, result.pageSize);
+        }
+        m_isPrefetching = false;
+
+        // Images rendered with outdated ink mapping are not cached
+        if (result.key.inkMapperRevision == m_inkMapperRevision)
+        {
+            insertCachedImage(qMove(result));
+        }
 
         if (m_needUpdateImage)
         {
             updatePageImage();
         }
+        else
+        {
+            prefetchNeighbourPages();
+        }
     }
 }
 
@@ -408,7 +575,7 @@ bool OutputPreviewDialog::isRenderingDone() const
 
 void OutputPreviewDialog::accept()
 {
-    if (!isRenderingDone())
+    if (!isRenderingDone() && !m_isPrefetching)
     {
         return;
     }
@@ -418,7 +585,7 @@ void OutputPreviewDialog::accept()
 
 void OutputPreviewDialog::reject()
 {
-    if (!isRenderingDone())
+    if (!isRenderingDone() && !m_isPrefetching)
     {
         return;
     }
@@ -64,8 +64,22 @@ private:
     void onInkCoverageLimitChanged(double value);
     void onRichBlackLimtiChanged(double value);
 
+    /// Parameters, which uniquely determine rendered page image
+    struct RenderKey
+    {
+        pdf::PDFInteger pageIndex = -1;
+        QSize renderSize;
+        pdf::PDFRGB paperColor = { };
+        uint32_t activeColorMask = 0;
+        pdf::PDFTransparencyRendererSettings::Flags flags = pdf::PDFTransparencyRendererSettings::None;
+        int inkMapperRevision = 0;
+
+        bool operator==(const RenderKey&) const = default;
+    };
+
     struct RenderedImage
     {
+        RenderKey key;
         QImage image;
         pdf::PDFFloatBitmapWithColorSpace originalProcessImage;
         QSizeF pageSize;
@@ -74,13 +88,37 @@ private:
 
     void updatePageImage();
     void onPageImageRendered();
-    RenderedImage renderPage(const pdf::PDFPage* page,
-                             QSize renderSize,
-                             pdf::PDFRGB paperColor,
-                             uint32_t activeColorMask,
-                             pdf::PDFTransparencyRendererSettings::Flags additionalFlags);
+    RenderedImage renderPage(const RenderKey& key);
     bool isRenderingDone() const;
 
+    /// Returns render key for the page using current settings of the dialog
+    /// \param pageIndex Page index
+    RenderKey getRenderKey(pdf::PDFInteger pageIndex) const;
+
+    /// Starts asynchronous rendering of the page
+    /// \param key Render key
+    /// \param isPrefetch Is it a prefetch of the neighbouring page?
+    void startRendering(const RenderKey& key, bool isPrefetch);
+
+    /// Starts background rendering of the first neighbouring page
+    /// of the current page, which is not in the cache. If all neighbouring
+    /// pages are cached, then nothing happens.
+    void prefetchNeighbourPages();
+
+    /// Finds image in the cache. Found image is marked as most recently used.
+    /// Returns nullptr, if image is not found.
+    /// \param key Render key
+    const RenderedImage* findCachedImage(const RenderKey& key);
+
+    /// Inserts image into the cache, least recently used images
+    /// are removed, if cache size limit is exceeded.
+    /// \param image Rendered image
+    void insertCachedImage(RenderedImage image);
+
+    /// Removes all images from the cache, and ensures, that images being
+    /// rendered are not cached (for example, when ink mapping is changed).
+    void clearImageCache();
+
     Ui::OutputPreviewDialog* ui;
     pdf::PDFInkMapper m_inkMapper;
     pdf::PDFInkMapper m_inkMapperForRendering;
@@ -91,6 +129,12 @@ private:
 
     QFuture<RenderedImage> m_future;
     QFutureWatcher<RenderedImage>* m_futureWatcher;
+    bool m_isPrefetching;
+    int m_inkMapperRevision;
+
+    /// Rendered images, ordered from least recently used
+    /// to most recently used.
+    std::vector<RenderedImage> m_imageCache;
 };
 
 }   // namespace pdf
@@ -278,8 +278,11 @@ void SignaturePlugin::onSceneEditElement(const std::set<pdf::PDFInteger>& elemen
         return;
     }
 
-    if (pdf::PDFPageContentEditorStyleSettings::showEditElementStyleDialog(m_dataExchangeInterface->getMainWindow(), element))
+    // Element is replaced, so scene can update its cached rendering
+    std::unique_ptr<pdf::PDFPageContentElement> clonedElement(element->clone());
+    if (pdf::PDFPageContentEditorStyleSettings::showEditElementStyleDialog(m_dataExchangeInterface->getMainWindow(), clonedElement.get()))
     {
+        m_scene.replaceElement(clonedElement.release());
         updateGraphics();
     }
 }
@@ -93,7 +93,10 @@ public:
 /// Algorithm for computing longest common subsequence, on two sequences
 /// of objects, which are implementing operator "==" (equal operator).
 /// Constructor takes bidirectional iterators to the sequence. So, iterators
-/// are requred to be bidirectional.
+/// are requred to be bidirectional. Common prefix and suffix of the sequences
+/// are matched directly. For small inputs, dynamic programming with backtrack
+/// matrix is used, for large inputs (when backtrack matrix would be too large),
+/// linear space variant of Myers O(ND) algorithm is used.
 template<typename Iterator, typename Comparator>
 class PDFAlgorithmLongestCommonSubsequence : public PDFAlgorithmLongestCommonSubsequenceBase
 {
@@ -104,24 +107,39 @@ public:
                                          Iterator it2End,
                                          Comparator comparator);
 
+    /// Maximal number of cells of backtrack matrix, for which dynamic
+    /// programming is used. Larger inputs use linear space algorithm.
+    static constexpr const size_t MAX_BACKTRACK_MATRIX_SIZE = size_t(1) << 24;
 
     void perform();
 
     const Sequence& getSequence() const { return m_sequence; }
 
 private:
+    bool isEqual(size_t index1, size_t index2) { return m_comparator(*m_items1[index1], *m_items2[index2]); }
+
+    void addMatches(size_t index1, size_t index2, size_t count);
+    void addLeftItems(size_t first1, size_t last1);
+    void addRightItems(size_t first2, size_t last2);
+
+    /// Computes subsequence of ranges [first1, last1) and [first2, last2)
+    /// using dynamic programming with backtrack matrix.
+    void performBacktrack(size_t first1, size_t last1, size_t first2, size_t last2);
+
+    /// Computes subsequence of ranges [first1, last1) and [first2, last2)
+    /// using linear space variant of Myers algorithm (divide and conquer
+    /// using middle snake).
+    void performLinearSpace(size_t first1, size_t last1, size_t first2, size_t last2);
+
     Iterator m_it1;
     Iterator m_it1End;
     Iterator m_it2;
     Iterator m_it2End;
 
-    size_t m_size1;
-    size_t m_size2;
-    size_t m_matrixSize;
-
     Comparator m_comparator;
 
-    std::vector<bool> m_backtrackData;
+    std::vector<Iterator> m_items1;
+    std::vector<Iterator> m_items2;
     Sequence m_sequence;
 };
 
@@ -135,36 +153,126 @@ PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::PDFAlgorithmLongestC
     m_it1End(std::move(it1End)),
     m_it2(std::move(it2)),
     m_it2End(std::move(it2End)),
-    m_size1(0),
-    m_size2(0),
-    m_matrixSize(0),
     m_comparator(std::move(comparator))
 {
-    m_size1 = std::distance(m_it1, m_it1End) + 1;
-    m_size2 = std::distance(m_it2, m_it2End) + 1;
-    m_matrixSize = m_size1 * m_size2;
+
 }
 
 template<typename Iterator, typename Comparator>
 void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
 {
-    m_backtrackData.resize(m_matrixSize);
     m_sequence.clear();
+    m_items1.clear();
+    m_items2.clear();
+
+    for (auto it = m_it1; it != m_it1End; ++it)
+    {
+        m_items1.push_back(it);
+    }
+
+    for (auto it = m_it2; it != m_it2End; ++it)
+    {
+        m_items2.push_back(it);
+    }
+
+    size_t first1 = 0;
+    size_t first2 = 0;
+    size_t last1 = m_items1.size();
+    size_t last2 = m_items2.size();
+
+    m_sequence.reserve(last1 + last2);
+
+    // Revisions of documents are typically almost identical,
+    // so we match common prefix and suffix first, and only the rest
+    // is processed by the algorithm.
+    size_t prefixLength = 0;
+    while (first1 + prefixLength < last1 && first2 + prefixLength < last2 && isEqual(first1 + prefixLength, first2 + prefixLength))
+    {
+        ++prefixLength;
+    }
+    addMatches(first1, first2, prefixLength);
+    first1 += prefixLength;
+    first2 += prefixLength;
+
+    size_t suffixLength = 0;
+    while (first1 < last1 - suffixLength && first2 < last2 - suffixLength && isEqual(last1 - suffixLength - 1, last2 - suffixLength - 1))
+    {
+        ++suffixLength;
+    }
+    last1 -= suffixLength;
+    last2 -= suffixLength;
+
+    const size_t size1 = last1 - first1 + 1;
+    const size_t size2 = last2 - first2 + 1;
+    if (size1 <= MAX_BACKTRACK_MATRIX_SIZE / size2)
+    {
+        performBacktrack(first1, last1, first2, last2);
+    }
+    else
+    {
+        performLinearSpace(first1, last1, first2, last2);
+    }
+
+    addMatches(last1, last2, suffixLength);
+
+    m_items1.clear();
+    m_items2.clear();
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::addMatches(size_t index1, size_t index2, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        SequenceItem item;
+        item.index1 = index1 + i;
+        item.index2 = index2 + i;
+        m_sequence.push_back(item);
+    }
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::addLeftItems(size_t first1, size_t last1)
+{
+    for (size_t i = first1; i < last1; ++i)
+    {
+        SequenceItem item;
+        item.index1 = i;
+        m_sequence.push_back(item);
+    }
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::addRightItems(size_t first2, size_t last2)
+{
+    for (size_t i = first2; i < last2; ++i)
+    {
+        SequenceItem item;
+        item.index2 = i;
+        m_sequence.push_back(item);
+    }
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::performBacktrack(size_t first1, size_t last1, size_t first2, size_t last2)
+{
+    const size_t size1 = last1 - first1 + 1;
+    const size_t size2 = last2 - first2 + 1;
+
+    std::vector<bool> backtrackData(size1 * size2, false);
 
-    std::vector<size_t> rowTop(m_size1, size_t());
-    std::vector<size_t> rowBottom(m_size1, size_t());
+    std::vector<size_t> rowTop(size1, size_t());
+    std::vector<size_t> rowBottom(size1, size_t());
 
     // Jakub Melka: we will have columns consisting of it1...it1End
     // and rows consisting of it2...it2End. We iterate trough rows,
     // and for each row, we update longest common subsequence data.
 
-    auto it2 = m_it2;
-    for (size_t i2 = 1; i2 < m_size2; ++i2, ++it2)
+    for (size_t i2 = 1; i2 < size2; ++i2)
     {
-        auto it1 = m_it1;
-        for (size_t i1 = 1; i1 < m_size1; ++i1, ++it1)
+        for (size_t i1 = 1; i1 < size1; ++i1)
         {
-            if (m_comparator(*it1, *it2))
+            if (isEqual(first1 + i1 - 1, first2 + i2 - 1))
             {
                 // We have match
                 rowBottom[i1] = rowTop[i1 - 1] + 1;
@@ -178,12 +286,12 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
                 if (isLeftBigger)
                 {
                     rowBottom[i1] = leftCellValue;
-                    m_backtrackData[i2 * m_size1 + i1] = true;
+                    backtrackData[i2 * size1 + i1] = true;
                 }
                 else
                 {
                     rowBottom[i1] = upperCellValue;
-                    m_backtrackData[i2 * m_size1 + i1] = false;
+                    backtrackData[i2 * size1 + i1] = false;
                 }
             }
         }
@@ -192,20 +300,19 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
         std::swap(rowTop, rowBottom);
     }
 
-    size_t i1 = m_size1 - 1;
-    size_t i2 = m_size2 - 1;
+    Sequence sequence;
+
+    size_t i1 = size1 - 1;
+    size_t i2 = size2 - 1;
 
     while (i1 > 0 && i2 > 0)
     {
         SequenceItem item;
 
-        const size_t index1 = i1 - 1;
-        const size_t index2 = i2 - 1;
-
-        auto cit1 = std::next(m_it1, index1);
-        auto cit2 = std::next(m_it2, index2);
+        const size_t index1 = first1 + i1 - 1;
+        const size_t index2 = first2 + i2 - 1;
 
-        if (m_comparator(*cit1, *cit2))
+        if (isEqual(index1, index2))
         {
             item.index1 = index1;
             item.index2 = index2;
@@ -215,7 +322,7 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
         }
         else
         {
-            if (m_backtrackData[i2 * m_size1 + i1])
+            if (backtrackData[i2 * size1 + i1])
             {
                 item.index1 = index1;
                 --i1;
@@ -227,32 +334,169 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
             }
         }
 
-        m_sequence.push_back(item);
+        sequence.push_back(item);
     }
 
     while (i1 > 0)
     {
         SequenceItem item;
 
-        const size_t index1 = i1 - 1;
+        const size_t index1 = first1 + i1 - 1;
         item.index1 = index1;
         --i1;
 
-        m_sequence.push_back(item);
+        sequence.push_back(item);
     }
 
     while (i2 > 0)
     {
         SequenceItem item;
 
-        const size_t index2 = i2 - 1;
+        const size_t index2 = first2 + i2 - 1;
         item.index2 = index2;
         --i2;
 
-        m_sequence.push_back(item);
+        sequence.push_back(item);
+    }
+
+    m_sequence.insert(m_sequence.end(), sequence.crbegin(), sequence.crend());
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::performLinearSpace(size_t first1, size_t last1, size_t first2, size_t last2)
+{
+    size_t prefixLength = 0;
+    while (first1 + prefixLength < last1 && first2 + prefixLength < last2 && isEqual(first1 + prefixLength, first2 + prefixLength))
+    {
+        ++prefixLength;
+    }
+    addMatches(first1, first2, prefixLength);
+    first1 += prefixLength;
+    first2 += prefixLength;
+
+    size_t suffixLength = 0;
+    while (first1 < last1 - suffixLength && first2 < last2 - suffixLength && isEqual(last1 - suffixLength - 1, last2 - suffixLength - 1))
+    {
+        ++suffixLength;
+    }
+    last1 -= suffixLength;
+    last2 -= suffixLength;
+
+    if (first1 == last1 || first2 == last2)
+    {
+        addLeftItems(first1, last1);
+        addRightItems(first2, last2);
+        addMatches(last1, last2, suffixLength);
+        return;
+    }
+
+    // Find middle snake, i.e. the diagonal, which lies in the middle
+    // of the shortest edit script (E. W. Myers, An O(ND) Difference Algorithm and
+    // Its Variations, 1986). Paths are searched in forward direction from the beginning
+    // and in backward direction from the end simultaneously, until they overlap.
+    // Because both ranges are nonempty and their first (last) items differ, edit
+    // script has at least two edits, so both subproblems are smaller.
+    using Index = std::ptrdiff_t;
+    const Index width = static_cast<Index>(last1 - first1);
+    const Index height = static_cast<Index>(last2 - first2);
+    const Index delta = width - height;
+    const bool isDeltaOdd = (delta % 2) != 0;
+    const Index maxD = (width + height + 1) / 2;
+    const Index offset = maxD + 1;
+
+    // Forward paths store furthest x for diagonal k = x - y, backward paths
+    // store smallest x for diagonal k (relative to the diagonal of the end, i.e. c = k - delta).
+    std::vector<Index> forward(2 * offset + 1, 0);
+    std::vector<Index> backward(2 * offset + 1, width);
+
+    Index snakeX1 = 0;
+    Index snakeY1 = 0;
+    Index snakeX2 = 0;
+    Index snakeY2 = 0;
+    bool isSnakeFound = false;
+
+    for (Index d = 0; d <= maxD && !isSnakeFound; ++d)
+    {
+        for (Index k = -d; k <= d; k += 2)
+        {
+            Index x = 0;
+            if (k == -d || (k != d && forward[offset + k - 1] < forward[offset + k + 1]))
+            {
+                x = forward[offset + k + 1];
+            }
+            else
+            {
+                x = forward[offset + k - 1] + 1;
+            }
+            Index y = x - k;
+
+            const Index startX = x;
+            const Index startY = y;
+            while (x < width && y < height && isEqual(first1 + x, first2 + y))
+            {
+                ++x;
+                ++y;
+            }
+            forward[offset + k] = x;
+
+            const Index c = k - delta;
+            if (isDeltaOdd && c >= -(d - 1) && c <= d - 1 && x >= backward[offset + c])
+            {
+                snakeX1 = startX;
+                snakeY1 = startY;
+                snakeX2 = x;
+                snakeY2 = y;
+                isSnakeFound = true;
+                break;
+            }
+        }
+
+        if (isSnakeFound)
+        {
+            break;
+        }
+
+        for (Index c = -d; c <= d; c += 2)
+        {
+            Index x = 0;
+            if (c == d || (c != -d && backward[offset + c + 1] > backward[offset + c - 1]))
+            {
+                x = backward[offset + c - 1];
+            }
+            else
+            {
+                x = backward[offset + c + 1] - 1;
+            }
+            const Index k = c + delta;
+            Index y = x - k;
+
+            const Index endX = x;
+            const Index endY = y;
+            while (x > 0 && y > 0 && isEqual(first1 + x - 1, first2 + y - 1))
+            {
+                --x;
+                --y;
+            }
+            backward[offset + c] = x;
+
+            if (!isDeltaOdd && k >= -d && k <= d && x <= forward[offset + k])
+            {
+                snakeX1 = x;
+                snakeY1 = y;
+                snakeX2 = endX;
+                snakeY2 = endY;
+                isSnakeFound = true;
+                break;
+            }
+        }
     }
 
-    std::reverse(m_sequence.begin(), m_sequence.end());
+    Q_ASSERT(isSnakeFound);
+
+    performLinearSpace(first1, first1 + snakeX1, first2, first2 + snakeY1);
+    addMatches(first1 + snakeX1, first2 + snakeY1, snakeX2 - snakeX1);
+    performLinearSpace(first1 + snakeX2, last1, first2 + snakeY2, last2);
+    addMatches(last1, last2, suffixLength);
 }
 
 }   // namespace pdf
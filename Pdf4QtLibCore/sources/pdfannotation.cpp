@@ -23,11 +23,13 @@
 #include "pdfpagecontentprocessor.h"
 #include "pdfparser.h"
 #include "pdfform.h"
+#include "pdfoptionalcontent.h"
 #include "pdfpainterutils.h"
 #include "pdfdocumentbuilder.h"
 
 #include <QtMath>
 #include <QIcon>
+#include <QElapsedTimer>
 
 #include "pdfdbgheap.h"
 
@@ -1297,7 +1299,10 @@ PDFAnnotationManager::PDFAnnotationManager(PDFFontCache* fontCache,
     m_features(features),
     m_target(target)
 {
-
+    if (m_optionalActivity)
+    {
+        connect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::clearCompiledAppearances, Qt::UniqueConnection);
+    }
 }
 
 PDFAnnotationManager::~PDFAnnotationManager()
@@ -1305,6 +1310,12 @@ PDFAnnotationManager::~PDFAnnotationManager()
 
 }
 
+struct PDFAnnotationManager::CompiledAppearance
+{
+    bool isContentVisible = false;
+    PDFPrecompiledPage compiledPage;
+};
+
 QTransform PDFAnnotationManager::prepareTransformations(const QTransform& pagePointToDevicePointMatrix,
                                                         QPaintDevice* device,
                                                         const PDFAnnotation::Flags annotationFlags,
@@ -1455,6 +1466,18 @@ void PDFAnnotationManager::drawPage(QPainter* painter,
         const PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
         m_fontCache->setCacheShrinkEnabled(&fontCacheLock, false);
 
+        {
+            // Compiled appearances have colors converted by the color management
+            // system, so they are no longer valid, if color management system changes.
+            QMutexLocker lock(&m_mutex);
+            if (m_compiledAppearancesCMS != cms)
+            {
+                m_compiledAppearances.clear();
+                m_compiledAppearancesMemory = 0;
+                m_compiledAppearancesCMS = cms;
+            }
+        }
+
         const PageAnnotation* annotationDrawnByEditor = nullptr;
         for (const PageAnnotation& annotation : annotations.annotations)
         {
@@ -1649,15 +1672,87 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     QTransform AA = formMatrix * A;
 
     bool isContentVisible = false;
+    const PDFObjectReference oc = annotation.annotation->getOptionalContent();
+
+    // Appearance streams of annotations, which are zoomed and rotated
+    // together with the page, are compiled in page space, so repaint is just a replay
+    // of the compiled appearance. Annotations with NoZoom/NoRotate flags depend on
+    // the target device, so they are always interpreted.
+    const PDFObjectReference annotationReference = annotation.annotation->getSelfReference();
+    const bool isCompiledAppearanceUsed = annotationReference.isValid() &&
+                                          !annotationFlags.testFlag(PDFAnnotation::NoZoom) &&
+                                          !annotationFlags.testFlag(PDFAnnotation::NoRotate);
+
+    if (isCompiledAppearanceUsed)
+    {
+        const CompiledAppearanceKey key(annotationReference, annotation.appearance, annotation.annotation->getAppearanceState(), features.toInt());
+        std::shared_ptr<const CompiledAppearance> compiledAppearance;
+
+        {
+            QMutexLocker lock(&m_mutex);
+            auto it = m_compiledAppearances.find(key);
+            if (it != m_compiledAppearances.cend())
+            {
+                compiledAppearance = it->second;
+            }
+        }
+
+        if (!compiledAppearance)
+        {
+            QElapsedTimer timer;
+            timer.start();
+
+            std::shared_ptr<CompiledAppearance> newCompiledAppearance = std::make_shared<CompiledAppearance>();
+            PDFPrecompiledPage* compiledPage = &newCompiledAppearance->compiledPage;
+
+            PDFPrecompiledPageGenerator generator(compiledPage, features, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
+            generator.initializeProcessor();
+
+            // We must check, that we do not display annotation disabled by optional content
+            newCompiledAppearance->isContentVisible = !oc.isValid() || !generator.isContentSuppressedByOC(oc);
+
+            if (newCompiledAppearance->isContentVisible)
+            {
+                generator.processForm(AA, formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+            }
+
+            PDFColorConvertor colorConvertor = cms->getColorConvertor();
+            PDFRenderer::applyFeaturesToColorConvertor(features, colorConvertor);
+            compiledPage->convertColors(colorConvertor);
+            compiledPage->optimize();
+            compiledPage->finalize(timer.nsecsElapsed(), QList<PDFRenderError>());
+
+            QMutexLocker lock(&m_mutex);
+            const qint64 memoryConsumption = compiledPage->getMemoryConsumptionEstimate();
+            if (m_compiledAppearancesMemory + memoryConsumption > COMPILED_APPEARANCES_MEMORY_LIMIT)
+            {
+                m_compiledAppearances.clear();
+                m_compiledAppearancesMemory = 0;
+            }
 
-    // Draw annotation
+            auto result = m_compiledAppearances.emplace(key, qMove(newCompiledAppearance));
+            if (result.second)
+            {
+                m_compiledAppearancesMemory += memoryConsumption;
+            }
+            compiledAppearance = result.first->second;
+        }
+
+        isContentVisible = compiledAppearance->isContentVisible;
+
+        if (isContentVisible)
+        {
+            PDFPainterStateGuard guard(painter);
+            compiledAppearance->compiledPage.draw(painter, page->getCropBox(), userSpaceToDeviceSpace, features, 1.0);
+        }
+    }
+    else
     {
         PDFPainterStateGuard guard(painter);
         PDFPainter pdfPainter(painter, features, userSpaceToDeviceSpace, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
         pdfPainter.initializeProcessor();
 
         // Jakub Melka: we must check, that we do not display annotation disabled by optional content
-        PDFObjectReference oc = annotation.annotation->getOptionalContent();
         isContentVisible = !oc.isValid() || !pdfPainter.isContentSuppressedByOC(oc);
 
         if (isContentVisible)
@@ -1684,10 +1779,21 @@ void PDFAnnotationManager::setDocument(const PDFModifiedDocument& document)
         m_document = document;
         m_optionalActivity = document.getOptionalContentActivity();
 
+        if (m_optionalActivity)
+        {
+            connect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::clearCompiledAppearances, Qt::UniqueConnection);
+        }
+
         if (document.hasReset() || document.hasFlag(PDFModifiedDocument::Annotation))
         {
             m_pageAnnotations.clear();
         }
+
+        // Form fields regenerate appearance streams of widget annotations
+        if (document.hasReset() || document.hasFlag(PDFModifiedDocument::Annotation) || document.hasFlag(PDFModifiedDocument::FormField))
+        {
+            clearCompiledAppearances();
+        }
     }
 }
 
@@ -1734,6 +1840,24 @@ PDFAnnotationManager::PageAnnotations& PDFAnnotationManager::getPageAnnotations(
             }
         }
 
+        std::vector<std::optional<QRectF>> rectangles;
+        rectangles.reserve(annotations.annotations.size());
+        for (const PageAnnotation& annotation : annotations.annotations)
+        {
+            // Rectangles of annotations, which are not zoomed or rotated with
+            // the page, depend on the page to device transformation.
+            const PDFAnnotation::Flags flags = annotation.annotation->getEffectiveFlags();
+            if (flags.testFlag(PDFAnnotation::NoZoom) || flags.testFlag(PDFAnnotation::NoRotate))
+            {
+                rectangles.emplace_back(std::nullopt);
+            }
+            else
+            {
+                rectangles.emplace_back(annotation.annotation->getRectangle());
+            }
+        }
+        annotations.spatialIndex.build(rectangles);
+
         it = m_pageAnnotations.insert(std::make_pair(pageIndex, qMove(annotations))).first;
     }
 
@@ -1797,6 +1921,7 @@ PDFMeshQualitySettings PDFAnnotationManager::getMeshQualitySettings() const
 void PDFAnnotationManager::setMeshQualitySettings(const PDFMeshQualitySettings& meshQualitySettings)
 {
     m_meshQualitySettings = meshQualitySettings;
+    clearCompiledAppearances();
 }
 
 PDFFontCache* PDFAnnotationManager::getFontCache() const
@@ -1807,6 +1932,7 @@ PDFFontCache* PDFAnnotationManager::getFontCache() const
 void PDFAnnotationManager::setFontCache(PDFFontCache* fontCache)
 {
     m_fontCache = fontCache;
+    clearCompiledAppearances();
 }
 
 const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() const
@@ -1817,6 +1943,19 @@ const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() co
 void PDFAnnotationManager::setOptionalActivity(const PDFOptionalContentActivity* optionalActivity)
 {
     m_optionalActivity = optionalActivity;
+    clearCompiledAppearances();
+
+    if (m_optionalActivity)
+    {
+        connect(m_optionalActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFAnnotationManager::clearCompiledAppearances, Qt::UniqueConnection);
+    }
+}
+
+void PDFAnnotationManager::clearCompiledAppearances()
+{
+    QMutexLocker lock(&m_mutex);
+    m_compiledAppearances.clear();
+    m_compiledAppearancesMemory = 0;
 }
 
 PDFAnnotationManager::Target PDFAnnotationManager::getTarget() const
@@ -35,6 +35,7 @@
 #include <QPainterPath>
 
 #include <array>
+#include <tuple>
 
 class QKeyEvent;
 class QMouseEvent;
@@ -1527,6 +1528,11 @@ public:
         std::vector<const PageAnnotation*> getReplies(const PageAnnotation& pageAnnotation) const;
 
         std::vector<PageAnnotation> annotations;
+
+        /// Spatial index of the annotations for hit testing, it is built together
+        /// with the annotations, so it is rebuilt only for the pages, whose
+        /// annotations were discarded.
+        PDFSpatialIndex spatialIndex;
     };
 
     /// Prepares annotation transformations for rendering
@@ -1623,6 +1629,9 @@ protected:
                                              const PDFCMS* cms,
                                              QPainter* painter) const;
 
+    /// Clears all compiled annotation appearances
+    void clearCompiledAppearances();
+
     const PDFDocument* m_document;
 
     PDFFontCache* m_fontCache;
@@ -1635,6 +1644,24 @@ protected:
     mutable QMutex m_mutex;
     mutable std::map<PDFInteger, PageAnnotations> m_pageAnnotations;
     Target m_target = Target::View;
+
+private:
+    /// Maximal memory consumption of compiled appearances. If it is exceeded,
+    /// then all compiled appearances are discarded and compiled again.
+    static constexpr qint64 COMPILED_APPEARANCES_MEMORY_LIMIT = 128 * 1024 * 1024;
+
+    struct CompiledAppearance;
+
+    /// Compiled appearances are identified by annotation, appearance,
+    /// appearance state and renderer features.
+    using CompiledAppearanceKey = std::tuple<PDFObjectReference, PDFAppeareanceStreams::Appearance, QByteArray, int>;
+
+    /// Appearance streams compiled to display lists (in page space),
+    /// so repaint of the annotation is just a replay of the display list.
+    /// Protected by main mutex.
+    mutable std::map<CompiledAppearanceKey, std::shared_ptr<const CompiledAppearance>> m_compiledAppearances;
+    mutable qint64 m_compiledAppearancesMemory = 0;
+    mutable PDFCMSPointer m_compiledAppearancesCMS;
 };
 
 }   // namespace pdf
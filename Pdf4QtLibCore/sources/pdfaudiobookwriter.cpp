@@ -0,0 +1,283 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfaudiobookwriter.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QWaitCondition>
+#include <QCryptographicHash>
+
+#include "pdfdbgheap.h"
+
+#include <limits>
+#include <memory>
+#include <optional>
+
+namespace pdf
+{
+
+PDFAudioBookWriter::PDFAudioBookWriter(AudioFormat format, QString cacheDirectory, QByteArray cacheKey) :
+    m_format(format),
+    m_cacheDirectory(qMove(cacheDirectory)),
+    m_cacheKey(qMove(cacheKey))
+{
+
+}
+
+void PDFAudioBookWriter::setWorkerFunctions(WorkerFunction startWorker, WorkerFunction finishWorker)
+{
+    m_startWorker = qMove(startWorker);
+    m_finishWorker = qMove(finishWorker);
+}
+
+PDFOperationResult PDFAudioBookWriter::write(const QString& fileName, const std::vector<QString>& segments, const SynthesizeFunction& synthesize) const
+{
+    m_cachedSegmentCount = 0;
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return PDFTranslationContext::tr("Cannot create output file '%1'.").arg(fileName);
+    }
+
+    // Size of the audio data is not known yet, header is written again at the end
+    file.write(getWaveHeader(0));
+
+    if (!m_cacheDirectory.isEmpty())
+    {
+        QDir().mkpath(m_cacheDirectory);
+    }
+
+    const size_t idealWorkerCount = m_workerCount > 0 ? m_workerCount : size_t(PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Unknown));
+    const size_t workerCount = qBound(size_t(1), idealWorkerCount, qMax(segments.size(), size_t(1)));
+    const size_t maxSegmentsInFlight = workerCount * SEGMENTS_IN_FLIGHT_PER_WORKER;
+
+    QMutex mutex;
+    QWaitCondition segmentFinished;
+    QWaitCondition segmentWritten;
+    std::vector<std::optional<QByteArray>> audioDataOfSegments(segments.size());
+    size_t nextSegment = 0;
+    size_t writtenSegmentCount = 0;
+    size_t cachedSegmentCount = 0;
+    bool isCancelled = false;
+    QString errorMessage;
+
+    auto cancel = [&](QString message)
+    {
+        QMutexLocker lock(&mutex);
+        isCancelled = true;
+        if (errorMessage.isEmpty())
+        {
+            errorMessage = qMove(message);
+        }
+        segmentFinished.wakeAll();
+        segmentWritten.wakeAll();
+    };
+
+    auto worker = [&](size_t workerIndex)
+    {
+        QString workerErrorMessage;
+        bool isOk = !m_startWorker || m_startWorker(workerIndex, workerErrorMessage);
+
+        while (isOk)
+        {
+            size_t index = 0;
+
+            {
+                QMutexLocker lock(&mutex);
+
+                // Do not synthesize too many segments ahead of the writer
+                while (!isCancelled && nextSegment < segments.size() && nextSegment >= writtenSegmentCount + maxSegmentsInFlight)
+                {
+                    segmentWritten.wait(&mutex);
+                }
+
+                if (isCancelled || nextSegment >= segments.size())
+                {
+                    break;
+                }
+
+                index = nextSegment++;
+            }
+
+            const QString& text = segments[index];
+            const QString cacheFileName = getCacheFileName(text);
+
+            QByteArray audioData;
+            bool isCached = false;
+
+            if (!cacheFileName.isEmpty())
+            {
+                QFile cacheFile(cacheFileName);
+                if (cacheFile.open(QFile::ReadOnly))
+                {
+                    audioData = cacheFile.readAll();
+                    isCached = true;
+                }
+            }
+
+            if (!isCached)
+            {
+                isOk = synthesize(workerIndex, text, audioData, workerErrorMessage);
+
+                if (isOk && !cacheFileName.isEmpty())
+                {
+                    // Cache file is written atomically, so other instances
+                    // never read partially written segment.
+                    QSaveFile cacheFile(cacheFileName);
+                    if (cacheFile.open(QFile::WriteOnly))
+                    {
+                        cacheFile.write(audioData);
+                        cacheFile.commit();
+                    }
+                }
+            }
+
+            if (isOk)
+            {
+                QMutexLocker lock(&mutex);
+                audioDataOfSegments[index] = qMove(audioData);
+                cachedSegmentCount += isCached ? 1 : 0;
+                segmentFinished.wakeAll();
+            }
+        }
+
+        if (m_finishWorker)
+        {
+            QString finishErrorMessage;
+            m_finishWorker(workerIndex, finishErrorMessage);
+        }
+
+        if (!isOk)
+        {
+            cancel(workerErrorMessage);
+        }
+    };
+
+    std::vector<std::unique_ptr<QThread>> threads;
+    threads.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        threads.emplace_back(QThread::create(worker, i));
+        threads.back()->start();
+    }
+
+    // Write segments in order, as soon as they are synthesized
+    quint64 dataSize = 0;
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        QByteArray audioData;
+
+        {
+            QMutexLocker lock(&mutex);
+            while (!isCancelled && !audioDataOfSegments[i])
+            {
+                segmentFinished.wait(&mutex);
+            }
+
+            if (isCancelled)
+            {
+                break;
+            }
+
+            audioData = qMove(*audioDataOfSegments[i]);
+            audioDataOfSegments[i].reset();
+            writtenSegmentCount = i + 1;
+            segmentWritten.wakeAll();
+        }
+
+        if (file.write(audioData) != audioData.size())
+        {
+            cancel(PDFTranslationContext::tr("Cannot write output file '%1'.").arg(fileName));
+            break;
+        }
+
+        dataSize += audioData.size();
+    }
+
+    for (const auto& thread : threads)
+    {
+        thread->wait();
+    }
+
+    m_cachedSegmentCount = cachedSegmentCount;
+
+    if (isCancelled)
+    {
+        return errorMessage;
+    }
+
+    if (dataSize > std::numeric_limits<quint32>::max() - 36)
+    {
+        return PDFTranslationContext::tr("Audio data are too large for WAV file.");
+    }
+
+    file.seek(0);
+    file.write(getWaveHeader(quint32(dataSize)));
+    file.close();
+    return true;
+}
+
+QString PDFAudioBookWriter::getCacheFileName(const QString& text) const
+{
+    if (m_cacheDirectory.isEmpty())
+    {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(m_cacheKey);
+    hash.addData(QByteArray::number(m_format.sampleRate));
+    hash.addData(QByteArray::number(m_format.channelCount));
+    hash.addData(QByteArray::number(m_format.bitsPerSample));
+    hash.addData(text.toUtf8());
+    return QDir(m_cacheDirectory).filePath(QString::fromLatin1(hash.result().toHex()) + ".pcm");
+}
+
+QByteArray PDFAudioBookWriter::getWaveHeader(quint32 dataSize) const
+{
+    const quint16 blockAlign = quint16(m_format.channelCount * m_format.bitsPerSample / 8);
+    const quint32 byteRate = quint32(m_format.sampleRate) * blockAlign;
+
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream.writeRawData("RIFF", 4);
+    stream << quint32(36 + dataSize);
+    stream.writeRawData("WAVE", 4);
+    stream.writeRawData("fmt ", 4);
+    stream << quint32(16);
+    stream << quint16(1); // PCM
+    stream << quint16(m_format.channelCount);
+    stream << quint32(m_format.sampleRate);
+    stream << byteRate;
+    stream << blockAlign;
+    stream << quint16(m_format.bitsPerSample);
+    stream.writeRawData("data", 4);
+    stream << dataSize;
+
+    return header;
+}
+
+}   // namespace pdf
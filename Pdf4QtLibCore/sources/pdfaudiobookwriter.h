@@ -0,0 +1,108 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFAUDIOBOOKWRITER_H
+#define PDFAUDIOBOOKWRITER_H
+
+#include "pdfglobal.h"
+#include "pdfutils.h"
+
+#include <QString>
+#include <QByteArray>
+
+#include <vector>
+#include <functional>
+
+namespace pdf
+{
+
+/// Writes audio book from text segments (for example, paragraphs or structure
+/// items of the text flow). Segments are synthesized in parallel by worker threads,
+/// each worker can use its own speech engine instance. Synthesized segments are
+/// written in order to the output WAV file as soon as they are available, so only
+/// a limited count of synthesized segments is held in the memory. Synthesized
+/// segments can be stored in the persistent cache, so when text of the segment
+/// is edited, only this segment is synthesized again.
+class PDF4QTLIBCORESHARED_EXPORT PDFAudioBookWriter
+{
+public:
+
+    /// Format of the raw PCM audio data produced by the speech engine
+    struct AudioFormat
+    {
+        int sampleRate = 22050;
+        int channelCount = 1;
+        int bitsPerSample = 16;
+    };
+
+    /// Synthesizes text of the segment to raw PCM audio data. It is called
+    /// from worker threads, worker index is passed, so each worker can use
+    /// its own speech engine instance. Returns false and sets error message,
+    /// if text can't be synthesized.
+    using SynthesizeFunction = std::function<bool(size_t workerIndex, const QString& text, QByteArray& audioData, QString& errorMessage)>;
+
+    /// Function called in the worker thread, when worker is started or finished
+    /// (it can be used, for example, to initialize or free the speech engine).
+    /// Returns false and sets error message, if worker can't be initialized.
+    using WorkerFunction = std::function<bool(size_t workerIndex, QString& errorMessage)>;
+
+    /// Creates audio book writer
+    /// \param format Format of the audio data
+    /// \param cacheDirectory Directory of the persistent segment cache (empty, if cache is not used)
+    /// \param cacheKey Key of the speech settings (voice, rate, ...), segments with different keys are cached separately
+    explicit PDFAudioBookWriter(AudioFormat format, QString cacheDirectory, QByteArray cacheKey);
+
+    /// Sets count of workers (speech engine instances), zero means ideal thread count
+    void setWorkerCount(size_t workerCount) { m_workerCount = workerCount; }
+
+    /// Sets functions called in the worker thread, when worker is started or finished
+    void setWorkerFunctions(WorkerFunction startWorker, WorkerFunction finishWorker);
+
+    /// Synthesizes the segments and writes them to the WAV file
+    /// \param fileName Output file name
+    /// \param segments Text segments
+    /// \param synthesize Synthesize function
+    PDFOperationResult write(const QString& fileName, const std::vector<QString>& segments, const SynthesizeFunction& synthesize) const;
+
+    /// Returns count of segments read from the cache during last write
+    size_t getCachedSegmentCount() const { return m_cachedSegmentCount; }
+
+private:
+    /// Maximal count of synthesized segments waiting for writing per worker
+    static constexpr size_t SEGMENTS_IN_FLIGHT_PER_WORKER = 4;
+
+    /// Returns file name of the segment in the persistent cache,
+    /// or empty string, if cache is not used.
+    /// \param text Text of the segment
+    QString getCacheFileName(const QString& text) const;
+
+    /// Returns WAV file header
+    /// \param dataSize Size of the audio data
+    QByteArray getWaveHeader(quint32 dataSize) const;
+
+    AudioFormat m_format;
+    QString m_cacheDirectory;
+    QByteArray m_cacheKey;
+    size_t m_workerCount = 0;
+    WorkerFunction m_startWorker;
+    WorkerFunction m_finishWorker;
+    mutable size_t m_cachedSegmentCount = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFAUDIOBOOKWRITER_H
@@ -16,6 +16,7 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdfblendfunction.h"
+#include "pdfsimd.h"
 #include "pdfdbgheap.h"
 
 #include <algorithm>
@@ -389,6 +390,277 @@ PDFColorComponent PDFBlendFunction::blend(BlendMode mode, PDFColorComponent Cb,
     return Cs;
 }
 
+/// SIMD kernels for blending rows of colors. Kernels exist only for
+/// separable blend modes, which can be computed without division.
+class PDFBlendRowKernels
+{
+public:
+    /// Blends colors using SIMD instructions. Returns count of blended
+    /// colors, remaining colors must be blended by scalar code.
+    static size_t blend(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count);
+
+private:
+#if defined(PDF4QT_SIMD_SSE2)
+    static __m128 multiplySSE2(__m128 b, __m128 s) { return _mm_mul_ps(b, s); }
+    static __m128 screenSSE2(__m128 b, __m128 s) { return _mm_sub_ps(_mm_add_ps(b, s), _mm_mul_ps(b, s)); }
+    static __m128 darkenSSE2(__m128 b, __m128 s) { return _mm_min_ps(b, s); }
+    static __m128 lightenSSE2(__m128 b, __m128 s) { return _mm_max_ps(b, s); }
+    static __m128 differenceSSE2(__m128 b, __m128 s) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(b, s)); }
+    static __m128 exclusionSSE2(__m128 b, __m128 s) { return _mm_sub_ps(_mm_add_ps(b, s), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), b), s)); }
+    static __m128 hardLightSSE2(__m128 b, __m128 s)
+    {
+        const __m128 s2 = _mm_add_ps(s, s);
+        const __m128 s2m1 = _mm_sub_ps(s2, _mm_set1_ps(1.0f));
+        const __m128 mask = _mm_cmple_ps(s, _mm_set1_ps(0.5f));
+        return _mm_or_ps(_mm_and_ps(mask, multiplySSE2(b, s2)), _mm_andnot_ps(mask, screenSSE2(b, s2m1)));
+    }
+
+    template<__m128(*Function)(__m128, __m128)>
+    static size_t blendSSE2(const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_storeu_ps(result + i, Function(_mm_loadu_ps(Cb + i), _mm_loadu_ps(Cs + i)));
+        }
+        return i;
+    }
+
+    static size_t blendSSE2(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 multiplyAVX2(__m256 b, __m256 s) { return _mm256_mul_ps(b, s); }
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 screenAVX2(__m256 b, __m256 s) { return _mm256_sub_ps(_mm256_add_ps(b, s), _mm256_mul_ps(b, s)); }
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 darkenAVX2(__m256 b, __m256 s) { return _mm256_min_ps(b, s); }
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 lightenAVX2(__m256 b, __m256 s) { return _mm256_max_ps(b, s); }
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 differenceAVX2(__m256 b, __m256 s) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(b, s)); }
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 exclusionAVX2(__m256 b, __m256 s) { return _mm256_sub_ps(_mm256_add_ps(b, s), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), b), s)); }
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256 hardLightAVX2(__m256 b, __m256 s)
+    {
+        const __m256 s2 = _mm256_add_ps(s, s);
+        const __m256 s2m1 = _mm256_sub_ps(s2, _mm256_set1_ps(1.0f));
+        const __m256 mask = _mm256_cmp_ps(s, _mm256_set1_ps(0.5f), _CMP_LE_OQ);
+        return _mm256_blendv_ps(screenAVX2(b, s2m1), multiplyAVX2(b, s2), mask);
+    }
+
+    template<__m256(*Function)(__m256, __m256)>
+    PDF4QT_SIMD_AVX2_FUNCTION static size_t blendAVX2(const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_ps(result + i, Function(_mm256_loadu_ps(Cb + i), _mm256_loadu_ps(Cs + i)));
+        }
+        return i;
+    }
+
+    PDF4QT_SIMD_AVX2_FUNCTION static size_t blendAVX2(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static float32x4_t multiplyNEON(float32x4_t b, float32x4_t s) { return vmulq_f32(b, s); }
+    static float32x4_t screenNEON(float32x4_t b, float32x4_t s) { return vsubq_f32(vaddq_f32(b, s), vmulq_f32(b, s)); }
+    static float32x4_t darkenNEON(float32x4_t b, float32x4_t s) { return vminq_f32(b, s); }
+    static float32x4_t lightenNEON(float32x4_t b, float32x4_t s) { return vmaxq_f32(b, s); }
+    static float32x4_t differenceNEON(float32x4_t b, float32x4_t s) { return vabdq_f32(b, s); }
+    static float32x4_t exclusionNEON(float32x4_t b, float32x4_t s) { return vsubq_f32(vaddq_f32(b, s), vmulq_f32(vmulq_f32(vdupq_n_f32(2.0f), b), s)); }
+    static float32x4_t hardLightNEON(float32x4_t b, float32x4_t s)
+    {
+        const float32x4_t s2 = vaddq_f32(s, s);
+        const float32x4_t s2m1 = vsubq_f32(s2, vdupq_n_f32(1.0f));
+        const uint32x4_t mask = vcleq_f32(s, vdupq_n_f32(0.5f));
+        return vbslq_f32(mask, multiplyNEON(b, s2), screenNEON(b, s2m1));
+    }
+
+    template<float32x4_t(*Function)(float32x4_t, float32x4_t)>
+    static size_t blendNEON(const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            vst1q_f32(result + i, Function(vld1q_f32(Cb + i), vld1q_f32(Cs + i)));
+        }
+        return i;
+    }
+
+    static size_t blendNEON(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count);
+#endif
+};
+
+size_t PDFBlendRowKernels::blend(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+{
+    const PDFSimd::InstructionSet instructionSet = PDFSimd::getInstructionSet();
+    if (instructionSet == PDFSimd::InstructionSet::Scalar)
+    {
+        return 0;
+    }
+
+#if defined(PDF4QT_SIMD_AVX2)
+    if (instructionSet == PDFSimd::InstructionSet::AVX2)
+    {
+        return blendAVX2(mode, Cb, Cs, result, count);
+    }
+#endif
+
+#if defined(PDF4QT_SIMD_SSE2)
+    return blendSSE2(mode, Cb, Cs, result, count);
+#elif defined(PDF4QT_SIMD_NEON)
+    return blendNEON(mode, Cb, Cs, result, count);
+#else
+    Q_UNUSED(mode);
+    Q_UNUSED(Cb);
+    Q_UNUSED(Cs);
+    Q_UNUSED(result);
+    Q_UNUSED(count);
+    return 0;
+#endif
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+size_t PDFBlendRowKernels::blendSSE2(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+{
+    switch (mode)
+    {
+        case BlendMode::Multiply:
+            return blendSSE2<multiplySSE2>(Cb, Cs, result, count);
+
+        case BlendMode::Screen:
+            return blendSSE2<screenSSE2>(Cb, Cs, result, count);
+
+        case BlendMode::Overlay:
+            return blendSSE2<hardLightSSE2>(Cs, Cb, result, count);
+
+        case BlendMode::Darken:
+            return blendSSE2<darkenSSE2>(Cb, Cs, result, count);
+
+        case BlendMode::Lighten:
+            return blendSSE2<lightenSSE2>(Cb, Cs, result, count);
+
+        case BlendMode::HardLight:
+            return blendSSE2<hardLightSSE2>(Cb, Cs, result, count);
+
+        case BlendMode::Difference:
+            return blendSSE2<differenceSSE2>(Cb, Cs, result, count);
+
+        case BlendMode::Exclusion:
+            return blendSSE2<exclusionSSE2>(Cb, Cs, result, count);
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+PDF4QT_SIMD_AVX2_FUNCTION size_t PDFBlendRowKernels::blendAVX2(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+{
+    switch (mode)
+    {
+        case BlendMode::Multiply:
+            return blendAVX2<multiplyAVX2>(Cb, Cs, result, count);
+
+        case BlendMode::Screen:
+            return blendAVX2<screenAVX2>(Cb, Cs, result, count);
+
+        case BlendMode::Overlay:
+            return blendAVX2<hardLightAVX2>(Cs, Cb, result, count);
+
+        case BlendMode::Darken:
+            return blendAVX2<darkenAVX2>(Cb, Cs, result, count);
+
+        case BlendMode::Lighten:
+            return blendAVX2<lightenAVX2>(Cb, Cs, result, count);
+
+        case BlendMode::HardLight:
+            return blendAVX2<hardLightAVX2>(Cb, Cs, result, count);
+
+        case BlendMode::Difference:
+            return blendAVX2<differenceAVX2>(Cb, Cs, result, count);
+
+        case BlendMode::Exclusion:
+            return blendAVX2<exclusionAVX2>(Cb, Cs, result, count);
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+size_t PDFBlendRowKernels::blendNEON(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+{
+    switch (mode)
+    {
+        case BlendMode::Multiply:
+            return blendNEON<multiplyNEON>(Cb, Cs, result, count);
+
+        case BlendMode::Screen:
+            return blendNEON<screenNEON>(Cb, Cs, result, count);
+
+        case BlendMode::Overlay:
+            return blendNEON<hardLightNEON>(Cs, Cb, result, count);
+
+        case BlendMode::Darken:
+            return blendNEON<darkenNEON>(Cb, Cs, result, count);
+
+        case BlendMode::Lighten:
+            return blendNEON<lightenNEON>(Cb, Cs, result, count);
+
+        case BlendMode::HardLight:
+            return blendNEON<hardLightNEON>(Cb, Cs, result, count);
+
+        case BlendMode::Difference:
+            return blendNEON<differenceNEON>(Cb, Cs, result, count);
+
+        case BlendMode::Exclusion:
+            return blendNEON<exclusionNEON>(Cb, Cs, result, count);
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+#endif
+
+void PDFBlendFunction::blendRow(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count)
+{
+    switch (mode)
+    {
+        case BlendMode::Normal:
+        case BlendMode::Compatible:
+        {
+            if (result != Cs)
+            {
+                std::copy(Cs, Cs + count, result);
+            }
+            return;
+        }
+
+        case BlendMode::Overprint_SelectBackdrop:
+        {
+            if (result != Cb)
+            {
+                std::copy(Cb, Cb + count, result);
+            }
+            return;
+        }
+
+        default:
+            break;
+    }
+
+    for (size_t i = PDFBlendRowKernels::blend(mode, Cb, Cs, result, count); i < count; ++i)
+    {
+        result[i] = blend(mode, Cb[i], Cs[i]);
+    }
+}
+
 PDFRGB PDFBlendFunction::blend_Hue(PDFRGB Cb, PDFRGB Cs)
 {
     return nonseparable_SetLum(nonseparable_SetSat(Cs, nonseparable_Sat(Cb)), nonseparable_Lum(Cb));
@@ -114,6 +114,16 @@ public:
     /// \param Cs Source color
     static PDFColorComponent blend(BlendMode mode, PDFColorComponent Cb, PDFColorComponent Cs);
 
+    /// Blends row of colors using separable blend mode. Result is the same
+    /// as calling \p blend for each color, but SIMD instructions are used,
+    /// if available. Result buffer can be the same as backdrop or source buffer.
+    /// \param mode Separable blend mode
+    /// \param Cb Backdrop colors
+    /// \param Cs Source colors
+    /// \param result Blended colors
+    /// \param count Color count
+    static void blendRow(BlendMode mode, const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* result, size_t count);
+
     /// Blend non-separable hue function
     /// \param Cb Backdrop color
     /// \param Cs Source color
@@ -17,8 +17,10 @@
 
 #include "pdfblpainter.h"
 #include "pdffont.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QThread>
+#include <QPainter>
 #include <QRawFont>
 #include <QPainterPath>
 #include <QPaintEngine>
@@ -30,6 +32,8 @@
 #include <blend2d.h>
 #endif
 
+#include <map>
+
 namespace pdf
 {
 
@@ -58,6 +62,13 @@ public:
     virtual void drawImage(const QRectF& r, const QImage& pm, const QRectF& sr, Qt::ImageConversionFlags flags) override;
     virtual Type type() const override;
 
+    /// Fills text glyphs, see PDFBLPaintDevice::drawGlyphRun
+    void drawGlyphRun(quint64 fontId,
+                      const QTransform& matrix,
+                      const std::vector<QPointF>& positions,
+                      const std::vector<CID>& cids,
+                      const std::vector<QPainterPath>& outlines);
+
     static PaintEngineFeatures getStaticFeatures();
 
 private:
@@ -91,6 +102,10 @@ private:
 
     void drawPathImpl(const QPainterPath& path, bool enableStroke, bool enableFill, bool forceFill = false);
 
+    /// Returns Blend2D path of the glyph outline. Paths are converted only
+    /// once for each glyph, if font id is valid (nonzero).
+    const BLPath& getBLGlyphPath(quint64 fontId, CID cid, const QPainterPath& outline);
+
     void setFillRule(Qt::FillRule fillRule);
     void updateFont(QFont newFont);
     void setPathFillMode(PolygonDrawMode mode, QPainterPath& path);
@@ -113,9 +128,14 @@ private:
     ClipMode resolveClipping(const QRectF& rect) const;
     ClipMode resolveClipping(const QPainterPath& path) const;
 
+    /// Maximal count of cached glyph paths. Paint device can be used
+    /// to paint many pages, so the cache is cleared, when it is full.
+    static constexpr size_t MAX_CACHED_GLYPH_PATHS = 65536;
+
     QImage& m_qtOffscreenBuffer;
     std::optional<BLContext> m_blContext;
     std::optional<BLImage> m_blOffscreenBuffer;
+    std::optional<PDFThreadBudgetReservation> m_threadReservation;
     bool m_isMultithreaded;
 
     QPen m_currentPen;
@@ -128,6 +148,9 @@ private:
     bool m_clipSingleRect = false;
     std::optional<QPainterPath> m_finalClipPath;
     QRectF m_finalClipPathBoundingBox;
+
+    std::map<std::pair<quint64, CID>, BLPath> m_glyphPaths;
+    BLPath m_uncachedGlyphPath;
 };
 
 PDFBLPaintDevice::PDFBLPaintDevice(QImage& offscreenBuffer, bool isMultithreaded) :
@@ -158,6 +181,21 @@ uint32_t PDFBLPaintDevice::getVersion()
     return BL_VERSION;
 }
 
+void PDFBLPaintDevice::drawGlyphRun(QPainter* painter,
+                                    quint64 fontId,
+                                    const QTransform& matrix,
+                                    const std::vector<QPointF>& positions,
+                                    const std::vector<unsigned int>& cids,
+                                    const std::vector<QPainterPath>& outlines)
+{
+    Q_ASSERT(painter->device() == this);
+
+    // Painter state (brush, transformation, clipping) must be
+    // propagated to the engine, because we bypass the painter.
+    m_paintEngine->syncState();
+    m_paintEngine->drawGlyphRun(fontId, matrix, positions, cids, outlines);
+}
+
 int PDFBLPaintDevice::metric(PaintDeviceMetric metric) const
 {
     switch (metric)
@@ -209,6 +247,11 @@ bool PDFBLPaintEngine::begin(QPaintDevice*)
         return false;
     }
 
+    if (m_glyphPaths.size() > MAX_CACHED_GLYPH_PATHS)
+    {
+        m_glyphPaths.clear();
+    }
+
     m_blContext.emplace();
     m_blOffscreenBuffer.emplace();
 
@@ -216,8 +259,16 @@ bool PDFBLPaintEngine::begin(QPaintDevice*)
 
     if (m_isMultithreaded)
     {
-        info.flags = BL_CONTEXT_CREATE_FLAG_FALLBACK_TO_SYNC;
-        info.threadCount = QThread::idealThreadCount();
+        // Blend2D worker threads are taken from the global thread budget, so when
+        // pages are rendered in parallel, threads are not oversubscribed.
+        m_threadReservation.emplace(QThread::idealThreadCount());
+        const int threadCount = m_threadReservation->getThreadCount();
+
+        if (threadCount > 1)
+        {
+            info.flags = BL_CONTEXT_CREATE_FLAG_FALLBACK_TO_SYNC;
+            info.threadCount = threadCount;
+        }
     }
 
     m_blContext->setHint(BL_CONTEXT_HINT_RENDERING_QUALITY, BL_RENDERING_QUALITY_MAX_VALUE);
@@ -240,6 +291,7 @@ bool PDFBLPaintEngine::begin(QPaintDevice*)
     {
         m_blContext.reset();
         m_blOffscreenBuffer.reset();
+        m_threadReservation.reset();
     }
 
     return false;
@@ -255,6 +307,7 @@ bool PDFBLPaintEngine::end()
     m_blContext->end();
     m_blContext.reset();
     m_blOffscreenBuffer.reset();
+    m_threadReservation.reset();
     return true;
 }
 
@@ -551,8 +604,9 @@ void PDFBLPaintEngine::drawPath(const QPainterPath& path)
 
 void PDFBLPaintEngine::drawPathImpl(const QPainterPath& path, bool enableStroke, bool enableFill, bool forceFill)
 {
-    QPainterPath transformedPath = m_currentTransform.map(path);
-    ClipMode clipMode = resolveClipping(transformedPath);
+    // Path is transformed only, if it must be clipped, bounding
+    // rectangle is sufficient to resolve clipping mode.
+    ClipMode clipMode = resolveClipping(m_currentTransform.mapRect(path.controlPointRect()));
 
     setFillRule(path.fillRule());
 
@@ -575,6 +629,7 @@ void PDFBLPaintEngine::drawPathImpl(const QPainterPath& path, bool enableStroke,
 
             if ((isFillActive() && enableFill) || forceFill)
             {
+                QPainterPath transformedPath = m_currentTransform.map(path);
                 QPainterPath fillPath = transformedPath.intersected(m_finalClipPath.value());
 
                 if (!fillPath.isEmpty())
@@ -620,6 +675,69 @@ void PDFBLPaintEngine::drawPathImpl(const QPainterPath& path, bool enableStroke,
     }
 }
 
+void PDFBLPaintEngine::drawGlyphRun(quint64 fontId,
+                                    const QTransform& matrix,
+                                    const std::vector<QPointF>& positions,
+                                    const std::vector<CID>& cids,
+                                    const std::vector<QPainterPath>& outlines)
+{
+    if (!isFillActive())
+    {
+        return;
+    }
+
+    const QTransform worldMatrix = m_currentTransform;
+
+    for (size_t i = 0; i < outlines.size(); ++i)
+    {
+        const QPainterPath& outline = outlines[i];
+        const QTransform glyphMatrix = matrix * QTransform::fromTranslate(positions[i].x(), positions[i].y()) * worldMatrix;
+
+        switch (resolveClipping(glyphMatrix.mapRect(outline.controlPointRect())))
+        {
+            case ClipMode::NoClip:
+            {
+                setFillRule(outline.fillRule());
+                m_blContext->setMatrix(getBLMatrix(glyphMatrix));
+                m_blContext->fillPath(getBLGlyphPath(fontId, cids[i], outline));
+                break;
+            }
+
+            case ClipMode::NotVisible:
+                break;
+
+            case ClipMode::NeedsResolve:
+            {
+                // Glyph must be clipped using the path, paint it as ordinary path
+                m_currentTransform = glyphMatrix;
+                m_blContext->setMatrix(getBLMatrix(glyphMatrix));
+                drawPathImpl(outline, false, true);
+                m_currentTransform = worldMatrix;
+                break;
+            }
+        }
+    }
+
+    m_blContext->setMatrix(getBLMatrix(worldMatrix));
+}
+
+const BLPath& PDFBLPaintEngine::getBLGlyphPath(quint64 fontId, CID cid, const QPainterPath& outline)
+{
+    if (fontId == 0)
+    {
+        m_uncachedGlyphPath = getBLPath(outline);
+        return m_uncachedGlyphPath;
+    }
+
+    auto it = m_glyphPaths.find(std::make_pair(fontId, cid));
+    if (it == m_glyphPaths.cend())
+    {
+        it = m_glyphPaths.emplace(std::make_pair(fontId, cid), getBLPath(outline)).first;
+    }
+
+    return it->second;
+}
+
 void PDFBLPaintEngine::drawPoints(const QPointF* points, int pointCount)
 {
     m_blContext->save();
@@ -826,32 +944,46 @@ BLPath PDFBLPaintEngine::getBLPath(const QPainterPath& path)
 {
     BLPath blPath;
 
-    int elementCount = path.elementCount();
-    for (int i = 0; i < elementCount; ++i) {
+    const int elementCount = path.elementCount();
+    if (elementCount == 0)
+    {
+        return blPath;
+    }
+
+    // Both QPainterPath and BLPath store paths as flat arrays of points,
+    // and cubic curve is stored as three consecutive points in both formats. So
+    // we allocate the path storage at once and copy the points directly, instead
+    // of building the path command by command.
+    uint8_t* commands = nullptr;
+    BLPoint* vertices = nullptr;
+    if (blPath.modifyOp(BL_MODIFY_OP_ASSIGN_FIT, size_t(elementCount), &commands, &vertices) != BL_SUCCESS)
+    {
+        return BLPath();
+    }
+
+    for (int i = 0; i < elementCount; ++i)
+    {
         const QPainterPath::Element& element = path.elementAt(i);
+        vertices[i].reset(element.x, element.y);
 
         switch (element.type)
         {
         case QPainterPath::MoveToElement:
-            blPath.moveTo(element.x, element.y);
+            commands[i] = BL_PATH_CMD_MOVE;
             break;
 
         case QPainterPath::LineToElement:
-            blPath.lineTo(element.x, element.y);
+            commands[i] = BL_PATH_CMD_ON;
             break;
 
         case QPainterPath::CurveToElement:
-            if (i + 2 < elementCount)
-            {
-                const QPainterPath::Element& ctrlPoint1 = path.elementAt(i++);
-                const QPainterPath::Element& ctrlPoint2 = path.elementAt(i++);
-                const QPainterPath::Element& endPoint = path.elementAt(i);
-                blPath.cubicTo(ctrlPoint1.x, ctrlPoint1.y, ctrlPoint2.x, ctrlPoint2.y, endPoint.x, endPoint.y);
-            }
+            commands[i] = BL_PATH_CMD_CUBIC;
             break;
 
         case QPainterPath::CurveToDataElement:
-            Q_ASSERT(false);
+            // Second control point of the curve is followed by the end point
+            Q_ASSERT(i > 0);
+            commands[i] = (path.elementAt(i - 1).type == QPainterPath::CurveToElement) ? BL_PATH_CMD_CUBIC : BL_PATH_CMD_ON;
             break;
         }
     }
@@ -1002,6 +1134,7 @@ void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
                 blLinearGradient.y1 = linearGradient->finalStop().y();
                 BLGradient blGradient(blLinearGradient);
                 setGradientStops(blGradient, *gradient);
+                blGradient.setMatrix(getBLMatrix(brush.transform()));
                 context.setFillStyle(blGradient);
             }
             break;
@@ -1020,10 +1153,30 @@ void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
                 blRadialGradientValues.r0 = radialGradient->radius();
                 BLGradient blGradient(blRadialGradientValues);
                 setGradientStops(blGradient, *gradient);
+                blGradient.setMatrix(getBLMatrix(brush.transform()));
                 context.setFillStyle(blGradient);
             }
             break;
         }
+        case Qt::TexturePattern:
+        {
+            QImage image = brush.textureImage();
+
+            if (image.format() != QImage::Format_ARGB32_Premultiplied)
+            {
+                image.convertTo(QImage::Format_ARGB32_Premultiplied);
+            }
+
+            BLImage blImage;
+            blImage.createFromData(image.width(), image.height(), BL_FORMAT_PRGB32, image.bits(), image.bytesPerLine());
+
+            BLImage blPatternImage;
+            blPatternImage.assignDeep(blImage);
+
+            BLPattern blPattern(blPatternImage, BL_EXTEND_MODE_REPEAT, getBLMatrix(brush.transform()));
+            context.setFillStyle(blPattern);
+            break;
+        }
     }
 }
 
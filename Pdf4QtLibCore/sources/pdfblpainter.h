@@ -23,6 +23,11 @@
 #include <QImage>
 #include <QPaintDevice>
 
+#include <vector>
+
+class QPainter;
+class QPainterPath;
+
 namespace pdf
 {
 class PDFBLPaintEngine;
@@ -38,6 +43,24 @@ public:
 
     static uint32_t getVersion();
 
+    /// Fills run of text glyphs using the current brush and transformation
+    /// of the painter. Glyph outlines are converted to Blend2D paths only
+    /// once, converted paths are cached by the font id and the glyph id,
+    /// as long as the paint device exists. Paint device can be reused
+    /// for painting of multiple pages to share the cached paths.
+    /// \param painter Painter, which is painting on this device
+    /// \param fontId Unique id of the realized font (zero disables the cache)
+    /// \param matrix Glyph matrix (transformation from text space to user space) without translation
+    /// \param positions Glyph positions in user space
+    /// \param cids Character ids of the glyphs
+    /// \param outlines Glyph outlines in text space
+    void drawGlyphRun(QPainter* painter,
+                      quint64 fontId,
+                      const QTransform& matrix,
+                      const std::vector<QPointF>& positions,
+                      const std::vector<unsigned int>& cids,
+                      const std::vector<QPainterPath>& outlines);
+
 protected:
     virtual int metric(PaintDeviceMetric metric) const override;
 
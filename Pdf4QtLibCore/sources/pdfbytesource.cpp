@@ -0,0 +1,153 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfbytesource.h"
+#include "pdfexception.h"
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFFileByteSource::PDFFileByteSource(const QString& fileName) :
+    m_file(fileName)
+{
+
+}
+
+bool PDFFileByteSource::open()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_file.isOpen() || m_file.open(QFile::ReadOnly);
+}
+
+qint64 PDFFileByteSource::getSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_file.isOpen() ? m_file.size() : -1;
+}
+
+bool PDFFileByteSource::read(qint64 offset, qint64 length, char* data)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (!m_file.isOpen() || !m_file.seek(offset))
+    {
+        return false;
+    }
+
+    return m_file.read(data, length) == length;
+}
+
+QString PDFFileByteSource::getErrorString() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_file.errorString();
+}
+
+PDFByteSourceCache::PDFByteSourceCache(PDFByteSourcePointer byteSource) :
+    m_byteSource(std::move(byteSource))
+{
+    m_size = m_byteSource ? m_byteSource->getSize() : -1;
+
+    if (m_size <= 0)
+    {
+        throw PDFException(PDFTranslationContext::tr("Document data can't be read."));
+    }
+
+    // Buffer is not initialized, so memory pages are committed only when blocks are written
+    m_data.reset(new char[m_size]);
+
+    m_missingBlockCount = (m_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    m_blocks.resize(m_missingBlockCount, false);
+}
+
+QByteArray PDFByteSourceCache::getData() const
+{
+    return QByteArray::fromRawData(m_data.get(), m_size);
+}
+
+void PDFByteSourceCache::ensureRange(qint64 offset, qint64 length)
+{
+    offset = qBound(qint64(0), offset, m_size);
+    length = qBound(qint64(0), length, m_size - offset);
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    const qint64 firstBlock = offset / BLOCK_SIZE;
+    const qint64 lastBlock = (offset + length - 1) / BLOCK_SIZE;
+
+    QMutexLocker lock(&m_mutex);
+
+    qint64 block = firstBlock;
+    while (block <= lastBlock)
+    {
+        if (m_blocks[block])
+        {
+            ++block;
+            continue;
+        }
+
+        // Find run of missing blocks, which is read at once
+        qint64 runEnd = block + 1;
+        while (runEnd <= lastBlock && !m_blocks[runEnd])
+        {
+            ++runEnd;
+        }
+
+        const qint64 readOffset = block * BLOCK_SIZE;
+        const qint64 readLength = qMin(runEnd * BLOCK_SIZE, m_size) - readOffset;
+
+        if (!m_byteSource->read(readOffset, readLength, m_data.get() + readOffset))
+        {
+            throw PDFException(PDFTranslationContext::tr("Can't read %1 bytes of document data at position %2. %3").arg(readLength).arg(readOffset).arg(m_byteSource->getErrorString()));
+        }
+
+        for (qint64 i = block; i < runEnd; ++i)
+        {
+            m_blocks[i] = true;
+        }
+
+        m_missingBlockCount -= runEnd - block;
+        m_readBytes += readLength;
+        ++m_readCount;
+        block = runEnd;
+    }
+}
+
+bool PDFByteSourceCache::isComplete() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_missingBlockCount == 0;
+}
+
+qint64 PDFByteSourceCache::getReadBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_readBytes;
+}
+
+qint64 PDFByteSourceCache::getReadCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_readCount;
+}
+
+}   // namespace pdf
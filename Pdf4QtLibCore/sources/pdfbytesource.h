@@ -0,0 +1,128 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFBYTESOURCE_H
+#define PDFBYTESOURCE_H
+
+#include "pdfglobal.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QByteArray>
+
+#include <memory>
+#include <vector>
+
+namespace pdf
+{
+
+/// Random access source of the document data. It allows reading of documents,
+/// whose data are not available at once (for example, documents stored
+/// remotely, which are read using range requests). Data can be read
+/// from multiple threads, so implementations must be thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFByteSource
+{
+public:
+    explicit inline PDFByteSource() = default;
+    virtual ~PDFByteSource() = default;
+
+    /// Returns size of the data in bytes, or -1, if size is unknown
+    /// (for example, source can't be opened).
+    virtual qint64 getSize() const = 0;
+
+    /// Reads the data. Returns true, if all requested bytes were read.
+    /// \param offset Offset of the data
+    /// \param length Length of the data
+    /// \param data Output buffer of size at least \p length
+    virtual bool read(qint64 offset, qint64 length, char* data) = 0;
+
+    /// Returns error message of the last failed operation
+    virtual QString getErrorString() const = 0;
+};
+
+using PDFByteSourcePointer = std::shared_ptr<PDFByteSource>;
+
+/// Byte source reading data from the file
+class PDF4QTLIBCORESHARED_EXPORT PDFFileByteSource : public PDFByteSource
+{
+public:
+    explicit PDFFileByteSource(const QString& fileName);
+
+    /// Opens the file. Returns true, if file was opened.
+    bool open();
+
+    virtual qint64 getSize() const override;
+    virtual bool read(qint64 offset, qint64 length, char* data) override;
+    virtual QString getErrorString() const override;
+
+private:
+    mutable QMutex m_mutex;
+    QFile m_file;
+};
+
+/// Block cache of the byte source. Data of the byte source are read in blocks,
+/// when they are requested, and each block is read only once. Cache holds
+/// buffer of the whole data size, whose memory pages are committed by
+/// the operating system only, when they are written, so only read blocks
+/// consume memory. Cache is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFByteSourceCache
+{
+public:
+    explicit PDFByteSourceCache(PDFByteSourcePointer byteSource);
+
+    /// Returns size of the data
+    qint64 getSize() const { return m_size; }
+
+    /// Returns data of the source. Data are not copied, returned byte array
+    /// references the cache buffer, so cache must exist as long as the data
+    /// are used. Only ranges ensured by \p ensureRange contain valid data.
+    QByteArray getData() const;
+
+    /// Ensures, that data in the given range are read from the byte source.
+    /// Missing blocks are read using as few reads as possible. Throws
+    /// an exception, if data can't be read.
+    /// \param offset Offset of the range
+    /// \param length Length of the range
+    void ensureRange(qint64 offset, qint64 length);
+
+    /// Returns true, if all data were read
+    bool isComplete() const;
+
+    /// Returns count of bytes read from the byte source
+    qint64 getReadBytes() const;
+
+    /// Returns count of reads from the byte source
+    qint64 getReadCount() const;
+
+private:
+    /// Size of the block
+    static constexpr qint64 BLOCK_SIZE = 64 * 1024;
+
+    PDFByteSourcePointer m_byteSource;
+    qint64 m_size = 0;
+    std::unique_ptr<char[]> m_data;
+
+    mutable QMutex m_mutex;
+    std::vector<bool> m_blocks;
+    qint64 m_missingBlockCount = 0;
+    qint64 m_readBytes = 0;
+    qint64 m_readCount = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFBYTESOURCE_H
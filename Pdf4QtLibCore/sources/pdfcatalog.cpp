@@ -61,6 +61,12 @@ static constexpr const char* PDF_VIEWER_PREFERENCES_PRINT_PAGE_RANGE = "PrintPag
 
 size_t PDFCatalog::getPageIndexFromPageReference(PDFObjectReference reference) const
 {
+    if (m_pageTree)
+    {
+        const size_t index = m_pageTree->getPageIndexFromPageReference(reference);
+        return index < m_pageTree->getPageCount() ? index : INVALID_PAGE_INDEX;
+    }
+
     auto it = std::find_if(m_pages.cbegin(), m_pages.cend(), [reference](const PDFPage& page) { return page.getPageReference() == reference; });
     if (it != m_pages.cend())
     {
@@ -72,13 +78,15 @@ size_t PDFCatalog::getPageIndexFromPageReference(PDFObjectReference reference) c
 
 const PDFDestination* PDFCatalog::getNamedDestination(const QByteArray& key) const
 {
-    auto it = m_namedDestinations.find(key);
-    if (it != m_namedDestinations.cend())
+    return m_namedDestinations ? m_namedDestinations->getDestination(key) : nullptr;
+}
+
+void PDFCatalog::enumerateNamedDestinations(const PDFNamedDestinations::EnumerateCallback& callback) const
+{
+    if (m_namedDestinations)
     {
-        return &it->second;
+        m_namedDestinations->enumerate(callback);
     }
-
-    return nullptr;
 }
 
 PDFActionPtr PDFCatalog::getNamedJavaScriptAction(const QByteArray& key) const
@@ -181,7 +189,27 @@ PDFCatalog PDFCatalog::parse(const PDFObject& catalog, const PDFDocument* docume
 
     PDFCatalog catalogObject;
     catalogObject.m_viewerPreferences = PDFViewerPreferences::parse(catalog, document);
-    catalogObject.m_pages = PDFPage::parse(&document->getStorage(), catalogDictionary->get("Pages"));
+
+    if (document->getStorage().isLazy())
+    {
+        // Objects are loaded on demand, so parse the pages on demand too,
+        // so first page can be displayed without loading whole page tree.
+        try
+        {
+            catalogObject.m_pageTree = std::make_shared<const PDFPageTree>(document->getStorage(), catalogDictionary->get("Pages"));
+        }
+        catch (const PDFException&)
+        {
+            // Root of the page tree is damaged, parse pages immediately
+            catalogObject.m_pageTree.reset();
+        }
+    }
+
+    if (!catalogObject.m_pageTree)
+    {
+        catalogObject.m_pages = PDFPage::parse(&document->getStorage(), catalogDictionary->get("Pages"));
+    }
+
     catalogObject.m_pageLabels = PDFNumberTreeLoader<PDFPageLabel>::parse(&document->getStorage(), catalogDictionary->get("PageLabels"));
 
     if (catalogDictionary->hasKey("OCProperties"))
@@ -249,23 +277,11 @@ PDFCatalog PDFCatalog::parse(const PDFObject& catalog, const PDFDocument* docume
 
     if (const PDFDictionary* namesDictionary = document->getDictionaryFromObject(catalogDictionary->get("Names")))
     {
-        auto parseDestination = [](const PDFObjectStorage* storage, PDFObject object)
-        {
-            object = storage->getObject(object);
-            if (object.isDictionary())
-            {
-                object = object.getDictionary()->get("D");
-            }
-
-            return PDFDestination::parse(storage, qMove(object));
-        };
-
         auto getObject = [](const PDFObjectStorage*, PDFObject object)
         {
             return object;
         };
 
-        catalogObject.m_namedDestinations = PDFNameTreeLoader<PDFDestination>::parse(&document->getStorage(), namesDictionary->get("Dests"), parseDestination);
         catalogObject.m_namedAppearanceStreams = PDFNameTreeLoader<PDFObject>::parse(&document->getStorage(), namesDictionary->get("AP"), getObject);
         catalogObject.m_namedJavaScriptActions = PDFNameTreeLoader<PDFActionPtr>::parse(&document->getStorage(), namesDictionary->get("JavaScript"), &PDFAction::parse);
         catalogObject.m_namedPages = PDFNameTreeLoader<PDFObject>::parse(&document->getStorage(), namesDictionary->get("Pages"), getObject);
@@ -277,15 +293,13 @@ PDFCatalog PDFCatalog::parse(const PDFObject& catalog, const PDFDocument* docume
         catalogObject.m_namedRenditions = PDFNameTreeLoader<PDFObject>::parse(&document->getStorage(), namesDictionary->get("Renditions"), getObject);
     }
 
-    // Examine "Dests" dictionary
-    if (const PDFDictionary* destsDictionary = document->getDictionaryFromObject(catalogDictionary->get("Dests")))
+    // Named destinations ("Dests" name tree and "Dests" dictionary) are resolved on demand
+    PDFObject destinationsNameTree;
+    if (const PDFDictionary* namesDictionary = document->getDictionaryFromObject(catalogDictionary->get("Names")))
     {
-        const size_t count = destsDictionary->getCount();
-        for (size_t i = 0; i < count; ++i)
-        {
-            catalogObject.m_namedDestinations[destsDictionary->getKey(i).getString()] = PDFDestination::parse(&document->getStorage(), destsDictionary->getValue(i));
-        }
+        destinationsNameTree = namesDictionary->get("Dests");
     }
+    catalogObject.m_namedDestinations = std::make_shared<const PDFNamedDestinations>(document->getStorage(), qMove(destinationsNameTree), catalogDictionary->get("Dests"));
 
     // Examine "URI" dictionary
     if (const PDFDictionary* URIDictionary = document->getDictionaryFromObject(catalogDictionary->get("URI")))
@@ -1048,4 +1062,84 @@ PDFPageAdditionalActions PDFPageAdditionalActions::parse(const PDFObjectStorage*
     return result;
 }
 
+PDFNamedDestinations::PDFNamedDestinations(const PDFObjectStorage& storage, PDFObject nameTreeRoot, PDFObject destinationsDictionary) :
+    m_storage(std::make_unique<PDFObjectStorage>(storage)),
+    m_nameTreeRoot(qMove(nameTreeRoot)),
+    m_destinationsDictionary(qMove(destinationsDictionary))
+{
+
+}
+
+PDFNamedDestinations::~PDFNamedDestinations() = default;
+
+const PDFDestination* PDFNamedDestinations::getDestination(const QByteArray& name) const
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        auto it = m_cache.find(name);
+        if (it != m_cache.cend())
+        {
+            return it->second.has_value() ? &it->second.value() : nullptr;
+        }
+    }
+
+    // Destination is resolved outside of the lock, another thread
+    // may resolve the same destination, then first result is kept.
+    std::optional<PDFDestination> destination = findDestination(name);
+
+    QMutexLocker lock(&m_mutex);
+    auto it = m_cache.emplace(name, qMove(destination)).first;
+    return it->second.has_value() ? &it->second.value() : nullptr;
+}
+
+void PDFNamedDestinations::enumerate(const EnumerateCallback& callback) const
+{
+    const PDFDictionary* destinationsDictionary = m_storage->getDictionaryFromObject(m_destinationsDictionary);
+
+    auto enumerateNameTreeItem = [&](const QByteArray& name, const PDFObject& object)
+    {
+        // Destinations from the Dests dictionary have priority
+        if (destinationsDictionary && destinationsDictionary->hasKey(name))
+        {
+            return;
+        }
+
+        callback(name, parseDestination(m_storage.get(), object));
+    };
+    PDFNameTreeLoader<PDFDestination>::enumerate(m_storage.get(), m_nameTreeRoot, enumerateNameTreeItem);
+
+    if (destinationsDictionary)
+    {
+        const size_t count = destinationsDictionary->getCount();
+        for (size_t i = 0; i < count; ++i)
+        {
+            callback(destinationsDictionary->getKey(i).getString(), PDFDestination::parse(m_storage.get(), destinationsDictionary->getValue(i)));
+        }
+    }
+}
+
+PDFDestination PDFNamedDestinations::parseDestination(const PDFObjectStorage* storage, PDFObject object)
+{
+    object = storage->getObject(object);
+    if (object.isDictionary())
+    {
+        object = object.getDictionary()->get("D");
+    }
+
+    return PDFDestination::parse(storage, qMove(object));
+}
+
+std::optional<PDFDestination> PDFNamedDestinations::findDestination(const QByteArray& name) const
+{
+    if (const PDFDictionary* destinationsDictionary = m_storage->getDictionaryFromObject(m_destinationsDictionary))
+    {
+        if (destinationsDictionary->hasKey(name))
+        {
+            return PDFDestination::parse(m_storage.get(), destinationsDictionary->get(name));
+        }
+    }
+
+    return PDFNameTreeLoader<PDFDestination>::find(m_storage.get(), m_nameTreeRoot, name, &PDFNamedDestinations::parseDestination);
+}
+
 }   // namespace pdf
@@ -24,9 +24,15 @@
 #include "pdfoutline.h"
 #include "pdfaction.h"
 
+#include <QMutex>
+
+#include <map>
 #include <array>
+#include <memory>
 #include <vector>
 #include <utility>
+#include <optional>
+#include <functional>
 
 namespace pdf
 {
@@ -562,6 +568,56 @@ private:
     std::array<PDFActionPtr, End> m_actions;
 };
 
+/// Named destinations of the document. Destinations are resolved on demand
+/// from the name tree (Dests entry in the Names dictionary) and from the
+/// Dests dictionary of the catalog, only nodes of the name tree on the path
+/// to the destination are visited. Resolved destinations are cached.
+/// Destinations from the Dests dictionary have priority over destinations
+/// from the name tree. This class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFNamedDestinations
+{
+public:
+    /// Creates named destinations
+    /// \param storage Storage, must not be modified (it should be lazy storage)
+    /// \param nameTreeRoot Root of the name tree of destinations
+    /// \param destinationsDictionary Dests dictionary of the catalog
+    explicit PDFNamedDestinations(const PDFObjectStorage& storage, PDFObject nameTreeRoot, PDFObject destinationsDictionary);
+    ~PDFNamedDestinations();
+
+    PDFNamedDestinations(const PDFNamedDestinations&) = delete;
+    PDFNamedDestinations& operator=(const PDFNamedDestinations&) = delete;
+
+    using EnumerateCallback = std::function<void(const QByteArray&, const PDFDestination&)>;
+
+    /// Returns destination with given name. If destination is not found,
+    /// then nullptr is returned. Returned pointer is valid as long
+    /// as this object exists.
+    /// \param name Name of the destination
+    const PDFDestination* getDestination(const QByteArray& name) const;
+
+    /// Enumerates all named destinations. Destinations are parsed and passed
+    /// to the callback one by one, they are not cached, so enumerating
+    /// of large documents doesn't need much memory.
+    /// \param callback Callback called for each destination
+    void enumerate(const EnumerateCallback& callback) const;
+
+private:
+    /// Parses destination from the value in the name tree (destination,
+    /// or dictionary with destination in the D entry).
+    static PDFDestination parseDestination(const PDFObjectStorage* storage, PDFObject object);
+
+    /// Finds destination with given name in the Dests dictionary
+    /// and in the name tree. Returns std::nullopt, if not found.
+    std::optional<PDFDestination> findDestination(const QByteArray& name) const;
+
+    std::unique_ptr<const PDFObjectStorage> m_storage;
+    PDFObject m_nameTreeRoot;
+    PDFObject m_destinationsDictionary;
+
+    mutable QMutex m_mutex;
+    mutable std::map<QByteArray, std::optional<PDFDestination>> m_cache;
+};
+
 class PDF4QTLIBCORESHARED_EXPORT PDFCatalog
 {
 public:
@@ -589,10 +645,10 @@ public:
     const PDFViewerPreferences* getViewerPreferences() const { return &m_viewerPreferences; }
 
     /// Returns the page count
-    size_t getPageCount() const { return m_pages.size(); }
+    size_t getPageCount() const { return m_pageTree ? m_pageTree->getPageCount() : m_pages.size(); }
 
     /// Returns the page
-    const PDFPage* getPage(size_t index) const { return &m_pages.at(index); }
+    const PDFPage* getPage(size_t index) const { return m_pageTree ? m_pageTree->getPage(index) : &m_pages.at(index); }
 
     /// Returns page index. If page is not found, then INVALID_PAGE_INDEX is returned.
     size_t getPageIndexFromPageReference(PDFObjectReference reference) const;
@@ -632,7 +688,6 @@ public:
     bool isXFANeedsRendering() const { return m_xfaNeedsRendering; }
     const PDFObject& getAssociatedFiles() const { return m_associatedFiles; }
     const PDFObject& getDocumentPartRoot() const { return m_documentPartRoot; }
-    const std::map<QByteArray, PDFDestination>& getNamedDestinations() const { return m_namedDestinations; }
 
     /// Is document marked to have structure tree conforming to tagged document convention?
     bool isLogicalStructureMarked() const { return m_markInfoFlags.testFlag(MarkInfo_Marked); }
@@ -649,6 +704,11 @@ public:
     /// \returns Pointer to the destination, or nullptr
     const PDFDestination* getNamedDestination(const QByteArray& key) const;
 
+    /// Enumerates all named destinations of the document, destinations
+    /// are not cached. See PDFNamedDestinations::enumerate.
+    /// \param callback Callback called for each destination
+    void enumerateNamedDestinations(const PDFNamedDestinations::EnumerateCallback& callback) const;
+
     /// Returns javascript action using the key. If javascript action is not found,
     /// then nullptr is returned.
     /// \param key Action key
@@ -720,6 +780,10 @@ private:
     QByteArray m_version;
     PDFViewerPreferences m_viewerPreferences;
     std::vector<PDFPage> m_pages;
+
+    /// Page tree parsed on demand (used instead of m_pages for
+    /// documents, whose objects are loaded on demand)
+    std::shared_ptr<const PDFPageTree> m_pageTree;
     std::vector<PDFPageLabel> m_pageLabels;
     PDFOptionalContentProperties m_optionalContentProperties;
     QSharedPointer<PDFOutlineItem> m_outlineRoot;
@@ -747,8 +811,9 @@ private:
     PDFObject m_associatedFiles;
     PDFObject m_documentPartRoot;
 
+    std::shared_ptr<const PDFNamedDestinations> m_namedDestinations;
+
     // Maps from Names dictionary
-    std::map<QByteArray, PDFDestination> m_namedDestinations;
     std::map<QByteArray, PDFObject> m_namedAppearanceStreams;
     std::map<QByteArray, PDFActionPtr> m_namedJavaScriptActions;
     std::map<QByteArray, PDFObject> m_namedPages;
@@ -18,6 +18,10 @@
 
 #include "pdfccittfaxdecoder.h"
 #include "pdfexception.h"
+
+#include <array>
+#include <cstring>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -58,8 +62,6 @@ struct PDFCCITTCode
     uint8_t bits;
 };
 
-static constexpr uint8_t MAX_CODE_BIT_LENGTH = 12;
-
 static constexpr PDFCCITTCode CCITT_WHITE_CODES[] = {
 
 // Terminating white codes
@@ -284,6 +286,75 @@ static constexpr PDFCCITTCode CCITT_BLACK_CODES[] = {
     { 2560,    0b000000011111,     000000011111_bitlength }
 };
 
+/// Number of bits used to index the lookup tables of the codes. All run length
+/// codes have at most 13 bits, all 2D mode codes have at most 7 bits.
+static constexpr uint8_t CODE_TABLE_BITS = 13;
+
+struct PDFCCITTCodeTableEntry
+{
+    uint16_t length = 0;
+    uint8_t bits = 0;   ///< Bit length of the code, zero for invalid code
+};
+
+struct PDFCCITT2DModeTableEntry
+{
+    CCITT_2D_Code_Mode mode = Invalid;
+    uint8_t bits = 0;   ///< Bit length of the code, zero for invalid code
+};
+
+/// Creates lookup table of the codes. Table is indexed by next \p tableBits bits
+/// of the stream, entry contains decoded value and bit length of the code.
+template<size_t tableBits, typename Entry, typename Code, size_t codeCount, typename Transform>
+static constexpr std::array<Entry, (size_t(1) << tableBits)> createCodeTable(const Code (&codes)[codeCount], Transform transform)
+{
+    std::array<Entry, (size_t(1) << tableBits)> table = { };
+
+    for (const Code& code : codes)
+    {
+        const size_t shift = tableBits - code.bits;
+        const size_t first = size_t(code.code) << shift;
+        const size_t last = first + (size_t(1) << shift);
+
+        for (size_t i = first; i < last; ++i)
+        {
+            table[i] = transform(code);
+        }
+    }
+
+    return table;
+}
+
+static constexpr auto createRunLengthEntry = [](const PDFCCITTCode& code) { return PDFCCITTCodeTableEntry{ code.length, code.bits }; };
+static constexpr auto create2DModeEntry = [](const PDFCCITT2DModeInfo& info) { return PDFCCITT2DModeTableEntry{ info.mode, info.bits }; };
+
+static constexpr auto CCITT_WHITE_CODE_TABLE = createCodeTable<CODE_TABLE_BITS, PDFCCITTCodeTableEntry>(CCITT_WHITE_CODES, createRunLengthEntry);
+static constexpr auto CCITT_BLACK_CODE_TABLE = createCodeTable<CODE_TABLE_BITS, PDFCCITTCodeTableEntry>(CCITT_BLACK_CODES, createRunLengthEntry);
+static constexpr auto CCITT_2D_CODE_MODE_TABLE = createCodeTable<MAX_2D_MODE_BIT_LENGTH, PDFCCITT2DModeTableEntry>(CCITT_2D_CODE_MODES, create2DModeEntry);
+
+/// Sets bits of the packed row in the interval [from, to) to one (white pixels)
+static inline void fillWhiteSpan(uint8_t* row, int from, int to)
+{
+    if (from >= to)
+    {
+        return;
+    }
+
+    const int firstByte = from >> 3;
+    const int lastByte = (to - 1) >> 3;
+    const uint8_t firstMask = static_cast<uint8_t>(0xFF >> (from & 7));
+    const uint8_t lastMask = static_cast<uint8_t>(0xFF << (7 - ((to - 1) & 7)));
+
+    if (firstByte == lastByte)
+    {
+        row[firstByte] |= firstMask & lastMask;
+        return;
+    }
+
+    row[firstByte] |= firstMask;
+    std::memset(row + firstByte + 1, 0xFF, lastByte - firstByte - 1);
+    row[lastByte] |= lastMask;
+}
+
 PDFCCITTFaxDecoder::PDFCCITTFaxDecoder(const QByteArray* stream, const PDFCCITTFaxDecoderParameters& parameters) :
     m_reader(stream, 1),
     m_parameters(parameters)
@@ -293,7 +364,13 @@ PDFCCITTFaxDecoder::PDFCCITTFaxDecoder(const QByteArray* stream, const PDFCCITTF
 
 PDFImageData PDFCCITTFaxDecoder::decode()
 {
-    PDFBitWriter writer(1);
+    const int rowSize = (m_parameters.columns + 7) / 8;
+    QByteArray imageData;
+    if (m_parameters.rows > 0)
+    {
+        imageData.reserve(rowSize * m_parameters.rows);
+    }
+
     std::vector<int> codingLine;
     std::vector<int> referenceLine;
 
@@ -453,20 +530,17 @@ PDFImageData PDFCCITTFaxDecoder::decode()
             }
         }
 
-        // Write the line to the output buffer
-        isCurrentPixelBlack = false;
-        int index = 0;
-        for (int i = 0; i < m_parameters.columns; ++i)
+        // Write the line to the output buffer. Changing elements alternate
+        // white and black runs, first run is white. White pixels are ones.
+        imageData.append(rowSize, 0x00);
+        uint8_t* rowData = reinterpret_cast<uint8_t*>(imageData.data()) + static_cast<qsizetype>(row) * rowSize;
+        int position = 0;
+        for (size_t index = 0; position < m_parameters.columns && index < codingLine.size(); index += 2)
         {
-            if (i == codingLine[index])
-            {
-                isCurrentPixelBlack = !isCurrentPixelBlack;
-                ++index;
-            }
-
-            writer.write(isCurrentPixelBlack ? 0 : 1);
+            const int whiteRunEnd = qMin(codingLine[index], m_parameters.columns);
+            fillWhiteSpan(rowData, position, whiteRunEnd);
+            position = (index + 1 < codingLine.size()) ? qMin(codingLine[index + 1], m_parameters.columns) : m_parameters.columns;
         }
-        writer.finishLine();
 
         ++row;
 
@@ -556,7 +630,7 @@ PDFImageData PDFCCITTFaxDecoder::decode()
         decode = { m_parameters.decode[0], m_parameters.decode[1] };
     }
 
-    return PDFImageData(1, 1, m_parameters.columns, row, (m_parameters.columns + 7) / 8, m_parameters.maskingType, writer.takeByteArray(), { }, qMove(decode), { });
+    return PDFImageData(1, 1, m_parameters.columns, row, rowSize, m_parameters.maskingType, qMove(imageData), { }, qMove(decode), { });
 }
 
 void PDFCCITTFaxDecoder::skipFill()
@@ -640,57 +714,38 @@ uint32_t PDFCCITTFaxDecoder::getRunLength(bool white)
 
 uint32_t PDFCCITTFaxDecoder::getWhiteCode()
 {
-    return getCode(CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES));
+    return getCode(CCITT_WHITE_CODE_TABLE.data());
 }
 
 uint32_t PDFCCITTFaxDecoder::getBlackCode()
 {
-    return getCode(CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES));
+    return getCode(CCITT_BLACK_CODE_TABLE.data());
 }
 
-uint32_t PDFCCITTFaxDecoder::getCode(const PDFCCITTCode* codes, size_t codeCount)
+uint32_t PDFCCITTFaxDecoder::getCode(const PDFCCITTCodeTableEntry* codeTable)
 {
-    uint32_t code = 0;
-    uint8_t bits = 0;
+    const PDFCCITTCodeTableEntry& entry = codeTable[m_reader.look(CODE_TABLE_BITS)];
 
-    while (bits <= MAX_CODE_BIT_LENGTH)
+    if (entry.bits == 0)
     {
-        code = (code << 1) + m_reader.read(1);
-        ++bits;
-
-        for (size_t i = 0; i < codeCount; ++i)
-        {
-            const PDFCCITTCode& currentCode = codes[i];
-            if (currentCode.bits == bits && currentCode.code == code)
-            {
-                return currentCode.length;
-            }
-        }
+        throw PDFException(PDFTranslationContext::tr("Invalid CCITT run length code word."));
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid CCITT run length code word."));
+    m_reader.read(entry.bits);
+    return entry.length;
 }
 
 CCITT_2D_Code_Mode PDFCCITTFaxDecoder::get2DMode()
 {
-    uint32_t code = 0;
-    uint8_t bits = 0;
+    const PDFCCITT2DModeTableEntry& entry = CCITT_2D_CODE_MODE_TABLE[m_reader.look(MAX_2D_MODE_BIT_LENGTH)];
 
-    while (bits <= MAX_2D_MODE_BIT_LENGTH)
+    if (entry.bits == 0)
     {
-        code = (code << 1) + m_reader.read(1);
-        ++bits;
-
-        for (const PDFCCITT2DModeInfo& info : CCITT_2D_CODE_MODES)
-        {
-            if (info.bits == bits && info.code == code)
-            {
-                return info.mode;
-            }
-        }
+        throw PDFException(PDFTranslationContext::tr("Invalid CCITT 2D mode."));
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid CCITT 2D mode."));
+    m_reader.read(entry.bits);
+    return entry.mode;
 }
 
 }   // namespace pdf
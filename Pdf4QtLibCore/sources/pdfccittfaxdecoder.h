@@ -24,7 +24,7 @@
 namespace pdf
 {
 
-struct PDFCCITTCode;
+struct PDFCCITTCodeTableEntry;
 
 struct PDFCCITTFaxDecoderParameters
 {
@@ -122,7 +122,7 @@ private:
     uint32_t getWhiteCode();
     uint32_t getBlackCode();
 
-    uint32_t getCode(const PDFCCITTCode* codes, size_t codeCount);
+    uint32_t getCode(const PDFCCITTCodeTableEntry* codeTable);
 
     PDFBitReader m_reader;
     PDFCCITTFaxDecoderParameters m_parameters;
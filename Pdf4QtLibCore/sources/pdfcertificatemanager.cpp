@@ -245,59 +245,92 @@ bool PDFCertificateManager::isCertificateValid(const PDFCertificateEntry& certif
     return pkcs12data.isEmpty();
 }
 
-bool PDFSignatureFactory::sign(const PDFCertificateEntry& certificateEntry,
-                               QString password,
-                               QByteArray data,
-                               QByteArray& result)
+PDFSigningKey::~PDFSigningKey()
 {
-    QByteArray pkcs12Data = certificateEntry.pkcs12;
+    clear();
+}
 
-    if (!pkcs12Data.isEmpty())
+void PDFSigningKey::clear()
+{
+    EVP_PKEY_free(m_key);
+    X509_free(m_certificate);
+    sk_X509_pop_free(m_certificates, X509_free);
+
+    m_key = nullptr;
+    m_certificate = nullptr;
+    m_certificates = nullptr;
+}
+
+bool PDFSigningKey::load(const QByteArray& pkcs12Data, const QString& password)
+{
+    clear();
+
+    PDFOpenSSLGlobalLock lock;
+
+    openssl_ptr<BIO> pkcs12Buffer(BIO_new(BIO_s_mem()), &BIO_free_all);
+    BIO_write(pkcs12Buffer.get(), pkcs12Data.constData(), pkcs12Data.length());
+
+    openssl_ptr<PKCS12> pkcs12(d2i_PKCS12_bio(pkcs12Buffer.get(), nullptr), &PKCS12_free);
+    if (!pkcs12)
     {
-        openssl_ptr<BIO> pkcs12Buffer(BIO_new(BIO_s_mem()), &BIO_free_all);
-        BIO_write(pkcs12Buffer.get(), pkcs12Data.constData(), pkcs12Data.length());
+        return false;
+    }
 
-        openssl_ptr<PKCS12> pkcs12(d2i_PKCS12_bio(pkcs12Buffer.get(), nullptr), &PKCS12_free);
-        if (pkcs12)
-        {
-            const char* passwordPointer = nullptr;
-            QByteArray passwordByteArray = password.isEmpty() ? QByteArray() : password.toUtf8();
-            if (!passwordByteArray.isEmpty())
-            {
-                passwordPointer = passwordByteArray.constData();
-            }
+    const char* passwordPointer = nullptr;
+    QByteArray passwordByteArray = password.isEmpty() ? QByteArray() : password.toUtf8();
+    if (!passwordByteArray.isEmpty())
+    {
+        passwordPointer = passwordByteArray.constData();
+    }
 
-            EVP_PKEY* key = nullptr;
-            X509* certificate = nullptr;
-            STACK_OF(X509)* certificates = nullptr;
-            if (PKCS12_parse(pkcs12.get(), passwordPointer, &key, &certificate, &certificates) == 1)
-            {
-                openssl_ptr<BIO> signedDataBuffer(BIO_new(BIO_s_mem()), &BIO_free_all);
-                BIO_write(signedDataBuffer.get(), data.constData(), data.length());
+    if (PKCS12_parse(pkcs12.get(), passwordPointer, &m_key, &m_certificate, &m_certificates) != 1 || !isValid())
+    {
+        clear();
+        return false;
+    }
 
-                PKCS7* signature = PKCS7_sign(certificate, key, certificates, signedDataBuffer.get(), PKCS7_DETACHED | PKCS7_BINARY);
-                if (signature)
-                {
-                    openssl_ptr<BIO> outputBuffer(BIO_new(BIO_s_mem()), &BIO_free_all);
-                    i2d_PKCS7_bio(outputBuffer.get(), signature);
+    return true;
+}
 
-                    BUF_MEM* pksMemoryBuffer = nullptr;
-                    BIO_get_mem_ptr(outputBuffer.get(), &pksMemoryBuffer);
+bool PDFSigningKey::sign(const QByteArray& data, QByteArray& result) const
+{
+    if (!isValid())
+    {
+        return false;
+    }
 
-                    result = QByteArray(pksMemoryBuffer->data, int(pksMemoryBuffer->length));
+    PDFOpenSSLGlobalLock lock;
 
-                    EVP_PKEY_free(key);
-                    X509_free(certificate);
-                    sk_X509_free(certificates);
-                    return true;
-                }
+    openssl_ptr<BIO> signedDataBuffer(BIO_new(BIO_s_mem()), &BIO_free_all);
+    BIO_write(signedDataBuffer.get(), data.constData(), data.length());
 
-                EVP_PKEY_free(key);
-                X509_free(certificate);
-                sk_X509_free(certificates);
-                return false;
-            }
-        }
+    openssl_ptr<PKCS7> signature(PKCS7_sign(m_certificate, m_key, m_certificates, signedDataBuffer.get(), PKCS7_DETACHED | PKCS7_BINARY), &PKCS7_free);
+    if (!signature)
+    {
+        return false;
+    }
+
+    openssl_ptr<BIO> outputBuffer(BIO_new(BIO_s_mem()), &BIO_free_all);
+    i2d_PKCS7_bio(outputBuffer.get(), signature.get());
+
+    BUF_MEM* pksMemoryBuffer = nullptr;
+    BIO_get_mem_ptr(outputBuffer.get(), &pksMemoryBuffer);
+
+    result = QByteArray(pksMemoryBuffer->data, int(pksMemoryBuffer->length));
+    return true;
+}
+
+bool PDFSignatureFactory::sign(const PDFCertificateEntry& certificateEntry,
+                               QString password,
+                               QByteArray data,
+                               QByteArray& result)
+{
+    QByteArray pkcs12Data = certificateEntry.pkcs12;
+
+    if (!pkcs12Data.isEmpty())
+    {
+        PDFSigningKey signingKey;
+        return signingKey.load(pkcs12Data, password) && signingKey.sign(data, result);
     }
 #ifdef Q_OS_WIN
     else
@@ -24,6 +24,9 @@
 #include <QString>
 #include <QFileInfoList>
 
+struct evp_pkey_st;
+struct stack_st_X509;
+
 namespace pdf
 {
 
@@ -56,6 +59,41 @@ public:
     static bool isCertificateValid(const PDFCertificateEntry& certificateEntry, QString password);
 };
 
+/// Signing key (private key, certificate and its chain) loaded from PKCS#12 data.
+/// Key is decrypted only once, when it is loaded, so it can be used to sign many
+/// documents cheaply. Signing is thread safe, so documents can be signed in parallel
+/// using the same key (OpenSSL global lock is used only by OpenSSL prior to 1.1.0).
+class PDF4QTLIBCORESHARED_EXPORT PDFSigningKey
+{
+public:
+    explicit PDFSigningKey() = default;
+    ~PDFSigningKey();
+
+    PDFSigningKey(const PDFSigningKey&) = delete;
+    PDFSigningKey& operator=(const PDFSigningKey&) = delete;
+
+    /// Loads the key from PKCS#12 data. Previously loaded key is released.
+    /// Returns true, if key was loaded successfully.
+    /// \param pkcs12 PKCS#12 data
+    /// \param password Password of the private key
+    bool load(const QByteArray& pkcs12, const QString& password);
+
+    /// Creates detached PKCS#7 signature (DER encoded) of the data
+    /// \param data Data to be signed
+    /// \param[out] result Signature
+    bool sign(const QByteArray& data, QByteArray& result) const;
+
+    /// Returns true, if key is loaded
+    bool isValid() const { return m_key && m_certificate; }
+
+private:
+    void clear();
+
+    evp_pkey_st* m_key = nullptr;
+    x509_st* m_certificate = nullptr;
+    stack_st_X509* m_certificates = nullptr;
+};
+
 class PDF4QTLIBCORESHARED_EXPORT PDFSignatureFactory
 {
 public:
@@ -17,6 +17,7 @@
 
 #include "pdfcertificatestore.h"
 #include "pdfutils.h"
+#include "pdfinstrumentation.h"
 
 #if defined(PDF4QT_COMPILER_MINGW) || defined(PDF4QT_COMPILER_GCC)
 #pragma GCC diagnostic push
@@ -53,10 +54,17 @@ namespace pdf
 
 QRecursiveMutex PDFOpenSSLGlobalLock::s_globalOpenSSLMutex;
 
+// OpenSSL is thread safe since version 1.1.0 (it uses its own
+// locking), so global lock is needed only for older versions. Waiting
+// for the lock is traced, so serialization on the lock can be spotted.
 PDFOpenSSLGlobalLock::PDFOpenSSLGlobalLock() :
-    m_mutexLocker(&s_globalOpenSSLMutex)
+    m_waitStartTime(PDFTrace::isEnabled() ? PDFInstrumentation::now() : -1),
+    m_mutexLocker((OPENSSL_VERSION_NUMBER < 0x10100000L) ? &s_globalOpenSSLMutex : nullptr)
 {
-
+    if (m_waitStartTime >= 0 && m_mutexLocker.mutex())
+    {
+        PDFTrace::addEvent("openssl-global-lock-wait", "lock", m_waitStartTime, PDFInstrumentation::now());
+    }
 }
 
 void PDFCertificateEntry::serialize(QDataStream& stream) const
@@ -31,7 +31,8 @@ struct x509_st;
 namespace pdf
 {
 
-/// OpenSSL is not thread safe.
+/// OpenSSL prior to version 1.1.0 is not thread safe. For newer versions
+/// of OpenSSL, this lock does nothing.
 class PDF4QTLIBCORESHARED_EXPORT PDFOpenSSLGlobalLock
 {
 public:
@@ -39,6 +40,7 @@ public:
     inline ~PDFOpenSSLGlobalLock() = default;
 
 private:
+    qint64 m_waitStartTime;
     QMutexLocker<QRecursiveMutex> m_mutexLocker;
     static QRecursiveMutex s_globalOpenSSLMutex;
 };
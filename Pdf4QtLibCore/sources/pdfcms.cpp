@@ -18,9 +18,13 @@
 #include "pdfcms.h"
 #include "pdfdocument.h"
 #include "pdfexecutionpolicy.h"
+#include "pdfinstrumentation.h"
+#include "pdfsimd.h"
 
 #include <QDir>
 #include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
 #include <QBuffer>
 #include <QCoreApplication>
 #include <QReadWriteLock>
@@ -60,11 +64,20 @@
 #endif
 #endif
 
+#include <cmath>
+#include <atomic>
+#include <algorithm>
 #include <unordered_map>
 
 namespace pdf
 {
 
+PDFCMS::PDFCMS()
+{
+    static std::atomic<quint64> s_serialNumber = 0;
+    m_serialNumber = ++s_serialNumber;
+}
+
 class PDFLittleCMS : public PDFCMS
 {
 public:
@@ -87,6 +100,8 @@ public:
     virtual bool fillRGBBufferFromICC(const std::vector<float>& colors, RenderingIntent renderingIntent, unsigned char* outputBuffer, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const override;
     virtual bool transformColorSpace(const ColorSpaceTransformParams& params) const override;
     virtual PDFColorConvertor getColorConvertor() const override;
+    virtual ColorCacheStatistics getColorCacheStatistics() const override;
+    virtual bool fillRGBImageLines(const ImageLinesTransformParams& params) const override;
 
 private:
     void init();
@@ -156,6 +171,55 @@ private:
     /// \param profile Color profile handle
     static cmsUInt32Number getProfileDataFormat(cmsHPROFILE profile);
 
+    /// Returns little CMS integer data format for profile (8 or 16 bits per component,
+    /// 16-bit samples are big endian, as in PDF). If profile color space is not
+    /// supported, zero is returned.
+    /// \param profile Color profile handle
+    /// \param bitsPerComponent Bits per component (8 or 16)
+    static cmsUInt32Number getProfileIntegerDataFormat(cmsHPROFILE profile, int bitsPerComponent);
+
+    /// Gets transform with integer input format from cache. If transform
+    /// doesn't exist, then it is created. Output format is 8-bit RGB.
+    cmsHTRANSFORM getIntegerTransform(const ImageLinesTransformParams& params) const;
+
+    /// Creates transform from input profile to the output profile. If soft-proofing
+    /// is active, then proofing transform is created. If transform cache directory
+    /// is set, then transform is created from precomputed device link profile stored
+    /// in this directory, or, if it doesn't exist, device link profile is precomputed
+    /// and stored, so other instances of the application can reuse it.
+    /// \param input Input color profile
+    /// \param inputFormat Input data format
+    /// \param outputFormat Output data format
+    /// \param intent Rendering intent
+    cmsHTRANSFORM createTransform(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsUInt32Number outputFormat, RenderingIntent intent) const;
+
+    /// Returns file name of device link profile in the transform cache directory.
+    /// If transform can't be cached, empty string is returned.
+    /// \param input Input color profile
+    /// \param inputFormat Input data format
+    /// \param outputFormat Output data format
+    /// \param intent Rendering intent
+    QString getDeviceLinkFileName(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsUInt32Number outputFormat, RenderingIntent intent) const;
+
+    /// Returns serialized data of the color profile. If profile can't
+    /// be serialized, empty byte array is returned.
+    /// \param profile Color profile handle
+    static QByteArray getProfileData(cmsHPROFILE profile);
+
+    /// Returns hash of the color profile contents. Profile header is not hashed,
+    /// because it contains creation date, so instances of the same profile created
+    /// at different times have the same hash. If profile can't be serialized,
+    /// empty byte array is returned.
+    /// \param profile Color profile handle
+    static QByteArray getProfileHash(cmsHPROFILE profile);
+
+    /// Returns true, if transform from the profile to the output profile is identity
+    /// (each 8-bit output value is the same as the scaled input value), regardless
+    /// of rendering intent. Such transforms are not performed by the color management
+    /// system, colors are only scaled and packed.
+    /// \param profile Color profile (gray or RGB)
+    bool isIdentityTransform(Profile profile) const;
+
     /// Returns color from output color. Clamps invalid rgb output values to range [0.0, 1.0].
     /// \param color01 Rgb color (range 0-1 is assumed).
     static QColor getColorFromOutputColor(std::array<float, 3> color01);
@@ -165,6 +229,21 @@ private:
 
     cmsHTRANSFORM getTransformBetweenColorSpaces(const ColorSpaceTransformParams& params) const;
 
+    QColor convertColorFromDeviceGray(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const;
+    QColor convertColorFromDeviceRGB(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const;
+    QColor convertColorFromDeviceCMYK(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const;
+    QColor convertColorFromICC(const PDFColor& color, RenderingIntent renderingIntent, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const;
+
+    /// Returns color from the thread local color cache. If color is not found
+    /// in the cache, it is converted using \p convert function and stored in the cache.
+    /// \param profile Source color profile
+    /// \param iccID Icc profile id (for ICC based colors), or empty byte array
+    /// \param intent Rendering intent
+    /// \param color Source color
+    /// \param convert Color conversion function
+    template<typename ConvertFunction>
+    QColor getCachedColor(Profile profile, const QByteArray& iccID, RenderingIntent intent, const PDFColor& color, ConvertFunction convert) const;
+
     const PDFCMSManager* m_manager;
     PDFCMSSettings m_settings;
     QColor m_paperColor;
@@ -179,13 +258,350 @@ private:
 
     mutable QReadWriteLock m_transformColorSpaceCacheLock;
     mutable std::map<QByteArray, cmsHTRANSFORM> m_transformColorSpaceCache;
+
+    /// Hash of the settings common to all cached device link profiles (output
+    /// and soft-proofing profiles, transformation flags), empty, if transform
+    /// cache is disabled.
+    QByteArray m_deviceLinkCacheKey;
+
+    mutable QReadWriteLock m_integerTransformCacheLock;
+    mutable std::map<QByteArray, cmsHTRANSFORM> m_integerTransformCache;
+
+    /// Transforms from profiles to the output profile, which are bypassed
+    std::array<bool, ProfileCount> m_isIdentityTransform = { };
+
+    mutable std::atomic<quint64> m_colorCacheHits = 0;
+    mutable std::atomic<quint64> m_colorCacheMisses = 0;
+    mutable std::atomic<quint64> m_bypassedConversions = 0;
+};
+
+/// Thread local cache of colors converted by the color management system. Pages
+/// usually use a few fill and stroke colors, which are set many times, so instead
+/// of locking the transformation cache and transforming single color each time,
+/// converted colors are memoized. Cache is direct mapped and each thread has its own
+/// cache, so no locking is needed. Color components are quantized.
+class PDFCMSColorCache
+{
+public:
+    struct Key
+    {
+        quint64 serialNumber = 0;
+        int profile = 0;
+        int intent = 0;
+        QByteArray iccID;
+        std::array<qint32, 4> components = { };
+        size_t componentCount = 0;
+
+        bool operator==(const Key&) const = default;
+    };
+
+    /// Creates key for the color. Returns false, if color can't be cached.
+    static bool createKey(quint64 serialNumber, int profile, RenderingIntent intent, const QByteArray& iccID, const PDFColor& color, Key& key);
+
+    /// Finds color in the cache of the current thread
+    static bool find(const Key& key, QColor& color);
+
+    /// Inserts color into the cache of the current thread
+    static void insert(const Key& key, const QColor& color);
+
+private:
+    struct Entry
+    {
+        Key key;
+        QColor color;
+    };
+
+    static constexpr size_t CACHE_SIZE = 256;
+    static constexpr float QUANTIZATION_FACTOR = 65536.0f;
+
+    static size_t getIndex(const Key& key);
+    static std::array<Entry, CACHE_SIZE>& getCache();
+};
+
+bool PDFCMSColorCache::createKey(quint64 serialNumber, int profile, RenderingIntent intent, const QByteArray& iccID, const PDFColor& color, Key& key)
+{
+    if (color.size() > key.components.size())
+    {
+        return false;
+    }
+
+    key.serialNumber = serialNumber;
+    key.profile = profile;
+    key.intent = int(intent);
+    key.iccID = iccID;
+    key.componentCount = color.size();
+    for (size_t i = 0; i < color.size(); ++i)
+    {
+        const float value = color[i];
+        if (!std::isfinite(value) || std::abs(value) > 1024.0f)
+        {
+            return false;
+        }
+
+        key.components[i] = static_cast<qint32>(std::lround(value * QUANTIZATION_FACTOR));
+    }
+
+    return true;
+}
+
+bool PDFCMSColorCache::find(const Key& key, QColor& color)
+{
+    const Entry& entry = getCache()[getIndex(key)];
+    if (entry.key.serialNumber != 0 && entry.key == key)
+    {
+        color = entry.color;
+        return true;
+    }
+
+    return false;
+}
+
+void PDFCMSColorCache::insert(const Key& key, const QColor& color)
+{
+    Entry& entry = getCache()[getIndex(key)];
+    entry.key = key;
+    entry.color = color;
+}
+
+size_t PDFCMSColorCache::getIndex(const Key& key)
+{
+    // FNV-1a hash of the key (icc profile id is not hashed, colors
+    // with different icc profiles are distinguished by key comparison)
+    quint64 hash = 14695981039346656037ULL;
+    auto addToHash = [&hash](quint64 value)
+    {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+
+    addToHash(key.serialNumber);
+    addToHash(quint64(key.profile));
+    addToHash(quint64(key.intent));
+    for (size_t i = 0; i < key.componentCount; ++i)
+    {
+        addToHash(quint64(quint32(key.components[i])));
+    }
+
+    return size_t(hash ^ (hash >> 32)) % CACHE_SIZE;
+}
+
+std::array<PDFCMSColorCache::Entry, PDFCMSColorCache::CACHE_SIZE>& PDFCMSColorCache::getCache()
+{
+    thread_local std::array<Entry, CACHE_SIZE> cache;
+    return cache;
+}
+
+template<typename ConvertFunction>
+QColor PDFLittleCMS::getCachedColor(Profile profile, const QByteArray& iccID, RenderingIntent intent, const PDFColor& color, ConvertFunction convert) const
+{
+    PDFCMSColorCache::Key key;
+    if (!PDFCMSColorCache::createKey(getSerialNumber(), profile, getEffectiveRenderingIntent(intent), iccID, color, key))
+    {
+        return convert();
+    }
+
+    QColor result;
+    if (PDFCMSColorCache::find(key, result))
+    {
+        m_colorCacheHits.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    m_colorCacheMisses.fetch_add(1, std::memory_order_relaxed);
+    result = convert();
+
+    // Invalid colors are not cached, so errors are always reported
+    if (result.isValid())
+    {
+        PDFCMSColorCache::insert(key, result);
+    }
+
+    return result;
+}
+
+/// Kernels of the identity transforms. Color components in range [0, 1]
+/// are scaled to 8-bit values, gray values are replicated to RGB triplets.
+class PDFCMSIdentityKernels
+{
+public:
+    /// Scales color components to 8-bit values
+    /// \param colors Color components
+    /// \param output Output 8-bit values
+    /// \param count Number of color components
+    static void packRGB(const float* colors, unsigned char* output, size_t count);
+
+    /// Scales gray values to 8-bit RGB triplets
+    /// \param colors Gray values
+    /// \param output Output 8-bit RGB triplets
+    /// \param count Number of gray values
+    static void packGrayToRGB(const float* colors, unsigned char* output, size_t count);
+
+    /// Unpacks image line with integer gray or RGB samples to 8-bit RGB triplets
+    /// \param input Input samples (16-bit samples are big endian)
+    /// \param output Output 8-bit RGB triplets
+    /// \param width Number of pixels
+    /// \param componentCount Number of color components (1 or 3)
+    /// \param bitsPerComponent Bits per component (8 or 16)
+    static void unpackImageLine(const unsigned char* input, unsigned char* output, size_t width, size_t componentCount, int bitsPerComponent);
+
+    /// Scales color component to 8-bit value. Halves are rounded up, the same
+    /// way as in the vectorized kernels (value is non-negative after clamping,
+    /// so truncation after adding one half rounds it).
+    /// \param value Color component
+    static unsigned char pack(float value) { return static_cast<unsigned char>(qBound(0.0f, value, 1.0f) * 255.0f + 0.5f); }
+
+private:
+    static void packRGBScalar(const float* colors, unsigned char* output, size_t count);
+
+#if defined(PDF4QT_SIMD_SSE2)
+    static void packRGBSSE2(const float* colors, unsigned char* output, size_t count);
+#endif
 };
 
+void PDFCMSIdentityKernels::packRGB(const float* colors, unsigned char* output, size_t count)
+{
+    switch (PDFSimd::getInstructionSet())
+    {
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+        case PDFSimd::InstructionSet::AVX2:
+            packRGBSSE2(colors, output, count);
+            break;
+#endif
+
+        default:
+            packRGBScalar(colors, output, count);
+            break;
+    }
+}
+
+void PDFCMSIdentityKernels::packGrayToRGB(const float* colors, unsigned char* output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const unsigned char value = pack(colors[i]);
+        *output++ = value;
+        *output++ = value;
+        *output++ = value;
+    }
+}
+
+void PDFCMSIdentityKernels::unpackImageLine(const unsigned char* input, unsigned char* output, size_t width, size_t componentCount, int bitsPerComponent)
+{
+    const size_t sampleCount = width * componentCount;
+
+    if (bitsPerComponent == 8 && componentCount == 3)
+    {
+        std::copy(input, input + sampleCount, output);
+        return;
+    }
+
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        unsigned char value = input[i];
+
+        if (bitsPerComponent == 16)
+        {
+            const quint32 sample = (quint32(input[2 * i]) << 8) | quint32(input[2 * i + 1]);
+            value = static_cast<unsigned char>((sample * 255 + 32767) / 65535);
+        }
+
+        *output++ = value;
+
+        if (componentCount == 1)
+        {
+            *output++ = value;
+            *output++ = value;
+        }
+    }
+}
+
+void PDFCMSIdentityKernels::packRGBScalar(const float* colors, unsigned char* output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        output[i] = pack(colors[i]);
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+void PDFCMSIdentityKernels::packRGBSSE2(const float* colors, unsigned char* output, size_t count)
+{
+    // Sixteen color components are packed at once, the rest is packed by scalar code.
+    // Results must be the same as results of the scalar code, so halves are rounded
+    // up by truncation (not to even, as _mm_cvtps_epi32 does).
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    auto convert = [&](const float* data)
+    {
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(data), zero), one), scale), half));
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i low = _mm_packs_epi32(convert(colors + i), convert(colors + i + 4));
+        const __m128i high = _mm_packs_epi32(convert(colors + i + 8), convert(colors + i + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(low, high));
+    }
+
+    packRGBScalar(colors + i, output + i, count - i);
+}
+#endif
+
+PDFCMS::ColorCacheStatistics PDFLittleCMS::getColorCacheStatistics() const
+{
+    ColorCacheStatistics statistics;
+    statistics.hits = m_colorCacheHits.load(std::memory_order_relaxed);
+    statistics.misses = m_colorCacheMisses.load(std::memory_order_relaxed);
+    statistics.bypassed = m_bypassedConversions.load(std::memory_order_relaxed);
+    statistics.isDeviceGrayIdentity = m_isIdentityTransform[Gray];
+    statistics.isDeviceRGBIdentity = m_isIdentityTransform[RGB];
+    return statistics;
+}
+
+QColor PDFLittleCMS::getColorFromDeviceGray(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+{
+    return getCachedColor(Gray, QByteArray(), intent, color, [&]() { return convertColorFromDeviceGray(color, intent, reporter); });
+}
+
+QColor PDFLittleCMS::getColorFromDeviceRGB(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+{
+    return getCachedColor(RGB, QByteArray(), intent, color, [&]() { return convertColorFromDeviceRGB(color, intent, reporter); });
+}
+
+QColor PDFLittleCMS::getColorFromDeviceCMYK(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+{
+    return getCachedColor(CMYK, QByteArray(), intent, color, [&]() { return convertColorFromDeviceCMYK(color, intent, reporter); });
+}
+
+QColor PDFLittleCMS::getColorFromICC(const PDFColor& color, RenderingIntent renderingIntent, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
+{
+    if (iccID.isEmpty())
+    {
+        return convertColorFromICC(color, renderingIntent, iccID, iccData, reporter);
+    }
+
+    return getCachedColor(ProfileCount, iccID, renderingIntent, color, [&]() { return convertColorFromICC(color, renderingIntent, iccID, iccData, reporter); });
+}
+
 bool PDFLittleCMS::fillRGBBufferFromDeviceGray(const std::vector<float>& colors,
                                                RenderingIntent intent,
                                                unsigned char* outputBuffer,
                                                PDFRenderErrorReporter* reporter) const
 {
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
+    if (m_isIdentityTransform[Gray])
+    {
+        PDFCMSIdentityKernels::packGrayToRGB(colors.data(), outputBuffer, colors.size());
+        m_bypassedConversions.fetch_add(colors.size(), std::memory_order_relaxed);
+        return true;
+    }
+
     cmsHTRANSFORM transform = getTransform(Gray, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -210,6 +626,15 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceGray(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
+    if (m_isIdentityTransform[RGB] && colors.size() % 3 == 0)
+    {
+        PDFCMSIdentityKernels::packRGB(colors.data(), outputBuffer, colors.size());
+        m_bypassedConversions.fetch_add(colors.size() / 3, std::memory_order_relaxed);
+        return true;
+    }
+
     cmsHTRANSFORM transform = getTransform(RGB, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -235,6 +660,8 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
     cmsHTRANSFORM transform = getTransform(CMYK, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -265,6 +692,8 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
     cmsHTRANSFORM transform = getTransform(XYZ, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -307,6 +736,8 @@ bool PDFLittleCMS::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::
 
 bool PDFLittleCMS::fillRGBBufferFromICC(const std::vector<float>& colors, RenderingIntent renderingIntent, unsigned char* outputBuffer, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
 {
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
     cmsHTRANSFORM transform = getTransformFromICCProfile(iccData, iccID, renderingIntent, true);
 
     if (!transform)
@@ -348,6 +779,8 @@ bool PDFLittleCMS::fillRGBBufferFromICC(const std::vector<float>& colors, Render
 
 bool PDFLittleCMS::transformColorSpace(const PDFCMS::ColorSpaceTransformParams& params) const
 {
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
     PDFCMS::ColorSpaceTransformParams transformedParams = params;
     transformedParams.intent = getEffectiveRenderingIntent(transformedParams.intent);
 
@@ -502,6 +935,15 @@ PDFLittleCMS::~PDFLittleCMS()
         }
     }
 
+    for (const auto& transformItem : m_integerTransformCache)
+    {
+        cmsHTRANSFORM transform = transformItem.second;
+        if (transform)
+        {
+            cmsDeleteTransform(transform);
+        }
+    }
+
     for (cmsHPROFILE profile : m_profiles)
     {
         if (profile)
@@ -521,8 +963,14 @@ QColor PDFLittleCMS::getPaperColor() const
     return m_paperColor;
 }
 
-QColor PDFLittleCMS::getColorFromDeviceGray(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+QColor PDFLittleCMS::convertColorFromDeviceGray(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
+    if (m_isIdentityTransform[Gray] && color.size() == 1)
+    {
+        m_bypassedConversions.fetch_add(1, std::memory_order_relaxed);
+        return getColorFromOutputColor({ color[0], color[0], color[0] });
+    }
+
     cmsHTRANSFORM transform = getTransform(Gray, getEffectiveRenderingIntent(intent), false);
 
     if (!transform)
@@ -548,8 +996,14 @@ QColor PDFLittleCMS::getColorFromDeviceGray(const PDFColor& color, RenderingInte
     return QColor();
 }
 
-QColor PDFLittleCMS::getColorFromDeviceRGB(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+QColor PDFLittleCMS::convertColorFromDeviceRGB(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
+    if (m_isIdentityTransform[RGB] && color.size() == 3)
+    {
+        m_bypassedConversions.fetch_add(1, std::memory_order_relaxed);
+        return getColorFromOutputColor({ color[0], color[1], color[2] });
+    }
+
     cmsHTRANSFORM transform = getTransform(RGB, getEffectiveRenderingIntent(intent), false);
 
     if (!transform)
@@ -575,7 +1029,7 @@ QColor PDFLittleCMS::getColorFromDeviceRGB(const PDFColor& color, RenderingInten
     return QColor();
 }
 
-QColor PDFLittleCMS::getColorFromDeviceCMYK(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+QColor PDFLittleCMS::convertColorFromDeviceCMYK(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
     cmsHTRANSFORM transform = getTransform(CMYK, getEffectiveRenderingIntent(intent), false);
 
@@ -652,24 +1106,7 @@ cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData
             {
                 if (const cmsUInt32Number inputDataFormat = getProfileDataFormat(profile))
                 {
-                    cmsUInt32Number lcmsIntent = getLittleCMSRenderingIntent(effectiveRenderingIntent);
-
-                    if (isSoftProofing())
-                    {
-                        cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
-                        RenderingIntent proofingIntent = m_settings.proofingIntent;
-                        if (m_settings.proofingIntent == RenderingIntent::Auto)
-                        {
-                            proofingIntent = effectiveRenderingIntent;
-                        }
-
-                        transform = cmsCreateProofingTransform(profile, inputDataFormat, m_profiles[Output], isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
-                                                               lcmsIntent, getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
-                    }
-                    else
-                    {
-                        transform = cmsCreateTransform(profile, inputDataFormat, m_profiles[Output], isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, lcmsIntent, getTransformationFlags());
-                    }
+                    transform = createTransform(profile, inputDataFormat, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, effectiveRenderingIntent);
                 }
                 cmsCloseProfile(profile);
             }
@@ -687,7 +1124,7 @@ cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData
     return cmsHTRANSFORM();
 }
 
-QColor PDFLittleCMS::getColorFromICC(const PDFColor& color, RenderingIntent renderingIntent, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
+QColor PDFLittleCMS::convertColorFromICC(const PDFColor& color, RenderingIntent renderingIntent, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
 {
     cmsHTRANSFORM transform = getTransformFromICCProfile(iccData, iccID, renderingIntent, false);
 
@@ -731,6 +1168,29 @@ void PDFLittleCMS::init()
     m_profiles[SoftProofing] = createProfile(m_settings.softProofingProfile, m_manager->getCMYKProfiles(), false);
     m_profiles[XYZ] = cmsCreateXYZProfile();
 
+    // Device link profiles can't contain gamut check, so transforms
+    // are cached only, if gamut checking is turned off.
+    if (!m_settings.transformCacheDirectory.isEmpty() && !m_settings.isGamutChecking && m_profiles[Output])
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(QByteArray::number(LCMS_VERSION));
+        hash.addData(QByteArray::number(getTransformationFlags()));
+        hash.addData(getProfileData(m_profiles[Output]));
+
+        if (isSoftProofing())
+        {
+            hash.addData(QByteArray::number(int(m_settings.proofingIntent)));
+            hash.addData(getProfileData(m_profiles[SoftProofing]));
+        }
+
+        m_deviceLinkCacheKey = hash.result();
+    }
+
+    // Transforms, which don't change colors (for example, from sRGB
+    // to sRGB display), are bypassed, colors are only scaled and packed.
+    m_isIdentityTransform[Gray] = isIdentityTransform(Gray);
+    m_isIdentityTransform[RGB] = isIdentityTransform(RGB);
+
     cmsUInt16Number outOfGamutR = m_settings.outOfGamutColor.redF() * 0xFFFF;
     cmsUInt16Number outOfGamutG = m_settings.outOfGamutColor.greenF() * 0xFFFF;
     cmsUInt16Number outOfGamutB = m_settings.outOfGamutColor.blueF() * 0xFFFF;
@@ -973,22 +1433,7 @@ cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent
 
             if (input && output)
             {
-                if (isSoftProofing())
-                {
-                    cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
-                    RenderingIntent proofingIntent = m_settings.proofingIntent;
-                    if (m_settings.proofingIntent == RenderingIntent::Auto)
-                    {
-                        proofingIntent = intent;
-                    }
-
-                    transform = cmsCreateProofingTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
-                                                           getLittleCMSRenderingIntent(intent), getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
-                }
-                else
-                {
-                    transform = cmsCreateTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, getLittleCMSRenderingIntent(intent), getTransformationFlags());
-                }
+                transform = createTransform(input, getProfileDataFormat(input), isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, intent);
             }
 
             it = m_transformationCache.insert(std::make_pair(key, transform)).first;
@@ -1002,6 +1447,216 @@ cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent
     return it->second;
 }
 
+cmsHTRANSFORM PDFLittleCMS::createTransform(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsUInt32Number outputFormat, RenderingIntent intent) const
+{
+    const QString deviceLinkFileName = getDeviceLinkFileName(input, inputFormat, outputFormat, intent);
+    const cmsUInt32Number lcmsIntent = getLittleCMSRenderingIntent(intent);
+    const cmsUInt32Number deviceLinkFlags = getTransformationFlags() & ~(cmsFLAGS_SOFTPROOFING | cmsFLAGS_GAMUTCHECK);
+
+    if (!deviceLinkFileName.isEmpty())
+    {
+        QFile file(deviceLinkFileName);
+        if (file.open(QFile::ReadOnly))
+        {
+            QByteArray data = file.readAll();
+            file.close();
+
+            if (cmsHPROFILE deviceLink = cmsOpenProfileFromMem(data.constData(), data.size()))
+            {
+                cmsHTRANSFORM transform = cmsCreateTransform(deviceLink, inputFormat, nullptr, outputFormat, lcmsIntent, deviceLinkFlags);
+                cmsCloseProfile(deviceLink);
+
+                if (transform)
+                {
+                    return transform;
+                }
+            }
+        }
+    }
+
+    cmsHTRANSFORM transform = cmsHTRANSFORM();
+    if (isSoftProofing())
+    {
+        cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
+        RenderingIntent proofingIntent = m_settings.proofingIntent;
+        if (m_settings.proofingIntent == RenderingIntent::Auto)
+        {
+            proofingIntent = intent;
+        }
+
+        transform = cmsCreateProofingTransform(input, inputFormat, m_profiles[Output], outputFormat, proofingProfile,
+                                               lcmsIntent, getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
+    }
+    else
+    {
+        transform = cmsCreateTransform(input, inputFormat, m_profiles[Output], outputFormat, lcmsIntent, getTransformationFlags());
+    }
+
+    if (transform && !deviceLinkFileName.isEmpty())
+    {
+        // Store the device link profile. Errors are ignored, cache
+        // is only an optimization, and transform was created successfully.
+        if (cmsHPROFILE deviceLink = cmsTransform2DeviceLink(transform, 4.3, 0))
+        {
+            QByteArray data = getProfileData(deviceLink);
+            cmsCloseProfile(deviceLink);
+
+            if (!data.isEmpty() && QDir().mkpath(m_settings.transformCacheDirectory))
+            {
+                QSaveFile file(deviceLinkFileName);
+                if (file.open(QFile::WriteOnly))
+                {
+                    file.write(data);
+                    file.commit();
+                }
+            }
+        }
+    }
+
+    return transform;
+}
+
+QString PDFLittleCMS::getDeviceLinkFileName(cmsHPROFILE input, cmsUInt32Number inputFormat, cmsUInt32Number outputFormat, RenderingIntent intent) const
+{
+    if (m_deviceLinkCacheKey.isEmpty())
+    {
+        return QString();
+    }
+
+    QByteArray inputProfileData = getProfileData(input);
+    if (inputProfileData.isEmpty())
+    {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_deviceLinkCacheKey);
+    hash.addData(inputProfileData);
+    hash.addData(QByteArray::number(inputFormat));
+    hash.addData(QByteArray::number(outputFormat));
+    hash.addData(QByteArray::number(int(intent)));
+
+    return QDir(m_settings.transformCacheDirectory).filePath(QString::fromLatin1(hash.result().toHex()) + QLatin1String(".icc"));
+}
+
+QByteArray PDFLittleCMS::getProfileData(cmsHPROFILE profile)
+{
+    QByteArray data;
+    cmsUInt32Number size = 0;
+
+    if (profile && cmsSaveProfileToMem(profile, nullptr, &size) && size > 0)
+    {
+        data.resize(size);
+        if (!cmsSaveProfileToMem(profile, data.data(), &size))
+        {
+            data.clear();
+        }
+    }
+
+    return data;
+}
+
+QByteArray PDFLittleCMS::getProfileHash(cmsHPROFILE profile)
+{
+    // Size of the profile header, see ICC specification
+    constexpr int PROFILE_HEADER_SIZE = 128;
+
+    QByteArray data = getProfileData(profile);
+    if (data.size() <= PROFILE_HEADER_SIZE)
+    {
+        return QByteArray();
+    }
+
+    return QCryptographicHash::hash(data.mid(PROFILE_HEADER_SIZE), QCryptographicHash::Md5);
+}
+
+bool PDFLittleCMS::isIdentityTransform(Profile profile) const
+{
+    cmsHPROFILE input = m_profiles[profile];
+    cmsHPROFILE output = m_profiles[Output];
+
+    // Soft proofing and gamut checking change colors even for the same profiles
+    if (!input || !output || isSoftProofing() || cmsGetColorSpace(output) != cmsSigRgbData)
+    {
+        return false;
+    }
+
+    const cmsColorSpaceSignature inputColorSpace = cmsGetColorSpace(input);
+    const bool isGray = inputColorSpace == cmsSigGrayData;
+    if (!isGray && inputColorSpace != cmsSigRgbData)
+    {
+        return false;
+    }
+
+    if (!isGray)
+    {
+        QByteArray inputHash = getProfileHash(input);
+        if (!inputHash.isEmpty() && inputHash == getProfileHash(output))
+        {
+            return true;
+        }
+    }
+
+    // Other identity transforms are detected by sampling, every sample must be
+    // converted exactly to the value, which identity kernels produce. Rendering
+    // intents of matrix shaper profiles differ only in the white point adaptation
+    // of absolute colorimetric intent, so both colorimetric intents are checked.
+    if (!cmsIsMatrixShaper(input) || !cmsIsMatrixShaper(output))
+    {
+        return false;
+    }
+
+    constexpr int STEPS = 8;
+    std::vector<float> samples;
+    if (isGray)
+    {
+        for (int i = 0; i <= STEPS * STEPS; ++i)
+        {
+            samples.push_back(float(i) / (STEPS * STEPS));
+        }
+    }
+    else
+    {
+        for (int r = 0; r <= STEPS; ++r)
+        {
+            for (int g = 0; g <= STEPS; ++g)
+            {
+                for (int b = 0; b <= STEPS; ++b)
+                {
+                    samples.insert(samples.end(), { float(r) / STEPS, float(g) / STEPS, float(b) / STEPS });
+                }
+            }
+        }
+    }
+
+    const size_t pixelCount = isGray ? samples.size() : samples.size() / 3;
+    std::vector<unsigned char> result(pixelCount * 3, 0);
+
+    for (RenderingIntent intent : { RenderingIntent::RelativeColorimetric, RenderingIntent::AbsoluteColorimetric })
+    {
+        cmsHTRANSFORM transform = cmsCreateTransform(input, isGray ? TYPE_GRAY_FLT : TYPE_RGB_FLT, output, TYPE_RGB_8,
+                                                     getLittleCMSRenderingIntent(intent), getTransformationFlags());
+        if (!transform)
+        {
+            return false;
+        }
+
+        cmsDoTransform(transform, samples.data(), result.data(), static_cast<cmsUInt32Number>(pixelCount));
+        cmsDeleteTransform(transform);
+
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            const float sample = isGray ? samples[i / 3] : samples[i];
+            if (result[i] != PDFCMSIdentityKernels::pack(sample))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 cmsUInt32Number PDFLittleCMS::getTransformationFlags() const
 {
     // Flag cmsFLAGS_NONEGATIVES is used here to avoid invalid transformation
@@ -1102,6 +1757,145 @@ cmsUInt32Number PDFLittleCMS::getProfileDataFormat(cmsHPROFILE profile)
     return 0;
 }
 
+cmsUInt32Number PDFLittleCMS::getProfileIntegerDataFormat(cmsHPROFILE profile, int bitsPerComponent)
+{
+    // 16-bit samples in PDF are big endian
+    constexpr bool isSwapEndianNeeded = Q_BYTE_ORDER == Q_LITTLE_ENDIAN;
+
+    cmsColorSpaceSignature signature = cmsGetColorSpace(profile);
+    switch (signature)
+    {
+        case cmsSigGrayData:
+            return bitsPerComponent == 8 ? TYPE_GRAY_8 : (isSwapEndianNeeded ? TYPE_GRAY_16_SE : TYPE_GRAY_16);
+
+        case cmsSigRgbData:
+            return bitsPerComponent == 8 ? TYPE_RGB_8 : (isSwapEndianNeeded ? TYPE_RGB_16_SE : TYPE_RGB_16);
+
+        case cmsSigCmykData:
+            return bitsPerComponent == 8 ? TYPE_CMYK_8 : (isSwapEndianNeeded ? TYPE_CMYK_16_SE : TYPE_CMYK_16);
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+cmsHTRANSFORM PDFLittleCMS::getIntegerTransform(const ImageLinesTransformParams& params) const
+{
+    const RenderingIntent intent = getEffectiveRenderingIntent(params.intent);
+
+    QByteArray key;
+    key.append(char(params.sourceType));
+    key.append(char(params.bitsPerComponent));
+    key.append(char(intent));
+    key.append(params.sourceIccId);
+
+    QReadLocker lock(&m_integerTransformCacheLock);
+    auto it = m_integerTransformCache.find(key);
+    if (it != m_integerTransformCache.cend())
+    {
+        return it->second;
+    }
+
+    lock.unlock();
+    QWriteLocker writeLock(&m_integerTransformCacheLock);
+
+    // Now, we have locked cache for writing. We must find out,
+    // if some other thread doesn't created the transformation already.
+    it = m_integerTransformCache.find(key);
+    if (it == m_integerTransformCache.cend())
+    {
+        cmsHTRANSFORM transform = cmsHTRANSFORM();
+        cmsHPROFILE input = cmsHPROFILE();
+        bool isInputProfileOwned = false;
+
+        switch (params.sourceType)
+        {
+            case ColorSpaceType::DeviceGray:
+                input = m_profiles[Gray];
+                break;
+
+            case ColorSpaceType::DeviceRGB:
+                input = m_profiles[RGB];
+                break;
+
+            case ColorSpaceType::DeviceCMYK:
+                input = m_profiles[CMYK];
+                break;
+
+            case ColorSpaceType::ICC:
+                input = cmsOpenProfileFromMem(params.sourceIccData.data(), params.sourceIccData.size());
+                isInputProfileOwned = true;
+                break;
+
+            default:
+                break;
+        }
+
+        cmsHPROFILE output = m_profiles[Output];
+        const cmsUInt32Number inputFormat = input ? getProfileIntegerDataFormat(input, params.bitsPerComponent) : 0;
+
+        if (input && output && inputFormat)
+        {
+            transform = createTransform(input, inputFormat, TYPE_RGB_8, intent);
+        }
+
+        if (input && isInputProfileOwned)
+        {
+            cmsCloseProfile(input);
+        }
+
+        it = m_integerTransformCache.insert(std::make_pair(key, transform)).first;
+    }
+
+    return it->second;
+}
+
+bool PDFLittleCMS::fillRGBImageLines(const ImageLinesTransformParams& params) const
+{
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ColorManagement);
+
+    if (params.bitsPerComponent != 8 && params.bitsPerComponent != 16)
+    {
+        return false;
+    }
+
+    const bool isIdentityGray = params.sourceType == ColorSpaceType::DeviceGray && m_isIdentityTransform[Gray] && params.componentCount == 1;
+    const bool isIdentityRGB = params.sourceType == ColorSpaceType::DeviceRGB && m_isIdentityTransform[RGB] && params.componentCount == 3;
+    if (isIdentityGray || isIdentityRGB)
+    {
+        for (size_t i = 0; i < params.lineCount; ++i)
+        {
+            PDFCMSIdentityKernels::unpackImageLine(params.input + i * params.inputStride, params.output + i * params.outputStride,
+                                                   params.width, params.componentCount, params.bitsPerComponent);
+        }
+
+        m_bypassedConversions.fetch_add(params.width * params.lineCount, std::memory_order_relaxed);
+        return true;
+    }
+
+    cmsHTRANSFORM transform = getIntegerTransform(params);
+    if (!transform)
+    {
+        return false;
+    }
+
+    Q_ASSERT(cmsGetTransformOutputFormat(transform) == TYPE_RGB_8);
+
+    if (T_CHANNELS(cmsGetTransformInputFormat(transform)) != params.componentCount)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < params.lineCount; ++i)
+    {
+        cmsDoTransform(transform, params.input + i * params.inputStride, params.output + i * params.outputStride, static_cast<cmsUInt32Number>(params.width));
+    }
+
+    return true;
+}
+
 QColor PDFLittleCMS::getColorFromOutputColor(std::array<float, 3> color01)
 {
     QColor color(QColor::Rgb);
@@ -1391,6 +2185,70 @@ PDFColorConvertor PDFCMSGeneric::getColorConvertor() const
     return m_colorConvertor;
 }
 
+/// Storage of color management systems shared by all documents (and all
+/// CMS managers) of the process. Color management systems with the same
+/// settings and output intent profiles are shared, so color profiles and
+/// transformations are created only once. Color management systems are
+/// reference counted, they are released, when no document uses them.
+class PDFSharedCMSStorage
+{
+public:
+    /// Returns instance of storage
+    static PDFSharedCMSStorage* getInstance();
+
+    /// Returns shared color management system for given settings and output
+    /// intent profiles. If it doesn't exist, it is created using \p create
+    /// function and registered. This function is thread safe.
+    /// \param settings Color management system settings
+    /// \param outputIntentProfiles Output intent profiles of the document
+    /// \param create Create function
+    template<typename CreateFunction>
+    PDFCMSPointer getCMS(const PDFCMSSettings& settings, const PDFColorProfileIdentifiers& outputIntentProfiles, CreateFunction create);
+
+private:
+    explicit PDFSharedCMSStorage() = default;
+
+    struct Entry
+    {
+        PDFCMSSettings settings;
+        PDFColorProfileIdentifiers outputIntentProfiles;
+        QWeakPointer<PDFCMS> cms;
+    };
+
+    QMutex m_mutex;
+    std::vector<Entry> m_entries;
+};
+
+PDFSharedCMSStorage* PDFSharedCMSStorage::getInstance()
+{
+    static PDFSharedCMSStorage instance;
+    return &instance;
+}
+
+template<typename CreateFunction>
+PDFCMSPointer PDFSharedCMSStorage::getCMS(const PDFCMSSettings& settings, const PDFColorProfileIdentifiers& outputIntentProfiles, CreateFunction create)
+{
+    QMutexLocker lock(&m_mutex);
+
+    // Remove color management systems, which are not used anymore
+    std::erase_if(m_entries, [](const Entry& entry) { return entry.cms.isNull(); });
+
+    for (const Entry& entry : m_entries)
+    {
+        if (entry.settings == settings && entry.outputIntentProfiles == outputIntentProfiles)
+        {
+            if (PDFCMSPointer cms = entry.cms.toStrongRef())
+            {
+                return cms;
+            }
+        }
+    }
+
+    PDFCMSPointer cms = create();
+    m_entries.push_back(Entry{ settings, outputIntentProfiles, cms.toWeakRef() });
+    return cms;
+}
+
 PDFCMSManager::PDFCMSManager(QObject* parent) :
     BaseClass(parent),
     m_document(nullptr),
@@ -1615,7 +2473,12 @@ PDFCMSPointer PDFCMSManager::getCurrentCMSImpl() const
             return PDFCMSPointer(new PDFCMSGeneric(getColorConvertor()));
 
         case PDFCMSSettings::System::LittleCMS2:
-            return PDFCMSPointer(new PDFLittleCMS(this, m_settings, getColorConvertor()));
+        {
+            // Color management system doesn't depend on the document,
+            // only on settings and output intents, so it is shared between documents.
+            auto create = [this]() { return PDFCMSPointer(new PDFLittleCMS(this, m_settings, getColorConvertor())); };
+            return PDFSharedCMSStorage::getInstance()->getCMS(m_settings, m_outputIntentProfiles, create);
+        }
 
         default:
             Q_ASSERT(false);
@@ -84,6 +84,7 @@ struct PDFCMSSettings
     QString deviceCMYK;             ///< Identifiers for color space (device CMYK)
     QString softProofingProfile;    ///< Identifiers for soft proofing profile
     QString profileDirectory;       ///< Directory containing color profiles
+    QString transformCacheDirectory; ///< Directory, where precomputed transforms are stored (empty = disabled)
 
     // Postprocessing
     QColor foregroundColor = Qt::green;
@@ -98,9 +99,14 @@ struct PDFCMSSettings
 class PDFCMS
 {
 public:
-    explicit inline PDFCMS() = default;
+    explicit PDFCMS();
     virtual ~PDFCMS() = default;
 
+    /// Returns unique serial number of the color management system. Serial
+    /// number identifies the color management system instance, so colors
+    /// converted by the color management system can be cached.
+    quint64 getSerialNumber() const { return m_serialNumber; }
+
     /// This function should decide, if color management system is compatible with these
     /// settings (so, it transforms colors according to this setting). If this
     /// function returns false, then this color management system should be replaced
@@ -258,8 +264,51 @@ public:
     /// it just transforms two float buffers from input color space to output color space.
     virtual bool transformColorSpace(const ColorSpaceTransformParams& params) const = 0;
 
+    struct ImageLinesTransformParams
+    {
+        ColorSpaceType sourceType = ColorSpaceType::Invalid;
+
+        QByteArray sourceIccId;
+        QByteArray sourceIccData;
+
+        size_t componentCount = 0;              ///< Number of color components of the input
+        int bitsPerComponent = 8;               ///< Bits per component (8 or 16, 16-bit samples are big endian)
+        const unsigned char* input = nullptr;   ///< Input image lines
+        size_t inputStride = 0;                 ///< Number of bytes per input line
+        unsigned char* output = nullptr;        ///< Output 8-bit RGB image lines
+        size_t outputStride = 0;                ///< Number of bytes per output line
+        size_t width = 0;                       ///< Number of pixels per line
+        size_t lineCount = 0;                   ///< Number of lines
+
+        RenderingIntent intent = RenderingIntent::Unknown;
+    };
+
+    /// Transforms image lines with integer color components (8 or 16 bits per component)
+    /// directly to the 8-bit RGB output, without conversion to floating point colors.
+    /// Source color space must be DeviceGray, DeviceRGB, DeviceCMYK or ICC. If transformation
+    /// is not supported, false is returned (no error is reported) and caller should use
+    /// floating point transformation. Default implementation doesn't support it.
+    virtual bool fillRGBImageLines(const ImageLinesTransformParams& params) const { Q_UNUSED(params); return false; }
+
     /// Get D50 white point for XYZ color space
     static PDFColor3 getDefaultXYZWhitepoint();
+
+    struct ColorCacheStatistics
+    {
+        quint64 hits = 0;                   ///< Number of colors found in the cache
+        quint64 misses = 0;                 ///< Number of colors converted by the color management system
+        quint64 bypassed = 0;               ///< Number of colors and pixels, which were not converted, because transform is identity
+        bool isDeviceGrayIdentity = false;  ///< Transform from DeviceGray to the output device is identity
+        bool isDeviceRGBIdentity = false;   ///< Transform from DeviceRGB to the output device is identity
+    };
+
+    /// Returns statistics of the cache of single color conversions (fill and stroke
+    /// colors, colors of text) and of the identity transforms, which are bypassed.
+    /// Default implementation doesn't cache colors.
+    virtual ColorCacheStatistics getColorCacheStatistics() const { return ColorCacheStatistics(); }
+
+private:
+    quint64 m_serialNumber = 0;
 };
 
 using PDFCMSPointer = QSharedPointer<PDFCMS>;
@@ -18,13 +18,149 @@
 #include "pdfcolorconvertor.h"
 #include "pdfimageconversion.h"
 #include "pdfutils.h"
+#include "pdfsimd.h"
+#include "pdfexecutionpolicy.h"
 #include "pdfdbgheap.h"
 
 #include <cmath>
+#include <array>
 
 namespace pdf
 {
 
+/// SIMD kernels for image color conversion. Kernels work on 32-bit
+/// pixels, either premultiplied or not.
+class PDFColorConvertorKernels
+{
+public:
+    /// Converts pixels to grayscale (alpha is preserved). Gray value
+    /// is computed in the same way as qGray.
+    /// \param pixels Pixels
+    /// \param count Pixel count
+    static void convertToGrayscale(QRgb* pixels, int count);
+
+private:
+#if defined(PDF4QT_SIMD_SSE2)
+    static __m128i convertToGrayscaleSSE2(__m128i pixels)
+    {
+        // Weighted sum fits into 16 bits, so we can use 16-bit multiplication
+        // on 32-bit values (upper halves of the values are zero).
+        const __m128i mask = _mm_set1_epi32(0xFF);
+        const __m128i b = _mm_mullo_epi16(_mm_and_si128(pixels, mask), _mm_set1_epi32(5));
+        const __m128i g = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask), _mm_set1_epi32(16));
+        const __m128i r = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask), _mm_set1_epi32(11));
+        const __m128i gray = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(r, g), b), 5);
+        const __m128i alpha = _mm_and_si128(pixels, _mm_set1_epi32(int(0xFF000000)));
+        return _mm_or_si128(_mm_or_si128(alpha, gray), _mm_or_si128(_mm_slli_epi32(gray, 8), _mm_slli_epi32(gray, 16)));
+    }
+
+    static int convertToGrayscaleSSE2(QRgb* pixels, int count);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static int convertToGrayscaleAVX2(QRgb* pixels, int count);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static int convertToGrayscaleNEON(QRgb* pixels, int count);
+#endif
+};
+
+void PDFColorConvertorKernels::convertToGrayscale(QRgb* pixels, int count)
+{
+    int i = 0;
+
+    switch (PDFSimd::getInstructionSet())
+    {
+#if defined(PDF4QT_SIMD_AVX2)
+        case PDFSimd::InstructionSet::AVX2:
+            i = convertToGrayscaleAVX2(pixels, count);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+            i = convertToGrayscaleSSE2(pixels, count);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+        case PDFSimd::InstructionSet::NEON:
+            i = convertToGrayscaleNEON(pixels, count);
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    for (; i < count; ++i)
+    {
+        const QRgb pixel = pixels[i];
+        const int gray = qGray(pixel);
+        pixels[i] = qRgba(gray, gray, gray, qAlpha(pixel));
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+int PDFColorConvertorKernels::convertToGrayscaleSSE2(QRgb* pixels, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i* data = reinterpret_cast<__m128i*>(pixels + i);
+        _mm_storeu_si128(data, convertToGrayscaleSSE2(_mm_loadu_si128(data)));
+    }
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+int PDFColorConvertorKernels::convertToGrayscaleAVX2(QRgb* pixels, int count)
+{
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xFF000000));
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i* data = reinterpret_cast<__m256i*>(pixels + i);
+        const __m256i value = _mm256_loadu_si256(data);
+        const __m256i b = _mm256_mullo_epi16(_mm256_and_si256(value, mask), _mm256_set1_epi32(5));
+        const __m256i g = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(value, 8), mask), _mm256_set1_epi32(16));
+        const __m256i r = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(value, 16), mask), _mm256_set1_epi32(11));
+        const __m256i gray = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(r, g), b), 5);
+        const __m256i alpha = _mm256_and_si256(value, alphaMask);
+        _mm256_storeu_si256(data, _mm256_or_si256(_mm256_or_si256(alpha, gray), _mm256_or_si256(_mm256_slli_epi32(gray, 8), _mm256_slli_epi32(gray, 16))));
+    }
+
+    // Finish remaining 4 pixels using SSE2
+    return i + convertToGrayscaleSSE2(pixels + i, count - i);
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+int PDFColorConvertorKernels::convertToGrayscaleNEON(QRgb* pixels, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // Deinterleaved components - blue, green, red and alpha
+        uint8_t* data = reinterpret_cast<uint8_t*>(pixels + i);
+        uint8x8x4_t components = vld4_u8(data);
+        uint16x8_t sum = vmull_u8(components.val[0], vdup_n_u8(5));
+        sum = vmlal_u8(sum, components.val[1], vdup_n_u8(16));
+        sum = vmlal_u8(sum, components.val[2], vdup_n_u8(11));
+        const uint8x8_t gray = vshrn_n_u16(sum, 5);
+        components.val[0] = gray;
+        components.val[1] = gray;
+        components.val[2] = gray;
+        vst4_u8(data, components);
+    }
+    return i;
+}
+#endif
+
 PDFColorConvertor::PDFColorConvertor()
 {
     calculateSigmoidParams();
@@ -110,18 +246,30 @@ QImage PDFColorConvertor::convert(QImage image) const
 
         case Mode::InvertedColors:
         {
+            if (image.colorCount() > 0)
+            {
+                // Indexed images (for example, image masks) have
+                // transparency in the color table, so we invert it.
+                QList<QRgb> colorTable = image.colorTable();
+                for (QRgb& color : colorTable)
+                {
+                    color = qRgba(255 - qRed(color), 255 - qGreen(color), 255 - qBlue(color), qAlpha(color));
+                }
+                image.setColorTable(colorTable);
+                return image;
+            }
+
             image.invertPixels(QImage::InvertRgb);
             return image;
         }
 
         case Mode::Grayscale:
         {
-            QImage alpha = image.convertedTo(QImage::Format_Alpha8);
-            QImage grayscaleImage = image.convertedTo(QImage::Format_Grayscale8);
-            QImage resultImage = grayscaleImage;
-            resultImage = resultImage.convertedTo(QImage::Format_ARGB32);
-            resultImage.setAlphaChannel(std::move(alpha));
-            return resultImage;
+            // Gray value is linear function of the color components, so it can be
+            // computed directly from premultiplied components.
+            prepareImage(image);
+            convertLines(image, &PDFColorConvertorKernels::convertToGrayscale);
+            return image;
         }
 
         case Mode::Bitonal:
@@ -140,34 +288,82 @@ QImage PDFColorConvertor::convert(QImage image) const
 
         case Mode::HighContrast:
         {
-            for (int row = 0; row < image.height(); ++row)
+            // Only lightness is changed in HSL color space, hue and saturation are
+            // preserved. Both lightness and chroma depend on the sum of maximal
+            // and minimal component, so whole conversion is driven by lookup tables
+            // indexed by this sum. Each component is then computed as
+            // c' = L' + (c - L) * C' / C, where C is chroma.
+            std::array<float, LIGHTNESS_LUT_SIZE> lightnessLUT = { };
+            std::array<float, LIGHTNESS_LUT_SIZE> chromaRatioLUT = { };
+
+            for (int i = 0; i < LIGHTNESS_LUT_SIZE; ++i)
             {
-                for (int column = 0; column < image.width(); ++column)
+                const float lightness = float(i) / float(LIGHTNESS_LUT_SIZE - 1);
+                const float adjustedLightness = correctLigthnessBySigmoidFunction(lightness);
+                const float chromaFactor = 1.0f - std::fabs(2.0f * lightness - 1.0f);
+                const float adjustedChromaFactor = 1.0f - std::fabs(2.0f * adjustedLightness - 1.0f);
+
+                lightnessLUT[i] = adjustedLightness * 255.0f;
+                chromaRatioLUT[i] = !qFuzzyIsNull(chromaFactor) ? adjustedChromaFactor / chromaFactor : 0.0f;
+            }
+
+            prepareImage(image);
+            const bool isPremultiplied = image.format() == QImage::Format_ARGB32_Premultiplied;
+            convertLines(image, [&](QRgb* pixels, int count)
+            {
+                for (int i = 0; i < count; ++i)
                 {
-                    QColor color = image.pixelColor(column, row);
-                    QColor adjustedColor = convert(color, false, false);
-                    image.setPixelColor(column, row, adjustedColor);
+                    const QRgb pixel = isPremultiplied ? qUnpremultiply(pixels[i]) : pixels[i];
+                    const int r = qRed(pixel);
+                    const int g = qGreen(pixel);
+                    const int b = qBlue(pixel);
+                    const int sum = qMax(r, qMax(g, b)) + qMin(r, qMin(g, b));
+                    const float lightness = float(sum) * 0.5f;
+                    const float adjustedLightness = lightnessLUT[sum];
+                    const float ratio = chromaRatioLUT[sum];
+
+                    auto adjust = [&](int component) { return qBound(0, qRound(adjustedLightness + (component - lightness) * ratio), 255); };
+                    const QRgb adjustedPixel = qRgba(adjust(r), adjust(g), adjust(b), qAlpha(pixel));
+                    pixels[i] = isPremultiplied ? qPremultiply(adjustedPixel) : adjustedPixel;
                 }
-            }
+            });
 
             return image;
         }
 
         case Mode::CustomColors:
         {
-            for (int row = 0; row < image.height(); ++row)
+            // Converted color depends only on the lightness, so we precompute
+            // all colors into the lookup table indexed by the sum of maximal
+            // and minimal component.
+            std::array<QRgb, LIGHTNESS_LUT_SIZE> colorLUT = { };
+
+            prepareImage(image);
+            const bool isPremultiplied = image.format() == QImage::Format_ARGB32_Premultiplied;
+
+            for (int i = 0; i < LIGHTNESS_LUT_SIZE; ++i)
             {
-                for (int column = 0; column < image.width(); ++column)
+                const float lightness = 1.0f - float(i) / float(LIGHTNESS_LUT_SIZE - 1);
+                QColor convertedColor = m_foregroundColor;
+                convertedColor.setRedF(convertedColor.redF() * lightness);
+                convertedColor.setGreenF(convertedColor.greenF() * lightness);
+                convertedColor.setBlueF(convertedColor.blueF() * lightness);
+                colorLUT[i] = isPremultiplied ? qPremultiply(convertedColor.rgba()) : convertedColor.rgba();
+            }
+
+            convertLines(image, [&](QRgb* pixels, int count)
+            {
+                for (int i = 0; i < count; ++i)
                 {
-                    QColor color = image.pixelColor(column, row);
-                    const float lightness = 1.0f - color.lightnessF();
-                    QColor convertedColor = m_foregroundColor;
-                    convertedColor.setRedF(convertedColor.redF() * lightness);
-                    convertedColor.setGreenF(convertedColor.greenF() * lightness);
-                    convertedColor.setBlueF(convertedColor.blueF() * lightness);
-                    image.setPixelColor(column, row, convertedColor);
+                    // Sum of maximal and minimal component is the same for premultiplied
+                    // colors only for opaque pixels, so unpremultiply the others.
+                    const QRgb pixel = (isPremultiplied && qAlpha(pixels[i]) != 255) ? qUnpremultiply(pixels[i]) : pixels[i];
+                    const int r = qRed(pixel);
+                    const int g = qGreen(pixel);
+                    const int b = qBlue(pixel);
+                    pixels[i] = colorLUT[qMax(r, qMax(g, b)) + qMin(r, qMin(g, b))];
                 }
-            }
+            });
 
             return image;
         }
@@ -180,6 +376,36 @@ QImage PDFColorConvertor::convert(QImage image) const
     return image;
 }
 
+void PDFColorConvertor::prepareImage(QImage& image)
+{
+    switch (image.format())
+    {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            break;
+
+        default:
+            image.convertTo(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+            break;
+    }
+}
+
+void PDFColorConvertor::convertLines(QImage& image, const std::function<void(QRgb*, int)>& function)
+{
+    // Access image data before parallel processing, so image is detached
+    // in this thread, and scanlines are then only written by the workers.
+    uchar* data = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    const int width = image.width();
+
+    auto range = PDFIntegerRange<int>(0, image.height());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), [&](int row)
+    {
+        function(reinterpret_cast<QRgb*>(data + row * stride), width);
+    });
+}
+
 void PDFColorConvertor::setHighContrastBrightnessFactor(float factor)
 {
     m_sigmoidParamC = factor;
@@ -25,6 +25,8 @@
 #include <QColor>
 #include <QImage>
 
+#include <functional>
+
 namespace pdf
 {
 
@@ -140,6 +142,20 @@ private:
     /// which are used to scale color values to the interval [0.0, 1.0].
     void calculateSigmoidParams();
 
+    /// Converts image to 32-bit format (RGB32, ARGB32 or ARGB32_Premultiplied),
+    /// if it is not already in one of these formats.
+    /// \param image Image
+    static void prepareImage(QImage& image);
+
+    /// Calls function for each scanline of the 32-bit image, scanlines
+    /// are processed in parallel.
+    /// \param image Image
+    /// \param function Function, which takes pixels and pixel count
+    static void convertLines(QImage& image, const std::function<void(QRgb*, int)>& function);
+
+    /// Size of lookup tables indexed by sum of maximal and minimal color component
+    static constexpr int LIGHTNESS_LUT_SIZE = 511;
+
     Mode m_mode = Mode::Normal;
     float m_sigmoidParamC = 10.0f;
     float m_sigmoidParamC_Black = 0.0f;
@@ -23,16 +23,328 @@
 #include "pdfpattern.h"
 #include "pdfcms.h"
 #include "pdfexecutionpolicy.h"
+#include "pdfsimd.h"
 
 #include <QCryptographicHash>
 
 #include "pdfdbgheap.h"
 
+#include <atomic>
 #include <execution>
+#include <limits>
 
 namespace pdf
 {
 
+/// Number of pixels in one band of image lines transformed at once
+static constexpr size_t INTEGER_TRANSFORM_BAND_PIXEL_COUNT = 64 * 1024;
+
+/// Unpacks rows of image samples. Routine used for unpacking is selected
+/// by bits per component, component count and decode array. Samples with
+/// 1, 2, 4 and 8 bits per component are converted using lookup tables,
+/// 8-bit and 16-bit samples with identity decode array are converted using
+/// SIMD instructions, other samples are read by the bit reader.
+class PDFImageSampleUnpacker
+{
+public:
+    /// Creates new unpacker
+    /// \param bitsPerComponent Bits per component
+    /// \param componentCount Number of components of each pixel
+    /// \param decode Decode array (can be empty)
+    explicit PDFImageSampleUnpacker(unsigned int bitsPerComponent, unsigned int componentCount, const std::vector<PDFReal>& decode);
+
+    /// Unpacks row of pixels and maps samples through the decode array
+    /// (or to the range [0, 1], if decode array is empty). If data are
+    /// incomplete, exception is thrown.
+    /// \param data Image data
+    /// \param offset Offset of the row in the image data
+    /// \param pixelCount Pixel count
+    /// \param output Output samples (pixelCount * componentCount values)
+    void unpackRow(const QByteArray& data, size_t offset, unsigned int pixelCount, float* output) const;
+
+    /// Unpacks row of raw samples (decode array is not used), samples
+    /// larger than 255 are clamped to 255. If data are incomplete,
+    /// exception is thrown.
+    /// \param data Image data
+    /// \param offset Offset of the row in the image data
+    /// \param sampleCount Sample count
+    /// \param output Output samples
+    void unpackRawRow(const QByteArray& data, size_t offset, unsigned int sampleCount, unsigned char* output) const;
+
+    /// Returns true, if decode array is empty or maps samples to the range [0, 1]
+    bool isIdentityDecode() const { return m_isIdentityDecode; }
+
+private:
+    /// Returns pointer to the row data, or nullptr, if data are incomplete
+    const unsigned char* getRowData(const QByteArray& data, size_t offset, size_t sampleCount) const;
+
+    void unpackRowGeneric(const QByteArray& data, size_t offset, size_t sampleCount, float* output) const;
+    void unpackRowLookupTable(const unsigned char* row, size_t sampleCount, float* output) const;
+    void unpackRow16(const unsigned char* row, size_t sampleCount, float* output) const;
+
+#if defined(PDF4QT_SIMD_SSE2)
+    static void unpackRow8IdentitySSE2(const unsigned char* row, size_t sampleCount, float* output);
+    static void unpackRow16IdentitySSE2(const unsigned char* row, size_t sampleCount, float* output);
+#endif
+
+    unsigned int m_bitsPerComponent;
+    unsigned int m_componentCount;
+    bool m_isIdentityDecode;
+
+    /// Decoded value of the sample of the component k is m_offsets[k] + sample * m_scales[k]
+    std::vector<float> m_offsets;
+    std::vector<float> m_scales;
+
+    /// Decoded values of all samples, component k starts at index k << bitsPerComponent
+    std::vector<float> m_lookupTable;
+};
+
+PDFImageSampleUnpacker::PDFImageSampleUnpacker(unsigned int bitsPerComponent, unsigned int componentCount, const std::vector<PDFReal>& decode) :
+    m_bitsPerComponent(bitsPerComponent),
+    m_componentCount(qMax(componentCount, 1u)),
+    m_isIdentityDecode(true)
+{
+    const PDFReal max = (bitsPerComponent > 0 && bitsPerComponent < 32) ? PDFReal((1u << bitsPerComponent) - 1) : 1.0;
+
+    m_offsets.resize(m_componentCount, 0.0f);
+    m_scales.resize(m_componentCount, float(1.0 / max));
+
+    if (decode.size() == 2 * m_componentCount)
+    {
+        for (unsigned int k = 0; k < m_componentCount; ++k)
+        {
+            m_offsets[k] = float(decode[2 * k]);
+            m_scales[k] = float((decode[2 * k + 1] - decode[2 * k]) / max);
+            m_isIdentityDecode = m_isIdentityDecode && decode[2 * k] == 0.0 && decode[2 * k + 1] == 1.0;
+        }
+    }
+
+    if (bitsPerComponent == 1 || bitsPerComponent == 2 || bitsPerComponent == 4 || bitsPerComponent == 8)
+    {
+        const unsigned int valueCount = 1u << bitsPerComponent;
+        m_lookupTable.resize(m_componentCount * valueCount, 0.0f);
+        for (unsigned int k = 0; k < m_componentCount; ++k)
+        {
+            for (unsigned int value = 0; value < valueCount; ++value)
+            {
+                m_lookupTable[(k << bitsPerComponent) + value] = m_offsets[k] + value * m_scales[k];
+            }
+        }
+    }
+}
+
+const unsigned char* PDFImageSampleUnpacker::getRowData(const QByteArray& data, size_t offset, size_t sampleCount) const
+{
+    const size_t byteCount = (sampleCount * m_bitsPerComponent + 7) / 8;
+    if (offset + byteCount > size_t(data.size()))
+    {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const unsigned char*>(data.constData()) + offset;
+}
+
+void PDFImageSampleUnpacker::unpackRow(const QByteArray& data, size_t offset, unsigned int pixelCount, float* output) const
+{
+    const size_t sampleCount = size_t(pixelCount) * m_componentCount;
+    const unsigned char* row = getRowData(data, offset, sampleCount);
+
+    if (!row)
+    {
+        // Bit reader throws an exception, when data are incomplete
+        unpackRowGeneric(data, offset, sampleCount, output);
+        return;
+    }
+
+    switch (m_bitsPerComponent)
+    {
+        case 8:
+#if defined(PDF4QT_SIMD_SSE2)
+            if (m_isIdentityDecode && PDFSimd::getInstructionSet() != PDFSimd::InstructionSet::Scalar)
+            {
+                unpackRow8IdentitySSE2(row, sampleCount, output);
+                break;
+            }
+#endif
+            unpackRowLookupTable(row, sampleCount, output);
+            break;
+
+        case 1:
+        case 2:
+        case 4:
+            unpackRowLookupTable(row, sampleCount, output);
+            break;
+
+        case 16:
+#if defined(PDF4QT_SIMD_SSE2)
+            if (m_isIdentityDecode && PDFSimd::getInstructionSet() != PDFSimd::InstructionSet::Scalar)
+            {
+                unpackRow16IdentitySSE2(row, sampleCount, output);
+                break;
+            }
+#endif
+            unpackRow16(row, sampleCount, output);
+            break;
+
+        default:
+            unpackRowGeneric(data, offset, sampleCount, output);
+            break;
+    }
+}
+
+void PDFImageSampleUnpacker::unpackRawRow(const QByteArray& data, size_t offset, unsigned int sampleCount, unsigned char* output) const
+{
+    const unsigned char* row = getRowData(data, offset, sampleCount);
+
+    if (row && m_bitsPerComponent == 8)
+    {
+        std::copy(row, row + sampleCount, output);
+    }
+    else if (row && (m_bitsPerComponent == 1 || m_bitsPerComponent == 2 || m_bitsPerComponent == 4))
+    {
+        const unsigned int mask = (1u << m_bitsPerComponent) - 1;
+        const unsigned int samplesPerByte = 8 / m_bitsPerComponent;
+
+        for (unsigned int i = 0; i < sampleCount; ++i)
+        {
+            const unsigned int shift = 8 - m_bitsPerComponent * (i % samplesPerByte + 1);
+            output[i] = static_cast<unsigned char>((row[i / samplesPerByte] >> shift) & mask);
+        }
+    }
+    else
+    {
+        PDFBufferedBitReader reader(&data);
+        reader.seek(qint64(offset));
+
+        for (unsigned int i = 0; i < sampleCount; ++i)
+        {
+            output[i] = static_cast<unsigned char>(qMin<PDFBufferedBitReader::Value>(reader.read(m_bitsPerComponent), 255));
+        }
+    }
+}
+
+void PDFImageSampleUnpacker::unpackRowGeneric(const QByteArray& data, size_t offset, size_t sampleCount, float* output) const
+{
+    PDFBufferedBitReader reader(&data);
+    reader.seek(qint64(offset));
+
+    unsigned int k = 0;
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        output[i] = m_offsets[k] + reader.read(m_bitsPerComponent) * m_scales[k];
+
+        if (++k == m_componentCount)
+        {
+            k = 0;
+        }
+    }
+}
+
+void PDFImageSampleUnpacker::unpackRowLookupTable(const unsigned char* row, size_t sampleCount, float* output) const
+{
+    const float* lookupTable = m_lookupTable.data();
+
+    if (m_bitsPerComponent == 8)
+    {
+        unsigned int k = 0;
+        for (size_t i = 0; i < sampleCount; ++i)
+        {
+            output[i] = lookupTable[(k << 8) + row[i]];
+
+            if (++k == m_componentCount)
+            {
+                k = 0;
+            }
+        }
+        return;
+    }
+
+    // Samples are packed in bytes, most significant bits first
+    const unsigned int bitsPerComponent = m_bitsPerComponent;
+    const unsigned int mask = (1u << bitsPerComponent) - 1;
+    size_t i = 0;
+    unsigned int k = 0;
+
+    while (i < sampleCount)
+    {
+        const unsigned int byte = *row++;
+        for (int shift = 8 - int(bitsPerComponent); shift >= 0 && i < sampleCount; shift -= int(bitsPerComponent))
+        {
+            output[i++] = lookupTable[(k << bitsPerComponent) + ((byte >> shift) & mask)];
+
+            if (++k == m_componentCount)
+            {
+                k = 0;
+            }
+        }
+    }
+}
+
+void PDFImageSampleUnpacker::unpackRow16(const unsigned char* row, size_t sampleCount, float* output) const
+{
+    unsigned int k = 0;
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        // 16-bit samples are stored in big endian order
+        const unsigned int sample = (unsigned int(row[2 * i]) << 8) | row[2 * i + 1];
+        output[i] = m_offsets[k] + sample * m_scales[k];
+
+        if (++k == m_componentCount)
+        {
+            k = 0;
+        }
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+void PDFImageSampleUnpacker::unpackRow8IdentitySSE2(const unsigned char* row, size_t sampleCount, float* output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+    size_t i = 0;
+    for (; i + 16 <= sampleCount; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+        _mm_storeu_ps(output + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+        _mm_storeu_ps(output + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+    }
+
+    for (; i < sampleCount; ++i)
+    {
+        output[i] = row[i] * (1.0f / 255.0f);
+    }
+}
+
+void PDFImageSampleUnpacker::unpackRow16IdentitySSE2(const unsigned char* row, size_t sampleCount, float* output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= sampleCount; i += 8)
+    {
+        // Swap bytes of big endian samples
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 2 * i));
+        const __m128i samples = _mm_or_si128(_mm_slli_epi16(data, 8), _mm_srli_epi16(data, 8));
+
+        _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(samples, zero)), scale));
+        _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(samples, zero)), scale));
+    }
+
+    for (; i < sampleCount; ++i)
+    {
+        const unsigned int sample = (unsigned int(row[2 * i]) << 8) | row[2 * i + 1];
+        output[i] = sample * (1.0f / 65535.0f);
+    }
+}
+#endif
+
 PDFColorComponentMatrix_3x3 getInverseMatrix(const PDFColorComponentMatrix_3x3& matrix)
 {
     const PDFColorComponent a_11 = matrix.getValue(0, 0);
@@ -231,6 +543,49 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
                 const unsigned int imageWidth = imageData.getWidth();
                 const unsigned int imageHeight = imageData.getHeight();
 
+                // 8-bit and 16-bit images without decode array can be transformed
+                // directly by color management system, without conversion to floating point
+                // colors. Image is transformed in bands of lines in parallel.
+                const unsigned int bitsPerComponent = imageData.getBitsPerComponent();
+                const size_t minimalStride = size_t(imageWidth) * componentCount * bitsPerComponent / 8;
+                if (decode.empty() &&
+                    (bitsPerComponent == 8 || bitsPerComponent == 16) &&
+                    imageData.getStride() >= minimalStride &&
+                    size_t(imageData.getData().size()) >= size_t(imageData.getStride()) * imageHeight)
+                {
+                    const size_t linesPerBand = qMax(size_t(1), INTEGER_TRANSFORM_BAND_PIXEL_COUNT / imageWidth);
+                    const size_t bandCount = (imageHeight + linesPerBand - 1) / linesPerBand;
+                    const unsigned char* inputData = reinterpret_cast<const unsigned char*>(imageData.getData().constData());
+                    unsigned char* outputData = image.bits();
+                    const size_t outputStride = image.bytesPerLine();
+                    std::atomic_bool isTransformed = true;
+
+                    auto transformBand = [&](size_t bandIndex)
+                    {
+                        if (!isTransformed || PDFOperationControl::isOperationCancelled(operationControl))
+                        {
+                            return;
+                        }
+
+                        const size_t firstLine = bandIndex * linesPerBand;
+                        const size_t lineCount = qMin(linesPerBand, imageHeight - firstLine);
+                        if (!fillRGBImageLines(inputData + firstLine * imageData.getStride(), imageData.getStride(), bitsPerComponent,
+                                               outputData + firstLine * outputStride, outputStride, imageWidth, lineCount, intent, cms))
+                        {
+                            isTransformed = false;
+                        }
+                    };
+
+                    auto bandRange = PDFIntegerRange<size_t>(0, bandCount);
+                    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bandRange.begin(), bandRange.end(), transformBand);
+
+                    if (isTransformed)
+                    {
+                        return image;
+                    }
+                }
+
+                PDFImageSampleUnpacker unpacker(bitsPerComponent, componentCount, decode);
                 QMutex exceptionMutex;
                 std::optional<PDFException> exception;
 
@@ -244,38 +599,10 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
 
                     try
                     {
-                        PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
-                        reader.seek(i * imageData.getStride());
-
-                        const double max = reader.max();
-                        const double coefficient = 1.0 / max;
                         unsigned char* outputLine = image.scanLine(i);
 
                         std::vector<float> inputColors(imageWidth * componentCount, 0.0f);
-                        auto itInputColor = inputColors.begin();
-
-                        if (!decode.empty())
-                        {
-                            // Interpolate value
-                            for (unsigned int j = 0; j < imageData.getWidth(); ++j)
-                            {
-                                for (unsigned int k = 0; k < componentCount; ++k)
-                                {
-                                    PDFReal value = reader.read();
-                                    *itInputColor++ = interpolate(value, 0.0, max, decode[2 * k], decode[2 * k + 1]);
-                                }
-                            }
-                        }
-                        else
-                        {
-                            // Just read all values and multiply them with coefficient
-                            const unsigned int pixelCount = imageData.getWidth() * componentCount;
-                            for (unsigned int j = 0; j < pixelCount; ++j)
-                            {
-                                PDFReal value = reader.read();
-                                *itInputColor++ = value * coefficient;
-                            }
-                        }
+                        unpacker.unpackRow(imageData.getData(), size_t(i) * imageData.getStride(), imageWidth, inputColors.data());
 
                         fillRGBBuffer(inputColors, outputLine, intent, cms, reporter);
                     }
@@ -324,6 +651,7 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
                 QImage alphaMask = createAlphaMask(softMask);
                 QSize targetSize = getLargerSizeByArea(alphaMask.size(), image.size());
 
+                PDFImageSampleUnpacker unpacker(imageData.getBitsPerComponent(), componentCount, decode);
                 QMutex exceptionMutex;
                 std::optional<PDFException> exception;
 
@@ -337,34 +665,11 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
 
                     try
                     {
-                        PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
-                        reader.seek(i * imageData.getStride());
-
-                        const double max = reader.max();
-                        const double coefficient = 1.0 / max;
                         unsigned char* outputLine = image.scanLine(i);
 
                         std::vector<float> inputColors(imageWidth * componentCount, 0.0f);
                         std::vector<unsigned char> outputColors(imageWidth * 3, 0);
-
-                        auto itInputColor = inputColors.begin();
-                        for (unsigned int j = 0; j < imageData.getWidth(); ++j)
-                        {
-                            for (unsigned int k = 0; k < componentCount; ++k)
-                            {
-                                PDFReal value = reader.read();
-
-                                // Interpolate value, if it is not empty
-                                if (!decode.empty())
-                                {
-                                    *itInputColor++ = interpolate(value, 0.0, max, decode[2 * k], decode[2 * k + 1]);
-                                }
-                                else
-                                {
-                                    *itInputColor++ = value * coefficient;
-                                }
-                            }
-                        }
+                        unpacker.unpackRow(imageData.getData(), size_t(i) * imageData.getStride(), imageWidth, inputColors.data());
 
                         fillRGBBuffer(inputColors, outputColors.data(), intent, cms, reporter);
 
@@ -524,6 +829,48 @@ void PDFAbstractColorSpace::fillRGBBuffer(const std::vector<float>& colors,
     }
 }
 
+bool PDFAbstractColorSpace::fillRGBImageLines(const unsigned char* input,
+                                              size_t inputStride,
+                                              int bitsPerComponent,
+                                              unsigned char* output,
+                                              size_t outputStride,
+                                              size_t width,
+                                              size_t lineCount,
+                                              RenderingIntent intent,
+                                              const PDFCMS* cms) const
+{
+    PDFCMS::ImageLinesTransformParams params;
+
+    switch (getColorSpace())
+    {
+        case ColorSpace::DeviceGray:
+            params.sourceType = PDFCMS::DeviceGray;
+            break;
+
+        case ColorSpace::DeviceRGB:
+            params.sourceType = PDFCMS::DeviceRGB;
+            break;
+
+        case ColorSpace::DeviceCMYK:
+            params.sourceType = PDFCMS::DeviceCMYK;
+            break;
+
+        default:
+            return false;
+    }
+
+    params.componentCount = getColorComponentCount();
+    params.bitsPerComponent = bitsPerComponent;
+    params.input = input;
+    params.inputStride = inputStride;
+    params.output = output;
+    params.outputStride = outputStride;
+    params.width = width;
+    params.lineCount = lineCount;
+    params.intent = intent;
+    return cms->fillRGBImageLines(params);
+}
+
 QColor PDFAbstractColorSpace::getCheckedColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
     if (getColorComponentCount() != color.size())
@@ -560,37 +907,27 @@ QImage PDFAbstractColorSpace::createAlphaMask(const PDFImageData& softMask)
         throw PDFException(PDFTranslationContext::tr("Invalid size of the decode array. Expected %1, actual %2.").arg(componentCount * 2).arg(decode.size()));
     }
 
-    PDFBitReader reader(&softMask.getData(), softMask.getBitsPerComponent());
+    PDFImageSampleUnpacker unpacker(softMask.getBitsPerComponent(), componentCount, decode);
+    const unsigned int width = softMask.getWidth();
+    std::vector<float> alphas(width, 0.0f);
 
-    PDFColor color;
-    color.resize(componentCount);
-
-    const double max = reader.max();
-    const double coefficient = 1.0 / max;
     for (unsigned int i = 0, rowCount = softMask.getHeight(); i < rowCount; ++i)
     {
-        reader.seek(i * softMask.getStride());
+        const size_t offset = size_t(i) * softMask.getStride();
         unsigned char* outputLine = image.scanLine(i);
 
-        for (unsigned int j = 0; j < softMask.getWidth(); ++j)
+        if (softMask.getBitsPerComponent() == 8 && unpacker.isIdentityDecode())
         {
-            PDFReal alpha = 0.0;
-
-            PDFReal value = reader.read();
-
-            // Interpolate value, if it is not empty
-            if (!decode.empty())
-            {
-                alpha = interpolate(value, 0.0, max, decode[0], decode[1]);
-            }
-            else
-            {
-                alpha = value * coefficient;
-            }
+            // Samples are alpha values
+            unpacker.unpackRawRow(softMask.getData(), offset, width, outputLine);
+            continue;
+        }
 
-            alpha = qBound(0.0, alpha, 1.0);
-            uint8_t alphaCoded = alpha * 255;
-            *outputLine++ = alphaCoded;
+        unpacker.unpackRow(softMask.getData(), offset, width, alphas.data());
+        for (unsigned int j = 0; j < width; ++j)
+        {
+            const float alpha = qBound(0.0f, alphas[j], 1.0f);
+            *outputLine++ = uint8_t(qRound(alpha * 255.0f));
         }
     }
 
@@ -1707,6 +2044,42 @@ void PDFICCBasedColorSpace::fillRGBBuffer(const std::vector<float>& colors, unsi
     }
 }
 
+bool PDFICCBasedColorSpace::fillRGBImageLines(const unsigned char* input,
+                                              size_t inputStride,
+                                              int bitsPerComponent,
+                                              unsigned char* output,
+                                              size_t outputStride,
+                                              size_t width,
+                                              size_t lineCount,
+                                              RenderingIntent intent,
+                                              const PDFCMS* cms) const
+{
+    // Integer samples can be used only, if they are mapped to the range [0, 1]
+    const size_t colorComponentCount = getColorComponentCount();
+    for (size_t i = 0; i < colorComponentCount; ++i)
+    {
+        if (m_range[2 * i] != 0.0f || m_range[2 * i + 1] != 1.0f)
+        {
+            return false;
+        }
+    }
+
+    PDFCMS::ImageLinesTransformParams params;
+    params.sourceType = PDFCMS::ICC;
+    params.sourceIccId = m_iccProfileDataChecksum;
+    params.sourceIccData = m_iccProfileData;
+    params.componentCount = colorComponentCount;
+    params.bitsPerComponent = bitsPerComponent;
+    params.input = input;
+    params.inputStride = inputStride;
+    params.output = output;
+    params.outputStride = outputStride;
+    params.width = width;
+    params.lineCount = lineCount;
+    params.intent = intent;
+    return cms->fillRGBImageLines(params);
+}
+
 bool PDFICCBasedColorSpace::equals(const PDFAbstractColorSpace* other) const
 {
     if (!PDFAbstractColorSpace::equals(other))
@@ -1893,6 +2266,43 @@ size_t PDFIndexedColorSpace::getColorComponentCount() const
     return 1;
 }
 
+void PDFIndexedColorSpace::fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    std::vector<PDFColorComponent> indices = colors;
+    std::vector<PDFColorComponent> transformedColors = transformColorsToBaseColorSpace(PDFColorBuffer(indices.data(), indices.size()));
+    m_baseColorSpace->fillRGBBuffer(transformedColors, outputBuffer, intent, cms, reporter);
+}
+
+std::vector<unsigned char> PDFIndexedColorSpace::createRGBPalette(RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    const size_t colorCount = m_maxValue - MIN_VALUE + 1;
+
+    std::vector<PDFColorComponent> indices(colorCount, 0.0f);
+    for (size_t i = 0; i < colorCount; ++i)
+    {
+        indices[i] = PDFColorComponent(MIN_VALUE + i);
+    }
+
+    std::vector<unsigned char> palette(colorCount * 3, 0);
+    fillRGBBuffer(indices, palette.data(), intent, cms, reporter);
+    return palette;
+}
+
+std::array<QRgb, 256> PDFIndexedColorSpace::createRGBLookupTable(RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    const std::vector<unsigned char> palette = createRGBPalette(intent, cms, reporter);
+
+    // Indices out of range are clamped to the valid range
+    std::array<QRgb, 256> lookupTable = { };
+    for (int index = 0; index < int(lookupTable.size()); ++index)
+    {
+        const unsigned char* paletteColor = palette.data() + 3 * qBound<int>(MIN_VALUE, index, m_maxValue);
+        lookupTable[index] = qRgb(paletteColor[0], paletteColor[1], paletteColor[2]);
+    }
+
+    return lookupTable;
+}
+
 QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                                       const PDFImageData& softMask,
                                       const PDFCMS* cms,
@@ -1910,7 +2320,6 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                 image.fill(QColor(Qt::white));
 
                 unsigned int componentCount = imageData.getComponents();
-                PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
 
                 if (componentCount != getColorComponentCount())
                 {
@@ -1919,8 +2328,12 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
 
                 Q_ASSERT(componentCount == 1);
 
-                PDFColor color;
-                color.resize(1);
+                // Transform all colors of the palette at once, then just copy them
+                const std::array<QRgb, 256> palette = createRGBLookupTable(intent, cms, reporter);
+
+                const unsigned int imageWidth = imageData.getWidth();
+                PDFImageSampleUnpacker unpacker(imageData.getBitsPerComponent(), componentCount, { });
+                std::vector<unsigned char> indices(imageWidth, 0);
 
                 for (unsigned int i = 0, rowCount = imageData.getHeight(); i < rowCount; ++i)
                 {
@@ -1930,20 +2343,15 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                         throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Operation cancelled!"));
                     }
 
-                    reader.seek(i * imageData.getStride());
+                    unpacker.unpackRawRow(imageData.getData(), size_t(i) * imageData.getStride(), imageWidth, indices.data());
                     unsigned char* outputLine = image.scanLine(i);
 
-                    for (unsigned int j = 0; j < imageData.getWidth(); ++j)
+                    for (unsigned char index : indices)
                     {
-                        PDFBitReader::Value index = reader.read();
-                        color[0] = index;
-
-                        QColor transformedColor = getColor(color, cms, intent, reporter, false);
-                        QRgb rgb = transformedColor.rgb();
-
-                        *outputLine++ = qRed(rgb);
-                        *outputLine++ = qGreen(rgb);
-                        *outputLine++ = qBlue(rgb);
+                        const QRgb color = palette[index];
+                        *outputLine++ = qRed(color);
+                        *outputLine++ = qGreen(color);
+                        *outputLine++ = qBlue(color);
                     }
                 }
 
@@ -1956,7 +2364,6 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                 QImage image(imageData.getWidth(), imageData.getHeight(), hasMatte ? QImage::Format_RGBA8888_Premultiplied : QImage::Format_RGBA8888);
 
                 unsigned int componentCount = imageData.getComponents();
-                PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
 
                 if (componentCount != getColorComponentCount())
                 {
@@ -1965,12 +2372,16 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
 
                 Q_ASSERT(componentCount == 1);
 
-                PDFColor color;
-                color.resize(1);
+                // Transform all colors of the palette at once, then just copy them
+                const std::array<QRgb, 256> palette = createRGBLookupTable(intent, cms, reporter);
 
                 QImage alphaMask = createAlphaMask(softMask);
                 QSize targetSize = getLargerSizeByArea(alphaMask.size(), image.size());
 
+                const unsigned int imageWidth = imageData.getWidth();
+                PDFImageSampleUnpacker unpacker(imageData.getBitsPerComponent(), componentCount, { });
+                std::vector<unsigned char> indices(imageWidth, 0);
+
                 for (unsigned int i = 0, rowCount = imageData.getHeight(); i < rowCount; ++i)
                 {
                     // Is operation being cancelled?
@@ -1979,20 +2390,15 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                         throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Operation cancelled!"));
                     }
 
-                    reader.seek(i * imageData.getStride());
+                    unpacker.unpackRawRow(imageData.getData(), size_t(i) * imageData.getStride(), imageWidth, indices.data());
                     unsigned char* outputLine = image.scanLine(i);
 
-                    for (unsigned int j = 0; j < imageData.getWidth(); ++j)
+                    for (unsigned char index : indices)
                     {
-                        PDFBitReader::Value index = reader.read();
-                        color[0] = index;
-
-                        QColor transformedColor = getColor(color, cms, intent, reporter, false);
-                        QRgb rgb = transformedColor.rgb();
-
-                        *outputLine++ = qRed(rgb);
-                        *outputLine++ = qGreen(rgb);
-                        *outputLine++ = qBlue(rgb);
+                        const QRgb color = palette[index];
+                        *outputLine++ = qRed(color);
+                        *outputLine++ = qGreen(color);
+                        *outputLine++ = qBlue(color);
                         *outputLine++ = 255;
                     }
                 }
@@ -2041,6 +2447,9 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                 PDFColor color;
                 color.resize(componentCount);
 
+                // Transform all colors of the palette at once, then just copy them
+                const std::vector<unsigned char> palette = createRGBPalette(intent, cms, reporter);
+
                 const PDFReal max = reader.max();
                 for (unsigned int i = 0, rowCount = imageData.getHeight(); i < rowCount; ++i)
                 {
@@ -2074,12 +2483,11 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                             }
                         }
 
-                        QColor transformedColor = getColor(color, cms, intent, reporter, false);
-                        QRgb rgb = transformedColor.rgb();
+                        const unsigned char* paletteColor = palette.data() + 3 * qBound<int>(MIN_VALUE, static_cast<int>(color[0]), m_maxValue);
 
-                        *outputLine++ = qRed(rgb);
-                        *outputLine++ = qGreen(rgb);
-                        *outputLine++ = qBlue(rgb);
+                        *outputLine++ = *paletteColor++;
+                        *outputLine++ = *paletteColor++;
+                        *outputLine++ = *paletteColor++;
                         *outputLine++ = (maskedColors == componentCount) ? 0x00 : 0xFF;
                     }
                 }
@@ -2272,11 +2680,51 @@ size_t PDFSeparationColorSpace::getColorComponentCount() const
     return 1;
 }
 
+void PDFSeparationColorSpace::fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    if (m_isNone)
+    {
+        PDFAbstractColorSpace::fillRGBBuffer(colors, outputBuffer, intent, cms, reporter);
+        return;
+    }
+
+    if (m_isAll)
+    {
+        for (const float tint : colors)
+        {
+            const unsigned char value = static_cast<unsigned char>(qRound(qBound(0.0f, 1.0f - tint, 1.0f) * 255.0f));
+            *outputBuffer++ = value;
+            *outputBuffer++ = value;
+            *outputBuffer++ = value;
+        }
+        return;
+    }
+
+    // Transform whole buffer by tint transform, and then fill
+    // RGB buffer using alternate color space in one call.
+    std::vector<PDFColorComponent> tints = colors;
+    std::vector<PDFColorComponent> transformedColors = transformColorsToBaseColorSpace(PDFColorBuffer(tints.data(), tints.size()));
+    m_alternateColorSpace->fillRGBBuffer(transformedColors, outputBuffer, intent, cms, reporter);
+}
+
 std::vector<PDFColorComponent> PDFSeparationColorSpace::transformColorsToBaseColorSpace(const PDFColorBuffer buffer) const
 {
     const std::size_t colorComponentCount = m_alternateColorSpace->getColorComponentCount();
     std::vector<PDFColorComponent> result(buffer.size() * colorComponentCount, 0.0f);
 
+    if (!m_isAll && m_tintTransform->getInputVariableCount() == 1 && m_tintTransform->getOutputVariableCount() == colorComponentCount)
+    {
+        // Evaluate tint transform in a batch, if buffer is large enough,
+        // use baked tint transform (lookup table) instead of original function.
+        std::vector<double> inputColors(buffer.cbegin(), buffer.cend());
+        std::vector<double> outputColors(result.size(), 0.0);
+
+        const PDFFunctionPtr& tintTransform = getBatchTintTransform(inputColors.size());
+        tintTransform->applyBatch(inputColors.data(), outputColors.data(), inputColors.size());
+        std::copy(outputColors.cbegin(), outputColors.cend(), result.begin());
+        return result;
+    }
+
     std::vector<double> outputColor;
     outputColor.resize(colorComponentCount, 0.0);
 
@@ -2306,6 +2754,21 @@ std::vector<PDFColorComponent> PDFSeparationColorSpace::transformColorsToBaseCol
     return result;
 }
 
+const PDFFunctionPtr& PDFSeparationColorSpace::getBatchTintTransform(size_t evaluationCount) const
+{
+    if (!PDFFunction::isBakingWorthIt(m_tintTransform.get(), evaluationCount))
+    {
+        return m_tintTransform;
+    }
+
+    std::call_once(m_bakedTintTransformFlag, [this]()
+    {
+        m_bakedTintTransform = PDFFunction::createBakedFunction(m_tintTransform, std::numeric_limits<size_t>::max());
+    });
+
+    return m_bakedTintTransform;
+}
+
 PDFColorSpacePointer PDFSeparationColorSpace::createSeparationColorSpace(const PDFDictionary* colorSpaceDictionary,
                                                                          const PDFDocument* document,
                                                                          const PDFArray* array,
@@ -2507,6 +2970,21 @@ size_t PDFDeviceNColorSpace::getColorComponentCount() const
     return m_colorants.size();
 }
 
+void PDFDeviceNColorSpace::fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const
+{
+    if (m_isNone || m_colorants.empty())
+    {
+        PDFAbstractColorSpace::fillRGBBuffer(colors, outputBuffer, intent, cms, reporter);
+        return;
+    }
+
+    // Transform whole buffer by tint transform, and then fill
+    // RGB buffer using alternate color space in one call.
+    std::vector<PDFColorComponent> inputColors = colors;
+    std::vector<PDFColorComponent> transformedColors = transformColorsToBaseColorSpace(PDFColorBuffer(inputColors.data(), inputColors.size()));
+    m_alternateColorSpace->fillRGBBuffer(transformedColors, outputBuffer, intent, cms, reporter);
+}
+
 std::vector<PDFColorComponent> PDFDeviceNColorSpace::transformColorsToBaseColorSpace(const PDFColorBuffer buffer) const
 {
     std::vector<PDFColorComponent> result;
@@ -2518,6 +2996,19 @@ std::vector<PDFColorComponent> PDFDeviceNColorSpace::transformColorsToBaseColorS
         const std::size_t alternateColorSpaceComponentCount = m_alternateColorSpace->getColorComponentCount();
         result.resize(inputColorCount * alternateColorSpaceComponentCount, 0.0f);
 
+        if (m_tintTransform->getInputVariableCount() == colorantCount && m_tintTransform->getOutputVariableCount() == alternateColorSpaceComponentCount)
+        {
+            // Evaluate tint transform in a batch, if buffer is large enough,
+            // use baked tint transform (lookup table) instead of original function.
+            std::vector<double> inputColors(buffer.cbegin(), std::next(buffer.cbegin(), inputColorCount * colorantCount));
+            std::vector<double> outputColors(result.size(), 0.0);
+
+            const PDFFunctionPtr& tintTransform = getBatchTintTransform(inputColorCount);
+            tintTransform->applyBatch(inputColors.data(), outputColors.data(), inputColorCount);
+            std::copy(outputColors.cbegin(), outputColors.cend(), result.begin());
+            return result;
+        }
+
         std::vector<double> inputColor(colorantCount, 0.0);
         std::vector<double> outputColor(alternateColorSpaceComponentCount, 0.0);
 
@@ -2535,6 +3026,21 @@ std::vector<PDFColorComponent> PDFDeviceNColorSpace::transformColorsToBaseColorS
     return result;
 }
 
+const PDFFunctionPtr& PDFDeviceNColorSpace::getBatchTintTransform(size_t evaluationCount) const
+{
+    if (!PDFFunction::isBakingWorthIt(m_tintTransform.get(), evaluationCount))
+    {
+        return m_tintTransform;
+    }
+
+    std::call_once(m_bakedTintTransformFlag, [this]()
+    {
+        m_bakedTintTransform = PDFFunction::createBakedFunction(m_tintTransform, std::numeric_limits<size_t>::max());
+    });
+
+    return m_bakedTintTransform;
+}
+
 PDFColorSpacePointer PDFDeviceNColorSpace::createDeviceNColorSpace(const PDFDictionary* colorSpaceDictionary,
                                                                    const PDFDocument* document,
                                                                    const PDFArray* array,
@@ -28,6 +28,7 @@
 #include <QSharedPointer>
 
 #include <set>
+#include <mutex>
 
 namespace pdf
 {
@@ -376,7 +377,9 @@ public:
 
     /// Fills RGB buffer using colors from \p colors. Colors are transformed
     /// by this color space (or color management system is used). Buffer
-    /// must be big enough to contain all 8-bit RGB data.
+    /// must be big enough to contain all 8-bit RGB data. This function
+    /// is intended to transform whole scanline at once, so use it instead
+    /// of \p getColor when many colors are being transformed.
     /// \param Colors Input color buffer
     /// \param intent Rendering intent
     /// \param outputBuffer 8-bit RGB output buffer
@@ -388,6 +391,30 @@ public:
                                const PDFCMS* cms,
                                PDFRenderErrorReporter* reporter) const;
 
+    /// Fills 8-bit RGB image lines directly from image lines with integer color
+    /// components (8 or 16 bits per component, without decode array), without
+    /// conversion to floating point colors. Returns false, if it is not supported
+    /// by the color space or by the color management system, caller then must
+    /// use \p fillRGBBuffer. Default implementation supports device color spaces.
+    /// \param input Input image lines
+    /// \param inputStride Number of bytes per input line
+    /// \param bitsPerComponent Bits per component (8 or 16)
+    /// \param output 8-bit RGB output image lines
+    /// \param outputStride Number of bytes per output line
+    /// \param width Number of pixels per line
+    /// \param lineCount Number of lines
+    /// \param intent Rendering intent
+    /// \param cms Color management system
+    virtual bool fillRGBImageLines(const unsigned char* input,
+                                   size_t inputStride,
+                                   int bitsPerComponent,
+                                   unsigned char* output,
+                                   size_t outputStride,
+                                   size_t width,
+                                   size_t lineCount,
+                                   RenderingIntent intent,
+                                   const PDFCMS* cms) const;
+
     /// If this class is pattern space, returns this, otherwise returns nullptr.
     virtual const PDFPatternColorSpace* asPatternColorSpace() const { return nullptr; }
 
@@ -716,6 +743,7 @@ public:
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
     virtual void fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
+    virtual bool fillRGBImageLines(const unsigned char* input, size_t inputStride, int bitsPerComponent, unsigned char* output, size_t outputStride, size_t width, size_t lineCount, RenderingIntent intent, const PDFCMS* cms) const override;
     virtual bool equals(const PDFAbstractColorSpace* other) const override;
 
     PDFObjectReference getMetadata() const { return m_metadata; }
@@ -756,6 +784,7 @@ public:
     virtual PDFColor getDefaultColorOriginal() const override;
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
+    virtual void fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
     virtual QImage getImage(const PDFImageData& imageData,
                             const PDFImageData& softMask,
                             const PDFCMS* cms,
@@ -782,6 +811,21 @@ public:
     const QByteArray& getColors() const;
 
 private:
+    /// Creates 8-bit RGB palette for all color indices. Palette contains
+    /// three bytes for each color index, base color space is used
+    /// to transform all colors in one call.
+    /// \param intent Rendering intent
+    /// \param cms Color management system
+    /// \param reporter Render error reporter
+    std::vector<unsigned char> createRGBPalette(RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const;
+
+    /// Creates lookup table of RGB colors for all 8-bit samples, samples
+    /// out of range of the color indices are clamped to the valid range.
+    /// \param intent Rendering intent
+    /// \param cms Color management system
+    /// \param reporter Render error reporter
+    std::array<QRgb, 256> createRGBLookupTable(RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const;
+
     static constexpr const int MIN_VALUE = 0;
     static constexpr const int MAX_VALUE = 255;
 
@@ -801,6 +845,7 @@ public:
     virtual PDFColor getDefaultColorOriginal() const override;
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
+    virtual void fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
 
     bool isNone() const { return m_isNone; }
     bool isAll() const { return m_isAll; }
@@ -823,9 +868,16 @@ public:
     const QByteArray& getColorName() const;
 
 private:
+    /// Returns tint transform used to transform \p evaluationCount colors in a batch.
+    /// Baked tint transform is created only once and it is reused by next batches.
+    /// \param evaluationCount Number of transformed colors
+    const PDFFunctionPtr& getBatchTintTransform(size_t evaluationCount) const;
+
     QByteArray m_colorName;
     PDFColorSpacePointer m_alternateColorSpace;
     PDFFunctionPtr m_tintTransform;
+    mutable PDFFunctionPtr m_bakedTintTransform;
+    mutable std::once_flag m_bakedTintTransformFlag;
     bool m_isNone;
     bool m_isAll;
 };
@@ -864,6 +916,7 @@ public:
     virtual PDFColor getDefaultColorOriginal() const override;
     virtual QColor getColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, bool isRange01) const override;
     virtual size_t getColorComponentCount() const override;
+    virtual void fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer, RenderingIntent intent, const PDFCMS* cms, PDFRenderErrorReporter* reporter) const override;
 
     /// Returns type of DeviceN color space
     Type getType() const { return m_type; }
@@ -891,11 +944,18 @@ public:
                                                         std::set<QByteArray>& usedNames);
 
 private:
+    /// Returns tint transform used to transform \p evaluationCount colors in a batch.
+    /// Baked tint transform is created only once and it is reused by next batches.
+    /// \param evaluationCount Number of transformed colors
+    const PDFFunctionPtr& getBatchTintTransform(size_t evaluationCount) const;
+
     Type m_type;
     Colorants m_colorants;
     PDFColorSpacePointer m_alternateColorSpace;
     PDFColorSpacePointer m_processColorSpace;
     PDFFunctionPtr m_tintTransform;
+    mutable PDFFunctionPtr m_bakedTintTransform;
+    mutable std::once_flag m_bakedTintTransformFlag;
     std::vector<QByteArray> m_colorantsPrintingOrder;
     std::vector<QByteArray> m_processColorSpaceComponents;
     bool m_isNone;
@@ -0,0 +1,558 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfcontentstreamoptimizer.h"
+#include "pdfexception.h"
+
+#include <cmath>
+#include <map>
+#include <optional>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+using Token = PDFLexicalAnalyzer::Token;
+using TokenType = PDFLexicalAnalyzer::TokenType;
+
+/// Returns true, if operator is path construction operator
+static bool isPathConstructionOperator(const QByteArray& op)
+{
+    return op == "m" || op == "l" || op == "c" || op == "v" || op == "y" || op == "h" || op == "re";
+}
+
+/// Returns key of the graphic state parameter, which is set by the operator
+/// (operands of the operator are the new value of the parameter). If operator
+/// doesn't set graphic state parameter in this way, empty array is returned.
+static QByteArray getGraphicStateKey(const QByteArray& op)
+{
+    static const char* const simpleOperators[] = { "w", "J", "j", "M", "d", "ri", "i", "Tc", "Tw", "Tz", "TL", "Tf", "Tr", "Ts" };
+    for (const char* simpleOperator : simpleOperators)
+    {
+        if (op == simpleOperator)
+        {
+            return op;
+        }
+    }
+
+    if (op == "g" || op == "rg" || op == "k")
+    {
+        return "fill";
+    }
+
+    if (op == "G" || op == "RG" || op == "K")
+    {
+        return "stroke";
+    }
+
+    return QByteArray();
+}
+
+/// Returns true, if operator doesn't change any graphic state
+/// parameter tracked by the optimizer.
+static bool isNeutralOperator(const QByteArray& op)
+{
+    static const char* const neutralOperators[] = { "m", "l", "c", "v", "y", "h", "re", "S", "s", "f", "F", "f*", "B", "B*", "b", "b*", "n", "W", "W*",
+                                                     "BT", "ET", "Td", "Tm", "T*", "Tj", "TJ", "Do", "sh", "BMC", "BDC", "EMC", "MP", "DP", "d0", "d1", "cm" };
+    for (const char* neutralOperator : neutralOperators)
+    {
+        if (op == neutralOperator)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+PDFContentStreamOptimizer::PDFContentStreamOptimizer(int precision) :
+    m_precision(qBound(0, precision, 10))
+{
+
+}
+
+QByteArray PDFContentStreamOptimizer::optimize(const QByteArray& content) const
+{
+    Instructions instructions;
+    if (!parse(content, instructions))
+    {
+        return content;
+    }
+
+    roundNumbers(instructions);
+    removeUnusedPaths(instructions);
+    removeRedundantGraphicState(instructions);
+    mergeTextRuns(instructions);
+    removeEmptyPairs(instructions);
+
+    return write(instructions);
+}
+
+bool PDFContentStreamOptimizer::parse(const QByteArray& content, Instructions& instructions) const
+{
+    try
+    {
+        std::vector<Token> operands;
+        PDFLexicalAnalyzer parser(content.constBegin(), content.constEnd());
+
+        while (!parser.isAtEnd())
+        {
+            Token token = parser.fetch();
+
+            if (token.type == TokenType::EndOfFile)
+            {
+                break;
+            }
+
+            if (token.type != TokenType::Command)
+            {
+                operands.push_back(qMove(token));
+                continue;
+            }
+
+            Instruction instruction;
+            instruction.op = token.data.toByteArray();
+            instruction.operands = qMove(operands);
+            operands = std::vector<Token>();
+
+            if (instruction.op == "BI")
+            {
+                // Inline images contain binary data, which can't be tokenized,
+                // and their end can be determined only heuristically. We do not risk
+                // damaging the content stream, so such content streams are not optimized.
+                return false;
+            }
+
+            instructions.emplace_back(qMove(instruction));
+        }
+
+        // Operands without operator - content stream is probably split into
+        // multiple streams in the middle of the instruction.
+        return operands.empty();
+    }
+    catch (const PDFException&)
+    {
+        return false;
+    }
+}
+
+void PDFContentStreamOptimizer::roundNumbers(Instructions& instructions) const
+{
+    const PDFReal scale = std::pow(10.0, m_precision);
+
+    for (Instruction& instruction : instructions)
+    {
+        // Matrices and font sizes scale other values, so they are
+        // rounded only, if the relative error is small enough.
+        const bool isScaling = instruction.op == "cm" || instruction.op == "Tm" || instruction.op == "Tf";
+
+        for (Token& token : instruction.operands)
+        {
+            if (token.type != TokenType::Real)
+            {
+                continue;
+            }
+
+            const PDFReal value = token.data.toDouble();
+            const PDFReal roundedValue = std::round(value * scale) / scale;
+
+            if (!std::isfinite(roundedValue) || (isScaling && qAbs(roundedValue - value) > qAbs(value) * 1e-4))
+            {
+                continue;
+            }
+
+            token.data = roundedValue;
+        }
+    }
+}
+
+void PDFContentStreamOptimizer::removeUnusedPaths(Instructions& instructions) const
+{
+    size_t pathStart = instructions.size();
+    bool isClipped = false;
+
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        const QByteArray& op = instructions[i].op;
+
+        if (isPathConstructionOperator(op))
+        {
+            pathStart = qMin(pathStart, i);
+        }
+        else if (op == "W" || op == "W*")
+        {
+            isClipped = true;
+        }
+        else
+        {
+            if (op == "n" && !isClipped)
+            {
+                // Path is neither painted, nor used as a clipping path
+                const size_t start = qMin(pathStart, i);
+                for (size_t j = start; j <= i; ++j)
+                {
+                    instructions[j].isRemoved = true;
+                }
+            }
+
+            pathStart = instructions.size();
+            isClipped = false;
+        }
+    }
+}
+
+void PDFContentStreamOptimizer::removeRedundantGraphicState(Instructions& instructions) const
+{
+    using State = std::map<QByteArray, std::vector<Token>>;
+
+    State state;
+    std::vector<State> stateStack;
+
+    // Graphic state operators, after which no other operator was executed yet,
+    // so they can be removed, if the same parameter is set again.
+    std::map<QByteArray, size_t> pendingOperators;
+
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        Instruction& instruction = instructions[i];
+        if (instruction.isRemoved)
+        {
+            continue;
+        }
+
+        const QByteArray& op = instruction.op;
+        const QByteArray key = getGraphicStateKey(op);
+
+        if (!key.isEmpty())
+        {
+            auto it = state.find(key);
+            if (it != state.end() && it->second == instruction.operands)
+            {
+                // Value is already set
+                instruction.isRemoved = true;
+                continue;
+            }
+
+            auto pendingIt = pendingOperators.find(key);
+            if (pendingIt != pendingOperators.end())
+            {
+                // Value is overwritten without being used
+                instructions[pendingIt->second].isRemoved = true;
+            }
+
+            state[key] = instruction.operands;
+            pendingOperators[key] = i;
+            continue;
+        }
+
+        pendingOperators.clear();
+
+        if (op == "q")
+        {
+            stateStack.push_back(state);
+        }
+        else if (op == "Q")
+        {
+            if (!stateStack.empty())
+            {
+                state = qMove(stateStack.back());
+                stateStack.pop_back();
+            }
+            else
+            {
+                // Restored state is not known
+                state.clear();
+            }
+        }
+        else if (op == "cs" || op == "sc" || op == "scn")
+        {
+            state.erase("fill");
+        }
+        else if (op == "CS" || op == "SC" || op == "SCN")
+        {
+            state.erase("stroke");
+        }
+        else if (op == "'" || op == "\"")
+        {
+            state.erase("Tw");
+            state.erase("Tc");
+        }
+        else if (op == "TD")
+        {
+            state.erase("TL");
+        }
+        else if (!isNeutralOperator(op))
+        {
+            // Operator can change anything (for example, external graphic state),
+            // or it is unknown operator in the compatibility section.
+            state.clear();
+        }
+    }
+}
+
+void PDFContentStreamOptimizer::mergeTextRuns(Instructions& instructions) const
+{
+    // Returns items of the text showing operator (strings and numbers of the TJ array),
+    // or empty optional value, if instruction is not a text showing operator.
+    auto getTextItems = [](const Instruction& instruction) -> std::optional<std::vector<Token>>
+    {
+        const std::vector<Token>& operands = instruction.operands;
+
+        if (instruction.op == "Tj" && operands.size() == 1 && operands.front().type == TokenType::String)
+        {
+            return operands;
+        }
+
+        if (instruction.op == "TJ" && operands.size() >= 2 &&
+            operands.front().type == TokenType::ArrayStart &&
+            operands.back().type == TokenType::ArrayEnd)
+        {
+            std::vector<Token> items(std::next(operands.cbegin()), std::prev(operands.cend()));
+            auto isItemValid = [](const Token& token) { return token.type == TokenType::String || token.type == TokenType::Integer || token.type == TokenType::Real; };
+            if (std::all_of(items.cbegin(), items.cend(), isItemValid))
+            {
+                return items;
+            }
+        }
+
+        return std::nullopt;
+    };
+
+    auto getNumber = [](const Token& token) { return token.type == TokenType::Integer ? PDFReal(token.data.toLongLong()) : token.data.toDouble(); };
+
+    size_t previous = instructions.size();
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        Instruction& instruction = instructions[i];
+        if (instruction.isRemoved)
+        {
+            continue;
+        }
+
+        std::optional<std::vector<Token>> currentItems = getTextItems(instruction);
+        std::optional<std::vector<Token>> previousItems = (previous < instructions.size()) ? getTextItems(instructions[previous]) : std::nullopt;
+
+        if (!currentItems || !previousItems)
+        {
+            previous = i;
+            continue;
+        }
+
+        // Merge items, adjacent strings are concatenated, adjacent numbers are summed
+        std::vector<Token> items = qMove(*previousItems);
+        for (Token& item : *currentItems)
+        {
+            if (!items.empty() && items.back().type == TokenType::String && item.type == TokenType::String)
+            {
+                items.back().data = items.back().data.toByteArray() + item.data.toByteArray();
+            }
+            else if (!items.empty() && items.back().type != TokenType::String && item.type != TokenType::String)
+            {
+                items.back() = Token(TokenType::Real, getNumber(items.back()) + getNumber(item));
+            }
+            else
+            {
+                items.push_back(qMove(item));
+            }
+        }
+
+        Instruction& previousInstruction = instructions[previous];
+        if (items.size() == 1 && items.front().type == TokenType::String)
+        {
+            previousInstruction.op = "Tj";
+            previousInstruction.operands = qMove(items);
+        }
+        else
+        {
+            previousInstruction.op = "TJ";
+            previousInstruction.operands.clear();
+            previousInstruction.operands.emplace_back(TokenType::ArrayStart);
+            previousInstruction.operands.insert(previousInstruction.operands.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+            previousInstruction.operands.emplace_back(TokenType::ArrayEnd);
+        }
+
+        instruction.isRemoved = true;
+    }
+}
+
+void PDFContentStreamOptimizer::removeEmptyPairs(Instructions& instructions) const
+{
+    std::vector<size_t> stack;
+
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        Instruction& instruction = instructions[i];
+        if (instruction.isRemoved)
+        {
+            continue;
+        }
+
+        if (!stack.empty())
+        {
+            Instruction& previousInstruction = instructions[stack.back()];
+            if ((previousInstruction.op == "q" && instruction.op == "Q") ||
+                (previousInstruction.op == "BT" && instruction.op == "ET"))
+            {
+                previousInstruction.isRemoved = true;
+                instruction.isRemoved = true;
+                stack.pop_back();
+                continue;
+            }
+        }
+
+        stack.push_back(i);
+    }
+}
+
+QByteArray PDFContentStreamOptimizer::write(const Instructions& instructions) const
+{
+    QByteArray output;
+
+    for (const Instruction& instruction : instructions)
+    {
+        if (instruction.isRemoved)
+        {
+            continue;
+        }
+
+        for (const Token& token : instruction.operands)
+        {
+            writeToken(output, token);
+            output.append(' ');
+        }
+
+        output.append(instruction.op);
+        output.append('\n');
+    }
+
+    return output;
+}
+
+void PDFContentStreamOptimizer::writeToken(QByteArray& output, const PDFLexicalAnalyzer::Token& token) const
+{
+    switch (token.type)
+    {
+        case TokenType::Boolean:
+            output.append(token.data.toBool() ? "true" : "false");
+            break;
+
+        case TokenType::Integer:
+            output.append(QByteArray::number(token.data.toLongLong()));
+            break;
+
+        case TokenType::Real:
+            output.append(formatReal(token.data.toDouble()));
+            break;
+
+        case TokenType::String:
+        {
+            const QByteArray data = token.data.toByteArray();
+            auto isLiteralCharacter = [](char character) { return character >= 0x20 && character <= 0x7E && character != '(' && character != ')' && character != '\\'; };
+
+            if (std::all_of(data.cbegin(), data.cend(), isLiteralCharacter))
+            {
+                output.append('(');
+                output.append(data);
+                output.append(')');
+            }
+            else
+            {
+                output.append('<');
+                output.append(data.toHex());
+                output.append('>');
+            }
+            break;
+        }
+
+        case TokenType::Name:
+        {
+            output.append('/');
+            for (const char character : token.data.toByteArray())
+            {
+                if (PDFLexicalAnalyzer::isRegular(character) && character != '#')
+                {
+                    output.append(character);
+                }
+                else
+                {
+                    output.append('#');
+                    output.append(QByteArray(&character, 1).toHex());
+                }
+            }
+            break;
+        }
+
+        case TokenType::ArrayStart:
+            output.append('[');
+            break;
+
+        case TokenType::ArrayEnd:
+            output.append(']');
+            break;
+
+        case TokenType::DictionaryStart:
+            output.append("<<");
+            break;
+
+        case TokenType::DictionaryEnd:
+            output.append(">>");
+            break;
+
+        case TokenType::Null:
+            output.append("null");
+            break;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+}
+
+QByteArray PDFContentStreamOptimizer::formatReal(PDFReal value) const
+{
+    if (!std::isfinite(value))
+    {
+        return "0";
+    }
+
+    // Numbers are already rounded, we just remove trailing zeroes
+    QByteArray result = QByteArray::number(value, 'f', 12);
+    if (result.contains('.'))
+    {
+        while (result.endsWith('0'))
+        {
+            result.chop(1);
+        }
+
+        if (result.endsWith('.'))
+        {
+            result.chop(1);
+        }
+    }
+
+    if (result == "-0")
+    {
+        result = "0";
+    }
+
+    return result;
+}
+
+}   // namespace pdf
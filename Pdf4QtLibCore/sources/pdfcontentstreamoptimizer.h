@@ -0,0 +1,80 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFCONTENTSTREAMOPTIMIZER_H
+#define PDFCONTENTSTREAMOPTIMIZER_H
+
+#include "pdfglobal.h"
+#include "pdfparser.h"
+
+#include <QByteArray>
+
+#include <vector>
+
+namespace pdf
+{
+
+/// Rewrites content streams to the smaller equivalent form. Content stream is
+/// optimized at the level of operators, it is never interpreted (so it can be
+/// used for any content stream, regardless of its resources). Following
+/// optimizations are performed:
+///     - real numbers are rounded to the given precision,
+///     - graphic state operators setting already set values are removed,
+///     - graphic state operators overwritten by following ones are removed,
+///     - paths, which are neither painted nor used for clipping, are removed,
+///     - adjacent text showing operators are merged,
+///     - empty q/Q and BT/ET pairs are removed.
+class PDF4QTLIBCORESHARED_EXPORT PDFContentStreamOptimizer
+{
+public:
+    /// Constructs content stream optimizer
+    /// \param precision Number of decimal places of real numbers
+    explicit PDFContentStreamOptimizer(int precision);
+
+    /// Optimizes the content stream. If content stream can't be optimized
+    /// (it is invalid, or contains inline images), original content stream is returned.
+    /// \param content Decoded content stream
+    QByteArray optimize(const QByteArray& content) const;
+
+private:
+    struct Instruction
+    {
+        QByteArray op;
+        std::vector<PDFLexicalAnalyzer::Token> operands;
+        bool isRemoved = false;
+    };
+
+    using Instructions = std::vector<Instruction>;
+
+    bool parse(const QByteArray& content, Instructions& instructions) const;
+    void roundNumbers(Instructions& instructions) const;
+    void removeUnusedPaths(Instructions& instructions) const;
+    void removeRedundantGraphicState(Instructions& instructions) const;
+    void mergeTextRuns(Instructions& instructions) const;
+    void removeEmptyPairs(Instructions& instructions) const;
+    QByteArray write(const Instructions& instructions) const;
+
+    void writeToken(QByteArray& output, const PDFLexicalAnalyzer::Token& token) const;
+    QByteArray formatReal(PDFReal value) const;
+
+    int m_precision;
+};
+
+}   // namespace pdf
+
+#endif // PDFCONTENTSTREAMOPTIMIZER_H
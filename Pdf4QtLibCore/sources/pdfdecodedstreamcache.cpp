@@ -0,0 +1,118 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfdecodedstreamcache.h"
+#include "pdfobject.h"
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFDecodedStreamCache::PDFDecodedStreamCache(qint64 memoryLimit) :
+    m_memoryLimit(qMax(memoryLimit, qint64(0)))
+{
+
+}
+
+bool PDFDecodedStreamCache::find(const PDFStream* stream, QByteArray& data) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_itemMap.find(stream);
+    if (it == m_itemMap.cend())
+    {
+        ++m_misses;
+        return false;
+    }
+
+    // Move item to the front, it is now most recently used
+    m_items.splice(m_items.begin(), m_items, it->second);
+    data = it->second->data;
+    ++m_hits;
+    return true;
+}
+
+void PDFDecodedStreamCache::insert(const PDFStream* stream, const QByteArray& data)
+{
+    std::shared_ptr<const PDFStream> streamPointer = stream->weak_from_this().lock();
+    if (!streamPointer)
+    {
+        // Stream is not owned by shared pointer, we can't guarantee,
+        // that it will be alive during lifetime of the cached item.
+        return;
+    }
+
+    QMutexLocker lock(&m_mutex);
+
+    const qint64 size = data.size();
+    if (size > m_memoryLimit || m_itemMap.count(stream))
+    {
+        return;
+    }
+
+    m_items.push_front(Item{ qMove(streamPointer), data });
+    m_itemMap[stream] = m_items.begin();
+    m_memoryConsumption += size;
+    shrink();
+}
+
+void PDFDecodedStreamCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_itemMap.clear();
+    m_items.clear();
+    m_memoryConsumption = 0;
+}
+
+void PDFDecodedStreamCache::setMemoryLimit(qint64 memoryLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_memoryLimit = qMax(memoryLimit, qint64(0));
+    shrink();
+}
+
+qint64 PDFDecodedStreamCache::getMemoryLimit() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryLimit;
+}
+
+PDFDecodedStreamCache::Statistics PDFDecodedStreamCache::getStatistics() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    Statistics statistics;
+    statistics.hits = m_hits.load();
+    statistics.misses = m_misses.load();
+    statistics.memoryConsumption = m_memoryConsumption;
+    statistics.memoryLimit = m_memoryLimit;
+    statistics.itemCount = m_items.size();
+    return statistics;
+}
+
+void PDFDecodedStreamCache::shrink()
+{
+    while (m_memoryConsumption > m_memoryLimit && !m_items.empty())
+    {
+        const Item& item = m_items.back();
+        m_memoryConsumption -= item.data.size();
+        m_itemMap.erase(item.stream.get());
+        m_items.pop_back();
+    }
+}
+
+}   // namespace pdf
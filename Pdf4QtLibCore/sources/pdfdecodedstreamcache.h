@@ -0,0 +1,109 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFDECODEDSTREAMCACHE_H
+#define PDFDECODEDSTREAMCACHE_H
+
+#include "pdfglobal.h"
+
+#include <QMutex>
+#include <QByteArray>
+
+#include <list>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+namespace pdf
+{
+class PDFStream;
+
+/// Thread safe cache of decoded stream data. Memory consumption of the cache
+/// is limited by the byte budget, least recently used items are removed first,
+/// when limit is exceeded. Items are identified by the stream object. Cache
+/// keeps stream objects alive while they are cached, so an item can't be
+/// mistaken for another stream allocated at the same address.
+class PDF4QTLIBCORESHARED_EXPORT PDFDecodedStreamCache
+{
+public:
+    /// Default memory limit of the cache (in bytes)
+    static constexpr const qint64 DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+    explicit PDFDecodedStreamCache(qint64 memoryLimit = DEFAULT_MEMORY_LIMIT);
+
+    PDFDecodedStreamCache(const PDFDecodedStreamCache&) = delete;
+    PDFDecodedStreamCache& operator=(const PDFDecodedStreamCache&) = delete;
+
+    struct Statistics
+    {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        qint64 memoryConsumption = 0;
+        qint64 memoryLimit = 0;
+        size_t itemCount = 0;
+    };
+
+    /// Tries to find decoded data of the stream. If data are found,
+    /// true is returned and \p data are set, otherwise false is returned.
+    /// \param stream Stream
+    /// \param[out] data Decoded data
+    bool find(const PDFStream* stream, QByteArray& data) const;
+
+    /// Inserts decoded data of the stream into the cache. If stream
+    /// is not owned by a shared pointer (for example, it is a temporary
+    /// object), or data are too large, then nothing is inserted.
+    /// \param stream Stream
+    /// \param data Decoded data
+    void insert(const PDFStream* stream, const QByteArray& data);
+
+    /// Removes all items from the cache
+    void clear();
+
+    /// Sets memory limit of the cache (in bytes). Zero memory
+    /// limit means, that cache is disabled.
+    void setMemoryLimit(qint64 memoryLimit);
+
+    /// Returns memory limit of the cache (in bytes)
+    qint64 getMemoryLimit() const;
+
+    /// Returns statistics of the cache
+    Statistics getStatistics() const;
+
+private:
+    struct Item
+    {
+        std::shared_ptr<const PDFStream> stream;
+        QByteArray data;
+    };
+
+    using Items = std::list<Item>;
+
+    /// Removes least recently used items, until memory limit is met
+    void shrink();
+
+    mutable QMutex m_mutex;
+    mutable Items m_items;
+    std::unordered_map<const PDFStream*, Items::iterator> m_itemMap;
+    qint64 m_memoryConsumption = 0;
+    qint64 m_memoryLimit = 0;
+    mutable std::atomic<quint64> m_hits = 0;
+    mutable std::atomic<quint64> m_misses = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFDECODEDSTREAMCACHE_H
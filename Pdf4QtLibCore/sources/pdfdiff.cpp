@@ -24,9 +24,17 @@
 #include "pdfconstants.h"
 #include "pdfalgorithmlcs.h"
 #include "pdfpainter.h"
+#include "pdfinstrumentation.h"
+#include "pdfsimd.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
 #include <QtConcurrent/QtConcurrent>
 
+#include <limits>
+#include <unordered_map>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -61,9 +69,14 @@ public:
         size_t index = 0;
         int charIndex = 0;
         int charCount = 0;
+        quint32 id = 0;     ///< Identifier of the text (items with the same text have the same identifier)
         bool left = false;
     };
 
+    /// Minimal count of text compare items, for which texts are compared
+    /// in parallel (texts are split by paragraph anchors).
+    static constexpr const size_t PARALLEL_TEXT_COMPARE_LIMIT = 4096;
+
     static Differences calculateDifferences(const GraphicPieceInfos& left, const GraphicPieceInfos& right, PDFReal epsilon);
     static std::vector<size_t> getLeftUnmatched(const PageSequence& sequence);
     static std::vector<size_t> getRightUnmatched(const PageSequence& sequence);
@@ -72,8 +85,364 @@ public:
                                                                 bool isWordsComparingMode,
                                                                 bool isLeft);
     static void refineTextRectangles(PDFDiffResult::RectInfos& items);
+
+    /// Size of the square tile (in pixels), in which rendered pages are compared
+    static constexpr const int RASTER_TILE_SIZE = 32;
+
+    /// Compares two images of the same size and format ARGB32_Premultiplied. Images
+    /// are divided into tiles, tiles are compared in parallel, comparation of the tile
+    /// is finished, when first different pixel is found. Neighbouring different tiles
+    /// are clustered into regions, returned as rectangles in pixel coordinates.
+    /// \param left Left image
+    /// \param right Right image
+    /// \param tolerance Maximal difference of color channels of equal pixels
+    static std::vector<QRect> calculateRasterDifferences(const QImage& left, const QImage& right, int tolerance);
+
+    /// Assigns identifiers to the text compare items. Texts are interned, so items
+    /// with the same text have the same identifier, and items can be compared
+    /// by identifiers, not by texts.
+    static void assignTextCompareItemIds(const TextFlowDifferences& context,
+                                         std::vector<TextCompareItem>& leftItems,
+                                         std::vector<TextCompareItem>& rightItems);
+
+    /// Computes longest common subsequence of text compare items (identifiers
+    /// must be assigned). Long texts are split by paragraph anchors (paragraphs,
+    /// which are unique and the same in both texts), and parts between anchors
+    /// are compared in parallel.
+    static PDFAlgorithmLongestCommonSubsequenceBase::Sequence compareTextCompareItems(const std::vector<TextCompareItem>& leftItems,
+                                                                                      const std::vector<TextCompareItem>& rightItems);
+};
+
+/// SIMD kernels for comparation of rendered page images
+class PDFDiffRasterKernels
+{
+public:
+    /// Returns true, if some byte of the left and right buffer
+    /// differ by more than tolerance.
+    /// \param left Left buffer
+    /// \param right Right buffer
+    /// \param count Byte count
+    /// \param tolerance Tolerance
+    static bool isDifferent(const uchar* left, const uchar* right, int count, uchar tolerance);
+
+private:
+    // Functions return count of processed bytes. Processing is stopped
+    // at the first block containing a difference, which is then found
+    // again by scalar code.
+#if defined(PDF4QT_SIMD_SSE2)
+    static int findDifferenceSSE2(const uchar* left, const uchar* right, int count, uchar tolerance);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static int findDifferenceAVX2(const uchar* left, const uchar* right, int count, uchar tolerance);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static int findDifferenceNEON(const uchar* left, const uchar* right, int count, uchar tolerance);
+#endif
+};
+
+bool PDFDiffRasterKernels::isDifferent(const uchar* left, const uchar* right, int count, uchar tolerance)
+{
+    int i = 0;
+
+    switch (PDFSimd::getInstructionSet())
+    {
+#if defined(PDF4QT_SIMD_AVX2)
+        case PDFSimd::InstructionSet::AVX2:
+            i = findDifferenceAVX2(left, right, count, tolerance);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+            i = findDifferenceSSE2(left, right, count, tolerance);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+        case PDFSimd::InstructionSet::NEON:
+            i = findDifferenceNEON(left, right, count, tolerance);
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    for (; i < count; ++i)
+    {
+        if (std::abs(int(left[i]) - int(right[i])) > tolerance)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+int PDFDiffRasterKernels::findDifferenceSSE2(const uchar* left, const uchar* right, int count, uchar tolerance)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i toleranceVector = _mm_set1_epi8(char(tolerance));
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+
+        // Absolute difference using saturated subtraction, differences within
+        // tolerance are saturated to zero.
+        const __m128i difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        const __m128i exceeded = _mm_subs_epu8(difference, toleranceVector);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(exceeded, zero)) != 0xFFFF)
+        {
+            break;
+        }
+    }
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+int PDFDiffRasterKernels::findDifferenceAVX2(const uchar* left, const uchar* right, int count, uchar tolerance)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i toleranceVector = _mm256_set1_epi8(char(tolerance));
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+        const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+        const __m256i exceeded = _mm256_subs_epu8(difference, toleranceVector);
+        if (uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(exceeded, zero))) != 0xFFFFFFFFU)
+        {
+            return i;
+        }
+    }
+
+    // Finish remaining 16 bytes using SSE2
+    return i + findDifferenceSSE2(left + i, right + i, count - i, tolerance);
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+int PDFDiffRasterKernels::findDifferenceNEON(const uchar* left, const uchar* right, int count, uchar tolerance)
+{
+    const uint8x16_t toleranceVector = vdupq_n_u8(tolerance);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const uint8x16_t difference = vabdq_u8(vld1q_u8(left + i), vld1q_u8(right + i));
+        const uint64x2_t exceeded = vreinterpretq_u64_u8(vcgtq_u8(difference, toleranceVector));
+        if ((vgetq_lane_u64(exceeded, 0) | vgetq_lane_u64(exceeded, 1)) != 0)
+        {
+            break;
+        }
+    }
+    return i;
+}
+#endif
+
+/// Calculates hash of the page source data (content streams, resources and page boxes).
+/// Hash doesn't depend on object numbers, so pages of two different documents can be
+/// compared. Pages having the same source hash have the same content, so they don't
+/// have to be interpreted. Hashes of stream data are cached, because resources
+/// (fonts, images) are often shared by multiple pages. Function \p calculateHash
+/// can be called from multiple threads.
+class PDFDiffPageSourceHasher
+{
+public:
+    explicit inline PDFDiffPageSourceHasher(const PDFDocument* document) :
+        m_document(document)
+    {
+
+    }
+
+    using Hash = std::array<uint8_t, 64>;
+
+    /// Calculates source hash of the page
+    /// \param page Page
+    Hash calculateHash(const PDFPage* page);
+
+private:
+    struct Context
+    {
+        QCryptographicHash hasher{ QCryptographicHash::Sha512 };
+        std::map<PDFObjectReference, quint64> visitedReferences;
+    };
+
+    template<typename T>
+    static void addValue(Context& context, T value)
+    {
+        context.hasher.addData(QByteArrayView(reinterpret_cast<const char*>(&value), sizeof(T)));
+    }
+
+    static void addBytes(Context& context, const QByteArray& bytes);
+
+    void addObject(Context& context, const PDFObject& object);
+    void addDictionary(Context& context, const PDFDictionary* dictionary);
+    void addStream(Context& context, const PDFStream* stream, PDFObjectReference reference);
+
+    const PDFDocument* m_document;
+    QMutex m_mutex;
+    std::map<PDFObjectReference, QByteArray> m_streamHashes;
 };
 
+PDFDiffPageSourceHasher::Hash PDFDiffPageSourceHasher::calculateHash(const PDFPage* page)
+{
+    Context context;
+
+    const QRectF& mediaBox = page->getMediaBox();
+    const QRectF& cropBox = page->getCropBox();
+    for (PDFReal value : { mediaBox.x(), mediaBox.y(), mediaBox.width(), mediaBox.height(), cropBox.x(), cropBox.y(), cropBox.width(), cropBox.height() })
+    {
+        addValue(context, value);
+    }
+    addValue(context, static_cast<int>(page->getPageRotation()));
+
+    addObject(context, page->getContents());
+    addObject(context, page->getResources());
+
+    QByteArray hash = context.hasher.result();
+
+    Hash result = { };
+    size_t size = qMin<size_t>(hash.length(), result.size());
+    std::copy(hash.data(), hash.data() + size, result.data());
+    return result;
+}
+
+void PDFDiffPageSourceHasher::addBytes(Context& context, const QByteArray& bytes)
+{
+    addValue(context, static_cast<quint64>(bytes.size()));
+    context.hasher.addData(bytes);
+}
+
+void PDFDiffPageSourceHasher::addObject(Context& context, const PDFObject& object)
+{
+    addValue(context, static_cast<uint8_t>(object.getType()));
+
+    switch (object.getType())
+    {
+        case PDFObject::Type::Null:
+            break;
+
+        case PDFObject::Type::Bool:
+            addValue(context, object.getBool());
+            break;
+
+        case PDFObject::Type::Int:
+            addValue(context, object.getInteger());
+            break;
+
+        case PDFObject::Type::Real:
+            addValue(context, object.getReal());
+            break;
+
+        case PDFObject::Type::String:
+        case PDFObject::Type::Name:
+            addBytes(context, object.getString());
+            break;
+
+        case PDFObject::Type::Array:
+        {
+            const PDFArray* array = object.getArray();
+            addValue(context, static_cast<quint64>(array->getCount()));
+            for (size_t i = 0, count = array->getCount(); i < count; ++i)
+            {
+                addObject(context, array->getItem(i));
+            }
+            break;
+        }
+
+        case PDFObject::Type::Dictionary:
+            addDictionary(context, object.getDictionary());
+            break;
+
+        case PDFObject::Type::Stream:
+            addStream(context, object.getStream(), PDFObjectReference());
+            break;
+
+        case PDFObject::Type::Reference:
+        {
+            // Object numbers differ in different documents, so we hash
+            // referenced object instead. Already visited objects are hashed by order
+            // of the first visit, so cycles are handled properly.
+            const PDFObjectReference reference = object.getReference();
+            auto it = context.visitedReferences.find(reference);
+            if (it != context.visitedReferences.cend())
+            {
+                addValue(context, it->second);
+                break;
+            }
+
+            const quint64 visitOrder = context.visitedReferences.size();
+            context.visitedReferences.emplace(reference, visitOrder);
+            addValue(context, std::numeric_limits<quint64>::max());
+
+            const PDFObject& referencedObject = m_document->getObjectByReference(reference);
+            if (referencedObject.isStream())
+            {
+                addValue(context, static_cast<uint8_t>(referencedObject.getType()));
+                addStream(context, referencedObject.getStream(), reference);
+            }
+            else
+            {
+                addObject(context, referencedObject);
+            }
+            break;
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+}
+
+void PDFDiffPageSourceHasher::addDictionary(Context& context, const PDFDictionary* dictionary)
+{
+    addValue(context, static_cast<quint64>(dictionary->getCount()));
+    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    {
+        addBytes(context, dictionary->getKey(i).getString());
+        addObject(context, dictionary->getValue(i));
+    }
+}
+
+void PDFDiffPageSourceHasher::addStream(Context& context, const PDFStream* stream, PDFObjectReference reference)
+{
+    addDictionary(context, stream->getDictionary());
+
+    QByteArray contentHash;
+    if (reference.isValid())
+    {
+        QMutexLocker lock(&m_mutex);
+        auto it = m_streamHashes.find(reference);
+        if (it != m_streamHashes.cend())
+        {
+            contentHash = it->second;
+        }
+    }
+
+    if (contentHash.isEmpty())
+    {
+        contentHash = QCryptographicHash::hash(*stream->getContent(), QCryptographicHash::Sha512);
+
+        if (reference.isValid())
+        {
+            QMutexLocker lock(&m_mutex);
+            m_streamHashes[reference] = contentHash;
+        }
+    }
+
+    context.hasher.addData(contentHash);
+}
+
 PDFDiff::PDFDiff(QObject* parent) :
     BaseClass(parent),
     m_progress(nullptr),
@@ -81,6 +450,8 @@ PDFDiff::PDFDiff(QObject* parent) :
     m_rightDocument(nullptr),
     m_options(Asynchronous | PC_Text | PC_VectorGraphics | PC_Images | CompareWords),
     m_epsilon(0.001),
+    m_rasterResolution(100.0),
+    m_rasterTolerance(16),
     m_cancelled(false),
     m_textAnalysisAlgorithm(PDFDocumentTextFlowFactory::Algorithm::Layout)
 {
@@ -131,6 +502,12 @@ void PDFDiff::start()
 
     m_cancelled = false;
 
+    {
+        QMutexLocker locker(&m_partialResultMutex);
+        m_partialResult = PDFDiffResult();
+        m_partialResultTimer.invalidate();
+    }
+
     if (m_options.testFlag(Asynchronous))
     {
         m_futureWatcher = std::nullopt;
@@ -218,12 +595,168 @@ void PDFDiff::stepProgress()
 
 struct PDFDiffPageContext
 {
+    bool hasIdenticalPage() const { return identicalPageIndex != std::numeric_limits<size_t>::max(); }
+
     PDFInteger pageIndex = 0;
     std::array<uint8_t, 64> pageHash = { };
+    std::array<uint8_t, 64> sourceHash = { };
+    size_t identicalPageIndex = std::numeric_limits<size_t>::max(); ///< Index of page context with the same source in other document
+    bool isContentExtracted = false;
     PDFPrecompiledPage::GraphicPieceInfos graphicPieces;
     PDFDocumentTextFlow text;
+    std::vector<QRectF> rasterDifferences; ///< Regions of the page, which differ from the matched page (when pages are compared as images)
+};
+
+/// Objects needed to render pages of the document, when
+/// pages are compared as rendered images.
+struct PDFDiffRasterDocumentContext
+{
+    explicit PDFDiffRasterDocumentContext(const PDFDocument* document, PDFRenderer::Features features) :
+        document(document),
+        features(features),
+        fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT),
+        optionalContentActivity(document, pdf::OCUsage::View, nullptr),
+        cmsManager(nullptr),
+        rasterizerPool(document, &fontCache, &cmsManager, &optionalContentActivity, features, meshQualitySettings,
+                       PDFRasterizerPool::getDefaultRasterizerCount(), RendererEngine::Blend2D_SingleThread, nullptr)
+    {
+        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(document), &optionalContentActivity));
+        cmsManager.setDocument(document);
+    }
+
+    /// Renders page to the image of given size. Function is thread safe.
+    /// \param pageIndex Page index
+    /// \param size Image size
+    QImage render(PDFInteger pageIndex, QSize size)
+    {
+        const PDFPage* page = document->getCatalog()->getPage(pageIndex);
+        PDFCMSPointer cms = cmsManager.getCurrentCMS();
+
+        PDFPrecompiledPage compiledPage;
+        PDFRenderer renderer(document, &fontCache, cms.data(), &optionalContentActivity, features, meshQualitySettings);
+        renderer.compile(&compiledPage, pageIndex);
+
+        PDFRasterizer* rasterizer = rasterizerPool.acquire();
+        QImage image = rasterizer->render(pageIndex, page, &compiledPage, size, features, nullptr, cms.data(), PageRotation::None);
+        rasterizerPool.release(rasterizer);
+
+        return image;
+    }
+
+    const PDFDocument* document;
+    PDFRenderer::Features features;
+    PDFFontCache fontCache;
+    PDFOptionalContentActivity optionalContentActivity;
+    PDFCMSManager cmsManager;
+    PDFMeshQualitySettings meshQualitySettings;
+    PDFRasterizerPool rasterizerPool;
 };
 
+void PDFDiff::matchIdenticalPages(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                                  std::vector<PDFDiffPageContext>& rightPreparedPages)
+{
+    // Revisions of documents typically change only a few pages.
+    // Pages with the same source data (content streams and resources) have
+    // the same content, so we match them without interpretation. Source hash
+    // is used as page hash of these pages, so they are matched by the page
+    // matching algorithm.
+    for (auto [document, contexts] : { std::make_pair(m_leftDocument, &leftPreparedPages), std::make_pair(m_rightDocument, &rightPreparedPages) })
+    {
+        PDFDiffPageSourceHasher hasher(document);
+        auto calculateSourceHash = [&](PDFDiffPageContext& context)
+        {
+            const PDFPage* page = document->getCatalog()->getPage(context.pageIndex);
+            context.sourceHash = hasher.calculateHash(page);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, contexts->begin(), contexts->end(), calculateSourceHash);
+    }
+
+    auto compareSources = [](const PDFDiffPageContext& left, const PDFDiffPageContext& right) { return left.sourceHash == right.sourceHash; };
+    PDFAlgorithmLongestCommonSubsequence algorithm(leftPreparedPages.cbegin(), leftPreparedPages.cend(),
+                                                   rightPreparedPages.cbegin(), rightPreparedPages.cend(),
+                                                   compareSources);
+    algorithm.perform();
+
+    for (const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item : algorithm.getSequence())
+    {
+        if (item.isMatch())
+        {
+            PDFDiffPageContext& leftContext = leftPreparedPages[item.index1];
+            PDFDiffPageContext& rightContext = rightPreparedPages[item.index2];
+
+            leftContext.identicalPageIndex = item.index2;
+            leftContext.pageHash = leftContext.sourceHash;
+            rightContext.identicalPageIndex = item.index1;
+            rightContext.pageHash = rightContext.sourceHash;
+        }
+    }
+}
+
+void PDFDiff::extractPageContent(const PDFDocument* document, std::vector<PDFDiffPageContext>& preparedPages)
+{
+    PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    PDFOptionalContentActivity optionalContentActivity(document, pdf::OCUsage::View, nullptr);
+    fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(document), &optionalContentActivity));
+
+    PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(document);
+    PDFCMSPointer cms = cmsManager.getCurrentCMS();
+
+    auto fillPageContext = [&, this](PDFDiffPageContext& context)
+    {
+        if (context.isContentExtracted || context.hasIdenticalPage())
+        {
+            // Content is already extracted, or it is not needed
+            return;
+        }
+
+        PDFPrecompiledPage compiledPage;
+        constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
+        PDFRenderer renderer(document, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
+        renderer.compile(&compiledPage, context.pageIndex);
+
+        const PDFPage* page = document->getCatalog()->getPage(context.pageIndex);
+        PDFReal epsilon = calculateEpsilonForPage(page);
+        context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
+
+        finalizeGraphicsPieces(context);
+        context.isContentExtracted = true;
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, preparedPages.begin(), preparedPages.end(), fillPageContext);
+}
+
+void PDFDiff::extractPageText(const PDFDocument* document, std::vector<PDFDiffPageContext>& preparedPages)
+{
+    std::vector<PDFInteger> pages;
+    for (const PDFDiffPageContext& context : preparedPages)
+    {
+        if (context.isContentExtracted && context.text.isEmpty())
+        {
+            pages.push_back(context.pageIndex);
+        }
+    }
+
+    if (pages.empty())
+    {
+        return;
+    }
+
+    pdf::PDFDocumentTextFlowFactory factoryDocumentTextFlow;
+    factoryDocumentTextFlow.setCalculateBoundingBoxes(true);
+    PDFDocumentTextFlow textFlow = factoryDocumentTextFlow.create(document, pages, m_textAnalysisAlgorithm);
+    std::map<PDFInteger, PDFDocumentTextFlow> splittedText = textFlow.split(PDFDocumentTextFlow::Text);
+    for (PDFDiffPageContext& context : preparedPages)
+    {
+        auto it = splittedText.find(context.pageIndex);
+        if (it != splittedText.cend())
+        {
+            context.text = std::move(it->second);
+            splittedText.erase(it);
+        }
+    }
+}
+
 void PDFDiff::performPageMatching(const std::vector<PDFDiffPageContext>& leftPreparedPages,
                                   const std::vector<PDFDiffPageContext>& rightPreparedPages,
                                   PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
@@ -270,6 +803,11 @@ void PDFDiff::performPageMatching(const std::vector<PDFDiffPageContext>& leftPre
     auto matchLeftPage = [&, this](size_t leftIndex)
     {
         const PDFDiffPageContext& leftPageContext = leftPreparedPages[leftIndex];
+        if (!leftPageContext.isContentExtracted)
+        {
+            // Graphic pieces are not available
+            return;
+        }
 
         auto page = m_leftDocument->getCatalog()->getPage(leftPageContext.pageIndex);
         PDFReal epsilon = calculateEpsilonForPage(page);
@@ -277,7 +815,7 @@ void PDFDiff::performPageMatching(const std::vector<PDFDiffPageContext>& leftPre
         for (const size_t rightIndex : rightUnmatched)
         {
             const PDFDiffPageContext& rightPageContext = rightPreparedPages[rightIndex];
-            if (leftPageContext.graphicPieces.size() != rightPageContext.graphicPieces.size())
+            if (!rightPageContext.isContentExtracted || leftPageContext.graphicPieces.size() != rightPageContext.graphicPieces.size())
             {
                 // Match cannot exist, graphic pieces have different size
                 continue;
@@ -351,115 +889,100 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
     // StepExtractContentLeftDocument
     if (!m_cancelled)
     {
-        PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-        PDFOptionalContentActivity optionalContentActivity(m_leftDocument, pdf::OCUsage::View, nullptr);
-        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(m_leftDocument), &optionalContentActivity));
-
-        PDFCMSManager cmsManager(nullptr);
-        cmsManager.setDocument(m_leftDocument);
-        PDFCMSPointer cms = cmsManager.getCurrentCMS();
-
-        auto fillPageContext = [&, this](PDFDiffPageContext& context)
-        {
-            PDFPrecompiledPage compiledPage;
-            constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
-            PDFRenderer renderer(m_leftDocument, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
-            renderer.compile(&compiledPage, context.pageIndex);
-
-            auto page = m_leftDocument->getCatalog()->getPage(context.pageIndex);
-            PDFReal epsilon = calculateEpsilonForPage(page);
-            context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
-
-            finalizeGraphicsPieces(context);
-        };
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, leftPreparedPages.begin(), leftPreparedPages.end(), fillPageContext);
+        PDFTraceScope traceScope("diff-extract-content-left", "diff");
+        matchIdenticalPages(leftPreparedPages, rightPreparedPages);
+        extractPageContent(m_leftDocument, leftPreparedPages);
         stepProgress();
     }
 
     // StepExtractContentRightDocument
     if (!m_cancelled)
     {
-        PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-        PDFOptionalContentActivity optionalContentActivity(m_rightDocument, pdf::OCUsage::View, nullptr);
-        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(m_rightDocument), &optionalContentActivity));
-
-        PDFCMSManager cmsManager(nullptr);
-        cmsManager.setDocument(m_rightDocument);
-        PDFCMSPointer cms = cmsManager.getCurrentCMS();
-
-        auto fillPageContext = [&, this](PDFDiffPageContext& context)
-        {
-            PDFPrecompiledPage compiledPage;
-            constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
-            PDFRenderer renderer(m_rightDocument, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
-            renderer.compile(&compiledPage, context.pageIndex);
-
-            const PDFPage* page = m_rightDocument->getCatalog()->getPage(context.pageIndex);
-            PDFReal epsilon = calculateEpsilonForPage(page);
-            context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
-
-            finalizeGraphicsPieces(context);
-        };
-
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, rightPreparedPages.begin(), rightPreparedPages.end(), fillPageContext);
+        PDFTraceScope traceScope("diff-extract-content-right", "diff");
+        extractPageContent(m_rightDocument, rightPreparedPages);
         stepProgress();
     }
 
     // StepMatchPages
     if (!m_cancelled)
     {
+        PDFTraceScope traceScope("diff-match-pages", "diff");
         performPageMatching(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches);
-        stepProgress();
-    }
 
-    // StepExtractTextLeftDocument
-    if (!m_cancelled)
-    {
-        pdf::PDFDocumentTextFlowFactory factoryLeftDocumentTextFlow;
-        factoryLeftDocumentTextFlow.setCalculateBoundingBoxes(true);
-        PDFDocumentTextFlow leftTextFlow = factoryLeftDocumentTextFlow.create(m_leftDocument, leftPages, m_textAnalysisAlgorithm);
-        std::map<PDFInteger, PDFDocumentTextFlow> splittedText = leftTextFlow.split(PDFDocumentTextFlow::Text);
-        for (PDFDiffPageContext& leftContext : leftPreparedPages)
+        // Pages with identical source are usually matched with each other. If it
+        // is not the case (for example, page is duplicated), and page is modified (or moved),
+        // we extract its content (and content of its identical page) and perform matching again.
+        bool isMatchingRepeated = true;
+        while (isMatchingRepeated && !m_cancelled)
         {
-            auto it = splittedText.find(leftContext.pageIndex);
-            if (it != splittedText.cend())
+            isMatchingRepeated = false;
+            for (const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item : pageSequence)
+            {
+                if (!item.isModified() && !item.isMovedLeft() && !item.isMovedRight())
+                {
+                    continue;
+                }
+
+                for (auto [isValid, contexts, otherContexts, index] : { std::make_tuple(item.isLeftValid(), &leftPreparedPages, &rightPreparedPages, item.index1),
+                                                                        std::make_tuple(item.isRightValid(), &rightPreparedPages, &leftPreparedPages, item.index2) })
+                {
+                    if (isValid && (*contexts)[index].hasIdenticalPage())
+                    {
+                        PDFDiffPageContext& context = (*contexts)[index];
+                        (*otherContexts)[context.identicalPageIndex].identicalPageIndex = std::numeric_limits<size_t>::max();
+                        context.identicalPageIndex = std::numeric_limits<size_t>::max();
+                        isMatchingRepeated = true;
+                    }
+                }
+            }
+
+            if (isMatchingRepeated)
             {
-                leftContext.text = std::move(it->second);
-                splittedText.erase(it);
+                extractPageContent(m_leftDocument, leftPreparedPages);
+                extractPageContent(m_rightDocument, rightPreparedPages);
+
+                pageSequence.clear();
+                pageMatches.clear();
+                performPageMatching(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches);
             }
         }
+
         stepProgress();
     }
 
-    // StepExtractTextRightDocument
+    // StepExtractTextLeftDocument
     if (!m_cancelled)
     {
-        pdf::PDFDocumentTextFlowFactory factoryRightDocumentTextFlow;
-        factoryRightDocumentTextFlow.setCalculateBoundingBoxes(true);
-        PDFDocumentTextFlow rightTextFlow = factoryRightDocumentTextFlow.create(m_rightDocument, rightPages, m_textAnalysisAlgorithm);
-        std::map<PDFInteger, PDFDocumentTextFlow> splittedText = rightTextFlow.split(PDFDocumentTextFlow::Text);
-        for (PDFDiffPageContext& rightContext : rightPreparedPages)
-        {
-            auto it = splittedText.find(rightContext.pageIndex);
-            if (it != splittedText.cend())
-            {
-                rightContext.text = std::move(it->second);
-                splittedText.erase(it);
-            }
-        }
+        PDFTraceScope traceScope("diff-extract-text-left", "diff");
+        extractPageText(m_leftDocument, leftPreparedPages);
         stepProgress();
     }
 
-    // StepCompare
+    // StepExtractTextRightDocument
     if (!m_cancelled)
     {
-        performCompare(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches, result);
+        PDFTraceScope traceScope("diff-extract-text-right", "diff");
+        extractPageText(m_rightDocument, rightPreparedPages);
         stepProgress();
     }
-}
 
-void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPreparedPages,
-                             const std::vector<PDFDiffPageContext>& rightPreparedPages,
+    // StepCompare
+    if (!m_cancelled)
+    {
+        if (m_options.testFlag(CompareRaster))
+        {
+            PDFTraceScope traceScope("diff-compare-raster", "diff");
+            performRasterCompare(leftPreparedPages, rightPreparedPages, pageSequence);
+        }
+
+        PDFTraceScope traceScope("diff-compare", "diff");
+        performCompare(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches, result);
+        stepProgress();
+    }
+}
+
+void PDFDiff::performCompare(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                             std::vector<PDFDiffPageContext>& rightPreparedPages,
                              PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
                              const std::map<size_t, size_t>& pageMatches,
                              PDFDiffResult& result)
@@ -471,6 +994,7 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
     resultPageSequence.reserve(pageSequence.size());
 
     // First find all moved pages
+    PDFDiffResult movedPages;
     for (const AlgorithmLCS::SequenceItem& item : pageSequence)
     {
         if (item.isMovedLeft())
@@ -478,11 +1002,11 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
             Q_ASSERT(pageMatches.contains(leftPreparedPages.at(item.index1).pageIndex));
             const PDFInteger leftIndex = leftPreparedPages[item.index1].pageIndex;
             const PDFInteger rightIndex = pageMatches.at(leftIndex);
-            result.addPageMoved(leftIndex, rightIndex);
+            movedPages.addPageMoved(leftIndex, rightIndex);
         }
         if (item.isMoved())
         {
-            result.addPageMoved(leftPreparedPages[item.index1].pageIndex, rightPreparedPages[item.index2].pageIndex);
+            movedPages.addPageMoved(leftPreparedPages[item.index1].pageIndex, rightPreparedPages[item.index2].pageIndex);
         }
 
         PDFDiffResult::PageSequenceItem pageSequenceItem;
@@ -498,12 +1022,209 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
         }
         resultPageSequence.emplace_back(pageSequenceItem);
     }
-    result.setPageSequence(std::move(resultPageSequence));
+    appendPartialResult(movedPages);
+
+    // Jakub Melka: try to compare text differences
+    auto compareTexts = [this](PDFDiffHelper::TextFlowDifferences& context, PDFDiffResult& chunk)
+    {
+        using TextCompareItem = PDFDiffHelper::TextCompareItem;
+        const bool isWordsComparingMode = m_options.testFlag(CompareWords);
+
+        std::vector<TextCompareItem> leftItems;
+        std::vector<TextCompareItem> rightItems;
+
+        leftItems = PDFDiffHelper::prepareTextCompareItems(context.leftTextFlow, isWordsComparingMode, true);
+        rightItems = PDFDiffHelper::prepareTextCompareItems(context.rightTextFlow, isWordsComparingMode, false);
+
+        PDFDiffHelper::assignTextCompareItemIds(context, leftItems, rightItems);
+        PDFAlgorithmLongestCommonSubsequenceBase::Sequence sequence = PDFDiffHelper::compareTextCompareItems(leftItems, rightItems);
+        PDFAlgorithmLongestCommonSubsequenceBase::markSequence(sequence, { }, { });
+        PDFAlgorithmLongestCommonSubsequenceBase::SequenceItemRanges modifiedRanges = PDFAlgorithmLongestCommonSubsequenceBase::getModifiedRanges(sequence);
+
+        // Merge modified sequences separated by just space
+        if (!isWordsComparingMode && !modifiedRanges.empty())
+        {
+            auto itPrev = sequence.end();
+            for (const auto& range : modifiedRanges)
+            {
+                if (itPrev != sequence.end())
+                {
+                    auto itNext = range.first;
+
+                    bool isReplaced = true;
+                    for (auto it = itPrev; it != itNext && isReplaced; ++it)
+                    {
+                        const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item = *it;
+
+                        // If we doesn't have a match, then it is not a whitespace
+                        if (!item.isMatch())
+                        {
+                            isReplaced = false;
+                            break;
+                        }
+
+                        const TextCompareItem& compareItem = leftItems[item.index1];
+                        const auto& flowItem = compareItem.left ? context.leftTextFlow : context.rightTextFlow;
+                        QChar character = flowItem.getItem(compareItem.index)->text.at(compareItem.charIndex);
+
+                        isReplaced = !character.isSpace();
+                    }
+
+                    if (isReplaced)
+                    {
+                        for (auto it = itPrev; it != itNext; ++it)
+                        {
+                            PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item = *it;
+                            item.markReplaced();
+                        }
+                    }
+                }
+
+                itPrev = range.second;
+            }
+
+            modifiedRanges = PDFAlgorithmLongestCommonSubsequenceBase::getModifiedRanges(sequence);
+        }
+
+        for (const auto& range : modifiedRanges)
+        {
+            auto it = range.first;
+            auto itEnd = range.second;
+
+            QStringList leftStrings;
+            QStringList rightStrings;
+
+            PDFDiffResult::RectInfos leftRectInfos;
+            PDFDiffResult::RectInfos rightRectInfos;
+
+            PDFInteger pageIndex1 = -1;
+            PDFInteger pageIndex2 = -1;
+
+            for (; it != itEnd; ++it)
+            {
+                const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item = *it;
+
+                if (item.isLeftValid())
+                {
+                    const TextCompareItem& textCompareItem = leftItems[item.index1];
+                    const auto& textFlow = textCompareItem.left ? context.leftTextFlow : context.rightTextFlow;
+                    const PDFDocumentTextFlow::Item* textItem = textFlow.getItem(textCompareItem.index);
+
+                    QStringView text(textItem->text);
+                    text = text.mid(textCompareItem.charIndex, textCompareItem.charCount);
+
+                    leftStrings << text.toString();
+
+                    if (pageIndex1 == -1)
+                    {
+                        pageIndex1 = textItem->pageIndex;
+                    }
+
+                    if (static_cast< std::size_t >( textCompareItem.charIndex ) + textCompareItem.charCount <= textItem->characterBoundingRects.size())
+                    {
+                        const size_t startIndex =  textCompareItem.charIndex;
+                        const size_t endIndex = startIndex + textCompareItem.charCount;
 
-    std::vector<PDFDiffHelper::TextFlowDifferences> textFlowDifferences;
+                        for (size_t i = startIndex; i < endIndex; ++i)
+                        {
+                            leftRectInfos.emplace_back(textItem->pageIndex, textItem->characterBoundingRects[i]);
+                        }
+                    }
+                }
+
+                if (item.isRightValid())
+                {
+                    const TextCompareItem& textCompareItem = rightItems[item.index2];
+                    const auto& textFlow = textCompareItem.left ? context.leftTextFlow : context.rightTextFlow;
+                    const PDFDocumentTextFlow::Item* textItem = textFlow.getItem(textCompareItem.index);
 
-    for (const auto& range : modifiedRanges)
+                    QStringView text(textItem->text);
+                    text = text.mid(textCompareItem.charIndex, textCompareItem.charCount);
+
+                    rightStrings << text.toString();
+
+                    if (pageIndex2 == -1)
+                    {
+                        pageIndex2 = textItem->pageIndex;
+                    }
+
+                    if (static_cast< std::size_t >(textCompareItem.charIndex) + textCompareItem.charCount <= textItem->characterBoundingRects.size())
+                    {
+                        const size_t startIndex =  textCompareItem.charIndex;
+                        const size_t endIndex = startIndex + textCompareItem.charCount;
+
+                        for (size_t i = startIndex; i < endIndex; ++i)
+                        {
+                            rightRectInfos.emplace_back(textItem->pageIndex, textItem->characterBoundingRects[i]);
+                        }
+                    }
+                }
+            }
+
+            QString leftString;
+            QString rightString;
+
+            if (isWordsComparingMode)
+            {
+                leftString = leftStrings.join(QChar::Space);
+                rightString = rightStrings.join(QChar::Space);
+            }
+            else
+            {
+                leftString = leftStrings.join(QString());
+                rightString = rightStrings.join(QString());
+            }
+
+            PDFDiffHelper::refineTextRectangles(leftRectInfos);
+            PDFDiffHelper::refineTextRectangles(rightRectInfos);
+
+            if (!leftString.isEmpty() && !rightString.isEmpty())
+            {
+                chunk.addTextReplaced(pageIndex1, pageIndex2, leftString, rightString, leftRectInfos, rightRectInfos);
+            }
+            else
+            {
+                if (!leftString.isEmpty())
+                {
+                    chunk.addTextRemoved(pageIndex1, leftString, leftRectInfos);
+                }
+
+                if (!rightString.isEmpty())
+                {
+                    chunk.addTextAdded(pageIndex2, rightString, rightRectInfos);
+                }
+            }
+        }
+    };
+
+    // Page ranges are compared in parallel. Differences of each range
+    // are published as a chunk as soon as all previous ranges are finished, so partial
+    // result contains differences in the order of pages. Content of pages is released,
+    // when it is no longer needed, so only pages being compared are held in the memory.
+    for (const AlgorithmLCS::SequenceItem& item : pageSequence)
+    {
+        if (!item.isModified())
+        {
+            releasePageContent(leftPreparedPages, rightPreparedPages, item);
+        }
+    }
+
+    std::vector<std::optional<PDFDiffResult>> chunks(modifiedRanges.size());
+    size_t publishedChunkCount = 0;
+    QMutex chunkMutex;
+
+    auto compareRange = [&, this](size_t rangeIndex)
     {
+        PDFDiffResult chunk;
+        const auto& range = modifiedRanges[rangeIndex];
+
+        if (m_cancelled)
+        {
+            return;
+        }
+
+        std::vector<PDFDiffHelper::TextFlowDifferences> textFlowDifferences;
+
         AlgorithmLCS::SequenceItemFlags flags = AlgorithmLCS::collectFlags(range);
 
         const bool isAdded = flags.testFlag(AlgorithmLCS::Added);
@@ -520,6 +1241,7 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
             PDFDocumentTextFlow rightTextFlow;
 
             const bool isTextComparedAsVectorGraphics = m_options.testFlag(CompareTextsAsVector);
+            const bool isRasterCompared = m_options.testFlag(CompareRaster);
 
             for (auto it = range.first; it != range.second; ++it)
             {
@@ -535,6 +1257,17 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
                         rightTextFlow.append(rightPageContext.text);
                     }
 
+                    if (isRasterCompared)
+                    {
+                        Q_ASSERT(leftPageContext.rasterDifferences.size() == rightPageContext.rasterDifferences.size());
+                        for (size_t i = 0; i < leftPageContext.rasterDifferences.size(); ++i)
+                        {
+                            chunk.addRasterContentChanged(leftPageContext.pageIndex, rightPageContext.pageIndex,
+                                                          leftPageContext.rasterDifferences[i], rightPageContext.rasterDifferences[i]);
+                        }
+                        continue;
+                    }
+
                     auto pageLeft = m_leftDocument->getCatalog()->getPage(leftPageContext.pageIndex);
                     auto pageRight = m_rightDocument->getCatalog()->getPage(rightPageContext.pageIndex);
                     PDFReal epsilon = (calculateEpsilonForPage(pageLeft) + calculateEpsilonForPage(pageRight)) * 0.5;
@@ -548,20 +1281,20 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
                             case PDFDiffHelper::GraphicPieceInfo::Type::Text:
                                 if (isTextComparedAsVectorGraphics)
                                 {
-                                    result.addRemovedTextCharContent(leftPageContext.pageIndex, info.boundingRect);
+                                    chunk.addRemovedTextCharContent(leftPageContext.pageIndex, info.boundingRect);
                                 }
                                 break;
 
                             case PDFDiffHelper::GraphicPieceInfo::Type::VectorGraphics:
-                                result.addRemovedVectorGraphicContent(leftPageContext.pageIndex, info.boundingRect);
+                                chunk.addRemovedVectorGraphicContent(leftPageContext.pageIndex, info.boundingRect);
                                 break;
 
                             case PDFDiffHelper::GraphicPieceInfo::Type::Image:
-                                result.addRemovedImageContent(leftPageContext.pageIndex, info.boundingRect);
+                                chunk.addRemovedImageContent(leftPageContext.pageIndex, info.boundingRect);
                                 break;
 
                             case PDFDiffHelper::GraphicPieceInfo::Type::Shading:
-                                result.addRemovedShadingContent(leftPageContext.pageIndex, info.boundingRect);
+                                chunk.addRemovedShadingContent(leftPageContext.pageIndex, info.boundingRect);
                                 break;
 
                             default:
@@ -577,20 +1310,20 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
                             case PDFDiffHelper::GraphicPieceInfo::Type::Text:
                                 if (isTextComparedAsVectorGraphics)
                                 {
-                                    result.addAddedTextCharContent(rightPageContext.pageIndex, info.boundingRect);
+                                    chunk.addAddedTextCharContent(rightPageContext.pageIndex, info.boundingRect);
                                 }
                                 break;
 
                             case PDFDiffHelper::GraphicPieceInfo::Type::VectorGraphics:
-                                result.addAddedVectorGraphicContent(rightPageContext.pageIndex, info.boundingRect);
+                                chunk.addAddedVectorGraphicContent(rightPageContext.pageIndex, info.boundingRect);
                                 break;
 
                             case PDFDiffHelper::GraphicPieceInfo::Type::Image:
-                                result.addAddedImageContent(rightPageContext.pageIndex, info.boundingRect);
+                                chunk.addAddedImageContent(rightPageContext.pageIndex, info.boundingRect);
                                 break;
 
                             case PDFDiffHelper::GraphicPieceInfo::Type::Shading:
-                                result.addAddedShadingContent(rightPageContext.pageIndex, info.boundingRect);
+                                chunk.addAddedShadingContent(rightPageContext.pageIndex, info.boundingRect);
                                 break;
 
                             default:
@@ -609,7 +1342,7 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
                         rightTextFlow.append(rightPageContext.text);
                     }
 
-                    result.addPageAdded(rightPageContext.pageIndex);
+                    chunk.addPageAdded(rightPageContext.pageIndex);
                 }
                 if (item.isRemoved())
                 {
@@ -620,7 +1353,7 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
                         leftTextFlow.append(leftPageContext.text);
                     }
 
-                    result.addPageRemoved(leftPageContext.pageIndex);
+                    chunk.addPageRemoved(leftPageContext.pageIndex);
                 }
             }
 
@@ -649,212 +1382,155 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
 
                 if (item.isAdded())
                 {
-                    result.addPageAdded(rightPreparedPages[item.index2].pageIndex);
+                    chunk.addPageAdded(rightPreparedPages[item.index2].pageIndex);
                 }
                 if (item.isRemoved())
                 {
-                    result.addPageRemoved(leftPreparedPages[item.index1].pageIndex);
+                    chunk.addPageRemoved(leftPreparedPages[item.index1].pageIndex);
                 }
             }
         }
-    }
 
-    QMutex mutex;
-
-    // Jakub Melka: try to compare text differences
-    auto compareTexts = [this, &mutex, &result](PDFDiffHelper::TextFlowDifferences& context)
-    {
-        using TextCompareItem = PDFDiffHelper::TextCompareItem;
-        const bool isWordsComparingMode = m_options.testFlag(CompareWords);
-
-        std::vector<TextCompareItem> leftItems;
-        std::vector<TextCompareItem> rightItems;
-
-        leftItems = PDFDiffHelper::prepareTextCompareItems(context.leftTextFlow, isWordsComparingMode, true);
-        rightItems = PDFDiffHelper::prepareTextCompareItems(context.rightTextFlow, isWordsComparingMode, false);
-
-        auto compareCharacters = [&](const TextCompareItem& a, const TextCompareItem& b)
+        for (PDFDiffHelper::TextFlowDifferences& context : textFlowDifferences)
         {
-            const auto& aItem = a.left ? context.leftTextFlow : context.rightTextFlow;
-            const auto& bItem = b.left ? context.leftTextFlow : context.rightTextFlow;
-
-            QStringView aText(aItem.getItem(a.index)->text);
-            aText = aText.mid(a.charIndex, a.charCount);
-
-            QStringView bText(bItem.getItem(b.index)->text);
-            bText = bText.mid(b.charIndex, b.charCount);
-
-            return aText == bText;
-        };
-        PDFAlgorithmLongestCommonSubsequence algorithm(leftItems.cbegin(), leftItems.cend(),
-                                                       rightItems.cbegin(), rightItems.cend(),
-                                                       compareCharacters);
-        algorithm.perform();
-        PDFAlgorithmLongestCommonSubsequenceBase::Sequence sequence = algorithm.getSequence();
-        PDFAlgorithmLongestCommonSubsequenceBase::markSequence(sequence, { }, { });
-        PDFAlgorithmLongestCommonSubsequenceBase::SequenceItemRanges modifiedRanges = PDFAlgorithmLongestCommonSubsequenceBase::getModifiedRanges(sequence);
+            compareTexts(context, chunk);
+        }
 
-        // Merge modified sequences separated by just space
-        if (!isWordsComparingMode && !modifiedRanges.empty())
+        for (auto it = range.first; it != range.second; ++it)
         {
-            auto itPrev = sequence.end();
-            for (const auto& range : modifiedRanges)
-            {
-                if (itPrev != sequence.end())
-                {
-                    auto itNext = range.first;
-
-                    bool isReplaced = true;
-                    for (auto it = itPrev; it != itNext && isReplaced; ++it)
-                    {
-                        const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item = *it;
-
-                        // If we doesn't have a match, then it is not a whitespace
-                        if (!item.isMatch())
-                        {
-                            isReplaced = false;
-                            break;
-                        }
-
-                        const TextCompareItem& compareItem = leftItems[item.index1];
-                        const auto& flowItem = compareItem.left ? context.leftTextFlow : context.rightTextFlow;
-                        QChar character = flowItem.getItem(compareItem.index)->text.at(compareItem.charIndex);
-
-                        isReplaced = !character.isSpace();
-                    }
-
-                    if (isReplaced)
-                    {
-                        for (auto it = itPrev; it != itNext; ++it)
-                        {
-                            PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item = *it;
-                            item.markReplaced();
-                        }
-                    }
-                }
-
-                itPrev = range.second;
-            }
-
-            modifiedRanges = PDFAlgorithmLongestCommonSubsequenceBase::getModifiedRanges(sequence);
+            releasePageContent(leftPreparedPages, rightPreparedPages, *it);
         }
 
-        for (const auto& range : modifiedRanges)
+        QMutexLocker locker(&chunkMutex);
+        chunks[rangeIndex] = std::move(chunk);
+        for (; publishedChunkCount < chunks.size() && chunks[publishedChunkCount].has_value(); ++publishedChunkCount)
         {
-            auto it = range.first;
-            auto itEnd = range.second;
-
-            QStringList leftStrings;
-            QStringList rightStrings;
-
-            PDFDiffResult::RectInfos leftRectInfos;
-            PDFDiffResult::RectInfos rightRectInfos;
+            appendPartialResult(*chunks[publishedChunkCount]);
+            chunks[publishedChunkCount].reset();
+        }
+    };
 
-            PDFInteger pageIndex1 = -1;
-            PDFInteger pageIndex2 = -1;
+    auto rangeIndices = PDFIntegerRange<size_t>(0, modifiedRanges.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, rangeIndices.begin(), rangeIndices.end(), compareRange);
 
-            for (; it != itEnd; ++it)
-            {
-                const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item = *it;
+    {
+        QMutexLocker locker(&m_partialResultMutex);
+        result.append(m_partialResult);
+    }
+    result.setPageSequence(std::move(resultPageSequence));
 
-                if (item.isLeftValid())
-                {
-                    const TextCompareItem& textCompareItem = leftItems[item.index1];
-                    const auto& textFlow = textCompareItem.left ? context.leftTextFlow : context.rightTextFlow;
-                    const PDFDocumentTextFlow::Item* textItem = textFlow.getItem(textCompareItem.index);
+    // Jakub Melka: sort results
+    result.finalize();
+}
 
-                    QStringView text(textItem->text);
-                    text = text.mid(textCompareItem.charIndex, textCompareItem.charCount);
+void PDFDiff::performRasterCompare(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                                   std::vector<PDFDiffPageContext>& rightPreparedPages,
+                                   const PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence)
+{
+    std::vector<std::pair<size_t, size_t>> pagePairs;
+    for (const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item : pageSequence)
+    {
+        if (item.isReplaced() && item.isMatch())
+        {
+            pagePairs.emplace_back(item.index1, item.index2);
+        }
+    }
 
-                    leftStrings << text.toString();
+    if (pagePairs.empty())
+    {
+        return;
+    }
 
-                    if (pageIndex1 == -1)
-                    {
-                        pageIndex1 = textItem->pageIndex;
-                    }
+    constexpr PDFRenderer::Features features = PDFRenderer::Antialiasing | PDFRenderer::TextAntialiasing | PDFRenderer::ClipToCropBox;
+    PDFDiffRasterDocumentContext leftContext(m_leftDocument, features);
+    PDFDiffRasterDocumentContext rightContext(m_rightDocument, features);
 
-                    if (static_cast< std::size_t >( textCompareItem.charIndex ) + textCompareItem.charCount <= textItem->characterBoundingRects.size())
-                    {
-                        const size_t startIndex =  textCompareItem.charIndex;
-                        const size_t endIndex = startIndex + textCompareItem.charCount;
+    auto comparePages = [&, this](const std::pair<size_t, size_t>& pagePair)
+    {
+        if (m_cancelled)
+        {
+            return;
+        }
 
-                        for (size_t i = startIndex; i < endIndex; ++i)
-                        {
-                            leftRectInfos.emplace_back(textItem->pageIndex, textItem->characterBoundingRects[i]);
-                        }
-                    }
-                }
+        PDFDiffPageContext& leftPageContext = leftPreparedPages[pagePair.first];
+        PDFDiffPageContext& rightPageContext = rightPreparedPages[pagePair.second];
+        const PDFPage* leftPage = m_leftDocument->getCatalog()->getPage(leftPageContext.pageIndex);
+        const PDFPage* rightPage = m_rightDocument->getCatalog()->getPage(rightPageContext.pageIndex);
 
-                if (item.isRightValid())
-                {
-                    const TextCompareItem& textCompareItem = rightItems[item.index2];
-                    const auto& textFlow = textCompareItem.left ? context.leftTextFlow : context.rightTextFlow;
-                    const PDFDocumentTextFlow::Item* textItem = textFlow.getItem(textCompareItem.index);
+        // Both pages are rendered to the images of the same size (determined
+        // by the left page), so if page sizes differ, right page is scaled.
+        const QSizeF scaledPageSize = leftPage->getRotatedMediaBox().size() * (m_rasterResolution / 72.0);
+        const QSize imageSize = scaledPageSize.toSize().expandedTo(QSize(1, 1));
+        const QRectF imageRect(QPointF(0, 0), imageSize);
 
-                    QStringView text(textItem->text);
-                    text = text.mid(textCompareItem.charIndex, textCompareItem.charCount);
+        QImage leftImage = leftContext.render(leftPageContext.pageIndex, imageSize);
+        QImage rightImage = rightContext.render(rightPageContext.pageIndex, imageSize);
 
-                    rightStrings << text.toString();
+        const QTransform leftMatrix = PDFRenderer::createPagePointToDevicePointMatrix(leftPage, imageRect).inverted();
+        const QTransform rightMatrix = PDFRenderer::createPagePointToDevicePointMatrix(rightPage, imageRect).inverted();
 
-                    if (pageIndex2 == -1)
-                    {
-                        pageIndex2 = textItem->pageIndex;
-                    }
+        for (const QRect& rect : PDFDiffHelper::calculateRasterDifferences(leftImage, rightImage, m_rasterTolerance))
+        {
+            leftPageContext.rasterDifferences.push_back(leftMatrix.mapRect(QRectF(rect)));
+            rightPageContext.rasterDifferences.push_back(rightMatrix.mapRect(QRectF(rect)));
+        }
+    };
 
-                    if (static_cast< std::size_t >(textCompareItem.charIndex) + textCompareItem.charCount <= textItem->characterBoundingRects.size())
-                    {
-                        const size_t startIndex =  textCompareItem.charIndex;
-                        const size_t endIndex = startIndex + textCompareItem.charCount;
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pagePairs.cbegin(), pagePairs.cend(), comparePages);
+}
 
-                        for (size_t i = startIndex; i < endIndex; ++i)
-                        {
-                            rightRectInfos.emplace_back(textItem->pageIndex, textItem->characterBoundingRects[i]);
-                        }
-                    }
-                }
-            }
+void PDFDiff::releasePageContent(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                                 std::vector<PDFDiffPageContext>& rightPreparedPages,
+                                 const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item)
+{
+    for (auto [isValid, context] : { std::make_pair(item.isLeftValid(), item.isLeftValid() ? &leftPreparedPages[item.index1] : nullptr),
+                                     std::make_pair(item.isRightValid(), item.isRightValid() ? &rightPreparedPages[item.index2] : nullptr) })
+    {
+        if (isValid)
+        {
+            context->graphicPieces = PDFPrecompiledPage::GraphicPieceInfos();
+            context->text = PDFDocumentTextFlow();
+            context->rasterDifferences = std::vector<QRectF>();
+        }
+    }
+}
 
-            QString leftString;
-            QString rightString;
+void PDFDiff::appendPartialResult(const PDFDiffResult& result)
+{
+    if (result.m_differences.empty())
+    {
+        return;
+    }
 
-            if (isWordsComparingMode)
-            {
-                leftString = leftStrings.join(QChar::Space);
-                rightString = rightStrings.join(QChar::Space);
-            }
-            else
-            {
-                leftString = leftStrings.join(QString());
-                rightString = rightStrings.join(QString());
-            }
+    bool isSignalEmitted = false;
 
-            PDFDiffHelper::refineTextRectangles(leftRectInfos);
-            PDFDiffHelper::refineTextRectangles(rightRectInfos);
+    {
+        QMutexLocker locker(&m_partialResultMutex);
+        m_partialResult.append(result);
 
-            QMutexLocker locker(&mutex);
-            if (!leftString.isEmpty() && !rightString.isEmpty())
-            {
-                result.addTextReplaced(pageIndex1, pageIndex2, leftString, rightString, leftRectInfos, rightRectInfos);
-            }
-            else
-            {
-                if (!leftString.isEmpty())
-                {
-                    result.addTextRemoved(pageIndex1, leftString, leftRectInfos);
-                }
+        if (m_options.testFlag(StopAtFirstDifference))
+        {
+            // Remaining steps and page ranges are skipped
+            m_cancelled = true;
+        }
 
-                if (!rightString.isEmpty())
-                {
-                    result.addTextAdded(pageIndex2, rightString, rightRectInfos);
-                }
-            }
+        if (!m_partialResultTimer.isValid() || m_partialResultTimer.elapsed() >= PARTIAL_RESULT_INTERVAL)
+        {
+            m_partialResultTimer.start();
+            isSignalEmitted = true;
         }
-    };
+    }
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, textFlowDifferences.begin(), textFlowDifferences.end(), compareTexts);
+    if (isSignalEmitted)
+    {
+        Q_EMIT partialResultAvailable();
+    }
+}
 
-    // Jakub Melka: sort results
-    result.finalize();
+PDFDiffResult PDFDiff::getPartialResult() const
+{
+    QMutexLocker locker(&m_partialResultMutex);
+    return m_partialResult;
 }
 
 void PDFDiff::finalizeGraphicsPieces(PDFDiffPageContext& context)
@@ -925,6 +1601,16 @@ void PDFDiff::setTextAnalysisAlgorithm(PDFDocumentTextFlowFactory::Algorithm tex
     m_textAnalysisAlgorithm = textAnalysisAlgorithm;
 }
 
+void PDFDiff::setRasterResolution(PDFReal rasterResolution)
+{
+    m_rasterResolution = qBound(10.0, rasterResolution, 1200.0);
+}
+
+void PDFDiff::setRasterTolerance(int rasterTolerance)
+{
+    m_rasterTolerance = qBound(0, rasterTolerance, 255);
+}
+
 PDFDiffResult::PDFDiffResult() :
     m_result(true)
 {
@@ -1086,6 +1772,23 @@ void PDFDiffResult::addTextReplaced(PDFInteger pageIndex1,
     m_differences.emplace_back(std::move(difference));
 }
 
+void PDFDiffResult::addRasterContentChanged(PDFInteger pageIndex1,
+                                            PDFInteger pageIndex2,
+                                            QRectF rect1,
+                                            QRectF rect2)
+{
+    Difference difference;
+
+    difference.type = Type::RasterContentChanged;
+    difference.pageIndex1 = pageIndex1;
+    difference.pageIndex2 = pageIndex2;
+
+    addRectLeft(difference, rect1);
+    addRectRight(difference, rect2);
+
+    m_differences.emplace_back(std::move(difference));
+}
+
 void PDFDiffResult::saveToStream(QXmlStreamWriter* stream) const
 {
     stream->setAutoFormatting(true);
@@ -1096,99 +1799,118 @@ void PDFDiffResult::saveToStream(QXmlStreamWriter* stream) const
 
     // Jakub Melka: write all differences
     stream->writeStartElement("differences");
-    for (const Difference& difference : m_differences)
+    for (size_t i = 0; i < m_differences.size(); ++i)
     {
-        stream->writeStartElement("difference");
+        saveDifferenceToXML(stream, i);
+    }
+    stream->writeEndElement();
 
-        QString type;
-        switch (difference.type)
-        {
-            case Type::PageMoved:
-                type = "page-moved";
-                break;
+    savePageSequenceToXML(stream);
 
-            case Type::PageAdded:
-                type = "page-added";
-                break;
+    stream->writeEndElement();
+    stream->writeEndDocument();
+}
 
-            case Type::PageRemoved:
-                type = "page-removed";
-                break;
+void PDFDiffResult::saveDifferenceToXML(QXmlStreamWriter* stream, size_t index) const
+{
+    const Difference& difference = m_differences.at(index);
 
-            case Type::RemovedTextCharContent:
-                type = "removed-text-char";
-                break;
+    stream->writeStartElement("difference");
 
-            case Type::RemovedVectorGraphicContent:
-                type = "removed-vector-graphics";
-                break;
+    QString type;
+    switch (difference.type)
+    {
+        case Type::PageMoved:
+            type = "page-moved";
+            break;
 
-            case Type::RemovedImageContent:
-                type = "removed-image";
-                break;
+        case Type::PageAdded:
+            type = "page-added";
+            break;
 
-            case Type::RemovedShadingContent:
-                type = "removed-shading";
-                break;
+        case Type::PageRemoved:
+            type = "page-removed";
+            break;
 
-            case Type::AddedTextCharContent:
-                type = "added-text-char";
-                break;
+        case Type::RemovedTextCharContent:
+            type = "removed-text-char";
+            break;
 
-            case Type::AddedVectorGraphicContent:
-                type = "added-vector-graphics";
-                break;
+        case Type::RemovedVectorGraphicContent:
+            type = "removed-vector-graphics";
+            break;
 
-            case Type::AddedImageContent:
-                type = "added-image";
-                break;
+        case Type::RemovedImageContent:
+            type = "removed-image";
+            break;
 
-            case Type::AddedShadingContent:
-                type = "added-shading";
-                break;
+        case Type::RemovedShadingContent:
+            type = "removed-shading";
+            break;
 
-            case Type::TextAdded:
-                type = "text-added";
-                break;
+        case Type::AddedTextCharContent:
+            type = "added-text-char";
+            break;
 
-            case Type::TextRemoved:
-                type = "text-removed";
-                break;
+        case Type::AddedVectorGraphicContent:
+            type = "added-vector-graphics";
+            break;
 
-            case Type::TextReplaced:
-                type = "text-replaced";
-                break;
+        case Type::AddedImageContent:
+            type = "added-image";
+            break;
 
-            default:
-                Q_ASSERT(false);
-                break;
-        }
-        stream->writeAttribute("type", type);
+        case Type::AddedShadingContent:
+            type = "added-shading";
+            break;
 
-        if (difference.pageIndex1 != -1)
-        {
-            stream->writeAttribute("left", QString::number(difference.pageIndex1 + 1));
-        }
+        case Type::TextAdded:
+            type = "text-added";
+            break;
 
-        if (difference.pageIndex2 != -1)
-        {
-            stream->writeAttribute("right", QString::number(difference.pageIndex2 + 1));
-        }
+        case Type::TextRemoved:
+            type = "text-removed";
+            break;
 
-        if (difference.textAddedIndex != -1)
-        {
-            stream->writeTextElement("text-added", m_strings[difference.textAddedIndex]);
-        }
+        case Type::TextReplaced:
+            type = "text-replaced";
+            break;
 
-        if (difference.textRemovedIndex != -1)
-        {
-            stream->writeTextElement("text-removed", m_strings[difference.textRemovedIndex]);
-        }
+        case Type::RasterContentChanged:
+            type = "raster-content-changed";
+            break;
 
-        stream->writeEndElement();
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+    stream->writeAttribute("type", type);
+
+    if (difference.pageIndex1 != -1)
+    {
+        stream->writeAttribute("left", QString::number(difference.pageIndex1 + 1));
+    }
+
+    if (difference.pageIndex2 != -1)
+    {
+        stream->writeAttribute("right", QString::number(difference.pageIndex2 + 1));
+    }
+
+    if (difference.textAddedIndex != -1)
+    {
+        stream->writeTextElement("text-added", m_strings[difference.textAddedIndex]);
     }
+
+    if (difference.textRemovedIndex != -1)
+    {
+        stream->writeTextElement("text-removed", m_strings[difference.textRemovedIndex]);
+    }
+
     stream->writeEndElement();
+}
 
+void PDFDiffResult::savePageSequenceToXML(QXmlStreamWriter* stream) const
+{
     stream->writeStartElement("page-sequence");
     for (const PageSequenceItem& item : m_pageSequence)
     {
@@ -1203,9 +1925,34 @@ void PDFDiffResult::saveToStream(QXmlStreamWriter* stream) const
         stream->writeEndElement();
     }
     stream->writeEndElement();
+}
 
-    stream->writeEndElement();
-    stream->writeEndDocument();
+void PDFDiffResult::append(const PDFDiffResult& result)
+{
+    const size_t rectOffset = m_rects.size();
+    const int stringOffset = m_strings.size();
+
+    for (Difference difference : result.m_differences)
+    {
+        difference.leftRectIndex += rectOffset;
+        difference.rightRectIndex += rectOffset;
+
+        if (difference.textAddedIndex != -1)
+        {
+            difference.textAddedIndex += stringOffset;
+        }
+
+        if (difference.textRemovedIndex != -1)
+        {
+            difference.textRemovedIndex += stringOffset;
+        }
+
+        m_typeFlags |= static_cast<uint32_t>(difference.type);
+        m_differences.push_back(difference);
+    }
+
+    m_rects.insert(m_rects.end(), result.m_rects.cbegin(), result.m_rects.cend());
+    m_strings.append(result.m_strings);
 }
 
 void PDFDiffResult::finalize()
@@ -1286,6 +2033,9 @@ QString PDFDiffResult::getMessage(size_t index) const
         case Type::TextReplaced:
             return PDFDiff::tr("Text '%1' on page %2 has been replaced by text '%3' on page %4.").arg(m_strings[difference.textRemovedIndex]).arg(difference.pageIndex1 + 1).arg(m_strings[difference.textAddedIndex]).arg(difference.pageIndex2 + 1);
 
+        case Type::RasterContentChanged:
+            return PDFDiff::tr("Content of page %1 differs visually from content of page %2.").arg(difference.pageIndex1 + 1).arg(difference.pageIndex2 + 1);
+
         default:
             Q_ASSERT(false);
             break;
@@ -1358,6 +2108,8 @@ QString PDFDiffResult::getTypeDescription(size_t index) const
             return PDFDiff::tr("Text removed");
         case Type::TextReplaced:
             return PDFDiff::tr("Text replaced");
+        case Type::RasterContentChanged:
+            return PDFDiff::tr("Visual content changed");
 
         default:
             Q_ASSERT(false);
@@ -1741,6 +2493,208 @@ std::vector<PDFDiffHelper::TextCompareItem> PDFDiffHelper::prepareTextCompareIte
     return items;
 }
 
+void PDFDiffHelper::assignTextCompareItemIds(const TextFlowDifferences& context,
+                                             std::vector<TextCompareItem>& leftItems,
+                                             std::vector<TextCompareItem>& rightItems)
+{
+    QHash<QStringView, quint32> ids;
+
+    for (std::vector<TextCompareItem>* items : { &leftItems, &rightItems })
+    {
+        for (TextCompareItem& item : *items)
+        {
+            const PDFDocumentTextFlow& textFlow = item.left ? context.leftTextFlow : context.rightTextFlow;
+            QStringView text = QStringView(textFlow.getItem(item.index)->text).mid(item.charIndex, item.charCount);
+
+            auto it = ids.constFind(text);
+            if (it == ids.cend())
+            {
+                it = ids.insert(text, static_cast<quint32>(ids.size()));
+            }
+
+            item.id = it.value();
+        }
+    }
+}
+
+PDFAlgorithmLongestCommonSubsequenceBase::Sequence PDFDiffHelper::compareTextCompareItems(const std::vector<TextCompareItem>& leftItems,
+                                                                                          const std::vector<TextCompareItem>& rightItems)
+{
+    using Sequence = PDFAlgorithmLongestCommonSubsequenceBase::Sequence;
+    using SequenceItem = PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem;
+
+    auto compareItems = [](const TextCompareItem& a, const TextCompareItem& b) { return a.id == b.id; };
+
+    // Computes subsequence of ranges [first1, last1) and [first2, last2)
+    auto compareRanges = [&](size_t first1, size_t last1, size_t first2, size_t last2)
+    {
+        PDFAlgorithmLongestCommonSubsequence algorithm(std::next(leftItems.cbegin(), first1), std::next(leftItems.cbegin(), last1),
+                                                       std::next(rightItems.cbegin(), first2), std::next(rightItems.cbegin(), last2),
+                                                       compareItems);
+        algorithm.perform();
+
+        Sequence sequence = algorithm.getSequence();
+        for (SequenceItem& item : sequence)
+        {
+            if (item.isLeftValid())
+            {
+                item.index1 += first1;
+            }
+
+            if (item.isRightValid())
+            {
+                item.index2 += first2;
+            }
+        }
+
+        return sequence;
+    };
+
+    if (leftItems.size() + rightItems.size() < PARALLEL_TEXT_COMPARE_LIMIT)
+    {
+        return compareRanges(0, leftItems.size(), 0, rightItems.size());
+    }
+
+    // Text flow items (paragraphs) are used as anchors. Paragraph, which
+    // is unique in both texts and has the same text, is matched directly, and parts of the
+    // texts between matched paragraphs are compared independently (in parallel). Paragraphs
+    // are identified by rolling hash of identifiers of its items.
+    struct Paragraph
+    {
+        size_t first = 0;
+        size_t last = 0;
+        quint64 hash = 0;
+    };
+
+    auto createParagraphs = [](const std::vector<TextCompareItem>& items)
+    {
+        std::vector<Paragraph> paragraphs;
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            if (paragraphs.empty() || items[paragraphs.back().first].index != items[i].index)
+            {
+                paragraphs.push_back({ i, i, 0 });
+            }
+
+            Paragraph& paragraph = paragraphs.back();
+            paragraph.last = i + 1;
+            paragraph.hash = paragraph.hash * 0x100000001B3ULL + items[i].id + 1;
+        }
+        return paragraphs;
+    };
+
+    std::vector<Paragraph> leftParagraphs = createParagraphs(leftItems);
+    std::vector<Paragraph> rightParagraphs = createParagraphs(rightItems);
+
+    // Find paragraphs unique in both texts, value is pair of paragraph indices (or max, if not unique)
+    constexpr size_t INVALID_INDEX = std::numeric_limits<size_t>::max();
+    std::unordered_map<quint64, std::pair<size_t, size_t>> uniqueParagraphs;
+    for (size_t i = 0; i < leftParagraphs.size(); ++i)
+    {
+        auto [it, inserted] = uniqueParagraphs.try_emplace(leftParagraphs[i].hash, i, INVALID_INDEX);
+        if (!inserted)
+        {
+            it->second.first = INVALID_INDEX;
+        }
+    }
+    for (size_t i = 0; i < rightParagraphs.size(); ++i)
+    {
+        auto it = uniqueParagraphs.find(rightParagraphs[i].hash);
+        if (it != uniqueParagraphs.end())
+        {
+            // Second occurence makes the paragraph non-unique
+            it->second.second = (it->second.second == INVALID_INDEX) ? i : INVALID_INDEX - 1;
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> candidateAnchors;
+    for (const auto& [hash, indices] : uniqueParagraphs)
+    {
+        if (indices.first >= INVALID_INDEX - 1 || indices.second >= INVALID_INDEX - 1)
+        {
+            continue;
+        }
+
+        const Paragraph& leftParagraph = leftParagraphs[indices.first];
+        const Paragraph& rightParagraph = rightParagraphs[indices.second];
+
+        // Verify, that paragraphs are really the same (hash can collide)
+        if (std::equal(std::next(leftItems.cbegin(), leftParagraph.first), std::next(leftItems.cbegin(), leftParagraph.last),
+                       std::next(rightItems.cbegin(), rightParagraph.first), std::next(rightItems.cbegin(), rightParagraph.last),
+                       compareItems))
+        {
+            candidateAnchors.push_back(indices);
+        }
+    }
+    std::sort(candidateAnchors.begin(), candidateAnchors.end());
+
+    // Select anchors in the same order in both texts (longest increasing
+    // subsequence of right paragraph indices, patience sorting is used).
+    std::vector<size_t> pileTops;
+    std::vector<size_t> predecessors(candidateAnchors.size(), INVALID_INDEX);
+    for (size_t i = 0; i < candidateAnchors.size(); ++i)
+    {
+        auto it = std::lower_bound(pileTops.begin(), pileTops.end(), candidateAnchors[i].second, [&](size_t index, size_t value) { return candidateAnchors[index].second < value; });
+        if (it != pileTops.begin())
+        {
+            predecessors[i] = *std::prev(it);
+        }
+
+        if (it == pileTops.end())
+        {
+            pileTops.push_back(i);
+        }
+        else
+        {
+            *it = i;
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> anchors;
+    for (size_t i = pileTops.empty() ? INVALID_INDEX : pileTops.back(); i != INVALID_INDEX; i = predecessors[i])
+    {
+        anchors.push_back(candidateAnchors[i]);
+    }
+    std::reverse(anchors.begin(), anchors.end());
+
+    // Compare parts between anchors, last part is after the last anchor
+    std::vector<Sequence> sequences(anchors.size() + 1);
+    auto comparePart = [&](size_t partIndex)
+    {
+        const size_t first1 = partIndex > 0 ? leftParagraphs[anchors[partIndex - 1].first].last : 0;
+        const size_t first2 = partIndex > 0 ? rightParagraphs[anchors[partIndex - 1].second].last : 0;
+        const size_t last1 = partIndex < anchors.size() ? leftParagraphs[anchors[partIndex].first].first : leftItems.size();
+        const size_t last2 = partIndex < anchors.size() ? rightParagraphs[anchors[partIndex].second].first : rightItems.size();
+        sequences[partIndex] = compareRanges(first1, last1, first2, last2);
+    };
+
+    auto range = PDFIntegerRange<size_t>(0, sequences.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), comparePart);
+
+    Sequence sequence;
+    sequence.reserve(leftItems.size() + rightItems.size());
+    for (size_t i = 0; i < sequences.size(); ++i)
+    {
+        sequence.insert(sequence.end(), sequences[i].cbegin(), sequences[i].cend());
+
+        if (i < anchors.size())
+        {
+            const Paragraph& leftParagraph = leftParagraphs[anchors[i].first];
+            const Paragraph& rightParagraph = rightParagraphs[anchors[i].second];
+
+            for (size_t j = 0; j < leftParagraph.last - leftParagraph.first; ++j)
+            {
+                SequenceItem item;
+                item.index1 = leftParagraph.first + j;
+                item.index2 = rightParagraph.first + j;
+                sequence.push_back(item);
+            }
+        }
+    }
+
+    return sequence;
+}
+
 void PDFDiffHelper::refineTextRectangles(PDFDiffResult::RectInfos& items)
 {
     PDFDiffResult::RectInfos refinedItems;
@@ -1789,6 +2743,103 @@ void PDFDiffHelper::refineTextRectangles(PDFDiffResult::RectInfos& items)
     items = std::move(refinedItems);
 }
 
+std::vector<QRect> PDFDiffHelper::calculateRasterDifferences(const QImage& left, const QImage& right, int tolerance)
+{
+    std::vector<QRect> result;
+
+    if (left.size() != right.size() || left.format() != right.format() || left.isNull())
+    {
+        result.emplace_back(QPoint(0, 0), left.size().expandedTo(right.size()));
+        return result;
+    }
+
+    const int width = left.width();
+    const int height = left.height();
+    const int bytesPerPixel = left.depth() / 8;
+    const int tileCountX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const int tileCountY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    // Compare tiles, tile is different, if at least one pixel is
+    // different, so comparation of the tile ends at the first
+    // different scanline.
+    std::vector<uint8_t> differentTiles(size_t(tileCountX) * size_t(tileCountY), 0);
+    auto compareTileRow = [&](int tileY)
+    {
+        const int yStart = tileY * RASTER_TILE_SIZE;
+        const int yEnd = qMin(yStart + RASTER_TILE_SIZE, height);
+
+        for (int tileX = 0; tileX < tileCountX; ++tileX)
+        {
+            const int xStart = tileX * RASTER_TILE_SIZE;
+            const int byteOffset = xStart * bytesPerPixel;
+            const int byteCount = (qMin(xStart + RASTER_TILE_SIZE, width) - xStart) * bytesPerPixel;
+
+            for (int y = yStart; y < yEnd; ++y)
+            {
+                if (PDFDiffRasterKernels::isDifferent(left.constScanLine(y) + byteOffset, right.constScanLine(y) + byteOffset, byteCount, uchar(tolerance)))
+                {
+                    differentTiles[size_t(tileY) * tileCountX + tileX] = 1;
+                    break;
+                }
+            }
+        }
+    };
+
+    PDFIntegerRange<int> tileRows(0, tileCountY);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, tileRows.begin(), tileRows.end(), compareTileRow);
+
+    // Cluster neighbouring different tiles (including diagonal neighbours)
+    // into regions using flood fill.
+    std::vector<std::pair<int, int>> stack;
+    for (int tileY = 0; tileY < tileCountY; ++tileY)
+    {
+        for (int tileX = 0; tileX < tileCountX; ++tileX)
+        {
+            if (differentTiles[size_t(tileY) * tileCountX + tileX] != 1)
+            {
+                continue;
+            }
+
+            int minX = tileX;
+            int maxX = tileX;
+            int minY = tileY;
+            int maxY = tileY;
+
+            differentTiles[size_t(tileY) * tileCountX + tileX] = 2;
+            stack.emplace_back(tileX, tileY);
+
+            while (!stack.empty())
+            {
+                auto [x, y] = stack.back();
+                stack.pop_back();
+
+                minX = qMin(minX, x);
+                maxX = qMax(maxX, x);
+                minY = qMin(minY, y);
+                maxY = qMax(maxY, y);
+
+                for (int neighbourY = qMax(y - 1, 0); neighbourY <= qMin(y + 1, tileCountY - 1); ++neighbourY)
+                {
+                    for (int neighbourX = qMax(x - 1, 0); neighbourX <= qMin(x + 1, tileCountX - 1); ++neighbourX)
+                    {
+                        uint8_t& tile = differentTiles[size_t(neighbourY) * tileCountX + neighbourX];
+                        if (tile == 1)
+                        {
+                            tile = 2;
+                            stack.emplace_back(neighbourX, neighbourY);
+                        }
+                    }
+                }
+            }
+
+            QRect rect(minX * RASTER_TILE_SIZE, minY * RASTER_TILE_SIZE, (maxX - minX + 1) * RASTER_TILE_SIZE, (maxY - minY + 1) * RASTER_TILE_SIZE);
+            result.push_back(rect.intersected(QRect(0, 0, width, height)));
+        }
+    }
+
+    return result;
+}
+
 PDFDiffResultNavigator::PDFDiffResultNavigator(QObject* parent) :
     QObject(parent),
     m_diffResult(nullptr),
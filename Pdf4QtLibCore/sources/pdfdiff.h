@@ -24,8 +24,10 @@
 #include "pdfalgorithmlcs.h"
 #include "pdfdocumenttextflow.h"
 
+#include <QMutex>
 #include <QObject>
 #include <QFuture>
+#include <QElapsedTimer>
 #include <QFutureWatcher>
 
 #include <atomic>
@@ -60,6 +62,7 @@ public:
         TextReplaced                    = 0x0800,
         TextAdded                       = 0x1000,
         TextRemoved                     = 0x2000,
+        RasterContentChanged            = 0x4000,
     };
 
     struct PageSequenceItem
@@ -159,20 +162,30 @@ public:
     /// \param string Output string
     void saveToXML(QString* string) const;
 
+    /// Saves single difference as XML element "difference" (used
+    /// to write differences progressively, as they are found).
+    /// \param stream Output stream
+    /// \param index Index
+    void saveDifferenceToXML(QXmlStreamWriter* stream, size_t index) const;
+
+    /// Saves page sequence as XML element "page-sequence"
+    /// \param stream Output stream
+    void savePageSequenceToXML(QXmlStreamWriter* stream) const;
+
 private:
     friend class PDFDiff;
 
     static constexpr uint32_t FLAGS_PAGE_MOVE = uint32_t(Type::PageMoved) | uint32_t(Type::PageAdded) | uint32_t(Type::PageRemoved);
     static constexpr uint32_t FLAGS_TEXT = uint32_t(Type::RemovedTextCharContent) | uint32_t(Type::AddedTextCharContent) | uint32_t(Type::TextReplaced) | uint32_t(Type::TextAdded) | uint32_t(Type::TextRemoved);
     static constexpr uint32_t FLAGS_VECTOR_GRAPHICS = uint32_t(Type::RemovedVectorGraphicContent) | uint32_t(Type::AddedVectorGraphicContent);
-    static constexpr uint32_t FLAGS_IMAGE = uint32_t(Type::RemovedImageContent) | uint32_t(Type::AddedImageContent);
+    static constexpr uint32_t FLAGS_IMAGE = uint32_t(Type::RemovedImageContent) | uint32_t(Type::AddedImageContent) | uint32_t(Type::RasterContentChanged);
     static constexpr uint32_t FLAGS_SHADING = uint32_t(Type::RemovedShadingContent) | uint32_t(Type::AddedShadingContent);
 
     static constexpr uint32_t FLAGS_TYPE_PAGE_MOVE = uint32_t(Type::PageMoved);
     static constexpr uint32_t FLAGS_TYPE_PAGE_MOVE_ADD_REMOVE = uint32_t(Type::PageMoved) | uint32_t(Type::PageAdded) | uint32_t(Type::PageRemoved);
     static constexpr uint32_t FLAGS_TYPE_ADD = uint32_t(Type::PageAdded) | uint32_t(Type::AddedTextCharContent) | uint32_t(Type::AddedVectorGraphicContent) | uint32_t(Type::AddedImageContent) | uint32_t(Type::AddedShadingContent) | uint32_t(Type::TextAdded);
     static constexpr uint32_t FLAGS_TYPE_REMOVE = uint32_t(Type::PageRemoved) | uint32_t(Type::RemovedTextCharContent) | uint32_t(Type::RemovedVectorGraphicContent) | uint32_t(Type::RemovedImageContent) | uint32_t(Type::RemovedShadingContent) | uint32_t(Type::TextRemoved);
-    static constexpr uint32_t FLAGS_TYPE_REPLACE = uint32_t(Type::TextReplaced);
+    static constexpr uint32_t FLAGS_TYPE_REPLACE = uint32_t(Type::TextReplaced) | uint32_t(Type::RasterContentChanged);
 
     void addPageMoved(PDFInteger pageIndex1, PDFInteger pageIndex2);
     void addPageAdded(PDFInteger pageIndex);
@@ -197,8 +210,17 @@ private:
                          const RectInfos& rectInfos1,
                          const RectInfos& rectInfos2);
 
+    void addRasterContentChanged(PDFInteger pageIndex1,
+                                 PDFInteger pageIndex2,
+                                 QRectF rect1,
+                                 QRectF rect2);
+
     void saveToStream(QXmlStreamWriter* stream) const;
 
+    /// Appends differences of other result (page sequence is not appended)
+    /// \param result Result
+    void append(const PDFDiffResult& result);
+
     void finalize();
 
     uint32_t getTypeFlags(size_t index) const;
@@ -304,6 +326,8 @@ public:
         PC_Mesh                 = 0x0010,   ///< Use mesh to compare pages (determine, which pages correspond to each other)
         CompareTextsAsVector    = 0x0020,   ///< Compare texts as vector graphics
         CompareWords            = 0x0040,   ///< Compare words, not just characters
+        CompareRaster           = 0x0080,   ///< Compare graphics of replaced pages as rendered images (suitable for scanned documents)
+        StopAtFirstDifference   = 0x0100,   ///< Stop comparation, when first difference is found (result contains differences found so far)
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -345,12 +369,44 @@ public:
     /// Returns result of a comparation process
     const PDFDiffResult& getResult() const { return m_result; }
 
+    /// Minimal interval (in milliseconds) between two emissions of signal \p partialResultAvailable
+    static constexpr const qint64 PARTIAL_RESULT_INTERVAL = 250;
+
+    /// Returns differences found so far. During comparation, differences are
+    /// added progressively, page range by page range, in the order of pages
+    /// (page moves are added first). Differences are not sorted as in the
+    /// result of the comparation. Function can be called from any thread.
+    PDFDiffResult getPartialResult() const;
+
     PDFDocumentTextFlowFactory::Algorithm getTextAnalysisAlgorithm() const;
     void setTextAnalysisAlgorithm(PDFDocumentTextFlowFactory::Algorithm textAnalysisAlgorithm);
 
+    /// Returns resolution (in DPI), in which pages are rendered,
+    /// when option \p CompareRaster is enabled.
+    PDFReal getRasterResolution() const { return m_rasterResolution; }
+
+    /// Sets resolution (in DPI), in which pages are rendered,
+    /// when option \p CompareRaster is enabled.
+    /// \param rasterResolution Resolution in DPI
+    void setRasterResolution(PDFReal rasterResolution);
+
+    /// Returns tolerance of the raster comparation. Pixels, whose color
+    /// channels differ at most by tolerance, are treated as equal.
+    int getRasterTolerance() const { return m_rasterTolerance; }
+
+    /// Sets tolerance of the raster comparation (in range 0-255).
+    /// \param rasterTolerance Tolerance
+    void setRasterTolerance(int rasterTolerance);
+
 signals:
     void comparationFinished();
 
+    /// Emitted, when new differences were found during comparation. Signal
+    /// is emitted from the thread performing comparation, at most once per
+    /// \p PARTIAL_RESULT_INTERVAL milliseconds. Use \p getPartialResult
+    /// to obtain differences.
+    void partialResultAvailable();
+
 private:
 
     enum Steps
@@ -373,13 +429,55 @@ private:
                              const std::vector<PDFDiffPageContext>& rightPreparedPages,
                              PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
                              std::map<size_t, size_t>& pageMatches);
-    void performCompare(const std::vector<PDFDiffPageContext>& leftPreparedPages,
-                        const std::vector<PDFDiffPageContext>& rightPreparedPages,
+    void performCompare(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                        std::vector<PDFDiffPageContext>& rightPreparedPages,
                         PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
                         const std::map<size_t, size_t>& pageMatches,
                         PDFDiffResult& result);
     void finalizeGraphicsPieces(PDFDiffPageContext& context);
 
+    /// Renders replaced pages of the page sequence (pages, which were matched,
+    /// but differ) in both documents and compares them pixel by pixel. Regions
+    /// with different pixels are stored in page contexts. Page pairs
+    /// are compared in parallel.
+    /// \param leftPreparedPages Page contexts of the left document
+    /// \param rightPreparedPages Page contexts of the right document
+    /// \param pageSequence Page sequence
+    void performRasterCompare(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                              std::vector<PDFDiffPageContext>& rightPreparedPages,
+                              const PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence);
+
+    /// Calculates source hashes of pages and marks pages with identical
+    /// source data, which don't need to be interpreted.
+    /// \param leftPreparedPages Page contexts of the left document
+    /// \param rightPreparedPages Page contexts of the right document
+    void matchIdenticalPages(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                             std::vector<PDFDiffPageContext>& rightPreparedPages);
+
+    /// Extracts graphic pieces of pages, which don't have identical page
+    /// and whose content was not extracted yet.
+    /// \param document Document
+    /// \param preparedPages Page contexts
+    void extractPageContent(const PDFDocument* document, std::vector<PDFDiffPageContext>& preparedPages);
+
+    /// Releases graphic pieces and text of pages of the sequence item
+    /// \param leftPreparedPages Page contexts of the left document
+    /// \param rightPreparedPages Page contexts of the right document
+    /// \param item Sequence item
+    void releasePageContent(std::vector<PDFDiffPageContext>& leftPreparedPages,
+                            std::vector<PDFDiffPageContext>& rightPreparedPages,
+                            const PDFAlgorithmLongestCommonSubsequenceBase::SequenceItem& item);
+
+    /// Appends differences to the partial result and emits
+    /// signal \p partialResultAvailable (signal is throttled).
+    /// \param result Differences
+    void appendPartialResult(const PDFDiffResult& result);
+
+    /// Extracts text of pages, whose content was extracted
+    /// \param document Document
+    /// \param preparedPages Page contexts
+    void extractPageText(const PDFDocument* document, std::vector<PDFDiffPageContext>& preparedPages);
+
     void onComparationPerformed();
 
     /// Calculates real epsilon for a page. Epsilon is used in page
@@ -395,9 +493,14 @@ private:
     PDFClosedIntervalSet m_pagesForRightDocument;
     Options m_options;
     PDFReal m_epsilon;
+    PDFReal m_rasterResolution;
+    int m_rasterTolerance;
     std::atomic_bool m_cancelled;
     PDFDiffResult m_result;
     PDFDocumentTextFlowFactory::Algorithm m_textAnalysisAlgorithm;
+    mutable QMutex m_partialResultMutex;
+    PDFDiffResult m_partialResult;
+    QElapsedTimer m_partialResultTimer;
 
     QFuture<PDFDiffResult> m_future;
     std::optional<QFutureWatcher<PDFDiffResult>> m_futureWatcher;
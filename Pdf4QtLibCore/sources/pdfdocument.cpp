@@ -21,6 +21,12 @@
 #include "pdfexception.h"
 #include "pdfstreamfilters.h"
 #include "pdfconstants.h"
+
+#include <QCryptographicHash>
+
+#include <utility>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -30,7 +36,46 @@ static constexpr const char* PDF_DOCUMENT_INFO_ENTRY = "Info";
 
 QByteArray PDFObjectStorage::getDecodedStream(const PDFStream* stream) const
 {
-    return PDFStreamFilterStorage::getDecodedStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), this, std::placeholders::_1), getSecurityHandler());
+    QByteArray result;
+    if (m_decodedStreamCache && m_decodedStreamCache->find(stream, result))
+    {
+        return result;
+    }
+
+    result = PDFStreamFilterStorage::getDecodedStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), this, std::placeholders::_1), getSecurityHandler());
+
+    if (m_decodedStreamCache)
+    {
+        m_decodedStreamCache->insert(stream, result);
+    }
+
+    return result;
+}
+
+bool PDFObjectStorage::decodeStream(const PDFStream* stream, PDFStreamDecoderSink sink) const
+{
+    return PDFStreamFilterStorage::decodeStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), this, std::placeholders::_1), getSecurityHandler(), qMove(sink));
+}
+
+PDFSourceDataHash::PDFSourceDataHash(QByteArray sourceData, std::shared_ptr<const void> sourceOwner) :
+    m_sourceData(qMove(sourceData)),
+    m_sourceOwner(qMove(sourceOwner))
+{
+
+}
+
+const QByteArray& PDFSourceDataHash::getHash() const
+{
+    std::call_once(m_hashFlag, [this]()
+    {
+        m_hash = QCryptographicHash::hash(m_sourceData, QCryptographicHash::Sha256);
+
+        // Source data are no longer needed
+        m_sourceData.clear();
+        m_sourceOwner.reset();
+    });
+
+    return m_hash;
 }
 
 PDFDocument::~PDFDocument()
@@ -69,6 +114,11 @@ QByteArray PDFDocument::getDecodedStream(const PDFStream* stream) const
     return m_pdfObjectStorage.getDecodedStream(stream);
 }
 
+bool PDFDocument::decodeStream(const PDFStream* stream, PDFStreamDecoderSink sink) const
+{
+    return m_pdfObjectStorage.decodeStream(stream, qMove(sink));
+}
+
 const PDFDictionary* PDFDocument::getTrailerDictionary() const
 {
     const PDFObject& trailerDictionary = m_pdfObjectStorage.getTrailerDictionary();
@@ -125,12 +175,126 @@ void PDFDocument::initInfo()
 bool PDFObjectStorage::operator==(const PDFObjectStorage& other) const
 {
     // We compare just content. Security handler just defines encryption behavior.
-    return m_objects == other.m_objects &&
+    if (m_loader && m_loader == other.m_loader)
+    {
+        return m_trailerDictionary == other.m_trailerDictionary;
+    }
+
+    if (!m_loader && !other.m_loader)
+    {
+        // Compare persistent vectors directly, shared chunks
+        // of objects are not compared item by item.
+        return m_objects == other.m_objects &&
+               m_trailerDictionary == other.m_trailerDictionary;
+    }
+
+    return getObjects() == other.getObjects() &&
            m_trailerDictionary == other.m_trailerDictionary;
 }
 
+const PDFObjectStorage::PDFObjects& PDFObjectStorage::getObjects() const
+{
+    if (m_loader)
+    {
+        return m_loader->getObjects();
+    }
+
+    if (!m_objectArrayCache)
+    {
+        static const PDFObjects dummy;
+        return dummy;
+    }
+
+    QMutexLocker lock(&m_objectArrayCache->mutex);
+    if (!m_objectArrayCache->objects)
+    {
+        m_objectArrayCache->objects = m_objects.toVector();
+    }
+
+    return *m_objectArrayCache->objects;
+}
+
+size_t PDFObjectStorage::getObjectCount() const
+{
+    if (m_loader)
+    {
+        return m_loader->getObjectCount();
+    }
+
+    return m_objects.size();
+}
+
+PDFObjectStorage::ObjectMetadata PDFObjectStorage::getObjectMetadata(PDFInteger objectNumber) const
+{
+    if (m_loader)
+    {
+        return m_loader->getObjectMetadata(objectNumber);
+    }
+
+    ObjectMetadata metadata;
+    if (objectNumber >= 0 && objectNumber < static_cast<PDFInteger>(m_objects.size()))
+    {
+        const Entry& entry = m_objects[objectNumber];
+        metadata.isOccupied = !entry.object.isNull();
+        metadata.generation = entry.generation;
+    }
+
+    return metadata;
+}
+
+void PDFObjectStorage::materialize()
+{
+    if (m_loader)
+    {
+        PDFObjects objects = m_loader->getObjects();
+        m_objects.assign(qMove(objects));
+        m_loader.reset();
+    }
+}
+
+void PDFObjectStorage::createDecodedStreamCache()
+{
+    if (!m_decodedStreamCache)
+    {
+        m_decodedStreamCache = std::make_shared<PDFDecodedStreamCache>();
+    }
+}
+
+void PDFObjectStorage::invalidateDecodedStreamCache()
+{
+    if (!m_decodedStreamCache)
+    {
+        // Storage doesn't cache decoded streams
+        return;
+    }
+    else if (m_decodedStreamCache.use_count() == 1)
+    {
+        // Cache is not shared with other storages
+        m_decodedStreamCache->clear();
+    }
+    else
+    {
+        m_decodedStreamCache = std::make_shared<PDFDecodedStreamCache>(m_decodedStreamCache->getMemoryLimit());
+    }
+}
+
+void PDFObjectStorage::invalidateObjectArrayCache()
+{
+    // Cache can be shared with copies of the storage,
+    // which are not modified, so we can't clear it, we must create a new one.
+    if (!m_objectArrayCache || m_objectArrayCache.use_count() > 1 || m_objectArrayCache->objects.has_value())
+    {
+        m_objectArrayCache = std::make_shared<ObjectArrayCache>();
+    }
+}
+
 const PDFObject& PDFObjectStorage::getObject(PDFObjectReference reference) const
 {
+    if (m_loader)
+    {
+        return m_loader->getObject(reference);
+    }
+
     if (reference.objectNumber >= 0 &&
         reference.objectNumber < static_cast<PDFInteger>(m_objects.size()) &&
         m_objects[reference.objectNumber].generation == reference.generation)
@@ -144,16 +308,99 @@ const PDFObject& PDFObjectStorage::getObject(PDFObjectReference reference) const
     }
 }
 
+void PDFObjectStorage::setObjects(PDFObjects&& objects)
+{
+    materialize();
+
+    const size_t oldCount = m_objects.size();
+    const size_t count = qMax(objects.size(), oldCount);
+
+    // Objects, which were changed, added or removed are modified
+    m_modifiedObjects.resize(qMax(m_modifiedObjects.size(), count), false);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i >= objects.size() || i >= oldCount || objects[i] != m_objects[i])
+        {
+            m_modifiedObjects[i] = true;
+        }
+    }
+
+    m_objects.assign(qMove(objects));
+    invalidateDecodedStreamCache();
+    invalidateObjectArrayCache();
+}
+
 PDFObjectReference PDFObjectStorage::addObject(PDFObject object)
 {
+    materialize();
+    invalidateDecodedStreamCache();
+    invalidateObjectArrayCache();
+
     PDFObjectReference reference(m_objects.size(), 0);
-    m_objects.emplace_back(0, qMove(object));
+    m_objects.push_back(Entry(0, qMove(object)));
+    setObjectModified(reference.objectNumber);
     return reference;
 }
 
+void PDFObjectStorage::addObjects(std::vector<PDFObject> objects)
+{
+    materialize();
+    invalidateDecodedStreamCache();
+    invalidateObjectArrayCache();
+
+    const size_t firstObjectNumber = m_objects.size();
+    for (PDFObject& object : objects)
+    {
+        m_objects.push_back(Entry(0, qMove(object)));
+    }
+
+    m_modifiedObjects.resize(qMax(m_modifiedObjects.size(), m_objects.size()), false);
+    std::fill(std::next(m_modifiedObjects.begin(), firstObjectNumber), std::next(m_modifiedObjects.begin(), m_objects.size()), true);
+}
+
 void PDFObjectStorage::setObject(PDFObjectReference reference, PDFObject object)
 {
-    m_objects[reference.objectNumber] = Entry(reference.generation, qMove(object));
+    materialize();
+    invalidateDecodedStreamCache();
+    invalidateObjectArrayCache();
+    m_objects.getModifiable(reference.objectNumber) = Entry(reference.generation, qMove(object));
+    setObjectModified(reference.objectNumber);
+}
+
+bool PDFObjectStorage::isObjectModified(PDFInteger objectNumber) const
+{
+    return objectNumber >= 0 && objectNumber < static_cast<PDFInteger>(m_modifiedObjects.size()) && m_modifiedObjects[objectNumber];
+}
+
+std::vector<PDFInteger> PDFObjectStorage::getModifiedObjects() const
+{
+    std::vector<PDFInteger> modifiedObjects;
+
+    for (size_t i = 0; i < m_modifiedObjects.size(); ++i)
+    {
+        if (m_modifiedObjects[i])
+        {
+            modifiedObjects.push_back(static_cast<PDFInteger>(i));
+        }
+    }
+
+    return modifiedObjects;
+}
+
+void PDFObjectStorage::clearModifiedFlags()
+{
+    m_modifiedObjects.clear();
+    m_isSecurityHandlerModified = false;
+}
+
+void PDFObjectStorage::setObjectModified(PDFInteger objectNumber)
+{
+    if (objectNumber >= static_cast<PDFInteger>(m_modifiedObjects.size()))
+    {
+        m_modifiedObjects.resize(objectNumber + 1, false);
+    }
+
+    m_modifiedObjects[objectNumber] = true;
 }
 
 void PDFObjectStorage::updateTrailerDictionary(PDFObject trailerDictionary)
@@ -22,20 +22,31 @@
 #include "pdfobject.h"
 #include "pdfcatalog.h"
 #include "pdfsecurityhandler.h"
+#include "pdfdecodedstreamcache.h"
+#include "pdfstreamfilters.h"
+#include "pdfobjectarena.h"
+#include "pdfutils.h"
 
 #include <QColor>
+#include <QMutex>
 #include <QTransform>
 #include <QDateTime>
 
+#include <mutex>
 #include <optional>
 
 namespace pdf
 {
 class PDFDocument;
 class PDFDocumentBuilder;
+class PDFObjectStorageLoader;
+
+using PDFObjectStorageLoaderPointer = std::shared_ptr<const PDFObjectStorageLoader>;
 
 /// Storage for objects. This class is not thread safe for writing (calling non-const functions). Caller must ensure
 /// locking, if this object is used from multiple threads. Calling const functions should be thread safe.
+/// Objects are stored in a persistent vector, so copies of the storage share unmodified objects. Copying
+/// the storage (for example, for undo/redo snapshots) and modification of single object are cheap.
 class PDF4QTLIBCORESHARED_EXPORT PDFObjectStorage
 {
 public:
@@ -65,10 +76,21 @@ public:
     using PDFObjects = std::vector<Entry>;
 
     explicit PDFObjectStorage(PDFObjects&& objects, PDFObject&& trailerDictionary, PDFSecurityHandlerPointer&& securityHandler) :
-        m_objects(std::move(objects)),
         m_trailerDictionary(std::move(trailerDictionary)),
         m_securityHandler(std::move(securityHandler))
     {
+        m_objects.assign(std::move(objects));
+    }
+
+    /// Creates lazy object storage. Objects are not stored in the storage, but they
+    /// are loaded by the loader on demand, when they are accessed for the first time.
+    /// Storage remains lazy until it is modified, then all objects are loaded
+    /// and stored in the storage.
+    explicit PDFObjectStorage(PDFObjectStorageLoaderPointer loader, PDFObject&& trailerDictionary, PDFSecurityHandlerPointer&& securityHandler) :
+        m_trailerDictionary(std::move(trailerDictionary)),
+        m_securityHandler(std::move(securityHandler)),
+        m_loader(std::move(loader))
+    {
 
     }
 
@@ -90,14 +112,38 @@ public:
     /// is returned (no exception is thrown).
     const PDFObject& getObjectByReference(PDFObjectReference reference) const;
 
-    /// Returns array of objects stored in this storage
-    const PDFObjects& getObjects() const { return m_objects; }
+    /// Returns array of objects stored in this storage. If storage is lazy,
+    /// then all objects are loaded. Array is created on demand and it is shared
+    /// between copies of the storage, until storage is modified. Returned
+    /// reference is valid until the storage is modified.
+    const PDFObjects& getObjects() const;
+
+    /// Returns number of objects (including free objects) in this storage.
+    /// If storage is lazy, objects are not loaded.
+    size_t getObjectCount() const;
+
+    /// Metadata of the object, which can be obtained without loading the object
+    struct ObjectMetadata
+    {
+        bool isOccupied = false;    ///< Object exists (it is not free)
+        PDFInteger generation = 0;  ///< Generation number of the object
+        PDFInteger size = -1;       ///< Size of the object in the source data, -1, if it is unknown
+    };
 
-    /// Returns array of objects stored in this storage
-    PDFObjects& getObjects() { return m_objects; }
+    /// Returns metadata of the object. If storage is lazy, then metadata are taken
+    /// from the cross reference table and object is not loaded (size of the object
+    /// is estimated from the offset of the next object, it is unknown for objects
+    /// stored in object streams). If storage is not lazy, size is unknown.
+    /// \param objectNumber Object number
+    ObjectMetadata getObjectMetadata(PDFInteger objectNumber) const;
 
-    /// Sets array of objects
-    void setObjects(PDFObjects&& objects) { m_objects = qMove(objects); }
+    /// Sets array of objects. Objects, which differ from the current
+    /// objects, are marked as modified. Unmodified objects remain
+    /// shared with the copies of the storage.
+    void setObjects(PDFObjects&& objects);
+
+    /// Returns true, if objects are loaded on demand
+    bool isLazy() const { return m_loader != nullptr; }
 
     /// Returns trailer dictionary
     const PDFObject& getTrailerDictionary() const { return m_trailerDictionary; }
@@ -106,7 +152,23 @@ public:
     const PDFSecurityHandler* getSecurityHandler() const { return m_securityHandler.data(); }
 
     /// Sets security handler associated with these objects
-    void setSecurityHandler(PDFSecurityHandlerPointer handler) { m_securityHandler = qMove(handler); }
+    void setSecurityHandler(PDFSecurityHandlerPointer handler) { m_securityHandler = qMove(handler); m_isSecurityHandlerModified = true; invalidateDecodedStreamCache(); }
+
+    /// Returns true, if object was modified (or added) since the storage was
+    /// created (typically, since the document was read), or since modified
+    /// flags were cleared.
+    /// \param objectNumber Object number
+    bool isObjectModified(PDFInteger objectNumber) const;
+
+    /// Returns sorted object numbers of modified (or added) objects
+    std::vector<PDFInteger> getModifiedObjects() const;
+
+    /// Returns true, if security handler was changed
+    bool isSecurityHandlerModified() const { return m_isSecurityHandlerModified; }
+
+    /// Marks all objects (and security handler) as unmodified,
+    /// for example, when document was saved.
+    void clearModifiedFlags();
 
     /// Adds a new object to the object list. This function
     /// is not thread safe, do not call it from multiple threads.
@@ -114,6 +176,13 @@ public:
     /// \returns Reference to new object
     PDFObjectReference addObject(PDFObject object);
 
+    /// Adds new objects to the object list at once. Objects get consecutive
+    /// object numbers, starting with current object count, so references
+    /// to them can be determined before they are added. This function
+    /// is not thread safe, do not call it from multiple threads.
+    /// \param objects Objects to be added
+    void addObjects(std::vector<PDFObject> objects);
+
     /// Sets object to object storage. Reference must exist.
     /// \param reference Reference to object
     /// \param object New value of object
@@ -130,14 +199,92 @@ public:
     /// \param stream Stream to be decoded
     QByteArray getDecodedStream(const PDFStream* stream) const;
 
+    /// Decodes the stream incrementally, decoded data are passed to the sink
+    /// in chunks, so whole decoded stream is never held in memory. Decoded
+    /// data are not cached. Returns false, if stream filters are invalid.
+    /// If error occurs during decoding, exception is thrown.
+    /// \param stream Stream to be decoded
+    /// \param sink Sink receiving decoded data
+    bool decodeStream(const PDFStream* stream, PDFStreamDecoderSink sink) const;
+
+    /// Returns cache of decoded streams. Cache is thread safe and it is
+    /// shared between copies of the storage, until storage is modified.
+    /// Returns nullptr, if storage doesn't cache decoded streams.
+    PDFDecodedStreamCache* getDecodedStreamCache() const { return m_decodedStreamCache.get(); }
+
+    /// Creates cache of decoded streams, if it doesn't exist. Storages are
+    /// created without the cache, document reader creates it for read
+    /// documents, which are then displayed or processed.
+    void createDecodedStreamCache();
+
     /// Set trailer dictionary
     /// \param object Object defining trailer dictionary
     void setTrailerDictionary(const PDFObject& object) { m_trailerDictionary = object; }
 
+    /// Sets arena, from which content of objects was allocated. Storage
+    /// (and its copies) owns the arena, when storage is released (or replaced),
+    /// the memory pool of the arena is released too.
+    /// \param arena Object arena
+    void setObjectArena(PDFObjectArenaPointer arena) { m_objectArena = std::move(arena); }
+
 private:
-    PDFObjects m_objects;
+    /// Loads all objects from the loader (if storage is lazy)
+    /// and stores them in this storage.
+    void materialize();
+
+    /// Invalidates decoded stream cache (storage is being modified)
+    void invalidateDecodedStreamCache();
+
+    /// Invalidates array of objects returned by \p getObjects (storage is being modified)
+    void invalidateObjectArrayCache();
+
+    /// Marks object as modified
+    /// \param objectNumber Object number
+    void setObjectModified(PDFInteger objectNumber);
+
+    struct ObjectArrayCache
+    {
+        QMutex mutex;
+        std::optional<PDFObjects> objects;
+    };
+
+    PDFPersistentVector<Entry> m_objects;
     PDFObject m_trailerDictionary;
     PDFSecurityHandlerPointer m_securityHandler;
+    PDFObjectStorageLoaderPointer m_loader;
+    PDFObjectArenaPointer m_objectArena;
+    std::shared_ptr<PDFDecodedStreamCache> m_decodedStreamCache;
+    std::shared_ptr<ObjectArrayCache> m_objectArrayCache = std::make_shared<ObjectArrayCache>();
+
+    /// Modified flags of objects (indexed by object number), objects
+    /// beyond the end of this array are not modified.
+    std::vector<bool> m_modifiedObjects;
+    bool m_isSecurityHandlerModified = false;
+};
+
+/// Loads objects of the object storage on demand. Object is loaded, when it is
+/// accessed for the first time. Loaded objects are never changed, so loader can be
+/// shared between object storages. All functions must be thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFObjectStorageLoader
+{
+public:
+    virtual ~PDFObjectStorageLoader() = default;
+
+    /// Returns object by reference. If object is not loaded yet,
+    /// it is loaded. If object doesn't exist, or it can't be loaded,
+    /// then null object is returned (no exception is thrown).
+    /// \param reference Reference
+    virtual const PDFObject& getObject(PDFObjectReference reference) const = 0;
+
+    /// Loads all objects and returns them
+    virtual const PDFObjectStorage::PDFObjects& getObjects() const = 0;
+
+    /// Returns number of objects (including free objects), objects are not loaded
+    virtual size_t getObjectCount() const = 0;
+
+    /// Returns metadata of the object, object is not loaded
+    /// \param objectNumber Object number
+    virtual PDFObjectStorage::ObjectMetadata getObjectMetadata(PDFInteger objectNumber) const = 0;
 };
 
 /// Loads data from the object contained in the PDF document, such as integers,
@@ -400,6 +547,29 @@ private:
     const PDFObjectStorage* m_storage;
 };
 
+/// Hash of the source data of the document, which is computed on the first request.
+/// Memory mapped files are not read as a whole, when document is opened, so hash
+/// is not computed at the time of opening, because it would touch every page of the
+/// file. Source data (and their owner) are kept, until the hash is computed.
+class PDF4QTLIBCORESHARED_EXPORT PDFSourceDataHash
+{
+public:
+    /// Creates hash of the source data
+    /// \param sourceData Source data of the document
+    /// \param sourceOwner Owner of the source data (for example, memory mapped file)
+    explicit PDFSourceDataHash(QByteArray sourceData, std::shared_ptr<const void> sourceOwner);
+
+    /// Returns hash of the source data, computes it, if it wasn't computed yet.
+    /// This function is thread safe.
+    const QByteArray& getHash() const;
+
+private:
+    mutable std::once_flag m_hashFlag;
+    mutable QByteArray m_sourceData;
+    mutable std::shared_ptr<const void> m_sourceOwner;
+    mutable QByteArray m_hash;
+};
+
 /// PDF document main class.
 class PDF4QTLIBCORESHARED_EXPORT PDFDocument
 {
@@ -443,6 +613,13 @@ public:
     /// \param stream Stream to be decoded
     QByteArray getDecodedStream(const PDFStream* stream) const;
 
+    /// Decodes the stream incrementally, decoded data are passed to the sink
+    /// in chunks. Returns false, if stream filters are invalid. If error
+    /// occurs during decoding, exception is thrown.
+    /// \param stream Stream to be decoded
+    /// \param sink Sink receiving decoded data
+    bool decodeStream(const PDFStream* stream, PDFStreamDecoderSink sink) const;
+
     /// Returns the trailer dictionary
     const PDFDictionary* getTrailerDictionary() const;
 
@@ -460,15 +637,25 @@ public:
         m_info.version = version;
     }
 
+    explicit PDFDocument(PDFObjectStorage&& storage, PDFVersion version, std::shared_ptr<const PDFSourceDataHash> sourceDataHash) :
+        m_pdfObjectStorage(std::move(storage)),
+        m_lazySourceDataHash(std::move(sourceDataHash))
+    {
+        init();
+
+        m_info.version = version;
+    }
+
     /**
      * @brief Retrieves the hash of the source data.
      *
      * This function returns the hash derived from the source data
-     * from which the document was originally read.
+     * from which the document was originally read. Hash of the
+     * memory mapped file is computed on the first call.
      *
      * @return Hash value of the source data.
      */
-    const QByteArray& getSourceDataHash() const { return m_sourceDataHash; }
+    const QByteArray& getSourceDataHash() const { return m_lazySourceDataHash ? m_lazySourceDataHash->getHash() : m_sourceDataHash; }
 
 private:
     friend class PDFDocumentReader;
@@ -496,6 +683,10 @@ private:
     /// Hash of the source byte array's data,
     /// from which the document was created.
     QByteArray m_sourceDataHash;
+
+    /// Hash of the source data computed on demand (if set, it is used
+    /// instead of \p m_sourceDataHash)
+    std::shared_ptr<const PDFSourceDataHash> m_lazySourceDataHash;
 };
 
 using PDFDocumentPointer = QSharedPointer<PDFDocument>;
@@ -28,6 +28,10 @@
 #include <QPainter>
 #include <QPdfWriter>
 
+#include <map>
+#include <numeric>
+#include <utility>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -690,7 +694,7 @@ void PDFDocumentBuilder::reset()
 
 void PDFDocumentBuilder::createDocument()
 {
-    if (!m_storage.getObjects().empty())
+    if (m_storage.getObjectCount() > 0)
     {
         reset();
     }
@@ -710,7 +714,7 @@ void PDFDocumentBuilder::setDocument(const PDFDocument* document)
 
 PDFDocument PDFDocumentBuilder::build()
 {
-    updateTrailerDictionary(m_storage.getObjects().size());
+    updateTrailerDictionary(PDFInteger(m_storage.getObjectCount()));
     return PDFDocument(PDFObjectStorage(m_storage), m_version, QByteArray());
 }
 
@@ -1798,6 +1802,184 @@ std::vector<PDFObjectReference> PDFDocumentBuilder::getPages() const
     return result;
 }
 
+std::vector<PDFObjectReference> PDFDocumentBuilder::appendPages(std::vector<PDFAppendedPage> pages)
+{
+    std::vector<PDFObjectReference> pageReferences;
+
+    if (pages.empty())
+    {
+        return pageReferences;
+    }
+
+    const PDFObjectReference pageTreeRoot = getPageTreeRoot();
+    const PDFInteger firstObjectNumber = PDFInteger(m_storage.getObjectCount());
+    PDFInteger objectNumber = firstObjectNumber;
+
+    auto allocateReference = [&objectNumber]()
+    {
+        return PDFObjectReference(objectNumber++, 0);
+    };
+
+    // 1) Allocate references of pages and their content streams
+    std::vector<std::vector<PDFObjectReference>> contentReferences(pages.size());
+    pageReferences.reserve(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        pageReferences.push_back(allocateReference());
+
+        for (const PDFObject& content : pages[i].contents)
+        {
+            contentReferences[i].push_back(content.isReference() ? content.getReference() : allocateReference());
+        }
+    }
+
+    // 2) Allocate references of page tree nodes. Nodes are created level by level,
+    //    items of the level are evenly distributed to the nodes, so the tree is balanced.
+    struct PageTreeNode
+    {
+        PDFObjectReference reference;
+        std::vector<PDFObjectReference> kids;
+        PDFInteger count = 0;
+    };
+
+    std::vector<PageTreeNode> nodes;
+    std::map<PDFObjectReference, PDFObjectReference> parents;
+    std::vector<PDFObjectReference> levelReferences = pageReferences;
+    std::vector<PDFInteger> levelCounts(pageReferences.size(), 1);
+
+    while (levelReferences.size() > PAGE_TREE_NODE_SIZE)
+    {
+        const size_t itemCount = levelReferences.size();
+        const size_t nodeCount = (itemCount + PAGE_TREE_NODE_SIZE - 1) / PAGE_TREE_NODE_SIZE;
+
+        std::vector<PDFObjectReference> nextLevelReferences;
+        std::vector<PDFInteger> nextLevelCounts;
+        nextLevelReferences.reserve(nodeCount);
+        nextLevelCounts.reserve(nodeCount);
+
+        for (size_t nodeIndex = 0; nodeIndex < nodeCount; ++nodeIndex)
+        {
+            const size_t first = nodeIndex * itemCount / nodeCount;
+            const size_t last = (nodeIndex + 1) * itemCount / nodeCount;
+
+            PageTreeNode node;
+            node.reference = allocateReference();
+            node.kids.assign(std::next(levelReferences.cbegin(), first), std::next(levelReferences.cbegin(), last));
+            node.count = std::accumulate(std::next(levelCounts.cbegin(), first), std::next(levelCounts.cbegin(), last), PDFInteger(0));
+
+            for (const PDFObjectReference& kid : node.kids)
+            {
+                parents[kid] = node.reference;
+            }
+
+            nextLevelReferences.push_back(node.reference);
+            nextLevelCounts.push_back(node.count);
+            nodes.push_back(qMove(node));
+        }
+
+        levelReferences = qMove(nextLevelReferences);
+        levelCounts = qMove(nextLevelCounts);
+    }
+
+    auto getParent = [&parents, pageTreeRoot](PDFObjectReference reference)
+    {
+        auto it = parents.find(reference);
+        return it != parents.cend() ? it->second : pageTreeRoot;
+    };
+
+    // 3) Create all objects in order of their object numbers
+    std::vector<PDFObject> objects;
+    objects.reserve(objectNumber - firstObjectNumber);
+
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        PDFAppendedPage& page = pages[i];
+        PDFObjectFactory objectBuilder;
+
+        objectBuilder.beginDictionary();
+        objectBuilder.beginDictionaryItem("Type");
+        objectBuilder << WrapName("Page");
+        objectBuilder.endDictionaryItem();
+        objectBuilder.beginDictionaryItem("Parent");
+        objectBuilder << getParent(pageReferences[i]);
+        objectBuilder.endDictionaryItem();
+        objectBuilder.beginDictionaryItem("MediaBox");
+        objectBuilder << page.mediaBox;
+        objectBuilder.endDictionaryItem();
+
+        if (!page.resources.isNull())
+        {
+            objectBuilder.beginDictionaryItem("Resources");
+            objectBuilder << page.resources;
+            objectBuilder.endDictionaryItem();
+        }
+
+        if (!contentReferences[i].empty())
+        {
+            objectBuilder.beginDictionaryItem("Contents");
+            if (contentReferences[i].size() == 1)
+            {
+                objectBuilder << contentReferences[i].front();
+            }
+            else
+            {
+                objectBuilder << contentReferences[i];
+            }
+            objectBuilder.endDictionaryItem();
+        }
+
+        objectBuilder.endDictionary();
+        objects.push_back(PDFObjectManipulator::removeNullObjects(objectBuilder.takeObject()));
+
+        for (PDFObject& content : page.contents)
+        {
+            if (!content.isReference())
+            {
+                objects.push_back(qMove(content));
+            }
+        }
+    }
+
+    for (const PageTreeNode& node : nodes)
+    {
+        PDFObjectFactory objectBuilder;
+
+        objectBuilder.beginDictionary();
+        objectBuilder.beginDictionaryItem("Type");
+        objectBuilder << WrapName("Pages");
+        objectBuilder.endDictionaryItem();
+        objectBuilder.beginDictionaryItem("Parent");
+        objectBuilder << getParent(node.reference);
+        objectBuilder.endDictionaryItem();
+        objectBuilder.beginDictionaryItem("Kids");
+        objectBuilder << node.kids;
+        objectBuilder.endDictionaryItem();
+        objectBuilder.beginDictionaryItem("Count");
+        objectBuilder << node.count;
+        objectBuilder.endDictionaryItem();
+        objectBuilder.endDictionary();
+
+        objects.push_back(objectBuilder.takeObject());
+    }
+
+    Q_ASSERT(objects.size() == size_t(objectNumber - firstObjectNumber));
+    m_storage.addObjects(qMove(objects));
+
+    // 4) Append top-level nodes to the page tree root
+    PDFObjectFactory objectBuilder;
+    objectBuilder.beginDictionary();
+    objectBuilder.beginDictionaryItem("Kids");
+    objectBuilder << levelReferences;
+    objectBuilder.endDictionaryItem();
+    objectBuilder.beginDictionaryItem("Count");
+    objectBuilder << getPageTreeRootChildCount() + PDFInteger(pageReferences.size());
+    objectBuilder.endDictionaryItem();
+    objectBuilder.endDictionary();
+    appendTo(pageTreeRoot, objectBuilder.takeObject());
+
+    return pageReferences;
+}
+
 void PDFDocumentBuilder::setOutline(const PDFOutlineItem* root)
 {
     setOutline(createOutlineItem(root, false));
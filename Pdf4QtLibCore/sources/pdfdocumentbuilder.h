@@ -316,6 +316,15 @@ private:
     Mode m_mode;
 };
 
+/// Page appended to the document in bulk, by function
+/// \p PDFDocumentBuilder::appendPages
+struct PDFAppendedPage
+{
+    QRectF mediaBox;                    ///< Media box of the page (size of paper)
+    PDFObject resources;                ///< Resources of the page (dictionary, or reference to resources shared by the pages)
+    std::vector<PDFObject> contents;    ///< Content streams of the page (streams, or references to the streams)
+};
+
 class PDF4QTLIBCORESHARED_EXPORT PDFDocumentBuilder
 {
 public:
@@ -390,6 +399,17 @@ public:
     /// be flattened to use this function. \sa flattenPageTree
     std::vector<PDFObjectReference> getPages() const;
 
+    /// Appends pages after the last page in one go. All objects of the pages
+    /// (pages, content streams and page tree nodes) get preallocated consecutive
+    /// object numbers and they are added to the object storage at once. Appended
+    /// pages are organized in a balanced page tree, whose top-level nodes are
+    /// appended to the page tree root, so page tree root is updated only once.
+    /// This is much faster than appending pages one by one, when large number
+    /// of pages is created.
+    /// \param pages Pages to be appended
+    /// \returns References to the appended pages
+    std::vector<PDFObjectReference> appendPages(std::vector<PDFAppendedPage> pages);
+
     /// Sets document outline root item corresponds to invisible root.
     /// Top-level items are children of the root.
     /// \param root Root item
@@ -1585,6 +1605,9 @@ private:
     QRectF getPolygonsBoundingRect(const Polygons& Polygons) const;
     PDFObjectReference createOutlineItem(const PDFOutlineItem* root, bool writeOutlineData);
 
+    /// Maximal number of kids of the page tree node created by \p appendPages
+    static constexpr size_t PAGE_TREE_NODE_SIZE = 32;
+
     PDFObjectStorage m_storage;
     PDFVersion m_version;
     const PDFFormManager* m_formManager = nullptr;
@@ -18,6 +18,10 @@
 #include "pdfdocumentmanipulator.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfoptimizer.h"
+#include "pdfdocumentwriter.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfobjectutils.h"
+#include "pdfexception.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -100,6 +104,332 @@ PDFOperationResult PDFDocumentManipulator::assemble(const AssembledPages& pages)
     return true;
 }
 
+/// Source document of the streaming assembly
+struct PDFStreamAssemblySource
+{
+    PDFDocument document;
+    QString errorMessage;
+    std::vector<PDFObjectReference> pages;          ///< Page references (in the source document)
+    std::vector<PDFObjectReference> references;     ///< References of the copied objects (in the source document)
+    std::vector<PDFObjectReference> nullReferences; ///< References of objects, which are not copied (in the source document)
+    PDFObject acroForm;                             ///< Interactive form dictionary (direct object)
+    PDFObject ocProperties;                         ///< Optional content properties dictionary (direct object)
+    PDFInteger firstObjectNumber = 0;
+    std::vector<std::pair<PDFObjectReference, PDFObject>> objects; ///< Renumbered objects
+};
+
+static PDFObject createRectangleObject(const QRectF& rectangle)
+{
+    PDFArray array;
+    array.appendItem(PDFObject::createReal(rectangle.left()));
+    array.appendItem(PDFObject::createReal(rectangle.top()));
+    array.appendItem(PDFObject::createReal(rectangle.right()));
+    array.appendItem(PDFObject::createReal(rectangle.bottom()));
+    return PDFObject::createArray(std::make_shared<PDFArray>(qMove(array)));
+}
+
+PDFOperationResult PDFDocumentManipulator::assembleToDevice(QIODevice* device, const std::vector<DocumentLoader>& documents)
+{
+    if (documents.empty())
+    {
+        return tr("Empty document list.");
+    }
+
+    PDFStreamDocumentWriter writer(device);
+    PDFOperationResult result = writer.begin(PDFVersion(1, 7));
+    if (!result)
+    {
+        return result;
+    }
+
+    // First objects are reserved for the catalog, page tree root
+    // and null object. References to objects, which are not copied (for example,
+    // page tree nodes of the source document), are redirected to the null object.
+    const PDFObjectReference catalogReference(1, 0);
+    const PDFObjectReference pageTreeRootReference(2, 0);
+    const PDFObjectReference nullReference(3, 0);
+    PDFInteger nextObjectNumber = 4;
+
+    std::vector<PDFObjectReference> pageReferences;
+    PDFObject acroForm;
+    PDFObject ocProperties;
+
+    auto loadSource = [&documents](PDFStreamAssemblySource& source, size_t documentIndex)
+    {
+        source.document = documents[documentIndex]();
+
+        const PDFDocument& document = source.document;
+        const PDFCatalog* catalog = document.getCatalog();
+        PDFDocumentDataLoaderDecorator loader(&document);
+
+        std::vector<PDFObject> roots;
+        std::set<PDFObjectReference> pageSet;
+        const size_t pageCount = catalog->getPageCount();
+        for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+        {
+            const PDFPage* page = catalog->getPage(pageIndex);
+            const PDFObjectReference pageReference = page->getPageReference();
+
+            if (!pageReference.isValid() || !pageSet.insert(pageReference).second)
+            {
+                throw PDFException(PDFDocumentManipulator::tr("Page %1 of document %2 is not a unique indirect object.").arg(pageIndex + 1).arg(documentIndex + 1));
+            }
+
+            source.pages.push_back(pageReference);
+            roots.push_back(PDFObject::createReference(pageReference));
+            roots.push_back(page->getResources());
+        }
+
+        if (const PDFDictionary* catalogDictionary = document.getDictionaryFromObject(document.getTrailerDictionary()->get("Root")))
+        {
+            source.acroForm = document.getObject(catalogDictionary->get("AcroForm"));
+            source.ocProperties = document.getObject(catalogDictionary->get("OCProperties"));
+        }
+
+        if (!source.acroForm.isDictionary())
+        {
+            source.acroForm = PDFObject();
+        }
+
+        if (!source.ocProperties.isDictionary())
+        {
+            source.ocProperties = PDFObject();
+        }
+
+        roots.push_back(source.acroForm);
+        roots.push_back(source.ocProperties);
+
+        // Collect objects reachable from the roots. Traversal stops at page tree
+        // nodes and at the catalog, these are replaced by the new ones.
+        std::set<PDFObjectReference> visited;
+        std::vector<PDFObjectReference> stack;
+        for (const PDFObject& root : roots)
+        {
+            std::set<PDFObjectReference> references = PDFObjectUtils::getDirectReferences(root);
+            stack.insert(stack.end(), references.cbegin(), references.cend());
+        }
+
+        while (!stack.empty())
+        {
+            const PDFObjectReference reference = stack.back();
+            stack.pop_back();
+
+            if (!visited.insert(reference).second)
+            {
+                continue;
+            }
+
+            const PDFObject& object = document.getObjectByReference(reference);
+            const PDFDictionary* dictionary = object.isDictionary() ? object.getDictionary() : nullptr;
+            const QByteArray type = dictionary ? loader.readNameFromDictionary(dictionary, "Type") : QByteArray();
+
+            if (object.isNull() || (!pageSet.count(reference) && (type == "Pages" || type == "Catalog")))
+            {
+                source.nullReferences.push_back(reference);
+                continue;
+            }
+
+            source.references.push_back(reference);
+            for (const PDFObjectReference& childReference : PDFObjectUtils::getDirectReferences(object))
+            {
+                if (!visited.count(childReference))
+                {
+                    stack.push_back(childReference);
+                }
+            }
+        }
+
+        std::sort(source.references.begin(), source.references.end());
+    };
+
+    auto renumberSource = [&](PDFStreamAssemblySource& source)
+    {
+        const PDFDocument& document = source.document;
+
+        std::map<PDFObjectReference, PDFObjectReference> mapping;
+        for (size_t i = 0; i < source.references.size(); ++i)
+        {
+            mapping[source.references[i]] = PDFObjectReference(source.firstObjectNumber + PDFInteger(i), 0);
+        }
+        for (const PDFObjectReference& reference : source.nullReferences)
+        {
+            mapping[reference] = nullReference;
+        }
+
+        std::map<PDFObjectReference, const PDFPage*> pages;
+        const PDFCatalog* catalog = document.getCatalog();
+        for (size_t pageIndex = 0; pageIndex < source.pages.size(); ++pageIndex)
+        {
+            pages[source.pages[pageIndex]] = catalog->getPage(pageIndex);
+        }
+
+        source.objects.reserve(source.references.size());
+        for (const PDFObjectReference& reference : source.references)
+        {
+            PDFObject object = document.getObjectByReference(reference);
+
+            auto pageIt = pages.find(reference);
+            if (pageIt != pages.cend() && object.isDictionary())
+            {
+                // Pages are moved to the new page tree, so we must copy
+                // inherited attributes into the page dictionary.
+                const PDFPage* page = pageIt->second;
+                PDFDictionary pageDictionary = *object.getDictionary();
+
+                if (!pageDictionary.hasKey("Resources") && !page->getResources().isNull())
+                {
+                    pageDictionary.setEntry(PDFInplaceOrMemoryString("Resources"), PDFObject(page->getResources()));
+                }
+                if (!pageDictionary.hasKey("MediaBox"))
+                {
+                    pageDictionary.setEntry(PDFInplaceOrMemoryString("MediaBox"), createRectangleObject(page->getMediaBox()));
+                }
+                if (!pageDictionary.hasKey("CropBox") && page->getCropBox() != page->getMediaBox())
+                {
+                    pageDictionary.setEntry(PDFInplaceOrMemoryString("CropBox"), createRectangleObject(page->getCropBox()));
+                }
+                if (!pageDictionary.hasKey("Rotate") && page->getPageRotation() != PageRotation::None)
+                {
+                    PDFInteger rotation = 0;
+                    switch (page->getPageRotation())
+                    {
+                        case PageRotation::None:
+                            break;
+                        case PageRotation::Rotate90:
+                            rotation = 90;
+                            break;
+                        case PageRotation::Rotate180:
+                            rotation = 180;
+                            break;
+                        case PageRotation::Rotate270:
+                            rotation = 270;
+                            break;
+                    }
+
+                    pageDictionary.setEntry(PDFInplaceOrMemoryString("Rotate"), PDFObject::createInteger(rotation));
+                }
+
+                object = PDFObjectUtils::replaceReferences(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(pageDictionary))), mapping);
+
+                // Parent must be set after the references are replaced, because
+                // its reference number can collide with the source references.
+                pageDictionary = *object.getDictionary();
+                pageDictionary.setEntry(PDFInplaceOrMemoryString("Parent"), PDFObject::createReference(pageTreeRootReference));
+                object = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(pageDictionary)));
+            }
+            else
+            {
+                object = PDFObjectUtils::replaceReferences(object, mapping);
+            }
+
+            source.objects.emplace_back(mapping[reference], qMove(object));
+        }
+
+        source.acroForm = PDFObjectUtils::replaceReferences(source.acroForm, mapping);
+        source.ocProperties = PDFObjectUtils::replaceReferences(source.ocProperties, mapping);
+        for (PDFObjectReference& pageReference : source.pages)
+        {
+            pageReference = mapping[pageReference];
+        }
+    };
+
+    // Documents are processed in batches, so the number of documents
+    // held in memory is bounded. Loading and renumbering of documents in the batch
+    // is independent, so it is done in parallel, objects are written sequentially.
+    const size_t batchSize = size_t(qMax(PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Unknown), 1));
+    for (size_t batchStart = 0; batchStart < documents.size(); batchStart += batchSize)
+    {
+        const size_t batchEnd = qMin(batchStart + batchSize, documents.size());
+        std::vector<PDFStreamAssemblySource> sources(batchEnd - batchStart);
+
+        auto processLoad = [&](size_t i)
+        {
+            PDFStreamAssemblySource& source = sources[i - batchStart];
+
+            try
+            {
+                loadSource(source, i);
+            }
+            catch (const PDFException& exception)
+            {
+                source.errorMessage = exception.getMessage();
+            }
+        };
+
+        PDFIntegerRange<size_t> batchRange(batchStart, batchEnd);
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, batchRange.begin(), batchRange.end(), processLoad);
+
+        for (PDFStreamAssemblySource& source : sources)
+        {
+            if (!source.errorMessage.isEmpty())
+            {
+                return source.errorMessage;
+            }
+
+            source.firstObjectNumber = nextObjectNumber;
+            nextObjectNumber += PDFInteger(source.references.size());
+        }
+
+        auto processRenumber = [&](size_t i) { renumberSource(sources[i - batchStart]); };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, batchRange.begin(), batchRange.end(), processRenumber);
+
+        for (PDFStreamAssemblySource& source : sources)
+        {
+            writer.writeObjects(source.objects);
+            pageReferences.insert(pageReferences.end(), source.pages.cbegin(), source.pages.cend());
+
+            if (!source.acroForm.isNull())
+            {
+                acroForm = PDFObjectManipulator::merge(acroForm, source.acroForm, PDFObjectManipulator::ConcatenateArrays);
+            }
+
+            if (!source.ocProperties.isNull())
+            {
+                ocProperties = PDFObjectManipulator::merge(ocProperties, source.ocProperties, PDFObjectManipulator::ConcatenateArrays);
+            }
+        }
+    }
+
+    if (pageReferences.empty())
+    {
+        return tr("Assembled document has no pages.");
+    }
+
+    // Write page tree root, catalog and null object
+    PDFArray kids;
+    for (const PDFObjectReference& pageReference : pageReferences)
+    {
+        kids.appendItem(PDFObject::createReference(pageReference));
+    }
+
+    PDFDictionary pageTreeRoot;
+    pageTreeRoot.addEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("Pages"));
+    pageTreeRoot.addEntry(PDFInplaceOrMemoryString("Kids"), PDFObject::createArray(std::make_shared<PDFArray>(qMove(kids))));
+    pageTreeRoot.addEntry(PDFInplaceOrMemoryString("Count"), PDFObject::createInteger(PDFInteger(pageReferences.size())));
+
+    PDFDictionary catalog;
+    catalog.addEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("Catalog"));
+    catalog.addEntry(PDFInplaceOrMemoryString("Pages"), PDFObject::createReference(pageTreeRootReference));
+    if (!acroForm.isNull())
+    {
+        catalog.addEntry(PDFInplaceOrMemoryString("AcroForm"), qMove(acroForm));
+    }
+    if (!ocProperties.isNull())
+    {
+        catalog.addEntry(PDFInplaceOrMemoryString("OCProperties"), qMove(ocProperties));
+    }
+
+    std::vector<std::pair<PDFObjectReference, PDFObject>> objects;
+    objects.emplace_back(catalogReference, PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(catalog))));
+    objects.emplace_back(pageTreeRootReference, PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(pageTreeRoot))));
+    objects.emplace_back(nullReference, PDFObject());
+    writer.writeObjects(objects);
+
+    PDFDictionary trailerDictionary;
+    trailerDictionary.addEntry(PDFInplaceOrMemoryString("Root"), PDFObject::createReference(catalogReference));
+    return writer.end(qMove(trailerDictionary));
+}
+
 PDFDocumentManipulator::AssembledPages PDFDocumentManipulator::createAllDocumentPages(int documentIndex, const PDFDocument* document)
 {
     AssembledPages assembledPages;
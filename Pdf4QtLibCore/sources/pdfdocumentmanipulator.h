@@ -22,6 +22,9 @@
 #include "pdfutils.h"
 
 #include <QImage>
+#include <QIODevice>
+
+#include <functional>
 
 namespace pdf
 {
@@ -91,6 +94,24 @@ public:
     /// \returns Assembled document
     PDFDocument&& takeAssembledDocument() { return std::move(m_assembledDocument); }
 
+    /// Loader of the source document for streaming assembly. Document is loaded
+    /// only when it is needed, and released after its objects are written.
+    /// If document can't be loaded, loader throws \p PDFException.
+    using DocumentLoader = std::function<PDFDocument(void)>;
+
+    /// Assembles all pages of the documents into a new document, which is written
+    /// directly to the output device. Unlike \p assemble, documents are not copied
+    /// into one in-memory document. Objects reachable from pages of each document
+    /// are renumbered and written, and then the document is released. Multiple
+    /// documents are processed in parallel, but only a limited number of them
+    /// is held in memory at once. Inherited page attributes are copied into the pages,
+    /// interactive forms and optional content properties are merged. Outlines, names
+    /// and document parts are not created, and document is not optimized.
+    /// \param device Output device (must be opened for writing)
+    /// \param documents Loaders of the source documents
+    /// \returns True or error message
+    static PDFOperationResult assembleToDevice(QIODevice* device, const std::vector<DocumentLoader>& documents);
+
     static AssembledPages createAllDocumentPages(int documentIndex, const PDFDocument* document);
 
     static constexpr AssembledPage createDocumentPage(int documentIndex, int pageIndex, QSizeF pageSize, PageRotation pageRotation) { return AssembledPage{ documentIndex, -1, pageIndex, pageSize, pageRotation}; }
@@ -23,6 +23,7 @@
 #include "pdfparser.h"
 #include "pdfstreamfilters.h"
 #include "pdfexecutionpolicy.h"
+#include "pdfsimd.h"
 
 #include <QFile>
 #include <QCryptographicHash>
@@ -30,13 +31,501 @@
 #include "pdfdbgheap.h"
 
 #include <regex>
+#include <array>
 #include <cctype>
+#include <memory>
+#include <cstring>
 #include <algorithm>
 #include <execution>
+#include <functional>
+#include <iterator>
+#include <string_view>
 
 namespace pdf
 {
 
+/// Memory mapped file used as source data for the document. Mapping
+/// is released, when last object referencing it is destroyed.
+class PDFMappedFile
+{
+public:
+    explicit PDFMappedFile(const QString& fileName) :
+        m_file(fileName)
+    {
+
+    }
+
+    ~PDFMappedFile()
+    {
+        if (m_data)
+        {
+            m_file.unmap(m_data);
+        }
+    }
+
+    /// Opens and maps the file. Returns true, if file was mapped.
+    bool map()
+    {
+        if (!m_file.open(QFile::ReadOnly))
+        {
+            return false;
+        }
+
+        const qint64 size = m_file.size();
+        if (size <= 0)
+        {
+            return false;
+        }
+
+        m_data = m_file.map(0, size);
+        if (!m_data)
+        {
+            return false;
+        }
+
+        m_size = size;
+        return true;
+    }
+
+    /// Returns byte array referencing mapped data (no data are copied)
+    QByteArray getData() const { return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), m_size); }
+
+private:
+    QFile m_file;
+    uchar* m_data = nullptr;
+    qsizetype m_size = 0;
+};
+
+/// Parses indirect object at given offset of the source data. Throws
+/// an exception, if object can't be read, or it has different reference.
+static PDFObject parseIndirectObject(const QByteArray& source,
+                                     const std::shared_ptr<const void>& sourceOwner,
+                                     PDFObjectArena* objectArena,
+                                     PDFParsingContext* context,
+                                     PDFInteger offset,
+                                     PDFObjectReference reference)
+{
+    PDFParsingContext::PDFParsingContextGuard guard(context, reference);
+
+    PDFParser parser(source, context, PDFParser::AllowStreams);
+    parser.setDataOwner(sourceOwner);
+    parser.setObjectArena(objectArena);
+    parser.seek(offset);
+
+    PDFObject objectNumber = parser.getObject();
+    PDFObject generation = parser.getObject();
+
+    if (!objectNumber.isInt() || !generation.isInt())
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    if (!parser.fetchCommand(PDF_OBJECT_START_MARK))
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    PDFObject object = parser.getObject();
+
+    if (!parser.fetchCommand(PDF_OBJECT_END_MARK))
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    PDFObjectReference scannedReference(objectNumber.getInteger(), generation.getInteger());
+    if (scannedReference != reference)
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    return object;
+}
+
+/// Parses objects stored in the object stream. Object stream object must be
+/// already decrypted. For each parsed object, callback is called with object
+/// number and the parsed object. Throws an exception, if object stream is invalid.
+static void parseObjectStream(PDFParsingContext* context,
+                              PDFObjectReference objectStreamReference,
+                              const PDFObject& object,
+                              const PDFSecurityHandler* securityHandler,
+                              PDFObjectArena* objectArena,
+                              const std::function<void(PDFInteger, PDFObject&&)>& callback)
+{
+    if (!object.isStream())
+    {
+        throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
+    }
+
+    const PDFStream* objectStream = object.getStream();
+    const PDFDictionary* objectStreamDictionary = objectStream->getDictionary();
+
+    const PDFObject& objectStreamType = objectStreamDictionary->get("Type");
+    if (!objectStreamType.isName() || objectStreamType.getString() != "ObjStm")
+    {
+        throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
+    }
+
+    const PDFObject& nObject = objectStreamDictionary->get("N");
+    const PDFObject& firstObject = objectStreamDictionary->get("First");
+    if (!nObject.isInt() || !firstObject.isInt())
+    {
+        throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
+    }
+
+    // Number of objects in object stream dictionary
+    const PDFInteger n = nObject.getInteger();
+    const PDFInteger first = firstObject.getInteger();
+
+    QByteArray objectStreamData = PDFStreamFilterStorage::getDecodedStream(objectStream, securityHandler);
+
+    PDFParsingContext::PDFParsingContextGuard guard(context, objectStreamReference);
+    PDFParser parser(objectStreamData, context, PDFParser::AllowStreams);
+    parser.setObjectArena(objectArena);
+
+    std::vector<std::pair<PDFInteger, PDFInteger>> objectNumberAndOffset;
+    objectNumberAndOffset.reserve(n);
+    for (PDFInteger i = 0; i < n; ++i)
+    {
+        PDFObject currentObjectNumber = parser.getObject();
+        PDFObject currentOffset = parser.getObject();
+
+        if (!currentObjectNumber.isInt() || !currentOffset.isInt())
+        {
+            throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
+        }
+
+        const PDFInteger objectNumber = currentObjectNumber.getInteger();
+        const PDFInteger offset = currentOffset.getInteger() + first;
+        objectNumberAndOffset.emplace_back(objectNumber, offset);
+    }
+
+    for (size_t i = 0; i < objectNumberAndOffset.size(); ++i)
+    {
+        const PDFInteger objectNumber = objectNumberAndOffset[i].first;
+        const PDFInteger offset = objectNumberAndOffset[i].second;
+        parser.seek(offset);
+
+        PDFObject currentObject = parser.getObject();
+        callback(objectNumber, qMove(currentObject));
+    }
+}
+
+/// Loads objects of the document on demand, directly from the source data.
+/// Each object is parsed (and decrypted), when it is accessed for the first time.
+/// Objects can be loaded from multiple threads at once. Parsing is performed
+/// without locking, only publishing of the parsed object is guarded by the mutex,
+/// so nested loading (for example, of stream length) can't cause a deadlock.
+class PDFLazyObjectLoader : public PDFObjectStorageLoader
+{
+public:
+    explicit PDFLazyObjectLoader(QByteArray source, std::shared_ptr<const void> sourceOwner, PDFObjectArenaPointer objectArena, PDFXRefTable xrefTable) :
+        m_source(qMove(source)),
+        m_sourceOwner(qMove(sourceOwner)),
+        m_objectArena(qMove(objectArena)),
+        m_xrefTable(qMove(xrefTable)),
+        m_slots(std::make_unique<Slot[]>(m_xrefTable.getSize()))
+    {
+        for (const PDFXRefTable::Entry& entry : m_xrefTable.getOccupiedEntries())
+        {
+            m_objectOffsets.push_back(entry.offset);
+        }
+
+        std::sort(m_objectOffsets.begin(), m_objectOffsets.end());
+        m_objectOffsets.erase(std::unique(m_objectOffsets.begin(), m_objectOffsets.end()), m_objectOffsets.end());
+    }
+
+    /// Sets security handler, which is used to decrypt loaded objects. Must be called
+    /// before any object is loaded (except raw objects).
+    /// \param securityHandler Security handler
+    /// \param encryptObjectReference Reference to encryption dictionary (it is not decrypted)
+    void setSecurityHandler(PDFSecurityHandlerPointer securityHandler, PDFObjectReference encryptObjectReference)
+    {
+        m_securityHandler = qMove(securityHandler);
+        m_encryptObjectReference = encryptObjectReference;
+    }
+
+    /// Sets byte source cache. If it is set, then data of each object are read
+    /// from the byte source before the object is parsed. Data of the object are
+    /// expected between the object offset and offset of the next object.
+    /// Must be called before any object is loaded.
+    /// \param byteSourceCache Byte source cache
+    void setByteSourceCache(std::shared_ptr<PDFByteSourceCache> byteSourceCache)
+    {
+        m_byteSourceCache = qMove(byteSourceCache);
+    }
+
+    /// Returns object as it is stored in the source data, i.e. without decryption.
+    /// If object can't be read, null object is returned.
+    /// \param reference Reference
+    PDFObject getRawObject(PDFObjectReference reference) const
+    {
+        try
+        {
+            PDFParsingContext context(std::bind(&PDFLazyObjectLoader::fetchObject, this, std::placeholders::_1, std::placeholders::_2));
+            return fetchObject(&context, reference);
+        }
+        catch (const PDFException&)
+        {
+            return PDFObject();
+        }
+    }
+
+    virtual const PDFObject& getObject(PDFObjectReference reference) const override;
+    virtual const PDFObjectStorage::PDFObjects& getObjects() const override;
+    virtual size_t getObjectCount() const override { return m_xrefTable.getSize(); }
+    virtual PDFObjectStorage::ObjectMetadata getObjectMetadata(PDFInteger objectNumber) const override;
+
+private:
+    static constexpr size_t MUTEX_COUNT = 64;
+
+    struct Slot
+    {
+        std::atomic_bool loaded = false;
+        PDFObject object;
+    };
+
+    /// Fetches object for parsing context (for example, length of the stream)
+    PDFObject fetchObject(PDFParsingContext* context, PDFObjectReference reference) const;
+
+    /// Loads the object described by the entry
+    void loadObject(const PDFXRefTable::Entry& entry) const;
+
+    /// Loads all objects from the object stream
+    void loadObjectStream(PDFObjectReference objectStreamReference) const;
+
+    /// Publishes loaded object, if it was not published yet
+    void publish(PDFInteger objectNumber, PDFObject object) const;
+
+    /// Ensures, that data of the object at given offset are read from
+    /// the byte source (if byte source is used). Throws an exception,
+    /// if data can't be read.
+    /// \param offset Offset of the object
+    void ensureObjectData(PDFInteger offset) const;
+
+    QByteArray m_source;
+    std::shared_ptr<const void> m_sourceOwner;
+    PDFObjectArenaPointer m_objectArena;
+    PDFXRefTable m_xrefTable;
+    PDFSecurityHandlerPointer m_securityHandler;
+    PDFObjectReference m_encryptObjectReference;
+    std::unique_ptr<Slot[]> m_slots;
+    std::shared_ptr<PDFByteSourceCache> m_byteSourceCache;
+    std::vector<PDFInteger> m_objectOffsets; ///< Sorted offsets of objects (used to determine extent of the object data)
+
+    mutable std::array<QMutex, MUTEX_COUNT> m_mutexes;
+    mutable std::array<QMutex, MUTEX_COUNT> m_objectStreamMutexes;
+
+    mutable QMutex m_objectsMutex;
+    mutable std::atomic_bool m_objectsLoaded = false;
+    mutable PDFObjectStorage::PDFObjects m_objects;
+};
+
+const PDFObject& PDFLazyObjectLoader::getObject(PDFObjectReference reference) const
+{
+    const PDFXRefTable::Entry& entry = m_xrefTable.getEntry(reference);
+    if (entry.type == PDFXRefTable::EntryType::Free)
+    {
+        static const PDFObject dummy;
+        return dummy;
+    }
+
+    Slot& slot = m_slots[reference.objectNumber];
+    if (!slot.loaded.load(std::memory_order_acquire))
+    {
+        loadObject(entry);
+    }
+
+    Q_ASSERT(slot.loaded.load(std::memory_order_acquire));
+    return slot.object;
+}
+
+const PDFObjectStorage::PDFObjects& PDFLazyObjectLoader::getObjects() const
+{
+    if (!m_objectsLoaded.load(std::memory_order_acquire))
+    {
+        QMutexLocker lock(&m_objectsMutex);
+        if (!m_objectsLoaded.load(std::memory_order_relaxed))
+        {
+            PDFObjectStorage::PDFObjects objects;
+            objects.resize(m_xrefTable.getSize());
+
+            std::vector<PDFXRefTable::Entry> entries = m_xrefTable.getOccupiedEntries();
+            std::vector<PDFXRefTable::Entry> objectStreamEntries = m_xrefTable.getObjectStreamEntries();
+            entries.insert(entries.end(), objectStreamEntries.cbegin(), objectStreamEntries.cend());
+
+            auto processEntry = [this, &objects](const PDFXRefTable::Entry& entry)
+            {
+                objects[entry.reference.objectNumber] = PDFObjectStorage::Entry(entry.reference.generation, getObject(entry.reference));
+            };
+            PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, entries.cbegin(), entries.cend(), processEntry);
+
+            m_objects = qMove(objects);
+            m_objectsLoaded.store(true, std::memory_order_release);
+        }
+    }
+
+    return m_objects;
+}
+
+PDFObjectStorage::ObjectMetadata PDFLazyObjectLoader::getObjectMetadata(PDFInteger objectNumber) const
+{
+    PDFObjectStorage::ObjectMetadata metadata;
+
+    if (objectNumber < 0 || objectNumber >= static_cast<PDFInteger>(m_xrefTable.getSize()))
+    {
+        return metadata;
+    }
+
+    const PDFXRefTable::Entry& entry = m_xrefTable.getEntryByObjectNumber(objectNumber);
+    switch (entry.type)
+    {
+        case PDFXRefTable::EntryType::Occupied:
+        {
+            metadata.isOccupied = true;
+            metadata.generation = entry.reference.generation;
+
+            // Object data span to the start of the next object (or to the end of the file)
+            auto it = std::upper_bound(m_objectOffsets.cbegin(), m_objectOffsets.cend(), entry.offset);
+            const PDFInteger sourceSize = m_byteSourceCache ? m_byteSourceCache->getSize() : m_source.size();
+            const PDFInteger endOffset = (it != m_objectOffsets.cend()) ? *it : sourceSize;
+            metadata.size = qMax(endOffset - entry.offset, PDFInteger(0));
+            break;
+        }
+
+        case PDFXRefTable::EntryType::InObjectStream:
+            metadata.isOccupied = true;
+            metadata.generation = entry.reference.generation;
+            break;
+
+        default:
+            break;
+    }
+
+    return metadata;
+}
+
+PDFObject PDFLazyObjectLoader::fetchObject(PDFParsingContext* context, PDFObjectReference reference) const
+{
+    const PDFXRefTable::Entry& entry = m_xrefTable.getEntry(reference);
+    if (entry.type == PDFXRefTable::EntryType::Occupied)
+    {
+        const Slot& slot = m_slots[reference.objectNumber];
+        if (slot.loaded.load(std::memory_order_acquire))
+        {
+            return slot.object;
+        }
+
+        ensureObjectData(entry.offset);
+        return parseIndirectObject(m_source, m_sourceOwner, m_objectArena.get(), context, entry.offset, reference);
+    }
+
+    return PDFObject();
+}
+
+void PDFLazyObjectLoader::loadObject(const PDFXRefTable::Entry& entry) const
+{
+    switch (entry.type)
+    {
+        case PDFXRefTable::EntryType::Occupied:
+        {
+            PDFObject object;
+
+            try
+            {
+                PDFParsingContext context(std::bind(&PDFLazyObjectLoader::fetchObject, this, std::placeholders::_1, std::placeholders::_2));
+                ensureObjectData(entry.offset);
+                object = parseIndirectObject(m_source, m_sourceOwner, m_objectArena.get(), &context, entry.offset, entry.reference);
+
+                const bool isEncryptDictionary = m_encryptObjectReference.objectNumber != 0 && m_encryptObjectReference == entry.reference;
+                if (m_securityHandler && m_securityHandler->getMode() != EncryptionMode::None && !isEncryptDictionary)
+                {
+                    object = m_securityHandler->decryptObject(object, entry.reference);
+                }
+            }
+            catch (const PDFException&)
+            {
+                // Object can't be read, it will be null
+                object = PDFObject();
+            }
+
+            publish(entry.reference.objectNumber, qMove(object));
+            break;
+        }
+
+        case PDFXRefTable::EntryType::InObjectStream:
+        {
+            loadObjectStream(entry.objectStream);
+
+            // Object was not found in the object stream, it will be null
+            publish(entry.reference.objectNumber, PDFObject());
+            break;
+        }
+
+        default:
+        {
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+void PDFLazyObjectLoader::loadObjectStream(PDFObjectReference objectStreamReference) const
+{
+    // Object stream can't be stored in another object stream
+    if (m_xrefTable.getEntry(objectStreamReference).type != PDFXRefTable::EntryType::Occupied)
+    {
+        return;
+    }
+
+    const PDFObject& object = getObject(objectStreamReference);
+
+    // We must avoid parsing same object stream by multiple threads
+    QMutexLocker lock(&m_objectStreamMutexes[objectStreamReference.objectNumber % MUTEX_COUNT]);
+
+    auto processObject = [this, objectStreamReference](PDFInteger objectNumber, PDFObject&& currentObject)
+    {
+        const PDFXRefTable::Entry& entry = m_xrefTable.getEntry(PDFObjectReference(objectNumber, 0));
+        if (entry.type == PDFXRefTable::EntryType::InObjectStream && entry.objectStream == objectStreamReference)
+        {
+            publish(objectNumber, qMove(currentObject));
+        }
+    };
+
+    try
+    {
+        PDFParsingContext context(std::bind(&PDFLazyObjectLoader::fetchObject, this, std::placeholders::_1, std::placeholders::_2));
+        parseObjectStream(&context, objectStreamReference, object, m_securityHandler.data(), m_objectArena.get(), processObject);
+    }
+    catch (const PDFException&)
+    {
+        // Object stream is invalid, remaining objects will be null
+    }
+}
+
+void PDFLazyObjectLoader::ensureObjectData(PDFInteger offset) const
+{
+    if (!m_byteSourceCache)
+    {
+        return;
+    }
+
+    auto it = std::upper_bound(m_objectOffsets.cbegin(), m_objectOffsets.cend(), offset);
+    const PDFInteger endOffset = (it != m_objectOffsets.cend()) ? *it : m_byteSourceCache->getSize();
+    m_byteSourceCache->ensureRange(offset, endOffset - offset);
+}
+
+void PDFLazyObjectLoader::publish(PDFInteger objectNumber, PDFObject object) const
+{
+    QMutexLocker lock(&m_mutexes[objectNumber % MUTEX_COUNT]);
+
+    Slot& slot = m_slots[objectNumber];
+    if (!slot.loaded.load(std::memory_order_relaxed))
+    {
+        slot.object = qMove(object);
+        slot.loaded.store(true, std::memory_order_release);
+    }
+}
+
 PDFDocumentReader::PDFDocumentReader(PDFProgress* progress, const std::function<QString(bool*)>& getPasswordCallback, bool permissive, bool authorizeOwnerOnly) :
     m_result(Result::OK),
     m_getPasswordCallback(getPasswordCallback),
@@ -55,6 +544,18 @@ PDFDocument PDFDocumentReader::readFromFile(const QString& fileName)
 
     if (file.exists())
     {
+        if (m_readingMode == ReadingMode::MemoryMapped)
+        {
+            std::shared_ptr<PDFMappedFile> mappedFile = std::make_shared<PDFMappedFile>(fileName);
+            if (mappedFile->map())
+            {
+                QByteArray data = mappedFile->getData();
+                return readFromSource(data, std::move(mappedFile));
+            }
+
+            // File can't be mapped, fallback to buffered reading
+        }
+
         if (file.open(QFile::ReadOnly))
         {
             PDFDocument document = readFromDevice(&file);
@@ -167,7 +668,7 @@ void PDFDocumentReader::checkHeader(const QByteArray& buffer)
 
 PDFInteger PDFDocumentReader::findXrefTableOffset(const QByteArray& buffer)
 {
-    const int startXRefPosition = findFromEnd(PDF_START_OF_XREF_MARK, buffer, PDF_FOOTER_SCAN_LIMIT);
+    const PDFInteger startXRefPosition = findFromEnd(PDF_START_OF_XREF_MARK, buffer, PDF_FOOTER_SCAN_LIMIT);
     if (startXRefPosition == FIND_NOT_FOUND_RESULT)
     {
         throw PDFException(tr("Start of object reference table not found."));
@@ -187,38 +688,7 @@ PDFInteger PDFDocumentReader::findXrefTableOffset(const QByteArray& buffer)
 
 PDFObject PDFDocumentReader::getObject(PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference) const
 {
-    PDFParsingContext::PDFParsingContextGuard guard(context, reference);
-
-    PDFParser parser(m_source, context, PDFParser::AllowStreams);
-    parser.seek(offset);
-
-    PDFObject objectNumber = parser.getObject();
-    PDFObject generation = parser.getObject();
-
-    if (!objectNumber.isInt() || !generation.isInt())
-    {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
-    }
-
-    if (!parser.fetchCommand(PDF_OBJECT_START_MARK))
-    {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
-    }
-
-    PDFObject object = parser.getObject();
-
-    if (!parser.fetchCommand(PDF_OBJECT_END_MARK))
-    {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
-    }
-
-    PDFObjectReference scannedReference(objectNumber.getInteger(), generation.getInteger());
-    if (scannedReference != reference)
-    {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
-    }
-
-    return object;
+    return parseIndirectObject(m_source, m_sourceOwner, m_objectArena.get(), context, offset, reference);
 }
 
 PDFObject PDFDocumentReader::getObjectFromXrefTable(PDFXRefTable* xrefTable, PDFParsingContext* context, PDFObjectReference reference) const
@@ -245,23 +715,13 @@ PDFObject PDFDocumentReader::getObjectFromXrefTable(PDFXRefTable* xrefTable, PDF
     return PDFObject();
 }
 
-PDFObject PDFDocumentReader::readDamagedTrailerDictionary() const
+PDFObject PDFDocumentReader::readDamagedTrailerDictionary(const std::vector<int>& trailerOffsets) const
 {
     PDFObject object = PDFObject::createDictionary(std::make_shared<PDFDictionary>(PDFDictionary()));
     PDFParsingContext context([](PDFParsingContext*, PDFObjectReference){ return PDFObject(); });
 
-    int offset = 0;
-    while (offset < m_source.size())
+    for (const int offset : trailerOffsets)
     {
-        offset = m_source.indexOf(PDF_XREF_TRAILER, offset);
-
-        if (offset == -1)
-        {
-            break;
-        }
-
-        offset += static_cast<int>(std::strlen(PDF_XREF_TRAILER));
-
         // Try to read trailer dictioanry
         try
         {
@@ -437,8 +897,19 @@ void PDFDocumentReader::processObjectStreams(PDFXRefTable* xrefTable, PDFObjectS
         objectStreams.insert(entry.objectStream);
     }
 
+    // Owning object stream of each object, so objects can be validated
+    // in constant time when object stream is being parsed.
+    std::vector<PDFObjectReference> objectStreamOwners(objects.size());
+    for (const PDFXRefTable::Entry& entry : objectStreamEntries)
+    {
+        if (entry.reference.objectNumber >= 0 && entry.reference.objectNumber < static_cast<PDFInteger>(objectStreamOwners.size()))
+        {
+            objectStreamOwners[entry.reference.objectNumber] = entry.objectStream;
+        }
+    }
+
     auto objectFetcher = [this, xrefTable](PDFParsingContext* context, PDFObjectReference reference) { return getObjectFromXrefTable(xrefTable, context, reference); };
-    auto processObjectStream = [this, &objectFetcher, &objects, &objectStreamEntries] (const PDFObjectReference& objectStreamReference)
+    auto processObjectStream = [this, &objectFetcher, &objects, &objectStreamOwners] (const PDFObjectReference& objectStreamReference)
     {
         if (m_result != Result::OK)
         {
@@ -453,72 +924,22 @@ void PDFDocumentReader::processObjectStreams(PDFXRefTable* xrefTable, PDFObjectS
                 throw PDFException(PDFTranslationContext::tr("Object stream %1 not found.").arg(objectStreamReference.objectNumber));
             }
 
-            const PDFObject& object = objects[objectStreamReference.objectNumber].object;
-            if (!object.isStream())
+            auto processObject = [&objects, &objectStreamOwners, objectStreamReference](PDFInteger objectNumber, PDFObject&& currentObject)
             {
-                throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
-            }
-
-            const PDFStream* objectStream = object.getStream();
-            const PDFDictionary* objectStreamDictionary = objectStream->getDictionary();
-
-            const PDFObject& objectStreamType = objectStreamDictionary->get("Type");
-            if (!objectStreamType.isName() || objectStreamType.getString() != "ObjStm")
-            {
-                throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
-            }
-
-            const PDFObject& nObject = objectStreamDictionary->get("N");
-            const PDFObject& firstObject = objectStreamDictionary->get("First");
-            if (!nObject.isInt() || !firstObject.isInt())
-            {
-                throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
-            }
-
-            // Number of objects in object stream dictionary
-            const PDFInteger n = nObject.getInteger();
-            const PDFInteger first = firstObject.getInteger();
-
-            QByteArray objectStreamData = PDFStreamFilterStorage::getDecodedStream(objectStream, m_securityHandler.data());
-
-            PDFParsingContext::PDFParsingContextGuard guard(&context, objectStreamReference);
-            PDFParser parser(objectStreamData, &context, PDFParser::AllowStreams);
-
-            std::vector<std::pair<PDFInteger, PDFInteger>> objectNumberAndOffset;
-            objectNumberAndOffset.reserve(n);
-            for (PDFInteger i = 0; i < n; ++i)
-            {
-                PDFObject currentObjectNumber = parser.getObject();
-                PDFObject currentOffset = parser.getObject();
-
-                if (!currentObjectNumber.isInt() || !currentOffset.isInt())
-                {
-                    throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(objectStreamReference.objectNumber));
-                }
-
-                const PDFInteger objectNumber = currentObjectNumber.getInteger();
-                const PDFInteger offset = currentOffset.getInteger() + first;
-                objectNumberAndOffset.emplace_back(objectNumber, offset);
-            }
-
-            for (size_t i = 0; i < objectNumberAndOffset.size(); ++i)
-            {
-                const PDFInteger objectNumber = objectNumberAndOffset[i].first;
-                const PDFInteger offset = objectNumberAndOffset[i].second;
-                parser.seek(offset);
-
-                PDFObject currentObject = parser.getObject();
-                auto predicate = [objectNumber, objectStreamReference](const PDFXRefTable::Entry& entry) -> bool { return entry.reference.objectNumber == objectNumber && entry.objectStream == objectStreamReference; };
-                if (std::find_if(objectStreamEntries.cbegin(), objectStreamEntries.cend(), predicate) != objectStreamEntries.cend())
+                if (objectNumber >= 0 && objectNumber < static_cast<PDFInteger>(objectStreamOwners.size()) && objectStreamOwners[objectNumber] == objectStreamReference)
                 {
-                    QMutexLocker lock(&m_mutex);
+                    // Each object has exactly one owning object stream, so no other
+                    // thread writes to this entry and no locking is needed.
                     objects[objectNumber].object = qMove(currentObject);
                 }
                 else
                 {
                     // Silently ignore this error. It is not critical, so, maybe this object will be null.
                 }
-            }
+            };
+
+            const PDFObject& object = objects[objectStreamReference.objectNumber].object;
+            parseObjectStream(&context, objectStreamReference, object, m_securityHandler.data(), m_objectArena.get(), processObject);
         }
         catch (const PDFException& exception)
         {
@@ -533,12 +954,19 @@ void PDFDocumentReader::processObjectStreams(PDFXRefTable* xrefTable, PDFObjectS
 }
 
 PDFDocument PDFDocumentReader::readFromBuffer(const QByteArray& buffer)
+{
+    return readFromSource(buffer, nullptr);
+}
+
+PDFDocument PDFDocumentReader::readFromSource(const QByteArray& buffer, std::shared_ptr<const void> sourceOwner)
 {
     bool shouldTryPermissiveReading = true;
 
     try
     {
         m_source = buffer;
+        m_sourceOwner = std::move(sourceOwner);
+        m_objectArena = PDFObjectArena::createArena();
 
         // FOOTER CHECKING
         //  1) Check, if EOF marking is present
@@ -560,6 +988,11 @@ PDFDocument PDFDocumentReader::readFromBuffer(const QByteArray& buffer)
             throw PDFException(tr("Empty xref table."));
         }
 
+        if (m_objectLoadingMode == ObjectLoadingMode::OnDemand)
+        {
+            return createOnDemandDocument(xrefTable, buffer);
+        }
+
         PDFObjectStorage::PDFObjects objects;
         objects.resize(xrefTable.getSize());
 
@@ -584,7 +1017,9 @@ PDFDocument PDFDocumentReader::readFromBuffer(const QByteArray& buffer)
         processObjectStreams(&xrefTable, objects);
 
         PDFObjectStorage storage(std::move(objects), PDFObject(xrefTable.getTrailerDictionary()), qMove(m_securityHandler));
-        return PDFDocument(std::move(storage), m_version, hash(buffer));
+        storage.setObjectArena(m_objectArena);
+        storage.createDecodedStreamCache();
+        return PDFDocument(std::move(storage), m_version, createSourceDataHash(buffer));
     }
     catch (const PDFException &parserException)
     {
@@ -601,80 +1036,565 @@ PDFDocument PDFDocumentReader::readFromBuffer(const QByteArray& buffer)
     return PDFDocument();
 }
 
+PDFDocument PDFDocumentReader::createOnDemandDocument(const PDFXRefTable& xrefTable, const QByteArray& buffer, std::shared_ptr<PDFByteSourceCache> byteSourceCache)
+{
+    std::shared_ptr<PDFLazyObjectLoader> loader = std::make_shared<PDFLazyObjectLoader>(m_source, m_sourceOwner, m_objectArena, xrefTable);
+
+    // Hash of the whole data can't be computed, if data are read from byte source
+    std::shared_ptr<const PDFSourceDataHash> documentHash = byteSourceCache ? nullptr : createSourceDataHash(buffer);
+    if (byteSourceCache)
+    {
+        loader->setByteSourceCache(qMove(byteSourceCache));
+    }
+
+    const PDFObject& trailerDictionaryObject = xrefTable.getTrailerDictionary();
+    const PDFDictionary* trailerDictionary = nullptr;
+    if (trailerDictionaryObject.isDictionary())
+    {
+        trailerDictionary = trailerDictionaryObject.getDictionary();
+    }
+    else if (trailerDictionaryObject.isStream())
+    {
+        trailerDictionary = trailerDictionaryObject.getStream()->getDictionary();
+    }
+
+    // Security handler needs only encryption dictionary, which is never encrypted
+    PDFObjectStorage::PDFObjects objects;
+    objects.resize(xrefTable.getSize());
+
+    PDFObjectReference encryptObjectReference;
+    if (trailerDictionary)
+    {
+        const PDFObject& encryptObject = trailerDictionary->get("Encrypt");
+        if (encryptObject.isReference())
+        {
+            encryptObjectReference = encryptObject.getReference();
+            if (static_cast<size_t>(encryptObjectReference.objectNumber) < objects.size())
+            {
+                objects[encryptObjectReference.objectNumber] = PDFObjectStorage::Entry(encryptObjectReference.generation, loader->getRawObject(encryptObjectReference));
+            }
+        }
+    }
+
+    if (processSecurityHandler(trailerDictionaryObject, { }, objects) == Result::Cancelled)
+    {
+        return PDFDocument();
+    }
+
+    loader->setSecurityHandler(m_securityHandler, encryptObjectReference);
+
+    PDFObjectStorage storage(qMove(loader), PDFObject(trailerDictionaryObject), qMove(m_securityHandler));
+    storage.setObjectArena(m_objectArena);
+    storage.createDecodedStreamCache();
+    return PDFDocument(std::move(storage), m_version, documentHash);
+}
+
+PDFDocument PDFDocumentReader::readFromByteSource(PDFByteSourcePointer byteSource)
+{
+    reset();
+
+    std::shared_ptr<PDFByteSourceCache> byteSourceCache;
+    bool shouldTryPermissiveReading = true;
+
+    try
+    {
+        byteSourceCache = std::make_shared<PDFByteSourceCache>(qMove(byteSource));
+        const qint64 size = byteSourceCache->getSize();
+
+        // Read header and footer of the document
+        byteSourceCache->ensureRange(0, PDF_HEADER_SCAN_LIMIT);
+        byteSourceCache->ensureRange(size - PDF_FOOTER_SCAN_LIMIT, PDF_FOOTER_SCAN_LIMIT);
+
+        QByteArray buffer = byteSourceCache->getData();
+        m_source = buffer;
+        m_sourceOwner = byteSourceCache;
+        m_objectArena = PDFObjectArena::createArena();
+
+        checkFooter(buffer);
+        const PDFInteger firstXrefTableOffset = findXrefTableOffset(buffer);
+        checkHeader(buffer);
+
+        prefetchByteSourceData(byteSourceCache.get(), firstXrefTableOffset);
+
+        PDFXRefTable xrefTable;
+        try
+        {
+            xrefTable.readXRefTable(nullptr, buffer, firstXrefTableOffset);
+        }
+        catch (const PDFException&)
+        {
+            // Some cross reference tables (for example, of incremental updates)
+            // are outside of the read data, so we must read all data.
+            byteSourceCache->ensureRange(0, size);
+            xrefTable.readXRefTable(nullptr, buffer, firstXrefTableOffset);
+        }
+
+        if (xrefTable.getSize() == 0)
+        {
+            throw PDFException(tr("Empty xref table."));
+        }
+
+        shouldTryPermissiveReading = false;
+        return createOnDemandDocument(xrefTable, buffer, byteSourceCache);
+    }
+    catch (const PDFException &parserException)
+    {
+        m_result = Result::Failed;
+        m_errorMessage = parserException.getMessage();
+        m_warnings << m_errorMessage;
+    }
+
+    if (m_result == Result::Failed && m_permissive && shouldTryPermissiveReading && byteSourceCache)
+    {
+        try
+        {
+            // Damaged document must be read whole
+            byteSourceCache->ensureRange(0, byteSourceCache->getSize());
+            return readDamagedDocumentFromBuffer(m_source);
+        }
+        catch (const PDFException &exception)
+        {
+            m_warnings << exception.getMessage();
+        }
+    }
+
+    return PDFDocument();
+}
+
+void PDFDocumentReader::prefetchByteSourceData(PDFByteSourceCache* byteSourceCache, PDFInteger firstXrefTableOffset)
+{
+    const qint64 size = byteSourceCache->getSize();
+
+    // Linearization dictionary is the first object in the file, it must be
+    // contained in the header (first 1024 bytes), which is already read.
+    try
+    {
+        PDFParsingContext context([](PDFParsingContext*, PDFObjectReference){ return PDFObject(); });
+        const QByteArray header = m_source.left(PDF_HEADER_SCAN_LIMIT);
+        PDFParser parser(header, &context, PDFParser::None);
+
+        PDFObject objectNumber = parser.getObject();
+        PDFObject generation = parser.getObject();
+        if (objectNumber.isInt() && generation.isInt() && parser.fetchCommand(PDF_OBJECT_START_MARK))
+        {
+            PDFObject object = parser.getObject();
+            const PDFDictionary* linearizationDictionary = object.isDictionary() ? object.getDictionary() : nullptr;
+
+            // If document was updated incrementally, then its length differs
+            // from the length in linearization dictionary, and linearization
+            // is not valid anymore.
+            if (linearizationDictionary && linearizationDictionary->hasKey("Linearized"))
+            {
+                const PDFObject& lengthObject = linearizationDictionary->get("L");
+                const PDFObject& firstPageEndObject = linearizationDictionary->get("E");
+                const PDFObject& mainXrefTableOffsetObject = linearizationDictionary->get("T");
+
+                if (lengthObject.isInt() && lengthObject.getInteger() == size &&
+                    firstPageEndObject.isInt() && mainXrefTableOffsetObject.isInt())
+                {
+                    // First page section (including first page cross reference
+                    // table) and main cross reference table at the end of the file.
+                    const PDFInteger mainXrefTableOffset = mainXrefTableOffsetObject.getInteger();
+                    byteSourceCache->ensureRange(0, firstPageEndObject.getInteger());
+                    byteSourceCache->ensureRange(qMin(mainXrefTableOffset, firstXrefTableOffset), size);
+                    return;
+                }
+            }
+        }
+    }
+    catch (const PDFException&)
+    {
+        // Document is not linearized
+    }
+
+    // Cross reference table of the document is usually at the end of the file
+    byteSourceCache->ensureRange(firstXrefTableOffset, size);
+}
+
+std::shared_ptr<const PDFSourceDataHash> PDFDocumentReader::createSourceDataHash(const QByteArray& sourceData) const
+{
+    std::shared_ptr<PDFSourceDataHash> sourceDataHash = std::make_shared<PDFSourceDataHash>(sourceData, m_sourceOwner);
+    if (!m_sourceOwner)
+    {
+        // Data are in the memory, so we do not keep them until hash is requested
+        sourceDataHash->getHash();
+    }
+    return sourceDataHash;
+}
+
 QByteArray PDFDocumentReader::hash(const QByteArray& sourceData)
 {
     return QCryptographicHash::hash(sourceData, QCryptographicHash::Sha256);
 }
 
-std::vector<std::pair<int, int>> PDFDocumentReader::findObjectByteOffsets(const QByteArray& buffer) const
+/// Kernels for scanning of damaged documents. Kernels find positions of candidate
+/// characters, i.e. last characters of the marks - 'j' (obj, endobj), 'm' (stream,
+/// endstream) and 'r' (trailer). Candidates are then verified by scalar code.
+class PDFDamagedDocumentScannerKernels
 {
-    std::vector<std::pair<int, int>> offsets;
-    int lastOffset = 0;
-    const int shift = static_cast<int>(std::strlen(PDF_OBJECT_END_MARK));
-    while (lastOffset < buffer.size())
+public:
+    /// Finds candidate characters in the data and appends their
+    /// positions (relative to the \p data) to the \p candidates.
+    /// \param data Data
+    /// \param size Size of the data
+    /// \param candidates Positions of candidate characters
+    static void findCandidates(const char* data, int size, std::vector<int>& candidates);
+
+private:
+    static constexpr bool isCandidate(char character) { return character == 'j' || character == 'm' || character == 'r'; }
+
+#if defined(PDF4QT_SIMD_SSE2)
+    static int findCandidatesSSE2(const char* data, int size, int i, std::vector<int>& candidates);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static int findCandidatesAVX2(const char* data, int size, std::vector<int>& candidates);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static int findCandidatesNEON(const char* data, int size, std::vector<int>& candidates);
+#endif
+};
+
+void PDFDamagedDocumentScannerKernels::findCandidates(const char* data, int size, std::vector<int>& candidates)
+{
+    int i = 0;
+
+    switch (PDFSimd::getInstructionSet())
     {
-        int offset = buffer.indexOf(PDF_OBJECT_END_MARK, lastOffset);
+#if defined(PDF4QT_SIMD_AVX2)
+        case PDFSimd::InstructionSet::AVX2:
+            i = findCandidatesSSE2(data, size, findCandidatesAVX2(data, size, candidates), candidates);
+            break;
+#endif
 
-        // Object end mark was not found
-        if (offset == -1)
-        {
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+            i = findCandidatesSSE2(data, size, 0, candidates);
             break;
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+        case PDFSimd::InstructionSet::NEON:
+            i = findCandidatesNEON(data, size, candidates);
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    for (; i < size; ++i)
+    {
+        if (isCandidate(data[i]))
+        {
+            candidates.push_back(i);
         }
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+int PDFDamagedDocumentScannerKernels::findCandidatesSSE2(const char* data, int size, int i, std::vector<int>& candidates)
+{
+    const __m128i j = _mm_set1_epi8('j');
+    const __m128i m = _mm_set1_epi8('m');
+    const __m128i r = _mm_set1_epi8('r');
 
-        offset += shift;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(value, j), _mm_cmpeq_epi8(value, m)), _mm_cmpeq_epi8(value, r));
 
-        int startOffset = buffer.indexOf(PDF_OBJECT_START_MARK, lastOffset);
-        if (startOffset != -1 && startOffset < offset)
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match));
+        while (mask)
         {
-            --startOffset;
+            candidates.push_back(i + qCountTrailingZeroBits(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+PDF4QT_SIMD_AVX2_FUNCTION int PDFDamagedDocumentScannerKernels::findCandidatesAVX2(const char* data, int size, std::vector<int>& candidates)
+{
+    const __m256i j = _mm256_set1_epi8('j');
+    const __m256i m = _mm256_set1_epi8('m');
+    const __m256i r = _mm256_set1_epi8('r');
+
+    int i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(value, j), _mm256_cmpeq_epi8(value, m)), _mm256_cmpeq_epi8(value, r));
+
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+        while (mask)
+        {
+            candidates.push_back(i + qCountTrailingZeroBits(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+int PDFDamagedDocumentScannerKernels::findCandidatesNEON(const char* data, int size, std::vector<int>& candidates)
+{
+    const uint8x16_t j = vdupq_n_u8('j');
+    const uint8x16_t m = vdupq_n_u8('m');
+    const uint8x16_t r = vdupq_n_u8('r');
+
+    // NEON has no movemask instruction, so we only test, if block
+    // contains some candidate, and then we scan the block using scalar code.
+    int i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const uint8x16_t value = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        const uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(value, j), vceqq_u8(value, m)), vceqq_u8(value, r));
+
+        if (vmaxvq_u8(match))
+        {
+            for (int k = i; k < i + 16; ++k)
+            {
+                if (isCandidate(data[k]))
+                {
+                    candidates.push_back(k);
+                }
+            }
+        }
+    }
+
+    return i;
+}
+#endif
+
+PDFDocumentReader::DamagedDocumentMarks PDFDocumentReader::scanDamagedDocument(const QByteArray& buffer) const
+{
+    enum class MarkType
+    {
+        ObjectStart,    ///< Offset of the "obj" mark
+        ObjectEnd,      ///< Offset just after the "endobj" mark
+        StreamStart,    ///< Offset of the "stream" mark
+        StreamEnd,      ///< Offset of the "endstream" mark
+        Trailer         ///< Offset just after the "trailer" mark
+    };
+
+    struct Mark
+    {
+        MarkType type;
+        int offset;
+    };
+
+    const char* data = buffer.constData();
+    const int size = static_cast<int>(buffer.size());
+
+    // Returns true, if mark ends at given position. Mark must not
+    // be followed by a regular character (so it is a whole token).
+    auto isMarkAt = [data, size](int lastCharacterPosition, std::string_view mark)
+    {
+        const int markStart = lastCharacterPosition + 1 - static_cast<int>(mark.size());
+        if (markStart < 0 || std::memcmp(data + markStart, mark.data(), mark.size()) != 0)
+        {
+            return false;
+        }
+
+        return lastCharacterPosition + 1 == size || !PDFLexicalAnalyzer::isRegular(data[lastCharacterPosition + 1]);
+    };
+
+    // First pass - buffer is divided into chunks, which are scanned in parallel.
+    // Mark belongs to the chunk containing its last character, verification
+    // of the mark can read data before the chunk start.
+    constexpr int CHUNK_SIZE = 1 << 20;
+    const int chunkCount = qMax((size + CHUNK_SIZE - 1) / CHUNK_SIZE, 1);
+    std::vector<std::vector<Mark>> chunkMarks(chunkCount);
+
+    auto scanChunk = [&](std::vector<Mark>& marks)
+    {
+        const int chunkIndex = static_cast<int>(&marks - chunkMarks.data());
+        const int chunkStart = chunkIndex * CHUNK_SIZE;
+        const int chunkEnd = qMin(chunkStart + CHUNK_SIZE, size);
+
+        if (chunkStart >= chunkEnd)
+        {
+            return;
+        }
+
+        std::vector<int> candidates;
+        PDFDamagedDocumentScannerKernels::findCandidates(data + chunkStart, chunkEnd - chunkStart, candidates);
 
-            // Skip whitespace between obj and generation number
-            while (startOffset >= 0 && PDFLexicalAnalyzer::isWhitespace(buffer[startOffset]))
+        for (const int candidate : candidates)
+        {
+            const int position = chunkStart + candidate;
+            switch (data[position])
             {
-                --startOffset;
+                case 'j':
+                {
+                    if (isMarkAt(position, PDF_OBJECT_END_MARK))
+                    {
+                        marks.push_back({ MarkType::ObjectEnd, position + 1 });
+                    }
+                    else if (isMarkAt(position, PDF_OBJECT_START_MARK) && position >= 3 && (PDFLexicalAnalyzer::isWhitespace(data[position - 3]) || std::isdigit(static_cast<unsigned char>(data[position - 3]))))
+                    {
+                        marks.push_back({ MarkType::ObjectStart, position - 2 });
+                    }
+                    break;
+                }
+
+                case 'm':
+                {
+                    if (isMarkAt(position, PDF_STREAM_END_COMMAND))
+                    {
+                        marks.push_back({ MarkType::StreamEnd, position - 8 });
+                    }
+                    else if (isMarkAt(position, PDF_STREAM_START_COMMAND))
+                    {
+                        marks.push_back({ MarkType::StreamStart, position - 5 });
+                    }
+                    break;
+                }
+
+                case 'r':
+                {
+                    if (isMarkAt(position, PDF_XREF_TRAILER))
+                    {
+                        marks.push_back({ MarkType::Trailer, position + 1 });
+                    }
+                    break;
+                }
+
+                default:
+                    Q_ASSERT(false);
+                    break;
             }
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, chunkMarks.begin(), chunkMarks.end(), scanChunk);
+
+    // Finds start of the object, i.e. object number before the "obj" mark
+    auto findObjectStart = [data](int objectMarkOffset)
+    {
+        int startOffset = objectMarkOffset - 1;
+
+        // Skip whitespace between obj and generation number
+        while (startOffset >= 0 && PDFLexicalAnalyzer::isWhitespace(data[startOffset]))
+        {
+            --startOffset;
+        }
+
+        // Skip generation number
+        while (startOffset >= 0 && std::isdigit(static_cast<unsigned char>(data[startOffset])))
+        {
+            --startOffset;
+        }
 
-            // Skip generation number
-            while (startOffset >= 0 && std::isdigit(buffer[startOffset]))
+        // Skip whitespace between generation number and object number
+        while (startOffset >= 0 && PDFLexicalAnalyzer::isWhitespace(data[startOffset]))
+        {
+            --startOffset;
+        }
+
+        // Skip object number
+        while (startOffset >= 0 && std::isdigit(static_cast<unsigned char>(data[startOffset])))
+        {
+            --startOffset;
+        }
+
+        return startOffset + 1;
+    };
+
+    std::vector<Mark> marks;
+    for (const std::vector<Mark>& currentChunkMarks : chunkMarks)
+    {
+        marks.insert(marks.end(), currentChunkMarks.cbegin(), currentChunkMarks.cend());
+    }
+
+    // Second pass - marks are processed in file order. Stream data can contain
+    // anything, so all marks inside streams are skipped. If stream end mark is missing
+    // (next stream starts before it), stream is damaged, and its data are not skipped.
+    DamagedDocumentMarks result;
+    int objectMarkOffset = -1;
+
+    for (size_t i = 0; i < marks.size(); ++i)
+    {
+        const Mark& mark = marks[i];
+        switch (mark.type)
+        {
+            case MarkType::ObjectStart:
             {
-                --startOffset;
+                // First object mark after the previous object is used
+                if (objectMarkOffset == -1)
+                {
+                    objectMarkOffset = mark.offset;
+                }
+                break;
             }
 
-            // Skip whitespace between generation number and object number
-            while (startOffset >= 0 && PDFLexicalAnalyzer::isWhitespace(buffer[startOffset]))
+            case MarkType::ObjectEnd:
             {
-                --startOffset;
+                if (objectMarkOffset != -1)
+                {
+                    const int objectStart = findObjectStart(objectMarkOffset);
+                    if (objectStart < mark.offset)
+                    {
+                        result.objectOffsets.emplace_back(objectStart, mark.offset);
+                    }
+                    objectMarkOffset = -1;
+                }
+                break;
             }
 
-            // Skip object number
-            while (startOffset >= 0 && std::isdigit(buffer[startOffset]))
+            case MarkType::StreamStart:
             {
-                --startOffset;
+                if (objectMarkOffset != -1)
+                {
+                    size_t streamEndIndex = i + 1;
+                    while (streamEndIndex < marks.size() && marks[streamEndIndex].type != MarkType::StreamEnd && marks[streamEndIndex].type != MarkType::StreamStart)
+                    {
+                        ++streamEndIndex;
+                    }
+
+                    if (streamEndIndex < marks.size() && marks[streamEndIndex].type == MarkType::StreamEnd)
+                    {
+                        i = streamEndIndex;
+                    }
+                }
+                break;
             }
 
-            ++startOffset;
+            case MarkType::StreamEnd:
+                break;
 
-            if (startOffset < offset)
+            case MarkType::Trailer:
             {
-                offsets.emplace_back(startOffset, offset);
+                result.trailerOffsets.push_back(mark.offset);
+                break;
             }
         }
-
-        lastOffset = offset;
     }
 
-    return offsets;
+    return result;
 }
 
 bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>& restoredObjects, const std::vector<std::pair<int, int>>& offsets)
 {
-    QMutex restoredObjectsMutex;
+    struct RestoredObject
+    {
+        PDFObjectReference reference;
+        PDFObject object;
+    };
+
+    // Restored objects are only read during parallel parsing, and they are
+    // updated afterwards, so no locking is needed.
     std::atomic_bool succesfull = true;
+    std::vector<RestoredObject> parsedObjects(offsets.size());
 
-    auto getObject = [&restoredObjects, &restoredObjectsMutex](PDFParsingContext*, PDFObjectReference reference)
+    auto getObject = [&restoredObjects](PDFParsingContext*, PDFObjectReference reference)
     {
-        QMutexLocker lock(&restoredObjectsMutex);
-
         auto it = restoredObjects.find(reference);
         if (it != restoredObjects.cend())
         {
@@ -700,6 +1620,8 @@ bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>&
             const char* end = m_source.constData() + endOffset;
 
             PDFParser parser(begin, end, &context, PDFParser::AllowStreams);
+            parser.setDataOwner(m_sourceOwner);
+            parser.setObjectArena(m_objectArena.get());
             PDFObject objectNumberObject = parser.getObject();
             PDFObject objectGenerationObject = parser.getObject();
             parser.fetchCommand(PDF_OBJECT_START_MARK);
@@ -710,11 +1632,9 @@ bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>&
                 PDFObjectReference reference(objectNumberObject.getInteger(), objectGenerationObject.getInteger());
                 if (reference.isValid())
                 {
-                    QMutexLocker lock(&restoredObjectsMutex);
-                    if (!restoredObjects.count(reference))
-                    {
-                        restoredObjects[reference] = qMove(object);
-                    }
+                    RestoredObject& parsedObject = parsedObjects[&offset - offsets.data()];
+                    parsedObject.reference = reference;
+                    parsedObject.object = qMove(object);
                 }
             }
         }
@@ -725,6 +1645,18 @@ bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>&
         }
     };
     PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, offsets.cbegin(), offsets.cend(), processOffsetEntry);
+
+    // Merge in file order. If object with the same reference occurs multiple
+    // times (for example, in incremental updates), the last one is used,
+    // regardless of thread scheduling.
+    for (RestoredObject& parsedObject : parsedObjects)
+    {
+        if (parsedObject.reference.isValid())
+        {
+            restoredObjects[parsedObject.reference] = qMove(parsedObject.object);
+        }
+    }
+
     return succesfull;
 }
 
@@ -737,7 +1669,9 @@ PDFDocument PDFDocumentReader::readDamagedDocumentFromBuffer(const QByteArray& b
         // Try to reconstruct trailer dictionary
         std::map<PDFObjectReference, PDFObject> restoredObjects;
 
-        PDFObject trailerDictionaryObject = readDamagedTrailerDictionary();
+        DamagedDocumentMarks marks = scanDamagedDocument(buffer);
+
+        PDFObject trailerDictionaryObject = readDamagedTrailerDictionary(marks.trailerOffsets);
         if (!trailerDictionaryObject.isDictionary())
         {
             throw PDFException(PDFTranslationContext::tr("Trailer dictionary is not valid."));
@@ -745,10 +1679,9 @@ PDFDocument PDFDocumentReader::readDamagedDocumentFromBuffer(const QByteArray& b
 
         // Jakub Melka: Try to parse objects - read offsets of objects. We must probably
         // try second pass, if some streams have referenced objects.
-        std::vector<std::pair<int, int>> offsets = findObjectByteOffsets(buffer);
-        if (!restoreObjects(restoredObjects, offsets))
+        if (!restoreObjects(restoredObjects, marks.objectOffsets))
         {
-            restoreObjects(restoredObjects, offsets);
+            restoreObjects(restoredObjects, marks.objectOffsets);
         }
 
         // We will create security handler.
@@ -774,6 +1707,8 @@ PDFDocument PDFDocumentReader::readDamagedDocumentFromBuffer(const QByteArray& b
         }
 
         PDFObjectStorage storage(std::move(objects), PDFObject(trailerDictionaryObject), qMove(m_securityHandler));
+        storage.setObjectArena(m_objectArena);
+        storage.createDecodedStreamCache();
         return PDFDocument(std::move(storage), m_version, QByteArray());
     }
     catch (const PDFException &parserException)
@@ -791,10 +1726,12 @@ void PDFDocumentReader::reset()
     m_errorMessage = QString();
     m_version = PDFVersion();
     m_source = QByteArray();
+    m_sourceOwner.reset();
+    m_objectArena.reset();
     m_securityHandler = nullptr;
 }
 
-int PDFDocumentReader::findFromEnd(const char* what, const QByteArray& byteArray, int limit)
+PDFInteger PDFDocumentReader::findFromEnd(const char* what, const QByteArray& byteArray, int limit)
 {
     if (byteArray.isEmpty())
     {
@@ -802,8 +1739,8 @@ int PDFDocumentReader::findFromEnd(const char* what, const QByteArray& byteArray
         return FIND_NOT_FOUND_RESULT;
     }
 
-    const int size = byteArray.size();
-    const int adjustedLimit = qMin(byteArray.size(), limit);
+    const qsizetype size = byteArray.size();
+    const qsizetype adjustedLimit = qMin(byteArray.size(), qsizetype(limit));
     const int whatLength = static_cast<int>(std::strlen(what));
 
     if (adjustedLimit < whatLength)
@@ -23,6 +23,8 @@
 #include "pdfdocument.h"
 #include "pdfprogress.h"
 #include "pdfxreftable.h"
+#include "pdfobjectarena.h"
+#include "pdfbytesource.h"
 
 #include <QMutex>
 #include <QIODevice>
@@ -54,6 +56,41 @@ public:
         Cancelled   ///< User cancelled document reading
     };
 
+    enum class ReadingMode
+    {
+        Buffered,       ///< Whole file is read into the memory buffer
+        MemoryMapped    ///< File is memory mapped, objects are parsed directly from the mapping
+    };
+
+    /// Sets reading mode used in \p readFromFile function. In memory mapped mode,
+    /// stream data are not copied, but they are referenced from the mapped file,
+    /// and are sliced out of it only when stream is decoded. Mapped file
+    /// is kept opened as long as some stream of the document references it,
+    /// so file should not be modified during that time. If file can't
+    /// be mapped, then buffered mode is used as fallback.
+    /// \param readingMode Reading mode
+    void setReadingMode(ReadingMode readingMode) { m_readingMode = readingMode; }
+
+    /// Returns reading mode used in \p readFromFile function
+    ReadingMode getReadingMode() const { return m_readingMode; }
+
+    enum class ObjectLoadingMode
+    {
+        Immediate,  ///< All objects are parsed, when document is read
+        OnDemand    ///< Objects are parsed, when they are accessed for the first time
+    };
+
+    /// Sets object loading mode. In on demand mode, only cross reference table
+    /// and trailer dictionary is read, objects are parsed (and decrypted), when they
+    /// are accessed for the first time. Because objects are not parsed during reading,
+    /// errors in objects are not detected, and such objects are treated as null objects.
+    /// Damaged documents are always read with immediate loading.
+    /// \param objectLoadingMode Object loading mode
+    void setObjectLoadingMode(ObjectLoadingMode objectLoadingMode) { m_objectLoadingMode = objectLoadingMode; }
+
+    /// Returns object loading mode
+    ObjectLoadingMode getObjectLoadingMode() const { return m_objectLoadingMode; }
+
     /// Reads a PDF document from the specified file. If file doesn't exist,
     /// cannot be opened or contain invalid pdf, empty PDF file is returned.
     /// No exception is thrown.
@@ -69,13 +106,24 @@ public:
     /// PDF is read, then empty PDF document is returned. No exception is thrown.
     PDFDocument readFromBuffer(const QByteArray& buffer);
 
+    /// Reads a PDF document from the byte source (for example, from remote storage).
+    /// Objects are always loaded on demand, and only data, which are needed, are
+    /// read from the byte source - header, footer, cross reference tables and data
+    /// of the accessed objects. If document is linearized, then data of the first
+    /// page are read at once. If incorrect PDF is read, then empty PDF document
+    /// is returned. No exception is thrown.
+    /// \param byteSource Byte source
+    PDFDocument readFromByteSource(PDFByteSourcePointer byteSource);
+
     /// Returns result code for reading document from the device
     Result getReadingResult() const { return m_result; }
 
     /// Returns error message, if document reading was unsuccessfull
     const QString& getErrorMessage() const { return m_errorMessage; }
 
-    /// Get source data of the document
+    /// Get source data of the document. If document was read in memory mapped
+    /// mode, then source data references the mapped file, and are valid only
+    /// as long as this reader or the streams of the read document exist.
     const QByteArray& getSource() const { return m_source; }
 
     /// Returns warning messages
@@ -84,11 +132,23 @@ public:
     static QByteArray hash(const QByteArray& sourceData);
 
 private:
-    static constexpr const int FIND_NOT_FOUND_RESULT = -1;
+    static constexpr const PDFInteger FIND_NOT_FOUND_RESULT = -1;
+
+    /// Creates hash of the source data. If source data are memory mapped,
+    /// then hash is computed on demand, otherwise it is computed immediately.
+    /// \param sourceData Source data
+    std::shared_ptr<const PDFSourceDataHash> createSourceDataHash(const QByteArray& sourceData) const;
 
     /// Resets the internal state and prepares it for new reading cycle
     void reset();
 
+    /// Reads a PDF document from the specified buffer. If \p sourceOwner
+    /// is set, then buffer doesn't own its data, and stream content
+    /// of the document will reference the buffer data.
+    /// \param buffer Buffer
+    /// \param sourceOwner Owner of the buffer data (or nullptr)
+    PDFDocument readFromSource(const QByteArray& buffer, std::shared_ptr<const void> sourceOwner);
+
     /// Find a last string in the byte array, scan only \p limit bytes. If string
     /// is not found, then FIND_NOT_FOUND_RESULT is returned, if it is found, then
     /// it position from the beginning of byte array is returned.
@@ -96,7 +156,7 @@ private:
     /// \param byteArray Byte array to be scanned from the end
     /// \param limit Scan up to this value bytes from the end
     /// \returns Position of string, or FIND_NOT_FOUND_RESULT
-    int findFromEnd(const char* what, const QByteArray& byteArray, int limit);
+    PDFInteger findFromEnd(const char* what, const QByteArray& byteArray, int limit);
 
     void checkFooter(const QByteArray& buffer);
     void checkHeader(const QByteArray& buffer);
@@ -105,6 +165,18 @@ private:
     Result processSecurityHandler(const PDFObject& trailerDictionaryObject, const std::vector<PDFXRefTable::Entry>& occupiedEntries, PDFObjectStorage::PDFObjects& objects);
     void processObjectStreams(PDFXRefTable* xrefTable, PDFObjectStorage::PDFObjects& objects);
 
+    /// Creates document, whose objects are loaded on demand
+    /// \param xrefTable Cross reference table
+    /// \param buffer Source data
+    /// \param byteSourceCache Byte source cache, from which object data are read (or nullptr)
+    PDFDocument createOnDemandDocument(const PDFXRefTable& xrefTable, const QByteArray& buffer, std::shared_ptr<PDFByteSourceCache> byteSourceCache = nullptr);
+
+    /// Reads data of cross reference tables from the byte source cache. If document
+    /// is linearized, data of the first page are also read.
+    /// \param byteSourceCache Byte source cache
+    /// \param firstXrefTableOffset Offset of the first cross reference table
+    void prefetchByteSourceData(PDFByteSourceCache* byteSourceCache, PDFInteger firstXrefTableOffset);
+
     /// This function fetches object from the buffer from the specified offset.
     /// Can throw exception, returns a pair of scanned reference and object content.
     /// \param context Context
@@ -114,7 +186,8 @@ private:
 
     /// Tries to restore objects from object list. This function can be used in multiple pass, because
     /// for example streams, can have length defined in referred object. If such is the case, then
-    /// second pass is needed. Returns true, if all object were correctly read.
+    /// second pass is needed. Returns true, if all object were correctly read. Objects are parsed
+    /// in parallel, if object occurs in offsets multiple times, then last occurence is used.
     /// \param restoredObjects Map of restored objects
     /// \param offsets Offsets, from which are objects being read
     bool restoreObjects(std::map<PDFObjectReference, PDFObject>& restoredObjects, const std::vector<std::pair<int, int>>& offsets);
@@ -123,18 +196,31 @@ private:
     PDFObject getObjectFromXrefTable(PDFXRefTable* xrefTable, PDFParsingContext* context, PDFObjectReference reference) const;
 
     /// Tries to read damaged trailer dictionary
-    PDFObject readDamagedTrailerDictionary() const;
+    /// \param trailerOffsets Offsets of the trailer dictionaries (after trailer mark)
+    PDFObject readDamagedTrailerDictionary(const std::vector<int>& trailerOffsets) const;
 
     /// Attempts to read a damaged PDF document from the specified buffer (byte array). If incorrect
     /// PDF is read, then empty PDF document is returned. No exception is thrown.
     PDFDocument readDamagedDocumentFromBuffer(const QByteArray& buffer);
 
-    /// This function is used, when damaged pdf document is being restored. It returns
-    /// array of hints, where objects should appear. It constists of pair of start offset,
-    /// and end offset. Start offset is always a valid index to the buffer, end offset
-    /// can be one index after the buffers end (it is end iterator).
+    /// Marks found in the damaged document
+    struct DamagedDocumentMarks
+    {
+        /// Array of hints, where objects should appear. It constists of pair of start offset,
+        /// and end offset. Start offset is always a valid index to the buffer, end offset
+        /// can be one index after the buffers end (it is end iterator).
+        std::vector<std::pair<int, int>> objectOffsets;
+
+        /// Offsets of trailer dictionaries (just after the trailer mark)
+        std::vector<int> trailerOffsets;
+    };
+
+    /// This function is used, when damaged pdf document is being restored. Buffer
+    /// is scanned in single pass (chunks of the buffer are scanned in parallel)
+    /// and object marks, stream marks and trailer marks are found together.
+    /// Object end marks inside streams are ignored.
     /// \param buffer Buffer
-    std::vector<std::pair<int, int>> findObjectByteOffsets(const QByteArray& buffer) const;
+    DamagedDocumentMarks scanDamagedDocument(const QByteArray& buffer) const;
 
     void progressStart(size_t stepCount, QString text);
     void progressStep();
@@ -162,6 +248,21 @@ private:
     /// Raw document data (byte array containing source data for created document)
     QByteArray m_source;
 
+    /// Owner of raw document data, if raw document data are not owned
+    /// by the byte array (for example, if file is memory mapped)
+    std::shared_ptr<const void> m_sourceOwner;
+
+    /// Arena for content of objects of currently read document. Each read
+    /// document has its own arena, which is owned by the object storage
+    /// of the document.
+    PDFObjectArenaPointer m_objectArena;
+
+    /// Reading mode for reading from file
+    ReadingMode m_readingMode = ReadingMode::Buffered;
+
+    /// Object loading mode
+    ObjectLoadingMode m_objectLoadingMode = ObjectLoadingMode::Immediate;
+
     /// Security handler
     PDFSecurityHandlerPointer m_securityHandler;
 
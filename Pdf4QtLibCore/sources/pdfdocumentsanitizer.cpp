@@ -20,8 +20,14 @@
 #include "pdfexecutionpolicy.h"
 #include "pdfoptimizer.h"
 #include "pdfdocumentbuilder.h"
+#include "pdfobjectutils.h"
+#include "pdfannotation.h"
+#include "pdfpage.h"
 #include "pdfdbgheap.h"
 
+#include <map>
+#include <set>
+
 namespace pdf
 {
 
@@ -77,43 +83,42 @@ void PDFDocumentSanitizer::sanitize()
 {
     Q_EMIT sanitizationStarted();
 
-    if (m_flags.testFlag(DocumentInfo))
+    // Passes, which modify only the trailer and the catalog, touch only few
+    // objects, so they share single document builder.
+    if (m_flags.testFlag(DocumentInfo) || m_flags.testFlag(Outline) || m_flags.testFlag(FileAttachments) || m_flags.testFlag(EmbeddedSearchIndex))
     {
-        performSanitizeDocumentInfo();
-    }
+        PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
 
-    if (m_flags.testFlag(Metadata))
-    {
-        performSanitizeMetadata();
-    }
+        if (m_flags.testFlag(DocumentInfo))
+        {
+            performSanitizeDocumentInfo(&builder);
+        }
 
-    if (m_flags.testFlag(Outline))
-    {
-        performSanitizeOutline();
-    }
+        if (m_flags.testFlag(Outline))
+        {
+            performSanitizeOutline(&builder);
+        }
 
-    if (m_flags.testFlag(FileAttachments))
-    {
-        performSanitizeFileAttachments();
-    }
+        if (m_flags.testFlag(FileAttachments))
+        {
+            performSanitizeEmbeddedFiles(&builder);
+        }
 
-    if (m_flags.testFlag(EmbeddedSearchIndex))
-    {
-        performSanitizeEmbeddedSearchIndex();
-    }
+        if (m_flags.testFlag(EmbeddedSearchIndex))
+        {
+            performSanitizeEmbeddedSearchIndex(&builder);
+        }
 
-    if (m_flags.testFlag(MarkupAnnotations))
-    {
-        performSanitizeMarkupAnnotations();
+        PDFDocument document = builder.build();
+        m_storage = document.getStorage();
     }
 
-    if (m_flags.testFlag(PageThumbnails))
-    {
-        performSanitizePageThumbnails();
-    }
+    // Page passes, metadata removal and unused object removal are
+    // performed in single sweep over all objects.
+    performSanitizeObjects();
 
-    // Optimize - remove unused objects
-    PDFOptimizer optimizer(PDFOptimizer::OptimizationFlags(PDFOptimizer::RemoveUnusedObjects | PDFOptimizer::ShrinkObjectStorage | PDFOptimizer::RemoveNullObjects), nullptr);
+    // Optimize - remove null objects and shrink object storage
+    PDFOptimizer optimizer(PDFOptimizer::OptimizationFlags(PDFOptimizer::ShrinkObjectStorage | PDFOptimizer::RemoveNullObjects), nullptr);
     optimizer.setStorage(m_storage);
     optimizer.optimize();
     m_storage = optimizer.takeStorage();
@@ -131,15 +136,12 @@ void PDFDocumentSanitizer::setFlags(SanitizationFlags flags)
     m_flags = flags;
 }
 
-void PDFDocumentSanitizer::performSanitizeDocumentInfo()
+void PDFDocumentSanitizer::performSanitizeDocumentInfo(PDFDocumentBuilder* builder)
 {
-    PDFObjectReference emptyDocumentInfoReference = m_storage.addObject(PDFObject());
+    PDFObjectReference emptyDocumentInfoReference = builder->addObject(PDFObject());
 
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    const bool hasDocumentInfo = builder.getDocumentInfo().isValid();
-    builder.setDocumentInfo(emptyDocumentInfoReference);
-    PDFDocument document = builder.build();
-    m_storage = document.getStorage();
+    const bool hasDocumentInfo = builder->getDocumentInfo().isValid();
+    builder->setDocumentInfo(emptyDocumentInfoReference);
 
     if (hasDocumentInfo)
     {
@@ -147,58 +149,32 @@ void PDFDocumentSanitizer::performSanitizeDocumentInfo()
     }
 }
 
-void PDFDocumentSanitizer::performSanitizeMetadata()
+void PDFDocumentSanitizer::performSanitizeOutline(PDFDocumentBuilder* builder)
 {
-    std::atomic<PDFInteger> counter = 0;
-
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
-    {
-        PDFRemoveMetadataVisitor visitor(&m_storage, &counter);
-        entry.object.accept(&visitor);
-        entry.object = visitor.getObject();
-    };
-
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT sanitizationProgress(tr("Metadata streams removed: %1").arg(counter));
-}
-
-void PDFDocumentSanitizer::performSanitizeOutline()
-{
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    PDFObject catalogObject = builder.getObjectByReference(builder.getCatalogReference());
-    const PDFDictionary* catalogDictionary = builder.getDictionaryFromObject(catalogObject);
+    PDFObject catalogObject = builder->getObjectByReference(builder->getCatalogReference());
+    const PDFDictionary* catalogDictionary = builder->getDictionaryFromObject(catalogObject);
     const bool hasOutline = catalogDictionary && catalogDictionary->hasKey("Outlines");
 
     if (hasOutline)
     {
-        builder.removeOutline();
-        PDFDocument document = builder.build();
-        m_storage = document.getStorage();
+        builder->removeOutline();
         Q_EMIT sanitizationProgress(tr("Outline was removed."));
     }
 }
 
-void PDFDocumentSanitizer::performSanitizeFileAttachments()
+void PDFDocumentSanitizer::performSanitizeEmbeddedFiles(PDFDocumentBuilder* builder)
 {
-    auto filter = [](const PDFAnnotation* annotation)
-    {
-        return annotation->getType() == AnnotationType::FileAttachment;
-    };
-    removeAnnotations(filter, tr("File attachments removed: %1."));
-
-    // Remove files in name tree
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    PDFObject catalogObject = builder.getObjectByReference(builder.getCatalogReference());
-    const PDFDictionary* catalogDictionary = builder.getDictionaryFromObject(catalogObject);
+    // Remove files in name tree, file attachment annotations
+    // are removed in the page pass.
+    PDFObject catalogObject = builder->getObjectByReference(builder->getCatalogReference());
+    const PDFDictionary* catalogDictionary = builder->getDictionaryFromObject(catalogObject);
     const bool hasNames = catalogDictionary && catalogDictionary->hasKey("Names");
 
     if (hasNames)
     {
-        PDFObject namesObject = builder.getObject(catalogDictionary->get("Names"));
-        const PDFDictionary* namesDictionary = builder.getDictionaryFromObject(namesObject);
-        if (namesDictionary->hasKey("EmbeddedFiles"))
+        PDFObject namesObject = builder->getObject(catalogDictionary->get("Names"));
+        const PDFDictionary* namesDictionary = builder->getDictionaryFromObject(namesObject);
+        if (namesDictionary && namesDictionary->hasKey("EmbeddedFiles"))
         {
             PDFDictionary dictionaryCopy = *namesDictionary;
             dictionaryCopy.setEntry(PDFInplaceOrMemoryString("EmbeddedFiles"), PDFObject());
@@ -211,26 +187,23 @@ void PDFDocumentSanitizer::performSanitizeFileAttachments()
             factory.endDictionaryItem();
             factory.endDictionary();
             PDFObject newCatalog = factory.takeObject();
-            builder.mergeTo(builder.getCatalogReference(), std::move(newCatalog));
-            PDFDocument document = builder.build();
-            m_storage = document.getStorage();
+            builder->mergeTo(builder->getCatalogReference(), std::move(newCatalog));
             Q_EMIT sanitizationProgress(tr("Embedded files were removed."));
         }
     }
 }
 
-void PDFDocumentSanitizer::performSanitizeEmbeddedSearchIndex()
+void PDFDocumentSanitizer::performSanitizeEmbeddedSearchIndex(PDFDocumentBuilder* builder)
 {
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    PDFObject catalogObject = builder.getObjectByReference(builder.getCatalogReference());
-    const PDFDictionary* catalogDictionary = builder.getDictionaryFromObject(catalogObject);
+    PDFObject catalogObject = builder->getObjectByReference(builder->getCatalogReference());
+    const PDFDictionary* catalogDictionary = builder->getDictionaryFromObject(catalogObject);
     const bool hasPieceInfo = catalogDictionary && catalogDictionary->hasKey("PieceInfo");
 
     if (hasPieceInfo)
     {
-        PDFObject pieceInfoObject = builder.getObject(catalogDictionary->get("PieceInfo"));
-        const PDFDictionary* pieceInfoDictionary = builder.getDictionaryFromObject(pieceInfoObject);
-        if (pieceInfoDictionary->hasKey("SearchIndex"))
+        PDFObject pieceInfoObject = builder->getObject(catalogDictionary->get("PieceInfo"));
+        const PDFDictionary* pieceInfoDictionary = builder->getDictionaryFromObject(pieceInfoObject);
+        if (pieceInfoDictionary && pieceInfoDictionary->hasKey("SearchIndex"))
         {
             PDFDictionary dictionaryCopy = *pieceInfoDictionary;
             dictionaryCopy.setEntry(PDFInplaceOrMemoryString("SearchIndex"), PDFObject());
@@ -243,95 +216,224 @@ void PDFDocumentSanitizer::performSanitizeEmbeddedSearchIndex()
             factory.endDictionaryItem();
             factory.endDictionary();
             PDFObject newCatalog = factory.takeObject();
-            builder.mergeTo(builder.getCatalogReference(), std::move(newCatalog));
-            PDFDocument document = builder.build();
-            m_storage = document.getStorage();
+            builder->mergeTo(builder->getCatalogReference(), std::move(newCatalog));
             Q_EMIT sanitizationProgress(tr("Search index was removed."));
         }
     }
 }
 
-void PDFDocumentSanitizer::performSanitizeMarkupAnnotations()
+void PDFDocumentSanitizer::performSanitizeObjects()
 {
-    auto filter = [](const PDFAnnotation* annotation)
+    const bool removeMetadata = m_flags.testFlag(Metadata);
+    const bool removeFileAttachments = m_flags.testFlag(FileAttachments);
+    const bool removeMarkupAnnotations = m_flags.testFlag(MarkupAnnotations);
+    const bool removePageThumbnails = m_flags.testFlag(PageThumbnails);
+
+    // 1) Sanitize pages in parallel. Sanitized pages and removed annotations
+    //    are stored as replaced objects, which are written in the sweep.
+    std::map<PDFInteger, PDFObject> replacedObjects;
+    std::atomic<PDFInteger> fileAttachmentCounter = 0;
+    std::atomic<PDFInteger> markupAnnotationCounter = 0;
+    std::atomic<PDFInteger> thumbnailCounter = 0;
+
+    if (removeFileAttachments || removeMarkupAnnotations || removePageThumbnails)
     {
-        return annotation->asMarkupAnnotation() != nullptr;
-    };
-    removeAnnotations(filter, tr("Markup annotations removed: %1."));
-}
+        std::vector<PDFObjectReference> pageReferences;
+        if (const PDFDictionary* trailerDictionary = m_storage.getDictionaryFromObject(m_storage.getTrailerDictionary()))
+        {
+            if (const PDFDictionary* catalogDictionary = m_storage.getDictionaryFromObject(trailerDictionary->get("Root")))
+            {
+                for (const PDFPage& page : PDFPage::parse(&m_storage, catalogDictionary->get("Pages")))
+                {
+                    pageReferences.push_back(page.getPageReference());
+                }
+            }
+        }
 
-void PDFDocumentSanitizer::performSanitizePageThumbnails()
-{
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    builder.flattenPageTree();
-    std::vector<PDFObjectReference> pageReferences = builder.getPages();
-    std::vector<PDFObjectReference> pagesWithThumbnail;
+        struct SanitizedPage
+        {
+            PDFObject pageObject;
+            std::vector<PDFObjectReference> removedAnnotations;
+        };
 
-    for (const PDFObjectReference& pageReference : pageReferences)
-    {
-        const PDFDictionary* pageDictionary = builder.getDictionaryFromObject(builder.getObjectByReference(pageReference));
-        if (pageDictionary && pageDictionary->hasKey("Thumb"))
+        std::vector<SanitizedPage> sanitizedPages(pageReferences.size());
+
+        auto sanitizePage = [&](size_t index)
         {
-            pagesWithThumbnail.push_back(pageReference);
+            const PDFObjectReference pageReference = pageReferences[index];
+            const PDFDictionary* pageDictionary = m_storage.getDictionaryFromObject(m_storage.getObjectByReference(pageReference));
+
+            if (!pageDictionary)
+            {
+                return;
+            }
+
+            PDFDictionary sanitizedPageDictionary = *pageDictionary;
+            bool isModified = false;
+
+            if (removePageThumbnails && sanitizedPageDictionary.hasKey("Thumb"))
+            {
+                sanitizedPageDictionary.removeEntry("Thumb");
+                ++thumbnailCounter;
+                isModified = true;
+            }
+
+            if (removeFileAttachments || removeMarkupAnnotations)
+            {
+                PDFDocumentDataLoaderDecorator loader(&m_storage);
+                std::vector<PDFObjectReference> annotationReferences = loader.readReferenceArrayFromDictionary(pageDictionary, "Annots");
+                std::vector<PDFObjectReference> keptAnnotations;
+                keptAnnotations.reserve(annotationReferences.size());
+
+                for (const PDFObjectReference& annotationReference : annotationReferences)
+                {
+                    PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_storage, annotationReference);
+
+                    // File attachment is also a markup annotation, it is counted as file attachment
+                    if (annotation && removeFileAttachments && annotation->getType() == AnnotationType::FileAttachment)
+                    {
+                        sanitizedPages[index].removedAnnotations.push_back(annotationReference);
+                        ++fileAttachmentCounter;
+                    }
+                    else if (annotation && removeMarkupAnnotations && annotation->asMarkupAnnotation())
+                    {
+                        sanitizedPages[index].removedAnnotations.push_back(annotationReference);
+                        ++markupAnnotationCounter;
+                    }
+                    else
+                    {
+                        keptAnnotations.push_back(annotationReference);
+                    }
+                }
+
+                if (!sanitizedPages[index].removedAnnotations.empty())
+                {
+                    sanitizedPageDictionary.removeEntry("Annots");
+
+                    if (!keptAnnotations.empty())
+                    {
+                        PDFArray annotationArray;
+                        for (const PDFObjectReference& annotationReference : keptAnnotations)
+                        {
+                            annotationArray.appendItem(PDFObject::createReference(annotationReference));
+                        }
+                        sanitizedPageDictionary.addEntry(PDFInplaceOrMemoryString("Annots"), PDFObject::createArray(std::make_shared<PDFArray>(qMove(annotationArray))));
+                    }
+
+                    isModified = true;
+                }
+            }
+
+            if (isModified)
+            {
+                sanitizedPages[index].pageObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(sanitizedPageDictionary)));
+            }
+        };
+
+        PDFIntegerRange<size_t> pageRange(0, pageReferences.size());
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), sanitizePage);
+
+        for (size_t i = 0; i < pageReferences.size(); ++i)
+        {
+            for (const PDFObjectReference& annotationReference : sanitizedPages[i].removedAnnotations)
+            {
+                replacedObjects[annotationReference.objectNumber] = PDFObject();
+            }
+        }
+
+        for (size_t i = 0; i < pageReferences.size(); ++i)
+        {
+            if (!sanitizedPages[i].pageObject.isNull())
+            {
+                replacedObjects[pageReferences[i].objectNumber] = qMove(sanitizedPages[i].pageObject);
+            }
         }
     }
 
-    if (!pagesWithThumbnail.empty())
+    // 2) Single parallel sweep over all objects. Replaced objects are written,
+    //    metadata are removed and references of the objects are collected.
+    std::atomic<PDFInteger> metadataCounter = 0;
+    PDFObjectStorage::PDFObjects objects = m_storage.getObjects();
+    std::vector<std::vector<PDFObjectReference>> objectReferences(objects.size());
+
+    auto processEntry = [&](size_t index)
     {
-        for (const auto& pageReference : pagesWithThumbnail)
+        PDFObjectStorage::Entry& entry = objects[index];
+
+        auto it = replacedObjects.find(PDFInteger(index));
+        if (it != replacedObjects.cend())
         {
-            builder.removePageThumbnail(pageReference);
+            entry.object = it->second;
         }
 
-        PDFDocument document = builder.build();
-        m_storage = document.getStorage();
-        Q_EMIT sanitizationProgress(tr("Page thumbnails removed: %1.").arg(pagesWithThumbnail.size()));
-    }
-}
+        if (removeMetadata)
+        {
+            PDFRemoveMetadataVisitor visitor(&m_storage, &metadataCounter);
+            entry.object.accept(&visitor);
+            entry.object = visitor.getObject();
+        }
 
-void PDFDocumentSanitizer::removeAnnotations(const std::function<bool (const PDFAnnotation*)>& filter,
-                                             QString message)
-{
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    builder.flattenPageTree();
-    std::vector<PDFObjectReference> pageReferences = builder.getPages();
-    std::vector<std::pair<PDFObjectReference, PDFObjectReference>> annotationsToBeRemoved;
+        std::set<PDFObjectReference> references = PDFObjectUtils::getDirectReferences(entry.object);
+        objectReferences[index].assign(references.cbegin(), references.cend());
+    };
+
+    PDFIntegerRange<size_t> objectRange(0, objects.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectRange.begin(), objectRange.end(), processEntry);
 
-    PDFDocumentDataLoaderDecorator loader(&m_storage);
-    for (const PDFObjectReference pageReference : pageReferences)
+    // 3) Remove unused objects, which are not reachable from the trailer dictionary,
+    //    using references collected in the sweep.
+    std::vector<bool> isObjectUsed(objects.size(), false);
+    std::set<PDFObjectReference> trailerReferences = PDFObjectUtils::getDirectReferences(m_storage.getTrailerDictionary());
+    std::vector<PDFObjectReference> workList(trailerReferences.cbegin(), trailerReferences.cend());
+
+    while (!workList.empty())
     {
-        const PDFObject& pageObject = m_storage.getObjectByReference(pageReference);
-        const PDFDictionary* pageDictionary = m_storage.getDictionaryFromObject(pageObject);
+        const PDFObjectReference reference = workList.back();
+        workList.pop_back();
 
-        if (!pageDictionary)
+        const size_t objectNumber = size_t(reference.objectNumber);
+        if (reference.objectNumber < 0 || objectNumber >= objects.size() || isObjectUsed[objectNumber] || objects[objectNumber].generation != reference.generation)
         {
             continue;
         }
 
-        std::vector<PDFObjectReference> annotationReferences = loader.readReferenceArrayFromDictionary(pageDictionary, "Annots");
-        for (const PDFObjectReference& annotationReference : annotationReferences)
-        {
-            PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_storage, annotationReference);
-            if (filter(annotation.get()))
-            {
-                annotationsToBeRemoved.emplace_back(pageReference, annotationReference);
-            }
-        }
+        isObjectUsed[objectNumber] = true;
+        workList.insert(workList.end(), objectReferences[objectNumber].cbegin(), objectReferences[objectNumber].cend());
     }
 
-    if (!annotationsToBeRemoved.empty())
+    PDFInteger unusedObjectCounter = 0;
+    for (size_t i = 0; i < objects.size(); ++i)
     {
-        for (const auto& item : annotationsToBeRemoved)
+        if (!isObjectUsed[i] && !objects[i].object.isNull())
         {
-            const PDFObjectReference pageReference = item.first;
-            const PDFObjectReference annotationReference = item.second;
-            builder.removeAnnotation(pageReference, annotationReference);
+            objects[i].object = PDFObject();
+            ++unusedObjectCounter;
         }
+    }
 
-        PDFDocument document = builder.build();
-        m_storage = document.getStorage();
-        Q_EMIT sanitizationProgress(message.arg(annotationsToBeRemoved.size()));
+    m_storage.setObjects(qMove(objects));
+
+    if (removeMetadata)
+    {
+        Q_EMIT sanitizationProgress(tr("Metadata streams removed: %1").arg(metadataCounter));
+    }
+
+    if (fileAttachmentCounter > 0)
+    {
+        Q_EMIT sanitizationProgress(tr("File attachments removed: %1.").arg(fileAttachmentCounter));
+    }
+
+    if (markupAnnotationCounter > 0)
+    {
+        Q_EMIT sanitizationProgress(tr("Markup annotations removed: %1.").arg(markupAnnotationCounter));
+    }
+
+    if (thumbnailCounter > 0)
+    {
+        Q_EMIT sanitizationProgress(tr("Page thumbnails removed: %1.").arg(thumbnailCounter));
     }
+
+    Q_EMIT sanitizationProgress(tr("Unused objects removed: %1").arg(unusedObjectCounter));
 }
 
 }   // namespace pdf
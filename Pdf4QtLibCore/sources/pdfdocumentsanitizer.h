@@ -22,7 +22,7 @@
 
 namespace pdf
 {
-class PDFAnnotation;
+class PDFDocumentBuilder;
 
 /// Class for sanitizing documents. Can remove sensitive content from the document,
 /// except the content streams. Sanitization is configurable, user can specify,
@@ -80,15 +80,15 @@ signals:
     void sanitizationFinished();
 
 private:
-    void performSanitizeDocumentInfo();
-    void performSanitizeMetadata();
-    void performSanitizeOutline();
-    void performSanitizeFileAttachments();
-    void performSanitizeEmbeddedSearchIndex();
-    void performSanitizeMarkupAnnotations();
-    void performSanitizePageThumbnails();
-
-    void removeAnnotations(const std::function<bool(const PDFAnnotation*)>& filter, QString message);
+    void performSanitizeDocumentInfo(PDFDocumentBuilder* builder);
+    void performSanitizeOutline(PDFDocumentBuilder* builder);
+    void performSanitizeEmbeddedFiles(PDFDocumentBuilder* builder);
+    void performSanitizeEmbeddedSearchIndex(PDFDocumentBuilder* builder);
+
+    /// Performs page passes (file attachments, markup annotations, page thumbnails),
+    /// metadata removal and unused objects removal in single parallel sweep
+    /// over all objects. Pages are sanitized in parallel before the sweep.
+    void performSanitizeObjects();
 
     SanitizationFlags m_flags;
     PDFObjectStorage m_storage;
@@ -23,62 +23,17 @@
 #include "pdfcms.h"
 #include "pdftextlayoutgenerator.h"
 #include "pdfpagecontentprocessor.h"
-#include "pdfdbgheap.h"
+#include "pdfoperationcontrol.h"
+#include "pdfprogress.h"
 
-namespace pdf
-{
+#include <QMutex>
 
-class PDFStructureTreeReferenceCollector : public PDFStructureTreeAbstractVisitor
-{
-public:
-    explicit inline PDFStructureTreeReferenceCollector(std::map<PDFObjectReference, const PDFStructureItem*>* mapping) :
-        m_mapping(mapping)
-    {
-
-    }
-
-    virtual void visitStructureTree(const PDFStructureTree* structureTree) override;
-    virtual void visitStructureElement(const PDFStructureElement* structureElement) override;
-    virtual void visitStructureMarkedContentReference(const PDFStructureMarkedContentReference* structureMarkedContentReference) override;
-    virtual void visitStructureObjectReference(const PDFStructureObjectReference* structureObjectReference) override;
-
-private:
-    void addReference(const PDFStructureItem* structureObjectReference);
-
-    std::map<PDFObjectReference, const PDFStructureItem*>* m_mapping;
-};
-
-void PDFStructureTreeReferenceCollector::visitStructureTree(const PDFStructureTree* structureTree)
-{
-    addReference(structureTree);
-    acceptChildren(structureTree);
-}
+#include <optional>
 
-void PDFStructureTreeReferenceCollector::visitStructureElement(const PDFStructureElement* structureElement)
-{
-    addReference(structureElement);
-    acceptChildren(structureElement);
-}
-
-void PDFStructureTreeReferenceCollector::visitStructureMarkedContentReference(const PDFStructureMarkedContentReference* structureMarkedContentReference)
-{
-    addReference(structureMarkedContentReference);
-    acceptChildren(structureMarkedContentReference);
-}
-
-void PDFStructureTreeReferenceCollector::visitStructureObjectReference(const PDFStructureObjectReference* structureObjectReference)
-{
-    addReference(structureObjectReference);
-    acceptChildren(structureObjectReference);
-}
+#include "pdfdbgheap.h"
 
-void PDFStructureTreeReferenceCollector::addReference(const PDFStructureItem* structureItem)
+namespace pdf
 {
-    if (structureItem->getSelfReference().isValid())
-    {
-        (*m_mapping)[structureItem->getSelfReference()] = structureItem;
-    }
-}
 
 struct PDFStructureTreeTextItem
 {
@@ -90,18 +45,18 @@ struct PDFStructureTreeTextItem
     };
 
     PDFStructureTreeTextItem() = default;
-    PDFStructureTreeTextItem(Type type, const PDFStructureItem* item, QString text, PDFInteger pageIndex, QRectF boundingRect, std::vector<QRectF> characterBoundingRects) :
-        type(type), item(item), text(qMove(text)), pageIndex(pageIndex), boundingRect(boundingRect), characterBoundingRects(std::move(characterBoundingRects))
+    PDFStructureTreeTextItem(Type type, PDFObjectReference reference, QString text, PDFInteger pageIndex, QRectF boundingRect, std::vector<QRectF> characterBoundingRects) :
+        type(type), reference(reference), text(qMove(text)), pageIndex(pageIndex), boundingRect(boundingRect), characterBoundingRects(std::move(characterBoundingRects))
     {
 
     }
 
-    static PDFStructureTreeTextItem createText(QString text, PDFInteger pageIndex, QRectF boundingRect, std::vector<QRectF> characterBoundingRects) { return PDFStructureTreeTextItem(Type::Text, nullptr, qMove(text), pageIndex, boundingRect, std::move(characterBoundingRects)); }
-    static PDFStructureTreeTextItem createStartTag(const PDFStructureItem* item) { return PDFStructureTreeTextItem(Type::StartTag, item, QString(), -1, QRectF(), { }); }
-    static PDFStructureTreeTextItem createEndTag(const PDFStructureItem* item) { return PDFStructureTreeTextItem(Type::EndTag, item, QString(), -1, QRectF(), { }); }
+    static PDFStructureTreeTextItem createText(QString text, PDFInteger pageIndex, QRectF boundingRect, std::vector<QRectF> characterBoundingRects) { return PDFStructureTreeTextItem(Type::Text, PDFObjectReference(), qMove(text), pageIndex, boundingRect, std::move(characterBoundingRects)); }
+    static PDFStructureTreeTextItem createStartTag(PDFObjectReference reference) { return PDFStructureTreeTextItem(Type::StartTag, reference, QString(), -1, QRectF(), { }); }
+    static PDFStructureTreeTextItem createEndTag(PDFObjectReference reference) { return PDFStructureTreeTextItem(Type::EndTag, reference, QString(), -1, QRectF(), { }); }
 
     Type type = Type::Text;
-    const PDFStructureItem* item = nullptr;
+    PDFObjectReference reference; ///< Reference to the structure tree item (for tags)
     QString text;
     PDFInteger pageIndex = -1;
     QRectF boundingRect;
@@ -156,9 +111,11 @@ public:
 
     /// Returns text for given structure tree item. If structure tree item
     /// is not found, then empty list is returned. This functionality
-    /// requires, that \p CreateTreeMapping flag is being set.
-    /// \param item Item
-    const TextItems& getText(const PDFStructureItem* item) const;
+    /// requires, that \p CreateTreeMapping flag is being set. Text is mapped
+    /// using references of structure tree items, so structure tree can
+    /// be loaded on demand.
+    /// \param reference Reference of the structure tree item
+    const TextItems& getText(PDFObjectReference reference) const;
 
 private:
     QList<PDFRenderError> m_errors;
@@ -166,7 +123,7 @@ private:
     const PDFStructureTree* m_tree;
     QStringList m_unmatchedText;
     std::map<PDFInteger, PDFStructureTreeTextSequence> m_textSequences;
-    std::map<const PDFStructureItem*, TextItems> m_textForItems;
+    std::map<PDFObjectReference, TextItems> m_textForItems;
     Options m_options;
 };
 
@@ -186,16 +143,15 @@ public:
                                                   QTransform pagePointToDevicePointMatrix,
                                                   const PDFMeshQualitySettings& meshQualitySettings,
                                                   const PDFStructureTree* tree,
-                                                  const std::map<PDFObjectReference, const PDFStructureItem*>* mapping,
                                                   PDFStructureTreeTextExtractor::Options extractorOptions) :
         BaseClass(page, document, fontCache, cms, optionalContentActivity, pagePointToDevicePointMatrix, meshQualitySettings),
         m_features(features),
         m_tree(tree),
-        m_mapping(mapping),
         m_extractorOptions(extractorOptions),
         m_pageIndex(document->getCatalog()->getPageIndexFromPageReference(page->getPageReference()))
     {
-
+        // Only characters are used to create text sequence
+        setTextOnlyProcessing(true);
     }
 
     PDFStructureTreeTextSequence& takeSequence() { return m_textSequence; }
@@ -209,7 +165,7 @@ protected:
     virtual void performMarkedContentEnd() override;
 
 private:
-    const PDFStructureItem* getStructureTreeItemFromMCID(PDFInteger mcid) const;
+    PDFObjectReference getStructureTreeItemFromMCID(PDFInteger mcid) const;
     void finishText();
 
     bool isArtifact() const;
@@ -219,14 +175,13 @@ private:
     {
         QByteArray tag;
         PDFInteger mcid = -1;
-        const PDFStructureItem* structureTreeItem = nullptr;
+        PDFObjectReference structureTreeItem;
         bool isArtifact = false;
         bool isReversedText = false;
     };
 
     PDFRenderer::Features m_features;
     const PDFStructureTree* m_tree;
-    const std::map<PDFObjectReference, const PDFStructureItem*>* m_mapping;
     std::vector<MarkedContentInfo> m_markedContentInfoStack;
     QString m_currentText;
     QRectF m_currentBoundingBox;
@@ -305,12 +260,12 @@ void PDFStructureTreeTextContentProcessor::performMarkedContentBegin(const QByte
             info.isArtifact = tag == "Artifact";
             info.isReversedText = tag == "ReversedChars";
 
-            if (!info.structureTreeItem)
+            if (!info.structureTreeItem.isValid())
             {
                 reportRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Structure tree item for MCID %1 not found.").arg(info.mcid));
             }
 
-            if (info.structureTreeItem)
+            if (info.structureTreeItem.isValid())
             {
                 m_textSequence.emplace_back(PDFStructureTreeTextItem::createStartTag(info.structureTreeItem));
             }
@@ -328,7 +283,7 @@ void PDFStructureTreeTextContentProcessor::performMarkedContentEnd()
     if (info.mcid != -1)
     {
         finishText();
-        if (info.structureTreeItem)
+        if (info.structureTreeItem.isValid())
         {
             m_textSequence.emplace_back(PDFStructureTreeTextItem::createEndTag(info.structureTreeItem));
         }
@@ -347,14 +302,9 @@ void PDFStructureTreeTextContentProcessor::performMarkedContentEnd()
     }
 }
 
-const PDFStructureItem* PDFStructureTreeTextContentProcessor::getStructureTreeItemFromMCID(PDFInteger mcid) const
+PDFObjectReference PDFStructureTreeTextContentProcessor::getStructureTreeItemFromMCID(PDFInteger mcid) const
 {
-    auto it = m_mapping->find(m_tree->getParent(getStructuralParentKey(), mcid));
-    if (it != m_mapping->cend())
-    {
-        return it->second;
-    }
-    return nullptr;
+    return m_tree->getParent(getStructuralParentKey(), mcid);
 }
 
 bool PDFStructureTreeTextContentProcessor::isContentSuppressedByOC(PDFObjectReference ocgOrOcmd)
@@ -380,6 +330,9 @@ bool PDFStructureTreeTextContentProcessor::isContentKindSuppressed(ContentKind k
         case ContentKind::Tiling:
             return false; // Tiling can have text
 
+        case ContentKind::Forms:
+            return false; // Forms can have text
+
         default:
         {
             Q_ASSERT(false);
@@ -423,10 +376,6 @@ PDFStructureTreeTextExtractor::PDFStructureTreeTextExtractor(const PDFDocument*
 
 void PDFStructureTreeTextExtractor::perform(const std::vector<PDFInteger>& pageIndices)
 {
-    std::map<PDFObjectReference, const PDFStructureItem*> mapping;
-    PDFStructureTreeReferenceCollector referenceCollector(&mapping);
-    m_tree->accept(&referenceCollector);
-
     PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
 
     QMutex mutex;
@@ -449,7 +398,7 @@ void PDFStructureTreeTextExtractor::perform(const std::vector<PDFInteger>& pageI
         const PDFPage* page = catalog->getPage(pageIndex);
         Q_ASSERT(page);
 
-        PDFStructureTreeTextContentProcessor processor(PDFRenderer::IgnoreOptionalContent, page, m_document, &fontCache, &cms, &oca, QTransform(), mqs, m_tree, &mapping, m_options);
+        PDFStructureTreeTextContentProcessor processor(PDFRenderer::IgnoreOptionalContent, page, m_document, &fontCache, &cms, &oca, QTransform(), mqs, m_tree, m_options);
         QList<PDFRenderError> errors = processor.processContents();
 
         QMutexLocker lock(&mutex);
@@ -466,14 +415,14 @@ void PDFStructureTreeTextExtractor::perform(const std::vector<PDFInteger>& pageI
     {
         for (const auto& sequence : m_textSequences)
         {
-            std::stack<const PDFStructureItem*> stack;
+            std::stack<PDFObjectReference> stack;
             for (const PDFStructureTreeTextItem& sequenceItem : sequence.second)
             {
                 switch (sequenceItem.type)
                 {
                     case PDFStructureTreeTextItem::Type::StartTag:
                     {
-                        stack.push(sequenceItem.item);
+                        stack.push(sequenceItem.reference);
                         break;
                     }
                     case PDFStructureTreeTextItem::Type::EndTag:
@@ -510,9 +459,9 @@ const PDFStructureTreeTextSequence& PDFStructureTreeTextExtractor::getTextSequen
     return dummy;
 }
 
-const PDFStructureTreeTextExtractor::TextItems& PDFStructureTreeTextExtractor::getText(const PDFStructureItem* item) const
+const PDFStructureTreeTextExtractor::TextItems& PDFStructureTreeTextExtractor::getText(PDFObjectReference reference) const
 {
-    auto it = m_textForItems.find(item);
+    auto it = m_textForItems.find(reference);
     if (it != m_textForItems.cend())
     {
         return it->second;
@@ -523,12 +472,19 @@ const PDFStructureTreeTextExtractor::TextItems& PDFStructureTreeTextExtractor::g
 }
 
 
+/// Collects text flow from the structure tree. Subtrees of the structure tree
+/// are released after they are visited, so if structure tree is loaded on demand,
+/// only the currently visited path is held in the memory. Collected items are
+/// passed to the flush callback as soon as they can't be removed anymore.
 class PDFStructureTreeTextFlowCollector : public PDFStructureTreeAbstractVisitor
 {
 public:
-    explicit PDFStructureTreeTextFlowCollector(PDFDocumentTextFlow::Items* items, const PDFStructureTreeTextExtractor* extractor) :
+    using FlushCallback = std::function<void(PDFDocumentTextFlow::Items&&)>;
+
+    explicit PDFStructureTreeTextFlowCollector(PDFDocumentTextFlow::Items* items, const PDFStructureTreeTextExtractor* extractor, FlushCallback flushCallback) :
         m_items(items),
-        m_extractor(extractor)
+        m_extractor(extractor),
+        m_flushCallback(qMove(flushCallback))
     {
 
     }
@@ -538,11 +494,22 @@ public:
     virtual void visitStructureMarkedContentReference(const PDFStructureMarkedContentReference* structureMarkedContentReference) override;
     virtual void visitStructureObjectReference(const PDFStructureObjectReference* structureObjectReference) override;
 
+    /// Passes all collected items to the flush callback
+    void flush();
+
 private:
+    /// Minimal number of collected items, which are passed to the flush callback
+    static constexpr size_t FLUSH_ITEM_COUNT = 4096;
+
     void markHasContent();
 
+    /// Passes collected items to the flush callback, if there is enough of them,
+    /// and no item can be removed (all opened structure elements have content).
+    void flushIfPossible();
+
     PDFDocumentTextFlow::Items* m_items;
     const PDFStructureTreeTextExtractor* m_extractor;
+    FlushCallback m_flushCallback;
     std::vector<bool> m_hasContentStack;
 };
 
@@ -553,6 +520,23 @@ void PDFStructureTreeTextFlowCollector::visitStructureTree(const PDFStructureTre
     m_items->push_back(PDFDocumentTextFlow::Item{ QRectF(), -1, QString(), PDFDocumentTextFlow::StructureItemEnd, {} });
 }
 
+void PDFStructureTreeTextFlowCollector::flush()
+{
+    if (!m_items->empty())
+    {
+        m_flushCallback(qMove(*m_items));
+        m_items->clear();
+    }
+}
+
+void PDFStructureTreeTextFlowCollector::flushIfPossible()
+{
+    if (m_items->size() >= FLUSH_ITEM_COUNT && std::all_of(m_hasContentStack.cbegin(), m_hasContentStack.cend(), [](bool hasContent) { return hasContent; }))
+    {
+        flush();
+    }
+}
+
 void PDFStructureTreeTextFlowCollector::markHasContent()
 {
     for (size_t i = 0; i < m_hasContentStack.size(); ++i)
@@ -612,13 +596,14 @@ void PDFStructureTreeTextFlowCollector::visitStructureElement(const PDFStructure
         m_items->push_back(PDFDocumentTextFlow::Item{ QRectF(), -1, phoneme, PDFDocumentTextFlow::StructurePhoneme, {} });
     }
 
-    for (const auto& textItem : m_extractor->getText(structureElement))
+    for (const auto& textItem : m_extractor->getText(structureElement->getSelfReference()))
     {
         markHasContent();
         m_items->push_back(PDFDocumentTextFlow::Item{ textItem.boundingRect, textItem.pageIndex, textItem.text, PDFDocumentTextFlow::Text, textItem.characterBoundingRects });
     }
 
     acceptChildren(structureElement);
+    structureElement->releaseChildren();
 
     const bool hasContent = m_hasContentStack.back();
     m_hasContentStack.pop_back();
@@ -630,6 +615,8 @@ void PDFStructureTreeTextFlowCollector::visitStructureElement(const PDFStructure
         // Delete unused content
         m_items->erase(std::next(m_items->begin(), index), m_items->end());
     }
+
+    flushIfPossible();
 }
 
 void PDFStructureTreeTextFlowCollector::visitStructureMarkedContentReference(const PDFStructureMarkedContentReference* structureMarkedContentReference)
@@ -645,13 +632,27 @@ void PDFStructureTreeTextFlowCollector::visitStructureObjectReference(const PDFS
 PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* document, const std::vector<PDFInteger>& pageIndices, Algorithm algorithm)
 {
     PDFDocumentTextFlow result;
-    PDFStructureTree structureTree;
 
-    const PDFCatalog* catalog = document->getCatalog();
-    if (algorithm != Algorithm::Layout)
+    auto appendTextFlow = [&result](PDFInteger, PDFDocumentTextFlow&& textFlow)
     {
-        structureTree = PDFStructureTree::parse(&document->getStorage(), catalog->getStructureTreeRoot());
-    }
+        result.append(qMove(textFlow));
+    };
+
+    createPageByPage(document, pageIndices, algorithm, 0, appendTextFlow);
+    return result;
+}
+
+void PDFDocumentTextFlowFactory::createPageByPage(const PDFDocument* document,
+                                                  const std::vector<PDFInteger>& pageIndices,
+                                                  Algorithm algorithm,
+                                                  size_t maxPagesInFlight,
+                                                  const PageTextFlowCallback& callback)
+{
+    // Structure tree is loaded on demand, so whole structure tree
+    // of large tagged documents is never held in the memory.
+    const PDFCatalog* catalog = document->getCatalog();
+    PDFStructureTree structureTree = (algorithm != Algorithm::Layout) ? PDFStructureTree::parse(&document->getStorage(), catalog->getStructureTreeRoot(), PDFStructureTree::LoadMode::OnDemand)
+                                                                      : PDFStructureTree();
 
     if (algorithm == Algorithm::Auto)
     {
@@ -668,6 +669,9 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
 
     Q_ASSERT(algorithm != Algorithm::Auto);
 
+    // Pages are processed in batches, so only pages of one batch are held in the memory
+    const size_t batchSize = maxPagesInFlight > 0 ? maxPagesInFlight : qMax(pageIndices.size(), size_t(1));
+
     // Perform algorithm to retrieve document text
     switch (algorithm)
     {
@@ -675,8 +679,6 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
         {
             PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
 
-            std::map<PDFInteger, PDFDocumentTextFlow::Items> items;
-
             QMutex mutex;
             PDFCMSGeneric cms;
             PDFMeshQualitySettings mqs;
@@ -685,46 +687,62 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
             fontCache.setDocument(md);
             fontCache.setCacheShrinkEnabled(nullptr, false);
 
-            auto generateTextLayout = [this, &items, &mutex, &fontCache, &cms, &mqs, &oca, document, catalog](PDFInteger pageIndex)
+            for (size_t batchStart = 0; batchStart < pageIndices.size(); batchStart += batchSize)
             {
-                if (!catalog->getPage(pageIndex))
-                {
-                    // Invalid page index
-                    return;
-                }
+                const size_t batchEnd = qMin(batchStart + batchSize, pageIndices.size());
 
-                const PDFPage* page = catalog->getPage(pageIndex);
-                Q_ASSERT(page);
+                // Text flows of the batch, they are passed to the callback in the order
+                // of pages, by the thread, which finishes the first unfinished page.
+                std::vector<std::optional<PDFDocumentTextFlow>> textFlows(batchEnd - batchStart);
+                std::vector<bool> isFinished(batchEnd - batchStart, false);
+                size_t nextTextFlow = 0;
 
-                PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, document, &fontCache, &cms, &oca, QTransform(), mqs);
-                QList<PDFRenderError> errors = generator.processContents();
-                PDFTextLayout textLayout = generator.createTextLayout();
-                PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, PDFTextFlow::FlowFlags(PDFTextFlow::SeparateBlocks) | PDFTextFlow::RemoveSoftHyphen, pageIndex);
-
-                PDFDocumentTextFlow::Items flowItems;
-                flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, PDFTranslationContext::tr("Page %1").arg(pageIndex + 1), PDFDocumentTextFlow::PageStart, {} });
-                for (const PDFTextFlow& textFlow : textFlows)
+                auto generateTextLayout = [&, this, document, catalog](size_t index)
                 {
-                    flowItems.emplace_back(PDFDocumentTextFlow::Item{ textFlow.getBoundingBox(), pageIndex, textFlow.getText(), PDFDocumentTextFlow::Text, textFlow.getBoundingBoxes() });
-                }
-                flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, QString(), PDFDocumentTextFlow::PageEnd, {} });
+                    const PDFInteger pageIndex = pageIndices[batchStart + index];
+                    const PDFPage* page = catalog->getPage(pageIndex);
 
-                QMutexLocker lock(&mutex);
-                items[pageIndex] = qMove(flowItems);
-                m_errors.append(qMove(errors));
-            };
+                    std::optional<PDFDocumentTextFlow> pageTextFlow;
+                    QList<PDFRenderError> errors;
 
-            PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageIndices.begin(), pageIndices.end(), generateTextLayout);
+                    // Invalid page indices are skipped
+                    if (page)
+                    {
+                        PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, document, &fontCache, &cms, &oca, QTransform(), mqs);
+                        errors = generator.processContents();
+                        PDFTextLayout textLayout = generator.createTextLayout();
+                        PDFTextFlows pageTextFlows = PDFTextFlow::createTextFlows(textLayout, PDFTextFlow::FlowFlags(PDFTextFlow::SeparateBlocks) | PDFTextFlow::RemoveSoftHyphen, pageIndex);
+
+                        PDFDocumentTextFlow::Items flowItems;
+                        flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, PDFTranslationContext::tr("Page %1").arg(pageIndex + 1), PDFDocumentTextFlow::PageStart, {} });
+                        for (const PDFTextFlow& textFlow : pageTextFlows)
+                        {
+                            flowItems.emplace_back(PDFDocumentTextFlow::Item{ textFlow.getBoundingBox(), pageIndex, textFlow.getText(), PDFDocumentTextFlow::Text, textFlow.getBoundingBoxes() });
+                        }
+                        flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, QString(), PDFDocumentTextFlow::PageEnd, {} });
+                        pageTextFlow = PDFDocumentTextFlow(qMove(flowItems));
+                    }
 
-            fontCache.setCacheShrinkEnabled(nullptr, true);
+                    QMutexLocker lock(&mutex);
+                    textFlows[index] = qMove(pageTextFlow);
+                    isFinished[index] = true;
+                    m_errors.append(qMove(errors));
 
-            PDFDocumentTextFlow::Items flowItems;
-            for (const auto& item : items)
-            {
-                flowItems.insert(flowItems.end(), std::make_move_iterator(item.second.begin()), std::make_move_iterator(item.second.end()));
+                    for (; nextTextFlow < textFlows.size() && isFinished[nextTextFlow]; ++nextTextFlow)
+                    {
+                        if (textFlows[nextTextFlow])
+                        {
+                            callback(pageIndices[batchStart + nextTextFlow], qMove(*textFlows[nextTextFlow]));
+                            textFlows[nextTextFlow].reset();
+                        }
+                    }
+                };
+
+                PDFIntegerRange<size_t> range(0, batchEnd - batchStart);
+                PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), generateTextLayout);
             }
 
-            result = PDFDocumentTextFlow(qMove(flowItems));
+            fontCache.setCacheShrinkEnabled(nullptr, true);
             break;
         }
 
@@ -741,12 +759,13 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
             PDFStructureTreeTextExtractor extractor(document, &structureTree, options);
             extractor.perform(pageIndices);
 
+            m_errors.append(extractor.getErrors());
+
             PDFDocumentTextFlow::Items flowItems;
-            PDFStructureTreeTextFlowCollector collector(&flowItems, &extractor);
+            auto flushCallback = [&callback](PDFDocumentTextFlow::Items&& items) { callback(-1, PDFDocumentTextFlow(qMove(items))); };
+            PDFStructureTreeTextFlowCollector collector(&flowItems, &extractor, flushCallback);
             structureTree.accept(&collector);
-
-            result = PDFDocumentTextFlow(qMove(flowItems));
-            m_errors.append(extractor.getErrors());
+            collector.flush();
             break;
         }
 
@@ -754,25 +773,32 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
         {
             PDFStructureTreeTextExtractor::Options options = PDFStructureTreeTextExtractor::None;
             options.setFlag(PDFStructureTreeTextExtractor::BoundingBoxes, m_calculateBoundingBoxes);
-            PDFStructureTreeTextExtractor extractor(document, &structureTree, options);
-            extractor.perform(pageIndices);
 
-            PDFDocumentTextFlow::Items flowItems;
-            for (PDFInteger pageIndex : pageIndices)
+            for (size_t batchStart = 0; batchStart < pageIndices.size(); batchStart += batchSize)
             {
-                flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, PDFTranslationContext::tr("Page %1").arg(pageIndex + 1), PDFDocumentTextFlow::PageStart, {} });
-                for (const PDFStructureTreeTextItem& sequenceItem : extractor.getTextSequence(pageIndex))
+                const size_t batchEnd = qMin(batchStart + batchSize, pageIndices.size());
+                std::vector<PDFInteger> batchPageIndices(std::next(pageIndices.cbegin(), batchStart), std::next(pageIndices.cbegin(), batchEnd));
+
+                PDFStructureTreeTextExtractor extractor(document, &structureTree, options);
+                extractor.perform(batchPageIndices);
+                m_errors.append(extractor.getErrors());
+
+                for (PDFInteger pageIndex : batchPageIndices)
                 {
-                    if (sequenceItem.type == PDFStructureTreeTextItem::Type::Text)
+                    PDFDocumentTextFlow::Items flowItems;
+                    flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, PDFTranslationContext::tr("Page %1").arg(pageIndex + 1), PDFDocumentTextFlow::PageStart, {} });
+                    for (const PDFStructureTreeTextItem& sequenceItem : extractor.getTextSequence(pageIndex))
                     {
-                        flowItems.emplace_back(PDFDocumentTextFlow::Item{ sequenceItem.boundingRect, pageIndex, sequenceItem.text, PDFDocumentTextFlow::Text, sequenceItem.characterBoundingRects });
+                        if (sequenceItem.type == PDFStructureTreeTextItem::Type::Text)
+                        {
+                            flowItems.emplace_back(PDFDocumentTextFlow::Item{ sequenceItem.boundingRect, pageIndex, sequenceItem.text, PDFDocumentTextFlow::Text, sequenceItem.characterBoundingRects });
+                        }
                     }
+                    flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, QString(), PDFDocumentTextFlow::PageEnd, {} });
+
+                    callback(pageIndex, PDFDocumentTextFlow(qMove(flowItems)));
                 }
-                flowItems.emplace_back(PDFDocumentTextFlow::Item{ QRectF(), pageIndex, QString(), PDFDocumentTextFlow::PageEnd, {} });
             }
-
-            result = PDFDocumentTextFlow(qMove(flowItems));
-            m_errors.append(extractor.getErrors());
             break;
         }
 
@@ -780,8 +806,6 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
             Q_ASSERT(false);
             break;
     }
-
-    return result;
 }
 
 PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* document, Algorithm algorithm)
@@ -881,33 +905,108 @@ void PDFDocumentTextFlowEditor::selectByRectangle(QRectF rectangle)
 
 void PDFDocumentTextFlowEditor::selectByContainedText(QString text)
 {
-    for (auto& item : m_editedTextFlow)
+    selectItems(findItems(createContainedTextPredicate(qMove(text)), nullptr, nullptr));
+}
+
+void PDFDocumentTextFlowEditor::selectByRegularExpression(const QRegularExpression& expression)
+{
+    selectItems(findItems(createRegularExpressionPredicate(expression), nullptr, nullptr));
+}
+
+void PDFDocumentTextFlowEditor::selectByPageIndices(const pdf::PDFClosedIntervalSet& indices)
+{
+    selectItems(findItems(createPageIndicesPredicate(indices), nullptr, nullptr));
+}
+
+void PDFDocumentTextFlowEditor::selectItems(const std::vector<size_t>& indices)
+{
+    deselect();
+
+    for (size_t index : indices)
     {
-        const bool isContained = item.text.contains(text, Qt::CaseSensitive);
-        item.editedItemFlags.setFlag(Selected, isContained);
+        select(index, true);
     }
 }
 
-void PDFDocumentTextFlowEditor::selectByRegularExpression(const QRegularExpression& expression)
+std::vector<size_t> PDFDocumentTextFlowEditor::findItems(const ItemPredicate& predicate,
+                                                         const PDFOperationControl* operationControl,
+                                                         PDFProgress* progress) const
 {
-    for (auto& item : m_editedTextFlow)
+    const size_t itemCount = m_editedTextFlow.size();
+    const size_t blockCount = (itemCount + FIND_ITEMS_BLOCK_SIZE - 1) / FIND_ITEMS_BLOCK_SIZE;
+
+    if (progress)
     {
-        QRegularExpressionMatch match = expression.match(item.text, 0, QRegularExpression::NormalMatch, QRegularExpression::NoMatchOption);
-        const bool hasMatch = match.hasMatch();
-        item.editedItemFlags.setFlag(Selected, hasMatch);
+        progress->start(blockCount, ProgressStartupInfo());
+    }
+
+    std::vector<size_t> indices;
+    QMutex mutex;
+
+    auto findInBlock = [&, this](size_t blockIndex)
+    {
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            // Search was cancelled, skip remaining blocks
+            return;
+        }
+
+        const size_t first = blockIndex * FIND_ITEMS_BLOCK_SIZE;
+        const size_t last = qMin(first + FIND_ITEMS_BLOCK_SIZE, itemCount);
+
+        std::vector<size_t> blockIndices;
+        for (size_t i = first; i < last; ++i)
+        {
+            if (predicate(m_editedTextFlow[i]))
+            {
+                blockIndices.push_back(i);
+            }
+        }
+
+        if (!blockIndices.empty())
+        {
+            QMutexLocker lock(&mutex);
+            indices.insert(indices.end(), blockIndices.cbegin(), blockIndices.cend());
+        }
+
+        if (progress)
+        {
+            progress->step();
+        }
+    };
+
+    PDFIntegerRange<size_t> blocks(0, blockCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, blocks.begin(), blocks.end(), findInBlock);
+    std::sort(indices.begin(), indices.end());
+
+    if (progress)
+    {
+        progress->finish();
     }
+
+    return indices;
 }
 
-void PDFDocumentTextFlowEditor::selectByPageIndices(const pdf::PDFClosedIntervalSet& indices)
+PDFDocumentTextFlowEditor::ItemPredicate PDFDocumentTextFlowEditor::createContainedTextPredicate(QString text)
+{
+    return [text](const EditedItem& item) { return item.text.contains(text, Qt::CaseSensitive); };
+}
+
+PDFDocumentTextFlowEditor::ItemPredicate PDFDocumentTextFlowEditor::createRegularExpressionPredicate(QRegularExpression expression)
+{
+    return [expression](const EditedItem& item)
+    {
+        QRegularExpressionMatch match = expression.match(item.text, 0, QRegularExpression::NormalMatch, QRegularExpression::NoMatchOption);
+        return match.hasMatch();
+    };
+}
+
+PDFDocumentTextFlowEditor::ItemPredicate PDFDocumentTextFlowEditor::createPageIndicesPredicate(const PDFClosedIntervalSet& indices)
 {
     std::vector<PDFInteger> pageIndices = indices.unfold();
     std::sort(pageIndices.begin(), pageIndices.end());
 
-    for (auto& item : m_editedTextFlow)
-    {
-        const bool isPageValid = std::binary_search(pageIndices.begin(), pageIndices.end(), item.pageIndex + 1);
-        item.editedItemFlags.setFlag(Selected, isPageValid);
-    }
+    return [pageIndices](const EditedItem& item) { return std::binary_search(pageIndices.begin(), pageIndices.end(), item.pageIndex + 1); };
 }
 
 void PDFDocumentTextFlowEditor::restoreOriginalTexts()
@@ -1077,6 +1176,11 @@ void PDFDocumentTextFlow::append(const PDFDocumentTextFlow& textFlow)
     m_items.insert(m_items.end(), textFlow.m_items.cbegin(), textFlow.m_items.cend());
 }
 
+void PDFDocumentTextFlow::append(PDFDocumentTextFlow&& textFlow)
+{
+    m_items.insert(m_items.end(), std::make_move_iterator(textFlow.m_items.begin()), std::make_move_iterator(textFlow.m_items.end()));
+}
+
 QString PDFDocumentTextFlow::getText() const
 {
     QStringList texts;
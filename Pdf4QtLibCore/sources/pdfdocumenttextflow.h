@@ -22,9 +22,13 @@
 #include "pdfexception.h"
 #include "pdfutils.h"
 
+#include <functional>
+
 namespace pdf
 {
 class PDFDocument;
+class PDFProgress;
+class PDFOperationControl;
 
 /// Text flow extracted from document. Text flow can be created \p PDFDocumentTextFlowFactory.
 /// Flow can contain various items, not just text ones. Also, some manipulation functions
@@ -96,6 +100,10 @@ public:
     /// \param textFlow Text flow
     void append(const PDFDocumentTextFlow& textFlow);
 
+    /// Appends document text flow to this one (items are moved)
+    /// \param textFlow Text flow
+    void append(PDFDocumentTextFlow&& textFlow);
+
     /// Returns text concantecated from all items
     QString getText() const;
 
@@ -132,6 +140,29 @@ public:
     /// \param algorithm Algorithm
     PDFDocumentTextFlow create(const PDFDocument* document, Algorithm algorithm);
 
+    /// Callback, which receives text flow of a page (page index is -1, if text
+    /// flow of multiple pages is passed at once).
+    using PageTextFlowCallback = std::function<void(PDFInteger, PDFDocumentTextFlow&&)>;
+
+    /// Performs document text flow analysis page by page, text flows of pages are
+    /// passed to the callback in the order of page indices, as soon as they are
+    /// available. Pages are processed in parallel, at most \p maxPagesInFlight pages
+    /// at once, so text flows of whole document are not held in the memory. Callback
+    /// can be called from different threads, but calls are never concurrent.
+    /// Structure algorithm can't be processed page by page (structure tree spans
+    /// whole document), so in this case callback is called with page index -1,
+    /// with text flows of consecutive parts of the structure tree.
+    /// \param document Document
+    /// \param pageIndices Analyzed page indices
+    /// \param algorithm Algorithm
+    /// \param maxPagesInFlight Maximal number of pages processed at once (zero means unlimited)
+    /// \param callback Callback receiving page text flows
+    void createPageByPage(const PDFDocument* document,
+                          const std::vector<PDFInteger>& pageIndices,
+                          Algorithm algorithm,
+                          size_t maxPagesInFlight,
+                          const PageTextFlowCallback& callback);
+
     /// Has some error/warning occured during text layout creation?
     bool hasError() const { return !m_errors.isEmpty(); }
 
@@ -192,6 +223,7 @@ public:
     };
 
     using EditedItems = std::vector<EditedItem>;
+    using ItemPredicate = std::function<bool(const EditedItem&)>;
     using PageIndicesMapping = std::vector<std::pair<PDFInteger, size_t>>;
     using PageIndicesMappingIterator = PageIndicesMapping::const_iterator;
     using PageIndicesMappingRange = std::pair<PageIndicesMappingIterator, PageIndicesMappingIterator>;
@@ -257,6 +289,34 @@ public:
     /// \param indices Indices
     void selectByPageIndices(const PDFClosedIntervalSet& indices);
 
+    /// Selects items with given indices, other items are deselected
+    /// \param indices Sorted indices of the items
+    void selectItems(const std::vector<size_t>& indices);
+
+    /// Finds indices of items, which satisfy the predicate. Items are processed
+    /// in parallel, so predicate must be thread safe. This function can be called
+    /// from another thread, but edited items must not be added, removed or their
+    /// texts modified during the search. If operation is cancelled, then search
+    /// is stopped, and result is incomplete.
+    /// \param predicate Predicate
+    /// \param operationControl Operation control (can be nullptr)
+    /// \param progress Progress (can be nullptr)
+    std::vector<size_t> findItems(const ItemPredicate& predicate,
+                                  const PDFOperationControl* operationControl,
+                                  PDFProgress* progress) const;
+
+    /// Creates predicate matching items containing the text
+    /// \param text Text
+    static ItemPredicate createContainedTextPredicate(QString text);
+
+    /// Creates predicate matching items matching regular expression
+    /// \param expression Regular expression
+    static ItemPredicate createRegularExpressionPredicate(QRegularExpression expression);
+
+    /// Creates predicate matching items on a given page indices
+    /// \param indices Page indices (one-based)
+    static ItemPredicate createPageIndicesPredicate(const PDFClosedIntervalSet& indices);
+
     /// Restores original texts in selected items
     void restoreOriginalTexts();
 
@@ -287,6 +347,9 @@ private:
     void createEditedFromOriginalTextFlow();
     void updateModifiedFlag(size_t index);
 
+    /// Number of items processed at once, when items are searched
+    static constexpr size_t FIND_ITEMS_BLOCK_SIZE = 4096;
+
     const PDFDocumentTextFlow::Item* getOriginalItem(size_t index) const { return m_originalTextFlow.getItem(index); }
     EditedItem* getEditedItem(size_t index) { return &m_editedTextFlow.at(index); }
 
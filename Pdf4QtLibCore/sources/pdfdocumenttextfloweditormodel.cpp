@@ -28,7 +28,8 @@ namespace pdf
 
 PDFDocumentTextFlowEditorModel::PDFDocumentTextFlowEditorModel(QObject* parent) :
     BaseClass(parent),
-    m_editor(nullptr)
+    m_editor(nullptr),
+    m_fetchedRowCount(0)
 {
 
 }
@@ -77,12 +78,7 @@ int PDFDocumentTextFlowEditorModel::rowCount(const QModelIndex& parent) const
         return 0;
     }
 
-    if (m_editor)
-    {
-        return int(m_editor->getItemCount());
-    }
-
-    return 0;
+    return qMin(m_fetchedRowCount, getItemCount());
 }
 
 int PDFDocumentTextFlowEditorModel::columnCount(const QModelIndex& parent) const
@@ -206,6 +202,53 @@ Qt::ItemFlags PDFDocumentTextFlowEditorModel::flags(const QModelIndex& index) co
     return flags;
 }
 
+bool PDFDocumentTextFlowEditorModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+    {
+        return false;
+    }
+
+    return m_fetchedRowCount < getItemCount();
+}
+
+void PDFDocumentTextFlowEditorModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid())
+    {
+        return;
+    }
+
+    fetchRow(m_fetchedRowCount + FETCH_ROW_COUNT - 1);
+}
+
+void PDFDocumentTextFlowEditorModel::fetchRow(int row)
+{
+    const int itemCount = getItemCount();
+    if (row < m_fetchedRowCount || m_fetchedRowCount >= itemCount)
+    {
+        return;
+    }
+
+    // Fetch whole pages of rows
+    const int pageCount = row / FETCH_ROW_COUNT + 1;
+    const int fetchedRowCount = qMin(pageCount * FETCH_ROW_COUNT, itemCount);
+
+    beginInsertRows(QModelIndex(), m_fetchedRowCount, fetchedRowCount - 1);
+    m_fetchedRowCount = fetchedRowCount;
+    endInsertRows();
+}
+
+int PDFDocumentTextFlowEditorModel::getItemCount() const
+{
+    return m_editor ? int(m_editor->getItemCount()) : 0;
+}
+
+void PDFDocumentTextFlowEditorModel::resetFetchedRowCount()
+{
+    m_fetchedRowCount = qMin(FETCH_ROW_COUNT, getItemCount());
+}
+
 PDFDocumentTextFlowEditor* PDFDocumentTextFlowEditorModel::getEditor() const
 {
     return m_editor;
@@ -217,6 +260,7 @@ void PDFDocumentTextFlowEditorModel::setEditor(PDFDocumentTextFlowEditor* editor
     {
         beginResetModel();
         m_editor = editor;
+        resetFetchedRowCount();
         endResetModel();
     }
 }
@@ -228,6 +272,7 @@ void PDFDocumentTextFlowEditorModel::beginFlowChange()
 
 void PDFDocumentTextFlowEditorModel::endFlowChange()
 {
+    resetFetchedRowCount();
     endResetModel();
 }
 
@@ -252,7 +297,7 @@ void PDFDocumentTextFlowEditorModel::setSelectionActivated(bool activate)
 
     m_editor->setSelectionActive(activate);
     m_editor->deselect();
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::selectByRectangle(QRectF rectangle)
@@ -263,7 +308,7 @@ void PDFDocumentTextFlowEditorModel::selectByRectangle(QRectF rectangle)
     }
 
     m_editor->selectByRectangle(rectangle);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::selectByContainedText(QString text)
@@ -274,7 +319,7 @@ void PDFDocumentTextFlowEditorModel::selectByContainedText(QString text)
     }
 
     m_editor->selectByContainedText(text);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::selectByRegularExpression(const QRegularExpression& expression)
@@ -285,7 +330,7 @@ void PDFDocumentTextFlowEditorModel::selectByRegularExpression(const QRegularExp
     }
 
     m_editor->selectByRegularExpression(expression);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::selectByPageIndices(const PDFClosedIntervalSet& indices)
@@ -296,7 +341,18 @@ void PDFDocumentTextFlowEditorModel::selectByPageIndices(const PDFClosedInterval
     }
 
     m_editor->selectByPageIndices(indices);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
+}
+
+void PDFDocumentTextFlowEditorModel::selectItems(const std::vector<size_t>& indices)
+{
+    if (!m_editor || m_editor->isEmpty())
+    {
+        return;
+    }
+
+    m_editor->selectItems(indices);
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::restoreOriginalTexts()
@@ -308,7 +364,7 @@ void PDFDocumentTextFlowEditorModel::restoreOriginalTexts()
 
     m_editor->restoreOriginalTexts();
     m_editor->deselect();
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::moveSelectionUp()
@@ -340,7 +396,18 @@ void PDFDocumentTextFlowEditorModel::notifyDataChanged()
         return;
     }
 
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyRowsChanged(0, rowCount(QModelIndex()) - 1);
+}
+
+void PDFDocumentTextFlowEditorModel::notifyRowsChanged(int firstRow, int lastRow)
+{
+    firstRow = qMax(firstRow, 0);
+    lastRow = qMin(lastRow, rowCount(QModelIndex()) - 1);
+
+    if (firstRow <= lastRow)
+    {
+        Q_EMIT dataChanged(index(firstRow, 0), index(lastRow, ColumnLast - 1));
+    }
 }
 
 }   // namespace pdf
@@ -27,6 +27,9 @@ namespace pdf
 {
 class PDFDocumentTextFlowEditor;
 
+/// Table model of the edited text flow. Rows are fetched incrementally
+/// in pages (as they are scrolled into the view), so views with very
+/// large text flows don't create all rows at once.
 class PDF4QTLIBCORESHARED_EXPORT PDFDocumentTextFlowEditorModel : public QAbstractTableModel
 {
     Q_OBJECT
@@ -55,6 +58,8 @@ public:
     virtual Qt::DropActions supportedDragActions() const override;
     virtual Qt::ItemFlags flags(const QModelIndex& index) const override;
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    virtual bool canFetchMore(const QModelIndex& parent) const override;
+    virtual void fetchMore(const QModelIndex& parent) override;
 
     PDFDocumentTextFlowEditor* getEditor() const;
     void setEditor(PDFDocumentTextFlowEditor* editor);
@@ -68,13 +73,34 @@ public:
     void selectByContainedText(QString text);
     void selectByRegularExpression(const QRegularExpression& expression);
     void selectByPageIndices(const pdf::PDFClosedIntervalSet& indices);
+    void selectItems(const std::vector<size_t>& indices);
     void restoreOriginalTexts();
     void moveSelectionUp();
     void moveSelectionDown();
     void notifyDataChanged();
 
+    /// Notifies views, that data of the rows in given range were changed
+    /// (range is clamped to the fetched rows).
+    /// \param firstRow First row
+    /// \param lastRow Last row
+    void notifyRowsChanged(int firstRow, int lastRow);
+
+    /// Fetches rows, so row of the item is present in the model
+    /// \param row Row (item index)
+    void fetchRow(int row);
+
 private:
+    /// Number of rows fetched at once
+    static constexpr int FETCH_ROW_COUNT = 1024;
+
+    /// Returns item count of the edited text flow
+    int getItemCount() const;
+
+    /// Resets count of the fetched rows to the first page
+    void resetFetchedRowCount();
+
     PDFDocumentTextFlowEditor* m_editor;
+    int m_fetchedRowCount;
 };
 
 }   // namespace pdf
@@ -19,11 +19,21 @@
 #include "pdfconstants.h"
 #include "pdfvisitor.h"
 #include "pdfparser.h"
+#include "pdfstreamfilters.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfobjectutils.h"
 
 #include <QFile>
+#include <QMutex>
 #include <QBuffer>
 #include <QSaveFile>
 
+#include <map>
+#include <set>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -244,7 +254,6 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
     const PDFObjectStorage& storage = document->getStorage();
     const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
     const size_t objectCount = objects.size();
-    const bool isEncrypted = storage.getSecurityHandler()->getMode() != EncryptionMode::None;
     if (!storage.getSecurityHandler()->isEncryptionAllowed())
     {
         return tr("Writing of encrypted documents is not supported.");
@@ -252,6 +261,12 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
 
     // Write header
     PDFVersion version = document->getInfo()->version;
+    if (m_objectStreamsEnabled && (version.major < 1 || (version.major == 1 && version.minor < 5)))
+    {
+        // Object streams and cross-reference streams are available since PDF 1.5
+        version = PDFVersion(1, 5);
+    }
+
     device->write(QString("%PDF-%1.%2").arg(version.major).arg(version.minor).toLatin1());
     writeCRLF(device);
     device->write("% PDF producer: ");
@@ -260,48 +275,42 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
     writeCRLF(device);
     writeCRLF(device);
 
-    PDFObjectReference encryptObjectReference;
-    PDFObject encryptObject = document->getTrailerDictionary()->get("Encrypt");
-    if (encryptObject.isReference())
+    const PDFObjectReference encryptObjectReference = getEncryptObjectReference(document);
+
+    if (m_linearizationEnabled)
     {
-        encryptObjectReference = encryptObject.getReference();
+        return writeLinearized(device, document, encryptObjectReference);
+    }
+
+    if (m_objectStreamsEnabled)
+    {
+        writeObjectStreams(device, document, encryptObjectReference);
+
+        // Write footer
+        device->write("%%EOF");
+
+        return true;
     }
 
     // Write objects
-    std::vector<PDFInteger> offsets(objectCount, -1);
+    std::vector<PDFObjectReference> references;
+    references.reserve(objectCount);
     for (size_t i = 0; i < objectCount; ++i)
     {
         const PDFObjectStorage::Entry& entry = objects[i];
-        if (entry.object.isNull())
+        if (!entry.object.isNull())
         {
-            continue;
+            references.emplace_back(i, entry.generation);
         }
+    }
 
-        // Jakub Melka: we must mark actual position of object
-        offsets[i] = device->pos();
-
-        if (isEncrypted)
-        {
-            PDFObjectReference reference(i, entry.generation);
-            PDFObject objectToWrite = entry.object;
-
-            if (reference != encryptObjectReference)
-            {
-                objectToWrite = storage.getSecurityHandler()->encryptObject(objectToWrite, reference);
-            }
+    std::vector<PDFInteger> referenceOffsets;
+    writeObjects(device, storage, references, encryptObjectReference, referenceOffsets);
 
-            PDFWriteObjectVisitor visitor(device);
-            writeObjectHeader(device, reference);
-            objectToWrite.accept(&visitor);
-            writeObjectFooter(device);
-        }
-        else
-        {
-            PDFWriteObjectVisitor visitor(device);
-            writeObjectHeader(device, PDFObjectReference(i, entry.generation));
-            entry.object.accept(&visitor);
-            writeObjectFooter(device);
-        }
+    std::vector<PDFInteger> offsets(objectCount, -1);
+    for (size_t i = 0; i < references.size(); ++i)
+    {
+        offsets[references[i].objectNumber] = referenceOffsets[i];
     }
 
     // Write cross-reference table
@@ -327,31 +336,10 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
             offset = 0;
         }
 
-        QString offsetString = QString::number(offset).rightJustified(10, QChar('0'), true);
-        QString generationString = QString::number(generation).rightJustified(5, QChar('0'), true);
-
-        device->write(offsetString.toLatin1());
-        device->write(" ");
-        device->write(generationString.toLatin1());
-        device->write(" ");
-        device->write(entry.object.isNull() ? "f" : "n");
-        writeCRLF(device);
-    }
-
-    // Jakub Melka: Adjust trailer dictionary, to be really dictionary, not a stream
-    PDFDictionary trailerDictionary = *document->getTrailerDictionary();
-    PDFDictionary newTrailerDictionary;
-
-    for (const char* entry : { "Size", "Root", "Encrypt", "Info", "ID"})
-    {
-        PDFObject object = trailerDictionary.get(entry);
-        if (!object.isNull())
-        {
-            newTrailerDictionary.addEntry(PDFInplaceOrMemoryString(entry), qMove(object));
-        }
+        writeXRefEntry(device, offset, generation, !entry.object.isNull());
     }
 
-    PDFObject trailerDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(newTrailerDictionary)));
+    PDFObject trailerDictionaryObject = createTrailerDictionary(document);
 
     device->write("trailer");
     writeCRLF(device);
@@ -369,196 +357,1533 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
     return true;
 }
 
-void PDFDocumentWriter::writeCRLF(QIODevice* device)
+PDFOperationResult PDFDocumentWriter::writeIncremental(const QString& fileName, const PDFDocument* document)
 {
-    device->write("\x0D\x0A");
-}
+    Q_ASSERT(document);
 
-void PDFDocumentWriter::writeObjectHeader(QIODevice* device, PDFObjectReference reference)
-{
-    QString objectHeader = QString("%1 %2 obj").arg(QString::number(reference.objectNumber), QString::number(reference.generation));
-    device->write(objectHeader.toLatin1());
-    writeCRLF(device);
-}
+    QFile file(fileName);
+    if (!file.open(QFile::ReadWrite))
+    {
+        return tr("File '%1' can't be opened for writing. %2").arg(fileName, file.errorString());
+    }
 
-void PDFDocumentWriter::writeObjectFooter(QIODevice* device)
-{
-    device->write("endobj");
-    writeCRLF(device);
+    const qint64 originalSize = file.size();
+    PDFOperationResult result = writeIncremental(&file, document);
+
+    if (!result)
+    {
+        // If some error occured, then remove incomplete update
+        file.resize(originalSize);
+    }
+
+    file.close();
+    return result;
 }
 
-class PDFSizeCounterIODevice : public QIODevice
+PDFOperationResult PDFDocumentWriter::writeIncremental(QIODevice* device, const PDFDocument* document)
 {
-public:
-    explicit PDFSizeCounterIODevice(QObject* parent) :
-        QIODevice(parent)
+    if (!device->isWritable() || !device->isReadable() || device->isSequential())
     {
+        return tr("Device is not readable and writable.");
+    }
 
+    const PDFObjectStorage& storage = document->getStorage();
+    if (!storage.getSecurityHandler()->isEncryptionAllowed())
+    {
+        return tr("Writing of encrypted documents is not supported.");
     }
 
-    virtual bool isSequential() const override;
-    virtual bool open(OpenMode mode) override;
-    virtual void close() override;
-    virtual qint64 pos() const override;
-    virtual qint64 size() const override;
-    virtual bool seek(qint64 pos) override;
-    virtual bool atEnd() const override;
-    virtual bool reset() override;
-    virtual qint64 bytesAvailable() const override;
-    virtual qint64 bytesToWrite() const override;
-    virtual bool canReadLine() const override;
-    virtual bool waitForReadyRead(int msecs) override;
-    virtual bool waitForBytesWritten(int msecs) override;
+    if (storage.isSecurityHandlerModified())
+    {
+        return tr("Document encryption was changed, incremental update is not possible.");
+    }
 
-protected:
-    virtual qint64 readData(char* data, qint64 maxlen) override;
-    virtual qint64 readLineData(char* data, qint64 maxlen) override;
-    virtual qint64 writeData(const char* data, qint64 len) override;
+    // Find offset of the previous cross-reference section
+    const qint64 originalSize = device->size();
+    const qint64 footerSize = qMin(originalSize, qint64(PDF_FOOTER_SCAN_LIMIT));
+    if (!device->seek(originalSize - footerSize))
+    {
+        return tr("Original document can't be read.");
+    }
 
-private:
-    OpenMode m_openMode = NotOpen;
-    qint64 m_fileSize = 0;
-};
+    const QByteArray footer = device->read(footerSize);
+    const int startXRefPosition = footer.lastIndexOf(PDF_START_OF_XREF_MARK);
+    if (startXRefPosition == -1)
+    {
+        return tr("Start of object reference table not found.");
+    }
 
-bool PDFSizeCounterIODevice::isSequential() const
-{
-    return true;
-}
+    PDFInteger previousXRefOffset = -1;
+    try
+    {
+        PDFLexicalAnalyzer analyzer(footer.constData() + startXRefPosition + std::strlen(PDF_START_OF_XREF_MARK), footer.constData() + footer.size());
+        const PDFLexicalAnalyzer::Token token = analyzer.fetch();
+        if (token.type == PDFLexicalAnalyzer::TokenType::Integer)
+        {
+            previousXRefOffset = token.data.toLongLong();
+        }
+    }
+    catch (const PDFException&)
+    {
+        previousXRefOffset = -1;
+    }
 
-bool PDFSizeCounterIODevice::open(OpenMode mode)
-{
-    if (m_openMode == NotOpen)
+    if (previousXRefOffset < 0)
     {
-        setOpenMode(mode);
+        return tr("Start of object reference table not found.");
+    }
+
+    const std::vector<PDFInteger> modifiedObjects = storage.getModifiedObjects();
+    if (modifiedObjects.empty())
+    {
+        // Nothing to do, document was not modified
         return true;
     }
-    else
+
+    if (!device->seek(originalSize))
     {
-        return false;
+        return tr("Device is not writable.");
     }
-}
 
-void PDFSizeCounterIODevice::close()
-{
-    setOpenMode(NotOpen);
-}
+    // Original file need not to end with end of line marker
+    writeCRLF(device);
 
-qint64 PDFSizeCounterIODevice::pos() const
-{
-    return m_fileSize;
-}
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    const PDFInteger objectCount = qMax(static_cast<PDFInteger>(objects.size()), modifiedObjects.back() + 1);
+    const PDFObjectReference encryptObjectReference = getEncryptObjectReference(document);
+
+    // Write modified objects. Removed objects are written as null objects, because
+    // free entries in cross-reference section would not hide previous revisions
+    // of these objects in all readers.
+    std::vector<PDFObjectReference> references;
+    references.reserve(modifiedObjects.size());
+    for (PDFInteger objectNumber : modifiedObjects)
+    {
+        if (objectNumber == 0)
+        {
+            // Head of the free list, it is never written
+            continue;
+        }
 
-qint64 PDFSizeCounterIODevice::size() const
-{
-    return m_fileSize;
-}
+        const PDFInteger generation = objectNumber < static_cast<PDFInteger>(objects.size()) ? objects[objectNumber].generation : 0;
+        references.emplace_back(objectNumber, generation);
+    }
 
-bool PDFSizeCounterIODevice::seek(qint64 pos)
-{
-    Q_UNUSED(pos);
+    std::vector<PDFInteger> referenceOffsets;
+    writeObjects(device, storage, references, encryptObjectReference, referenceOffsets);
 
-    return false;
-}
+    std::vector<std::pair<PDFObjectReference, PDFInteger>> offsets;
+    offsets.reserve(references.size());
+    for (size_t i = 0; i < references.size(); ++i)
+    {
+        offsets.emplace_back(references[i], referenceOffsets[i]);
+    }
 
-bool PDFSizeCounterIODevice::atEnd() const
-{
-    return true;
-}
+    // Write cross-reference section, consecutive objects form a subsection
+    PDFInteger xrefOffset = device->pos();
+    device->write("xref");
+    writeCRLF(device);
 
-bool PDFSizeCounterIODevice::reset()
-{
-    return false;
-}
+    for (auto it = offsets.cbegin(); it != offsets.cend();)
+    {
+        auto itEnd = std::next(it);
+        while (itEnd != offsets.cend() && itEnd->first.objectNumber == std::prev(itEnd)->first.objectNumber + 1)
+        {
+            ++itEnd;
+        }
 
-qint64 PDFSizeCounterIODevice::bytesAvailable() const
-{
-    return 0;
-}
+        device->write(QString("%1 %2").arg(it->first.objectNumber).arg(std::distance(it, itEnd)).toLatin1());
+        writeCRLF(device);
 
-qint64 PDFSizeCounterIODevice::bytesToWrite() const
-{
-    return 0;
-}
+        for (; it != itEnd; ++it)
+        {
+            writeXRefEntry(device, it->second, it->first.generation, true);
+        }
+    }
 
-bool PDFSizeCounterIODevice::canReadLine() const
-{
-    return false;
-}
+    PDFObject trailerDictionaryObject = createTrailerDictionary(document);
+    PDFDictionary trailerDictionary = *trailerDictionaryObject.getDictionary();
+    trailerDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(objectCount));
+    trailerDictionary.setEntry(PDFInplaceOrMemoryString("Prev"), PDFObject::createInteger(previousXRefOffset));
+    trailerDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(trailerDictionary)));
 
-bool PDFSizeCounterIODevice::waitForReadyRead(int msecs)
-{
-    Q_UNUSED(msecs);
+    device->write("trailer");
+    writeCRLF(device);
+    PDFWriteObjectVisitor trailerVisitor(device);
+    trailerDictionaryObject.accept(&trailerVisitor);
+    writeCRLF(device);
+    device->write("startxref");
+    writeCRLF(device);
+    device->write(QString::number(xrefOffset).toLatin1());
+    writeCRLF(device);
 
-    return false;
+    // Write footer
+    device->write("%%EOF");
+    writeCRLF(device);
+
+    return true;
 }
 
-bool PDFSizeCounterIODevice::waitForBytesWritten(int msecs)
+void PDFDocumentWriter::writeCRLF(QIODevice* device)
 {
-    Q_UNUSED(msecs);
-
-    return false;
+    device->write("\x0D\x0A");
 }
 
-qint64 PDFSizeCounterIODevice::readData(char* data, qint64 maxlen)
+void PDFDocumentWriter::writeObjectHeader(QIODevice* device, PDFObjectReference reference)
 {
-    Q_UNUSED(data);
-    Q_UNUSED(maxlen);
-
-    return 0;
+    QString objectHeader = QString("%1 %2 obj").arg(QString::number(reference.objectNumber), QString::number(reference.generation));
+    device->write(objectHeader.toLatin1());
+    writeCRLF(device);
 }
 
-qint64 PDFSizeCounterIODevice::readLineData(char* data, qint64 maxlen)
+void PDFDocumentWriter::writeObjectFooter(QIODevice* device)
 {
-    Q_UNUSED(data);
-    Q_UNUSED(maxlen);
-
-    return 0;
+    device->write("endobj");
+    writeCRLF(device);
 }
 
-qint64 PDFSizeCounterIODevice::writeData(const char* data, qint64 len)
+void PDFDocumentWriter::writeObject(QIODevice* device,
+                                    const PDFObjectStorage& storage,
+                                    PDFObjectReference reference,
+                                    const PDFObject& object,
+                                    PDFObjectReference encryptObjectReference)
 {
-    Q_UNUSED(data);
+    const bool isEncrypted = storage.getSecurityHandler()->getMode() != EncryptionMode::None;
 
-    m_fileSize += len;
-    return len;
+    PDFObject objectToWrite = object;
+    if (isEncrypted && reference != encryptObjectReference)
+    {
+        objectToWrite = storage.getSecurityHandler()->encryptObject(objectToWrite, reference);
+    }
+
+    PDFWriteObjectVisitor visitor(device);
+    writeObjectHeader(device, reference);
+    objectToWrite.accept(&visitor);
+    writeObjectFooter(device);
 }
 
-qint64 PDFDocumentWriter::getDocumentFileSize(const PDFDocument* document)
+QByteArray PDFDocumentWriter::getSerializedIndirectObject(const PDFObjectStorage& storage,
+                                                      PDFObjectReference reference,
+                                                      const PDFObject& object,
+                                                      PDFObjectReference encryptObjectReference)
 {
-    PDFSizeCounterIODevice device(nullptr);
-    PDFDocumentWriter writer(nullptr);
-
-    device.open(QIODevice::WriteOnly);
+    QBuffer buffer;
 
-    if (writer.write(&device, document))
+    if (buffer.open(QBuffer::WriteOnly))
     {
-        device.close();
-        return device.pos();
+        writeObject(&buffer, storage, reference, object, encryptObjectReference);
+        buffer.close();
     }
 
-    device.close();
-    return -1;
+    return buffer.data();
 }
 
-qint64 PDFDocumentWriter::getObjectSize(const PDFDocument* document, PDFObjectReference reference)
+void PDFDocumentWriter::writeObjects(QIODevice* device,
+                                     const PDFObjectStorage& storage,
+                                     const std::vector<PDFObjectReference>& references,
+                                     PDFObjectReference encryptObjectReference,
+                                     std::vector<PDFInteger>& offsets)
 {
-    const PDFObject& object = document->getObjectByReference(reference);
-
-    if (object.isNull())
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    auto getObject = [&objects](PDFObjectReference reference) -> const PDFObject&
     {
-        return 0;
-    }
+        static const PDFObject nullObject;
 
-    PDFSizeCounterIODevice device(nullptr);
+        if (reference.objectNumber >= 0 && reference.objectNumber < static_cast<PDFInteger>(objects.size()))
+        {
+            return objects[reference.objectNumber].object;
+        }
 
-    device.open(QIODevice::WriteOnly);
+        return nullObject;
+    };
 
-    PDFWriteObjectVisitor visitor(&device);
-    writeObjectHeader(&device, reference);
-    object.accept(&visitor);
-    writeObjectFooter(&device);
+    offsets.assign(references.size(), -1);
 
-    device.close();
+    QByteArray writeBuffer;
+    writeBuffer.reserve(WRITE_BUFFER_SIZE);
+    auto flush = [device, &writeBuffer]()
+    {
+        if (!writeBuffer.isEmpty())
+        {
+            device->write(writeBuffer);
+            writeBuffer.resize(0);
+        }
+    };
+
+    std::vector<QByteArray> serializedObjects;
+    size_t batchStart = 0;
+    while (batchStart < references.size())
+    {
+        // Select batch of objects. Size of the batch is limited, so memory
+        // occupied by serialized objects, which are not yet written, is bounded.
+        size_t batchEnd = batchStart;
+        qint64 batchDataSize = 0;
+        while (batchEnd < references.size() && batchEnd - batchStart < WRITE_BATCH_OBJECT_COUNT && batchDataSize < WRITE_BATCH_DATA_SIZE)
+        {
+            const PDFObject& object = getObject(references[batchEnd]);
+            batchDataSize += object.isStream() ? object.getStream()->getContent()->size() : 0;
+            ++batchEnd;
+        }
+
+        // Serialization (and encryption) of objects is independent,
+        // so we can do it in parallel. Serialized objects are then written in order.
+        serializedObjects.assign(batchEnd - batchStart, QByteArray());
+        auto serializeObject = [&](size_t i)
+        {
+            serializedObjects[i - batchStart] = getSerializedIndirectObject(storage, references[i], getObject(references[i]), encryptObjectReference);
+        };
+
+        PDFIntegerRange<size_t> batchRange(batchStart, batchEnd);
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, batchRange.begin(), batchRange.end(), serializeObject);
+
+        for (size_t i = batchStart; i < batchEnd; ++i)
+        {
+            QByteArray& data = serializedObjects[i - batchStart];
+
+            if (writeBuffer.size() + data.size() > WRITE_BUFFER_SIZE)
+            {
+                flush();
+            }
+
+            // Jakub Melka: we must mark actual position of object
+            offsets[i] = device->pos() + writeBuffer.size();
+
+            if (data.size() >= WRITE_BUFFER_SIZE)
+            {
+                device->write(data);
+            }
+            else
+            {
+                writeBuffer.append(data);
+            }
+
+            data = QByteArray();
+        }
+
+        batchStart = batchEnd;
+    }
+
+    flush();
+}
+
+void PDFDocumentWriter::writeXRefEntry(QIODevice* device, PDFInteger offset, PDFInteger generation, bool isOccupied)
+{
+    QString offsetString = QString::number(offset).rightJustified(10, QChar('0'), true);
+    QString generationString = QString::number(generation).rightJustified(5, QChar('0'), true);
+
+    device->write(offsetString.toLatin1());
+    device->write(" ");
+    device->write(generationString.toLatin1());
+    device->write(" ");
+    device->write(isOccupied ? "n" : "f");
+    writeCRLF(device);
+}
+
+void PDFDocumentWriter::writeObjectStreams(QIODevice* device, const PDFDocument* document, PDFObjectReference encryptObjectReference) const
+{
+    const PDFObjectStorage& storage = document->getStorage();
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    const PDFInteger objectCount = static_cast<PDFInteger>(objects.size());
+
+    // Select objects, which can be packed into object streams. Streams, objects with
+    // nonzero generation number and encryption dictionary must remain regular objects.
+    std::vector<PDFInteger> packedObjects;
+    for (PDFInteger i = 1; i < objectCount; ++i)
+    {
+        const PDFObjectStorage::Entry& entry = objects[i];
+        if (!entry.object.isNull() && !entry.object.isStream() && entry.generation == 0 && PDFObjectReference(i, 0) != encryptObjectReference)
+        {
+            packedObjects.push_back(i);
+        }
+    }
+
+    const size_t objectsPerStream = static_cast<size_t>(m_objectsPerStream);
+    const size_t objectStreamCount = (packedObjects.size() + objectsPerStream - 1) / objectsPerStream;
+    const PDFInteger xrefStreamObjectNumber = objectCount + static_cast<PDFInteger>(objectStreamCount);
+    const PDFInteger size = xrefStreamObjectNumber + 1;
+
+    std::vector<XRefStreamEntry> xrefEntries(size);
+    for (PDFInteger i = 0; i < objectCount; ++i)
+    {
+        xrefEntries[i].field3 = (i == 0) ? 65535 : objects[i].generation;
+    }
+
+    // Object streams are independent on each other, so we can serialize,
+    // compress and encrypt them in parallel. Then they are written sequentially.
+    std::vector<PDFObject> objectStreams(objectStreamCount);
+    auto createObjectStreamAtIndex = [&](size_t streamIndex)
+    {
+        const size_t first = streamIndex * objectsPerStream;
+        const size_t last = qMin(first + objectsPerStream, packedObjects.size());
+        const PDFObjectReference streamReference(objectCount + static_cast<PDFInteger>(streamIndex), 0);
+
+        std::vector<std::pair<PDFInteger, PDFObject>> streamObjects;
+        streamObjects.reserve(last - first);
+        for (size_t i = first; i < last; ++i)
+        {
+            const PDFInteger objectNumber = packedObjects[i];
+            streamObjects.emplace_back(objectNumber, objects[objectNumber].object);
+
+            XRefStreamEntry& xrefEntry = xrefEntries[objectNumber];
+            xrefEntry.type = 2;
+            xrefEntry.field2 = streamReference.objectNumber;
+            xrefEntry.field3 = static_cast<PDFInteger>(i - first);
+        }
+
+        objectStreams[streamIndex] = createObjectStream(storage, streamReference, streamObjects);
+    };
+
+    PDFIntegerRange<size_t> objectStreamRange(0, objectStreamCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectStreamRange.begin(), objectStreamRange.end(), createObjectStreamAtIndex);
+
+    // Write objects, which are not packed into object streams
+    std::vector<PDFObjectReference> references;
+    for (PDFInteger i = 1; i < objectCount; ++i)
+    {
+        const PDFObjectStorage::Entry& entry = objects[i];
+        if (!entry.object.isNull() && xrefEntries[i].type != 2)
+        {
+            references.emplace_back(i, entry.generation);
+        }
+    }
+
+    std::vector<PDFInteger> referenceOffsets;
+    writeObjects(device, storage, references, encryptObjectReference, referenceOffsets);
+
+    for (size_t i = 0; i < references.size(); ++i)
+    {
+        XRefStreamEntry& xrefEntry = xrefEntries[references[i].objectNumber];
+        xrefEntry.type = 1;
+        xrefEntry.field2 = referenceOffsets[i];
+    }
+
+    // Write object streams
+    PDFWriteObjectVisitor visitor(device);
+    for (size_t i = 0; i < objectStreamCount; ++i)
+    {
+        const PDFObjectReference streamReference(objectCount + static_cast<PDFInteger>(i), 0);
+
+        xrefEntries[streamReference.objectNumber].type = 1;
+        xrefEntries[streamReference.objectNumber].field2 = device->pos();
+
+        writeObjectHeader(device, streamReference);
+        objectStreams[i].accept(&visitor);
+        writeObjectFooter(device);
+    }
+
+    // Write cross-reference stream (it is never encrypted)
+    const PDFInteger xrefOffset = device->pos();
+    xrefEntries[xrefStreamObjectNumber].type = 1;
+    xrefEntries[xrefStreamObjectNumber].field2 = xrefOffset;
+
+    PDFObject trailerDictionaryObject = createTrailerDictionary(document);
+    PDFDictionary xrefDictionary = *trailerDictionaryObject.getDictionary();
+    xrefDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(size));
+
+    PDFObject xrefStreamObject = createXRefStream(xrefEntries, qMove(xrefDictionary), 0, true);
+    writeObjectHeader(device, PDFObjectReference(xrefStreamObjectNumber, 0));
+    xrefStreamObject.accept(&visitor);
+    writeObjectFooter(device);
+
+    device->write("startxref");
+    writeCRLF(device);
+    device->write(QString::number(xrefOffset).toLatin1());
+    writeCRLF(device);
+}
+
+/// Object written to the linearized document. It is either a regular
+/// object, or an object stream containing multiple objects.
+struct PDFLinearizedObject
+{
+    PDFObjectReference reference;                   ///< Reference of the object in the written document
+    std::vector<PDFInteger> originalObjectNumbers;  ///< Original object numbers (packed objects, if this is an object stream)
+    bool isObjectStream = false;                    ///< Is object an object stream?
+    QByteArray data;                                ///< Serialized object
+    PDFInteger offset = 0;                          ///< Offset of the object in the written document
+
+    /// Returns number of objects (including packed objects)
+    PDFInteger getObjectCount() const { return isObjectStream ? static_cast<PDFInteger>(originalObjectNumbers.size()) + 1 : 1; }
+};
+
+using PDFLinearizedSection = std::vector<PDFLinearizedObject>;
+
+/// Returns number of bits needed to represent the value
+static PDFInteger getBitCount(PDFInteger value)
+{
+    PDFInteger bits = 0;
+    while (value > 0)
+    {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+/// Creates data of the primary hint stream - page offset hint table followed by the shared
+/// object hint table. Offsets of the objects must be computed as if the hint stream was not
+/// present in the file. Shared object groups are objects of the first page section followed
+/// by objects of the shared objects section.
+/// \param pageSections Sections of the pages (first page section is the first one)
+/// \param pageSharedGroups Shared object groups referenced by pages
+/// \param sharedSection Shared objects section
+/// \param firstSharedObjectNumber Object number of the first object in shared objects section
+/// \param[out] sharedObjectHintTableOffset Offset of the shared object hint table in the data
+static QByteArray createHintStreamData(const std::vector<PDFLinearizedSection>& pageSections,
+                                       const std::vector<std::vector<PDFInteger>>& pageSharedGroups,
+                                       const PDFLinearizedSection& sharedSection,
+                                       PDFInteger firstSharedObjectNumber,
+                                       PDFInteger& sharedObjectHintTableOffset)
+{
+    const size_t pageCount = pageSections.size();
+
+    std::vector<PDFInteger> pageObjectCounts(pageCount, 0);
+    std::vector<PDFInteger> pageLengths(pageCount, 0);
+    PDFInteger maxSharedReferences = 0;
+    PDFInteger maxSharedIdentifier = 0;
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        const PDFLinearizedSection& section = pageSections[i];
+        for (const PDFLinearizedObject& object : section)
+        {
+            pageObjectCounts[i] += object.getObjectCount();
+        }
+        pageLengths[i] = section.back().offset + section.back().data.size() - section.front().offset;
+
+        maxSharedReferences = qMax(maxSharedReferences, static_cast<PDFInteger>(pageSharedGroups[i].size()));
+        for (PDFInteger group : pageSharedGroups[i])
+        {
+            maxSharedIdentifier = qMax(maxSharedIdentifier, group);
+        }
+    }
+
+    const auto [minObjectCount, maxObjectCount] = std::minmax_element(pageObjectCounts.cbegin(), pageObjectCounts.cend());
+    const auto [minLength, maxLength] = std::minmax_element(pageLengths.cbegin(), pageLengths.cend());
+    const PDFInteger objectCountBits = getBitCount(*maxObjectCount - *minObjectCount);
+    const PDFInteger lengthBits = getBitCount(*maxLength - *minLength);
+    const PDFInteger sharedReferencesBits = getBitCount(maxSharedReferences);
+    const PDFInteger sharedIdentifierBits = getBitCount(maxSharedIdentifier);
+
+    // Page offset hint table. Content streams are not placed at the fixed
+    // position in the page, so content stream offsets are zero and content stream
+    // lengths are equal to the page lengths.
+    PDFBitWriter pageWriter(32);
+    pageWriter.write(*minObjectCount, 32);
+    pageWriter.write(pageSections.front().front().offset, 32);
+    pageWriter.write(objectCountBits, 16);
+    pageWriter.write(*minLength, 32);
+    pageWriter.write(lengthBits, 16);
+    pageWriter.write(0, 32);
+    pageWriter.write(0, 16);
+    pageWriter.write(*minLength, 32);
+    pageWriter.write(lengthBits, 16);
+    pageWriter.write(sharedReferencesBits, 16);
+    pageWriter.write(sharedIdentifierBits, 16);
+    pageWriter.write(0, 16);
+    pageWriter.write(1, 16);
+
+    for (PDFInteger objectCount : pageObjectCounts)
+    {
+        pageWriter.write(objectCount - *minObjectCount, objectCountBits);
+    }
+    pageWriter.finishLine();
+
+    for (PDFInteger length : pageLengths)
+    {
+        pageWriter.write(length - *minLength, lengthBits);
+    }
+    pageWriter.finishLine();
+
+    for (const std::vector<PDFInteger>& groups : pageSharedGroups)
+    {
+        pageWriter.write(groups.size(), sharedReferencesBits);
+    }
+    pageWriter.finishLine();
+
+    for (const std::vector<PDFInteger>& groups : pageSharedGroups)
+    {
+        for (PDFInteger group : groups)
+        {
+            pageWriter.write(group, sharedIdentifierBits);
+        }
+    }
+    pageWriter.finishLine();
+
+    for (PDFInteger length : pageLengths)
+    {
+        pageWriter.write(length - *minLength, lengthBits);
+    }
+    pageWriter.finishLine();
+
+    QByteArray data = pageWriter.takeByteArray();
+    sharedObjectHintTableOffset = data.size();
+
+    // Shared object hint table
+    std::vector<const PDFLinearizedObject*> groups;
+    for (const PDFLinearizedSection* section : { &pageSections.front(), &sharedSection })
+    {
+        for (const PDFLinearizedObject& object : *section)
+        {
+            groups.push_back(&object);
+        }
+    }
+
+    PDFInteger minGroupLength = std::numeric_limits<PDFInteger>::max();
+    PDFInteger maxGroupLength = 0;
+    PDFInteger maxGroupObjectCount = 1;
+    for (const PDFLinearizedObject* group : groups)
+    {
+        minGroupLength = qMin(minGroupLength, static_cast<PDFInteger>(group->data.size()));
+        maxGroupLength = qMax(maxGroupLength, static_cast<PDFInteger>(group->data.size()));
+        maxGroupObjectCount = qMax(maxGroupObjectCount, group->getObjectCount());
+    }
+
+    const PDFInteger groupLengthBits = getBitCount(maxGroupLength - minGroupLength);
+    const PDFInteger groupObjectCountBits = getBitCount(maxGroupObjectCount - 1);
+
+    PDFBitWriter sharedWriter(32);
+    sharedWriter.write(!sharedSection.empty() ? firstSharedObjectNumber : 0, 32);
+    sharedWriter.write(!sharedSection.empty() ? sharedSection.front().offset : 0, 32);
+    sharedWriter.write(pageSections.front().size(), 32);
+    sharedWriter.write(groups.size(), 32);
+    sharedWriter.write(groupObjectCountBits, 16);
+    sharedWriter.write(minGroupLength, 32);
+    sharedWriter.write(groupLengthBits, 16);
+
+    for (const PDFLinearizedObject* group : groups)
+    {
+        sharedWriter.write(group->data.size() - minGroupLength, groupLengthBits);
+    }
+    sharedWriter.finishLine();
+
+    // Signatures of the groups are not present
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        sharedWriter.write(0, 1);
+    }
+    sharedWriter.finishLine();
+
+    for (const PDFLinearizedObject* group : groups)
+    {
+        sharedWriter.write(group->getObjectCount() - 1, groupObjectCountBits);
+    }
+    sharedWriter.finishLine();
+
+    data.append(sharedWriter.takeByteArray());
+    return data;
+}
+
+PDFOperationResult PDFDocumentWriter::writeLinearized(QIODevice* device, const PDFDocument* document, PDFObjectReference encryptObjectReference) const
+{
+    const PDFObjectStorage& storage = document->getStorage();
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    const PDFInteger objectCount = static_cast<PDFInteger>(objects.size());
+    const PDFCatalog* catalog = document->getCatalog();
+    const size_t pageCount = catalog->getPageCount();
+
+    auto isValidReference = [&objects, objectCount](PDFObjectReference reference)
+    {
+        return reference.objectNumber > 0 &&
+               reference.objectNumber < objectCount &&
+               objects[reference.objectNumber].generation == reference.generation &&
+               !objects[reference.objectNumber].object.isNull();
+    };
+
+    const PDFObject& rootObject = document->getTrailerDictionary()->get("Root");
+    if (pageCount == 0 || !rootObject.isReference() || !isValidReference(rootObject.getReference()))
+    {
+        return tr("Document can't be linearized, it has no pages, or its catalog is invalid.");
+    }
+    const PDFObjectReference catalogReference = rootObject.getReference();
+
+    std::vector<PDFObjectReference> pageReferences(pageCount);
+    std::set<PDFObjectReference> uniquePageReferences;
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        pageReferences[i] = catalog->getPage(i)->getPageReference();
+        if (!isValidReference(pageReferences[i]) || !uniquePageReferences.insert(pageReferences[i]).second)
+        {
+            return tr("Document can't be linearized, page %1 is not a unique indirect object.").arg(i + 1);
+        }
+    }
+
+    // Page tree nodes and document catalog are not followed, when objects
+    // of the page are collected, so objects of other pages are not collected.
+    PDFDocumentDataLoaderDecorator loader(document);
+    std::vector<bool> isBarrier(objectCount, false);
+    for (PDFInteger i = 0; i < objectCount; ++i)
+    {
+        if (objects[i].object.isDictionary())
+        {
+            const QByteArray type = loader.readNameFromDictionary(objects[i].object.getDictionary(), "Type");
+            isBarrier[i] = (type == "Page" || type == "Pages");
+        }
+    }
+    for (PDFObjectReference pageReference : pageReferences)
+    {
+        isBarrier[pageReference.objectNumber] = true;
+    }
+    isBarrier[catalogReference.objectNumber] = true;
+
+    // Collects objects reachable from the roots (in depth-first order). Parent entries are
+    // not followed (they lead to page tree, or to form field hierarchy).
+    auto collectObjects = [&](const std::vector<PDFObject>& roots, PDFObjectReference rootPageReference)
+    {
+        std::vector<PDFInteger> result;
+        std::set<PDFInteger> visited;
+        std::vector<PDFObject> stack(roots.crbegin(), roots.crend());
+
+        auto pushDictionary = [&stack](const PDFDictionary* dictionary)
+        {
+            for (size_t i = dictionary->getCount(); i > 0; --i)
+            {
+                if (dictionary->getKey(i - 1).getString() != "Parent")
+                {
+                    stack.push_back(dictionary->getValue(i - 1));
+                }
+            }
+        };
+
+        while (!stack.empty())
+        {
+            PDFObject object = qMove(stack.back());
+            stack.pop_back();
+
+            switch (object.getType())
+            {
+                case PDFObject::Type::Reference:
+                {
+                    const PDFObjectReference reference = object.getReference();
+                    if (isValidReference(reference) &&
+                        (!isBarrier[reference.objectNumber] || reference == rootPageReference) &&
+                        visited.insert(reference.objectNumber).second)
+                    {
+                        result.push_back(reference.objectNumber);
+                        stack.push_back(objects[reference.objectNumber].object);
+                    }
+                    break;
+                }
+
+                case PDFObject::Type::Array:
+                {
+                    const PDFArray* array = object.getArray();
+                    for (size_t i = array->getCount(); i > 0; --i)
+                    {
+                        stack.push_back(array->getItem(i - 1));
+                    }
+                    break;
+                }
+
+                case PDFObject::Type::Dictionary:
+                    pushDictionary(object.getDictionary());
+                    break;
+
+                case PDFObject::Type::Stream:
+                    pushDictionary(object.getStream()->getDictionary());
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        return result;
+    };
+
+    // Collect objects of the pages. Inherited resources are treated as objects of the page.
+    std::vector<std::vector<PDFInteger>> pageObjects(pageCount);
+    auto collectPageObjects = [&](size_t pageIndex)
+    {
+        const PDFObject pageObject = PDFObject::createReference(pageReferences[pageIndex]);
+        pageObjects[pageIndex] = collectObjects({ pageObject, catalog->getPage(pageIndex)->getResources() }, pageReferences[pageIndex]);
+    };
+    PDFIntegerRange<size_t> pageRange(0, pageCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), collectPageObjects);
+
+    constexpr PDFInteger NotUsed = -1;
+    constexpr PDFInteger Shared = -2;
+    constexpr PDFInteger DocumentLevel = -3;
+
+    std::vector<PDFInteger> usage(objectCount, NotUsed);
+    for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+    {
+        for (PDFInteger objectNumber : pageObjects[pageIndex])
+        {
+            PDFInteger& objectUsage = usage[objectNumber];
+            if (objectUsage == NotUsed)
+            {
+                objectUsage = static_cast<PDFInteger>(pageIndex);
+            }
+            else if (objectUsage != static_cast<PDFInteger>(pageIndex))
+            {
+                objectUsage = Shared;
+            }
+        }
+    }
+
+    // Document-level objects, which are needed to open the document
+    std::vector<PDFInteger> documentObjects = { catalogReference.objectNumber };
+    usage[catalogReference.objectNumber] = DocumentLevel;
+
+    if (isValidReference(encryptObjectReference) && usage[encryptObjectReference.objectNumber] == NotUsed)
+    {
+        documentObjects.push_back(encryptObjectReference.objectNumber);
+        usage[encryptObjectReference.objectNumber] = DocumentLevel;
+    }
+
+    if (const PDFDictionary* catalogDictionary = document->getDictionaryFromObject(objects[catalogReference.objectNumber].object))
+    {
+        for (const char* key : { "ViewerPreferences", "OpenAction" })
+        {
+            for (PDFInteger objectNumber : collectObjects({ catalogDictionary->get(key) }, PDFObjectReference()))
+            {
+                if (usage[objectNumber] == NotUsed)
+                {
+                    documentObjects.push_back(objectNumber);
+                    usage[objectNumber] = DocumentLevel;
+                }
+            }
+        }
+    }
+
+    // Divide objects into sections. First page section contains also
+    // shared objects used by the first page.
+    std::vector<bool> isPlaced(objectCount, false);
+    for (PDFInteger objectNumber : documentObjects)
+    {
+        isPlaced[objectNumber] = true;
+    }
+
+    std::vector<std::vector<PDFInteger>> pageSectionObjects(pageCount);
+    for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+    {
+        for (PDFInteger objectNumber : pageObjects[pageIndex])
+        {
+            if (usage[objectNumber] == static_cast<PDFInteger>(pageIndex) || (pageIndex == 0 && usage[objectNumber] == Shared))
+            {
+                pageSectionObjects[pageIndex].push_back(objectNumber);
+                isPlaced[objectNumber] = true;
+            }
+        }
+    }
+
+    std::vector<PDFInteger> sharedObjects;
+    for (size_t pageIndex = 1; pageIndex < pageCount; ++pageIndex)
+    {
+        for (PDFInteger objectNumber : pageObjects[pageIndex])
+        {
+            if (usage[objectNumber] == Shared && !isPlaced[objectNumber])
+            {
+                sharedObjects.push_back(objectNumber);
+                isPlaced[objectNumber] = true;
+            }
+        }
+    }
+
+    std::vector<PDFInteger> otherObjects;
+    for (PDFInteger i = 1; i < objectCount; ++i)
+    {
+        if (!isPlaced[i] && isValidReference(PDFObjectReference(i, objects[i].generation)))
+        {
+            otherObjects.push_back(i);
+        }
+    }
+
+    // Renumber objects. Objects of the first page section have the highest numbers, objects
+    // of each other section are numbered consecutively, in the order of sections in the file.
+    std::vector<PDFObjectReference> newReferences(objectCount);
+    PDFInteger nextObjectNumber = 1;
+    const size_t objectsPerStream = static_cast<size_t>(m_objectsPerStream);
+
+    auto createSection = [&](const std::vector<PDFInteger>& sectionObjects, bool isFirstObjectUnpacked)
+    {
+        PDFLinearizedSection section;
+        std::vector<PDFInteger> packedObjects;
+
+        for (size_t i = 0; i < sectionObjects.size(); ++i)
+        {
+            const PDFInteger objectNumber = sectionObjects[i];
+            const PDFObjectStorage::Entry& entry = objects[objectNumber];
+
+            if (m_objectStreamsEnabled &&
+                !(isFirstObjectUnpacked && i == 0) &&
+                !entry.object.isStream() &&
+                PDFObjectReference(objectNumber, entry.generation) != encryptObjectReference)
+            {
+                packedObjects.push_back(objectNumber);
+                continue;
+            }
+
+            PDFLinearizedObject linearizedObject;
+            linearizedObject.reference = PDFObjectReference(nextObjectNumber++, 0);
+            linearizedObject.originalObjectNumbers = { objectNumber };
+            newReferences[objectNumber] = linearizedObject.reference;
+            section.emplace_back(qMove(linearizedObject));
+        }
+
+        for (size_t first = 0; first < packedObjects.size(); first += objectsPerStream)
+        {
+            const size_t last = qMin(first + objectsPerStream, packedObjects.size());
+
+            PDFLinearizedObject objectStream;
+            objectStream.isObjectStream = true;
+            for (size_t i = first; i < last; ++i)
+            {
+                newReferences[packedObjects[i]] = PDFObjectReference(nextObjectNumber++, 0);
+                objectStream.originalObjectNumbers.push_back(packedObjects[i]);
+            }
+            objectStream.reference = PDFObjectReference(nextObjectNumber++, 0);
+            section.emplace_back(qMove(objectStream));
+        }
+
+        return section;
+    };
+
+    std::vector<PDFLinearizedSection> pageSections(pageCount);
+    for (size_t pageIndex = 1; pageIndex < pageCount; ++pageIndex)
+    {
+        pageSections[pageIndex] = createSection(pageSectionObjects[pageIndex], true);
+    }
+
+    const PDFInteger firstSharedObjectNumber = nextObjectNumber;
+    PDFLinearizedSection sharedSection = createSection(sharedObjects, false);
+    PDFLinearizedSection otherSection = createSection(otherObjects, false);
+    const PDFObjectReference mainXRefReference = m_objectStreamsEnabled ? PDFObjectReference(nextObjectNumber++, 0) : PDFObjectReference();
+
+    const PDFInteger mainSectionSize = nextObjectNumber;
+    const PDFObjectReference linearizationDictionaryReference(nextObjectNumber++, 0);
+    const PDFObjectReference firstPageXRefReference = m_objectStreamsEnabled ? PDFObjectReference(nextObjectNumber++, 0) : PDFObjectReference();
+    PDFLinearizedSection documentSection = createSection(documentObjects, false);
+    const PDFObjectReference hintStreamReference(nextObjectNumber++, 0);
+    pageSections.front() = createSection(pageSectionObjects.front(), true);
+    const PDFInteger size = nextObjectNumber;
+
+    std::map<PDFObjectReference, PDFObjectReference> referenceMapping;
+    for (PDFInteger i = 1; i < objectCount; ++i)
+    {
+        if (isValidReference(PDFObjectReference(i, objects[i].generation)))
+        {
+            referenceMapping[PDFObjectReference(i, objects[i].generation)] = newReferences[i];
+        }
+    }
+
+    // References to objects, which doesn't exist, must be redirected, so they do
+    // not refer to renumbered objects. Object numbers above the size are treated as null objects.
+    PDFObject trailerDictionaryObject = createTrailerDictionary(document);
+    std::set<PDFObjectReference> invalidReferences;
+    QMutex invalidReferencesMutex;
+    auto collectInvalidReferences = [&](const PDFObject& object)
+    {
+        for (const PDFObjectReference& reference : PDFObjectUtils::getDirectReferences(object))
+        {
+            if (!referenceMapping.count(reference))
+            {
+                QMutexLocker lock(&invalidReferencesMutex);
+                invalidReferences.insert(reference);
+            }
+        }
+    };
+    PDFIntegerRange<PDFInteger> objectRange(0, objectCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectRange.begin(), objectRange.end(), [&](PDFInteger i) { collectInvalidReferences(objects[i].object); });
+    collectInvalidReferences(trailerDictionaryObject);
+
+    for (const PDFObjectReference& reference : invalidReferences)
+    {
+        referenceMapping[reference] = PDFObjectReference(size, 0);
+    }
+
+    const PDFObjectReference newEncryptObjectReference = isValidReference(encryptObjectReference) ? newReferences[encryptObjectReference.objectNumber] : PDFObjectReference();
+
+    // Serialize objects in parallel
+    std::vector<PDFLinearizedObject*> linearizedObjects;
+    for (PDFLinearizedSection* section : { &documentSection, &sharedSection, &otherSection })
+    {
+        for (PDFLinearizedObject& object : *section)
+        {
+            linearizedObjects.push_back(&object);
+        }
+    }
+    for (PDFLinearizedSection& section : pageSections)
+    {
+        for (PDFLinearizedObject& object : section)
+        {
+            linearizedObjects.push_back(&object);
+        }
+    }
+
+    auto serializeObject = [&](PDFLinearizedObject* linearizedObject)
+    {
+        if (linearizedObject->isObjectStream)
+        {
+            std::vector<std::pair<PDFInteger, PDFObject>> streamObjects;
+            streamObjects.reserve(linearizedObject->originalObjectNumbers.size());
+            for (PDFInteger objectNumber : linearizedObject->originalObjectNumbers)
+            {
+                streamObjects.emplace_back(newReferences[objectNumber].objectNumber, PDFObjectUtils::replaceReferences(objects[objectNumber].object, referenceMapping));
+            }
+
+            // Object stream is already encrypted, so it is passed as encryption object reference
+            PDFObject objectStream = createObjectStream(storage, linearizedObject->reference, streamObjects);
+            linearizedObject->data = getSerializedIndirectObject(storage, linearizedObject->reference, objectStream, linearizedObject->reference);
+        }
+        else
+        {
+            PDFObject object = PDFObjectUtils::replaceReferences(objects[linearizedObject->originalObjectNumbers.front()].object, referenceMapping);
+            linearizedObject->data = getSerializedIndirectObject(storage, linearizedObject->reference, object, newEncryptObjectReference);
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, linearizedObjects.begin(), linearizedObjects.end(), serializeObject);
+
+    // Linearization parameter dictionary and first page cross-reference section contain
+    // values, which depend on the layout, so they are padded to the fixed size.
+    constexpr PDFInteger PLACEHOLDER_VALUE = 9999999999;
+    const QByteArray firstPageXRefFooter = "\x0D\x0Astartxref\x0D\x0A" "0\x0D\x0A%%EOF\x0D\x0A";
+
+    auto createLinearizationDictionary = [&](PDFInteger fileLength, PDFInteger hintStreamOffset, PDFInteger hintStreamLength, PDFInteger endOfFirstPage, PDFInteger mainXRefEntryOffset)
+    {
+        std::shared_ptr<PDFArray> hintStreamArray = std::make_shared<PDFArray>();
+        hintStreamArray->appendItem(PDFObject::createInteger(hintStreamOffset));
+        hintStreamArray->appendItem(PDFObject::createInteger(hintStreamLength));
+
+        PDFDictionary dictionary;
+        dictionary.addEntry(PDFInplaceOrMemoryString("Linearized"), PDFObject::createInteger(1));
+        dictionary.addEntry(PDFInplaceOrMemoryString("L"), PDFObject::createInteger(fileLength));
+        dictionary.addEntry(PDFInplaceOrMemoryString("H"), PDFObject::createArray(qMove(hintStreamArray)));
+        dictionary.addEntry(PDFInplaceOrMemoryString("O"), PDFObject::createInteger(pageSections.front().front().reference.objectNumber));
+        dictionary.addEntry(PDFInplaceOrMemoryString("E"), PDFObject::createInteger(endOfFirstPage));
+        dictionary.addEntry(PDFInplaceOrMemoryString("N"), PDFObject::createInteger(static_cast<PDFInteger>(pageCount)));
+        dictionary.addEntry(PDFInplaceOrMemoryString("T"), PDFObject::createInteger(mainXRefEntryOffset));
+
+        // Linearization parameter dictionary is never encrypted
+        PDFObject dictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionary)));
+        return getSerializedIndirectObject(storage, linearizationDictionaryReference, dictionaryObject, linearizationDictionaryReference);
+    };
+
+    std::vector<XRefStreamEntry> xrefEntries(size);
+    xrefEntries[0].field3 = 65535;
+
+    PDFDictionary trailerDictionary = *PDFObjectUtils::replaceReferences(trailerDictionaryObject, referenceMapping).getDictionary();
+    trailerDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(size));
+
+    auto createFirstPageXRef = [&](PDFInteger mainXRefOffset)
+    {
+        PDFDictionary dictionary = trailerDictionary;
+        dictionary.setEntry(PDFInplaceOrMemoryString("Prev"), PDFObject::createInteger(mainXRefOffset));
+
+        std::vector<XRefStreamEntry> entries(xrefEntries.cbegin() + mainSectionSize, xrefEntries.cend());
+
+        if (m_objectStreamsEnabled)
+        {
+            std::shared_ptr<PDFArray> indexArray = std::make_shared<PDFArray>();
+            indexArray->appendItem(PDFObject::createInteger(mainSectionSize));
+            indexArray->appendItem(PDFObject::createInteger(size - mainSectionSize));
+            dictionary.setEntry(PDFInplaceOrMemoryString("Index"), PDFObject::createArray(qMove(indexArray)));
+
+            // Uncompressed cross-reference stream with fixed field widths has fixed size
+            PDFObject xrefStream = createXRefStream(entries, qMove(dictionary), 5, false);
+            return getSerializedIndirectObject(storage, firstPageXRefReference, xrefStream, firstPageXRefReference);
+        }
+
+        QBuffer buffer;
+        buffer.open(QBuffer::WriteOnly);
+        buffer.write("xref");
+        writeCRLF(&buffer);
+        buffer.write(QString("%1 %2").arg(mainSectionSize).arg(size - mainSectionSize).toLatin1());
+        writeCRLF(&buffer);
+        for (const XRefStreamEntry& entry : entries)
+        {
+            writeXRefEntry(&buffer, entry.field2, 0, true);
+        }
+        buffer.write("trailer");
+        writeCRLF(&buffer);
+        PDFWriteObjectVisitor trailerVisitor(&buffer);
+        PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionary))).accept(&trailerVisitor);
+        buffer.close();
+        return buffer.data();
+    };
+
+    auto pad = [](QByteArray data, qint64 size)
+    {
+        Q_ASSERT(data.size() <= size);
+        data.append(QByteArray(size - data.size(), ' '));
+        return data;
+    };
+
+    const PDFInteger linearizationDictionaryOffset = device->pos();
+    const qint64 linearizationDictionarySize = createLinearizationDictionary(PLACEHOLDER_VALUE, PLACEHOLDER_VALUE, PLACEHOLDER_VALUE, PLACEHOLDER_VALUE, PLACEHOLDER_VALUE).size();
+    const PDFInteger firstPageXRefOffset = linearizationDictionaryOffset + linearizationDictionarySize;
+    const qint64 firstPageXRefSize = createFirstPageXRef(PLACEHOLDER_VALUE).size();
+
+    // Offsets in the hint tables are computed as if the hint stream
+    // was not present in the file, so we compute layout without the hint stream first.
+    auto layoutSection = [](PDFLinearizedSection& section, PDFInteger& offset)
+    {
+        for (PDFLinearizedObject& object : section)
+        {
+            object.offset = offset;
+            offset += object.data.size();
+        }
+    };
+
+    PDFInteger offset = firstPageXRefOffset + firstPageXRefSize + firstPageXRefFooter.size();
+    layoutSection(documentSection, offset);
+    const PDFInteger hintStreamOffset = offset;
+    for (PDFLinearizedSection& section : pageSections)
+    {
+        layoutSection(section, offset);
+    }
+    layoutSection(sharedSection, offset);
+    layoutSection(otherSection, offset);
+
+    // Create hint stream
+    std::vector<PDFInteger> sharedGroups(objectCount, -1);
+    PDFInteger groupIndex = 0;
+    for (const PDFLinearizedSection* section : { &pageSections.front(), &sharedSection })
+    {
+        for (const PDFLinearizedObject& object : *section)
+        {
+            for (PDFInteger objectNumber : object.originalObjectNumbers)
+            {
+                sharedGroups[objectNumber] = groupIndex;
+            }
+            ++groupIndex;
+        }
+    }
+
+    // All objects used by the first page are in the first page section, so first
+    // page doesn't refer to any shared object group.
+    std::vector<std::vector<PDFInteger>> pageSharedGroups(pageCount);
+    for (size_t pageIndex = 1; pageIndex < pageCount; ++pageIndex)
+    {
+        std::set<PDFInteger> groups;
+        for (PDFInteger objectNumber : pageObjects[pageIndex])
+        {
+            if (usage[objectNumber] == Shared)
+            {
+                groups.insert(sharedGroups[objectNumber]);
+            }
+        }
+        pageSharedGroups[pageIndex].assign(groups.cbegin(), groups.cend());
+    }
+
+    PDFInteger sharedObjectHintTableOffset = 0;
+    QByteArray hintStreamData = PDFFlateDecodeFilter::compress(createHintStreamData(pageSections, pageSharedGroups, sharedSection, firstSharedObjectNumber, sharedObjectHintTableOffset));
+
+    PDFDictionary hintStreamDictionary;
+    hintStreamDictionary.addEntry(PDFInplaceOrMemoryString("S"), PDFObject::createInteger(sharedObjectHintTableOffset));
+    hintStreamDictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+    hintStreamDictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(hintStreamData.size()));
+    PDFObject hintStream = PDFObject::createStream(std::make_shared<PDFStream>(qMove(hintStreamDictionary), qMove(hintStreamData)));
+    const QByteArray hintStreamObjectData = getSerializedIndirectObject(storage, hintStreamReference, hintStream, newEncryptObjectReference);
+
+    // Move objects following the hint stream and fill cross-reference entries
+    auto addXRefEntries = [&](PDFLinearizedSection& section, PDFInteger shift)
+    {
+        for (PDFLinearizedObject& object : section)
+        {
+            object.offset += shift;
+
+            XRefStreamEntry& entry = xrefEntries[object.reference.objectNumber];
+            entry.type = 1;
+            entry.field2 = object.offset;
+
+            if (object.isObjectStream)
+            {
+                for (size_t i = 0; i < object.originalObjectNumbers.size(); ++i)
+                {
+                    XRefStreamEntry& packedEntry = xrefEntries[newReferences[object.originalObjectNumbers[i]].objectNumber];
+                    packedEntry.type = 2;
+                    packedEntry.field2 = object.reference.objectNumber;
+                    packedEntry.field3 = static_cast<PDFInteger>(i);
+                }
+            }
+        }
+    };
+
+    const PDFInteger hintStreamLength = hintStreamObjectData.size();
+    addXRefEntries(documentSection, 0);
+    for (PDFLinearizedSection& section : pageSections)
+    {
+        addXRefEntries(section, hintStreamLength);
+    }
+    addXRefEntries(sharedSection, hintStreamLength);
+    addXRefEntries(otherSection, hintStreamLength);
+
+    xrefEntries[linearizationDictionaryReference.objectNumber] = XRefStreamEntry{ 1, linearizationDictionaryOffset, 0 };
+    xrefEntries[hintStreamReference.objectNumber] = XRefStreamEntry{ 1, hintStreamOffset, 0 };
+    if (m_objectStreamsEnabled)
+    {
+        xrefEntries[firstPageXRefReference.objectNumber] = XRefStreamEntry{ 1, firstPageXRefOffset, 0 };
+    }
+
+    // Create main cross-reference section
+    const PDFInteger mainXRefOffset = offset + hintStreamLength;
+    PDFInteger mainXRefEntryOffset = mainXRefOffset;
+    QByteArray mainXRefData;
+    std::vector<XRefStreamEntry> mainXRefEntries(xrefEntries.cbegin(), xrefEntries.cbegin() + mainSectionSize);
+
+    if (m_objectStreamsEnabled)
+    {
+        mainXRefEntries[mainXRefReference.objectNumber] = XRefStreamEntry{ 1, mainXRefOffset, 0 };
+
+        PDFDictionary dictionary;
+        dictionary.addEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(mainSectionSize));
+        PDFObject xrefStream = createXRefStream(mainXRefEntries, qMove(dictionary), 0, true);
+        mainXRefData = getSerializedIndirectObject(storage, mainXRefReference, xrefStream, mainXRefReference);
+    }
+    else
+    {
+        QBuffer buffer;
+        buffer.open(QBuffer::WriteOnly);
+        buffer.write("xref");
+        writeCRLF(&buffer);
+        buffer.write(QString("0 %1").arg(mainSectionSize).toLatin1());
+        writeCRLF(&buffer);
+
+        // Offset of the white-space character preceding the first entry
+        mainXRefEntryOffset = mainXRefOffset + buffer.pos() - 1;
+
+        for (size_t i = 0; i < mainXRefEntries.size(); ++i)
+        {
+            writeXRefEntry(&buffer, mainXRefEntries[i].field2, mainXRefEntries[i].field3, i > 0);
+        }
+
+        PDFDictionary dictionary;
+        dictionary.addEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(mainSectionSize));
+
+        buffer.write("trailer");
+        writeCRLF(&buffer);
+        PDFWriteObjectVisitor trailerVisitor(&buffer);
+        PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionary))).accept(&trailerVisitor);
+        writeCRLF(&buffer);
+        buffer.close();
+        mainXRefData = buffer.data();
+    }
+
+    // Last startxref points to the first page cross-reference section
+    const QByteArray footer = QByteArray("startxref\x0D\x0A") + QByteArray::number(firstPageXRefOffset) + QByteArray("\x0D\x0A%%EOF\x0D\x0A");
+    const PDFInteger fileLength = mainXRefOffset + mainXRefData.size() + footer.size();
+    const PDFInteger endOfFirstPage = pageSections.front().back().offset + pageSections.front().back().data.size();
+
+    // Write the document
+    device->write(pad(createLinearizationDictionary(fileLength, hintStreamOffset, hintStreamLength, endOfFirstPage, mainXRefEntryOffset), linearizationDictionarySize));
+    device->write(pad(createFirstPageXRef(mainXRefOffset), firstPageXRefSize));
+    device->write(firstPageXRefFooter);
+
+    auto writeSection = [device](PDFLinearizedSection& section)
+    {
+        for (PDFLinearizedObject& object : section)
+        {
+            Q_ASSERT(device->pos() == object.offset);
+            device->write(object.data);
+            object.data = QByteArray();
+        }
+    };
+
+    writeSection(documentSection);
+    device->write(hintStreamObjectData);
+    for (PDFLinearizedSection& section : pageSections)
+    {
+        writeSection(section);
+    }
+    writeSection(sharedSection);
+    writeSection(otherSection);
+    device->write(mainXRefData);
+    device->write(footer);
+
+    Q_ASSERT(device->pos() == fileLength);
+    return true;
+}
+
+PDFObject PDFDocumentWriter::createObjectStream(const PDFObjectStorage& storage,
+                                                PDFObjectReference streamReference,
+                                                const std::vector<std::pair<PDFInteger, PDFObject>>& objects)
+{
+    QByteArray offsetTable;
+    QByteArray objectData;
+    for (const auto& item : objects)
+    {
+        offsetTable.append(QByteArray::number(item.first));
+        offsetTable.append(' ');
+        offsetTable.append(QByteArray::number(objectData.size()));
+        offsetTable.append(' ');
+
+        objectData.append(getSerializedObject(item.second));
+        objectData.append('\n');
+    }
+    offsetTable.append('\n');
+
+    const PDFInteger firstObjectOffset = offsetTable.size();
+    QByteArray compressedData = PDFFlateDecodeFilter::compress(offsetTable + objectData);
+
+    PDFDictionary dictionary;
+    dictionary.addEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("ObjStm"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("N"), PDFObject::createInteger(static_cast<PDFInteger>(objects.size())));
+    dictionary.addEntry(PDFInplaceOrMemoryString("First"), PDFObject::createInteger(firstObjectOffset));
+    dictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(compressedData.size()));
+
+    PDFObject streamObject = PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), qMove(compressedData)));
+    if (storage.getSecurityHandler()->getMode() != EncryptionMode::None)
+    {
+        streamObject = storage.getSecurityHandler()->encryptObject(streamObject, streamReference);
+    }
+
+    return streamObject;
+}
+
+PDFObject PDFDocumentWriter::createXRefStream(const std::vector<XRefStreamEntry>& entries, PDFDictionary dictionary, int field2Width, bool compress)
+{
+    if (field2Width <= 0)
+    {
+        PDFInteger maxField2 = 0;
+        for (const XRefStreamEntry& entry : entries)
+        {
+            maxField2 = qMax(maxField2, entry.field2);
+        }
+
+        field2Width = 1;
+        while (field2Width < 8 && (maxField2 >> (8 * field2Width)) > 0)
+        {
+            ++field2Width;
+        }
+    }
+
+    const int entryWidths[3] = { 1, field2Width, 2 };
+
+    QByteArray xrefData;
+    xrefData.reserve(entries.size() * (entryWidths[0] + entryWidths[1] + entryWidths[2]));
+    for (const XRefStreamEntry& entry : entries)
+    {
+        const PDFInteger values[3] = { entry.type, entry.field2, entry.field3 };
+        for (int field = 0; field < 3; ++field)
+        {
+            for (int byteIndex = entryWidths[field] - 1; byteIndex >= 0; --byteIndex)
+            {
+                xrefData.append(static_cast<char>((values[field] >> (8 * byteIndex)) & 0xFF));
+            }
+        }
+    }
+
+    std::shared_ptr<PDFArray> widthArray = std::make_shared<PDFArray>();
+    for (int width : entryWidths)
+    {
+        widthArray->appendItem(PDFObject::createInteger(width));
+    }
+
+    dictionary.setEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("XRef"));
+    dictionary.setEntry(PDFInplaceOrMemoryString("W"), PDFObject::createArray(qMove(widthArray)));
+
+    if (compress)
+    {
+        xrefData = PDFFlateDecodeFilter::compress(xrefData);
+        dictionary.setEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+    }
+
+    dictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(xrefData.size()));
+    return PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), qMove(xrefData)));
+}
+
+PDFObject PDFDocumentWriter::createTrailerDictionary(const PDFDocument* document)
+{
+    // Jakub Melka: Adjust trailer dictionary, to be really dictionary, not a stream
+    PDFDictionary trailerDictionary = *document->getTrailerDictionary();
+    PDFDictionary newTrailerDictionary;
+
+    for (const char* entry : { "Size", "Root", "Encrypt", "Info", "ID"})
+    {
+        PDFObject object = trailerDictionary.get(entry);
+        if (!object.isNull())
+        {
+            newTrailerDictionary.addEntry(PDFInplaceOrMemoryString(entry), qMove(object));
+        }
+    }
+
+    return PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(newTrailerDictionary)));
+}
+
+PDFObjectReference PDFDocumentWriter::getEncryptObjectReference(const PDFDocument* document)
+{
+    PDFObject encryptObject = document->getTrailerDictionary()->get("Encrypt");
+    if (encryptObject.isReference())
+    {
+        return encryptObject.getReference();
+    }
+
+    return PDFObjectReference();
+}
+
+class PDFSizeCounterIODevice : public QIODevice
+{
+public:
+    explicit PDFSizeCounterIODevice(QObject* parent) :
+        QIODevice(parent)
+    {
+
+    }
+
+    virtual bool isSequential() const override;
+    virtual bool open(OpenMode mode) override;
+    virtual void close() override;
+    virtual qint64 pos() const override;
+    virtual qint64 size() const override;
+    virtual bool seek(qint64 pos) override;
+    virtual bool atEnd() const override;
+    virtual bool reset() override;
+    virtual qint64 bytesAvailable() const override;
+    virtual qint64 bytesToWrite() const override;
+    virtual bool canReadLine() const override;
+    virtual bool waitForReadyRead(int msecs) override;
+    virtual bool waitForBytesWritten(int msecs) override;
+
+protected:
+    virtual qint64 readData(char* data, qint64 maxlen) override;
+    virtual qint64 readLineData(char* data, qint64 maxlen) override;
+    virtual qint64 writeData(const char* data, qint64 len) override;
+
+private:
+    OpenMode m_openMode = NotOpen;
+    qint64 m_fileSize = 0;
+};
+
+bool PDFSizeCounterIODevice::isSequential() const
+{
+    return true;
+}
+
+bool PDFSizeCounterIODevice::open(OpenMode mode)
+{
+    if (m_openMode == NotOpen)
+    {
+        setOpenMode(mode);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void PDFSizeCounterIODevice::close()
+{
+    setOpenMode(NotOpen);
+}
+
+qint64 PDFSizeCounterIODevice::pos() const
+{
+    return m_fileSize;
+}
+
+qint64 PDFSizeCounterIODevice::size() const
+{
+    return m_fileSize;
+}
+
+bool PDFSizeCounterIODevice::seek(qint64 pos)
+{
+    Q_UNUSED(pos);
+
+    return false;
+}
+
+bool PDFSizeCounterIODevice::atEnd() const
+{
+    return true;
+}
+
+bool PDFSizeCounterIODevice::reset()
+{
+    return false;
+}
+
+qint64 PDFSizeCounterIODevice::bytesAvailable() const
+{
+    return 0;
+}
+
+qint64 PDFSizeCounterIODevice::bytesToWrite() const
+{
+    return 0;
+}
+
+bool PDFSizeCounterIODevice::canReadLine() const
+{
+    return false;
+}
+
+bool PDFSizeCounterIODevice::waitForReadyRead(int msecs)
+{
+    Q_UNUSED(msecs);
+
+    return false;
+}
+
+bool PDFSizeCounterIODevice::waitForBytesWritten(int msecs)
+{
+    Q_UNUSED(msecs);
+
+    return false;
+}
+
+qint64 PDFSizeCounterIODevice::readData(char* data, qint64 maxlen)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxlen);
+
+    return 0;
+}
+
+qint64 PDFSizeCounterIODevice::readLineData(char* data, qint64 maxlen)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxlen);
+
+    return 0;
+}
+
+qint64 PDFSizeCounterIODevice::writeData(const char* data, qint64 len)
+{
+    Q_UNUSED(data);
+
+    m_fileSize += len;
+    return len;
+}
+
+qint64 PDFDocumentWriter::getDocumentFileSize(const PDFDocument* document)
+{
+    PDFSizeCounterIODevice device(nullptr);
+    PDFDocumentWriter writer(nullptr);
+
+    device.open(QIODevice::WriteOnly);
+
+    if (writer.write(&device, document))
+    {
+        device.close();
+        return device.pos();
+    }
+
+    device.close();
+    return -1;
+}
+
+qint64 PDFDocumentWriter::getObjectSize(const PDFDocument* document, PDFObjectReference reference)
+{
+    const PDFObject& object = document->getObjectByReference(reference);
+
+    if (object.isNull())
+    {
+        return 0;
+    }
+
+    PDFSizeCounterIODevice device(nullptr);
+
+    device.open(QIODevice::WriteOnly);
+
+    PDFWriteObjectVisitor visitor(&device);
+    writeObjectHeader(&device, reference);
+    object.accept(&visitor);
+    writeObjectFooter(&device);
+
+    device.close();
     return device.pos();
 }
 
@@ -577,4 +1902,110 @@ QByteArray PDFDocumentWriter::getSerializedObject(const PDFObject& object)
     return buffer.data();
 }
 
+PDFStreamDocumentWriter::PDFStreamDocumentWriter(QIODevice* device) :
+    m_device(device)
+{
+
+}
+
+PDFOperationResult PDFStreamDocumentWriter::begin(PDFVersion version)
+{
+    if (!m_device->isWritable())
+    {
+        return tr("Device is not writable.");
+    }
+
+    m_device->write(QString("%PDF-%1.%2").arg(version.major).arg(version.minor).toLatin1());
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write("% PDF producer: ");
+    m_device->write(PDF_LIBRARY_NAME);
+    PDFDocumentWriter::writeCRLF(m_device);
+    PDFDocumentWriter::writeCRLF(m_device);
+    PDFDocumentWriter::writeCRLF(m_device);
+
+    return true;
+}
+
+void PDFStreamDocumentWriter::writeObjects(const std::vector<std::pair<PDFObjectReference, PDFObject>>& objects)
+{
+    const size_t batchSize = PDFDocumentWriter::WRITE_BATCH_OBJECT_COUNT;
+
+    std::vector<QByteArray> serializedObjects;
+    for (size_t batchStart = 0; batchStart < objects.size(); batchStart += batchSize)
+    {
+        const size_t batchEnd = qMin(batchStart + batchSize, objects.size());
+
+        serializedObjects.assign(batchEnd - batchStart, QByteArray());
+        auto serializeObject = [&](size_t i)
+        {
+            const PDFObjectReference reference = objects[i].first;
+            QString objectHeader = QString("%1 %2 obj\x0D\x0A").arg(QString::number(reference.objectNumber), QString::number(reference.generation));
+
+            QByteArray& data = serializedObjects[i - batchStart];
+            data = objectHeader.toLatin1();
+            data.append(PDFDocumentWriter::getSerializedObject(objects[i].second));
+            data.append("endobj\x0D\x0A");
+        };
+
+        PDFIntegerRange<size_t> batchRange(batchStart, batchEnd);
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, batchRange.begin(), batchRange.end(), serializeObject);
+
+        for (size_t i = batchStart; i < batchEnd; ++i)
+        {
+            const PDFObjectReference reference = objects[i].first;
+            const size_t objectNumber = static_cast<size_t>(reference.objectNumber);
+            if (m_xrefEntries.size() <= objectNumber)
+            {
+                m_xrefEntries.resize(objectNumber + 1);
+            }
+
+            m_xrefEntries[objectNumber].offset = m_device->pos();
+            m_xrefEntries[objectNumber].generation = reference.generation;
+            m_device->write(serializedObjects[i - batchStart]);
+            serializedObjects[i - batchStart] = QByteArray();
+        }
+    }
+}
+
+PDFOperationResult PDFStreamDocumentWriter::end(PDFDictionary trailerDictionary)
+{
+    if (m_xrefEntries.empty())
+    {
+        m_xrefEntries.resize(1);
+    }
+
+    const size_t objectCount = m_xrefEntries.size();
+
+    // Write cross-reference table
+    PDFInteger xrefOffset = m_device->pos();
+    m_device->write("xref");
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write(QString("0 %1").arg(objectCount).toLatin1());
+    PDFDocumentWriter::writeCRLF(m_device);
+
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const XRefEntry& entry = m_xrefEntries[i];
+        const bool isOccupied = i > 0 && entry.offset != -1;
+        PDFDocumentWriter::writeXRefEntry(m_device, isOccupied ? entry.offset : 0, i > 0 ? entry.generation : 65535, isOccupied);
+    }
+
+    trailerDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(PDFInteger(objectCount)));
+    PDFObject trailerDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(trailerDictionary)));
+
+    m_device->write("trailer");
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write(PDFDocumentWriter::getSerializedObject(trailerDictionaryObject));
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write("startxref");
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write(QString::number(xrefOffset).toLatin1());
+    PDFDocumentWriter::writeCRLF(m_device);
+
+    // Write footer
+    m_device->write("%%EOF");
+
+    return true;
+}
+
 }   // namespace pdf
@@ -56,6 +56,64 @@ public:
     /// \param document Document
     PDFOperationResult write(QIODevice* device, const PDFDocument* document);
 
+    /// Appends incremental update of the document to the end of the file. File must
+    /// contain the original document, from which the document was read. Only modified
+    /// and new objects are written (see \p PDFObjectStorage::getModifiedObjects), followed
+    /// by a new cross-reference section and trailer, referring to the previous one.
+    /// Incremental update is not possible, if security handler was changed. If writing
+    /// fails, file is truncated to its original size.
+    /// \param fileName File name
+    /// \param document Document
+    PDFOperationResult writeIncremental(const QString& fileName, const PDFDocument* document);
+
+    /// Appends incremental update of the document to the end of the device. Device
+    /// must contain the original document data, from which the document was read,
+    /// and it must be opened for reading and writing.
+    /// \param device Device containing the original document
+    /// \param document Document
+    PDFOperationResult writeIncremental(QIODevice* device, const PDFDocument* document);
+
+    /// Enables or disables writing of object streams. If enabled, all objects,
+    /// which are not streams, are packed into compressed object streams, and
+    /// cross-reference stream is written instead of cross-reference table.
+    /// Object streams are created in parallel. Object streams are supported
+    /// from PDF 1.5, so document version is raised, if it is lower. Incremental
+    /// updates are always written without object streams.
+    /// \param enabled Enable object streams
+    void setObjectStreamsEnabled(bool enabled) { m_objectStreamsEnabled = enabled; }
+
+    /// Returns true, if object streams are written
+    bool isObjectStreamsEnabled() const { return m_objectStreamsEnabled; }
+
+    /// Sets maximal number of objects stored in one object stream. Index of the
+    /// object in the object stream is written in two bytes of the cross-reference
+    /// stream entry, so value is clamped to range [1, MAX_OBJECTS_PER_STREAM].
+    /// \param objectsPerStream Number of objects per stream
+    void setObjectsPerStream(int objectsPerStream) { m_objectsPerStream = qBound(1, objectsPerStream, MAX_OBJECTS_PER_STREAM); }
+
+    /// Returns maximal number of objects stored in one object stream
+    int getObjectsPerStream() const { return m_objectsPerStream; }
+
+    /// Default number of objects stored in one object stream
+    static constexpr int DEFAULT_OBJECTS_PER_STREAM = 100;
+
+    /// Maximal number of objects stored in one object stream
+    static constexpr int MAX_OBJECTS_PER_STREAM = 65535;
+
+    /// Enables or disables writing of linearized documents ("Fast Web View").
+    /// Objects are renumbered and reordered, so objects of the first page are
+    /// written first, followed by objects of the other pages (in page order),
+    /// objects shared by multiple pages and remaining objects. Linearization
+    /// parameter dictionary and hint tables are written, so viewer can display
+    /// pages as they are downloaded. If object streams are enabled, objects
+    /// of each page are packed into their own object streams. Linearized
+    /// document is assembled in memory. Incremental updates are never linearized.
+    /// \param enabled Enable linearization
+    void setLinearizationEnabled(bool enabled) { m_linearizationEnabled = enabled; }
+
+    /// Returns true, if linearized document is written
+    bool isLinearizationEnabled() const { return m_linearizationEnabled; }
+
     /// Calculates document file size, as if it is written to the disk.
     /// No file is accessed by this function; document is written
     /// to fake stream, which counts operations. If error occurs, and
@@ -73,12 +131,116 @@ public:
     static QByteArray getSerializedObject(const PDFObject& object);
 
 private:
+    friend class PDFStreamDocumentWriter;
+
     static void writeCRLF(QIODevice* device);
     static void writeObjectHeader(QIODevice* device, PDFObjectReference reference);
     static void writeObjectFooter(QIODevice* device);
+    static void writeObject(QIODevice* device, const PDFObjectStorage& storage, PDFObjectReference reference, const PDFObject& object, PDFObjectReference encryptObjectReference);
+    static QByteArray getSerializedIndirectObject(const PDFObjectStorage& storage, PDFObjectReference reference, const PDFObject& object, PDFObjectReference encryptObjectReference);
+
+    /// Writes objects to the device. Objects are serialized in parallel, in batches
+    /// of limited size, and written in order using large buffered writes.
+    /// Offsets of the objects in the device are stored in \p offsets.
+    /// \param device Output device
+    /// \param storage Object storage
+    /// \param references References of objects to be written
+    /// \param encryptObjectReference Reference of encryption dictionary (it is not encrypted)
+    /// \param[out] offsets Offsets of written objects
+    static void writeObjects(QIODevice* device,
+                             const PDFObjectStorage& storage,
+                             const std::vector<PDFObjectReference>& references,
+                             PDFObjectReference encryptObjectReference,
+                             std::vector<PDFInteger>& offsets);
+    static void writeXRefEntry(QIODevice* device, PDFInteger offset, PDFInteger generation, bool isOccupied);
+    static PDFObject createTrailerDictionary(const PDFDocument* document);
+    static PDFObjectReference getEncryptObjectReference(const PDFDocument* document);
+
+    struct XRefStreamEntry
+    {
+        PDFInteger type = 0;
+        PDFInteger field2 = 0;  ///< Offset (type 1), or object stream number (type 2)
+        PDFInteger field3 = 0;  ///< Generation number (type 0/1), or index in object stream (type 2)
+    };
+
+    /// Writes objects packed into object streams, followed by cross-reference
+    /// stream and its position (startxref keyword).
+    void writeObjectStreams(QIODevice* device, const PDFDocument* document, PDFObjectReference encryptObjectReference) const;
+
+    /// Writes linearized document (without header), see \p setLinearizationEnabled.
+    PDFOperationResult writeLinearized(QIODevice* device, const PDFDocument* document, PDFObjectReference encryptObjectReference) const;
+
+    /// Creates object stream containing given objects. Object stream is encrypted,
+    /// if document is encrypted.
+    /// \param storage Object storage
+    /// \param streamReference Reference of the object stream
+    /// \param objects Object numbers and objects to be packed
+    static PDFObject createObjectStream(const PDFObjectStorage& storage,
+                                        PDFObjectReference streamReference,
+                                        const std::vector<std::pair<PDFInteger, PDFObject>>& objects);
+
+    /// Creates cross-reference stream from the entries. If \p field2Width is zero,
+    /// then width of the second field is determined from the entries. Uncompressed
+    /// stream with fixed field widths has size independent on values of the entries.
+    /// \param entries Cross-reference entries
+    /// \param dictionary Stream dictionary (trailer entries, Index, ...)
+    /// \param field2Width Width of the second field, or zero
+    /// \param compress Compress the stream using flate filter
+    static PDFObject createXRefStream(const std::vector<XRefStreamEntry>& entries, PDFDictionary dictionary, int field2Width, bool compress);
+
+    /// Size of the buffer used for writing objects to the device
+    static constexpr qint64 WRITE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+    /// Maximal number of objects serialized at once
+    static constexpr size_t WRITE_BATCH_OBJECT_COUNT = 4096;
+
+    /// Maximal stream data size of objects serialized at once
+    static constexpr qint64 WRITE_BATCH_DATA_SIZE = 64 * 1024 * 1024;
 
     /// Progress indicator
     PDFProgress* m_progress;
+
+    bool m_objectStreamsEnabled = false;
+    int m_objectsPerStream = DEFAULT_OBJECTS_PER_STREAM;
+    bool m_linearizationEnabled = false;
+};
+
+/// Writes document directly to the output device, object by object, so the whole
+/// document is never held in memory. Caller is responsible for the object numbering,
+/// each object can be written only once, in arbitrary order. Objects, which were not
+/// written, are marked as free in the cross-reference table. Document is not encrypted.
+class PDF4QTLIBCORESHARED_EXPORT PDFStreamDocumentWriter
+{
+    Q_DECLARE_TR_FUNCTIONS(pdf::PDFStreamDocumentWriter)
+
+public:
+    /// Constructs stream writer. Device must be writable (i.e. opened for writing).
+    /// \param device Output device
+    explicit PDFStreamDocumentWriter(QIODevice* device);
+
+    /// Writes the header of the document. Must be called before any object is written.
+    /// \param version Version of the document
+    PDFOperationResult begin(PDFVersion version);
+
+    /// Writes objects to the device. Objects are serialized in parallel
+    /// and written in the given order.
+    /// \param objects References and objects to be written
+    void writeObjects(const std::vector<std::pair<PDFObjectReference, PDFObject>>& objects);
+
+    /// Writes cross-reference table, trailer and footer of the document.
+    /// Size entry of the trailer dictionary is set automatically.
+    /// \param trailerDictionary Trailer dictionary (Root, Info, ID, ...)
+    PDFOperationResult end(PDFDictionary trailerDictionary);
+
+private:
+    struct XRefEntry
+    {
+        PDFInteger offset = -1;
+        PDFInteger generation = 0;
+    };
+
+    QIODevice* m_device;
+    std::vector<XRefEntry> m_xrefEntries;
 };
 
 }   // namespace pdf
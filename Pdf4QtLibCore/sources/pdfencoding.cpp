@@ -16,6 +16,7 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdfencoding.h"
+#include "pdfutils.h"
 
 #include <QTimeZone>
 #include <QStringDecoder>
@@ -32,7 +33,7 @@ namespace encoding
 {
 
 // PDF Reference 1.7, Appendix D, Section D.1, StandardEncoding
-static const EncodingTable STANDARD_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable STANDARD_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -292,7 +293,7 @@ static const EncodingTable STANDARD_ENCODING_CONVERSION_TABLE = {
 };
 
 // PDF Reference 1.7, Appendix D, Section D.1, MacRomanEncoding
-static const EncodingTable MAC_ROMAN_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable MAC_ROMAN_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -552,7 +553,7 @@ static const EncodingTable MAC_ROMAN_ENCODING_CONVERSION_TABLE = {
 };
 
 // PDF Reference 1.7, Appendix D, Section D.1, WinAnsiEncoding
-static const EncodingTable WIN_ANSI_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable WIN_ANSI_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -812,7 +813,7 @@ static const EncodingTable WIN_ANSI_ENCODING_CONVERSION_TABLE = {
 };
 
 // PDF Reference 1.7, Appendix D, Section D.1/D.2, PDFDocEncoding
-static const EncodingTable PDF_DOC_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable PDF_DOC_ENCODING_CONVERSION_TABLE = {
     QChar(0x0000),  // Hex No. 00 (Dec 000) Null character
     QChar(0x0001),  // Hex No. 01 (Dec 001)
     QChar(0x0002),  // Hex No. 02 (Dec 002)
@@ -1072,7 +1073,7 @@ static const EncodingTable PDF_DOC_ENCODING_CONVERSION_TABLE = {
 };
 
 // PDF Reference 1.7, Appendix D, Section D.3, MacExpertEncoding
-static const EncodingTable MAC_EXPERT_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable MAC_EXPERT_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -1332,7 +1333,7 @@ static const EncodingTable MAC_EXPERT_ENCODING_CONVERSION_TABLE = {
 };
 
 // PDF Reference 1.7, Appendix D, Section D.4, Symbol Set and Encoding
-static const EncodingTable SYMBOL_SET_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable SYMBOL_SET_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -1592,7 +1593,7 @@ static const EncodingTable SYMBOL_SET_ENCODING_CONVERSION_TABLE = {
 };
 
 // PDF Reference 1.7, Appendix D, Section D.5, Zapf Dingbats Set and Encoding
-static const EncodingTable ZAPF_DINGBATS_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable ZAPF_DINGBATS_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -1852,7 +1853,7 @@ static const EncodingTable ZAPF_DINGBATS_ENCODING_CONVERSION_TABLE = {
 };
 
 // Mac OS encoding
-static const EncodingTable MAC_OS_ENCODING_CONVERSION_TABLE = {
+static constexpr EncodingTable MAC_OS_ENCODING_CONVERSION_TABLE = {
     QChar(0xfffd),  // Hex No. 00 (Dec 000) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 01 (Dec 001) REPLACEMENT CHARACTER 0xFFFD - not present in character set
     QChar(0xfffd),  // Hex No. 02 (Dec 002) REPLACEMENT CHARACTER 0xFFFD - not present in character set
@@ -2111,6 +2112,124 @@ static const EncodingTable MAC_OS_ENCODING_CONVERSION_TABLE = {
     QChar(0x02c7),  // Hex No. FF (Dec 255) Character 'ˇ' Letter
 };
 
+/// Reverse conversion table of the encoding, which maps unicode characters
+/// to the character codes using perfect hash constructed at compile time.
+/// If character is present in the encoding more than once, then the lowest
+/// character code is used.
+class ReverseEncodingTable
+{
+public:
+    constexpr explicit ReverseEncodingTable(const EncodingTable& table) :
+        m_characters(getCharacters(table)),
+        m_perfectHash(getHashes(m_characters), m_characters.count)
+    {
+
+    }
+
+    /// Finds character code of the unicode character. If character
+    /// is not present in the encoding, false is returned.
+    /// \param character Unicode character
+    /// \param[out] code Character code
+    constexpr bool find(char16_t character, unsigned char& code) const
+    {
+        const size_t index = m_perfectHash.find(PDFStaticPerfectHash<ENCODING_SIZE>::getHash(uint64_t(character)));
+        if (index < m_characters.count && m_characters.characters[index] == character)
+        {
+            code = m_characters.codes[index];
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    static constexpr size_t ENCODING_SIZE = std::tuple_size_v<EncodingTable>;
+
+    struct Characters
+    {
+        std::array<char16_t, ENCODING_SIZE> characters = { };
+        std::array<unsigned char, ENCODING_SIZE> codes = { };
+        size_t count = 0;
+    };
+
+    static constexpr Characters getCharacters(const EncodingTable& table)
+    {
+        Characters result;
+
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            const char16_t character = table[i].unicode();
+            if (std::find(result.characters.cbegin(), result.characters.cbegin() + result.count, character) == result.characters.cbegin() + result.count)
+            {
+                result.characters[result.count] = character;
+                result.codes[result.count] = static_cast<unsigned char>(i);
+                ++result.count;
+            }
+        }
+
+        return result;
+    }
+
+    static constexpr std::array<uint64_t, ENCODING_SIZE> getHashes(const Characters& characters)
+    {
+        std::array<uint64_t, ENCODING_SIZE> hashes = { };
+        for (size_t i = 0; i < characters.count; ++i)
+        {
+            hashes[i] = PDFStaticPerfectHash<ENCODING_SIZE>::getHash(uint64_t(characters.characters[i]));
+        }
+        return hashes;
+    }
+
+    Characters m_characters;
+    PDFStaticPerfectHash<ENCODING_SIZE> m_perfectHash;
+};
+
+static constexpr ReverseEncodingTable STANDARD_ENCODING_REVERSE_TABLE(STANDARD_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable MAC_ROMAN_ENCODING_REVERSE_TABLE(MAC_ROMAN_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable WIN_ANSI_ENCODING_REVERSE_TABLE(WIN_ANSI_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable PDF_DOC_ENCODING_REVERSE_TABLE(PDF_DOC_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable MAC_EXPERT_ENCODING_REVERSE_TABLE(MAC_EXPERT_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable SYMBOL_SET_ENCODING_REVERSE_TABLE(SYMBOL_SET_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable ZAPF_DINGBATS_ENCODING_REVERSE_TABLE(ZAPF_DINGBATS_ENCODING_CONVERSION_TABLE);
+static constexpr ReverseEncodingTable MAC_OS_ENCODING_REVERSE_TABLE(MAC_OS_ENCODING_CONVERSION_TABLE);
+
+static const ReverseEncodingTable* getReverseTableForEncoding(PDFEncoding::Encoding encoding)
+{
+    switch (encoding)
+    {
+        case PDFEncoding::Encoding::Standard:
+            return &STANDARD_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::MacRoman:
+            return &MAC_ROMAN_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::WinAnsi:
+            return &WIN_ANSI_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::PDFDoc:
+            return &PDF_DOC_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::MacExpert:
+            return &MAC_EXPERT_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::Symbol:
+            return &SYMBOL_SET_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::ZapfDingbats:
+            return &ZAPF_DINGBATS_ENCODING_REVERSE_TABLE;
+
+        case PDFEncoding::Encoding::MacOsRoman:
+            return &MAC_OS_ENCODING_REVERSE_TABLE;
+
+        default:
+            break;
+    }
+
+    // Unknown encoding?
+    Q_ASSERT(false);
+    return nullptr;
+}
+
 } // namespace encoding
 
 QString PDFEncoding::convert(const QByteArray& stream, PDFEncoding::Encoding encoding)
@@ -2139,22 +2258,16 @@ QByteArray PDFEncoding::convertToEncoding(const QString& string, Encoding encodi
 {
     QByteArray result;
 
-    const encoding::EncodingTable* table = getTableForEncoding(encoding);
+    const encoding::ReverseEncodingTable* table = encoding::getReverseTableForEncoding(encoding);
     Q_ASSERT(table);
 
     result.reserve(string.size());
     for (QChar character : string)
     {
-        ushort unicode = character.unicode();
         unsigned char converted = 0;
-
-        for (size_t i = 0; i < table->size(); ++i)
+        if (!table->find(character.unicode(), converted))
         {
-            if (unicode == (*table)[static_cast<unsigned char>(i)])
-            {
-                converted = static_cast<unsigned char>(i);
-                break;
-            }
+            converted = 0;
         }
 
         result.push_back(converted);
@@ -2165,25 +2278,14 @@ QByteArray PDFEncoding::convertToEncoding(const QString& string, Encoding encodi
 
 bool PDFEncoding::canConvertToEncoding(const QString& string, Encoding encoding, QString* invalidCharacters)
 {
-    const encoding::EncodingTable* table = getTableForEncoding(encoding);
+    const encoding::ReverseEncodingTable* table = encoding::getReverseTableForEncoding(encoding);
     Q_ASSERT(table);
 
     bool isConvertible = true;
     for (QChar character : string)
     {
-        ushort unicode = character.unicode();
-        bool converted = false;
-
-        for (int i = 0; i < static_cast< int >(table->size()); ++i)
-        {
-            if (unicode == (*table)[static_cast<unsigned char>(i)])
-            {
-                converted = true;
-                break;
-            }
-        }
-
-        if (!converted)
+        unsigned char code = 0;
+        if (!table->find(character.unicode(), code))
         {
             isConvertible = false;
 
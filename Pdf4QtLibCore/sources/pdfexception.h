@@ -18,7 +18,10 @@
 #ifndef PDFEXCEPTION_H
 #define PDFEXCEPTION_H
 
+#include "pdfglobal.h"
+
 #include <QString>
+#include <QStringList>
 
 namespace pdf
 {
@@ -48,6 +51,11 @@ enum RenderErrorType
     Information
 };
 
+/// Render error. Message of the error is either formatted when error
+/// is created, or error is a compact record of message template and
+/// its arguments, and message is formatted only, when it is needed.
+/// Same errors reported repeatedly are merged into one record with
+/// the count of occurrences.
 struct PDFRenderError
 {
     explicit PDFRenderError() = default;
@@ -58,8 +66,46 @@ struct PDFRenderError
 
     }
 
+    /// Creates error, whose message is formatted by \p getMessage.
+    /// \param type Error type
+    /// \param messageTemplate Untranslated message of PDFTranslationContext (string literal,
+    ///        marked by QT_TRANSLATE_NOOP), it must exist during whole program run
+    /// \param arguments Arguments of the message
+    explicit PDFRenderError(RenderErrorType type, const char* messageTemplate, QStringList arguments) :
+        type(type),
+        messageTemplate(messageTemplate),
+        arguments(std::move(arguments))
+    {
+
+    }
+
+    /// Returns translated message of the error
+    QString getMessage() const
+    {
+        if (!messageTemplate)
+        {
+            return message;
+        }
+
+        QString result = PDFTranslationContext::tr(messageTemplate);
+        for (const QString& argument : arguments)
+        {
+            result = result.arg(argument);
+        }
+        return result;
+    }
+
+    /// Returns true, if errors are the same (they can differ in count of occurrences)
+    bool isSameError(const PDFRenderError& other) const
+    {
+        return type == other.type && messageTemplate == other.messageTemplate && message == other.message && arguments == other.arguments;
+    }
+
     RenderErrorType type = RenderErrorType::Error;
     QString message;
+    const char* messageTemplate = nullptr;
+    QStringList arguments;
+    PDFInteger count = 1;
 };
 
 class PDFRendererException : public std::exception
@@ -71,6 +117,12 @@ public:
 
     }
 
+    explicit PDFRendererException(PDFRenderError error) :
+        m_error(std::move(error))
+    {
+
+    }
+
     const PDFRenderError& getError() const { return m_error; }
 
 private:
@@ -89,6 +141,11 @@ public:
     /// \param message Error message
     virtual void reportRenderError(RenderErrorType type, QString message) = 0;
 
+    /// Reports render error record. Default implementation formats
+    /// the message, reporters can override it to format it lazily.
+    /// \param error Error
+    virtual void reportRenderError(const PDFRenderError& error) { reportRenderError(error.type, error.getMessage()); }
+
     /// Reports render error, but only once - if same error was already reported,
     /// then no new error is reported.
     /// \param type Error type
@@ -106,6 +163,11 @@ public:
         Q_UNUSED(message);
     }
 
+    virtual void reportRenderError(const PDFRenderError& error) override
+    {
+        Q_UNUSED(error);
+    }
+
     virtual void reportRenderErrorOnce(RenderErrorType type, QString message) override
     {
         Q_UNUSED(type);
@@ -17,29 +17,504 @@
 
 #include "pdfexecutionpolicy.h"
 
+#include <QMutex>
 #include <QThread>
+#include <QWaitCondition>
 #include <QCoreApplication>
 
+#include <array>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
 {
 
+/// Group of tasks created by one call of execute function. Tasks are claimed
+/// using atomic counter, so one group can be processed by several threads
+/// at once, and threads, which finished their work, can steal remaining
+/// tasks from the group.
+struct PDFExecutionTaskGroup
+{
+    explicit PDFExecutionTaskGroup(PDFExecutionPolicy::Scope scope,
+                                   size_t taskCount,
+                                   int maxParticipants,
+                                   const std::function<void(size_t)>* task) :
+        scope(scope),
+        taskCount(taskCount),
+        maxParticipants(maxParticipants),
+        task(task)
+    {
+
+    }
+
+    bool hasUnclaimedTasks() const { return nextTask.load(std::memory_order_relaxed) < taskCount; }
+    bool isFinished() const { return finishedTasks.load(std::memory_order_acquire) == taskCount; }
+
+    PDFExecutionPolicy::Scope scope;
+    size_t taskCount;
+    int maxParticipants;
+    const std::function<void(size_t)>* task;
+    std::atomic<size_t> nextTask = 0;
+    std::atomic<size_t> finishedTasks = 0;
+    std::atomic<int> participants = 0;
+
+    QMutex exceptionMutex;
+    std::exception_ptr exception;
+};
+
+using PDFExecutionTaskGroupPointer = std::shared_ptr<PDFExecutionTaskGroup>;
+
+/// Work-stealing executor. Each worker thread has its own deque of task groups.
+/// Groups submitted from worker thread (nested parallelism) are pushed to the
+/// worker's own deque, groups submitted from other threads are pushed to the
+/// shared injection deque. Worker takes work from the back of its own deque
+/// (most recently submitted, i.e. nested work first) and steals work from
+/// the front of the other deques.
+class PDFWorkStealingExecutor
+{
+public:
+    explicit PDFWorkStealingExecutor() = default;
+    ~PDFWorkStealingExecutor() { stop(); }
+
+    /// Executes tasks, calling thread participates on the work
+    void execute(PDFExecutionPolicy::Scope scope, size_t taskCount, int maxParticipants, const std::function<void(size_t)>& task);
+
+    /// Stops all worker threads, pending work is finished by calling threads
+    void stop();
+
+    /// Returns number of threads actually processing tasks of given scope
+    int getActiveThreadCount(PDFExecutionPolicy::Scope scope) const;
+
+    /// Returns global thread budget
+    int getThreadBudget() const { return m_threadBudget.load(std::memory_order_relaxed); }
+
+    /// Sets global thread budget
+    void setThreadBudget(int threadBudget);
+
+    /// Acquires up to \p count tokens from the thread budget, returns
+    /// number of acquired tokens.
+    int acquireThreadTokens(int count);
+
+    /// Releases tokens, workers, which were unable to acquire token,
+    /// are woken up, so they can try again.
+    void releaseThreadTokens(int count);
+
+private:
+    struct WorkerQueue
+    {
+        QMutex mutex;
+        std::deque<PDFExecutionTaskGroupPointer> groups;
+    };
+
+    /// Starts worker threads, if they were not started yet
+    void ensureStarted();
+
+    /// Main loop of worker thread
+    void workerLoop(size_t workerIndex);
+
+    /// Pushes group to the deque of current thread and wakes up workers
+    void submit(PDFExecutionTaskGroupPointer group);
+
+    /// Finds a pending group and processes its tasks. Returns true,
+    /// if some task was processed.
+    /// \param queueIndex Queue of current thread
+    bool runPendingTasks(size_t queueIndex);
+
+    /// Tries to take pending group from the queue. If \p fromBack is true,
+    /// then groups are taken from the most recent one, otherwise from the
+    /// oldest one. Exhausted groups are removed from the queue.
+    bool runPendingTasksFromQueue(WorkerQueue* queue, bool fromBack);
+
+    /// Processes tasks of the group. Returns true, if at least one task
+    /// was processed. If \p force is false, then participant limit
+    /// of the group is respected.
+    bool runGroup(PDFExecutionTaskGroup* group, bool force);
+
+    static size_t getScopeIndex(PDFExecutionPolicy::Scope scope) { return static_cast<size_t>(scope); }
+
+    std::once_flag m_startFlag;
+    std::atomic_bool m_stopped = false;
+
+    /// Worker queues, last queue is injection queue for non-worker threads
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<QThread*> m_threads;
+
+    QMutex m_mutex;
+    QWaitCondition m_workAvailable;
+    QWaitCondition m_taskFinished;
+    uint64_t m_generation = 0;
+
+    std::array<std::atomic<int>, 3> m_activeThreadCount = { };
+
+    std::atomic<int> m_threadBudget = qMax(1, QThread::idealThreadCount());
+    std::atomic<int> m_usedThreadTokens = 0;
+    std::atomic_bool m_tokenStarvation = false;
+};
+
+/// Index of the worker queue for worker threads, or -1 for other threads
+static thread_local int s_workerIndex = -1;
+
+/// True, if worker thread holds a token from the thread budget
+static thread_local bool s_holdsThreadToken = false;
+
+void PDFWorkStealingExecutor::execute(PDFExecutionPolicy::Scope scope,
+                                      size_t taskCount,
+                                      int maxParticipants,
+                                      const std::function<void(size_t)>& task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+
+    ensureStarted();
+
+    PDFExecutionTaskGroupPointer group = std::make_shared<PDFExecutionTaskGroup>(scope, taskCount, maxParticipants, &task);
+
+    if (taskCount > 1 && !m_stopped.load(std::memory_order_acquire))
+    {
+        submit(group);
+    }
+
+    // Calling thread always participates on its own group,
+    // so we can't end up waiting for work nobody processes.
+    runGroup(group.get(), true);
+
+    const bool isWorker = s_workerIndex >= 0;
+    const size_t queueIndex = isWorker ? size_t(s_workerIndex) : m_queues.size() - 1;
+    while (!group->isFinished())
+    {
+        uint64_t generation = 0;
+
+        // Help other threads instead of blocking, but only, if we are
+        // worker thread. Other threads (for example, the main thread)
+        // are not allowed to pick up unrelated long-running work.
+        if (isWorker)
+        {
+            {
+                QMutexLocker lock(&m_mutex);
+                generation = m_generation;
+            }
+
+            if (runPendingTasks(queueIndex))
+            {
+                continue;
+            }
+        }
+
+        // Group signals the condition under the mutex, when its last task
+        // is finished, so the wakeup can't be lost. Worker threads are also
+        // woken up, when new work is submitted, so they can help with it.
+        QMutexLocker lock(&m_mutex);
+        while (!group->isFinished() && (!isWorker || generation == m_generation))
+        {
+            m_taskFinished.wait(&m_mutex);
+        }
+    }
+
+    if (group->exception)
+    {
+        std::rethrow_exception(group->exception);
+    }
+}
+
+void PDFWorkStealingExecutor::stop()
+{
+    if (m_stopped.exchange(true))
+    {
+        return;
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        ++m_generation;
+        m_workAvailable.wakeAll();
+    }
+
+    for (QThread* thread : m_threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+}
+
+int PDFWorkStealingExecutor::getActiveThreadCount(PDFExecutionPolicy::Scope scope) const
+{
+    return m_activeThreadCount[getScopeIndex(scope)].load(std::memory_order_relaxed);
+}
+
+void PDFWorkStealingExecutor::setThreadBudget(int threadBudget)
+{
+    m_threadBudget.store(qMax(threadBudget, 1), std::memory_order_relaxed);
+    releaseThreadTokens(0);
+}
+
+int PDFWorkStealingExecutor::acquireThreadTokens(int count)
+{
+    int usedTokens = m_usedThreadTokens.load(std::memory_order_relaxed);
+    while (true)
+    {
+        const int acquiredTokens = qBound(0, getThreadBudget() - usedTokens, count);
+        if (acquiredTokens == 0)
+        {
+            m_tokenStarvation.store(count > 0, std::memory_order_relaxed);
+            return 0;
+        }
+
+        if (m_usedThreadTokens.compare_exchange_weak(usedTokens, usedTokens + acquiredTokens, std::memory_order_acq_rel))
+        {
+            return acquiredTokens;
+        }
+    }
+}
+
+void PDFWorkStealingExecutor::releaseThreadTokens(int count)
+{
+    m_usedThreadTokens.fetch_sub(count, std::memory_order_acq_rel);
+
+    // Wake up workers only, if some of them gave up the work due to lack of tokens
+    if (m_tokenStarvation.exchange(false, std::memory_order_acq_rel))
+    {
+        QMutexLocker lock(&m_mutex);
+        ++m_generation;
+        m_workAvailable.wakeAll();
+        m_taskFinished.wakeAll();
+    }
+}
+
+void PDFWorkStealingExecutor::ensureStarted()
+{
+    std::call_once(m_startFlag, [this]()
+    {
+        const size_t workerCount = qMax(1, QThread::idealThreadCount());
+
+        // Create worker queues and injection queue
+        m_queues.reserve(workerCount + 1);
+        for (size_t i = 0; i <= workerCount; ++i)
+        {
+            m_queues.emplace_back(std::make_unique<WorkerQueue>());
+        }
+
+        if (m_stopped.load(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        m_threads.reserve(workerCount);
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            QThread* thread = QThread::create([this, i]() { workerLoop(i); });
+            thread->setObjectName(QString("PDFExecutionPolicy worker %1").arg(i));
+            m_threads.push_back(thread);
+            thread->start();
+        }
+    });
+}
+
+void PDFWorkStealingExecutor::workerLoop(size_t workerIndex)
+{
+    s_workerIndex = static_cast<int>(workerIndex);
+
+    while (!m_stopped.load(std::memory_order_acquire))
+    {
+        uint64_t generation = 0;
+        {
+            QMutexLocker lock(&m_mutex);
+            generation = m_generation;
+        }
+
+        if (runPendingTasks(workerIndex))
+        {
+            continue;
+        }
+
+        // No work was found. Wait for new work, but only, if no new work
+        // was submitted in the meantime.
+        QMutexLocker lock(&m_mutex);
+        if (generation == m_generation && !m_stopped.load(std::memory_order_acquire))
+        {
+            m_workAvailable.wait(&m_mutex);
+        }
+    }
+}
+
+void PDFWorkStealingExecutor::submit(PDFExecutionTaskGroupPointer group)
+{
+    const size_t queueIndex = s_workerIndex >= 0 ? size_t(s_workerIndex) : m_queues.size() - 1;
+    WorkerQueue* queue = m_queues[queueIndex].get();
+
+    {
+        QMutexLocker lock(&queue->mutex);
+        queue->groups.push_back(std::move(group));
+    }
+
+    QMutexLocker lock(&m_mutex);
+    ++m_generation;
+    m_workAvailable.wakeAll();
+    m_taskFinished.wakeAll();
+}
+
+bool PDFWorkStealingExecutor::runPendingTasks(size_t queueIndex)
+{
+    // First, take our own (most recent) work
+    if (runPendingTasksFromQueue(m_queues[queueIndex].get(), true))
+    {
+        return true;
+    }
+
+    // Then, try to steal the oldest work from other queues
+    const size_t queueCount = m_queues.size();
+    for (size_t i = 1; i < queueCount; ++i)
+    {
+        const size_t victimIndex = (queueIndex + i) % queueCount;
+        if (runPendingTasksFromQueue(m_queues[victimIndex].get(), false))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PDFWorkStealingExecutor::runPendingTasksFromQueue(WorkerQueue* queue, bool fromBack)
+{
+    std::vector<PDFExecutionTaskGroupPointer> candidates;
+
+    {
+        QMutexLocker lock(&queue->mutex);
+
+        // Remove exhausted groups
+        auto it = std::remove_if(queue->groups.begin(), queue->groups.end(), [](const PDFExecutionTaskGroupPointer& group) { return !group->hasUnclaimedTasks(); });
+        queue->groups.erase(it, queue->groups.end());
+
+        if (queue->groups.empty())
+        {
+            return false;
+        }
+
+        if (fromBack)
+        {
+            candidates.assign(queue->groups.rbegin(), queue->groups.rend());
+        }
+        else
+        {
+            candidates.assign(queue->groups.begin(), queue->groups.end());
+        }
+    }
+
+    for (const PDFExecutionTaskGroupPointer& group : candidates)
+    {
+        if (runGroup(group.get(), false))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PDFWorkStealingExecutor::runGroup(PDFExecutionTaskGroup* group, bool force)
+{
+    if (!group->hasUnclaimedTasks())
+    {
+        return false;
+    }
+
+    // Thread, which joins the group of other thread, must acquire token from
+    // the thread budget. Calling thread processing its own group, or worker
+    // already holding a token (nested parallelism), needs no additional token.
+    const bool needsToken = !force && !s_holdsThreadToken;
+    if (needsToken)
+    {
+        if (acquireThreadTokens(1) == 0)
+        {
+            return false;
+        }
+
+        s_holdsThreadToken = true;
+    }
+
+    const int participants = group->participants.fetch_add(1, std::memory_order_acq_rel);
+    if (!force && participants >= group->maxParticipants)
+    {
+        group->participants.fetch_sub(1, std::memory_order_acq_rel);
+
+        if (needsToken)
+        {
+            s_holdsThreadToken = false;
+            releaseThreadTokens(1);
+        }
+
+        return false;
+    }
+
+    std::atomic<int>& activeThreadCount = m_activeThreadCount[getScopeIndex(group->scope)];
+    ++activeThreadCount;
+
+    bool processed = false;
+    size_t index = group->nextTask.fetch_add(1, std::memory_order_relaxed);
+    while (index < group->taskCount)
+    {
+        try
+        {
+            (*group->task)(index);
+        }
+        catch (...)
+        {
+            QMutexLocker lock(&group->exceptionMutex);
+            if (!group->exception)
+            {
+                group->exception = std::current_exception();
+            }
+        }
+
+        processed = true;
+        if (group->finishedTasks.fetch_add(1, std::memory_order_acq_rel) + 1 == group->taskCount)
+        {
+            QMutexLocker lock(&m_mutex);
+            m_taskFinished.wakeAll();
+        }
+
+        index = group->nextTask.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    --activeThreadCount;
+    group->participants.fetch_sub(1, std::memory_order_acq_rel);
+
+    if (needsToken)
+    {
+        s_holdsThreadToken = false;
+        releaseThreadTokens(1);
+    }
+
+    return processed;
+}
+
 struct PDFExecutionPolicyHolder
 {
     PDFExecutionPolicyHolder()
     {
         qAddPostRoutine(&PDFExecutionPolicy::finalize);
+
+        const int idealThreadCount = qMax(1, QThread::idealThreadCount());
+        for (std::atomic<int>& maxThreadCount : maxThreadCounts)
+        {
+            maxThreadCount.store(idealThreadCount, std::memory_order_relaxed);
+        }
     }
     ~PDFExecutionPolicyHolder()
     {
-        auxiliary.waitForDone();
-        primary.waitForDone();
+        executor.stop();
     }
 
     PDFExecutionPolicy policy;
-    QThreadPool primary;
-    QThreadPool auxiliary;
+    PDFWorkStealingExecutor executor;
+    std::array<std::atomic<int>, 3> maxThreadCounts = { };
 } s_execution_policy;
 
 void PDFExecutionPolicy::setStrategy(Strategy strategy)
@@ -81,19 +556,19 @@ bool PDFExecutionPolicy::isParallelizing(Scope scope)
 
 int PDFExecutionPolicy::getActiveThreadCount(Scope scope)
 {
-    return getThreadPool(scope)->activeThreadCount();
+    return s_execution_policy.executor.getActiveThreadCount(scope);
 }
 
 int PDFExecutionPolicy::getMaxThreadCount(Scope scope)
 {
-    return getThreadPool(scope)->maxThreadCount();
+    return s_execution_policy.maxThreadCounts[static_cast<size_t>(scope)].load(std::memory_order_relaxed);
 }
 
 void PDFExecutionPolicy::setMaxThreadCount(Scope scope, int count)
 {
     // Sanitize value!
     count = qMax(count, 1);
-    getThreadPool(scope)->setMaxThreadCount(count);
+    s_execution_policy.maxThreadCounts[static_cast<size_t>(scope)].store(count, std::memory_order_relaxed);
 }
 
 int PDFExecutionPolicy::getIdealThreadCount(Scope scope)
@@ -107,6 +582,42 @@ int PDFExecutionPolicy::getContentStreamCount()
     return s_execution_policy.policy.m_contentStreamsCount.load(std::memory_order_relaxed);
 }
 
+int PDFExecutionPolicy::getThreadBudget()
+{
+    return s_execution_policy.executor.getThreadBudget();
+}
+
+void PDFExecutionPolicy::setThreadBudget(int threadBudget)
+{
+    s_execution_policy.executor.setThreadBudget(threadBudget);
+}
+
+int PDFExecutionPolicy::acquireThreadTokens(int count)
+{
+    return s_execution_policy.executor.acquireThreadTokens(count);
+}
+
+void PDFExecutionPolicy::releaseThreadTokens(int count)
+{
+    if (count > 0)
+    {
+        s_execution_policy.executor.releaseThreadTokens(count);
+    }
+}
+
+int PDFExecutionPolicy::getContentStreamThreadBudget()
+{
+    if (s_execution_policy.policy.m_strategy.load(std::memory_order_relaxed) == Strategy::SingleThreaded)
+    {
+        return 1;
+    }
+
+    const int idealThreadCount = getIdealThreadCount(Scope::Content);
+    const int threadCount = isParallelizing(Scope::Content) ? getMaxThreadCount(Scope::Content) : idealThreadCount;
+    const int contentStreamCount = qMax(getContentStreamCount(), 1);
+    return qBound(1, threadCount / contentStreamCount, qMax(idealThreadCount, 1));
+}
+
 void PDFExecutionPolicy::startProcessingContentStream()
 {
     ++s_execution_policy.policy.m_contentStreamsCount;
@@ -119,27 +630,12 @@ void PDFExecutionPolicy::endProcessingContentStream()
 
 void PDFExecutionPolicy::finalize()
 {
-    s_execution_policy.auxiliary.waitForDone();
-    s_execution_policy.primary.waitForDone();
+    s_execution_policy.executor.stop();
 }
 
-QThreadPool* PDFExecutionPolicy::getThreadPool(PDFExecutionPolicy::Scope scope)
+void PDFExecutionPolicy::executeTasks(Scope scope, size_t taskCount, const std::function<void(size_t)>& task)
 {
-    switch (scope)
-    {
-        case Scope::Page:
-        case Scope::Unknown:
-            return &s_execution_policy.primary;
-
-        case Scope::Content:
-            return &s_execution_policy.auxiliary;
-
-        default:
-            Q_ASSERT(false);
-            break;
-    }
-
-    return nullptr;
+    s_execution_policy.executor.execute(scope, taskCount, getMaxThreadCount(scope), task);
 }
 
 PDFExecutionPolicy::PDFExecutionPolicy() :
@@ -149,4 +645,15 @@ PDFExecutionPolicy::PDFExecutionPolicy() :
 
 }
 
+PDFThreadBudgetReservation::PDFThreadBudgetReservation(int threadCount) :
+    m_tokenCount(threadCount > 1 ? PDFExecutionPolicy::acquireThreadTokens(threadCount - 1) : 0)
+{
+
+}
+
+PDFThreadBudgetReservation::~PDFThreadBudgetReservation()
+{
+    PDFExecutionPolicy::releaseThreadTokens(m_tokenCount);
+}
+
 }   // namespace pdf
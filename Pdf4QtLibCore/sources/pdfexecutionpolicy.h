@@ -20,11 +20,12 @@
 
 #include "pdfglobal.h"
 
-#include <QSemaphore>
-#include <QThreadPool>
+#include <QThread>
 
 #include <atomic>
+#include <vector>
 #include <execution>
+#include <functional>
 
 namespace pdf
 {
@@ -59,47 +60,15 @@ public:
     /// \param scope Scope for which we want to determine execution policy
     static bool isParallelizing(Scope scope);
 
-    template<typename ForwardIt, typename UnaryFunction>
-    class Runnable : public QRunnable
-    {
-    public:
-        explicit inline Runnable(ForwardIt it, ForwardIt itEnd, UnaryFunction* function, QSemaphore* semaphore) :
-            m_forwardIt(qMove(it)),
-            m_forwardItEnd(qMove(itEnd)),
-            m_function(function),
-            m_semaphore(semaphore),
-            m_packSize(static_cast<int>(std::distance(m_forwardIt, m_forwardItEnd)))
-        {
-            setAutoDelete(true);
-        }
-
-        virtual void run() override
-        {
-            QSemaphoreReleaser semaphoreReleaser(m_semaphore, m_packSize);
-            for (auto it = m_forwardIt; it != m_forwardItEnd; ++it)
-            {
-                (*m_function)(*it);
-            }
-        }
-
-    private:
-        ForwardIt m_forwardIt;
-        ForwardIt m_forwardItEnd;
-        UnaryFunction* m_function;
-        QSemaphore* m_semaphore;
-        int m_packSize;
-    };
-
     template<typename ForwardIt, typename UnaryFunction>
     static void execute(Scope scope, ForwardIt first, ForwardIt last, UnaryFunction f)
     {
         if (isParallelizing(scope))
         {
-            QSemaphore semaphore(0);
-            int count = static_cast<int>(std::distance(first, last));
-            int remainder = count;
+            const size_t count = static_cast<size_t>(std::distance(first, last));
+            size_t remainder = count;
 
-            int bucketSize = 1;
+            size_t bucketSize = 1;
 
             // For page scope, we do not divide the tasks into buckets, i.e.
             // each bucket will have size 1. But if we are in a content scope,
@@ -107,29 +76,36 @@ public:
             // into buckets of appropriate size.
             if (scope != Scope::Page)
             {
-                const int buckets = 8 * QThread::idealThreadCount();
-                bucketSize = qMax(1, count / buckets);
+                const size_t buckets = 8 * static_cast<size_t>(QThread::idealThreadCount());
+                bucketSize = qMax(size_t(1), count / buckets);
             }
 
-            QThreadPool* pool = getThreadPool(scope);
-
             // Divide tasks into buckets with given bucket size
+            std::vector<ForwardIt> bucketStarts;
+            bucketStarts.reserve(count / bucketSize + 2);
+
             auto it = first;
             while (remainder > 0)
             {
-                const int currentSize = qMin(remainder, bucketSize);
-
-                auto itStart = it;
-                auto itEnd = std::next(it, currentSize);
-                pool->start(new Runnable(itStart, itEnd, &f, &semaphore));
+                const size_t currentSize = qMin(remainder, bucketSize);
+                bucketStarts.push_back(it);
 
                 remainder -= currentSize;
                 std::advance(it, currentSize);
             }
 
             Q_ASSERT(it == last);
+            bucketStarts.push_back(last);
+
+            auto processBucket = [&bucketStarts, &f](size_t bucket)
+            {
+                for (auto itBucket = bucketStarts[bucket]; itBucket != bucketStarts[bucket + 1]; ++itBucket)
+                {
+                    f(*itBucket);
+                }
+            };
 
-            semaphore.acquire(count);
+            executeTasks(scope, bucketStarts.size() - 1, processBucket);
         }
         else
         {
@@ -161,6 +137,36 @@ public:
     /// Returns number of currently processed content streams
     static int getContentStreamCount();
 
+    /// Returns global thread budget, i.e. maximal number of threads, which are
+    /// processing work at once. All parallel work draws tokens from this budget:
+    /// worker threads of the execution policy (page and content scope) and
+    /// threads of external libraries (Blend2D, OpenJPEG). So, if many pages are
+    /// processed in parallel, intra-page parallelism gets no additional threads,
+    /// and if only single page is processed, it gets all remaining threads.
+    static int getThreadBudget();
+
+    /// Sets global thread budget
+    /// \param threadBudget Thread budget (at least 1)
+    static void setThreadBudget(int threadBudget);
+
+    /// Tries to acquire up to \p count tokens from the global thread budget
+    /// and returns number of acquired tokens (can be zero). Each acquired token
+    /// allows to run one additional thread and must be released using
+    /// \p releaseThreadTokens. Use \p PDFThreadBudgetReservation instead
+    /// of calling this function directly.
+    /// \param count Requested token count
+    static int acquireThreadTokens(int count);
+
+    /// Releases tokens acquired by \p acquireThreadTokens
+    /// \param count Token count
+    static void releaseThreadTokens(int count);
+
+    /// Returns number of threads, which can be used by single content stream
+    /// for its internal parallel work, which is not scheduled by execution policy
+    /// (for example, image decoding in external library). Thread count is divided
+    /// between currently processed content streams, so threads are not oversubscribed.
+    static int getContentStreamThreadBudget();
+
     /// Starts processing content stream
     static void startProcessingContentStream();
 
@@ -173,8 +179,16 @@ public:
 private:
     friend struct PDFExecutionPolicyHolder;
 
-    /// Returns thread pool based on scope
-    static QThreadPool* getThreadPool(Scope scope);
+    /// Executes tasks with indices 0, 1, ..., taskCount - 1 using work-stealing
+    /// executor. Calling thread also processes the tasks, and if the tasks
+    /// are being processed by other threads, calling thread helps with other
+    /// pending work instead of blocking. Function returns, when all tasks
+    /// are finished. If some task throws an exception, then first thrown
+    /// exception is rethrown in the calling thread.
+    /// \param scope Scope of the tasks
+    /// \param taskCount Task count
+    /// \param task Task function
+    static void executeTasks(Scope scope, size_t taskCount, const std::function<void(size_t)>& task);
 
     explicit PDFExecutionPolicy();
 
@@ -182,6 +196,27 @@ private:
     std::atomic<Strategy> m_strategy;
 };
 
+/// Reserves additional threads from the global thread budget for the
+/// lifetime of the object. Calling thread is not counted, so thread count
+/// available for the work is always at least one.
+class PDF4QTLIBCORESHARED_EXPORT PDFThreadBudgetReservation
+{
+public:
+    /// Reserves threads
+    /// \param threadCount Requested total thread count, including the calling thread
+    explicit PDFThreadBudgetReservation(int threadCount);
+    ~PDFThreadBudgetReservation();
+
+    PDFThreadBudgetReservation(const PDFThreadBudgetReservation&) = delete;
+    PDFThreadBudgetReservation& operator=(const PDFThreadBudgetReservation&) = delete;
+
+    /// Returns total thread count, which can be used (including the calling thread)
+    int getThreadCount() const { return m_tokenCount + 1; }
+
+private:
+    int m_tokenCount;
+};
+
 }   // namespace pdf
 
 #endif // PDFEXECUTIONPOLICY_H
@@ -21,6 +21,11 @@
 #include "pdfnametounicode.h"
 #include "pdfexception.h"
 #include "pdfutils.h"
+#include "pdfparsedcontentcache.h"
+#include "pdfimagecache.h"
+#include "pdfsharedcontentcache.h"
+#include "pdfinstrumentation.h"
+#include "pdfmemorybudget.h"
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -32,9 +37,12 @@
 #include <QFile>
 #include <QMutex>
 #include <QReadWriteLock>
+#include <QTransform>
 #include <QPainterPath>
 #include <QDataStream>
 
+#include <atomic>
+
 #include "pdfdbgheap.h"
 
 #if defined(Q_OS_WIN)
@@ -118,16 +126,47 @@ public:
     /// Returns instance of storage
     static const PDFSystemFontInfoStorage* getInstance();
 
-    /// Loads font from descriptor
+    /// Loads font from descriptor. Results are cached, so system font lookup
+    /// is performed only once for the same font parameters, and font files are
+    /// memory mapped (if possible) and shared. This function is thread safe.
     /// \param descriptor Descriptor describing the font
     QByteArray loadFont(const CIDSystemInfo* cidSystemInfo,
                         const FontDescriptor* descriptor,
                         StandardFontType standardFontType,
                         PDFRenderErrorReporter* reporter) const;
 
+    /// Returns font face of the system font, which is shared by all documents,
+    /// or nullptr, if no document uses such font face. Font faces are reference
+    /// counted, so they are released, when no document uses them. This function
+    /// is thread safe.
+    /// \param fontData Font data (returned by \p loadFont function)
+    /// \param isVertical Is vertical writing system used?
+    PDFFontFacePointer getSharedFontFace(const QByteArray& fontData, bool isVertical) const;
+
+    /// Registers font face of the system font, so it can be shared by
+    /// all documents. If other font face was already registered for the
+    /// same font data, then it is returned, otherwise \p fontFace is returned.
+    /// This function is thread safe.
+    /// \param fontData Font data (returned by \p loadFont function)
+    /// \param isVertical Is vertical writing system used?
+    /// \param fontFace Font face
+    PDFFontFacePointer registerSharedFontFace(const QByteArray& fontData, bool isVertical, PDFFontFacePointer fontFace) const;
+
 private:
     explicit PDFSystemFontInfoStorage();
 
+    /// Loads font from descriptor (without using the cache)
+    /// \param descriptor Descriptor describing the font
+    QByteArray loadFontUncached(const CIDSystemInfo* cidSystemInfo,
+                                const FontDescriptor* descriptor,
+                                StandardFontType standardFontType,
+                                PDFRenderErrorReporter* reporter) const;
+
+    /// Returns data of the font file. File is memory mapped, if possible,
+    /// and it is kept opened, so each file is loaded only once.
+    /// \param fileName File name
+    QByteArray getFontFileData(const QString& fileName) const;
+
     /// Loads font from descriptor
     /// \param descriptor Descriptor describing the font
     QByteArray loadFontImpl(const FontDescriptor* descriptor,
@@ -166,6 +205,55 @@ private:
 
     std::vector<FontInfo> m_fontInfos;
 #endif
+
+    /// Result of the font lookup. Warnings reported during lookup
+    /// are stored, so they can be reported for each use of the font.
+    struct LoadedFont
+    {
+        QByteArray fontData;
+        std::vector<PDFRenderError> warnings;
+    };
+
+    mutable QMutex m_mutex;
+
+    /// Loaded fonts, key is created from font parameters
+    mutable std::map<QByteArray, LoadedFont> m_loadedFonts;
+
+    /// Opened (mapped) font files and their data
+    mutable std::map<QString, std::pair<std::unique_ptr<QFile>, QByteArray>> m_fontFiles;
+
+    /// Key of the shared font face - font data (which are never released
+    /// from this storage, so pointer is stable) and vertical writing flag.
+    using SharedFontFaceKey = std::pair<const char*, bool>;
+
+    /// Font faces of system fonts shared by all documents
+    mutable QMutex m_sharedFontFacesMutex;
+    mutable std::map<SharedFontFaceKey, std::weak_ptr<PDFFontFace>> m_sharedFontFaces;
+};
+
+/// Error reporter, which records reported errors
+class PDFRenderErrorRecorder : public PDFRenderErrorReporter
+{
+public:
+    virtual void reportRenderError(RenderErrorType type, QString message) override
+    {
+        m_errors.emplace_back(type, qMove(message));
+    }
+
+    virtual void reportRenderError(const PDFRenderError& error) override
+    {
+        m_errors.push_back(error);
+    }
+
+    virtual void reportRenderErrorOnce(RenderErrorType type, QString message) override
+    {
+        reportRenderError(type, qMove(message));
+    }
+
+    std::vector<PDFRenderError>& getErrors() { return m_errors; }
+
+private:
+    std::vector<PDFRenderError> m_errors;
 };
 
 const PDFSystemFontInfoStorage* PDFSystemFontInfoStorage::getInstance()
@@ -178,6 +266,103 @@ QByteArray PDFSystemFontInfoStorage::loadFont(const CIDSystemInfo* cidSystemInfo
                                               const FontDescriptor* descriptor,
                                               StandardFontType standardFontType,
                                               PDFRenderErrorReporter* reporter) const
+{
+    // Create key from all parameters, which are used when system font is being found
+    QByteArray key;
+    {
+        QDataStream stream(&key, QIODevice::WriteOnly);
+        stream << cidSystemInfo->registry << cidSystemInfo->ordering;
+        stream << descriptor->fontName << descriptor->fontFamily << int(descriptor->fontStretch);
+        stream << descriptor->fontWeight << descriptor->italicAngle << descriptor->isSerif();
+        stream << int(standardFontType);
+    }
+
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_loadedFonts.find(key);
+    if (it == m_loadedFonts.cend())
+    {
+        // Font lookup is performed under the lock, so system
+        // font API is not called from more threads simultaneously.
+        PDFRenderErrorRecorder recorder;
+
+        LoadedFont loadedFont;
+        loadedFont.fontData = loadFontUncached(cidSystemInfo, descriptor, standardFontType, &recorder);
+        loadedFont.warnings = qMove(recorder.getErrors());
+        it = m_loadedFonts.emplace(qMove(key), qMove(loadedFont)).first;
+    }
+
+    for (const PDFRenderError& warning : it->second.warnings)
+    {
+        reporter->reportRenderError(warning);
+    }
+
+    return it->second.fontData;
+}
+
+PDFFontFacePointer PDFSystemFontInfoStorage::getSharedFontFace(const QByteArray& fontData, bool isVertical) const
+{
+    QMutexLocker lock(&m_sharedFontFacesMutex);
+
+    auto it = m_sharedFontFaces.find(SharedFontFaceKey(fontData.constData(), isVertical));
+    if (it != m_sharedFontFaces.cend())
+    {
+        return it->second.lock();
+    }
+
+    return nullptr;
+}
+
+PDFFontFacePointer PDFSystemFontInfoStorage::registerSharedFontFace(const QByteArray& fontData, bool isVertical, PDFFontFacePointer fontFace) const
+{
+    QMutexLocker lock(&m_sharedFontFacesMutex);
+
+    std::weak_ptr<PDFFontFace>& sharedFontFace = m_sharedFontFaces[SharedFontFaceKey(fontData.constData(), isVertical)];
+    if (PDFFontFacePointer existingFontFace = sharedFontFace.lock())
+    {
+        // Other thread was faster
+        return existingFontFace;
+    }
+
+    sharedFontFace = fontFace;
+
+    // Remove font faces, which are not used anymore
+    std::erase_if(m_sharedFontFaces, [](const auto& item) { return item.second.expired(); });
+    return fontFace;
+}
+
+QByteArray PDFSystemFontInfoStorage::getFontFileData(const QString& fileName) const
+{
+    auto it = m_fontFiles.find(fileName);
+    if (it != m_fontFiles.cend())
+    {
+        return it->second.second;
+    }
+
+    QByteArray data;
+    std::unique_ptr<QFile> file = std::make_unique<QFile>(fileName);
+    if (file->open(QIODevice::ReadOnly))
+    {
+        if (uchar* mappedData = file->map(0, file->size()))
+        {
+            // Font file stays mapped for the lifetime of the storage
+            data = QByteArray::fromRawData(reinterpret_cast<const char*>(mappedData), file->size());
+        }
+        else
+        {
+            data = file->readAll();
+            file->close();
+        }
+    }
+
+    m_fontFiles.emplace(fileName, std::make_pair(qMove(file), data));
+    return data;
+}
+
+QByteArray PDFSystemFontInfoStorage::loadFontUncached(const CIDSystemInfo* cidSystemInfo,
+                                                      const FontDescriptor* descriptor,
+                                                      StandardFontType standardFontType,
+                                                      PDFRenderErrorReporter* reporter) const
 {
     QString fontName;
 
@@ -404,7 +589,8 @@ QByteArray PDFSystemFontInfoStorage::loadFontImpl(const FontDescriptor* descript
     ReleaseDC(NULL, hdc);
     return result;
 #elif defined(Q_OS_UNIX)
-    FcPattern* p = FcPatternBuild(nullptr, FC_FAMILY, FcTypeString, fontName.constData(), nullptr);
+    const QByteArray fontNameUtf8 = fontName.toUtf8();
+    FcPattern* p = FcPatternBuild(nullptr, FC_FAMILY, FcTypeString, reinterpret_cast<const FcChar8*>(fontNameUtf8.constData()), nullptr);
     if (!p)
     {
         throw PDFException(PDFTranslationContext::tr("FontConfig error building pattern for font %1").arg(fontName));
@@ -452,12 +638,11 @@ QByteArray PDFSystemFontInfoStorage::loadFontImpl(const FontDescriptor* descript
         FcChar8* s = nullptr;
         if (FcPatternGetString(match, FC_FILE, 0, &s) == FcResultMatch)
         {
-            QFile f(QString::fromUtf8(reinterpret_cast<char*>(s)));
-            f.open(QIODevice::ReadOnly);
-            result = f.readAll();
-            f.close();
+            result = getFontFileData(QString::fromUtf8(reinterpret_cast<char*>(s)));
         }
+        FcPatternDestroy(match);
     }
+    FcPatternDestroy(p);
 
     if (result.isEmpty() && standardFontType == StandardFontType::Invalid)
     {
@@ -618,56 +803,57 @@ private:
     PDFFontPointer m_parentFont;
 };
 
-/// Implementation of the PDFRealizedFont class using PIMPL pattern
-class PDFRealizedFontImpl : public IRealizedFontImpl
+/// Font program loaded by FreeType. Font face is shared by all realized fonts
+/// of the same font (i.e. of different sizes). Glyph outlines are loaded
+/// and decomposed only once, and cached in size independent units (size of the
+/// font is 1.0), realized fonts then just scale them to their pixel size.
+class PDFFontFace
 {
 public:
-    explicit PDFRealizedFontImpl();
-    virtual ~PDFRealizedFontImpl();
+    explicit PDFFontFace();
+    ~PDFFontFace();
 
-    virtual void fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter) override;
-    virtual bool isHorizontalWritingSystem() const override { return !m_isVertical; }
-    virtual void dumpFontToTreeItem(ITreeFactory* treeFactory) const override;
-    virtual QString getPostScriptName() const override { return m_postScriptName; }
-    virtual CharacterInfos getCharacterInfos() const override;
+    struct Glyph
+    {
+        QPainterPath glyph;
+        PDFReal advance = 0.0;
+    };
+
+    /// Returns size independent outline of the glyph. Glyph
+    /// index must not be zero. This function is thread safe.
+    /// \param glyphIndex Glyph index
+    const Glyph& getGlyph(unsigned int glyphIndex);
 
-    static constexpr const PDFReal PIXEL_SIZE_MULTIPLIER = 100.0;
+    FT_Face getFace() const { return m_face; }
+    bool isVertical() const { return m_isVertical; }
+    const QString& getPostScriptName() const { return m_postScriptName; }
+
+    /// Function checks, if error occured, and if yes, then exception is thrown
+    static void checkFreeTypeError(FT_Error error);
 
 private:
     friend class PDFRealizedFont;
 
-    static constexpr const PDFReal FONT_WIDTH_MULTIPLIER = 1.0 / 1000.0;
+    /// Glyphs are loaded at this reference pixel size. Hinting is
+    /// not used, so outlines scale linearly and this size only affects the
+    /// precision of the 26.6 fixed point coordinates.
+    static constexpr const FT_UInt REFERENCE_PIXEL_SIZE = 10000;
     static constexpr const PDFReal FORMAT_26_6_MULTIPLIER = 1 / 64.0;
-    static constexpr const PDFReal FONT_MULTIPLIER = FORMAT_26_6_MULTIPLIER / PIXEL_SIZE_MULTIPLIER;
-
-    struct Glyph
-    {
-        QPainterPath glyph;
-        PDFReal advance = 0.0;
-    };
+    static constexpr const PDFReal FONT_MULTIPLIER = FORMAT_26_6_MULTIPLIER / REFERENCE_PIXEL_SIZE;
 
     static int outlineMoveTo(const FT_Vector* to, void* user);
     static int outlineLineTo(const FT_Vector* to, void* user);
     static int outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user);
     static int outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user);
 
-    /// Get glyph for glyph index
-    const Glyph& getGlyph(unsigned int glyphIndex);
-
-    /// Function checks, if error occured, and if yes, then exception is thrown
-    static void checkFreeTypeError(FT_Error error);
-
-    /// Read/write lock for accessing the glyph data
+    /// Read/write lock for accessing the glyph data and the face
     QReadWriteLock m_readWriteLock;
 
-    /// Glyph cache, must be protected by the mutex above
+    /// Glyph outline cache, must be protected by the mutex above
     std::unordered_map<unsigned int, Glyph> m_glyphCache;
 
-    /// For embedded fonts, this byte array contains embedded font data
-    QByteArray m_embeddedFontData;
-
-    /// For system fonts, this byte array contains system font data
-    QByteArray m_systemFontData;
+    /// Font data (embedded or system font data)
+    QByteArray m_fontData;
 
     /// Instance of FreeType library assigned to this font
     FT_Library m_library;
@@ -675,12 +861,6 @@ private:
     /// Face of the font
     FT_Face m_face;
 
-    /// Pixel size of the font
-    PDFReal m_pixelSize;
-
-    /// Parent font
-    PDFFontPointer m_parentFont;
-
     /// True, if font is embedded
     bool m_isEmbedded;
 
@@ -691,18 +871,16 @@ private:
     QString m_postScriptName;
 };
 
-PDFRealizedFontImpl::PDFRealizedFontImpl() :
+PDFFontFace::PDFFontFace() :
     m_library(nullptr),
     m_face(nullptr),
-    m_pixelSize(0.0),
-    m_parentFont(nullptr),
     m_isEmbedded(false),
     m_isVertical(false)
 {
 
 }
 
-PDFRealizedFontImpl::~PDFRealizedFontImpl()
+PDFFontFace::~PDFFontFace()
 {
     if (m_face)
     {
@@ -717,6 +895,56 @@ PDFRealizedFontImpl::~PDFRealizedFontImpl()
     }
 }
 
+/// Implementation of the PDFRealizedFont class using PIMPL pattern
+class PDFRealizedFontImpl : public IRealizedFontImpl
+{
+public:
+    explicit PDFRealizedFontImpl();
+    virtual ~PDFRealizedFontImpl() override = default;
+
+    virtual void fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter) override;
+    virtual bool isHorizontalWritingSystem() const override { return !m_fontFace->isVertical(); }
+    virtual void dumpFontToTreeItem(ITreeFactory* treeFactory) const override;
+    virtual QString getPostScriptName() const override { return m_fontFace->getPostScriptName(); }
+    virtual CharacterInfos getCharacterInfos() const override;
+
+private:
+    friend class PDFRealizedFont;
+
+    static constexpr const PDFReal FONT_WIDTH_MULTIPLIER = 1.0 / 1000.0;
+
+    using Glyph = PDFFontFace::Glyph;
+
+    /// Get glyph for glyph index
+    const Glyph& getGlyph(unsigned int glyphIndex);
+
+    /// Read/write lock for accessing the glyph data
+    QReadWriteLock m_readWriteLock;
+
+    /// Glyph cache (glyphs scaled to the pixel size), must be protected by the mutex above
+    std::unordered_map<unsigned int, Glyph> m_glyphCache;
+
+    /// Font face (shared with realized fonts of other sizes)
+    PDFFontFacePointer m_fontFace;
+
+    /// Face of the font (owned by the font face)
+    FT_Face m_face;
+
+    /// Pixel size of the font
+    PDFReal m_pixelSize;
+
+    /// Parent font
+    PDFFontPointer m_parentFont;
+};
+
+PDFRealizedFontImpl::PDFRealizedFontImpl() :
+    m_face(nullptr),
+    m_pixelSize(0.0),
+    m_parentFont(nullptr)
+{
+
+}
+
 void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter)
 {
     switch (m_parentFont->getFontType())
@@ -754,7 +982,7 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
                 }
                 else
                 {
-                    reporter->reportRenderError(RenderErrorType::Warning, PDFTranslationContext::tr("Glyph for simple font character code '%1' not found.").arg(static_cast<uint8_t>(byteArray[i])));
+                    reporter->reportRenderError(PDFRenderError(RenderErrorType::Warning, QT_TRANSLATE_NOOP("pdf::PDFTranslationContext", "Glyph for simple font character code '%1' not found."), { QString::number(static_cast<uint8_t>(byteArray[i])) }));
                     if (glyphWidth > 0)
                     {
                         const QPainterPath* nullpath = nullptr;
@@ -792,7 +1020,7 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
                     if (cid > 0)
                     {
                         // Character with CID == 0 is treated as default whitespace, it hasn't glyph
-                        reporter->reportRenderError(RenderErrorType::Warning, PDFTranslationContext::tr("Glyph for composite font character with cid '%1' not found.").arg(cid));
+                        reporter->reportRenderError(PDFRenderError(RenderErrorType::Warning, QT_TRANSLATE_NOOP("pdf::PDFTranslationContext", "Glyph for composite font character with cid '%1' not found."), { QString::number(cid) }));
                     }
 
                     if (glyphWidth > 0)
@@ -867,12 +1095,15 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
             const PDFFontCMap* toUnicode = font->getToUnicode();
             const PDFCIDtoGIDMapper* CIDtoGIDmapper = font->getCIDtoGIDMapper();
 
+            const GID glyphCount = GID(qMax(m_face->num_glyphs, FT_Long(0)));
+            const std::vector<CID> inverseMapping = CIDtoGIDmapper->createInverseMapping(glyphCount);
+
             FT_UInt index = 0;
             FT_ULong character = FT_Get_First_Char(m_face, &index);
             while (index != 0)
             {
                 const GID gid = index;
-                const CID cid = CIDtoGIDmapper->unmap(gid);
+                const CID cid = gid < glyphCount ? inverseMapping[gid] : 0;
 
                 CharacterInfo info;
                 info.gid = gid;
@@ -884,8 +1115,10 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
 
             if (result.empty())
             {
-                // We will try all reasonable high CIDs
-                for (CID cid = 0; cid < QChar::LastValidCodePoint; ++cid)
+                // Enumerate all mapped CIDs. Every glyph index lower than
+                // glyph count is valid glyph, so we need not load the glyphs.
+                const CID cidCount = CIDtoGIDmapper->isIdentity() ? glyphCount : CIDtoGIDmapper->getMappedCIDCount();
+                for (CID cid = 0; cid < cidCount; ++cid)
                 {
                     const GID gid = CIDtoGIDmapper->map(cid);
 
@@ -894,7 +1127,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                         continue;
                     }
 
-                    if (!FT_Load_Glyph(m_face, gid, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING))
+                    if (gid < glyphCount)
                     {
                         CharacterInfo info;
                         info.gid = gid;
@@ -1022,34 +1255,77 @@ void PDFRealizedFontImpl::dumpFontToTreeItem(ITreeFactory* treeFactory) const
     treeFactory->popItem();
 }
 
-int PDFRealizedFontImpl::outlineMoveTo(const FT_Vector* to, void* user)
+int PDFFontFace::outlineMoveTo(const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.moveTo(to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineLineTo(const FT_Vector* to, void* user)
+int PDFFontFace::outlineLineTo(const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.lineTo(to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+int PDFFontFace::outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.quadTo(control->x * FONT_MULTIPLIER, control->y * FONT_MULTIPLIER, to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+int PDFFontFace::outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.cubicTo(control1->x * FONT_MULTIPLIER, control1->y * FONT_MULTIPLIER, control2->x * FONT_MULTIPLIER, control2->y * FONT_MULTIPLIER, to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
+const PDFFontFace::Glyph& PDFFontFace::getGlyph(unsigned int glyphIndex)
+{
+    Q_ASSERT(glyphIndex);
+
+    {
+        QReadLocker readLock(&m_readWriteLock);
+
+        // First look into cache
+        auto it = m_glyphCache.find(glyphIndex);
+        if (it != m_glyphCache.cend())
+        {
+            return it->second;
+        }
+    }
+
+    QWriteLocker writeLock(&m_readWriteLock);
+
+    // Other thread may have loaded the glyph meanwhile
+    auto it = m_glyphCache.find(glyphIndex);
+    if (it != m_glyphCache.cend())
+    {
+        return it->second;
+    }
+
+    Glyph glyph;
+
+    FT_Outline_Funcs glyphOutlineInterface;
+    glyphOutlineInterface.delta = 0;
+    glyphOutlineInterface.shift = 0;
+    glyphOutlineInterface.move_to = PDFFontFace::outlineMoveTo;
+    glyphOutlineInterface.line_to = PDFFontFace::outlineLineTo;
+    glyphOutlineInterface.conic_to = PDFFontFace::outlineConicTo;
+    glyphOutlineInterface.cubic_to = PDFFontFace::outlineCubicTo;
+
+    checkFreeTypeError(FT_Load_Glyph(m_face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
+    checkFreeTypeError(FT_Outline_Decompose(&m_face->glyph->outline, &glyphOutlineInterface, &glyph));
+    glyph.glyph.closeSubpath();
+    glyph.advance = !m_isVertical ? m_face->glyph->advance.x : m_face->glyph->advance.y;
+    glyph.advance *= FONT_MULTIPLIER;
+
+    return m_glyphCache.insert(std::make_pair(glyphIndex, qMove(glyph))).first->second;
+}
+
 const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int glyphIndex)
 {
     if (glyphIndex)
@@ -1065,23 +1341,14 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
             }
         }
 
-        QWriteLocker writeLock(&m_readWriteLock);
-        Glyph glyph;
-
-        FT_Outline_Funcs glyphOutlineInterface;
-        glyphOutlineInterface.delta = 0;
-        glyphOutlineInterface.shift = 0;
-        glyphOutlineInterface.move_to = PDFRealizedFontImpl::outlineMoveTo;
-        glyphOutlineInterface.line_to = PDFRealizedFontImpl::outlineLineTo;
-        glyphOutlineInterface.conic_to = PDFRealizedFontImpl::outlineConicTo;
-        glyphOutlineInterface.cubic_to = PDFRealizedFontImpl::outlineCubicTo;
+        // Glyph outline is shared by all sizes of the font, we just scale it
+        const Glyph& outline = m_fontFace->getGlyph(glyphIndex);
 
-        checkFreeTypeError(FT_Load_Glyph(m_face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
-        checkFreeTypeError(FT_Outline_Decompose(&m_face->glyph->outline, &glyphOutlineInterface, &glyph));
-        glyph.glyph.closeSubpath();
-        glyph.advance = !m_isVertical ? m_face->glyph->advance.x : m_face->glyph->advance.y;
-        glyph.advance *= FONT_MULTIPLIER;
+        Glyph glyph;
+        glyph.glyph = QTransform::fromScale(m_pixelSize, m_pixelSize).map(outline.glyph);
+        glyph.advance = outline.advance * m_pixelSize;
 
+        QWriteLocker writeLock(&m_readWriteLock);
         auto it = m_glyphCache.find(glyphIndex);
         if (it == m_glyphCache.cend())
         {
@@ -1094,7 +1361,7 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
     return dummy;
 }
 
-void PDFRealizedFontImpl::checkFreeTypeError(FT_Error error)
+void PDFFontFace::checkFreeTypeError(FT_Error error)
 {
     if (error)
     {
@@ -1108,6 +1375,14 @@ void PDFRealizedFontImpl::checkFreeTypeError(FT_Error error)
     }
 }
 
+PDFRealizedFont::PDFRealizedFont(IRealizedFontImpl* impl) :
+    m_impl(impl),
+    m_uniqueId(0)
+{
+    static std::atomic<quint64> s_uniqueIdCounter = 0;
+    m_uniqueId = ++s_uniqueIdCounter;
+}
+
 PDFRealizedFont::~PDFRealizedFont()
 {
     delete m_impl;
@@ -1138,7 +1413,77 @@ CharacterInfos PDFRealizedFont::getCharacterInfos() const
     return m_impl->getCharacterInfos();
 }
 
-PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter)
+PDFFontFacePointer PDFRealizedFont::createFontFace(PDFFontPointer font, PDFRenderErrorReporter* reporter)
+{
+    if (font->getFontType() == FontType::Type3)
+    {
+        // Type 3 fonts have no font program
+        return nullptr;
+    }
+
+    PDFFontFacePointer fontFace = std::make_shared<PDFFontFace>();
+
+    const PDFFontCMap* cmap = font->getCMap();
+    const FontDescriptor* descriptor = font->getFontDescriptor();
+    if (descriptor->isEmbedded())
+    {
+        const QByteArray* embeddedFontData = descriptor->getEmbeddedFontData();
+        Q_ASSERT(embeddedFontData);
+        fontFace->m_fontData = *embeddedFontData;
+
+        // At this time, embedded font data should not be empty!
+        Q_ASSERT(!fontFace->m_fontData.isEmpty());
+        fontFace->m_isEmbedded = true;
+    }
+    else
+    {
+        StandardFontType standardFontType = StandardFontType::Invalid;
+        if (font->getFontType() == FontType::Type1 || font->getFontType() == FontType::MMType1)
+        {
+            Q_ASSERT(dynamic_cast<const PDFType1Font*>(font.get()));
+            const PDFType1Font* type1Font = static_cast<const PDFType1Font*>(font.get());
+            standardFontType = type1Font->getStandardFontType();
+        }
+
+        const PDFSystemFontInfoStorage* fontStorage = PDFSystemFontInfoStorage::getInstance();
+        fontFace->m_fontData = fontStorage->loadFont(font->getCIDSystemInfo(), descriptor, standardFontType, reporter);
+
+        if (fontFace->m_fontData.isEmpty())
+        {
+            throw PDFException(PDFTranslationContext::tr("Can't load system font '%1'.").arg(QString::fromLatin1(descriptor->fontName)));
+        }
+        fontFace->m_isEmbedded = false;
+
+        // System font faces are shared across all documents, so glyph
+        // outlines of system fonts are loaded only once per process.
+        const bool isVertical = cmap ? cmap->isVertical() : false;
+        if (PDFFontFacePointer sharedFontFace = fontStorage->getSharedFontFace(fontFace->m_fontData, isVertical))
+        {
+            return sharedFontFace;
+        }
+    }
+
+    PDFFontFace::checkFreeTypeError(FT_Init_FreeType(&fontFace->m_library));
+    PDFFontFace::checkFreeTypeError(FT_New_Memory_Face(fontFace->m_library, reinterpret_cast<const FT_Byte*>(fontFace->m_fontData.constData()), fontFace->m_fontData.size(), 0, &fontFace->m_face));
+    FT_Select_Charmap(fontFace->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
+    PDFFontFace::checkFreeTypeError(FT_Set_Pixel_Sizes(fontFace->m_face, 0, PDFFontFace::REFERENCE_PIXEL_SIZE));
+    fontFace->m_isVertical = cmap ? cmap->isVertical() : false;
+    if (!fontFace->m_isEmbedded)
+    {
+        if (const char* postScriptName = FT_Get_Postscript_Name(fontFace->m_face))
+        {
+            fontFace->m_postScriptName = QString::fromLatin1(postScriptName);
+        }
+
+        const QByteArray fontData = fontFace->m_fontData;
+        const bool isVertical = fontFace->m_isVertical;
+        return PDFSystemFontInfoStorage::getInstance()->registerSharedFontFace(fontData, isVertical, qMove(fontFace));
+    }
+
+    return fontFace;
+}
+
+PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter, PDFFontFacePointer fontFace)
 {
     PDFRealizedFontPointer result;
 
@@ -1153,61 +1498,19 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
     }
     else
     {
+        if (!fontFace)
+        {
+            fontFace = createFontFace(font, reporter);
+        }
+
         std::unique_ptr<PDFRealizedFontImpl> implPtr(new PDFRealizedFontImpl());
 
         PDFRealizedFontImpl* impl = implPtr.get();
         impl->m_parentFont = font;
         impl->m_pixelSize = pixelSize;
-
-        const PDFFontCMap* cmap = font->getCMap();
-        const FontDescriptor* descriptor = font->getFontDescriptor();
-        if (descriptor->isEmbedded())
-        {
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
-            const QByteArray* embeddedFontData = descriptor->getEmbeddedFontData();
-            Q_ASSERT(embeddedFontData);
-            impl->m_embeddedFontData = *embeddedFontData;
-
-            // At this time, embedded font data should not be empty!
-            Q_ASSERT(!impl->m_embeddedFontData.isEmpty());
-
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_embeddedFontData.constData()), impl->m_embeddedFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
-            impl->m_isVertical = cmap ? cmap->isVertical() : false;
-            impl->m_isEmbedded = true;
-            result.reset(new PDFRealizedFont(implPtr.release()));
-        }
-        else
-        {
-            StandardFontType standardFontType = StandardFontType::Invalid;
-            if (font->getFontType() == FontType::Type1 || font->getFontType() == FontType::MMType1)
-            {
-                Q_ASSERT(dynamic_cast<const PDFType1Font*>(font.get()));
-                const PDFType1Font* type1Font = static_cast<const PDFType1Font*>(font.get());
-                standardFontType = type1Font->getStandardFontType();
-            }
-
-            const PDFSystemFontInfoStorage* fontStorage = PDFSystemFontInfoStorage::getInstance();
-            impl->m_systemFontData = fontStorage->loadFont(font->getCIDSystemInfo(), descriptor, standardFontType, reporter);
-
-            if (impl->m_systemFontData.isEmpty())
-            {
-                throw PDFException(PDFTranslationContext::tr("Can't load system font '%1'.").arg(QString::fromLatin1(descriptor->fontName)));
-            }
-
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_systemFontData.constData()), impl->m_systemFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
-            impl->m_isVertical = cmap ? cmap->isVertical() : false;
-            impl->m_isEmbedded = false;
-            if (const char* postScriptName = FT_Get_Postscript_Name(impl->m_face))
-            {
-                impl->m_postScriptName = QString::fromLatin1(postScriptName);
-            }
-            result.reset(new PDFRealizedFont(implPtr.release()));
-        }
+        impl->m_face = fontFace->getFace();
+        impl->m_fontFace = qMove(fontFace);
+        result.reset(new PDFRealizedFont(implPtr.release()));
     }
 
     return result;
@@ -2139,6 +2442,19 @@ FontType PDFTrueTypeFont::getFontType() const
     return FontType::TrueType;
 }
 
+PDFFontCache::PDFFontCache(size_t fontCacheLimit, size_t realizedFontCacheLimit) :
+    m_fontCacheLimit(fontCacheLimit),
+    m_realizedFontCacheLimit(realizedFontCacheLimit),
+    m_document(nullptr),
+    m_glyphCache(std::make_shared<PDFGlyphCache>()),
+    m_meshCache(std::make_shared<PDFMeshCache>()),
+    m_parsedContentCache(std::make_shared<PDFParsedContentCache>()),
+    m_imageCache(std::make_shared<PDFImageCache>()),
+    m_sharedContentCache(std::make_shared<PDFSharedContentCache>())
+{
+
+}
+
 void PDFFontCache::setDocument(const PDFModifiedDocument& document)
 {
     QMutexLocker lock(&m_mutex);
@@ -2150,41 +2466,32 @@ void PDFFontCache::setDocument(const PDFModifiedDocument& document)
         // document remains the same. So it is not needed to clear font cache.
         if (document.hasReset() || document.hasPageContentsChanged())
         {
-            m_fontCache.clear();
-            m_realizedFontCache.clear();
+            clearShards(m_fontCache, m_fontCount);
+            clearShards(m_fontFaceCache, m_fontFaceCount);
+            clearShards(m_realizedFontCache, m_realizedFontCount);
+            m_glyphCache->clear();
+            m_meshCache->clear();
+            m_parsedContentCache->clear();
+            m_imageCache->clear();
+            m_sharedContentCache->clear();
         }
     }
 }
 
 PDFFontPointer PDFFontCache::getFont(const PDFObject& fontObject, const QByteArray& fontId) const
 {
+    const PDFDocument* document = m_document.load(std::memory_order_acquire);
+
     if (fontObject.isReference())
     {
         // Font is object reference. Look in the cache, if we have it, then return it.
-
-        QMutexLocker lock(&m_mutex);
-        PDFObjectReference reference = fontObject.getReference();
-
-        auto it = m_fontCache.find(reference);
-        if (it == m_fontCache.cend())
-        {
-            // We must create the font
-            PDFFontPointer font = PDFFont::createFont(fontObject, fontId, m_document);
-
-            if (m_fontCacheShrinkDisabledObjects.empty() && m_fontCache.size() >= m_fontCacheLimit)
-            {
-                // We have exceeded the cache limit. Clear the cache.
-                m_fontCache.clear();
-            }
-
-            it = m_fontCache.insert(std::make_pair(reference, qMove(font))).first;
-        }
-        return it->second;
+        auto create = [&fontObject, &fontId, document]() { return PDFFont::createFont(fontObject, fontId, document); };
+        return getOrCreate(m_fontCache, m_fontCount, m_fontCacheLimit, fontObject.getReference(), create);
     }
     else
     {
         // Object is not a reference. Create font directly and return it.
-        return PDFFont::createFont(fontObject, fontId, m_document);
+        return PDFFont::createFont(fontObject, fontId, document);
     }
 }
 
@@ -2192,22 +2499,132 @@ PDFRealizedFontPointer PDFFontCache::getRealizedFont(const PDFFontPointer& font,
 {
     Q_ASSERT(font);
 
-    QMutexLocker lock(&m_mutex);
-    auto it = m_realizedFontCache.find(std::make_pair(font, size));
-    if (it == m_realizedFontCache.cend())
+    auto create = [this, &font, size, reporter]()
     {
-        // We must create the realized font
-        PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, size, reporter);
+        PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::FontRealization);
 
-        if (m_fontCacheShrinkDisabledObjects.empty() && m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+        // Font face is shared by all realized fonts of the font, so glyph
+        // outlines are loaded only once for all font sizes.
+        PDFFontFacePointer fontFace;
+        if (font->getFontType() != FontType::Type3)
         {
-            m_realizedFontCache.clear();
+            auto createFontFace = [&font, reporter]() { return PDFRealizedFont::createFontFace(font, reporter); };
+            fontFace = getOrCreate(m_fontFaceCache, m_fontFaceCount, m_fontCacheLimit, font, createFontFace);
         }
 
-        it = m_realizedFontCache.insert(std::make_pair(std::make_pair(font, size), qMove(realizedFont))).first;
+        return PDFRealizedFont::createRealizedFont(font, size, reporter, qMove(fontFace));
+    };
+    return getOrCreate(m_realizedFontCache, m_realizedFontCount, m_realizedFontCacheLimit, std::make_pair(font, size), create);
+}
+
+template<typename Key, typename Value, typename Hash, typename Create>
+Value PDFFontCache::getOrCreate(Shards<Key, Value, Hash>& shards, std::atomic<size_t>& count, size_t limit, const Key& key, Create create) const
+{
+    Shard<Key, Value, Hash>& shard = shards[Hash()(key) % SHARD_COUNT];
+
+    std::shared_future<Value> value;
+
+    // Fast path - value is already in the cache (or it is being created)
+    {
+        QReadLocker lock(&shard.lock);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.cend())
+        {
+            value = it->second.value;
+        }
     }
 
-    return it->second;
+    if (!value.valid())
+    {
+        if (isShrinkEnabled() && count.load(std::memory_order_relaxed) >= limit)
+        {
+            // We have exceeded the cache limit. Clear the cache.
+            clearShards(shards, count);
+        }
+
+        std::promise<Value> promise;
+        const quint64 serialNumber = ++m_serialNumber;
+        bool isCreator = false;
+
+        {
+            QWriteLocker lock(&shard.lock);
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.cend())
+            {
+                // Other thread was faster, and is now creating the value
+                value = it->second.value;
+            }
+            else
+            {
+                value = promise.get_future().share();
+                shard.entries.emplace(key, Entry<Value>{ value, serialNumber });
+                ++count;
+                isCreator = true;
+            }
+        }
+
+        if (isCreator)
+        {
+            // Create the value outside of the lock, other threads requesting
+            // the same value wait for the future, other values are accessible.
+            try
+            {
+                promise.set_value(create());
+            }
+            catch (...)
+            {
+                // Creation failed, remove the entry (if it was not already
+                // removed by clearing the cache), so creation can be retried.
+                {
+                    QWriteLocker lock(&shard.lock);
+                    auto it = shard.entries.find(key);
+                    if (it != shard.entries.cend() && it->second.serialNumber == serialNumber)
+                    {
+                        shard.entries.erase(it);
+                        --count;
+                    }
+                }
+
+                promise.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    // Other thread is creating the value, trace the waiting
+    if (PDFTrace::isEnabled() && value.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        PDFTraceScope traceScope("font-cache-wait", "lock");
+        value.wait();
+    }
+
+    // Rethrows the exception, if value creation failed
+    return value.get();
+}
+
+template<typename Key, typename Value, typename Hash>
+void PDFFontCache::clearShards(Shards<Key, Value, Hash>& shards, std::atomic<size_t>& count)
+{
+    for (Shard<Key, Value, Hash>& shard : shards)
+    {
+        QWriteLocker lock(&shard.lock);
+        count -= shard.entries.size();
+        shard.entries.clear();
+    }
+}
+
+size_t PDFFontCache::FontKeyHash::operator()(const PDFObjectReference& reference) const
+{
+    return qHash(reference.objectNumber) ^ (qHash(reference.generation) << 1);
+}
+
+size_t PDFFontCache::FontFaceKeyHash::operator()(const PDFFontPointer& key) const
+{
+    return qHash(key.data());
+}
+
+size_t PDFFontCache::RealizedFontKeyHash::operator()(const RealizedFontKey& key) const
+{
+    return qHash(key.first.data()) ^ (qHash(key.second) << 1);
 }
 
 void PDFFontCache::setCacheShrinkEnabled(const void* source, bool enabled)
@@ -2216,12 +2633,14 @@ void PDFFontCache::setCacheShrinkEnabled(const void* source, bool enabled)
     if (enabled)
     {
         m_fontCacheShrinkDisabledObjects.erase(source);
+        m_fontCacheShrinkDisabledCount = m_fontCacheShrinkDisabledObjects.size();
         lock.unlock();
         shrink();
     }
     else
     {
         m_fontCacheShrinkDisabledObjects.insert(source);
+        m_fontCacheShrinkDisabledCount = m_fontCacheShrinkDisabledObjects.size();
     }
 }
 
@@ -2238,19 +2657,41 @@ void PDFFontCache::setCacheLimits(std::size_t fontCacheLimit, std::size_t instan
 void PDFFontCache::shrink()
 {
     QMutexLocker lock(&m_mutex);
-    if (m_fontCacheShrinkDisabledObjects.empty())
+    if (isShrinkEnabled())
     {
-        if (m_fontCache.size() >= m_fontCacheLimit)
+        if (m_fontCount >= m_fontCacheLimit)
+        {
+            clearShards(m_fontCache, m_fontCount);
+        }
+        if (m_fontFaceCount >= m_fontCacheLimit)
         {
-            m_fontCache.clear();
+            clearShards(m_fontFaceCache, m_fontFaceCount);
         }
-        if (m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+        if (m_realizedFontCount >= m_realizedFontCacheLimit)
         {
-            m_realizedFontCache.clear();
+            clearShards(m_realizedFontCache, m_realizedFontCount);
         }
     }
 }
 
+void PDFFontCache::setHibernated(bool hibernated)
+{
+    if (hibernated)
+    {
+        QMutexLocker lock(&m_mutex);
+        if (isShrinkEnabled())
+        {
+            // Fonts can be created again from the document, when they are needed
+            clearShards(m_fontCache, m_fontCount);
+            clearShards(m_fontFaceCache, m_fontFaceCount);
+            clearShards(m_realizedFontCache, m_realizedFontCount);
+        }
+    }
+
+    std::vector<PDFMemoryBudgetClient*> clients = { m_glyphCache.get(), m_meshCache.get(), m_parsedContentCache.get(), m_imageCache.get(), m_sharedContentCache.get() };
+    PDFMemoryBudget::getInstance()->setHibernated(clients, hibernated);
+}
+
 const QByteArray* FontDescriptor::getEmbeddedFontData() const
 {
     if (!fontFile.isEmpty())
@@ -2271,20 +2712,7 @@ const QByteArray* FontDescriptor::getEmbeddedFontData() const
 
 PDFFontCMap PDFFontCMap::createFromName(const QByteArray& name)
 {
-    QFile file(QString(":/cmaps/%1").arg(QString::fromLatin1(name)));
-    if (file.exists())
-    {
-        QByteArray data;
-        if (file.open(QFile::ReadOnly))
-        {
-            data = file.readAll();
-            file.close();
-        }
-
-        return createFromData(data);
-    }
-
-    throw PDFException(PDFTranslationContext::tr("Can't load CID font mapping named '%1'.").arg(QString::fromLatin1(name)));
+    return PDFFontCMapRepository::getInstance()->getCMap(name);
 }
 
 PDFFontCMap PDFFontCMap::createFromData(const QByteArray& data)
@@ -2488,7 +2916,7 @@ PDFFontCMap PDFFontCMap::createFromData(const QByteArray& data)
     {
         for (const PDFFontCMap& map : additionalMappings)
         {
-            entries.insert(entries.cend(), map.m_entries.cbegin(), map.m_entries.cend());
+            entries.insert(entries.cend(), map.getEntries().cbegin(), map.getEntries().cend());
         }
     }
 
@@ -2503,8 +2931,8 @@ QByteArray PDFFontCMap::serialize() const
         QDataStream stream(&result, QIODevice::WriteOnly);
         stream << m_maxKeyLength;
         stream << m_vertical;
-        stream << m_entries.size();
-        for (const Entry& entry : m_entries)
+        stream << getEntries().size();
+        for (const Entry& entry : getEntries())
         {
             stream << entry.from;
             stream << entry.to;
@@ -2526,7 +2954,9 @@ PDFFontCMap PDFFontCMap::deserialize(const QByteArray& byteArray)
 
     Entries::size_type size = 0;
     stream >> size;
-    result.m_entries.reserve(size);
+
+    Entries entries;
+    entries.reserve(size);
     for (Entries::size_type i = 0; i < size; ++i)
     {
         Entry entry;
@@ -2534,14 +2964,17 @@ PDFFontCMap PDFFontCMap::deserialize(const QByteArray& byteArray)
         stream >> entry.to;
         stream >> entry.byteCount;
         stream >> entry.cid;
-        result.m_entries.push_back(entry);
+        entries.push_back(entry);
     }
+    result.m_entries = std::make_shared<const Entries>(qMove(entries));
 
     return result;
 }
 
 std::vector<CID> PDFFontCMap::interpret(const QByteArray& byteArray) const
 {
+    const Entries& entries = getEntries();
+
     std::vector<CID> result;
     result.reserve(byteArray.size() / m_maxKeyLength);
 
@@ -2554,8 +2987,8 @@ std::vector<CID> PDFFontCMap::interpret(const QByteArray& byteArray) const
         ++scannedBytes;
 
         // Find suitable mapping
-        auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [value, scannedBytes](const Entry& entry) { return entry.from <= value && entry.to >= value && entry.byteCount == scannedBytes; });
-        if (it != m_entries.cend())
+        auto it = std::find_if(entries.cbegin(), entries.cend(), [value, scannedBytes](const Entry& entry) { return entry.from <= value && entry.to >= value && entry.byteCount == scannedBytes; });
+        if (it != entries.cend())
         {
             const Entry& entry = *it;
             const CID cid = value - entry.from + entry.cid;
@@ -2580,7 +3013,7 @@ QByteArray PDFFontCMap::encode(CID cid) const
 {
     QByteArray byteArray;
 
-    for (const auto& entry : m_entries)
+    for (const auto& entry : getEntries())
     {
         unsigned int minPossibleValue = entry.from + entry.cid;
         unsigned int maxPossibleValue = entry.to + entry.cid;
@@ -2609,8 +3042,9 @@ QChar PDFFontCMap::getToUnicode(CID cid) const
 {
     if (isValid())
     {
-        auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [cid](const Entry& entry) { return entry.from <= cid && entry.to >= cid; });
-        if (it != m_entries.cend())
+        const Entries& entries = getEntries();
+        auto it = std::find_if(entries.cbegin(), entries.cend(), [cid](const Entry& entry) { return entry.from <= cid && entry.to >= cid; });
+        if (it != entries.cend())
         {
             const Entry& entry = *it;
             const CID unicodeCID = cid - entry.from + entry.cid;
@@ -2628,7 +3062,7 @@ CID PDFFontCMap::getFromUnicode(QChar character) const
         char16_t ucs4 = character.unicode();
         const CID unicodeCID = ucs4;
 
-        for (const Entry& entry : m_entries)
+        for (const Entry& entry : getEntries())
         {
             const CID minUnicodeCID = entry.cid;
             const CID maxUnicodeCID = (entry.to - entry.from) + entry.cid;
@@ -2645,11 +3079,17 @@ CID PDFFontCMap::getFromUnicode(QChar character) const
 }
 
 PDFFontCMap::PDFFontCMap(Entries&& entries, bool vertical) :
-    m_entries(qMove(entries)),
+    m_entries(std::make_shared<const Entries>(qMove(entries))),
     m_maxKeyLength(0),
     m_vertical(vertical)
 {
-    m_maxKeyLength = std::accumulate(m_entries.cbegin(), m_entries.cend(), 0, [](unsigned int a, const Entry& b) { return qMax(a, b.byteCount); });
+    m_maxKeyLength = std::accumulate(m_entries->cbegin(), m_entries->cend(), 0, [](unsigned int a, const Entry& b) { return qMax(a, b.byteCount); });
+}
+
+const PDFFontCMap::Entries& PDFFontCMap::getEntries() const
+{
+    static const Entries dummy;
+    return m_entries ? *m_entries : dummy;
 }
 
 PDFFontCMap::Entries PDFFontCMap::optimize(const PDFFontCMap::Entries& entries)
@@ -2689,6 +3129,8 @@ PDFFontCMapRepository* PDFFontCMapRepository::getInstance()
 
 void PDFFontCMapRepository::saveToFile(const QString& fileName) const
 {
+    QMutexLocker lock(&m_mutex);
+
     QFile file(fileName);
     if (file.open(QFile::WriteOnly | QFile::Truncate))
     {
@@ -2723,7 +3165,7 @@ bool PDFFontCMapRepository::loadFromFile(const QString& fileName)
                 QByteArray value;
                 stream >> key;
                 stream >> value;
-                m_cmaps[qMove(key)] = qMove(value);
+                add(key, qMove(value));
             }
         }
 
@@ -2734,6 +3176,71 @@ bool PDFFontCMapRepository::loadFromFile(const QString& fileName)
     return false;
 }
 
+PDFFontCMap PDFFontCMapRepository::getCMap(const QByteArray& name)
+{
+    QByteArray precompiledData;
+
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto it = m_parsedCMaps.find(name);
+        if (it != m_parsedCMaps.cend())
+        {
+            return it->second;
+        }
+
+        auto precompiledIt = m_cmaps.find(name);
+        if (precompiledIt != m_cmaps.cend())
+        {
+            precompiledData = precompiledIt->second;
+        }
+    }
+
+    // CMap is created outside of the lock, because CMap can
+    // use other CMaps (usecmap operator), which are also taken from this
+    // repository. If two threads create the same CMap simultaneously,
+    // then the first created one is kept.
+    PDFFontCMap cmap;
+    if (!precompiledData.isEmpty())
+    {
+        cmap = PDFFontCMap::deserialize(precompiledData);
+    }
+    else
+    {
+        QFile file(QString(":/cmaps/%1").arg(QString::fromLatin1(name)));
+        if (!file.exists())
+        {
+            throw PDFException(PDFTranslationContext::tr("Can't load CID font mapping named '%1'.").arg(QString::fromLatin1(name)));
+        }
+
+        QByteArray data;
+        if (file.open(QFile::ReadOnly))
+        {
+            data = file.readAll();
+            file.close();
+        }
+
+        cmap = PDFFontCMap::createFromData(data);
+    }
+
+    QMutexLocker lock(&m_mutex);
+    return m_parsedCMaps.emplace(name, qMove(cmap)).first->second;
+}
+
+void PDFFontCMapRepository::add(const QByteArray& key, QByteArray value)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cmaps[key] = qMove(value);
+    m_parsedCMaps.erase(key);
+}
+
+void PDFFontCMapRepository::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_cmaps.clear();
+    m_parsedCMaps.clear();
+}
+
 PDFFontCMapRepository::PDFFontCMapRepository()
 {
 
@@ -2806,6 +3313,27 @@ const QByteArray* PDFType3Font::getContentStream(int characterIndex) const
     return nullptr;
 }
 
+PDFType3Font::GlyphOutline PDFType3Font::getGlyphOutline(int characterIndex, bool isDraft, const std::function<GlyphOutline()>& createOutline) const
+{
+    const std::pair<int, bool> key(characterIndex, isDraft);
+
+    {
+        QMutexLocker lock(&m_glyphOutlinesMutex);
+        auto it = m_glyphOutlines.find(key);
+        if (it != m_glyphOutlines.cend())
+        {
+            return it->second;
+        }
+    }
+
+    // Outline is created outside the lock, because glyph content stream
+    // is being processed. If other thread was faster, we use its outline.
+    GlyphOutline outline = createOutline();
+
+    QMutexLocker lock(&m_glyphOutlinesMutex);
+    return m_glyphOutlines.emplace(key, qMove(outline)).first->second;
+}
+
 void PDFRealizedType3FontImpl::fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter)
 {
     Q_ASSERT(dynamic_cast<const PDFType3Font*>(m_parentFont.get()));
@@ -21,13 +21,21 @@
 #include "pdfglobal.h"
 #include "pdfencoding.h"
 #include "pdfobject.h"
+#include "pdfglyphcache.h"
+#include "pdfmeshcache.h"
 
 #include <QFont>
 #include <QMutex>
 #include <QTransform>
+#include <QReadWriteLock>
 #include <QSharedPointer>
 
 #include <set>
+#include <array>
+#include <atomic>
+#include <future>
+#include <numeric>
+#include <functional>
 #include <unordered_map>
 
 class QPainterPath;
@@ -38,6 +46,9 @@ class PDFDocument;
 class PDFModifiedDocument;
 class PDFRenderErrorReporter;
 class PDFFontCMap;
+class PDFParsedContentCache;
+class PDFImageCache;
+class PDFSharedContentCache;
 
 using CID = unsigned int;
 using GID = unsigned int;
@@ -244,8 +255,10 @@ using PDFFontPointer = QSharedPointer<PDFFont>;
 
 class PDFRealizedFont;
 class IRealizedFontImpl;
+class PDFFontFace;
 
 using PDFRealizedFontPointer = QSharedPointer<PDFRealizedFont>;
+using PDFFontFacePointer = std::shared_ptr<PDFFontFace>;
 
 struct CharacterInfo
 {
@@ -280,15 +293,28 @@ public:
     /// Returns character info
     CharacterInfos getCharacterInfos() const;
 
+    /// Returns unique id of the realized font. Ids are never reused
+    /// during the lifetime of the application, so they can be used
+    /// to identify glyphs of this font in the caches.
+    quint64 getUniqueId() const { return m_uniqueId; }
+
+    /// Creates font face (font program loaded by FreeType together with size independent
+    /// glyph outline cache), which can be shared by realized fonts of different sizes.
+    /// For Type 3 fonts, nullptr is returned. If font face can't be created, then exception is thrown.
+    /// \param font Font
+    /// \param reporter Error reporter
+    static PDFFontFacePointer createFontFace(PDFFontPointer font, PDFRenderErrorReporter* reporter);
+
     /// Creates new realized font from the standard font. If font can't be created,
-    /// then exception is thrown.
-    static PDFRealizedFontPointer createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter);
+    /// then exception is thrown. If font face is not provided, new one is created.
+    static PDFRealizedFontPointer createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter, PDFFontFacePointer fontFace = nullptr);
 
 private:
     /// Constructs new realized font
-    explicit PDFRealizedFont(IRealizedFontImpl* impl) : m_impl(impl) { }
+    explicit PDFRealizedFont(IRealizedFontImpl* impl);
 
     IRealizedFontImpl* m_impl;
+    quint64 m_uniqueId;
 };
 
 struct PDFEncodedText
@@ -433,17 +459,15 @@ public:
 };
 
 /// Font cache which caches both fonts, and realized fonts. Cache has individual limit
-/// for fonts, and realized fonts.
+/// for fonts, and realized fonts. Cache is divided into shards by hashed keys, each
+/// shard is protected by its own read-write lock, so threads looking up different
+/// fonts do not block each other. Font creation is single-flight: if more threads
+/// request the same font (or realized font) at once, only one of them creates it,
+/// and others wait for the result.
 class PDF4QTLIBCORESHARED_EXPORT PDFFontCache
 {
 public:
-    inline explicit PDFFontCache(size_t fontCacheLimit, size_t realizedFontCacheLimit) :
-        m_fontCacheLimit(fontCacheLimit),
-        m_realizedFontCacheLimit(realizedFontCacheLimit),
-        m_document(nullptr)
-    {
-
-    }
+    explicit PDFFontCache(size_t fontCacheLimit, size_t realizedFontCacheLimit);
 
     /// Sets the document to the cache. Whole cache is cleared,
     /// if it is needed.
@@ -478,13 +502,103 @@ public:
     /// If shrinking is enabled, then erase font, if cache limit is exceeded.
     void shrink();
 
+    /// Hibernates the cache (or wakes it up). When cache is hibernated, fonts
+    /// are erased (if shrinking is enabled) and caches of glyphs, images,
+    /// meshes and content are hibernated in the global memory budget,
+    /// so their items are evicted. Caches remain usable, when they are
+    /// hibernated, but they do not keep any items.
+    /// \param hibernated Hibernate (true) or wake up (false) the cache
+    void setHibernated(bool hibernated);
+
+    /// Returns cache of rasterized glyphs of realized fonts
+    const std::shared_ptr<PDFGlyphCache>& getGlyphCache() const { return m_glyphCache; }
+
+    /// Returns cache of shading meshes
+    const std::shared_ptr<PDFMeshCache>& getMeshCache() const { return m_meshCache; }
+
+    /// Returns cache of parsed content streams (forms, Type 3 glyphs)
+    const std::shared_ptr<PDFParsedContentCache>& getParsedContentCache() const { return m_parsedContentCache; }
+
+    /// Returns cache of decoded images
+    const std::shared_ptr<PDFImageCache>& getImageCache() const { return m_imageCache; }
+
+    /// Returns cache of compiled content of forms placed on many pages
+    const std::shared_ptr<PDFSharedContentCache>& getSharedContentCache() const { return m_sharedContentCache; }
+
 private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    using RealizedFontKey = std::pair<PDFFontPointer, PDFReal>;
+
+    struct FontKeyHash
+    {
+        size_t operator()(const PDFObjectReference& reference) const;
+    };
+
+    struct FontFaceKeyHash
+    {
+        size_t operator()(const PDFFontPointer& key) const;
+    };
+
+    struct RealizedFontKeyHash
+    {
+        size_t operator()(const RealizedFontKey& key) const;
+    };
+
+    /// Cache entry. Value is stored as shared future, so threads requesting
+    /// the value, which is just being created, can wait for it. Serial number
+    /// identifies the entry, when it must be removed (creation failed).
+    template<typename Value>
+    struct Entry
+    {
+        std::shared_future<Value> value;
+        quint64 serialNumber = 0;
+    };
+
+    template<typename Key, typename Value, typename Hash>
+    struct Shard
+    {
+        mutable QReadWriteLock lock;
+        std::unordered_map<Key, Entry<Value>, Hash> entries;
+    };
+
+    template<typename Key, typename Value, typename Hash>
+    using Shards = std::array<Shard<Key, Value, Hash>, SHARD_COUNT>;
+
+    using FontShards = Shards<PDFObjectReference, PDFFontPointer, FontKeyHash>;
+    using FontFaceShards = Shards<PDFFontPointer, PDFFontFacePointer, FontFaceKeyHash>;
+    using RealizedFontShards = Shards<RealizedFontKey, PDFRealizedFontPointer, RealizedFontKeyHash>;
+
+    /// Finds value in the cache, or creates it using \p create function,
+    /// if it is not found. If value is being created by another thread,
+    /// then function waits for the result.
+    template<typename Key, typename Value, typename Hash, typename Create>
+    Value getOrCreate(Shards<Key, Value, Hash>& shards, std::atomic<size_t>& count, size_t limit, const Key& key, Create create) const;
+
+    /// Clears all shards
+    template<typename Key, typename Value, typename Hash>
+    static void clearShards(Shards<Key, Value, Hash>& shards, std::atomic<size_t>& count);
+
+    /// Returns true, if cache can shrink (no object disabled shrinking)
+    bool isShrinkEnabled() const { return m_fontCacheShrinkDisabledCount.load(std::memory_order_acquire) == 0; }
+
     size_t m_fontCacheLimit;
     size_t m_realizedFontCacheLimit;
     mutable QMutex m_mutex;
-    const PDFDocument* m_document;
-    mutable std::map<PDFObjectReference, PDFFontPointer> m_fontCache;
-    mutable std::map<std::pair<PDFFontPointer, PDFReal>, PDFRealizedFontPointer> m_realizedFontCache;
+    std::atomic<const PDFDocument*> m_document;
+    mutable FontShards m_fontCache;
+    mutable FontFaceShards m_fontFaceCache;
+    mutable RealizedFontShards m_realizedFontCache;
+    mutable std::atomic<size_t> m_fontCount = 0;
+    mutable std::atomic<size_t> m_fontFaceCount = 0;
+    mutable std::atomic<size_t> m_realizedFontCount = 0;
+    mutable std::atomic<quint64> m_serialNumber = 0;
+    std::atomic<size_t> m_fontCacheShrinkDisabledCount = 0;
+    std::shared_ptr<PDFGlyphCache> m_glyphCache;
+    std::shared_ptr<PDFMeshCache> m_meshCache;
+    std::shared_ptr<PDFParsedContentCache> m_parsedContentCache;
+    std::shared_ptr<PDFImageCache> m_imageCache;
+    std::shared_ptr<PDFSharedContentCache> m_sharedContentCache;
     mutable std::set<const void*> m_fontCacheShrinkDisabledObjects;
 };
 
@@ -504,7 +618,7 @@ public:
         }
         else if ((2 * cid + 1) < CID(m_mapping.size()))
         {
-            return (GID(m_mapping[2 * cid]) << 8) + GID(m_mapping[2 * cid + 1]);
+            return (GID(static_cast<unsigned char>(m_mapping[2 * cid])) << 8) + GID(static_cast<unsigned char>(m_mapping[2 * cid + 1]));
         }
 
         // This should occur only in case of bad (damaged) PDF file - because in this case,
@@ -537,6 +651,40 @@ public:
         return 0;
     }
 
+    /// Returns true, if mapping is identity
+    bool isIdentity() const { return m_mapping.isEmpty(); }
+
+    /// Returns number of CIDs with explicit mapping (zero for identity mapping)
+    CID getMappedCIDCount() const { return CID(m_mapping.size() / 2); }
+
+    /// Creates inverse mapping (GID to CID) for glyphs from 0 to \p glyphCount - 1
+    /// in one pass over the mapping. For each glyph, lowest CID mapped to the glyph
+    /// is used (as in function unmap), unmapped glyphs have CID 0.
+    /// \param glyphCount Glyph count
+    std::vector<CID> createInverseMapping(GID glyphCount) const
+    {
+        std::vector<CID> result(glyphCount, 0);
+
+        if (isIdentity())
+        {
+            std::iota(result.begin(), result.end(), 0);
+            return result;
+        }
+
+        std::vector<bool> isMapped(glyphCount, false);
+        for (CID cid = 0, cidCount = getMappedCIDCount(); cid < cidCount; ++cid)
+        {
+            const GID gid = map(cid);
+            if (gid < glyphCount && !isMapped[gid])
+            {
+                result[gid] = cid;
+                isMapped[gid] = true;
+            }
+        }
+
+        return result;
+    }
+
 private:
     QByteArray m_mapping;
 };
@@ -548,7 +696,7 @@ public:
     explicit PDFFontCMap() = default;
 
     /// Returns true, if mapping is valid
-    bool isValid() const { return !m_entries.empty(); }
+    bool isValid() const { return m_entries && !m_entries->empty(); }
 
     /// Returns true, if vertical writing mode is on
     bool isVertical() const { return m_vertical; }
@@ -617,7 +765,11 @@ private:
     /// requires, that entries are sorted.
     static Entries optimize(const Entries& entries);
 
-    Entries m_entries;
+    /// Returns entries (or empty entries, if mapping is invalid)
+    const Entries& getEntries() const;
+
+    /// Entries are immutable, so they can be shared between copies of the mapping
+    std::shared_ptr<const Entries> m_entries;
     unsigned int m_maxKeyLength = 0;
     bool m_vertical = false;
 };
@@ -654,6 +806,20 @@ public:
     /// present, empty (null) character is returned.
     QChar getUnicode(int characterIndex) const { return m_toUnicode.getToUnicode(characterIndex); }
 
+    using GlyphOutline = std::shared_ptr<const QPainterPath>;
+
+    /// Returns cached outline of the character glyph (in glyph space). If outline
+    /// is not cached yet, it is created by \p createOutline function. Outline
+    /// is created only once for each character, and it is shared between all
+    /// font sizes and pages. If glyph can't be represented by an outline (for example,
+    /// it is colored glyph, or it paints images), nullptr is returned.
+    /// Draft outlines (approximations of glyphs, which can't be represented by
+    /// the outline exactly) are cached separately.
+    /// \param characterIndex Character index
+    /// \param isDraft Is draft outline requested?
+    /// \param createOutline Function, which creates glyph outline
+    GlyphOutline getGlyphOutline(int characterIndex, bool isDraft, const std::function<GlyphOutline()>& createOutline) const;
+
 private:
     int m_firstCharacterIndex;
     int m_lastCharacterIndex;
@@ -662,6 +828,9 @@ private:
     std::vector<double> m_widths;
     PDFObject m_resources;
     PDFFontCMap m_toUnicode;
+
+    mutable QMutex m_glyphOutlinesMutex;
+    mutable std::map<std::pair<int, bool>, GlyphOutline> m_glyphOutlines;
 };
 
 /// Composite font (CID-keyed font)
@@ -715,10 +884,18 @@ public:
     static PDFFontCMapRepository* getInstance();
 
     /// Adds CMAP to the repository
-    void add(const QByteArray& key, QByteArray value) { m_cmaps[key] = qMove(value); }
+    void add(const QByteArray& key, QByteArray value);
 
     /// Clears the repository
-    void clear() { m_cmaps.clear(); }
+    void clear();
+
+    /// Returns predefined CMap with given name. Each CMap is created only once
+    /// per process, from the serialized data, if repository contains them,
+    /// otherwise from the CMap resource file. Created CMaps share their data,
+    /// so they are cheap to copy. If CMap can't be loaded, exception is thrown.
+    /// This function is thread safe.
+    /// \param name Name of the predefined CMap
+    PDFFontCMap getCMap(const QByteArray& name);
 
     /// Saves the repository content to the file
     void saveToFile(const QString& fileName) const;
@@ -729,8 +906,13 @@ public:
 private:
     explicit PDFFontCMapRepository();
 
+    mutable QMutex m_mutex;
+
     /// Storage for predefined cmaps
     std::map<QByteArray, QByteArray> m_cmaps;
+
+    /// Already created cmaps
+    std::map<QByteArray, PDFFontCMap> m_parsedCMaps;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFSystemFont
@@ -0,0 +1,350 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdffontsubsetter.h"
+#include "pdfexception.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+static constexpr quint32 makeTag(const char (&tag)[5])
+{
+    return (quint32(quint8(tag[0])) << 24) | (quint32(quint8(tag[1])) << 16) | (quint32(quint8(tag[2])) << 8) | quint32(quint8(tag[3]));
+}
+
+static constexpr quint32 TAG_HEAD = makeTag("head");
+static constexpr quint32 TAG_MAXP = makeTag("maxp");
+static constexpr quint32 TAG_LOCA = makeTag("loca");
+static constexpr quint32 TAG_GLYF = makeTag("glyf");
+
+/// Tables, which are kept in the subset font. Other tables (layout tables,
+/// digital signature, kerning, ...) are not needed for rendering glyphs in PDF.
+static constexpr quint32 KEPT_TABLES[] = { makeTag("OS/2"), makeTag("cmap"), makeTag("cvt "), makeTag("fpgm"),
+                                           makeTag("glyf"), makeTag("head"), makeTag("hhea"), makeTag("hmtx"),
+                                           makeTag("loca"), makeTag("maxp"), makeTag("name"), makeTag("post"),
+                                           makeTag("prep"), makeTag("vhea"), makeTag("vmtx") };
+
+static quint16 readUInt16(const QByteArray& data, qsizetype offset)
+{
+    if (offset < 0 || offset + 2 > data.size())
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid TrueType font data."));
+    }
+
+    return qFromBigEndian<quint16>(data.constData() + offset);
+}
+
+static quint32 readUInt32(const QByteArray& data, qsizetype offset)
+{
+    if (offset < 0 || offset + 4 > data.size())
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid TrueType font data."));
+    }
+
+    return qFromBigEndian<quint32>(data.constData() + offset);
+}
+
+static void appendUInt16(QByteArray& data, quint16 value)
+{
+    char buffer[2];
+    qToBigEndian<quint16>(value, buffer);
+    data.append(buffer, sizeof(buffer));
+}
+
+static void appendUInt32(QByteArray& data, quint32 value)
+{
+    char buffer[4];
+    qToBigEndian<quint32>(value, buffer);
+    data.append(buffer, sizeof(buffer));
+}
+
+PDFTrueTypeFontSubsetter::PDFTrueTypeFontSubsetter(QByteArray fontData) :
+    m_fontData(qMove(fontData))
+{
+    // Parse table directory. Font collections and fonts with CFF outlines are not supported.
+    const quint32 version = readUInt32(m_fontData, 0);
+    if (version != 0x00010000 && version != makeTag("true"))
+    {
+        throw PDFException(PDFTranslationContext::tr("Font is not a TrueType font."));
+    }
+
+    const quint16 tableCount = readUInt16(m_fontData, 4);
+    for (quint16 i = 0; i < tableCount; ++i)
+    {
+        const qsizetype recordOffset = 12 + 16 * qsizetype(i);
+
+        Table table;
+        table.tag = readUInt32(m_fontData, recordOffset);
+        table.offset = readUInt32(m_fontData, recordOffset + 8);
+        table.length = readUInt32(m_fontData, recordOffset + 12);
+
+        if (qsizetype(table.offset) + qsizetype(table.length) > m_fontData.size())
+        {
+            throw PDFException(PDFTranslationContext::tr("Invalid TrueType font data."));
+        }
+
+        m_tables.push_back(table);
+    }
+}
+
+QByteArray PDFTrueTypeFontSubsetter::subset(const std::set<unsigned int>& glyphs) const
+{
+    QByteArray head = getTableData(TAG_HEAD);
+    const QByteArray maxp = getTableData(TAG_MAXP);
+    const QByteArray loca = getTableData(TAG_LOCA);
+    const QByteArray glyf = getTableData(TAG_GLYF);
+
+    if (head.size() < 54 || maxp.size() < 6 || loca.isEmpty() || glyf.isEmpty())
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid TrueType font data."));
+    }
+
+    const bool isLongLocaFormat = readUInt16(head, 50) != 0;
+    const unsigned int glyphCount = readUInt16(maxp, 4);
+
+    // Compute closure of used glyphs (components of composite glyphs)
+    std::vector<bool> isGlyphUsed(glyphCount, false);
+    std::vector<unsigned int> stack(glyphs.cbegin(), glyphs.cend());
+    stack.push_back(0);
+
+    while (!stack.empty())
+    {
+        const unsigned int glyph = stack.back();
+        stack.pop_back();
+
+        if (glyph >= glyphCount || isGlyphUsed[glyph])
+        {
+            continue;
+        }
+
+        isGlyphUsed[glyph] = true;
+        addComponents(getGlyph(glyf, loca, isLongLocaFormat, glyph), stack);
+    }
+
+    // Create new glyf and loca tables. Loca table is always in the long format.
+    QByteArray newGlyf;
+    QByteArray newLoca;
+    newLoca.reserve(4 * (glyphCount + 1));
+
+    for (unsigned int glyph = 0; glyph < glyphCount; ++glyph)
+    {
+        appendUInt32(newLoca, quint32(newGlyf.size()));
+
+        if (isGlyphUsed[glyph])
+        {
+            newGlyf.append(getGlyph(glyf, loca, isLongLocaFormat, glyph));
+
+            while (newGlyf.size() % 4 != 0)
+            {
+                newGlyf.append('\0');
+            }
+        }
+    }
+    appendUInt32(newLoca, quint32(newGlyf.size()));
+
+    // Set long loca format and clear checksum adjustment (it is computed at the end)
+    qToBigEndian<quint16>(1, head.data() + 50);
+    qToBigEndian<quint32>(0, head.data() + 8);
+
+    std::vector<std::pair<quint32, QByteArray>> newTables;
+    for (const Table& table : m_tables)
+    {
+        if (std::find(std::cbegin(KEPT_TABLES), std::cend(KEPT_TABLES), table.tag) == std::cend(KEPT_TABLES))
+        {
+            continue;
+        }
+
+        switch (table.tag)
+        {
+            case TAG_HEAD:
+                newTables.emplace_back(table.tag, head);
+                break;
+
+            case TAG_LOCA:
+                newTables.emplace_back(table.tag, newLoca);
+                break;
+
+            case TAG_GLYF:
+                newTables.emplace_back(table.tag, newGlyf);
+                break;
+
+            default:
+                newTables.emplace_back(table.tag, getTableData(table.tag));
+                break;
+        }
+    }
+    std::sort(newTables.begin(), newTables.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+
+    // Write the font
+    const quint16 newTableCount = quint16(newTables.size());
+    quint16 entrySelector = 0;
+    while ((2u << entrySelector) <= newTableCount)
+    {
+        ++entrySelector;
+    }
+    const quint16 searchRange = quint16(16u << entrySelector);
+
+    QByteArray font;
+    appendUInt32(font, 0x00010000);
+    appendUInt16(font, newTableCount);
+    appendUInt16(font, searchRange);
+    appendUInt16(font, entrySelector);
+    appendUInt16(font, quint16(newTableCount * 16 - searchRange));
+
+    quint32 offset = 12 + 16 * quint32(newTableCount);
+    qsizetype headOffset = -1;
+    for (const auto& table : newTables)
+    {
+        appendUInt32(font, table.first);
+        appendUInt32(font, getChecksum(table.second));
+        appendUInt32(font, offset);
+        appendUInt32(font, quint32(table.second.size()));
+
+        if (table.first == TAG_HEAD)
+        {
+            headOffset = offset;
+        }
+
+        offset += (quint32(table.second.size()) + 3) & ~quint32(3);
+    }
+
+    for (const auto& table : newTables)
+    {
+        font.append(table.second);
+
+        while (font.size() % 4 != 0)
+        {
+            font.append('\0');
+        }
+    }
+
+    if (headOffset != -1)
+    {
+        qToBigEndian<quint32>(0xB1B0AFBA - getChecksum(font), font.data() + headOffset + 8);
+    }
+
+    return font;
+}
+
+const PDFTrueTypeFontSubsetter::Table* PDFTrueTypeFontSubsetter::findTable(quint32 tag) const
+{
+    auto it = std::find_if(m_tables.cbegin(), m_tables.cend(), [tag](const Table& table) { return table.tag == tag; });
+    return it != m_tables.cend() ? &*it : nullptr;
+}
+
+QByteArray PDFTrueTypeFontSubsetter::getTableData(quint32 tag) const
+{
+    if (const Table* table = findTable(tag))
+    {
+        return m_fontData.mid(table->offset, table->length);
+    }
+
+    return QByteArray();
+}
+
+QByteArray PDFTrueTypeFontSubsetter::getGlyph(const QByteArray& glyf, const QByteArray& loca, bool isLongLocaFormat, unsigned int glyph) const
+{
+    quint32 begin = 0;
+    quint32 end = 0;
+
+    if (isLongLocaFormat)
+    {
+        begin = readUInt32(loca, 4 * qsizetype(glyph));
+        end = readUInt32(loca, 4 * qsizetype(glyph) + 4);
+    }
+    else
+    {
+        begin = 2 * quint32(readUInt16(loca, 2 * qsizetype(glyph)));
+        end = 2 * quint32(readUInt16(loca, 2 * qsizetype(glyph) + 2));
+    }
+
+    if (begin > end || qsizetype(end) > glyf.size())
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid TrueType font data."));
+    }
+
+    return glyf.mid(begin, end - begin);
+}
+
+void PDFTrueTypeFontSubsetter::addComponents(const QByteArray& glyphData, std::vector<unsigned int>& glyphs)
+{
+    if (glyphData.isEmpty() || qint16(readUInt16(glyphData, 0)) >= 0)
+    {
+        // Empty glyph, or simple glyph
+        return;
+    }
+
+    constexpr quint16 ARG_1_AND_2_ARE_WORDS = 0x0001;
+    constexpr quint16 WE_HAVE_A_SCALE = 0x0008;
+    constexpr quint16 MORE_COMPONENTS = 0x0020;
+    constexpr quint16 WE_HAVE_AN_X_AND_Y_SCALE = 0x0040;
+    constexpr quint16 WE_HAVE_A_TWO_BY_TWO = 0x0080;
+
+    // Skip the glyph header (number of contours and bounding box)
+    qsizetype offset = 10;
+    quint16 flags = MORE_COMPONENTS;
+    while (flags & MORE_COMPONENTS)
+    {
+        flags = readUInt16(glyphData, offset);
+        glyphs.push_back(readUInt16(glyphData, offset + 2));
+        offset += 4;
+
+        offset += (flags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2;
+
+        if (flags & WE_HAVE_A_SCALE)
+        {
+            offset += 2;
+        }
+        else if (flags & WE_HAVE_AN_X_AND_Y_SCALE)
+        {
+            offset += 4;
+        }
+        else if (flags & WE_HAVE_A_TWO_BY_TWO)
+        {
+            offset += 8;
+        }
+    }
+}
+
+quint32 PDFTrueTypeFontSubsetter::getChecksum(const QByteArray& data)
+{
+    quint32 checksum = 0;
+
+    qsizetype i = 0;
+    for (; i + 4 <= data.size(); i += 4)
+    {
+        checksum += qFromBigEndian<quint32>(data.constData() + i);
+    }
+
+    // Last incomplete word is padded with zeroes
+    quint32 lastWord = 0;
+    for (qsizetype shift = 24; i < data.size(); ++i, shift -= 8)
+    {
+        lastWord |= quint32(quint8(data[i])) << shift;
+    }
+
+    return checksum + lastWord;
+}
+
+}   // namespace pdf
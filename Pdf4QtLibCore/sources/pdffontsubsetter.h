@@ -0,0 +1,75 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFFONTSUBSETTER_H
+#define PDFFONTSUBSETTER_H
+
+#include "pdfglobal.h"
+
+#include <QByteArray>
+
+#include <set>
+#include <vector>
+
+namespace pdf
+{
+
+/// Creates subsets of TrueType font programs. Glyph identifiers are preserved,
+/// glyphs, which are not used, are replaced by empty glyphs, so font can be
+/// used with the same CID to GID mapping as the original font. Tables, which
+/// are not used for rendering of the glyphs (such as layout tables), are removed.
+class PDF4QTLIBCORESHARED_EXPORT PDFTrueTypeFontSubsetter
+{
+public:
+    /// Creates subsetter for the font. If font is not a TrueType
+    /// font, or it can't be parsed, then exception is thrown.
+    /// \param fontData Font program
+    explicit PDFTrueTypeFontSubsetter(QByteArray fontData);
+
+    /// Creates subset of the font containing given glyphs. Components
+    /// of composite glyphs and glyph 0 (.notdef) are always kept.
+    /// If font data are invalid, then exception is thrown.
+    /// \param glyphs Glyph identifiers of used glyphs
+    QByteArray subset(const std::set<unsigned int>& glyphs) const;
+
+private:
+    struct Table
+    {
+        quint32 tag = 0;
+        quint32 offset = 0;
+        quint32 length = 0;
+    };
+
+    const Table* findTable(quint32 tag) const;
+    QByteArray getTableData(quint32 tag) const;
+
+    /// Returns glyph data from the glyf table
+    QByteArray getGlyph(const QByteArray& glyf, const QByteArray& loca, bool isLongLocaFormat, unsigned int glyph) const;
+
+    /// Appends components of composite glyph to the list
+    static void addComponents(const QByteArray& glyphData, std::vector<unsigned int>& glyphs);
+
+    static quint32 getChecksum(const QByteArray& data);
+
+    QByteArray m_fontData;
+    std::vector<Table> m_tables;
+};
+
+}   // namespace pdf
+
+#endif // PDFFONTSUBSETTER_H
@@ -19,11 +19,233 @@
 #include "pdfdocument.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfpainterutils.h"
+
+#include <QMutex>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
 {
 
+/// Loader of the form fields. Form fields are parsed on demand - subtree of the root
+/// field (from the 'Fields' entry of the form) is parsed, when form field of some
+/// of its widgets is requested, all fields are parsed, when list of all form fields
+/// is requested. Loader is shared by copies of the form, loading is protected by mutex,
+/// because form fields of widgets can be requested from the rendering threads.
+class PDFFormFieldLoader
+{
+public:
+    explicit PDFFormFieldLoader(const PDFDocument* document, std::vector<PDFObjectReference> fieldRoots) :
+        m_document(document),
+        m_fieldRoots(qMove(fieldRoots)),
+        m_fieldRootSet(m_fieldRoots.cbegin(), m_fieldRoots.cend())
+    {
+
+    }
+
+    /// Parses all form fields (if not already parsed) and returns them
+    const PDFFormFields& getFormFields();
+
+    /// Returns form field for widget, parses its field tree, if it is not already parsed
+    /// \param widget Widget annotation
+    PDFFormField* getFormFieldForWidget(PDFObjectReference widget);
+
+    void setDocument(const PDFDocument* document);
+    void reloadValues(const PDFObjectStorage* storage);
+
+private:
+    /// Returns already parsed field, or parses it as root field
+    /// \param reference Field reference
+    PDFFormFieldPointer loadField(PDFObjectReference reference);
+
+    /// Returns root of the field tree by following 'Parent' entries
+    /// \param reference Field or widget reference
+    PDFObjectReference getRootField(PDFObjectReference reference) const;
+
+    /// Returns true, if annotation is 'rogue' form field, i.e. widget,
+    /// which is incorrectly not in the 'Fields' entry of the form.
+    /// \param annotation Annotation reference
+    bool isRogueField(PDFObjectReference annotation) const;
+
+    const PDFDocument* m_document;
+    QMutex m_mutex;
+    std::vector<PDFObjectReference> m_fieldRoots;
+    std::set<PDFObjectReference> m_fieldRootSet;
+
+    /// Parsed root fields (nullptr, if field is incorrectly defined)
+    std::map<PDFObjectReference, PDFFormFieldPointer> m_parsedFields;
+    PDFWidgetToFormFieldMapping m_widgetToFormField;
+    PDFFormFields m_formFields;
+    bool m_isFullyLoaded = false;
+};
+
+const PDFFormFields& PDFFormFieldLoader::getFormFields()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (m_isFullyLoaded || !m_document)
+    {
+        return m_formFields;
+    }
+
+    PDFFormFields formFields;
+    PDFWidgetToFormFieldMapping widgetToFormField;
+    formFields.reserve(m_fieldRoots.size());
+
+    for (const PDFObjectReference& fieldRootReference : m_fieldRoots)
+    {
+        // Form fields, which are nullptr (are incorrectly defined), are skipped
+        if (PDFFormFieldPointer formField = loadField(fieldRootReference))
+        {
+            formFields.push_back(formField);
+            formField->fillWidgetToFormFieldMapping(widgetToFormField);
+        }
+    }
+
+    // We must also look for 'rogue' form fields, which are incorrectly not
+    // in the 'Fields' entry of this form. We do this by iterating all pages,
+    // and their annotations and try to find these 'rogue' fields.
+    const PDFCatalog* catalog = m_document->getCatalog();
+    const size_t pageCount = catalog->getPageCount();
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        const PDFPage* page = catalog->getPage(i);
+        for (PDFObjectReference annotationReference : page->getAnnotations())
+        {
+            if (widgetToFormField.count(annotationReference))
+            {
+                // This widget/form field is already present
+                continue;
+            }
+
+            if (isRogueField(annotationReference))
+            {
+                if (PDFFormFieldPointer formField = loadField(annotationReference))
+                {
+                    formFields.push_back(formField);
+                    formField->fillWidgetToFormFieldMapping(widgetToFormField);
+                }
+            }
+        }
+    }
+
+    m_formFields = qMove(formFields);
+    m_widgetToFormField = qMove(widgetToFormField);
+    m_isFullyLoaded = true;
+    return m_formFields;
+}
+
+PDFFormField* PDFFormFieldLoader::getFormFieldForWidget(PDFObjectReference widget)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_widgetToFormField.find(widget);
+    if (it != m_widgetToFormField.cend())
+    {
+        return it->second;
+    }
+
+    if (m_isFullyLoaded || !m_document)
+    {
+        return nullptr;
+    }
+
+    // Parse field tree containing the widget. If the widget is not in any field
+    // tree of the form, then it can be a 'rogue' form field.
+    const PDFObjectReference rootField = getRootField(widget);
+    if (m_fieldRootSet.count(rootField))
+    {
+        loadField(rootField);
+    }
+
+    if (!m_widgetToFormField.count(widget) && isRogueField(widget))
+    {
+        loadField(widget);
+    }
+
+    it = m_widgetToFormField.find(widget);
+    if (it != m_widgetToFormField.cend())
+    {
+        return it->second;
+    }
+
+    return nullptr;
+}
+
+void PDFFormFieldLoader::setDocument(const PDFDocument* document)
+{
+    QMutexLocker lock(&m_mutex);
+    m_document = document;
+}
+
+void PDFFormFieldLoader::reloadValues(const PDFObjectStorage* storage)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (const auto& parsedField : m_parsedFields)
+    {
+        if (parsedField.second)
+        {
+            parsedField.second->reloadValue(storage, PDFObject());
+        }
+    }
+}
+
+PDFFormFieldPointer PDFFormFieldLoader::loadField(PDFObjectReference reference)
+{
+    auto it = m_parsedFields.find(reference);
+    if (it != m_parsedFields.cend())
+    {
+        return it->second;
+    }
+
+    PDFFormFieldPointer formField = PDFFormField::parse(&m_document->getStorage(), reference, nullptr);
+    m_parsedFields[reference] = formField;
+
+    if (formField)
+    {
+        formField->fillWidgetToFormFieldMapping(m_widgetToFormField);
+    }
+
+    return formField;
+}
+
+PDFObjectReference PDFFormFieldLoader::getRootField(PDFObjectReference reference) const
+{
+    const PDFObjectStorage& storage = m_document->getStorage();
+    std::set<PDFObjectReference> visitedFields;
+
+    // Cyclic dependence is detected by already visited fields
+    while (visitedFields.insert(reference).second)
+    {
+        const PDFDictionary* dictionary = storage.getDictionaryFromObject(storage.getObjectByReference(reference));
+        if (!dictionary)
+        {
+            break;
+        }
+
+        const PDFObject& parent = dictionary->get("Parent");
+        if (!parent.isReference())
+        {
+            break;
+        }
+
+        reference = parent.getReference();
+    }
+
+    return reference;
+}
+
+bool PDFFormFieldLoader::isRogueField(PDFObjectReference annotation) const
+{
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* annotationDictionary = m_document->getDictionaryFromObject(m_document->getObjectByReference(annotation));
+
+    return annotationDictionary &&
+           loader.readNameFromDictionary(annotationDictionary, "Subtype") == "Widget" &&
+           !annotationDictionary->hasKey("Kids");
+}
+
 PDFForm PDFForm::parse(const PDFDocument* document, PDFObject object)
 {
     PDFForm form;
@@ -32,12 +254,9 @@ PDFForm PDFForm::parse(const PDFDocument* document, PDFObject object)
     {
         PDFDocumentDataLoaderDecorator loader(document);
 
+        // Form fields are parsed on demand
         std::vector<PDFObjectReference> fieldRoots = loader.readReferenceArrayFromDictionary(formDictionary, "Fields");
-        form.m_formFields.reserve(fieldRoots.size());
-        for (const PDFObjectReference& fieldRootReference : fieldRoots)
-        {
-            form.m_formFields.emplace_back(PDFFormField::parse(&document->getStorage(), fieldRootReference, nullptr));
-        }
+        form.m_fieldLoader = std::make_shared<PDFFormFieldLoader>(document, qMove(fieldRoots));
 
         form.m_formType = FormType::AcroForm;
         form.m_needAppearances = loader.readBooleanFromDictionary(formDictionary, "NeedAppearances", false);
@@ -53,60 +272,30 @@ PDFForm PDFForm::parse(const PDFDocument* document, PDFObject object)
             // Jakub Melka: handle XFA form
             form.m_formType = FormType::XFAForm;
         }
-
-        // As post-processing, delete all form fields, which are nullptr (are incorrectly defined)
-        form.m_formFields.erase(std::remove_if(form.m_formFields.begin(), form.m_formFields.end(), [](const auto& field){ return !field; }), form.m_formFields.end());
-        form.updateWidgetToFormFieldMapping();
-
-        // If we have form, then we must also look for 'rogue' form fields, which are
-        // incorrectly not in the 'Fields' entry of this form. We do this by iterating
-        // all pages, and their annotations and try to find these 'rogue' fields.
-        bool rogueFieldFound = false;
-        const size_t pageCount = document->getCatalog()->getPageCount();
-        for (size_t i = 0; i < pageCount; ++i)
-        {
-            const PDFPage* page = document->getCatalog()->getPage(i);
-            for (PDFObjectReference annotationReference : page->getAnnotations())
-            {
-                const PDFDictionary* annotationDictionary = document->getDictionaryFromObject(document->getObjectByReference(annotationReference));
-
-                if (form.m_widgetToFormField.count(annotationReference))
-                {
-                    // This widget/form field is already present
-                    continue;
-                }
-
-                if (loader.readNameFromDictionary(annotationDictionary, "Subtype") == "Widget" &&
-                    !annotationDictionary->hasKey("Kids"))
-                {
-                    rogueFieldFound = true;
-                    form.m_formFields.emplace_back(PDFFormField::parse(&document->getStorage(), annotationReference, nullptr));
-                }
-            }
-        }
-
-        // As post-processing, delete all form fields, which are nullptr (are incorrectly defined)
-        form.m_formFields.erase(std::remove_if(form.m_formFields.begin(), form.m_formFields.end(), [](const auto& field){ return !field; }), form.m_formFields.end());
-
-        if (rogueFieldFound)
-        {
-            form.updateWidgetToFormFieldMapping();
-        }
     }
 
     return form;
 }
 
-void PDFForm::updateWidgetToFormFieldMapping()
+const PDFFormFields& PDFForm::getFormFields() const
 {
-    m_widgetToFormField.clear();
+    static const PDFFormFields dummy;
+    return m_fieldLoader ? m_fieldLoader->getFormFields() : dummy;
+}
 
-    if (isAcroForm() || isXFAForm())
+void PDFForm::setDocument(const PDFDocument* document)
+{
+    if (m_fieldLoader)
     {
-        for (const PDFFormFieldPointer& formFieldPtr : getFormFields())
-        {
-            formFieldPtr->fillWidgetToFormFieldMapping(m_widgetToFormField);
-        }
+        m_fieldLoader->setDocument(document);
+    }
+}
+
+void PDFForm::reloadValues(const PDFObjectStorage* storage)
+{
+    if (m_fieldLoader)
+    {
+        m_fieldLoader->reloadValues(storage);
     }
 }
 
@@ -135,10 +324,9 @@ Qt::Alignment PDFForm::getDefaultAlignment() const
 
 const PDFFormField* PDFForm::getFormFieldForWidget(PDFObjectReference widget) const
 {
-    auto it = m_widgetToFormField.find(widget);
-    if (it != m_widgetToFormField.cend())
+    if (isAcroForm() || isXFAForm())
     {
-        return it->second;
+        return m_fieldLoader->getFormFieldForWidget(widget);
     }
 
     return nullptr;
@@ -146,10 +334,9 @@ const PDFFormField* PDFForm::getFormFieldForWidget(PDFObjectReference widget) co
 
 PDFFormField* PDFForm::getFormFieldForWidget(PDFObjectReference widget)
 {
-    auto it = m_widgetToFormField.find(widget);
-    if (it != m_widgetToFormField.cend())
+    if (isAcroForm() || isXFAForm())
     {
-        return it->second;
+        return m_fieldLoader->getFormFieldForWidget(widget);
     }
 
     return nullptr;
@@ -661,10 +848,16 @@ void PDFFormManager::setDocument(const PDFModifiedDocument& document)
 
             onDocumentReset();
         }
-        else if (document.hasFlag(PDFModifiedDocument::FormField))
+        else
         {
-            // Just update field values
-            updateFieldValues();
+            // Form fields are parsed on demand, so they must be parsed from the new document
+            m_form.setDocument(m_document);
+
+            if (document.hasFlag(PDFModifiedDocument::FormField))
+            {
+                // Just update field values
+                updateFieldValues();
+            }
         }
 
         m_xfaEngine.setDocument(document, &m_form);
@@ -749,6 +942,56 @@ const PDFAction* PDFFormManager::getAction(PDFAnnotationAdditionalActions::Actio
     return nullptr;
 }
 
+void PDFFormManager::beginBatchUpdate()
+{
+    ++m_batchUpdateCounter;
+
+    if (!m_batchModifier && m_document)
+    {
+        m_batchModifier = std::make_unique<PDFDocumentModifier>(m_document);
+        m_batchModifier->getBuilder()->setFormManager(this);
+    }
+}
+
+void PDFFormManager::endBatchUpdate()
+{
+    Q_ASSERT(m_batchUpdateCounter > 0);
+
+    if (--m_batchUpdateCounter == 0 && m_batchModifier)
+    {
+        std::unique_ptr<PDFDocumentModifier> modifier = std::move(m_batchModifier);
+        std::set<PDFObjectReference> dirtyWidgets = std::move(m_batchDirtyWidgets);
+        m_batchDirtyWidgets.clear();
+
+        // Appearance streams are updated only once, using final values of the form fields
+        for (const PDFObjectReference& widget : dirtyWidgets)
+        {
+            modifier->getBuilder()->updateAnnotationAppearanceStreams(widget);
+        }
+
+        if (modifier->finalize())
+        {
+            Q_EMIT documentModified(PDFModifiedDocument(modifier->getDocument(), nullptr, modifier->getFlags()));
+        }
+    }
+}
+
+void PDFFormManager::updateWidgetAppearance(PDFDocumentModifier* modifier, PDFObjectReference widget)
+{
+    Q_ASSERT(modifier);
+
+    if (m_batchModifier && modifier == m_batchModifier.get())
+    {
+        m_batchDirtyWidgets.insert(widget);
+    }
+    else
+    {
+        modifier->getBuilder()->updateAnnotationAppearanceStreams(widget);
+    }
+
+    modifier->markAnnotationsChanged();
+}
+
 void PDFFormManager::setFormFieldValue(PDFFormField::SetValueParameters parameters)
 {
     if (!m_document)
@@ -763,8 +1006,8 @@ void PDFFormManager::setFormFieldValue(PDFFormField::SetValueParameters paramete
     parameters.formManager = this;
     parameters.scope = PDFFormField::SetValueParameters::Scope::User;
 
-    PDFDocumentModifier modifier(m_document);
-    modifier.getBuilder()->setFormManager(this);
+    PDFFormBatchUpdateGuard batchUpdateGuard(this);
+    PDFDocumentModifier& modifier = *m_batchModifier;
     parameters.modifier = &modifier;
 
     if (parameters.invokingFormField->setValue(parameters))
@@ -789,11 +1032,6 @@ void PDFFormManager::setFormFieldValue(PDFFormField::SetValueParameters paramete
             };
             modify(updateDependentField);
         }
-
-        if (modifier.finalize())
-        {
-            Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
-        }
     }
 }
 
@@ -917,10 +1155,8 @@ void PDFFormManager::updateFieldValues()
 {
     if (m_document)
     {
-        for (const PDFFormFieldPointer& childField : m_form.getFormFields())
-        {
-            childField->reloadValue(&m_document->getStorage(), PDFObject());
-        }
+        // Form fields, which are not parsed yet, will be parsed with current values
+        m_form.reloadValues(&m_document->getStorage());
     }
 }
 
@@ -929,8 +1165,8 @@ void PDFFormManager::performResetAction(const PDFActionResetForm* action)
     Q_ASSERT(action);
     Q_ASSERT(m_document);
 
-    PDFDocumentModifier modifier(m_document);
-    modifier.getBuilder()->setFormManager(this);
+    PDFFormBatchUpdateGuard batchUpdateGuard(this);
+    PDFDocumentModifier& modifier = *m_batchModifier;
 
     auto resetFieldValue = [this, action, &modifier](PDFFormField* formField)
     {
@@ -968,11 +1204,6 @@ void PDFFormManager::performResetAction(const PDFActionResetForm* action)
         }
     };
     modify(resetFieldValue);
-
-    if (modifier.finalize())
-    {
-        Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
-    }
 }
 
 bool PDFFormFieldText::setValue(const SetValueParameters& parameters)
@@ -995,8 +1226,7 @@ bool PDFFormFieldText::setValue(const SetValueParameters& parameters)
     // Change widget appearance states
     for (const PDFFormWidget& formWidget : getWidgets())
     {
-        builder->updateAnnotationAppearanceStreams(formWidget.getWidget());
-        parameters.modifier->markAnnotationsChanged();
+        parameters.formManager->updateWidgetAppearance(parameters.modifier, formWidget.getWidget());
     }
 
     return true;
@@ -1016,8 +1246,7 @@ void PDFFormFieldText::resetValue(const ResetValueParameters& parameters)
     // Change widget appearance states
     for (const PDFFormWidget& formWidget : getWidgets())
     {
-        builder->updateAnnotationAppearanceStreams(formWidget.getWidget());
-        parameters.modifier->markAnnotationsChanged();
+        parameters.formManager->updateWidgetAppearance(parameters.modifier, formWidget.getWidget());
     }
 }
 
@@ -1054,8 +1283,7 @@ bool PDFFormFieldChoice::setValue(const SetValueParameters& parameters)
     // Change widget appearance states
     for (const PDFFormWidget& formWidget : getWidgets())
     {
-        builder->updateAnnotationAppearanceStreams(formWidget.getWidget());
-        parameters.modifier->markAnnotationsChanged();
+        parameters.formManager->updateWidgetAppearance(parameters.modifier, formWidget.getWidget());
     }
 
     return true;
@@ -1083,8 +1311,7 @@ void PDFFormFieldChoice::resetValue(const PDFFormField::ResetValueParameters& pa
     // Change widget appearance states
     for (const PDFFormWidget& formWidget : getWidgets())
     {
-        builder->updateAnnotationAppearanceStreams(formWidget.getWidget());
-        parameters.modifier->markAnnotationsChanged();
+        parameters.formManager->updateWidgetAppearance(parameters.modifier, formWidget.getWidget());
     }
 }
 
@@ -26,12 +26,15 @@
 
 #include <QTextLayout>
 
+#include <set>
+#include <memory>
 #include <optional>
 
 namespace pdf
 {
 class PDFFormField;
 class PDFFormManager;
+class PDFFormFieldLoader;
 class PDFObjectStorage;
 class PDFModifiedDocument;
 class PDFDocumentModifier;
@@ -412,6 +415,9 @@ private:
 /// Fields forms tree-like structure, where leafs are usually widgets. Fields include
 /// ordinary widgets, such as buttons, check boxes, combo boxes and text fields, and one
 /// special - signature field, which represents digital signature.
+/// Form fields are parsed on demand. Subtree of the root field is parsed, when form
+/// field of some of its widgets is requested, all form fields are parsed, when
+/// list of the form fields is requested (or all fields are enumerated).
 class PDF4QTLIBCORESHARED_EXPORT PDFForm
 {
 public:
@@ -433,7 +439,7 @@ public:
     Q_DECLARE_FLAGS(SignatureFlags, SignatureFlag)
 
     FormType getFormType() const { return m_formType; }
-    const PDFFormFields& getFormFields() const { return m_formFields; }
+    const PDFFormFields& getFormFields() const;
     bool isAppearanceUpdateNeeded() const { return m_needAppearances; }
     SignatureFlags getSignatureFlags() const { return m_signatureFlags; }
     const std::vector<PDFObjectReference>& getCalculationOrder() const { return m_calculationOrder; }
@@ -463,17 +469,26 @@ public:
     /// \param functor Functor to apply
     void apply(const std::function<void(const PDFFormField*)>& functor) const;
 
+    /// Sets document, from which form fields, which were not parsed yet,
+    /// are parsed. It must be called, when document is replaced by its
+    /// modified version, because form fields are parsed on demand.
+    /// \param document Document
+    void setDocument(const PDFDocument* document);
+
+    /// Reloads values of the form fields, which were already parsed
+    /// \param storage Storage
+    void reloadValues(const PDFObjectStorage* storage);
+
     /// Parses form from the object. If some error occurs
     /// then empty form is returned, no exception is thrown.
+    /// Document must exist, until the form is destroyed,
+    /// or it is replaced by \p setDocument.
     /// \param document Document
     /// \param reference Field reference
     static PDFForm parse(const PDFDocument* document, PDFObject object);
 
 private:
-    void updateWidgetToFormFieldMapping();
-
     FormType m_formType = FormType::None;
-    PDFFormFields m_formFields;
     bool m_needAppearances = false;
     SignatureFlags m_signatureFlags = None;
     std::vector<PDFObjectReference> m_calculationOrder;
@@ -481,7 +496,9 @@ private:
     std::optional<QByteArray> m_defaultAppearance;
     std::optional<PDFInteger> m_quadding;
     PDFObject m_xfa;
-    PDFWidgetToFormFieldMapping m_widgetToFormField;
+
+    /// Loader of the form fields (nullptr, if form is empty)
+    std::shared_ptr<PDFFormFieldLoader> m_fieldLoader;
 };
 
 /// Form manager. Manages all form widgets functionality - triggers actions,
@@ -558,9 +575,32 @@ public:
     /// Returns default form apperance flags
     static constexpr FormAppearanceFlags getDefaultApperanceFlags() { return FormAppearanceFlags(HighlightFields | HighlightRequiredFields); }
 
-    /// Tries to set value to the form field
+    /// Tries to set value to the form field. If batch update is active,
+    /// then change is accumulated in the batch and document is modified
+    /// when batch update ends.
     void setFormFieldValue(PDFFormField::SetValueParameters parameters);
 
+    /// Starts batch update of form fields. All field changes made until
+    /// the matching call of \p endBatchUpdate are accumulated in single
+    /// document modifier, appearance streams of changed widgets are
+    /// regenerated only once, and single \p documentModified signal
+    /// is emitted. Batch updates can be nested.
+    void beginBatchUpdate();
+
+    /// Ends batch update. If it is outermost batch update, then dirty
+    /// widget appearances are regenerated and document is modified.
+    void endBatchUpdate();
+
+    /// Returns true, if batch update is active
+    bool isBatchUpdateActive() const { return m_batchUpdateCounter > 0; }
+
+    /// Updates appearance stream of the widget annotation. If modifier
+    /// is the batch update modifier, then widget is only marked as dirty
+    /// and its appearance is regenerated when batch update ends.
+    /// \param modifier Document modifier
+    /// \param widget Widget annotation
+    void updateWidgetAppearance(PDFDocumentModifier* modifier, PDFObjectReference widget);
+
     /// Get widget rectangle (from annotation)
     QRectF getWidgetRectangle(const PDFFormWidget& widget) const;
 
@@ -618,6 +658,33 @@ private:
     bool m_isCommitDisabled;
 
     PDFXFAEngine m_xfaEngine;
+
+    int m_batchUpdateCounter = 0;
+    std::unique_ptr<PDFDocumentModifier> m_batchModifier;
+    std::set<PDFObjectReference> m_batchDirtyWidgets;
+};
+
+/// Guard, which performs batch update of form fields
+/// in the scope of its lifetime.
+class PDFFormBatchUpdateGuard
+{
+public:
+    explicit inline PDFFormBatchUpdateGuard(PDFFormManager* formManager) :
+        m_formManager(formManager)
+    {
+        m_formManager->beginBatchUpdate();
+    }
+
+    inline ~PDFFormBatchUpdateGuard()
+    {
+        m_formManager->endBatchUpdate();
+    }
+
+    PDFFormBatchUpdateGuard(const PDFFormBatchUpdateGuard&) = delete;
+    PDFFormBatchUpdateGuard& operator=(const PDFFormBatchUpdateGuard&) = delete;
+
+private:
+    PDFFormManager* m_formManager;
 };
 
 }   // namespace pdf
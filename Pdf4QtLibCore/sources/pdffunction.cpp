@@ -27,13 +27,25 @@
 
 #include "pdfdbgheap.h"
 
+#include <array>
 #include <stack>
 #include <iterator>
+#include <algorithm>
 #include <type_traits>
 
 namespace pdf
 {
 
+/// Number of samples of baked function of one input variable
+static constexpr const uint32_t BAKED_FUNCTION_1D_SAMPLE_COUNT = 1024;
+
+/// Number of samples (for each input variable) of baked function of two input variables
+static constexpr const uint32_t BAKED_FUNCTION_2D_SAMPLE_COUNT = 64;
+
+/// Function is baked only, if it is evaluated at least this
+/// times more than number of samples of the baked function.
+static constexpr const size_t BAKED_FUNCTION_EVALUATION_RATIO = 2;
+
 PDFFunction::PDFFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain, std::vector<PDFReal>&& range) :
     m_m(m),
     m_n(n),
@@ -43,12 +55,89 @@ PDFFunction::PDFFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain,
 
 }
 
+PDFFunction::FunctionResult PDFFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    FunctionResult result(true);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const_iterator x_1 = x + i * m_m;
+        iterator y_1 = y + i * m_n;
+
+        FunctionResult itemResult = apply(x_1, x_1 + m_m, y_1, y_1 + m_n);
+        if (!itemResult)
+        {
+            result = std::move(itemResult);
+        }
+    }
+
+    return result;
+}
+
 PDFFunctionPtr PDFFunction::createFunction(const PDFDocument* document, const PDFObject& object)
 {
     PDFParsingContext context(nullptr);
     return createFunctionImpl(document, object, &context);
 }
 
+bool PDFFunction::isBakingWorthIt(const PDFFunction* function, size_t evaluationCount)
+{
+    if (!function || !function->isLinear())
+    {
+        // Only linear functions can be baked without loss of precision
+        return false;
+    }
+
+    const uint32_t m = function->getInputVariableCount();
+    const uint32_t n = function->getOutputVariableCount();
+
+    if (m == 0 || m > PDFLookupTableFunction::MAXIMAL_INPUT_VARIABLE_COUNT || n == 0 || function->m_domain.size() != 2 * m)
+    {
+        return false;
+    }
+
+    const size_t sampleCount = (m == 1) ? BAKED_FUNCTION_1D_SAMPLE_COUNT : BAKED_FUNCTION_2D_SAMPLE_COUNT * BAKED_FUNCTION_2D_SAMPLE_COUNT;
+    return evaluationCount >= sampleCount * BAKED_FUNCTION_EVALUATION_RATIO;
+}
+
+PDFFunctionPtr PDFFunction::createBakedFunction(const PDFFunctionPtr& function, size_t evaluationCount)
+{
+    if (!isBakingWorthIt(function.get(), evaluationCount))
+    {
+        return function;
+    }
+
+    const uint32_t m = function->getInputVariableCount();
+    const uint32_t n = function->getOutputVariableCount();
+
+    const uint32_t samplesPerVariable = (m == 1) ? BAKED_FUNCTION_1D_SAMPLE_COUNT : BAKED_FUNCTION_2D_SAMPLE_COUNT;
+    const size_t sampleCount = (m == 1) ? samplesPerVariable : samplesPerVariable * samplesPerVariable;
+
+    // Prepare input values in regular grid, first variable varies fastest
+    std::vector<PDFReal> inputs(sampleCount * m, 0.0);
+    for (size_t i = 0; i < sampleCount; ++i)
+    {
+        size_t index = i;
+        for (uint32_t j = 0; j < m; ++j)
+        {
+            const PDFReal t = PDFReal(index % samplesPerVariable) / PDFReal(samplesPerVariable - 1);
+            inputs[i * m + j] = mix(t, function->m_domain[2 * j], function->m_domain[2 * j + 1]);
+            index /= samplesPerVariable;
+        }
+    }
+
+    std::vector<PDFReal> samples(sampleCount * n, 0.0);
+    if (!function->applyBatch(inputs.data(), samples.data(), sampleCount))
+    {
+        // Function can't be evaluated somewhere, we must use original function
+        return function;
+    }
+
+    std::vector<PDFReal> domain = function->m_domain;
+    std::vector<uint32_t> size(m, samplesPerVariable);
+    return std::make_shared<PDFLookupTableFunction>(m, n, std::move(domain), std::move(size), std::move(samples));
+}
+
 PDFFunctionPtr PDFFunction::createFunctionImpl(const PDFDocument* document, const PDFObject& object, PDFParsingContext* context)
 {
     PDFParsingContext::PDFParsingContextObjectGuard guard(context, &object);
@@ -649,6 +738,102 @@ PDFFunction::FunctionResult PDFIdentityFunction::apply(const_iterator x_1,
     return true;
 }
 
+PDFLookupTableFunction::PDFLookupTableFunction(uint32_t m,
+                                               uint32_t n,
+                                               std::vector<PDFReal>&& domain,
+                                               std::vector<uint32_t>&& size,
+                                               std::vector<PDFReal>&& samples) :
+    PDFFunction(m, n, std::move(domain), std::vector<PDFReal>()),
+    m_size(std::move(size)),
+    m_samples(std::move(samples))
+{
+    Q_ASSERT(m > 0 && m <= MAXIMAL_INPUT_VARIABLE_COUNT);
+    Q_ASSERT(n > 0);
+    Q_ASSERT(m_size.size() == m);
+    Q_ASSERT(m_domain.size() == 2 * m);
+    Q_ASSERT(std::all_of(m_size.cbegin(), m_size.cend(), [](uint32_t size) { return size >= 2; }));
+    Q_ASSERT(m_samples.size() == std::accumulate(m_size.cbegin(), m_size.cend(), size_t(1), std::multiplies<size_t>()) * n);
+}
+
+PDFFunction::FunctionResult PDFLookupTableFunction::apply(const_iterator x_1,
+                                                          const_iterator x_m,
+                                                          iterator y_1,
+                                                          iterator y_n) const
+{
+    const size_t m = std::distance(x_1, x_m);
+    const size_t n = std::distance(y_1, y_n);
+
+    if (m != m_m)
+    {
+        return PDFTranslationContext::tr("Invalid number of operands for function. Expected %1, provided %2.").arg(m_m).arg(m);
+    }
+    if (n != m_n)
+    {
+        return PDFTranslationContext::tr("Invalid number of output variables for function. Expected %1, provided %2.").arg(m_n).arg(n);
+    }
+
+    evaluate(x_1, y_1);
+    return true;
+}
+
+PDFFunction::FunctionResult PDFLookupTableFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        evaluate(x + i * m_m, y + i * m_n);
+    }
+
+    return true;
+}
+
+void PDFLookupTableFunction::evaluate(const_iterator x, iterator y) const
+{
+    std::array<uint32_t, MAXIMAL_INPUT_VARIABLE_COUNT> indices = { };
+    std::array<PDFReal, MAXIMAL_INPUT_VARIABLE_COUNT> fractions = { };
+
+    for (uint32_t i = 0; i < m_m; ++i)
+    {
+        const PDFReal x0 = m_domain[2 * i];
+        const PDFReal x1 = m_domain[2 * i + 1];
+        const uint32_t intervalCount = m_size[i] - 1;
+
+        PDFReal t = (x1 > x0) ? (clampInput(i, x[i]) - x0) / (x1 - x0) * intervalCount : 0.0;
+        if (!(t > 0.0))
+        {
+            // Handle also NaN values
+            t = 0.0;
+        }
+
+        const uint32_t index = qMin(static_cast<uint32_t>(t), intervalCount - 1);
+        indices[i] = index;
+        fractions[i] = qMin(t - index, 1.0);
+    }
+
+    if (m_m == 1)
+    {
+        const PDFReal* s0 = m_samples.data() + indices[0] * m_n;
+        const PDFReal* s1 = s0 + m_n;
+
+        for (uint32_t j = 0; j < m_n; ++j)
+        {
+            y[j] = mix(fractions[0], s0[j], s1[j]);
+        }
+    }
+    else
+    {
+        const size_t rowSize = size_t(m_size[0]) * m_n;
+        const PDFReal* s00 = m_samples.data() + (size_t(indices[1]) * m_size[0] + indices[0]) * m_n;
+        const PDFReal* s10 = s00 + m_n;
+        const PDFReal* s01 = s00 + rowSize;
+        const PDFReal* s11 = s01 + m_n;
+
+        for (uint32_t j = 0; j < m_n; ++j)
+        {
+            y[j] = mix(fractions[1], mix(fractions[0], s00[j], s10[j]), mix(fractions[0], s01[j], s11[j]));
+        }
+    }
+}
+
 class PDFPostScriptFunctionStack
 {
 public:
@@ -721,6 +906,9 @@ public:
     /// Pushes the operand onto the stack
     void push(const OperandObject& operand) { m_stack.push_back(operand); checkOverflow(); }
 
+    /// Pops the operand from the stack (throw exception, if stack underflow occurs)
+    inline OperandObject popOperand() { checkUnderflow(); OperandObject operand = m_stack.back(); m_stack.pop_back(); return operand; }
+
     /// Returns true, if stack is empty
     bool empty() const { return m_stack.empty(); }
 
@@ -759,21 +947,28 @@ public:
     /// Executes the postscript program
     void execute();
 
+    /// Executes the operator, which doesn't affect control flow and which
+    /// is not a stack operator (arithmetic, relational, boolean and bitwise operators).
+    /// Operator pops operands from the stack and pushes the result onto the stack.
+    /// \param code Operator code
+    /// \param stack Stack
+    static void executeOperator(PDFPostScriptFunction::Code code, Stack& stack);
+
 private:
    template<template<typename> typename Comparator>
-    void executeRelationOperator()
+    static void executeRelationOperator(Stack& stack)
     {
-        if (m_stack.isBinaryOperationInteger())
+        if (stack.isBinaryOperationInteger())
         {
-            const PDFInteger b = m_stack.popInteger();
-            const PDFInteger a = m_stack.popInteger();
-            m_stack.pushBoolean(Comparator<PDFInteger>()(a, b));
+            const PDFInteger b = stack.popInteger();
+            const PDFInteger a = stack.popInteger();
+            stack.pushBoolean(Comparator<PDFInteger>()(a, b));
         }
         else
         {
-            const PDFReal b = m_stack.popNumber();
-            const PDFReal a = m_stack.popNumber();
-            m_stack.pushBoolean(Comparator<PDFReal>()(a, b));
+            const PDFReal b = stack.popNumber();
+            const PDFReal a = stack.popNumber();
+            stack.pushBoolean(Comparator<PDFReal>()(a, b));
         }
     }
 
@@ -798,786 +993,1218 @@ void PDFPostScriptFunctionExecutor::execute()
         const CodeObject& instruction = m_program[ip];
         switch (instruction.code)
         {
-            case PDFPostScriptFunction::Code::Add:
+            case PDFPostScriptFunction::Code::Execute:
             {
-                if (m_stack.isBinaryOperationInteger())
-                {
-                    const PDFInteger b = m_stack.popInteger();
-                    const PDFInteger a = m_stack.popInteger();
-                    m_stack.pushInteger(a + b);
-                }
-                else
-                {
-                    const PDFReal b = m_stack.popNumber();
-                    const PDFReal a = m_stack.popNumber();
-                    m_stack.pushReal(a + b);
-                }
-                break;
+                const PDFPostScriptFunctionStack::InstructionPointer callIp = m_stack.popInstructionPointer();
+                callStack.push(instruction.next);
+                ip = callIp;
+                continue;
             }
 
-            case PDFPostScriptFunction::Code::Sub:
+            case PDFPostScriptFunction::Code::If:
             {
-                if (m_stack.isBinaryOperationInteger())
-                {
-                    const PDFInteger b = m_stack.popInteger();
-                    const PDFInteger a = m_stack.popInteger();
-                    m_stack.pushInteger(a - b);
-                }
-                else
+                const PDFPostScriptFunctionStack::InstructionPointer callIp = m_stack.popInstructionPointer();
+                const bool condition = m_stack.popBoolean();
+
+                if (condition)
                 {
-                    const PDFReal b = m_stack.popNumber();
-                    const PDFReal a = m_stack.popNumber();
-                    m_stack.pushReal(a - b);
+                    // Call the if block
+                    callStack.push(instruction.next);
+                    ip = callIp;
+                    continue;
                 }
+
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Mul:
+            case PDFPostScriptFunction::Code::IfElse:
             {
-                if (m_stack.isBinaryOperationInteger())
+                const PDFPostScriptFunctionStack::InstructionPointer falsePartIp = m_stack.popInstructionPointer();
+                const PDFPostScriptFunctionStack::InstructionPointer truePartIp = m_stack.popInstructionPointer();
+                const bool condition = m_stack.popBoolean();
+
+                callStack.push(instruction.next);
+                if (condition)
                 {
-                    const PDFInteger b = m_stack.popInteger();
-                    const PDFInteger a = m_stack.popInteger();
-                    m_stack.pushInteger(a * b);
+                    // Call the if part
+                    ip = truePartIp;
                 }
                 else
                 {
-                    const PDFReal b = m_stack.popNumber();
-                    const PDFReal a = m_stack.popNumber();
-                    m_stack.pushReal(a * b);
+                    // Call the else part
+                    ip = falsePartIp;
                 }
-                break;
-            }
 
-            case PDFPostScriptFunction::Code::Div:
+                continue;
+            }
+            case PDFPostScriptFunction::Code::Pop:
             {
-                const PDFReal b = m_stack.popNumber();
-                const PDFReal a = m_stack.popNumber();
-
-                if (qFuzzyIsNull(b))
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
-                }
-
-                m_stack.pushReal(a / b);
+                m_stack.pop();
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Idiv:
+            case PDFPostScriptFunction::Code::Exch:
             {
-                const PDFInteger b = m_stack.popInteger();
-                const PDFInteger a = m_stack.popInteger();
-
-                if (b == 0)
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
-                }
-
-                m_stack.pushInteger(a / b);
+                m_stack.exch();
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Mod:
+            case PDFPostScriptFunction::Code::Dup:
             {
-                const PDFInteger b = m_stack.popInteger();
-                const PDFInteger a = m_stack.popInteger();
-
-                if (b == 0)
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
-                }
-
-                m_stack.pushInteger(a % b);
+                m_stack.dup();
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Neg:
+            case PDFPostScriptFunction::Code::Copy:
             {
-                if (m_stack.isInteger())
+                const PDFInteger n = m_stack.popInteger();
+
+                if (n < 0)
                 {
-                    m_stack.pushInteger(-m_stack.popInteger());
+                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Can't copy negative number of arguments (PostScript engine)."));
                 }
-                else
+
+                if (n > 0)
                 {
-                    m_stack.pushReal(-m_stack.popReal());
+                    m_stack.copy(n);
                 }
+
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Abs:
+            case PDFPostScriptFunction::Code::Index:
             {
-                if (m_stack.isInteger())
-                {
-                    m_stack.pushInteger(qAbs(m_stack.popInteger()));
-                }
-                else
+                const PDFInteger n = m_stack.popInteger();
+
+                if (n < 0)
                 {
-                    m_stack.pushReal(qAbs(m_stack.popReal()));
+                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Negative index of operand (PostScript engine)."));
                 }
+
+                m_stack.index(n);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Ceiling:
+            case PDFPostScriptFunction::Code::Roll:
             {
-                if (m_stack.isReal())
-                {
-                    m_stack.pushReal(std::ceil(m_stack.popReal()));
-                }
-                else if (!m_stack.isInteger())
+                const PDFInteger j = m_stack.popInteger();
+                const PDFInteger n = m_stack.popInteger();
+
+                if (n < 0)
                 {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for ceil function (PostScript engine)."));
+                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Negative number of operands (PostScript engine)."));
                 }
+
+                m_stack.roll(n, j);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Floor:
+            case PDFPostScriptFunction::Code::Call:
             {
-                if (m_stack.isReal())
-                {
-                    m_stack.pushReal(std::floor(m_stack.popReal()));
-                }
-                else if (!m_stack.isInteger())
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for floor function (PostScript engine)."));
-                }
+                Q_ASSERT(instruction.operand.type == PDFPostScriptFunction::OperandType::InstructionPointer);
+                m_stack.pushInstructionPointer(instruction.operand.instructionPointer);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Round:
+            case PDFPostScriptFunction::Code::Return:
             {
-                if (m_stack.isReal())
-                {
-                    m_stack.pushReal(qRound(m_stack.popReal()));
-                }
-                else if (!m_stack.isInteger())
+                if (callStack.empty())
                 {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for round function (PostScript engine)."));
+                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Call stack underflow (PostScript engine)."));
                 }
-                break;
+
+                ip = callStack.top();
+                callStack.pop();
+                continue;
             }
 
-            case PDFPostScriptFunction::Code::Truncate:
+            case PDFPostScriptFunction::Code::Push:
             {
-                if (m_stack.isReal())
-                {
-                    m_stack.pushReal(std::trunc(m_stack.popReal()));
-                }
-                else if (!m_stack.isInteger())
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for truncate function (PostScript engine)."));
-                }
+                m_stack.push(instruction.operand);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Sqrt:
+            default:
             {
-                const PDFReal value = m_stack.popNumber();
-
-                if (value < 0.0)
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Square root of negative value can't be computed (PostScript engine)."));
-                }
-
-                m_stack.pushReal(std::sqrt(value));
+                executeOperator(instruction.code, m_stack);
                 break;
             }
+        }
+
+        // Move to the next instruction
+        ip = instruction.next;
+    }
+}
 
-            case PDFPostScriptFunction::Code::Sin:
+void PDFPostScriptFunctionExecutor::executeOperator(PDFPostScriptFunction::Code code, Stack& stack)
+{
+    switch (code)
+    {
+        case PDFPostScriptFunction::Code::Add:
+        {
+            if (stack.isBinaryOperationInteger())
             {
-                m_stack.pushReal(qSin(qDegreesToRadians(m_stack.popNumber())));
-                break;
+                const PDFInteger b = stack.popInteger();
+                const PDFInteger a = stack.popInteger();
+                stack.pushInteger(a + b);
             }
-
-            case PDFPostScriptFunction::Code::Cos:
+            else
             {
-                m_stack.pushReal(qCos(qDegreesToRadians(m_stack.popNumber())));
-                break;
+                const PDFReal b = stack.popNumber();
+                const PDFReal a = stack.popNumber();
+                stack.pushReal(a + b);
             }
+            break;
+        }
 
-            case PDFPostScriptFunction::Code::Atan:
+        case PDFPostScriptFunction::Code::Sub:
+        {
+            if (stack.isBinaryOperationInteger())
             {
-                const PDFReal b = m_stack.popNumber();
-                const PDFReal a = m_stack.popNumber();
-
-                const PDFReal angles = qRadiansToDegrees(qAtan2(a, b));
-                m_stack.pushReal(angles < 0.0 ? (angles + 360.0) : angles);
-                break;
+                const PDFInteger b = stack.popInteger();
+                const PDFInteger a = stack.popInteger();
+                stack.pushInteger(a - b);
             }
-
-            case PDFPostScriptFunction::Code::Exp:
+            else
             {
-                const PDFReal exponent = m_stack.popNumber();
-                const PDFReal base = m_stack.popNumber();
-                m_stack.pushReal(qPow(base, exponent));
-                break;
+                const PDFReal b = stack.popNumber();
+                const PDFReal a = stack.popNumber();
+                stack.pushReal(a - b);
             }
+            break;
+        }
 
-            case PDFPostScriptFunction::Code::Ln:
+        case PDFPostScriptFunction::Code::Mul:
+        {
+            if (stack.isBinaryOperationInteger())
+            {
+                const PDFInteger b = stack.popInteger();
+                const PDFInteger a = stack.popInteger();
+                stack.pushInteger(a * b);
+            }
+            else
             {
-                const PDFReal value = m_stack.popNumber();
+                const PDFReal b = stack.popNumber();
+                const PDFReal a = stack.popNumber();
+                stack.pushReal(a * b);
+            }
+            break;
+        }
 
-                if (value < 0.0 || qFuzzyIsNull(value))
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Logarithm's input should be positive value  (PostScript engine)."));
-                }
+        case PDFPostScriptFunction::Code::Div:
+        {
+            const PDFReal b = stack.popNumber();
+            const PDFReal a = stack.popNumber();
 
-                m_stack.pushReal(qLn(value));
-                break;
+            if (qFuzzyIsNull(b))
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
             }
 
-            case PDFPostScriptFunction::Code::Log:
-            {
-                const PDFReal value = m_stack.popNumber();
+            stack.pushReal(a / b);
+            break;
+        }
 
-                if (value < 0.0 || qFuzzyIsNull(value))
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Logarithm's input should be positive value (PostScript engine)."));
-                }
+        case PDFPostScriptFunction::Code::Idiv:
+        {
+            const PDFInteger b = stack.popInteger();
+            const PDFInteger a = stack.popInteger();
 
-                m_stack.pushReal(std::log10(value));
-                break;
+            if (b == 0)
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
             }
 
-            case PDFPostScriptFunction::Code::Cvi:
+            stack.pushInteger(a / b);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Mod:
+        {
+            const PDFInteger b = stack.popInteger();
+            const PDFInteger a = stack.popInteger();
+
+            if (b == 0)
             {
-                if (m_stack.isReal())
-                {
-                    m_stack.pushInteger(static_cast<PDFInteger>(m_stack.popReal()));
-                }
-                else if (!m_stack.isInteger())
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Real value expected for conversion to integer (PostScript engine)."));
-                }
-                break;
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
+            }
+
+            stack.pushInteger(a % b);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Neg:
+        {
+            if (stack.isInteger())
+            {
+                stack.pushInteger(-stack.popInteger());
             }
+            else
+            {
+                stack.pushReal(-stack.popReal());
+            }
+            break;
+        }
 
-            case PDFPostScriptFunction::Code::Cvr:
+        case PDFPostScriptFunction::Code::Abs:
+        {
+            if (stack.isInteger())
             {
-                if (m_stack.isInteger())
-                {
-                    m_stack.pushReal(m_stack.popInteger());
-                }
-                else if (!m_stack.isReal())
-                {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Integer value expected for conversion to real (PostScript engine)."));
-                }
-                break;
+                stack.pushInteger(qAbs(stack.popInteger()));
+            }
+            else
+            {
+                stack.pushReal(qAbs(stack.popReal()));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Ceiling:
+        {
+            if (stack.isReal())
+            {
+                stack.pushReal(std::ceil(stack.popReal()));
+            }
+            else if (!stack.isInteger())
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for ceil function (PostScript engine)."));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Floor:
+        {
+            if (stack.isReal())
+            {
+                stack.pushReal(std::floor(stack.popReal()));
+            }
+            else if (!stack.isInteger())
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for floor function (PostScript engine)."));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Round:
+        {
+            if (stack.isReal())
+            {
+                stack.pushReal(qRound(stack.popReal()));
+            }
+            else if (!stack.isInteger())
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for round function (PostScript engine)."));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Truncate:
+        {
+            if (stack.isReal())
+            {
+                stack.pushReal(std::trunc(stack.popReal()));
+            }
+            else if (!stack.isInteger())
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected for truncate function (PostScript engine)."));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Sqrt:
+        {
+            const PDFReal value = stack.popNumber();
+
+            if (value < 0.0)
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Square root of negative value can't be computed (PostScript engine)."));
+            }
+
+            stack.pushReal(std::sqrt(value));
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Sin:
+        {
+            stack.pushReal(qSin(qDegreesToRadians(stack.popNumber())));
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Cos:
+        {
+            stack.pushReal(qCos(qDegreesToRadians(stack.popNumber())));
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Atan:
+        {
+            const PDFReal b = stack.popNumber();
+            const PDFReal a = stack.popNumber();
+
+            const PDFReal angles = qRadiansToDegrees(qAtan2(a, b));
+            stack.pushReal(angles < 0.0 ? (angles + 360.0) : angles);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Exp:
+        {
+            const PDFReal exponent = stack.popNumber();
+            const PDFReal base = stack.popNumber();
+            stack.pushReal(qPow(base, exponent));
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Ln:
+        {
+            const PDFReal value = stack.popNumber();
+
+            if (value < 0.0 || qFuzzyIsNull(value))
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Logarithm's input should be positive value  (PostScript engine)."));
+            }
+
+            stack.pushReal(qLn(value));
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Log:
+        {
+            const PDFReal value = stack.popNumber();
+
+            if (value < 0.0 || qFuzzyIsNull(value))
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Logarithm's input should be positive value (PostScript engine)."));
+            }
+
+            stack.pushReal(std::log10(value));
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Cvi:
+        {
+            if (stack.isReal())
+            {
+                stack.pushInteger(static_cast<PDFInteger>(stack.popReal()));
+            }
+            else if (!stack.isInteger())
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Real value expected for conversion to integer (PostScript engine)."));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Cvr:
+        {
+            if (stack.isInteger())
+            {
+                stack.pushReal(stack.popInteger());
+            }
+            else if (!stack.isReal())
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Integer value expected for conversion to real (PostScript engine)."));
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Eq:
+        {
+            if (stack.isBinaryOperationInteger())
+            {
+                const PDFInteger b = stack.popInteger();
+                const PDFInteger a = stack.popInteger();
+                stack.pushBoolean(a == b);
+            }
+            else if (stack.isBinaryOperationBoolean())
+            {
+                const bool b = stack.popBoolean();
+                const bool a = stack.popBoolean();
+                stack.pushBoolean(a == b);
+            }
+            else
+            {
+                // Real values
+                const PDFReal b = stack.popNumber();
+                const PDFReal a = stack.popNumber();
+                stack.pushBoolean(a == b);
+            }
+
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Ne:
+        {
+            if (stack.isBinaryOperationInteger())
+            {
+                const PDFInteger b = stack.popInteger();
+                const PDFInteger a = stack.popInteger();
+                stack.pushBoolean(a != b);
+            }
+            else if (stack.isBinaryOperationBoolean())
+            {
+                const bool b = stack.popBoolean();
+                const bool a = stack.popBoolean();
+                stack.pushBoolean(a != b);
+            }
+            else
+            {
+                // Real values
+                const PDFReal b = stack.popNumber();
+                const PDFReal a = stack.popNumber();
+                stack.pushBoolean(a != b);
+            }
+
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Gt:
+        {
+            executeRelationOperator<std::greater>(stack);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Ge:
+        {
+            executeRelationOperator<std::greater_equal>(stack);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Lt:
+        {
+            executeRelationOperator<std::less>(stack);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Le:
+        {
+            executeRelationOperator<std::less_equal>(stack);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::And:
+        {
+            if (stack.isBinaryOperationBoolean())
+            {
+                const bool a = stack.popBoolean();
+                const bool b = stack.popBoolean();
+                stack.pushBoolean(a && b);
             }
+            else
+            {
+                const PDFIntegerUnsigned a = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                const PDFIntegerUnsigned b = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                stack.pushInteger(a & b);
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Or:
+        {
+            if (stack.isBinaryOperationBoolean())
+            {
+                const bool a = stack.popBoolean();
+                const bool b = stack.popBoolean();
+                stack.pushBoolean(a || b);
+            }
+            else
+            {
+                const PDFIntegerUnsigned a = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                const PDFIntegerUnsigned b = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                stack.pushInteger(a | b);
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Xor:
+        {
+            if (stack.isBinaryOperationBoolean())
+            {
+                const bool a = stack.popBoolean();
+                const bool b = stack.popBoolean();
+                stack.pushBoolean(a != b);
+            }
+            else
+            {
+                const PDFIntegerUnsigned a = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                const PDFIntegerUnsigned b = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                stack.pushInteger(a ^ b);
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Not:
+        {
+            if (stack.isInteger())
+            {
+                const PDFIntegerUnsigned value = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+                stack.pushInteger(~value);
+            }
+            else
+            {
+                const bool value = stack.popBoolean();
+                stack.pushBoolean(!value);
+            }
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::Bitshift:
+        {
+            const PDFInteger shift = stack.popInteger();
+            const PDFIntegerUnsigned value = static_cast<PDFIntegerUnsigned>(stack.popInteger());
+            PDFIntegerUnsigned shiftedValue = value;
+
+            if (shift > 0)
+            {
+                // Positive is left
+                shiftedValue = value << shift;
+            }
+            else if (shift < 0)
+            {
+                // Negative is right
+                shiftedValue = value >> -shift;
+            }
+
+            stack.pushInteger(shiftedValue);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::True:
+        {
+            stack.pushBoolean(true);
+            break;
+        }
+
+        case PDFPostScriptFunction::Code::False:
+        {
+            stack.pushBoolean(false);
+            break;
+        }
+
+        default:
+        {
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+bool PDFPostScriptFunctionStack::isBinaryOperationInteger() const
+{
+    checkUnderflow(2);
+
+    const size_t size = m_stack.size();
+    return m_stack[size - 1].type == PDFPostScriptFunction::OperandType::Integer &&
+            m_stack[size - 2].type == PDFPostScriptFunction::OperandType::Integer;
+}
+
+bool PDFPostScriptFunctionStack::isBinaryOperationBoolean() const
+{
+    checkUnderflow(2);
+
+    const size_t size = m_stack.size();
+    return m_stack[size - 1].type == PDFPostScriptFunction::OperandType::Boolean &&
+            m_stack[size - 2].type == PDFPostScriptFunction::OperandType::Boolean;
+}
+
+PDFReal PDFPostScriptFunctionStack::popReal()
+{
+    checkUnderflow();
+
+    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
+    if (topElement.type == PDFPostScriptFunction::OperandType::Real)
+    {
+        const PDFReal value = topElement.realNumber;
+        m_stack.pop_back();
+        return value;
+    }
+    else
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Real value expected (PostScript engine)."));
+    }
+}
+
+PDFInteger PDFPostScriptFunctionStack::popInteger()
+{
+    checkUnderflow();
+
+    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
+    if (topElement.type == PDFPostScriptFunction::OperandType::Integer)
+    {
+        const PDFInteger value = topElement.integerNumber;
+        m_stack.pop_back();
+        return value;
+    }
+    else
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Integer value expected (PostScript engine)."));
+    }
+}
+
+bool PDFPostScriptFunctionStack::popBoolean()
+{
+    checkUnderflow();
+
+    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
+    if (topElement.type == PDFPostScriptFunction::OperandType::Boolean)
+    {
+        const bool value = topElement.boolean;
+        m_stack.pop_back();
+        return value;
+    }
+    else
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Boolean value expected (PostScript engine)."));
+    }
+}
+
+PDFPostScriptFunctionStack::InstructionPointer PDFPostScriptFunctionStack::popInstructionPointer()
+{
+    checkUnderflow();
+
+    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
+    if (topElement.type == PDFPostScriptFunction::OperandType::InstructionPointer)
+    {
+        const InstructionPointer value = topElement.instructionPointer;
+        m_stack.pop_back();
+        return value;
+    }
+    else
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Instruction pointer expected (PostScript engine)."));
+    }
+}
+
+PDFReal PDFPostScriptFunctionStack::popNumber()
+{
+    checkUnderflow();
+
+    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
+    if (topElement.type == PDFPostScriptFunction::OperandType::Real)
+    {
+        const PDFReal value = topElement.realNumber;
+        m_stack.pop_back();
+        return value;
+    }
+    else if (topElement.type == PDFPostScriptFunction::OperandType::Integer)
+    {
+        const PDFInteger value = topElement.integerNumber;
+        m_stack.pop_back();
+        return value;
+    }
+    else
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected (PostScript engine)."));
+    }
+}
+
+void PDFPostScriptFunctionStack::exch()
+{
+    checkUnderflow(2);
+
+    const size_t size = m_stack.size();
+    std::swap(m_stack[size - 2], m_stack[size - 1]);
+}
+
+void PDFPostScriptFunctionStack::dup()
+{
+    checkUnderflow();
+    m_stack.push_back(m_stack.back());
+    checkOverflow();
+}
+
+void PDFPostScriptFunctionStack::copy(PDFInteger n)
+{
+    Q_ASSERT(n > 0);
+
+    checkUnderflow(static_cast<size_t>(n));
+
+    size_t startIndex = m_stack.size() - n;
+    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
+    {
+        m_stack.push_back(m_stack[startIndex + i]);
+        checkOverflow();
+    }
+}
+
+void PDFPostScriptFunctionStack::index(PDFInteger n)
+{
+    Q_ASSERT(n >= 0);
+
+    checkUnderflow(static_cast<size_t>(n) + 1);
+    m_stack.push_back(m_stack[m_stack.size() - 1 - n]);
+}
+
+void PDFPostScriptFunctionStack::roll(PDFInteger n, PDFInteger j)
+{
+    if (n == 0)
+    {
+        // If n is zero, then we are rolling zero arguments - do nothing
+        return;
+    }
+
+    // If we roll n-times, then we get original sequence
+    j = j % n;
+    if (j == 0)
+    {
+        // If j is zero, then we don't roll anything at all - do nothing
+        return;
+    }
+
+    checkUnderflow(n);
+
+    // Load operands into temporary array
+    const size_t firstIndexOnStack = m_stack.size() - n;
+    std::vector<OperandObject> operands(n);
+    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
+    {
+        operands[i] = m_stack[firstIndexOnStack + i];
+    }
+
+    if (j > 0)
+    {
+        // Rotate left j times
+        std::rotate(operands.begin(), operands.end() - j, operands.end());
+    }
+    else
+    {
+        // Rotate right j times
+        std::rotate(operands.rbegin(), operands.rend() + j, operands.rend());
+    }
+
+    // Load data back from temporary array
+    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
+    {
+        m_stack[firstIndexOnStack + i] = operands[i];
+    }
+}
+
+void PDFPostScriptFunctionStack::checkOverflow() const
+{
+    if (m_stack.size() > 100)
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Stack overflow occured (PostScript engine)."));
+    }
+}
+
+void PDFPostScriptFunctionStack::checkUnderflow(size_t n) const
+{
+    if (m_stack.size() < n)
+    {
+        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Stack underflow occured (PostScript engine)."));
+    }
+}
+
+/// Compiles the postscript program into the linear sequence of operators over
+/// value slots. Stack operators are resolved during the compilation (so they do
+/// not exist in the compiled program), blocks are inlined, and operators with
+/// constant operands are evaluated. Program can't be compiled, if it contains
+/// conditions, which depend on input values, or if it fails during compilation.
+class PDFPostScriptFunctionCompiler
+{
+public:
+    using Code = PDFPostScriptFunction::Code;
+    using Program = PDFPostScriptFunction::Program;
+    using CodeObject = PDFPostScriptFunction::CodeObject;
+    using OperandType = PDFPostScriptFunction::OperandType;
+    using OperandObject = PDFPostScriptFunction::OperandObject;
+    using ValueSlot = PDFPostScriptFunction::ValueSlot;
+    using CompiledProgram = PDFPostScriptFunction::CompiledProgram;
+    using CompiledInstruction = PDFPostScriptFunction::CompiledInstruction;
+    using InstructionPointer = PDFPostScriptFunction::InstructionPointer;
+
+    explicit inline PDFPostScriptFunctionCompiler(const Program& program, uint32_t m, uint32_t n) :
+        m_program(program),
+        m_m(m),
+        m_n(n)
+    {
+
+    }
+
+    /// Compiles the program. If program can't be compiled,
+    /// then invalid compiled program is returned.
+    CompiledProgram compile();
+
+private:
+    /// Maximal stack size, according to the PDF 1.7 specification
+    static constexpr const size_t MAXIMAL_STACK_SIZE = 100;
 
-            case PDFPostScriptFunction::Code::Eq:
-            {
-                if (m_stack.isBinaryOperationInteger())
-                {
-                    const PDFInteger b = m_stack.popInteger();
-                    const PDFInteger a = m_stack.popInteger();
-                    m_stack.pushBoolean(a == b);
-                }
-                else if (m_stack.isBinaryOperationBoolean())
-                {
-                    const bool b = m_stack.popBoolean();
-                    const bool a = m_stack.popBoolean();
-                    m_stack.pushBoolean(a == b);
-                }
-                else
-                {
-                    // Real values
-                    const PDFReal b = m_stack.popNumber();
-                    const PDFReal a = m_stack.popNumber();
-                    m_stack.pushBoolean(a == b);
-                }
+    /// Maximal depth of the inlined blocks
+    static constexpr const int MAXIMAL_BLOCK_DEPTH = 32;
 
-                break;
-            }
+    /// Maximal number of value slots of the compiled program
+    static constexpr const size_t MAXIMAL_VALUE_COUNT = 4096;
 
-            case PDFPostScriptFunction::Code::Ne:
-            {
-                if (m_stack.isBinaryOperationInteger())
-                {
-                    const PDFInteger b = m_stack.popInteger();
-                    const PDFInteger a = m_stack.popInteger();
-                    m_stack.pushBoolean(a != b);
-                }
-                else if (m_stack.isBinaryOperationBoolean())
-                {
-                    const bool b = m_stack.popBoolean();
-                    const bool a = m_stack.popBoolean();
-                    m_stack.pushBoolean(a != b);
-                }
-                else
-                {
-                    // Real values
-                    const PDFReal b = m_stack.popNumber();
-                    const PDFReal a = m_stack.popNumber();
-                    m_stack.pushBoolean(a != b);
-                }
+    /// Compiles the block starting at given instruction pointer.
+    /// Returns false, if block can't be compiled.
+    /// \param ip Instruction pointer of the first instruction of the block
+    /// \param depth Depth of the block (top level program has depth 0)
+    bool compileBlock(InstructionPointer ip, int depth);
 
-                break;
-            }
+    /// Compiles operator, which pops \p operandCount operands from
+    /// the stack and pushes the result. Returns false, if operator
+    /// can't be compiled.
+    /// \param code Operator code
+    /// \param operandCount Operand count
+    bool compileOperator(Code code, size_t operandCount);
 
-            case PDFPostScriptFunction::Code::Gt:
-            {
-                executeRelationOperator<std::greater>();
-                break;
-            }
+    /// Returns number of operands of the operator
+    static size_t getOperandCount(Code code);
 
-            case PDFPostScriptFunction::Code::Ge:
-            {
-                executeRelationOperator<std::greater_equal>();
-                break;
-            }
+    /// Adds new value slot
+    /// \param value Value of the slot
+    /// \param isConstant Is value constant?
+    ValueSlot addValue(const OperandObject& value, bool isConstant);
 
-            case PDFPostScriptFunction::Code::Lt:
-            {
-                executeRelationOperator<std::less>();
-                break;
-            }
+    bool push(ValueSlot slot);
+    bool pop(ValueSlot& slot);
+    bool popConstant(OperandObject& value, OperandType type);
 
-            case PDFPostScriptFunction::Code::Le:
-            {
-                executeRelationOperator<std::less_equal>();
-                break;
-            }
+    const Program& m_program;
+    uint32_t m_m;
+    uint32_t m_n;
+    std::vector<OperandObject> m_values;
+    std::vector<bool> m_isConstant;
+    std::vector<CompiledInstruction> m_instructions;
+    std::vector<ValueSlot> m_stack;
+};
 
-            case PDFPostScriptFunction::Code::And:
-            {
-                if (m_stack.isBinaryOperationBoolean())
-                {
-                    const bool a = m_stack.popBoolean();
-                    const bool b = m_stack.popBoolean();
-                    m_stack.pushBoolean(a && b);
-                }
-                else
-                {
-                    const PDFIntegerUnsigned a = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    const PDFIntegerUnsigned b = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    m_stack.pushInteger(a & b);
-                }
-                break;
-            }
+PDFPostScriptFunctionCompiler::CompiledProgram PDFPostScriptFunctionCompiler::compile()
+{
+    CompiledProgram result;
+
+    for (uint32_t i = 0; i < m_m; ++i)
+    {
+        if (!push(addValue(OperandObject::createReal(0.0), false)))
+        {
+            return result;
+        }
+    }
+
+    if (!compileBlock(0, 0) || m_stack.size() != m_n || m_values.size() > MAXIMAL_VALUE_COUNT)
+    {
+        return result;
+    }
+
+    result.values = std::move(m_values);
+    result.instructions = std::move(m_instructions);
+    result.outputs = std::move(m_stack);
+    return result;
+}
+
+bool PDFPostScriptFunctionCompiler::compileBlock(InstructionPointer ip, int depth)
+{
+    if (depth > MAXIMAL_BLOCK_DEPTH)
+    {
+        return false;
+    }
+
+    while (ip != PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER)
+    {
+        if (ip >= m_program.size() || m_values.size() > MAXIMAL_VALUE_COUNT)
+        {
+            return false;
+        }
 
-            case PDFPostScriptFunction::Code::Or:
+        const CodeObject& instruction = m_program[ip];
+        switch (instruction.code)
+        {
+            case Code::Push:
+            case Code::Call:
             {
-                if (m_stack.isBinaryOperationBoolean())
+                // Call pushes instruction pointer of the block onto the stack
+                if (!push(addValue(instruction.operand, true)))
                 {
-                    const bool a = m_stack.popBoolean();
-                    const bool b = m_stack.popBoolean();
-                    m_stack.pushBoolean(a || b);
-                }
-                else
-                {
-                    const PDFIntegerUnsigned a = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    const PDFIntegerUnsigned b = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    m_stack.pushInteger(a | b);
+                    return false;
                 }
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Xor:
+            case Code::Execute:
             {
-                if (m_stack.isBinaryOperationBoolean())
+                OperandObject block;
+                if (!popConstant(block, OperandType::InstructionPointer) || !compileBlock(block.instructionPointer, depth + 1))
                 {
-                    const bool a = m_stack.popBoolean();
-                    const bool b = m_stack.popBoolean();
-                    m_stack.pushBoolean(a != b);
-                }
-                else
-                {
-                    const PDFIntegerUnsigned a = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    const PDFIntegerUnsigned b = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    m_stack.pushInteger(a ^ b);
+                    return false;
                 }
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Not:
+            case Code::If:
             {
-                if (m_stack.isInteger())
+                OperandObject block;
+                OperandObject condition;
+                if (!popConstant(block, OperandType::InstructionPointer) || !popConstant(condition, OperandType::Boolean))
                 {
-                    const PDFIntegerUnsigned value = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                    m_stack.pushInteger(~value);
+                    return false;
                 }
-                else
+
+                if (condition.boolean && !compileBlock(block.instructionPointer, depth + 1))
                 {
-                    const bool value = m_stack.popBoolean();
-                    m_stack.pushBoolean(!value);
+                    return false;
                 }
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Bitshift:
+            case Code::IfElse:
             {
-                const PDFInteger shift = m_stack.popInteger();
-                const PDFIntegerUnsigned value = static_cast<PDFIntegerUnsigned>(m_stack.popInteger());
-                PDFIntegerUnsigned shiftedValue = value;
-
-                if (shift > 0)
+                OperandObject falseBlock;
+                OperandObject trueBlock;
+                OperandObject condition;
+                if (!popConstant(falseBlock, OperandType::InstructionPointer) ||
+                    !popConstant(trueBlock, OperandType::InstructionPointer) ||
+                    !popConstant(condition, OperandType::Boolean))
                 {
-                    // Positive is left
-                    shiftedValue = value << shift;
+                    return false;
                 }
-                else if (shift < 0)
+
+                if (!compileBlock(condition.boolean ? trueBlock.instructionPointer : falseBlock.instructionPointer, depth + 1))
                 {
-                    // Negative is right
-                    shiftedValue = value >> -shift;
+                    return false;
                 }
-
-                m_stack.pushInteger(shiftedValue);
-                break;
-            }
-
-            case PDFPostScriptFunction::Code::True:
-            {
-                m_stack.pushBoolean(true);
-                break;
-            }
-
-            case PDFPostScriptFunction::Code::False:
-            {
-                m_stack.pushBoolean(false);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Execute:
+            case Code::Return:
             {
-                const PDFPostScriptFunctionStack::InstructionPointer callIp = m_stack.popInstructionPointer();
-                callStack.push(instruction.next);
-                ip = callIp;
-                continue;
+                // Return from the top level program is an error
+                return depth > 0;
             }
 
-            case PDFPostScriptFunction::Code::If:
+            case Code::Pop:
             {
-                const PDFPostScriptFunctionStack::InstructionPointer callIp = m_stack.popInstructionPointer();
-                const bool condition = m_stack.popBoolean();
-
-                if (condition)
+                ValueSlot slot = PDFPostScriptFunction::INVALID_VALUE_SLOT;
+                if (!pop(slot))
                 {
-                    // Call the if block
-                    callStack.push(instruction.next);
-                    ip = callIp;
-                    continue;
+                    return false;
                 }
-
                 break;
             }
 
-            case PDFPostScriptFunction::Code::IfElse:
+            case Code::Exch:
             {
-                const PDFPostScriptFunctionStack::InstructionPointer falsePartIp = m_stack.popInstructionPointer();
-                const PDFPostScriptFunctionStack::InstructionPointer truePartIp = m_stack.popInstructionPointer();
-                const bool condition = m_stack.popBoolean();
-
-                callStack.push(instruction.next);
-                if (condition)
-                {
-                    // Call the if part
-                    ip = truePartIp;
-                }
-                else
+                if (m_stack.size() < 2)
                 {
-                    // Call the else part
-                    ip = falsePartIp;
+                    return false;
                 }
 
-                continue;
-            }
-            case PDFPostScriptFunction::Code::Pop:
-            {
-                m_stack.pop();
-                break;
-            }
-
-            case PDFPostScriptFunction::Code::Exch:
-            {
-                m_stack.exch();
+                std::swap(m_stack[m_stack.size() - 2], m_stack[m_stack.size() - 1]);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Dup:
+            case Code::Dup:
             {
-                m_stack.dup();
+                if (m_stack.empty() || !push(m_stack.back()))
+                {
+                    return false;
+                }
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Copy:
+            case Code::Copy:
             {
-                const PDFInteger n = m_stack.popInteger();
-
-                if (n < 0)
+                OperandObject count;
+                if (!popConstant(count, OperandType::Integer) || count.integerNumber < 0 || m_stack.size() < static_cast<size_t>(count.integerNumber))
                 {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Can't copy negative number of arguments (PostScript engine)."));
+                    return false;
                 }
 
-                if (n > 0)
+                const size_t startIndex = m_stack.size() - count.integerNumber;
+                for (size_t i = 0; i < static_cast<size_t>(count.integerNumber); ++i)
                 {
-                    m_stack.copy(n);
+                    if (!push(m_stack[startIndex + i]))
+                    {
+                        return false;
+                    }
                 }
-
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Index:
+            case Code::Index:
             {
-                const PDFInteger n = m_stack.popInteger();
-
-                if (n < 0)
+                OperandObject index;
+                if (!popConstant(index, OperandType::Integer) || index.integerNumber < 0 || m_stack.size() < static_cast<size_t>(index.integerNumber) + 1)
                 {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Negative index of operand (PostScript engine)."));
+                    return false;
                 }
 
-                m_stack.index(n);
-                break;
-            }
-
-            case PDFPostScriptFunction::Code::Roll:
-            {
-                const PDFInteger j = m_stack.popInteger();
-                const PDFInteger n = m_stack.popInteger();
-
-                if (n < 0)
+                if (!push(m_stack[m_stack.size() - 1 - index.integerNumber]))
                 {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Negative number of operands (PostScript engine)."));
+                    return false;
                 }
-
-                m_stack.roll(n, j);
-                break;
-            }
-
-            case PDFPostScriptFunction::Code::Call:
-            {
-                Q_ASSERT(instruction.operand.type == PDFPostScriptFunction::OperandType::InstructionPointer);
-                m_stack.pushInstructionPointer(instruction.operand.instructionPointer);
                 break;
             }
 
-            case PDFPostScriptFunction::Code::Return:
+            case Code::Roll:
             {
-                if (callStack.empty())
+                OperandObject j;
+                OperandObject n;
+                if (!popConstant(j, OperandType::Integer) || !popConstant(n, OperandType::Integer) || n.integerNumber < 0)
                 {
-                    throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Call stack underflow (PostScript engine)."));
+                    return false;
                 }
 
-                ip = callStack.top();
-                callStack.pop();
-                continue;
-            }
-
-            case PDFPostScriptFunction::Code::Push:
-            {
-                m_stack.push(instruction.operand);
-                break;
-            }
-        }
-
-        // Move to the next instruction
-        ip = instruction.next;
-    }
-}
-
-bool PDFPostScriptFunctionStack::isBinaryOperationInteger() const
-{
-    checkUnderflow(2);
-
-    const size_t size = m_stack.size();
-    return m_stack[size - 1].type == PDFPostScriptFunction::OperandType::Integer &&
-            m_stack[size - 2].type == PDFPostScriptFunction::OperandType::Integer;
-}
-
-bool PDFPostScriptFunctionStack::isBinaryOperationBoolean() const
-{
-    checkUnderflow(2);
-
-    const size_t size = m_stack.size();
-    return m_stack[size - 1].type == PDFPostScriptFunction::OperandType::Boolean &&
-            m_stack[size - 2].type == PDFPostScriptFunction::OperandType::Boolean;
-}
-
-PDFReal PDFPostScriptFunctionStack::popReal()
-{
-    checkUnderflow();
+                if (n.integerNumber == 0)
+                {
+                    break;
+                }
 
-    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
-    if (topElement.type == PDFPostScriptFunction::OperandType::Real)
-    {
-        const PDFReal value = topElement.realNumber;
-        m_stack.pop_back();
-        return value;
-    }
-    else
-    {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Real value expected (PostScript engine)."));
-    }
-}
+                const PDFInteger shift = j.integerNumber % n.integerNumber;
+                if (shift == 0)
+                {
+                    break;
+                }
 
-PDFInteger PDFPostScriptFunctionStack::popInteger()
-{
-    checkUnderflow();
+                if (m_stack.size() < static_cast<size_t>(n.integerNumber))
+                {
+                    return false;
+                }
 
-    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
-    if (topElement.type == PDFPostScriptFunction::OperandType::Integer)
-    {
-        const PDFInteger value = topElement.integerNumber;
-        m_stack.pop_back();
-        return value;
-    }
-    else
-    {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Integer value expected (PostScript engine)."));
-    }
-}
+                auto first = std::next(m_stack.begin(), m_stack.size() - n.integerNumber);
+                if (shift > 0)
+                {
+                    std::rotate(first, m_stack.end() - shift, m_stack.end());
+                }
+                else
+                {
+                    std::rotate(first, first - shift, m_stack.end());
+                }
+                break;
+            }
 
-bool PDFPostScriptFunctionStack::popBoolean()
-{
-    checkUnderflow();
+            default:
+            {
+                if (!compileOperator(instruction.code, getOperandCount(instruction.code)))
+                {
+                    return false;
+                }
+                break;
+            }
+        }
 
-    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
-    if (topElement.type == PDFPostScriptFunction::OperandType::Boolean)
-    {
-        const bool value = topElement.boolean;
-        m_stack.pop_back();
-        return value;
-    }
-    else
-    {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Boolean value expected (PostScript engine)."));
+        ip = instruction.next;
     }
+
+    // Only top level program can end with invalid instruction pointer
+    return depth == 0;
 }
 
-PDFPostScriptFunctionStack::InstructionPointer PDFPostScriptFunctionStack::popInstructionPointer()
+bool PDFPostScriptFunctionCompiler::compileOperator(Code code, size_t operandCount)
 {
-    checkUnderflow();
+    Q_ASSERT(operandCount <= 2);
 
-    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
-    if (topElement.type == PDFPostScriptFunction::OperandType::InstructionPointer)
+    std::array<ValueSlot, 2> operands = { PDFPostScriptFunction::INVALID_VALUE_SLOT, PDFPostScriptFunction::INVALID_VALUE_SLOT };
+    for (size_t i = operandCount; i > 0; --i)
     {
-        const InstructionPointer value = topElement.instructionPointer;
-        m_stack.pop_back();
-        return value;
+        if (!pop(operands[i - 1]))
+        {
+            return false;
+        }
     }
-    else
+
+    const bool isConstant = std::all_of(operands.cbegin(), std::next(operands.cbegin(), operandCount), [this](ValueSlot slot) { return m_isConstant[slot]; });
+    if (isConstant)
     {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Instruction pointer expected (PostScript engine)."));
-    }
-}
+        // Evaluate the operator now, value will be a constant
+        try
+        {
+            PDFPostScriptFunctionStack stack;
+            for (size_t i = 0; i < operandCount; ++i)
+            {
+                stack.push(m_values[operands[i]]);
+            }
 
-PDFReal PDFPostScriptFunctionStack::popNumber()
-{
-    checkUnderflow();
+            PDFPostScriptFunctionExecutor::executeOperator(code, stack);
+            OperandObject value = stack.popOperand();
 
-    const PDFPostScriptFunction::OperandObject& topElement = m_stack.back();
-    if (topElement.type == PDFPostScriptFunction::OperandType::Real)
-    {
-        const PDFReal value = topElement.realNumber;
-        m_stack.pop_back();
-        return value;
-    }
-    else if (topElement.type == PDFPostScriptFunction::OperandType::Integer)
-    {
-        const PDFInteger value = topElement.integerNumber;
-        m_stack.pop_back();
-        return value;
-    }
-    else
-    {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Number expected (PostScript engine)."));
+            if (!stack.empty())
+            {
+                return false;
+            }
+
+            return push(addValue(value, true));
+        }
+        catch (const PDFPostScriptFunction::PDFPostScriptFunctionException&)
+        {
+            // Let the interpreter report the error
+            return false;
+        }
     }
+
+    CompiledInstruction instruction;
+    instruction.code = code;
+    instruction.operand1 = operands[0];
+    instruction.operand2 = operands[1];
+    instruction.result = addValue(OperandObject::createReal(0.0), false);
+    m_instructions.push_back(instruction);
+    return push(instruction.result);
 }
 
-void PDFPostScriptFunctionStack::exch()
+size_t PDFPostScriptFunctionCompiler::getOperandCount(Code code)
 {
-    checkUnderflow(2);
+    switch (code)
+    {
+        case Code::True:
+        case Code::False:
+            return 0;
+
+        case Code::Neg:
+        case Code::Abs:
+        case Code::Ceiling:
+        case Code::Floor:
+        case Code::Round:
+        case Code::Truncate:
+        case Code::Sqrt:
+        case Code::Sin:
+        case Code::Cos:
+        case Code::Ln:
+        case Code::Log:
+        case Code::Cvi:
+        case Code::Cvr:
+        case Code::Not:
+            return 1;
 
-    const size_t size = m_stack.size();
-    std::swap(m_stack[size - 2], m_stack[size - 1]);
-}
+        default:
+            break;
+    }
 
-void PDFPostScriptFunctionStack::dup()
-{
-    checkUnderflow();
-    m_stack.push_back(m_stack.back());
-    checkOverflow();
+    return 2;
 }
 
-void PDFPostScriptFunctionStack::copy(PDFInteger n)
+PDFPostScriptFunctionCompiler::ValueSlot PDFPostScriptFunctionCompiler::addValue(const OperandObject& value, bool isConstant)
 {
-    Q_ASSERT(n > 0);
-
-    checkUnderflow(static_cast<size_t>(n));
-
-    size_t startIndex = m_stack.size() - n;
-    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
-    {
-        m_stack.push_back(m_stack[startIndex + i]);
-        checkOverflow();
-    }
+    const ValueSlot slot = static_cast<ValueSlot>(m_values.size());
+    m_values.push_back(value);
+    m_isConstant.push_back(isConstant);
+    return slot;
 }
 
-void PDFPostScriptFunctionStack::index(PDFInteger n)
+bool PDFPostScriptFunctionCompiler::push(ValueSlot slot)
 {
-    Q_ASSERT(n >= 0);
-
-    checkUnderflow(static_cast<size_t>(n) + 1);
-    m_stack.push_back(m_stack[m_stack.size() - 1 - n]);
+    m_stack.push_back(slot);
+    return m_stack.size() <= MAXIMAL_STACK_SIZE;
 }
 
-void PDFPostScriptFunctionStack::roll(PDFInteger n, PDFInteger j)
+bool PDFPostScriptFunctionCompiler::pop(ValueSlot& slot)
 {
-    if (n == 0)
-    {
-        // If n is zero, then we are rolling zero arguments - do nothing
-        return;
-    }
-
-    // If we roll n-times, then we get original sequence
-    j = j % n;
-    if (j == 0)
-    {
-        // If j is zero, then we don't roll anything at all - do nothing
-        return;
-    }
-
-    checkUnderflow(n);
-
-    // Load operands into temporary array
-    const size_t firstIndexOnStack = m_stack.size() - n;
-    std::vector<OperandObject> operands(n);
-    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
-    {
-        operands[i] = m_stack[firstIndexOnStack + i];
-    }
-
-    if (j > 0)
-    {
-        // Rotate left j times
-        std::rotate(operands.begin(), operands.end() - j, operands.end());
-    }
-    else
+    if (m_stack.empty())
     {
-        // Rotate right j times
-        std::rotate(operands.rbegin(), operands.rend() + j, operands.rend());
+        return false;
     }
 
-    // Load data back from temporary array
-    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
-    {
-        m_stack[firstIndexOnStack + i] = operands[i];
-    }
+    slot = m_stack.back();
+    m_stack.pop_back();
+    return true;
 }
 
-void PDFPostScriptFunctionStack::checkOverflow() const
+bool PDFPostScriptFunctionCompiler::popConstant(OperandObject& value, OperandType type)
 {
-    if (m_stack.size() > 100)
+    ValueSlot slot = PDFPostScriptFunction::INVALID_VALUE_SLOT;
+    if (!pop(slot) || !m_isConstant[slot] || m_values[slot].type != type)
     {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Stack overflow occured (PostScript engine)."));
+        return false;
     }
-}
 
-void PDFPostScriptFunctionStack::checkUnderflow(size_t n) const
-{
-    if (m_stack.size() < n)
-    {
-        throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Stack underflow occured (PostScript engine)."));
-    }
+    value = m_values[slot];
+    return true;
 }
 
 PDFPostScriptFunction::Code PDFPostScriptFunction::getCode(const QByteArray& byteArray)
@@ -1651,6 +2278,10 @@ PDFPostScriptFunction::PDFPostScriptFunction(uint32_t m, uint32_t n, std::vector
     m_program(std::move(program))
 {
     Q_ASSERT(!m_program.empty());
+
+    PDFPostScriptFunctionCompiler compiler(m_program, m_m, m_n);
+    m_compiledProgram = compiler.compile();
+    m_isLinear = isCompiledProgramLinear();
 }
 
 PDFPostScriptFunction::~PDFPostScriptFunction()
@@ -1838,28 +2469,214 @@ PDFFunction::FunctionResult PDFPostScriptFunction::apply(const_iterator x_1, con
         return PDFTranslationContext::tr("Invalid number of output variables for function. Expected %1, provided %2.").arg(m_n).arg(n);
     }
 
+    std::vector<OperandObject> values = m_compiledProgram.values;
+    return evaluate(x_1, y_1, values);
+}
+
+PDFFunction::FunctionResult PDFPostScriptFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    FunctionResult result(true);
+
+    // Values are initialized only once, constants are never overwritten
+    std::vector<OperandObject> values = m_compiledProgram.values;
+    for (size_t i = 0; i < count; ++i)
+    {
+        FunctionResult itemResult = evaluate(x + i * m_m, y + i * m_n, values);
+        if (!itemResult)
+        {
+            result = std::move(itemResult);
+        }
+    }
+
+    return result;
+}
+
+bool PDFPostScriptFunction::isCompiledProgramLinear() const
+{
+    if (!isCompiled() || m_domain.size() != 2 * m_m || m_range.size() != 2 * m_n)
+    {
+        return false;
+    }
+
+    // Each value slot is expressed as an affine form of the input values,
+    // coefficients of the input values are followed by the constant term.
+    // Empty form means, that value is not affine.
+    using AffineForm = std::vector<PDFReal>;
+    const size_t formSize = m_m + 1;
+
+    std::vector<AffineForm> forms(m_compiledProgram.values.size());
+    for (size_t i = 0; i < forms.size(); ++i)
+    {
+        const OperandObject& value = m_compiledProgram.values[i];
+        if (i < m_m)
+        {
+            forms[i].resize(formSize, 0.0);
+            forms[i][i] = 1.0;
+        }
+        else if (value.type == OperandType::Real || value.type == OperandType::Integer)
+        {
+            forms[i].resize(formSize, 0.0);
+            forms[i].back() = value.type == OperandType::Real ? value.realNumber : PDFReal(value.integerNumber);
+        }
+    }
+
+    auto isConstant = [formSize](const AffineForm& form)
+    {
+        return !form.empty() && std::all_of(form.cbegin(), std::next(form.cbegin(), formSize - 1), [](PDFReal coefficient) { return coefficient == 0.0; });
+    };
+
+    auto scale = [](const AffineForm& form, PDFReal factor)
+    {
+        AffineForm result = form;
+        for (PDFReal& coefficient : result)
+        {
+            coefficient *= factor;
+        }
+        return result;
+    };
+
+    for (const CompiledInstruction& instruction : m_compiledProgram.instructions)
+    {
+        // Results of the instructions are always initialized as non-constant
+        // values, which are overwritten by the instruction.
+        const AffineForm& a = forms[instruction.operand1];
+        const AffineForm& b = instruction.operand2 != INVALID_VALUE_SLOT ? forms[instruction.operand2] : AffineForm();
+        AffineForm result;
+
+        switch (instruction.code)
+        {
+            case Code::Add:
+            case Code::Sub:
+            {
+                if (!a.empty() && !b.empty())
+                {
+                    const PDFReal sign = instruction.code == Code::Add ? 1.0 : -1.0;
+                    result = a;
+                    for (size_t i = 0; i < formSize; ++i)
+                    {
+                        result[i] += sign * b[i];
+                    }
+                }
+                break;
+            }
+
+            case Code::Mul:
+            {
+                if (isConstant(b))
+                {
+                    result = scale(a, b.back());
+                }
+                else if (isConstant(a))
+                {
+                    result = scale(b, a.back());
+                }
+                break;
+            }
+
+            case Code::Div:
+            {
+                if (isConstant(b) && b.back() != 0.0)
+                {
+                    result = scale(a, 1.0 / b.back());
+                }
+                break;
+            }
+
+            case Code::Neg:
+                result = scale(a, -1.0);
+                break;
+
+            case Code::Cvr:
+                result = a;
+                break;
+
+            default:
+                break;
+        }
+
+        forms[instruction.result] = std::move(result);
+    }
+
+    // Outputs must be affine and they must not be clamped. Affine function
+    // attains its extremes in the corners of the domain.
+    for (uint32_t i = 0; i < m_n; ++i)
+    {
+        const AffineForm& form = forms[m_compiledProgram.outputs[i]];
+        if (form.empty())
+        {
+            return false;
+        }
+
+        PDFReal minimum = form.back();
+        PDFReal maximum = form.back();
+        for (uint32_t j = 0; j < m_m; ++j)
+        {
+            const PDFReal value1 = form[j] * m_domain[2 * j];
+            const PDFReal value2 = form[j] * m_domain[2 * j + 1];
+            minimum += qMin(value1, value2);
+            maximum += qMax(value1, value2);
+        }
+
+        if (minimum < m_range[2 * i] - PDF_EPSILON || maximum > m_range[2 * i + 1] + PDF_EPSILON)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+PDFFunction::FunctionResult PDFPostScriptFunction::evaluate(const_iterator x, iterator y, std::vector<OperandObject>& values) const
+{
     try
     {
         PDFPostScriptFunctionStack stack;
 
+        if (isCompiled())
+        {
+            for (uint32_t i = 0; i < m_m; ++i)
+            {
+                values[i] = OperandObject::createReal(clampInput(i, x[i]));
+            }
+
+            for (const CompiledInstruction& instruction : m_compiledProgram.instructions)
+            {
+                stack.push(values[instruction.operand1]);
+                if (instruction.operand2 != INVALID_VALUE_SLOT)
+                {
+                    stack.push(values[instruction.operand2]);
+                }
+
+                PDFPostScriptFunctionExecutor::executeOperator(instruction.code, stack);
+                values[instruction.result] = stack.popOperand();
+            }
+
+            for (uint32_t i = 0; i < m_n; ++i)
+            {
+                stack.push(values[m_compiledProgram.outputs[i]]);
+                y[i] = clampOutput(i, stack.popNumber());
+            }
+
+            return true;
+        }
+
         // Insert input values
-        for (uint32_t i = 0; i < m; ++i)
+        for (uint32_t i = 0; i < m_m; ++i)
         {
-            const PDFReal x = *std::next(x_1, i);
-            const PDFReal xClamped = clampInput(i, x);
+            const PDFReal xClamped = clampInput(i, x[i]);
             stack.pushReal(xClamped);
         }
 
         PDFPostScriptFunctionExecutor executor(m_program, stack);
         executor.execute();
 
-        uint32_t i = static_cast<uint32_t>(n);
-        auto it = std::make_reverse_iterator(y_n);
-        auto itEnd = std::make_reverse_iterator(y_1);
+        uint32_t i = m_n;
+        auto it = std::make_reverse_iterator(y + m_n);
+        auto itEnd = std::make_reverse_iterator(y);
         for (; it != itEnd; ++it)
         {
-            const PDFReal y = stack.popNumber();
-            const PDFReal yClamped = clampOutput(--i, y);
+            const PDFReal yValue = stack.popNumber();
+            const PDFReal yClamped = clampOutput(--i, yValue);
             *it = yClamped;
         }
 
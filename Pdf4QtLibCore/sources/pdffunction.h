@@ -86,11 +86,40 @@ public:
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const = 0;
 
+    /// Transforms batch of input values to the output values. Input array contains
+    /// \p count input vectors (each of them has m values), output array must have space
+    /// for \p count output vectors (each of them has n values). All items are evaluated,
+    /// even if evaluation of some of them fails, in that case, last error is returned.
+    /// \param x Input values
+    /// \param y Output values
+    /// \param count Number of input vectors
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const;
+
+    /// Returns true, if function is proven to be linear (affine) on the whole domain
+    /// and its outputs are never clamped to the range. Such function can be baked
+    /// into the lookup table without loss of precision.
+    virtual bool isLinear() const { return false; }
+
     /// Creates function from the object. If error occurs, exception is thrown.
     /// \param document Document, owning the pdf object
     /// \param object Object defining the function
     static PDFFunctionPtr createFunction(const PDFDocument* document, const PDFObject& object);
 
+    /// Creates baked function (lookup table function) from the function, if it is worth it,
+    /// i.e. function has at most two input variables, it is linear (see \p isLinear), and it
+    /// will be evaluated at least \p evaluationCount times. Otherwise original function
+    /// is returned. Baked function interpolates precomputed samples linearly, so it gives
+    /// the same results as the original function (up to the rounding errors).
+    /// \param function Function
+    /// \param evaluationCount Expected number of function evaluations
+    static PDFFunctionPtr createBakedFunction(const PDFFunctionPtr& function, size_t evaluationCount);
+
+    /// Returns true, if it is worth to bake the function, which will be evaluated
+    /// at least \p evaluationCount times (see \p createBakedFunction).
+    /// \param function Function
+    /// \param evaluationCount Expected number of function evaluations
+    static bool isBakingWorthIt(const PDFFunction* function, size_t evaluationCount);
+
 protected:
     static constexpr const size_t DEFAULT_OPERAND_COUNT = 32;
 
@@ -311,8 +340,56 @@ private:
     std::vector<PartialFunction> m_partialFunctions;
 };
 
+/// Lookup table function. Function contains samples of another function
+/// of one or two input variables, in regular grid over the function domain.
+/// Function is evaluated using linear (bilinear) interpolation of the samples.
+/// It is used to speed up evaluation of expensive functions, which are evaluated
+/// many times (for example, tint transforms of images).
+class PDF4QTLIBCORESHARED_EXPORT PDFLookupTableFunction : public PDFFunction
+{
+public:
+    /// Maximal number of input variables of the lookup table function
+    static constexpr const uint32_t MAXIMAL_INPUT_VARIABLE_COUNT = 2;
+
+    /// Construct new lookup table function.
+    /// \param m Number of input variables (must be 1 or 2)
+    /// \param n Number of output variables
+    /// \param domain Array of 2 x m variables of input range - [x1 min, x1 max, x2 min, x2 max, ... ]
+    /// \param size Number of samples for each variable (so array size is m), each at least 2
+    /// \param samples Array of samples (size is size[0] * size[1] * ... * size[m - 1] * n,
+    ///        first variable varies fastest)
+    explicit PDFLookupTableFunction(uint32_t m,
+                                    uint32_t n,
+                                    std::vector<PDFReal>&& domain,
+                                    std::vector<uint32_t>&& size,
+                                    std::vector<PDFReal>&& samples);
+    virtual ~PDFLookupTableFunction() = default;
+
+    /// Transforms input values to the output values.
+    /// \param x_1 Iterator to the first input value
+    /// \param x_n Iterator to the end of the input values (one item after last value)
+    /// \param y_1 Iterator to the first output value
+    /// \param y_n Iterator to the end of the output values (one item after last value)
+    virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const override;
+
+private:
+    /// Evaluates the function, input values must have size m, output values size n
+    void evaluate(const_iterator x, iterator y) const;
+
+    /// Number of samples for each input variable
+    std::vector<uint32_t> m_size;
+
+    /// Samples (sample values), already decoded
+    std::vector<PDFReal> m_samples;
+};
+
 /// Postscript function (Type 4 function)
-/// Implements subset of postscript language
+/// Implements subset of postscript language. If possible, program is compiled
+/// into the linear sequence of operators over value slots. Stack operators,
+/// blocks with constant conditions and operators with constant operands
+/// are resolved during compilation. If program can't be compiled (for example,
+/// it contains conditions depending on the input values), it is interpreted.
 class PDF4QTLIBCORESHARED_EXPORT PDFPostScriptFunction : public PDFFunction
 {
 public:
@@ -465,12 +542,56 @@ public:
     /// \param y_1 Iterator to the first output value
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const override;
+
+    /// Returns true, if program was compiled (so it is not interpreted)
+    bool isCompiled() const { return m_compiledProgram.isValid(); }
+
+    virtual bool isLinear() const override { return m_isLinear; }
+
+    using ValueSlot = uint32_t;
+
+    static constexpr const ValueSlot INVALID_VALUE_SLOT = std::numeric_limits<ValueSlot>::max();
+
+    /// Instruction of the compiled program. Operands are pushed to the stack,
+    /// operator is executed, and result is stored into the result slot.
+    struct CompiledInstruction
+    {
+        Code code = Code::Return;
+        ValueSlot operand1 = INVALID_VALUE_SLOT;
+        ValueSlot operand2 = INVALID_VALUE_SLOT;
+        ValueSlot result = INVALID_VALUE_SLOT;
+    };
+
+    /// Compiled program. First m value slots are input values, other value slots
+    /// contain either constants, or results of the instructions. Outputs are
+    /// value slots of the output values.
+    struct CompiledProgram
+    {
+        bool isValid() const { return !outputs.empty(); }
+
+        std::vector<OperandObject> values;
+        std::vector<CompiledInstruction> instructions;
+        std::vector<ValueSlot> outputs;
+    };
 
 private:
+    /// Evaluates the function for single input vector. Values are used
+    /// as temporary storage for the compiled program.
+    FunctionResult evaluate(const_iterator x, iterator y, std::vector<OperandObject>& values) const;
+
+    /// Returns true, if compiled program consists only of additions, subtractions,
+    /// negations and multiplications (divisions) by constants, and its outputs
+    /// are not clamped to the range on the whole domain.
+    bool isCompiledProgramLinear() const;
+
     Program m_program;
+    CompiledProgram m_compiledProgram;
+    bool m_isLinear = false;
 
     friend class PDFPostScriptFunctionStack;
     friend class PDFPostScriptFunctionExecutor;
+    friend class PDFPostScriptFunctionCompiler;
 };
 
 }   // namespace pdf
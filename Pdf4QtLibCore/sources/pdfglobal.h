@@ -190,6 +190,7 @@ enum class RendererEngine
     Blend2D_MultiThread,
     Blend2D_SingleThread,
     QPainter,
+    QRhi,       ///< GPU rendering using Qt's rendering hardware interface (images are rendered by QPainter)
 };
 
 enum class RenderingIntent
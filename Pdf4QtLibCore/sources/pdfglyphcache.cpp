@@ -0,0 +1,251 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfglyphcache.h"
+
+#include <QPainter>
+#include <QtMath>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+/// Quantization factor of the linear part of the glyph transformation
+static constexpr const PDFReal GLYPH_MATRIX_QUANTIZATION = 1024.0;
+
+PDFGlyphCache::PDFGlyphCache(qint64 memoryLimit) :
+    PDFMemoryBudgetClient("glyph-cache", 1, memoryLimit)
+{
+    registerMemoryBudgetClient();
+}
+
+PDFGlyphCache::~PDFGlyphCache()
+{
+    unregisterMemoryBudgetClient();
+}
+
+bool PDFGlyphCache::isBlittingSupported(QPainter* painter)
+{
+    QPaintDevice* device = painter->device();
+    if (!device)
+    {
+        return false;
+    }
+
+    switch (device->devType())
+    {
+        case QInternal::Widget:
+        case QInternal::Image:
+        case QInternal::Pixmap:
+            break;
+
+        default:
+            return false;
+    }
+
+    return !painter->viewTransformEnabled() || painter->window() == painter->viewport();
+}
+
+bool PDFGlyphCache::drawGlyph(QPainter* painter,
+                              const QTransform& glyphToDeviceMatrix,
+                              quint64 fontId,
+                              uint glyphId,
+                              const QPainterPath& glyphOutline,
+                              QColor color,
+                              bool antialiasing)
+{
+    if (getMemoryLimit() == 0 || glyphToDeviceMatrix.type() > QTransform::TxShear)
+    {
+        return false;
+    }
+
+    const QRectF deviceBoundingRect = glyphToDeviceMatrix.mapRect(glyphOutline.controlPointRect());
+    if (deviceBoundingRect.width() > MAXIMAL_GLYPH_SIZE || deviceBoundingRect.height() > MAXIMAL_GLYPH_SIZE)
+    {
+        return false;
+    }
+
+    // Split translation into integer pixel position and subpixel offset
+    const PDFReal dx = glyphToDeviceMatrix.dx();
+    const PDFReal dy = glyphToDeviceMatrix.dy();
+    const PDFReal pixelX = qFloor(dx);
+    const PDFReal pixelY = qFloor(dy);
+
+    const PDFReal maximalCoefficient = qMax(qMax(qAbs(glyphToDeviceMatrix.m11()), qAbs(glyphToDeviceMatrix.m12())),
+                                            qMax(qAbs(glyphToDeviceMatrix.m21()), qAbs(glyphToDeviceMatrix.m22())));
+    if (!qIsFinite(dx) || !qIsFinite(dy) || qAbs(dx) > 1e6 || qAbs(dy) > 1e6 || !(maximalCoefficient < 1e5))
+    {
+        return false;
+    }
+
+    Key key;
+    key.fontId = fontId;
+    key.glyphId = glyphId;
+    key.matrix = { qRound(glyphToDeviceMatrix.m11() * GLYPH_MATRIX_QUANTIZATION),
+                   qRound(glyphToDeviceMatrix.m12() * GLYPH_MATRIX_QUANTIZATION),
+                   qRound(glyphToDeviceMatrix.m21() * GLYPH_MATRIX_QUANTIZATION),
+                   qRound(glyphToDeviceMatrix.m22() * GLYPH_MATRIX_QUANTIZATION) };
+    key.subpixelX = quint8(qBound(0, int((dx - pixelX) * SUBPIXEL_POSITIONS), SUBPIXEL_POSITIONS - 1));
+    key.subpixelY = quint8(qBound(0, int((dy - pixelY) * SUBPIXEL_POSITIONS), SUBPIXEL_POSITIONS - 1));
+    key.antialiasing = antialiasing;
+    key.color = color.rgba();
+
+    QImage image;
+    QPoint offset;
+
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto it = m_itemMap.find(key);
+        if (it != m_itemMap.cend())
+        {
+            // Move item to the front, it is now most recently used
+            m_items.splice(m_items.begin(), m_items, it->second);
+            image = it->second->image;
+            offset = it->second->offset;
+        }
+    }
+
+    if (image.isNull())
+    {
+        // Rasterize the glyph outside of the lock, so other
+        // threads can use the cache in the meantime.
+        Item item = createItem(key, glyphOutline, color);
+        image = item.image;
+        offset = item.offset;
+
+        QMutexLocker lock(&m_mutex);
+        if (!m_itemMap.count(key))
+        {
+            m_memoryConsumption += item.image.sizeInBytes();
+            m_items.push_front(std::move(item));
+            m_itemMap[key] = m_items.begin();
+            shrink();
+
+            const qint64 memoryConsumption = m_memoryConsumption;
+            lock.unlock();
+
+            reportMemoryConsumption(memoryConsumption);
+        }
+    }
+
+    if (!image.isNull())
+    {
+        const QTransform worldTransform = painter->worldTransform();
+        painter->setWorldTransform(QTransform());
+        painter->drawImage(QPoint(int(pixelX), int(pixelY)) + offset, image);
+        painter->setWorldTransform(worldTransform);
+    }
+
+    return true;
+}
+
+void PDFGlyphCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_itemMap.clear();
+    m_items.clear();
+    m_memoryConsumption = 0;
+    lock.unlock();
+
+    setMemoryConsumption(0);
+}
+
+qint64 PDFGlyphCache::getMemoryConsumption() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryConsumption;
+}
+
+size_t PDFGlyphCache::KeyHash::operator()(const Key& key) const
+{
+    size_t seed = std::hash<quint64>()(key.fontId);
+    auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2); };
+
+    combine(key.glyphId);
+    for (qint32 value : key.matrix)
+    {
+        combine(std::hash<qint32>()(value));
+    }
+    combine(key.subpixelX);
+    combine(key.subpixelY);
+    combine(key.antialiasing);
+    combine(key.color);
+    return seed;
+}
+
+PDFGlyphCache::Item PDFGlyphCache::createItem(const Key& key, const QPainterPath& glyphOutline, QColor color)
+{
+    Item item;
+    item.key = key;
+
+    // We use quantized matrix, so all glyphs with the same key
+    // are rasterized exactly the same way.
+    const QTransform matrix(key.matrix[0] / GLYPH_MATRIX_QUANTIZATION,
+                            key.matrix[1] / GLYPH_MATRIX_QUANTIZATION,
+                            key.matrix[2] / GLYPH_MATRIX_QUANTIZATION,
+                            key.matrix[3] / GLYPH_MATRIX_QUANTIZATION,
+                            PDFReal(key.subpixelX) / SUBPIXEL_POSITIONS,
+                            PDFReal(key.subpixelY) / SUBPIXEL_POSITIONS);
+
+    const QRect pixelBoundingRect = matrix.mapRect(glyphOutline.controlPointRect()).toAlignedRect().adjusted(-1, -1, 1, 1);
+    if (pixelBoundingRect.isEmpty())
+    {
+        return item;
+    }
+
+    item.image = QImage(pixelBoundingRect.size(), QImage::Format_ARGB32_Premultiplied);
+    item.image.fill(Qt::transparent);
+    item.offset = pixelBoundingRect.topLeft();
+
+    QPainter painter(&item.image);
+    painter.setRenderHint(QPainter::Antialiasing, key.antialiasing);
+    painter.translate(-pixelBoundingRect.topLeft());
+    painter.setTransform(matrix, true);
+    painter.fillPath(glyphOutline, color);
+    painter.end();
+
+    return item;
+}
+
+void PDFGlyphCache::shrink()
+{
+    while (m_memoryConsumption > getMemoryLimit() && !m_items.empty())
+    {
+        const Item& item = m_items.back();
+        m_memoryConsumption -= item.image.sizeInBytes();
+        m_itemMap.erase(item.key);
+        m_items.pop_back();
+    }
+}
+
+void PDFGlyphCache::trimMemory()
+{
+    qint64 memoryConsumption = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        shrink();
+        memoryConsumption = m_memoryConsumption;
+    }
+
+    setMemoryConsumption(memoryConsumption);
+}
+
+}   // namespace pdf
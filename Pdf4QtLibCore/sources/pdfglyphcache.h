@@ -0,0 +1,142 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFGLYPHCACHE_H
+#define PDFGLYPHCACHE_H
+
+#include "pdfglobal.h"
+#include "pdfmemorybudget.h"
+
+#include <QMutex>
+#include <QImage>
+#include <QTransform>
+#include <QPainterPath>
+
+#include <list>
+#include <array>
+#include <atomic>
+#include <unordered_map>
+
+class QPainter;
+
+namespace pdf
+{
+
+/// Thread safe cache of rasterized glyphs. Small glyphs are rasterized into
+/// anti-aliased coverage images, which are then blitted onto the target
+/// painter, instead of filling the glyph outline again and again. Glyphs are
+/// identified by realized font, glyph (character) id, device transformation
+/// (which defines glyph size) and subpixel offset, together with glyph color.
+/// Memory consumption is limited, least recently used glyphs are removed first.
+/// Memory limit is assigned by the global memory budget, if the budget is set.
+class PDF4QTLIBCORESHARED_EXPORT PDFGlyphCache : public PDFMemoryBudgetClient
+{
+public:
+    /// Default memory limit of the cache (in bytes)
+    static constexpr const qint64 DEFAULT_MEMORY_LIMIT = 16 * 1024 * 1024;
+
+    /// Maximal size of the glyph in device pixels, for which glyph image
+    /// is cached. Larger glyphs are painted as vector paths.
+    static constexpr const PDFReal MAXIMAL_GLYPH_SIZE = 48.0;
+
+    /// Number of subpixel positions in each direction
+    static constexpr const int SUBPIXEL_POSITIONS = 4;
+
+    explicit PDFGlyphCache(qint64 memoryLimit = DEFAULT_MEMORY_LIMIT);
+    virtual ~PDFGlyphCache() override;
+
+    PDFGlyphCache(const PDFGlyphCache&) = delete;
+    PDFGlyphCache& operator=(const PDFGlyphCache&) = delete;
+
+    /// Returns true, if glyphs can be blitted onto the painter. Glyphs can be blitted
+    /// only onto raster devices with no view transformation. Vector devices (printers,
+    /// content stream builders) must receive vector paths.
+    /// \param painter Painter
+    static bool isBlittingSupported(QPainter* painter);
+
+    /// Paints the glyph onto the painter. If glyph can't be painted using the cache
+    /// (for example, it is too large), false is returned. Then caller must paint
+    /// the glyph outline as vector path. Function doesn't check, if blitting
+    /// is supported, use \p isBlittingSupported to check it.
+    /// \param painter Painter
+    /// \param glyphToDeviceMatrix Transformation from glyph space to device space
+    /// \param fontId Unique id of the realized font
+    /// \param glyphId Glyph id in the font
+    /// \param glyphOutline Glyph outline in glyph space
+    /// \param color Glyph fill color
+    /// \param antialiasing Use antialiasing
+    bool drawGlyph(QPainter* painter,
+                   const QTransform& glyphToDeviceMatrix,
+                   quint64 fontId,
+                   uint glyphId,
+                   const QPainterPath& glyphOutline,
+                   QColor color,
+                   bool antialiasing);
+
+    /// Removes all items from the cache
+    void clear();
+
+    /// Returns memory consumption of the cache (in bytes)
+    qint64 getMemoryConsumption() const;
+
+protected:
+    virtual void trimMemory() override;
+
+private:
+    struct Key
+    {
+        bool operator==(const Key&) const = default;
+
+        quint64 fontId = 0;
+        uint glyphId = 0;
+        std::array<qint32, 4> matrix = { };
+        quint8 subpixelX = 0;
+        quint8 subpixelY = 0;
+        bool antialiasing = false;
+        QRgb color = 0;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Item
+    {
+        Key key;
+        QImage image;
+        QPoint offset;
+    };
+
+    using Items = std::list<Item>;
+
+    /// Rasterizes the glyph image
+    static Item createItem(const Key& key, const QPainterPath& glyphOutline, QColor color);
+
+    /// Removes least recently used items, until memory limit is met
+    void shrink();
+
+    mutable QMutex m_mutex;
+    Items m_items;
+    std::unordered_map<Key, Items::iterator, KeyHash> m_itemMap;
+    qint64 m_memoryConsumption = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFGLYPHCACHE_H
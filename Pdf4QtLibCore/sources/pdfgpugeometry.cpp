@@ -0,0 +1,682 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfgpugeometry.h"
+#include "pdfpainter.h"
+#include "pdfpattern.h"
+
+#include <QtMath>
+#include <QPainterPathStroker>
+
+#include <algorithm>
+#include <limits>
+#include <stack>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFGpuPageGeometry PDFGpuPageGeometry::createGeometry(const PDFPrecompiledPage& page, const std::vector<bool>& optionalContentVisibility)
+{
+    PDFGpuPageGeometry geometry;
+
+    struct State
+    {
+        QTransform matrix;
+        ClipPaths clipPaths;
+    };
+
+    State state;
+    std::stack<State> stateStack;
+
+    for (const PDFPrecompiledPage::Instruction& instruction : page.m_instructions)
+    {
+        if (!optionalContentVisibility.empty() && !optionalContentVisibility[instruction.optionalContentCondition])
+        {
+            // Drawing instruction of hidden optional content
+            continue;
+        }
+
+        switch (instruction.type)
+        {
+            case PDFPrecompiledPage::InstructionType::DrawPath:
+            {
+                const PDFPrecompiledPage::PathPaintData& data = page.m_paths[instruction.dataIndex];
+                const QPen& pen = page.m_pens[data.penIndex];
+                const QBrush& brush = page.m_brushes[data.brushIndex];
+
+                if (brush.style() == Qt::TexturePattern)
+                {
+                    // Tiling pattern cell image, brush transform maps the image into the user space
+                    geometry.addTextureFill(state.matrix.map(data.path), brush.textureImage(), brush.transform() * state.matrix);
+                }
+                else if (const QGradient* gradient = brush.gradient())
+                {
+                    // Shading painted using native gradient, brush transform maps gradient into the user space
+                    geometry.addGradientFill(state.matrix.map(data.path), *gradient, brush.transform() * state.matrix);
+                }
+                else if (brush.style() != Qt::NoBrush)
+                {
+                    geometry.addFill(state.matrix.map(data.path), brush.color());
+                }
+
+                if (!data.strokeOutline.isEmpty())
+                {
+                    geometry.addFill(state.matrix.map(data.strokeOutline), pen.color());
+                }
+                else if (pen.style() != Qt::NoPen)
+                {
+                    QPainterPathStroker stroker(pen);
+
+                    if (pen.isCosmetic())
+                    {
+                        // Cosmetic pens have width in device space, which is not known
+                        // when page is being tessellated. So we use fixed width in page space.
+                        const PDFReal scale = qSqrt(qAbs(state.matrix.determinant()));
+                        const PDFReal width = pen.widthF() > 0.0 ? pen.widthF() : 1.0;
+                        if (!qFuzzyIsNull(scale))
+                        {
+                            stroker.setWidth(width * COSMETIC_PEN_WIDTH / scale);
+                        }
+                    }
+
+                    QPainterPath strokePath = stroker.createStroke(data.path);
+                    strokePath.setFillRule(Qt::WindingFill);
+                    geometry.addFill(state.matrix.map(strokePath), pen.color());
+                }
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::DrawGlyphRun:
+            {
+                const PDFPrecompiledPage::GlyphRunData& data = page.m_glyphRuns[instruction.dataIndex];
+                for (size_t glyphIndex = 0; glyphIndex < data.outlines.size(); ++glyphIndex)
+                {
+                    geometry.addFill(state.matrix.map(data.getGlyphPath(glyphIndex)), data.brush.color());
+                }
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::DrawImage:
+            {
+                const QImage& image = page.m_images[instruction.dataIndex].image;
+                if (image.isNull())
+                {
+                    break;
+                }
+
+                Command command;
+                command.type = CommandType::Image;
+                command.firstVertex = static_cast<quint32>(geometry.m_vertices.size());
+                command.imageIndex = static_cast<quint32>(geometry.m_images.size());
+                geometry.m_images.push_back(image);
+
+                // Image is painted into the unit square in user space. Because Qt uses opposite
+                // axis direction than PDF, then first image row is mapped to the y = 1.
+                const std::array<quint8, 4> white = { 255, 255, 255, 255 };
+                const QPointF p00 = state.matrix.map(QPointF(0.0, 0.0));
+                const QPointF p10 = state.matrix.map(QPointF(1.0, 0.0));
+                const QPointF p11 = state.matrix.map(QPointF(1.0, 1.0));
+                const QPointF p01 = state.matrix.map(QPointF(0.0, 1.0));
+
+                geometry.addVertex(p00, white, QPointF(0.0, 1.0));
+                geometry.addVertex(p10, white, QPointF(1.0, 1.0));
+                geometry.addVertex(p11, white, QPointF(1.0, 0.0));
+                geometry.addVertex(p00, white, QPointF(0.0, 1.0));
+                geometry.addVertex(p11, white, QPointF(1.0, 0.0));
+                geometry.addVertex(p01, white, QPointF(0.0, 0.0));
+
+                command.vertexCount = static_cast<quint32>(geometry.m_vertices.size()) - command.firstVertex;
+                geometry.m_commands.push_back(command);
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::DrawMesh:
+            {
+                // Mesh is in page space, it doesn't use world matrix
+                const PDFPrecompiledPage::MeshPaintData& data = page.m_meshes[instruction.dataIndex];
+                const PDFMesh& mesh = data.mesh;
+
+                if (mesh.getTriangles().empty())
+                {
+                    break;
+                }
+
+                const bool isClipped = !mesh.getBoundingPath().isEmpty();
+                if (isClipped)
+                {
+                    ClipPaths clipPaths = state.clipPaths;
+                    geometry.addClip(mesh.getBoundingPath(), clipPaths);
+                }
+
+                if (!mesh.getBackgroundPath().isEmpty() && mesh.getBackgroundColor().isValid())
+                {
+                    QColor backgroundColor = mesh.getBackgroundColor();
+                    backgroundColor.setAlphaF(data.alpha);
+                    geometry.addFill(mesh.getBackgroundPath(), backgroundColor);
+                }
+
+                Command command;
+                command.type = CommandType::Triangles;
+                command.firstVertex = static_cast<quint32>(geometry.m_vertices.size());
+
+                const std::vector<QPointF>& vertices = mesh.getVertices();
+                const std::vector<PDFMesh::Triangle>& triangles = mesh.getTriangles();
+                for (size_t i = 0; i < triangles.size(); ++i)
+                {
+                    // Vertex colors are interpolated by the GPU (Gouraud shading)
+                    const PDFMesh::Triangle& triangle = triangles[i];
+                    const std::array<QRgb, 3> vertexColors = mesh.getTriangleVertexColors(i);
+                    geometry.addVertex(vertices[triangle.v1], getPremultipliedColor(QColor(vertexColors[0]), data.alpha));
+                    geometry.addVertex(vertices[triangle.v2], getPremultipliedColor(QColor(vertexColors[1]), data.alpha));
+                    geometry.addVertex(vertices[triangle.v3], getPremultipliedColor(QColor(vertexColors[2]), data.alpha));
+                }
+
+                command.vertexCount = static_cast<quint32>(geometry.m_vertices.size()) - command.firstVertex;
+                geometry.m_commands.push_back(command);
+
+                if (isClipped)
+                {
+                    geometry.addClipReset(state.clipPaths);
+                }
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::Clip:
+            {
+                geometry.addClip(state.matrix.map(page.m_clips[instruction.dataIndex].clipPath), state.clipPaths);
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::SaveGraphicState:
+            {
+                stateStack.push(state);
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::RestoreGraphicState:
+            {
+                if (stateStack.empty())
+                {
+                    break;
+                }
+
+                State restoredState = qMove(stateStack.top());
+                stateStack.pop();
+
+                // Clip paths can be only added in the graphic state, so if count
+                // of the clip paths is the same, then clip mask is also the same.
+                if (restoredState.clipPaths.size() != state.clipPaths.size())
+                {
+                    geometry.addClipReset(restoredState.clipPaths);
+                }
+
+                state = qMove(restoredState);
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::SetWorldMatrix:
+            {
+                state.matrix = page.m_matrices[instruction.dataIndex];
+                break;
+            }
+
+            case PDFPrecompiledPage::InstructionType::SetCompositionMode:
+            {
+                // Composition modes are not supported, pages, which use them,
+                // are painted by QPainter, see isPageSupported.
+                break;
+            }
+
+            default:
+            {
+                Q_ASSERT(false);
+                break;
+            }
+        }
+    }
+
+    geometry.m_vertices.shrink_to_fit();
+    geometry.m_commands.shrink_to_fit();
+    return geometry;
+}
+
+bool PDFGpuPageGeometry::isPageSupported(const PDFPrecompiledPage& page)
+{
+    return std::all_of(page.m_compositionModes.cbegin(), page.m_compositionModes.cend(), [](QPainter::CompositionMode mode) { return mode == QPainter::CompositionMode_SourceOver; });
+}
+
+qint64 PDFGpuPageGeometry::getMemoryConsumptionEstimate() const
+{
+    qint64 memoryConsumption = sizeof(*this);
+    memoryConsumption += m_vertices.capacity() * sizeof(Vertex);
+    memoryConsumption += m_commands.capacity() * sizeof(Command);
+
+    for (const QImage& image : m_images)
+    {
+        memoryConsumption += image.sizeInBytes();
+    }
+
+    return memoryConsumption;
+}
+
+PDFGpuPageGeometry::Command PDFGpuPageGeometry::addStencil(const QPainterPath& path)
+{
+    Command command;
+    command.type = CommandType::Stencil;
+    command.fillRule = path.fillRule();
+    command.firstVertex = static_cast<quint32>(m_vertices.size());
+
+    // Flatten curves in finer scale, so they remain smooth, when zoomed
+    const QTransform scaleMatrix = QTransform::fromScale(CURVE_FLATTENING_SCALE, CURVE_FLATTENING_SCALE);
+    const QTransform inverseScaleMatrix = QTransform::fromScale(1.0 / CURVE_FLATTENING_SCALE, 1.0 / CURVE_FLATTENING_SCALE);
+    const std::array<quint8, 4> color = { };
+
+    for (const QPolygonF& polygon : path.toSubpathPolygons(scaleMatrix))
+    {
+        if (polygon.size() < 3)
+        {
+            continue;
+        }
+
+        // Triangle fan from the first vertex. Winding number of the fan
+        // triangles gives the winding number of the polygon.
+        const QPointF origin = inverseScaleMatrix.map(polygon.front());
+        for (qsizetype i = 1; i + 1 < polygon.size(); ++i)
+        {
+            addVertex(origin, color);
+            addVertex(inverseScaleMatrix.map(polygon[i]), color);
+            addVertex(inverseScaleMatrix.map(polygon[i + 1]), color);
+        }
+    }
+
+    command.vertexCount = static_cast<quint32>(m_vertices.size()) - command.firstVertex;
+    return command;
+}
+
+void PDFGpuPageGeometry::addFill(const QPainterPath& path, const QColor& color)
+{
+    if (path.isEmpty() || !color.isValid() || color.alpha() == 0)
+    {
+        return;
+    }
+
+    Command stencilCommand = addStencil(path);
+    if (stencilCommand.vertexCount == 0)
+    {
+        return;
+    }
+
+    Command coverCommand;
+    coverCommand.type = CommandType::Cover;
+    coverCommand.fillRule = stencilCommand.fillRule;
+    coverCommand.firstVertex = static_cast<quint32>(m_vertices.size());
+
+    const QRectF bounds = path.controlPointRect();
+    const std::array<quint8, 4> coverColor = getPremultipliedColor(color, 1.0);
+    addVertex(bounds.topLeft(), coverColor);
+    addVertex(bounds.topRight(), coverColor);
+    addVertex(bounds.bottomRight(), coverColor);
+    addVertex(bounds.topLeft(), coverColor);
+    addVertex(bounds.bottomRight(), coverColor);
+    addVertex(bounds.bottomLeft(), coverColor);
+
+    coverCommand.vertexCount = static_cast<quint32>(m_vertices.size()) - coverCommand.firstVertex;
+
+    m_commands.push_back(stencilCommand);
+    m_commands.push_back(coverCommand);
+}
+
+void PDFGpuPageGeometry::addGradientFill(const QPainterPath& path, const QGradient& gradient, const QTransform& gradientMatrix)
+{
+    const QGradientStops& stops = gradient.stops();
+    if (path.isEmpty() || stops.isEmpty() || !gradientMatrix.isInvertible())
+    {
+        return;
+    }
+
+    Command stencilCommand = addStencil(path);
+    if (stencilCommand.vertexCount == 0)
+    {
+        return;
+    }
+
+    Command coverCommand;
+    coverCommand.type = CommandType::Cover;
+    coverCommand.fillRule = stencilCommand.fillRule;
+    coverCommand.firstVertex = static_cast<quint32>(m_vertices.size());
+
+    // Cover triangles must cover the whole bounding box of the path, otherwise
+    // winding number will not be reset. Gradients are always padded.
+    const QRectF bounds = path.controlPointRect();
+    const QPolygonF gradientBounds = gradientMatrix.inverted().map(QPolygonF(bounds));
+
+    switch (gradient.type())
+    {
+        case QGradient::LinearGradient:
+            addLinearGradientCover(static_cast<const QLinearGradient&>(gradient), gradientBounds, gradientMatrix);
+            break;
+
+        case QGradient::RadialGradient:
+            addRadialGradientCover(static_cast<const QRadialGradient&>(gradient), gradientBounds, gradientMatrix);
+            break;
+
+        default:
+            break;
+    }
+
+    if (m_vertices.size() == coverCommand.firstVertex)
+    {
+        // Gradient is degenerate, use its middle color
+        const std::array<quint8, 4> coverColor = getGradientColor(stops, 0.5);
+        addVertex(bounds.topLeft(), coverColor);
+        addVertex(bounds.topRight(), coverColor);
+        addVertex(bounds.bottomRight(), coverColor);
+        addVertex(bounds.topLeft(), coverColor);
+        addVertex(bounds.bottomRight(), coverColor);
+        addVertex(bounds.bottomLeft(), coverColor);
+    }
+
+    coverCommand.vertexCount = static_cast<quint32>(m_vertices.size()) - coverCommand.firstVertex;
+
+    m_commands.push_back(stencilCommand);
+    m_commands.push_back(coverCommand);
+}
+
+void PDFGpuPageGeometry::addLinearGradientCover(const QLinearGradient& gradient, const QPolygonF& bounds, const QTransform& gradientMatrix)
+{
+    const QPointF start = gradient.start();
+    const QPointF axis = gradient.finalStop() - start;
+    const QPointF normal(-axis.y(), axis.x());
+    const PDFReal axisLengthSquared = QPointF::dotProduct(axis, axis);
+
+    if (qFuzzyIsNull(axisLengthSquared))
+    {
+        return;
+    }
+
+    // Parameter ranges of the bounds along the axis and along the normal
+    PDFReal tMin = std::numeric_limits<PDFReal>::infinity();
+    PDFReal tMax = -std::numeric_limits<PDFReal>::infinity();
+    PDFReal sMin = std::numeric_limits<PDFReal>::infinity();
+    PDFReal sMax = -std::numeric_limits<PDFReal>::infinity();
+
+    for (const QPointF& point : bounds)
+    {
+        const QPointF offset = point - start;
+        const PDFReal t = QPointF::dotProduct(offset, axis) / axisLengthSquared;
+        const PDFReal s = QPointF::dotProduct(offset, normal) / axisLengthSquared;
+        tMin = qMin(tMin, t);
+        tMax = qMax(tMax, t);
+        sMin = qMin(sMin, s);
+        sMax = qMax(sMax, s);
+    }
+
+    // Strips perpendicular to the axis are split at the stops. Colors are
+    // interpolated linearly between stops, so the gradient is exact.
+    const QGradientStops& stops = gradient.stops();
+    std::vector<PDFReal> parameters;
+    parameters.reserve(stops.size() + 2);
+    parameters.push_back(tMin);
+    for (const QGradientStop& stop : stops)
+    {
+        if (stop.first > parameters.back() && stop.first < tMax)
+        {
+            parameters.push_back(stop.first);
+        }
+    }
+    parameters.push_back(tMax);
+
+    auto getPoint = [&](PDFReal t, PDFReal s)
+    {
+        return gradientMatrix.map(start + axis * t + normal * s);
+    };
+
+    for (size_t i = 0; i + 1 < parameters.size(); ++i)
+    {
+        const PDFReal t1 = parameters[i];
+        const PDFReal t2 = parameters[i + 1];
+        const std::array<quint8, 4> color1 = getGradientColor(stops, t1);
+        const std::array<quint8, 4> color2 = getGradientColor(stops, t2);
+
+        addVertex(getPoint(t1, sMin), color1);
+        addVertex(getPoint(t2, sMin), color2);
+        addVertex(getPoint(t2, sMax), color2);
+        addVertex(getPoint(t1, sMin), color1);
+        addVertex(getPoint(t2, sMax), color2);
+        addVertex(getPoint(t1, sMax), color1);
+    }
+}
+
+void PDFGpuPageGeometry::addRadialGradientCover(const QRadialGradient& gradient, const QPolygonF& bounds, const QTransform& gradientMatrix)
+{
+    // Circle of parameter t has center focal + t * (center - focal) and radius
+    // t * radius. Circles are nested, because focal point is inside the circle.
+    // Circles are approximated by polygons with fixed count of segments.
+    constexpr int SEGMENT_COUNT = 64;
+
+    const QPointF focal = gradient.focalPoint();
+    const QPointF axis = gradient.center() - focal;
+    const PDFReal radius = gradient.radius();
+    const PDFReal axisLength = qSqrt(QPointF::dotProduct(axis, axis));
+
+    if (!qFuzzyIsNull(gradient.focalRadius()) || radius <= 0.0 || axisLength >= radius)
+    {
+        return;
+    }
+
+    // Last circle must contain the bounds. Distance of bounds point p from the center
+    // of circle t is at most |p - focal| + t * |axis|, so it suffices, if it is lesser
+    // than t * radius. Last polygon is circumscribed to the circle.
+    PDFReal maximalDistance = 0.0;
+    for (const QPointF& point : bounds)
+    {
+        maximalDistance = qMax(maximalDistance, QLineF(focal, point).length());
+    }
+    const PDFReal tMax = qMax(maximalDistance / (radius - axisLength), 1.0);
+    const PDFReal circumscribedScale = 1.0 / qCos(M_PI / SEGMENT_COUNT);
+
+    std::array<QPointF, SEGMENT_COUNT + 1> directions;
+    for (int i = 0; i <= SEGMENT_COUNT; ++i)
+    {
+        const PDFReal angle = 2.0 * M_PI * i / SEGMENT_COUNT;
+        directions[i] = QPointF(qCos(angle), qSin(angle));
+    }
+
+    const QGradientStops& stops = gradient.stops();
+    std::vector<PDFReal> parameters;
+    parameters.reserve(stops.size() + 3);
+    parameters.push_back(0.0);
+    for (const QGradientStop& stop : stops)
+    {
+        if (stop.first > parameters.back() && stop.first < 1.0)
+        {
+            parameters.push_back(stop.first);
+        }
+    }
+    parameters.push_back(1.0);
+    parameters.push_back(tMax);
+
+    auto getPoint = [&](size_t parameterIndex, int segment)
+    {
+        const PDFReal t = parameters[parameterIndex];
+        const PDFReal scale = parameterIndex + 1 == parameters.size() ? circumscribedScale : 1.0;
+        return gradientMatrix.map(focal + axis * t + directions[segment] * (t * radius * scale));
+    };
+
+    for (size_t i = 0; i + 1 < parameters.size(); ++i)
+    {
+        const std::array<quint8, 4> color1 = getGradientColor(stops, parameters[i]);
+        const std::array<quint8, 4> color2 = getGradientColor(stops, parameters[i + 1]);
+
+        for (int segment = 0; segment < SEGMENT_COUNT; ++segment)
+        {
+            // First ring is a triangle fan around the focal point
+            if (i > 0)
+            {
+                addVertex(getPoint(i, segment), color1);
+                addVertex(getPoint(i, segment + 1), color1);
+                addVertex(getPoint(i + 1, segment + 1), color2);
+            }
+
+            addVertex(getPoint(i, segment), color1);
+            addVertex(getPoint(i + 1, segment + 1), color2);
+            addVertex(getPoint(i + 1, segment), color2);
+        }
+    }
+}
+
+void PDFGpuPageGeometry::addTextureFill(const QPainterPath& path, const QImage& image, const QTransform& imageMatrix)
+{
+    if (path.isEmpty() || image.isNull() || !imageMatrix.isInvertible())
+    {
+        return;
+    }
+
+    Command stencilCommand = addStencil(path);
+    if (stencilCommand.vertexCount == 0)
+    {
+        return;
+    }
+
+    Command coverCommand;
+    coverCommand.type = CommandType::TextureCover;
+    coverCommand.fillRule = stencilCommand.fillRule;
+    coverCommand.firstVertex = static_cast<quint32>(m_vertices.size());
+    coverCommand.imageIndex = static_cast<quint32>(m_images.size());
+    m_images.push_back(image);
+
+    // Texture coordinates are in image sizes, texture is repeated outside the unit square
+    QTransform textureMatrix = imageMatrix.inverted();
+    textureMatrix *= QTransform::fromScale(1.0 / image.width(), 1.0 / image.height());
+
+    const QRectF bounds = path.controlPointRect();
+    const std::array<quint8, 4> white = { 255, 255, 255, 255 };
+    addVertex(bounds.topLeft(), white, textureMatrix.map(bounds.topLeft()));
+    addVertex(bounds.topRight(), white, textureMatrix.map(bounds.topRight()));
+    addVertex(bounds.bottomRight(), white, textureMatrix.map(bounds.bottomRight()));
+    addVertex(bounds.topLeft(), white, textureMatrix.map(bounds.topLeft()));
+    addVertex(bounds.bottomRight(), white, textureMatrix.map(bounds.bottomRight()));
+    addVertex(bounds.bottomLeft(), white, textureMatrix.map(bounds.bottomLeft()));
+
+    coverCommand.vertexCount = static_cast<quint32>(m_vertices.size()) - coverCommand.firstVertex;
+
+    m_commands.push_back(stencilCommand);
+    m_commands.push_back(coverCommand);
+}
+
+void PDFGpuPageGeometry::addClip(const QPainterPath& path, ClipPaths& clipPaths)
+{
+    // Empty clip path is also valid, it clips everything
+    Command stencilCommand = addStencil(path);
+
+    ClipPath clipPath;
+    clipPath.fillRule = stencilCommand.fillRule;
+    clipPath.firstVertex = stencilCommand.firstVertex;
+    clipPath.vertexCount = stencilCommand.vertexCount;
+    clipPaths.push_back(clipPath);
+
+    Command intersectCommand;
+    intersectCommand.type = CommandType::ClipIntersect;
+    intersectCommand.fillRule = stencilCommand.fillRule;
+
+    m_commands.push_back(stencilCommand);
+    m_commands.push_back(intersectCommand);
+}
+
+void PDFGpuPageGeometry::addClipReset(const ClipPaths& clipPaths)
+{
+    Command resetCommand;
+    resetCommand.type = CommandType::ClipReset;
+    m_commands.push_back(resetCommand);
+
+    // Intersect clip paths again, they are already tessellated
+    for (const ClipPath& clipPath : clipPaths)
+    {
+        Command stencilCommand;
+        stencilCommand.type = CommandType::Stencil;
+        stencilCommand.fillRule = clipPath.fillRule;
+        stencilCommand.firstVertex = clipPath.firstVertex;
+        stencilCommand.vertexCount = clipPath.vertexCount;
+
+        Command intersectCommand;
+        intersectCommand.type = CommandType::ClipIntersect;
+        intersectCommand.fillRule = clipPath.fillRule;
+
+        m_commands.push_back(stencilCommand);
+        m_commands.push_back(intersectCommand);
+    }
+}
+
+void PDFGpuPageGeometry::addVertex(const QPointF& point, const std::array<quint8, 4>& color, const QPointF& texCoord)
+{
+    Vertex vertex;
+    vertex.x = static_cast<float>(point.x());
+    vertex.y = static_cast<float>(point.y());
+    vertex.u = static_cast<float>(texCoord.x());
+    vertex.v = static_cast<float>(texCoord.y());
+    vertex.color = color;
+    m_vertices.push_back(vertex);
+}
+
+std::array<quint8, 4> PDFGpuPageGeometry::getPremultipliedColor(const QColor& color, PDFReal alpha)
+{
+    const PDFReal a = qBound(0.0, color.alphaF() * alpha, 1.0);
+
+    auto toByte = [](PDFReal value)
+    {
+        return static_cast<quint8>(qBound(0, qRound(value * 255.0), 255));
+    };
+
+    return { toByte(color.redF() * a), toByte(color.greenF() * a), toByte(color.blueF() * a), toByte(a) };
+}
+
+std::array<quint8, 4> PDFGpuPageGeometry::getGradientColor(const QGradientStops& stops, PDFReal t)
+{
+    Q_ASSERT(!stops.isEmpty());
+
+    if (t <= stops.front().first)
+    {
+        return getPremultipliedColor(stops.front().second, 1.0);
+    }
+
+    if (t >= stops.back().first)
+    {
+        return getPremultipliedColor(stops.back().second, 1.0);
+    }
+
+    auto it = std::upper_bound(stops.cbegin(), stops.cend(), t, [](PDFReal value, const QGradientStop& stop) { return value < stop.first; });
+    const QGradientStop& stop1 = *std::prev(it);
+    const QGradientStop& stop2 = *it;
+
+    const PDFReal length = stop2.first - stop1.first;
+    const PDFReal ratio = length > 0.0 ? (t - stop1.first) / length : 0.0;
+    const std::array<quint8, 4> color1 = getPremultipliedColor(stop1.second, 1.0);
+    const std::array<quint8, 4> color2 = getPremultipliedColor(stop2.second, 1.0);
+
+    std::array<quint8, 4> color = { };
+    for (size_t i = 0; i < color.size(); ++i)
+    {
+        color[i] = static_cast<quint8>(qBound(0, qRound(color1[i] + (color2[i] - color1[i]) * ratio), 255));
+    }
+
+    return color;
+}
+
+}   // namespace pdf
@@ -0,0 +1,189 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFGPUGEOMETRY_H
+#define PDFGPUGEOMETRY_H
+
+#include "pdfglobal.h"
+
+#include <QBrush>
+#include <QImage>
+#include <QPainterPath>
+
+#include <array>
+#include <vector>
+
+namespace pdf
+{
+class PDFPrecompiledPage;
+
+/// Geometry of the precompiled page prepared for rendering on the GPU. Page is
+/// tessellated only once, in page space, so it can be drawn with arbitrary zoom
+/// and offset just by changing page to device transformation matrix.
+///
+/// Paths are not triangulated. They are decomposed into triangle fans, which
+/// are rendered into the stencil buffer using "stencil, then cover" technique.
+/// Stencil buffer has following layout: bit 7 is a clip mask (pixels, which
+/// can be painted), bits 0-6 are used for evaluation of the winding number
+/// (or parity for even-odd fill rule) of the path. Stencil command accumulates
+/// winding number of the path, cover command paints a quad covering the path
+/// with the color, where winding number is nonzero, and resets the winding bits
+/// back to zero. Clipping is intersected in the same way, clip intersect command
+/// clears clip mask, where winding number is zero. Clip mask can't be restored,
+/// so when graphic state is restored, clip mask is reset to the whole page and
+/// all clip paths of the restored state are intersected again.
+///
+/// Composition modes other than source over are not supported, pages, which
+/// use them, must be painted by QPainter (see isPageSupported).
+class PDF4QTLIBCORESHARED_EXPORT PDFGpuPageGeometry
+{
+public:
+    explicit inline PDFGpuPageGeometry() = default;
+
+    /// Vertex of the geometry. Position is in page space, color
+    /// is a premultiplied RGBA color.
+    struct Vertex
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float u = 0.0f;
+        float v = 0.0f;
+        std::array<quint8, 4> color = { };
+    };
+
+    enum class CommandType
+    {
+        Stencil,        ///< Accumulates winding number of triangle fans in the stencil buffer
+        Cover,          ///< Paints triangles with color, where winding number is nonzero, and resets winding number
+        TextureCover,   ///< Paints triangles with repeated image, where winding number is nonzero, and resets winding number
+        ClipIntersect,  ///< Clears clip mask on the whole page, where winding number is zero, and resets winding number
+        ClipReset,      ///< Resets clip mask to the whole page (renderer provides page geometry)
+        Triangles,      ///< Paints triangles with per-vertex color inside clip mask
+        Image           ///< Paints textured triangles (image quad) inside clip mask
+    };
+
+    struct Command
+    {
+        CommandType type = CommandType::Triangles;
+        Qt::FillRule fillRule = Qt::WindingFill;
+        quint32 firstVertex = 0;
+        quint32 vertexCount = 0;
+        quint32 imageIndex = 0;
+    };
+
+    /// Creates geometry of the precompiled page
+    /// \param page Precompiled page
+    /// \param optionalContentVisibility Visibility of optional content of the page (empty, if all content is visible)
+    /// \sa PDFPrecompiledPage::getOptionalContentVisibility
+    static PDFGpuPageGeometry createGeometry(const PDFPrecompiledPage& page, const std::vector<bool>& optionalContentVisibility = std::vector<bool>());
+
+    /// Returns true, if precompiled page can be painted using the geometry. Pages
+    /// with composition modes other than source over (blend modes) are not supported.
+    /// \param page Precompiled page
+    static bool isPageSupported(const PDFPrecompiledPage& page);
+
+    const std::vector<Vertex>& getVertices() const { return m_vertices; }
+    const std::vector<Command>& getCommands() const { return m_commands; }
+    const std::vector<QImage>& getImages() const { return m_images; }
+
+    /// Returns true, if geometry doesn't contain any command
+    bool isEmpty() const { return m_commands.empty(); }
+
+    /// Returns estimate of number of bytes, which this geometry occupies in memory
+    qint64 getMemoryConsumptionEstimate() const;
+
+    /// Curves are flattened as they were scaled by this factor, so they
+    /// remain smooth, even when page is zoomed.
+    static constexpr PDFReal CURVE_FLATTENING_SCALE = 8.0;
+
+    /// Width of cosmetic pens in page space
+    static constexpr PDFReal COSMETIC_PEN_WIDTH = 0.5;
+
+private:
+    struct ClipPath
+    {
+        Qt::FillRule fillRule = Qt::WindingFill;
+        quint32 firstVertex = 0;
+        quint32 vertexCount = 0;
+    };
+
+    using ClipPaths = std::vector<ClipPath>;
+
+    /// Adds triangle fans of the path (in page space) using current
+    /// vertex color. Returns command, which renders fans into stencil
+    /// buffer. Winding number of the empty path is always zero.
+    /// \param path Path in page space
+    Command addStencil(const QPainterPath& path);
+
+    /// Fills the path with color
+    /// \param path Path in page space
+    /// \param color Fill color
+    void addFill(const QPainterPath& path, const QColor& color);
+
+    /// Fills the path with the image, which is repeated in both directions
+    /// (tiling pattern cell image)
+    /// \param path Path in page space
+    /// \param image Image
+    /// \param imageMatrix Matrix, which maps image pixels to the page space
+    void addTextureFill(const QPainterPath& path, const QImage& image, const QTransform& imageMatrix);
+
+    /// Fills the path with linear or radial gradient (with pad spread). Cover
+    /// triangles have per-vertex colors of the gradient, which are interpolated
+    /// by the GPU. Linear gradient is exact, circles of radial gradient are
+    /// approximated by polygons.
+    /// \param path Path in page space
+    /// \param gradient Gradient
+    /// \param gradientMatrix Matrix, which maps gradient space to the page space
+    void addGradientFill(const QPainterPath& path, const QGradient& gradient, const QTransform& gradientMatrix);
+
+    /// Adds cover triangles of the linear gradient
+    /// \param gradient Gradient
+    /// \param bounds Polygon in gradient space, which must be covered
+    /// \param gradientMatrix Matrix, which maps gradient space to the page space
+    void addLinearGradientCover(const QLinearGradient& gradient, const QPolygonF& bounds, const QTransform& gradientMatrix);
+
+    /// Adds cover triangles of the radial gradient, focal point must be inside the circle
+    /// \param gradient Gradient
+    /// \param bounds Polygon in gradient space, which must be covered
+    /// \param gradientMatrix Matrix, which maps gradient space to the page space
+    void addRadialGradientCover(const QRadialGradient& gradient, const QPolygonF& bounds, const QTransform& gradientMatrix);
+
+    /// Intersects the clip mask with clip path
+    /// \param path Path in page space
+    /// \param clipPaths Clip paths of current graphic state
+    void addClip(const QPainterPath& path, ClipPaths& clipPaths);
+
+    /// Resets the clip mask and intersects it with clip paths
+    /// \param clipPaths Clip paths, which forms the clip mask
+    void addClipReset(const ClipPaths& clipPaths);
+
+    void addVertex(const QPointF& point, const std::array<quint8, 4>& color, const QPointF& texCoord = QPointF());
+
+    static std::array<quint8, 4> getPremultipliedColor(const QColor& color, PDFReal alpha);
+
+    /// Returns premultiplied color of the gradient at given parameter (gradient is padded)
+    static std::array<quint8, 4> getGradientColor(const QGradientStops& stops, PDFReal t);
+
+    std::vector<Vertex> m_vertices;
+    std::vector<Command> m_commands;
+    std::vector<QImage> m_images;
+};
+
+}   // namespace pdf
+
+#endif // PDFGPUGEOMETRY_H
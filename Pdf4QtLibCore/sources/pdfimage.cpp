@@ -22,6 +22,9 @@
 #include "pdfutils.h"
 #include "pdfjbig2decoder.h"
 #include "pdfccittfaxdecoder.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QScopeGuard>
 
 #include <openjpeg.h>
 #include <jpeglib.h>
@@ -54,7 +57,9 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
                                PDFColorSpacePointer colorSpace,
                                bool isSoftMask,
                                RenderingIntent renderingIntent,
-                               PDFRenderErrorReporter* errorReporter)
+                               PDFRenderErrorReporter* errorReporter,
+                               QSize targetSize,
+                               bool isSoftMaskIgnored)
 {
     PDFImage image;
     image.m_colorSpace = colorSpace;
@@ -154,14 +159,14 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
             image.m_softMask.setDecode(qMove(adjustedDecode));
         }
     }
-    else if (dictionary->hasKey("SMask"))
+    else if (dictionary->hasKey("SMask") && !isSoftMaskIgnored)
     {
         // Parse soft mask image
         const PDFObject& softMaskObject = document->getObject(dictionary->get("SMask"));
 
         if (softMaskObject.isStream())
         {
-            PDFImage softMaskImage = createImage(document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, renderingIntent, errorReporter);
+            PDFImage softMaskImage = createImage(document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, renderingIntent, errorReporter, targetSize);
             maskingType = PDFImageData::MaskingType::SoftMask;
             image.m_softMask = qMove(softMaskImage.m_imageData);
         }
@@ -176,17 +181,6 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
         maskingType = PDFImageData::MaskingType::ImageMask;
     }
 
-    // Retrieve filters
-    PDFObject filters;
-    if (dictionary->hasKey(PDF_STREAM_DICT_FILTER))
-    {
-        filters = document->getObject(dictionary->get(PDF_STREAM_DICT_FILTER));
-    }
-    else if (dictionary->hasKey(PDF_STREAM_DICT_FILE_FILTER))
-    {
-        filters = document->getObject(dictionary->get(PDF_STREAM_DICT_FILE_FILTER));
-    }
-
     // Retrieve filter parameters
     PDFObject filterParameters;
     if (dictionary->hasKey(PDF_STREAM_DICT_DECODE_PARMS))
@@ -198,25 +192,7 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
         filterParameters = document->getObject(dictionary->get(PDF_STREAM_DICT_FDECODE_PARMS));
     }
 
-    QByteArray imageFilterName;
-    if (filters.isName())
-    {
-        imageFilterName = filters.getString();
-    }
-    else if (filters.isArray())
-    {
-        const PDFArray* filterArray = filters.getArray();
-        const size_t filterCount = filterArray->getCount();
-
-        if (filterCount)
-        {
-            const PDFObject& object = document->getObject(filterArray->getItem(filterCount - 1));
-            if (object.isName())
-            {
-                imageFilterName = object.getString();
-            }
-        }
-    }
+    QByteArray imageFilterName = getImageFilterName(document, dictionary);
 
     const PDFDictionary* filterParamsDictionary = nullptr;
     if (filterParameters.isDictionary())
@@ -339,6 +315,14 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
                 }
             }
 
+            // Decode only the resolution, which is needed for the target size (DCT scaling)
+            const int reductionLevel = getResolutionReductionLevel(QSize(int(codec.image_width), int(codec.image_height)), targetSize);
+            if (reductionLevel > 0)
+            {
+                codec.scale_num = 1;
+                codec.scale_denom = 1 << reductionLevel;
+            }
+
             jpeg_start_decompress(&codec);
 
             const JDIMENSION rowStride = codec.output_width * codec.output_components;
@@ -426,10 +410,44 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
             // Setup the decoder
             if (opj_setup_decoder(codec, &decompressParameters))
             {
+                // Decode tiles in parallel, if thread budget allows it. Function
+                // fails, if OpenJPEG is built without thread support, which is not an error.
+                PDFThreadBudgetReservation threadReservation(PDFExecutionPolicy::getContentStreamThreadBudget());
+                const int threadCount = threadReservation.getThreadCount();
+                if (threadCount > 1)
+                {
+                    opj_codec_set_threads(codec, threadCount);
+                }
+
                 // Try to read the header
 
                 if (opj_read_header(opjStream, codec, &jpegImage))
                 {
+                    // Decode only the resolution, which is needed for the target size
+                    int reductionLevel = getResolutionReductionLevel(QSize(int(jpegImage->x1 - jpegImage->x0), int(jpegImage->y1 - jpegImage->y0)), targetSize);
+                    if (reductionLevel > 0)
+                    {
+                        // Reduction level must be lower, than number of resolutions of all components
+                        if (opj_codestream_info_v2_t* codestreamInfo = opj_get_cstr_info(codec))
+                        {
+                            for (OPJ_UINT32 i = 0; i < codestreamInfo->nbcomps; ++i)
+                            {
+                                reductionLevel = qMin(reductionLevel, int(codestreamInfo->m_default_tile_info.tccp_info[i].numresolutions) - 1);
+                            }
+
+                            opj_destroy_cstr_info(&codestreamInfo);
+                        }
+                        else
+                        {
+                            reductionLevel = 0;
+                        }
+
+                        if (reductionLevel > 0)
+                        {
+                            opj_set_decoded_resolution_factor(codec, OPJ_UINT32(reductionLevel));
+                        }
+                    }
+
                     if (opj_set_decode_area(codec, jpegImage, decompressParameters.DA_x0, decompressParameters.DA_y0, decompressParameters.DA_x1, decompressParameters.DA_y1))
                     {
                         if (opj_decode(codec, opjStream, jpegImage))
@@ -640,7 +658,7 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
         {
             for (const PDFRenderError& error : imageData.errors)
             {
-                QString message = error.message.simplified().trimmed();
+                QString message = error.getMessage().simplified().trimmed();
                 if (error.type == RenderErrorType::Error)
                 {
                     throw PDFRendererException(error.type, message);
@@ -680,16 +698,26 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
     {
         QByteArray data = document->getDecodedStream(stream);
         QByteArray globalData;
+        PDFJBIG2GlobalSegmentsPointer globalSegments;
         if (filterParamsDictionary)
         {
             const PDFObject& globalDataObject = document->getObject(filterParamsDictionary->get("JBIG2Globals"));
             if (globalDataObject.isStream())
             {
-                globalData = document->getDecodedStream(globalDataObject.getStream());
+                // Global segments are usually shared by all pages, so they are decoded only once
+                const PDFStream* globalStream = globalDataObject.getStream();
+                auto getGlobalData = [document, globalStream]() { return document->getDecodedStream(globalStream); };
+                globalSegments = PDFJBIG2GlobalSegmentsCache::getInstance()->getGlobalSegments(globalStream, getGlobalData, errorReporter);
+
+                if (!globalSegments)
+                {
+                    globalData = getGlobalData();
+                }
             }
         }
 
         PDFJBIG2Decoder decoder(qMove(data), qMove(globalData), errorReporter);
+        decoder.setGlobalSegments(qMove(globalSegments));
         image.m_imageData = decoder.decode(maskingType);
         image.m_imageData.setDecode(!decode.empty() ? qMove(decode) : std::vector<PDFReal>({ 0.0, 1.0 }));
     }
@@ -767,27 +795,104 @@ QImage PDFImage::getImage(const PDFCMS* cms,
             throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Invalid size of image (%1x%2)").arg(m_imageData.getWidth()).arg(m_imageData.getHeight()));
         }
 
-        QImage image(m_imageData.getWidth(), m_imageData.getHeight(), QImage::Format_Alpha8);
+        // Image mask is kept as 1-bit image, its samples have the same bit order
+        // as pixels of the 1-bit image, so rows are just copied. Decode array
+        // only swaps entries of the color table. Painted samples are opaque
+        // black, masked out samples are transparent. Image mask is then painted
+        // with the fill color by changing the color table.
+        const QByteArray& data = m_imageData.getData();
+        const qsizetype rowSize = (qsizetype(m_imageData.getWidth()) + 7) / 8;
+        const qsizetype stride = m_imageData.getStride();
+        if (data.size() < stride * (qsizetype(m_imageData.getHeight()) - 1) + rowSize)
+        {
+            throw PDFException(PDFTranslationContext::tr("Not enough data to read %1-bit value.").arg(1));
+        }
+
+        QImage image(m_imageData.getWidth(), m_imageData.getHeight(), QImage::Format_Mono);
 
         const bool flip01 = !m_imageData.getDecode().empty() && qFuzzyCompare(m_imageData.getDecode().front(), 1.0);
-        PDFBitReader reader(&m_imageData.getData(), m_imageData.getBitsPerComponent());
+        const QRgb paintedColor = qRgba(0, 0, 0, 255);
+        const QRgb maskedOutColor = qRgba(0, 0, 0, 0);
+        image.setColorTable({ flip01 ? maskedOutColor : paintedColor, flip01 ? paintedColor : maskedOutColor });
 
         for (unsigned int i = 0, rowCount = m_imageData.getHeight(); i < rowCount; ++i)
         {
-            reader.seek(i * m_imageData.getStride());
-            unsigned char* outputLine = image.scanLine(i);
+            std::memcpy(image.scanLine(i), data.constData() + i * stride, rowSize);
+        }
+
+        return image;
+    }
+
+    return QImage();
+}
+
+int PDFImage::getResolutionReductionLevel(const PDFDocument* document, const PDFStream* stream, QSize targetSize)
+{
+    const PDFDictionary* dictionary = stream->getDictionary();
+    const QByteArray imageFilterName = getImageFilterName(document, dictionary);
+
+    if (imageFilterName == "DCTDecode" || imageFilterName == "DCT" || imageFilterName == "JPXDecode")
+    {
+        PDFDocumentDataLoaderDecorator loader(document);
+        const PDFInteger width = loader.readIntegerFromDictionary(dictionary, "Width", 0);
+        const PDFInteger height = loader.readIntegerFromDictionary(dictionary, "Height", 0);
+        return getResolutionReductionLevel(QSize(int(qBound<PDFInteger>(0, width, std::numeric_limits<int>::max())), int(qBound<PDFInteger>(0, height, std::numeric_limits<int>::max()))), targetSize);
+    }
+
+    return 0;
+}
+
+QByteArray PDFImage::getImageFilterName(const PDFDocument* document, const PDFDictionary* dictionary)
+{
+    PDFObject filters;
+    if (dictionary->hasKey(PDF_STREAM_DICT_FILTER))
+    {
+        filters = document->getObject(dictionary->get(PDF_STREAM_DICT_FILTER));
+    }
+    else if (dictionary->hasKey(PDF_STREAM_DICT_FILE_FILTER))
+    {
+        filters = document->getObject(dictionary->get(PDF_STREAM_DICT_FILE_FILTER));
+    }
 
-            for (unsigned int j = 0; j < m_imageData.getWidth(); ++j)
+    if (filters.isName())
+    {
+        return filters.getString();
+    }
+    else if (filters.isArray())
+    {
+        const PDFArray* filterArray = filters.getArray();
+        const size_t filterCount = filterArray->getCount();
+
+        if (filterCount)
+        {
+            const PDFObject& object = document->getObject(filterArray->getItem(filterCount - 1));
+            if (object.isName())
             {
-                const bool transparent = flip01 != static_cast<bool>(reader.read());
-                *outputLine++ = transparent ? 0x00 : 0xFF;
+                return object.getString();
             }
         }
+    }
 
-        return image;
+    return QByteArray();
+}
+
+int PDFImage::getResolutionReductionLevel(QSize imageSize, QSize targetSize)
+{
+    if (targetSize.isEmpty())
+    {
+        // Full resolution is requested
+        return 0;
     }
 
-    return QImage();
+    int level = 0;
+    while (level < MAX_RESOLUTION_REDUCTION_LEVEL &&
+           (imageSize.width() >> (level + 1)) >= targetSize.width() &&
+           (imageSize.height() >> (level + 1)) >= targetSize.height())
+    {
+        ++level;
+    }
+
+    return level;
 }
 
 bool PDFImage::canBeConvertedToMonochromatic(const QImage& image)
@@ -816,6 +921,57 @@ bool PDFImage::canBeConvertedToMonochromatic(const QImage& image)
     return true;
 }
 
+QByteArray PDFImage::encodeJPEG(const QImage& image, int quality)
+{
+    Q_ASSERT(image.format() == QImage::Format_Grayscale8 || image.format() == QImage::Format_RGB888);
+
+    jpeg_compress_struct codec;
+    jpeg_error_mgr errorManager;
+    std::memset(&codec, 0, sizeof(jpeg_compress_struct));
+    std::memset(&errorManager, 0, sizeof(errorManager));
+
+    auto errorMethod = [](j_common_ptr ptr)
+    {
+        char buffer[JMSG_LENGTH_MAX] = { };
+        (ptr->err->format_message)(ptr, buffer);
+
+        jpeg_destroy(ptr);
+        throw PDFException(PDFTranslationContext::tr("Error writing JPEG (DCT) image: %1.").arg(QString::fromLatin1(buffer)));
+    };
+
+    unsigned char* buffer = nullptr;
+    unsigned long bufferSize = 0;
+    auto freeBuffer = qScopeGuard([&buffer]() { std::free(buffer); });
+
+    jpeg_std_error(&errorManager);
+    errorManager.error_exit = errorMethod;
+    codec.err = &errorManager;
+
+    jpeg_create_compress(&codec);
+    jpeg_mem_dest(&codec, &buffer, &bufferSize);
+
+    const bool isGray = image.format() == QImage::Format_Grayscale8;
+    codec.image_width = image.width();
+    codec.image_height = image.height();
+    codec.input_components = isGray ? 1 : 3;
+    codec.in_color_space = isGray ? JCS_GRAYSCALE : JCS_RGB;
+
+    jpeg_set_defaults(&codec);
+    jpeg_set_quality(&codec, qBound(1, quality, 100), TRUE);
+    jpeg_start_compress(&codec, TRUE);
+
+    while (codec.next_scanline < codec.image_height)
+    {
+        JSAMPROW rowData = const_cast<JSAMPROW>(image.constScanLine(codec.next_scanline));
+        jpeg_write_scanlines(&codec, &rowData, 1);
+    }
+
+    jpeg_finish_compress(&codec);
+    jpeg_destroy_compress(&codec);
+
+    return QByteArray(reinterpret_cast<const char*>(buffer), static_cast<qsizetype>(bufferSize));
+}
+
 OPJ_SIZE_T PDFJPEG2000ImageData::read(void* p_buffer, OPJ_SIZE_T p_nb_bytes, void* p_user_data)
 {
     PDFJPEG2000ImageData* data = reinterpret_cast<PDFJPEG2000ImageData*>(p_user_data);
@@ -67,12 +67,29 @@ public:
     /// \param isSoftMask Is it a soft mask image?
     /// \param renderingIntent Default rendering intent of the image
     /// \param errorReporter Error reporter for reporting errors (or warnings)
+    /// \param targetSize Size of the image on the device (in pixels). If it is valid, then
+    ///        JPEG and JPEG 2000 images are decoded only in resolution needed for this size.
+    /// \param isSoftMaskIgnored If true, soft mask image (SMask entry) is ignored and image is opaque
     static PDFImage createImage(const PDFDocument* document,
                                 const PDFStream* stream,
                                 PDFColorSpacePointer colorSpace,
                                 bool isSoftMask,
                                 RenderingIntent renderingIntent,
-                                PDFRenderErrorReporter* errorReporter);
+                                PDFRenderErrorReporter* errorReporter,
+                                QSize targetSize = QSize(),
+                                bool isSoftMaskIgnored = false);
+
+    /// Maximal resolution reduction level of the image. Image decoded with
+    /// reduction level n is 2^n times smaller in each direction.
+    static constexpr const int MAX_RESOLUTION_REDUCTION_LEVEL = 3;
+
+    /// Returns resolution reduction level, which is used, when image is created
+    /// with given target size. Reduction is supported for JPEG and JPEG 2000 images,
+    /// for other images, zero is returned. Image size is taken from the image dictionary.
+    /// \param document Document
+    /// \param stream Stream with image
+    /// \param targetSize Size of the image on the device (in pixels)
+    static int getResolutionReductionLevel(const PDFDocument* document, const PDFStream* stream, QSize targetSize);
 
     /// Returns image transformed from image data and color space
     QImage getImage(const PDFCMS* cms,
@@ -114,7 +131,22 @@ public:
 
     static bool canBeConvertedToMonochromatic(const QImage& image);
 
+    /// Encodes image to the baseline JPEG data, which can be used as content
+    /// of the stream with DCTDecode filter. Image must be in the Format_Grayscale8,
+    /// or Format_RGB888 format, samples are stored without any color conversion.
+    /// If image can't be encoded, then exception is thrown.
+    /// \param image Image to be encoded
+    /// \param quality Quality of the JPEG image (1-100)
+    static QByteArray encodeJPEG(const QImage& image, int quality);
+
 private:
+    /// Returns name of the last filter of the image stream (which is the image filter)
+    static QByteArray getImageFilterName(const PDFDocument* document, const PDFDictionary* dictionary);
+
+    /// Returns resolution reduction level, so image of given size is still
+    /// at least as large as the target size.
+    static int getResolutionReductionLevel(QSize imageSize, QSize targetSize);
+
     PDFImageData m_imageData;
     PDFImageData m_softMask;
     PDFColorSpacePointer m_colorSpace;
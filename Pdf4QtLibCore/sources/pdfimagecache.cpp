@@ -0,0 +1,358 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfimagecache.h"
+#include "pdfobject.h"
+#include "pdfcms.h"
+#include "pdfoperationcontrol.h"
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFImageCache::PDFImageCache(qint64 memoryLimit) :
+    PDFMemoryBudgetClient("image-cache", 3, memoryLimit)
+{
+    registerMemoryBudgetClient();
+}
+
+PDFImageCache::~PDFImageCache()
+{
+    unregisterMemoryBudgetClient();
+}
+
+QImage PDFImageCache::getImage(const PDFStream* stream,
+                               const void* colorSpaceContext,
+                               const PDFCMS* cms,
+                               RenderingIntent intent,
+                               int resolutionReductionLevel,
+                               bool isSoftMaskIgnored,
+                               const PDFOperationControl* operationControl,
+                               const CreateImage& create)
+{
+    // Streams not owned by the document can't be pinned in the cache,
+    // their address can be reused by another stream.
+    std::shared_ptr<const PDFStream> streamPointer = stream->weak_from_this().lock();
+    if (!streamPointer)
+    {
+        return create();
+    }
+
+    Key key;
+    key.stream = stream;
+    key.colorSpaceContext = colorSpaceContext;
+    key.cmsSerialNumber = cms->getSerialNumber();
+    key.intent = intent;
+    key.resolutionReductionLevel = resolutionReductionLevel;
+    key.isSoftMaskIgnored = isSoftMaskIgnored;
+
+    std::promise<QImage> promise;
+    std::shared_future<QImage> image;
+    quint64 serialNumber = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto it = m_itemMap.find(key);
+        if (it != m_itemMap.cend())
+        {
+            // Mark item as recently used
+            m_items.splice(m_items.begin(), m_items, it->second);
+            image = it->second->image;
+        }
+        else
+        {
+            serialNumber = ++m_serialNumber;
+            image = promise.get_future().share();
+
+            Item item;
+            item.key = key;
+            item.stream = std::move(streamPointer);
+            item.image = image;
+            item.serialNumber = serialNumber;
+            m_items.push_front(std::move(item));
+            m_itemMap.emplace(key, m_items.begin());
+        }
+    }
+
+    if (serialNumber == 0)
+    {
+        // Image is created by another thread (or it is already created),
+        // rethrows the exception, if image creation failed.
+        QImage result = image.get();
+        if (!result.isNull())
+        {
+            return result;
+        }
+
+        // Creation of the image was cancelled in the other thread
+        return create();
+    }
+
+    QImage result;
+    try
+    {
+        result = create();
+    }
+    catch (...)
+    {
+        finish(key, serialNumber, QImage());
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    // Image of the cancelled operation can be incomplete
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        finish(key, serialNumber, QImage());
+        promise.set_value(QImage());
+    }
+    else
+    {
+        finish(key, serialNumber, result);
+        promise.set_value(result);
+    }
+
+    return result;
+}
+
+void PDFImageCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_itemMap.clear();
+    m_items.clear();
+    m_memoryConsumption = 0;
+    lock.unlock();
+
+    setMemoryConsumption(0);
+}
+
+qint64 PDFImageCache::getMemoryConsumption() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryConsumption;
+}
+
+size_t PDFImageCache::KeyHash::operator()(const Key& key) const
+{
+    size_t seed = std::hash<const void*>()(key.stream);
+    auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2); };
+
+    combine(std::hash<const void*>()(key.colorSpaceContext));
+    combine(std::hash<quint64>()(key.cmsSerialNumber));
+    combine(static_cast<size_t>(key.intent));
+    combine(static_cast<size_t>(key.resolutionReductionLevel));
+    combine(static_cast<size_t>(key.isSoftMaskIgnored));
+    return seed;
+}
+
+void PDFImageCache::finish(const Key& key, quint64 serialNumber, const QImage& image)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_itemMap.find(key);
+    if (it == m_itemMap.end() || it->second->serialNumber != serialNumber)
+    {
+        // Item was removed meanwhile (cache was cleared or item was evicted)
+        return;
+    }
+
+    const qint64 memoryConsumption = image.sizeInBytes();
+    if (image.isNull() || memoryConsumption > getMemoryLimit())
+    {
+        m_items.erase(it->second);
+        m_itemMap.erase(it);
+        return;
+    }
+
+    it->second->memoryConsumption = memoryConsumption;
+    m_memoryConsumption += memoryConsumption;
+    shrink();
+
+    const qint64 totalMemoryConsumption = m_memoryConsumption;
+    lock.unlock();
+
+    reportMemoryConsumption(totalMemoryConsumption);
+}
+
+void PDFImageCache::shrink()
+{
+    while (m_memoryConsumption > getMemoryLimit() && !m_items.empty())
+    {
+        auto itemIt = std::prev(m_items.end());
+        m_itemMap.erase(itemIt->key);
+        m_memoryConsumption -= itemIt->memoryConsumption;
+        m_items.erase(itemIt);
+    }
+}
+
+void PDFImageCache::trimMemory()
+{
+    qint64 memoryConsumption = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        shrink();
+        memoryConsumption = m_memoryConsumption;
+    }
+
+    setMemoryConsumption(memoryConsumption);
+}
+
+PDFImageMipmaps::PDFImageMipmaps(QImage image) :
+    m_image(std::move(image))
+{
+
+}
+
+QImage PDFImageMipmaps::getImage(QSize targetSize) const
+{
+    if (targetSize.isEmpty())
+    {
+        return m_image;
+    }
+
+    // Determine level, we do not want to go under the target size, because
+    // then smooth transformation of the painter would enlarge the image.
+    size_t level = 0;
+    QSize levelSize = m_image.size();
+    while (true)
+    {
+        const QSize nextLevelSize((levelSize.width() + 1) / 2, (levelSize.height() + 1) / 2);
+        if (levelSize == nextLevelSize ||
+            nextLevelSize.width() < targetSize.width() ||
+            nextLevelSize.height() < targetSize.height())
+        {
+            break;
+        }
+
+        levelSize = nextLevelSize;
+        ++level;
+    }
+
+    if (level == 0)
+    {
+        return m_image;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    while (m_levels.size() < level)
+    {
+        m_levels.push_back(createNextLevel(m_levels.empty() ? m_image : m_levels.back()));
+    }
+
+    return m_levels[level - 1];
+}
+
+qint64 PDFImageMipmaps::getMemoryConsumptionEstimate() const
+{
+    // Sum of geometric series 1/4 + 1/16 + ... is 1/3, but images
+    // in other formats are converted to 32-bit images.
+    const qint64 bytes = qint64(m_image.width()) * qint64(m_image.height()) * qint64(qMax(m_image.depth(), 8) / 8);
+    return bytes / 3;
+}
+
+bool PDFImageMipmaps::isMipmapsUsed(const QImage& image)
+{
+    return image.width() >= MIN_IMAGE_SIZE && image.height() >= MIN_IMAGE_SIZE;
+}
+
+QImage PDFImageMipmaps::createNextLevel(const QImage& image)
+{
+    QImage source = image;
+
+    switch (source.format())
+    {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+        case QImage::Format_Grayscale8:
+            break;
+
+        default:
+        {
+            // Averaging of the pixels must be done with premultiplied alpha. Gray images
+            // (including bitonal images) are kept gray to save the memory.
+            if (source.allGray() && !source.hasAlphaChannel())
+            {
+                source.convertTo(QImage::Format_Grayscale8);
+            }
+            else
+            {
+                source.convertTo(source.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+            }
+            break;
+        }
+    }
+
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    const int width = (sourceWidth + 1) / 2;
+    const int height = (sourceHeight + 1) / 2;
+
+    QImage result(width, height, source.format());
+    result.setDevicePixelRatio(source.devicePixelRatio());
+
+    for (int y = 0; y < height; ++y)
+    {
+        // Odd size - last row (column) is averaged with itself
+        const int y0 = 2 * y;
+        const int y1 = qMin(y0 + 1, sourceHeight - 1);
+
+        if (source.format() == QImage::Format_Grayscale8)
+        {
+            const uchar* line0 = source.constScanLine(y0);
+            const uchar* line1 = source.constScanLine(y1);
+            uchar* target = result.scanLine(y);
+
+            for (int x = 0; x < width; ++x)
+            {
+                const int x0 = 2 * x;
+                const int x1 = qMin(x0 + 1, sourceWidth - 1);
+                target[x] = uchar((line0[x0] + line0[x1] + line1[x0] + line1[x1] + 2) >> 2);
+            }
+        }
+        else
+        {
+            const QRgb* line0 = reinterpret_cast<const QRgb*>(source.constScanLine(y0));
+            const QRgb* line1 = reinterpret_cast<const QRgb*>(source.constScanLine(y1));
+            QRgb* target = reinterpret_cast<QRgb*>(result.scanLine(y));
+
+            for (int x = 0; x < width; ++x)
+            {
+                const int x0 = 2 * x;
+                const int x1 = qMin(x0 + 1, sourceWidth - 1);
+
+                // Two components are summed at once, sum of four 8-bit
+                // values fits into 16 bits, so components do not interfere.
+                const QRgb p0 = line0[x0];
+                const QRgb p1 = line0[x1];
+                const QRgb p2 = line1[x0];
+                const QRgb p3 = line1[x1];
+
+                const quint32 redBlue = (p0 & 0x00FF00FF) + (p1 & 0x00FF00FF) + (p2 & 0x00FF00FF) + (p3 & 0x00FF00FF) + 0x00020002;
+                const quint32 alphaGreen = ((p0 >> 8) & 0x00FF00FF) + ((p1 >> 8) & 0x00FF00FF) + ((p2 >> 8) & 0x00FF00FF) + ((p3 >> 8) & 0x00FF00FF) + 0x00020002;
+                target[x] = ((redBlue >> 2) & 0x00FF00FF) | (((alphaGreen >> 2) & 0x00FF00FF) << 8);
+            }
+        }
+    }
+
+    return result;
+}
+
+}   // namespace pdf
@@ -0,0 +1,180 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFIMAGECACHE_H
+#define PDFIMAGECACHE_H
+
+#include "pdfglobal.h"
+#include "pdfmemorybudget.h"
+
+#include <QMutex>
+#include <QImage>
+
+#include <list>
+#include <vector>
+#include <memory>
+#include <future>
+#include <functional>
+#include <unordered_map>
+
+namespace pdf
+{
+class PDFCMS;
+class PDFStream;
+class PDFOperationControl;
+
+/// Thread safe cache of decoded and color converted images. Image is identified
+/// by its stream, color space context (resource dictionary, in which color space
+/// of the image was resolved), color management system, rendering intent and
+/// resolution reduction level (images can be decoded in lower resolution).
+/// Soft mask and mask of the image are part of the image stream, so they
+/// are part of the key too. Cache is shared by all rasterizers, if more threads
+/// request the same image at once, only one of them decodes it, others wait
+/// for the result. Memory consumption is limited, least recently used images
+/// are removed first.
+/// Memory limit is assigned by the global memory budget, if the budget is set.
+class PDF4QTLIBCORESHARED_EXPORT PDFImageCache : public PDFMemoryBudgetClient
+{
+public:
+    /// Default memory limit of the cache (in bytes)
+    static constexpr const qint64 DEFAULT_MEMORY_LIMIT = 256 * 1024 * 1024;
+
+    explicit PDFImageCache(qint64 memoryLimit = DEFAULT_MEMORY_LIMIT);
+    virtual ~PDFImageCache() override;
+
+    PDFImageCache(const PDFImageCache&) = delete;
+    PDFImageCache& operator=(const PDFImageCache&) = delete;
+
+    using CreateImage = std::function<QImage()>;
+
+    /// Returns image from the cache. If image is not in the cache, it is created
+    /// using \p create function and inserted into the cache. If image is just being
+    /// created by another thread, function waits for the result. Streams, which
+    /// are not owned by the document (inline images) are not cached. Exception
+    /// from \p create function is rethrown.
+    /// \param stream Image stream
+    /// \param colorSpaceContext Context, in which color space of the image is resolved
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param resolutionReductionLevel Resolution reduction level of the image
+    /// \param isSoftMaskIgnored Is soft mask of the image ignored?
+    /// \param operationControl Operation control (image of cancelled operation is not cached)
+    /// \param create Function, which creates the image
+    QImage getImage(const PDFStream* stream,
+                    const void* colorSpaceContext,
+                    const PDFCMS* cms,
+                    RenderingIntent intent,
+                    int resolutionReductionLevel,
+                    bool isSoftMaskIgnored,
+                    const PDFOperationControl* operationControl,
+                    const CreateImage& create);
+
+    /// Removes all items from the cache
+    void clear();
+
+    /// Returns memory consumption of the cache (in bytes)
+    qint64 getMemoryConsumption() const;
+
+protected:
+    virtual void trimMemory() override;
+
+private:
+    struct Key
+    {
+        bool operator==(const Key&) const = default;
+
+        const PDFStream* stream = nullptr;
+        const void* colorSpaceContext = nullptr;
+        quint64 cmsSerialNumber = 0;
+        RenderingIntent intent = RenderingIntent::Unknown;
+        int resolutionReductionLevel = 0;
+        bool isSoftMaskIgnored = false;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Item
+    {
+        Key key;
+        std::shared_ptr<const PDFStream> stream;
+        std::shared_future<QImage> image;
+        quint64 serialNumber = 0;
+        qint64 memoryConsumption = 0;
+    };
+
+    using Items = std::list<Item>;
+
+    /// Finishes the item created by this thread. If \p image is null,
+    /// then item is removed from the cache.
+    void finish(const Key& key, quint64 serialNumber, const QImage& image);
+
+    /// Removes least recently used items, until memory limit is met
+    void shrink();
+
+    mutable QMutex m_mutex;
+    Items m_items;
+    std::unordered_map<Key, Items::iterator, KeyHash> m_itemMap;
+    quint64 m_serialNumber = 0;
+    qint64 m_memoryConsumption = 0;
+};
+
+/// Mipmap levels (box filter pyramid) of the decoded image. Level 0 is the
+/// image itself, each next level has half the size of the previous level.
+/// Levels are created lazily, when the image is drawn downscaled, so large
+/// images drawn small are not resampled from the full resolution on each
+/// draw. Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFImageMipmaps
+{
+public:
+    explicit PDFImageMipmaps(QImage image);
+
+    PDFImageMipmaps(const PDFImageMipmaps&) = delete;
+    PDFImageMipmaps& operator=(const PDFImageMipmaps&) = delete;
+
+    /// Returns the smallest level of the image, which is not smaller
+    /// than target size in any dimension. Missing levels are created.
+    /// \param targetSize Size of the drawn image on the device (in pixels)
+    QImage getImage(QSize targetSize) const;
+
+    /// Returns upper bound of memory consumed by the mipmap levels
+    /// (level 0 is not included, it is the image itself).
+    qint64 getMemoryConsumptionEstimate() const;
+
+    /// Returns true, if it makes sense to create mipmaps for the image
+    /// \param image Image
+    static bool isMipmapsUsed(const QImage& image);
+
+    /// Creates next level of the image using 2x2 box filter
+    /// \param image Image (previous level)
+    static QImage createNextLevel(const QImage& image);
+
+private:
+    /// Minimal size of the image (in both dimensions) to use mipmaps
+    static constexpr int MIN_IMAGE_SIZE = 64;
+
+    QImage m_image;
+    mutable QMutex m_mutex;
+    mutable std::vector<QImage> m_levels;
+};
+
+}   // namespace pdf
+
+#endif // PDFIMAGECACHE_H
@@ -1,11 +1,274 @@
 #include "pdfimageconversion.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfutils.h"
+#include "pdfsimd.h"
 #include "pdfdbgheap.h"
 
 #include <cmath>
+#include <cstring>
 
 namespace pdf
 {
 
+/// Kernels for bitonal conversion. Lightness is computed as in QColor,
+/// i.e. as rounded average of maximal and minimal color component, so
+/// results are the same as from the scalar code.
+class PDFImageConversionKernels
+{
+public:
+    /// Computes lightness of the pixels
+    /// \param pixels Pixels in RGB32 or ARGB32 format
+    /// \param lightness Output lightness
+    /// \param count Pixel count
+    static void computeLightness(const QRgb* pixels, uint8_t* lightness, int count);
+
+    /// Compares lightness with the threshold and packs result bits into
+    /// the bytes, most significant bit first (as in QImage::Format_Mono).
+    /// Bit is set, if lightness is greater or equal than the threshold,
+    /// padding bits of the last byte are zero.
+    /// \param lightness Lightness
+    /// \param bits Output bits
+    /// \param count Pixel count
+    /// \param threshold Threshold
+    static void threshold(const uint8_t* lightness, uint8_t* bits, int count, int threshold);
+
+private:
+    static uint8_t computeLightness(QRgb pixel)
+    {
+        const int r = qRed(pixel);
+        const int g = qGreen(pixel);
+        const int b = qBlue(pixel);
+        const int maximum = qMax(r, qMax(g, b));
+        const int minimum = qMin(r, qMin(g, b));
+        return uint8_t((maximum + minimum + 1) >> 1);
+    }
+
+    static uint8_t reverseBits(uint8_t value)
+    {
+        value = uint8_t(((value & 0xF0) >> 4) | ((value & 0x0F) << 4));
+        value = uint8_t(((value & 0xCC) >> 2) | ((value & 0x33) << 2));
+        value = uint8_t(((value & 0xAA) >> 1) | ((value & 0x55) << 1));
+        return value;
+    }
+
+#if defined(PDF4QT_SIMD_SSE2)
+    static __m128i computeLightnessSSE2(__m128i pixels)
+    {
+        // Lowest byte of each pixel is blue, then green and red follow
+        const __m128i maximum = _mm_max_epu8(pixels, _mm_max_epu8(_mm_srli_epi32(pixels, 8), _mm_srli_epi32(pixels, 16)));
+        const __m128i minimum = _mm_min_epu8(pixels, _mm_min_epu8(_mm_srli_epi32(pixels, 8), _mm_srli_epi32(pixels, 16)));
+        return _mm_and_si128(_mm_avg_epu8(maximum, minimum), _mm_set1_epi32(0xFF));
+    }
+
+    static int computeLightnessSSE2(const QRgb* pixels, uint8_t* lightness, int count);
+    static int thresholdSSE2(const uint8_t* lightness, uint8_t* bits, int count, int threshold);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static __m256i computeLightnessAVX2(__m256i pixels)
+    {
+        const __m256i maximum = _mm256_max_epu8(pixels, _mm256_max_epu8(_mm256_srli_epi32(pixels, 8), _mm256_srli_epi32(pixels, 16)));
+        const __m256i minimum = _mm256_min_epu8(pixels, _mm256_min_epu8(_mm256_srli_epi32(pixels, 8), _mm256_srli_epi32(pixels, 16)));
+        return _mm256_and_si256(_mm256_avg_epu8(maximum, minimum), _mm256_set1_epi32(0xFF));
+    }
+
+    PDF4QT_SIMD_AVX2_FUNCTION static int computeLightnessAVX2(const QRgb* pixels, uint8_t* lightness, int count);
+    PDF4QT_SIMD_AVX2_FUNCTION static int thresholdAVX2(const uint8_t* lightness, uint8_t* bits, int count, int threshold);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static int computeLightnessNEON(const QRgb* pixels, uint8_t* lightness, int count);
+#endif
+};
+
+void PDFImageConversionKernels::computeLightness(const QRgb* pixels, uint8_t* lightness, int count)
+{
+    int i = 0;
+
+    switch (PDFSimd::getInstructionSet())
+    {
+#if defined(PDF4QT_SIMD_AVX2)
+        case PDFSimd::InstructionSet::AVX2:
+            i = computeLightnessAVX2(pixels, lightness, count);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+            i = computeLightnessSSE2(pixels, lightness, count);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+        case PDFSimd::InstructionSet::NEON:
+            i = computeLightnessNEON(pixels, lightness, count);
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    for (; i < count; ++i)
+    {
+        lightness[i] = computeLightness(pixels[i]);
+    }
+}
+
+void PDFImageConversionKernels::threshold(const uint8_t* lightness, uint8_t* bits, int count, int threshold)
+{
+    if (threshold <= 0 || threshold > 255)
+    {
+        // All bits are either set, or cleared
+        const uint8_t value = threshold <= 0 ? 0xFF : 0x00;
+        const int byteCount = (count + 7) / 8;
+        std::memset(bits, value, byteCount);
+
+        if (count % 8 != 0)
+        {
+            bits[byteCount - 1] &= uint8_t(0xFF << (8 - count % 8));
+        }
+        return;
+    }
+
+    int i = 0;
+
+    switch (PDFSimd::getInstructionSet())
+    {
+#if defined(PDF4QT_SIMD_AVX2)
+        case PDFSimd::InstructionSet::AVX2:
+            i = thresholdAVX2(lightness, bits, count, threshold);
+            break;
+#endif
+
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+            i = thresholdSSE2(lightness, bits, count, threshold);
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    Q_ASSERT(i % 8 == 0);
+    for (; i < count; i += 8)
+    {
+        uint8_t value = 0;
+        const int bitCount = qMin(count - i, 8);
+        for (int j = 0; j < bitCount; ++j)
+        {
+            if (lightness[i + j] >= threshold)
+            {
+                value |= uint8_t(0x80 >> j);
+            }
+        }
+        bits[i / 8] = value;
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+int PDFImageConversionKernels::computeLightnessSSE2(const QRgb* pixels, uint8_t* lightness, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i l0 = computeLightnessSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i)));
+        const __m128i l1 = computeLightnessSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 4)));
+        const __m128i l2 = computeLightnessSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 8)));
+        const __m128i l3 = computeLightnessSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 12)));
+
+        // Values are in range 0-255, so saturation never occurs
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(l0, l1), _mm_packs_epi32(l2, l3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lightness + i), packed);
+    }
+    return i;
+}
+
+int PDFImageConversionKernels::thresholdSSE2(const uint8_t* lightness, uint8_t* bits, int count, int threshold)
+{
+    const __m128i thresholdValue = _mm_set1_epi8(char(threshold));
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        // Unsigned comparison value >= threshold is max(value, threshold) == value
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lightness + i));
+        const __m128i mask = _mm_cmpeq_epi8(_mm_max_epu8(value, thresholdValue), value);
+        const int maskBits = _mm_movemask_epi8(mask);
+
+        // Movemask stores first pixel into the least significant bit
+        bits[i / 8] = reverseBits(uint8_t(maskBits));
+        bits[i / 8 + 1] = reverseBits(uint8_t(maskBits >> 8));
+    }
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+int PDFImageConversionKernels::computeLightnessAVX2(const QRgb* pixels, uint8_t* lightness, int count)
+{
+    // Packing instructions work within 128-bit lanes, so
+    // we must restore the order of the pixels after packing.
+    const __m256i permutation = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i l0 = computeLightnessAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i)));
+        const __m256i l1 = computeLightnessAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i + 8)));
+        const __m256i l2 = computeLightnessAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i + 16)));
+        const __m256i l3 = computeLightnessAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i + 24)));
+
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(l0, l1), _mm256_packs_epi32(l2, l3));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lightness + i), _mm256_permutevar8x32_epi32(packed, permutation));
+    }
+    return i;
+}
+
+int PDFImageConversionKernels::thresholdAVX2(const uint8_t* lightness, uint8_t* bits, int count, int threshold)
+{
+    const __m256i thresholdValue = _mm256_set1_epi8(char(threshold));
+
+    // Reverses order of the bytes in each group of 8 bytes, so the first
+    // pixel of the group ends in the most significant bit of the mask byte.
+    const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i value = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lightness + i)), reverse);
+        const __m256i mask = _mm256_cmpeq_epi8(_mm256_max_epu8(value, thresholdValue), value);
+        const uint32_t maskBits = static_cast<uint32_t>(_mm256_movemask_epi8(mask));
+
+        bits[i / 8 + 0] = uint8_t(maskBits);
+        bits[i / 8 + 1] = uint8_t(maskBits >> 8);
+        bits[i / 8 + 2] = uint8_t(maskBits >> 16);
+        bits[i / 8 + 3] = uint8_t(maskBits >> 24);
+    }
+
+    // Finish remaining 16 pixels using SSE2
+    return i + thresholdSSE2(lightness + i, bits + i / 8, count - i, threshold);
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+int PDFImageConversionKernels::computeLightnessNEON(const QRgb* pixels, uint8_t* lightness, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        // Deinterleaved components - blue, green, red and alpha
+        const uint8x16x4_t components = vld4q_u8(reinterpret_cast<const uint8_t*>(pixels + i));
+        const uint8x16_t maximum = vmaxq_u8(components.val[0], vmaxq_u8(components.val[1], components.val[2]));
+        const uint8x16_t minimum = vminq_u8(components.val[0], vminq_u8(components.val[1], components.val[2]));
+        vst1q_u8(lightness + i, vrhaddq_u8(maximum, minimum));
+    }
+    return i;
+}
+#endif
+
 PDFImageConversion::PDFImageConversion()
 {
 
@@ -35,8 +298,50 @@ bool PDFImageConversion::convert()
         return false;
     }
 
-    QImage bitonal(m_image.width(), m_image.height(), QImage::Format_Mono);
-    bitonal.fill(0);
+    // Kernels work directly with 32-bit pixels, so we convert the image
+    // only once (if necessary). Premultiplied formats are converted too,
+    // because lightness is computed from unpremultiplied color.
+    QImage image = m_image;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32)
+    {
+        image.convertTo(QImage::Format_ARGB32);
+    }
+
+    const int width = image.width();
+    const int height = image.height();
+
+    // Lightness is computed only once into the buffer, then it is used both
+    // for histogram (automatic threshold) and for thresholding itself.
+    std::vector<uint8_t> lightness(size_t(width) * size_t(height), 0);
+
+    const bool isAutomatic = m_conversionMethod == ConversionMethod::Automatic;
+    const int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    std::vector<Histogram> histograms(isAutomatic ? bandCount : 0, Histogram());
+
+    auto computeBand = [&](int band)
+    {
+        const int firstLine = band * BAND_HEIGHT;
+        const int lastLine = qMin(firstLine + BAND_HEIGHT, height);
+
+        for (int y = firstLine; y < lastLine; ++y)
+        {
+            const QRgb* pixels = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+            uint8_t* line = lightness.data() + size_t(y) * size_t(width);
+            PDFImageConversionKernels::computeLightness(pixels, line, width);
+
+            if (isAutomatic)
+            {
+                Histogram& histogram = histograms[band];
+                for (int x = 0; x < width; ++x)
+                {
+                    histogram[line[x]] += 1;
+                }
+            }
+        }
+    };
+
+    auto bandRange = PDFIntegerRange<int>(0, bandCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bandRange.begin(), bandRange.end(), computeBand);
 
     // Thresholding
     int threshold = DEFAULT_THRESHOLD;
@@ -44,9 +349,20 @@ bool PDFImageConversion::convert()
     switch (m_conversionMethod)
     {
         case pdf::PDFImageConversion::ConversionMethod::Automatic:
-            m_automaticThreshold = calculateOtsu1DThreshold();
+        {
+            Histogram histogram = { };
+            for (const Histogram& bandHistogram : histograms)
+            {
+                for (size_t i = 0; i < histogram.size(); ++i)
+                {
+                    histogram[i] += bandHistogram[i];
+                }
+            }
+
+            m_automaticThreshold = calculateOtsu1DThreshold(histogram);
             threshold = m_automaticThreshold;
             break;
+        }
 
         case pdf::PDFImageConversion::ConversionMethod::Manual:
             threshold = m_manualThreshold;
@@ -57,16 +373,23 @@ bool PDFImageConversion::convert()
             break;
     }
 
-    for (int y = 0; y < m_image.height(); ++y)
+    QImage bitonal(width, height, QImage::Format_Mono);
+    uchar* bitonalData = bitonal.bits();
+    const qsizetype bitonalStride = bitonal.bytesPerLine();
+
+    auto thresholdBand = [&](int band)
     {
-        for (int x = 0; x < m_image.width(); ++x)
+        const int firstLine = band * BAND_HEIGHT;
+        const int lastLine = qMin(firstLine + BAND_HEIGHT, height);
+
+        for (int y = firstLine; y < lastLine; ++y)
         {
-            QColor pixelColor = m_image.pixelColor(x, y);
-            int pixelValue = pixelColor.lightness();
-            bool bit = (pixelValue >= threshold);
-            bitonal.setPixel(x, y, bit);
+            const uint8_t* line = lightness.data() + size_t(y) * size_t(width);
+            PDFImageConversionKernels::threshold(line, bitonalData + y * bitonalStride, width, threshold);
         }
-    }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bandRange.begin(), bandRange.end(), thresholdBand);
 
     m_convertedImage = std::move(bitonal);
     return true;
@@ -95,94 +418,53 @@ QImage PDFImageConversion::getConvertedImage() const
     return m_convertedImage;
 }
 
-int PDFImageConversion::calculateOtsu1DThreshold() const
+int PDFImageConversion::calculateOtsu1DThreshold(const Histogram& histogram)
 {
-    if (m_image.isNull())
-    {
-        return 128;
-    }
-
-    // Histogram of lightness occurences
-    std::array<int, 256> histogram = { };
+    int64_t pixelCount = 0;
+    double totalMoment = 0.0;
 
-    for (int x = 0; x < m_image.width(); ++x)
+    for (size_t i = 0; i < histogram.size(); ++i)
     {
-        for (int y = 0; y < m_image.height(); ++y)
-        {
-            int lightness = m_image.pixelColor(x, y).lightness();
-            Q_ASSERT(lightness >= 0 && lightness <= 255);
-
-            int clampedLightness = qBound(0, lightness, 255);
-            histogram[clampedLightness] += 1;
-        }
+        pixelCount += histogram[i];
+        totalMoment += double(i) * histogram[i];
     }
 
-    float factor = 1.0f / float(m_image.width() * m_image.height());
-
-    std::array<float, 256> normalizedHistogram = { };
-    std::array<float, 256> cumulativeProbabilities = { };
-    std::array<float, 256> interClassVariance = { };
-
-    // Compute probabilities
-    for (size_t i = 0; i < histogram.size(); ++i)
+    if (pixelCount == 0)
     {
-        normalizedHistogram[i] = histogram[i] * factor;
-        cumulativeProbabilities[i] = normalizedHistogram[i];
-
-        if (i > 0)
-        {
-            cumulativeProbabilities[i] += cumulativeProbabilities[i - 1];
-        }
+        return DEFAULT_THRESHOLD;
     }
 
+    const double factor = 1.0 / double(pixelCount);
+
     // Calculate the inter-class variance for each threshold. Variables
     // with the subscript 0 denote the background, while those with
-    // subscript 1 denote the foreground.
-    for (size_t i = 0; i < histogram.size(); ++i)
-    {
-        const float w0 = cumulativeProbabilities[i] - normalizedHistogram[i];
-        const float w1 = 1.0f - w0;
-
-        float u0 = 0.0f;
-        float u1 = 0.0f;
+    // subscript 1 denote the foreground. Background weight and moment
+    // are accumulated, so whole computation is linear.
+    double w0 = 0.0;
+    double moment0 = 0.0;
+    const double totalMean = totalMoment * factor;
 
-        // Calculate mean intensity value of the background.
-        if (!qFuzzyIsNull(w0))
-        {
-            for (size_t j = 0; j < i; ++j)
-            {
-                u0 += j * normalizedHistogram[j];
-            }
-
-            u0 /= w0;
-        }
-
-        // Calculate mean intensity value of the foreground.
-        if (!qFuzzyIsNull(w1))
-        {
-            for (size_t j = i; j < histogram.size(); ++j)
-            {
-                u1 += j * normalizedHistogram[j];
-            }
-
-            u1 /= w1;
-        }
-
-        const float variance = w0 * w1 * std::pow(u0 - u1, 2);
-        interClassVariance[i] = variance;
-    }
-
-    // Find maximal value of the variance
     size_t maxVarianceIndex = 0;
-    float maxVarianceValue = 0.0f;
+    double maxVarianceValue = 0.0;
 
-    for (size_t i = 0; i < interClassVariance.size(); ++i)
+    for (size_t i = 0; i < histogram.size(); ++i)
     {
-        if (interClassVariance[i] > maxVarianceValue)
+        const double w1 = 1.0 - w0;
+
+        // Mean intensity values of the background and foreground
+        const double u0 = !qFuzzyIsNull(w0) ? moment0 / w0 : 0.0;
+        const double u1 = !qFuzzyIsNull(w1) ? (totalMean - moment0) / w1 : 0.0;
+
+        const double variance = w0 * w1 * std::pow(u0 - u1, 2);
+        if (variance > maxVarianceValue)
         {
-            maxVarianceValue = interClassVariance[i];
+            maxVarianceValue = variance;
             maxVarianceIndex = i;
         }
+
+        const double probability = histogram[i] * factor;
+        w0 += probability;
+        moment0 += i * probability;
     }
 
     return int(maxVarianceIndex);
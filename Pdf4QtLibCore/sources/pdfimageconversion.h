@@ -22,6 +22,8 @@
 
 #include <QImage>
 
+#include <array>
+
 namespace pdf
 {
 
@@ -81,9 +83,14 @@ public:
     QImage getConvertedImage() const;
 
 private:
-    int calculateOtsu1DThreshold() const;
+    using Histogram = std::array<int, 256>;
+
+    /// Calculates threshold using Otsu's 1D algorithm from the lightness histogram
+    /// \param histogram Histogram of lightness occurences
+    static int calculateOtsu1DThreshold(const Histogram& histogram);
 
     static constexpr int DEFAULT_THRESHOLD = 128;
+    static constexpr int BAND_HEIGHT = 64;
 
     QImage m_image;
     QImage m_convertedImage;
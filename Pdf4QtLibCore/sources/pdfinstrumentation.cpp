@@ -0,0 +1,418 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfinstrumentation.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+std::atomic_bool PDFInstrumentation::s_enabled = false;
+std::atomic_bool PDFTrace::s_enabled = false;
+
+namespace
+{
+
+/// Storage of collected values. Totals are atomic, values per page
+/// and per resource are stored in maps guarded by the mutex.
+struct PDFInstrumentationStorage
+{
+    std::array<std::atomic<qint64>, size_t(PDFInstrumentationStage::LastStage)> totalCounts = { };
+    std::array<std::atomic<qint64>, size_t(PDFInstrumentationStage::LastStage)> totalTimes = { };
+
+    QMutex mutex;
+    std::map<PDFInteger, PDFInstrumentation::StageValues> pageValues;
+    std::map<PDFObjectReference, PDFInstrumentation::StageValues> resourceValues;
+};
+
+PDFInstrumentationStorage& getStorage()
+{
+    static PDFInstrumentationStorage storage;
+    return storage;
+}
+
+thread_local PDFInteger s_currentPageIndex = -1;
+
+QJsonObject toJsonObject(const PDFInstrumentation::StageValues& values)
+{
+    QJsonObject object;
+
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const PDFInstrumentation::StageValue& value = values[i];
+        if (value.count > 0)
+        {
+            QJsonObject stageObject;
+            stageObject["count"] = value.count;
+            stageObject["time-ms"] = double(value.time) / 1000000.0;
+            object[PDFInstrumentation::getStageName(PDFInstrumentationStage(i))] = stageObject;
+        }
+    }
+
+    return object;
+}
+
+struct PDFTraceEvent
+{
+    const char* name = nullptr;
+    const char* category = nullptr;
+    qint64 startTime = 0;
+    qint64 duration = 0;
+    PDFInteger pageIndex = -1;
+};
+
+/// Buffer of trace events of one thread. Mutex is locked only by the owning thread
+/// and when trace is being cleared or written, so it is practically never contended.
+struct PDFTraceThreadBuffer
+{
+    QMutex mutex;
+    int threadId = 0;
+    QString threadName;
+    std::vector<PDFTraceEvent> events;
+};
+
+struct PDFTraceStorage
+{
+    QMutex mutex;
+    qint64 startTime = 0;
+    int lastThreadId = 0;
+    std::vector<std::shared_ptr<PDFTraceThreadBuffer>> buffers;
+};
+
+PDFTraceStorage& getTraceStorage()
+{
+    static PDFTraceStorage storage;
+    return storage;
+}
+
+thread_local std::shared_ptr<PDFTraceThreadBuffer> s_traceThreadBuffer;
+
+PDFTraceThreadBuffer* getTraceThreadBuffer()
+{
+    if (!s_traceThreadBuffer)
+    {
+        PDFTraceStorage& storage = getTraceStorage();
+        auto buffer = std::make_shared<PDFTraceThreadBuffer>();
+
+        QMutexLocker lock(&storage.mutex);
+        buffer->threadId = ++storage.lastThreadId;
+
+        QThread* thread = QThread::currentThread();
+        buffer->threadName = thread ? thread->objectName() : QString();
+        if (buffer->threadName.isEmpty())
+        {
+            buffer->threadName = QString("Thread %1").arg(buffer->threadId);
+        }
+
+        storage.buffers.push_back(buffer);
+        s_traceThreadBuffer = std::move(buffer);
+    }
+
+    return s_traceThreadBuffer.get();
+}
+
+/// Starts tracing, if environment variable PDF4QT_TRACE_FILE is set,
+/// and writes the trace to the file, when application exits.
+class PDFTraceEnvironmentActivator
+{
+public:
+    PDFTraceEnvironmentActivator() :
+        m_fileName(qEnvironmentVariable("PDF4QT_TRACE_FILE"))
+    {
+        if (!m_fileName.isEmpty())
+        {
+            PDFTrace::start();
+        }
+    }
+
+    ~PDFTraceEnvironmentActivator()
+    {
+        if (!m_fileName.isEmpty())
+        {
+            PDFTrace::stop();
+            PDFTrace::writeToFile(m_fileName);
+        }
+    }
+
+private:
+    QString m_fileName;
+};
+
+PDFTraceEnvironmentActivator s_traceEnvironmentActivator;
+
+}   // namespace
+
+void PDFInstrumentation::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void PDFInstrumentation::clear()
+{
+    PDFInstrumentationStorage& storage = getStorage();
+
+    for (size_t i = 0; i < size_t(PDFInstrumentationStage::LastStage); ++i)
+    {
+        storage.totalCounts[i].store(0, std::memory_order_relaxed);
+        storage.totalTimes[i].store(0, std::memory_order_relaxed);
+    }
+
+    QMutexLocker lock(&storage.mutex);
+    storage.pageValues.clear();
+    storage.resourceValues.clear();
+}
+
+void PDFInstrumentation::addTime(PDFInstrumentationStage stage, qint64 nanoseconds, PDFObjectReference resource)
+{
+    Q_ASSERT(stage != PDFInstrumentationStage::LastStage);
+
+    PDFInstrumentationStorage& storage = getStorage();
+    const size_t index = size_t(stage);
+
+    storage.totalCounts[index].fetch_add(1, std::memory_order_relaxed);
+    storage.totalTimes[index].fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    const PDFInteger pageIndex = s_currentPageIndex;
+    if (pageIndex >= 0 || resource.isValid())
+    {
+        QMutexLocker lock(&storage.mutex);
+
+        if (pageIndex >= 0)
+        {
+            StageValue& value = storage.pageValues[pageIndex][index];
+            ++value.count;
+            value.time += nanoseconds;
+        }
+
+        if (resource.isValid())
+        {
+            StageValue& value = storage.resourceValues[resource][index];
+            ++value.count;
+            value.time += nanoseconds;
+        }
+    }
+}
+
+PDFInteger PDFInstrumentation::getCurrentPageIndex()
+{
+    return s_currentPageIndex;
+}
+
+void PDFInstrumentation::setCurrentPageIndex(PDFInteger pageIndex)
+{
+    s_currentPageIndex = pageIndex;
+}
+
+const char* PDFInstrumentation::getStageName(PDFInstrumentationStage stage)
+{
+    switch (stage)
+    {
+        case PDFInstrumentationStage::PageCompilation:
+            return "page-compilation";
+        case PDFInstrumentationStage::PageRasterization:
+            return "page-rasterization";
+        case PDFInstrumentationStage::ContentLexing:
+            return "content-lexing";
+        case PDFInstrumentationStage::FontRealization:
+            return "font-realization";
+        case PDFInstrumentationStage::ImageDecoding:
+            return "image-decoding";
+        case PDFInstrumentationStage::ColorManagement:
+            return "color-management";
+        case PDFInstrumentationStage::ShadingMesh:
+            return "shading-mesh";
+        case PDFInstrumentationStage::PathFill:
+            return "path-fill";
+        case PDFInstrumentationStage::Text:
+            return "text";
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return "";
+}
+
+PDFInstrumentation::StageValues PDFInstrumentation::getTotalValues()
+{
+    PDFInstrumentationStorage& storage = getStorage();
+
+    StageValues values;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i].count = storage.totalCounts[i].load(std::memory_order_relaxed);
+        values[i].time = storage.totalTimes[i].load(std::memory_order_relaxed);
+    }
+
+    return values;
+}
+
+QByteArray PDFInstrumentation::toJson()
+{
+    PDFInstrumentationStorage& storage = getStorage();
+
+    QJsonObject rootObject;
+    rootObject["total"] = toJsonObject(getTotalValues());
+
+    QMutexLocker lock(&storage.mutex);
+
+    QJsonArray pagesArray;
+    for (const auto& [pageIndex, values] : storage.pageValues)
+    {
+        QJsonObject pageObject;
+        pageObject["page"] = pageIndex + 1;
+        pageObject["stages"] = toJsonObject(values);
+        pagesArray.append(pageObject);
+    }
+    rootObject["pages"] = pagesArray;
+
+    QJsonArray resourcesArray;
+    for (const auto& [reference, values] : storage.resourceValues)
+    {
+        QJsonObject resourceObject;
+        resourceObject["object"] = reference.objectNumber;
+        resourceObject["generation"] = reference.generation;
+        resourceObject["stages"] = toJsonObject(values);
+        resourcesArray.append(resourceObject);
+    }
+    rootObject["resources"] = resourcesArray;
+
+    return QJsonDocument(rootObject).toJson(QJsonDocument::Indented);
+}
+
+void PDFTrace::start()
+{
+    PDFTraceStorage& storage = getTraceStorage();
+
+    {
+        QMutexLocker lock(&storage.mutex);
+        storage.startTime = PDFInstrumentation::now();
+
+        for (const std::shared_ptr<PDFTraceThreadBuffer>& buffer : storage.buffers)
+        {
+            QMutexLocker bufferLock(&buffer->mutex);
+            buffer->events.clear();
+        }
+    }
+
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+void PDFTrace::stop()
+{
+    s_enabled.store(false, std::memory_order_relaxed);
+}
+
+void PDFTrace::addEvent(const char* name, const char* category, qint64 startTime, qint64 endTime)
+{
+    PDFTraceThreadBuffer* buffer = getTraceThreadBuffer();
+
+    PDFTraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.startTime = startTime;
+    event.duration = endTime - startTime;
+    event.pageIndex = PDFInstrumentation::getCurrentPageIndex();
+
+    QMutexLocker lock(&buffer->mutex);
+    buffer->events.push_back(event);
+}
+
+QByteArray PDFTrace::toJson()
+{
+    PDFTraceStorage& storage = getTraceStorage();
+    QMutexLocker lock(&storage.mutex);
+
+    QJsonArray eventsArray;
+    for (const std::shared_ptr<PDFTraceThreadBuffer>& buffer : storage.buffers)
+    {
+        QMutexLocker bufferLock(&buffer->mutex);
+
+        if (buffer->events.empty())
+        {
+            continue;
+        }
+
+        QJsonObject threadNameArgs;
+        threadNameArgs["name"] = buffer->threadName;
+
+        QJsonObject threadNameObject;
+        threadNameObject["name"] = "thread_name";
+        threadNameObject["ph"] = "M";
+        threadNameObject["pid"] = 1;
+        threadNameObject["tid"] = buffer->threadId;
+        threadNameObject["args"] = threadNameArgs;
+        eventsArray.append(threadNameObject);
+
+        for (const PDFTraceEvent& event : buffer->events)
+        {
+            // Times are in microseconds in the trace event format
+            QJsonObject eventObject;
+            eventObject["name"] = event.name;
+            eventObject["cat"] = event.category;
+            eventObject["ph"] = "X";
+            eventObject["ts"] = double(qMax<qint64>(event.startTime - storage.startTime, 0)) / 1000.0;
+            eventObject["dur"] = double(event.duration) / 1000.0;
+            eventObject["pid"] = 1;
+            eventObject["tid"] = buffer->threadId;
+
+            if (event.pageIndex >= 0)
+            {
+                QJsonObject argsObject;
+                argsObject["page"] = event.pageIndex + 1;
+                eventObject["args"] = argsObject;
+            }
+
+            eventsArray.append(eventObject);
+        }
+    }
+
+    QJsonObject rootObject;
+    rootObject["traceEvents"] = eventsArray;
+    rootObject["displayTimeUnit"] = "ms";
+
+    return QJsonDocument(rootObject).toJson(QJsonDocument::Compact);
+}
+
+bool PDFTrace::writeToFile(const QString& fileName)
+{
+    QFile file(fileName);
+    if (file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        file.write(toJson());
+        file.close();
+        return true;
+    }
+
+    return false;
+}
+
+}   // namespace pdf
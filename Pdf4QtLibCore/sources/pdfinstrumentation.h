@@ -0,0 +1,248 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFINSTRUMENTATION_H
+#define PDFINSTRUMENTATION_H
+
+#include "pdfglobal.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace pdf
+{
+
+/// Stages of page processing, which are measured by the instrumentation. Stages
+/// can be nested (for example, color management is a part of image decoding),
+/// so time of the stage contains time of all nested stages.
+enum class PDFInstrumentationStage
+{
+    PageCompilation,    ///< Compilation of the page (processing of content streams)
+    PageRasterization,  ///< Rasterization of the compiled page
+    ContentLexing,      ///< Lexical analysis of content streams
+    FontRealization,    ///< Realization of fonts (loading font faces and creating realized fonts)
+    ImageDecoding,      ///< Decoding of image XObjects
+    ColorManagement,    ///< Color conversion of color buffers and images
+    ShadingMesh,        ///< Creation of shading meshes
+    PathFill,           ///< Painting of paths
+    Text,               ///< Processing and painting of text
+    LastStage
+};
+
+/// Lightweight thread safe registry of counters and timers of page processing
+/// stages. Times are accumulated in total, per page and per resource (when resource
+/// reference is known). Instrumentation is turned off by default, and when it is off,
+/// each measured place costs only one relaxed atomic load. Page, to which
+/// measured values are assigned, is set per thread using \p PDFInstrumentationPageScope.
+class PDF4QTLIBCORESHARED_EXPORT PDFInstrumentation
+{
+public:
+    PDFInstrumentation() = delete;
+
+    /// Returns true, if instrumentation is enabled
+    static inline bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /// Enables or disables instrumentation. Already collected values are kept.
+    /// \param enabled Enable instrumentation
+    static void setEnabled(bool enabled);
+
+    /// Clears all collected values
+    static void clear();
+
+    /// Returns current time in nanoseconds (for measuring)
+    static inline qint64 now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    /// Adds measured time to the stage. Call count of the stage is incremented.
+    /// Value is assigned to the current page of the calling thread, and
+    /// to the resource, if it is valid.
+    /// \param stage Stage
+    /// \param nanoseconds Time in nanoseconds
+    /// \param resource Resource reference (can be invalid)
+    static void addTime(PDFInstrumentationStage stage, qint64 nanoseconds, PDFObjectReference resource = PDFObjectReference());
+
+    /// Returns page index, to which values are assigned in the calling thread
+    /// (or -1, if no page is set)
+    static PDFInteger getCurrentPageIndex();
+
+    /// Sets page index, to which values are assigned in the calling thread.
+    /// Use \p PDFInstrumentationPageScope instead of calling this function directly.
+    /// \param pageIndex Page index (or -1, if no page is set)
+    static void setCurrentPageIndex(PDFInteger pageIndex);
+
+    /// Returns name of the stage, which is used in the JSON output
+    /// \param stage Stage
+    static const char* getStageName(PDFInstrumentationStage stage);
+
+    struct StageValue
+    {
+        qint64 count = 0;
+        qint64 time = 0;    ///< Time in nanoseconds
+    };
+
+    using StageValues = std::array<StageValue, size_t(PDFInstrumentationStage::LastStage)>;
+
+    /// Returns total values of all stages
+    static StageValues getTotalValues();
+
+    /// Returns all collected values as JSON document, with total values,
+    /// values per page and values per resource (times are in milliseconds).
+    static QByteArray toJson();
+
+private:
+    static std::atomic_bool s_enabled;
+};
+
+/// Recorder of trace events of page processing, which are written in Chrome trace
+/// event format (JSON), so they can be viewed in the Perfetto UI or in chrome://tracing.
+/// Each event has a thread id and a page index (if known), so it is possible to see,
+/// which threads are waiting (for example, for a global lock) and which are working.
+/// Events are stored in per-thread buffers, so recording is not serialized.
+/// Tracing can be also started using environment variable PDF4QT_TRACE_FILE,
+/// then trace is written to the given file when the application exits.
+class PDF4QTLIBCORESHARED_EXPORT PDFTrace
+{
+public:
+    PDFTrace() = delete;
+
+    /// Returns true, if tracing is enabled
+    static inline bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /// Clears all recorded events and starts tracing
+    static void start();
+
+    /// Stops tracing, recorded events are kept
+    static void stop();
+
+    /// Adds complete event to the trace of the calling thread. Event is assigned
+    /// to the current page of the calling thread. Name and category must be
+    /// string literals (pointers are stored, not the strings).
+    /// \param name Event name
+    /// \param category Event category
+    /// \param startTime Start time (as returned by \p PDFInstrumentation::now())
+    /// \param endTime End time (as returned by \p PDFInstrumentation::now())
+    static void addEvent(const char* name, const char* category, qint64 startTime, qint64 endTime);
+
+    /// Returns all recorded events in Chrome trace event format
+    static QByteArray toJson();
+
+    /// Writes all recorded events in Chrome trace event format to the file.
+    /// Returns true, if trace was successfully written.
+    /// \param fileName File name
+    static bool writeToFile(const QString& fileName);
+
+private:
+    static std::atomic_bool s_enabled;
+};
+
+/// Measures time of the stage from construction to destruction,
+/// if instrumentation or tracing is enabled.
+class PDFInstrumentationTimer
+{
+public:
+    inline explicit PDFInstrumentationTimer(PDFInstrumentationStage stage, PDFObjectReference resource = PDFObjectReference()) :
+        m_stage(stage),
+        m_resource(resource),
+        m_startTime((PDFInstrumentation::isEnabled() || PDFTrace::isEnabled()) ? PDFInstrumentation::now() : -1)
+    {
+
+    }
+
+    inline ~PDFInstrumentationTimer()
+    {
+        if (m_startTime >= 0)
+        {
+            const qint64 endTime = PDFInstrumentation::now();
+
+            if (PDFInstrumentation::isEnabled())
+            {
+                PDFInstrumentation::addTime(m_stage, endTime - m_startTime, m_resource);
+            }
+
+            if (PDFTrace::isEnabled())
+            {
+                PDFTrace::addEvent(PDFInstrumentation::getStageName(m_stage), "stage", m_startTime, endTime);
+            }
+        }
+    }
+
+    PDFInstrumentationTimer(const PDFInstrumentationTimer&) = delete;
+    PDFInstrumentationTimer& operator=(const PDFInstrumentationTimer&) = delete;
+
+private:
+    PDFInstrumentationStage m_stage;
+    PDFObjectReference m_resource;
+    qint64 m_startTime;
+};
+
+/// Records trace event from construction to destruction, if tracing is enabled.
+/// Name and category must be string literals.
+class PDFTraceScope
+{
+public:
+    inline explicit PDFTraceScope(const char* name, const char* category) :
+        m_name(name),
+        m_category(category),
+        m_startTime(PDFTrace::isEnabled() ? PDFInstrumentation::now() : -1)
+    {
+
+    }
+
+    inline ~PDFTraceScope()
+    {
+        if (m_startTime >= 0)
+        {
+            PDFTrace::addEvent(m_name, m_category, m_startTime, PDFInstrumentation::now());
+        }
+    }
+
+    PDFTraceScope(const PDFTraceScope&) = delete;
+    PDFTraceScope& operator=(const PDFTraceScope&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_category;
+    qint64 m_startTime;
+};
+
+/// Assigns instrumentation values measured in the calling thread
+/// to the page, until the scope is destroyed.
+class PDFInstrumentationPageScope
+{
+public:
+    inline explicit PDFInstrumentationPageScope(PDFInteger pageIndex) :
+        m_oldPageIndex(PDFInstrumentation::getCurrentPageIndex())
+    {
+        PDFInstrumentation::setCurrentPageIndex(pageIndex);
+    }
+
+    inline ~PDFInstrumentationPageScope()
+    {
+        PDFInstrumentation::setCurrentPageIndex(m_oldPageIndex);
+    }
+
+    PDFInstrumentationPageScope(const PDFInstrumentationPageScope&) = delete;
+    PDFInstrumentationPageScope& operator=(const PDFInstrumentationPageScope&) = delete;
+
+private:
+    PDFInteger m_oldPageIndex;
+};
+
+}   // namespace pdf
+
+#endif // PDFINSTRUMENTATION_H
@@ -18,6 +18,11 @@
 #include "pdfjbig2decoder.h"
 #include "pdfexception.h"
 #include "pdfccittfaxdecoder.h"
+#include "pdfobject.h"
+
+#include <utility>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -337,6 +342,78 @@ struct PDFJBIG2BitmapDecodingParameters
     PDFJBIG2ArithmeticDecoder* arithmeticDecoder = nullptr;
 };
 
+/// Packed bitmap used during generic region decoding. Each pixel is stored as
+/// one bit, most significant bit of the word is the leftmost pixel. Each row
+/// has one extra zero word at the end, so readers can look ahead behind
+/// the right edge of the bitmap without bounds checking.
+struct PDFJBIG2PackedBitmap
+{
+    explicit PDFJBIG2PackedBitmap(int width, int height) :
+        width(width),
+        height(height),
+        stride((width + 31) / 32 + 1),
+        data(size_t(height) * size_t(stride), 0)
+    {
+
+    }
+
+    inline const uint32_t* getRow(int y) const { return (y >= 0 && y < height) ? data.data() + size_t(y) * stride : nullptr; }
+    inline uint32_t* getRow(int y) { return data.data() + size_t(y) * stride; }
+
+    inline uint32_t getPixelSafe(int x, int y) const
+    {
+        if (x < 0 || x >= width || y < 0 || y >= height)
+        {
+            return 0;
+        }
+
+        return (data[size_t(y) * stride + (x >> 5)] >> (31 - (x & 31))) & 1;
+    }
+
+    inline void setPixel(int x, int y) { data[size_t(y) * stride + (x >> 5)] |= 0x80000000U >> (x & 31); }
+
+    int width;
+    int height;
+    int stride;
+    std::vector<uint32_t> data;
+};
+
+/// Sequential reader of pixels from the row of packed bitmap. Pixels are read
+/// from the left to the right, from the word cached in the reader. Pixels
+/// outside of the bitmap (invalid row, left to the start) are zero.
+class PDFJBIG2PackedRowReader
+{
+public:
+    /// Creates reader of the row, reader starts at pixel 0
+    /// \param row Row of the bitmap, or nullptr, if row is outside of the bitmap
+    inline explicit PDFJBIG2PackedRowReader(const uint32_t* row) :
+        m_row(row),
+        m_word(row ? row[0] : 0)
+    {
+
+    }
+
+    /// Reads pixel and advances to the next pixel
+    inline uint32_t read()
+    {
+        const uint32_t pixel = m_word >> 31;
+        m_word <<= 1;
+
+        if (--m_bitsLeft == 0 && m_row)
+        {
+            m_word = *++m_row;
+            m_bitsLeft = 32;
+        }
+
+        return pixel;
+    }
+
+private:
+    const uint32_t* m_row;
+    uint32_t m_word;
+    int m_bitsLeft = 32;
+};
+
 /// Info structure for refinement bitmap decoding parameters
 struct PDFJBIG2BitmapRefinementDecodingParameters
 {
@@ -1139,6 +1216,24 @@ PDFImageData PDFJBIG2Decoder::decode(PDFImageData::MaskingType maskingType)
     return PDFImageData();
 }
 
+PDFJBIG2GlobalSegmentsPointer PDFJBIG2Decoder::decodeGlobalSegments(QByteArray globalData, PDFRenderErrorReporter* errorReporter)
+{
+    PDFJBIG2Decoder decoder(QByteArray(), qMove(globalData), errorReporter);
+    decoder.m_reader = PDFBitReader(&decoder.m_globalData, 8);
+    decoder.processStream();
+
+    if (decoder.m_pageBitmap.isValid())
+    {
+        // Global data contains page, state of the decoder
+        // can't be shared by multiple images.
+        return nullptr;
+    }
+
+    std::shared_ptr<PDFJBIG2GlobalSegments> globalSegments = std::make_shared<PDFJBIG2GlobalSegments>();
+    globalSegments->segments = qMove(decoder.m_segments);
+    return globalSegments;
+}
+
 PDFImageData PDFJBIG2Decoder::decodeFileStream()
 {
     m_reader = PDFBitReader(&m_data, 8);
@@ -2820,6 +2915,23 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::getBitmap(const uint32_t segmentIndex, bool remo
     PDFJBIG2Bitmap result;
 
     auto it = m_segments.find(segmentIndex);
+    if (it == m_segments.cend() && m_globalSegments)
+    {
+        // Global segments are shared, so bitmap can be only copied
+        auto globalIt = m_globalSegments->segments.find(segmentIndex);
+        if (globalIt != m_globalSegments->segments.cend())
+        {
+            const PDFJBIG2Bitmap* bitmap = globalIt->second->asBitmap();
+
+            if (!bitmap)
+            {
+                throw PDFException(PDFTranslationContext::tr("JBIG2 segment %1 is not a bitmap.").arg(segmentIndex));
+            }
+
+            return *bitmap;
+        }
+    }
+
     if (it != m_segments.cend())
     {
         PDFJBIG2Bitmap* bitmap = it->second->asBitmap();
@@ -2864,16 +2976,20 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
 
         PDFJBIG2Bitmap bitmap(data.getWidth(), data.getHeight(), m_pageDefaultPixelValue);
 
-        // Copy the data
-        PDFBitReader reader(&data.getData(), data.getBitsPerComponent());
+        // Copy the data, rows are aligned to bytes, bit 1 means white pixel
+        Q_ASSERT(data.getBitsPerComponent() == 1);
+        const QByteArray& buffer = data.getData();
+        const unsigned int width = data.getWidth();
+        const unsigned int stride = data.getStride();
         for (unsigned int row = 0; row < data.getHeight(); ++row)
         {
-            for (unsigned int column = 0; column < data.getWidth(); ++column)
+            const uint8_t* source = reinterpret_cast<const uint8_t*>(buffer.constData()) + row * stride;
+            uint8_t* target = bitmap.getRow(row);
+
+            for (unsigned int column = 0; column < width; ++column)
             {
-                bitmap.setPixel(column, row, (reader.read()) ? 0x00 : 0xFF);
+                target[column] = ((source[column >> 3] << (column & 7)) & 0x80) ? 0x00 : 0xFF;
             }
-
-            reader.alignToBytes();
         }
 
         return bitmap;
@@ -2980,6 +3096,12 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
             }
         }
 
+        if (!parameters.SKIP)
+        {
+            // Fast path - without skip bitmap, we can compute contexts incrementally
+            return readGenericBitmapPacked(parameters, LTPContext);
+        }
+
         Q_ASSERT(parameters.arithmeticDecoder);
         PDFJBIG2ArithmeticDecoder& decoder = *parameters.arithmeticDecoder;
 
@@ -3148,6 +3270,170 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
     }
 }
 
+PDFJBIG2Bitmap PDFJBIG2Decoder::readGenericBitmapPacked(PDFJBIG2BitmapDecodingParameters& parameters, uint16_t LTPContext)
+{
+    Q_ASSERT(parameters.arithmeticDecoder);
+    Q_ASSERT(!parameters.SKIP);
+    PDFJBIG2ArithmeticDecoder& decoder = *parameters.arithmeticDecoder;
+
+    const int width = parameters.GBW;
+    const int height = parameters.GBH;
+
+    if (width <= 0 || height <= 0)
+    {
+        return PDFJBIG2Bitmap(width, height, 0x00);
+    }
+
+    // Templates use pixels from previous rows up to this offset to the right
+    // of the current pixel. Pixels are shifted into the sliding registers
+    // at this offset, so register bit 0 corresponds to the rightmost pixel.
+    int lookahead1 = 0;
+    int lookahead2 = 0;
+    int adaptivePixelCount = 1;
+
+    switch (parameters.GBTEMPLATE)
+    {
+        case 0:
+            lookahead1 = 2;
+            lookahead2 = 1;
+            adaptivePixelCount = 4;
+            break;
+
+        case 1:
+            lookahead1 = 2;
+            lookahead2 = 2;
+            break;
+
+        case 2:
+            lookahead1 = 1;
+            lookahead2 = 1;
+            break;
+
+        case 3:
+            lookahead1 = 1;
+            lookahead2 = -1;
+            break;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    PDFJBIG2PackedBitmap packedBitmap(width, height);
+    uint8_t LTP = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        // Check TPGDON prediction - if we use same pixels as in previous line
+        if (parameters.TPGDON)
+        {
+            LTP = LTP ^ decoder.readBit(LTPContext, parameters.arithmeticDecoderState);
+            if (LTP)
+            {
+                if (y > 0)
+                {
+                    std::copy_n(packedBitmap.getRow(y - 1), packedBitmap.stride, packedBitmap.getRow(y));
+                }
+                continue;
+            }
+        }
+
+        PDFJBIG2PackedRowReader reader1(std::as_const(packedBitmap).getRow(y - 1));
+        PDFJBIG2PackedRowReader reader2(std::as_const(packedBitmap).getRow(y - 2));
+
+        // Sliding registers of the current row and the two previous rows. Bit k of
+        // the register of the current row is pixel x - 1 - k, bit k of the register
+        // of previous rows is pixel x + lookahead - k.
+        uint32_t line0 = 0;
+        uint32_t line1 = 0;
+        uint32_t line2 = 0;
+
+        for (int i = 0; i < lookahead1; ++i)
+        {
+            line1 = (line1 << 1) | reader1.read();
+        }
+
+        for (int i = 0; i < lookahead2; ++i)
+        {
+            line2 = (line2 << 1) | reader2.read();
+        }
+
+        for (int x = 0; x < width; ++x)
+        {
+            line1 = (line1 << 1) | reader1.read();
+            if (lookahead2 >= 0)
+            {
+                line2 = (line2 << 1) | reader2.read();
+            }
+
+            std::array<uint32_t, 4> AT = { };
+            for (int i = 0; i < adaptivePixelCount; ++i)
+            {
+                AT[i] = packedBitmap.getPixelSafe(x + parameters.GBAT[i].x, y + parameters.GBAT[i].y);
+            }
+
+            // Bit order of the contexts is the same as in the reference implementation
+            // in the function readBitmap, see figures 8-11 of the specification.
+            uint32_t pixelContext = 0;
+            switch (parameters.GBTEMPLATE)
+            {
+                case 0:
+                    pixelContext = (line0 & 0x0F) | (AT[0] << 4) | ((line1 & 0x1F) << 5) | (AT[1] << 10) | (AT[2] << 11) | ((line2 & 0x07) << 12) | (AT[3] << 15);
+                    break;
+
+                case 1:
+                    pixelContext = (line0 & 0x07) | (AT[0] << 3) | ((line1 & 0x1F) << 4) | ((line2 & 0x0F) << 9);
+                    break;
+
+                case 2:
+                    pixelContext = (line0 & 0x03) | (AT[0] << 2) | ((line1 & 0x0F) << 3) | ((line2 & 0x07) << 7);
+                    break;
+
+                case 3:
+                    pixelContext = (line0 & 0x0F) | (AT[0] << 4) | ((line1 & 0x1F) << 5);
+                    break;
+
+                default:
+                    Q_ASSERT(false);
+                    break;
+            }
+
+            const uint32_t pixel = decoder.readBit(pixelContext, parameters.arithmeticDecoderState);
+            line0 = (line0 << 1) | pixel;
+
+            if (pixel)
+            {
+                packedBitmap.setPixel(x, y);
+            }
+        }
+    }
+
+    // Expand packed bitmap to the bitmap with byte per pixel
+    PDFJBIG2Bitmap bitmap(width, height, 0x00);
+    for (int y = 0; y < height; ++y)
+    {
+        const uint32_t* source = std::as_const(packedBitmap).getRow(y);
+        uint8_t* target = bitmap.getRow(y);
+
+        for (int x = 0; x < width; x += 32)
+        {
+            const uint32_t word = source[x >> 5];
+            if (!word)
+            {
+                continue;
+            }
+
+            const int count = qMin(32, width - x);
+            for (int i = 0; i < count; ++i)
+            {
+                target[x + i] = ((word << i) & 0x80000000U) ? 0xFF : 0x00;
+            }
+        }
+    }
+
+    return bitmap;
+}
+
 PDFJBIG2Bitmap PDFJBIG2Decoder::readRefinementBitmap(PDFJBIG2BitmapRefinementDecodingParameters& parameters)
 {
     // Use algorithm described in 6.3.5.6
@@ -3562,10 +3848,8 @@ PDFJBIG2ReferencedSegments PDFJBIG2Decoder::getReferencedSegments(const PDFJBIG2
 
     for (const uint32_t referredSegmentId : header.getReferredSegments())
     {
-        auto it = m_segments.find(referredSegmentId);
-        if (it != m_segments.cend() && it->second)
+        if (const PDFJBIG2Segment* referredSegment = findSegment(referredSegmentId))
         {
-            const PDFJBIG2Segment* referredSegment = it->second.get();
             if (const PDFJBIG2Bitmap* bitmap = referredSegment->asBitmap())
             {
                 segments.bitmaps.push_back(bitmap);
@@ -3596,6 +3880,26 @@ PDFJBIG2ReferencedSegments PDFJBIG2Decoder::getReferencedSegments(const PDFJBIG2
     return segments;
 }
 
+const PDFJBIG2Segment* PDFJBIG2Decoder::findSegment(uint32_t segmentNumber) const
+{
+    auto it = m_segments.find(segmentNumber);
+    if (it != m_segments.cend())
+    {
+        return it->second.get();
+    }
+
+    if (m_globalSegments)
+    {
+        auto globalIt = m_globalSegments->segments.find(segmentNumber);
+        if (globalIt != m_globalSegments->segments.cend())
+        {
+            return globalIt->second.get();
+        }
+    }
+
+    return nullptr;
+}
+
 void PDFJBIG2Decoder::checkBitmapSize(const uint32_t size)
 {
     if (size > MAX_BITMAP_SIZE)
@@ -3977,4 +4281,59 @@ PDFJBIG2HuffmanDecoder PDFJBIG2ReferencedSegments::getUserTable(PDFBitReader* re
     }
 }
 
+PDFJBIG2GlobalSegmentsCache* PDFJBIG2GlobalSegmentsCache::getInstance()
+{
+    static PDFJBIG2GlobalSegmentsCache cache;
+    return &cache;
+}
+
+PDFJBIG2GlobalSegmentsPointer PDFJBIG2GlobalSegmentsCache::getGlobalSegments(const PDFStream* stream,
+                                                                            const GetGlobalData& getGlobalData,
+                                                                            PDFRenderErrorReporter* errorReporter)
+{
+    // Streams not owned by the document can't be pinned in the cache,
+    // their address can be reused by another stream.
+    std::shared_ptr<const PDFStream> streamPointer = stream->weak_from_this().lock();
+    if (!streamPointer)
+    {
+        return PDFJBIG2Decoder::decodeGlobalSegments(getGlobalData(), errorReporter);
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        auto it = std::find_if(m_items.begin(), m_items.end(), [stream](const Item& item) { return item.stream.get() == stream; });
+        if (it != m_items.end())
+        {
+            // Move item to the front (most recently used)
+            m_items.splice(m_items.begin(), m_items, it);
+            return m_items.front().segments;
+        }
+    }
+
+    // Decode segments outside the lock, if more threads decode the
+    // same segments at once, result of the first one is stored.
+    PDFJBIG2GlobalSegmentsPointer segments = PDFJBIG2Decoder::decodeGlobalSegments(getGlobalData(), errorReporter);
+
+    QMutexLocker lock(&m_mutex);
+    auto it = std::find_if(m_items.begin(), m_items.end(), [stream](const Item& item) { return item.stream.get() == stream; });
+    if (it != m_items.end())
+    {
+        return it->segments;
+    }
+
+    m_items.push_front(Item{ qMove(streamPointer), segments });
+    if (m_items.size() > MAX_ITEMS)
+    {
+        m_items.pop_back();
+    }
+
+    return segments;
+}
+
+void PDFJBIG2GlobalSegmentsCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_items.clear();
+}
+
 }   // namespace pdf
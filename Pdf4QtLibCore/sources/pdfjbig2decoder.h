@@ -21,7 +21,12 @@
 #include "pdfutils.h"
 #include "pdfcolorspaces.h"
 
+#include <QMutex>
+
+#include <list>
+#include <memory>
 #include <optional>
+#include <functional>
 
 namespace pdf
 {
@@ -339,6 +344,7 @@ public:
     inline int getPixelCount() const { return m_width * m_height; }
     inline uint8_t getPixel(int x, int y) const { return m_data[y * m_width + x]; }
     inline void setPixel(int x, int y, uint8_t value) { m_data[y * m_width + x] = value; }
+    inline uint8_t* getRow(int y) { return m_data.data() + y * m_width; }
 
     inline uint8_t getPixelSafe(int x, int y) const
     {
@@ -424,6 +430,15 @@ struct PDFJBIG2ATPosition
 
 using PDFJBIG2ATPositions = std::array<PDFJBIG2ATPosition, 4>;
 
+/// Decoded global segments of the JBIG2 stream (stream JBIG2Globals in the PDF).
+/// Segments are read only, so they can be shared by decoders of multiple images.
+struct PDFJBIG2GlobalSegments
+{
+    std::map<uint32_t, std::unique_ptr<PDFJBIG2Segment>> segments;
+};
+
+using PDFJBIG2GlobalSegmentsPointer = std::shared_ptr<const PDFJBIG2GlobalSegments>;
+
 /// Decoder of JBIG2 data streams. Decodes the black/white monochrome image.
 /// Handles also global segments. Decoder decodes data using the specification
 /// ISO/IEC 14492:2001, T.88.
@@ -451,6 +466,18 @@ public:
 
     ~PDFJBIG2Decoder();
 
+    /// Sets decoded global segments, which are used instead of the global data
+    /// \param globalSegments Global segments
+    void setGlobalSegments(PDFJBIG2GlobalSegmentsPointer globalSegments) { m_globalSegments = qMove(globalSegments); }
+
+    /// Decodes global segments from the global data. If global data contains
+    /// segments, which can't be shared by multiple decoders (for example,
+    /// page information), then nullptr is returned. If error occurs,
+    /// then exception is thrown.
+    /// \param globalData Global data
+    /// \param errorReporter Error reporter
+    static PDFJBIG2GlobalSegmentsPointer decodeGlobalSegments(QByteArray globalData, PDFRenderErrorReporter* errorReporter);
+
     /// Decodes image interpreting the data as JBIG2 data stream. If image cannot
     /// be decoded, exception is thrown (or invalid PDFImageData is returned).
     /// \param maskingType Image masking type
@@ -492,6 +519,13 @@ private:
     /// \param parameters Decoding parameters
     PDFJBIG2Bitmap readBitmap(PDFJBIG2BitmapDecodingParameters& parameters);
 
+    /// Reads generic region bitmap using arithmetic decoding without skip bitmap.
+    /// Bitmap is decoded into packed bitmap (one bit per pixel), and pixel context
+    /// is computed incrementally from sliding row words.
+    /// \param parameters Decoding parameters
+    /// \param LTPContext Context of the typical prediction bit
+    PDFJBIG2Bitmap readGenericBitmapPacked(PDFJBIG2BitmapDecodingParameters& parameters, uint16_t LTPContext);
+
     /// Reads refined bitmap using decoding parameters
     /// \param parameters Decoding parameters
     PDFJBIG2Bitmap readRefinementBitmap(PDFJBIG2BitmapRefinementDecodingParameters& parameters);
@@ -514,6 +548,12 @@ private:
     /// \param header Header, from which referred segments are read
     PDFJBIG2ReferencedSegments getReferencedSegments(const PDFJBIG2SegmentHeader& header) const;
 
+    /// Returns segment with given number, segments of the current data are
+    /// searched first, then global segments. If segment is not found,
+    /// then nullptr is returned.
+    /// \param segmentNumber Segment number
+    const PDFJBIG2Segment* findSegment(uint32_t segmentNumber) const;
+
     static void checkBitmapSize(const uint32_t size);
     static void checkRegionSegmentInformationField(const PDFJBIG2RegionSegmentInformationField& field);
     static int32_t checkInteger(std::optional<int32_t> value);
@@ -523,6 +563,7 @@ private:
     PDFRenderErrorReporter* m_errorReporter;
     PDFBitReader m_reader;
     std::map<uint32_t, std::unique_ptr<PDFJBIG2Segment>> m_segments;
+    PDFJBIG2GlobalSegmentsPointer m_globalSegments;
     uint8_t m_pageDefaultPixelValue;
     PDFJBIG2BitOperation m_pageDefaultCompositionOperator;
     bool m_pageDefaultCompositionOperatorOverriden;
@@ -530,6 +571,46 @@ private:
     PDFJBIG2Bitmap m_pageBitmap;
 };
 
+/// Cache of decoded JBIG2 global segments. Scanned documents usually share
+/// one JBIG2Globals stream by all pages, so global segments (symbol dictionaries,
+/// huffman tables) are decoded only once. Decoded segments are read only and
+/// they are shared by decoders in all threads. Cache is thread safe, only few
+/// most recently used global streams are kept.
+class PDF4QTLIBCORESHARED_EXPORT PDFJBIG2GlobalSegmentsCache
+{
+public:
+    static PDFJBIG2GlobalSegmentsCache* getInstance();
+
+    using GetGlobalData = std::function<QByteArray()>;
+
+    /// Returns decoded global segments of the stream. If segments are not in the
+    /// cache, then they are decoded from the data returned by \p getGlobalData.
+    /// Streams not owned by the document are not cached. If global segments
+    /// can't be shared, nullptr is returned. If error occurs, exception is thrown.
+    /// \param stream Stream with global data
+    /// \param getGlobalData Function returning decoded global data
+    /// \param errorReporter Error reporter
+    PDFJBIG2GlobalSegmentsPointer getGlobalSegments(const PDFStream* stream, const GetGlobalData& getGlobalData, PDFRenderErrorReporter* errorReporter);
+
+    /// Removes all items from the cache
+    void clear();
+
+private:
+    explicit PDFJBIG2GlobalSegmentsCache() = default;
+
+    /// Maximal number of cached global streams
+    static constexpr size_t MAX_ITEMS = 16;
+
+    struct Item
+    {
+        std::shared_ptr<const PDFStream> stream;
+        PDFJBIG2GlobalSegmentsPointer segments;
+    };
+
+    QMutex m_mutex;
+    std::list<Item> m_items;
+};
+
 }   // namespace pdf
 
 #endif // PDFJBIG2DECODER_H
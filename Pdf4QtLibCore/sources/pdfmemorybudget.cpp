@@ -0,0 +1,277 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfmemorybudget.h"
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFMemoryBudgetClient::PDFMemoryBudgetClient(const char* name, int evictionCost, qint64 defaultMemoryLimit) :
+    m_name(name),
+    m_evictionCost(qMax(evictionCost, 1)),
+    m_defaultMemoryLimit(qMax(defaultMemoryLimit, qint64(0))),
+    m_memoryLimit(qMax(defaultMemoryLimit, qint64(0))),
+    m_memoryConsumption(0),
+    m_isHibernated(false)
+{
+
+}
+
+PDFMemoryBudgetClient::~PDFMemoryBudgetClient()
+{
+
+}
+
+void PDFMemoryBudgetClient::registerMemoryBudgetClient()
+{
+    PDFMemoryBudget::getInstance()->registerClient(this);
+}
+
+void PDFMemoryBudgetClient::unregisterMemoryBudgetClient()
+{
+    PDFMemoryBudget::getInstance()->unregisterClient(this);
+}
+
+void PDFMemoryBudgetClient::setDefaultMemoryLimit(qint64 defaultMemoryLimit)
+{
+    m_defaultMemoryLimit.store(qMax(defaultMemoryLimit, qint64(0)), std::memory_order_relaxed);
+
+    PDFMemoryBudget* budget = PDFMemoryBudget::getInstance();
+    if (budget->getBudget() > 0)
+    {
+        budget->rebalance();
+    }
+    else
+    {
+        m_memoryLimit.store(!isHibernated() ? getDefaultMemoryLimit() : 0, std::memory_order_relaxed);
+    }
+}
+
+void PDFMemoryBudgetClient::reportMemoryConsumption(qint64 memoryConsumption)
+{
+    PDFMemoryBudget* budget = PDFMemoryBudget::getInstance();
+    if (budget->updateMemoryConsumption(this, memoryConsumption))
+    {
+        budget->rebalance();
+    }
+}
+
+void PDFMemoryBudgetClient::setMemoryConsumption(qint64 memoryConsumption)
+{
+    PDFMemoryBudget::getInstance()->updateMemoryConsumption(this, memoryConsumption);
+}
+
+PDFMemoryBudget* PDFMemoryBudget::getInstance()
+{
+    static PDFMemoryBudget budget;
+    return &budget;
+}
+
+void PDFMemoryBudget::setBudget(qint64 budget)
+{
+    m_budget.store(qMax(budget, qint64(0)), std::memory_order_relaxed);
+    rebalance();
+}
+
+std::vector<PDFMemoryBudget::ClientInfo> PDFMemoryBudget::getClientInfos() const
+{
+    std::vector<ClientInfo> infos;
+
+    QMutexLocker lock(&m_mutex);
+    infos.reserve(m_clients.size());
+    for (const PDFMemoryBudgetClient* client : m_clients)
+    {
+        ClientInfo info;
+        info.name = QString::fromLatin1(client->getMemoryBudgetClientName());
+        info.evictionCost = client->getEvictionCost();
+        info.memoryConsumption = client->getReportedMemoryConsumption();
+        info.memoryLimit = client->getMemoryLimit();
+        infos.emplace_back(qMove(info));
+    }
+
+    return infos;
+}
+
+void PDFMemoryBudget::rebalance()
+{
+    if (m_isRebalancing.exchange(true, std::memory_order_acquire))
+    {
+        // Budget is being rebalanced by another thread
+        return;
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        computeMemoryLimits();
+
+        // Clients never call the budget while holding their own locks,
+        // so they can be trimmed here, while the client list is locked.
+        for (PDFMemoryBudgetClient* client : m_clients)
+        {
+            if (client->getReportedMemoryConsumption() > client->getMemoryLimit())
+            {
+                client->trimMemory();
+            }
+        }
+    }
+
+    m_isRebalancing.store(false, std::memory_order_release);
+}
+
+void PDFMemoryBudget::setHibernated(const std::vector<PDFMemoryBudgetClient*>& clients, bool hibernated)
+{
+    QMutexLocker lock(&m_mutex);
+
+    std::vector<PDFMemoryBudgetClient*> changedClients;
+    for (PDFMemoryBudgetClient* client : clients)
+    {
+        Q_ASSERT(std::find(m_clients.cbegin(), m_clients.cend(), client) != m_clients.cend());
+        if (client->m_isHibernated.exchange(hibernated, std::memory_order_relaxed) != hibernated)
+        {
+            changedClients.push_back(client);
+        }
+    }
+
+    if (changedClients.empty())
+    {
+        return;
+    }
+
+    computeMemoryLimits();
+
+    // Hibernated clients evict all items, woken up clients apply
+    // their restored limits. Other clients can only get more memory.
+    for (PDFMemoryBudgetClient* client : changedClients)
+    {
+        client->trimMemory();
+    }
+}
+
+void PDFMemoryBudget::registerClient(PDFMemoryBudgetClient* client)
+{
+    QMutexLocker lock(&m_mutex);
+    Q_ASSERT(std::find(m_clients.cbegin(), m_clients.cend(), client) == m_clients.cend());
+    m_clients.push_back(client);
+    computeMemoryLimits();
+}
+
+void PDFMemoryBudget::unregisterClient(PDFMemoryBudgetClient* client)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = std::find(m_clients.begin(), m_clients.end(), client);
+    if (it != m_clients.end())
+    {
+        m_clients.erase(it);
+        m_totalMemoryConsumption.fetch_sub(client->m_memoryConsumption.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        computeMemoryLimits();
+    }
+}
+
+bool PDFMemoryBudget::updateMemoryConsumption(PDFMemoryBudgetClient* client, qint64 memoryConsumption)
+{
+    const qint64 oldMemoryConsumption = client->m_memoryConsumption.exchange(memoryConsumption, std::memory_order_relaxed);
+    const qint64 totalMemoryConsumption = m_totalMemoryConsumption.fetch_add(memoryConsumption - oldMemoryConsumption, std::memory_order_relaxed) + memoryConsumption - oldMemoryConsumption;
+
+    const qint64 budget = getBudget();
+    // Rebalance also when the client is near its limit, it may borrow unused memory of other clients
+    return budget > 0 && (totalMemoryConsumption > budget || memoryConsumption + memoryConsumption / 16 >= client->getMemoryLimit());
+}
+
+void PDFMemoryBudget::computeMemoryLimits()
+{
+    const qint64 budget = getBudget();
+
+    // Hibernated clients do not get any memory
+    std::vector<PDFMemoryBudgetClient*> activeClients;
+    activeClients.reserve(m_clients.size());
+    for (PDFMemoryBudgetClient* client : m_clients)
+    {
+        if (client->isHibernated())
+        {
+            client->m_memoryLimit.store(0, std::memory_order_relaxed);
+        }
+        else
+        {
+            activeClients.push_back(client);
+        }
+    }
+
+    if (budget <= 0)
+    {
+        for (PDFMemoryBudgetClient* client : activeClients)
+        {
+            client->m_memoryLimit.store(client->getDefaultMemoryLimit(), std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    // Each client is guaranteed part of the budget proportional to its eviction cost.
+    // Guaranteed memory not used by clients below their guarantee is lent
+    // to clients, which use all of their guaranteed memory.
+    qint64 totalEvictionCost = 0;
+    for (const PDFMemoryBudgetClient* client : activeClients)
+    {
+        totalEvictionCost += client->getEvictionCost();
+    }
+
+    if (totalEvictionCost == 0)
+    {
+        return;
+    }
+
+    auto getGuaranteedMemory = [budget, totalEvictionCost](const PDFMemoryBudgetClient* client)
+    {
+        return qint64(double(budget) * client->getEvictionCost() / totalEvictionCost);
+    };
+
+    qint64 unusedMemory = 0;
+    qint64 borrowersEvictionCost = 0;
+    for (const PDFMemoryBudgetClient* client : activeClients)
+    {
+        const qint64 guaranteedMemory = getGuaranteedMemory(client);
+        const qint64 memoryConsumption = client->getReportedMemoryConsumption();
+
+        if (memoryConsumption < guaranteedMemory)
+        {
+            unusedMemory += guaranteedMemory - memoryConsumption;
+        }
+        else
+        {
+            borrowersEvictionCost += client->getEvictionCost();
+        }
+    }
+
+    for (PDFMemoryBudgetClient* client : activeClients)
+    {
+        const qint64 guaranteedMemory = getGuaranteedMemory(client);
+        qint64 memoryLimit = guaranteedMemory;
+
+        if (borrowersEvictionCost > 0 && client->getReportedMemoryConsumption() >= guaranteedMemory)
+        {
+            memoryLimit += qint64(double(unusedMemory) * client->getEvictionCost() / borrowersEvictionCost);
+        }
+
+        client->m_memoryLimit.store(memoryLimit, std::memory_order_relaxed);
+    }
+}
+
+}   // namespace pdf
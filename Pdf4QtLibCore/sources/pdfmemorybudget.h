@@ -0,0 +1,174 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFMEMORYBUDGET_H
+#define PDFMEMORYBUDGET_H
+
+#include "pdfglobal.h"
+
+#include <QMutex>
+
+#include <atomic>
+#include <vector>
+
+namespace pdf
+{
+class PDFMemoryBudget;
+
+/// Cache, which is managed by the global memory budget. Cache reports its memory
+/// consumption and evicts items, until its consumption is below the memory limit
+/// returned by \p getMemoryLimit. If the budget is not set, memory limit is
+/// the default memory limit of the cache. Otherwise, limit is assigned by the budget.
+/// Derived class must call \p registerMemoryBudgetClient in the constructor and
+/// \p unregisterMemoryBudgetClient in the destructor.
+class PDF4QTLIBCORESHARED_EXPORT PDFMemoryBudgetClient
+{
+public:
+    /// Creates new memory budget client
+    /// \param name Name of the cache
+    /// \param evictionCost Relative cost of eviction (cost of recreating evicted items),
+    ///        caches with higher cost get larger part of the budget
+    /// \param defaultMemoryLimit Memory limit of the cache, if the budget is not set
+    explicit PDFMemoryBudgetClient(const char* name, int evictionCost, qint64 defaultMemoryLimit);
+    virtual ~PDFMemoryBudgetClient();
+
+    PDFMemoryBudgetClient(const PDFMemoryBudgetClient&) = delete;
+    PDFMemoryBudgetClient& operator=(const PDFMemoryBudgetClient&) = delete;
+
+    const char* getMemoryBudgetClientName() const { return m_name; }
+    int getEvictionCost() const { return m_evictionCost; }
+    qint64 getDefaultMemoryLimit() const { return m_defaultMemoryLimit.load(std::memory_order_relaxed); }
+
+    /// Returns current memory limit of the cache (in bytes)
+    qint64 getMemoryLimit() const { return m_memoryLimit.load(std::memory_order_relaxed); }
+
+    /// Returns last reported memory consumption of the cache (in bytes)
+    qint64 getReportedMemoryConsumption() const { return m_memoryConsumption.load(std::memory_order_relaxed); }
+
+    /// Returns true, if cache is hibernated (its memory limit is zero)
+    bool isHibernated() const { return m_isHibernated.load(std::memory_order_relaxed); }
+
+protected:
+    void registerMemoryBudgetClient();
+    void unregisterMemoryBudgetClient();
+
+    /// Sets memory limit of the cache, which is used, if the budget is not set
+    /// \param defaultMemoryLimit Default memory limit (in bytes)
+    void setDefaultMemoryLimit(qint64 defaultMemoryLimit);
+
+    /// Reports memory consumption of the cache. If total memory consumption
+    /// exceeds the budget, or the cache exceeds its own limit, the budget
+    /// is rebalanced. Never call this function while holding a lock,
+    /// which is also used in \p trimMemory.
+    /// \param memoryConsumption Current memory consumption (in bytes)
+    void reportMemoryConsumption(qint64 memoryConsumption);
+
+    /// Evicts items from the cache, until memory consumption is below the memory limit.
+    /// Function can be called from any thread and must not call \p reportMemoryConsumption
+    /// synchronously, use \p setMemoryConsumption instead. It is also called, when
+    /// the cache wakes up from hibernation, so the cache can apply its new memory limit.
+    virtual void trimMemory() = 0;
+
+    /// Sets memory consumption of the cache without rebalancing the budget
+    /// \param memoryConsumption Current memory consumption (in bytes)
+    void setMemoryConsumption(qint64 memoryConsumption);
+
+private:
+    friend class PDFMemoryBudget;
+
+    const char* m_name;
+    int m_evictionCost;
+    std::atomic<qint64> m_defaultMemoryLimit;
+    std::atomic<qint64> m_memoryLimit;
+    std::atomic<qint64> m_memoryConsumption;
+    std::atomic_bool m_isHibernated;
+};
+
+/// Global memory budget shared by all registered caches (compiled pages, images,
+/// glyphs, ...). If the budget is set, each cache is guaranteed a part of the budget
+/// proportional to its eviction cost. Part of the guaranteed memory, which is not
+/// used by the cache, is lent to caches needing more memory. When total memory
+/// consumption exceeds the budget, limits are recomputed and caches exceeding
+/// their new limits are trimmed.
+class PDF4QTLIBCORESHARED_EXPORT PDFMemoryBudget
+{
+public:
+    /// Returns global instance of the memory budget
+    static PDFMemoryBudget* getInstance();
+
+    /// Sets memory budget (in bytes), zero means no budget
+    /// (each cache uses its default memory limit).
+    /// \param budget Memory budget
+    void setBudget(qint64 budget);
+
+    /// Returns memory budget (in bytes), zero means no budget
+    qint64 getBudget() const { return m_budget.load(std::memory_order_relaxed); }
+
+    /// Returns total memory consumption of all registered caches (in bytes)
+    qint64 getTotalMemoryConsumption() const { return m_totalMemoryConsumption.load(std::memory_order_relaxed); }
+
+    struct ClientInfo
+    {
+        QString name;
+        int evictionCost = 0;
+        qint64 memoryConsumption = 0;
+        qint64 memoryLimit = 0;
+    };
+
+    /// Returns informations about all registered caches
+    std::vector<ClientInfo> getClientInfos() const;
+
+    /// Recomputes memory limits of all caches and trims caches
+    /// exceeding their limits. If the budget is being rebalanced
+    /// by another thread, function does nothing.
+    void rebalance();
+
+    /// Hibernates caches (for example, caches of the document, which is not
+    /// used for a long time) or wakes them up. Memory limit of the hibernated
+    /// cache is zero, so all of its items are evicted, and its part of the
+    /// budget is divided between other caches. When the cache wakes up,
+    /// its memory limit is restored.
+    /// \param clients Caches
+    /// \param hibernated Hibernate (true) or wake up (false) caches
+    void setHibernated(const std::vector<PDFMemoryBudgetClient*>& clients, bool hibernated);
+
+private:
+    friend class PDFMemoryBudgetClient;
+
+    PDFMemoryBudget() = default;
+
+    void registerClient(PDFMemoryBudgetClient* client);
+    void unregisterClient(PDFMemoryBudgetClient* client);
+
+    /// Updates memory consumption of the client and total memory
+    /// consumption. Returns true, if budget should be rebalanced.
+    bool updateMemoryConsumption(PDFMemoryBudgetClient* client, qint64 memoryConsumption);
+
+    /// Computes memory limits of the clients, must be called with locked mutex
+    void computeMemoryLimits();
+
+    mutable QMutex m_mutex;
+    std::vector<PDFMemoryBudgetClient*> m_clients;
+    std::atomic<qint64> m_budget = 0;
+    std::atomic<qint64> m_totalMemoryConsumption = 0;
+    std::atomic_bool m_isRebalancing = false;
+};
+
+}   // namespace pdf
+
+#endif // PDFMEMORYBUDGET_H
@@ -0,0 +1,280 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfmeshcache.h"
+#include "pdfpattern.h"
+#include "pdfcms.h"
+#include "pdfoperationcontrol.h"
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+/// Quantization factor of the pattern space to page space matrix
+static constexpr const PDFReal MESH_MATRIX_QUANTIZATION = 1024.0;
+
+/// Relative tolerance, used when mesh resolutions are compared
+static constexpr const PDFReal MESH_RESOLUTION_TOLERANCE = 0.001;
+
+PDFMeshCache::PDFMeshCache(qint64 memoryLimit) :
+    PDFMemoryBudgetClient("mesh-cache", 2, memoryLimit)
+{
+    registerMemoryBudgetClient();
+}
+
+PDFMeshCache::~PDFMeshCache()
+{
+    unregisterMemoryBudgetClient();
+}
+
+bool PDFMeshCache::isCacheable(const PDFShadingPattern* shadingPattern)
+{
+    switch (shadingPattern->getShadingType())
+    {
+        case ShadingType::FreeFormGouradTriangle:
+        case ShadingType::LatticeFormGouradTriangle:
+        case ShadingType::CoonsPatchMesh:
+        case ShadingType::TensorProductPatchMesh:
+            return static_cast<const PDFType4567Shading*>(shadingPattern)->getShadingReference().isValid();
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+PDFMesh PDFMeshCache::getMesh(const PDFShadingPattern* shadingPattern,
+                              const PDFMeshQualitySettings& settings,
+                              const QTransform& pagePointToDevicePointMatrix,
+                              const PDFCMS* cms,
+                              RenderingIntent intent,
+                              PDFRenderErrorReporter* reporter,
+                              const PDFOperationControl* operationControl)
+{
+    if (!isCacheable(shadingPattern) || !pagePointToDevicePointMatrix.isInvertible())
+    {
+        return shadingPattern->createMesh(settings, cms, intent, reporter, operationControl);
+    }
+
+    // Mesh is generated in the page space, so it can be reused for all zoom levels.
+    // Mesh resolution is proportional to the meshing area, so page space mesh has
+    // the same density as the mesh generated in the device space.
+    const QTransform devicePointToPagePointMatrix = pagePointToDevicePointMatrix.inverted();
+    PDFMeshQualitySettings pageSpaceSettings = settings;
+    pageSpaceSettings.userSpaceToDeviceSpaceMatrix = settings.userSpaceToDeviceSpaceMatrix * devicePointToPagePointMatrix;
+    pageSpaceSettings.deviceSpaceMeshingArea = devicePointToPagePointMatrix.mapRect(settings.deviceSpaceMeshingArea);
+
+    if (!pageSpaceSettings.deviceSpaceMeshingArea.isValid())
+    {
+        return shadingPattern->createMesh(settings, cms, intent, reporter, operationControl);
+    }
+
+    pageSpaceSettings.initResolution();
+
+    const QTransform patternSpaceToPageSpaceMatrix = shadingPattern->getPatternSpaceToDeviceSpaceMatrix(pageSpaceSettings);
+    auto quantize = [](PDFReal value) { return qint64(qRound64(value * MESH_MATRIX_QUANTIZATION)); };
+
+    Key key;
+    key.reference = static_cast<const PDFType4567Shading*>(shadingPattern)->getShadingReference();
+    key.cmsSerialNumber = cms->getSerialNumber();
+    key.intent = intent;
+    key.matrix = { quantize(patternSpaceToPageSpaceMatrix.m11()),
+                   quantize(patternSpaceToPageSpaceMatrix.m12()),
+                   quantize(patternSpaceToPageSpaceMatrix.m21()),
+                   quantize(patternSpaceToPageSpaceMatrix.m22()),
+                   quantize(patternSpaceToPageSpaceMatrix.dx()),
+                   quantize(patternSpaceToPageSpaceMatrix.dy()) };
+    key.tolerance = pageSpaceSettings.tolerance;
+    key.patchTestPoints = pageSpaceSettings.patchTestPoints;
+    key.patchResolutionMappingRatioLow = pageSpaceSettings.patchResolutionMappingRatioLow;
+    key.patchResolutionMappingRatioHigh = pageSpaceSettings.patchResolutionMappingRatioHigh;
+
+    std::shared_ptr<const PDFMesh> cachedMesh = find(key, pageSpaceSettings);
+    if (!cachedMesh)
+    {
+        cachedMesh = std::make_shared<const PDFMesh>(shadingPattern->createMesh(pageSpaceSettings, cms, intent, reporter, operationControl));
+
+        // Mesh of the cancelled operation can be incomplete
+        if (!PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            insert(key, pageSpaceSettings, cachedMesh);
+        }
+    }
+
+    PDFMesh mesh = *cachedMesh;
+    mesh.transform(pagePointToDevicePointMatrix);
+
+    // Mesh can be created on another page, which has different size,
+    // so background must be painted in the current meshing area.
+    if (mesh.getBackgroundColor().isValid())
+    {
+        QPainterPath path;
+        path.addRect(settings.deviceSpaceMeshingArea);
+        mesh.setBackgroundPath(path);
+    }
+
+    return mesh;
+}
+
+void PDFMeshCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_itemMap.clear();
+    m_items.clear();
+    m_memoryConsumption = 0;
+    lock.unlock();
+
+    setMemoryConsumption(0);
+}
+
+qint64 PDFMeshCache::getMemoryConsumption() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryConsumption;
+}
+
+size_t PDFMeshCache::KeyHash::operator()(const Key& key) const
+{
+    size_t seed = std::hash<PDFInteger>()(key.reference.objectNumber);
+    auto combine = [&seed](size_t value) { seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2); };
+
+    combine(std::hash<PDFInteger>()(key.reference.generation));
+    combine(std::hash<quint64>()(key.cmsSerialNumber));
+    combine(static_cast<size_t>(key.intent));
+    for (qint64 value : key.matrix)
+    {
+        combine(std::hash<qint64>()(value));
+    }
+    combine(std::hash<PDFReal>()(key.tolerance));
+    combine(std::hash<PDFInteger>()(key.patchTestPoints));
+    return seed;
+}
+
+std::shared_ptr<const PDFMesh> PDFMeshCache::find(const Key& key, const PDFMeshQualitySettings& settings)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_itemMap.find(key);
+    if (it == m_itemMap.cend())
+    {
+        return nullptr;
+    }
+
+    // Find the coarsest mesh, which is at least as fine as requested,
+    // but not finer than maximal refinement ratio allows.
+    const PDFReal minimalResolutionLimit = settings.minimalMeshResolution * (1.0 + MESH_RESOLUTION_TOLERANCE);
+    const PDFReal preferredResolutionLimit = settings.preferredMeshResolution * (1.0 + MESH_RESOLUTION_TOLERANCE);
+
+    auto bestItemIt = m_items.end();
+    for (Items::iterator itemIt : it->second)
+    {
+        const Item& item = *itemIt;
+
+        const bool isFineEnough = item.minimalMeshResolution <= minimalResolutionLimit &&
+                                  item.preferredMeshResolution <= preferredResolutionLimit;
+        const bool isNotTooFine = item.minimalMeshResolution * MAXIMAL_REFINEMENT_RATIO >= settings.minimalMeshResolution &&
+                                  item.preferredMeshResolution * MAXIMAL_REFINEMENT_RATIO >= settings.preferredMeshResolution;
+
+        if (isFineEnough && isNotTooFine && (bestItemIt == m_items.end() || bestItemIt->minimalMeshResolution < item.minimalMeshResolution))
+        {
+            bestItemIt = itemIt;
+        }
+    }
+
+    if (bestItemIt == m_items.end())
+    {
+        return nullptr;
+    }
+
+    // Mark item as recently used
+    m_items.splice(m_items.begin(), m_items, bestItemIt);
+    return bestItemIt->mesh;
+}
+
+void PDFMeshCache::insert(const Key& key, const PDFMeshQualitySettings& settings, std::shared_ptr<const PDFMesh> mesh)
+{
+    QMutexLocker lock(&m_mutex);
+
+    Levels& levels = m_itemMap[key];
+    for (Items::iterator itemIt : levels)
+    {
+        if (qAbs(itemIt->minimalMeshResolution - settings.minimalMeshResolution) <= settings.minimalMeshResolution * MESH_RESOLUTION_TOLERANCE &&
+            qAbs(itemIt->preferredMeshResolution - settings.preferredMeshResolution) <= settings.preferredMeshResolution * MESH_RESOLUTION_TOLERANCE)
+        {
+            // Mesh was inserted by another thread meanwhile
+            return;
+        }
+    }
+
+    Item item;
+    item.key = key;
+    item.minimalMeshResolution = settings.minimalMeshResolution;
+    item.preferredMeshResolution = settings.preferredMeshResolution;
+    item.memoryConsumption = mesh->getMemoryConsumptionEstimate();
+    item.mesh = std::move(mesh);
+
+    m_memoryConsumption += item.memoryConsumption;
+    m_items.push_front(std::move(item));
+    levels.push_back(m_items.begin());
+
+    shrink();
+
+    const qint64 totalMemoryConsumption = m_memoryConsumption;
+    lock.unlock();
+
+    reportMemoryConsumption(totalMemoryConsumption);
+}
+
+void PDFMeshCache::shrink()
+{
+    while (m_memoryConsumption > getMemoryLimit() && !m_items.empty())
+    {
+        auto itemIt = std::prev(m_items.end());
+        auto levelsIt = m_itemMap.find(itemIt->key);
+        Q_ASSERT(levelsIt != m_itemMap.end());
+
+        Levels& levels = levelsIt->second;
+        levels.erase(std::remove(levels.begin(), levels.end(), itemIt), levels.end());
+        if (levels.empty())
+        {
+            m_itemMap.erase(levelsIt);
+        }
+
+        m_memoryConsumption -= itemIt->memoryConsumption;
+        m_items.erase(itemIt);
+    }
+}
+
+void PDFMeshCache::trimMemory()
+{
+    qint64 memoryConsumption = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        shrink();
+        memoryConsumption = m_memoryConsumption;
+    }
+
+    setMemoryConsumption(memoryConsumption);
+}
+
+}   // namespace pdf
@@ -0,0 +1,149 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFMESHCACHE_H
+#define PDFMESHCACHE_H
+
+#include "pdfglobal.h"
+#include "pdfmemorybudget.h"
+#include "pdfmeshqualitysettings.h"
+
+#include <QMutex>
+#include <QTransform>
+
+#include <list>
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace pdf
+{
+class PDFCMS;
+class PDFMesh;
+class PDFShadingPattern;
+class PDFRenderErrorReporter;
+class PDFOperationControl;
+
+/// Thread safe cache of shading meshes of free-form, lattice-form, Coons patch
+/// and tensor product patch shadings (types 4-7). Meshes are generated in the page
+/// space coordinate system (not in the device space), so they do not depend on the
+/// zoom, and are transformed into the device space when they are used. Each shading
+/// can have more meshes of different resolution, finer meshes are reused for coarser
+/// requests, if they are not too fine. Memory consumption is limited, least recently
+/// used meshes are removed first.
+/// Memory limit is assigned by the global memory budget, if the budget is set.
+class PDF4QTLIBCORESHARED_EXPORT PDFMeshCache : public PDFMemoryBudgetClient
+{
+public:
+    /// Default memory limit of the cache (in bytes)
+    static constexpr const qint64 DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+    /// Maximal ratio between requested mesh resolution and cached mesh
+    /// resolution, for which is finer cached mesh used instead of coarser mesh.
+    static constexpr const PDFReal MAXIMAL_REFINEMENT_RATIO = 2.0;
+
+    explicit PDFMeshCache(qint64 memoryLimit = DEFAULT_MEMORY_LIMIT);
+    virtual ~PDFMeshCache() override;
+
+    PDFMeshCache(const PDFMeshCache&) = delete;
+    PDFMeshCache& operator=(const PDFMeshCache&) = delete;
+
+    /// Returns true, if mesh of the shading pattern can be cached
+    /// \param shadingPattern Shading pattern
+    static bool isCacheable(const PDFShadingPattern* shadingPattern);
+
+    /// Returns mesh of the shading pattern in the device space coordinate system.
+    /// If mesh is not in the cache, it is created and inserted into the cache.
+    /// If shading can't be cached, mesh is created directly. Exception can be
+    /// thrown, if mesh can't be created.
+    /// \param shadingPattern Shading pattern
+    /// \param settings Meshing settings (in device space)
+    /// \param pagePointToDevicePointMatrix Page space to device space matrix
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    /// \param operationControl Operation control
+    PDFMesh getMesh(const PDFShadingPattern* shadingPattern,
+                    const PDFMeshQualitySettings& settings,
+                    const QTransform& pagePointToDevicePointMatrix,
+                    const PDFCMS* cms,
+                    RenderingIntent intent,
+                    PDFRenderErrorReporter* reporter,
+                    const PDFOperationControl* operationControl);
+
+    /// Removes all items from the cache
+    void clear();
+
+    /// Returns memory consumption of the cache (in bytes)
+    qint64 getMemoryConsumption() const;
+
+protected:
+    virtual void trimMemory() override;
+
+private:
+    struct Key
+    {
+        bool operator==(const Key&) const = default;
+
+        PDFObjectReference reference;
+        quint64 cmsSerialNumber = 0;
+        RenderingIntent intent = RenderingIntent::Unknown;
+        std::array<qint64, 6> matrix = { };
+        PDFReal tolerance = 0.0;
+        PDFInteger patchTestPoints = 0;
+        PDFReal patchResolutionMappingRatioLow = 0.0;
+        PDFReal patchResolutionMappingRatioHigh = 0.0;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Item
+    {
+        Key key;
+        PDFReal minimalMeshResolution = 0.0;
+        PDFReal preferredMeshResolution = 0.0;
+        std::shared_ptr<const PDFMesh> mesh;
+        qint64 memoryConsumption = 0;
+    };
+
+    using Items = std::list<Item>;
+    using Levels = std::vector<Items::iterator>;
+
+    /// Finds the best cached mesh for given settings, or returns nullptr,
+    /// if no suitable mesh is found. Found mesh is marked as recently used.
+    std::shared_ptr<const PDFMesh> find(const Key& key, const PDFMeshQualitySettings& settings);
+
+    /// Inserts new mesh into the cache
+    void insert(const Key& key, const PDFMeshQualitySettings& settings, std::shared_ptr<const PDFMesh> mesh);
+
+    /// Removes least recently used items, until memory limit is met
+    void shrink();
+
+    mutable QMutex m_mutex;
+    Items m_items;
+    std::unordered_map<Key, Levels, KeyHash> m_itemMap;
+    qint64 m_memoryConsumption = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFMESHCACHE_H
@@ -58,6 +58,10 @@ struct PDFMeshQualitySettings
     /// Test points to determine maximal curvature of the tensor product patch meshes
     PDFInteger patchTestPoints = 64;
 
+    /// Maximal count of color stops of shadings painted using native gradient
+    /// (color lookup table of the gradient).
+    PDFInteger gradientStopCount = 256;
+
     /// Lower value of the surface curvature meshing resolution mapping. When ratio between
     /// current curvature at the center of meshed triangle and maximal curvature is below
     /// this value, then prefered mesh resolution is used. If ratio is higher than this value
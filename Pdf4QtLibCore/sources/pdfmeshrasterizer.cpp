@@ -0,0 +1,299 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfmeshrasterizer.h"
+#include "pdfpattern.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfutils.h"
+#include "pdfsimd.h"
+#include "pdfdbgheap.h"
+
+#include <cmath>
+#include <array>
+
+namespace pdf
+{
+
+/// SIMD kernels of the mesh rasterizer. Colors are premultiplied,
+/// channels are in the order blue, green, red, alpha (the same order,
+/// as bytes of the 32-bit pixel on little endian machines).
+class PDFMeshRasterizerKernels
+{
+public:
+    /// Composes span of pixels with interpolated color using source over
+    /// composition mode. Color is incremented by \p dx for each pixel.
+    /// \param pixels Pixels
+    /// \param count Pixel count
+    /// \param color Color of the first pixel (in range [0, 255])
+    /// \param dx Color increment
+    static void fillSpan(QRgb* pixels, int count, const std::array<float, 4>& color, const std::array<float, 4>& dx);
+
+private:
+    static void fillSpanScalar(QRgb* pixels, int count, std::array<float, 4> color, const std::array<float, 4>& dx);
+
+#if defined(PDF4QT_SIMD_SSE2)
+    static void fillSpanSSE2(QRgb* pixels, int count, const std::array<float, 4>& color, const std::array<float, 4>& dx);
+#endif
+};
+
+void PDFMeshRasterizerKernels::fillSpan(QRgb* pixels, int count, const std::array<float, 4>& color, const std::array<float, 4>& dx)
+{
+    switch (PDFSimd::getInstructionSet())
+    {
+#if defined(PDF4QT_SIMD_SSE2)
+        case PDFSimd::InstructionSet::SSE2:
+        case PDFSimd::InstructionSet::AVX2:
+            fillSpanSSE2(pixels, count, color, dx);
+            break;
+#endif
+
+        default:
+            fillSpanScalar(pixels, count, color, dx);
+            break;
+    }
+}
+
+void PDFMeshRasterizerKernels::fillSpanScalar(QRgb* pixels, int count, std::array<float, 4> color, const std::array<float, 4>& dx)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        // Color must be valid premultiplied color, so color channels can't exceed alpha
+        const float sourceAlpha = qBound(0.0f, color[3], 255.0f);
+        const float inverseAlpha = 1.0f - sourceAlpha * (1.0f / 255.0f);
+        const float blue = qBound(0.0f, color[0], sourceAlpha);
+        const float green = qBound(0.0f, color[1], sourceAlpha);
+        const float red = qBound(0.0f, color[2], sourceAlpha);
+
+        const QRgb pixel = pixels[i];
+        pixels[i] = qRgba(qRound(red + qRed(pixel) * inverseAlpha),
+                          qRound(green + qGreen(pixel) * inverseAlpha),
+                          qRound(blue + qBlue(pixel) * inverseAlpha),
+                          qRound(sourceAlpha + qAlpha(pixel) * inverseAlpha));
+
+        for (size_t j = 0; j < color.size(); ++j)
+        {
+            color[j] += dx[j];
+        }
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+void PDFMeshRasterizerKernels::fillSpanSSE2(QRgb* pixels, int count, const std::array<float, 4>& color, const std::array<float, 4>& dx)
+{
+    // All four channels of the pixel are processed at once
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 maximum = _mm_set1_ps(255.0f);
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    const __m128i zeroInteger = _mm_setzero_si128();
+    const __m128 increment = _mm_loadu_ps(dx.data());
+    __m128 value = _mm_loadu_ps(color.data());
+
+    for (int i = 0; i < count; ++i)
+    {
+        __m128 source = _mm_min_ps(_mm_max_ps(value, zero), maximum);
+        const __m128 sourceAlpha = _mm_shuffle_ps(source, source, _MM_SHUFFLE(3, 3, 3, 3));
+        source = _mm_min_ps(source, sourceAlpha);
+
+        const __m128i targetBytes = _mm_cvtsi32_si128(int(pixels[i]));
+        const __m128i targetIntegers = _mm_unpacklo_epi16(_mm_unpacklo_epi8(targetBytes, zeroInteger), zeroInteger);
+        const __m128 target = _mm_cvtepi32_ps(targetIntegers);
+
+        const __m128 inverseAlpha = _mm_sub_ps(one, _mm_mul_ps(sourceAlpha, scale));
+        const __m128i result = _mm_cvtps_epi32(_mm_add_ps(source, _mm_mul_ps(target, inverseAlpha)));
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(result, zeroInteger), zeroInteger);
+        pixels[i] = QRgb(_mm_cvtsi128_si32(packed));
+
+        value = _mm_add_ps(value, increment);
+    }
+}
+#endif
+
+void PDFMeshRasterizer::rasterize(QImage& image, const PDFMesh& mesh, const QTransform& matrix, PDFReal alpha)
+{
+    Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+
+    const std::vector<PDFMesh::Triangle>& triangles = mesh.getTriangles();
+    if (triangles.empty() || image.isNull() || alpha <= 0.0)
+    {
+        return;
+    }
+
+    const int width = image.width();
+    const int height = image.height();
+
+    std::vector<QPointF> vertices = mesh.getVertices();
+    for (QPointF& vertex : vertices)
+    {
+        vertex = matrix.map(vertex);
+    }
+
+    // Triangle is described by three edge functions w_i(x, y) = a_i * x + b_i * y + c_i,
+    // which are nonnegative inside the triangle. Color is a linear function of
+    // the pixel position, i.e. it is interpolated using barycentric coordinates.
+    struct TriangleSetup
+    {
+        std::array<PDFReal, 3> a = { };
+        std::array<PDFReal, 3> b = { };
+        std::array<PDFReal, 3> c = { };
+        PDFReal yMin = 0.0;
+        PDFReal yMax = 0.0;
+        std::array<float, 4> color = { };
+        std::array<float, 4> dx = { };
+        std::array<float, 4> dy = { };
+    };
+
+    std::vector<TriangleSetup> setups;
+    setups.reserve(triangles.size());
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        const PDFMesh::Triangle& triangle = triangles[i];
+        const std::array<QPointF, 3> points = { vertices[triangle.v1], vertices[triangle.v2], vertices[triangle.v3] };
+        const std::array<QRgb, 3> colors = mesh.getTriangleVertexColors(i);
+
+        TriangleSetup setup;
+        setup.yMin = qMin(points[0].y(), qMin(points[1].y(), points[2].y()));
+        setup.yMax = qMax(points[0].y(), qMax(points[1].y(), points[2].y()));
+        const PDFReal xMin = qMin(points[0].x(), qMin(points[1].x(), points[2].x()));
+        const PDFReal xMax = qMax(points[0].x(), qMax(points[1].x(), points[2].x()));
+
+        if (setup.yMax < 0.0 || setup.yMin > height || xMax < 0.0 || xMin > width)
+        {
+            // Triangle is outside of the image
+            continue;
+        }
+
+        // Edge function i corresponds to the edge opposite to the vertex i
+        for (size_t j = 0; j < 3; ++j)
+        {
+            const QPointF& p = points[(j + 1) % 3];
+            const QPointF& q = points[(j + 2) % 3];
+            setup.a[j] = p.y() - q.y();
+            setup.b[j] = q.x() - p.x();
+            setup.c[j] = p.x() * q.y() - q.x() * p.y();
+        }
+
+        PDFReal area = setup.a[0] * points[0].x() + setup.b[0] * points[0].y() + setup.c[0];
+        if (qFuzzyIsNull(area))
+        {
+            // Degenerated triangle
+            continue;
+        }
+
+        if (area < 0.0)
+        {
+            for (size_t j = 0; j < 3; ++j)
+            {
+                setup.a[j] = -setup.a[j];
+                setup.b[j] = -setup.b[j];
+                setup.c[j] = -setup.c[j];
+            }
+            area = -area;
+        }
+
+        const PDFReal inverseArea = 1.0 / area;
+        for (size_t j = 0; j < 3; ++j)
+        {
+            const QRgb rgb = colors[j];
+            const std::array<PDFReal, 4> vertexColor = { qBlue(rgb) * alpha, qGreen(rgb) * alpha, qRed(rgb) * alpha, 255.0 * alpha };
+
+            for (size_t k = 0; k < vertexColor.size(); ++k)
+            {
+                setup.color[k] += float(vertexColor[k] * setup.c[j] * inverseArea);
+                setup.dx[k] += float(vertexColor[k] * setup.a[j] * inverseArea);
+                setup.dy[k] += float(vertexColor[k] * setup.b[j] * inverseArea);
+            }
+        }
+
+        setups.push_back(setup);
+    }
+
+    if (setups.empty())
+    {
+        return;
+    }
+
+    uchar* bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+
+    auto rasterizeBand = [&](int band)
+    {
+        const int bandTop = band * BAND_HEIGHT;
+        const int bandBottom = qMin(bandTop + BAND_HEIGHT, height);
+
+        for (const TriangleSetup& setup : setups)
+        {
+            // Rows, whose pixel centers lie in the vertical range of the triangle
+            const int yStart = qMax(bandTop, int(std::ceil(setup.yMin - 0.5)));
+            const int yEnd = qMin(bandBottom - 1, int(std::floor(setup.yMax - 0.5)));
+
+            for (int y = yStart; y <= yEnd; ++y)
+            {
+                const PDFReal yCenter = y + 0.5;
+
+                // Determine span of pixels, whose centers lie in the triangle
+                PDFReal spanStart = 0.0;
+                PDFReal spanEnd = width - 1;
+                bool isEmpty = false;
+
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    const PDFReal a = setup.a[j];
+                    const PDFReal value = setup.b[j] * yCenter + setup.c[j];
+
+                    if (a > 0.0)
+                    {
+                        spanStart = qMax(spanStart, std::ceil(-value / a - 0.5));
+                    }
+                    else if (a < 0.0)
+                    {
+                        spanEnd = qMin(spanEnd, std::floor(-value / a - 0.5));
+                    }
+                    else if (value < 0.0)
+                    {
+                        isEmpty = true;
+                    }
+                }
+
+                if (isEmpty || spanStart > spanEnd)
+                {
+                    continue;
+                }
+
+                const int xStart = int(spanStart);
+                const int xEnd = int(spanEnd);
+                const float xCenter = xStart + 0.5f;
+
+                std::array<float, 4> color = { };
+                for (size_t k = 0; k < color.size(); ++k)
+                {
+                    color[k] = setup.color[k] + setup.dx[k] * xCenter + setup.dy[k] * float(yCenter);
+                }
+
+                QRgb* pixels = reinterpret_cast<QRgb*>(bits + y * bytesPerLine) + xStart;
+                PDFMeshRasterizerKernels::fillSpan(pixels, xEnd - xStart + 1, color, setup.dx);
+            }
+        }
+    };
+
+    const int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    PDFIntegerRange<int> bands(0, bandCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bands.begin(), bands.end(), rasterizeBand);
+}
+
+}   // namespace pdf
@@ -0,0 +1,56 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFMESHRASTERIZER_H
+#define PDFMESHRASTERIZER_H
+
+#include "pdfglobal.h"
+
+#include <QImage>
+#include <QTransform>
+
+namespace pdf
+{
+class PDFMesh;
+
+/// Scanline rasterizer of the mesh triangles. Colors of the triangles are interpolated
+/// per pixel from the colors of the triangle vertices (Gouraud shading), so smooth
+/// output is produced even from coarse meshes. Triangles are written directly into
+/// the image, without the overhead of painting each triangle by the painter. Image
+/// is divided into horizontal bands, which are rasterized in parallel, triangles
+/// are composed in the order, in which they are stored in the mesh.
+class PDF4QTLIBCORESHARED_EXPORT PDFMeshRasterizer
+{
+public:
+    /// Rasterizes triangles of the mesh into the image. Image must be in the
+    /// format ARGB32_Premultiplied, triangles are composed using source over
+    /// composition mode. Pixel is painted, if its center lies in the triangle.
+    /// Background and bounding path of the mesh are not painted.
+    /// \param image Target image
+    /// \param mesh Mesh to be rasterized
+    /// \param matrix Transformation from the mesh coordinates to the image pixel coordinates
+    /// \param alpha Opacity factor
+    static void rasterize(QImage& image, const PDFMesh& mesh, const QTransform& matrix, PDFReal alpha);
+
+private:
+    /// Height of the band of image rows rasterized by single task
+    static constexpr int BAND_HEIGHT = 32;
+};
+
+}   // namespace pdf
+
+#endif // PDFMESHRASTERIZER_H
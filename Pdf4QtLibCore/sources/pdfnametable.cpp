@@ -0,0 +1,185 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfnametable.h"
+
+#include <array>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+static constexpr std::array<const char*, PDFNames::LastWellKnownName> WELL_KNOWN_NAMES =
+{
+    "",
+    "Type",
+    "Subtype",
+    "Resources",
+    "Font",
+    "XObject",
+    "ExtGState",
+    "ColorSpace",
+    "Pattern",
+    "Shading",
+    "Properties",
+    "ProcSet",
+    "Filter",
+    "DecodeParms",
+    "Length",
+    "Width",
+    "Height",
+    "BitsPerComponent",
+    "ImageMask",
+    "Mask",
+    "SMask",
+    "Decode",
+    "Interpolate",
+    "Parent",
+    "Kids",
+    "Count",
+    "Contents",
+    "MediaBox",
+    "CropBox",
+    "BBox",
+    "Matrix",
+    "Group",
+    "OC",
+    "StructParent",
+    "Image",
+    "Form",
+    "Name",
+    "BaseFont",
+    "Encoding",
+    "FontDescriptor",
+    "FirstChar",
+    "LastChar",
+    "Widths",
+    "ToUnicode",
+    "Annots",
+    "Page",
+    "Pages"
+};
+
+static_assert(WELL_KNOWN_NAMES.back() != nullptr, "Well-known names must match PDFNames enumeration.");
+
+PDFNameTable::PDFNameTable()
+{
+    for (PDFNameAtom atom = PDFNames::Invalid + 1; atom < PDFNames::LastWellKnownName; ++atom)
+    {
+        m_wellKnownAtoms.insert(QByteArray(WELL_KNOWN_NAMES[atom]), atom);
+    }
+}
+
+PDFNameTable* PDFNameTable::getInstance()
+{
+    static PDFNameTable instance;
+    return &instance;
+}
+
+PDFNameAtom PDFNameTable::intern(QByteArrayView name)
+{
+    return findOrIntern(name, true);
+}
+
+PDFNameAtom PDFNameTable::find(QByteArrayView name) const
+{
+    return findOrIntern(name, false);
+}
+
+PDFNameAtom PDFNameTable::findOrIntern(QByteArrayView name, bool intern) const
+{
+    if (name.isEmpty() || name.size() > MAX_INTERNED_NAME_LENGTH)
+    {
+        return PDFNames::Invalid;
+    }
+
+    // Interned names are never removed, so cached views of
+    // the names remain valid as long as the table exists.
+    thread_local std::array<CacheEntry, CACHE_SIZE> cache;
+
+    const size_t hash = qHash(name);
+    CacheEntry& cacheEntry = cache[hash % CACHE_SIZE];
+    if (cacheEntry.atom != PDFNames::Invalid && cacheEntry.name == name)
+    {
+        return cacheEntry.atom;
+    }
+
+    // Name is not copied, we use it only for lookup
+    const QByteArray key = QByteArray::fromRawData(name.data(), name.size());
+
+    auto wellKnownIt = m_wellKnownAtoms.constFind(key);
+    if (wellKnownIt != m_wellKnownAtoms.cend())
+    {
+        cacheEntry.name = QByteArrayView(WELL_KNOWN_NAMES[wellKnownIt.value()]);
+        cacheEntry.atom = wellKnownIt.value();
+        return cacheEntry.atom;
+    }
+
+    // Atoms of names are distributed into shards, so shard and index
+    // of the name in the shard can be determined from the atom.
+    const size_t shardIndex = hash % SHARD_COUNT;
+    Shard& shard = m_shards[shardIndex];
+
+    PDFNameAtom atom = PDFNames::Invalid;
+
+    {
+        QReadLocker lock(&shard.lock);
+        atom = shard.atoms.value(key, PDFNames::Invalid);
+    }
+
+    if (atom == PDFNames::Invalid && intern)
+    {
+        QWriteLocker lock(&shard.lock);
+
+        // Name can be interned by other thread in the meantime
+        atom = shard.atoms.value(key, PDFNames::Invalid);
+
+        if (atom == PDFNames::Invalid && shard.names.size() < MAX_INTERNED_NAMES / SHARD_COUNT)
+        {
+            atom = static_cast<PDFNameAtom>(PDFNames::LastWellKnownName + shard.names.size() * SHARD_COUNT + shardIndex);
+            QByteArray internedName = name.toByteArray();
+            shard.names.push_back(internedName);
+            shard.atoms.insert(internedName, atom);
+        }
+    }
+
+    if (atom != PDFNames::Invalid)
+    {
+        cacheEntry.name = getName(atom);
+        cacheEntry.atom = atom;
+    }
+
+    return atom;
+}
+
+QByteArrayView PDFNameTable::getName(PDFNameAtom atom) const
+{
+    if (atom < PDFNames::LastWellKnownName)
+    {
+        return QByteArrayView(WELL_KNOWN_NAMES[atom]);
+    }
+
+    const size_t index = atom - PDFNames::LastWellKnownName;
+    Shard& shard = m_shards[index % SHARD_COUNT];
+
+    QReadLocker lock(&shard.lock);
+    const size_t nameIndex = index / SHARD_COUNT;
+    return nameIndex < shard.names.size() ? QByteArrayView(shard.names[nameIndex]) : QByteArrayView();
+}
+
+}   // namespace pdf
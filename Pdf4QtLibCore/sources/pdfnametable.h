@@ -0,0 +1,171 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFNAMETABLE_H
+#define PDFNAMETABLE_H
+
+#include "pdfglobal.h"
+
+#include <QHash>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QReadWriteLock>
+
+#include <array>
+#include <deque>
+
+namespace pdf
+{
+
+/// Atom of the interned name. Two names are equal, if and only if
+/// they have the same atom. Zero atom is invalid atom and means,
+/// that the name is not interned.
+using PDFNameAtom = uint32_t;
+
+/// Well-known names. These names are interned when name table is created,
+/// so their atoms are compile-time constants and can be used for fast
+/// dictionary lookups without string comparisons.
+namespace PDFNames
+{
+
+enum : PDFNameAtom
+{
+    Invalid = 0,
+    Type,
+    Subtype,
+    Resources,
+    Font,
+    XObject,
+    ExtGState,
+    ColorSpace,
+    Pattern,
+    Shading,
+    Properties,
+    ProcSet,
+    Filter,
+    DecodeParms,
+    Length,
+    Width,
+    Height,
+    BitsPerComponent,
+    ImageMask,
+    Mask,
+    SMask,
+    Decode,
+    Interpolate,
+    Parent,
+    Kids,
+    Count,
+    Contents,
+    MediaBox,
+    CropBox,
+    BBox,
+    Matrix,
+    Group,
+    OC,
+    StructParent,
+    Image,
+    Form,
+    Name,
+    BaseFont,
+    Encoding,
+    FontDescriptor,
+    FirstChar,
+    LastChar,
+    Widths,
+    ToUnicode,
+    Annots,
+    Page,
+    Pages,
+    LastWellKnownName
+};
+
+}   // namespace PDFNames
+
+/// Global name interning table. Each interned name has unique atom, so names
+/// can be compared by integer comparison. Table is thread safe. Names are
+/// distributed into shards (each shard has its own lock) and each thread
+/// has small cache of recently used names, so parsing threads rarely
+/// contend for the lock. To avoid unbounded memory consumption (for example,
+/// for malicious documents with huge number of distinct names), only short
+/// names are interned and count of interned names is limited. Names, which
+/// are not interned, have invalid atom and must be compared as strings.
+class PDF4QTLIBCORESHARED_EXPORT PDFNameTable
+{
+public:
+    /// Returns global instance of the name table
+    static PDFNameTable* getInstance();
+
+    /// Returns atom of the name. If name is not interned yet, it is interned,
+    /// if it is possible. If name can't be interned, invalid atom is returned.
+    /// \param name Name
+    PDFNameAtom intern(QByteArrayView name);
+
+    /// Returns atom of the name, if name is interned, otherwise returns
+    /// invalid atom. Name is never interned by this function.
+    /// \param name Name
+    PDFNameAtom find(QByteArrayView name) const;
+
+    /// Returns name of the atom. For invalid atom, empty view is returned.
+    /// Interned names are never removed, so view is valid as long as
+    /// the table exists.
+    /// \param atom Atom
+    QByteArrayView getName(PDFNameAtom atom) const;
+
+private:
+    explicit PDFNameTable();
+
+    /// Maximal length of interned name
+    static constexpr qsizetype MAX_INTERNED_NAME_LENGTH = 64;
+
+    /// Maximal count of interned names
+    static constexpr size_t MAX_INTERNED_NAMES = 65536;
+
+    /// Number of shards of the table
+    static constexpr size_t SHARD_COUNT = 16;
+
+    /// Number of entries of the per-thread cache
+    static constexpr size_t CACHE_SIZE = 512;
+
+    struct Shard
+    {
+        QReadWriteLock lock;
+        QHash<QByteArray, PDFNameAtom> atoms;
+        std::deque<QByteArray> names;   ///< Deque never moves names, so views of them remain valid
+    };
+
+    struct CacheEntry
+    {
+        QByteArrayView name;
+        PDFNameAtom atom = 0;
+    };
+
+    /// Finds atom of the name (or interns it, if \p intern is true)
+    /// \param name Name
+    /// \param intern Intern the name, if it is not found
+    PDFNameAtom findOrIntern(QByteArrayView name, bool intern) const;
+
+    /// Well-known names, they are never modified after construction,
+    /// so they can be read without locking.
+    QHash<QByteArray, PDFNameAtom> m_wellKnownAtoms;
+
+    mutable std::array<Shard, SHARD_COUNT> m_shards;
+};
+
+}   // namespace pdf
+
+#endif // PDFNAMETABLE_H
@@ -16,6 +16,7 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdfnametounicode.h"
+#include "pdfutils.h"
 #include "pdfdbgheap.h"
 
 #include <array>
@@ -4515,34 +4516,658 @@ static constexpr const std::array<std::pair<QChar, const char*>, 201> glyphNameZ
     std::pair<QChar, const char*>{ QChar(0x275D), "a99" }                           // Character '❝' Symbol
 };
 
-QChar PDFNameToUnicode::getUnicodeForName(const QByteArray& name)
-{
-    Q_ASSERT(std::is_sorted(glyphNameToUnicode.cbegin(), glyphNameToUnicode.cend(), Comparator()));
+template<size_t Count>
+using GlyphNameTable = std::array<std::pair<QChar, const char*>, Count>;
 
-    auto [it, itEnd] = std::equal_range(glyphNameToUnicode.cbegin(), glyphNameToUnicode.cend(), name, Comparator());
-    if (it != itEnd)
+template<size_t Count>
+static constexpr std::array<uint64_t, Count> getGlyphNameHashes(const GlyphNameTable<Count>& table)
+{
+    std::array<uint64_t, Count> hashes = { };
+    for (size_t i = 0; i < Count; ++i)
     {
-        return it->first;
+        hashes[i] = PDFStaticPerfectHash<Count>::getHash(table[i].second);
     }
-    else
+    return hashes;
+}
+
+template<size_t Count>
+static QChar findGlyphName(const GlyphNameTable<Count>& table, const PDFStaticPerfectHash<Count>& perfectHash, const QByteArray& name)
+{
+    const size_t index = perfectHash.find(PDFStaticPerfectHash<Count>::getHash(name.constData(), name.size()));
+    if (index < Count && name == table[index].second)
     {
-        return QChar();
+        return table[index].first;
     }
+
+    return QChar();
+}
+
+// Perfect hashes of the glyph names are constant, so lookup doesn't need any
+// initialization. Construction of the perfect hash of the large glyph name table
+// (and even hashing of its names) exceeds compile time evaluation limits of some
+// compilers, so its tables were generated offline by PDFStaticPerfectHash from
+// hashes of the names. Tables must be regenerated, if glyph names are changed.
+static constexpr std::array<uint16_t, PDFStaticPerfectHash<glyphNameToUnicode.size()>::SLOT_COUNT> glyphNamePerfectHashSlots = {
+    2051, 513, 65535, 1469, 65535, 65535, 65535, 65535, 2124, 65535, 65535, 581, 65535, 2825, 65535, 4061,
+    37, 2505, 4149, 3624, 65535, 65535, 3163, 4024, 374, 1121, 1586, 65535, 1693, 2691, 65535, 3764,
+    65535, 65535, 65535, 2414, 846, 65535, 2996, 65535, 3801, 2234, 1231, 2403, 65535, 1406, 66, 65535,
+    2119, 2156, 2064, 65535, 65535, 65535, 65535, 2776, 65535, 1308, 1977, 65535, 1629, 2123, 112, 65535,
+    679, 2839, 2811, 3664, 65535, 2901, 65535, 65535, 65535, 65535, 65535, 2987, 65535, 1449, 65535, 3435,
+    1656, 2732, 1771, 65535, 2011, 2111, 65535, 2532, 726, 65535, 2588, 1814, 65535, 65535, 390, 65535,
+    65535, 65535, 3263, 2944, 1631, 1220, 2105, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 2694, 65535,
+    1152, 3910, 2591, 65535, 65535, 65535, 8, 18, 65535, 65535, 2707, 3320, 3857, 3605, 4220, 3639,
+    1010, 4234, 3062, 1249, 2555, 65535, 65535, 65535, 3356, 3638, 65535, 65535, 2091, 2229, 1783, 3958,
+    4007, 65535, 1432, 125, 755, 65535, 65535, 65535, 65535, 343, 2837, 65535, 3967, 65535, 65535, 1129,
+    1030, 3079, 3827, 4283, 65535, 65535, 65535, 1222, 65535, 65535, 65535, 4281, 4072, 1837, 65535, 65535,
+    849, 1697, 65535, 1467, 65535, 70, 4161, 65535, 4198, 2336, 1342, 65535, 65535, 3414, 65535, 2470,
+    65535, 925, 2648, 65535, 2114, 65535, 65535, 65535, 65535, 3408, 1230, 1392, 65535, 3329, 65535, 65535,
+    2292, 645, 2898, 65535, 3768, 65535, 65535, 2027, 1267, 65535, 372, 65535, 65535, 65535, 65535, 58,
+    65535, 1316, 945, 3690, 65535, 779, 65535, 65535, 254, 904, 2685, 65535, 242, 4162, 65535, 2453,
+    2821, 65535, 2187, 425, 65535, 65535, 65535, 65535, 2697, 65535, 2863, 323, 1110, 65535, 3630, 1185,
+    1618, 321, 436, 1885, 1745, 65535, 3016, 65535, 65535, 2903, 2976, 2788, 80, 2384, 1036, 65535,
+    65535, 65535, 1200, 65535, 4104, 65535, 65535, 65535, 65535, 325, 1169, 65535, 409, 65535, 2620, 1599,
+    371, 65535, 1570, 65535, 494, 65535, 3375, 65535, 2021, 65535, 3953, 770, 65535, 720, 2197, 65535,
+    631, 3238, 1830, 2878, 3691, 3172, 65535, 1408, 997, 2702, 65535, 65535, 65535, 65535, 65535, 3853,
+    65535, 65535, 65535, 1133, 3227, 65535, 65535, 65535, 65535, 65535, 1318, 2073, 719, 65535, 105, 65535,
+    65535, 65535, 65535, 65535, 2543, 2090, 65535, 65535, 65535, 4092, 4116, 878, 65535, 65535, 3709, 65535,
+    3225, 1815, 865, 3939, 65535, 3672, 3093, 4195, 65535, 65535, 2585, 65535, 620, 65535, 2618, 3825,
+    65535, 65535, 2441, 717, 2844, 2553, 65535, 65535, 2712, 65535, 65535, 65535, 3576, 65535, 344, 65535,
+    65535, 65535, 499, 1225, 2405, 65535, 65535, 1307, 4242, 65535, 65535, 65535, 2250, 3989, 2276, 3281,
+    65535, 1369, 65535, 4166, 1145, 2587, 1790, 4031, 65535, 65535, 3173, 65535, 4045, 481, 702, 65535,
+    587, 65535, 65535, 963, 850, 1803, 65535, 65535, 4201, 2263, 65535, 65535, 3501, 65535, 2896, 65535,
+    1367, 2942, 898, 3677, 3060, 65535, 65535, 170, 1987, 65535, 65535, 1209, 65535, 65535, 65535, 3082,
+    2757, 65535, 3874, 65535, 1527, 65535, 65535, 188, 65535, 65535, 65535, 65535, 2673, 65535, 4047, 65535,
+    2055, 153, 288, 65535, 65535, 3028, 65535, 3050, 1994, 4057, 65535, 65535, 1781, 289, 3364, 65535,
+    590, 2058, 3332, 3116, 65535, 1509, 65535, 1436, 2034, 3341, 65535, 4275, 65535, 136, 65535, 3615,
+    65535, 65535, 65535, 65535, 3766, 65535, 65535, 2142, 3066, 65535, 65535, 593, 65535, 65535, 3934, 4048,
+    65535, 806, 3542, 2794, 65535, 885, 1827, 2862, 3087, 1717, 61, 65535, 214, 65535, 1811, 65535,
+    3886, 1106, 65535, 2401, 65535, 65535, 65535, 4119, 65535, 1343, 1393, 65535, 65535, 65535, 3376, 65535,
+    65535, 2412, 65535, 2519, 65535, 2540, 284, 65535, 65535, 65535, 3138, 65535, 1592, 65535, 893, 65535,
+    65535, 65535, 65535, 1027, 3039, 65535, 638, 3632, 65535, 65535, 1666, 751, 1743, 65535, 512, 3465,
+    939, 2494, 2659, 65535, 65535, 65535, 65535, 65535, 1749, 2498, 65535, 650, 65535, 65535, 431, 3372,
+    1332, 3464, 1603, 1851, 65535, 2729, 1778, 65535, 860, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 362, 852, 3509, 1361, 65535, 2980, 65535, 65535, 47, 767, 65535, 65535, 2223, 1089,
+    1141, 2295, 65535, 65535, 922, 756, 65535, 65535, 65535, 65535, 65535, 1698, 65535, 4273, 65535, 65535,
+    2319, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 3142, 65535, 65535, 3380, 65535, 1285, 65535, 65535,
+    3499, 65535, 987, 165, 2084, 944, 65535, 2365, 65535, 3403, 65535, 65535, 65535, 3720, 65535, 4095,
+    65535, 65535, 1075, 3640, 1248, 3013, 1703, 65535, 3870, 591, 3316, 65535, 65535, 3784, 3824, 2675,
+    65535, 2770, 422, 65535, 65535, 65535, 65535, 2542, 65535, 3761, 3851, 65535, 1533, 65535, 65535, 3535,
+    4160, 65535, 65535, 2462, 3525, 3187, 65535, 4018, 3009, 65535, 65535, 2982, 4282, 65535, 261, 65535,
+    65535, 2538, 3746, 3543, 65535, 65535, 65535, 65535, 2847, 65535, 3804, 65535, 65535, 1807, 65535, 65535,
+    65535, 3315, 65535, 65535, 2992, 65535, 810, 65535, 530, 4257, 392, 3584, 65535, 65535, 993, 65535,
+    1239, 4004, 65535, 4027, 65535, 2892, 2674, 3026, 65535, 65535, 265, 65535, 65535, 65535, 4064, 65535,
+    2009, 65535, 1817, 65535, 2132, 4245, 2830, 3821, 1295, 65535, 420, 65535, 2590, 312, 2979, 65535,
+    65535, 65535, 65535, 65535, 2023, 65535, 1784, 65535, 65535, 65535, 2372, 65535, 3413, 65535, 65535, 65535,
+    1118, 65535, 65535, 2831, 65535, 3157, 574, 3631, 2278, 3736, 4139, 65535, 2283, 3799, 65535, 65535,
+    1339, 65535, 248, 65535, 65535, 65535, 3105, 3524, 2834, 4107, 65535, 1236, 3660, 2062, 65535, 802,
+    65535, 660, 199, 2135, 3091, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 859, 432,
+    3772, 65535, 65535, 65535, 2988, 65535, 71, 4148, 2120, 4253, 2989, 65535, 65535, 65535, 3152, 65535,
+    65535, 65535, 1262, 888, 391, 3456, 65535, 65535, 3354, 65535, 65535, 65535, 65535, 65535, 3237, 65535,
+    3471, 65535, 65535, 2914, 65535, 2039, 65535, 65535, 65535, 65535, 65535, 1571, 65535, 3860, 65535, 765,
+    3502, 65535, 3345, 205, 3350, 65535, 65535, 1701, 3431, 65535, 26, 2030, 65535, 65535, 1644, 2079,
+    65535, 65535, 3407, 65535, 3033, 1740, 65535, 966, 65535, 65535, 4041, 65535, 2608, 3759, 65535, 65535,
+    65535, 1653, 2145, 65535, 65535, 65535, 3369, 65535, 241, 65535, 3477, 65535, 65535, 3678, 1022, 3812,
+    3451, 65535, 65535, 65535, 799, 2507, 65535, 65535, 1204, 2762, 2387, 2438, 2616, 789, 1810, 65535,
+    3264, 65535, 65535, 3271, 4278, 273, 1042, 1718, 4130, 4080, 65535, 3599, 3929, 65535, 3224, 139,
+    3698, 65535, 579, 3249, 433, 1503, 93, 65535, 3500, 3940, 65535, 3212, 1680, 293, 65535, 2827,
+    65535, 446, 3424, 1211, 65535, 3582, 3795, 294, 65535, 65535, 65535, 65535, 1974, 3074, 3294, 65535,
+    65535, 1280, 65535, 157, 4269, 4252, 389, 65535, 65535, 1250, 659, 65535, 65535, 355, 65535, 437,
+    1507, 3386, 65535, 1430, 65535, 2630, 1309, 1139, 3399, 3289, 3992, 65535, 65535, 65535, 65535, 65535,
+    65535, 3440, 2018, 193, 2594, 2298, 1414, 65535, 3381, 65535, 592, 693, 65535, 65535, 875, 474,
+    1275, 1764, 3922, 65535, 65535, 3164, 417, 923, 2179, 65535, 1670, 65535, 65535, 1926, 3198, 3918,
+    65535, 3551, 2205, 4141, 65535, 1829, 65535, 65535, 65535, 65535, 65535, 65535, 2766, 65535, 65535, 1755,
+    65535, 41, 65535, 456, 3488, 2739, 470, 2328, 1396, 3197, 65535, 1757, 3063, 65535, 65535, 2237,
+    65535, 65535, 680, 801, 17, 3921, 65535, 3834, 65535, 3781, 65535, 4052, 65535, 3217, 65535, 65535,
+    65535, 4258, 4122, 65535, 2014, 315, 65535, 65535, 65535, 65535, 65535, 65535, 3523, 65535, 65535, 65535,
+    65535, 65535, 65535, 989, 65535, 796, 3040, 3671, 65535, 65535, 65535, 65535, 2905, 65535, 65535, 4014,
+    1364, 65535, 1967, 34, 1687, 87, 65535, 1444, 65535, 65535, 65535, 65535, 65535, 4078, 65535, 4016,
+    65535, 65535, 1789, 3734, 65535, 65535, 65535, 3420, 65535, 65535, 3110, 735, 65535, 3977, 65535, 65535,
+    65535, 4144, 2981, 3613, 65535, 3839, 65535, 65535, 2563, 65535, 3395, 1865, 2880, 3404, 54, 65535,
+    65535, 837, 65535, 137, 65535, 65535, 666, 3696, 649, 65535, 65535, 3446, 65535, 65535, 65535, 3873,
+    1672, 65535, 1418, 176, 3044, 1346, 65535, 3636, 2215, 3036, 979, 747, 3794, 111, 1336, 65535,
+    65535, 3945, 65535, 65535, 186, 65535, 2456, 65535, 2881, 3574, 65535, 65535, 65535, 65535, 129, 65535,
+    3008, 65535, 65535, 65535, 2641, 65535, 271, 1330, 1899, 65535, 196, 65535, 3148, 2377, 65535, 2957,
+    723, 3878, 2080, 4185, 368, 65535, 2581, 2638, 65535, 2416, 1389, 1054, 65535, 3793, 448, 65535,
+    65535, 65535, 65535, 65535, 457, 3702, 2428, 2713, 3777, 65535, 2899, 65535, 2473, 65535, 341, 3971,
+    65535, 65535, 881, 1705, 65535, 543, 887, 2769, 65535, 2050, 1504, 65535, 3262, 65535, 1654, 65535,
+    2035, 65535, 3186, 65535, 1991, 65535, 65535, 3473, 65535, 1026, 492, 65535, 65535, 2549, 3479, 65535,
+    2526, 473, 65535, 4177, 838, 65535, 253, 65535, 3183, 4042, 65535, 65535, 65535, 462, 1426, 1227,
+    65535, 65535, 65535, 3976, 65535, 65535, 2128, 3954, 2823, 1884, 65535, 539, 1577, 4079, 2772, 2211,
+    65535, 3423, 4132, 65535, 65535, 65535, 478, 65535, 65535, 526, 3884, 65535, 65535, 65535, 2227, 942,
+    65535, 2410, 65535, 504, 65535, 3610, 3716, 800, 65535, 2493, 558, 855, 3667, 65535, 4194, 65535,
+    65535, 1070, 65535, 2907, 2408, 2482, 65535, 1611, 65535, 2253, 65535, 65535, 1874, 65535, 65535, 3098,
+    361, 65535, 65535, 2363, 3590, 65535, 4117, 65535, 65535, 65535, 65535, 65535, 739, 1892, 65535, 3776,
+    65535, 842, 65535, 2536, 65535, 237, 546, 65535, 1610, 1146, 65535, 65535, 606, 65535, 65535, 65535,
+    1555, 65535, 3250, 65535, 65535, 4111, 941, 2813, 65535, 4008, 3591, 65535, 65535, 65535, 65535, 65535,
+    3518, 65535, 65535, 2768, 2598, 184, 65535, 65535, 491, 65535, 834, 65535, 65535, 2603, 3567, 65535,
+    2044, 3355, 2273, 65535, 4049, 65535, 43, 65535, 484, 65535, 65535, 65535, 65535, 65535, 65535, 1422,
+    65535, 65535, 459, 1785, 1765, 65535, 2698, 95, 3912, 65535, 920, 2919, 1871, 65535, 65535, 65535,
+    255, 1993, 3823, 1035, 65535, 3297, 3880, 2231, 65535, 65535, 65535, 65535, 2217, 65535, 179, 65535,
+    65535, 65535, 2663, 65535, 1859, 65535, 65535, 65535, 65535, 65535, 3938, 2275, 308, 65535, 4256, 1206,
+    3503, 2789, 899, 2853, 3683, 2958, 65535, 65535, 2730, 3987, 1354, 1301, 872, 65535, 1381, 65535,
+    65535, 65535, 65535, 65535, 65535, 38, 65535, 4055, 65535, 2973, 1202, 559, 3293, 1012, 65535, 3319,
+    3201, 65535, 65535, 2607, 65535, 65535, 2296, 3412, 65535, 65535, 2783, 65535, 3871, 1637, 356, 65535,
+    588, 1708, 65535, 3972, 65535, 127, 1140, 3103, 514, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    1825, 65535, 2042, 65535, 65535, 65535, 65535, 149, 65535, 65535, 3382, 3629, 1554, 3448, 1931, 3828,
+    375, 569, 65535, 65535, 65535, 65535, 65535, 528, 65535, 729, 65535, 848, 65535, 1162, 1193, 65535,
+    895, 65535, 65535, 65535, 1968, 65535, 91, 2521, 65535, 3676, 4071, 65535, 1702, 65535, 65535, 4203,
+    825, 65535, 1112, 1916, 2252, 65535, 3891, 65535, 65535, 65535, 2676, 864, 675, 2106, 65535, 2061,
+    1107, 65535, 935, 65535, 1609, 65535, 3960, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 2066, 65535,
+    65535, 1425, 65535, 3742, 3689, 65535, 1218, 65535, 572, 3234, 65535, 65535, 65535, 2993, 65535, 65535,
+    65535, 65535, 65535, 4093, 65535, 1752, 65535, 235, 1649, 65535, 2072, 65535, 65535, 1271, 412, 65535,
+    65535, 96, 1798, 65535, 65535, 2809, 65535, 1658, 65535, 65535, 3740, 65535, 962, 851, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 3291, 65535, 1066, 886, 554, 2605, 3745, 3643, 65535, 1550,
+    65535, 777, 1676, 616, 22, 65535, 974, 961, 65535, 2184, 65535, 65535, 65535, 65535, 2468, 330,
+    2144, 65535, 2599, 909, 3257, 65535, 520, 3195, 4098, 760, 65535, 3909, 3662, 36, 65535, 3055,
+    65535, 65535, 1519, 3901, 1753, 65535, 122, 65535, 3963, 65535, 1260, 65535, 65535, 1201, 2321, 2537,
+    3134, 3023, 1582, 65535, 65535, 65535, 65535, 65535, 65535, 1016, 1714, 2214, 2657, 3651, 65535, 65535,
+    65535, 2102, 2535, 3046, 716, 3602, 373, 65535, 556, 74, 4017, 65535, 3090, 3153, 65535, 65535,
+    65535, 820, 65535, 65535, 4191, 65535, 4058, 65535, 65535, 65535, 4250, 65535, 3597, 65535, 65535, 1403,
+    295, 2429, 4076, 65535, 65535, 65535, 65535, 65535, 65535, 2022, 65535, 65535, 65535, 65535, 1175, 65535,
+    4005, 65535, 65535, 65535, 3325, 1484, 1957, 65535, 3814, 3829, 65535, 900, 3743, 3361, 1539, 65535,
+    931, 1938, 65535, 3889, 2935, 2422, 65535, 1679, 65535, 1194, 1321, 65535, 2909, 3184, 4249, 3789,
+    65535, 65535, 65535, 65535, 65535, 65535, 1325, 65535, 65535, 65535, 3442, 65535, 290, 65535, 677, 3727,
+    1796, 863, 65535, 1481, 2886, 65535, 65535, 65535, 1424, 65535, 632, 2206, 65535, 65535, 3076, 65535,
+    4279, 65535, 65535, 65535, 65535, 1471, 65535, 2680, 2719, 65535, 476, 65535, 2860, 921, 65535, 65535,
+    65535, 1470, 65535, 286, 3519, 65535, 1763, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 1575, 821, 65535, 3353, 65535, 65535, 65535, 65535, 65535, 3785, 65535, 65535, 65535, 3285, 65535,
+    1602, 3832, 65535, 509, 65535, 889, 151, 307, 65535, 3312, 4208, 65535, 3125, 65535, 65535, 2019,
+    65535, 384, 65535, 2316, 101, 65535, 65535, 65535, 65535, 65535, 2541, 65535, 1176, 2486, 1614, 65535,
+    1213, 65535, 2300, 65535, 106, 65535, 65535, 65535, 65535, 3578, 3368, 65535, 2632, 65535, 1844, 65535,
+    1279, 578, 65535, 65535, 65535, 65535, 65535, 65535, 1594, 4114, 1613, 65535, 65535, 4189, 310, 65535,
+    65535, 65535, 65535, 138, 3897, 2265, 482, 65535, 65535, 65535, 65535, 130, 1905, 65535, 2346, 65535,
+    65535, 3398, 65535, 2118, 65535, 65535, 505, 65535, 65535, 65535, 65535, 4157, 65535, 2777, 1563, 65535,
+    2654, 2371, 65535, 2941, 278, 65535, 4106, 65535, 65535, 65535, 65535, 1917, 2580, 1161, 65535, 65535,
+    65535, 65535, 65535, 826, 65535, 531, 3397, 969, 90, 65535, 3196, 65535, 65535, 4204, 65535, 3101,
+    65535, 778, 65535, 65535, 65535, 65535, 2185, 65535, 626, 65535, 1049, 65535, 65535, 964, 1591, 3895,
+    65535, 65535, 3808, 65535, 3107, 1103, 65535, 65535, 65535, 65535, 65535, 2108, 2962, 65535, 65535, 65535,
+    3166, 65535, 65535, 65535, 141, 3682, 547, 65535, 2174, 25, 65535, 65535, 496, 3496, 3730, 65535,
+    1673, 1039, 2026, 3504, 4261, 2006, 1587, 866, 65535, 65535, 3357, 2838, 227, 65535, 1999, 65535,
+    1076, 2904, 1023, 1328, 1057, 65535, 65535, 2198, 2635, 65535, 65535, 65535, 65535, 65535, 648, 65535,
+    2943, 65535, 65535, 3334, 4103, 65535, 65535, 1870, 522, 65535, 65535, 1800, 65535, 1299, 65535, 3283,
+    2492, 1491, 65535, 1651, 65535, 65535, 1421, 275, 2572, 1353, 4051, 65535, 3444, 3010, 65535, 4019,
+    65535, 65535, 65535, 3253, 3083, 229, 336, 65535, 65535, 65535, 65535, 1134, 2259, 65535, 3411, 65535,
+    3475, 65535, 3556, 1302, 65535, 3085, 65535, 65535, 3594, 65535, 1882, 2343, 824, 65535, 1489, 65535,
+    65535, 65535, 4062, 1895, 65535, 65535, 65535, 65535, 65535, 65535, 206, 3737, 2522, 1416, 892, 65535,
+    2699, 65535, 65535, 65535, 40, 400, 65535, 65535, 65535, 65535, 65535, 2393, 3494, 65535, 65535, 65535,
+    3436, 2109, 65535, 65535, 65535, 1728, 2358, 652, 1334, 3070, 1067, 912, 3109, 65535, 65535, 2260,
+    4155, 65535, 2279, 65535, 65535, 65535, 2165, 65535, 65535, 757, 896, 65535, 65535, 65535, 65535, 65535,
+    65535, 1518, 65535, 930, 584, 65535, 65535, 3251, 65535, 506, 65535, 65535, 65535, 2883, 1464, 2,
+    1831, 2404, 2077, 65535, 156, 3467, 4243, 65535, 2126, 1199, 65535, 3472, 211, 3145, 65535, 1084,
+    4227, 2924, 65535, 1849, 99, 65535, 65535, 1852, 65535, 1028, 2264, 1538, 65535, 65535, 65535, 3541,
+    986, 560, 2048, 65535, 681, 1373, 65535, 65535, 65535, 1173, 65535, 3900, 2133, 97, 65535, 65535,
+    2419, 2024, 65535, 1043, 65535, 891, 381, 3272, 3546, 65535, 65535, 1640, 3521, 1775, 65535, 65535,
+    2029, 65535, 65535, 65535, 65535, 2849, 1021, 65535, 4123, 65535, 65535, 285, 65535, 1826, 1638, 65535,
+    65535, 1932, 65535, 3483, 65535, 65535, 4039, 1912, 21, 65535, 3430, 2745, 3997, 65535, 65535, 2596,
+    386, 416, 65535, 3559, 3609, 3905, 65535, 65535, 692, 65535, 1913, 4137, 65535, 65535, 2921, 65535,
+    65535, 2700, 65535, 3392, 3773, 65535, 4026, 131, 2765, 65535, 2304, 65535, 65535, 1805, 3365, 497,
+    387, 65535, 1258, 3327, 65535, 65535, 65535, 2706, 1228, 1156, 65535, 3914, 4022, 1661, 471, 65535,
+    65535, 65535, 65535, 3244, 3641, 69, 1581, 1657, 65535, 3674, 486, 65535, 1272, 65535, 65535, 65535,
+    2033, 65535, 65535, 65535, 65535, 65535, 4158, 910, 3111, 65535, 65535, 65535, 1860, 3268, 65535, 65535,
+    65535, 3634, 2484, 65535, 3141, 65535, 65535, 2424, 2193, 1365, 65535, 3835, 2755, 3548, 65535, 1072,
+    65535, 65535, 901, 1927, 65535, 65535, 823, 65535, 65535, 1923, 970, 2431, 1014, 83, 65535, 65535,
+    65535, 65535, 65535, 3128, 2373, 1710, 1420, 3269, 937, 65535, 79, 2113, 65535, 1598, 1159, 65535,
+    3544, 65535, 1124, 65535, 3719, 1327, 166, 3726, 2485, 4167, 65535, 1960, 65535, 65535, 3434, 3652,
+    65535, 2529, 65535, 3845, 65535, 60, 2074, 65535, 3680, 65535, 65535, 65535, 65535, 65535, 65535, 1696,
+    65535, 2798, 65535, 3688, 2820, 467, 65535, 2357, 3568, 65535, 3373, 65535, 708, 3394, 65535, 65535,
+    338, 2887, 65535, 65535, 65535, 1044, 602, 3221, 65535, 2891, 3695, 65535, 534, 65535, 65535, 884,
+    65535, 3572, 65535, 2640, 1502, 65535, 1535, 4232, 65535, 65535, 2929, 65535, 65535, 3767, 65535, 2013,
+    65535, 65535, 65535, 3732, 1485, 3649, 605, 2202, 245, 4135, 65535, 1792, 3390, 65535, 65535, 65535,
+    65535, 65535, 1842, 65535, 65535, 2182, 65535, 1746, 364, 65535, 1120, 4241, 524, 65535, 1282, 65535,
+    3170, 465, 65535, 1441, 65535, 65535, 65535, 3800, 1025, 65535, 65535, 65535, 65535, 65535, 2780, 1011,
+    65535, 4247, 65535, 65535, 2689, 65535, 3890, 65535, 1937, 65535, 396, 65535, 65535, 306, 1351, 4073,
+    713, 3149, 65535, 65535, 65535, 65535, 948, 65535, 1821, 65535, 65535, 14, 65535, 2421, 1934, 2800,
+    65535, 65535, 23, 65535, 65535, 4248, 65535, 3562, 65535, 65535, 65535, 65535, 65535, 4136, 65535, 3893,
+    1982, 92, 1048, 2157, 1525, 65535, 3534, 65535, 65535, 1557, 358, 65535, 2544, 3798, 3906, 3135,
+    65535, 902, 65535, 65535, 1483, 65535, 933, 65535, 1212, 65535, 3252, 1888, 65535, 65535, 65535, 65535,
+    65535, 65535, 1306, 3598, 2150, 1338, 65535, 65535, 811, 65535, 65535, 65535, 3406, 65535, 65535, 366,
+    65535, 65535, 65535, 65535, 643, 65535, 65535, 65535, 65535, 65535, 65535, 1963, 65535, 3565, 32, 108,
+    65535, 3279, 3852, 65535, 65535, 3405, 1975, 65535, 1127, 65535, 871, 3453, 65535, 3276, 65535, 2085,
+    2381, 20, 2299, 65535, 1588, 65535, 65535, 65535, 3481, 1040, 65535, 3457, 3003, 65535, 65535, 65535,
+    65535, 65535, 3663, 1590, 65535, 65535, 65535, 65535, 65535, 3974, 65535, 65535, 674, 65535, 2491, 1304,
+    65535, 65535, 1092, 65535, 65535, 3018, 65535, 65535, 3278, 1759, 65535, 65535, 3348, 65535, 1155, 65535,
+    1006, 65535, 2430, 65535, 340, 65535, 65535, 619, 408, 65535, 65535, 2000, 164, 251, 65535, 65535,
+    65535, 1062, 65535, 171, 65535, 2394, 2548, 2763, 2335, 3290, 2761, 65535, 2459, 3449, 3425, 316,
+    65535, 65535, 3053, 65535, 3437, 65535, 65535, 3955, 2786, 65535, 3206, 3843, 1597, 3513, 65535, 65535,
+    65535, 1632, 65535, 65535, 65535, 2531, 65535, 65535, 65535, 65535, 65535, 3025, 2552, 1377, 2228, 65535,
+    4094, 2007, 2323, 3780, 562, 65535, 65535, 65535, 65535, 3194, 2956, 2070, 65535, 65535, 65535, 385,
+    2352, 276, 65535, 1767, 65535, 65535, 1919, 2041, 973, 65535, 3489, 2477, 1547, 1744, 3450, 3820,
+    728, 2679, 2257, 2450, 2158, 1429, 4083, 65535, 3625, 65535, 65535, 65535, 775, 65535, 65535, 65535,
+    2963, 2395, 2146, 517, 65535, 65535, 2546, 65535, 65535, 1990, 65535, 65535, 3648, 4129, 65535, 1368,
+    65535, 3308, 65535, 3928, 181, 3048, 65535, 2370, 65535, 65535, 1407, 3628, 65535, 65535, 197, 3038,
+    65535, 65535, 2683, 65535, 65535, 65535, 65535, 180, 65535, 976, 507, 2819, 65535, 65535, 65535, 65535,
+    65535, 1650, 2392, 65535, 454, 1843, 65535, 2651, 65535, 65535, 65535, 2627, 576, 1123, 2374, 3012,
+    65535, 3999, 65535, 65535, 65535, 65535, 65535, 1647, 3763, 65535, 65535, 65535, 2545, 65535, 812, 3850,
+    65535, 413, 1560, 2917, 65535, 3071, 3084, 2509, 65535, 1033, 65535, 65535, 65535, 2937, 65535, 4230,
+    65535, 2001, 263, 635, 133, 65535, 65535, 3908, 65535, 65535, 3819, 3611, 65535, 65535, 65535, 786,
+    1163, 1548, 65535, 65535, 65535, 2148, 123, 2049, 2758, 65535, 65535, 2752, 2341, 65535, 65535, 382,
+    3844, 3731, 65535, 65535, 65535, 2557, 65535, 65535, 65535, 65535, 511, 2611, 65535, 209, 1623, 65535,
+    2065, 281, 3881, 65535, 2301, 39, 65535, 65535, 4020, 4125, 1862, 3265, 65535, 65535, 783, 1512,
+    65535, 1635, 3706, 3986, 2087, 2242, 65535, 3864, 1564, 65535, 65535, 65535, 65535, 65535, 2818, 65535,
+    65535, 1105, 2508, 65535, 65535, 89, 3156, 3209, 701, 65535, 65535, 65535, 65535, 727, 65535, 6,
+    65535, 2481, 44, 65535, 2677, 65535, 1198, 1097, 1241, 2539, 65535, 763, 65535, 1210, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 1959, 1226, 3965, 932, 65535, 1704, 3422, 65535, 2220, 65535,
+    65535, 3270, 65535, 65535, 65535, 2984, 3492, 1442, 3288, 65535, 65535, 65535, 2927, 65535, 1031, 160,
+    65535, 1003, 65535, 65535, 65535, 697, 2851, 65535, 1628, 1972, 4178, 2218, 734, 2985, 4209, 65535,
+    2511, 65535, 568, 65535, 2779, 65535, 984, 4246, 731, 65535, 3043, 2737, 65535, 1951, 65535, 65535,
+    65535, 65535, 65535, 1115, 65535, 65535, 1706, 65535, 1463, 65535, 1988, 2362, 65535, 65535, 3791, 388,
+    65535, 65535, 3990, 3957, 4223, 65535, 2386, 3926, 2999, 65535, 551, 1915, 219, 4199, 65535, 65535,
+    65535, 65535, 2693, 65535, 85, 65535, 3049, 65535, 65535, 65535, 3614, 3491, 2781, 65535, 65535, 65535,
+    3486, 2076, 2796, 1511, 1579, 4089, 65535, 3410, 3962, 65535, 65535, 65535, 65535, 65535, 65535, 3259,
+    65535, 260, 65535, 65535, 2289, 65535, 65535, 3360, 65535, 65535, 65535, 65535, 1056, 1731, 33, 1956,
+    65535, 65535, 2606, 2930, 65535, 65535, 65535, 65535, 65535, 2380, 65535, 65535, 65535, 172, 65535, 65535,
+    65535, 65535, 190, 2718, 65535, 1063, 65535, 65535, 1726, 3004, 65535, 65535, 65535, 68, 549, 65535,
+    490, 65535, 65535, 1578, 65535, 2463, 2478, 65535, 65535, 3032, 4211, 65535, 1709, 916, 65535, 65535,
+    646, 65535, 617, 346, 65535, 30, 2067, 3887, 65535, 65535, 1091, 65535, 3697, 1296, 2597, 1936,
+    65535, 65535, 65535, 1290, 65535, 502, 4043, 65535, 3267, 65535, 65535, 1906, 65535, 3892, 3159, 10,
+    1167, 934, 2355, 1604, 2609, 65535, 1534, 84, 65535, 65535, 3158, 2936, 65535, 65535, 65535, 183,
+    65535, 65535, 65535, 3996, 1866, 2138, 65535, 65535, 65535, 1901, 65535, 3703, 65535, 65535, 65535, 627,
+    2224, 573, 65535, 65535, 784, 1795, 498, 678, 1148, 2932, 3620, 3830, 3966, 65535, 1188, 65535,
+    126, 2510, 65535, 65535, 2426, 3245, 65535, 3190, 65535, 230, 65535, 65535, 3583, 65535, 65535, 2350,
+    65535, 4224, 3915, 65535, 65535, 4032, 65535, 2554, 65535, 2534, 65535, 3744, 2472, 65535, 65535, 1474,
+    1475, 2069, 399, 2037, 65535, 4156, 1606, 1720, 65535, 65535, 3803, 65535, 65535, 65535, 65535, 2353,
+    65535, 65535, 65535, 86, 65535, 65535, 65535, 952, 65535, 3474, 65535, 2095, 65535, 65535, 752, 1797,
+    1520, 65535, 1050, 65535, 65535, 2653, 65535, 65535, 2785, 65535, 2294, 712, 2569, 3433, 65535, 3919,
+    65535, 65535, 65535, 924, 65535, 65535, 65535, 691, 3717, 65535, 2152, 1735, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 1013, 3378, 1223, 65535, 1652, 65535, 65535, 65535, 65535, 1847, 132,
+    1546, 65535, 65535, 65535, 65535, 3309, 665, 2625, 65535, 65535, 1233, 65535, 65535, 65535, 3995, 2255,
+    1689, 65535, 65535, 65535, 2876, 65535, 65535, 65535, 633, 65535, 204, 65535, 1492, 65535, 65535, 65535,
+    3454, 65535, 65535, 65535, 1458, 2615, 65535, 65535, 1832, 3095, 258, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 695, 3478, 2824, 65535, 65535, 1104, 4244, 65535, 65535, 65535, 65535,
+    2960, 65535, 754, 65535, 1721, 938, 65535, 3229, 2143, 65535, 4192, 3005, 65535, 1949, 1619, 65535,
+    65535, 65535, 65535, 174, 1004, 65535, 354, 65535, 65535, 2971, 1528, 65535, 3174, 143, 65535, 1350,
+    1499, 65535, 65535, 3806, 65535, 1532, 4259, 326, 3346, 985, 595, 2764, 3949, 4218, 1573, 3931,
+    65535, 65535, 1802, 3235, 65535, 65535, 65535, 65535, 1037, 65535, 2514, 4174, 1059, 2623, 3137, 3011,
+    65535, 3118, 586, 65535, 65535, 65535, 65535, 4134, 65535, 65535, 1388, 65535, 3942, 365, 3140, 65535,
+    1896, 65535, 65535, 3241, 65535, 65535, 3973, 4172, 65535, 65535, 348, 65535, 442, 65535, 65535, 65535,
+    65535, 65535, 65535, 3306, 1540, 65535, 774, 65535, 378, 1889, 2137, 65535, 65535, 3162, 29, 65535,
+    65535, 218, 65535, 1902, 65535, 2446, 65535, 3493, 65535, 1648, 4108, 65535, 1055, 65535, 428, 65535,
+    65535, 65535, 1287, 65535, 2879, 3903, 1263, 790, 2822, 3826, 65535, 65535, 65535, 65535, 65535, 3868,
+    65535, 2251, 65535, 2986, 2331, 65535, 65535, 65535, 65535, 65535, 2735, 599, 249, 65535, 65535, 65535,
+    703, 2161, 2836, 65535, 363, 56, 3443, 1165, 220, 2842, 683, 3754, 2812, 3, 3679, 65535,
+    65535, 65535, 65535, 2420, 65535, 3255, 1944, 65535, 65535, 65535, 77, 65535, 2388, 65535, 2141, 65535,
+    65535, 1238, 1998, 65535, 65535, 3547, 65535, 3899, 65535, 65535, 65535, 440, 2243, 748, 2342, 822,
+    65535, 128, 0, 1695, 65535, 244, 65535, 2946, 65535, 1942, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 167, 65535, 3797, 2351, 65535, 65535, 65535, 65535, 65535, 65535, 1324,
+    65535, 1625, 4030, 65535, 65535, 65535, 65535, 65535, 2583, 663, 967, 1887, 65535, 65535, 65535, 766,
+    960, 2721, 65535, 65535, 65535, 2423, 65535, 65535, 65535, 2614, 841, 2723, 2036, 191, 65535, 65535,
+    140, 832, 65535, 65535, 3537, 65535, 2136, 65535, 65535, 4179, 2457, 415, 65535, 1102, 65535, 65535,
+    4221, 210, 3818, 1311, 814, 65535, 65535, 397, 853, 65535, 65535, 65535, 2312, 65535, 3846, 1333,
+    65535, 65535, 65535, 65535, 1846, 1450, 3490, 1379, 2110, 283, 4090, 3230, 3096, 894, 2955, 65535,
+    65535, 65535, 65535, 65535, 1415, 2326, 65535, 65535, 3377, 4053, 2186, 65535, 4236, 3723, 2734, 3065,
+    2434, 3338, 46, 65535, 3497, 1996, 65535, 65535, 65535, 1447, 696, 65535, 65535, 65535, 65535, 1567,
+    65535, 2043, 65535, 3654, 2176, 65535, 2190, 65535, 4205, 1739, 65535, 150, 15, 3143, 65535, 3637,
+    2290, 2664, 542, 3383, 1667, 65535, 1780, 65535, 2629, 65535, 65535, 65535, 2496, 65535, 65535, 618,
+    65535, 500, 159, 65535, 65535, 65535, 3626, 3287, 1531, 2865, 2506, 65535, 65535, 65535, 3067, 3975,
+    65535, 65535, 65535, 65535, 1229, 65535, 722, 65535, 2266, 144, 65535, 359, 65535, 65535, 65535, 710,
+    65535, 65535, 3114, 65535, 2475, 65535, 567, 287, 65535, 65535, 897, 94, 65535, 65535, 4113, 65535,
+    1191, 687, 65535, 4060, 65535, 2775, 1497, 4240, 2906, 4260, 65535, 2116, 65535, 65535, 65535, 3337,
+    2333, 1375, 65535, 2103, 4131, 65535, 65535, 1005, 317, 571, 4112, 780, 2454, 3121, 3917, 2369,
+    65535, 65535, 3531, 65535, 65535, 65535, 2178, 2767, 3747, 65535, 65535, 65535, 3863, 65535, 65535, 65535,
+    238, 65535, 65535, 65535, 1939, 65535, 4138, 65535, 1962, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    1007, 4210, 2728, 429, 1737, 3877, 1219, 3907, 3627, 65535, 3286, 1109, 2617, 110, 2012, 65535,
+    3020, 65535, 65535, 328, 65535, 1058, 65535, 3817, 1237, 65535, 65535, 65535, 421, 4196, 65535, 233,
+    65535, 65535, 4197, 65535, 1189, 2778, 65535, 1215, 65535, 3258, 65535, 1000, 2425, 1881, 65535, 65535,
+    267, 3991, 4037, 1093, 742, 3783, 1600, 596, 3384, 2320, 65535, 1079, 65535, 65535, 65535, 65535,
+    65535, 3139, 65535, 557, 3809, 65535, 65535, 65535, 145, 552, 65535, 65535, 4036, 65535, 423, 3222,
+    2163, 1508, 3775, 65535, 154, 65535, 983, 64, 65535, 3700, 103, 3468, 738, 2474, 3538, 65535,
+    2858, 857, 1074, 1314, 65535, 65535, 65535, 1034, 65535, 65535, 1234, 65535, 65535, 4143, 65535, 65535,
+    65535, 4006, 1164, 65535, 65535, 3623, 2592, 65535, 4235, 1366, 2859, 2471, 65535, 347, 807, 4270,
+    65535, 2078, 2897, 65535, 65535, 65535, 65535, 292, 2239, 1319, 65535, 65535, 65535, 4011, 65535, 1663,
+    65535, 1890, 819, 3970, 65535, 272, 65535, 65535, 65535, 65535, 3603, 3511, 1243, 4025, 65535, 65535,
+    2558, 1496, 730, 479, 65535, 2774, 65535, 956, 264, 1566, 65535, 65535, 65535, 1732, 65535, 65535,
+    2487, 3948, 510, 3177, 65535, 2502, 65535, 65535, 1370, 65535, 736, 65535, 954, 2643, 65535, 65535,
+    1910, 1711, 981, 1569, 2871, 65535, 545, 65535, 3144, 690, 3604, 753, 2695, 2099, 750, 65535,
+    3439, 65535, 65535, 65535, 65535, 1116, 2530, 65535, 19, 65535, 65535, 3131, 65535, 2225, 2708, 65535,
+    65535, 2208, 65535, 2589, 65535, 1514, 65535, 813, 3557, 2495, 65535, 65535, 65535, 65535, 4186, 65535,
+    2361, 65535, 1675, 3527, 1664, 65535, 2216, 3725, 65535, 65535, 65535, 65535, 65535, 124, 3034, 3441,
+    222, 65535, 1459, 2093, 1624, 2189, 1655, 65535, 65535, 1946, 65535, 9, 4128, 65535, 116, 3711,
+    65535, 65535, 1621, 65535, 1438, 4213, 1454, 3104, 65535, 1766, 1493, 65535, 4074, 65535, 2391, 65535,
+    3858, 65535, 65535, 3930, 4151, 3920, 773, 3514, 4170, 2345, 65535, 1736, 795, 65535, 2731, 65535,
+    65535, 65535, 65535, 3409, 3035, 65535, 2923, 65535, 3724, 65535, 65535, 117, 65535, 65535, 65535, 65535,
+    65535, 3951, 1878, 65535, 1261, 737, 3421, 65535, 3585, 2096, 1617, 65535, 65535, 65535, 65535, 65535,
+    1265, 1574, 2720, 65535, 65535, 858, 65535, 65535, 630, 725, 915, 3762, 65535, 65535, 337, 65535,
+    2703, 65535, 2913, 2356, 4010, 65535, 65535, 65535, 135, 3756, 1098, 1930, 65535, 65535, 65535, 2031,
+    2948, 769, 3299, 3301, 1292, 580, 65535, 65535, 65535, 1989, 65535, 3655, 3019, 1427, 65535, 628,
+    65535, 65535, 65535, 3352, 815, 65535, 537, 1068, 65535, 65535, 3983, 65535, 65535, 65535, 3684, 65535,
+    3558, 3861, 65535, 2631, 65535, 862, 2501, 2746, 2368, 65535, 65535, 121, 65535, 798, 544, 65535,
+    1920, 2210, 65535, 65535, 65535, 3094, 65535, 65535, 65535, 1337, 2003, 65535, 3645, 65535, 65535, 2315,
+    65535, 65535, 3469, 65535, 438, 65535, 65535, 65535, 65535, 1371, 65535, 82, 3014, 1941, 65535, 65535,
+    1686, 1297, 65535, 464, 65535, 65535, 1281, 65535, 65535, 906, 65535, 65535, 65535, 65535, 2512, 2164,
+    65535, 1256, 65535, 65535, 2559, 2888, 65535, 65535, 3470, 65535, 405, 65535, 3029, 762, 3653, 3106,
+    2390, 274, 65535, 1064, 65535, 2025, 65535, 65535, 65535, 3607, 65535, 3100, 1345, 65535, 65535, 65535,
+    65535, 65535, 65535, 1568, 65535, 65535, 65535, 2792, 65535, 65535, 1061, 589, 65535, 1190, 65535, 65535,
+    972, 2828, 65535, 65535, 2784, 65535, 2117, 3771, 65535, 982, 699, 1174, 65535, 3189, 65535, 65535,
+    2527, 65535, 65535, 360, 1246, 65535, 334, 1385, 78, 65535, 3579, 1069, 65535, 65535, 4102, 65535,
+    65535, 2366, 65535, 65535, 4175, 65535, 4012, 232, 2364, 239, 65535, 2928, 1500, 65535, 65535, 65535,
+    65535, 3001, 2288, 1688, 3358, 427, 65535, 65535, 65535, 65535, 2467, 65535, 342, 65535, 65535, 977,
+    3956, 1349, 65535, 1615, 65535, 65535, 65535, 65535, 2155, 2717, 2057, 65535, 65535, 4099, 3545, 65535,
+    3530, 582, 2098, 65535, 65535, 65535, 65535, 3242, 2790, 3232, 3988, 65535, 65535, 2658, 3419, 65535,
+    65535, 65535, 65535, 65535, 65535, 2804, 1171, 4153, 65535, 1437, 1955, 2910, 65535, 65535, 65535, 2075,
+    2524, 2954, 65535, 65535, 4216, 980, 3117, 3303, 65535, 1305, 2258, 65535, 1288, 65535, 65535, 65535,
+    65535, 65535, 65535, 2160, 65535, 604, 65535, 65535, 2088, 75, 715, 65535, 65535, 1326, 2054, 2877,
+    65535, 65535, 4271, 65535, 563, 1452, 65535, 508, 65535, 65535, 816, 2647, 65535, 65535, 940, 65535,
+    2848, 65535, 65535, 65535, 65535, 1713, 65535, 65535, 1002, 65535, 394, 3045, 3246, 2678, 65535, 65535,
+    3274, 4262, 65535, 1850, 65535, 2407, 1691, 65535, 1052, 1501, 2398, 234, 3343, 4152, 1479, 65535,
+    561, 2626, 1861, 3642, 740, 3292, 1101, 3123, 3210, 1969, 1259, 4044, 65535, 2869, 2442, 65535,
+    65535, 65535, 65535, 65535, 3247, 65535, 65535, 65535, 65535, 65535, 2893, 65535, 65535, 65535, 212, 794,
+    65535, 299, 1465, 65535, 65535, 3687, 3336, 2415, 65535, 65535, 65535, 3589, 65535, 65535, 1090, 3536,
+    65535, 2754, 7, 65535, 65535, 2743, 65535, 651, 1607, 540, 65535, 65535, 3612, 65535, 282, 1517,
+    65535, 2269, 65535, 65535, 1918, 1612, 1362, 461, 2850, 65535, 65535, 685, 65535, 914, 65535, 65535,
+    65535, 107, 65535, 207, 3254, 329, 2385, 4159, 4000, 65535, 4200, 65535, 65535, 1914, 65535, 65535,
+    65535, 65535, 65535, 426, 3328, 65535, 65535, 65535, 65535, 65535, 1510, 4088, 4277, 2922, 1863, 65535,
+    65535, 2503, 65535, 65535, 1585, 65535, 3362, 65535, 1608, 1205, 298, 65535, 3570, 65535, 65535, 65535,
+    65535, 3549, 1382, 672, 4110, 1616, 65535, 65535, 3831, 65535, 3722, 877, 65535, 65535, 65535, 65535,
+    65535, 65535, 988, 65535, 1266, 65535, 65535, 2191, 65535, 768, 65535, 1838, 3476, 370, 3788, 65535,
+    65535, 65535, 1082, 532, 65535, 65535, 65535, 2104, 3459, 65535, 3802, 65535, 65535, 4056, 65535, 3379,
+    1495, 351, 65535, 3661, 2940, 65535, 487, 519, 57, 65535, 1196, 2379, 65535, 4029, 65535, 1399,
+    1341, 65535, 65535, 1352, 65535, 65535, 65535, 65535, 65535, 2576, 65535, 65535, 4034, 1668, 65535, 1251,
+    65535, 42, 3507, 2918, 2032, 65535, 2147, 65535, 65535, 65535, 65535, 65535, 225, 2112, 3779, 2418,
+    2097, 65535, 65535, 831, 65535, 2188, 65535, 65535, 4142, 65535, 2939, 2297, 65535, 1428, 4169, 65535,
+    352, 65535, 65535, 65535, 1716, 65535, 65535, 65535, 65535, 65535, 65535, 455, 65535, 115, 65535, 2994,
+    65535, 2645, 1645, 2516, 65535, 65535, 65535, 2974, 2801, 65535, 291, 2016, 3592, 65535, 2840, 65535,
+    65535, 345, 1490, 3388, 2291, 65535, 1622, 65535, 2435, 3261, 309, 3529, 27, 65535, 1331, 2533,
+    1355, 65535, 65535, 65535, 65535, 1460, 1572, 2480, 65535, 4069, 65535, 65535, 65535, 65535, 3596, 65535,
+    65535, 228, 4121, 1820, 1480, 65535, 65535, 65535, 4046, 65535, 2306, 51, 4021, 65535, 65535, 2806,
+    65535, 4096, 2528, 2990, 65535, 65535, 65535, 65535, 1908, 3056, 65535, 65535, 2153, 911, 1909, 1498,
+    1646, 65535, 65535, 1182, 65535, 698, 65535, 65535, 1924, 472, 3351, 1018, 1809, 65535, 2068, 3526,
+    65535, 1596, 521, 65535, 1131, 1401, 1958, 1095, 152, 2334, 65535, 65535, 1855, 65535, 65535, 65535,
+    65535, 4188, 533, 65535, 65535, 148, 3051, 3561, 4068, 2751, 31, 1643, 1487, 65535, 65535, 65535,
+    65535, 3969, 2267, 65535, 732, 65535, 655, 1289, 65535, 1224, 1486, 1904, 3635, 623, 65535, 65535,
+    1466, 65535, 4075, 65535, 3037, 667, 1488, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 3856, 3374,
+    3984, 65535, 65535, 1595, 65535, 65535, 65535, 1840, 65535, 65535, 65535, 3167, 65535, 65535, 3506, 1087,
+    65535, 65535, 65535, 2308, 65535, 2293, 65535, 1180, 1300, 65535, 516, 2690, 65535, 262, 65535, 65535,
+    1997, 1179, 65535, 65535, 1722, 65535, 65535, 3735, 65535, 2127, 65535, 2360, 65535, 65535, 995, 2052,
+    65535, 883, 65535, 65535, 3214, 2672, 65535, 65535, 223, 4150, 65535, 1660, 65535, 65535, 1723, 65535,
+    65535, 3256, 65535, 65535, 65535, 65535, 65535, 3371, 65535, 828, 65535, 65535, 2655, 463, 65535, 65535,
+    868, 3335, 65535, 65535, 65535, 2183, 4190, 2945, 2715, 4126, 1397, 2852, 65535, 65535, 1980, 65535,
+    367, 65535, 65535, 2444, 2338, 65535, 706, 65535, 3339, 3432, 303, 161, 65535, 65535, 1411, 2692,
+    65535, 65535, 65535, 65535, 65535, 451, 3595, 2268, 65535, 3347, 259, 65535, 65535, 134, 65535, 1071,
+    65535, 65535, 65535, 65535, 65535, 3600, 2274, 2710, 65535, 776, 65535, 65535, 65535, 2040, 65535, 403,
+    65535, 65535, 743, 1398, 65535, 65535, 2286, 3120, 65535, 65535, 65535, 2451, 1857, 65535, 3710, 65535,
+    65535, 65535, 3006, 4065, 65535, 1359, 4105, 65535, 2497, 1677, 2107, 4254, 689, 65535, 65535, 622,
+    65535, 277, 65535, 758, 65535, 1409, 2846, 65535, 3226, 1580, 65535, 608, 65535, 3171, 2349, 65535,
+    418, 2437, 999, 1669, 3205, 3314, 3707, 65535, 566, 1911, 4100, 65535, 1933, 625, 1472, 907,
+    4233, 65535, 182, 3927, 65535, 2916, 65535, 3296, 1787, 65535, 65535, 2682, 65535, 65535, 2130, 3396,
+    327, 65535, 3552, 996, 2465, 65535, 65535, 2409, 65535, 3838, 65535, 311, 3203, 158, 65535, 339,
+    3758, 1978, 65535, 104, 2573, 2402, 830, 65535, 718, 3882, 65535, 3363, 1848, 2201, 4284, 65535,
+    3924, 65535, 65535, 65535, 3228, 65535, 2499, 2662, 65535, 65535, 65535, 2303, 65535, 452, 65535, 65535,
+    1073, 3455, 1699, 2002, 870, 65535, 65535, 65535, 65535, 65535, 201, 1207, 3176, 65535, 65535, 65535,
+    65535, 3000, 65535, 65535, 529, 445, 65535, 1051, 65535, 65535, 1446, 65535, 65535, 301, 65535, 65535,
+    65535, 65535, 65535, 4059, 1953, 65535, 65535, 953, 2397, 65535, 65535, 65535, 2709, 65535, 12, 2749,
+    195, 1113, 1329, 65535, 1804, 975, 867, 4225, 65535, 65535, 65535, 1893, 65535, 65535, 2584, 65535,
+    65535, 2646, 65535, 65535, 2344, 65535, 704, 3993, 2053, 65535, 3426, 65535, 65535, 65535, 4001, 65535,
+    1291, 65535, 65535, 3950, 65535, 65535, 65535, 1357, 2134, 2953, 4231, 430, 65535, 269, 1019, 65535,
+    3097, 65535, 2140, 65535, 65535, 955, 65535, 65535, 1979, 65535, 65535, 913, 65535, 65535, 3673, 2433,
+    3068, 65535, 65535, 2170, 65535, 65535, 65535, 607, 65535, 771, 3126, 65535, 65535, 836, 1626, 65535,
+    65535, 349, 1240, 2324, 65535, 4215, 1559, 3692, 1868, 2889, 65535, 1725, 2154, 1834, 3342, 65535,
+    1283, 65535, 2129, 3199, 65535, 65535, 1943, 65535, 469, 1136, 65535, 1562, 3191, 65535, 4023, 65535,
+    1183, 3088, 2131, 615, 65535, 797, 2864, 3239, 3964, 65535, 634, 1387, 1119, 279, 65535, 65535,
+    65535, 788, 2282, 65535, 991, 65535, 3849, 65535, 65535, 3836, 65535, 2247, 65535, 65535, 65535, 65535,
+    1867, 1756, 65535, 65535, 2722, 65535, 3896, 402, 2200, 65535, 65535, 65535, 3621, 1700, 1315, 3937,
+    65535, 65535, 65535, 65535, 2668, 65535, 3577, 2832, 5, 2171, 3841, 1081, 65535, 65535, 2254, 3002,
+    2843, 1682, 3876, 2307, 65535, 109, 2436, 1886, 65535, 65535, 65535, 65535, 1394, 65535, 2868, 1707,
+    318, 65535, 65535, 1347, 65535, 3593, 3813, 65535, 65535, 65535, 65535, 65535, 477, 65535, 2872, 65535,
+    3792, 535, 65535, 65535, 65535, 65535, 2089, 65535, 1108, 65535, 65535, 1477, 65535, 1681, 65535, 2115,
+    200, 65535, 2610, 65535, 65535, 65535, 2895, 65535, 2513, 65535, 65535, 65535, 250, 65535, 65535, 65535,
+    1046, 1310, 1869, 65535, 2902, 2856, 2551, 65535, 4207, 65535, 3179, 65535, 809, 3810, 1639, 1461,
+    951, 3295, 65535, 65535, 3842, 377, 65535, 3185, 296, 2005, 65535, 65535, 1747, 65535, 65535, 322,
+    2452, 2432, 65535, 1877, 65535, 65535, 3223, 65535, 3030, 65535, 65535, 3182, 3862, 65535, 1727, 1770,
+    711, 65535, 65535, 65535, 65535, 65535, 2056, 65535, 65535, 3979, 3848, 1786, 4163, 2173, 65535, 673,
+    65535, 3904, 65535, 65535, 1685, 3749, 4118, 759, 518, 782, 1372, 98, 2649, 3617, 1122, 905,
+    2348, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 3517, 2855, 705, 1642, 3837, 2562, 65535,
+    65535, 1806, 3151, 65535, 65535, 1545, 1853, 555, 65535, 1630, 65535, 1777, 1455, 3916, 2339, 4146,
+    839, 2092, 3765, 67, 707, 1015, 65535, 65535, 65535, 829, 65535, 1154, 2443, 65535, 1758, 65535,
+    65535, 65535, 4176, 1086, 73, 1799, 1922, 3571, 1774, 65535, 2332, 3333, 65535, 88, 65535, 2991,
+    407, 657, 2232, 393, 65535, 65535, 65535, 65535, 142, 257, 3606, 65535, 65535, 3215, 2246, 65535,
+    2997, 65535, 65535, 4276, 741, 1293, 65535, 65535, 1662, 65535, 65535, 65535, 65535, 1269, 1730, 216,
+    603, 2330, 65535, 3102, 65535, 65535, 65535, 2226, 3796, 65535, 1549, 65535, 65535, 3947, 4264, 3913,
+    65535, 65535, 3647, 65535, 247, 65535, 65535, 1384, 4206, 3755, 65535, 3112, 65535, 65535, 65535, 4263,
+    65535, 65535, 65535, 2619, 2194, 3021, 410, 4183, 3323, 1788, 65535, 1045, 1894, 460, 65535, 65535,
+    3741, 3659, 1149, 65535, 65535, 65535, 65535, 65535, 2359, 1413, 65535, 2383, 2670, 2595, 65535, 4097,
+    65535, 65535, 203, 65535, 65535, 65535, 243, 65535, 958, 3401, 1556, 65535, 65535, 65535, 65535, 2900,
+    65535, 65535, 65535, 65535, 3633, 475, 3466, 65535, 2566, 65535, 65535, 1217, 65535, 65535, 3550, 65535,
+    65535, 65535, 65535, 65535, 3078, 65535, 654, 2382, 65535, 65535, 686, 65535, 1216, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 3560, 4085, 2219, 3961, 65535, 65535, 65535, 65535, 1828, 808,
+    1448, 305, 919, 3752, 4164, 65535, 65535, 65535, 2181, 65535, 3175, 3982, 2829, 3484, 1665, 1294,
+    3072, 4002, 65535, 2578, 65535, 65535, 65535, 2238, 65535, 1096, 65535, 65535, 65535, 2427, 65535, 65535,
+    65535, 3317, 612, 65535, 65535, 2642, 3204, 2621, 2803, 65535, 1405, 3883, 3980, 65535, 65535, 1473,
+    1845, 65535, 65535, 65535, 439, 1078, 102, 3750, 1712, 3429, 65535, 1434, 4101, 2622, 11, 65535,
+    65535, 2660, 613, 380, 3218, 65535, 65535, 818, 65535, 65535, 65535, 65535, 65535, 3344, 2681, 65535,
+    65535, 65535, 3213, 1824, 2322, 3712, 3657, 65535, 65535, 1386, 3311, 65535, 65535, 65535, 65535, 65535,
+    2845, 854, 1858, 357, 2639, 65535, 3207, 2912, 240, 65535, 65535, 65535, 2458, 65535, 3340, 1195,
+    3894, 65535, 928, 709, 65535, 65535, 1009, 1954, 65535, 65535, 1277, 1298, 1360, 2965, 669, 65535,
+    1966, 65535, 65535, 2747, 2020, 4082, 65535, 943, 3367, 65535, 65535, 65535, 1125, 2870, 65535, 1875,
+    65535, 3089, 65535, 950, 65535, 3495, 2151, 1879, 65535, 65535, 653, 4219, 2874, 65535, 3564, 65535,
+    65535, 1822, 65535, 65535, 65535, 3866, 65535, 1729, 65535, 65535, 882, 65535, 65535, 2983, 65535, 3646,
+    2445, 3113, 65535, 65535, 404, 65535, 65535, 1356, 1462, 65535, 72, 65535, 1273, 65535, 3150, 65535,
+    1856, 65535, 65535, 3563, 65535, 466, 1659, 65535, 1001, 1274, 2961, 525, 65535, 3129, 65535, 65535,
+    65535, 65535, 4267, 65535, 65535, 2221, 3738, 65535, 65535, 1111, 208, 1761, 629, 2802, 4066, 65535,
+    3822, 65535, 1558, 202, 3693, 65535, 65535, 65535, 2327, 65535, 3699, 65535, 3729, 3200, 1166, 548,
+    3480, 65535, 2791, 840, 65535, 1168, 65535, 3075, 1247, 65535, 1929, 3136, 49, 350, 198, 4063,
+    65535, 65535, 65535, 3415, 3220, 2808, 642, 1836, 565, 65535, 3155, 2756, 65535, 1232, 65535, 2724,
+    65535, 65535, 65535, 2726, 2736, 65535, 1457, 65535, 2280, 714, 4239, 65535, 65535, 2711, 65535, 4145,
+    65535, 3130, 65535, 2440, 65535, 3946, 65535, 2313, 2807, 65535, 45, 65535, 65535, 3202, 65535, 65535,
+    2209, 65535, 1363, 570, 65535, 3739, 4266, 24, 65535, 65535, 65535, 65535, 485, 3165, 3307, 113,
+    65535, 65535, 65535, 2101, 2750, 3666, 236, 1158, 1985, 3533, 65535, 2931, 1526, 65535, 65535, 65535,
+    333, 3147, 65535, 65535, 302, 2582, 1482, 65535, 3024, 65535, 3393, 3879, 65535, 3273, 2248, 4212,
+    3658, 65535, 65535, 1358, 2753, 65535, 65535, 3512, 65535, 65535, 3902, 1268, 65535, 3935, 65535, 1760,
+    65535, 3505, 3753, 3321, 3998, 192, 3391, 3322, 65535, 65535, 65535, 957, 2309, 65535, 65535, 1690,
+    35, 65535, 873, 65535, 65535, 65535, 4214, 65535, 65535, 28, 1468, 65535, 2574, 65535, 65535, 65535,
+    575, 2890, 1142, 1674, 847, 65535, 65535, 2793, 65535, 65535, 1898, 2841, 65535, 1157, 65535, 2318,
+    3092, 313, 65535, 65535, 1505, 65535, 65535, 3588, 656, 65535, 936, 1445, 1178, 65535, 661, 724,
+    450, 1880, 65535, 2284, 1439, 65535, 2038, 1891, 65535, 65535, 280, 1808, 2742, 3233, 65535, 65535,
+    65535, 3132, 3601, 65535, 65535, 65535, 65535, 2952, 3705, 65535, 3805, 65535, 65535, 65535, 175, 65535,
+    65535, 65535, 65535, 3770, 2245, 65535, 65535, 65535, 65535, 65535, 1088, 65535, 65535, 2317, 65535, 65535,
+    1348, 65535, 2071, 65535, 65535, 65535, 3061, 65535, 65535, 2325, 65535, 65535, 2389, 65535, 1433, 1748,
+    65535, 2628, 65535, 3298, 65535, 65535, 65535, 65535, 65535, 65535, 817, 65535, 1184, 65535, 65535, 65535,
+    1008, 1197, 65535, 65535, 65535, 2413, 65535, 65535, 65535, 65535, 4181, 65535, 3280, 65535, 65535, 65535,
+    682, 48, 1544, 2833, 2047, 721, 3022, 688, 65535, 844, 65535, 2725, 1684, 2688, 2795, 65535,
+    65535, 187, 2814, 640, 3778, 929, 65535, 65535, 2195, 1833, 2875, 65535, 2240, 733, 65535, 65535,
+    65535, 65535, 65535, 2915, 65535, 443, 65535, 3236, 65535, 65535, 65535, 2925, 65535, 65535, 65535, 2520,
+    65535, 65535, 65535, 65535, 495, 1404, 949, 65535, 65535, 4184, 65535, 65535, 65535, 2911, 65535, 65535,
+    65535, 803, 2417, 65535, 2920, 65535, 1551, 65535, 65535, 523, 965, 65535, 65535, 1521, 992, 1094,
+    3326, 2704, 65535, 65535, 65535, 2926, 4015, 65535, 65535, 65535, 65535, 65535, 65535, 1897, 65535, 441,
+    65535, 65535, 65535, 610, 81, 65535, 3124, 1214, 1854, 65535, 2375, 1284, 65535, 65535, 2964, 146,
+    2504, 2560, 501, 3898, 3587, 594, 1151, 3580, 1839, 2347, 65535, 65535, 1583, 1529, 65535, 65535,
+    65535, 100, 869, 65535, 65535, 3554, 2305, 65535, 65535, 4009, 65535, 2523, 65535, 4217, 65535, 2464,
+    2400, 2633, 65535, 65535, 694, 65535, 1099, 65535, 3952, 2575, 65535, 65535, 1029, 2479, 65535, 835,
+    879, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 3015, 2652, 65535, 65535, 65535, 3575, 1816, 65535,
+    65535, 3685, 65535, 65535, 65535, 1017, 861, 65535, 2367, 55, 2175, 65535, 1402, 65535, 65535, 65535,
+    65535, 65535, 3944, 2733, 65535, 1986, 65535, 4182, 65535, 585, 4040, 65535, 614, 1380, 3715, 1400,
+    169, 65535, 65535, 65535, 1153, 65535, 668, 65535, 1620, 3586, 3815, 65535, 65535, 65535, 65535, 65535,
+    805, 2665, 3516, 1835, 4140, 65535, 65535, 65535, 2634, 65535, 65535, 65535, 65535, 791, 3932, 65535,
+    781, 2571, 65535, 2782, 65535, 65535, 2340, 3985, 2644, 173, 2873, 65535, 3675, 65535, 65535, 3452,
+    65535, 353, 600, 185, 65535, 65535, 65535, 601, 65535, 63, 65535, 1244, 62, 3925, 65535, 65535,
+    65535, 4035, 65535, 4087, 2650, 2714, 65, 971, 65535, 2741, 3059, 65535, 65535, 1950, 65535, 65535,
+    503, 13, 65535, 3180, 65535, 2547, 65535, 65535, 118, 2968, 3669, 3313, 65535, 65535, 2028, 65535,
+    3188, 65535, 65535, 65535, 65535, 1303, 4070, 65535, 395, 4115, 637, 65535, 3277, 65535, 65535, 2287,
+    65535, 3721, 1779, 65535, 65535, 2281, 65535, 65535, 4133, 1981, 1177, 2310, 2166, 1928, 65535, 65535,
+    65535, 2203, 65535, 2447, 59, 65535, 65535, 1719, 65535, 3911, 65535, 65535, 3978, 65535, 3968, 1762,
+    65535, 65535, 2671, 65535, 65535, 2567, 4081, 65535, 2978, 65535, 65535, 65535, 1053, 65535, 65535, 65535,
+    65535, 65535, 65535, 1264, 65535, 1921, 4251, 162, 2684, 65535, 379, 65535, 65535, 3485, 2017, 65535,
+    1417, 65535, 2998, 65535, 2378, 3569, 4280, 2314, 4, 65535, 65535, 3539, 2159, 3445, 3618, 65535,
+    3427, 3115, 1137, 65535, 65535, 1971, 3816, 2230, 65535, 1435, 65535, 1813, 65535, 3099, 2172, 65535,
+    65535, 536, 3417, 65535, 168, 65535, 3875, 65535, 65535, 2081, 65535, 65535, 2579, 65535, 65535, 65535,
+    2082, 2213, 65535, 2448, 1451, 65535, 1530, 856, 65535, 65535, 1948, 2399, 65535, 65535, 1181, 65535,
+    3854, 65535, 65535, 65535, 2196, 65535, 3757, 3366, 926, 52, 76, 65535, 1561, 2970, 2045, 1,
+    2010, 2199, 65535, 3208, 65535, 2177, 3872, 65535, 65535, 1769, 65535, 65535, 65535, 65535, 65535, 772,
+    2666, 65535, 65535, 65535, 2207, 1605, 1542, 65535, 65535, 65535, 65535, 65535, 65535, 3122, 527, 65535,
+    65535, 65535, 65535, 2236, 804, 2461, 65535, 65535, 611, 65535, 874, 65535, 3463, 2969, 3243, 65535,
+    3073, 65535, 2810, 65535, 217, 2686, 65535, 419, 65535, 65535, 1138, 65535, 1935, 65535, 4054, 3847,
+    1537, 1522, 1552, 65535, 1312, 3160, 65535, 2744, 2063, 65535, 664, 178, 1143, 65535, 3017, 1376,
+    65535, 65535, 890, 65535, 2975, 3943, 2329, 65535, 65535, 541, 65535, 908, 266, 2235, 3458, 4187,
+    65535, 65535, 4171, 65535, 1768, 65535, 65535, 65535, 2490, 1245, 1203, 4154, 3460, 332, 3487, 918,
+    65535, 1083, 147, 3760, 65535, 65535, 3077, 65535, 65535, 65535, 65535, 268, 65535, 1114, 4050, 2167,
+    2125, 65535, 65535, 2169, 2285, 65535, 785, 2867, 3540, 1984, 1235, 65535, 65535, 65535, 65535, 65535,
+    3728, 3923, 65535, 3532, 1794, 3807, 3081, 2439, 65535, 624, 65535, 3058, 2600, 65535, 2995, 2687,
+    1883, 65535, 65535, 3515, 4003, 2705, 1208, 65535, 2637, 1126, 3193, 65535, 65535, 550, 2139, 2933,
+    65535, 65535, 2977, 480, 3833, 65535, 65535, 2094, 3192, 658, 65535, 3402, 3748, 2861, 1476, 2882,
+    2949, 65535, 1584, 1391, 1873, 65535, 1627, 65535, 65535, 65535, 65535, 300, 65535, 65535, 65535, 2857,
+    65535, 444, 746, 65535, 2500, 3260, 2469, 65535, 411, 3146, 65535, 3331, 1576, 1513, 65535, 2669,
+    65535, 1431, 65535, 3686, 65535, 3733, 65535, 65535, 2086, 65535, 4222, 1516, 3168, 65535, 65535, 65535,
+    119, 3052, 65535, 3284, 1876, 1242, 2488, 65535, 65535, 1506, 3054, 65535, 1456, 65535, 65535, 2636,
+    3704, 2799, 65535, 65535, 65535, 65535, 764, 917, 538, 1536, 2601, 2149, 3161, 65535, 449, 65535,
+    270, 2656, 880, 324, 65535, 2411, 2908, 65535, 65535, 2060, 65535, 155, 65535, 65535, 1961, 65535,
+    65535, 2277, 1317, 3522, 65535, 2972, 65535, 65535, 1683, 65535, 2565, 3108, 65535, 65535, 4173, 65535,
+    65535, 65535, 3154, 1221, 4013, 65535, 65535, 65535, 3389, 2947, 4077, 65535, 2270, 65535, 1419, 1641,
+    65535, 793, 2376, 65535, 2738, 1144, 1694, 65535, 4091, 65535, 597, 401, 65535, 1340, 3994, 65535,
+    65535, 65535, 1313, 3181, 65535, 65535, 1132, 65535, 1601, 65535, 3790, 65535, 65535, 3708, 3482, 65535,
+    2951, 65535, 65535, 65535, 65535, 4228, 3266, 65535, 2894, 65535, 65535, 65535, 609, 3701, 65535, 3370,
+    65535, 1995, 414, 3694, 65535, 65535, 4086, 65535, 65535, 3042, 65535, 3416, 2122, 65535, 221, 2885,
+    2272, 65535, 65535, 3240, 65535, 3400, 65535, 65535, 1565, 65535, 3211, 406, 2525, 65535, 670, 3656,
+    2556, 213, 65535, 65535, 1478, 1412, 2826, 65535, 553, 2162, 2613, 3668, 65535, 65535, 2449, 65535,
+    65535, 65535, 2564, 2748, 3650, 65535, 2577, 398, 65535, 2354, 1085, 927, 1080, 65535, 3885, 3520,
+    65535, 65535, 1515, 2570, 65535, 3619, 65535, 65535, 65535, 1270, 447, 65535, 744, 65535, 2015, 65535,
+    1773, 65535, 2271, 3859, 65535, 1443, 65535, 65535, 4268, 515, 65535, 434, 947, 3498, 3787, 65535,
+    1135, 2233, 65535, 4180, 1254, 4067, 65535, 65535, 369, 65535, 2337, 3302, 3127, 4120, 65535, 65535,
+    50, 65535, 1322, 65535, 1553, 65535, 65535, 644, 1423, 65535, 3855, 65535, 65535, 3981, 1947, 65535,
+    2966, 1593, 65535, 2716, 65535, 2740, 4165, 1192, 65535, 65535, 3282, 2261, 3508, 65535, 65535, 1791,
+    761, 1257, 65535, 3080, 1117, 1751, 65535, 676, 65535, 3041, 1634, 3941, 65535, 65535, 1077, 3310,
+    65535, 319, 65535, 65535, 2797, 3608, 1940, 2884, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 3047,
+    65535, 65535, 994, 3275, 2593, 4229, 65535, 65535, 65535, 65535, 1900, 3616, 843, 1724, 65535, 65535,
+    3581, 1841, 65535, 65535, 65535, 833, 3774, 3219, 65535, 3670, 1383, 2760, 3566, 2083, 639, 65535,
+    4147, 1818, 65535, 65535, 65535, 1733, 65535, 3933, 2561, 483, 231, 65535, 65535, 2262, 1589, 1823,
+    65535, 2950, 65535, 2624, 65535, 2518, 1186, 3462, 65535, 1793, 65535, 65535, 65535, 1970, 65535, 1864,
+    1410, 2815, 65535, 1524, 1395, 583, 4084, 16, 2515, 226, 65535, 662, 1286, 3428, 65535, 2100,
+    65535, 1253, 65535, 1100, 65535, 65535, 65535, 4127, 65535, 968, 65535, 3786, 383, 65535, 4255, 1965,
+    1323, 2817, 65535, 65535, 978, 959, 65535, 65535, 3714, 2256, 827, 65535, 65535, 2455, 65535, 3867,
+    65535, 1276, 65535, 458, 2550, 3811, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 1772, 4202, 641, 65535, 4265, 65535, 65535, 3304, 65535, 65535, 65535, 65535, 65535, 4193, 1754,
+    65535, 3305, 3119, 65535, 65535, 1734, 1671, 65535, 4168, 1523, 65535, 65535, 65535, 65535, 65535, 3387,
+    65535, 845, 65535, 671, 65535, 65535, 787, 65535, 1024, 3769, 1032, 1925, 65535, 65535, 65535, 3248,
+    65535, 65535, 65535, 65535, 65535, 1320, 1255, 65535, 1130, 65535, 2967, 65535, 65535, 65535, 246, 65535,
+    2460, 2805, 3231, 2759, 3385, 65535, 1541, 65535, 1715, 65535, 2222, 3782, 65535, 1390, 65535, 1150,
+    1872, 3418, 65535, 65535, 792, 65535, 65535, 2602, 636, 2568, 1741, 256, 3007, 1172, 65535, 65535,
+    65535, 2212, 120, 65535, 65535, 1976, 2059, 2612, 65535, 65535, 3169, 1952, 1494, 2787, 65535, 65535,
+    1335, 65535, 3330, 65535, 2816, 3057, 65535, 114, 3528, 65535, 3936, 65535, 903, 331, 65535, 65535,
+    65535, 3086, 65535, 2204, 65535, 65535, 65535, 65535, 65535, 3031, 1020, 65535, 65535, 65535, 2396, 1170,
+    65535, 3553, 1678, 65535, 1278, 1344, 335, 65535, 65535, 65535, 2180, 65535, 65535, 1903, 65535, 1440,
+    4237, 3751, 3840, 2476, 3718, 65535, 65535, 1374, 65535, 65535, 4124, 65535, 2866, 65535, 700, 3888,
+    1128, 65535, 3216, 65535, 65535, 2959, 1782, 3555, 65535, 1147, 376, 2004, 65535, 65535, 65535, 1801,
+    3461, 647, 65535, 65535, 65535, 65535, 65535, 65535, 1738, 65535, 65535, 65535, 1160, 1819, 65535, 1750,
+    2168, 65535, 3681, 65535, 65535, 65535, 2604, 224, 1453, 1378, 2008, 65535, 65535, 3869, 163, 946,
+    2311, 1038, 1964, 453, 488, 1187, 65535, 65535, 493, 65535, 1633, 3133, 65535, 65535, 65535, 65535,
+    876, 65535, 564, 65535, 65535, 2938, 65535, 65535, 65535, 65535, 65535, 65535, 1983, 65535, 2249, 2046,
+    424, 65535, 1047, 65535, 65535, 65535, 65535, 435, 3644, 65535, 990, 2517, 3622, 3959, 65535, 65535,
+    577, 65535, 65535, 65535, 2586, 2934, 65535, 4033, 3438, 621, 65535, 749, 3359, 4272, 65535, 65535,
+    1636, 65535, 65535, 2192, 65535, 65535, 65535, 65535, 65535, 65535, 1973, 3324, 2483, 3027, 1776, 4109,
+    65535, 65535, 65535, 65535, 4038, 65535, 304, 65535, 3510, 65535, 194, 65535, 65535, 1945, 65535, 53,
+    1812, 65535, 2302, 1543, 2466, 65535, 2489, 65535, 297, 320, 489, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 2241, 4238, 2121, 252, 65535, 65535, 65535, 3300, 3349, 65535, 215, 684, 998,
+    65535, 1041, 65535, 65535, 177, 65535, 2661, 65535, 65535, 65535, 65535, 65535, 2701, 65535, 65535, 314,
+    2727, 65535, 1992, 3573, 65535, 3064, 65535, 65535, 2406, 65535, 3665, 1907, 65535, 65535, 65535, 65535,
+    3447, 1060, 65535, 2835, 4028, 65535, 598, 468, 2667, 65535, 3318, 3713, 65535, 65535, 65535, 65535,
+    65535, 2244, 65535, 65535, 65535, 65535, 65535, 2771, 1252, 65535, 65535, 65535, 65535, 1742, 65535, 65535,
+    4226, 3865, 4274, 65535, 2854, 1692, 1065, 745, 3178, 3069, 2773, 189, 65535, 2696, 65535, 65535
+};
+
+static constexpr std::array<uint16_t, PDFStaticPerfectHash<glyphNameToUnicode.size()>::BUCKET_COUNT> glyphNamePerfectHashDisplacements = {
+    3, 10, 0, 2, 1, 0, 5, 5, 5, 1, 0, 7, 0, 1, 4, 1,
+    4, 1, 0, 0, 3, 3, 1, 0, 1, 0, 3, 3, 0, 9, 1, 0,
+    1, 0, 2, 3, 1, 0, 2, 0, 1, 0, 1, 3, 0, 3, 2, 0,
+    14, 0, 0, 1, 4, 1, 1, 2, 0, 2, 0, 4, 1, 6, 3, 0,
+    1, 1, 0, 0, 2, 5, 4, 0, 1, 13, 6, 3, 1, 2, 0, 0,
+    2, 1, 3, 1, 4, 0, 3, 3, 0, 0, 0, 2, 0, 0, 9, 6,
+    1, 0, 0, 0, 1, 1, 1, 0, 3, 0, 1, 0, 0, 1, 0, 1,
+    0, 1, 0, 10, 0, 0, 0, 0, 3, 2, 2, 0, 12, 3, 1, 10,
+    0, 2, 4, 2, 1, 0, 1, 0, 10, 10, 0, 6, 3, 12, 0, 2,
+    0, 0, 0, 6, 3, 0, 0, 1, 0, 0, 1, 0, 1, 1, 0, 0,
+    3, 0, 12, 9, 3, 11, 5, 3, 1, 1, 0, 9, 2, 1, 0, 0,
+    5, 2, 1, 7, 0, 6, 1, 6, 3, 8, 4, 7, 2, 8, 0, 0,
+    4, 2, 10, 6, 0, 1, 3, 3, 3, 0, 2, 1, 2, 0, 1, 8,
+    17, 7, 4, 1, 1, 1, 2, 0, 0, 3, 2, 1, 0, 4, 1, 1,
+    4, 1, 3, 3, 1, 0, 0, 9, 5, 1, 3, 0, 4, 1, 1, 0,
+    0, 0, 0, 1, 6, 1, 2, 4, 1, 1, 6, 0, 0, 2, 1, 0,
+    3, 0, 0, 5, 24, 2, 15, 0, 10, 0, 0, 11, 4, 1, 8, 9,
+    9, 0, 5, 0, 0, 0, 9, 4, 1, 1, 7, 1, 0, 0, 4, 3,
+    8, 0, 0, 4, 0, 2, 0, 0, 6, 0, 1, 8, 1, 6, 8, 2,
+    0, 1, 2, 1, 0, 3, 3, 0, 7, 0, 2, 12, 2, 1, 1, 0,
+    2, 0, 0, 3, 3, 3, 7, 0, 0, 2, 4, 13, 1, 12, 7, 10,
+    2, 1, 1, 0, 0, 4, 13, 13, 4, 4, 3, 4, 0, 2, 0, 0,
+    12, 1, 3, 0, 4, 2, 0, 0, 1, 1, 0, 0, 7, 3, 0, 0,
+    1, 0, 8, 11, 2, 2, 1, 0, 1, 3, 0, 0, 1, 0, 5, 3,
+    0, 0, 3, 3, 4, 6, 8, 0, 0, 2, 6, 1, 13, 5, 5, 0,
+    0, 4, 4, 0, 7, 0, 1, 1, 4, 2, 1, 0, 7, 7, 3, 0,
+    1, 2, 9, 23, 2, 0, 7, 3, 0, 1, 0, 1, 0, 0, 6, 1,
+    1, 6, 2, 0, 2, 0, 11, 7, 11, 6, 2, 5, 1, 2, 6, 5,
+    4, 1, 1, 0, 3, 1, 0, 4, 0, 5, 0, 0, 0, 0, 1, 0,
+    1, 3, 0, 1, 1, 0, 2, 1, 1, 0, 0, 1, 15, 0, 3, 3,
+    0, 0, 1, 4, 0, 2, 1, 2, 1, 2, 0, 0, 2, 11, 0, 12,
+    0, 4, 0, 2, 2, 3, 0, 0, 4, 0, 1, 0, 16, 20, 0, 4,
+    0, 1, 1, 3, 1, 2, 4, 5, 0, 0, 11, 0, 3, 1, 4, 2,
+    3, 22, 4, 2, 0, 1, 8, 13, 2, 0, 1, 1, 7, 0, 1, 4,
+    1, 1, 0, 6, 0, 0, 1, 0, 3, 3, 4, 3, 1, 6, 0, 11,
+    1, 5, 0, 0, 2, 1, 3, 0, 23, 3, 1, 0, 2, 0, 5, 0,
+    7, 8, 6, 0, 7, 2, 17, 3, 0, 0, 6, 2, 2, 0, 5, 0,
+    8, 2, 6, 1, 2, 1, 1, 0, 0, 2, 0, 1, 0, 0, 0, 1,
+    0, 2, 6, 0, 1, 8, 7, 0, 4, 7, 2, 1, 4, 0, 0, 0,
+    2, 0, 10, 2, 0, 0, 0, 0, 6, 1, 1, 7, 0, 1, 0, 2,
+    1, 1, 0, 7, 9, 1, 1, 0, 1, 0, 4, 4, 0, 9, 2, 0,
+    2, 6, 11, 2, 13, 1, 6, 0, 3, 0, 1, 1, 0, 4, 1, 0,
+    0, 7, 1, 5, 4, 5, 1, 2, 0, 5, 6, 2, 0, 1, 0, 1,
+    3, 0, 1, 2, 0, 4, 0, 0, 0, 0, 2, 8, 1, 7, 7, 2,
+    3, 1, 1, 2, 0, 1, 6, 3, 0, 6, 3, 3, 3, 3, 2, 1,
+    6, 3, 5, 2, 0, 0, 2, 0, 0, 1, 11, 0, 1, 0, 1, 2,
+    2, 2, 11, 0, 2, 1, 0, 1, 0, 6, 2, 13, 2, 0, 1, 0,
+    0, 8, 21, 1, 0, 2, 5, 0, 3, 1, 5, 1, 0, 1, 1, 0,
+    0, 1, 0, 2, 0, 7, 0, 0, 0, 10, 6, 0, 11, 2, 4, 1,
+    0, 0, 8, 0, 2, 2, 13, 22, 6, 2, 23, 12, 1, 14, 10, 2,
+    5, 2, 1, 3, 11, 3, 3, 3, 0, 3, 1, 6, 0, 5, 3, 0,
+    5, 1, 0, 0, 1, 5, 1, 6, 0, 12, 5, 4, 4, 5, 0, 2,
+    6, 0, 1, 7, 0, 0, 0, 6, 1, 2, 3, 8, 5, 8, 1, 0,
+    2, 0, 9, 11, 10, 1, 4, 4, 4, 0, 5, 1, 0, 0, 0, 0,
+    0, 3, 0, 0, 3, 10, 2, 3, 0, 5, 13, 1, 0, 2, 2, 0,
+    8, 0, 0, 1, 12, 4, 10, 6, 3, 4, 15, 0, 1, 0, 4, 0,
+    3, 2, 0, 10, 2, 4, 7, 6, 1, 0, 10, 3, 0, 6, 0, 3,
+    0, 1, 5, 1, 6, 11, 6, 0, 5, 1, 11, 0, 1, 1, 1, 0,
+    4, 0, 3, 6, 7, 3, 6, 0, 1, 6, 2, 1, 11, 18, 3, 0,
+    1, 1, 2, 0, 0, 0, 10, 4, 5, 3, 0, 2, 7, 6, 0, 1,
+    3, 4, 9, 4, 8, 1, 1, 0, 8, 1, 2, 3, 1, 6, 7, 5,
+    1, 0, 6, 0, 6, 2, 1, 4, 8, 0, 0, 1, 0, 2, 0, 2,
+    0, 0, 0, 0, 2, 6, 0, 1, 11, 1, 1, 13, 7, 15, 11, 1,
+    9, 0, 3, 0, 6, 9, 11, 3, 0, 1, 2, 0, 0, 0, 11, 3,
+    3, 0, 8, 0, 0, 8, 5, 7, 5, 3, 3, 3, 4, 6, 5, 2,
+    1, 1, 1, 1, 0, 3, 0, 0, 16, 1, 0, 11, 4, 3, 0, 13,
+    16, 0, 2, 4, 0, 2, 3, 4, 0, 0, 5, 9, 11, 4, 0, 2
+};
+
+static constexpr PDFStaticPerfectHash<glyphNameToUnicode.size()> glyphNamePerfectHash(glyphNamePerfectHashSlots, glyphNamePerfectHashDisplacements);
+
+// ZapfDingbats glyph name table is small, so its perfect hash is constructed at compile time
+static constexpr std::array<uint64_t, glyphNameZapfDingbatsToUnicode.size()> glyphNameZapfDingbatsHashes = getGlyphNameHashes(glyphNameZapfDingbatsToUnicode);
+static constexpr PDFStaticPerfectHash<glyphNameZapfDingbatsToUnicode.size()> glyphNameZapfDingbatsPerfectHash(glyphNameZapfDingbatsHashes);
+
+QChar PDFNameToUnicode::getUnicodeForName(const QByteArray& name)
+{
+    return findGlyphName(glyphNameToUnicode, glyphNamePerfectHash, name);
 }
 
 QChar PDFNameToUnicode::getUnicodeForNameZapfDingbats(const QByteArray& name)
 {
-    Q_ASSERT(std::is_sorted(glyphNameZapfDingbatsToUnicode.cbegin(), glyphNameZapfDingbatsToUnicode.cend(), Comparator()));
+    return findGlyphName(glyphNameZapfDingbatsToUnicode, glyphNameZapfDingbatsPerfectHash, name);
+}
 
-    auto [it, itEnd] = std::equal_range(glyphNameZapfDingbatsToUnicode.cbegin(), glyphNameZapfDingbatsToUnicode.cend(), name, Comparator());
-    if (it != itEnd)
-    {
-        return it->first;
-    }
-    else
+template<size_t Count>
+static QByteArrayList getGlyphNames(const GlyphNameTable<Count>& table)
+{
+    QByteArrayList names;
+    names.reserve(qsizetype(Count));
+    for (const auto& item : table)
     {
-        return QChar();
+        names << QByteArray(item.second);
     }
+    return names;
+}
+
+QByteArrayList PDFNameToUnicode::getNames()
+{
+    return getGlyphNames(glyphNameToUnicode);
+}
+
+QByteArrayList PDFNameToUnicode::getNamesZapfDingbats()
+{
+    return getGlyphNames(glyphNameZapfDingbatsToUnicode);
 }
 
 QChar PDFNameToUnicode::getUnicodeUsingResolvedName(const QByteArray& name)
@@ -23,6 +23,7 @@
 
 #include <QChar>
 #include <QByteArray>
+#include <QByteArrayList>
 
 namespace pdf
 {
@@ -41,22 +42,11 @@ public:
     /// Tries to resolve unicode name
     static QChar getUnicodeUsingResolvedName(const QByteArray& name);
 
-private:
-    struct Comparator
-    {
-        inline bool operator()(const QByteArray& left, const std::pair<QChar, const char*>& right)
-        {
-            return left < right.second;
-        }
-        inline bool operator()(const std::pair<QChar, const char*>& left, const QByteArray& right)
-        {
-            return left.second < right;
-        }
-        inline bool operator()(const std::pair<QChar, const char*>& left, const std::pair<QChar, const char*>& right)
-        {
-            return QLatin1String(left.second) < QLatin1String(right.second);
-        }
-    };
+    /// Returns all glyph names, for which unicode character can be found
+    static QByteArrayList getNames();
+
+    /// Returns all glyph names (for ZapfDingbats), for which unicode character can be found
+    static QByteArrayList getNamesZapfDingbats();
 };
 
 }   // namespace pdf
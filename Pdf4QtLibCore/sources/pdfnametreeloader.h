@@ -19,14 +19,17 @@
 #define PDFNAMETREELOADER_H
 
 #include "pdfdocument.h"
+#include "pdfobjectutils.h"
 
 #include <map>
+#include <optional>
 #include <functional>
 
 namespace pdf
 {
 
-/// This class can load a number tree into the array
+/// This class can load a name tree into the map, or find
+/// a single item in the name tree without loading it whole.
 template<typename Type>
 class PDFNameTreeLoader
 {
@@ -35,6 +38,7 @@ public:
 
     using MappedObjects = std::map<QByteArray, Type>;
     using LoadMethod = std::function<Type(const PDFObjectStorage*, const PDFObject&)>;
+    using EnumerateCallback = std::function<void(const QByteArray&, const PDFObject&)>;
 
     /// Parses the name tree and loads its items into the map. Some errors are ignored,
     /// e.g. when kid is null. Objects are retrieved by \p loadMethod.
@@ -44,16 +48,55 @@ public:
     static MappedObjects parse(const PDFObjectStorage* storage, const PDFObject& root, const LoadMethod& loadMethod)
     {
         MappedObjects result;
-        parseImpl(result, storage, root, loadMethod);
+        enumerate(storage, root, [&](const QByteArray& name, const PDFObject& object) { result[name] = loadMethod(storage, object); });
         return result;
     }
 
+    /// Enumerates items of the name tree in the order, in which they are stored
+    /// in the tree. Items are not stored, so the memory usage doesn't depend
+    /// on the size of the tree. Some errors are ignored, e.g. when kid is null.
+    /// \param storage Object storage
+    /// \param root Root of the name tree
+    /// \param callback Callback called for each item (name and unparsed value)
+    static void enumerate(const PDFObjectStorage* storage, const PDFObject& root, const EnumerateCallback& callback)
+    {
+        PDFMarkedObjectsContext context;
+        enumerateImpl(storage, root, callback, &context);
+    }
+
+    /// Finds item with given name in the name tree. Kids of the nodes are searched
+    /// by binary search using their limits, names in the leaf nodes are also
+    /// searched by binary search, so only nodes on the path to the item are visited.
+    /// If tree is not sorted properly, the linear search is used as a fallback.
+    /// If item is not found, then std::nullopt is returned.
+    /// \param storage Object storage
+    /// \param root Root of the name tree
+    /// \param name Name of the item
+    /// \param loadMethod Parsing method, which retrieves parsed object
+    static std::optional<Type> find(const PDFObjectStorage* storage, const PDFObject& root, const QByteArray& name, const LoadMethod& loadMethod)
+    {
+        PDFMarkedObjectsContext context;
+        if (std::optional<PDFObject> object = findImpl(storage, root, name, &context))
+        {
+            return loadMethod(storage, *object);
+        }
+
+        return std::nullopt;
+    }
+
 private:
-    static void parseImpl(MappedObjects& objects, const PDFObjectStorage* storage, const PDFObject& root, const LoadMethod& loadMethod)
+    static void enumerateImpl(const PDFObjectStorage* storage, const PDFObject& root, const EnumerateCallback& callback, PDFMarkedObjectsContext* context)
     {
+        PDFMarkedObjectsLock lock(context, root);
+        if (!lock)
+        {
+            // Cycle in the name tree
+            return;
+        }
+
         if (const PDFDictionary* dictionary = storage->getDictionaryFromObject(root))
         {
-            // Jakub Melka: First, load the objects into the map
+            // First, enumerate the objects
             const PDFObject& namedItems = storage->getObject(dictionary->get("Names"));
             if (namedItems.isArray())
             {
@@ -61,31 +104,176 @@ private:
                 const size_t count = namedItemsArray->getCount() / 2;
                 for (size_t i = 0; i < count; ++i)
                 {
-                    const size_t numberIndex = 2 * i;
+                    const size_t nameIndex = 2 * i;
                     const size_t valueIndex = 2 * i + 1;
 
-                    const PDFObject& name = storage->getObject(namedItemsArray->getItem(numberIndex));
+                    const PDFObject& name = storage->getObject(namedItemsArray->getItem(nameIndex));
                     if (!name.isString())
                     {
                         continue;
                     }
 
-                    objects[name.getString()] = loadMethod(storage, namedItemsArray->getItem(valueIndex));
+                    callback(name.getString(), namedItemsArray->getItem(valueIndex));
                 }
             }
 
             // Then, follow the kids
-            const PDFObject&  kids = storage->getObject(dictionary->get("Kids"));
+            const PDFObject& kids = storage->getObject(dictionary->get("Kids"));
             if (kids.isArray())
             {
                 const PDFArray* kidsArray = kids.getArray();
                 const size_t count = kidsArray->getCount();
                 for (size_t i = 0; i < count; ++i)
                 {
-                    parseImpl(objects, storage, kidsArray->getItem(i), loadMethod);
+                    enumerateImpl(storage, kidsArray->getItem(i), callback, context);
+                }
+            }
+        }
+    }
+
+    /// Returns limits of the name tree node, or std::nullopt, if node doesn't have valid limits
+    static std::optional<std::pair<QByteArray, QByteArray>> getLimits(const PDFObjectStorage* storage, const PDFObject& node)
+    {
+        if (const PDFDictionary* dictionary = storage->getDictionaryFromObject(node))
+        {
+            const PDFObject& limits = storage->getObject(dictionary->get("Limits"));
+            if (limits.isArray() && limits.getArray()->getCount() == 2)
+            {
+                const PDFObject& lowerLimit = storage->getObject(limits.getArray()->getItem(0));
+                const PDFObject& upperLimit = storage->getObject(limits.getArray()->getItem(1));
+                if (lowerLimit.isString() && upperLimit.isString())
+                {
+                    return std::make_pair(lowerLimit.getString(), upperLimit.getString());
+                }
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    static std::optional<PDFObject> findImpl(const PDFObjectStorage* storage, const PDFObject& root, const QByteArray& name, PDFMarkedObjectsContext* context)
+    {
+        PDFMarkedObjectsLock lock(context, root);
+        if (!lock)
+        {
+            // Cycle in the name tree
+            return std::nullopt;
+        }
+
+        const PDFDictionary* dictionary = storage->getDictionaryFromObject(root);
+        if (!dictionary)
+        {
+            return std::nullopt;
+        }
+
+        const PDFObject& namedItems = storage->getObject(dictionary->get("Names"));
+        if (namedItems.isArray())
+        {
+            const PDFArray* namedItemsArray = namedItems.getArray();
+            const size_t count = namedItemsArray->getCount() / 2;
+
+            auto getName = [storage, namedItemsArray](size_t index) -> const PDFObject& { return storage->getObject(namedItemsArray->getItem(2 * index)); };
+
+            // Names are sorted in lexical order, try binary search first
+            size_t low = 0;
+            size_t high = count;
+            while (low < high)
+            {
+                const size_t middle = low + (high - low) / 2;
+                const PDFObject& middleName = getName(middle);
+                if (!middleName.isString())
+                {
+                    break;
+                }
+
+                const QByteArray& middleNameString = middleName.getString();
+                if (middleNameString == name)
+                {
+                    return namedItemsArray->getItem(2 * middle + 1);
+                }
+
+                if (middleNameString < name)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+
+            // Fallback - names may not be sorted
+            for (size_t i = 0; i < count; ++i)
+            {
+                const PDFObject& currentName = getName(i);
+                if (currentName.isString() && currentName.getString() == name)
+                {
+                    return namedItemsArray->getItem(2 * i + 1);
                 }
             }
         }
+
+        const PDFObject& kids = storage->getObject(dictionary->get("Kids"));
+        if (kids.isArray())
+        {
+            const PDFArray* kidsArray = kids.getArray();
+            const size_t count = kidsArray->getCount();
+
+            // Kids are sorted by their limits, try binary search first
+            size_t visitedKid = count;
+            size_t low = 0;
+            size_t high = count;
+            while (low < high)
+            {
+                const size_t middle = low + (high - low) / 2;
+                std::optional<std::pair<QByteArray, QByteArray>> limits = getLimits(storage, kidsArray->getItem(middle));
+                if (!limits)
+                {
+                    break;
+                }
+
+                if (name < limits->first)
+                {
+                    high = middle;
+                }
+                else if (limits->second < name)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    visitedKid = middle;
+                    if (std::optional<PDFObject> result = findImpl(storage, kidsArray->getItem(middle), name, context))
+                    {
+                        return result;
+                    }
+                    break;
+                }
+            }
+
+            // Fallback - kids may not be sorted, or they may not have limits
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i == visitedKid)
+                {
+                    continue;
+                }
+
+                const PDFObject& kid = kidsArray->getItem(i);
+                std::optional<std::pair<QByteArray, QByteArray>> limits = getLimits(storage, kid);
+                if (limits && (name < limits->first || limits->second < name))
+                {
+                    continue;
+                }
+
+                if (std::optional<PDFObject> result = findImpl(storage, kid, name, context))
+                {
+                    return result;
+                }
+            }
+        }
+
+        return std::nullopt;
     }
 };
 
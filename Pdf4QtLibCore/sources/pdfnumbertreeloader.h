@@ -20,8 +20,10 @@
 #define PDFNUMBERTREELOADER_H
 
 #include "pdfdocument.h"
+#include "pdfobjectutils.h"
 
 #include <vector>
+#include <optional>
 
 namespace pdf
 {
@@ -50,7 +52,73 @@ public:
         return result;
     }
 
+    /// Finds item with given number in the number tree. Only nodes, whose
+    /// limits contain the number, are visited, so the tree is not loaded
+    /// at whole. If item is not found, then std::nullopt is returned.
+    /// \param storage Storage
+    /// \param root Root of the number tree
+    /// \param number Number of the item
+    static std::optional<Type> find(const PDFObjectStorage* storage, const PDFObject& root, PDFInteger number)
+    {
+        PDFMarkedObjectsContext context;
+        return findImpl(storage, root, number, &context);
+    }
+
 private:
+    static std::optional<Type> findImpl(const PDFObjectStorage* storage, const PDFObject& root, PDFInteger number, PDFMarkedObjectsContext* context)
+    {
+        PDFMarkedObjectsLock lock(context, root);
+        if (!lock)
+        {
+            // Cycle in the number tree
+            return std::nullopt;
+        }
+
+        if (const PDFDictionary* dictionary = storage->getDictionaryFromObject(root))
+        {
+            // Check the limits of the node, if they are present
+            const PDFObject& limits = storage->getObject(dictionary->get("Limits"));
+            if (limits.isArray() && limits.getArray()->getCount() == 2)
+            {
+                const PDFObject& lowerLimit = storage->getObject(limits.getArray()->getItem(0));
+                const PDFObject& upperLimit = storage->getObject(limits.getArray()->getItem(1));
+                if (lowerLimit.isInt() && upperLimit.isInt() && (number < lowerLimit.getInteger() || number > upperLimit.getInteger()))
+                {
+                    return std::nullopt;
+                }
+            }
+
+            const PDFObject& numberedItems = storage->getObject(dictionary->get("Nums"));
+            if (numberedItems.isArray())
+            {
+                const PDFArray* numberedItemsArray = numberedItems.getArray();
+                const size_t count = numberedItemsArray->getCount() / 2;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const PDFObject& currentNumber = storage->getObject(numberedItemsArray->getItem(2 * i));
+                    if (currentNumber.isInt() && currentNumber.getInteger() == number)
+                    {
+                        return Type::parse(number, storage, numberedItemsArray->getItem(2 * i + 1));
+                    }
+                }
+            }
+
+            const PDFObject& kids = storage->getObject(dictionary->get("Kids"));
+            if (kids.isArray())
+            {
+                for (const PDFObject& kid : *kids.getArray())
+                {
+                    if (std::optional<Type> result = findImpl(storage, kid, number, context))
+                    {
+                        return result;
+                    }
+                }
+            }
+        }
+
+        return std::nullopt;
+    }
+
     static void parseImpl(Objects& objects, const PDFObjectStorage* storage, const PDFObject& root)
     {
         if (const PDFDictionary* dictionary = storage->getDictionaryFromObject(root))
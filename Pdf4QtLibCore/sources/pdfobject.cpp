@@ -17,6 +17,11 @@
 
 #include "pdfobject.h"
 #include "pdfvisitor.h"
+#include "pdfobjectarena.h"
+
+#include <utility>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -161,11 +166,11 @@ void PDFObject::accept(PDFAbstractVisitor* visitor) const
     }
 }
 
-PDFObject PDFObject::createName(QByteArray name)
+PDFObject PDFObject::createName(QByteArray name, PDFObjectArena* arena)
 {
     if (name.size() > PDFInplaceString::MAX_STRING_SIZE)
     {
-        return PDFObject(Type::Name, std::make_shared<PDFString>(qMove(name)));
+        return PDFObject(Type::Name, PDFObjectArena::create<PDFString>(arena, qMove(name)));
     }
     else
     {
@@ -173,11 +178,11 @@ PDFObject PDFObject::createName(QByteArray name)
     }
 }
 
-PDFObject PDFObject::createString(QByteArray name)
+PDFObject PDFObject::createString(QByteArray name, PDFObjectArena* arena)
 {
     if (name.size() > PDFInplaceString::MAX_STRING_SIZE)
     {
-        return PDFObject(Type::String, std::make_shared<PDFString>(qMove(name)));
+        return PDFObject(Type::String, PDFObjectArena::create<PDFString>(arena, qMove(name)));
     }
     else
     {
@@ -283,6 +288,20 @@ const PDFObject& PDFDictionary::get(const char* key) const
     }
 }
 
+const PDFObject& PDFDictionary::get(PDFNameAtom key) const
+{
+    auto it = find(key);
+    if (it != m_dictionary.cend())
+    {
+        return it->second;
+    }
+    else
+    {
+        static PDFObject dummy;
+        return dummy;
+    }
+}
+
 const PDFObject& PDFDictionary::get(const PDFInplaceOrMemoryString& key) const
 {
     auto it = find(key);
@@ -303,6 +322,7 @@ void PDFDictionary::removeEntry(const char* key)
     if (it != m_dictionary.end())
     {
         m_dictionary.erase(it);
+        m_hashIndex.clear();
     }
 }
 
@@ -323,41 +343,111 @@ void PDFDictionary::removeNullObjects()
 {
     m_dictionary.erase(std::remove_if(m_dictionary.begin(), m_dictionary.end(), [](const DictionaryEntry& entry) { return entry.second.isNull(); }), m_dictionary.end());
     m_dictionary.shrink_to_fit();
+    buildHashIndex();
 }
 
 void PDFDictionary::optimize()
 {
     m_dictionary.shrink_to_fit();
+    buildHashIndex();
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(const QByteArray& key) const
 {
+    if (!m_hashIndex.empty())
+    {
+        return findUsingHashIndex(QByteArrayView(key));
+    }
+
     return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const QByteArray& key)
 {
-    return std::find_if(m_dictionary.begin(), m_dictionary.end(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
+    return toIterator(std::as_const(*this).find(key));
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(const char* key) const
 {
+    if (!m_hashIndex.empty())
+    {
+        return findUsingHashIndex(QByteArrayView(key));
+    }
+
     return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(const PDFInplaceOrMemoryString& key) const
 {
+    if (!m_hashIndex.empty())
+    {
+        return findUsingHashIndex(key.getView());
+    }
+
     return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const PDFInplaceOrMemoryString& key)
 {
-    return std::find_if(m_dictionary.begin(), m_dictionary.end(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
+    return toIterator(std::as_const(*this).find(key));
+}
+
+std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(PDFNameAtom key) const
+{
+    if (key == PDFNames::Invalid)
+    {
+        return m_dictionary.cend();
+    }
+
+    if (!m_hashIndex.empty())
+    {
+        return findUsingHashIndex(PDFNameTable::getInstance()->getName(key));
+    }
+
+    // Name with valid atom is always interned, so all keys equal
+    // to the name have the same atom.
+    return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [key](const DictionaryEntry& entry) { return entry.first.getAtom() == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const char* key)
 {
-    return std::find_if(m_dictionary.begin(), m_dictionary.end(), [key](const DictionaryEntry& entry) { return entry.first == key; });
+    return toIterator(std::as_const(*this).find(key));
+}
+
+void PDFDictionary::buildHashIndex()
+{
+    m_hashIndex.clear();
+
+    if (m_dictionary.size() < HASH_INDEX_MIN_ENTRIES)
+    {
+        return;
+    }
+
+    m_hashIndex.reserve(m_dictionary.size());
+    for (size_t i = 0; i < m_dictionary.size(); ++i)
+    {
+        m_hashIndex.emplace_back(qHash(m_dictionary[i].first.getView()), i);
+    }
+
+    std::sort(m_hashIndex.begin(), m_hashIndex.end());
+}
+
+std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::findUsingHashIndex(QByteArrayView key) const
+{
+    Q_ASSERT(!m_hashIndex.empty());
+
+    // Entries with the same hash are sorted by index, so if dictionary
+    // contains duplicate keys, first one is found, as in linear search.
+    const size_t hash = qHash(key);
+    for (auto it = std::lower_bound(m_hashIndex.cbegin(), m_hashIndex.cend(), HashIndexEntry(hash, 0)); it != m_hashIndex.cend() && it->first == hash; ++it)
+    {
+        if (m_dictionary[it->second].first.getView() == key)
+        {
+            return std::next(m_dictionary.cbegin(), it->second);
+        }
+    }
+
+    return m_dictionary.cend();
 }
 
 bool PDFStream::equals(const PDFObjectContent* other) const
@@ -397,7 +487,8 @@ PDFObject PDFObjectManipulator::merge(PDFObject left, PDFObject right, MergeFlag
             targetDictionary.removeNullObjects();
         }
 
-        return PDFObject::createStream(std::make_shared<PDFStream>(qMove(targetDictionary), QByteArray(rightStream ? *rightStream->getContent() : *leftStream->getContent())));
+        const PDFStream* contentStream = rightStream ? rightStream : leftStream;
+        return PDFObject::createStream(std::make_shared<PDFStream>(qMove(targetDictionary), QByteArray(*contentStream->getContent()), contentStream->getContentOwner()));
     }
     if (left.isDictionary())
     {
@@ -461,7 +552,7 @@ PDFObject PDFObjectManipulator::removeDuplicitReferencesInArrays(PDFObject objec
                 dictionary.setEntry(dictionary.getKey(i), removeDuplicitReferencesInArrays(dictionary.getValue(i)));
             }
 
-            return PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), QByteArray(*stream->getContent())));
+            return PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), QByteArray(*stream->getContent()), stream->getContentOwner()));
         }
 
         case PDFObject::Type::Dictionary:
@@ -519,6 +610,19 @@ QByteArray PDFStringRef::getString() const
     return QByteArray();
 }
 
+QByteArrayView PDFStringRef::getView() const
+{
+    if (inplaceString)
+    {
+        return QByteArrayView(inplaceString->string.data(), inplaceString->size);
+    }
+    if (memoryString)
+    {
+        return QByteArrayView(memoryString->getString());
+    }
+    return QByteArrayView();
+}
+
 PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(const char* string)
 {
     const int size = static_cast<int>(qMin(std::strlen(string), size_t(std::numeric_limits<int>::max())));
@@ -530,6 +634,8 @@ PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(const char* string)
     {
         m_value = PDFInplaceString(string, size);
     }
+
+    m_atom = PDFNameTable::getInstance()->intern(getView());
 }
 
 PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(QByteArray string)
@@ -543,6 +649,8 @@ PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(QByteArray string)
     {
         m_value = PDFInplaceString(qMove(string));
     }
+
+    m_atom = PDFNameTable::getInstance()->intern(getView());
 }
 
 bool PDFInplaceOrMemoryString::equals(const char* value, size_t length) const
@@ -562,6 +670,32 @@ bool PDFInplaceOrMemoryString::equals(const char* value, size_t length) const
     return length == 0;
 }
 
+bool PDFInplaceOrMemoryString::operator==(const PDFInplaceOrMemoryString& other) const
+{
+    if (m_atom != PDFNames::Invalid && other.m_atom != PDFNames::Invalid)
+    {
+        return m_atom == other.m_atom;
+    }
+
+    return getView() == other.getView();
+}
+
+QByteArrayView PDFInplaceOrMemoryString::getView() const
+{
+    if (std::holds_alternative<PDFInplaceString>(m_value))
+    {
+        const PDFInplaceString& string = std::get<PDFInplaceString>(m_value);
+        return QByteArrayView(string.string.data(), string.size);
+    }
+
+    if (std::holds_alternative<QByteArray>(m_value))
+    {
+        return QByteArrayView(std::get<QByteArray>(m_value));
+    }
+
+    return QByteArrayView();
+}
+
 bool PDFInplaceOrMemoryString::isInplace() const
 {
     return std::holds_alternative<PDFInplaceString>(m_value);
@@ -20,8 +20,10 @@
 #define PDFOBJECT_H
 
 #include "pdfglobal.h"
+#include "pdfnametable.h"
 
 #include <QByteArray>
+#include <QByteArrayView>
 
 #include <memory>
 #include <vector>
@@ -37,6 +39,7 @@ class PDFString;
 class PDFStream;
 class PDFDictionary;
 class PDFAbstractVisitor;
+class PDFObjectArena;
 
 /// This class represents a content of the PDF object. It can be
 /// array of objects, dictionary, content stream data, or string data.
@@ -118,10 +121,15 @@ struct PDF4QTLIBCORESHARED_EXPORT PDFStringRef
     const PDFString* memoryString = nullptr;
 
     QByteArray getString() const;
+
+    /// Returns view of the string data (no memory is allocated)
+    QByteArrayView getView() const;
 };
 
 /// This class represents string, which can be inplace string (no memory allocation),
-/// or classic byte array string, if not enough space for embedded string.
+/// or classic byte array string, if not enough space for embedded string. String
+/// is interned in the global name table, if it is possible, so two strings
+/// having valid atoms can be compared by comparing their atoms.
 class PDF4QTLIBCORESHARED_EXPORT PDFInplaceOrMemoryString
 {
 public:
@@ -142,8 +150,8 @@ public:
 
     bool equals(const char* value, size_t length) const;
 
-    inline bool operator==(const PDFInplaceOrMemoryString&) const = default;
-    inline bool operator!=(const PDFInplaceOrMemoryString&) const = default;
+    bool operator==(const PDFInplaceOrMemoryString& other) const;
+    inline bool operator!=(const PDFInplaceOrMemoryString& other) const { return !(*this == other); }
 
     inline bool operator==(const QByteArray& value) const { return equals(value.constData(), value.size()); }
     inline bool operator==(const char* value) const { return equals(value, std::strlen(value)); }
@@ -154,8 +162,16 @@ public:
     /// Returns string. If string is inplace, byte array is constructed.
     QByteArray getString() const;
 
+    /// Returns view of the string data (no memory is allocated)
+    QByteArrayView getView() const;
+
+    /// Returns atom of the interned string, or invalid atom,
+    /// if string is not interned.
+    PDFNameAtom getAtom() const { return m_atom; }
+
 private:
     std::variant<typename std::monostate, PDFInplaceString, QByteArray> m_value;
+    PDFNameAtom m_atom = PDFNames::Invalid;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFObject
@@ -258,11 +274,13 @@ public:
     /// Creates a stream object
     static inline PDFObject createStream(PDFObjectContentPointer&& value) { value->optimize(); return PDFObject(Type::Stream, std::move(value)); }
 
-    /// Creates a name object
-    static PDFObject createName(QByteArray name);
+    /// Creates a name object. If arena is specified, then name content
+    /// (if it doesn't fit into the object) is allocated from the arena.
+    static PDFObject createName(QByteArray name, PDFObjectArena* arena = nullptr);
 
-    /// Creates a string object
-    static PDFObject createString(QByteArray name);
+    /// Creates a string object. If arena is specified, then string content
+    /// (if it doesn't fit into the object) is allocated from the arena.
+    static PDFObject createString(QByteArray name, PDFObjectArena* arena = nullptr);
 
     /// Creates a name object
     static PDFObject createName(PDFStringRef name);
@@ -381,6 +399,12 @@ public:
     /// \param key Key
     const PDFObject& get(const PDFInplaceOrMemoryString& key) const;
 
+    /// Returns object for the key. If key is not found in the dictionary,
+    /// then valid reference to the null object is returned. Keys are compared
+    /// by atoms, so this function is faster than string key variants.
+    /// \param key Atom of the key (for example, well-known name from PDFNames)
+    const PDFObject& get(PDFNameAtom key) const;
+
     /// Returns true, if dictionary contains a particular key
     /// \param key Key to be found in the dictionary
     bool hasKey(const QByteArray& key) const { return find(key) != m_dictionary.cend(); }
@@ -389,6 +413,10 @@ public:
     /// \param key Key to be found in the dictionary
     bool hasKey(const char* key) const { return find(key) != m_dictionary.cend(); }
 
+    /// Returns true, if dictionary contains a particular key
+    /// \param key Atom of the key to be found in the dictionary
+    bool hasKey(PDFNameAtom key) const { return find(key) != m_dictionary.cend(); }
+
     /// Removes entry with given key. If entry with this key is not found,
     /// nothing happens.
     /// \param key Key to be removed
@@ -397,12 +425,12 @@ public:
     /// Adds a new entry to the dictionary.
     /// \param key Key
     /// \param value Value
-    void addEntry(PDFInplaceOrMemoryString&& key, PDFObject&& value) { m_dictionary.emplace_back(std::move(key), std::move(value)); }
+    void addEntry(PDFInplaceOrMemoryString&& key, PDFObject&& value) { m_hashIndex.clear(); m_dictionary.emplace_back(std::move(key), std::move(value)); }
 
     /// Adds a new entry to the dictionary.
     /// \param key Key
     /// \param value Value
-    void addEntry(const PDFInplaceOrMemoryString& key, PDFObject&& value) { m_dictionary.emplace_back(key, std::move(value)); }
+    void addEntry(const PDFInplaceOrMemoryString& key, PDFObject&& value) { m_hashIndex.clear(); m_dictionary.emplace_back(key, std::move(value)); }
 
     /// Sets entry value. If entry with given key doesn't exist,
     /// then it is created.
@@ -429,10 +457,24 @@ public:
 
     bool isEmpty() const { return getCount() == 0; }
 
-    /// Optimizes the dictionary for memory consumption
+    /// Optimizes the dictionary for memory consumption. For large
+    /// dictionaries, hash index of the keys is also built.
     virtual void optimize() override;
 
 private:
+    /// Minimal count of entries, for which hash index is built
+    static constexpr size_t HASH_INDEX_MIN_ENTRIES = 32;
+
+    /// Entry of the hash index - hash of the key and index of the entry
+    using HashIndexEntry = std::pair<size_t, size_t>;
+
+    /// Builds hash index of the keys, if dictionary is large enough
+    void buildHashIndex();
+
+    /// Finds an item in the dictionary using hash index. Hash index must exist.
+    /// \param key Key to be found
+    std::vector<DictionaryEntry>::const_iterator findUsingHashIndex(QByteArrayView key) const;
+
     /// Finds an item in the dictionary array, if the item is not in the dictionary,
     /// then end iterator is returned.
     /// \param key Key to be found
@@ -463,12 +505,26 @@ private:
     /// \param key Key to be found
     std::vector<DictionaryEntry>::iterator find(const PDFInplaceOrMemoryString& key);
 
+    /// Finds an item in the dictionary array, if the item is not in the dictionary,
+    /// then end iterator is returned.
+    /// \param key Atom of the key to be found
+    std::vector<DictionaryEntry>::const_iterator find(PDFNameAtom key) const;
+
+    /// Converts constant iterator to the mutable one
+    std::vector<DictionaryEntry>::iterator toIterator(std::vector<DictionaryEntry>::const_iterator it) { return std::next(m_dictionary.begin(), std::distance(m_dictionary.cbegin(), it)); }
+
     std::vector<DictionaryEntry> m_dictionary;
+
+    /// Hash index of the keys sorted by hash, it is built only for
+    /// large dictionaries (for example, resource dictionaries with
+    /// many fonts), it is empty otherwise.
+    std::vector<HashIndexEntry> m_hashIndex;
 };
 
 /// Represents a stream object in the PDF file. Stream consists of dictionary
-/// and stream content - byte array.
-class PDF4QTLIBCORESHARED_EXPORT PDFStream : public PDFObjectContent
+/// and stream content - byte array. Stream objects are usually owned by shared
+/// pointer, so weak pointer to the stream can be obtained (used by decoded stream cache).
+class PDF4QTLIBCORESHARED_EXPORT PDFStream : public PDFObjectContent, public std::enable_shared_from_this<PDFStream>
 {
 public:
     inline explicit PDFStream() = default;
@@ -479,6 +535,17 @@ public:
 
     }
 
+    /// Creates stream, whose content is not owned by the stream, but
+    /// it references external data (for example, memory mapped file).
+    /// Content owner keeps referenced data alive as long as the stream exists.
+    inline explicit PDFStream(PDFDictionary&& dictionary, QByteArray&& content, std::shared_ptr<const void> contentOwner) :
+        m_dictionary(std::move(dictionary)),
+        m_content(std::move(content)),
+        m_contentOwner(std::move(contentOwner))
+    {
+
+    }
+
     virtual ~PDFStream() override = default;
 
     virtual bool equals(const PDFObjectContent* other) const override;
@@ -492,9 +559,18 @@ public:
     /// Returns content of the stream
     const QByteArray* getContent() const { return &m_content; }
 
+    /// Returns owner of the referenced content, or nullptr,
+    /// if stream owns its content.
+    const std::shared_ptr<const void>& getContentOwner() const { return m_contentOwner; }
+
+    /// Returns true, if content of the stream is referenced
+    /// from external data (and is not owned by the stream).
+    bool isContentReferenced() const { return m_contentOwner != nullptr; }
+
 private:
     PDFDictionary m_dictionary;
     QByteArray m_content;
+    std::shared_ptr<const void> m_contentOwner;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFObjectManipulator
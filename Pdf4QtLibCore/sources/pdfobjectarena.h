@@ -0,0 +1,159 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFOBJECTARENA_H
+#define PDFOBJECTARENA_H
+
+#include "pdfglobal.h"
+
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+
+namespace pdf
+{
+class PDFObjectArena;
+
+using PDFObjectArenaPointer = std::shared_ptr<PDFObjectArena>;
+
+/// Thread safe memory pool for content of objects (arrays, dictionaries,
+/// streams and strings), which are created during document parsing. Objects
+/// are allocated in larger blocks, so a document with millions of small objects
+/// doesn't fragment the heap. Arena is owned by the object storage of the document
+/// (objects themselves hold only raw pointer to the arena). When storage releases
+/// the arena, whole pool is released at once, as soon as the last object allocated
+/// from the arena is destroyed (usually immediately, objects are destroyed together
+/// with the storage). Objects copied to another document thus remain valid.
+class PDFObjectArena
+{
+public:
+    PDFObjectArena(const PDFObjectArena&) = delete;
+    PDFObjectArena& operator=(const PDFObjectArena&) = delete;
+
+    /// Creates new arena. Arena is released, when all returned
+    /// pointers and all objects allocated from the arena are destroyed.
+    static PDFObjectArenaPointer createArena();
+
+    /// Allocates memory from the arena
+    /// \param bytes Size of memory block
+    /// \param alignment Alignment of memory block
+    void* allocate(size_t bytes, size_t alignment);
+
+    /// Returns memory block to the arena, so it can be reused by another object
+    /// \param pointer Memory block
+    /// \param bytes Size of memory block
+    /// \param alignment Alignment of memory block
+    void deallocate(void* pointer, size_t bytes, size_t alignment);
+
+    /// Creates object of given type. If arena is valid, then object is allocated
+    /// from the arena, otherwise it is allocated on the heap.
+    /// \param arena Arena (can be nullptr)
+    /// \param arguments Arguments of the constructor
+    template<typename T, typename... Arguments>
+    static std::shared_ptr<T> create(PDFObjectArena* arena, Arguments&&... arguments);
+
+private:
+    explicit PDFObjectArena() = default;
+
+    /// Releases one allocation (or ownership of the arena). Arena
+    /// is deleted together with the pool, when nothing is left.
+    void release();
+
+    /// Number of allocated memory blocks plus one for owners of the arena
+    std::atomic<size_t> m_referenceCount = 1;
+    std::pmr::synchronized_pool_resource m_resource;
+};
+
+/// Allocator, which allocates memory from the object arena. Allocator
+/// doesn't own the arena, arena is released after all allocated
+/// memory is returned to it.
+template<typename T>
+class PDFObjectArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PDFObjectArenaAllocator(PDFObjectArena* arena) :
+        m_arena(arena)
+    {
+
+    }
+
+    template<typename U>
+    PDFObjectArenaAllocator(const PDFObjectArenaAllocator<U>& other) :
+        m_arena(other.getArena())
+    {
+
+    }
+
+    T* allocate(size_t count) { return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T* pointer, size_t count) { m_arena->deallocate(pointer, count * sizeof(T), alignof(T)); }
+
+    PDFObjectArena* getArena() const { return m_arena; }
+
+    template<typename U>
+    bool operator==(const PDFObjectArenaAllocator<U>& other) const { return m_arena == other.getArena(); }
+
+private:
+    PDFObjectArena* m_arena;
+};
+
+// Implementation
+
+inline PDFObjectArenaPointer PDFObjectArena::createArena()
+{
+    return PDFObjectArenaPointer(new PDFObjectArena(), [](PDFObjectArena* arena) { arena->release(); });
+}
+
+inline void* PDFObjectArena::allocate(size_t bytes, size_t alignment)
+{
+    void* pointer = m_resource.allocate(bytes, alignment);
+
+    // Caller holds either the owner, or another allocation, so arena can't be deleted now
+    m_referenceCount.fetch_add(1, std::memory_order_relaxed);
+    return pointer;
+}
+
+inline void PDFObjectArena::deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+    m_resource.deallocate(pointer, bytes, alignment);
+    release();
+}
+
+inline void PDFObjectArena::release()
+{
+    if (m_referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        delete this;
+    }
+}
+
+template<typename T, typename... Arguments>
+std::shared_ptr<T> PDFObjectArena::create(PDFObjectArena* arena, Arguments&&... arguments)
+{
+    if (arena)
+    {
+        return std::allocate_shared<T>(PDFObjectArenaAllocator<T>(arena), std::forward<Arguments>(arguments)...);
+    }
+
+    return std::make_shared<T>(std::forward<Arguments>(arguments)...);
+}
+
+}   // namespace pdf
+
+#endif // PDFOBJECTARENA_H
@@ -156,7 +156,7 @@ void PDFReplaceReferencesVisitor::visitStream(const PDFStream* stream)
     visitDictionary(stream->getDictionary());
     PDFObject dictionaryObject = m_objectStack.back();
     m_objectStack.pop_back();
-    m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(PDFDictionary(*dictionaryObject.getDictionary()), QByteArray(*stream->getContent()))));
+    m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(PDFDictionary(*dictionaryObject.getDictionary()), QByteArray(*stream->getContent()), stream->getContentOwner())));
 }
 
 void PDFReplaceReferencesVisitor::visitReference(const PDFObjectReference reference)
@@ -284,12 +284,13 @@ void PDFObjectClassifier::classify(const PDFDocument* document)
 
     PDFDocumentDataLoaderDecorator loader(document);
     const PDFObjectStorage& storage = document->getStorage();
-    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
 
-    m_classification.resize(objects.size(), Classification());
-    for (size_t i = 0; i < objects.size(); ++i)
+    // Objects are not loaded here (if storage is lazy), we need just generation numbers
+    const size_t objectCount = storage.getObjectCount();
+    m_classification.resize(objectCount, Classification());
+    for (size_t i = 0; i < objectCount; ++i)
     {
-        PDFObjectReference reference(i, objects[i].generation);
+        PDFObjectReference reference(i, storage.getObjectMetadata(i).generation);
         m_classification[i].reference = reference;
     }
 
@@ -407,57 +408,128 @@ std::vector<PDFObjectReference> PDFObjectClassifier::getObjectsByType(Type type)
     return result;
 }
 
-PDFObjectClassifier::Statistics PDFObjectClassifier::calculateStatistics(const PDFDocument* document) const
+PDFObjectClassifier::Statistics PDFObjectClassifier::calculateStatistics(const PDFDocument* document, StatisticsMode mode) const
 {
     Statistics result;
+    prepareStatistics(result);
+    calculateStatistics(document, result, 0, m_classification.size(), mode);
+    return result;
+}
 
+void PDFObjectClassifier::prepareStatistics(Statistics& statistics) const
+{
     // Jakub Melka: prepare statistics map
-    result.statistics[None];
+    statistics.statistics[None];
 
     for (uint i = 0; i < 32; ++i)
     {
         uint32_t mask = 1 << i;
         if (m_allTypesUsed & mask)
         {
-            result.statistics[Type(mask)];
+            statistics.statistics[Type(mask)];
         }
     }
+}
+
+void PDFObjectClassifier::calculateStatistics(const PDFDocument* document, Statistics& statistics, size_t first, size_t last, StatisticsMode mode) const
+{
+    last = qMin(last, m_classification.size());
+    first = qMin(first, last);
 
-    auto processEntry = [document, &result](const Classification& entry)
+    const PDFObjectStorage& storage = document->getStorage();
+    const bool useMetadata = mode == StatisticsMode::Metadata && storage.isLazy();
+
+    // Each task has its own accumulator, so threads do not share any
+    // counters. Accumulators are merged at the end.
+    struct Accumulator
     {
-        const PDFObject& object = document->getObjectByReference(entry.reference);
+        std::map<Type, std::pair<qint64, qint64>> countAndBytes;
+        PDFStatisticsCollector collector;
+    };
 
-        if (object.isNull())
-        {
-            return;
-        }
+    const size_t taskCount = (last - first + STATISTICS_TASK_SIZE - 1) / STATISTICS_TASK_SIZE;
+    std::vector<Accumulator> accumulators(taskCount);
 
-        Type type = Type(uint32_t(entry.types));
-        if (!result.statistics.count(type))
+    auto processTask = [&](size_t taskIndex)
+    {
+        Accumulator& accumulator = accumulators[taskIndex];
+        const size_t taskFirst = first + taskIndex * STATISTICS_TASK_SIZE;
+        const size_t taskLast = qMin(taskFirst + STATISTICS_TASK_SIZE, last);
+
+        for (size_t i = taskFirst; i < taskLast; ++i)
         {
-            type = None;
-        }
+            const Classification& entry = m_classification[i];
+            qint64 objectSize = 0;
+
+            if (useMetadata)
+            {
+                const PDFObjectStorage::ObjectMetadata metadata = storage.getObjectMetadata(entry.reference.objectNumber);
+
+                if (!metadata.isOccupied)
+                {
+                    continue;
+                }
+
+                objectSize = qMax(metadata.size, PDFInteger(0));
+            }
+            else
+            {
+                const PDFObject& object = document->getObjectByReference(entry.reference);
+                object.accept(&accumulator.collector);
 
-        Q_ASSERT(result.statistics.count(type));
+                if (object.isNull())
+                {
+                    continue;
+                }
+
+                objectSize = PDFDocumentWriter::getObjectSize(document, entry.reference);
+            }
 
-        const qint64 objectSize = PDFDocumentWriter::getObjectSize(document, entry.reference);
+            Type type = Type(uint32_t(entry.types));
+            if (!statistics.statistics.count(type))
+            {
+                type = None;
+            }
 
-        StatisticsItem& statisticsItem = result.statistics.at(type);
-        statisticsItem.count.fetch_add(1);
-        statisticsItem.bytes.fetch_add(objectSize);
+            std::pair<qint64, qint64>& countAndBytes = accumulator.countAndBytes[type];
+            countAndBytes.first += 1;
+            countAndBytes.second += objectSize;
+        }
     };
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, m_classification.cbegin(), m_classification.cend(), processEntry);
+    PDFExecutionPolicy::executeTasks(PDFExecutionPolicy::Scope::Unknown, taskCount, processTask);
 
     PDFStatisticsCollector collector;
-    PDFApplyVisitor(*document, &collector);
+    for (const Accumulator& accumulator : accumulators)
+    {
+        for (const auto& item : accumulator.countAndBytes)
+        {
+            Q_ASSERT(statistics.statistics.count(item.first));
 
-    for (PDFObject::Type objectType : PDFObject::getTypes())
+            StatisticsItem& statisticsItem = statistics.statistics.at(item.first);
+            statisticsItem.count.fetch_add(item.second.first);
+            statisticsItem.bytes.fetch_add(item.second.second);
+        }
+
+        collector.merge(&accumulator.collector);
+    }
+
+    if (useMetadata)
     {
-        result.objectCountByType[size_t(objectType)] = collector.getObjectCount(objectType);
+        // Objects were not visited, statistics by object type are not available
+        return;
     }
 
-    return result;
+    // Trailer dictionary is processed together with last objects
+    if (last == m_classification.size())
+    {
+        storage.getTrailerDictionary().accept(&collector);
+    }
+
+    for (PDFObject::Type objectType : PDFObject::getTypes())
+    {
+        statistics.objectCountByType[size_t(objectType)] += collector.getObjectCount(objectType);
+    }
 }
 
 void PDFObjectClassifier::mark(PDFObjectReference reference, Type type)
@@ -170,13 +170,44 @@ public:
         std::map<Type, StatisticsItem> statistics;
     };
 
+    enum class StatisticsMode
+    {
+        Full,       ///< All objects are loaded, sizes of objects are sizes of serialized objects
+        Metadata    ///< If storage is lazy, objects are not loaded, sizes of objects are estimated
+                    ///< from cross reference table (they are unknown for objects in object streams)
+                    ///< and statistics by object type are not calculated.
+    };
+
     /// Calculate document statistics. Document classification must be
     /// performed before this function is called, otherwise result is undefined.
     /// \param document Document
+    /// \param mode Statistics mode
     /// \returns Calculated statistics of each object type
-    Statistics calculateStatistics(const PDFDocument* document) const;
+    Statistics calculateStatistics(const PDFDocument* document, StatisticsMode mode = StatisticsMode::Full) const;
+
+    /// Prepares empty statistics for all object types used in a document.
+    /// Document classification must be performed before this function is called.
+    /// \param statistics Statistics to be prepared
+    void prepareStatistics(Statistics& statistics) const;
+
+    /// Calculates statistics of classified objects in range [first, last) and
+    /// accumulates them into \p statistics, which must be prepared by
+    /// \p prepareStatistics. Statistics can be thus calculated incrementally,
+    /// for example, in the background thread with progress reporting.
+    /// \param document Document
+    /// \param statistics Accumulated statistics
+    /// \param first Index of first object
+    /// \param last Index past the last object
+    /// \param mode Statistics mode
+    void calculateStatistics(const PDFDocument* document, Statistics& statistics, size_t first, size_t last, StatisticsMode mode = StatisticsMode::Full) const;
+
+    /// Returns count of classified objects
+    size_t getObjectCount() const { return m_classification.size(); }
 
 private:
+    /// Count of objects processed by one task, when statistics are calculated
+    static constexpr size_t STATISTICS_TASK_SIZE = 1024;
+
     struct Classification
     {
         PDFObjectReference reference;
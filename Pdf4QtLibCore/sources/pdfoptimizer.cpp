@@ -23,8 +23,28 @@
 #include "pdfconstants.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfstreamfilters.h"
+#include "pdfpagecontentprocessor.h"
+#include "pdfimage.h"
+#include "pdffont.h"
+#include "pdfcms.h"
+#include "pdfoptionalcontent.h"
+#include "pdfexception.h"
+#include "pdffontsubsetter.h"
+#include "pdfcontentstreamoptimizer.h"
+#include "pdfparser.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QtMath>
+
+#include <bit>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
 #include "pdfdbgheap.h"
-#include "pdfdocumentwriter.h"
 
 namespace pdf
 {
@@ -108,316 +128,1678 @@ void PDFRemoveNullDictionaryEntriesVisitor::visitDictionary(const PDFDictionary*
     m_objectStack.push_back(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(entries))));
 }
 
-PDFOptimizer::PDFOptimizer(OptimizationFlags flags, QObject* parent) :
-    QObject(parent),
-    m_flags(flags)
+/// Finds identical objects in a single pass. Objects are processed bottom-up
+/// over the reference graph (in depth-first post-order), and for each object,
+/// 128-bit structural hash is computed, in which references are replaced by
+/// references to their representatives (first found objects identical to the
+/// referenced ones). So objects, which differ only in references to identical
+/// objects, are also found. Objects having the same hash are compared, so hash
+/// collision never causes merging of different objects. Objects in reference
+/// cycles are merged only, if they refer to the same objects in the cycle.
+class PDFIdenticalObjectsMerger
 {
+public:
+    explicit inline PDFIdenticalObjectsMerger(const PDFObjectStorage* storage, const PDFObjectStorage::PDFObjects& objects) :
+        m_storage(storage),
+        m_objects(objects)
+    {
 
-}
-
-void PDFOptimizer::optimize()
-{
-    // Jakub Melka: We divide optimization into stages, each
-    // stage can consist from multiple passes.
-    constexpr OptimizationFlags stages[] = { OptimizationFlags(DereferenceSimpleObjects),
-                                             OptimizationFlags(RemoveNullObjects),
-                                             OptimizationFlags(RemoveUnusedObjects | MergeIdenticalObjects),
-                                             OptimizationFlags(ShrinkObjectStorage),
-                                             OptimizationFlags(RecompressFlateStreams) };
+    }
 
-    int stage = 1;
+    /// Finds identical objects and returns replacement map,
+    /// which maps objects to their representatives.
+    std::map<PDFObjectReference, PDFObjectReference> merge();
 
-    Q_EMIT optimizationStarted();
-    for (OptimizationFlags flags : stages)
+private:
+    struct Hash
     {
-        Q_EMIT optimizationProgress(tr("Stage %1").arg(stage++));
-        OptimizationFlags currentSteps = flags & m_flags;
+        quint64 low = 0;
+        quint64 high = 0;
 
-        int passIndex = 1;
+        bool operator==(const Hash&) const = default;
+    };
 
-        bool pass = true;
-        while (pass)
-        {
-            Q_EMIT optimizationProgress(tr("Pass %1").arg(passIndex++));
-            pass = false;
+    struct HashHasher
+    {
+        size_t operator()(const Hash& hash) const { return static_cast<size_t>(hash.low ^ hash.high); }
+    };
 
-            if (currentSteps.testFlag(DereferenceSimpleObjects))
-            {
-                pass = performDereferenceSimpleObjects() || pass;
-            }
-            if (currentSteps.testFlag(RemoveNullObjects))
-            {
-                pass = performRemoveNullObjects() || pass;
-            }
-            if (currentSteps.testFlag(RemoveUnusedObjects))
-            {
-                pass = performRemoveUnusedObjects() || pass;
-            }
-            if (currentSteps.testFlag(MergeIdenticalObjects))
-            {
-                pass = performMergeIdenticalObjects() || pass;
-            }
-            if (currentSteps.testFlag(ShrinkObjectStorage))
-            {
-                pass = performShrinkObjectStorage() || pass;
-            }
-            if (currentSteps.testFlag(RecompressFlateStreams))
-            {
-                pass = performRecompressFlateStreams() || pass;
-            }
-        }
-    }
-    Q_EMIT optimizationFinished();
-}
+    class HashBuilder
+    {
+    public:
+        void add(quint64 value);
+        void add(QByteArrayView data);
 
-PDFOptimizer::OptimizationFlags PDFOptimizer::getFlags() const
-{
-    return m_flags;
-}
+        Hash getHash() const { return Hash{ m_low, m_high }; }
 
-void PDFOptimizer::setFlags(OptimizationFlags flags)
-{
-    m_flags = flags;
-}
+    private:
+        static quint64 mix(quint64 value);
 
-bool PDFOptimizer::performDereferenceSimpleObjects()
-{
-    std::atomic<PDFInteger> counter = 0;
+        quint64 m_low = 0x243F6A8885A308D3ULL;
+        quint64 m_high = 0x13198A2E03707344ULL;
+    };
 
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
+    struct ObjectInfo
     {
-        PDFRemoveSimpleObjectsVisitor visitor(&m_storage, &counter);
-        entry.object.accept(&visitor);
-        entry.object = visitor.getObject();
+        Hash localHash;                                 ///< Hash of the object, without referenced objects
+        std::vector<PDFObjectReference> references;     ///< References in the object (in order of the traversal)
+        bool isMergeable = false;
     };
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Simple objects dereferenced and embedded: %1").arg(counter));
+    enum class State : uint8_t
+    {
+        Unvisited,
+        Visiting,
+        Finished
+    };
 
-    return false;
-}
+    bool isValidReference(PDFObjectReference reference) const;
+    bool isPage(const PDFObject& object) const;
+    PDFObjectReference getRepresentative(PDFObjectReference reference) const;
 
-bool PDFOptimizer::performRemoveNullObjects()
-{
-    std::atomic<PDFInteger> counter = 0;
+    void computeLocalHash(const PDFObject& object, HashBuilder& builder, std::vector<PDFObjectReference>& references) const;
+    void computeLocalHash(const PDFDictionary* dictionary, HashBuilder& builder, std::vector<PDFObjectReference>& references) const;
 
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
-    {
-        PDFRemoveNullDictionaryEntriesVisitor visitor(&m_storage, &counter);
-        entry.object.accept(&visitor);
-        entry.object = visitor.getObject();
-    };
+    bool isEqual(const PDFObject& left, const PDFObject& right) const;
+    bool isEqual(const PDFDictionary* left, const PDFDictionary* right) const;
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Null objects entries from dictionaries removed: %1").arg(counter));
+    void finish(size_t index);
 
-    return false;
-}
+    const PDFObjectStorage* m_storage;
+    const PDFObjectStorage::PDFObjects& m_objects;
+    std::vector<ObjectInfo> m_infos;
+    std::vector<State> m_states;
+    std::vector<size_t> m_representatives;
+    std::unordered_multimap<Hash, size_t, HashHasher> m_hashToObject;
+};
 
-bool PDFOptimizer::performRemoveUnusedObjects()
+std::map<PDFObjectReference, PDFObjectReference> PDFIdenticalObjectsMerger::merge()
 {
-    std::atomic<PDFInteger> counter = 0;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    std::set<PDFObjectReference> references = PDFObjectUtils::getReferences({ m_storage.getTrailerDictionary() }, m_storage);
-
-    PDFIntegerRange<size_t> range(0, objects.size());
-    auto processEntry = [&counter, &objects, &references](size_t index)
+    const size_t count = m_objects.size();
+
+    m_infos.assign(count, ObjectInfo());
+    m_states.assign(count, State::Unvisited);
+    m_representatives.resize(count);
+    std::iota(m_representatives.begin(), m_representatives.end(), size_t(0));
+    m_hashToObject.clear();
+
+    // Local hashes don't depend on other objects, so we can compute them
+    // in parallel. Local hash contains all data of the object (including stream data),
+    // so it is the most time consuming part.
+    PDFIntegerRange<size_t> range(0, count);
+    auto computeInfo = [this](size_t index)
     {
-        PDFObjectStorage::Entry& entry = objects[index];
-        PDFObjectReference reference(PDFInteger(index), entry.generation);
-        if (!references.count(reference) && !entry.object.isNull())
+        const PDFObject& object = m_objects[index].object;
+        if (object.isNull())
         {
-            entry.object = PDFObject();
-            ++counter;
+            return;
         }
-    };
-
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Unused objects removed: %1").arg(counter));
 
-    return counter > 0;
-}
+        ObjectInfo& info = m_infos[index];
+        HashBuilder builder;
+        computeLocalHash(object, builder, info.references);
+        info.localHash = builder.getHash();
 
-bool PDFOptimizer::performMergeIdenticalObjects()
-{
-    std::atomic<PDFInteger> counter = 0;
-    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
-    std::map<QByteArray, PDFObjectReference> serializedObjectToReference;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    std::vector<QByteArray> serializedObjects(objects.size());
+        // We do not merge special objects, such as pages
+        info.isMergeable = !isPage(object);
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), computeInfo);
 
-    PDFIntegerRange<size_t> range(0, objects.size());
-    auto serializeEntry = [&objects, &serializedObjects](size_t index)
+    // Process objects in depth-first post-order, so referenced objects are
+    // processed before objects referencing them (except reference cycles).
+    struct StackItem
     {
-        const PDFObjectStorage::Entry& entry = objects[index];
+        size_t index = 0;
+        size_t nextReference = 0;
+    };
 
-        if (!entry.object.isNull())
+    std::vector<StackItem> stack;
+    for (size_t root = 0; root < count; ++root)
+    {
+        if (m_objects[root].object.isNull() || m_states[root] != State::Unvisited)
         {
-            serializedObjects[index] = PDFDocumentWriter::getSerializedObject(entry.object);
+            continue;
         }
-    };
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), serializeEntry);
 
-    // Find same object
-    for (PDFInteger index : range)
-    {
-        const PDFObjectStorage::Entry& entry = objects[index];
+        m_states[root] = State::Visiting;
+        stack.push_back({ root, 0 });
 
-        if (!entry.object.isNull())
+        while (!stack.empty())
         {
-            // We do not merge special objects, such as pages
-            if (const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(entry.object))
+            StackItem& item = stack.back();
+            const std::vector<PDFObjectReference>& references = m_infos[item.index].references;
+
+            if (item.nextReference < references.size())
             {
-                PDFObject nameObject = m_storage.getObject(dictionary->get("Type"));
-                if (nameObject.isName())
+                const PDFObjectReference reference = references[item.nextReference++];
+                if (isValidReference(reference) && m_states[reference.objectNumber] == State::Unvisited)
                 {
-                    if (nameObject.getString() == "Page")
-                    {
-                        continue;
-                    }
+                    m_states[reference.objectNumber] = State::Visiting;
+                    stack.push_back({ static_cast<size_t>(reference.objectNumber), 0 });
                 }
+                continue;
             }
 
-            PDFObjectReference currentReference(PDFInteger(index), objects[index].generation);
-            const QByteArray& serializedObject = serializedObjects[index];
-            if (!serializedObjectToReference.count(serializedObject))
-            {
-                serializedObjectToReference[serializedObject] = currentReference;
-            }
-            else
-            {
-                PDFObjectReference oldReference = currentReference;
-                PDFObjectReference newReference = serializedObjectToReference.at(serializedObject);
-                replacementMap[oldReference] = newReference;
-                ++counter;
-            }
+            finish(item.index);
+            stack.pop_back();
         }
     }
 
-    // Replace objects
-    if (!replacementMap.empty())
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    for (size_t i = 0; i < count; ++i)
     {
-        for (size_t i = 0; i < objects.size(); ++i)
+        const size_t representative = m_representatives[i];
+        if (representative != i)
         {
-            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+            replacementMap[PDFObjectReference(PDFInteger(i), m_objects[i].generation)] = PDFObjectReference(PDFInteger(representative), m_objects[representative].generation);
         }
-        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
-        m_storage.setTrailerDictionary(trailerDictionary);
     }
 
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Identical objects merged: %1").arg(counter));
+    return replacementMap;
+}
 
-    return counter > 0;
+void PDFIdenticalObjectsMerger::HashBuilder::add(quint64 value)
+{
+    m_low = mix(m_low ^ value);
+    m_high = mix(m_high + value);
 }
 
-bool PDFOptimizer::performShrinkObjectStorage()
+void PDFIdenticalObjectsMerger::HashBuilder::add(QByteArrayView data)
 {
-    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    add(static_cast<quint64>(data.size()));
+    m_low = mix(m_low ^ static_cast<quint64>(qHashBits(data.data(), data.size(), 0x9E3779B9U)));
+    m_high = mix(m_high + static_cast<quint64>(qHashBits(data.data(), data.size(), 0x85EBCA6BU)));
+}
 
-    auto isFree = [](const PDFObjectStorage::Entry& entry)
-    {
-        return entry.object.isNull() && entry.generation < PDF_MAX_OBJECT_GENERATION;
-    };
-    auto isOccupied = [](const PDFObjectStorage::Entry& entry)
+quint64 PDFIdenticalObjectsMerger::HashBuilder::mix(quint64 value)
+{
+    // Finalizer of the SplitMix64 generator
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+bool PDFIdenticalObjectsMerger::isValidReference(PDFObjectReference reference) const
+{
+    return reference.objectNumber >= 0 &&
+           reference.objectNumber < static_cast<PDFInteger>(m_objects.size()) &&
+           m_objects[reference.objectNumber].generation == reference.generation &&
+           !m_objects[reference.objectNumber].object.isNull();
+}
+
+bool PDFIdenticalObjectsMerger::isPage(const PDFObject& object) const
+{
+    if (const PDFDictionary* dictionary = m_storage->getDictionaryFromObject(object))
     {
-        return !entry.object.isNull();
-    };
+        PDFObject nameObject = m_storage->getObject(dictionary->get("Type"));
+        return nameObject.isName() && nameObject.getString() == "Page";
+    }
 
-    // Make list of free usable indices
-    std::vector<size_t> freeIndices;
-    freeIndices.reserve(objects.size() / 8);
+    return false;
+}
 
-    const size_t objectCount = objects.size();
-    for (size_t sourceIndex = 1; sourceIndex < objectCount; ++sourceIndex)
+PDFObjectReference PDFIdenticalObjectsMerger::getRepresentative(PDFObjectReference reference) const
+{
+    if (isValidReference(reference) && m_states[reference.objectNumber] == State::Finished)
     {
-        if (isFree(objects[sourceIndex]))
-        {
-            freeIndices.push_back(sourceIndex);
-        }
+        const size_t representative = m_representatives[reference.objectNumber];
+        return PDFObjectReference(PDFInteger(representative), m_objects[representative].generation);
     }
-    std::reverse(freeIndices.begin(), freeIndices.end());
 
-    // Move objects to free entries
-    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    return reference;
+}
+
+void PDFIdenticalObjectsMerger::computeLocalHash(const PDFObject& object, HashBuilder& builder, std::vector<PDFObjectReference>& references) const
+{
+    builder.add(static_cast<quint64>(object.getType()));
+
+    switch (object.getType())
     {
-        if (freeIndices.empty())
-        {
-            // Jakub Melka: We have run out of free indices
+        case PDFObject::Type::Null:
             break;
-        }
-
-        PDFObjectStorage::Entry& sourceEntry = objects[sourceIndex];
-        if (isOccupied(sourceEntry))
-        {
-            size_t targetIndex = freeIndices.back();
-            freeIndices.pop_back();
 
-            if (targetIndex >= sourceIndex)
-            {
-                break;
-            }
+        case PDFObject::Type::Bool:
+            builder.add(object.getBool() ? 1 : 0);
+            break;
 
-            PDFObjectStorage::Entry& targetEntry = objects[targetIndex];
-            Q_ASSERT(isFree(targetEntry));
+        case PDFObject::Type::Int:
+            builder.add(static_cast<quint64>(object.getInteger()));
+            break;
 
-            ++targetEntry.generation;
-            targetEntry.object = qMove(sourceEntry.object);
-            sourceEntry.object = PDFObject();
+        case PDFObject::Type::Real:
+            builder.add(std::bit_cast<quint64>(object.getReal()));
+            break;
 
-            replacementMap[PDFObjectReference(PDFInteger(sourceIndex), sourceEntry.generation)] = PDFObjectReference(PDFInteger(targetIndex), targetEntry.generation);
-        }
-    }
+        case PDFObject::Type::String:
+        case PDFObject::Type::Name:
+            builder.add(object.getStringObject().getView());
+            break;
 
-    // Shrink objects array
-    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
-    {
-        if (isOccupied(objects[sourceIndex]))
+        case PDFObject::Type::Array:
         {
-            objects.resize(sourceIndex + 1);
+            const PDFArray* array = object.getArray();
+            builder.add(static_cast<quint64>(array->getCount()));
+            for (size_t i = 0, itemCount = array->getCount(); i < itemCount; ++i)
+            {
+                computeLocalHash(array->getItem(i), builder, references);
+            }
             break;
         }
-    }
 
-    // Update objects
-    if (!replacementMap.empty())
-    {
-        for (size_t i = 0; i < objects.size(); ++i)
+        case PDFObject::Type::Dictionary:
+            computeLocalHash(object.getDictionary(), builder, references);
+            break;
+
+        case PDFObject::Type::Stream:
         {
-            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+            const PDFStream* stream = object.getStream();
+            computeLocalHash(stream->getDictionary(), builder, references);
+            builder.add(QByteArrayView(*stream->getContent()));
+            break;
         }
-        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
 
-        PDFObjectFactory factory;
-        factory.beginDictionary();
-        factory.beginDictionaryItem("Size");
-        factory << PDFInteger(objects.size());
-        factory.endDictionaryItem();
-        factory.endDictionary();
+        case PDFObject::Type::Reference:
+            // Referenced object is added to the hash later, when it is processed
+            references.push_back(object.getReference());
+            break;
 
-        trailerDictionary = PDFObjectManipulator::merge(trailerDictionary, factory.takeObject(), PDFObjectManipulator::NoFlag);
-        m_storage.setTrailerDictionary(trailerDictionary);
+        default:
+            Q_ASSERT(false);
+            break;
     }
-
-    const size_t newObjectCount = objects.size();
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Object list shrinked by: %1").arg(objectCount - newObjectCount));
-
-    return false;
 }
 
-bool PDFOptimizer::performRecompressFlateStreams()
+void PDFIdenticalObjectsMerger::computeLocalHash(const PDFDictionary* dictionary, HashBuilder& builder, std::vector<PDFObjectReference>& references) const
 {
-    std::atomic<PDFInteger> bytesSaved = 0;
-
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &bytesSaved](PDFObjectStorage::Entry& entry)
+    builder.add(static_cast<quint64>(dictionary->getCount()));
+    for (size_t i = 0, entryCount = dictionary->getCount(); i < entryCount; ++i)
+    {
+        builder.add(dictionary->getKey(i).getView());
+        computeLocalHash(dictionary->getValue(i), builder, references);
+    }
+}
+
+bool PDFIdenticalObjectsMerger::isEqual(const PDFObject& left, const PDFObject& right) const
+{
+    if (left.getType() != right.getType())
+    {
+        return false;
+    }
+
+    switch (left.getType())
+    {
+        case PDFObject::Type::Null:
+            return true;
+
+        case PDFObject::Type::Bool:
+            return left.getBool() == right.getBool();
+
+        case PDFObject::Type::Int:
+            return left.getInteger() == right.getInteger();
+
+        case PDFObject::Type::Real:
+            return std::bit_cast<quint64>(left.getReal()) == std::bit_cast<quint64>(right.getReal());
+
+        case PDFObject::Type::String:
+        case PDFObject::Type::Name:
+            return left.getStringObject().getView() == right.getStringObject().getView();
+
+        case PDFObject::Type::Array:
+        {
+            const PDFArray* leftArray = left.getArray();
+            const PDFArray* rightArray = right.getArray();
+
+            if (leftArray->getCount() != rightArray->getCount())
+            {
+                return false;
+            }
+
+            for (size_t i = 0, itemCount = leftArray->getCount(); i < itemCount; ++i)
+            {
+                if (!isEqual(leftArray->getItem(i), rightArray->getItem(i)))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        case PDFObject::Type::Dictionary:
+            return isEqual(left.getDictionary(), right.getDictionary());
+
+        case PDFObject::Type::Stream:
+        {
+            const PDFStream* leftStream = left.getStream();
+            const PDFStream* rightStream = right.getStream();
+            return *leftStream->getContent() == *rightStream->getContent() && isEqual(leftStream->getDictionary(), rightStream->getDictionary());
+        }
+
+        case PDFObject::Type::Reference:
+            return getRepresentative(left.getReference()) == getRepresentative(right.getReference());
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return false;
+}
+
+bool PDFIdenticalObjectsMerger::isEqual(const PDFDictionary* left, const PDFDictionary* right) const
+{
+    if (left->getCount() != right->getCount())
+    {
+        return false;
+    }
+
+    for (size_t i = 0, entryCount = left->getCount(); i < entryCount; ++i)
+    {
+        if (left->getKey(i) != right->getKey(i) || !isEqual(left->getValue(i), right->getValue(i)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PDFIdenticalObjectsMerger::finish(size_t index)
+{
+    const ObjectInfo& info = m_infos[index];
+    m_states[index] = State::Finished;
+
+    if (!info.isMergeable)
+    {
+        return;
+    }
+
+    HashBuilder builder;
+    builder.add(info.localHash.low);
+    builder.add(info.localHash.high);
+    for (const PDFObjectReference& reference : info.references)
+    {
+        const PDFObjectReference representative = getRepresentative(reference);
+        builder.add(static_cast<quint64>(representative.objectNumber));
+        builder.add(static_cast<quint64>(representative.generation));
+    }
+    const Hash hash = builder.getHash();
+
+    // Verify, that objects are really identical, hashes can collide
+    auto [it, itEnd] = m_hashToObject.equal_range(hash);
+    for (; it != itEnd; ++it)
+    {
+        if (isEqual(m_objects[it->second].object, m_objects[index].object))
+        {
+            m_representatives[index] = it->second;
+            return;
+        }
+    }
+
+    m_hashToObject.emplace(hash, index);
+}
+
+/// Collects placed sizes of images on the page (in inches). Only images and forms
+/// are processed, and images are never converted to the QImage.
+class PDFImagePlacementProcessor : public PDFPageContentProcessor
+{
+    using BaseClass = PDFPageContentProcessor;
+
+public:
+    explicit PDFImagePlacementProcessor(const PDFPage* page,
+                                        const PDFDocument* document,
+                                        const PDFFontCache* fontCache,
+                                        const PDFCMS* cms,
+                                        const PDFOptionalContentActivity* optionalContentActivity,
+                                        const PDFMeshQualitySettings& meshQualitySettings) :
+        BaseClass(page, document, fontCache, cms, optionalContentActivity, QTransform(), meshQualitySettings)
+    {
+
+    }
+
+    std::map<const PDFStream*, QSizeF>& takePlacements() { return m_placements; }
+
+protected:
+    virtual bool isContentKindSuppressed(ContentKind kind) const override;
+    virtual bool isOriginalImagePaintingUsed() const override { return true; }
+    virtual bool performOriginalImagePainting(const PDFImage& image, const PDFStream* stream) override;
+
+private:
+    std::map<const PDFStream*, QSizeF> m_placements;
+};
+
+bool PDFImagePlacementProcessor::isContentKindSuppressed(ContentKind kind) const
+{
+    switch (kind)
+    {
+        case ContentKind::Images:
+        case ContentKind::Forms:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+bool PDFImagePlacementProcessor::performOriginalImagePainting(const PDFImage& image, const PDFStream* stream)
+{
+    Q_UNUSED(image);
+
+    // Image is painted onto the unit square of the user space,
+    // and page space units are 1/72 inch.
+    const QTransform matrix = getCurrentWorldMatrix();
+    const PDFReal width = std::hypot(matrix.m11(), matrix.m12()) / 72.0;
+    const PDFReal height = std::hypot(matrix.m21(), matrix.m22()) / 72.0;
+
+    QSizeF& size = m_placements[stream];
+    size = QSizeF(qMax(size.width(), width), qMax(size.height(), height));
+    return true;
+}
+
+/// Helper functions for image optimization passes. Images are decoded
+/// to their samples in the original color space (no color conversion is
+/// performed), so re-encoded images keep their color space.
+class PDFOptimizerImageHelper
+{
+public:
+    using Hash = std::pair<size_t, size_t>;
+
+    /// Returns true, if object is an image XObject
+    static bool isImage(const PDFObject& object);
+
+    /// Returns soft masks of the images in the object list
+    static std::set<PDFObjectReference> getSoftMasks(const PDFObjectStorage::PDFObjects& objects);
+
+    /// Returns maximal placed size of the images on the pages (in inches). Soft masks
+    /// receive placed size of the images, which they mask.
+    static std::map<PDFObjectReference, QSizeF> getImagePlacements(const PDFDocument* document, const PDFObjectStorage::PDFObjects& objects);
+
+    /// Returns true, if samples of the image can be re-encoded (no decode array,
+    /// color key masking, or samples in other than image data filter)
+    static bool canBeReencoded(const PDFDocument* document, const PDFStream* stream);
+
+    /// Decodes the image, returns empty optional value, if image can't be decoded
+    static std::optional<PDFImage> decodeImage(const PDFDocument* document, const PDFStream* stream, bool isSoftMask);
+
+    /// Creates image from 8-bit gray or RGB samples. For other samples,
+    /// null image is returned.
+    static QImage createImage(const PDFImageData& imageData);
+
+    /// Returns samples of image data, without row padding
+    static QByteArray getPackedSamples(const PDFImageData& imageData);
+
+    /// Returns samples of image created by \p createImage, without row padding
+    static QByteArray getPackedSamples(const QImage& image);
+
+    /// Returns samples of gray image containing only black and white pixels as 1-bit samples
+    static QByteArray getBilevelSamples(const QImage& image);
+
+    /// Returns true, if gray image contains only black and white pixels
+    static bool isBilevel(const QImage& image);
+
+    /// Returns true, if image contains so many distinct colors, that
+    /// it is probably a photo (and thus lossy compression is appropriate)
+    static bool isPhotographic(const QImage& image);
+
+    /// Returns hash of the decoded image samples (including image dimensions)
+    static Hash getHash(const PDFImageData& imageData);
+
+    /// Returns image dictionary without entries describing the encoding of the image data
+    static PDFObject getDictionaryWithoutEncoding(const PDFDictionary* dictionary);
+
+    /// Returns name of the last filter of the image stream (which is the image filter)
+    static QByteArray getFilterName(const PDFDocument* document, const PDFDictionary* dictionary);
+};
+
+bool PDFOptimizerImageHelper::isImage(const PDFObject& object)
+{
+    if (!object.isStream())
+    {
+        return false;
+    }
+
+    const PDFObject& subtype = object.getStream()->getDictionary()->get("Subtype");
+    return subtype.isName() && subtype.getString() == "Image";
+}
+
+std::set<PDFObjectReference> PDFOptimizerImageHelper::getSoftMasks(const PDFObjectStorage::PDFObjects& objects)
+{
+    std::set<PDFObjectReference> softMasks;
+    for (const PDFObjectStorage::Entry& entry : objects)
+    {
+        if (isImage(entry.object))
+        {
+            const PDFObject& softMask = entry.object.getStream()->getDictionary()->get("SMask");
+            if (softMask.isReference())
+            {
+                softMasks.insert(softMask.getReference());
+            }
+        }
+    }
+
+    return softMasks;
+}
+
+std::map<PDFObjectReference, QSizeF> PDFOptimizerImageHelper::getImagePlacements(const PDFDocument* document, const PDFObjectStorage::PDFObjects& objects)
+{
+    std::map<const PDFStream*, QSizeF> streamPlacements;
+
+    PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+
+    QMutex mutex;
+    PDFCMSGeneric cms;
+    PDFMeshQualitySettings mqs;
+    PDFOptionalContentActivity oca(document, OCUsage::Export, nullptr);
+    PDFModifiedDocument md(const_cast<PDFDocument*>(document), &oca);
+    fontCache.setDocument(md);
+    fontCache.setCacheShrinkEnabled(nullptr, false);
+
+    auto processPage = [&](size_t pageIndex)
+    {
+        const PDFPage* page = document->getCatalog()->getPage(pageIndex);
+        if (!page)
+        {
+            return;
+        }
+
+        PDFImagePlacementProcessor processor(page, document, &fontCache, &cms, &oca, mqs);
+        processor.processContents();
+
+        QMutexLocker lock(&mutex);
+        for (const auto& placement : processor.takePlacements())
+        {
+            QSizeF& size = streamPlacements[placement.first];
+            size = QSizeF(qMax(size.width(), placement.second.width()), qMax(size.height(), placement.second.height()));
+        }
+    };
+
+    PDFIntegerRange<size_t> pageRange(0, document->getCatalog()->getPageCount());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), processPage);
+
+    fontCache.setCacheShrinkEnabled(nullptr, true);
+
+    // Map streams to references. Document shares object contents with
+    // the object list, so stream pointers are the same.
+    std::map<PDFObjectReference, QSizeF> placements;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const PDFObjectStorage::Entry& entry = objects[i];
+        if (!entry.object.isStream())
+        {
+            continue;
+        }
+
+        auto it = streamPlacements.find(entry.object.getStream());
+        if (it != streamPlacements.cend())
+        {
+            placements[PDFObjectReference(PDFInteger(i), entry.generation)] = it->second;
+        }
+    }
+
+    // Soft masks are placed at the same place as their images
+    std::map<PDFObjectReference, QSizeF> softMaskPlacements;
+    for (const auto& placement : placements)
+    {
+        const PDFObject& softMask = document->getObjectByReference(placement.first).getStream()->getDictionary()->get("SMask");
+        if (softMask.isReference())
+        {
+            QSizeF& size = softMaskPlacements[softMask.getReference()];
+            size = QSizeF(qMax(size.width(), placement.second.width()), qMax(size.height(), placement.second.height()));
+        }
+    }
+    placements.merge(softMaskPlacements);
+
+    return placements;
+}
+
+bool PDFOptimizerImageHelper::canBeReencoded(const PDFDocument* document, const PDFStream* stream)
+{
+    const PDFDictionary* dictionary = stream->getDictionary();
+    PDFDocumentDataLoaderDecorator loader(document);
+
+    if (dictionary->hasKey("F") ||
+        dictionary->hasKey("Decode") ||
+        loader.readBooleanFromDictionary(dictionary, "ImageMask", false) ||
+        loader.readIntegerFromDictionary(dictionary, "SMaskInData", 0) != 0 ||
+        document->getObject(dictionary->get("Mask")).isArray())
+    {
+        return false;
+    }
+
+    // JPEG 2000 images can contain color space and alpha channel in the image data
+    return getFilterName(document, dictionary) != "JPXDecode";
+}
+
+std::optional<PDFImage> PDFOptimizerImageHelper::decodeImage(const PDFDocument* document, const PDFStream* stream, bool isSoftMask)
+{
+    std::optional<PDFImage> pdfImage;
+    PDFRenderErrorReporterDummy errorReporter;
+
+    try
+    {
+        PDFColorSpacePointer colorSpace;
+        const PDFDictionary* dictionary = stream->getDictionary();
+        if (dictionary->hasKey("ColorSpace"))
+        {
+            const PDFObject& colorSpaceObject = document->getObject(dictionary->get("ColorSpace"));
+            if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+            {
+                PDFDictionary dummyDictionary;
+                colorSpace = PDFAbstractColorSpace::createColorSpace(&dummyDictionary, document, colorSpaceObject);
+            }
+        }
+
+        pdfImage.emplace(PDFImage::createImage(document, stream, qMove(colorSpace), isSoftMask, RenderingIntent::Perceptual, &errorReporter));
+    }
+    catch (const PDFException&)
+    {
+        pdfImage.reset();
+    }
+    catch (const PDFRendererException&)
+    {
+        pdfImage.reset();
+    }
+
+    return pdfImage;
+}
+
+QImage PDFOptimizerImageHelper::createImage(const PDFImageData& imageData)
+{
+    const unsigned int components = imageData.getComponents();
+    if (!imageData.isValid() || imageData.getBitsPerComponent() != 8 || (components != 1 && components != 3))
+    {
+        return QImage();
+    }
+
+    const unsigned int width = imageData.getWidth();
+    const unsigned int height = imageData.getHeight();
+    const size_t rowSize = size_t(width) * components;
+
+    if (imageData.getStride() < rowSize || size_t(imageData.getData().size()) < size_t(imageData.getStride()) * height)
+    {
+        return QImage();
+    }
+
+    QImage image(width, height, components == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+    for (unsigned int row = 0; row < height; ++row)
+    {
+        std::memcpy(image.scanLine(row), imageData.getRow(row), rowSize);
+    }
+
+    return image;
+}
+
+QByteArray PDFOptimizerImageHelper::getPackedSamples(const PDFImageData& imageData)
+{
+    const size_t rowSize = (size_t(imageData.getWidth()) * imageData.getComponents() * imageData.getBitsPerComponent() + 7) / 8;
+    const unsigned int height = imageData.getHeight();
+
+    if (imageData.getStride() < rowSize || size_t(imageData.getData().size()) < size_t(imageData.getStride()) * height)
+    {
+        return imageData.getData();
+    }
+
+    QByteArray samples;
+    samples.reserve(rowSize * height);
+    for (unsigned int row = 0; row < height; ++row)
+    {
+        samples.append(reinterpret_cast<const char*>(imageData.getRow(row)), rowSize);
+    }
+
+    return samples;
+}
+
+QByteArray PDFOptimizerImageHelper::getPackedSamples(const QImage& image)
+{
+    const int components = image.format() == QImage::Format_Grayscale8 ? 1 : 3;
+    const qsizetype rowSize = qsizetype(image.width()) * components;
+
+    QByteArray samples;
+    samples.reserve(rowSize * image.height());
+    for (int row = 0; row < image.height(); ++row)
+    {
+        samples.append(reinterpret_cast<const char*>(image.constScanLine(row)), rowSize);
+    }
+
+    return samples;
+}
+
+QByteArray PDFOptimizerImageHelper::getBilevelSamples(const QImage& image)
+{
+    Q_ASSERT(image.format() == QImage::Format_Grayscale8);
+
+    PDFBitWriter bitWriter(1);
+    bitWriter.reserve((image.width() + 7) / 8 * image.height());
+    for (int row = 0; row < image.height(); ++row)
+    {
+        const uchar* rowData = image.constScanLine(row);
+        for (int column = 0; column < image.width(); ++column)
+        {
+            bitWriter.write(rowData[column] ? 1 : 0);
+        }
+
+        bitWriter.finishLine();
+    }
+
+    return bitWriter.takeByteArray();
+}
+
+bool PDFOptimizerImageHelper::isBilevel(const QImage& image)
+{
+    if (image.format() != QImage::Format_Grayscale8)
+    {
+        return false;
+    }
+
+    for (int row = 0; row < image.height(); ++row)
+    {
+        const uchar* rowData = image.constScanLine(row);
+        for (int column = 0; column < image.width(); ++column)
+        {
+            if (rowData[column] != 0 && rowData[column] != 255)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool PDFOptimizerImageHelper::isPhotographic(const QImage& image)
+{
+    // Graphics (charts, diagrams, screenshots) usually contain only a few
+    // distinct colors, and JPEG compression produces visible artifacts on their sharp
+    // edges. So we consider image as photographic, if it has enough distinct colors.
+    const bool isGray = image.format() == QImage::Format_Grayscale8;
+    const size_t limit = isGray ? 64 : 256;
+
+    QSet<quint32> colors;
+    for (int row = 0; row < image.height(); ++row)
+    {
+        const uchar* rowData = image.constScanLine(row);
+        for (int column = 0; column < image.width(); ++column)
+        {
+            const quint32 color = isGray ? rowData[column] : (quint32(rowData[3 * column]) << 16) | (quint32(rowData[3 * column + 1]) << 8) | rowData[3 * column + 2];
+            colors.insert(color);
+
+            if (size_t(colors.size()) > limit)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+PDFOptimizerImageHelper::Hash PDFOptimizerImageHelper::getHash(const PDFImageData& imageData)
+{
+    const QByteArray samples = getPackedSamples(imageData);
+    const size_t header = qHashMulti(0, imageData.getWidth(), imageData.getHeight(), imageData.getComponents(), imageData.getBitsPerComponent());
+    return Hash(qHashBits(samples.constData(), samples.size(), header), qHashBits(samples.constData(), samples.size(), ~header));
+}
+
+PDFObject PDFOptimizerImageHelper::getDictionaryWithoutEncoding(const PDFDictionary* dictionary)
+{
+    PDFDictionary result = *dictionary;
+    result.removeEntry("Filter");
+    result.removeEntry("DecodeParms");
+    result.removeEntry("Length");
+    result.removeEntry("DL");
+    result.removeEntry("BitsPerComponent");
+    return PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(result)));
+}
+
+QByteArray PDFOptimizerImageHelper::getFilterName(const PDFDocument* document, const PDFDictionary* dictionary)
+{
+    const PDFObject& filterObject = document->getObject(dictionary->get("Filter"));
+    if (filterObject.isName())
+    {
+        return filterObject.getString();
+    }
+
+    if (filterObject.isArray() && filterObject.getArray()->getCount() > 0)
+    {
+        const PDFObject& lastFilterObject = document->getObject(filterObject.getArray()->getItem(filterObject.getArray()->getCount() - 1));
+        if (lastFilterObject.isName())
+        {
+            return lastFilterObject.getString();
+        }
+    }
+
+    return QByteArray();
+}
+
+/// Collects glyphs used in the content streams of the document for embedded
+/// TrueType font programs, which can be subset. Only TrueType fonts of composite
+/// fonts with identity encoding are subset (character codes are CIDs directly),
+/// because for simple TrueType fonts, mapping of character codes to glyphs
+/// depends on the internal tables of the font program.
+class PDFFontGlyphUsageCollector
+{
+public:
+    explicit inline PDFFontGlyphUsageCollector(const PDFDocument* document) :
+        m_document(document)
+    {
+
+    }
+
+    /// Collects glyph usage of font programs. Returns false, if usage of the
+    /// glyphs can't be reliably determined (then no font can be subset).
+    /// \param objects Objects of the document
+    bool collect(const PDFObjectStorage::PDFObjects& objects);
+
+    /// Returns font programs, which can be subset, together with used glyphs
+    std::map<PDFObjectReference, std::set<GID>> getSubsettableFontPrograms() const;
+
+private:
+    struct FontInfo
+    {
+        PDFObjectReference fontProgram;
+        QByteArray cidToGidMapping;
+    };
+
+    /// Returns font info, if font is composite font with TrueType font program and identity encoding
+    std::optional<FontInfo> getFontInfo(const PDFObject& fontObject) const;
+
+    /// Returns TrueType font programs referenced by the font
+    std::vector<PDFObjectReference> getFontPrograms(const PDFObject& fontObject) const;
+
+    /// Scans content stream, returns false, if content stream can't be scanned
+    bool scanContentStream(const QByteArray& content, const PDFDictionary* resources);
+
+    const PDFDocument* m_document;
+    std::map<PDFObjectReference, std::set<GID>> m_glyphUsage;
+    std::set<PDFObjectReference> m_candidates;
+    std::set<PDFObjectReference> m_excluded;
+};
+
+bool PDFFontGlyphUsageCollector::collect(const PDFObjectStorage::PDFObjects& objects)
+{
+    m_glyphUsage.clear();
+    m_candidates.clear();
+    m_excluded.clear();
+
+    // Determine, which font programs are candidates for subsetting. Font program
+    // can be shared by multiple fonts, so it is excluded, if any of them is not
+    // suitable for subsetting.
+    for (const PDFObjectStorage::Entry& entry : objects)
+    {
+        const PDFDictionary* dictionary = m_document->getDictionaryFromObject(entry.object);
+        if (!dictionary || entry.object.isStream())
+        {
+            continue;
+        }
+
+        const PDFObject& type = dictionary->get("Type");
+        if (type.isName() && type.getString() == "Font")
+        {
+            if (std::optional<FontInfo> fontInfo = getFontInfo(entry.object))
+            {
+                m_candidates.insert(fontInfo->fontProgram);
+            }
+            else
+            {
+                const std::vector<PDFObjectReference> fontPrograms = getFontPrograms(entry.object);
+                m_excluded.insert(fontPrograms.cbegin(), fontPrograms.cend());
+            }
+        }
+    }
+
+    // Fonts in the interactive form default resources can be used to generate
+    // appearance of any text, so we do not subset them.
+    if (const PDFDictionary* rootDictionary = m_document->getDictionaryFromObject(m_document->getTrailerDictionary()->get("Root")))
+    {
+        if (const PDFDictionary* acroFormDictionary = m_document->getDictionaryFromObject(rootDictionary->get("AcroForm")))
+        {
+            if (const PDFDictionary* resourcesDictionary = m_document->getDictionaryFromObject(acroFormDictionary->get("DR")))
+            {
+                if (const PDFDictionary* fontsDictionary = m_document->getDictionaryFromObject(resourcesDictionary->get("Font")))
+                {
+                    for (size_t i = 0; i < fontsDictionary->getCount(); ++i)
+                    {
+                        const std::vector<PDFObjectReference> fontPrograms = getFontPrograms(fontsDictionary->getValue(i));
+                        m_excluded.insert(fontPrograms.cbegin(), fontPrograms.cend());
+                    }
+                }
+            }
+        }
+    }
+
+    if (m_candidates.empty())
+    {
+        return true;
+    }
+
+    // Scan page content streams
+    const PDFCatalog* catalog = m_document->getCatalog();
+    for (size_t i = 0, pageCount = catalog->getPageCount(); i < pageCount; ++i)
+    {
+        const PDFPage* page = catalog->getPage(i);
+        const PDFObject& contents = m_document->getObject(page->getContents());
+
+        QByteArray content;
+        if (contents.isStream())
+        {
+            content = m_document->getDecodedStream(contents.getStream());
+        }
+        else if (contents.isArray())
+        {
+            const PDFArray* array = contents.getArray();
+            for (size_t j = 0; j < array->getCount(); ++j)
+            {
+                const PDFObject& contentObject = m_document->getObject(array->getItem(j));
+                if (contentObject.isStream())
+                {
+                    content.append(m_document->getDecodedStream(contentObject.getStream()));
+                    content.append('\n');
+                }
+            }
+        }
+
+        if (!scanContentStream(content, m_document->getDictionaryFromObject(page->getResources())))
+        {
+            return false;
+        }
+    }
+
+    // Scan forms (including appearance streams), tiling patterns and Type 3 glyphs
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    for (const PDFObjectStorage::Entry& entry : objects)
+    {
+        if (entry.object.isStream())
+        {
+            const PDFStream* stream = entry.object.getStream();
+            const PDFDictionary* dictionary = stream->getDictionary();
+            if (loader.readNameFromDictionary(dictionary, "Subtype") == "Form" || loader.readIntegerFromDictionary(dictionary, "PatternType", 0) == 1)
+            {
+                if (!scanContentStream(m_document->getDecodedStream(stream), m_document->getDictionaryFromObject(dictionary->get("Resources"))))
+                {
+                    return false;
+                }
+            }
+        }
+        else if (const PDFDictionary* dictionary = m_document->getDictionaryFromObject(entry.object))
+        {
+            if (loader.readNameFromDictionary(dictionary, "Type") == "Font" && loader.readNameFromDictionary(dictionary, "Subtype") == "Type3")
+            {
+                const PDFDictionary* resources = m_document->getDictionaryFromObject(dictionary->get("Resources"));
+                if (const PDFDictionary* charProcs = m_document->getDictionaryFromObject(dictionary->get("CharProcs")))
+                {
+                    for (size_t i = 0; i < charProcs->getCount(); ++i)
+                    {
+                        const PDFObject& charProc = m_document->getObject(charProcs->getValue(i));
+                        if (charProc.isStream() && !scanContentStream(m_document->getDecodedStream(charProc.getStream()), resources))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+std::map<PDFObjectReference, std::set<GID>> PDFFontGlyphUsageCollector::getSubsettableFontPrograms() const
+{
+    std::map<PDFObjectReference, std::set<GID>> result;
+
+    for (const PDFObjectReference& fontProgram : m_candidates)
+    {
+        if (!m_excluded.count(fontProgram))
+        {
+            auto it = m_glyphUsage.find(fontProgram);
+            result[fontProgram] = (it != m_glyphUsage.cend()) ? it->second : std::set<GID>();
+        }
+    }
+
+    return result;
+}
+
+std::optional<PDFFontGlyphUsageCollector::FontInfo> PDFFontGlyphUsageCollector::getFontInfo(const PDFObject& fontObject) const
+{
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* fontDictionary = m_document->getDictionaryFromObject(fontObject);
+    if (!fontDictionary || loader.readNameFromDictionary(fontDictionary, "Subtype") != "Type0")
+    {
+        return std::nullopt;
+    }
+
+    const QByteArray encoding = loader.readNameFromDictionary(fontDictionary, "Encoding");
+    if (encoding != "Identity-H" && encoding != "Identity-V")
+    {
+        return std::nullopt;
+    }
+
+    const PDFObject& descendantFonts = m_document->getObject(fontDictionary->get("DescendantFonts"));
+    if (!descendantFonts.isArray() || descendantFonts.getArray()->getCount() != 1)
+    {
+        return std::nullopt;
+    }
+
+    const PDFDictionary* cidFontDictionary = m_document->getDictionaryFromObject(descendantFonts.getArray()->getItem(0));
+    if (!cidFontDictionary || loader.readNameFromDictionary(cidFontDictionary, "Subtype") != "CIDFontType2")
+    {
+        return std::nullopt;
+    }
+
+    const PDFDictionary* fontDescriptor = m_document->getDictionaryFromObject(cidFontDictionary->get("FontDescriptor"));
+    if (!fontDescriptor || !fontDescriptor->get("FontFile2").isReference())
+    {
+        return std::nullopt;
+    }
+
+    FontInfo fontInfo;
+    fontInfo.fontProgram = fontDescriptor->get("FontFile2").getReference();
+
+    const PDFObject& cidToGidMap = m_document->getObject(cidFontDictionary->get("CIDToGIDMap"));
+    if (cidToGidMap.isStream())
+    {
+        fontInfo.cidToGidMapping = m_document->getDecodedStream(cidToGidMap.getStream());
+    }
+    else if (!cidToGidMap.isNull() && !(cidToGidMap.isName() && cidToGidMap.getString() == "Identity"))
+    {
+        return std::nullopt;
+    }
+
+    return fontInfo;
+}
+
+std::vector<PDFObjectReference> PDFFontGlyphUsageCollector::getFontPrograms(const PDFObject& fontObject) const
+{
+    std::vector<PDFObjectReference> fontPrograms;
+
+    auto addFontProgram = [this, &fontPrograms](const PDFDictionary* fontDictionary)
+    {
+        if (const PDFDictionary* fontDescriptor = m_document->getDictionaryFromObject(fontDictionary->get("FontDescriptor")))
+        {
+            const PDFObject& fontFile = fontDescriptor->get("FontFile2");
+            if (fontFile.isReference())
+            {
+                fontPrograms.push_back(fontFile.getReference());
+            }
+        }
+    };
+
+    if (const PDFDictionary* fontDictionary = m_document->getDictionaryFromObject(fontObject))
+    {
+        addFontProgram(fontDictionary);
+
+        const PDFObject& descendantFonts = m_document->getObject(fontDictionary->get("DescendantFonts"));
+        if (descendantFonts.isArray())
+        {
+            for (size_t i = 0; i < descendantFonts.getArray()->getCount(); ++i)
+            {
+                if (const PDFDictionary* descendantFontDictionary = m_document->getDictionaryFromObject(descendantFonts.getArray()->getItem(i)))
+                {
+                    addFontProgram(descendantFontDictionary);
+                }
+            }
+        }
+    }
+
+    return fontPrograms;
+}
+
+bool PDFFontGlyphUsageCollector::scanContentStream(const QByteArray& content, const PDFDictionary* resources)
+{
+    const PDFDictionary* fontsDictionary = resources ? m_document->getDictionaryFromObject(resources->get("Font")) : nullptr;
+
+    std::optional<FontInfo> currentFont;
+    std::vector<PDFLexicalAnalyzer::Token> operands;
+
+    try
+    {
+        PDFLexicalAnalyzer parser(content.constBegin(), content.constEnd());
+        while (!parser.isAtEnd())
+        {
+            PDFLexicalAnalyzer::Token token = parser.fetch();
+
+            if (token.type == PDFLexicalAnalyzer::TokenType::EndOfFile)
+            {
+                break;
+            }
+
+            if (token.type != PDFLexicalAnalyzer::TokenType::Command)
+            {
+                operands.push_back(qMove(token));
+                continue;
+            }
+
+            const QByteArray command = token.data.toByteArray();
+            if (command == "Tf")
+            {
+                currentFont = std::nullopt;
+
+                if (operands.size() >= 2 && operands[operands.size() - 2].type == PDFLexicalAnalyzer::TokenType::Name)
+                {
+                    if (!resources)
+                    {
+                        // Form without resources uses resources of the page, on which it is
+                        // painted, so we can't determine, which font is used.
+                        return false;
+                    }
+
+                    const QByteArray fontName = operands[operands.size() - 2].data.toByteArray();
+                    const PDFObject& fontObject = fontsDictionary ? fontsDictionary->get(fontName) : PDFObject();
+                    currentFont = getFontInfo(fontObject);
+
+                    if (!currentFont)
+                    {
+                        // Font can be a direct object, which was not examined yet
+                        const std::vector<PDFObjectReference> fontPrograms = getFontPrograms(fontObject);
+                        m_excluded.insert(fontPrograms.cbegin(), fontPrograms.cend());
+                    }
+                }
+            }
+            else if (command == "Tj" || command == "TJ" || command == "'" || command == "\"")
+            {
+                if (currentFont)
+                {
+                    PDFCIDtoGIDMapper mapper(QByteArray(currentFont->cidToGidMapping));
+                    std::set<GID>& usedGlyphs = m_glyphUsage[currentFont->fontProgram];
+
+                    for (const PDFLexicalAnalyzer::Token& operand : operands)
+                    {
+                        if (operand.type == PDFLexicalAnalyzer::TokenType::String)
+                        {
+                            // Identity encoding - character codes are 2-byte CIDs
+                            const QByteArray text = operand.data.toByteArray();
+                            for (qsizetype i = 0; i + 1 < text.size(); i += 2)
+                            {
+                                const CID cid = (CID(quint8(text[i])) << 8) | CID(quint8(text[i + 1]));
+                                usedGlyphs.insert(mapper.map(cid));
+                            }
+                        }
+                    }
+                }
+            }
+            else if (command == "BI")
+            {
+                // Skip inline image data, they can contain arbitrary binary data
+                const PDFInteger operatorIDPosition = parser.findSubstring("ID", parser.pos());
+                const PDFInteger operatorEIPosition = operatorIDPosition != -1 ? parser.findSubstring("EI", operatorIDPosition + 3) : -1;
+
+                if (operatorEIPosition == -1)
+                {
+                    return false;
+                }
+
+                parser.seek(operatorEIPosition + 2);
+            }
+
+            operands.clear();
+        }
+    }
+    catch (const PDFException&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+PDFOptimizer::PDFOptimizer(OptimizationFlags flags, QObject* parent) :
+    QObject(parent),
+    m_flags(flags)
+{
+
+}
+
+/// Graph of references between objects of the storage. For each object, it holds
+/// references, which are directly contained in the object. Graph is updated
+/// incrementally, edges are created again only for objects, which were changed
+/// since the last update (object is changed, if it doesn't share its content
+/// with the object, from which edges were created).
+class PDFObjectReferenceGraph
+{
+public:
+    explicit PDFObjectReferenceGraph() = default;
+
+    /// Updates the graph to match the objects (in parallel)
+    /// \param objects Objects
+    void update(const PDFObjectStorage::PDFObjects& objects);
+
+    /// Returns references, which are directly contained in the object
+    /// \param objectNumber Object number
+    const std::vector<PDFObjectReference>& getReferences(size_t objectNumber) const { return m_nodes[objectNumber].references; }
+
+    /// Marks objects reachable from root references. Graph must be updated to match
+    /// the objects. Each object is marked only once (mark is set atomically), objects
+    /// are marked in parallel, by levels of the breadth first search. Returned marks
+    /// are indexed by object number.
+    /// \param roots Root references
+    /// \param objects Objects
+    std::vector<std::atomic_bool> mark(const std::set<PDFObjectReference>& roots, const PDFObjectStorage::PDFObjects& objects) const;
+
+private:
+    struct Node
+    {
+        PDFObject object;   ///< Object, from which references were collected
+        std::vector<PDFObjectReference> references;
+    };
+
+    /// Returns true, if objects are the same (objects sharing the content
+    /// are the same, simple objects without references are always the same)
+    static bool isSameObject(const PDFObject& left, const PDFObject& right);
+
+    std::vector<Node> m_nodes;
+};
+
+void PDFObjectReferenceGraph::update(const PDFObjectStorage::PDFObjects& objects)
+{
+    m_nodes.resize(objects.size());
+
+    auto updateNode = [this, &objects](size_t index)
+    {
+        Node& node = m_nodes[index];
+        const PDFObject& object = objects[index].object;
+
+        if (!isSameObject(node.object, object))
+        {
+            std::set<PDFObjectReference> references = PDFObjectUtils::getDirectReferences(object);
+            node.object = object;
+            node.references.assign(references.cbegin(), references.cend());
+        }
+    };
+
+    PDFIntegerRange<size_t> range(0, objects.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), updateNode);
+}
+
+std::vector<std::atomic_bool> PDFObjectReferenceGraph::mark(const std::set<PDFObjectReference>& roots, const PDFObjectStorage::PDFObjects& objects) const
+{
+    Q_ASSERT(m_nodes.size() == objects.size());
+
+    const size_t objectCount = m_nodes.size();
+    std::vector<std::atomic_bool> marks(objectCount);
+
+    // Marks the object, returns true, if object was marked by this call
+    auto markObject = [&marks, &objects, objectCount](PDFObjectReference reference)
+    {
+        return reference.objectNumber >= 0 &&
+               reference.objectNumber < PDFInteger(objectCount) &&
+               objects[reference.objectNumber].generation == reference.generation &&
+               !marks[reference.objectNumber].exchange(true, std::memory_order_relaxed);
+    };
+
+    std::vector<size_t> frontier;
+    for (const PDFObjectReference& reference : roots)
+    {
+        if (markObject(reference))
+        {
+            frontier.push_back(size_t(reference.objectNumber));
+        }
+    }
+
+    QMutex mutex;
+    while (!frontier.empty())
+    {
+        std::vector<size_t> nextFrontier;
+
+        auto processObject = [this, &markObject, &mutex, &nextFrontier](size_t objectNumber)
+        {
+            std::vector<size_t> markedObjects;
+            for (const PDFObjectReference& reference : m_nodes[objectNumber].references)
+            {
+                if (markObject(reference))
+                {
+                    markedObjects.push_back(size_t(reference.objectNumber));
+                }
+            }
+
+            if (!markedObjects.empty())
+            {
+                QMutexLocker lock(&mutex);
+                nextFrontier.insert(nextFrontier.end(), markedObjects.cbegin(), markedObjects.cend());
+            }
+        };
+
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, frontier.cbegin(), frontier.cend(), processObject);
+        frontier = qMove(nextFrontier);
+    }
+
+    return marks;
+}
+
+bool PDFObjectReferenceGraph::isSameObject(const PDFObject& left, const PDFObject& right)
+{
+    if (left.getType() != right.getType())
+    {
+        return false;
+    }
+
+    switch (left.getType())
+    {
+        case PDFObject::Type::Array:
+            return left.getArray() == right.getArray();
+
+        case PDFObject::Type::Dictionary:
+            return left.getDictionary() == right.getDictionary();
+
+        case PDFObject::Type::Stream:
+            return left.getStream() == right.getStream();
+
+        case PDFObject::Type::Reference:
+            return left.getReference() == right.getReference();
+
+        default:
+            // Simple objects don't contain references
+            return true;
+    }
+}
+
+void PDFOptimizer::optimize()
+{
+    // Jakub Melka: We divide optimization into stages, each
+    // stage can consist from multiple passes.
+    constexpr OptimizationFlags stages[] = { OptimizationFlags(DereferenceSimpleObjects),
+                                             OptimizationFlags(RemoveNullObjects),
+                                             OptimizationFlags(MergeIdenticalImages | MergeIdenticalFonts),
+                                             OptimizationFlags(RemoveUnusedObjects | MergeIdenticalObjects),
+                                             OptimizationFlags(DownsampleImages | RecompressImagesToJPEG | CompressBilevelImages | SubsetFonts | OptimizeContentStreams),
+                                             OptimizationFlags(ShrinkObjectStorage),
+                                             OptimizationFlags(RecompressFlateStreams) };
+
+    int stage = 1;
+
+    Q_EMIT optimizationStarted();
+    for (OptimizationFlags flags : stages)
+    {
+        Q_EMIT optimizationProgress(tr("Stage %1").arg(stage++));
+        OptimizationFlags currentSteps = flags & m_flags;
+
+        int passIndex = 1;
+
+        bool pass = true;
+        while (pass)
+        {
+            Q_EMIT optimizationProgress(tr("Pass %1").arg(passIndex++));
+            pass = false;
+
+            if (currentSteps.testFlag(DereferenceSimpleObjects))
+            {
+                pass = performDereferenceSimpleObjects() || pass;
+            }
+            if (currentSteps.testFlag(RemoveNullObjects))
+            {
+                pass = performRemoveNullObjects() || pass;
+            }
+            if (currentSteps.testFlag(MergeIdenticalImages))
+            {
+                pass = performMergeIdenticalImages() || pass;
+            }
+            if (currentSteps.testFlag(MergeIdenticalFonts))
+            {
+                pass = performMergeIdenticalFonts() || pass;
+            }
+            if (currentSteps.testFlag(RemoveUnusedObjects))
+            {
+                pass = performRemoveUnusedObjects() || pass;
+            }
+            if (currentSteps.testFlag(MergeIdenticalObjects))
+            {
+                pass = performMergeIdenticalObjects() || pass;
+            }
+            if (currentSteps & (DownsampleImages | RecompressImagesToJPEG | CompressBilevelImages))
+            {
+                pass = performOptimizeImages(currentSteps) || pass;
+            }
+            if (currentSteps.testFlag(OptimizeContentStreams))
+            {
+                pass = performOptimizeContentStreams() || pass;
+            }
+            if (currentSteps.testFlag(SubsetFonts))
+            {
+                pass = performSubsetFonts() || pass;
+            }
+            if (currentSteps.testFlag(ShrinkObjectStorage))
+            {
+                pass = performShrinkObjectStorage() || pass;
+            }
+            if (currentSteps.testFlag(RecompressFlateStreams))
+            {
+                pass = performRecompressFlateStreams() || pass;
+            }
+        }
+    }
+    Q_EMIT optimizationFinished();
+}
+
+PDFOptimizer::OptimizationFlags PDFOptimizer::getFlags() const
+{
+    return m_flags;
+}
+
+void PDFOptimizer::setFlags(OptimizationFlags flags)
+{
+    m_flags = flags;
+}
+
+bool PDFOptimizer::performDereferenceSimpleObjects()
+{
+    std::atomic<PDFInteger> counter = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
+    {
+        PDFRemoveSimpleObjectsVisitor visitor(&m_storage, &counter);
+        entry.object.accept(&visitor);
+        entry.object = visitor.getObject();
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Simple objects dereferenced and embedded: %1").arg(counter));
+
+    return false;
+}
+
+bool PDFOptimizer::performRemoveNullObjects()
+{
+    std::atomic<PDFInteger> counter = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
+    {
+        PDFRemoveNullDictionaryEntriesVisitor visitor(&m_storage, &counter);
+        entry.object.accept(&visitor);
+        entry.object = visitor.getObject();
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Null objects entries from dictionaries removed: %1").arg(counter));
+
+    return false;
+}
+
+bool PDFOptimizer::performRemoveUnusedObjects()
+{
+    PDFObjectReferenceGraph* referenceGraph = getReferenceGraph();
+    const PDFObjectStorage::PDFObjects& objects = m_storage.getObjects();
+
+    // Mark phase - find objects reachable from the trailer dictionary
+    std::set<PDFObjectReference> roots = PDFObjectUtils::getDirectReferences(m_storage.getTrailerDictionary());
+    std::vector<std::atomic_bool> marks = referenceGraph->mark(roots, objects);
+
+    std::vector<PDFObjectReference> unusedObjects;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (!marks[i] && !objects[i].object.isNull())
+        {
+            unusedObjects.emplace_back(PDFInteger(i), objects[i].generation);
+        }
+    }
+
+    // Sweep phase - unused objects are removed in place, we do not
+    // copy the object array (objects are no longer valid after this).
+    for (const PDFObjectReference& reference : unusedObjects)
+    {
+        m_storage.setObject(reference, PDFObject());
+    }
+
+    const PDFInteger counter = static_cast<PDFInteger>(unusedObjects.size());
+    Q_EMIT optimizationProgress(tr("Unused objects removed: %1").arg(counter));
+
+    return counter > 0;
+}
+
+bool PDFOptimizer::performMergeIdenticalObjects()
+{
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+
+    PDFIdenticalObjectsMerger merger(&m_storage, objects);
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap = merger.merge();
+    const PDFInteger counter = static_cast<PDFInteger>(replacementMap.size());
+
+    // Replace objects. Only objects containing replaced references are changed,
+    // so edges of other objects in the reference graph remain valid.
+    if (!replacementMap.empty())
+    {
+        PDFObjectReferenceGraph* referenceGraph = getReferenceGraph();
+
+        PDFIntegerRange<size_t> range(0, objects.size());
+        auto processEntry = [&objects, &replacementMap, referenceGraph](size_t index)
+        {
+            const std::vector<PDFObjectReference>& references = referenceGraph->getReferences(index);
+            auto isReplaced = [&replacementMap](const PDFObjectReference& reference) { return replacementMap.count(reference) > 0; };
+
+            if (std::any_of(references.cbegin(), references.cend(), isReplaced))
+            {
+                objects[index].object = PDFObjectUtils::replaceReferences(objects[index].object, replacementMap);
+            }
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
+
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Identical objects merged: %1").arg(counter));
+
+    return counter > 0;
+}
+
+PDFObjectReferenceGraph* PDFOptimizer::getReferenceGraph()
+{
+    if (!m_referenceGraph)
+    {
+        m_referenceGraph = std::make_shared<PDFObjectReferenceGraph>();
+    }
+
+    // Only edges of objects changed by other passes are created again
+    m_referenceGraph->update(m_storage.getObjects());
+    return m_referenceGraph.get();
+}
+
+bool PDFOptimizer::performShrinkObjectStorage()
+{
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+
+    auto isFree = [](const PDFObjectStorage::Entry& entry)
+    {
+        return entry.object.isNull() && entry.generation < PDF_MAX_OBJECT_GENERATION;
+    };
+    auto isOccupied = [](const PDFObjectStorage::Entry& entry)
+    {
+        return !entry.object.isNull();
+    };
+
+    // Make list of free usable indices
+    std::vector<size_t> freeIndices;
+    freeIndices.reserve(objects.size() / 8);
+
+    const size_t objectCount = objects.size();
+    for (size_t sourceIndex = 1; sourceIndex < objectCount; ++sourceIndex)
+    {
+        if (isFree(objects[sourceIndex]))
+        {
+            freeIndices.push_back(sourceIndex);
+        }
+    }
+    std::reverse(freeIndices.begin(), freeIndices.end());
+
+    // Move objects to free entries
+    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    {
+        if (freeIndices.empty())
+        {
+            // Jakub Melka: We have run out of free indices
+            break;
+        }
+
+        PDFObjectStorage::Entry& sourceEntry = objects[sourceIndex];
+        if (isOccupied(sourceEntry))
+        {
+            size_t targetIndex = freeIndices.back();
+            freeIndices.pop_back();
+
+            if (targetIndex >= sourceIndex)
+            {
+                break;
+            }
+
+            PDFObjectStorage::Entry& targetEntry = objects[targetIndex];
+            Q_ASSERT(isFree(targetEntry));
+
+            ++targetEntry.generation;
+            targetEntry.object = qMove(sourceEntry.object);
+            sourceEntry.object = PDFObject();
+
+            replacementMap[PDFObjectReference(PDFInteger(sourceIndex), sourceEntry.generation)] = PDFObjectReference(PDFInteger(targetIndex), targetEntry.generation);
+        }
+    }
+
+    // Shrink objects array
+    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    {
+        if (isOccupied(objects[sourceIndex]))
+        {
+            objects.resize(sourceIndex + 1);
+            break;
+        }
+    }
+
+    // Update objects
+    if (!replacementMap.empty())
+    {
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+        }
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+
+        PDFObjectFactory factory;
+        factory.beginDictionary();
+        factory.beginDictionaryItem("Size");
+        factory << PDFInteger(objects.size());
+        factory.endDictionaryItem();
+        factory.endDictionary();
+
+        trailerDictionary = PDFObjectManipulator::merge(trailerDictionary, factory.takeObject(), PDFObjectManipulator::NoFlag);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    const size_t newObjectCount = objects.size();
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Object list shrinked by: %1").arg(objectCount - newObjectCount));
+
+    return false;
+}
+
+bool PDFOptimizer::performRecompressFlateStreams()
+{
+    std::atomic<PDFInteger> bytesSaved = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    auto processEntry = [this, &bytesSaved](PDFObjectStorage::Entry& entry)
     {
         if (entry.object.isStream())
         {
@@ -462,4 +1844,504 @@ bool PDFOptimizer::performRecompressFlateStreams()
     return false;
 }
 
+bool PDFOptimizer::performMergeIdenticalImages()
+{
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    PDFDocument document(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+    std::set<PDFObjectReference> softMasks = PDFOptimizerImageHelper::getSoftMasks(objects);
+
+    auto decodeImage = [&document, &objects, &softMasks](size_t index)
+    {
+        const PDFObjectReference reference(PDFInteger(index), objects[index].generation);
+        return PDFOptimizerImageHelper::decodeImage(&document, objects[index].object.getStream(), softMasks.count(reference));
+    };
+
+    // Decoding of the images is the most time consuming part, so we compute
+    // hashes of decoded samples in parallel.
+    std::vector<std::optional<PDFOptimizerImageHelper::Hash>> hashes(objects.size());
+    PDFIntegerRange<size_t> range(0, objects.size());
+    auto computeHash = [&objects, &hashes, &decodeImage](size_t index)
+    {
+        if (PDFOptimizerImageHelper::isImage(objects[index].object))
+        {
+            std::optional<PDFImage> pdfImage = decodeImage(index);
+            if (pdfImage && pdfImage->getImageData().isValid())
+            {
+                hashes[index] = PDFOptimizerImageHelper::getHash(pdfImage->getImageData());
+            }
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), computeHash);
+
+    // Soft masks are processed first, so images with identical soft masks
+    // can be merged in the same pass.
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    std::map<PDFOptimizerImageHelper::Hash, std::vector<size_t>> candidates;
+
+    auto isSameImage = [&](size_t left, size_t right)
+    {
+        const PDFDictionary* leftDictionary = objects[left].object.getStream()->getDictionary();
+        const PDFDictionary* rightDictionary = objects[right].object.getStream()->getDictionary();
+        PDFObject leftObject = PDFObjectUtils::replaceReferences(PDFOptimizerImageHelper::getDictionaryWithoutEncoding(leftDictionary), replacementMap);
+        PDFObject rightObject = PDFObjectUtils::replaceReferences(PDFOptimizerImageHelper::getDictionaryWithoutEncoding(rightDictionary), replacementMap);
+
+        if (leftObject != rightObject)
+        {
+            return false;
+        }
+
+        // Hashes are equal, check decoded samples, so hash collision never causes merging of different images
+        std::optional<PDFImage> leftImage = decodeImage(left);
+        std::optional<PDFImage> rightImage = decodeImage(right);
+        return leftImage && rightImage &&
+               leftImage->getImageData().getComponents() == rightImage->getImageData().getComponents() &&
+               leftImage->getImageData().getBitsPerComponent() == rightImage->getImageData().getBitsPerComponent() &&
+               PDFOptimizerImageHelper::getPackedSamples(leftImage->getImageData()) == PDFOptimizerImageHelper::getPackedSamples(rightImage->getImageData());
+    };
+
+    for (const bool processSoftMasks : { true, false })
+    {
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            const PDFObjectReference reference(PDFInteger(i), objects[i].generation);
+            if (!hashes[i] || softMasks.count(reference) != size_t(processSoftMasks))
+            {
+                continue;
+            }
+
+            std::vector<size_t>& indices = candidates[*hashes[i]];
+            auto it = std::find_if(indices.cbegin(), indices.cend(), [&isSameImage, i](size_t index) { return isSameImage(index, i); });
+            if (it != indices.cend())
+            {
+                replacementMap[reference] = PDFObjectReference(PDFInteger(*it), objects[*it].generation);
+            }
+            else
+            {
+                indices.push_back(i);
+            }
+        }
+    }
+
+    const PDFInteger counter = static_cast<PDFInteger>(replacementMap.size());
+
+    // Replace images, replaced images will be removed as unused objects
+    if (!replacementMap.empty())
+    {
+        auto processEntry = [&objects, &replacementMap](size_t index)
+        {
+            objects[index].object = PDFObjectUtils::replaceReferences(objects[index].object, replacementMap);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
+
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Identical images merged: %1").arg(counter));
+
+    return false;
+}
+
+bool PDFOptimizer::performOptimizeImages(OptimizationFlags flags)
+{
+    std::atomic<PDFInteger> downsampledCounter = 0;
+    std::atomic<PDFInteger> recompressedCounter = 0;
+    std::atomic<PDFInteger> bytesSaved = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    PDFDocument document(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+    std::set<PDFObjectReference> softMasks = PDFOptimizerImageHelper::getSoftMasks(objects);
+
+    std::map<PDFObjectReference, QSizeF> placements;
+    if (flags.testFlag(DownsampleImages))
+    {
+        placements = PDFOptimizerImageHelper::getImagePlacements(&document, objects);
+    }
+
+    PDFIntegerRange<size_t> range(0, objects.size());
+    auto processEntry = [&, this](size_t index)
+    {
+        PDFObjectStorage::Entry& entry = objects[index];
+        if (!PDFOptimizerImageHelper::isImage(entry.object))
+        {
+            return;
+        }
+
+        const PDFStream* stream = entry.object.getStream();
+        const PDFDictionary* dictionary = stream->getDictionary();
+        const PDFObjectReference reference(PDFInteger(index), entry.generation);
+        const bool isSoftMask = softMasks.count(reference);
+
+        if (!PDFOptimizerImageHelper::canBeReencoded(&document, stream))
+        {
+            return;
+        }
+
+        std::optional<PDFImage> pdfImage = PDFOptimizerImageHelper::decodeImage(&document, stream, isSoftMask);
+        if (!pdfImage || (pdfImage->getColorSpace() && pdfImage->getColorSpace()->getColorSpace() == PDFAbstractColorSpace::ColorSpace::Indexed))
+        {
+            // Indices of indexed color space can't be interpolated
+            return;
+        }
+
+        QImage image = PDFOptimizerImageHelper::createImage(pdfImage->getImageData());
+        if (image.isNull())
+        {
+            return;
+        }
+
+        const bool isBilevel = flags.testFlag(CompressBilevelImages) && !isSoftMask && PDFOptimizerImageHelper::isBilevel(image);
+        const bool isJPEG = PDFOptimizerImageHelper::getFilterName(&document, dictionary) == "DCTDecode";
+
+        bool isDownsampled = false;
+        auto it = placements.find(reference);
+        if (it != placements.cend() && !it->second.isEmpty())
+        {
+            const QSizeF placedSize = it->second;
+            const PDFReal resolution = qMax(image.width() / placedSize.width(), image.height() / placedSize.height());
+            if (resolution > m_imageSettings.thresholdDpi)
+            {
+                const int width = qBound(1, qCeil(placedSize.width() * m_imageSettings.targetDpi), image.width());
+                const int height = qBound(1, qCeil(placedSize.height() * m_imageSettings.targetDpi), image.height());
+
+                if (width < image.width() || height < image.height())
+                {
+                    // Bilevel images must remain bilevel, so we do not use smooth transformation
+                    image = image.scaled(width, height, Qt::IgnoreAspectRatio, isBilevel ? Qt::FastTransformation : Qt::SmoothTransformation);
+                    isDownsampled = true;
+                }
+            }
+        }
+
+        const bool isRecompressedToJPEG = !isSoftMask && !isBilevel &&
+                                          (flags.testFlag(RecompressImagesToJPEG) ? PDFOptimizerImageHelper::isPhotographic(image) : isDownsampled && isJPEG);
+
+        if (!isDownsampled && !isBilevel && !isRecompressedToJPEG)
+        {
+            // Nothing to do with this image
+            return;
+        }
+
+        QByteArray data;
+        QByteArray filter;
+        int bitsPerComponent = 8;
+
+        try
+        {
+            if (isBilevel)
+            {
+                data = PDFFlateDecodeFilter::compress(PDFOptimizerImageHelper::getBilevelSamples(image));
+                filter = "FlateDecode";
+                bitsPerComponent = 1;
+            }
+            else if (isRecompressedToJPEG)
+            {
+                data = PDFImage::encodeJPEG(image, m_imageSettings.jpegQuality);
+                filter = "DCTDecode";
+            }
+            else
+            {
+                data = PDFFlateDecodeFilter::compress(PDFOptimizerImageHelper::getPackedSamples(image));
+                filter = "FlateDecode";
+            }
+        }
+        catch (const PDFException&)
+        {
+            return;
+        }
+
+        const PDFInteger currentBytesSaved = stream->getContent()->size() - data.size();
+        if (currentBytesSaved <= 0)
+        {
+            // Original image is smaller, keep it
+            return;
+        }
+
+        PDFDictionary updatedDictionary = *dictionary;
+        updatedDictionary.removeEntry("DecodeParms");
+        updatedDictionary.removeEntry("DL");
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("Width"), PDFObject::createInteger(image.width()));
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("Height"), PDFObject::createInteger(image.height()));
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("BitsPerComponent"), PDFObject::createInteger(bitsPerComponent));
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName(filter));
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(data.size()));
+        entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(data)));
+
+        bytesSaved += currentBytesSaved;
+        if (isDownsampled)
+        {
+            ++downsampledCounter;
+        }
+        else
+        {
+            ++recompressedCounter;
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Images downsampled: %1, images recompressed: %2, bytes saved: %3").arg(downsampledCounter).arg(recompressedCounter).arg(bytesSaved));
+
+    return false;
+}
+
+bool PDFOptimizer::performMergeIdenticalFonts()
+{
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    PDFDocument document(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+
+    // Find embedded font programs
+    std::vector<size_t> fontPrograms;
+    std::vector<bool> isFontProgram(objects.size(), false);
+    for (const PDFObjectStorage::Entry& entry : objects)
+    {
+        const PDFDictionary* dictionary = document.getDictionaryFromObject(entry.object);
+        if (!dictionary || entry.object.isStream())
+        {
+            continue;
+        }
+
+        for (const char* key : { "FontFile", "FontFile2", "FontFile3" })
+        {
+            const PDFObject& fontFile = dictionary->get(key);
+            if (fontFile.isReference() &&
+                fontFile.getReference().objectNumber >= 0 &&
+                fontFile.getReference().objectNumber < PDFInteger(objects.size()) &&
+                objects[fontFile.getReference().objectNumber].generation == fontFile.getReference().generation &&
+                objects[fontFile.getReference().objectNumber].object.isStream() &&
+                !isFontProgram[fontFile.getReference().objectNumber])
+            {
+                isFontProgram[fontFile.getReference().objectNumber] = true;
+                fontPrograms.push_back(fontFile.getReference().objectNumber);
+            }
+        }
+    }
+    std::sort(fontPrograms.begin(), fontPrograms.end());
+
+    // Font programs are often compressed differently in different source documents,
+    // so we compare decoded data. Decoding is done in parallel.
+    std::vector<QByteArray> decodedData(fontPrograms.size());
+    PDFIntegerRange<size_t> range(0, fontPrograms.size());
+    auto decodeFontProgram = [&](size_t index)
+    {
+        decodedData[index] = document.getDecodedStream(objects[fontPrograms[index]].object.getStream());
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), decodeFontProgram);
+
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    std::map<PDFOptimizerImageHelper::Hash, std::vector<size_t>> candidates;
+    for (size_t i = 0; i < fontPrograms.size(); ++i)
+    {
+        const QByteArray& data = decodedData[i];
+        if (data.isEmpty())
+        {
+            continue;
+        }
+
+        const PDFOptimizerImageHelper::Hash hash(qHashBits(data.constData(), data.size(), 0x9E3779B9U), qHashBits(data.constData(), data.size(), 0x85EBCA6BU));
+        const PDFObject dictionary = PDFOptimizerImageHelper::getDictionaryWithoutEncoding(objects[fontPrograms[i]].object.getStream()->getDictionary());
+
+        std::vector<size_t>& indices = candidates[hash];
+        auto isSameFontProgram = [&](size_t index)
+        {
+            return decodedData[index] == data && PDFOptimizerImageHelper::getDictionaryWithoutEncoding(objects[fontPrograms[index]].object.getStream()->getDictionary()) == dictionary;
+        };
+
+        auto it = std::find_if(indices.cbegin(), indices.cend(), isSameFontProgram);
+        if (it != indices.cend())
+        {
+            const size_t representative = fontPrograms[*it];
+            replacementMap[PDFObjectReference(PDFInteger(fontPrograms[i]), objects[fontPrograms[i]].generation)] = PDFObjectReference(PDFInteger(representative), objects[representative].generation);
+        }
+        else
+        {
+            indices.push_back(i);
+        }
+    }
+
+    const PDFInteger counter = static_cast<PDFInteger>(replacementMap.size());
+
+    // Replace font programs, font descriptors and fonts referring to the same
+    // font program are then merged by merging of identical objects.
+    if (!replacementMap.empty())
+    {
+        PDFIntegerRange<size_t> objectRange(0, objects.size());
+        auto processEntry = [&objects, &replacementMap](size_t index)
+        {
+            objects[index].object = PDFObjectUtils::replaceReferences(objects[index].object, replacementMap);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectRange.begin(), objectRange.end(), processEntry);
+
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Identical font programs merged: %1").arg(counter));
+
+    return false;
+}
+
+bool PDFOptimizer::performSubsetFonts()
+{
+    std::atomic<PDFInteger> counter = 0;
+    std::atomic<PDFInteger> bytesSaved = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    PDFDocument document(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+
+    PDFFontGlyphUsageCollector collector(&document);
+    if (!collector.collect(objects))
+    {
+        Q_EMIT optimizationProgress(tr("Fonts can't be subset, glyph usage can't be determined."));
+        return false;
+    }
+
+    const std::map<PDFObjectReference, std::set<GID>> fontPrograms = collector.getSubsettableFontPrograms();
+    auto processFontProgram = [&](const std::pair<const PDFObjectReference, std::set<GID>>& item)
+    {
+        const PDFObjectReference reference = item.first;
+        if (reference.objectNumber < 0 ||
+            reference.objectNumber >= PDFInteger(objects.size()) ||
+            objects[reference.objectNumber].generation != reference.generation ||
+            !objects[reference.objectNumber].object.isStream())
+        {
+            return;
+        }
+
+        PDFObjectStorage::Entry& entry = objects[reference.objectNumber];
+        const PDFStream* stream = entry.object.getStream();
+
+        try
+        {
+            PDFTrueTypeFontSubsetter subsetter(document.getDecodedStream(stream));
+            QByteArray fontData = subsetter.subset(item.second);
+            QByteArray compressedData = PDFFlateDecodeFilter::compress(fontData);
+
+            const PDFInteger currentBytesSaved = stream->getContent()->size() - compressedData.size();
+            if (currentBytesSaved <= 0)
+            {
+                return;
+            }
+
+            PDFDictionary updatedDictionary = *stream->getDictionary();
+            updatedDictionary.removeEntry("DecodeParms");
+            updatedDictionary.removeEntry("DL");
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length1"), PDFObject::createInteger(fontData.size()));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(compressedData.size()));
+            entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(compressedData)));
+
+            bytesSaved += currentBytesSaved;
+            ++counter;
+        }
+        catch (const PDFException&)
+        {
+            // Font program is invalid, or it is not a TrueType font, keep it
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, fontPrograms.cbegin(), fontPrograms.cend(), processFontProgram);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Fonts subset: %1, bytes saved: %2").arg(counter).arg(bytesSaved));
+
+    return false;
+}
+
+bool PDFOptimizer::performOptimizeContentStreams()
+{
+    std::atomic<PDFInteger> counter = 0;
+    std::atomic<PDFInteger> bytesSaved = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    PDFDocument document(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+
+    // Collect content streams of pages, forms (including appearance streams) and tiling patterns.
+    // Each stream of the page content array is optimized separately.
+    std::set<PDFInteger> contentStreams;
+    auto addContentStream = [&contentStreams, &objects](const PDFObject& object)
+    {
+        if (object.isReference())
+        {
+            const PDFObjectReference reference = object.getReference();
+            if (reference.objectNumber >= 0 &&
+                reference.objectNumber < PDFInteger(objects.size()) &&
+                objects[reference.objectNumber].generation == reference.generation &&
+                objects[reference.objectNumber].object.isStream())
+            {
+                contentStreams.insert(reference.objectNumber);
+            }
+        }
+    };
+
+    const PDFCatalog* catalog = document.getCatalog();
+    for (size_t i = 0, pageCount = catalog->getPageCount(); i < pageCount; ++i)
+    {
+        const PDFObject& contents = catalog->getPage(i)->getContents();
+        addContentStream(contents);
+
+        const PDFObject& contentsObject = document.getObject(contents);
+        if (contentsObject.isArray())
+        {
+            const PDFArray* array = contentsObject.getArray();
+            for (size_t j = 0; j < array->getCount(); ++j)
+            {
+                addContentStream(array->getItem(j));
+            }
+        }
+    }
+
+    PDFDocumentDataLoaderDecorator loader(&document);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (objects[i].object.isStream())
+        {
+            const PDFDictionary* dictionary = objects[i].object.getStream()->getDictionary();
+            if (loader.readNameFromDictionary(dictionary, "Subtype") == "Form" || loader.readIntegerFromDictionary(dictionary, "PatternType", 0) == 1)
+            {
+                contentStreams.insert(PDFInteger(i));
+            }
+        }
+    }
+
+    PDFContentStreamOptimizer optimizer(m_contentStreamPrecision);
+    auto processContentStream = [&](PDFInteger index)
+    {
+        PDFObjectStorage::Entry& entry = objects[index];
+        const PDFStream* stream = entry.object.getStream();
+
+        if (stream->getDictionary()->hasKey("F"))
+        {
+            // External file stream, we do not optimize it
+            return;
+        }
+
+        QByteArray content = optimizer.optimize(document.getDecodedStream(stream));
+        QByteArray compressedData = PDFFlateDecodeFilter::compress(content);
+
+        const PDFInteger currentBytesSaved = stream->getContent()->size() - compressedData.size();
+        if (currentBytesSaved <= 0)
+        {
+            return;
+        }
+
+        PDFDictionary updatedDictionary = *stream->getDictionary();
+        updatedDictionary.removeEntry("DecodeParms");
+        updatedDictionary.removeEntry("DL");
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+        updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(compressedData.size()));
+        entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(compressedData)));
+
+        bytesSaved += currentBytesSaved;
+        ++counter;
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, contentStreams.cbegin(), contentStreams.cend(), processContentStream);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Content streams optimized: %1, bytes saved: %2").arg(counter).arg(bytesSaved));
+
+    return false;
+}
+
 }   // namespace pdf
@@ -22,8 +22,11 @@
 
 #include <QObject>
 
+#include <memory>
+
 namespace pdf
 {
+class PDFObjectReferenceGraph;
 
 /// Class for optimalizing documents. Can examine object structure and it's dependencies,
 /// and remove unused objects, merge same objects, or even recompress some streams
@@ -44,10 +47,25 @@ public:
         MergeIdenticalObjects       = 0x0008, ///< Merge identical objects
         ShrinkObjectStorage         = 0x0010, ///< Shrink object storage, so unused objects are filled with used (and generation number increased)
         RecompressFlateStreams      = 0x0020, ///< Flate streams are recompressed with maximal compression
+        DownsampleImages            = 0x0040, ///< Images above threshold resolution (given by their placement on pages) are downsampled to the target resolution
+        RecompressImagesToJPEG      = 0x0080, ///< Photographic images are recompressed to JPEG with given quality (if it is smaller)
+        CompressBilevelImages       = 0x0100, ///< Images containing only black and white pixels are stored as 1-bit images
+        MergeIdenticalImages        = 0x0200, ///< Images with identical decoded pixels are merged, even if they are encoded differently
+        MergeIdenticalFonts         = 0x0400, ///< Embedded font programs with identical decoded data are merged, even if they are encoded differently
+        SubsetFonts                 = 0x0800, ///< Embedded TrueType font programs are subset to the glyphs used in the document
+        OptimizeContentStreams      = 0x1000, ///< Content streams are rewritten to the smaller equivalent form
         All                         = 0xFFFF, ///< All optimizations turned on
     };
     Q_DECLARE_FLAGS(OptimizationFlags, OptimizationFlag)
 
+    /// Settings of the image optimization passes
+    struct ImageSettings
+    {
+        PDFReal targetDpi = 150.0;      ///< Resolution, to which images are downsampled
+        PDFReal thresholdDpi = 225.0;   ///< Only images with resolution above this threshold are downsampled
+        int jpegQuality = 80;           ///< Quality of JPEG images (1-100)
+    };
+
     explicit PDFOptimizer(OptimizationFlags flags, QObject* parent);
 
     /// Set document, which should be optimalized
@@ -75,6 +93,14 @@ public:
     OptimizationFlags getFlags() const;
     void setFlags(OptimizationFlags flags);
 
+    const ImageSettings& getImageSettings() const { return m_imageSettings; }
+    void setImageSettings(const ImageSettings& imageSettings) { m_imageSettings = imageSettings; }
+
+    /// Returns number of decimal places, to which real numbers
+    /// in content streams are rounded.
+    int getContentStreamPrecision() const { return m_contentStreamPrecision; }
+    void setContentStreamPrecision(int contentStreamPrecision) { m_contentStreamPrecision = contentStreamPrecision; }
+
 signals:
     void optimizationStarted();
     void optimizationProgress(QString progressText);
@@ -87,9 +113,23 @@ private:
     bool performMergeIdenticalObjects();
     bool performShrinkObjectStorage();
     bool performRecompressFlateStreams();
+    bool performMergeIdenticalImages();
+    bool performOptimizeImages(OptimizationFlags flags);
+    bool performMergeIdenticalFonts();
+    bool performSubsetFonts();
+    bool performOptimizeContentStreams();
+
+    /// Returns graph of references between objects, which is
+    /// updated to match current objects of the storage.
+    PDFObjectReferenceGraph* getReferenceGraph();
 
     OptimizationFlags m_flags;
+    ImageSettings m_imageSettings;
+    int m_contentStreamPrecision = 3;
     PDFObjectStorage m_storage;
+
+    /// Graph of references between objects, it is reused between passes
+    std::shared_ptr<PDFObjectReferenceGraph> m_referenceGraph;
 };
 
 }   // namespace pdf
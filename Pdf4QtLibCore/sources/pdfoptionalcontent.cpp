@@ -382,6 +382,9 @@ void PDFOptionalContentActivity::setDocument(const PDFDocument* document)
         Q_ASSERT(document);
         m_document = document;
         m_properties = document->getCatalog()->getOptionalContentProperties();
+
+        QMutexLocker lock(&m_membershipCacheMutex);
+        m_membershipCache.clear();
     }
 }
 
@@ -407,6 +410,7 @@ void PDFOptionalContentActivity::setState(PDFObjectReference ocg, OCState state,
         }
 
         it->second = state;
+        invalidateMembershipStates();
         Q_EMIT optionalContentGroupStateChanged(ocg, state);
     }
 }
@@ -465,6 +469,58 @@ void PDFOptionalContentActivity::applyConfiguration(const PDFOptionalContentConf
             }
         }
     }
+
+    invalidateMembershipStates();
+}
+
+OCState PDFOptionalContentActivity::getVisibilityState(PDFObjectReference ocgOrOcmd, QString* errorMessage) const
+{
+    if (m_properties->hasOptionalContentGroup(ocgOrOcmd))
+    {
+        // Simplest case - we have single optional content group
+        return getState(ocgOrOcmd);
+    }
+
+    QMutexLocker lock(&m_membershipCacheMutex);
+
+    auto it = m_membershipCache.find(ocgOrOcmd);
+    if (it == m_membershipCache.cend())
+    {
+        MembershipCacheEntry entry;
+        try
+        {
+            entry.membership = PDFOptionalContentMembershipObject::create(m_document, PDFObject::createReference(ocgOrOcmd));
+        }
+        catch (const PDFException &e)
+        {
+            entry.errorMessage = e.getMessage();
+        }
+
+        it = m_membershipCache.emplace(ocgOrOcmd, qMove(entry)).first;
+    }
+
+    MembershipCacheEntry& entry = it->second;
+    if (!entry.isEvaluated)
+    {
+        entry.state = entry.membership.isValid() ? entry.membership.evaluate(this) : OCState::Unknown;
+        entry.isEvaluated = true;
+    }
+
+    if (errorMessage)
+    {
+        *errorMessage = entry.errorMessage;
+    }
+
+    return entry.state;
+}
+
+void PDFOptionalContentActivity::invalidateMembershipStates()
+{
+    QMutexLocker lock(&m_membershipCacheMutex);
+    for (auto& item : m_membershipCache)
+    {
+        item.second.isEvaluated = false;
+    }
 }
 
 PDFOptionalContentMembershipObject PDFOptionalContentMembershipObject::create(const PDFDocument* document, const PDFObject& object)
@@ -21,6 +21,10 @@
 
 #include "pdfobject.h"
 
+#include <QMutex>
+
+#include <map>
+
 namespace pdf
 {
 
@@ -190,14 +194,38 @@ public:
     /// Returns the properties of optional content
     const PDFOptionalContentProperties* getProperties() const { return m_properties; }
 
+    /// Returns visibility state of the optional content group, or optional content
+    /// membership dictionary. Membership dictionaries are parsed only once, their
+    /// states are evaluated only once for current states of optional content groups,
+    /// i.e. cached state is used until state of some optional content group is changed.
+    /// This function is thread safe.
+    /// \param ocgOrOcmd Optional content group or membership dictionary
+    /// \param errorMessage Error message, if membership dictionary is invalid
+    OCState getVisibilityState(PDFObjectReference ocgOrOcmd, QString* errorMessage) const;
+
 signals:
     void optionalContentGroupStateChanged(PDFObjectReference ocg, OCState state);
 
 private:
+    /// Cached membership dictionary and its evaluated state
+    struct MembershipCacheEntry
+    {
+        PDFOptionalContentMembershipObject membership;
+        QString errorMessage;
+        OCState state = OCState::Unknown;
+        bool isEvaluated = false;
+    };
+
+    /// Invalidates evaluated states of membership dictionaries
+    void invalidateMembershipStates();
+
     const PDFDocument* m_document;
     const PDFOptionalContentProperties* m_properties;
     OCUsage m_usage;
     std::map<PDFObjectReference, OCState> m_states;
+
+    mutable QMutex m_membershipCacheMutex;
+    mutable std::map<PDFObjectReference, MembershipCacheEntry> m_membershipCache;
 };
 
 /// Configuration of optional content configuration.
@@ -19,6 +19,13 @@
 #include "pdfdocument.h"
 #include "pdfexception.h"
 #include "pdfencoding.h"
+
+#include <QMutex>
+
+#include <set>
+#include <algorithm>
+#include <functional>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -26,9 +33,10 @@ namespace pdf
 
 size_t PDFOutlineItem::getTotalCount() const
 {
-    size_t count = m_children.size();
+    const size_t childCount = getChildCount();
+    size_t count = childCount;
 
-    for (size_t i = 0; i < m_children.size(); ++i)
+    for (size_t i = 0; i < childCount; ++i)
     {
         count += getChild(i)->getTotalCount();
     }
@@ -36,6 +44,85 @@ size_t PDFOutlineItem::getTotalCount() const
     return count;
 }
 
+/// Loader of the children of the outline items. It is shared by all items
+/// of the outline parsed from the document, it owns copy of the storage,
+/// and mutex protecting loading of the children.
+class PDFOutlineItemLoader
+{
+public:
+    explicit PDFOutlineItemLoader(const PDFObjectStorage& storage) :
+        m_storage(storage)
+    {
+
+    }
+
+    const PDFObjectStorage* getStorage() const { return &m_storage; }
+    QMutex* getMutex() { return &m_mutex; }
+
+private:
+    PDFObjectStorage m_storage;
+    QMutex m_mutex;
+};
+
+/// References of the ancestors of the outline item,
+/// it is used to detect cyclic dependence in the outline.
+struct PDFOutlineItemReferenceChain
+{
+    PDFObjectReference reference;
+    std::shared_ptr<const PDFOutlineItemReferenceChain> parent;
+};
+
+namespace
+{
+
+bool isInReferenceChain(const PDFOutlineItemReferenceChain* chain, PDFObjectReference reference)
+{
+    for (; chain; chain = chain->parent.get())
+    {
+        if (chain->reference == reference)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Calls the callback for each item of the list of sibling outline items, starting
+/// with the first item. Callback receives dictionary and reference of the item.
+template<typename Callback>
+void forEachOutlineItem(const PDFObjectStorage* storage,
+                        PDFObjectReference firstItem,
+                        const PDFOutlineItemReferenceChain* chain,
+                        Callback callback)
+{
+    std::set<PDFObjectReference> visitedOutlineItems;
+
+    PDFObjectReference currentItem = firstItem;
+    while (currentItem.isValid())
+    {
+        if (isInReferenceChain(chain, currentItem) || !visitedOutlineItems.insert(currentItem).second)
+        {
+            // Cyclic dependence
+            break;
+        }
+
+        PDFObject dereferencedItem = storage->getObjectByReference(currentItem);
+        if (!dereferencedItem.isDictionary())
+        {
+            break;
+        }
+
+        const PDFDictionary* dictionary = dereferencedItem.getDictionary();
+        callback(dictionary, currentItem);
+
+        const PDFObject& nextItem = dictionary->get("Next");
+        currentItem = nextItem.isReference() ? nextItem.getReference() : PDFObjectReference();
+    }
+}
+
+}   // namespace
+
 QSharedPointer<PDFOutlineItem> PDFOutlineItem::parse(const PDFObjectStorage* storage, const PDFObject& root)
 {
     const PDFObject& rootDereferenced = storage->getObject(root);
@@ -46,9 +133,13 @@ QSharedPointer<PDFOutlineItem> PDFOutlineItem::parse(const PDFObjectStorage* sto
 
         if (first.isReference())
         {
+            PDFDocumentDataLoaderDecorator loader(storage);
+
             QSharedPointer<PDFOutlineItem> result(new PDFOutlineItem());
-            std::set<PDFObjectReference> visitedOutlineItems;
-            parseImpl(storage, result.get(), first.getReference(), visitedOutlineItems);
+            result->m_loader = std::make_shared<PDFOutlineItemLoader>(*storage);
+            result->m_firstChildReference = first.getReference();
+            result->m_count = loader.readIntegerFromDictionary(dictionary, "Count", 0);
+            result->m_isChildrenLoaded = false;
             return result;
         }
     }
@@ -56,84 +147,192 @@ QSharedPointer<PDFOutlineItem> PDFOutlineItem::parse(const PDFObjectStorage* sto
     return QSharedPointer<PDFOutlineItem>();
 }
 
-void PDFOutlineItem::parseImpl(const PDFObjectStorage* storage,
-                               PDFOutlineItem* parent,
-                               PDFObjectReference currentItem,
-                               std::set<PDFObjectReference>& visitedOutlineItems)
+QSharedPointer<PDFOutlineItem> PDFOutlineItem::parseItem(const std::shared_ptr<PDFOutlineItemLoader>& loader,
+                                                         const PDFDictionary* dictionary,
+                                                         PDFObjectReference reference,
+                                                         const std::shared_ptr<const PDFOutlineItemReferenceChain>& referenceChain)
 {
-    auto checkCyclicDependence = [&visitedOutlineItems](PDFObjectReference reference)
+    const PDFObjectStorage* storage = loader->getStorage();
+
+    QSharedPointer<PDFOutlineItem> currentOutlineItem(new PDFOutlineItem());
+    const PDFObject& titleObject = storage->getObject(dictionary->get("Title"));
+    if (titleObject.isString())
     {
-        if (visitedOutlineItems.count(reference))
-        {
-            return false;
-        }
+        currentOutlineItem->setTitle(PDFEncoding::convertTextString(titleObject.getString()));
+    }
+    currentOutlineItem->setAction(PDFAction::parse(storage, dictionary->get("A")));
+    if (!currentOutlineItem->getAction() && dictionary->hasKey("Dest"))
+    {
+        currentOutlineItem->setAction(PDFActionPtr(new PDFActionGoTo(PDFDestination::parse(storage, dictionary->get("Dest")), PDFDestination())));
+    }
 
-        visitedOutlineItems.insert(reference);
-        return true;
-    };
+    PDFDocumentDataLoaderDecorator dataLoader(storage);
+    std::vector<PDFReal> colors = dataLoader.readNumberArrayFromDictionary(dictionary, "C", { 0.0, 0.0, 0.0 });
+    colors.resize(3, 0.0);
+    currentOutlineItem->setTextColor(QColor::fromRgbF(colors[0], colors[1], colors[2]));
+    PDFInteger flag = dataLoader.readIntegerFromDictionary(dictionary, "F", 0);
+    currentOutlineItem->setFontItalics(flag & 0x1);
+    currentOutlineItem->setFontBold(flag & 0x2);
+    PDFObject structureElementObject = dictionary->get("SE");
+    if (structureElementObject.isReference())
+    {
+        currentOutlineItem->setStructureElement(structureElementObject.getReference());
+    }
 
-    if (!checkCyclicDependence(currentItem))
+    // Children of this item are parsed, when they are accessed
+    const PDFObject& firstItem = dictionary->get("First");
+    if (firstItem.isReference())
+    {
+        currentOutlineItem->m_loader = loader;
+        currentOutlineItem->m_firstChildReference = firstItem.getReference();
+        currentOutlineItem->m_referenceChain = std::make_shared<const PDFOutlineItemReferenceChain>(PDFOutlineItemReferenceChain{ reference, referenceChain });
+        currentOutlineItem->m_count = dataLoader.readIntegerFromDictionary(dictionary, "Count", 0);
+        currentOutlineItem->m_isChildrenLoaded = false;
+    }
+
+    return currentOutlineItem;
+}
+
+void PDFOutlineItem::loadChildren() const
+{
+    if (!m_loader)
     {
         return;
     }
 
-    PDFObject dereferencedItem = storage->getObjectByReference(currentItem);
-    while (dereferencedItem.isDictionary())
+    QMutexLocker lock(m_loader->getMutex());
+    if (m_isChildrenLoaded)
     {
-        const PDFDictionary* dictionary = dereferencedItem.getDictionary();
+        return;
+    }
 
-        QSharedPointer<PDFOutlineItem> currentOutlineItem(new PDFOutlineItem());
-        const PDFObject& titleObject = storage->getObject(dictionary->get("Title"));
-        if (titleObject.isString())
-        {
-            currentOutlineItem->setTitle(PDFEncoding::convertTextString(titleObject.getString()));
-        }
-        currentOutlineItem->setAction(PDFAction::parse(storage, dictionary->get("A")));
-        if (!currentOutlineItem->getAction() && dictionary->hasKey("Dest"))
-        {
-            currentOutlineItem->setAction(PDFActionPtr(new PDFActionGoTo(PDFDestination::parse(storage, dictionary->get("Dest")), PDFDestination())));
-        }
+    // Absolute value of the count is number of visible descendants of the
+    // open item, so it is an upper bound of the number of the children.
+    constexpr PDFInteger MAX_RESERVED_CHILD_COUNT = 1024;
+    m_children.reserve(static_cast<size_t>(qMin(qAbs(m_count), MAX_RESERVED_CHILD_COUNT)));
 
-        PDFDocumentDataLoaderDecorator loader(storage);
-        std::vector<PDFReal> colors = loader.readNumberArrayFromDictionary(dictionary, "C", { 0.0, 0.0, 0.0 });
-        colors.resize(3, 0.0);
-        currentOutlineItem->setTextColor(QColor::fromRgbF(colors[0], colors[1], colors[2]));
-        PDFInteger flag = loader.readIntegerFromDictionary(dictionary, "F", 0);
-        currentOutlineItem->setFontItalics(flag & 0x1);
-        currentOutlineItem->setFontBold(flag & 0x2);
-        PDFObject structureElementObject = dictionary->get("SE");
-        if (structureElementObject.isReference())
-        {
-            currentOutlineItem->setStructureElement(structureElementObject.getReference());
-        }
+    auto addItem = [this](const PDFDictionary* dictionary, PDFObjectReference reference)
+    {
+        m_children.emplace_back(parseItem(m_loader, dictionary, reference, m_referenceChain));
+    };
+    forEachOutlineItem(m_loader->getStorage(), m_firstChildReference, m_referenceChain.get(), addItem);
+    m_isChildrenLoaded = true;
+}
 
-        // Parse children of this item
-        const PDFObject& firstItem = dictionary->get("First");
-        if (firstItem.isReference())
+bool PDFOutlineItem::hasChildren() const
+{
+    if (m_loader)
+    {
+        QMutexLocker lock(m_loader->getMutex());
+        if (!m_isChildrenLoaded)
         {
-            std::set<PDFObjectReference> currentVisitedOutlineItems = visitedOutlineItems;
-            parseImpl(storage, currentOutlineItem.get(), firstItem.getReference(), currentVisitedOutlineItems);
+            return m_firstChildReference.isValid();
         }
+    }
 
-        // Add new child to the parent
-        parent->addChild(qMove(currentOutlineItem));
+    return !m_children.empty();
+}
 
-        // Parse next item
-        const PDFObject& nextItem = dictionary->get("Next");
-        if (nextItem.isReference())
+bool PDFOutlineItem::isChildrenLoaded() const
+{
+    if (m_loader)
+    {
+        QMutexLocker lock(m_loader->getMutex());
+        return m_isChildrenLoaded;
+    }
+
+    return true;
+}
+
+PDFOutlineSearchIndex PDFOutlineSearchIndex::build(const PDFOutlineItem* root)
+{
+    PDFOutlineSearchIndex index;
+
+    if (!root)
+    {
+        return index;
+    }
+
+    if (root->m_loader)
+    {
+        const PDFObjectStorage* storage = root->m_loader->getStorage();
+
+        // Titles are read directly from the document, items are not created
+        std::function<void(PDFObjectReference, const std::shared_ptr<const PDFOutlineItemReferenceChain>&, size_t)> addItems;
+        addItems = [&](PDFObjectReference firstItem, const std::shared_ptr<const PDFOutlineItemReferenceChain>& chain, size_t parent)
         {
-            if (!checkCyclicDependence(nextItem.getReference()))
+            size_t row = 0;
+            auto addItem = [&](const PDFDictionary* dictionary, PDFObjectReference reference)
             {
-                break;
+                Entry entry;
+                const PDFObject& titleObject = storage->getObject(dictionary->get("Title"));
+                if (titleObject.isString())
+                {
+                    entry.title = PDFEncoding::convertTextString(titleObject.getString());
+                }
+                entry.parent = parent;
+                entry.row = row++;
+
+                const size_t entryIndex = index.m_entries.size();
+                index.m_entries.emplace_back(qMove(entry));
+
+                const PDFObject& childItem = dictionary->get("First");
+                if (childItem.isReference())
+                {
+                    auto childChain = std::make_shared<const PDFOutlineItemReferenceChain>(PDFOutlineItemReferenceChain{ reference, chain });
+                    addItems(childItem.getReference(), childChain, entryIndex);
+                }
+            };
+            forEachOutlineItem(storage, firstItem, chain.get(), addItem);
+        };
+        addItems(root->m_firstChildReference, root->m_referenceChain, INVALID_PARENT);
+    }
+    else
+    {
+        std::function<void(const PDFOutlineItem*, size_t)> addItems;
+        addItems = [&](const PDFOutlineItem* item, size_t parent)
+        {
+            for (size_t i = 0, childCount = item->getChildCount(); i < childCount; ++i)
+            {
+                const PDFOutlineItem* child = item->getChild(i);
+
+                Entry entry;
+                entry.title = child->getTitle();
+                entry.parent = parent;
+                entry.row = i;
+
+                const size_t entryIndex = index.m_entries.size();
+                index.m_entries.emplace_back(qMove(entry));
+                addItems(child, entryIndex);
             }
-            dereferencedItem = storage->getObject(nextItem);
+        };
+        addItems(root, INVALID_PARENT);
+    }
+
+    return index;
+}
+
+std::vector<PDFOutlineSearchIndex::Path> PDFOutlineSearchIndex::find(const QRegularExpression& expression) const
+{
+    std::vector<Path> result;
+
+    for (const Entry& entry : m_entries)
+    {
+        if (!entry.title.contains(expression))
+        {
+            continue;
         }
-        else
+
+        Path path;
+        for (const Entry* currentEntry = &entry; currentEntry; currentEntry = currentEntry->parent != INVALID_PARENT ? &m_entries[currentEntry->parent] : nullptr)
         {
-            // We are finished
-            break;
+            path.push_back(currentEntry->row);
         }
+        std::reverse(path.begin(), path.end());
+        result.emplace_back(qMove(path));
     }
+
+    return result;
 }
 
 PDFObjectReference PDFOutlineItem::getStructureElement() const
@@ -149,6 +348,7 @@ void PDFOutlineItem::setStructureElement(PDFObjectReference structureElement)
 void PDFOutlineItem::apply(const std::function<void (PDFOutlineItem*)>& functor)
 {
     functor(this);
+    loadChildren();
 
     for (const auto& item : m_children)
     {
@@ -171,6 +371,18 @@ QSharedPointer<PDFOutlineItem> PDFOutlineItem::clone() const
         result->setAction(action->clone());
     }
 
+    if (!isChildrenLoaded())
+    {
+        // Children are not loaded yet, clone will load them on demand
+        result->m_loader = m_loader;
+        result->m_firstChildReference = m_firstChildReference;
+        result->m_referenceChain = m_referenceChain;
+        result->m_count = m_count;
+        result->m_isChildrenLoaded = false;
+        return result;
+    }
+
+    result->m_count = m_count;
     for (size_t i = 0; i < getChildCount(); ++i)
     {
         result->addChild(getChild(i)->clone());
@@ -181,11 +393,13 @@ QSharedPointer<PDFOutlineItem> PDFOutlineItem::clone() const
 
 void PDFOutlineItem::insertChild(size_t index, QSharedPointer<PDFOutlineItem> item)
 {
+    loadChildren();
     m_children.insert(std::next(m_children.begin(), index), item);
 }
 
 void PDFOutlineItem::removeChild(size_t index)
 {
+    loadChildren();
     m_children.erase(std::next(m_children.begin(), index));
 }
 
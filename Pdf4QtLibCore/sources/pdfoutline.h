@@ -23,14 +23,21 @@
 #include "pdfaction.h"
 
 #include <QSharedPointer>
+#include <QRegularExpression>
 
-#include <set>
+#include <memory>
+#include <limits>
 
 namespace pdf
 {
 class PDFDocument;
+class PDFOutlineItemLoader;
+struct PDFOutlineItemReferenceChain;
 
-/// Outline item
+/// Outline item. Items parsed from the document load their children
+/// on demand, i.e. when children are accessed for the first time, so large
+/// outlines are not parsed as a whole, when document is opened. Loading
+/// of the children is thread safe.
 class PDF4QTLIBCORESHARED_EXPORT PDFOutlineItem
 {
 public:
@@ -39,12 +46,33 @@ public:
     const QString& getTitle() const { return m_title; }
     void setTitle(const QString& title) { m_title = title; }
 
-    size_t getChildCount() const { return m_children.size(); }
+    size_t getChildCount() const { loadChildren(); return m_children.size(); }
     size_t getTotalCount() const;
-    const PDFOutlineItem* getChild(size_t index) const { return m_children[index].get(); }
-    void addChild(QSharedPointer<PDFOutlineItem> child) { m_children.emplace_back(qMove(child)); }
-    QSharedPointer<PDFOutlineItem> getChildPtr(size_t index) const { return m_children[index]; }
-
+    const PDFOutlineItem* getChild(size_t index) const { loadChildren(); return m_children[index].get(); }
+    void addChild(QSharedPointer<PDFOutlineItem> child) { loadChildren(); m_children.emplace_back(qMove(child)); }
+    QSharedPointer<PDFOutlineItem> getChildPtr(size_t index) const { loadChildren(); return m_children[index]; }
+
+    /// Returns true, if item has children. Children are not loaded.
+    bool hasChildren() const;
+
+    /// Returns true, if children of the item were loaded (items,
+    /// which were not parsed from the document, have always loaded children).
+    bool isChildrenLoaded() const;
+
+    /// Returns value of the /Count entry of the item. Absolute value is
+    /// the number of visible descendants, if item is open, negative value
+    /// means item is closed. Zero is returned, if item has no children.
+    PDFInteger getCount() const { return m_count; }
+
+    /// Returns true, if item is open (its children are visible)
+    bool isOpen() const { return m_count > 0; }
+
+    /// Parses outline from the document. Only the top level items
+    /// are parsed, when they are accessed, other items are parsed
+    /// on demand. Storage is copied, so it need not to exist,
+    /// when items are loaded.
+    /// \param storage Storage
+    /// \param root Root of the outline (outline dictionary)
     static QSharedPointer<PDFOutlineItem> parse(const PDFObjectStorage* storage, const PDFObject& root);
 
     const PDFAction* getAction() const;
@@ -71,18 +99,67 @@ public:
     void removeChild(size_t index);
 
 private:
-    static void parseImpl(const PDFObjectStorage* storage,
-                          PDFOutlineItem* parent,
-                          PDFObjectReference currentItem,
-                          std::set<PDFObjectReference>& visitedOutlineItems);
+    friend class PDFOutlineSearchIndex;
+
+    /// Parses item from the outline item dictionary, children are not parsed
+    static QSharedPointer<PDFOutlineItem> parseItem(const std::shared_ptr<PDFOutlineItemLoader>& loader,
+                                                    const PDFDictionary* dictionary,
+                                                    PDFObjectReference reference,
+                                                    const std::shared_ptr<const PDFOutlineItemReferenceChain>& referenceChain);
+
+    /// Loads children of the item, if they are not already loaded
+    void loadChildren() const;
 
     QString m_title;
-    std::vector<QSharedPointer<PDFOutlineItem>> m_children;
+    mutable std::vector<QSharedPointer<PDFOutlineItem>> m_children;
     PDFActionPtr m_action;
     PDFObjectReference m_structureElement;
     QColor m_textColor;
     bool m_fontItalics = false;
     bool m_fontBold = false;
+    PDFInteger m_count = 0;
+
+    /// Loader of the children (nullptr, if item was not parsed from the document)
+    std::shared_ptr<PDFOutlineItemLoader> m_loader;
+    PDFObjectReference m_firstChildReference;
+    std::shared_ptr<const PDFOutlineItemReferenceChain> m_referenceChain;
+    mutable bool m_isChildrenLoaded = true;
+};
+
+/// Index of titles of the outline items. It is built directly from the
+/// document, so outline items need not to be loaded, and it can be built
+/// in the background thread. Item is identified by its path, i.e. by
+/// row indices of the items from the top level item to the item itself.
+class PDF4QTLIBCORESHARED_EXPORT PDFOutlineSearchIndex
+{
+public:
+    using Path = std::vector<size_t>;
+
+    explicit PDFOutlineSearchIndex() = default;
+
+    /// Builds index of the descendants of the root item. If root item
+    /// was parsed from the document, index reflects the document, not
+    /// the later modifications of the items.
+    /// \param root Root outline item
+    static PDFOutlineSearchIndex build(const PDFOutlineItem* root);
+
+    /// Returns paths of the items, whose title matches the expression
+    /// \param expression Expression
+    std::vector<Path> find(const QRegularExpression& expression) const;
+
+    size_t getItemCount() const { return m_entries.size(); }
+
+private:
+    static constexpr size_t INVALID_PARENT = std::numeric_limits<size_t>::max();
+
+    struct Entry
+    {
+        QString title;
+        size_t parent = INVALID_PARENT;
+        size_t row = 0;
+    };
+
+    std::vector<Entry> m_entries;
 };
 
 }   // namespace pdf
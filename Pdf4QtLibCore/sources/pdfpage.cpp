@@ -19,6 +19,10 @@
 #include "pdfdocument.h"
 #include "pdfexception.h"
 #include "pdfencoding.h"
+
+#include <limits>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -242,6 +246,63 @@ QRectF PDFPage::getRotatedBox(const QRectF& rect, PageRotation rotation)
     return rect;
 }
 
+PDFPage PDFPage::parsePage(const PDFObjectStorage* storage,
+                           const PDFObject& pageObject,
+                           const PDFPageInheritableAttributes& attributes)
+{
+    const PDFObject& dereferenced = storage->getObject(pageObject);
+    if (!dereferenced.isDictionary())
+    {
+        throw PDFException(PDFTranslationContext::tr("Expected dictionary in page tree."));
+    }
+
+    const PDFDictionary* dictionary = dereferenced.getDictionary();
+
+    PDFPage page;
+
+    page.m_pageObject = dereferenced;
+    page.m_pageReference = pageObject.isReference() ? pageObject.getReference() : PDFObjectReference();
+    page.m_mediaBox = attributes.getMediaBox();
+    page.m_cropBox = attributes.getCropBox();
+    page.m_resources = storage->getObject(attributes.getResources());
+    page.m_pageRotation = attributes.getPageRotation();
+
+    if (!page.m_cropBox.isValid())
+    {
+        page.m_cropBox = page.m_mediaBox;
+    }
+
+    PDFDocumentDataLoaderDecorator loader(storage);
+    page.m_bleedBox = loader.readRectangle(dictionary->get("BleedBox"), page.getCropBox());
+    page.m_trimBox = loader.readRectangle(dictionary->get("TrimBox"), page.getCropBox());
+    page.m_artBox = loader.readRectangle(dictionary->get("ArtBox"), page.getCropBox());
+    page.m_contents = storage->getObject(dictionary->get("Contents"));
+    page.m_annots = loader.readReferenceArrayFromDictionary(dictionary, "Annots");
+    page.m_lastModified = PDFEncoding::convertToDateTime(loader.readStringFromDictionary(dictionary, "LastModified"));
+    page.m_thumbnailReference = loader.readReferenceFromDictionary(dictionary, "Thumb");
+    page.m_beads = loader.readReferenceArrayFromDictionary(dictionary, "B");
+    page.m_duration = loader.readIntegerFromDictionary(dictionary, "Dur", 0);
+    page.m_structParent = loader.readIntegerFromDictionary(dictionary, "StructParents", 0);
+    page.m_webCaptureContentSetId = loader.readStringFromDictionary(dictionary, "ID");
+    page.m_preferredZoom = loader.readNumberFromDictionary(dictionary, "PZ", 0.0);
+
+    constexpr const std::array<std::pair<const char*, PageTabOrder>, 5> tabStops =
+    {
+        std::pair<const char*, PageTabOrder>{ "R", PageTabOrder::Row },
+        std::pair<const char*, PageTabOrder>{ "C", PageTabOrder::Column },
+        std::pair<const char*, PageTabOrder>{ "S", PageTabOrder::Structure },
+        std::pair<const char*, PageTabOrder>{ "A", PageTabOrder::Array },
+        std::pair<const char*, PageTabOrder>{ "W", PageTabOrder::Widget }
+    };
+
+    page.m_pageTabOrder = loader.readEnumByName(dictionary->get("Tabs"), tabStops.cbegin(), tabStops.cend(), PageTabOrder::Invalid);
+    page.m_templateName = loader.readNameFromDictionary(dictionary, "TemplateInstantiated");
+    page.m_userUnit = loader.readNumberFromDictionary(dictionary, "UserUnit", 1.0);
+    page.m_documentPart = loader.readReferenceFromDictionary(dictionary, "DPart");
+
+    return page;
+}
+
 void PDFPage::parseImpl(std::vector<PDFPage>& pages,
                         std::set<PDFObjectReference>& visitedReferences,
                         const PDFPageInheritableAttributes& templateAttributes,
@@ -249,7 +310,6 @@ void PDFPage::parseImpl(std::vector<PDFPage>& pages,
                         const PDFObjectStorage* storage)
 {
     // Are we in internal node, or leaf (page object)?
-    PDFObjectReference objectReference = root.isReference() ? root.getReference() : PDFObjectReference();
     const PDFObject& dereferenced = storage->getObject(root);
 
     if (dereferenced.isDictionary())
@@ -296,49 +356,7 @@ void PDFPage::parseImpl(std::vector<PDFPage>& pages,
             }
             else if (typeString == "Page")
             {
-                PDFPage page;
-
-                page.m_pageObject = dereferenced;
-                page.m_pageReference = objectReference;
-                page.m_mediaBox = currentInheritableAttributes.getMediaBox();
-                page.m_cropBox = currentInheritableAttributes.getCropBox();
-                page.m_resources = storage->getObject(currentInheritableAttributes.getResources());
-                page.m_pageRotation = currentInheritableAttributes.getPageRotation();
-
-                if (!page.m_cropBox.isValid())
-                {
-                    page.m_cropBox = page.m_mediaBox;
-                }
-
-                PDFDocumentDataLoaderDecorator loader(storage);
-                page.m_bleedBox = loader.readRectangle(dictionary->get("BleedBox"), page.getCropBox());
-                page.m_trimBox = loader.readRectangle(dictionary->get("TrimBox"), page.getCropBox());
-                page.m_artBox = loader.readRectangle(dictionary->get("ArtBox"), page.getCropBox());
-                page.m_contents = storage->getObject(dictionary->get("Contents"));
-                page.m_annots = loader.readReferenceArrayFromDictionary(dictionary, "Annots");
-                page.m_lastModified = PDFEncoding::convertToDateTime(loader.readStringFromDictionary(dictionary, "LastModified"));
-                page.m_thumbnailReference = loader.readReferenceFromDictionary(dictionary, "Thumb");
-                page.m_beads = loader.readReferenceArrayFromDictionary(dictionary, "B");
-                page.m_duration = loader.readIntegerFromDictionary(dictionary, "Dur", 0);
-                page.m_structParent = loader.readIntegerFromDictionary(dictionary, "StructParents", 0);
-                page.m_webCaptureContentSetId = loader.readStringFromDictionary(dictionary, "ID");
-                page.m_preferredZoom = loader.readNumberFromDictionary(dictionary, "PZ", 0.0);
-
-                constexpr const std::array<std::pair<const char*, PageTabOrder>, 5> tabStops =
-                {
-                    std::pair<const char*, PageTabOrder>{ "R", PageTabOrder::Row },
-                    std::pair<const char*, PageTabOrder>{ "C", PageTabOrder::Column },
-                    std::pair<const char*, PageTabOrder>{ "S", PageTabOrder::Structure },
-                    std::pair<const char*, PageTabOrder>{ "A", PageTabOrder::Array },
-                    std::pair<const char*, PageTabOrder>{ "W", PageTabOrder::Widget }
-                };
-
-                page.m_pageTabOrder = loader.readEnumByName(dictionary->get("Tabs"), tabStops.cbegin(), tabStops.cend(), PageTabOrder::Invalid);
-                page.m_templateName = loader.readNameFromDictionary(dictionary, "TemplateInstantiated");
-                page.m_userUnit = loader.readNumberFromDictionary(dictionary, "UserUnit", 1.0);
-                page.m_documentPart = loader.readReferenceFromDictionary(dictionary, "DPart");
-
-                pages.emplace_back(std::move(page));
+                pages.emplace_back(parsePage(storage, root, currentInheritableAttributes));
             }
             else
             {
@@ -356,4 +374,417 @@ void PDFPage::parseImpl(std::vector<PDFPage>& pages,
     }
 }
 
+PDFPageTree::PDFPageTree(const PDFObjectStorage& storage, PDFObject root) :
+    m_storage(std::make_unique<PDFObjectStorage>(storage)),
+    m_root(qMove(root))
+{
+    const PDFDictionary* rootDictionary = m_storage->getDictionaryFromObject(m_root);
+    if (!rootDictionary)
+    {
+        throw PDFException(PDFTranslationContext::tr("Expected dictionary in page tree."));
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_storage.get());
+    if (loader.readNameFromDictionary(rootDictionary, "Type") != "Pages")
+    {
+        throw PDFException(PDFTranslationContext::tr("Expected valid type item in page tree."));
+    }
+
+    const PDFInteger count = loader.readIntegerFromDictionary(rootDictionary, "Count", -1);
+    if (count < 0)
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid page count in page tree."));
+    }
+
+    // Each page is an indirect object, so page count can't be larger than object count.
+    // Page count is not trusted, otherwise damaged file can cause huge allocation.
+    if (static_cast<quint64>(count) > static_cast<quint64>(m_storage->getObjectCount()))
+    {
+        throw PDFException(PDFTranslationContext::tr("Page count %1 in page tree is larger than object count.").arg(count));
+    }
+
+    m_pageCapacity = static_cast<size_t>(count);
+    m_pageCount.store(m_pageCapacity, std::memory_order_release);
+    m_pages = std::make_unique<std::atomic<PDFPage*>[]>(m_pageCapacity);
+}
+
+PDFPageTree::~PDFPageTree()
+{
+    for (size_t i = 0; i < m_pageCapacity; ++i)
+    {
+        delete m_pages[i].load(std::memory_order_relaxed);
+    }
+}
+
+const PDFPage* PDFPageTree::getPage(size_t index) const
+{
+    // Page count can be lowered meanwhile, if page tree is damaged, so
+    // index is checked against page array size. Pages, which don't exist
+    // in the page tree, are empty pages.
+    if (index >= m_pageCapacity)
+    {
+        throw std::out_of_range("Invalid page index.");
+    }
+
+    std::atomic<PDFPage*>& slot = m_pages[index];
+    if (const PDFPage* page = slot.load(std::memory_order_acquire))
+    {
+        return page;
+    }
+
+    std::optional<PDFPage> foundPage;
+    if (!m_isFallbackUsed.load(std::memory_order_acquire))
+    {
+        foundPage = findPage(index);
+    }
+
+    if (!foundPage)
+    {
+        parseAllPages();
+        foundPage = index < m_fallbackPages.size() ? m_fallbackPages[index] : PDFPage();
+    }
+
+    PDFPage* newPage = new PDFPage(qMove(*foundPage));
+    PDFPage* expected = nullptr;
+    if (!slot.compare_exchange_strong(expected, newPage, std::memory_order_acq_rel))
+    {
+        // Another thread was faster
+        delete newPage;
+        return expected;
+    }
+
+    return newPage;
+}
+
+size_t PDFPageTree::getPageIndexFromPageReference(PDFObjectReference reference) const
+{
+    if (!m_isFallbackUsed.load(std::memory_order_acquire))
+    {
+        if (std::optional<size_t> index = findPageIndex(reference))
+        {
+            return *index;
+        }
+    }
+
+    parseAllPages();
+
+    auto it = std::find_if(m_fallbackPages.cbegin(), m_fallbackPages.cend(), [reference](const PDFPage& page) { return page.getPageReference() == reference; });
+    if (it != m_fallbackPages.cend())
+    {
+        return std::distance(m_fallbackPages.cbegin(), it);
+    }
+
+    return std::numeric_limits<size_t>::max();
+}
+
+std::optional<PDFPage> PDFPageTree::findPage(size_t index) const
+{
+    try
+    {
+        std::set<PDFObjectReference> visitedReferences;
+        PDFPageInheritableAttributes attributes;
+        PDFObject node = m_root;
+        size_t remainingIndex = index;
+
+        while (true)
+        {
+            const PDFDictionary* dictionary = m_storage->getDictionaryFromObject(node);
+            if (!dictionary)
+            {
+                return std::nullopt;
+            }
+
+            PDFDocumentDataLoaderDecorator loader(m_storage.get());
+            const QByteArray type = loader.readNameFromDictionary(dictionary, "Type");
+            attributes = PDFPageInheritableAttributes::parse(attributes, node, m_storage.get());
+
+            if (type == "Page")
+            {
+                if (remainingIndex != 0)
+                {
+                    return std::nullopt;
+                }
+
+                return PDFPage::parsePage(m_storage.get(), node, attributes);
+            }
+
+            if (type != "Pages")
+            {
+                return std::nullopt;
+            }
+
+            const PDFObject& kids = m_storage->getObject(dictionary->get("Kids"));
+            if (!kids.isArray())
+            {
+                return std::nullopt;
+            }
+
+            // Find kid containing the page
+            const PDFArray* kidsArray = kids.getArray();
+            bool kidFound = false;
+            for (size_t i = 0, count = kidsArray->getCount(); i < count; ++i)
+            {
+                const PDFObject& kid = kidsArray->getItem(i);
+                std::optional<size_t> kidPageCount = getKidPageCount(kid);
+                if (!kidPageCount)
+                {
+                    return std::nullopt;
+                }
+
+                if (remainingIndex < *kidPageCount)
+                {
+                    if (visitedReferences.count(kid.getReference()))
+                    {
+                        return std::nullopt;
+                    }
+
+                    visitedReferences.insert(kid.getReference());
+                    node = kid;
+                    kidFound = true;
+                    break;
+                }
+
+                remainingIndex -= *kidPageCount;
+            }
+
+            if (!kidFound)
+            {
+                return std::nullopt;
+            }
+        }
+    }
+    catch (const PDFException&)
+    {
+        return std::nullopt;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<size_t> PDFPageTree::findPageIndex(PDFObjectReference reference) const
+{
+    std::set<PDFObjectReference> visitedReferences;
+    PDFDocumentDataLoaderDecorator loader(m_storage.get());
+
+    const PDFDictionary* dictionary = m_storage->getDictionaryFromObject(PDFObject::createReference(reference));
+    if (!dictionary || loader.readNameFromDictionary(dictionary, "Type") != "Page")
+    {
+        return std::nullopt;
+    }
+
+    size_t index = 0;
+    PDFObjectReference currentReference = reference;
+
+    // Walk up to the root. Pages in preceding kids of each
+    // parent node are before our page.
+    while (dictionary->hasKey("Parent"))
+    {
+        const PDFObject& parentObject = dictionary->get("Parent");
+        if (!parentObject.isReference() || visitedReferences.count(parentObject.getReference()))
+        {
+            return std::nullopt;
+        }
+
+        const PDFObjectReference parentReference = parentObject.getReference();
+        visitedReferences.insert(parentReference);
+
+        const PDFDictionary* parentDictionary = m_storage->getDictionaryFromObject(parentObject);
+        if (!parentDictionary)
+        {
+            return std::nullopt;
+        }
+
+        const PDFObject& kids = m_storage->getObject(parentDictionary->get("Kids"));
+        if (!kids.isArray())
+        {
+            return std::nullopt;
+        }
+
+        const PDFArray* kidsArray = kids.getArray();
+        bool kidFound = false;
+        for (size_t i = 0, count = kidsArray->getCount(); i < count; ++i)
+        {
+            const PDFObject& kid = kidsArray->getItem(i);
+            if (kid.isReference() && kid.getReference() == currentReference)
+            {
+                kidFound = true;
+                break;
+            }
+
+            std::optional<size_t> kidPageCount = getKidPageCount(kid);
+            if (!kidPageCount)
+            {
+                return std::nullopt;
+            }
+
+            index += *kidPageCount;
+        }
+
+        if (!kidFound)
+        {
+            return std::nullopt;
+        }
+
+        currentReference = parentReference;
+        dictionary = parentDictionary;
+    }
+
+    // We must end in the root node
+    if (!m_root.isReference() || m_root.getReference() != currentReference || index >= getPageCount())
+    {
+        return std::nullopt;
+    }
+
+    return index;
+}
+
+std::optional<size_t> PDFPageTree::getKidPageCount(const PDFObject& kid) const
+{
+    if (!kid.isReference())
+    {
+        return std::nullopt;
+    }
+
+    const PDFDictionary* kidDictionary = m_storage->getDictionaryFromObject(kid);
+    if (!kidDictionary)
+    {
+        return std::nullopt;
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_storage.get());
+    const QByteArray type = loader.readNameFromDictionary(kidDictionary, "Type");
+    if (type == "Page")
+    {
+        return 1;
+    }
+
+    if (type == "Pages")
+    {
+        const PDFInteger count = loader.readIntegerFromDictionary(kidDictionary, "Count", -1);
+        if (count >= 0)
+        {
+            return static_cast<size_t>(count);
+        }
+    }
+
+    return std::nullopt;
+}
+
+void PDFPageTree::parseAllPages() const
+{
+    if (m_isFallbackUsed.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    QMutexLocker lock(&m_fallbackMutex);
+    if (!m_isFallbackUsed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            m_fallbackPages = PDFPage::parse(m_storage.get(), m_root);
+        }
+        catch (const PDFException&)
+        {
+            // Page tree is invalid, pages will be empty
+            m_fallbackPages.clear();
+        }
+
+        // Page tree is damaged, if root node claims more pages, than page tree
+        // contains, so page count is lowered to the count of the pages found.
+        if (m_fallbackPages.size() < m_pageCapacity)
+        {
+            m_pageCount.store(m_fallbackPages.size(), std::memory_order_release);
+        }
+
+        m_isFallbackUsed.store(true, std::memory_order_release);
+    }
+}
+
+PDFPageContentDependencies PDFPageContentDependencies::create(const PDFDocument* document, size_t pageIndex)
+{
+    PDFPageContentDependencies dependencies;
+
+    const PDFCatalog* catalog = document->getCatalog();
+    const PDFPage* page = pageIndex < catalog->getPageCount() ? catalog->getPage(pageIndex) : nullptr;
+    if (!page || !page->getPageReference().isValid())
+    {
+        return dependencies;
+    }
+
+    dependencies.m_pageReference = page->getPageReference();
+    dependencies.m_mediaBox = page->getMediaBox();
+    dependencies.m_cropBox = page->getCropBox();
+    dependencies.m_pageRotation = page->getPageRotation();
+    dependencies.m_contents = page->getContents();
+    dependencies.m_resources = page->getResources();
+
+    if (const PDFDictionary* pageDictionary = document->getDictionaryFromObject(document->getObjectByReference(dependencies.m_pageReference)))
+    {
+        dependencies.m_group = pageDictionary->get("Group");
+    }
+
+    // Collect all indirect objects reachable from the page content. We do not follow
+    // parent links, otherwise we can reach the page tree (and all annotations).
+    std::set<PDFObjectReference> visitedReferences;
+    std::vector<const PDFObject*> objectsToProcess = { &dependencies.m_contents, &dependencies.m_resources, &dependencies.m_group };
+
+    while (!objectsToProcess.empty())
+    {
+        const PDFObject* object = objectsToProcess.back();
+        objectsToProcess.pop_back();
+
+        switch (object->getType())
+        {
+            case PDFObject::Type::Reference:
+            {
+                const PDFObjectReference reference = object->getReference();
+                if (visitedReferences.insert(reference).second)
+                {
+                    const PDFObject& referencedObject = document->getObjectByReference(reference);
+                    dependencies.m_objects.emplace_back(reference, referencedObject);
+                    objectsToProcess.push_back(&referencedObject);
+                }
+                break;
+            }
+
+            case PDFObject::Type::Array:
+            {
+                const PDFArray* array = object->getArray();
+                for (size_t i = 0, count = array->getCount(); i < count; ++i)
+                {
+                    objectsToProcess.push_back(&array->getItem(i));
+                }
+                break;
+            }
+
+            case PDFObject::Type::Dictionary:
+            case PDFObject::Type::Stream:
+            {
+                const PDFDictionary* dictionary = object->isStream() ? object->getStream()->getDictionary() : object->getDictionary();
+                for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+                {
+                    if (dictionary->getKey(i) == "Parent")
+                    {
+                        continue;
+                    }
+
+                    objectsToProcess.push_back(&dictionary->getValue(i));
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    return dependencies;
+}
+
+bool PDFPageContentDependencies::isUpToDate(const PDFDocument* document, size_t pageIndex) const
+{
+    return isValid() && *this == create(document, pageIndex);
+}
+
 }   // namespace pdf
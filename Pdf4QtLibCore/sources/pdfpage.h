@@ -20,10 +20,13 @@
 
 #include "pdfobject.h"
 
+#include <QMutex>
 #include <QRectF>
 #include <QDateTime>
 
 #include <set>
+#include <atomic>
+#include <memory>
 #include <optional>
 
 namespace pdf
@@ -273,6 +276,15 @@ public:
     static QSizeF getRotatedSize(const QSizeF& size, PageRotation rotation);
     static QRectF getRotatedBox(const QRectF& rect, PageRotation rotation);
 
+    /// Parses single page (leaf node of the page tree). If error occurs,
+    /// then exception is thrown.
+    /// \param storage Storage owning the page
+    /// \param pageObject Page object (reference or dictionary)
+    /// \param attributes Inheritable attributes, including attributes of the page itself
+    static PDFPage parsePage(const PDFObjectStorage* storage,
+                             const PDFObject& pageObject,
+                             const PDFPageInheritableAttributes& attributes);
+
 private:
     /// Parses the page tree (implementation). If error occurs, then exception is thrown.
     /// \param pages Page array. Pages are inserted into this array
@@ -318,6 +330,110 @@ private:
     QByteArray m_templateName;
 };
 
+/// Objects, on which compiled page content depends - page content streams,
+/// resources (fonts, images, forms, patterns, ...), page transparency group
+/// and page boxes. Annotations are not part of the page content. If document
+/// is modified, dependencies of the page can be created again in the modified
+/// document and compared with the old ones, to determine, if compiled page
+/// content is still valid.
+class PDF4QTLIBCORESHARED_EXPORT PDFPageContentDependencies
+{
+public:
+    explicit PDFPageContentDependencies() = default;
+
+    /// Collects objects, on which content of the page depends. If page
+    /// doesn't exist, then invalid dependencies are returned.
+    /// \param document Document
+    /// \param pageIndex Page index
+    static PDFPageContentDependencies create(const PDFDocument* document, size_t pageIndex);
+
+    /// Returns true, if dependencies are valid
+    bool isValid() const { return m_pageReference.isValid(); }
+
+    /// Returns true, if page content compiled using these dependencies
+    /// is also valid in given document (page with given index has
+    /// the same content as the page, from which dependencies were created).
+    /// \param document Document
+    /// \param pageIndex Page index
+    bool isUpToDate(const PDFDocument* document, size_t pageIndex) const;
+
+    bool operator==(const PDFPageContentDependencies&) const = default;
+
+private:
+    PDFObjectReference m_pageReference;
+    QRectF m_mediaBox;
+    QRectF m_cropBox;
+    PageRotation m_pageRotation = PageRotation::None;
+    PDFObject m_contents;
+    PDFObject m_resources;
+    PDFObject m_group;
+
+    /// Indirect objects reachable from the contents, resources and the group
+    std::vector<std::pair<PDFObjectReference, PDFObject>> m_objects;
+};
+
+/// Page tree, which parses pages on demand. Only the path from the root node
+/// to the requested page is resolved (using page counts of the intermediate
+/// nodes), so cost of the page lookup depends on the depth of the page tree,
+/// not on the page count. Parsed pages are cached. If the page tree is found
+/// to be inconsistent (for example, some node has invalid page count), then
+/// whole page tree is parsed at once, and it is used instead. Page count
+/// is taken from the root node. If it is larger than object count of the storage,
+/// then page tree is damaged and exception is thrown. If whole page tree is parsed
+/// and its page count is lower, than page count of the root node, then page count
+/// is corrected. Pages, which can't be parsed, are empty pages. This class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFPageTree
+{
+public:
+    /// Creates page tree. If root node of the page tree
+    /// is invalid, then exception is thrown.
+    /// \param storage Storage, must not be modified (it should be lazy storage)
+    /// \param root Root node of the page tree
+    explicit PDFPageTree(const PDFObjectStorage& storage, PDFObject root);
+    ~PDFPageTree();
+
+    PDFPageTree(const PDFPageTree&) = delete;
+    PDFPageTree& operator=(const PDFPageTree&) = delete;
+
+    /// Returns page count. Page count can be lowered, if page tree is found to be damaged.
+    size_t getPageCount() const { return m_pageCount.load(std::memory_order_acquire); }
+
+    /// Returns page with given index. If index is invalid,
+    /// then std::out_of_range exception is thrown.
+    /// \param index Page index
+    const PDFPage* getPage(size_t index) const;
+
+    /// Returns index of the page, or -1, if page is not found
+    /// \param reference Page reference
+    size_t getPageIndexFromPageReference(PDFObjectReference reference) const;
+
+private:
+    /// Tries to find and parse page with given index by resolving the path from
+    /// the root node. Returns std::nullopt, if page tree is inconsistent.
+    std::optional<PDFPage> findPage(size_t index) const;
+
+    /// Tries to find page index by walking parents of the page up
+    /// to the root node. Returns std::nullopt, if page tree is inconsistent.
+    std::optional<size_t> findPageIndex(PDFObjectReference reference) const;
+
+    /// Returns page count of the kid of the page tree node,
+    /// or std::nullopt, if kid is invalid.
+    std::optional<size_t> getKidPageCount(const PDFObject& kid) const;
+
+    /// Parses whole page tree at once (fallback, if page tree is inconsistent)
+    void parseAllPages() const;
+
+    std::unique_ptr<const PDFObjectStorage> m_storage;
+    PDFObject m_root;
+    mutable std::atomic<size_t> m_pageCount = 0;
+    size_t m_pageCapacity = 0;  ///< Size of the page array (page count of the root node)
+    std::unique_ptr<std::atomic<PDFPage*>[]> m_pages;
+
+    mutable QMutex m_fallbackMutex;
+    mutable std::atomic_bool m_isFallbackUsed = false;
+    mutable std::vector<PDFPage> m_fallbackPages;
+};
+
 }   // namespace pdf
 
 #endif // PDFPAGE_H
@@ -463,9 +463,19 @@ void PDFPageContentEditorContentStreamBuilder::writeEditedElement(const PDFEdite
 
     if (const PDFEditedPageContentElementImage* imageElement = element->asImage())
     {
-        QImage image = imageElement->getImage();
+        PDFObject imageObject = imageElement->getImageObject();
 
-        writeImage(stream, image);
+        if (isImageObjectWritable(imageObject))
+        {
+            // Image was not replaced, so we write the original image object, it is
+            // much faster than encoding the image again, and the image is not degraded.
+            writeImageObject(stream, std::move(imageObject));
+        }
+        else
+        {
+            QImage image = imageElement->getImage();
+            writeImage(stream, image);
+        }
     }
 
     if (const PDFEditedPageContentElementPath* pathElement = element->asPath())
@@ -904,10 +914,57 @@ void PDFPageContentEditorContentStreamBuilder::writeImage(QTextStream& stream, c
     stream << "/" << key << " Do" << Qt::endl;
 }
 
+void PDFPageContentEditorContentStreamBuilder::writeImageObject(QTextStream& stream, PDFObject imageObject)
+{
+    QByteArray key;
+
+    for (size_t i = 0; i < m_xobjectDictionary.getCount(); ++i)
+    {
+        const PDFObject& value = m_xobjectDictionary.getValue(i);
+        if (value.isStream() && value.getStream() == imageObject.getStream())
+        {
+            key = m_xobjectDictionary.getKey(i).getString();
+            break;
+        }
+    }
+
+    int i = 0;
+    while (key.isEmpty())
+    {
+        QByteArray currentKey = QString("Im%1").arg(++i).toLatin1();
+        if (!m_xobjectDictionary.hasKey(currentKey))
+        {
+            m_xobjectDictionary.addEntry(PDFInplaceOrMemoryString(currentKey), std::move(imageObject));
+            key = currentKey;
+        }
+    }
+
+    stream << "/" << key << " Do" << Qt::endl;
+}
+
+bool PDFPageContentEditorContentStreamBuilder::isImageObjectWritable(const PDFObject& imageObject)
+{
+    if (!imageObject.isStream())
+    {
+        return false;
+    }
+
+    const PDFObject& subtype = imageObject.getStream()->getDictionary()->get("Subtype");
+    return subtype.isName() && subtype.getString() == "Image";
+}
+
 QByteArray PDFPageContentEditorContentStreamBuilder::selectFont(const QByteArray& font)
 {
     m_textFont = nullptr;
 
+    // Fonts are created only once, text elements usually share few fonts
+    auto it = m_fonts.find(font);
+    if (it != m_fonts.cend())
+    {
+        m_textFont = it->second;
+        return font;
+    }
+
     PDFObject fontObject = m_fontDictionary.get(font);
     if (!fontObject.isNull())
     {
@@ -921,6 +978,11 @@ QByteArray PDFPageContentEditorContentStreamBuilder::selectFont(const QByteArray
         }
     }
 
+    if (m_textFont)
+    {
+        m_fonts[font] = m_textFont;
+    }
+
     if (!m_textFont)
     {
         QByteArray defaultFontKey = "PDF4QT_DefFnt";
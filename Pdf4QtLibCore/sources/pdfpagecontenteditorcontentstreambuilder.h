@@ -22,6 +22,8 @@
 
 #include <QPaintDevice>
 
+#include <map>
+
 namespace pdf
 {
 class PDFPageContentElement;
@@ -96,6 +98,17 @@ private:
 
     void writeImage(QTextStream& stream, const QImage& image);
 
+    /// Writes image object (for example, original image of the page)
+    /// as it is, without decoding and encoding it again.
+    /// \param stream Stream
+    /// \param imageObject Image object
+    void writeImageObject(QTextStream& stream, PDFObject imageObject);
+
+    /// Returns true, if original image object of the image element can be
+    /// written as it is. Only image XObjects can be written, inline images
+    /// must be encoded again.
+    static bool isImageObjectWritable(const PDFObject& imageObject);
+
     QByteArray selectFont(const QByteArray& font);
     void addError(const QString& error);
 
@@ -106,6 +119,7 @@ private:
     QByteArray m_outputContent;
     PDFPageContentProcessorState m_currentState;
     PDFFontPointer m_textFont;
+    std::map<QByteArray, PDFFontPointer> m_fonts;
     QStringList m_errors;
 };
 
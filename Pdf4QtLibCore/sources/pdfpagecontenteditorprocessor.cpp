@@ -17,6 +17,8 @@
 
 #include "pdfpagecontenteditorprocessor.h"
 
+#include <atomic>
+
 namespace pdf
 {
 
@@ -497,6 +499,7 @@ const PDFPageContentProcessorState& PDFEditedPageContentElement::getState() cons
 void PDFEditedPageContentElement::setState(const PDFPageContentProcessorState& newState)
 {
     m_state = newState;
+    markModified();
 }
 
 QTransform PDFEditedPageContentElement::getTransform() const
@@ -506,7 +509,22 @@ QTransform PDFEditedPageContentElement::getTransform() const
 
 void PDFEditedPageContentElement::setTransform(const QTransform& newTransform)
 {
-    m_transform = newTransform;
+    if (m_transform != newTransform)
+    {
+        m_transform = newTransform;
+        markModified();
+    }
+}
+
+void PDFEditedPageContentElement::markModified()
+{
+    m_revision = getNextRevision();
+}
+
+PDFInteger PDFEditedPageContentElement::getNextRevision()
+{
+    static std::atomic<PDFInteger> s_revision = 0;
+    return ++s_revision;
 }
 
 PDFEditedPageContentElementPath::PDFEditedPageContentElementPath(PDFPageContentProcessorState state, QPainterPath path, bool strokePath, bool fillPath, QTransform transform) :
@@ -525,7 +543,9 @@ PDFEditedPageContentElement::Type PDFEditedPageContentElementPath::getType() con
 
 PDFEditedPageContentElementPath* PDFEditedPageContentElementPath::clone() const
 {
-    return new PDFEditedPageContentElementPath(getState(), getPath(), getStrokePath(), getFillPath(), getTransform());
+    PDFEditedPageContentElementPath* copy = new PDFEditedPageContentElementPath(getState(), getPath(), getStrokePath(), getFillPath(), getTransform());
+    copy->m_revision = m_revision;
+    return copy;
 }
 
 QRectF PDFEditedPageContentElementPath::getBoundingBox() const
@@ -542,6 +562,7 @@ QPainterPath PDFEditedPageContentElementPath::getPath() const
 void PDFEditedPageContentElementPath::setPath(QPainterPath newPath)
 {
     m_path = newPath;
+    markModified();
 }
 
 bool PDFEditedPageContentElementPath::getStrokePath() const
@@ -551,7 +572,11 @@ bool PDFEditedPageContentElementPath::getStrokePath() const
 
 void PDFEditedPageContentElementPath::setStrokePath(bool newStrokePath)
 {
-    m_strokePath = newStrokePath;
+    if (m_strokePath != newStrokePath)
+    {
+        m_strokePath = newStrokePath;
+        markModified();
+    }
 }
 
 bool PDFEditedPageContentElementPath::getFillPath() const
@@ -561,7 +586,11 @@ bool PDFEditedPageContentElementPath::getFillPath() const
 
 void PDFEditedPageContentElementPath::setFillPath(bool newFillPath)
 {
-    m_fillPath = newFillPath;
+    if (m_fillPath != newFillPath)
+    {
+        m_fillPath = newFillPath;
+        markModified();
+    }
 }
 
 PDFEditedPageContentElementImage::PDFEditedPageContentElementImage(PDFPageContentProcessorState state, PDFObject imageObject, QImage image, QTransform transform) :
@@ -579,7 +608,9 @@ PDFEditedPageContentElement::Type PDFEditedPageContentElementImage::getType() co
 
 PDFEditedPageContentElementImage* PDFEditedPageContentElementImage::clone() const
 {
-    return new PDFEditedPageContentElementImage(getState(), getImageObject(), getImage(), getTransform());
+    PDFEditedPageContentElementImage* copy = new PDFEditedPageContentElementImage(getState(), getImageObject(), getImage(), getTransform());
+    copy->m_revision = m_revision;
+    return copy;
 }
 
 QRectF PDFEditedPageContentElementImage::getBoundingBox() const
@@ -595,6 +626,7 @@ PDFObject PDFEditedPageContentElementImage::getImageObject() const
 void PDFEditedPageContentElementImage::setImageObject(const PDFObject& newImageObject)
 {
     m_imageObject = newImageObject;
+    markModified();
 }
 
 QImage PDFEditedPageContentElementImage::getImage() const
@@ -605,6 +637,7 @@ QImage PDFEditedPageContentElementImage::getImage() const
 void PDFEditedPageContentElementImage::setImage(const QImage& newImage)
 {
     m_image = newImage;
+    markModified();
 }
 
 PDFEditedPageContentElementText::PDFEditedPageContentElementText(PDFPageContentProcessorState state, QTransform transform) :
@@ -633,12 +666,15 @@ PDFEditedPageContentElement::Type PDFEditedPageContentElementText::getType() con
 
 PDFEditedPageContentElementText* PDFEditedPageContentElementText::clone() const
 {
-    return new PDFEditedPageContentElementText(getState(), getItems(), getTextPath(), getTransform(), getItemsAsText());
+    PDFEditedPageContentElementText* copy = new PDFEditedPageContentElementText(getState(), getItems(), getTextPath(), getTransform(), getItemsAsText());
+    copy->m_revision = m_revision;
+    return copy;
 }
 
 void PDFEditedPageContentElementText::addItem(Item item)
 {
     m_items.emplace_back(std::move(item));
+    markModified();
 }
 
 const std::vector<PDFEditedPageContentElementText::Item>& PDFEditedPageContentElementText::getItems() const
@@ -649,6 +685,7 @@ const std::vector<PDFEditedPageContentElementText::Item>& PDFEditedPageContentEl
 void PDFEditedPageContentElementText::setItems(const std::vector<Item>& newItems)
 {
     m_items = newItems;
+    markModified();
 }
 
 QRectF PDFEditedPageContentElementText::getBoundingBox() const
@@ -664,6 +701,7 @@ QPainterPath PDFEditedPageContentElementText::getTextPath() const
 void PDFEditedPageContentElementText::setTextPath(QPainterPath newTextPath)
 {
     m_textPath = newTextPath;
+    markModified();
 }
 
 QString PDFEditedPageContentElementText::createItemsAsText(const PDFPageContentProcessorState& initialState,
@@ -778,7 +816,11 @@ QString PDFEditedPageContentElementText::getItemsAsText() const
 
 void PDFEditedPageContentElementText::setItemsAsText(const QString& newItemsAsText)
 {
-    m_itemsAsText = newItemsAsText;
+    if (m_itemsAsText != newItemsAsText)
+    {
+        m_itemsAsText = newItemsAsText;
+        markModified();
+    }
 }
 
 void PDFEditedPageContentElementText::optimize()
@@ -786,6 +828,7 @@ void PDFEditedPageContentElementText::optimize()
     while (!m_items.empty() && !m_items.back().isText)
     {
         m_items.pop_back();
+        markModified();
     }
 }
 
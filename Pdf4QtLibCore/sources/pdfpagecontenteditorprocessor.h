@@ -65,9 +65,22 @@ public:
     QTransform getTransform() const;
     void setTransform(const QTransform& newTransform);
 
+    /// Returns revision of the element. Each element has unique revision,
+    /// which is changed every time the element is modified. Copy of the
+    /// element has the same revision as the source element, so unmodified
+    /// elements can be recognized by comparing revisions.
+    PDFInteger getRevision() const { return m_revision; }
+
 protected:
+    /// Assigns new revision to the element, must be called
+    /// when content of the element is modified.
+    void markModified();
+
+    static PDFInteger getNextRevision();
+
     PDFPageContentProcessorState m_state;
     QTransform m_transform;
+    PDFInteger m_revision = getNextRevision();
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFEditedPageContentElementPath : public PDFEditedPageContentElement
@@ -233,6 +246,7 @@ protected:
     virtual void performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule) override;
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
     virtual bool performOriginalImagePainting(const PDFImage& image, const PDFStream* stream) override;
+    virtual bool isOriginalImagePaintingUsed() const override { return true; }
     virtual void performImagePainting(const QImage& image) override;
     virtual void performClipping(const QPainterPath& path, Qt::FillRule fillRule) override;
     virtual void performSaveGraphicState(ProcessOrder order) override;
@@ -22,11 +22,17 @@
 #include "pdfpattern.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfstreamfilters.h"
+#include "pdfparsedcontentcache.h"
+#include "pdfimagecache.h"
+#include "pdfinstrumentation.h"
 
 #include <QScopeGuard>
 #include <QPainterPathStroker>
 #include <QtMath>
 
+#include <array>
+#include <string_view>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -160,10 +166,89 @@ static constexpr const std::pair<const char*, PDFPageContentProcessor::Operator>
     { "EX", PDFPageContentProcessor::Operator::CompatibilityEnd }
 };
 
+/// Returns key of the operator. Key contains length of the operator name in the
+/// lowest byte and characters of the name in upper bytes. All operators have at
+/// most three characters, zero is returned for names, which can't be an operator.
+static constexpr uint32_t getOperatorKey(std::string_view name)
+{
+    if (name.empty() || name.size() > 3)
+    {
+        return 0;
+    }
+
+    uint32_t key = static_cast<uint32_t>(name.size());
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        key |= static_cast<uint32_t>(static_cast<unsigned char>(name[i])) << (8 * (i + 1));
+    }
+
+    return key;
+}
+
+static constexpr const size_t OPERATOR_HASH_TABLE_SIZE = 256;
+
+/// Returns index into the operator hash table (multiplicative hashing)
+static constexpr size_t getOperatorHash(uint32_t key)
+{
+    return static_cast<uint32_t>(key * 2654435761u) >> 24;
+}
+
+struct PDFOperatorHashTableEntry
+{
+    uint32_t key = 0;
+    PDFPageContentProcessor::Operator op = PDFPageContentProcessor::Operator::Invalid;
+};
+
+using PDFOperatorHashTable = std::array<PDFOperatorHashTableEntry, OPERATOR_HASH_TABLE_SIZE>;
+
+/// Creates hash table (with linear probing) of the operators at compile time
+static constexpr PDFOperatorHashTable createOperatorHashTable()
+{
+    PDFOperatorHashTable table = { };
+
+    for (const auto& [name, op] : operators)
+    {
+        const uint32_t key = getOperatorKey(name);
+        size_t index = getOperatorHash(key);
+
+        while (table[index].key != 0)
+        {
+            index = (index + 1) % OPERATOR_HASH_TABLE_SIZE;
+        }
+
+        table[index].key = key;
+        table[index].op = op;
+    }
+
+    return table;
+}
+
+static constexpr const PDFOperatorHashTable operatorHashTable = createOperatorHashTable();
+
+/// Decodes operator from its name, if name is not an operator, then
+/// Operator::Invalid is returned.
+static PDFPageContentProcessor::Operator decodeOperator(std::string_view name)
+{
+    const uint32_t key = getOperatorKey(name);
+
+    if (key != 0)
+    {
+        for (size_t index = getOperatorHash(key); operatorHashTable[index].key != 0; index = (index + 1) % OPERATOR_HASH_TABLE_SIZE)
+        {
+            if (operatorHashTable[index].key == key)
+            {
+                return operatorHashTable[index].op;
+            }
+        }
+    }
+
+    return PDFPageContentProcessor::Operator::Invalid;
+}
+
 void PDFPageContentProcessor::initDictionaries(const PDFObject& resourcesObject)
 {
     const PDFObject& resources = m_document->getObject(resourcesObject);
-    auto getDictionary = [this, &resources](const char* resourceName) -> const pdf::PDFDictionary*
+    auto getDictionary = [this, &resources](PDFNameAtom resourceName) -> const pdf::PDFDictionary*
     {
         if (resources.isDictionary() && resources.getDictionary()->hasKey(resourceName))
         {
@@ -177,16 +262,16 @@ void PDFPageContentProcessor::initDictionaries(const PDFObject& resourcesObject)
         return nullptr;
     };
 
-    m_colorSpaceDictionary = getDictionary(COLOR_SPACE_DICTIONARY);
-    m_fontDictionary = getDictionary("Font");
-    m_xobjectDictionary = getDictionary("XObject");
-    m_extendedGraphicStateDictionary = getDictionary(PDF_RESOURCE_EXTGSTATE);
-    m_propertiesDictionary = getDictionary("Properties");
-    m_shadingDictionary = getDictionary("Shading");
-    m_patternDictionary = getDictionary("Pattern");
+    m_colorSpaceDictionary = getDictionary(PDFNames::ColorSpace);
+    m_fontDictionary = getDictionary(PDFNames::Font);
+    m_xobjectDictionary = getDictionary(PDFNames::XObject);
+    m_extendedGraphicStateDictionary = getDictionary(PDFNames::ExtGState);
+    m_propertiesDictionary = getDictionary(PDFNames::Properties);
+    m_shadingDictionary = getDictionary(PDFNames::Shading);
+    m_patternDictionary = getDictionary(PDFNames::Pattern);
     m_procedureSets = NoProcSet;
 
-    if (resources.isDictionary() && resources.getDictionary()->hasKey("ProcSet"))
+    if (resources.isDictionary() && resources.getDictionary()->hasKey(PDFNames::ProcSet))
     {
         PDFDocumentDataLoaderDecorator loader(m_document);
         std::vector<QByteArray> procedureSetNames = loader.readNameArrayFromDictionary(resources.getDictionary(), "ProcSet");
@@ -275,6 +360,7 @@ void PDFPageContentProcessor::initializeProcessor()
 {
     // Clear the old errors
     m_errorList.clear();
+    m_errorIndices.clear();
 
     // Initialize default color spaces (gray, RGB, CMYK)
     try
@@ -285,7 +371,7 @@ void PDFPageContentProcessor::initializeProcessor()
     }
     catch (const PDFException& exception)
     {
-        m_errorList.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+        addRenderError(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
 
         // Create default color spaces anyway, but do not try to load them...
         m_deviceGrayColorSpace.reset(new PDFDeviceGrayColorSpace);
@@ -328,7 +414,7 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
             }
             else
             {
-                m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Invalid page contents.")));
+                addRenderError(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Invalid page contents.")));
             }
         }
     }
@@ -338,13 +424,13 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
     }
     else
     {
-        m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Invalid page contents.")));
+        addRenderError(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Invalid page contents.")));
     }
 
     if (!m_stack.empty())
     {
         // Stack is not empty. There was more saves than restores. This is error.
-        m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Graphic state stack was saved more times, than was restored.")));
+        addRenderError(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Graphic state stack was saved more times, than was restored.")));
 
         while (!m_stack.empty())
         {
@@ -358,7 +444,30 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
 
 void PDFPageContentProcessor::reportRenderError(RenderErrorType type, QString message)
 {
-    m_errorList.append(PDFRenderError(type, qMove(message)));
+    addRenderError(PDFRenderError(type, qMove(message)));
+}
+
+void PDFPageContentProcessor::reportRenderError(const PDFRenderError& error)
+{
+    addRenderError(error);
+}
+
+void PDFPageContentProcessor::addRenderError(const PDFRenderError& error)
+{
+    m_renderErrorCount += error.count;
+
+    // Broken content streams can report the same error many times,
+    // so we store it only once, with count of its occurrences.
+    RenderErrorKey key(int(error.type), quintptr(error.messageTemplate), error.message, error.arguments);
+    auto it = m_errorIndices.find(key);
+    if (it != m_errorIndices.cend())
+    {
+        m_errorList[it->second].count += error.count;
+        return;
+    }
+
+    m_errorIndices.emplace(qMove(key), m_errorList.size());
+    m_errorList.append(error);
 }
 
 void PDFPageContentProcessor::performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
@@ -472,6 +581,22 @@ void PDFPageContentProcessor::performEndTransparencyGroup(ProcessOrder order, co
     Q_UNUSED(transparencyGroup);
 }
 
+bool PDFPageContentProcessor::isTransparencyGroupContentSkipped() const
+{
+    return false;
+}
+
+bool PDFPageContentProcessor::performBeginFormContent(const PDFStream* stream)
+{
+    Q_UNUSED(stream);
+    return false;
+}
+
+void PDFPageContentProcessor::performEndFormContent(const PDFStream* stream)
+{
+    Q_UNUSED(stream);
+}
+
 void PDFPageContentProcessor::performOutputCharacter(const PDFTextCharacterInfo& info)
 {
     Q_UNUSED(info);
@@ -510,6 +635,21 @@ bool PDFPageContentProcessor::isContentSuppressed() const
     return std::any_of(m_markedContentStack.cbegin(), m_markedContentStack.cend(), [](const MarkedContentState& state) { return state.contentSuppressed; });
 }
 
+std::vector<PDFObjectReference> PDFPageContentProcessor::getOptionalContentReferences() const
+{
+    std::vector<PDFObjectReference> references;
+
+    for (const MarkedContentState& state : m_markedContentStack)
+    {
+        if (state.kind == MarkedContentKind::OptionalContent && state.optionalContent.isValid())
+        {
+            references.push_back(state.optionalContent);
+        }
+    }
+
+    return references;
+}
+
 PDFPageContentProcessor::PDFTransparencyGroup PDFPageContentProcessor::parseTransparencyGroup(const PDFObject& object)
 {
     PDFTransparencyGroup group;
@@ -546,9 +686,39 @@ void PDFPageContentProcessor::performInterceptInstruction(Operator currentOperat
 }
 
 void PDFPageContentProcessor::processContent(const QByteArray& content)
+{
+    processContent(content, nullptr);
+}
+
+bool PDFPageContentProcessor::processContent(const QByteArray& content, PDFParsedContentStream* parsedContent)
 {
     PDFLexicalAnalyzer parser(content.constBegin(), content.constEnd());
 
+    // Lexing is interleaved with operator execution, so only time
+    // of fetching of tokens is accumulated for the instrumentation.
+    const bool isInstrumented = PDFInstrumentation::isEnabled();
+    qint64 lexingTime = 0;
+
+    // Index of the first operand of the current instruction (when parsing content)
+    size_t operandsBegin = 0;
+
+    auto addParsedInstruction = [parsedContent, &operandsBegin](PDFParsedContentStream::Instruction&& instruction)
+    {
+        const bool hasOperands = instruction.type == PDFParsedContentStream::InstructionType::Command ||
+                                 instruction.type == PDFParsedContentStream::InstructionType::Operands;
+
+        if (!hasOperands)
+        {
+            // Operands are discarded
+            parsedContent->operands.resize(operandsBegin);
+        }
+
+        instruction.operandsBegin = operandsBegin;
+        instruction.operandsEnd = parsedContent->operands.size();
+        operandsBegin = parsedContent->operands.size();
+        parsedContent->instructions.emplace_back(std::move(instruction));
+    };
+
     while (!parser.isAtEnd() && !isProcessingCancelled())
     {
         bool tokenFetched = false;
@@ -556,16 +726,22 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
 
         try
         {
-            PDFLexicalAnalyzer::Token token = parser.fetch();
+            const qint64 lexingStartTime = isInstrumented ? PDFInstrumentation::now() : 0;
+            PDFLexicalAnalyzer::ContentToken token = parser.fetchContentToken();
             tokenFetched = true;
 
+            if (isInstrumented)
+            {
+                lexingTime += PDFInstrumentation::now() - lexingStartTime;
+            }
+
             switch (token.type)
             {
                 case PDFLexicalAnalyzer::TokenType::Command:
                 {
-                    QByteArray command = token.data.toByteArray();
+                    const Operator op = decodeOperator(token.view());
 
-                    if (command == "BI")
+                    if (op == Operator::InlineImageBegin)
                     {
                         // Strategy: We will try to find position of BI/ID/EI in the stream. If we can determine
                         // length of the stream explicitly, then we use explicit length. We also create a PDFObject
@@ -686,16 +862,40 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                         parser.seek(operatorEIPosition + 2);
 
                         QByteArray buffer = content.mid(startDataPosition, dataLength);
-                        PDFStream imageStream(std::move(*dictionary), std::move(buffer));
-                        paintXObjectImage(&imageStream);
+
+                        if (parsedContent)
+                        {
+                            PDFParsedContentStream::Instruction instruction;
+                            instruction.type = PDFParsedContentStream::InstructionType::InlineImage;
+                            instruction.op = op;
+                            instruction.inlineImage = std::make_shared<PDFStream>(std::move(*dictionary), std::move(buffer));
+                            addParsedInstruction(std::move(instruction));
+                        }
+                        else
+                        {
+                            PDFStream imageStream(std::move(*dictionary), std::move(buffer));
+                            paintXObjectImage(&imageStream);
+                        }
+                    }
+                    else if (parsedContent)
+                    {
+                        PDFParsedContentStream::Instruction instruction;
+                        instruction.type = PDFParsedContentStream::InstructionType::Command;
+                        instruction.op = op;
+                        instruction.operatorText = QByteArray(token.begin, int(token.size()));
+                        addParsedInstruction(std::move(instruction));
                     }
                     else
                     {
-                        // Process the command, then clear the operand stack
-                        processCommand(command);
+                        // Process the command, then clear the operand stack. Command text
+                        // refers to the content data, it is not copied.
+                        processCommand(op, QByteArray::fromRawData(token.begin, int(token.size())));
                     }
 
-                    m_operands.clear();
+                    if (!parsedContent)
+                    {
+                        m_operands.clear();
+                    }
                     break;
                 }
 
@@ -708,7 +908,14 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                 default:
                 {
                     // Push the operand onto the operand stack
-                    m_operands.push_back(std::move(token));
+                    if (parsedContent)
+                    {
+                        parsedContent->operands.push_back(PDFLexicalAnalyzer::toToken(token));
+                    }
+                    else
+                    {
+                        m_operands.push_back(PDFLexicalAnalyzer::toToken(token));
+                    }
                     break;
                 }
             }
@@ -722,17 +929,149 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                 parser.seek(parser.pos() + 1);
             }
 
+            if (parsedContent)
+            {
+                PDFParsedContentStream::Instruction instruction;
+                instruction.type = PDFParsedContentStream::InstructionType::Error;
+                instruction.error = PDFRenderError(RenderErrorType::Error, exception.getMessage());
+                addParsedInstruction(std::move(instruction));
+            }
+            else
+            {
+                m_operands.clear();
+                addRenderError(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+            }
+        }
+        catch (const PDFRendererException &exception)
+        {
+            if (parsedContent)
+            {
+                PDFParsedContentStream::Instruction instruction;
+                instruction.type = PDFParsedContentStream::InstructionType::Error;
+                instruction.error = exception.getError();
+                addParsedInstruction(std::move(instruction));
+            }
+            else
+            {
+                m_operands.clear();
+                addRenderError(exception.getError());
+            }
+        }
+    }
+
+    if (isInstrumented)
+    {
+        PDFInstrumentation::addTime(PDFInstrumentationStage::ContentLexing, lexingTime);
+    }
+
+    if (parsedContent && operandsBegin < parsedContent->operands.size())
+    {
+        // Operands at the end of the stream, they remain on the operand stack
+        PDFParsedContentStream::Instruction instruction;
+        instruction.type = PDFParsedContentStream::InstructionType::Operands;
+        addParsedInstruction(std::move(instruction));
+    }
+
+    return parser.isAtEnd();
+}
+
+PDFParsedContentStreamPointer PDFPageContentProcessor::parseContent(const QByteArray& content)
+{
+    std::shared_ptr<PDFParsedContentStream> parsedContent = std::make_shared<PDFParsedContentStream>();
+
+    if (!processContent(content, parsedContent.get()))
+    {
+        // Processing was cancelled, content is incomplete
+        return nullptr;
+    }
+
+    parsedContent->instructions.shrink_to_fit();
+    parsedContent->operands.shrink_to_fit();
+    return parsedContent;
+}
+
+void PDFPageContentProcessor::processParsedContent(const PDFParsedContentStream& content)
+{
+    for (const PDFParsedContentStream::Instruction& instruction : content.instructions)
+    {
+        if (isProcessingCancelled())
+        {
+            break;
+        }
+
+        try
+        {
+            switch (instruction.type)
+            {
+                case PDFParsedContentStream::InstructionType::Command:
+                {
+                    m_operands.insert(m_operands.end(), std::next(content.operands.cbegin(), instruction.operandsBegin), std::next(content.operands.cbegin(), instruction.operandsEnd));
+                    processCommand(instruction.op, instruction.operatorText);
+                    m_operands.clear();
+                    break;
+                }
+
+                case PDFParsedContentStream::InstructionType::InlineImage:
+                {
+                    paintXObjectImage(instruction.inlineImage.get());
+                    m_operands.clear();
+                    break;
+                }
+
+                case PDFParsedContentStream::InstructionType::Error:
+                {
+                    m_operands.clear();
+                    addRenderError(instruction.error);
+                    break;
+                }
+
+                case PDFParsedContentStream::InstructionType::Operands:
+                {
+                    m_operands.insert(m_operands.end(), std::next(content.operands.cbegin(), instruction.operandsBegin), std::next(content.operands.cbegin(), instruction.operandsEnd));
+                    break;
+                }
+            }
+        }
+        catch (const PDFException& exception)
+        {
             m_operands.clear();
-            m_errorList.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+            addRenderError(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
         }
         catch (const PDFRendererException &exception)
         {
             m_operands.clear();
-            m_errorList.append(exception.getError());
+            addRenderError(exception.getError());
         }
     }
 }
 
+void PDFPageContentProcessor::processCachedContent(const void* key, const QByteArray& content, const std::function<std::shared_ptr<const void>()>& getOwner)
+{
+    PDFParsedContentCache* cache = m_fontCache ? m_fontCache->getParsedContentCache().get() : nullptr;
+
+    if (!cache)
+    {
+        processContent(content);
+        return;
+    }
+
+    PDFParsedContentStreamPointer parsedContent = cache->find(key);
+    if (!parsedContent)
+    {
+        parsedContent = parseContent(content);
+
+        if (!parsedContent)
+        {
+            // Processing was cancelled
+            return;
+        }
+
+        cache->insert(key, getOwner(), parsedContent);
+    }
+
+    processParsedContent(*parsedContent);
+}
+
 void PDFPageContentProcessor::processContentStream(const PDFStream* stream)
 {
     try
@@ -744,7 +1083,7 @@ void PDFPageContentProcessor::processContentStream(const PDFStream* stream)
     catch (const PDFException& exception)
     {
         m_operands.clear();
-        m_errorList.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+        addRenderError(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
     }
 }
 
@@ -754,6 +1093,17 @@ void PDFPageContentProcessor::processForm(const QTransform& matrix,
                                           const PDFObject& transparencyGroup,
                                           const QByteArray& content,
                                           PDFInteger formStructuralParent)
+{
+    processForm(matrix, boundingBox, resources, transparencyGroup, content, formStructuralParent, nullptr);
+}
+
+void PDFPageContentProcessor::processForm(const QTransform& matrix,
+                                          const QRectF& boundingBox,
+                                          const PDFObject& resources,
+                                          const PDFObject& transparencyGroup,
+                                          const QByteArray& content,
+                                          PDFInteger formStructuralParent,
+                                          const PDFStream* stream)
 {
     if (isContentKindSuppressed(ContentKind::Forms))
     {
@@ -779,6 +1129,7 @@ void PDFPageContentProcessor::processForm(const QTransform& matrix,
         }
         group.isolated = loader.readBooleanFromDictionary(transparencyDictionary, "I", false);
         group.knockout = loader.readBooleanFromDictionary(transparencyDictionary, "K", false);
+        group.stream = stream;
         guard2.reset(new PDFTransparencyGroupGuard(this, qMove(group)));
 
         // If we are in transparency group, we must reset transparency settings in the graphic state.
@@ -810,12 +1161,37 @@ void PDFPageContentProcessor::processForm(const QTransform& matrix,
         initDictionaries(resources);
     }
 
-    processContent(content);
+    if (guard2 && isTransparencyGroupContentSkipped())
+    {
+        // Result of the transparency group is already known
+        return;
+    }
+
+    if (stream)
+    {
+        if (!guard2 && performBeginFormContent(stream))
+        {
+            // Content of the form is already painted
+            return;
+        }
+
+        // Form can be used many times, so we use parsed content cache
+        processCachedContent(stream, content, [stream]() -> std::shared_ptr<const void> { return stream->weak_from_this().lock(); });
+
+        if (!guard2)
+        {
+            performEndFormContent(stream);
+        }
+    }
+    else
+    {
+        processContent(content);
+    }
 }
 
 void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
 {
-    if (isContentSuppressed() || (text && isContentKindSuppressed(ContentKind::Text)) || (!text && isContentKindSuppressed(ContentKind::Shapes)))
+    if (m_isTextOnlyProcessing || isContentSuppressed() || (text && isContentKindSuppressed(ContentKind::Text)) || (!text && isContentKindSuppressed(ContentKind::Shapes)))
     {
         // Content is suppressed, do not paint anything
         return;
@@ -875,7 +1251,7 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
 
                         if (!performPathPaintingUsingShading(path, false, true, shadingPattern))
                         {
-                            PDFMesh mesh = shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
+                            PDFMesh mesh = createShadingMesh(shadingPattern, settings);
 
                             // Now, merge the current path to the mesh clipping path
                             QPainterPath boundingPath = mesh.getBoundingPath();
@@ -990,7 +1366,7 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
 
                         if (!performPathPaintingUsingShading(strokedPath, true, false, shadingPattern))
                         {
-                            PDFMesh mesh = shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
+                            PDFMesh mesh = createShadingMesh(shadingPattern, settings);
 
                             QPainterPath boundingPath = mesh.getBoundingPath();
                             if (boundingPath.isEmpty())
@@ -1042,13 +1418,6 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     PDFPageContentProcessorStateGuard guard(this);
     performClipping(path, path.fillRule());
 
-    // Initialize resources
-    const PDFObject& resources = tilingPattern->getResources();
-    if (!resources.isNull())
-    {
-        initDictionaries(resources);
-    }
-
     Q_ASSERT(m_pagePointToDevicePointMatrix.isInvertible());
 
     // Initialize rendering matrix
@@ -1057,36 +1426,7 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     QTransform pathTransformationMatrix = m_graphicState.getCurrentTransformationMatrix() * matrix.inverted();
     m_graphicState.setCurrentTransformationMatrix(matrix);
 
-    int uncoloredTilingPatternFlag = 0;
-
-    // Initialize colors for uncolored color space pattern
-    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
-    {
-        if (!uncoloredPatternColorSpace)
-        {
-            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Uncolored tiling pattern has not underlying color space."));
-        }
-
-        uncoloredTilingPatternFlag = 1;
-
-        m_graphicState.setStrokeColorSpace(uncoloredPatternColorSpace);
-        m_graphicState.setFillColorSpace(uncoloredPatternColorSpace);
-
-        QColor color = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, m_CMS, m_graphicState.getRenderingIntent(), this);
-        m_graphicState.setStrokeColor(color, uncoloredPatternColor);
-        m_graphicState.setFillColor(color, uncoloredPatternColor);
-    }
-    else
-    {
-        // Jakub Melka: According the specification, we set default color space and default color
-        m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
-        m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
-
-        QColor color = m_deviceGrayColorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
-        m_graphicState.setStrokeColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
-        m_graphicState.setFillColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
-    }
-
+    const int uncoloredTilingPatternFlag = initializeTilingPatternState(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
     updateGraphicState();
 
     // Mark uncolored flag, if we drawing uncolored color pattern
@@ -1105,6 +1445,12 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     const PDFInteger columns = qMax<PDFInteger>(qCeil(tilingArea.width() / xStep), 1);
     const PDFInteger rows = qMax<PDFInteger>(qCeil(tilingArea.height() / yStep), 1);
 
+    if (performTilingPatternPainting(tilingPattern, tilingArea, columns, rows, uncoloredPatternColorSpace, uncoloredPatternColor))
+    {
+        // Tiling pattern was painted without processing each cell
+        return;
+    }
+
     QTransform baseTransformationMatrix = m_graphicState.getCurrentTransformationMatrix();
     for (PDFInteger column = 0; column < columns; ++column)
     {
@@ -1138,20 +1484,107 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     }
 }
 
-void PDFPageContentProcessor::processCommand(const QByteArray& command)
+int PDFPageContentProcessor::initializeTilingPatternState(const PDFTilingPattern* tilingPattern,
+                                                          const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                          const PDFColor& uncoloredPatternColor)
 {
-    Operator op = Operator::Invalid;
+    // Initialize resources
+    const PDFObject& resources = tilingPattern->getResources();
+    if (!resources.isNull())
+    {
+        initDictionaries(resources);
+    }
 
-    // Find the command in the command array
-    for (const std::pair<const char*, PDFPageContentProcessor::Operator>& operatorDescriptor : operators)
+    // Initialize colors for uncolored color space pattern
+    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
     {
-        if (command == operatorDescriptor.first)
+        if (!uncoloredPatternColorSpace)
         {
-            op = operatorDescriptor.second;
-            break;
+            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Uncolored tiling pattern has not underlying color space."));
         }
+
+        m_graphicState.setStrokeColorSpace(uncoloredPatternColorSpace);
+        m_graphicState.setFillColorSpace(uncoloredPatternColorSpace);
+
+        QColor color = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, m_CMS, m_graphicState.getRenderingIntent(), this);
+        m_graphicState.setStrokeColor(color, uncoloredPatternColor);
+        m_graphicState.setFillColor(color, uncoloredPatternColor);
+
+        return 1;
+    }
+
+    // Jakub Melka: According the specification, we set default color space and default color
+    m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
+    m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
+
+    QColor color = m_deviceGrayColorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
+    m_graphicState.setStrokeColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
+    m_graphicState.setFillColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
+
+    return 0;
+}
+
+bool PDFPageContentProcessor::performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                                           const QRectF& tilingArea,
+                                                           PDFInteger columns,
+                                                           PDFInteger rows,
+                                                           const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                           const PDFColor& uncoloredPatternColor)
+{
+    Q_UNUSED(tilingPattern);
+    Q_UNUSED(tilingArea);
+    Q_UNUSED(columns);
+    Q_UNUSED(rows);
+    Q_UNUSED(uncoloredPatternColorSpace);
+    Q_UNUSED(uncoloredPatternColor);
+
+    return false;
+}
+
+QList<PDFRenderError> PDFPageContentProcessor::processTilingPatternCell(const PDFTilingPattern* tilingPattern,
+                                                                        const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                                        const PDFColor& uncoloredPatternColor)
+{
+    initializeProcessor();
+
+    try
+    {
+        const int uncoloredTilingPatternFlag = initializeTilingPatternState(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
+        updateGraphicState();
+
+        PDFTemporaryValueChange guard(&m_drawingUncoloredTilingPatternState, m_drawingUncoloredTilingPatternState + uncoloredTilingPatternFlag);
+
+        QPainterPath boundingPath;
+        boundingPath.addRect(tilingPattern->getBoundingBox());
+        performClipping(boundingPath, boundingPath.fillRule());
+        processContent(tilingPattern->getContent());
+    }
+    catch (const PDFException& exception)
+    {
+        addRenderError(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+    }
+    catch (const PDFRendererException& exception)
+    {
+        addRenderError(exception.getError());
+    }
+
+    return m_errorList;
+}
+
+PDFMesh PDFPageContentProcessor::createShadingMesh(const PDFShadingPattern* shadingPattern, const PDFMeshQualitySettings& settings)
+{
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ShadingMesh);
+
+    if (m_fontCache)
+    {
+        return m_fontCache->getMeshCache()->getMesh(shadingPattern, settings, m_pagePointToDevicePointMatrix, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
     }
 
+    return shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
+}
+
+void PDFPageContentProcessor::processCommand(Operator op, const QByteArray& command)
+{
     performInterceptInstruction(op, ProcessOrder::BeforeOperation, command);
     auto callInterceptInstAtEnd = qScopeGuard([&, this](){ performInterceptInstruction(op, ProcessOrder::AfterOperation, command); });
 
@@ -1612,13 +2045,13 @@ void PDFPageContentProcessor::processCommand(const QByteArray& command)
 
         case Operator::Invalid:
         {
-            m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Unknown operator '%1'.").arg(QString::fromLatin1(command))));
+            addRenderError(PDFRenderError(RenderErrorType::Error, QT_TRANSLATE_NOOP("pdf::PDFTranslationContext", "Unknown operator '%1'."), { QString::fromLatin1(command) }));
             break;
         }
 
         default:
         {
-            m_errorList.append(PDFRenderError(RenderErrorType::NotImplemented, PDFTranslationContext::tr("Not implemented operator '%1'.").arg(QString::fromLatin1(command))));
+            addRenderError(PDFRenderError(RenderErrorType::NotImplemented, QT_TRANSLATE_NOOP("pdf::PDFTranslationContext", "Not implemented operator '%1'."), { QString::fromLatin1(command) }));
             break;
         }
     }
@@ -1862,7 +2295,7 @@ void PDFPageContentProcessor::finishMarkedContent()
 {
     if (!m_markedContentStack.empty())
     {
-        m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Marked content is not well formed (not enough EMC operators).")));
+        addRenderError(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Marked content is not well formed (not enough EMC operators).")));
     }
 
     while (!m_markedContentStack.empty())
@@ -1945,7 +2378,7 @@ void PDFPageContentProcessor::processApplyGraphicState(const PDFDictionary* grap
         if (blendMode == BlendMode::Invalid)
         {
             blendMode = BlendMode::Normal;
-            m_errorList.append(PDFRenderError(RenderErrorType::NotImplemented, PDFTranslationContext::tr("Blend mode '%1' is invalid.").arg(QString::fromLatin1(blendModeName))));
+            addRenderError(PDFRenderError(RenderErrorType::NotImplemented, PDFTranslationContext::tr("Blend mode '%1' is invalid.").arg(QString::fromLatin1(blendModeName))));
         }
         m_graphicState.setBlendMode(blendMode);
     }
@@ -2400,7 +2833,7 @@ void PDFPageContentProcessor::operatorColorSetStrokingColorSpace(PDFPageContentP
     {
         // We must also set default color (it can depend on the color space)
         m_graphicState.setStrokeColorSpace(colorSpace);
-        m_graphicState.setStrokeColor(colorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this), colorSpace->getDefaultColorOriginal());
+        m_graphicState.setStrokeColor(getDefaultColor(colorSpace.get()), colorSpace->getDefaultColorOriginal());
         updateGraphicState();
         checkStrokingColor();
     }
@@ -2423,7 +2856,7 @@ void PDFPageContentProcessor::operatorColorSetFillingColorSpace(PDFOperandName n
     {
         // We must also set default color (it can depend on the color space)
         m_graphicState.setFillColorSpace(colorSpace);
-        m_graphicState.setFillColor(colorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this), colorSpace->getDefaultColorOriginal());
+        m_graphicState.setFillColor(getDefaultColor(colorSpace.get()), colorSpace->getDefaultColorOriginal());
         updateGraphicState();
         checkFillingColor();
     }
@@ -2452,7 +2885,7 @@ void PDFPageContentProcessor::operatorColorSetStrokingColor()
         {
             color.push_back(readOperand<PDFReal>(i));
         }
-        m_graphicState.setStrokeColor(colorSpace->getColor(color, m_CMS, m_graphicState.getRenderingIntent(), this, true), color);
+        m_graphicState.setStrokeColor(getColor(colorSpace, color), color);
         updateGraphicState();
         checkStrokingColor();
     }
@@ -2491,6 +2924,12 @@ void PDFPageContentProcessor::operatorColorSetStrokingColorN()
             PDFOperandName name = readOperand<PDFOperandName>(operandCount - 1);
             if (m_patternDictionary && m_patternDictionary->hasKey(name.name))
             {
+                if (m_isTextOnlyProcessing)
+                {
+                    // Patterns are never painted in text only processing
+                    return;
+                }
+
                 // Create the pattern
                 PDFPatternPtr pattern = PDFPattern::createPattern(m_colorSpaceDictionary, m_document, m_patternDictionary->get(name.name), m_CMS, m_graphicState.getRenderingIntent(), this);
                 m_graphicState.setStrokeColorSpace(PDFColorSpacePointer(new PDFPatternColorSpace(qMove(pattern), qMove(uncoloredColorSpace), qMove(uncoloredPatternColor))));
@@ -2530,7 +2969,7 @@ void PDFPageContentProcessor::operatorColorSetFillingColor()
         {
             color.push_back(readOperand<PDFReal>(i));
         }
-        m_graphicState.setFillColor(colorSpace->getColor(color, m_CMS, m_graphicState.getRenderingIntent(), this, true), color);
+        m_graphicState.setFillColor(getColor(colorSpace, color), color);
         updateGraphicState();
         checkFillingColor();
     }
@@ -2569,6 +3008,12 @@ void PDFPageContentProcessor::operatorColorSetFillingColorN()
             PDFOperandName name = readOperand<PDFOperandName>(operandCount - 1);
             if (m_patternDictionary && m_patternDictionary->hasKey(name.name))
             {
+                if (m_isTextOnlyProcessing)
+                {
+                    // Patterns are never painted in text only processing
+                    return;
+                }
+
                 // Create the pattern
                 PDFPatternPtr pattern = PDFPattern::createPattern(m_colorSpaceDictionary, m_document, m_patternDictionary->get(name.name), m_CMS, m_graphicState.getRenderingIntent(), this);
                 m_graphicState.setFillColorSpace(QSharedPointer<PDFAbstractColorSpace>(new PDFPatternColorSpace(qMove(pattern), qMove(uncoloredColorSpace), qMove(uncoloredPatternColor))));
@@ -2765,7 +3210,7 @@ void PDFPageContentProcessor::operatorTextSetFontAndFontSize(PDFOperandName font
         }
         else
         {
-            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Font '%1' not found in font dictionary.").arg(QString::fromLatin1(fontName.name)));
+            throw PDFRendererException(PDFRenderError(RenderErrorType::Error, QT_TRANSLATE_NOOP("pdf::PDFTranslationContext", "Font '%1' not found in font dictionary."), { QString::fromLatin1(fontName.name) }));
         }
     }
     else
@@ -2946,7 +3391,7 @@ void PDFPageContentProcessor::operatorTextSetSpacingAndShowText(PDFReal t_w, PDF
 
 void PDFPageContentProcessor::operatorShadingPaintShape(PDFPageContentProcessor::PDFOperandName name)
 {
-    if (isContentKindSuppressed(ContentKind::Shading))
+    if (m_isTextOnlyProcessing || isContentKindSuppressed(ContentKind::Shading))
     {
         // Shadings are suppressed
         return;
@@ -2980,7 +3425,7 @@ void PDFPageContentProcessor::operatorShadingPaintShape(PDFPageContentProcessor:
 
 void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
 {
-    if (isContentKindSuppressed(ContentKind::Images))
+    if (m_isTextOnlyProcessing || isContentKindSuppressed(ContentKind::Images))
     {
         // Images are suppressed
         return;
@@ -3002,37 +3447,71 @@ void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
         }
     }
 
-    PDFImage pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, m_graphicState.getRenderingIntent(), this);
+    const RenderingIntent renderingIntent = m_graphicState.getRenderingIntent();
 
-    if (!performOriginalImagePainting(pdfImage, stream))
+    QImage image;
+    if (!isOriginalImagePaintingUsed() && m_fontCache)
     {
-        QImage image = pdfImage.getImage(m_CMS, this, m_operationControl);
+        const QSize targetSize = getImageDeviceSize(stream);
+        const int resolutionReductionLevel = PDFImage::getResolutionReductionLevel(m_document, stream, targetSize);
+        const bool isSoftMaskIgnored = isImageSoftMaskIgnored();
 
-        if (!isProcessingCancelled())
+        auto createImage = [this, stream, renderingIntent, targetSize, isSoftMaskIgnored, &colorSpace]()
         {
-            if (image.format() == QImage::Format_Alpha8)
-            {
-                QSize size = image.size();
-                QImage unmaskedImage(size, QImage::Format_ARGB32_Premultiplied);
-                unmaskedImage.fill(m_graphicState.getFillColor());
-                unmaskedImage.setAlphaChannel(image);
-                image = qMove(unmaskedImage);
-            }
+            PDFImage pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, renderingIntent, this, targetSize, isSoftMaskIgnored);
+            return pdfImage.getImage(m_CMS, this, m_operationControl);
+        };
 
-            if (!image.isNull())
-            {
-                if (PDFImage::canBeConvertedToMonochromatic(image))
-                {
-                    image.convertTo(QImage::Format_Mono);
-                }
+        // Color space given by name is resolved in the resources, so
+        // the same image can have different color spaces on different pages.
+        const void* colorSpaceContext = streamDictionary->hasKey("ColorSpace") ? m_colorSpaceDictionary : nullptr;
+        image = m_fontCache->getImageCache()->getImage(stream, colorSpaceContext, m_CMS, renderingIntent, resolutionReductionLevel, isSoftMaskIgnored, m_operationControl, createImage);
+    }
+    else
+    {
+        PDFImage pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, renderingIntent, this);
+        if (performOriginalImagePainting(pdfImage, stream))
+        {
+            return;
+        }
 
-                performImagePainting(image);
-            }
-            else
+        image = pdfImage.getImage(m_CMS, this, m_operationControl);
+    }
+
+    if (isProcessingCancelled())
+    {
+        return;
+    }
+
+    // Image mask is 1-bit image with transparent color in the color table,
+    // it is painted with the fill color, so only its color table is changed.
+    const bool isImageMask = image.format() == QImage::Format_Mono && image.hasAlphaChannel();
+    if (isImageMask)
+    {
+        const QRgb fillColor = m_graphicState.getFillColor().rgba();
+        QList<QRgb> colorTable = image.colorTable();
+        for (QRgb& color : colorTable)
+        {
+            if (qAlpha(color) > 0)
             {
-                throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Can't decode the image."));
+                color = fillColor;
             }
         }
+        image.setColorTable(colorTable);
+    }
+
+    if (!image.isNull())
+    {
+        if (!isImageMask && PDFImage::canBeConvertedToMonochromatic(image))
+        {
+            image.convertTo(QImage::Format_Mono);
+        }
+
+        performImagePainting(image);
+    }
+    else
+    {
+        throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Can't decode the image."));
     }
 }
 
@@ -3053,7 +3532,7 @@ void PDFPageContentProcessor::processForm(const PDFStream* stream)
     const PDFDictionary* streamDictionary = stream->getDictionary();
 
     // Read the bounding rectangle, if it is present
-    QRectF boundingBox = loader.readRectangle(streamDictionary->get("BBox"), QRectF());
+    QRectF boundingBox = loader.readRectangle(streamDictionary->get(PDFNames::BBox), QRectF());
 
     // Read the transformation matrix, if it is present
     QTransform transformationMatrix = loader.readMatrixFromDictionary(streamDictionary, "Matrix", QTransform());
@@ -3062,15 +3541,15 @@ void PDFPageContentProcessor::processForm(const PDFStream* stream)
     QByteArray content = m_document->getDecodedStream(stream);
 
     // Read resources
-    PDFObject resources = m_document->getObject(streamDictionary->get("Resources"));
+    PDFObject resources = m_document->getObject(streamDictionary->get(PDFNames::Resources));
 
     // Transparency group
-    PDFObject transparencyGroup = m_document->getObject(streamDictionary->get("Group"));
+    PDFObject transparencyGroup = m_document->getObject(streamDictionary->get(PDFNames::Group));
 
     // Form structural parent key
     const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(streamDictionary, "StructParent", m_structuralParentKey);
 
-    processForm(transformationMatrix, boundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+    processForm(transformationMatrix, boundingBox, resources, transparencyGroup, content, formStructuralParentKey, stream);
 }
 
 void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
@@ -3080,22 +3559,31 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
 
     if (m_xobjectDictionary)
     {
-        const PDFObject& object = m_document->getObject(m_xobjectDictionary->get(name.name));
+        const PDFObject& xobject = m_xobjectDictionary->get(name.name);
+        const PDFObjectReference xobjectReference = xobject.isReference() ? xobject.getReference() : PDFObjectReference();
+        const PDFObject& object = m_document->getObject(xobject);
         if (object.isStream())
         {
             const PDFStream* stream = object.getStream();
             const PDFDictionary* streamDictionary = stream->getDictionary();
 
             // According to the specification, XObjects are skipped entirely, as no operator was invoked.
-            if (streamDictionary->hasKey("OC"))
+            // Visible XObject is processed as if it was enclosed in the optional content section,
+            // so optional content of its graphics can be determined.
+            const size_t markedContentStackSize = m_markedContentStack.size();
+            auto markedContentGuard = qScopeGuard([this, markedContentStackSize]() { m_markedContentStack.resize(qMin(m_markedContentStack.size(), markedContentStackSize)); });
+
+            if (streamDictionary->hasKey(PDFNames::OC))
             {
-                const PDFObject& optionalContentObject = streamDictionary->get("OC");
+                const PDFObject& optionalContentObject = streamDictionary->get(PDFNames::OC);
                 if (optionalContentObject.isReference())
                 {
                     if (isContentSuppressedByOC(optionalContentObject.getReference()))
                     {
                         return;
                     }
+
+                    m_markedContentStack.emplace_back("OC", MarkedContentKind::OptionalContent, false, optionalContentObject.getReference());
                 }
                 else
                 {
@@ -3107,7 +3595,11 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
             QByteArray subtype = loader.readNameFromDictionary(streamDictionary, "Subtype");
             if (subtype == "Image")
             {
-                paintXObjectImage(stream);
+                if (!isImageXObjectSkipped(xobjectReference, stream))
+                {
+                    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::ImageDecoding, xobjectReference);
+                    paintXObjectImage(stream);
+                }
             }
             else if (subtype == "Form")
             {
@@ -3165,7 +3657,7 @@ void PDFPageContentProcessor::operatorMarkedContentBeginWithProperties(PDFOperan
             }
         }
 
-        m_markedContentStack.emplace_back(name.name, MarkedContentKind::OptionalContent, isContentSuppressedByOC(ocg));
+        m_markedContentStack.emplace_back(name.name, MarkedContentKind::OptionalContent, isContentSuppressedByOC(ocg), ocg);
     }
     else
     {
@@ -3199,6 +3691,98 @@ void PDFPageContentProcessor::operatorCompatibilityEnd()
     }
 }
 
+/// Converts glyph of the type 3 font to the outline. Only uncolored glyphs (glyphs
+/// using d1 operator), which only fill paths, can be converted. Colored glyphs (d0),
+/// or glyphs, which stroke paths, use clipping, paint images or shadings, can't
+/// be represented by the outline, and they must be painted by executing their content stream.
+/// In draft mode, glyphs, which stroke paths or use clipping, are approximated by the outline.
+class PDFType3GlyphOutlineExtractor : public PDFPageContentProcessor
+{
+public:
+    using PDFPageContentProcessor::PDFPageContentProcessor;
+
+    /// Processes glyph content stream and returns glyph outline in glyph space.
+    /// If glyph can't be converted to the outline, nullptr is returned.
+    /// \param resources Font resources
+    /// \param content Glyph content stream
+    PDFType3Font::GlyphOutline extract(const PDFObject& resources, const QByteArray& content)
+    {
+        initializeProcessor();
+        processForm(QTransform(), QRectF(), resources, PDFObject(), content, 0);
+
+        if (m_failed || !m_isUncolored)
+        {
+            return nullptr;
+        }
+
+        return std::make_shared<const QPainterPath>(qMove(m_outline));
+    }
+
+    /// Sets draft mode. In draft mode, glyph is approximated by the outline,
+    /// stroked paths are converted to filled outlines and clipping is ignored.
+    void setDraft(bool draft) { m_isDraft = draft; }
+
+protected:
+    virtual void performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule) override
+    {
+        Q_UNUSED(fillRule);
+
+        if ((stroke && !m_isDraft) || text || getGraphicState()->getFillColorSpace()->asPatternColorSpace())
+        {
+            m_failed = true;
+            return;
+        }
+
+        QPainterPath outline = fill ? path : QPainterPath();
+        if (stroke)
+        {
+            const PDFReal lineWidth = getGraphicState()->getLineWidth();
+            if (lineWidth <= 0.0 || getGraphicState()->getStrokeColorSpace()->asPatternColorSpace())
+            {
+                // Hairlines can't be represented by the outline
+                m_failed = true;
+                return;
+            }
+
+            QPainterPathStroker stroker;
+            stroker.setWidth(lineWidth);
+            stroker.setCapStyle(getGraphicState()->getLineCapStyle());
+            stroker.setJoinStyle(getGraphicState()->getLineJoinStyle());
+            stroker.setMiterLimit(getGraphicState()->getMitterLimit());
+
+            const PDFLineDashPattern& lineDashPattern = getGraphicState()->getLineDashPattern();
+            if (!lineDashPattern.isSolid())
+            {
+                stroker.setDashPattern(lineDashPattern.createForQPen(lineWidth));
+                stroker.setDashOffset(lineDashPattern.getDashOffset());
+            }
+
+            QPainterPath strokedPath = stroker.createStroke(path);
+            outline = outline.isEmpty() ? strokedPath : outline.united(strokedPath);
+        }
+
+        // Paths can have different fill rules, so we unite them
+        m_outline = m_outline.isEmpty() ? outline : m_outline.united(outline);
+    }
+
+    virtual bool performPathPaintingUsingShading(const QPainterPath&, bool, bool, const PDFShadingPattern*) override { m_failed = true; return true; }
+    virtual void performClipping(const QPainterPath&, Qt::FillRule) override { m_failed = m_failed || !m_isDraft; }
+    virtual bool isOriginalImagePaintingUsed() const override { return true; }
+    virtual bool performOriginalImagePainting(const PDFImage&, const PDFStream*) override { m_failed = true; return true; }
+    virtual void performImagePainting(const QImage&) override { m_failed = true; }
+    virtual void performMeshPainting(const PDFMesh&) override { m_failed = true; }
+    virtual void performMarkedContentBegin(const QByteArray&, const PDFObject&) override { m_failed = true; }
+    virtual void performBeginTransparencyGroup(ProcessOrder, const PDFTransparencyGroup&) override { m_failed = true; }
+    virtual void performSetCharWidth(PDFReal, PDFReal) override { m_failed = true; }
+    virtual void performSetCacheDevice(PDFReal, PDFReal, PDFReal, PDFReal, PDFReal, PDFReal) override { m_isUncolored = true; }
+
+private:
+    QPainterPath m_outline;
+    bool m_isUncolored = false;
+    bool m_isDraft = false;
+    bool m_failed = false;
+};
+
 void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
 {
     if (textSequence.items.empty())
@@ -3207,6 +3791,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
         return;
     }
 
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::Text);
     performProcessTextSequence(textSequence, ProcessOrder::BeforeOperation);
 
     const PDFRealizedFontPointer& font = getRealizedFont();
@@ -3263,16 +3848,27 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                         QTransform textRenderingMatrix = adjustMatrix * textMatrix;
                         QTransform toDeviceSpaceTransform = textRenderingMatrix * m_graphicState.getCurrentTransformationMatrix();
 
-                        if (!glyphPath.isEmpty())
+                        if (!glyphPath.isEmpty() && !m_isTextOnlyProcessing)
                         {
                             QPainterPath transformedGlyph = textRenderingMatrix.map(glyphPath);
+
+                            // Filled glyphs can be painted using glyph cache,
+                            // so we provide glyph identification to the painter.
+                            TextGlyph textGlyph;
+                            textGlyph.fontId = font->getUniqueId();
+                            textGlyph.cid = item.cid;
+                            textGlyph.outline = &glyphPath;
+                            textGlyph.glyphMatrix = textRenderingMatrix;
+
+                            m_currentTextGlyph = (fill && !stroke && !clipped) ? &textGlyph : nullptr;
                             processPathPainting(transformedGlyph, stroke, fill, true, transformedGlyph.fillRule());
+                            m_currentTextGlyph = nullptr;
+                        }
 
-                            if (clipped)
-                            {
-                                // Clipping is enabled, we must transform to the device coordinates
-                                m_textClippingPath = m_textClippingPath.united(toDeviceSpaceTransform.map(glyphPath));
-                            }
+                        if (!glyphPath.isEmpty() && clipped)
+                        {
+                            // Clipping is enabled, we must transform to the device coordinates
+                            m_textClippingPath = m_textClippingPath.united(toDeviceSpaceTransform.map(glyphPath));
                         }
 
                         if (!item.character.isNull())
@@ -3349,16 +3945,63 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
 
                 if (item.characterContentStream && (fill || stroke))
                 {
-                    PDFPageContentProcessorStateGuard guard2(this);
+                    QTransform worldMatrix = fontAdjustedMatrix * textMatrix * m_graphicState.getCurrentTransformationMatrix();
 
-                    // We must clear operands, because we are processing a new content stream
-                    m_operands.clear();
+                    // Uncolored glyphs, which only fill paths, are converted to the outline once
+                    // and then painted as ordinary glyphs. This way, they can use glyph cache.
+                    PDFType3Font::GlyphOutline glyphOutline;
+                    if (!m_isTextOnlyProcessing && fill && !stroke && !clipped)
+                    {
+                        auto createGlyphOutline = [this, parentFont, &item](bool isDraft)
+                        {
+                            PDFType3GlyphOutlineExtractor extractor(m_page, m_document, m_fontCache, m_CMS, m_optionalContentActivity, QTransform(), m_meshQualitySettings);
+                            extractor.setDraft(isDraft);
+                            return extractor.extract(parentFont->getResources(), *item.characterContentStream);
+                        };
 
-                    QTransform worldMatrix = fontAdjustedMatrix * textMatrix * m_graphicState.getCurrentTransformationMatrix();
-                    m_graphicState.setCurrentTransformationMatrix(worldMatrix);
-                    updateGraphicState();
+                        glyphOutline = parentFont->getGlyphOutline(item.cid, false, [&createGlyphOutline]() { return createGlyphOutline(false); });
+
+                        // Detail of the glyph is capped, glyph is approximated by the outline. Exact outline
+                        // doesn't exist for this glyph, so glyph cache will not contain different outlines.
+                        if (!glyphOutline && isType3GlyphDetailCapped())
+                        {
+                            glyphOutline = parentFont->getGlyphOutline(item.cid, true, [&createGlyphOutline]() { return createGlyphOutline(true); });
+                        }
+                    }
+
+                    if (glyphOutline)
+                    {
+                        if (!glyphOutline->isEmpty())
+                        {
+                            QTransform glyphMatrix = fontAdjustedMatrix * textMatrix;
+                            QPainterPath transformedGlyph = glyphMatrix.map(*glyphOutline);
+
+                            TextGlyph textGlyph;
+                            textGlyph.fontId = font->getUniqueId();
+                            textGlyph.cid = item.cid;
+                            textGlyph.outline = glyphOutline.get();
+                            textGlyph.glyphMatrix = glyphMatrix;
+
+                            m_currentTextGlyph = &textGlyph;
+                            processPathPainting(transformedGlyph, false, true, true, transformedGlyph.fillRule());
+                            m_currentTextGlyph = nullptr;
+                        }
+                    }
+                    else if (!m_isTextOnlyProcessing)
+                    {
+                        // Glyph procedure only paints the glyph, so it is not executed in text only processing
+                        PDFPageContentProcessorStateGuard guard2(this);
 
-                    processContent(*item.characterContentStream);
+                        // We must clear operands, because we are processing a new content stream
+                        m_operands.clear();
+
+                        m_graphicState.setCurrentTransformationMatrix(worldMatrix);
+                        updateGraphicState();
+
+                        // Glyph content streams are owned by the font, so font keeps them alive
+                        const PDFFontPointer& font = m_graphicState.getTextFont();
+                        processCachedContent(item.characterContentStream, *item.characterContentStream, [&font]() -> std::shared_ptr<const void> { return std::make_shared<const PDFFontPointer>(font); });
+                    }
 
                     if (!item.character.isNull())
                     {
@@ -3398,6 +4041,26 @@ PDFRealizedFontPointer PDFPageContentProcessor::getRealizedFontImpl()
     return PDFRealizedFontPointer();
 }
 
+QColor PDFPageContentProcessor::getColor(const PDFAbstractColorSpace* colorSpace, const PDFColor& color)
+{
+    if (m_isTextOnlyProcessing)
+    {
+        return QColor(Qt::black);
+    }
+
+    return colorSpace->getColor(color, m_CMS, m_graphicState.getRenderingIntent(), this, true);
+}
+
+QColor PDFPageContentProcessor::getDefaultColor(const PDFAbstractColorSpace* colorSpace)
+{
+    if (m_isTextOnlyProcessing)
+    {
+        return QColor(Qt::black);
+    }
+
+    return colorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
+}
+
 void PDFPageContentProcessor::checkStrokingColor()
 {
     if (!m_graphicState.getStrokeColor().isValid())
@@ -3437,69 +4100,31 @@ bool PDFPageContentProcessor::isContentSuppressedByOC(PDFObjectReference ocgOrOc
         return false;
     }
 
-    if (m_optionalContentActivity->getProperties()->hasOptionalContentGroup(ocgOrOcmd))
-    {
-        // Simplest case - we have single optional content group
-        return m_optionalContentActivity->getState(ocgOrOcmd) == OCState::OFF;
-    }
+    // Membership dictionaries are parsed and evaluated only once
+    // for the current state of optional content groups.
+    QString errorMessage;
+    const OCState state = m_optionalContentActivity->getVisibilityState(ocgOrOcmd, &errorMessage);
 
-    PDFOptionalContentMembershipObject ocmd;
-    try
+    if (!errorMessage.isEmpty())
     {
-        ocmd = PDFOptionalContentMembershipObject::create(m_document, PDFObject::createReference(ocgOrOcmd));
-    }
-    catch (const PDFException &e)
-    {
-        m_errorList.push_back(PDFRenderError(RenderErrorType::Error, e.getMessage()));
+        addRenderError(PDFRenderError(RenderErrorType::Error, errorMessage));
     }
 
-    if (ocmd.isValid())
-    {
-        return ocmd.evaluate(m_optionalContentActivity) == OCState::OFF;
-    }
-
-    return false;
+    return state == OCState::OFF;
 }
 
 PDFPageContentProcessorState::PDFPageContentProcessorState() :
-    m_currentTransformationMatrix(),
-    m_strokeColorSpace(),
-    m_fillColorSpace(),
-    m_strokeColor(Qt::black),
-    m_strokeColorOriginal(),
-    m_fillColor(Qt::black),
-    m_fillColorOriginal(),
-    m_lineWidth(1.0),
-    m_lineCapStyle(Qt::FlatCap),
-    m_lineJoinStyle(Qt::MiterJoin),
-    m_mitterLimit(10.0),
-    m_renderingIntentName(),
-    m_flatness(1.0),
-    m_smoothness(0.01),
-    m_textCharacterSpacing(0.0),
-    m_textWordSpacing(0.0),
-    m_textHorizontalScaling(100.0),
-    m_textLeading(0.0),
-    m_textFontSize(0.0),
-    m_textRenderingMode(TextRenderingMode::Fill),
-    m_textRise(0.0),
-    m_textKnockout(true),
-    m_alphaStroking(1.0),
-    m_alphaFilling(1.0),
-    m_blendMode(BlendMode::Normal),
-    m_renderingIntent(RenderingIntent::Perceptual),
-    m_overprintMode(),
-    m_alphaIsShape(false),
-    m_strokeAdjustment(false),
-    m_softMask(nullptr),
-    m_blackPointCompensationMode(BlackPointCompensationMode::Default),
+    m_color(new ColorState()),
+    m_line(new LineState()),
+    m_text(new TextState()),
+    m_extended(new ExtendedState()),
     m_stateFlags(StateUnchanged)
 {
-    m_fillColorSpace.reset(new PDFDeviceGrayColorSpace);
-    m_strokeColorSpace = m_fillColorSpace;
+    m_color->fillColorSpace.reset(new PDFDeviceGrayColorSpace);
+    m_color->strokeColorSpace = m_color->fillColorSpace;
 
-    m_fillColorOriginal = m_fillColorSpace->getDefaultColorOriginal();
-    m_strokeColorOriginal = m_fillColorOriginal;
+    m_color->fillColorOriginal = m_color->fillColorSpace->getDefaultColorOriginal();
+    m_color->strokeColorOriginal = m_color->fillColorOriginal;
 }
 
 PDFPageContentProcessorState::~PDFPageContentProcessorState()
@@ -3516,43 +4141,121 @@ PDFPageContentProcessorState& PDFPageContentProcessorState::operator=(const PDFP
 void PDFPageContentProcessorState::setState(const PDFPageContentProcessorState& state)
 {
     setCurrentTransformationMatrix(state.getCurrentTransformationMatrix());
-    setStrokeColorSpace(state.m_strokeColorSpace);
-    setFillColorSpace(state.m_fillColorSpace);
-    setStrokeColor(state.getStrokeColor(), state.getStrokeColorOriginal());
-    setFillColor(state.getFillColor(), state.getFillColorOriginal());
-    setLineWidth(state.getLineWidth());
-    setLineCapStyle(state.getLineCapStyle());
-    setLineJoinStyle(state.getLineJoinStyle());
-    setMitterLimit(state.getMitterLimit());
-    setLineDashPattern(state.getLineDashPattern());
-    setRenderingIntentName(state.getRenderingIntentName());
-    setFlatness(state.getFlatness());
-    setSmoothness(state.getSmoothness());
-    setTextCharacterSpacing(state.getTextCharacterSpacing());
-    setTextWordSpacing(state.getTextWordSpacing());
-    setTextHorizontalScaling(state.getTextHorizontalScaling());
-    setTextLeading(state.getTextLeading());
-    setTextFont(state.getTextFont());
-    setTextFontSize(state.getTextFontSize());
-    setTextRenderingMode(state.getTextRenderingMode());
-    setTextRise(state.getTextRise());
-    setTextKnockout(state.getTextKnockout());
     setTextMatrix(state.getTextMatrix());
     setTextLineMatrix(state.getTextLineMatrix());
-    setAlphaStroking(state.getAlphaStroking());
-    setAlphaFilling(state.getAlphaFilling());
-    setBlendMode(state.getBlendMode());
-    setRenderingIntent(state.getRenderingIntent());
-    setOverprintMode(state.getOverprintMode());
-    setAlphaIsShape(state.getAlphaIsShape());
-    setStrokeAdjustment(state.getStrokeAdjustment());
-    setSoftMask(state.getSoftMask());
-    setBlackPointCompensationMode(state.getBlackPointCompensationMode());
-    setBlackGenerationFunction(state.getBlackGenerationFunction());
-    setUndercolorRemovalFunction(state.getUndercolorRemovalFunction());
-    setTransferFunction(state.getTransferFunction());
-    setHalftone(state.getHalftone());
-    setHalftoneOrigin(state.getHalftoneOrigin());
+
+    // Shared blocks are not copied, we just compare them to determine,
+    // which parameters were changed, and then share block of the other state.
+    if (m_color != state.m_color)
+    {
+        m_stateFlags |= m_color.constData()->getChangedFlags(*state.m_color.constData());
+        m_color = state.m_color;
+    }
+
+    if (m_line != state.m_line)
+    {
+        m_stateFlags |= m_line.constData()->getChangedFlags(*state.m_line.constData());
+        m_line = state.m_line;
+    }
+
+    if (m_text != state.m_text)
+    {
+        m_stateFlags |= m_text.constData()->getChangedFlags(*state.m_text.constData());
+        m_text = state.m_text;
+    }
+
+    if (m_extended != state.m_extended)
+    {
+        m_stateFlags |= m_extended.constData()->getChangedFlags(*state.m_extended.constData());
+        m_extended = state.m_extended;
+    }
+}
+
+PDFPageContentProcessorState::StateFlags PDFPageContentProcessorState::getDifferenceFlags(const PDFPageContentProcessorState& state) const
+{
+    StateFlags flags = StateUnchanged;
+    flags.setFlag(StateCurrentTransformationMatrix, m_currentTransformationMatrix != state.m_currentTransformationMatrix);
+
+    if (m_color != state.m_color)
+    {
+        flags |= m_color.constData()->getChangedFlags(*state.m_color.constData());
+    }
+
+    if (m_line != state.m_line)
+    {
+        flags |= m_line.constData()->getChangedFlags(*state.m_line.constData());
+    }
+
+    if (m_text != state.m_text)
+    {
+        flags |= m_text.constData()->getChangedFlags(*state.m_text.constData());
+    }
+
+    if (m_extended != state.m_extended)
+    {
+        flags |= m_extended.constData()->getChangedFlags(*state.m_extended.constData());
+    }
+
+    return flags;
+}
+
+PDFPageContentProcessorState::StateFlags PDFPageContentProcessorState::ColorState::getChangedFlags(const ColorState& other) const
+{
+    StateFlags flags = StateUnchanged;
+    flags.setFlag(StateStrokeColorSpace, strokeColorSpace != other.strokeColorSpace);
+    flags.setFlag(StateFillColorSpace, fillColorSpace != other.fillColorSpace);
+    flags.setFlag(StateStrokeColor, strokeColor != other.strokeColor || strokeColorOriginal != other.strokeColorOriginal);
+    flags.setFlag(StateFillColor, fillColor != other.fillColor || fillColorOriginal != other.fillColorOriginal);
+    flags.setFlag(StateRenderingIntentName, renderingIntentName != other.renderingIntentName);
+    flags.setFlag(StateRenderingIntent, renderingIntent != other.renderingIntent);
+    return flags;
+}
+
+PDFPageContentProcessorState::StateFlags PDFPageContentProcessorState::LineState::getChangedFlags(const LineState& other) const
+{
+    StateFlags flags = StateUnchanged;
+    flags.setFlag(StateLineWidth, lineWidth != other.lineWidth);
+    flags.setFlag(StateLineCapStyle, lineCapStyle != other.lineCapStyle);
+    flags.setFlag(StateLineJoinStyle, lineJoinStyle != other.lineJoinStyle);
+    flags.setFlag(StateMitterLimit, mitterLimit != other.mitterLimit);
+    flags.setFlag(StateLineDashPattern, lineDashPattern != other.lineDashPattern);
+    flags.setFlag(StateFlatness, flatness != other.flatness);
+    flags.setFlag(StateSmoothness, smoothness != other.smoothness);
+    flags.setFlag(StateStrokeAdjustment, strokeAdjustment != other.strokeAdjustment);
+    return flags;
+}
+
+PDFPageContentProcessorState::StateFlags PDFPageContentProcessorState::TextState::getChangedFlags(const TextState& other) const
+{
+    StateFlags flags = StateUnchanged;
+    flags.setFlag(StateTextCharacterSpacing, textCharacterSpacing != other.textCharacterSpacing);
+    flags.setFlag(StateTextWordSpacing, textWordSpacing != other.textWordSpacing);
+    flags.setFlag(StateTextHorizontalScaling, textHorizontalScaling != other.textHorizontalScaling);
+    flags.setFlag(StateTextLeading, textLeading != other.textLeading);
+    flags.setFlag(StateTextFont, textFont != other.textFont);
+    flags.setFlag(StateTextFontSize, textFontSize != other.textFontSize);
+    flags.setFlag(StateTextRenderingMode, textRenderingMode != other.textRenderingMode);
+    flags.setFlag(StateTextRise, textRise != other.textRise);
+    flags.setFlag(StateTextKnockout, textKnockout != other.textKnockout);
+    return flags;
+}
+
+PDFPageContentProcessorState::StateFlags PDFPageContentProcessorState::ExtendedState::getChangedFlags(const ExtendedState& other) const
+{
+    StateFlags flags = StateUnchanged;
+    flags.setFlag(StateAlphaStroking, alphaStroking != other.alphaStroking);
+    flags.setFlag(StateAlphaFilling, alphaFilling != other.alphaFilling);
+    flags.setFlag(StateBlendMode, blendMode != other.blendMode);
+    flags.setFlag(StateOverprint, overprintMode != other.overprintMode);
+    flags.setFlag(StateAlphaIsShape, alphaIsShape != other.alphaIsShape);
+    flags.setFlag(StateSoftMask, softMask != other.softMask);
+    flags.setFlag(StateBlackPointCompensation, blackPointCompensationMode != other.blackPointCompensationMode);
+    flags.setFlag(StateBlackGenerationFunction, blackGenerationFunction != other.blackGenerationFunction);
+    flags.setFlag(StateUndercolorRemovalFunction, undercolorRemovalFunction != other.undercolorRemovalFunction);
+    flags.setFlag(StateTransferFunction, transferFunction != other.transferFunction);
+    flags.setFlag(StateHalftone, halftone != other.halftone);
+    flags.setFlag(StateHalftoneOrigin, halftoneOrigin != other.halftoneOrigin);
+    return flags;
 }
 
 void PDFPageContentProcessorState::setCurrentTransformationMatrix(const QTransform& currentTransformationMatrix)
@@ -3566,137 +4269,137 @@ void PDFPageContentProcessorState::setCurrentTransformationMatrix(const QTransfo
 
 void PDFPageContentProcessorState::setStrokeColorSpace(const QSharedPointer<PDFAbstractColorSpace>& strokeColorSpace)
 {
-    if (m_strokeColorSpace != strokeColorSpace)
+    if (m_color.constData()->strokeColorSpace != strokeColorSpace)
     {
-        m_strokeColorSpace = strokeColorSpace;
+        m_color->strokeColorSpace = strokeColorSpace;
         m_stateFlags |= StateStrokeColorSpace;
     }
 }
 
 void PDFPageContentProcessorState::setFillColorSpace(const QSharedPointer<PDFAbstractColorSpace>& fillColorSpace)
 {
-    if (m_fillColorSpace != fillColorSpace)
+    if (m_color.constData()->fillColorSpace != fillColorSpace)
     {
-        m_fillColorSpace = fillColorSpace;
+        m_color->fillColorSpace = fillColorSpace;
         m_stateFlags |= StateFillColorSpace;
     }
 }
 
 void PDFPageContentProcessorState::setStrokeColor(const QColor& strokeColor, const PDFColor& originalColor)
 {
-    if (m_strokeColor != strokeColor || m_strokeColorOriginal != originalColor)
+    if (m_color.constData()->strokeColor != strokeColor || m_color.constData()->strokeColorOriginal != originalColor)
     {
-        m_strokeColor = strokeColor;
-        m_strokeColorOriginal = originalColor;
+        m_color->strokeColor = strokeColor;
+        m_color->strokeColorOriginal = originalColor;
         m_stateFlags |= StateStrokeColor;
     }
 }
 
 void PDFPageContentProcessorState::setFillColor(const QColor& fillColor, const PDFColor& originalColor)
 {
-    if (m_fillColor != fillColor || m_fillColorOriginal != originalColor)
+    if (m_color.constData()->fillColor != fillColor || m_color.constData()->fillColorOriginal != originalColor)
     {
-        m_fillColor = fillColor;
-        m_fillColorOriginal = originalColor;
+        m_color->fillColor = fillColor;
+        m_color->fillColorOriginal = originalColor;
         m_stateFlags |= StateFillColor;
     }
 }
 
 void PDFPageContentProcessorState::setLineWidth(PDFReal lineWidth)
 {
-    if (m_lineWidth != lineWidth)
+    if (m_line.constData()->lineWidth != lineWidth)
     {
-        m_lineWidth = lineWidth;
+        m_line->lineWidth = lineWidth;
         m_stateFlags |= StateLineWidth;
     }
 }
 
 void PDFPageContentProcessorState::setLineCapStyle(Qt::PenCapStyle lineCapStyle)
 {
-    if (m_lineCapStyle != lineCapStyle)
+    if (m_line.constData()->lineCapStyle != lineCapStyle)
     {
-        m_lineCapStyle = lineCapStyle;
+        m_line->lineCapStyle = lineCapStyle;
         m_stateFlags |= StateLineCapStyle;
     }
 }
 
 void PDFPageContentProcessorState::setLineJoinStyle(Qt::PenJoinStyle lineJoinStyle)
 {
-    if (m_lineJoinStyle != lineJoinStyle)
+    if (m_line.constData()->lineJoinStyle != lineJoinStyle)
     {
-        m_lineJoinStyle = lineJoinStyle;
+        m_line->lineJoinStyle = lineJoinStyle;
         m_stateFlags |= StateLineJoinStyle;
     }
 }
 
 void PDFPageContentProcessorState::setMitterLimit(PDFReal mitterLimit)
 {
-    if (m_mitterLimit != mitterLimit)
+    if (m_line.constData()->mitterLimit != mitterLimit)
     {
-        m_mitterLimit = mitterLimit;
+        m_line->mitterLimit = mitterLimit;
         m_stateFlags |= StateMitterLimit;
     }
 }
 
 void PDFPageContentProcessorState::setLineDashPattern(PDFLineDashPattern pattern)
 {
-    if (m_lineDashPattern != pattern)
+    if (m_line.constData()->lineDashPattern != pattern)
     {
-        m_lineDashPattern = std::move(pattern);
+        m_line->lineDashPattern = std::move(pattern);
         m_stateFlags |= StateLineDashPattern;
     }
 }
 
 void PDFPageContentProcessorState::setRenderingIntentName(const QByteArray& renderingIntentName)
 {
-    if (m_renderingIntentName != renderingIntentName)
+    if (m_color.constData()->renderingIntentName != renderingIntentName)
     {
-        m_renderingIntentName = renderingIntentName;
+        m_color->renderingIntentName = renderingIntentName;
         m_stateFlags |= StateRenderingIntentName;
     }
 }
 
 void PDFPageContentProcessorState::setFlatness(PDFReal flatness)
 {
-    if (m_flatness != flatness)
+    if (m_line.constData()->flatness != flatness)
     {
-        m_flatness = flatness;
+        m_line->flatness = flatness;
         m_stateFlags |= StateFlatness;
     }
 }
 
 void PDFPageContentProcessorState::setSmoothness(PDFReal smoothness)
 {
-    if (m_smoothness != smoothness)
+    if (m_line.constData()->smoothness != smoothness)
     {
-        m_smoothness = smoothness;
+        m_line->smoothness = smoothness;
         m_stateFlags |= StateSmoothness;
     }
 }
 
 void PDFPageContentProcessorState::setTextLeading(PDFReal textLeading)
 {
-    if (m_textLeading != textLeading)
+    if (m_text.constData()->textLeading != textLeading)
     {
-        m_textLeading = textLeading;
+        m_text->textLeading = textLeading;
         m_stateFlags |= StateTextLeading;
     }
 }
 
 void PDFPageContentProcessorState::setTextFontSize(PDFReal textFontSize)
 {
-    if (m_textFontSize != textFontSize)
+    if (m_text.constData()->textFontSize != textFontSize)
     {
-        m_textFontSize = textFontSize;
+        m_text->textFontSize = textFontSize;
         m_stateFlags |= StateTextFontSize;
     }
 }
 
 void PDFPageContentProcessorState::setTextKnockout(bool textKnockout)
 {
-    if (m_textKnockout != textKnockout)
+    if (m_text.constData()->textKnockout != textKnockout)
     {
-        m_textKnockout = textKnockout;
+        m_text->textKnockout = textKnockout;
         m_stateFlags |= StateTextKnockout;
     }
 }
@@ -3712,36 +4415,36 @@ void PDFPageContentProcessorState::setTextLineMatrix(const QTransform& textLineM
 
 void PDFPageContentProcessorState::setAlphaStroking(PDFReal alpha)
 {
-    if (m_alphaStroking != alpha)
+    if (m_extended.constData()->alphaStroking != alpha)
     {
-        m_alphaStroking = alpha;
+        m_extended->alphaStroking = alpha;
         m_stateFlags |= StateAlphaStroking;
     }
 }
 
 void PDFPageContentProcessorState::setAlphaFilling(PDFReal alpha)
 {
-    if (m_alphaFilling != alpha)
+    if (m_extended.constData()->alphaFilling != alpha)
     {
-        m_alphaFilling = alpha;
+        m_extended->alphaFilling = alpha;
         m_stateFlags |= StateAlphaFilling;
     }
 }
 
 void PDFPageContentProcessorState::setBlendMode(BlendMode mode)
 {
-    if (m_blendMode != mode)
+    if (m_extended.constData()->blendMode != mode)
     {
-        m_blendMode = mode;
+        m_extended->blendMode = mode;
         m_stateFlags |= StateBlendMode;
     }
 }
 
 void PDFPageContentProcessorState::setRenderingIntent(RenderingIntent renderingIntent)
 {
-    if (m_renderingIntent != renderingIntent)
+    if (m_color.constData()->renderingIntent != renderingIntent)
     {
-        m_renderingIntent = renderingIntent;
+        m_color->renderingIntent = renderingIntent;
         m_stateFlags |= StateRenderingIntent;
     }
 }
@@ -3749,143 +4452,143 @@ void PDFPageContentProcessorState::setRenderingIntent(RenderingIntent renderingI
 QColor PDFPageContentProcessorState::getStrokeColorWithAlpha() const
 {
     QColor color = getStrokeColor();
-    color.setAlphaF(m_alphaStroking);
+    color.setAlphaF(m_extended->alphaStroking);
     return color;
 }
 
 QColor PDFPageContentProcessorState::getFillColorWithAlpha() const
 {
     QColor color = getFillColor();
-    color.setAlphaF(m_alphaFilling);
+    color.setAlphaF(m_extended->alphaFilling);
     return color;
 }
 
 void PDFPageContentProcessorState::setOverprintMode(PDFOverprintMode overprintMode)
 {
-    if (m_overprintMode != overprintMode)
+    if (m_extended.constData()->overprintMode != overprintMode)
     {
-        m_overprintMode = overprintMode;
+        m_extended->overprintMode = overprintMode;
         m_stateFlags |= StateOverprint;
     }
 }
 
 void PDFPageContentProcessorState::setAlphaIsShape(bool alphaIsShape)
 {
-    if (m_alphaIsShape != alphaIsShape)
+    if (m_extended.constData()->alphaIsShape != alphaIsShape)
     {
-        m_alphaIsShape = alphaIsShape;
+        m_extended->alphaIsShape = alphaIsShape;
         m_stateFlags |= StateAlphaIsShape;
     }
 }
 
 bool PDFPageContentProcessorState::getStrokeAdjustment() const
 {
-    return m_strokeAdjustment;
+    return m_line->strokeAdjustment;
 }
 
 void PDFPageContentProcessorState::setStrokeAdjustment(bool strokeAdjustment)
 {
-    if (m_strokeAdjustment != strokeAdjustment)
+    if (m_line.constData()->strokeAdjustment != strokeAdjustment)
     {
-        m_strokeAdjustment = strokeAdjustment;
+        m_line->strokeAdjustment = strokeAdjustment;
         m_stateFlags |= StateStrokeAdjustment;
     }
 }
 
 const PDFDictionary* PDFPageContentProcessorState::getSoftMask() const
 {
-    return m_softMask;
+    return m_extended->softMask;
 }
 
 void PDFPageContentProcessorState::setSoftMask(const PDFDictionary* softMask)
 {
-    if (m_softMask != softMask)
+    if (m_extended.constData()->softMask != softMask)
     {
-        m_softMask = softMask;
+        m_extended->softMask = softMask;
         m_stateFlags |= StateSoftMask;
     }
 }
 
 BlackPointCompensationMode PDFPageContentProcessorState::getBlackPointCompensationMode() const
 {
-    return m_blackPointCompensationMode;
+    return m_extended->blackPointCompensationMode;
 }
 
 void PDFPageContentProcessorState::setBlackPointCompensationMode(BlackPointCompensationMode blackPointCompensationMode)
 {
-    if (m_blackPointCompensationMode != blackPointCompensationMode)
+    if (m_extended.constData()->blackPointCompensationMode != blackPointCompensationMode)
     {
-        m_blackPointCompensationMode = blackPointCompensationMode;
+        m_extended->blackPointCompensationMode = blackPointCompensationMode;
         m_stateFlags |= StateBlackPointCompensation;
     }
 }
 
 PDFObject PDFPageContentProcessorState::getHalftone() const
 {
-    return m_halftone;
+    return m_extended->halftone;
 }
 
 void PDFPageContentProcessorState::setHalftone(const PDFObject& halftone)
 {
-    if (m_halftone != halftone)
+    if (m_extended.constData()->halftone != halftone)
     {
-        m_halftone = halftone;
+        m_extended->halftone = halftone;
         m_stateFlags |= StateHalftone;
     }
 }
 
 QPointF PDFPageContentProcessorState::getHalftoneOrigin() const
 {
-    return m_halftoneOrigin;
+    return m_extended->halftoneOrigin;
 }
 
 void PDFPageContentProcessorState::setHalftoneOrigin(const QPointF& halftoneOrigin)
 {
-    if (m_halftoneOrigin != halftoneOrigin)
+    if (m_extended.constData()->halftoneOrigin != halftoneOrigin)
     {
-        m_halftoneOrigin = halftoneOrigin;
+        m_extended->halftoneOrigin = halftoneOrigin;
         m_stateFlags |= StateHalftoneOrigin;
     }
 }
 
 PDFObject PDFPageContentProcessorState::getTransferFunction() const
 {
-    return m_transferFunction;
+    return m_extended->transferFunction;
 }
 
 void PDFPageContentProcessorState::setTransferFunction(const PDFObject& transferFunction)
 {
-    if (m_transferFunction != transferFunction)
+    if (m_extended.constData()->transferFunction != transferFunction)
     {
-        m_transferFunction = transferFunction;
+        m_extended->transferFunction = transferFunction;
         m_stateFlags |= StateTransferFunction;
     }
 }
 
 PDFObject PDFPageContentProcessorState::getUndercolorRemovalFunction() const
 {
-    return m_undercolorRemovalFunction;
+    return m_extended->undercolorRemovalFunction;
 }
 
 void PDFPageContentProcessorState::setUndercolorRemovalFunction(const PDFObject& undercolorRemovalFunction)
 {
-    if (m_undercolorRemovalFunction != undercolorRemovalFunction)
+    if (m_extended.constData()->undercolorRemovalFunction != undercolorRemovalFunction)
     {
-        m_undercolorRemovalFunction = undercolorRemovalFunction;
+        m_extended->undercolorRemovalFunction = undercolorRemovalFunction;
         m_stateFlags |= StateUndercolorRemovalFunction;
     }
 }
 
 PDFObject PDFPageContentProcessorState::getBlackGenerationFunction() const
 {
-    return m_blackGenerationFunction;
+    return m_extended->blackGenerationFunction;
 }
 
 void PDFPageContentProcessorState::setBlackGenerationFunction(const PDFObject& blackGenerationFunction)
 {
-    if (m_blackGenerationFunction != blackGenerationFunction)
+    if (m_extended.constData()->blackGenerationFunction != blackGenerationFunction)
     {
-        m_blackGenerationFunction = blackGenerationFunction;
+        m_extended->blackGenerationFunction = blackGenerationFunction;
         m_stateFlags |= StateBlackGenerationFunction;
     }
 }
@@ -3901,54 +4604,54 @@ void PDFPageContentProcessorState::setTextMatrix(const QTransform& textMatrix)
 
 void PDFPageContentProcessorState::setTextRise(PDFReal textRise)
 {
-    if (m_textRise != textRise)
+    if (m_text.constData()->textRise != textRise)
     {
-        m_textRise = textRise;
+        m_text->textRise = textRise;
         m_stateFlags |= StateTextRise;
     }
 }
 
 void PDFPageContentProcessorState::setTextRenderingMode(TextRenderingMode textRenderingMode)
 {
-    if (m_textRenderingMode != textRenderingMode)
+    if (m_text.constData()->textRenderingMode != textRenderingMode)
     {
-        m_textRenderingMode = textRenderingMode;
+        m_text->textRenderingMode = textRenderingMode;
         m_stateFlags |= StateTextRenderingMode;
     }
 }
 
 void PDFPageContentProcessorState::setTextFont(const PDFFontPointer& textFont)
 {
-    if (m_textFont != textFont)
+    if (m_text.constData()->textFont != textFont)
     {
-        m_textFont = textFont;
+        m_text->textFont = textFont;
         m_stateFlags |= StateTextFont;
     }
 }
 
 void PDFPageContentProcessorState::setTextHorizontalScaling(PDFReal textHorizontalScaling)
 {
-    if (m_textHorizontalScaling != textHorizontalScaling)
+    if (m_text.constData()->textHorizontalScaling != textHorizontalScaling)
     {
-        m_textHorizontalScaling = textHorizontalScaling;
+        m_text->textHorizontalScaling = textHorizontalScaling;
         m_stateFlags |= StateTextHorizontalScaling;
     }
 }
 
 void PDFPageContentProcessorState::setTextWordSpacing(PDFReal textWordSpacing)
 {
-    if (m_textWordSpacing != textWordSpacing)
+    if (m_text.constData()->textWordSpacing != textWordSpacing)
     {
-        m_textWordSpacing = textWordSpacing;
+        m_text->textWordSpacing = textWordSpacing;
         m_stateFlags |= StateTextWordSpacing;
     }
 }
 
 void PDFPageContentProcessorState::setTextCharacterSpacing(PDFReal textCharacterSpacing)
 {
-    if (m_textCharacterSpacing != textCharacterSpacing)
+    if (m_text.constData()->textCharacterSpacing != textCharacterSpacing)
     {
-        m_textCharacterSpacing = textCharacterSpacing;
+        m_text->textCharacterSpacing = textCharacterSpacing;
         m_stateFlags |= StateTextCharacterSpacing;
     }
 }
@@ -3998,14 +4701,26 @@ PDFPageContentProcessor::PDFTransparencyGroupGuard::~PDFTransparencyGroupGuard()
     m_processor->performEndTransparencyGroup(ProcessOrder::AfterOperation, group);
 }
 
-PDFLineDashPattern::PDFLineDashPattern(const std::vector<PDFReal>& dashArray, PDFReal dashOffset) :
-    m_dashArray(dashArray),
+PDFLineDashPattern::PDFLineDashPattern(std::vector<PDFReal> dashArray, PDFReal dashOffset) :
     m_dashOffset(dashOffset)
 {
-    if (m_dashArray.size() % 2 == 1)
+    if (dashArray.size() % 2 == 1)
     {
-        m_dashArray.push_back(m_dashArray.back());
+        dashArray.push_back(dashArray.back());
     }
+
+    setDashArray(qMove(dashArray));
+}
+
+void PDFLineDashPattern::setDashArray(std::vector<PDFReal> dashArray)
+{
+    m_dashArray = !dashArray.empty() ? std::make_shared<const std::vector<PDFReal>>(qMove(dashArray)) : nullptr;
+}
+
+const std::vector<PDFReal>& PDFLineDashPattern::getEmptyDashArray()
+{
+    static const std::vector<PDFReal> emptyDashArray;
+    return emptyDashArray;
 }
 
 void PDFLineDashPattern::fix()
@@ -4016,7 +4731,8 @@ void PDFLineDashPattern::fix()
         // then twice of sum of lengths in the dash array should be added
         // so dash offset will become positive.
 
-        const PDFReal totalLength = 2 * std::accumulate(m_dashArray.cbegin(), m_dashArray.cend(), 0.0);
+        const std::vector<PDFReal>& dashArray = getDashArray();
+        const PDFReal totalLength = 2 * std::accumulate(dashArray.cbegin(), dashArray.cend(), 0.0);
         if (totalLength > 0.0)
         {
             m_dashOffset += (std::floor(std::abs(m_dashOffset / totalLength)) + 1.0) * totalLength;
@@ -4031,7 +4747,8 @@ void PDFLineDashPattern::fix()
 
 QVector<qreal> PDFLineDashPattern::createForQPen(qreal penWidthF) const
 {
-    QVector<qreal> lineDashPattern(m_dashArray.begin(), m_dashArray.end());
+    const std::vector<PDFReal>& dashArray = getDashArray();
+    QVector<qreal> lineDashPattern(dashArray.begin(), dashArray.end());
 
     for (qreal& value : lineDashPattern)
     {
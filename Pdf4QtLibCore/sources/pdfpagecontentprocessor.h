@@ -32,9 +32,14 @@
 #include <QTransform>
 #include <QPainterPath>
 #include <QSharedPointer>
+#include <QSharedDataPointer>
 
+#include <map>
 #include <stack>
 #include <tuple>
+#include <vector>
+#include <memory>
+#include <functional>
 #include <type_traits>
 
 namespace pdf
@@ -45,6 +50,9 @@ class PDFImage;
 class PDFTilingPattern;
 class PDFShadingPattern;
 class PDFOptionalContentActivity;
+struct PDFParsedContentStream;
+
+using PDFParsedContentStreamPointer = std::shared_ptr<const PDFParsedContentStream>;
 
 static constexpr const char* PDF_RESOURCE_EXTGSTATE = "ExtGState";
 
@@ -53,19 +61,19 @@ class PDFLineDashPattern
 {
 public:
     explicit inline PDFLineDashPattern() = default;
-    explicit PDFLineDashPattern(const std::vector<PDFReal>& dashArray, PDFReal dashOffset);
+    explicit PDFLineDashPattern(std::vector<PDFReal> dashArray, PDFReal dashOffset);
 
-    inline const std::vector<PDFReal>& getDashArray() const { return m_dashArray; }
-    inline void setDashArray(const std::vector<PDFReal>& dashArray) { m_dashArray = dashArray; }
+    inline const std::vector<PDFReal>& getDashArray() const { return m_dashArray ? *m_dashArray : getEmptyDashArray(); }
+    void setDashArray(std::vector<PDFReal> dashArray);
 
     inline PDFReal getDashOffset() const { return m_dashOffset; }
     inline void setDashOffset(PDFReal dashOffset) { m_dashOffset = dashOffset; }
 
-    inline bool operator==(const PDFLineDashPattern& other) const { return m_dashArray == other.m_dashArray && m_dashOffset == other.m_dashOffset; }
+    inline bool operator==(const PDFLineDashPattern& other) const { return getDashArray() == other.getDashArray() && m_dashOffset == other.m_dashOffset; }
     inline bool operator!=(const PDFLineDashPattern& other) const { return !(*this == other); }
 
     /// Is line solid? Function returns true, if yes.
-    bool isSolid() const { return m_dashArray.empty(); }
+    bool isSolid() const { return !m_dashArray; }
 
     /// Fix line dash pattern according to the specification
     void fix();
@@ -76,7 +84,11 @@ public:
     QVector<qreal> createForQPen(qreal penWidthF) const;
 
 private:
-    std::vector<PDFReal> m_dashArray;
+    static const std::vector<PDFReal>& getEmptyDashArray();
+
+    /// Dash array is shared between copies of the pattern, so saving
+    /// of the graphic state doesn't allocate memory. Null means solid line.
+    std::shared_ptr<const std::vector<PDFReal>> m_dashArray;
     PDFReal m_dashOffset = 0.0;
 };
 
@@ -97,7 +109,10 @@ struct PDFOverprintMode
 };
 
 /// Represents graphic state of the PDF (holding current graphic state parameters).
-/// Please see PDF Reference 1.7, Chapter 4.3 "Graphic State"
+/// Please see PDF Reference 1.7, Chapter 4.3 "Graphic State". Parameters are
+/// divided into blocks (color, line, text and extended parameters), which are
+/// shared between copies of the state and copied only when modified. So saving
+/// and restoring of the graphic state (operators q/Q) is cheap.
 class PDF4QTLIBCORESHARED_EXPORT PDFPageContentProcessorState
 {
 public:
@@ -158,75 +173,80 @@ public:
 
     void setState(const PDFPageContentProcessorState& state);
 
+    /// Returns flags of parameters, which differ in this state and in the other
+    /// state. Current transformation matrix is compared, text matrices are not.
+    /// \param state Other state
+    StateFlags getDifferenceFlags(const PDFPageContentProcessorState& state) const;
+
     const QTransform& getCurrentTransformationMatrix() const { return m_currentTransformationMatrix; }
     void setCurrentTransformationMatrix(const QTransform& currentTransformationMatrix);
 
-    const PDFAbstractColorSpace* getStrokeColorSpace() const { return m_strokeColorSpace.data(); }
+    const PDFAbstractColorSpace* getStrokeColorSpace() const { return m_color->strokeColorSpace.data(); }
     void setStrokeColorSpace(const QSharedPointer<PDFAbstractColorSpace>& strokeColorSpace);
 
-    const PDFAbstractColorSpace* getFillColorSpace() const { return m_fillColorSpace.data(); }
+    const PDFAbstractColorSpace* getFillColorSpace() const { return m_color->fillColorSpace.data(); }
     void setFillColorSpace(const QSharedPointer<PDFAbstractColorSpace>& fillColorSpace);
 
-    const QColor& getStrokeColor() const { return m_strokeColor; }
-    const PDFColor& getStrokeColorOriginal() const { return m_strokeColorOriginal; }
+    const QColor& getStrokeColor() const { return m_color->strokeColor; }
+    const PDFColor& getStrokeColorOriginal() const { return m_color->strokeColorOriginal; }
     void setStrokeColor(const QColor& strokeColor, const PDFColor& originalColor);
 
-    const QColor& getFillColor() const { return m_fillColor; }
-    const PDFColor& getFillColorOriginal() const { return m_fillColorOriginal; }
+    const QColor& getFillColor() const { return m_color->fillColor; }
+    const PDFColor& getFillColorOriginal() const { return m_color->fillColorOriginal; }
     void setFillColor(const QColor& fillColor, const PDFColor& originalColor);
 
-    PDFReal getLineWidth() const { return m_lineWidth; }
+    PDFReal getLineWidth() const { return m_line->lineWidth; }
     void setLineWidth(PDFReal lineWidth);
 
-    Qt::PenCapStyle getLineCapStyle() const { return m_lineCapStyle; }
+    Qt::PenCapStyle getLineCapStyle() const { return m_line->lineCapStyle; }
     void setLineCapStyle(Qt::PenCapStyle lineCapStyle);
 
-    Qt::PenJoinStyle getLineJoinStyle() const { return m_lineJoinStyle; }
+    Qt::PenJoinStyle getLineJoinStyle() const { return m_line->lineJoinStyle; }
     void setLineJoinStyle(Qt::PenJoinStyle lineJoinStyle);
 
-    PDFReal getMitterLimit() const { return m_mitterLimit; }
+    PDFReal getMitterLimit() const { return m_line->mitterLimit; }
     void setMitterLimit(PDFReal mitterLimit);
 
-    const PDFLineDashPattern& getLineDashPattern() const { return m_lineDashPattern; }
+    const PDFLineDashPattern& getLineDashPattern() const { return m_line->lineDashPattern; }
     void setLineDashPattern(PDFLineDashPattern pattern);
 
-    const QByteArray& getRenderingIntentName() const { return m_renderingIntentName; }
+    const QByteArray& getRenderingIntentName() const { return m_color->renderingIntentName; }
     void setRenderingIntentName(const QByteArray& renderingIntentName);
 
-    PDFReal getFlatness() const { return m_flatness; }
+    PDFReal getFlatness() const { return m_line->flatness; }
     void setFlatness(PDFReal flatness);
 
-    PDFReal getSmoothness() const { return m_smoothness; }
+    PDFReal getSmoothness() const { return m_line->smoothness; }
     void setSmoothness(PDFReal smoothness);
 
     StateFlags getStateFlags() const { return m_stateFlags; }
     void setStateFlags(StateFlags stateFlags) { m_stateFlags = stateFlags; }
 
-    PDFReal getTextCharacterSpacing() const { return m_textCharacterSpacing; }
+    PDFReal getTextCharacterSpacing() const { return m_text->textCharacterSpacing; }
     void setTextCharacterSpacing(PDFReal textCharacterSpacing);
 
-    PDFReal getTextWordSpacing() const { return m_textWordSpacing; }
+    PDFReal getTextWordSpacing() const { return m_text->textWordSpacing; }
     void setTextWordSpacing(PDFReal textWordSpacing);
 
-    PDFReal getTextHorizontalScaling() const { return m_textHorizontalScaling; }
+    PDFReal getTextHorizontalScaling() const { return m_text->textHorizontalScaling; }
     void setTextHorizontalScaling(PDFReal textHorizontalScaling);
 
-    PDFReal getTextLeading() const { return m_textLeading; }
+    PDFReal getTextLeading() const { return m_text->textLeading; }
     void setTextLeading(PDFReal textLeading);
 
-    const PDFFontPointer& getTextFont() const { return m_textFont; }
+    const PDFFontPointer& getTextFont() const { return m_text->textFont; }
     void setTextFont(const PDFFontPointer& textFont);
 
-    PDFReal getTextFontSize() const { return m_textFontSize; }
+    PDFReal getTextFontSize() const { return m_text->textFontSize; }
     void setTextFontSize(PDFReal textFontSize);
 
-    TextRenderingMode getTextRenderingMode() const { return m_textRenderingMode; }
+    TextRenderingMode getTextRenderingMode() const { return m_text->textRenderingMode; }
     void setTextRenderingMode(TextRenderingMode textRenderingMode);
 
-    PDFReal getTextRise() const { return m_textRise; }
+    PDFReal getTextRise() const { return m_text->textRise; }
     void setTextRise(PDFReal textRise);
 
-    bool getTextKnockout() const { return m_textKnockout; }
+    bool getTextKnockout() const { return m_text->textKnockout; }
     void setTextKnockout(bool textKnockout);
 
     const QTransform& getTextMatrix() const { return m_textMatrix; }
@@ -235,16 +255,16 @@ public:
     const QTransform& getTextLineMatrix() const { return m_textLineMatrix; }
     void setTextLineMatrix(const QTransform& textLineMatrix);
 
-    PDFReal getAlphaStroking() const { return m_alphaStroking; }
+    PDFReal getAlphaStroking() const { return m_extended->alphaStroking; }
     void setAlphaStroking(PDFReal alpha);
 
-    PDFReal getAlphaFilling() const { return m_alphaFilling; }
+    PDFReal getAlphaFilling() const { return m_extended->alphaFilling; }
     void setAlphaFilling(PDFReal alpha);
 
-    BlendMode getBlendMode() const { return m_blendMode; }
+    BlendMode getBlendMode() const { return m_extended->blendMode; }
     void setBlendMode(BlendMode mode);
 
-    RenderingIntent getRenderingIntent() const { return m_renderingIntent; }
+    RenderingIntent getRenderingIntent() const { return m_color->renderingIntent; }
     void setRenderingIntent(RenderingIntent renderingIntent);
 
     /// Returns stroke color with alpha channel
@@ -253,10 +273,10 @@ public:
     /// Returns fill color with alpha channel
     QColor getFillColorWithAlpha() const;
 
-    PDFOverprintMode getOverprintMode() const { return m_overprintMode; }
+    PDFOverprintMode getOverprintMode() const { return m_extended->overprintMode; }
     void setOverprintMode(PDFOverprintMode overprintMode);
 
-    bool getAlphaIsShape() const { return m_alphaIsShape; }
+    bool getAlphaIsShape() const { return m_extended->alphaIsShape; }
     void setAlphaIsShape(bool alphaIsShape);
 
     bool getStrokeAdjustment() const;
@@ -284,46 +304,76 @@ public:
     void setHalftoneOrigin(const QPointF& halftoneOrigin);
 
 private:
+    struct ColorState : public QSharedData
+    {
+        PDFColorSpacePointer strokeColorSpace;
+        PDFColorSpacePointer fillColorSpace;
+        QColor strokeColor = Qt::black;
+        PDFColor strokeColorOriginal;
+        QColor fillColor = Qt::black;
+        PDFColor fillColorOriginal;
+        QByteArray renderingIntentName;
+        RenderingIntent renderingIntent = RenderingIntent::Perceptual;
+
+        StateFlags getChangedFlags(const ColorState& other) const;
+    };
+
+    struct LineState : public QSharedData
+    {
+        PDFReal lineWidth = 1.0;
+        Qt::PenCapStyle lineCapStyle = Qt::FlatCap;
+        Qt::PenJoinStyle lineJoinStyle = Qt::MiterJoin;
+        PDFReal mitterLimit = 10.0;
+        PDFLineDashPattern lineDashPattern;
+        PDFReal flatness = 1.0;
+        PDFReal smoothness = 0.01;
+        bool strokeAdjustment = false;
+
+        StateFlags getChangedFlags(const LineState& other) const;
+    };
+
+    struct TextState : public QSharedData
+    {
+        PDFReal textCharacterSpacing = 0.0; // T_c
+        PDFReal textWordSpacing = 0.0; // T_w
+        PDFReal textHorizontalScaling = 100.0; // T_h, percentage
+        PDFReal textLeading = 0.0; // T_l
+        PDFFontPointer textFont; // Text font
+        PDFReal textFontSize = 0.0; // T_fs
+        TextRenderingMode textRenderingMode = TextRenderingMode::Fill; // Text rendering mode
+        PDFReal textRise = 0.0; // T_rise
+        bool textKnockout = true;
+
+        StateFlags getChangedFlags(const TextState& other) const;
+    };
+
+    struct ExtendedState : public QSharedData
+    {
+        PDFReal alphaStroking = 1.0;
+        PDFReal alphaFilling = 1.0;
+        BlendMode blendMode = BlendMode::Normal;
+        PDFOverprintMode overprintMode;
+        bool alphaIsShape = false;
+        const PDFDictionary* softMask = nullptr;
+        BlackPointCompensationMode blackPointCompensationMode = BlackPointCompensationMode::Default;
+        PDFObject blackGenerationFunction;
+        PDFObject undercolorRemovalFunction;
+        PDFObject transferFunction;
+        PDFObject halftone;
+        QPointF halftoneOrigin;
+
+        StateFlags getChangedFlags(const ExtendedState& other) const;
+    };
+
+    // Matrices are changed very often (text matrix is changed by each
+    // text showing operator), so they are not shared.
     QTransform m_currentTransformationMatrix;
-    PDFColorSpacePointer m_strokeColorSpace;
-    PDFColorSpacePointer m_fillColorSpace;
-    QColor m_strokeColor;
-    PDFColor m_strokeColorOriginal;
-    QColor m_fillColor;
-    PDFColor m_fillColorOriginal;
-    PDFReal m_lineWidth;
-    Qt::PenCapStyle m_lineCapStyle;
-    Qt::PenJoinStyle m_lineJoinStyle;
-    PDFReal m_mitterLimit;
-    PDFLineDashPattern m_lineDashPattern;
-    QByteArray m_renderingIntentName;
-    PDFReal m_flatness;
-    PDFReal m_smoothness;
-    PDFReal m_textCharacterSpacing; // T_c
-    PDFReal m_textWordSpacing;  // T_w
-    PDFReal m_textHorizontalScaling; // T_h, percentage
-    PDFReal m_textLeading; // T_l
-    PDFFontPointer m_textFont; // Text font
-    PDFReal m_textFontSize; // T_fs
-    TextRenderingMode m_textRenderingMode; // Text rendering mode
-    PDFReal m_textRise; // T_rise
-    bool m_textKnockout;
     QTransform m_textMatrix;
     QTransform m_textLineMatrix;
-    PDFReal m_alphaStroking;
-    PDFReal m_alphaFilling;
-    BlendMode m_blendMode;
-    RenderingIntent m_renderingIntent;
-    PDFOverprintMode m_overprintMode;
-    bool m_alphaIsShape;
-    bool m_strokeAdjustment;
-    const PDFDictionary* m_softMask;
-    BlackPointCompensationMode m_blackPointCompensationMode;
-    PDFObject m_blackGenerationFunction;
-    PDFObject m_undercolorRemovalFunction;
-    PDFObject m_transferFunction;
-    PDFObject m_halftone;
-    QPointF m_halftoneOrigin;
+    QSharedDataPointer<ColorState> m_color;
+    QSharedDataPointer<LineState> m_line;
+    QSharedDataPointer<TextState> m_text;
+    QSharedDataPointer<ExtendedState> m_extended;
     StateFlags m_stateFlags;
 };
 
@@ -465,6 +515,7 @@ public:
     QList<PDFRenderError> processContents();
 
     virtual void reportRenderError(RenderErrorType type, QString message) override;
+    virtual void reportRenderError(const PDFRenderError& error) override;
 
     /// Reports render error, but only once - if same error was already reported,
     /// then no new error is reported.
@@ -504,6 +555,9 @@ public:
     /// Returns true, if we are in a text processing
     bool isTextProcessing() const;
 
+    /// Returns number of reported render errors, including repeated errors
+    PDFInteger getRenderErrorCount() const { return m_renderErrorCount; }
+
 
     /// Converts PDF line cap to Qt's pen cap style. Function always succeeds,
     /// if invalid \p lineCap occurs, then some valid pen cap style is returned.
@@ -531,6 +585,7 @@ protected:
         PDFColorSpacePointer colorSpacePointer;
         bool isolated = false;
         bool knockout = false;
+        const PDFStream* stream = nullptr; ///< Form XObject stream of the group (or nullptr, if group is not a form)
     };
 
     /// Parses transparency group
@@ -577,7 +632,8 @@ protected:
     /// stream instructions and operands.
     /// \param currentOperator Current operator
     /// \param processOrder Mark before/after instruction is executed
-    /// \param operatorAsText Operator converted to text
+    /// \param operatorAsText Operator converted to text (refers to the content
+    ///        stream data, so deep copy must be made, if it should be stored)
     virtual void performInterceptInstruction(Operator currentOperator,
                                              ProcessOrder processOrder,
                                              const QByteArray& operatorAsText);
@@ -614,6 +670,37 @@ protected:
     /// \returns true, if image is successfully processed
     virtual bool performOriginalImagePainting(const PDFImage& image, const PDFStream* stream);
 
+    /// Returns true, if processor uses original image in \p performOriginalImagePainting.
+    /// If it doesn't, then decoded images can be taken from the image cache,
+    /// and original image is not created at all.
+    virtual bool isOriginalImagePaintingUsed() const { return false; }
+
+    /// Returns size of the image in device pixels (image is painted onto the unit
+    /// square of the user space). JPEG and JPEG 2000 images are decoded only in resolution
+    /// needed for this size. If invalid size is returned, images are decoded in full
+    /// resolution. Default implementation returns invalid size, because generally,
+    /// it is not known, if device space is the final space (pages can be precompiled).
+    /// \param stream Image stream
+    virtual QSize getImageDeviceSize(const PDFStream* stream) { Q_UNUSED(stream); return QSize(); }
+
+    /// Returns true, if soft mask of the image, which is being painted (image is painted
+    /// onto the unit square of the user space), should be ignored, so image is painted as opaque.
+    /// Default implementation returns false.
+    virtual bool isImageSoftMaskIgnored() const { return false; }
+
+    /// Returns true, if Type 3 glyphs, which can't be represented by outlines exactly,
+    /// should be approximated by outlines (strokes are converted to filled outlines
+    /// and clipping is ignored). Default implementation returns false.
+    virtual bool isType3GlyphDetailCapped() const { return false; }
+
+    /// Returns true, if image XObject should be skipped, so it is neither decoded,
+    /// nor painted. It can be used, when each image is processed only once (for example,
+    /// when images are extracted from the document), or image is processed without
+    /// decoding. Default implementation returns false.
+    /// \param reference Reference of the image XObject (invalid, if image is a direct object)
+    /// \param stream Image stream
+    virtual bool isImageXObjectSkipped(PDFObjectReference reference, const PDFStream* stream) { Q_UNUSED(reference); Q_UNUSED(stream); return false; }
+
     /// This function has to be implemented in the client drawing implementation, it should
     /// draw the image.
     /// \param image Image to be painted
@@ -672,6 +759,23 @@ protected:
     /// \param transparencyGroup Transparency group
     virtual void performEndTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup);
 
+    /// Implement to skip processing of the content of the current transparency group
+    /// form, because paint device already has the result of the group (for example,
+    /// from cache). This function is called after transparency group is begun.
+    virtual bool isTransparencyGroupContentSkipped() const;
+
+    /// Implement to react on beginning of the content of the form XObject, which
+    /// is not a transparency group. Graphic state, clipping and resources of the form
+    /// are already set. Content of the form is skipped, if this function returns true,
+    /// because paint device already has the content of the form (for example, from cache).
+    /// \param stream Stream of the form
+    virtual bool performBeginFormContent(const PDFStream* stream);
+
+    /// Implement to react on end of the content of the form XObject. This function
+    /// is called only, if content of the form was not skipped.
+    /// \param stream Stream of the form
+    virtual void performEndFormContent(const PDFStream* stream);
+
     /// Implement to react on character printing
     virtual void performOutputCharacter(const PDFTextCharacterInfo& info);
 
@@ -684,6 +788,37 @@ protected:
     /// Implement to respond to text sequence processing
     virtual void performProcessTextSequence(const TextSequence& textSequence, ProcessOrder order);
 
+    /// Implement to paint tiling pattern without processing content stream of each
+    /// pattern cell, for example, by filling the area by image of the pattern cell.
+    /// When this function is called, current transformation matrix maps pattern space
+    /// to the user space, path is already clipped, and colors of uncolored pattern are set.
+    /// Cell (column, row) is painted at offset tilingArea.topLeft() + (column * xStep, row * yStep).
+    /// Return true, if the tiling pattern was painted, or false, if content stream
+    /// of the pattern should be processed for each cell (default).
+    /// \param tilingPattern Tiling pattern
+    /// \param tilingArea Area in the pattern space covered by pattern cells
+    /// \param columns Number of columns of the pattern cells
+    /// \param rows Number of rows of the pattern cells
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    virtual bool performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QRectF& tilingArea,
+                                              PDFInteger columns,
+                                              PDFInteger rows,
+                                              const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                              const PDFColor& uncoloredPatternColor);
+
+    /// Processes content of single tiling pattern cell in the pattern space, i.e.
+    /// page point to device point matrix maps pattern space to the device space. Processor
+    /// is initialized, so this function should be called on a new processor. Returns list
+    /// of errors, which occured during processing.
+    /// \param tilingPattern Tiling pattern
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    QList<PDFRenderError> processTilingPatternCell(const PDFTilingPattern* tilingPattern,
+                                                   const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                   const PDFColor& uncoloredPatternColor);
+
     enum class ContentKind
     {
         Shapes,     ///< General shapes (they can be also shaded / tiled)
@@ -698,6 +833,19 @@ protected:
     /// shading, images, ...)
     virtual bool isContentKindSuppressed(ContentKind kind) const;
 
+    /// Enables text only processing. Processors, which consume only output
+    /// characters (for example, text layout generators), can use this mode
+    /// to speed up content processing. Text state, transformation matrices,
+    /// clipping, marked content and forms are processed as usual, but nothing
+    /// is painted: paths, glyph outlines, images and shadings are not painted,
+    /// Type 3 glyph procedures are not executed, patterns are not created and
+    /// colors are not converted (cms is not used, all colors are black).
+    /// \param textOnlyProcessing Enable text only processing
+    void setTextOnlyProcessing(bool textOnlyProcessing) { m_isTextOnlyProcessing = textOnlyProcessing; }
+
+    /// Returns true, if text only processing is enabled
+    bool isTextOnlyProcessing() const { return m_isTextOnlyProcessing; }
+
     /// Sets current graphic state and updates data
     /// \param state New graphic state
     void setGraphicsState(const PDFPageContentProcessorState& state);
@@ -710,11 +858,22 @@ protected:
 
     /// Adds error to the error list
     /// \param error Error message
-    void addError(const QString& error) { m_errorList.append(PDFRenderError(RenderErrorType::Error, error)); }
+    void addError(const QString& error) { addRenderError(PDFRenderError(RenderErrorType::Error, error)); }
+
+    /// Adds error to the error list. If the same error was already added,
+    /// then only its count of occurrences is incremented.
+    /// \param error Error
+    void addRenderError(const PDFRenderError& error);
 
     /// Returns true, if graphic content is suppressed
     bool isContentSuppressed() const;
 
+    /// Returns references to optional content groups (or membership dictionaries)
+    /// of all optional content sections enclosing the current content, from
+    /// the outermost to the innermost one. Content is visible only, if all
+    /// of them are visible.
+    std::vector<PDFObjectReference> getOptionalContentReferences() const;
+
     /// Returns page point to device point matrix
     const QTransform& getPagePointToDevicePointMatrix() const { return m_pagePointToDevicePointMatrix; }
 
@@ -746,6 +905,23 @@ protected:
     /// Returns optional content activity
     const PDFOptionalContentActivity* getOptionalContentActivity() const { return m_optionalContentActivity; }
 
+    /// Returns mesh quality settings
+    const PDFMeshQualitySettings& getMeshQualitySettings() const { return m_meshQualitySettings; }
+
+    /// Glyph of the text, which is being painted
+    struct TextGlyph
+    {
+        quint64 fontId = 0;                     ///< Unique id of the realized font
+        CID cid = 0;                            ///< Character id of the glyph
+        const QPainterPath* outline = nullptr;  ///< Glyph outline (in text space)
+        QTransform glyphMatrix;                 ///< Transformation from text space to user space
+    };
+
+    /// Returns glyph, which is being currently painted. Glyph is valid only in the
+    /// path painting function called for filled text glyph, which is neither stroked
+    /// nor used as clipping path, otherwise nullptr is returned.
+    const TextGlyph* getCurrentTextGlyph() const { return m_currentTextGlyph; }
+
     /// Returns operand for current operator
     const PDFFlatArray<PDFLexicalAnalyzer::Token, 33>& getOperands() const { return m_operands; }
 
@@ -780,8 +956,46 @@ private:
     /// Process the content
     void processContent(const QByteArray& content);
 
+    /// Process the content, or parse the content, if \p parsedContent is not nullptr.
+    /// In that case, content is not processed, instructions are stored into the
+    /// parsed content instead. Returns false, if processing was cancelled.
+    /// \param content Content
+    /// \param parsedContent Parsed content (can be nullptr)
+    bool processContent(const QByteArray& content, PDFParsedContentStream* parsedContent);
+
+    /// Parses the content into the sequence of instructions, which can be
+    /// processed later (even many times). Returns nullptr, if processing
+    /// was cancelled.
+    /// \param content Content
+    PDFParsedContentStreamPointer parseContent(const QByteArray& content);
+
+    /// Process the parsed content
+    /// \param content Parsed content
+    void processParsedContent(const PDFParsedContentStream& content);
+
+    /// Process the content using parsed content cache. If content identified
+    /// by \p key is not in the cache, then it is parsed and inserted into the
+    /// cache. Owner keeps the identifying object alive, it is retrieved only,
+    /// when content is being inserted into the cache.
+    /// \param key Identifying object of the content
+    /// \param content Content
+    /// \param getOwner Returns owner of the identifying object
+    void processCachedContent(const void* key, const QByteArray& content, const std::function<std::shared_ptr<const void>()>& getOwner);
+
+    /// Processes form, if \p stream is not nullptr, then parsed content
+    /// of the form is cached using the stream as a key.
+    void processForm(const QTransform& matrix,
+                     const QRectF& boundingBox,
+                     const PDFObject& resources,
+                     const PDFObject& transparencyGroup,
+                     const QByteArray& content,
+                     PDFInteger formStructuralParent,
+                     const PDFStream* stream);
+
     /// Processes single command
-    void processCommand(const QByteArray& command);
+    /// \param op Decoded operator (Operator::Invalid, if command is unknown)
+    /// \param command Command text
+    void processCommand(Operator op, const QByteArray& command);
 
     /// Performs path painting
     /// \param path Path, which should be drawn (can be emtpy - in that case nothing happens)
@@ -801,6 +1015,21 @@ private:
                                        PDFColorSpacePointer uncoloredPatternColorSpace,
                                        PDFColor uncoloredPatternColor);
 
+    /// Initializes resources and colors of the graphic state for painting of the
+    /// tiling pattern cells. Returns 1, if pattern is uncolored, 0 otherwise.
+    /// \param tilingPattern Tiling pattern to be painted
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    int initializeTilingPatternState(const PDFTilingPattern* tilingPattern,
+                                     const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                     const PDFColor& uncoloredPatternColor);
+
+    /// Creates mesh of the shading pattern in the device space. If shading mesh
+    /// can be cached, then mesh is retrieved from the mesh cache of the font cache.
+    /// \param shadingPattern Shading pattern
+    /// \param settings Meshing settings
+    PDFMesh createShadingMesh(const PDFShadingPattern* shadingPattern, const PDFMeshQualitySettings& settings);
+
     /// Applies graphic state dictionary
     /// \param graphicStateDictionary Dictionary to be applied to the current graphic state
     void processApplyGraphicState(const PDFDictionary* graphicStateDictionary);
@@ -814,10 +1043,11 @@ private:
     struct MarkedContentState
     {
         inline explicit MarkedContentState() = default;
-        inline explicit MarkedContentState(const QByteArray& tag, MarkedContentKind kind, bool contentSuppressed) :
+        inline explicit MarkedContentState(const QByteArray& tag, MarkedContentKind kind, bool contentSuppressed, PDFObjectReference optionalContent = PDFObjectReference()) :
             tag(tag),
             kind(kind),
-            contentSuppressed(contentSuppressed)
+            contentSuppressed(contentSuppressed),
+            optionalContent(optionalContent)
         {
 
         }
@@ -825,6 +1055,7 @@ private:
         QByteArray tag;
         MarkedContentKind kind = MarkedContentKind::Other;
         bool contentSuppressed = false;
+        PDFObjectReference optionalContent; ///< Optional content group/membership dictionary (valid only for optional content)
     };
 
     class PDFPageContentProcessorStateGuard
@@ -905,6 +1136,17 @@ private:
     /// Notifies the updated graphic state. If nothing changed in graphic state, then nothing happens.
     void updateGraphicState();
 
+    /// Converts color from the color space using cms. If text only processing
+    /// is enabled, color is not converted and black color is returned.
+    /// \param colorSpace Color space
+    /// \param color Color in the color space
+    QColor getColor(const PDFAbstractColorSpace* colorSpace, const PDFColor& color);
+
+    /// Returns default color of the color space using cms. If text only processing
+    /// is enabled, color is not converted and black color is returned.
+    /// \param colorSpace Color space
+    QColor getDefaultColor(const PDFAbstractColorSpace* colorSpace);
+
     template<typename... Operands>
     inline QColor getColorFromColorSpace(const PDFAbstractColorSpace* colorSpace, Operands... operands)
     {
@@ -912,7 +1154,7 @@ private:
         const size_t colorSpaceComponentCount = colorSpace->getColorComponentCount();
         if (operandCount == colorSpaceComponentCount)
         {
-            return colorSpace->getColor(PDFColor(static_cast<PDFColorComponent>(operands)...), m_CMS, m_graphicState.getRenderingIntent(), this, true);
+            return getColor(colorSpace, PDFColor(static_cast<PDFColorComponent>(operands)...));
         }
         else
         {
@@ -1073,7 +1315,9 @@ private:
     PDFFlatArray<PDFLexicalAnalyzer::Token, 33> m_operands;
 
     /// Stack with saved graphic states
-    std::stack<PDFPageContentProcessorState> m_stack;
+    /// Stack of saved graphic states. Vector is used as underlying container,
+    /// so its memory is reused by subsequent q/Q operators.
+    std::stack<PDFPageContentProcessorState, std::vector<PDFPageContentProcessorState>> m_stack;
 
     /// Stack with transparency groups
     std::stack<PDFTransparencyGroup> m_transparencyGroupStack;
@@ -1084,9 +1328,17 @@ private:
     /// Current graphic state
     PDFPageContentProcessorState m_graphicState;
 
+    using RenderErrorKey = std::tuple<int, quintptr, QString, QStringList>;
+
     /// List of errors
     QList<PDFRenderError> m_errorList;
 
+    /// Indices of errors in the error list
+    std::map<RenderErrorKey, qsizetype> m_errorIndices;
+
+    /// Number of reported errors, including repeated errors
+    PDFInteger m_renderErrorCount = 0;
+
     /// Current painter path
     QPainterPath m_currentPath;
 
@@ -1106,6 +1358,12 @@ private:
     /// is in device space coordinates.
     QPainterPath m_textClippingPath;
 
+    /// Glyph, which is being currently painted (if any)
+    const TextGlyph* m_currentTextGlyph = nullptr;
+
+    /// Process only text (nothing is painted)
+    bool m_isTextOnlyProcessing = false;
+
     /// Base matrix to be used when drawing patterns. Concatenate this matrix
     /// with pattern matrix to get transformation from pattern space to device space.
     QTransform m_patternBaseMatrix;
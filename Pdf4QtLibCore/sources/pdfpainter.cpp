@@ -19,10 +19,21 @@
 #include "pdfpattern.h"
 #include "pdfcms.h"
 #include "pdfpainterutils.h"
+#include "pdfimage.h"
+#include "pdfblpainter.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfinstrumentation.h"
+#include "pdfimagecache.h"
+#include "pdfoptionalcontent.h"
 
 #include <QPainter>
+#include <QPainterPathStroker>
 #include <QCryptographicHash>
 #include <QtMath>
+#include <QColorSpace>
+
+#include <stack>
+#include <limits>
 
 #include "pdfdbgheap.h"
 
@@ -172,6 +183,24 @@ bool PDFPainterBase::canSetBlendMode(BlendMode mode) const
     return std::all_of(m_transparencyGroupDataStack.cbegin(), m_transparencyGroupDataStack.cend(), [](const PDFTransparencyGroupPainterData& group) { return group.blendMode == BlendMode::Normal || group.blendMode == BlendMode::Compatible; });
 }
 
+bool PDFPainterBase::isImageSoftMaskIgnored() const
+{
+    if (!hasFeature(PDFRenderer::Draft_SoftMasks))
+    {
+        return false;
+    }
+
+    const QTransform matrix = getCurrentWorldMatrix();
+    const PDFReal width = QLineF(matrix.map(QPointF(0.0, 0.0)), matrix.map(QPointF(1.0, 0.0))).length();
+    const PDFReal height = QLineF(matrix.map(QPointF(0.0, 0.0)), matrix.map(QPointF(0.0, 1.0))).length();
+    return width < PDFRenderer::DRAFT_SOFT_MASK_SIZE_LIMIT && height < PDFRenderer::DRAFT_SOFT_MASK_SIZE_LIMIT;
+}
+
+bool PDFPainterBase::isTransparencyGroupActive() const
+{
+    return std::any_of(m_transparencyGroupDataStack.cbegin(), m_transparencyGroupDataStack.cend(), [](const PDFTransparencyGroupPainterData& group) { return !group.isSkipped; });
+}
+
 void PDFPainterBase::performBeginTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup)
 {
     if (order == ProcessOrder::BeforeOperation)
@@ -181,6 +210,20 @@ void PDFPainterBase::performBeginTransparencyGroup(ProcessOrder order, const PDF
         data.alphaFill = getGraphicState()->getAlphaFilling();
         data.alphaStroke = getGraphicState()->getAlphaStroking();
         data.blendMode = getGraphicState()->getBlendMode();
+
+        // Opaque group composed using normal blend mode without soft mask
+        // gives (almost) the same result, as if its content is painted directly
+        // on the backdrop, so in draft mode, group is not isolated at all.
+        if (hasFeature(PDFRenderer::Draft_TransparencyGroups) &&
+            data.alphaFill == 1.0 &&
+            data.alphaStroke == 1.0 &&
+            (data.blendMode == BlendMode::Normal || data.blendMode == BlendMode::Compatible) &&
+            !getGraphicState()->getSoftMask())
+        {
+            data.isSkipped = true;
+            data.group.isolated = false;
+        }
+
         m_transparencyGroupDataStack.emplace_back(qMove(data));
     }
 }
@@ -195,6 +238,141 @@ void PDFPainterBase::performEndTransparencyGroup(ProcessOrder order, const PDFTr
     }
 }
 
+bool PDFPainterBase::performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern)
+{
+    Q_UNUSED(stroke);
+    Q_UNUSED(fill);
+
+    const QTransform worldMatrix = getCurrentWorldMatrix();
+    if (!worldMatrix.isInvertible())
+    {
+        return false;
+    }
+
+    // Simple axial and radial shadings are painted using native gradient,
+    // other shadings are painted using mesh.
+    QBrush brush = shadingPattern->createGradientBrush(getPatternBaseMatrix(), getMeshQualitySettings(), getCMS(), getGraphicState()->getRenderingIntent(), this);
+    if (brush.style() == Qt::NoBrush || !brush.gradient())
+    {
+        return false;
+    }
+
+    const PDFReal alpha = getEffectiveFillingAlpha();
+    if (alpha != 1.0)
+    {
+        QGradient gradient = *brush.gradient();
+        QGradientStops stops = gradient.stops();
+        for (QGradientStop& stop : stops)
+        {
+            stop.second.setAlphaF(stop.second.alphaF() * alpha);
+        }
+        gradient.setStops(stops);
+
+        QTransform brushTransform = brush.transform();
+        brush = QBrush(gradient);
+        brush.setTransform(brushTransform);
+    }
+
+    // Brush transform maps pattern space to device space, but path is painted in user space
+    brush.setTransform(brush.transform() * worldMatrix.inverted());
+    fillPath(path, brush);
+    return true;
+}
+
+bool PDFPainterBase::performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                                  const QRectF& tilingArea,
+                                                  PDFInteger columns,
+                                                  PDFInteger rows,
+                                                  const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                                  const PDFColor& uncoloredPatternColor)
+{
+    // Minimal number of cells, for which it pays off to render the cell image
+    constexpr PDFInteger MIN_CELL_COUNT = 16;
+
+    // Maximal width/height of the cell image in pixels
+    constexpr int MAX_CELL_IMAGE_SIZE = 512;
+
+    if (!hasFeature(PDFRenderer::TilingPatternCache) || isContentSuppressed() || columns * rows < MIN_CELL_COUNT)
+    {
+        return false;
+    }
+
+    // Cell image can be used only, if cells do not overlap (so bounding box
+    // fits into the step) and cells are not composed with the backdrop in some other way,
+    // than opaque source over composition.
+    const QRectF boundingBox = tilingPattern->getBoundingBox();
+    const PDFReal xStep = qAbs(tilingPattern->getXStep());
+    const PDFReal yStep = qAbs(tilingPattern->getYStep());
+    if (boundingBox.width() > xStep + PDF_EPSILON ||
+        boundingBox.height() > yStep + PDF_EPSILON ||
+        getEffectiveFillingAlpha() != 1.0 ||
+        isTransparencyGroupActive() ||
+        getGraphicState()->getBlendMode() != BlendMode::Normal)
+    {
+        return false;
+    }
+
+    const QTransform worldMatrix = getCurrentWorldMatrix();
+    const PDFReal xScale = QLineF(worldMatrix.map(QPointF(0.0, 0.0)), worldMatrix.map(QPointF(xStep, 0.0))).length() * m_tilingPatternImageScale;
+    const PDFReal yScale = QLineF(worldMatrix.map(QPointF(0.0, 0.0)), worldMatrix.map(QPointF(0.0, yStep))).length() * m_tilingPatternImageScale;
+    const int width = qMax(qCeil(xScale), 1);
+    const int height = qMax(qCeil(yScale), 1);
+
+    if (width > MAX_CELL_IMAGE_SIZE || height > MAX_CELL_IMAGE_SIZE)
+    {
+        // Cell is too large, replay the pattern content
+        return false;
+    }
+
+    const bool isUncolored = tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored;
+    const QRgb fillColor = isUncolored ? getGraphicState()->getFillColor().rgba() : 0;
+    TilingPatternImageKey key(tilingPattern, fillColor, width, height);
+
+    auto it = m_tilingPatternImages.find(key);
+    if (it == m_tilingPatternImages.end())
+    {
+        QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        // Matrix maps pattern cell space to the image
+        QTransform cellMatrix;
+        cellMatrix.scale(width / xStep, height / yStep);
+        cellMatrix.translate(-boundingBox.left(), -boundingBox.top());
+
+        PDFRenderer::Features cellFeatures = m_features;
+        cellFeatures.setFlag(PDFRenderer::ClipToCropBox, false);
+
+        QList<PDFRenderError> errors;
+        {
+            QPainter painter(&image);
+            PDFPainter cellPainter(&painter, cellFeatures, cellMatrix, getPage(), getDocument(), getFontCache(),
+                                   getCMS(), getOptionalContentActivity(), getMeshQualitySettings());
+            errors = cellPainter.processTilingPatternCell(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
+        }
+
+        for (const PDFRenderError& error : errors)
+        {
+            reportRenderErrorOnce(error.type, error.getMessage());
+        }
+
+        it = m_tilingPatternImages.emplace(std::move(key), std::move(image)).first;
+    }
+
+    // Brush maps the cell image onto the first cell, then it is repeated
+    QTransform brushMatrix;
+    brushMatrix.translate(tilingArea.left() + boundingBox.left(), tilingArea.top() + boundingBox.top());
+    brushMatrix.scale(xStep / width, yStep / height);
+
+    QBrush brush(it->second);
+    brush.setTransform(brushMatrix);
+
+    QPainterPath path;
+    path.addRect(QRectF(tilingArea.left() + boundingBox.left(), tilingArea.top() + boundingBox.top(), columns * xStep, rows * yStep));
+    fillPath(path, brush);
+
+    return true;
+}
+
 PDFPainter::PDFPainter(QPainter* painter,
                        PDFRenderer::Features features,
                        QTransform pagePointToDevicePointMatrix,
@@ -322,6 +500,23 @@ void PDFPainter::performImagePainting(const QImage& image)
     m_painter->restore();
 }
 
+QSize PDFPainter::getImageDeviceSize(const PDFStream* stream)
+{
+    Q_UNUSED(stream);
+
+    if (!PDFGlyphCache::isBlittingSupported(m_painter))
+    {
+        // Vector devices (printers, PDF writers) should receive images in full resolution
+        return QSize();
+    }
+
+    // Device transform contains also device pixel ratio of the paint device
+    const QTransform transform = m_painter->deviceTransform();
+    const QLineF mappedWidthVector = transform.map(QLineF(0, 0, 1, 0));
+    const QLineF mappedHeightVector = transform.map(QLineF(0, 0, 0, 1));
+    return QSize(qCeil(mappedWidthVector.length()), qCeil(mappedHeightVector.length()));
+}
+
 void PDFPainter::performMeshPainting(const PDFMesh& mesh)
 {
     m_painter->save();
@@ -346,6 +541,22 @@ void PDFPainter::performRestoreGraphicState(ProcessOrder order)
     }
 }
 
+bool PDFPainter::performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QRectF& tilingArea,
+                                              PDFInteger columns,
+                                              PDFInteger rows,
+                                              const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                              const PDFColor& uncoloredPatternColor)
+{
+    if (!PDFGlyphCache::isBlittingSupported(m_painter))
+    {
+        // Vector devices (printers, PDF writers) should receive exact vector graphics
+        return false;
+    }
+
+    return BaseClass::performTilingPatternPainting(tilingPattern, tilingArea, columns, rows, uncoloredPatternColorSpace, uncoloredPatternColor);
+}
+
 void PDFPainter::setWorldMatrix(const QTransform& matrix)
 {
     m_painter->setWorldTransform(QTransform(matrix), false);
@@ -356,6 +567,14 @@ void PDFPainter::setCompositionMode(QPainter::CompositionMode mode)
     m_painter->setCompositionMode(mode);
 }
 
+void PDFPainter::fillPath(const QPainterPath& path, const QBrush& brush)
+{
+    m_painter->setRenderHint(QPainter::Antialiasing, hasFeature(PDFRenderer::Antialiasing));
+    m_painter->setPen(Qt::NoPen);
+    m_painter->setBrush(brush);
+    m_painter->drawPath(path);
+}
+
 PDFPrecompiledPageGenerator::PDFPrecompiledPageGenerator(PDFPrecompiledPage* precompiledPage,
                                                          PDFRenderer::Features features,
                                                          const PDFPage* page,
@@ -367,8 +586,17 @@ PDFPrecompiledPageGenerator::PDFPrecompiledPageGenerator(PDFPrecompiledPage* pre
     BaseClass(features, page, document, fontCache, cms, optionalContentActivity, QTransform(), meshQualitySettings),
     m_precompiledPage(precompiledPage)
 {
+    // Page is compiled in the page space, so tiling pattern cell images are
+    // oversampled to look sharp also on zoomed page.
+    setTilingPatternImageScale(4.0);
+
     m_precompiledPage->setPaperColor(cms->getPaperColor());
     m_precompiledPage->getSnapInfo()->addPageMediaBox(page->getRotatedMediaBox());
+
+    if (fontCache)
+    {
+        m_precompiledPage->setGlyphCache(fontCache->getGlyphCache());
+    }
 }
 
 void PDFPrecompiledPageGenerator::performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
@@ -376,8 +604,18 @@ void PDFPrecompiledPageGenerator::performPathPainting(const QPainterPath& path,
     Q_ASSERT(stroke || fill);
     Q_ASSERT(path.fillRule() == fillRule);
 
+    updateOptionalContentCondition();
+
     QPen pen = stroke ? getCurrentPen() : QPen(Qt::NoPen);
     QBrush brush = fill ? getCurrentBrush() : QBrush(Qt::NoBrush);
+
+    const TextGlyph* textGlyph = text ? getCurrentTextGlyph() : nullptr;
+    if (textGlyph && !stroke && brush.style() == Qt::SolidPattern)
+    {
+        m_precompiledPage->addGlyph(qMove(brush), textGlyph->fontId, textGlyph->cid, *textGlyph->outline, textGlyph->glyphMatrix);
+        return;
+    }
+
     m_precompiledPage->addPath(qMove(pen), qMove(brush), path, text);
 }
 
@@ -387,6 +625,34 @@ void PDFPrecompiledPageGenerator::performClipping(const QPainterPath& path, Qt::
     m_precompiledPage->addClip(path);
 }
 
+QSize PDFPrecompiledPageGenerator::getImageDeviceSize(const PDFStream* stream)
+{
+    if (!m_isDraftImagesEnabled && !hasFeature(PDFRenderer::Draft_Images))
+    {
+        return QSize();
+    }
+
+    // Page is compiled in the page space, so image size is in points
+    const QTransform matrix = getCurrentWorldMatrix();
+    const QLineF mappedWidthVector = matrix.map(QLineF(0, 0, 1, 0));
+    const QLineF mappedHeightVector = matrix.map(QLineF(0, 0, 0, 1));
+    const QSize size(qCeil(mappedWidthVector.length()), qCeil(mappedHeightVector.length()));
+
+    // Draft images of the draft fidelity profile are final, page is marked
+    // as draft only, if it is compiled again later in the full resolution.
+    if (m_isDraftImagesEnabled && PDFImage::getResolutionReductionLevel(getDocument(), stream, size) > 0)
+    {
+        m_precompiledPage->setDraft(true);
+
+        for (SharedContentRecording& recording : m_sharedContentRecordings)
+        {
+            recording.isDraft = true;
+        }
+    }
+
+    return size;
+}
+
 void PDFPrecompiledPageGenerator::performImagePainting(const QImage& image)
 {
     if (isContentSuppressed())
@@ -395,6 +661,8 @@ void PDFPrecompiledPageGenerator::performImagePainting(const QImage& image)
         return;
     }
 
+    updateOptionalContentCondition();
+
     // Add snap info for image to the snapper
     QTransform matrix = getCurrentWorldMatrix();
     PDFSnapInfo* snapInfo = m_precompiledPage->getSnapInfo();
@@ -432,6 +700,7 @@ void PDFPrecompiledPageGenerator::performImagePainting(const QImage& image)
 
 void PDFPrecompiledPageGenerator::performMeshPainting(const PDFMesh& mesh)
 {
+    updateOptionalContentCondition();
     m_precompiledPage->addMesh(mesh, getEffectiveFillingAlpha());
 }
 
@@ -461,11 +730,141 @@ void PDFPrecompiledPageGenerator::setCompositionMode(QPainter::CompositionMode m
     m_precompiledPage->addSetCompositionMode(mode);
 }
 
+void PDFPrecompiledPageGenerator::fillPath(const QPainterPath& path, const QBrush& brush)
+{
+    updateOptionalContentCondition();
+    m_precompiledPage->addPath(QPen(Qt::NoPen), brush, path, false);
+}
+
+bool PDFPrecompiledPageGenerator::isContentSuppressedByOC(PDFObjectReference ocgOrOcmd)
+{
+    if (m_isOptionalContentRecordingEnabled)
+    {
+        // Optional content is compiled always, it is
+        // skipped, when precompiled page is drawn.
+        return false;
+    }
+
+    return BaseClass::isContentSuppressedByOC(ocgOrOcmd);
+}
+
+bool PDFPrecompiledPageGenerator::performBeginFormContent(const PDFStream* stream)
+{
+    SharedContentRecording recording;
+    recording.stream = stream;
+    recording.isShared = createSharedContentKey(stream, recording.key);
+
+    if (recording.isShared)
+    {
+        PDFSharedContentCache* sharedContentCache = getFontCache()->getSharedContentCache().get();
+        if (std::shared_ptr<const PDFPrecompiledPage> content = sharedContentCache->find(recording.key))
+        {
+            m_precompiledPage->appendInstructions(*content, getCurrentWorldMatrix());
+
+            for (SharedContentRecording& parentRecording : m_sharedContentRecordings)
+            {
+                parentRecording.isDraft = parentRecording.isDraft || content->isDraft();
+            }
+
+            return true;
+        }
+
+        recording.firstInstruction = m_precompiledPage->getInstructionCount();
+        recording.renderErrorCount = getRenderErrorCount();
+    }
+
+    m_sharedContentRecordings.emplace_back(qMove(recording));
+    return false;
+}
+
+void PDFPrecompiledPageGenerator::performEndFormContent(const PDFStream* stream)
+{
+    // Recordings of forms, which content was interrupted by an error, are discarded
+    while (!m_sharedContentRecordings.empty() && m_sharedContentRecordings.back().stream != stream)
+    {
+        m_sharedContentRecordings.pop_back();
+    }
+
+    if (m_sharedContentRecordings.empty())
+    {
+        return;
+    }
+
+    SharedContentRecording recording = qMove(m_sharedContentRecordings.back());
+    m_sharedContentRecordings.pop_back();
+
+    // Errors are reported only for the page, on which the content was compiled,
+    // so content with errors is not shared. Content of cancelled processing
+    // is incomplete.
+    if (!recording.isShared || recording.renderErrorCount != getRenderErrorCount() || isProcessingCancelled())
+    {
+        return;
+    }
+
+    std::shared_ptr<PDFPrecompiledPage> content = m_precompiledPage->extractInstructions(recording.firstInstruction);
+    content->setDraft(recording.isDraft);
+    getFontCache()->getSharedContentCache()->insert(qMove(recording.key), stream->weak_from_this().lock(), qMove(content));
+}
+
+bool PDFPrecompiledPageGenerator::createSharedContentKey(const PDFStream* stream, PDFSharedContentCache::Key& key) const
+{
+    // Compiled content of the form can be shared only, if it doesn't
+    // depend on the page. Form without resources uses resources of the page,
+    // transparency groups are emulated using alpha of the group, and if optional
+    // content is not recorded, then hidden content is not compiled at all.
+    if (!getFontCache() ||
+        !getFontCache()->getSharedContentCache() ||
+        !stream->getDictionary()->hasKey(PDFNames::Resources) ||
+        isContentSuppressed() ||
+        isTransparencyGroupActive() ||
+        isTextProcessing() ||
+        (!m_isOptionalContentRecordingEnabled && !hasFeature(PDFRenderer::IgnoreOptionalContent)))
+    {
+        return false;
+    }
+
+    const PDFMeshQualitySettings& meshQualitySettings = getMeshQualitySettings();
+
+    key.stream = stream;
+    key.cmsSerialNumber = getCMS()->getSerialNumber();
+    key.features = qint32(getFeatures());
+    key.isDraftImagesEnabled = m_isDraftImagesEnabled;
+    key.isOptionalContentRecordingEnabled = m_isOptionalContentRecordingEnabled;
+    key.meshQualityRatios = { meshQualitySettings.minimalMeshResolutionRatio,
+                              meshQualitySettings.preferredMeshResolutionRatio,
+                              meshQualitySettings.patchResolutionMappingRatioLow,
+                              meshQualitySettings.patchResolutionMappingRatioHigh };
+    key.meshColorTolerance = meshQualitySettings.tolerance;
+    key.meshPatchTestPoints = meshQualitySettings.patchTestPoints;
+    key.meshGradientStopCount = meshQualitySettings.gradientStopCount;
+    key.optionalContentReferences = getOptionalContentReferences();
+    key.state = *getGraphicState();
+    return true;
+}
+
+void PDFPrecompiledPageGenerator::updateOptionalContentCondition()
+{
+    if (!m_isOptionalContentRecordingEnabled)
+    {
+        return;
+    }
+
+    std::vector<PDFObjectReference> references = getOptionalContentReferences();
+    if (references != m_optionalContentReferences)
+    {
+        auto isHidden = [this](PDFObjectReference reference) { return BaseClass::isContentSuppressedByOC(reference); };
+        const bool isVisible = std::none_of(references.cbegin(), references.cend(), isHidden);
+        m_precompiledPage->setOptionalContentCondition(references, isVisible);
+        m_optionalContentReferences = qMove(references);
+    }
+}
+
 void PDFPrecompiledPage::draw(QPainter* painter,
                               const QRectF& cropBox,
                               const QTransform& pagePointToDevicePointMatrix,
                               PDFRenderer::Features features,
-                              PDFReal opacity) const
+                              PDFReal opacity,
+                              const PDFOptionalContentActivity* optionalContentActivity) const
 {
     Q_ASSERT(painter);
     Q_ASSERT(pagePointToDevicePointMatrix.isInvertible());
@@ -486,28 +885,149 @@ void PDFPrecompiledPage::draw(QPainter* painter,
 
     painter->setRenderHint(QPainter::SmoothPixmapTransform, features.testFlag(PDFRenderer::SmoothImages));
 
+    // Determine visible instructions, if only part of the page is visible
+    // (for example, page is zoomed). It is done only, if painter's logical
+    // coordinates are the device coordinates. Vector devices (such as
+    // printers or content stream builders) always receive all instructions.
+    std::vector<bool> visibleInstructions;
+    const int deviceType = painter->device() ? painter->device()->devType() : QInternal::UnknownDevice;
+    const bool isRasterDevice = deviceType == QInternal::Widget || deviceType == QInternal::Image || deviceType == QInternal::Pixmap;
+    if (m_spatialIndex.isValid() && isRasterDevice && (!painter->viewTransformEnabled() || painter->window() == painter->viewport()))
+    {
+        QRectF deviceVisibleRect = painter->window();
+        if (painter->hasClipping())
+        {
+            deviceVisibleRect = deviceVisibleRect.intersected(painter->clipBoundingRect());
+        }
+
+        // Add small tolerance for antialiasing and cosmetic pens
+        deviceVisibleRect.adjust(-2.0, -2.0, 2.0, 2.0);
+        QRectF visibleRect = pagePointToDevicePointMatrix.inverted().mapRect(deviceVisibleRect);
+
+        if (!visibleRect.contains(m_spatialIndex.bounds))
+        {
+            visibleInstructions = getVisibleInstructions(visibleRect);
+        }
+    }
+
+    // Drawing instructions of hidden optional content are skipped, so changing
+    // the state of optional content doesn't require page to be compiled again.
+    const std::vector<bool> optionalContentVisibility = getOptionalContentVisibility(features, optionalContentActivity);
+
+    // Small text glyphs can be painted from the glyph cache
+    const bool isGlyphCacheUsed = m_glyphCache && !m_glyphRuns.empty() && PDFGlyphCache::isBlittingSupported(painter);
+
+    // Blend2D paint device paints glyph runs directly, without building
+    // the glyph paths for each glyph again and again.
+    PDFBLPaintDevice* blPaintDevice = !m_glyphRuns.empty() ? dynamic_cast<PDFBLPaintDevice*>(painter->device()) : nullptr;
+
+    // Downscaled images are drawn from the nearest mipmap level
+    const bool isImageMipmapsUsed = features.testFlag(PDFRenderer::SmoothImages) && !m_images.empty() && PDFGlyphCache::isBlittingSupported(painter);
+
     // Process all instructions
-    for (const Instruction& instruction : m_instructions)
+    for (size_t i = 0; i < m_instructions.size(); ++i)
     {
+        const Instruction& instruction = m_instructions[i];
+
+        if (!visibleInstructions.empty() && !visibleInstructions[i])
+        {
+            // Instruction is a drawing instruction, which is not visible
+            continue;
+        }
+
+        if (!optionalContentVisibility.empty() && !optionalContentVisibility[instruction.optionalContentCondition])
+        {
+            // Instruction is a drawing instruction of hidden optional content
+            continue;
+        }
+
         switch (instruction.type)
         {
             case InstructionType::DrawPath:
             {
                 const PathPaintData& data = m_paths[instruction.dataIndex];
+                const QPen& pen = m_pens[data.penIndex];
+                const QBrush& brush = m_brushes[data.brushIndex];
+                PDFInstrumentationTimer instrumentationTimer(data.isText ? PDFInstrumentationStage::Text : PDFInstrumentationStage::PathFill);
 
                 // Set antialiasing
                 const bool antialiasing = (data.isText && features.testFlag(PDFRenderer::TextAntialiasing)) || (!data.isText && features.testFlag(PDFRenderer::Antialiasing));
+
                 painter->setRenderHint(QPainter::Antialiasing, antialiasing);
-                painter->setPen(data.pen);
-                painter->setBrush(data.brush);
+
+                if (!data.strokeOutline.isEmpty() && qSqrt(qAbs(painter->worldTransform().determinant())) <= STROKE_OUTLINE_MAX_SCALE)
+                {
+                    // Stroke outline is cached, so fill the path and then the stroke outline
+                    painter->setPen(Qt::NoPen);
+
+                    if (brush.style() != Qt::NoBrush)
+                    {
+                        painter->setBrush(brush);
+                        painter->drawPath(data.path);
+                    }
+
+                    painter->setBrush(pen.brush());
+                    painter->drawPath(data.strokeOutline);
+                    break;
+                }
+
+                painter->setPen(pen);
+                painter->setBrush(brush);
                 painter->drawPath(data.path);
                 break;
             }
 
+            case InstructionType::DrawGlyphRun:
+            {
+                const GlyphRunData& data = m_glyphRuns[instruction.dataIndex];
+                const bool antialiasing = features.testFlag(PDFRenderer::TextAntialiasing);
+                const QTransform worldMatrix = painter->worldTransform();
+                PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::Text);
+
+                painter->setRenderHint(QPainter::Antialiasing, antialiasing);
+                painter->setPen(Qt::NoPen);
+                painter->setBrush(data.brush);
+
+                if (blPaintDevice)
+                {
+                    blPaintDevice->drawGlyphRun(painter, data.fontId, data.matrix, data.positions, data.cids, data.outlines);
+                    break;
+                }
+
+                // Glyph outlines are filled in text space, so glyph paths
+                // in user space need not to be created.
+                for (size_t glyphIndex = 0; glyphIndex < data.outlines.size(); ++glyphIndex)
+                {
+                    const QTransform glyphMatrix = data.getGlyphMatrix(glyphIndex) * worldMatrix;
+                    const QPainterPath& outline = data.outlines[glyphIndex];
+
+                    if (isGlyphCacheUsed && data.fontId != 0 && m_glyphCache->drawGlyph(painter, glyphMatrix, data.fontId, data.cids[glyphIndex], outline, data.brush.color(), antialiasing))
+                    {
+                        continue;
+                    }
+
+                    painter->setWorldTransform(glyphMatrix);
+                    painter->drawPath(outline);
+                }
+
+                painter->setWorldTransform(worldMatrix);
+                break;
+            }
+
             case InstructionType::DrawImage:
             {
                 const ImageData& data = m_images[instruction.dataIndex];
-                const QImage& image = data.image;
+                QImage image = data.image;
+
+                if (isImageMipmapsUsed && data.mipmaps)
+                {
+                    // Image is mapped from the unit square, so lengths of the
+                    // mapped unit vectors are the image size on the device.
+                    const QTransform& deviceTransform = painter->deviceTransform();
+                    const qreal deviceWidth = QLineF(deviceTransform.map(QPointF(0, 0)), deviceTransform.map(QPointF(1, 0))).length();
+                    const qreal deviceHeight = QLineF(deviceTransform.map(QPointF(0, 0)), deviceTransform.map(QPointF(0, 1))).length();
+                    image = data.mipmaps->getImage(QSize(qCeil(deviceWidth), qCeil(deviceHeight)));
+                }
 
                 painter->save();
 
@@ -585,6 +1105,9 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
         return;
     }
 
+    // Instructions are modified, so spatial index is no longer valid
+    m_spatialIndex.clear();
+
     std::stack<QTransform> worldMatrixStack;
     worldMatrixStack.push(matrix);
 
@@ -594,7 +1117,7 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
     }
 
     // Process all instructions
-    for (const Instruction& instruction : m_instructions)
+    for (Instruction& instruction : m_instructions)
     {
         switch (instruction.type)
         {
@@ -604,6 +1127,26 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
                 QPainterPath mappedRedactPath = currentMatrix.map(redactPath);
                 PathPaintData& path = m_paths[instruction.dataIndex];
                 path.path = path.path.subtracted(mappedRedactPath);
+                path.strokeOutline = QPainterPath();
+                break;
+            }
+
+            case InstructionType::DrawGlyphRun:
+            {
+                // Glyph run is replaced by the path, from which redacted area is removed
+                QTransform currentMatrix = worldMatrixStack.top().inverted();
+                QPainterPath mappedRedactPath = currentMatrix.map(redactPath);
+                GlyphRunData data = qMove(m_glyphRuns[instruction.dataIndex]);
+                m_glyphRuns[instruction.dataIndex] = GlyphRunData();
+
+                QPainterPath path;
+                for (size_t glyphIndex = 0; glyphIndex < data.outlines.size(); ++glyphIndex)
+                {
+                    path = path.united(data.getGlyphPath(glyphIndex).subtracted(mappedRedactPath));
+                }
+
+                instruction = Instruction(InstructionType::DrawPath, m_paths.size());
+                m_paths.emplace_back(intern(m_pens, QPen(Qt::NoPen)), intern(m_brushes, data.brush), qMove(path), true);
                 break;
             }
 
@@ -671,8 +1214,51 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
 
 void PDFPrecompiledPage::addPath(QPen pen, QBrush brush, QPainterPath path, bool isText)
 {
-    m_instructions.emplace_back(InstructionType::DrawPath, m_paths.size());
-    m_paths.emplace_back(qMove(pen), qMove(brush), qMove(path), isText);
+    m_instructions.emplace_back(InstructionType::DrawPath, m_paths.size(), m_currentOptionalContentCondition);
+    m_paths.emplace_back(intern(m_pens, pen), intern(m_brushes, brush), qMove(path), isText);
+}
+
+template<typename T>
+uint32_t PDFPrecompiledPage::intern(std::vector<T>& table, const T& value)
+{
+    const size_t lookupStart = table.size() > INTERN_LOOKUP_COUNT ? table.size() - INTERN_LOOKUP_COUNT : 0;
+    for (size_t i = table.size(); i > lookupStart; --i)
+    {
+        if (table[i - 1] == value)
+        {
+            return uint32_t(i - 1);
+        }
+    }
+
+    table.push_back(value);
+    return uint32_t(table.size() - 1);
+}
+
+void PDFPrecompiledPage::addGlyph(QBrush brush, quint64 fontId, CID cid, QPainterPath outline, const QTransform& glyphMatrix)
+{
+    const QTransform matrix(glyphMatrix.m11(), glyphMatrix.m12(), glyphMatrix.m21(), glyphMatrix.m22(), 0.0, 0.0);
+
+    const bool isNewRun = m_instructions.empty() ||
+                          m_instructions.back().type != InstructionType::DrawGlyphRun ||
+                          m_instructions.back().optionalContentCondition != m_currentOptionalContentCondition ||
+                          m_glyphRuns[m_instructions.back().dataIndex].fontId != fontId ||
+                          m_glyphRuns[m_instructions.back().dataIndex].matrix != matrix ||
+                          m_glyphRuns[m_instructions.back().dataIndex].brush != brush;
+    if (isNewRun)
+    {
+        m_instructions.emplace_back(InstructionType::DrawGlyphRun, m_glyphRuns.size(), m_currentOptionalContentCondition);
+
+        GlyphRunData data;
+        data.brush = qMove(brush);
+        data.fontId = fontId;
+        data.matrix = matrix;
+        m_glyphRuns.emplace_back(qMove(data));
+    }
+
+    GlyphRunData& data = m_glyphRuns[m_instructions.back().dataIndex];
+    data.cids.push_back(cid);
+    data.positions.emplace_back(glyphMatrix.dx(), glyphMatrix.dy());
+    data.outlines.emplace_back(qMove(outline));
 }
 
 void PDFPrecompiledPage::addClip(QPainterPath path)
@@ -683,20 +1269,19 @@ void PDFPrecompiledPage::addClip(QPainterPath path)
 
 void PDFPrecompiledPage::addImage(QImage image)
 {
-    m_instructions.emplace_back(InstructionType::DrawImage, m_images.size());
+    m_instructions.emplace_back(InstructionType::DrawImage, m_images.size(), m_currentOptionalContentCondition);
     m_images.emplace_back(qMove(image));
 }
 
 void PDFPrecompiledPage::addMesh(PDFMesh mesh, PDFReal alpha)
 {
-    m_instructions.emplace_back(InstructionType::DrawMesh, m_meshes.size());
+    m_instructions.emplace_back(InstructionType::DrawMesh, m_meshes.size(), m_currentOptionalContentCondition);
     m_meshes.emplace_back(qMove(mesh), alpha);
 }
 
 void PDFPrecompiledPage::addSetWorldMatrix(const QTransform& matrix)
 {
-    m_instructions.emplace_back(InstructionType::SetWorldMatrix, m_matrices.size());
-    m_matrices.push_back(matrix);
+    m_instructions.emplace_back(InstructionType::SetWorldMatrix, intern(m_matrices, matrix));
 }
 
 void PDFPrecompiledPage::addSetCompositionMode(QPainter::CompositionMode compositionMode)
@@ -705,16 +1290,205 @@ void PDFPrecompiledPage::addSetCompositionMode(QPainter::CompositionMode composi
     m_compositionModes.push_back(compositionMode);
 }
 
-void PDFPrecompiledPage::optimize()
+void PDFPrecompiledPage::setOptionalContentCondition(const std::vector<PDFObjectReference>& references, bool isVisible)
 {
-    m_instructions.shrink_to_fit();
-    m_paths.shrink_to_fit();
-    m_clips.shrink_to_fit();
-    m_images.shrink_to_fit();
-    m_meshes.shrink_to_fit();
-    m_matrices.shrink_to_fit();
-    m_compositionModes.shrink_to_fit();
-}
+    if (references.empty())
+    {
+        m_currentOptionalContentCondition = 0;
+        return;
+    }
+
+    auto it = std::find_if(m_optionalContentConditions.cbegin(), m_optionalContentConditions.cend(), [&references](const OptionalContentCondition& condition) { return condition.references == references; });
+    if (it == m_optionalContentConditions.cend())
+    {
+        OptionalContentCondition condition;
+        condition.references = references;
+        condition.isVisible = isVisible;
+        m_optionalContentConditions.emplace_back(qMove(condition));
+        it = std::prev(m_optionalContentConditions.cend());
+    }
+
+    m_currentOptionalContentCondition = static_cast<uint32_t>(std::distance(m_optionalContentConditions.cbegin(), it)) + 1;
+}
+
+std::shared_ptr<PDFPrecompiledPage> PDFPrecompiledPage::extractInstructions(size_t firstInstruction) const
+{
+    std::shared_ptr<PDFPrecompiledPage> fragment = std::make_shared<PDFPrecompiledPage>();
+    for (size_t i = firstInstruction; i < m_instructions.size(); ++i)
+    {
+        fragment->appendInstruction(*this, m_instructions[i]);
+    }
+
+    fragment->m_currentOptionalContentCondition = 0;
+    fragment->optimize();
+    fragment->updateMemoryConsumptionEstimate();
+    return fragment;
+}
+
+void PDFPrecompiledPage::appendInstructions(const PDFPrecompiledPage& fragment, const QTransform& matrix)
+{
+    const uint32_t currentOptionalContentCondition = m_currentOptionalContentCondition;
+
+    // World matrix is tracked, so images of the fragment
+    // can be added to the snap info at the right place.
+    QTransform currentMatrix = matrix;
+    std::vector<QTransform> savedMatrices;
+
+    for (const Instruction& instruction : fragment.m_instructions)
+    {
+        switch (instruction.type)
+        {
+            case InstructionType::SaveGraphicState:
+                savedMatrices.push_back(currentMatrix);
+                break;
+
+            case InstructionType::RestoreGraphicState:
+                if (!savedMatrices.empty())
+                {
+                    currentMatrix = savedMatrices.back();
+                    savedMatrices.pop_back();
+                }
+                break;
+
+            case InstructionType::SetWorldMatrix:
+                currentMatrix = fragment.m_matrices[instruction.dataIndex];
+                break;
+
+            case InstructionType::DrawImage:
+                m_snapInfo.addImage({
+                                        currentMatrix.map(QPointF(0.0, 0.0)),
+                                        currentMatrix.map(QPointF(1.0, 0.0)),
+                                        currentMatrix.map(QPointF(1.0, 1.0)),
+                                        currentMatrix.map(QPointF(0.0, 1.0)),
+                                        currentMatrix.map(QPointF(0.5, 0.5)),
+                                    }, fragment.m_images[instruction.dataIndex].image);
+                break;
+
+            default:
+                break;
+        }
+
+        appendInstruction(fragment, instruction);
+    }
+
+    m_currentOptionalContentCondition = currentOptionalContentCondition;
+    m_isDraft = m_isDraft || fragment.m_isDraft;
+}
+
+void PDFPrecompiledPage::appendInstruction(const PDFPrecompiledPage& source, const Instruction& instruction)
+{
+    // Optional content condition of the source page is mapped to the condition of this page
+    if (instruction.optionalContentCondition > 0)
+    {
+        const OptionalContentCondition& condition = source.m_optionalContentConditions[instruction.optionalContentCondition - 1];
+        setOptionalContentCondition(condition.references, condition.isVisible);
+    }
+    else
+    {
+        m_currentOptionalContentCondition = 0;
+    }
+
+    switch (instruction.type)
+    {
+        case InstructionType::DrawPath:
+        {
+            const PathPaintData& data = source.m_paths[instruction.dataIndex];
+            addPath(source.m_pens[data.penIndex], source.m_brushes[data.brushIndex], data.path, data.isText);
+            break;
+        }
+
+        case InstructionType::DrawImage:
+            addImage(source.m_images[instruction.dataIndex].image);
+            break;
+
+        case InstructionType::DrawMesh:
+        {
+            const MeshPaintData& data = source.m_meshes[instruction.dataIndex];
+            addMesh(data.mesh, data.alpha);
+            break;
+        }
+
+        case InstructionType::Clip:
+            addClip(source.m_clips[instruction.dataIndex].clipPath);
+            break;
+
+        case InstructionType::SaveGraphicState:
+            addSaveGraphicState();
+            break;
+
+        case InstructionType::RestoreGraphicState:
+            addRestoreGraphicState();
+            break;
+
+        case InstructionType::SetWorldMatrix:
+            addSetWorldMatrix(source.m_matrices[instruction.dataIndex]);
+            break;
+
+        case InstructionType::SetCompositionMode:
+            addSetCompositionMode(source.m_compositionModes[instruction.dataIndex]);
+            break;
+
+        case InstructionType::DrawGlyphRun:
+            // Glyph run is copied as a whole, it must not be merged with the previous one
+            m_instructions.emplace_back(InstructionType::DrawGlyphRun, m_glyphRuns.size(), m_currentOptionalContentCondition);
+            m_glyphRuns.push_back(source.m_glyphRuns[instruction.dataIndex]);
+            break;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+}
+
+std::vector<bool> PDFPrecompiledPage::getOptionalContentVisibility(PDFRenderer::Features features, const PDFOptionalContentActivity* optionalContentActivity) const
+{
+    std::vector<bool> visibility;
+
+    if (m_optionalContentConditions.empty() || features.testFlag(PDFRenderer::IgnoreOptionalContent))
+    {
+        return visibility;
+    }
+
+    auto isHidden = [optionalContentActivity](PDFObjectReference reference) { return optionalContentActivity->getVisibilityState(reference, nullptr) == OCState::OFF; };
+
+    visibility.reserve(m_optionalContentConditions.size() + 1);
+    visibility.push_back(true);
+    for (const OptionalContentCondition& condition : m_optionalContentConditions)
+    {
+        if (optionalContentActivity)
+        {
+            visibility.push_back(std::none_of(condition.references.cbegin(), condition.references.cend(), isHidden));
+        }
+        else
+        {
+            visibility.push_back(condition.isVisible);
+        }
+    }
+
+    return visibility;
+}
+
+void PDFPrecompiledPage::optimize()
+{
+    m_instructions.shrink_to_fit();
+    m_paths.shrink_to_fit();
+    m_pens.shrink_to_fit();
+    m_brushes.shrink_to_fit();
+    m_clips.shrink_to_fit();
+    m_images.shrink_to_fit();
+    m_meshes.shrink_to_fit();
+    m_glyphRuns.shrink_to_fit();
+
+    for (GlyphRunData& data : m_glyphRuns)
+    {
+        data.cids.shrink_to_fit();
+        data.positions.shrink_to_fit();
+        data.outlines.shrink_to_fit();
+    }
+    m_matrices.shrink_to_fit();
+    m_compositionModes.shrink_to_fit();
+    m_optionalContentConditions.shrink_to_fit();
+}
 
 void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
 {
@@ -728,21 +1502,90 @@ void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
         return;
     }
 
+    // Conversion of the color depends on whether it is used for text, so pens
+    // and brushes shared by text and non-text paths are converted twice.
+    // Tables of converted pens and brushes are created.
+    std::vector<QPen> convertedPens;
+    std::vector<QBrush> convertedBrushes;
+    std::map<std::pair<uint32_t, bool>, uint32_t> convertedPenIndices;
+    std::map<std::pair<uint32_t, bool>, uint32_t> convertedBrushIndices;
+
+    auto convertPen = [&](QPen pen, bool isText)
+    {
+        if (pen.style() != Qt::NoPen)
+        {
+            pen.setColor(colorConvertor.convert(pen.color(), false, isText));
+        }
+        return pen;
+    };
+
+    auto convertBrush = [&](const QBrush& brush, bool isText)
+    {
+        if (brush.style() == Qt::SolidPattern)
+        {
+            QBrush convertedBrush = brush;
+            convertedBrush.setColor(colorConvertor.convert(brush.color(), false, isText));
+            return convertedBrush;
+        }
+        else if (const QGradient* gradient = brush.gradient())
+        {
+            // Shading painted using native gradient
+            QGradient convertedGradient = *gradient;
+            QGradientStops stops = convertedGradient.stops();
+            for (QGradientStop& stop : stops)
+            {
+                stop.second = colorConvertor.convert(stop.second, false, isText);
+            }
+            convertedGradient.setStops(stops);
+
+            QBrush convertedBrush(convertedGradient);
+            convertedBrush.setTransform(brush.transform());
+            return convertedBrush;
+        }
+        else if (brush.style() == Qt::TexturePattern)
+        {
+            // Tiling pattern cell image
+            QBrush convertedBrush(colorConvertor.convert(brush.textureImage()));
+            convertedBrush.setTransform(brush.transform());
+            return convertedBrush;
+        }
+
+        return brush;
+    };
+
     for (PathPaintData& pathData : m_paths)
     {
-        if (pathData.pen.style() != Qt::NoPen)
+        const std::pair<uint32_t, bool> penKey(pathData.penIndex, pathData.isText);
+        auto penIt = convertedPenIndices.find(penKey);
+        if (penIt == convertedPenIndices.end())
         {
-            pathData.pen.setColor(colorConvertor.convert(pathData.pen.color(), false, pathData.isText));
+            penIt = convertedPenIndices.emplace(penKey, uint32_t(convertedPens.size())).first;
+            convertedPens.push_back(convertPen(m_pens[pathData.penIndex], pathData.isText));
         }
-        if (pathData.brush.style() == Qt::SolidPattern)
+        pathData.penIndex = penIt->second;
+
+        const std::pair<uint32_t, bool> brushKey(pathData.brushIndex, pathData.isText);
+        auto brushIt = convertedBrushIndices.find(brushKey);
+        if (brushIt == convertedBrushIndices.end())
         {
-            pathData.brush.setColor(colorConvertor.convert(pathData.brush.color(), false, pathData.isText));
+            brushIt = convertedBrushIndices.emplace(brushKey, uint32_t(convertedBrushes.size())).first;
+            convertedBrushes.push_back(convertBrush(m_brushes[pathData.brushIndex], pathData.isText));
         }
+        pathData.brushIndex = brushIt->second;
+    }
+
+    m_pens = std::move(convertedPens);
+    m_brushes = std::move(convertedBrushes);
+
+    for (GlyphRunData& glyphRunData : m_glyphRuns)
+    {
+        glyphRunData.brush.setColor(colorConvertor.convert(glyphRunData.brush.color(), false, true));
     }
 
     for (ImageData& imageData : m_images)
     {
         imageData.image = colorConvertor.convert(imageData.image);
+        imageData.mipmaps.reset();
     }
 
     for (MeshPaintData& meshPaintData : m_meshes)
@@ -757,16 +1600,67 @@ void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError>
 {
     m_compilingTimeNS = compilingTimeNS;
     m_errors = qMove(errors);
+    m_currentOptionalContentCondition = 0;
+
+    createStrokeOutlines();
+    createImageMipmaps();
+    buildSpatialIndex();
+    updateMemoryConsumptionEstimate();
+}
 
+void PDFPrecompiledPage::createImageMipmaps()
+{
+    for (ImageData& data : m_images)
+    {
+        data.mipmaps.reset();
+
+        if (PDFImageMipmaps::isMipmapsUsed(data.image))
+        {
+            data.mipmaps = std::make_shared<PDFImageMipmaps>(data.image);
+        }
+    }
+}
+
+void PDFPrecompiledPage::createStrokeOutlines()
+{
+    auto createStrokeOutline = [this](PathPaintData& data)
+    {
+        const QPen& pen = m_pens[data.penIndex];
+        if (data.isText || pen.style() == Qt::NoPen || pen.isCosmetic() || pen.widthF() <= 0.0)
+        {
+            return;
+        }
+
+        // Solid thin strokes are stroked fast by the painter
+        if (pen.style() == Qt::SolidLine && pen.widthF() < STROKE_OUTLINE_MIN_WIDTH)
+        {
+            return;
+        }
+
+        QPainterPathStroker stroker(pen);
+        stroker.setCurveThreshold(STROKE_OUTLINE_CURVE_THRESHOLD);
+        data.strokeOutline = stroker.createStroke(data.path);
+        data.strokeOutline.setFillRule(Qt::WindingFill);
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, m_paths.begin(), m_paths.end(), createStrokeOutline);
+}
+
+void PDFPrecompiledPage::updateMemoryConsumptionEstimate()
+{
     // Determine memory consumption
     m_memoryConsumptionEstimate = sizeof(*this);
     m_memoryConsumptionEstimate += sizeof(Instruction) * m_instructions.capacity();
     m_memoryConsumptionEstimate += sizeof(PathPaintData) * m_paths.capacity();
+    m_memoryConsumptionEstimate += sizeof(QPen) * m_pens.capacity();
+    m_memoryConsumptionEstimate += sizeof(QBrush) * m_brushes.capacity();
     m_memoryConsumptionEstimate += sizeof(ClipData) * m_clips.capacity();
     m_memoryConsumptionEstimate += sizeof(ImageData) * m_images.capacity();
     m_memoryConsumptionEstimate += sizeof(MeshPaintData) * m_meshes.capacity();
+    m_memoryConsumptionEstimate += sizeof(GlyphRunData) * m_glyphRuns.capacity();
     m_memoryConsumptionEstimate += sizeof(QTransform) * m_matrices.capacity();
     m_memoryConsumptionEstimate += sizeof(QPainter::CompositionMode) * m_compositionModes.capacity();
+    m_memoryConsumptionEstimate += sizeof(OptionalContentCondition) * m_optionalContentConditions.capacity();
     m_memoryConsumptionEstimate += sizeof(PDFRenderError) * m_errors.size();
 
     auto calculateQPathMemoryConsumption = [](const QPainterPath& path)
@@ -776,91 +1670,858 @@ void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError>
     for (const PathPaintData& data : m_paths)
     {
         m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.path);
+        m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.strokeOutline);
     }
     for (const ClipData& data : m_clips)
     {
         m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.clipPath);
     }
+    for (const GlyphRunData& data : m_glyphRuns)
+    {
+        // Glyph outlines are shared with the font cache
+        m_memoryConsumptionEstimate += sizeof(CID) * data.cids.capacity();
+        m_memoryConsumptionEstimate += sizeof(QPointF) * data.positions.capacity();
+        m_memoryConsumptionEstimate += sizeof(QPainterPath) * data.outlines.capacity();
+    }
     for (const ImageData& data : m_images)
     {
         m_memoryConsumptionEstimate += data.image.sizeInBytes();
+
+        if (data.mipmaps)
+        {
+            m_memoryConsumptionEstimate += data.mipmaps->getMemoryConsumptionEstimate();
+        }
     }
     for (const MeshPaintData& data : m_meshes)
     {
         m_memoryConsumptionEstimate += data.mesh.getMemoryConsumptionEstimate();
     }
+
+    m_memoryConsumptionEstimate += sizeof(QRectF) * m_spatialIndex.instructionBounds.capacity();
+    m_memoryConsumptionEstimate += sizeof(uint32_t) * m_spatialIndex.unboundedInstructions.capacity();
+    for (const std::vector<uint32_t>& cell : m_spatialIndex.cells)
+    {
+        m_memoryConsumptionEstimate += sizeof(cell) + sizeof(uint32_t) * cell.capacity();
+    }
 }
 
-PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceInfos(QRectF mediaBox,
-                                                                                     PDFReal epsilon) const
+static void serializeImage(QDataStream& stream, const QImage& image)
 {
-    GraphicPieceInfos infos;
+    // Images are stored as raw data, standard image serialization
+    // uses PNG compression, which is too slow for caching purposes.
+    stream << qint32(image.format());
+    stream << qint32(image.width());
+    stream << qint32(image.height());
+    stream << image.colorTable();
+    stream << image.colorSpace();
+
+    const qsizetype lineSize = image.isNull() ? 0 : (qsizetype(image.width()) * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        stream.writeRawData(reinterpret_cast<const char*>(image.constScanLine(y)), lineSize);
+    }
+}
 
-    struct State
+static QImage deserializeImage(QDataStream& stream)
+{
+    qint32 format = QImage::Format_Invalid;
+    qint32 width = 0;
+    qint32 height = 0;
+    QList<QRgb> colorTable;
+    QColorSpace colorSpace;
+
+    stream >> format;
+    stream >> width;
+    stream >> height;
+    stream >> colorTable;
+    stream >> colorSpace;
+
+    if (stream.status() != QDataStream::Ok ||
+        format <= QImage::Format_Invalid ||
+        format >= QImage::NImageFormats ||
+        width <= 0 ||
+        height <= 0)
     {
-        QTransform matrix;
-    };
-    std::stack<State> stateStack;
-    stateStack.emplace();
+        return QImage();
+    }
 
-    // Check, if epsilon is not too small
-    if (qFuzzyIsNull(epsilon))
+    QImage image(width, height, static_cast<QImage::Format>(format));
+    if (image.isNull())
     {
-        epsilon = 0.000001;
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return QImage();
     }
-    PDFReal factor = 1.0 / epsilon;
 
-    QImage shadingTestImage;
+    const qsizetype lineSize = (qsizetype(image.width()) * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        if (stream.readRawData(reinterpret_cast<char*>(image.scanLine(y)), lineSize) != lineSize)
+        {
+            stream.setStatus(QDataStream::ReadPastEnd);
+            return QImage();
+        }
+    }
 
-    // Process all instructions
+    if (!colorTable.isEmpty())
+    {
+        image.setColorTable(colorTable);
+    }
+    image.setColorSpace(colorSpace);
+    return image;
+}
+
+void PDFPrecompiledPage::serialize(QDataStream& stream) const
+{
+    // Font ids of glyph runs are not serialized, because font ids are valid only
+    // during the lifetime of the application. Deserialized glyphs are painted as paths.
+
+    stream << m_compilingTimeNS;
+    stream << m_paperColor;
+
+    stream << quint64(m_instructions.size());
     for (const Instruction& instruction : m_instructions)
     {
-        switch (instruction.type)
-        {
-            case InstructionType::DrawPath:
-            {
-                const PathPaintData& data = m_paths[instruction.dataIndex];
+        stream << qint32(instruction.type) << quint64(instruction.dataIndex) << quint32(instruction.optionalContentCondition);
+    }
 
-                GraphicPieceInfo info;
-                QByteArray serializedPath;
+    stream << quint64(m_pens.size());
+    for (const QPen& pen : m_pens)
+    {
+        stream << pen;
+    }
 
-                // Serialize data
-                if (true)
-                {
-                    QDataStream stream(&serializedPath, QIODevice::WriteOnly);
+    stream << quint64(m_brushes.size());
+    for (const QBrush& brush : m_brushes)
+    {
+        stream << brush;
+    }
 
-                    stream << data.isText;
-                    stream << data.pen;
-                    stream << data.brush;
+    stream << quint64(m_paths.size());
+    for (const PathPaintData& data : m_paths)
+    {
+        stream << quint32(data.penIndex) << quint32(data.brushIndex) << data.path << data.isText;
+    }
 
-                    // Translate map to page coordinates
-                    QPainterPath pagePath = stateStack.top().matrix.map(data.path);
+    stream << quint64(m_clips.size());
+    for (const ClipData& data : m_clips)
+    {
+        stream << data.clipPath;
+    }
 
-                    info.type = data.isText ? GraphicPieceInfo::Type::Text : GraphicPieceInfo::Type::VectorGraphics;
-                    info.boundingRect = pagePath.controlPointRect();
-                    info.pagePath = pagePath;
+    stream << quint64(m_images.size());
+    for (const ImageData& data : m_images)
+    {
+        serializeImage(stream, data.image);
+    }
 
-                    const int elementCount = pagePath.elementCount();
-                    for (int i = 0; i < elementCount; ++i)
-                    {
-                        QPainterPath::Element element = pagePath.elementAt(i);
+    stream << quint64(m_meshes.size());
+    for (const MeshPaintData& data : m_meshes)
+    {
+        stream << data.mesh << data.alpha;
+    }
 
-                        PDFReal roundedX = qFloor(element.x * factor);
-                        PDFReal roundedY = qFloor(element.y * factor);
+    stream << m_matrices;
 
-                        stream << roundedX;
-                        stream << roundedY;
-                        stream << element.type;
-                    }
-                }
+    stream << quint64(m_glyphRuns.size());
+    for (const GlyphRunData& data : m_glyphRuns)
+    {
+        stream << data.brush << data.matrix << quint64(data.outlines.size());
+        for (size_t glyphIndex = 0; glyphIndex < data.outlines.size(); ++glyphIndex)
+        {
+            stream << quint32(data.cids[glyphIndex]) << data.positions[glyphIndex] << data.outlines[glyphIndex];
+        }
+    }
 
-                QByteArray hash = QCryptographicHash::hash(serializedPath, QCryptographicHash::Sha512);
-                Q_ASSERT(QCryptographicHash::hashLength(QCryptographicHash::Sha512) == 64);
+    stream << quint64(m_compositionModes.size());
+    for (QPainter::CompositionMode compositionMode : m_compositionModes)
+    {
+        stream << qint32(compositionMode);
+    }
 
-                size_t size = qMin<size_t>(hash.length(), info.hash.size());
-                std::copy(hash.data(), hash.data() + size, info.hash.data());
+    stream << quint64(m_optionalContentConditions.size());
+    for (const OptionalContentCondition& condition : m_optionalContentConditions)
+    {
+        stream << condition.isVisible << quint64(condition.references.size());
+        for (const PDFObjectReference& reference : condition.references)
+        {
+            stream << qint64(reference.objectNumber) << qint64(reference.generation);
+        }
+    }
 
-                infos.emplace_back(std::move(info));
+    stream << quint64(m_errors.size());
+    for (const PDFRenderError& error : m_errors)
+    {
+        stream << qint32(error.type) << error.getMessage();
+    }
+
+    // Snap images are usually the same images as the page images,
+    // so we store just the image index, if image is shared.
+    stream << quint64(m_snapInfo.m_snapPoints.size());
+    for (const PDFSnapInfo::SnapPoint& snapPoint : m_snapInfo.m_snapPoints)
+    {
+        stream << qint32(snapPoint.type) << snapPoint.point;
+    }
+
+    stream << m_snapInfo.m_snapLines;
+
+    stream << quint64(m_snapInfo.m_snapImages.size());
+    for (const PDFSnapInfo::SnapImage& snapImage : m_snapInfo.m_snapImages)
+    {
+        auto it = std::find_if(m_images.cbegin(), m_images.cend(), [&snapImage](const ImageData& data) { return data.image.cacheKey() == snapImage.image.cacheKey(); });
+        const qint64 imageIndex = (it != m_images.cend()) ? std::distance(m_images.cbegin(), it) : -1;
+
+        stream << snapImage.imagePath << imageIndex;
+        if (imageIndex == -1)
+        {
+            serializeImage(stream, snapImage.image);
+        }
+    }
+}
+
+void PDFPrecompiledPage::deserialize(QDataStream& stream)
+{
+    *this = PDFPrecompiledPage();
+
+    // Limits the preallocated size of the arrays, so corrupted
+    // data can't cause huge memory allocation.
+    auto readCount = [&stream]()
+    {
+        quint64 count = 0;
+        stream >> count;
+        return count;
+    };
+    auto reserveCount = [](quint64 count) { return static_cast<size_t>(qMin<quint64>(count, 1 << 16)); };
+
+    stream >> m_compilingTimeNS;
+    stream >> m_paperColor;
+
+    const quint64 instructionCount = readCount();
+    m_instructions.reserve(reserveCount(instructionCount));
+    for (quint64 i = 0; i < instructionCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        qint32 type = 0;
+        quint64 dataIndex = 0;
+        quint32 optionalContentCondition = 0;
+        stream >> type >> dataIndex >> optionalContentCondition;
+        m_instructions.emplace_back(static_cast<InstructionType>(type), dataIndex, optionalContentCondition);
+    }
+
+    const quint64 penCount = readCount();
+    m_pens.reserve(reserveCount(penCount));
+    for (quint64 i = 0; i < penCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        QPen pen;
+        stream >> pen;
+        m_pens.emplace_back(std::move(pen));
+    }
+
+    const quint64 brushCount = readCount();
+    m_brushes.reserve(reserveCount(brushCount));
+    for (quint64 i = 0; i < brushCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        QBrush brush;
+        stream >> brush;
+        m_brushes.emplace_back(std::move(brush));
+    }
+
+    const quint64 pathCount = readCount();
+    m_paths.reserve(reserveCount(pathCount));
+    for (quint64 i = 0; i < pathCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        PathPaintData data;
+        stream >> data.penIndex >> data.brushIndex >> data.path >> data.isText;
+
+        if (data.penIndex >= m_pens.size() || data.brushIndex >= m_brushes.size())
+        {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+
+        m_paths.emplace_back(std::move(data));
+    }
+
+    const quint64 clipCount = readCount();
+    m_clips.reserve(reserveCount(clipCount));
+    for (quint64 i = 0; i < clipCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        ClipData data;
+        stream >> data.clipPath;
+        m_clips.emplace_back(std::move(data));
+    }
+
+    const quint64 imageCount = readCount();
+    m_images.reserve(reserveCount(imageCount));
+    for (quint64 i = 0; i < imageCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        m_images.emplace_back(deserializeImage(stream));
+    }
+
+    const quint64 meshCount = readCount();
+    m_meshes.reserve(reserveCount(meshCount));
+    for (quint64 i = 0; i < meshCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        MeshPaintData data;
+        stream >> data.mesh >> data.alpha;
+        m_meshes.emplace_back(std::move(data));
+    }
+
+    stream >> m_matrices;
+
+    const quint64 glyphRunCount = readCount();
+    m_glyphRuns.reserve(reserveCount(glyphRunCount));
+    for (quint64 i = 0; i < glyphRunCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        GlyphRunData data;
+        stream >> data.brush >> data.matrix;
+
+        const quint64 glyphCount = readCount();
+        data.cids.reserve(reserveCount(glyphCount));
+        data.positions.reserve(reserveCount(glyphCount));
+        data.outlines.reserve(reserveCount(glyphCount));
+        for (quint64 j = 0; j < glyphCount && stream.status() == QDataStream::Ok; ++j)
+        {
+            quint32 cid = 0;
+            QPointF position;
+            QPainterPath outline;
+            stream >> cid >> position >> outline;
+            data.cids.push_back(cid);
+            data.positions.push_back(position);
+            data.outlines.emplace_back(std::move(outline));
+        }
+
+        m_glyphRuns.emplace_back(std::move(data));
+    }
+
+    const quint64 compositionModeCount = readCount();
+    m_compositionModes.reserve(reserveCount(compositionModeCount));
+    for (quint64 i = 0; i < compositionModeCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        qint32 compositionMode = 0;
+        stream >> compositionMode;
+        m_compositionModes.push_back(static_cast<QPainter::CompositionMode>(compositionMode));
+    }
+
+    const quint64 optionalContentConditionCount = readCount();
+    m_optionalContentConditions.reserve(reserveCount(optionalContentConditionCount));
+    for (quint64 i = 0; i < optionalContentConditionCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        OptionalContentCondition condition;
+        stream >> condition.isVisible;
+
+        const quint64 referenceCount = readCount();
+        condition.references.reserve(reserveCount(referenceCount));
+        for (quint64 j = 0; j < referenceCount && stream.status() == QDataStream::Ok; ++j)
+        {
+            qint64 objectNumber = 0;
+            qint64 generation = 0;
+            stream >> objectNumber >> generation;
+            condition.references.emplace_back(objectNumber, generation);
+        }
+
+        m_optionalContentConditions.emplace_back(std::move(condition));
+    }
+
+    const quint64 errorCount = readCount();
+    for (quint64 i = 0; i < errorCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        qint32 type = 0;
+        QString message;
+        stream >> type >> message;
+        m_errors.push_back(PDFRenderError(static_cast<RenderErrorType>(type), std::move(message)));
+    }
+
+    const quint64 snapPointCount = readCount();
+    m_snapInfo.m_snapPoints.reserve(reserveCount(snapPointCount));
+    for (quint64 i = 0; i < snapPointCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        qint32 type = 0;
+        QPointF point;
+        stream >> type >> point;
+        m_snapInfo.m_snapPoints.emplace_back(static_cast<SnapType>(type), point);
+    }
+
+    stream >> m_snapInfo.m_snapLines;
+
+    const quint64 snapImageCount = readCount();
+    for (quint64 i = 0; i < snapImageCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        PDFSnapInfo::SnapImage snapImage;
+        qint64 imageIndex = -1;
+        stream >> snapImage.imagePath >> imageIndex;
+
+        if (imageIndex == -1)
+        {
+            snapImage.image = deserializeImage(stream);
+        }
+        else if (imageIndex >= 0 && quint64(imageIndex) < m_images.size())
+        {
+            snapImage.image = m_images[imageIndex].image;
+        }
+        else
+        {
+            stream.setStatus(QDataStream::ReadCorruptData);
+        }
+
+        m_snapInfo.m_snapImages.emplace_back(std::move(snapImage));
+    }
+
+    // Validate instructions, data index must point to the valid data
+    for (const Instruction& instruction : m_instructions)
+    {
+        size_t dataSize = 1;
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+                dataSize = m_paths.size();
+                break;
+
+            case InstructionType::DrawImage:
+                dataSize = m_images.size();
+                break;
+
+            case InstructionType::DrawMesh:
+                dataSize = m_meshes.size();
+                break;
+
+            case InstructionType::Clip:
+                dataSize = m_clips.size();
+                break;
+
+            case InstructionType::SetWorldMatrix:
+                dataSize = m_matrices.size();
+                break;
+
+            case InstructionType::SetCompositionMode:
+                dataSize = m_compositionModes.size();
+                break;
+
+            case InstructionType::DrawGlyphRun:
+                dataSize = m_glyphRuns.size();
+                break;
+
+            case InstructionType::SaveGraphicState:
+            case InstructionType::RestoreGraphicState:
+                break;
+
+            default:
+                dataSize = 0;
+                break;
+        }
+
+        if (instruction.dataIndex >= dataSize || instruction.optionalContentCondition > m_optionalContentConditions.size())
+        {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        *this = PDFPrecompiledPage();
+        return;
+    }
+
+    createStrokeOutlines();
+    createImageMipmaps();
+    buildSpatialIndex();
+    updateMemoryConsumptionEstimate();
+}
+
+QByteArray PDFPrecompiledPage::compact() const
+{
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        serialize(stream);
+
+        // Font ids are valid during the lifetime of the application, so they
+        // can be stored here, and glyph cache can be used for the restored page.
+        for (const GlyphRunData& data : m_glyphRuns)
+        {
+            stream << data.fontId;
+        }
+
+        stream << m_isDraft;
+    }
+
+    return qCompress(data, COMPACT_COMPRESSION_LEVEL);
+}
+
+bool PDFPrecompiledPage::expand(const QByteArray& compactData)
+{
+    QByteArray data = qUncompress(compactData);
+    QDataStream stream(&data, QIODevice::ReadOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    deserialize(stream);
+
+    for (GlyphRunData& glyphRunData : m_glyphRuns)
+    {
+        stream >> glyphRunData.fontId;
+    }
+
+    stream >> m_isDraft;
+
+    if (data.isEmpty() || stream.status() != QDataStream::Ok)
+    {
+        *this = PDFPrecompiledPage();
+        return false;
+    }
+
+    return true;
+}
+
+void PDFPrecompiledPage::buildSpatialIndex()
+{
+    m_snapInfo.buildSpatialIndex();
+    m_spatialIndex.clear();
+
+    const size_t drawInstructionCount = m_paths.size() + m_images.size() + m_meshes.size() + m_glyphRuns.size();
+    if (drawInstructionCount < SPATIAL_INDEX_MIN_INSTRUCTIONS || m_instructions.size() > std::numeric_limits<uint32_t>::max())
+    {
+        // Page is simple, spatial index is not needed
+        return;
+    }
+
+    // Calculate page space bounding boxes of drawing instructions. Invalid
+    // bounding box means, that instruction is always drawn. World matrix
+    // is unknown until first matrix is set.
+    struct State
+    {
+        QTransform matrix;
+        bool isMatrixValid = false;
+    };
+
+    std::stack<State> stateStack;
+    stateStack.emplace();
+
+    std::vector<QRectF> instructionBounds(m_instructions.size());
+    for (size_t i = 0; i < m_instructions.size(); ++i)
+    {
+        const Instruction& instruction = m_instructions[i];
+        const State& state = stateStack.top();
+
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                const PathPaintData& data = m_paths[instruction.dataIndex];
+                const QPen& pen = m_pens[data.penIndex];
+                if (!state.isMatrixValid || (pen.style() != Qt::NoPen && pen.isCosmetic()))
+                {
+                    break;
+                }
+
+                QRectF boundingRect = data.path.controlPointRect();
+                if (pen.style() != Qt::NoPen)
+                {
+                    // Conservative estimate of the stroke extent, including
+                    // miter joins and square caps.
+                    const PDFReal extent = pen.widthF() * 0.5 * qMax(pen.miterLimit(), 1.5);
+                    boundingRect.adjust(-extent, -extent, extent, extent);
+                }
+
+                instructionBounds[i] = state.matrix.mapRect(boundingRect);
+                break;
+            }
+
+            case InstructionType::DrawGlyphRun:
+            {
+                if (!state.isMatrixValid)
+                {
+                    break;
+                }
+
+                const GlyphRunData& data = m_glyphRuns[instruction.dataIndex];
+                QRectF boundingRect;
+                for (size_t glyphIndex = 0; glyphIndex < data.outlines.size(); ++glyphIndex)
+                {
+                    boundingRect = boundingRect.united(data.getGlyphMatrix(glyphIndex).mapRect(data.outlines[glyphIndex].controlPointRect()));
+                }
+
+                instructionBounds[i] = state.matrix.mapRect(boundingRect);
+                break;
+            }
+
+            case InstructionType::DrawImage:
+            {
+                if (state.isMatrixValid)
+                {
+                    instructionBounds[i] = state.matrix.mapRect(QRectF(0.0, 0.0, 1.0, 1.0));
+                }
+                break;
+            }
+
+            case InstructionType::DrawMesh:
+            {
+                // Meshes are painted directly in page space
+                instructionBounds[i] = m_meshes[instruction.dataIndex].mesh.getBoundingRect();
+                break;
+            }
+
+            case InstructionType::SaveGraphicState:
+                stateStack.push(state);
+                break;
+
+            case InstructionType::RestoreGraphicState:
+            {
+                if (stateStack.size() > 1)
+                {
+                    stateStack.pop();
+                }
+                else
+                {
+                    // Unbalanced restore, we can't track matrices anymore
+                    stateStack.top().isMatrixValid = false;
+                }
+                break;
+            }
+
+            case InstructionType::SetWorldMatrix:
+                stateStack.top().matrix = m_matrices[instruction.dataIndex];
+                stateStack.top().isMatrixValid = true;
+                break;
+
+            case InstructionType::Clip:
+            case InstructionType::SetCompositionMode:
+                break;
+
+            default:
+            {
+                Q_ASSERT(false);
+                break;
+            }
+        }
+    }
+
+    QRectF bounds;
+    for (const QRectF& boundingRect : instructionBounds)
+    {
+        if (boundingRect.isValid())
+        {
+            bounds = bounds.united(boundingRect);
+        }
+    }
+
+    if (!bounds.isValid())
+    {
+        return;
+    }
+
+    m_spatialIndex.bounds = bounds;
+    m_spatialIndex.columns = SPATIAL_INDEX_GRID_SIZE;
+    m_spatialIndex.rows = SPATIAL_INDEX_GRID_SIZE;
+    m_spatialIndex.cells.resize(SPATIAL_INDEX_GRID_SIZE * SPATIAL_INDEX_GRID_SIZE);
+
+    const PDFReal cellWidth = bounds.width() / m_spatialIndex.columns;
+    const PDFReal cellHeight = bounds.height() / m_spatialIndex.rows;
+    const int maximalCellCount = SPATIAL_INDEX_GRID_SIZE * SPATIAL_INDEX_GRID_SIZE / 4;
+
+    for (size_t i = 0; i < m_instructions.size(); ++i)
+    {
+        switch (m_instructions[i].type)
+        {
+            case InstructionType::DrawPath:
+            case InstructionType::DrawImage:
+            case InstructionType::DrawMesh:
+            case InstructionType::DrawGlyphRun:
+                break;
+
+            default:
+                continue;
+        }
+
+        const QRectF& boundingRect = instructionBounds[i];
+        const uint32_t index = static_cast<uint32_t>(i);
+
+        if (!boundingRect.isValid())
+        {
+            m_spatialIndex.unboundedInstructions.push_back(index);
+            continue;
+        }
+
+        const int column1 = qBound(0, int((boundingRect.left() - bounds.left()) / cellWidth), m_spatialIndex.columns - 1);
+        const int column2 = qBound(0, int((boundingRect.right() - bounds.left()) / cellWidth), m_spatialIndex.columns - 1);
+        const int row1 = qBound(0, int((boundingRect.top() - bounds.top()) / cellHeight), m_spatialIndex.rows - 1);
+        const int row2 = qBound(0, int((boundingRect.bottom() - bounds.top()) / cellHeight), m_spatialIndex.rows - 1);
+
+        if ((column2 - column1 + 1) * (row2 - row1 + 1) > maximalCellCount)
+        {
+            // Large objects are visible almost always, do not
+            // waste memory by storing them in many cells.
+            m_spatialIndex.unboundedInstructions.push_back(index);
+            continue;
+        }
+
+        for (int row = row1; row <= row2; ++row)
+        {
+            for (int column = column1; column <= column2; ++column)
+            {
+                m_spatialIndex.cells[row * m_spatialIndex.columns + column].push_back(index);
+            }
+        }
+    }
+
+    for (std::vector<uint32_t>& cell : m_spatialIndex.cells)
+    {
+        cell.shrink_to_fit();
+    }
+
+    m_spatialIndex.instructionBounds = std::move(instructionBounds);
+}
+
+std::vector<bool> PDFPrecompiledPage::getVisibleInstructions(const QRectF& visibleRect) const
+{
+    Q_ASSERT(m_spatialIndex.isValid());
+
+    // State instructions are always visible, drawing instructions
+    // are visible only, if they are found in the spatial index.
+    std::vector<bool> visibleInstructions(m_instructions.size(), true);
+    for (size_t i = 0; i < m_instructions.size(); ++i)
+    {
+        switch (m_instructions[i].type)
+        {
+            case InstructionType::DrawPath:
+            case InstructionType::DrawImage:
+            case InstructionType::DrawMesh:
+            case InstructionType::DrawGlyphRun:
+                visibleInstructions[i] = false;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    for (uint32_t index : m_spatialIndex.unboundedInstructions)
+    {
+        visibleInstructions[index] = true;
+    }
+
+    const QRectF& bounds = m_spatialIndex.bounds;
+    if (!visibleRect.intersects(bounds))
+    {
+        return visibleInstructions;
+    }
+
+    const PDFReal cellWidth = bounds.width() / m_spatialIndex.columns;
+    const PDFReal cellHeight = bounds.height() / m_spatialIndex.rows;
+    const int column1 = qBound(0, int((visibleRect.left() - bounds.left()) / cellWidth), m_spatialIndex.columns - 1);
+    const int column2 = qBound(0, int((visibleRect.right() - bounds.left()) / cellWidth), m_spatialIndex.columns - 1);
+    const int row1 = qBound(0, int((visibleRect.top() - bounds.top()) / cellHeight), m_spatialIndex.rows - 1);
+    const int row2 = qBound(0, int((visibleRect.bottom() - bounds.top()) / cellHeight), m_spatialIndex.rows - 1);
+
+    auto intersects = [&visibleRect](const QRectF& rect)
+    {
+        // Degenerated rectangles (for example, horizontal lines) must be also handled
+        return rect.left() <= visibleRect.right() && visibleRect.left() <= rect.right() &&
+               rect.top() <= visibleRect.bottom() && visibleRect.top() <= rect.bottom();
+    };
+
+    for (int row = row1; row <= row2; ++row)
+    {
+        for (int column = column1; column <= column2; ++column)
+        {
+            for (uint32_t index : m_spatialIndex.cells[row * m_spatialIndex.columns + column])
+            {
+                if (!visibleInstructions[index] && intersects(m_spatialIndex.instructionBounds[index]))
+                {
+                    visibleInstructions[index] = true;
+                }
+            }
+        }
+    }
+
+    return visibleInstructions;
+}
+
+PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceInfos(QRectF mediaBox,
+                                                                                     PDFReal epsilon) const
+{
+    GraphicPieceInfos infos;
+
+    struct State
+    {
+        QTransform matrix;
+    };
+    std::stack<State> stateStack;
+    stateStack.emplace();
+
+    // Check, if epsilon is not too small
+    if (qFuzzyIsNull(epsilon))
+    {
+        epsilon = 0.000001;
+    }
+    PDFReal factor = 1.0 / epsilon;
+
+    QImage shadingTestImage;
+
+    auto addPathInfo = [&infos, &stateStack, factor](bool isText, const QPen& pen, const QBrush& brush, const QPainterPath& path)
+    {
+        GraphicPieceInfo info;
+        QByteArray serializedPath;
+
+        // Serialize data
+        if (true)
+        {
+            QDataStream stream(&serializedPath, QIODevice::WriteOnly);
+
+            stream << isText;
+            stream << pen;
+            stream << brush;
+
+            // Translate map to page coordinates
+            QPainterPath pagePath = stateStack.top().matrix.map(path);
+
+            info.type = isText ? GraphicPieceInfo::Type::Text : GraphicPieceInfo::Type::VectorGraphics;
+            info.boundingRect = pagePath.controlPointRect();
+            info.pagePath = pagePath;
+
+            const int elementCount = pagePath.elementCount();
+            for (int i = 0; i < elementCount; ++i)
+            {
+                QPainterPath::Element element = pagePath.elementAt(i);
+
+                PDFReal roundedX = qFloor(element.x * factor);
+                PDFReal roundedY = qFloor(element.y * factor);
+
+                stream << roundedX;
+                stream << roundedY;
+                stream << element.type;
+            }
+        }
+
+        QByteArray hash = QCryptographicHash::hash(serializedPath, QCryptographicHash::Sha512);
+        Q_ASSERT(QCryptographicHash::hashLength(QCryptographicHash::Sha512) == 64);
+
+        size_t size = qMin<size_t>(hash.length(), info.hash.size());
+        std::copy(hash.data(), hash.data() + size, info.hash.data());
+
+        infos.emplace_back(std::move(info));
+    };
+
+    // Process all instructions
+    for (const Instruction& instruction : m_instructions)
+    {
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                const PathPaintData& data = m_paths[instruction.dataIndex];
+                addPathInfo(data.isText, m_pens[data.penIndex], m_brushes[data.brushIndex], data.path);
+                break;
+            }
+
+            case InstructionType::DrawGlyphRun:
+            {
+                // Each glyph is a separate piece of the graphic
+                const GlyphRunData& data = m_glyphRuns[instruction.dataIndex];
+                for (size_t glyphIndex = 0; glyphIndex < data.outlines.size(); ++glyphIndex)
+                {
+                    addPathInfo(true, QPen(Qt::NoPen), data.brush, data.getGlyphPath(glyphIndex));
+                }
                 break;
             }
 
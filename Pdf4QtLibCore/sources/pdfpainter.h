@@ -25,13 +25,19 @@
 #include "pdftextlayout.h"
 #include "pdfcolorconvertor.h"
 #include "pdfsnapper.h"
+#include "pdfsharedcontentcache.h"
 
 #include <QPen>
 #include <QBrush>
 #include <QElapsedTimer>
 
+#include <map>
+#include <tuple>
+#include <memory>
+
 namespace pdf
 {
+class PDFImageMipmaps;
 
 /// Base painter, encapsulating common functionality for all PDF painters (for example,
 /// direct painter, or painter, which generates list of graphic commands).
@@ -55,9 +61,28 @@ protected:
     virtual void performUpdateGraphicsState(const PDFPageContentProcessorState& state) override;
     virtual void performBeginTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup) override;
     virtual void performEndTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup) override;
+    virtual bool performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern) override;
+    virtual bool performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QRectF& tilingArea,
+                                              PDFInteger columns,
+                                              PDFInteger rows,
+                                              const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                              const PDFColor& uncoloredPatternColor) override;
+    virtual bool isImageSoftMaskIgnored() const override;
+    virtual bool isType3GlyphDetailCapped() const override { return hasFeature(PDFRenderer::Draft_Type3Glyphs); }
     virtual void setWorldMatrix(const QTransform& matrix) = 0;
     virtual void setCompositionMode(QPainter::CompositionMode mode) = 0;
 
+    /// Fills the path using the brush (without pen), path is in current user space
+    /// \param path Path to be filled
+    /// \param brush Fill brush
+    virtual void fillPath(const QPainterPath& path, const QBrush& brush) = 0;
+
+    /// Sets scale of the tiling pattern cell image relative to the device scale.
+    /// Painters, which device space is not the final device space (for example,
+    /// precompiled page is in page space), should oversample the cell image.
+    void setTilingPatternImageScale(PDFReal scale) { m_tilingPatternImageScale = scale; }
+
     /// Returns current pen
     const QPen& getCurrentPen() { return m_currentPen.get(this, &PDFPainterBase::getCurrentPenImpl); }
 
@@ -76,8 +101,12 @@ protected:
     /// Returns, if feature is turned on
     bool hasFeature(PDFRenderer::Feature feature) const { return m_features.testFlag(feature); }
 
-    /// Is transparency group active?
-    bool isTransparencyGroupActive() const { return !m_transparencyGroupDataStack.empty(); }
+    /// Returns features of the painter
+    PDFRenderer::Features getFeatures() const { return m_features; }
+
+    /// Is transparency group active? Opaque transparency groups, which are not
+    /// isolated in draft mode (see \p PDFRenderer::Draft_TransparencyGroups), are not considered.
+    bool isTransparencyGroupActive() const;
 
 private:
     /// Returns current pen (implementation)
@@ -92,12 +121,19 @@ private:
         PDFReal alphaStroke = 1.0;
         PDFReal alphaFill = 1.0;
         BlendMode blendMode = BlendMode::Normal;
+        bool isSkipped = false; ///< Opaque group, which is not isolated in draft mode
     };
 
+    /// Key of the tiling pattern cell image - pattern, fill color
+    /// of uncolored pattern and image width and height.
+    using TilingPatternImageKey = std::tuple<const PDFTilingPattern*, QRgb, int, int>;
+
     PDFRenderer::Features m_features;
     PDFCachedItem<QPen> m_currentPen;
     PDFCachedItem<QBrush> m_currentBrush;
     std::vector<PDFTransparencyGroupPainterData> m_transparencyGroupDataStack;
+    std::map<TilingPatternImageKey, QImage> m_tilingPatternImages;
+    PDFReal m_tilingPatternImageScale = 1.0;
 };
 
 /// Processor, which processes PDF's page commands on the QPainter. It works with QPainter
@@ -137,8 +173,16 @@ protected:
     virtual void performMeshPainting(const PDFMesh& mesh) override;
     virtual void performSaveGraphicState(ProcessOrder order) override;
     virtual void performRestoreGraphicState(ProcessOrder order) override;
+    virtual bool performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QRectF& tilingArea,
+                                              PDFInteger columns,
+                                              PDFInteger rows,
+                                              const PDFColorSpacePointer& uncoloredPatternColorSpace,
+                                              const PDFColor& uncoloredPatternColor) override;
     virtual void setWorldMatrix(const QTransform& matrix) override;
     virtual void setCompositionMode(QPainter::CompositionMode mode) override;
+    virtual void fillPath(const QPainterPath& path, const QBrush& brush) override;
+    virtual QSize getImageDeviceSize(const PDFStream* stream) override;
 
 private:
     QPainter* m_painter;
@@ -167,20 +211,23 @@ public:
         SaveGraphicState,
         RestoreGraphicState,
         SetWorldMatrix,
-        SetCompositionMode
+        SetCompositionMode,
+        DrawGlyphRun
     };
 
     struct Instruction
     {
         inline Instruction() = default;
-        inline Instruction(InstructionType type, size_t dataIndex) :
+        inline Instruction(InstructionType type, size_t dataIndex, uint32_t optionalContentCondition = 0) :
             type(type),
+            optionalContentCondition(optionalContentCondition),
             dataIndex(dataIndex)
         {
 
         }
 
         InstructionType type = InstructionType::Invalid;
+        uint32_t optionalContentCondition = 0; ///< Index of optional content condition plus one (zero, if instruction is unconditional)
         size_t dataIndex = 0;
     };
 
@@ -190,11 +237,15 @@ public:
     /// \param pagePointToDevicePointMatrix Page point to device point transformation matrix
     /// \param features Renderer features
     /// \param opacity Opacity of page graphics
+    /// \param optionalContentActivity Optional content activity, which decides, which optional
+    ///        content is drawn (if it is nullptr, then optional content visibility at the time
+    ///        of page compilation is used)
     void draw(QPainter* painter,
               const QRectF& cropBox,
               const QTransform& pagePointToDevicePointMatrix,
               PDFRenderer::Features features,
-              PDFReal opacity) const;
+              PDFReal opacity,
+              const PDFOptionalContentActivity* optionalContentActivity = nullptr) const;
 
     /// Redact path - remove all content intersecting given path,
     /// and fill redact path with given color.
@@ -203,6 +254,17 @@ public:
     void redact(QPainterPath redactPath, const QTransform& matrix, QColor color);
 
     void addPath(QPen pen, QBrush brush, QPainterPath path, bool isText);
+
+    /// Adds filled text glyph. Consecutive glyphs of the same font, painted
+    /// with the same brush and having the same glyph matrix (except translation),
+    /// are merged into a single glyph run. Small glyphs can be painted from
+    /// the glyph cache (using rasterized glyph image) instead of filling the path.
+    /// \param brush Fill brush
+    /// \param fontId Unique id of the realized font
+    /// \param cid Character id of the glyph
+    /// \param outline Glyph outline in text space
+    /// \param glyphMatrix Transformation from text space to user space
+    void addGlyph(QBrush brush, quint64 fontId, CID cid, QPainterPath outline, const QTransform& glyphMatrix);
     void addClip(QPainterPath path);
     void addImage(QImage image);
     void addMesh(PDFMesh mesh, PDFReal alpha);
@@ -211,6 +273,42 @@ public:
     void addSetWorldMatrix(const QTransform& matrix);
     void addSetCompositionMode(QPainter::CompositionMode compositionMode);
 
+    /// Sets optional content condition of subsequently added drawing instructions.
+    /// Drawing instructions are drawn only, if all optional content groups (or
+    /// membership dictionaries) of the condition are visible. Empty condition
+    /// means, that drawing instructions are always drawn.
+    /// \param references Optional content groups/membership dictionaries
+    /// \param isVisible Is condition visible at the time of page compilation?
+    void setOptionalContentCondition(const std::vector<PDFObjectReference>& references, bool isVisible);
+
+    /// Returns true, if page contains drawing instructions depending on the optional content
+    bool hasOptionalContent() const { return !m_optionalContentConditions.empty(); }
+
+    /// Returns number of instructions of the page
+    size_t getInstructionCount() const { return m_instructions.size(); }
+
+    /// Creates page fragment containing instructions of this page starting from
+    /// the given instruction, together with their data. Fragment can be appended
+    /// to other pages using function \p appendInstructions.
+    /// \param firstInstruction Index of the first instruction
+    std::shared_ptr<PDFPrecompiledPage> extractInstructions(size_t firstInstruction) const;
+
+    /// Appends all instructions of the page fragment to this page. Images of
+    /// the fragment are added to the snap info, draft flag of the fragment is
+    /// propagated to this page.
+    /// \param fragment Page fragment
+    /// \param matrix World matrix, which is set, when first instruction of the fragment is drawn
+    void appendInstructions(const PDFPrecompiledPage& fragment, const QTransform& matrix);
+
+    /// Returns visibility of optional content conditions of the page for the
+    /// state of optional content activity. If page has no optional content,
+    /// or optional content is ignored, empty vector is returned (everything
+    /// is visible). Item at index zero corresponds to the unconditional content.
+    /// \param features Renderer features
+    /// \param optionalContentActivity Optional content activity (if it is nullptr, then
+    ///        optional content visibility at the time of page compilation is used)
+    std::vector<bool> getOptionalContentVisibility(PDFRenderer::Features features, const PDFOptionalContentActivity* optionalContentActivity) const;
+
     /// Optimizes page memory allocation to contain less space
     void optimize();
 
@@ -231,6 +329,20 @@ public:
     /// Returns true, if page is valid (i.e. has nonzero instruction count)
     bool isValid() const { return !m_instructions.empty(); }
 
+    /// Creates compact representation of the page, which can be kept in the memory
+    /// instead of the page, if page is not used for a long time. Page data are
+    /// compressed, coordinates and other real numbers are stored with single
+    /// precision, so page restored from the compact data is suitable only
+    /// for displaying.
+    /// \sa expand
+    QByteArray compact() const;
+
+    /// Restores page from compact representation. Returns true, if page
+    /// was restored, false otherwise (page is then cleared).
+    /// \param compactData Compact data created by function \p compact
+    /// \sa compact
+    bool expand(const QByteArray& compactData);
+
     /// Returns memory consumption estimate
     qint64 getMemoryConsumptionEstimate() const { return m_memoryConsumptionEstimate; }
 
@@ -238,6 +350,14 @@ public:
     QColor getPaperColor() const { return m_paperColor; }
     void setPaperColor(QColor paperColor) { m_paperColor = paperColor; }
 
+    /// Returns true, if page contains draft images (images decoded in lower
+    /// resolution), so page should be compiled again with full resolution images.
+    bool isDraft() const { return m_isDraft; }
+    void setDraft(bool isDraft) { m_isDraft = isDraft; }
+
+    /// Sets cache of rasterized glyphs, which is used to paint small glyphs
+    void setGlyphCache(std::shared_ptr<PDFGlyphCache> glyphCache) { m_glyphCache = std::move(glyphCache); }
+
     PDFSnapInfo* getSnapInfo() { return &m_snapInfo; }
     const PDFSnapInfo* getSnapInfo() const { return &m_snapInfo; }
 
@@ -290,25 +410,83 @@ public:
     GraphicPieceInfos calculateGraphicPieceInfos(QRectF mediaBox,
                                                  PDFReal epsilon) const;
 
+    friend inline QDataStream& operator<<(QDataStream& stream, const PDFPrecompiledPage& page) { page.serialize(stream); return stream; }
+    friend inline QDataStream& operator>>(QDataStream& stream, PDFPrecompiledPage& page) { page.deserialize(stream); return stream; }
+
 private:
+    friend class PDFGpuPageGeometry;
+
+    /// Serializes page contents into the stream. Spatial index and
+    /// memory consumption estimate are not serialized, they are
+    /// recalculated, when page is deserialized.
+    void serialize(QDataStream& stream) const;
+
+    /// Deserializes page contents from the stream. If data are corrupted,
+    /// then stream status is set to error and page is cleared.
+    void deserialize(QDataStream& stream);
+
+    /// Updates memory consumption estimate
+    void updateMemoryConsumptionEstimate();
+
+    /// Appends instruction of the source page together with its data
+    /// \param source Source page
+    /// \param instruction Instruction of the source page
+    void appendInstruction(const PDFPrecompiledPage& source, const Instruction& instruction);
+
+    /// Number of last table entries, in which equal pen, brush or matrix
+    /// is searched, when it is added to the page. Pages usually use only
+    /// a few pens, brushes and matrices, which are used repeatedly.
+    static constexpr size_t INTERN_LOOKUP_COUNT = 16;
+
+    /// Compression level of compact page data, page is compacted
+    /// in the main thread, so fast compression is used.
+    static constexpr int COMPACT_COMPRESSION_LEVEL = 1;
+
+    /// Returns index of the value in the table, value is inserted into
+    /// the table, if equal value is not found in last table entries.
+    /// \param table Table of values
+    /// \param value Value
+    template<typename T>
+    static uint32_t intern(std::vector<T>& table, const T& value);
+
     struct PathPaintData
     {
         inline PathPaintData() = default;
-        inline PathPaintData(QPen pen, QBrush brush, QPainterPath path, bool isText) :
-            pen(qMove(pen)),
-            brush(qMove(brush)),
+        inline PathPaintData(uint32_t penIndex, uint32_t brushIndex, QPainterPath path, bool isText) :
+            penIndex(penIndex),
+            brushIndex(brushIndex),
             path(qMove(path)),
             isText(isText)
         {
 
         }
 
-        QPen pen;
-        QBrush brush;
+        uint32_t penIndex = 0;      ///< Index of the pen in the page's pen table
+        uint32_t brushIndex = 0;    ///< Index of the brush in the page's brush table
         QPainterPath path;
+        QPainterPath strokeOutline; ///< Cached outline of the stroke (empty, if stroke outline is not cached)
         bool isText = false;
     };
 
+    /// Run of filled text glyphs of the same font, painted with the same brush.
+    /// All glyphs share the glyph matrix, except the translation, which is
+    /// stored for each glyph as its position.
+    struct GlyphRunData
+    {
+        /// Returns transformation from text space to user space of the glyph
+        QTransform getGlyphMatrix(size_t index) const { return matrix * QTransform::fromTranslate(positions[index].x(), positions[index].y()); }
+
+        /// Returns path of the glyph in user space
+        QPainterPath getGlyphPath(size_t index) const { return getGlyphMatrix(index).map(outlines[index]); }
+
+        QBrush brush;
+        quint64 fontId = 0;                 ///< Unique id of the realized font, zero, if glyph cache can't be used
+        QTransform matrix;                  ///< Glyph matrix without translation
+        std::vector<CID> cids;              ///< Character ids of the glyphs
+        std::vector<QPointF> positions;     ///< Glyph positions in user space
+        std::vector<QPainterPath> outlines; ///< Glyph outlines in text space
+    };
+
     struct ClipData
     {
         inline ClipData() = default;
@@ -331,6 +509,13 @@ private:
         }
 
         QImage image;
+        std::shared_ptr<PDFImageMipmaps> mipmaps;
+    };
+
+    struct OptionalContentCondition
+    {
+        std::vector<PDFObjectReference> references;
+        bool isVisible = true; ///< Visibility at the time of page compilation
     };
 
     struct MeshPaintData
@@ -347,19 +532,81 @@ private:
         PDFReal alpha = 1.0;
     };
 
+    /// Spatial index of drawing instructions (paths, images and meshes). Page space
+    /// bounding box of the page content is divided into uniform grid, each cell
+    /// contains drawing instructions, which bounding box intersects the cell. It is
+    /// used to skip drawing instructions, which are not visible. State instructions
+    /// (clipping, graphic state, matrices) are never skipped.
+    struct SpatialIndex
+    {
+        inline void clear() { *this = SpatialIndex(); }
+        inline bool isValid() const { return columns > 0 && rows > 0; }
+
+        QRectF bounds;
+        int columns = 0;
+        int rows = 0;
+        std::vector<QRectF> instructionBounds;
+        std::vector<std::vector<uint32_t>> cells;
+        std::vector<uint32_t> unboundedInstructions;
+    };
+
+    /// Minimal number of drawing instructions, for which spatial index is built
+    static constexpr size_t SPATIAL_INDEX_MIN_INSTRUCTIONS = 128;
+
+    /// Number of grid cells on each side of the spatial index grid
+    static constexpr int SPATIAL_INDEX_GRID_SIZE = 32;
+
+    /// Builds spatial index of drawing instructions and snap points
+    void buildSpatialIndex();
+
+    /// Minimal pen width (in user space units) of solid strokes, for which stroke outline is cached
+    static constexpr PDFReal STROKE_OUTLINE_MIN_WIDTH = 2.0;
+
+    /// Curve threshold of cached stroke outlines (in user space units)
+    static constexpr PDFReal STROKE_OUTLINE_CURVE_THRESHOLD = 0.01;
+
+    /// Maximal scale (device pixels per user space unit), up to which cached stroke
+    /// outline is used. Above this scale, curves of the outline would be visibly
+    /// flattened, so path is stroked when it is drawn.
+    static constexpr PDFReal STROKE_OUTLINE_MAX_SCALE = 25.0;
+
+    /// Creates cached outlines of dashed and wide strokes, so they are not
+    /// stroked again each time the page is drawn. Stroke outline is in user
+    /// space, so it doesn't depend on zoom. Cosmetic and hairline strokes
+    /// are not cached, they are stroked by the painter. Outlines are created
+    /// in parallel, if execution policy allows it.
+    void createStrokeOutlines();
+
+    /// Creates mipmaps of large images, levels of mipmaps are created
+    /// lazily, when image is drawn downscaled with smooth transformation.
+    void createImageMipmaps();
+
+    /// Returns visibility flags of instructions for given visible rectangle
+    /// in page space. State instructions are always marked as visible.
+    /// \param visibleRect Visible rectangle in page space
+    std::vector<bool> getVisibleInstructions(const QRectF& visibleRect) const;
+
     qint64 m_compilingTimeNS = 0;
     qint64 m_memoryConsumptionEstimate = 0;
     QColor m_paperColor = QColor(Qt::white);
+    bool m_isDraft = false;
     std::vector<Instruction> m_instructions;
     std::vector<PathPaintData> m_paths;
+    std::vector<QPen> m_pens;
+    std::vector<QBrush> m_brushes;
     std::vector<ClipData> m_clips;
     std::vector<ImageData> m_images;
     std::vector<MeshPaintData> m_meshes;
+    std::vector<GlyphRunData> m_glyphRuns;
     std::vector<QTransform> m_matrices;
     std::vector<QPainter::CompositionMode> m_compositionModes;
+    std::vector<OptionalContentCondition> m_optionalContentConditions;
+    uint32_t m_currentOptionalContentCondition = 0;
     QList<PDFRenderError> m_errors;
     PDFSnapInfo m_snapInfo;
     QElapsedTimer m_expirationTimer;
+    SpatialIndex m_spatialIndex;
+    std::shared_ptr<PDFGlyphCache> m_glyphCache;
 };
 
 /// Processor, which processes PDF's page commands and writes them to the precompiled page.
@@ -378,6 +625,21 @@ public:
                                          const PDFOptionalContentActivity* optionalContentActivity,
                                          const PDFMeshQualitySettings& meshQualitySettings);
 
+    /// Enables draft images. JPEG and JPEG 2000 images are decoded in lower
+    /// resolution (resolution of the page at 100% zoom at 72 DPI), which is much
+    /// faster. If some image is decoded in lower resolution, precompiled page
+    /// is marked as draft.
+    void setDraftImagesEnabled(bool draftImagesEnabled) { m_isDraftImagesEnabled = draftImagesEnabled; }
+
+    /// Enables recording of optional content. Content is compiled regardless
+    /// of the state of optional content, and optional content condition is
+    /// recorded for each drawing instruction. Hidden optional content is then
+    /// skipped, when precompiled page is drawn, so page needn't to be compiled
+    /// again, when state of optional content is changed.
+    void setOptionalContentRecordingEnabled(bool optionalContentRecordingEnabled) { m_isOptionalContentRecordingEnabled = optionalContentRecordingEnabled; }
+
+    virtual bool isContentSuppressedByOC(PDFObjectReference ocgOrOcmd) override;
+
 protected:
     virtual void performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule) override;
     virtual void performClipping(const QPainterPath& path, Qt::FillRule fillRule) override;
@@ -387,9 +649,39 @@ protected:
     virtual void performRestoreGraphicState(ProcessOrder order) override;
     virtual void setWorldMatrix(const QTransform& matrix) override;
     virtual void setCompositionMode(QPainter::CompositionMode mode) override;
+    virtual void fillPath(const QPainterPath& path, const QBrush& brush) override;
+    virtual QSize getImageDeviceSize(const PDFStream* stream) override;
+    virtual bool performBeginFormContent(const PDFStream* stream) override;
+    virtual void performEndFormContent(const PDFStream* stream) override;
 
 private:
+    /// Form, which content is being compiled. If form can be shared,
+    /// its compiled content is stored into the shared content cache.
+    struct SharedContentRecording
+    {
+        const PDFStream* stream = nullptr;
+        bool isShared = false;
+        bool isDraft = false;
+        size_t firstInstruction = 0;
+        PDFInteger renderErrorCount = 0;
+        PDFSharedContentCache::Key key;
+    };
+
+    /// Sets optional content condition of the current content to the precompiled
+    /// page, if recording of optional content is enabled.
+    void updateOptionalContentCondition();
+
+    /// Creates key of the compiled content of the form in the shared content cache.
+    /// Returns false, if compiled content of the form can't be shared.
+    /// \param stream Stream of the form
+    /// \param key Key
+    bool createSharedContentKey(const PDFStream* stream, PDFSharedContentCache::Key& key) const;
+
     PDFPrecompiledPage* m_precompiledPage;
+    bool m_isDraftImagesEnabled = false;
+    bool m_isOptionalContentRecordingEnabled = false;
+    std::vector<PDFObjectReference> m_optionalContentReferences;
+    std::vector<SharedContentRecording> m_sharedContentRecordings;
 };
 
 }   // namespace pdf
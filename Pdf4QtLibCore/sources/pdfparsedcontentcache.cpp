@@ -0,0 +1,149 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfparsedcontentcache.h"
+#include "pdfobject.h"
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+qint64 PDFParsedContentStream::getMemoryConsumptionEstimate() const
+{
+    qint64 memoryConsumption = sizeof(*this);
+    memoryConsumption += instructions.capacity() * sizeof(Instruction);
+    memoryConsumption += operands.capacity() * sizeof(PDFLexicalAnalyzer::Token);
+
+    for (const Instruction& instruction : instructions)
+    {
+        memoryConsumption += instruction.operatorText.size();
+        memoryConsumption += instruction.error.message.size() * sizeof(QChar);
+
+        if (instruction.inlineImage)
+        {
+            memoryConsumption += sizeof(PDFStream) + instruction.inlineImage->getContent()->size();
+        }
+    }
+
+    for (const PDFLexicalAnalyzer::Token& token : operands)
+    {
+        if (token.type == PDFLexicalAnalyzer::TokenType::Name ||
+            token.type == PDFLexicalAnalyzer::TokenType::String)
+        {
+            memoryConsumption += token.data.toByteArray().size();
+        }
+    }
+
+    return memoryConsumption;
+}
+
+PDFParsedContentCache::PDFParsedContentCache(qint64 memoryLimit) :
+    PDFMemoryBudgetClient("parsed-content-cache", 2, memoryLimit)
+{
+    registerMemoryBudgetClient();
+}
+
+PDFParsedContentCache::~PDFParsedContentCache()
+{
+    unregisterMemoryBudgetClient();
+}
+
+PDFParsedContentStreamPointer PDFParsedContentCache::find(const void* key) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_itemMap.find(key);
+    if (it == m_itemMap.cend())
+    {
+        return nullptr;
+    }
+
+    // Move item to the front, it is now most recently used
+    m_items.splice(m_items.begin(), m_items, it->second);
+    return it->second->content;
+}
+
+void PDFParsedContentCache::insert(const void* key, std::shared_ptr<const void> owner, PDFParsedContentStreamPointer content)
+{
+    if (!owner || !content)
+    {
+        return;
+    }
+
+    const qint64 memoryConsumption = content->getMemoryConsumptionEstimate();
+
+    QMutexLocker lock(&m_mutex);
+
+    if (memoryConsumption > getMemoryLimit() || m_itemMap.count(key))
+    {
+        return;
+    }
+
+    m_items.push_front(Item{ key, qMove(owner), qMove(content), memoryConsumption });
+    m_itemMap[key] = m_items.begin();
+    m_memoryConsumption += memoryConsumption;
+    shrink();
+
+    const qint64 totalMemoryConsumption = m_memoryConsumption;
+    lock.unlock();
+
+    reportMemoryConsumption(totalMemoryConsumption);
+}
+
+void PDFParsedContentCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_itemMap.clear();
+    m_items.clear();
+    m_memoryConsumption = 0;
+    lock.unlock();
+
+    setMemoryConsumption(0);
+}
+
+qint64 PDFParsedContentCache::getMemoryConsumption() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryConsumption;
+}
+
+void PDFParsedContentCache::shrink()
+{
+    while (m_memoryConsumption > getMemoryLimit() && !m_items.empty())
+    {
+        const Item& item = m_items.back();
+        m_memoryConsumption -= item.memoryConsumption;
+        m_itemMap.erase(item.key);
+        m_items.pop_back();
+    }
+}
+
+void PDFParsedContentCache::trimMemory()
+{
+    qint64 memoryConsumption = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        shrink();
+        memoryConsumption = m_memoryConsumption;
+    }
+
+    setMemoryConsumption(memoryConsumption);
+}
+
+}   // namespace pdf
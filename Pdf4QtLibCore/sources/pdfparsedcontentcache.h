@@ -0,0 +1,135 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFPARSEDCONTENTCACHE_H
+#define PDFPARSEDCONTENTCACHE_H
+
+#include "pdfglobal.h"
+#include "pdfmemorybudget.h"
+#include "pdfparser.h"
+#include "pdfpagecontentprocessor.h"
+
+#include <QMutex>
+#include <QByteArray>
+
+#include <list>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace pdf
+{
+class PDFStream;
+
+/// Content stream, which was already tokenized and parsed into the sequence
+/// of instructions. Operands of all instructions are stored in one array,
+/// each instruction refers to the range of its operands. Parsed content
+/// stream can be replayed by the content processor without running the
+/// lexical analyzer again.
+struct PDFParsedContentStream
+{
+    enum class InstructionType
+    {
+        Command,        ///< Operator with operands
+        InlineImage,    ///< Inline image (BI/ID/EI), operands are discarded
+        Error,          ///< Parsing error, operands are discarded
+        Operands        ///< Operands at the end of the stream, without operator
+    };
+
+    struct Instruction
+    {
+        InstructionType type = InstructionType::Command;
+        PDFPageContentProcessor::Operator op = PDFPageContentProcessor::Operator::Invalid;
+        QByteArray operatorText;
+        size_t operandsBegin = 0;
+        size_t operandsEnd = 0;
+        std::shared_ptr<const PDFStream> inlineImage;
+        PDFRenderError error;
+    };
+
+    /// Returns estimated memory consumption (in bytes)
+    qint64 getMemoryConsumptionEstimate() const;
+
+    std::vector<Instruction> instructions;
+    std::vector<PDFLexicalAnalyzer::Token> operands;
+};
+
+/// Thread safe cache of parsed content streams. It is used for content streams,
+/// which are processed many times, such as form XObjects placed on many places,
+/// or Type 3 font glyphs. Items are identified by the address of the object,
+/// from which content stream is created (stream object, or glyph content data).
+/// Each item holds an owner object keeping the identifying object alive, so an
+/// item can't be mistaken for another object allocated at the same address.
+/// Memory consumption is limited, least recently used items are removed first.
+/// Memory limit is assigned by the global memory budget, if the budget is set.
+class PDF4QTLIBCORESHARED_EXPORT PDFParsedContentCache : public PDFMemoryBudgetClient
+{
+public:
+    /// Default memory limit of the cache (in bytes)
+    static constexpr const qint64 DEFAULT_MEMORY_LIMIT = 32 * 1024 * 1024;
+
+    explicit PDFParsedContentCache(qint64 memoryLimit = DEFAULT_MEMORY_LIMIT);
+    virtual ~PDFParsedContentCache() override;
+
+    PDFParsedContentCache(const PDFParsedContentCache&) = delete;
+    PDFParsedContentCache& operator=(const PDFParsedContentCache&) = delete;
+
+    /// Tries to find parsed content identified by \p key. If content
+    /// is not found, nullptr is returned.
+    /// \param key Identifying object
+    PDFParsedContentStreamPointer find(const void* key) const;
+
+    /// Inserts parsed content into the cache. If owner is nullptr, or
+    /// parsed content is too large, then nothing is inserted.
+    /// \param key Identifying object
+    /// \param owner Object, which keeps identifying object alive
+    /// \param content Parsed content stream
+    void insert(const void* key, std::shared_ptr<const void> owner, PDFParsedContentStreamPointer content);
+
+    /// Removes all items from the cache
+    void clear();
+
+    /// Returns memory consumption of the cache (in bytes)
+    qint64 getMemoryConsumption() const;
+
+protected:
+    virtual void trimMemory() override;
+
+private:
+    struct Item
+    {
+        const void* key = nullptr;
+        std::shared_ptr<const void> owner;
+        PDFParsedContentStreamPointer content;
+        qint64 memoryConsumption = 0;
+    };
+
+    using Items = std::list<Item>;
+
+    /// Removes least recently used items, until memory limit is met
+    void shrink();
+
+    mutable QMutex m_mutex;
+    mutable Items m_items;
+    std::unordered_map<const void*, Items::iterator> m_itemMap;
+    qint64 m_memoryConsumption = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFPARSEDCONTENTCACHE_H
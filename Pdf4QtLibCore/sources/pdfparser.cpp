@@ -26,8 +26,10 @@
 
 #include "pdfdbgheap.h"
 
+#include <array>
 #include <cctype>
 #include <memory>
+#include <string_view>
 
 namespace pdf
 {
@@ -68,104 +70,9 @@ PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::fetch()
         case '-':
         case '.':
         {
-            // Scan integer or real number. If integer overflows, then it is converted to the real number. If
-            // real number overflow, then error is reported. This behaviour is according to the PDF 1.7 specification,
-            // chapter 3.2.2.
-
-            // First, treat special characters
-            bool positive = fetchChar('+');
-            bool negative = fetchChar('-');
-            bool dot = fetchChar('.');
-            bool treatAsReal = dot;
-            bool atLeastOneDigit = false;
-
-            if (isAtEnd())
-            {
-                error(tr("Expected a number, but end of stream reached."));
-            }
-
             PDFInteger integer = 0;
             PDFReal real = 0.0;
-            PDFReal scale = 0.1;
-
-            // Now, we can only have digits and a single dot
-            while (!isAtEnd())
-            {
-                if (!dot && fetchChar('.'))
-                {
-                    // Entering real mode
-                    dot = true;
-                    treatAsReal = true;
-                    real = integer;
-                }
-                else if (std::isdigit(static_cast<unsigned char>(lookChar())))
-                {
-                    atLeastOneDigit = true;
-                    PDFInteger digit = lookChar() - '0';
-                    ++m_current;
-
-                    if (!treatAsReal)
-                    {
-                        // Treat value as integer
-                        integer = integer * 10 + digit;
-
-                        // Check, if integer has not overflown, if yes, treat him as real
-                        // according to the PDF 1.7 specification.
-                        if (!isValidInteger(integer))
-                        {
-                            treatAsReal = true;
-                            real = integer;
-                        }
-                    }
-                    else
-                    {
-                        // Treat value as real
-                        if (!dot)
-                        {
-                            real = real * 10.0 + digit;
-                        }
-                        else
-                        {
-                            real = real + scale * digit;
-                            scale *= 0.1;
-                        }
-                    }
-                }
-                else if (isWhitespace(lookChar()) || isDelimiter(lookChar()))
-                {
-                    // Whitespace appeared - whitespaces/delimiters delimits tokens - break
-                    break;
-                }
-                else
-                {
-                    // Another character other than dot and digit appeared - this is an error
-                    error(tr("Invalid format of number. Character '%1' appeared.").arg(lookChar()));
-                }
-            }
-
-            // Now, we have scanned whole token number, check for errors.
-            if (positive && negative)
-            {
-                error(tr("Both '+' and '-' appeared in number. Invalid format of number."));
-            }
-
-            if (!atLeastOneDigit)
-            {
-                error(tr("Bad format of number - no digits appeared."));
-            }
-
-            // Check for real overflow
-            if (treatAsReal && !std::isfinite(real))
-            {
-                error(tr("Real number overflow."));
-            }
-
-            if (negative)
-            {
-                integer = -integer;
-                real = -real;
-            }
-
+            const bool treatAsReal = fetchNumber(integer, real);
             return !treatAsReal ? Token(TokenType::Integer, QVariant(static_cast<qint64>(integer))) : Token(TokenType::Real, real);
         }
 
@@ -484,6 +391,441 @@ PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::fetch()
     return Token(TokenType::EndOfFile);
 }
 
+PDFLexicalAnalyzer::ContentToken PDFLexicalAnalyzer::fetchContentToken()
+{
+    // Skip whitespace/comments at first
+    skipWhitespaceAndComments();
+
+    ContentToken token;
+    token.begin = m_current;
+
+    // If we are at end of token, then return immediately
+    if (isAtEnd())
+    {
+        token.end = m_current;
+        return token;
+    }
+
+    switch (lookChar())
+    {
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+        case '+':
+        case '-':
+        case '.':
+        {
+            PDFInteger integer = 0;
+            PDFReal real = 0.0;
+
+            if (fetchNumber(integer, real))
+            {
+                token.type = TokenType::Real;
+                token.real = real;
+            }
+            else
+            {
+                token.type = TokenType::Integer;
+                token.integer = integer;
+            }
+            break;
+        }
+
+        case CHAR_LEFT_BRACKET:
+        {
+            // Literal string, we just find the end of the string, string is decoded
+            // only, when it is needed, and only if it contains escape sequences.
+            int parenthesisBalance = 1;
+            fetchChar();
+
+            while (parenthesisBalance > 0)
+            {
+                const char character = fetchChar();
+                switch (character)
+                {
+                    case CHAR_LEFT_BRACKET:
+                        ++parenthesisBalance;
+                        break;
+
+                    case CHAR_RIGHT_BRACKET:
+                        --parenthesisBalance;
+                        break;
+
+                    case CHAR_BACKSLASH:
+                        token.needsDecoding = true;
+                        fetchChar();
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+
+            token.type = TokenType::String;
+            break;
+        }
+
+        case CHAR_SLASH:
+        {
+            fetchChar();
+
+            while (!isAtEnd() && isRegular(lookChar()))
+            {
+                if (lookChar() == CHAR_MARK)
+                {
+                    token.needsDecoding = true;
+                }
+                ++m_current;
+            }
+
+            token.type = TokenType::Name;
+            break;
+        }
+
+        case CHAR_ARRAY_START:
+        {
+            ++m_current;
+            token.type = TokenType::ArrayStart;
+            break;
+        }
+
+        case CHAR_ARRAY_END:
+        {
+            ++m_current;
+            token.type = TokenType::ArrayEnd;
+            break;
+        }
+
+        case CHAR_LEFT_ANGLE:
+        {
+            ++m_current;
+
+            if (fetchChar(CHAR_LEFT_ANGLE))
+            {
+                token.type = TokenType::DictionaryStart;
+                break;
+            }
+
+            // Hexadecimal string, it is always decoded
+            while (fetchChar() != CHAR_RIGHT_ANGLE)
+            {
+
+            }
+
+            token.type = TokenType::String;
+            token.needsDecoding = true;
+            break;
+        }
+
+        case CHAR_RIGHT_ANGLE:
+        {
+            ++m_current;
+
+            if (!fetchChar(CHAR_RIGHT_ANGLE))
+            {
+                error(tr("Invalid character '%1'").arg(CHAR_RIGHT_ANGLE));
+            }
+
+            token.type = TokenType::DictionaryEnd;
+            break;
+        }
+
+        default:
+        {
+            Q_ASSERT(!isWhitespace(lookChar()));
+
+            if (!isRegular(lookChar()))
+            {
+                error(tr("Unexpected character '%1' in the stream.").arg(lookChar()));
+            }
+
+            while (!isAtEnd() && isRegular(lookChar()))
+            {
+                ++m_current;
+            }
+
+            const std::string_view command(token.begin, m_current - token.begin);
+            if (command == BOOL_OBJECT_TRUE_STRING)
+            {
+                token.type = TokenType::Boolean;
+                token.boolean = true;
+            }
+            else if (command == BOOL_OBJECT_FALSE_STRING)
+            {
+                token.type = TokenType::Boolean;
+                token.boolean = false;
+            }
+            else if (command == NULL_OBJECT_STRING)
+            {
+                token.type = TokenType::Null;
+            }
+            else
+            {
+                token.type = TokenType::Command;
+            }
+            break;
+        }
+    }
+
+    token.end = m_current;
+    return token;
+}
+
+PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::toToken(const ContentToken& token)
+{
+    switch (token.type)
+    {
+        case TokenType::Boolean:
+            return Token(TokenType::Boolean, token.boolean);
+
+        case TokenType::Integer:
+            return Token(TokenType::Integer, QVariant(static_cast<qint64>(token.integer)));
+
+        case TokenType::Real:
+            return Token(TokenType::Real, token.real);
+
+        case TokenType::String:
+        {
+            if (token.needsDecoding)
+            {
+                PDFLexicalAnalyzer analyzer(token.begin, token.end);
+                return analyzer.fetch();
+            }
+
+            // Skip brackets
+            Q_ASSERT(token.size() >= 2);
+            return Token(TokenType::String, QByteArray(token.begin + 1, int(token.size()) - 2));
+        }
+
+        case TokenType::Name:
+        {
+            if (token.needsDecoding)
+            {
+                PDFLexicalAnalyzer analyzer(token.begin, token.end);
+                return analyzer.fetch();
+            }
+
+            // Skip slash
+            Q_ASSERT(token.size() >= 1);
+            return Token(TokenType::Name, QByteArray(token.begin + 1, int(token.size()) - 1));
+        }
+
+        case TokenType::Command:
+            return Token(TokenType::Command, QByteArray(token.begin, int(token.size())));
+
+        default:
+            return Token(token.type);
+    }
+}
+
+bool PDFLexicalAnalyzer::fetchNumberFast(PDFInteger& integer, PDFReal& real, bool& isReal)
+{
+    // Maximal number of digits, so integer mantissa fits into 64-bit integer
+    constexpr int MAX_INTEGER_DIGITS = 18;
+
+    // Maximal number of digits, so real mantissa is exactly representable
+    // by double, so single division by power of ten is correctly rounded.
+    constexpr int MAX_REAL_DIGITS = 15;
+    static constexpr std::array<PDFReal, MAX_REAL_DIGITS + 1> POWERS_OF_TEN = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                                                               1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+    const char* it = m_current;
+    bool negative = false;
+
+    if (it != m_end && (*it == '+' || *it == '-'))
+    {
+        negative = *it == '-';
+        ++it;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    bool dot = false;
+
+    for (; it != m_end; ++it)
+    {
+        const char character = *it;
+        if (character >= '0' && character <= '9')
+        {
+            if (digits < MAX_INTEGER_DIGITS)
+            {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(character - '0');
+            }
+
+            ++digits;
+            fractionDigits += dot ? 1 : 0;
+        }
+        else if (character == '.' && !dot)
+        {
+            dot = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // Number must contain a digit and must be terminated by end of stream,
+    // whitespace or delimiter, otherwise errors are handled by the slow path.
+    if (digits == 0 || (it != m_end && !isWhitespace(*it) && !isDelimiter(*it)))
+    {
+        return false;
+    }
+
+    const PDFInteger value = static_cast<PDFInteger>(mantissa);
+
+    if (!dot && digits <= MAX_INTEGER_DIGITS && isValidInteger(value))
+    {
+        isReal = false;
+        integer = negative ? -value : value;
+        real = 0.0;
+    }
+    else if (dot && digits <= MAX_REAL_DIGITS)
+    {
+        isReal = true;
+        real = static_cast<PDFReal>(mantissa) / POWERS_OF_TEN[fractionDigits];
+        real = negative ? -real : real;
+        integer = 0;
+    }
+    else
+    {
+        // Long numbers are rare, we convert them using locale independent
+        // conversion, so they are correctly rounded. Overflow is reported
+        // by the slow path.
+        bool ok = false;
+        real = QByteArray::fromRawData(m_current, std::distance(m_current, it)).toDouble(&ok);
+
+        if (!ok || !std::isfinite(real))
+        {
+            return false;
+        }
+
+        isReal = true;
+        integer = 0;
+    }
+
+    m_current = it;
+    return true;
+}
+
+bool PDFLexicalAnalyzer::fetchNumber(PDFInteger& integer, PDFReal& real)
+{
+    // Scan integer or real number. If integer overflows, then it is converted to the real number. If
+    // real number overflow, then error is reported. This behaviour is according to the PDF 1.7 specification,
+    // chapter 3.2.2.
+
+    // Most numbers are in common form and can be parsed using fast path
+    bool isReal = false;
+    if (fetchNumberFast(integer, real, isReal))
+    {
+        return isReal;
+    }
+
+    // First, treat special characters
+    bool positive = fetchChar('+');
+    bool negative = fetchChar('-');
+    bool dot = fetchChar('.');
+    bool treatAsReal = dot;
+    bool atLeastOneDigit = false;
+
+    if (isAtEnd())
+    {
+        error(tr("Expected a number, but end of stream reached."));
+    }
+
+    integer = 0;
+    real = 0.0;
+    PDFReal scale = 0.1;
+
+    // Now, we can only have digits and a single dot
+    while (!isAtEnd())
+    {
+        if (!dot && fetchChar('.'))
+        {
+            // Entering real mode
+            dot = true;
+            treatAsReal = true;
+            real = integer;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(lookChar())))
+        {
+            atLeastOneDigit = true;
+            PDFInteger digit = lookChar() - '0';
+            ++m_current;
+
+            if (!treatAsReal)
+            {
+                // Treat value as integer
+                integer = integer * 10 + digit;
+
+                // Check, if integer has not overflown, if yes, treat him as real
+                // according to the PDF 1.7 specification.
+                if (!isValidInteger(integer))
+                {
+                    treatAsReal = true;
+                    real = integer;
+                }
+            }
+            else
+            {
+                // Treat value as real
+                if (!dot)
+                {
+                    real = real * 10.0 + digit;
+                }
+                else
+                {
+                    real = real + scale * digit;
+                    scale *= 0.1;
+                }
+            }
+        }
+        else if (isWhitespace(lookChar()) || isDelimiter(lookChar()))
+        {
+            // Whitespace appeared - whitespaces/delimiters delimits tokens - break
+            break;
+        }
+        else
+        {
+            // Another character other than dot and digit appeared - this is an error
+            error(tr("Invalid format of number. Character '%1' appeared.").arg(lookChar()));
+        }
+    }
+
+    // Now, we have scanned whole token number, check for errors.
+    if (positive && negative)
+    {
+        error(tr("Both '+' and '-' appeared in number. Invalid format of number."));
+    }
+
+    if (!atLeastOneDigit)
+    {
+        error(tr("Bad format of number - no digits appeared."));
+    }
+
+    // Check for real overflow
+    if (treatAsReal && !std::isfinite(real))
+    {
+        error(tr("Real number overflow."));
+    }
+
+    if (negative)
+    {
+        integer = -integer;
+        real = -real;
+    }
+
+    return treatAsReal;
+}
+
 void PDFLexicalAnalyzer::seek(PDFInteger offset)
 {
     const PDFInteger limit = std::distance(m_begin, m_end);
@@ -553,6 +895,20 @@ QByteArray PDFLexicalAnalyzer::fetchByteArray(PDFInteger length)
     return result;
 }
 
+QByteArray PDFLexicalAnalyzer::fetchByteArrayReference(PDFInteger length)
+{
+    Q_ASSERT(length >= 0);
+
+    if (std::distance(m_current, m_end) < length)
+    {
+        error(tr("Can't read %1 bytes from the input stream. Input stream end reached.").arg(length));
+    }
+
+    QByteArray result = QByteArray::fromRawData(m_current, length);
+    std::advance(m_current, length);
+    return result;
+}
+
 PDFInteger PDFLexicalAnalyzer::findSubstring(const char* str, PDFInteger position) const
 {
     const PDFInteger length = std::distance(m_begin, m_end);
@@ -757,7 +1113,7 @@ PDFObject PDFParser::getObject()
             QByteArray array = m_lookAhead1.data.toByteArray();
             array.shrink_to_fit();
             shift();
-            return PDFObject::createString(std::move(array));
+            return PDFObject::createString(std::move(array), m_objectArena);
         }
 
         case PDFLexicalAnalyzer::TokenType::Name:
@@ -766,7 +1122,7 @@ PDFObject PDFParser::getObject()
             QByteArray array = m_lookAhead1.data.toByteArray();
             array.shrink_to_fit();
             shift();
-            return PDFObject::createName(std::move(array));
+            return PDFObject::createName(std::move(array), m_objectArena);
         }
 
         case PDFLexicalAnalyzer::TokenType::ArrayStart:
@@ -775,7 +1131,7 @@ PDFObject PDFParser::getObject()
 
             // Create shared pointer to the array (if the exception is thrown, array
             // will be properly destroyed by the shared array destructor)
-            std::shared_ptr<PDFObjectContent> arraySharedPointer = std::make_shared<PDFArray>();
+            std::shared_ptr<PDFObjectContent> arraySharedPointer = PDFObjectArena::create<PDFArray>(m_objectArena);
             PDFArray* array = static_cast<PDFArray*>(arraySharedPointer.get());
 
             while (m_lookAhead1.type != PDFLexicalAnalyzer::TokenType::EndOfFile &&
@@ -803,7 +1159,7 @@ PDFObject PDFParser::getObject()
 
             // Start reading the dictionary. BEWARE! It can also be a stream. In this case,
             // we must load also the stream content.
-            std::shared_ptr<PDFDictionary> dictionarySharedPointer = std::make_shared<PDFDictionary>();
+            std::shared_ptr<PDFDictionary> dictionarySharedPointer = PDFObjectArena::create<PDFDictionary>(m_objectArena);
             PDFDictionary* dictionary = dictionarySharedPointer.get();
 
             // Now, scan key/value pairs
@@ -863,7 +1219,8 @@ PDFObject PDFParser::getObject()
 
                 // Skip the stream start, then fetch data of the stream
                 m_lexicalAnalyzer.skipStreamStart();
-                QByteArray buffer = m_lexicalAnalyzer.fetchByteArray(length);
+                QByteArray buffer = m_dataOwner ? m_lexicalAnalyzer.fetchByteArrayReference(length) : m_lexicalAnalyzer.fetchByteArray(length);
+                std::shared_ptr<const void> contentOwner = m_dataOwner;
 
                 // According to the PDF Reference 1.7, chapter 3.2.7, stream content can also be specified
                 // in the external file. If this is the case, then we must try to load the stream data
@@ -881,6 +1238,7 @@ PDFObject PDFParser::getObject()
                     if (streamDataFile.open(QFile::ReadOnly))
                     {
                         buffer = streamDataFile.readAll();
+                        contentOwner.reset();
                         streamDataFile.close();
                     }
                     else
@@ -898,7 +1256,7 @@ PDFObject PDFParser::getObject()
                 {
                     // Everything OK, just advance and return stream object
                     shift();
-                    return PDFObject::createStream(std::make_shared<PDFStream>(std::move(*dictionary), std::move(buffer)));
+                    return PDFObject::createStream(PDFObjectArena::create<PDFStream>(m_objectArena, std::move(*dictionary), std::move(buffer), std::move(contentOwner)));
                 }
                 else
                 {
@@ -22,12 +22,14 @@
 #include "pdfglobal.h"
 #include "pdfobject.h"
 #include "pdfflatmap.h"
+#include "pdfobjectarena.h"
 
 #include <QVariant>
 #include <QByteArray>
 
 #include <set>
 #include <functional>
+#include <string_view>
 
 namespace pdf
 {
@@ -121,10 +123,42 @@ public:
         QVariant data;
     };
 
+    /// Lightweight token used for tokenizing content streams. Token is trivially
+    /// copyable and doesn't allocate memory. Numbers and booleans are stored inline,
+    /// names, strings and commands are views into the source buffer (including
+    /// leading slash of the name and string delimiters). If text of the token
+    /// contains escape sequences, it must be decoded, see \p toToken.
+    struct ContentToken
+    {
+        TokenType type = TokenType::EndOfFile;
+        bool needsDecoding = false;
+        union
+        {
+            bool boolean;
+            PDFInteger integer = 0;
+            PDFReal real;
+        };
+        const char* begin = nullptr;
+        const char* end = nullptr;
+
+        inline size_t size() const { return end - begin; }
+        inline std::string_view view() const { return std::string_view(begin, size()); }
+    };
+
     /// Fetches a new token from the input stream. If we are at end of the input
     /// stream, then EndOfFile token is returned.
     Token fetch();
 
+    /// Fetches a new lightweight content token from the input stream. If we are
+    /// at end of the input stream, then EndOfFile token is returned. Token refers
+    /// to the source buffer, so it is valid only while source buffer is alive.
+    ContentToken fetchContentToken();
+
+    /// Converts lightweight content token to the regular token, names and strings
+    /// are decoded and their data are copied.
+    /// \param token Content token
+    static Token toToken(const ContentToken& token);
+
     /// Seeks stream from the start. If stream cannot be seeked (position is invalid),
     /// then exception is thrown.
     void seek(PDFInteger offset);
@@ -140,6 +174,13 @@ public:
     /// \param length Length of the buffer
     QByteArray fetchByteArray(PDFInteger length);
 
+    /// Reads number of bytes from the buffer and creates a byte array referencing
+    /// the data, i.e. data are not copied. Caller is responsible for keeping the
+    /// source data alive. If end of stream appears before desired end byte,
+    /// exception is thrown.
+    /// \param length Length of the buffer
+    QByteArray fetchByteArrayReference(PDFInteger length);
+
     /// Returns, if whole stream was scanned
     inline bool isAtEnd() const { return m_current == m_end; }
 
@@ -194,6 +235,23 @@ private:
     /// or letter A-F, or small letter a-f.
     static constexpr bool isHexCharacter(const char character);
 
+    /// Fetches integer or real number from the stream. Returns true,
+    /// if number is real, false if number is integer.
+    /// \param integer Integer value
+    /// \param real Real value
+    bool fetchNumber(PDFInteger& integer, PDFReal& real);
+
+    /// Tries to fetch number using fast path for numbers in common form (optional
+    /// sign, digits and optional dot). Mantissa is accumulated as integer and real
+    /// number is obtained by single division by power of ten, long numbers are
+    /// converted by locale independent conversion, so real numbers are always
+    /// correctly rounded. If number is not in common form, or it is malformed, then
+    /// false is returned, stream position is not changed, and slow path must be used.
+    /// \param integer Integer value
+    /// \param real Real value
+    /// \param[out] isReal Is number real?
+    bool fetchNumberFast(PDFInteger& integer, PDFReal& real, bool& isReal);
+
     /// Throws an error exception
     void error(const QString& message) const;
 
@@ -309,6 +367,12 @@ public:
     /// exception is thrown.
     PDFObject getObject(PDFObjectReference reference);
 
+    /// Fetches integer or real number from the stream. Returns true,
+    /// if number is real, false if number is integer.
+    /// \param integer Integer value
+    /// \param real Real value
+    bool fetchNumber(PDFInteger& integer, PDFReal& real);
+
     /// Throws an error exception
     void error(const QString& message) const;
 
@@ -324,6 +388,18 @@ public:
     /// \param command Command to be fetched
     bool fetchCommand(const char* command);
 
+    /// Sets owner of the parsed data. If owner is set, then stream content
+    /// is not copied, but it references the parsed data, and owner is stored
+    /// in the created stream objects to keep the data alive.
+    /// \param owner Owner of the parsed data
+    void setDataOwner(std::shared_ptr<const void> owner) { m_dataOwner = std::move(owner); }
+
+    /// Sets arena, from which content of parsed objects is allocated. If arena
+    /// is not set, then content of objects is allocated on the heap. Arena
+    /// is not owned by the parser, caller must keep it alive.
+    /// \param arena Object arena
+    void setObjectArena(PDFObjectArena* arena) { m_objectArena = arena; }
+
 private:
     void shift();
 
@@ -343,6 +419,12 @@ private:
 
     PDFLexicalAnalyzer::Token m_lookAhead1;
     PDFLexicalAnalyzer::Token m_lookAhead2;
+
+    /// Owner of the parsed data, if stream content is referenced
+    std::shared_ptr<const void> m_dataOwner;
+
+    /// Arena for content of parsed objects (can be nullptr)
+    PDFObjectArena* m_objectArena = nullptr;
 };
 
 // Implementation
@@ -23,9 +23,12 @@
 #include "pdfexecutionpolicy.h"
 #include "pdfconstants.h"
 #include "pdfpainterutils.h"
+#include "pdfglyphcache.h"
+#include "pdfmeshrasterizer.h"
 
 #include <QMutex>
 #include <QPainter>
+#include <QtMath>
 
 #include "pdfdbgheap.h"
 
@@ -61,6 +64,150 @@ PDFShadingSampler* PDFShadingPattern::createSampler(QTransform userSpaceToDevice
     return nullptr;
 }
 
+QBrush PDFShadingPattern::createGradientBrush(const QTransform& userSpaceToDeviceSpaceMatrix,
+                                              const PDFMeshQualitySettings& settings,
+                                              const PDFCMS* cms,
+                                              RenderingIntent intent,
+                                              PDFRenderErrorReporter* reporter) const
+{
+    Q_UNUSED(userSpaceToDeviceSpaceMatrix);
+    Q_UNUSED(settings);
+    Q_UNUSED(cms);
+    Q_UNUSED(intent);
+    Q_UNUSED(reporter);
+
+    return QBrush();
+}
+
+bool PDFSingleDimensionShading::evaluateFunctions(const std::vector<PDFReal>& parameters,
+                                                  const std::vector<int>& indices,
+                                                  PDFColorBuffer outputBuffer,
+                                                  size_t stride) const
+{
+    Q_ASSERT(parameters.size() == indices.size());
+
+    if (parameters.empty())
+    {
+        return true;
+    }
+
+    if (!m_colorSpace)
+    {
+        return false;
+    }
+
+    const size_t colorComponentCount = m_colorSpace->getColorComponentCount();
+    const size_t count = parameters.size();
+    std::vector<PDFReal> colors;
+
+    if (m_functions.size() == 1)
+    {
+        const PDFFunction* function = m_functions.front().get();
+        if (!function || function->getInputVariableCount() != 1 || function->getOutputVariableCount() != colorComponentCount)
+        {
+            return false;
+        }
+
+        colors.resize(count * colorComponentCount, 0.0);
+        if (!function->applyBatch(parameters.data(), colors.data(), count))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            PDFColorComponent* output = outputBuffer.begin() + indices[i] * stride;
+            const PDFReal* color = colors.data() + i * colorComponentCount;
+            for (size_t j = 0; j < colorComponentCount; ++j)
+            {
+                output[j] = color[j];
+            }
+        }
+
+        return true;
+    }
+
+    if (m_functions.size() != colorComponentCount)
+    {
+        // Invalid number of functions
+        return false;
+    }
+
+    colors.resize(count, 0.0);
+    for (size_t j = 0; j < colorComponentCount; ++j)
+    {
+        const PDFFunction* function = m_functions[j].get();
+        if (!function || function->getInputVariableCount() != 1 || function->getOutputVariableCount() != 1)
+        {
+            return false;
+        }
+
+        if (!function->applyBatch(parameters.data(), colors.data(), count))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            outputBuffer[indices[i] * stride + j] = colors[i];
+        }
+    }
+
+    return true;
+}
+
+bool PDFSingleDimensionShading::isGradientBrushSupported() const
+{
+    return m_colorSpace && !m_functions.empty() && m_extendStart && m_extendEnd && !m_backgroundColor.isValid();
+}
+
+QGradientStops PDFSingleDimensionShading::createGradientStops(PDFReal deviceLength,
+                                                              PDFInteger maximalStopCount,
+                                                              const PDFCMS* cms,
+                                                              RenderingIntent intent,
+                                                              PDFRenderErrorReporter* reporter) const
+{
+    // One stop per device pixel is enough, paint engines interpolate colors
+    // between stops linearly. Paint engines also use color lookup table of limited size,
+    // so more stops will not increase the precision.
+    constexpr int MIN_STOP_COUNT = 16;
+    constexpr int MAX_STOP_COUNT = 256;
+
+    const int maxStopCount = qBound(MIN_STOP_COUNT, int(maximalStopCount), MAX_STOP_COUNT);
+    const int stopCount = qBound(MIN_STOP_COUNT, qCeil(deviceLength), maxStopCount);
+    const size_t colorComponentCount = m_colorSpace->getColorComponentCount();
+
+    std::vector<PDFReal> parameters(stopCount, 0.0);
+    std::vector<int> indices(stopCount, 0);
+    for (int i = 0; i < stopCount; ++i)
+    {
+        parameters[i] = interpolate(i, 0, stopCount - 1, m_domainStart, m_domainEnd);
+        indices[i] = i;
+    }
+
+    std::vector<PDFColorComponent> colors(stopCount * colorComponentCount, 0.0f);
+    if (!evaluateFunctions(parameters, indices, PDFColorBuffer(colors.data(), colors.size()), colorComponentCount))
+    {
+        return QGradientStops();
+    }
+
+    QGradientStops stops;
+    stops.reserve(stopCount);
+
+    for (int i = 0; i < stopCount; ++i)
+    {
+        PDFColor color;
+        for (size_t j = 0; j < colorComponentCount; ++j)
+        {
+            color.push_back(colors[i * colorComponentCount + j]);
+        }
+
+        stops.append(QGradientStop(PDFReal(i) / PDFReal(stopCount - 1), m_colorSpace->getColor(color, cms, intent, reporter, true)));
+    }
+
+    return stops;
+}
+
 ShadingType PDFAxialShading::getShadingType() const
 {
     return ShadingType::Axial;
@@ -442,6 +589,11 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             }
             else
             {
+                if (colorSpace->getColorComponentCount() > PDF_MAX_COLOR_COMPONENTS)
+                {
+                    throw PDFException(PDFTranslationContext::tr("Too many color components (%1) for shading.").arg(colorSpace->getColorComponentCount()));
+                }
+
                 const size_t expectedSize = colorSpace->getColorComponentCount() * 2 + 4;
                 if (decode.size() != expectedSize)
                 {
@@ -465,6 +617,7 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             type4567Shading->m_colorComponentCount = !functions.empty() ? 1 : colorSpace->getColorComponentCount();
             type4567Shading->m_functions = qMove(functions);
             type4567Shading->m_data = document->getDecodedStream(stream);
+            type4567Shading->m_shadingReference = shadingObject.isReference() ? shadingObject.getReference() : PDFObjectReference();
 
             switch (shadingType)
             {
@@ -1298,6 +1451,68 @@ public:
         return true;
     }
 
+    virtual void sampleRow(PDFReal x, PDFReal y, int count, PDFColorBuffer outputBuffer, size_t stride, bool* sampled, int limit) const override
+    {
+        const size_t colorComponentCount = m_pattern->getColorSpace() ? m_pattern->getColorSpace()->getColorComponentCount() : 0;
+        if (colorComponentCount == 0 || colorComponentCount > PDF_MAX_COLOR_COMPONENTS)
+        {
+            std::fill(sampled, sampled + count, false);
+            return;
+        }
+
+        std::array<PDFColorComponent, PDF_MAX_COLOR_COMPONENTS> backgroundColor = { };
+        const bool hasBackgroundColor = fillBackgroundColor(PDFColorBuffer(backgroundColor.data(), colorComponentCount));
+
+        std::vector<PDFReal> parameters;
+        std::vector<int> indices;
+        parameters.reserve(count);
+        indices.reserve(count);
+
+        // Mapped coordinate depends linearly on the device x coordinate, so we step it incrementally
+        const PDFReal mappedStartX = m_p1p2GCS.map(QPointF(x, y)).x();
+        const PDFReal mappedStepX = m_p1p2GCS.m11();
+
+        for (int i = 0; i < count; ++i)
+        {
+            const PDFReal mappedX = mappedStartX + i * mappedStepX;
+            const bool isBeforeStart = mappedX < m_xStart;
+            const bool isAfterEnd = mappedX > m_xEnd;
+
+            sampled[i] = true;
+
+            if (isBeforeStart || isAfterEnd)
+            {
+                if ((isBeforeStart && !m_axialShadingPattern->isExtendStart()) ||
+                    (isAfterEnd && !m_axialShadingPattern->isExtendEnd()))
+                {
+                    sampled[i] = false;
+                    continue;
+                }
+
+                if (hasBackgroundColor)
+                {
+                    std::copy(backgroundColor.cbegin(), backgroundColor.cbegin() + colorComponentCount, outputBuffer.begin() + i * stride);
+                    continue;
+                }
+
+                parameters.push_back(isBeforeStart ? m_tAtStart : m_tAtEnd);
+            }
+            else
+            {
+                PDFReal t = interpolate(mappedX, m_xStart, m_xEnd, m_tAtStart, m_tAtEnd);
+                parameters.push_back(qBound(m_tMin, t, m_tMax));
+            }
+
+            indices.push_back(i);
+        }
+
+        if (!m_axialShadingPattern->evaluateFunctions(parameters, indices, outputBuffer, stride))
+        {
+            // Functions can't be evaluated in batch, sample each point separately
+            PDFShadingSampler::sampleRow(x, y, count, outputBuffer, stride, sampled, limit);
+        }
+    }
+
 private:
     const PDFAxialShading* m_axialShadingPattern;
     QTransform m_p1p2GCS;
@@ -1314,6 +1529,34 @@ PDFShadingSampler* PDFAxialShading::createSampler(QTransform userSpaceToDeviceSp
     return new PDFAxialShadingSampler(this, userSpaceToDeviceSpaceMatrix);
 }
 
+QBrush PDFAxialShading::createGradientBrush(const QTransform& userSpaceToDeviceSpaceMatrix,
+                                            const PDFMeshQualitySettings& settings,
+                                            const PDFCMS* cms,
+                                            RenderingIntent intent,
+                                            PDFRenderErrorReporter* reporter) const
+{
+    const QTransform patternSpaceToDeviceSpace = getPatternSpaceToDeviceSpaceMatrix(userSpaceToDeviceSpaceMatrix);
+    if (!isGradientBrushSupported() || m_startPoint == m_endPoint || !patternSpaceToDeviceSpace.isInvertible())
+    {
+        return QBrush();
+    }
+
+    const PDFReal deviceLength = QLineF(patternSpaceToDeviceSpace.map(m_startPoint), patternSpaceToDeviceSpace.map(m_endPoint)).length();
+    QGradientStops stops = createGradientStops(deviceLength, settings.gradientStopCount, cms, intent, reporter);
+    if (stops.isEmpty())
+    {
+        return QBrush();
+    }
+
+    QLinearGradient gradient(m_startPoint, m_endPoint);
+    gradient.setSpread(QGradient::PadSpread);
+    gradient.setStops(stops);
+
+    QBrush brush(gradient);
+    brush.setTransform(patternSpaceToDeviceSpace);
+    return brush;
+}
+
 void PDFMesh::paint(QPainter* painter, PDFReal alpha) const
 {
     if (m_triangles.empty())
@@ -1339,6 +1582,36 @@ void PDFMesh::paint(QPainter* painter, PDFReal alpha) const
         painter->drawPath(m_backgroundPath);
     }
 
+    if (PDFGlyphCache::isBlittingSupported(painter))
+    {
+        // Rasterize triangles directly into the image in device pixels, only
+        // visible part of the mesh is rasterized.
+        const QTransform deviceTransform = painter->deviceTransform();
+        const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+
+        QRect deviceRect = deviceTransform.mapRect(getBoundingRect()).toAlignedRect();
+        deviceRect = deviceRect.intersected(QRect(QPoint(0, 0), QSizeF(painter->device()->width() * devicePixelRatio, painter->device()->height() * devicePixelRatio).toSize()));
+
+        if (painter->hasClipping())
+        {
+            deviceRect = deviceRect.intersected(deviceTransform.mapRect(painter->clipBoundingRect()).toAlignedRect());
+        }
+
+        if (!deviceRect.isEmpty())
+        {
+            QImage image(deviceRect.size(), QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+            PDFMeshRasterizer::rasterize(image, *this, deviceTransform * QTransform::fromTranslate(-deviceRect.left(), -deviceRect.top()), alpha);
+            image.setDevicePixelRatio(devicePixelRatio);
+
+            painter->setWorldTransform(QTransform());
+            painter->drawImage(QPointF(deviceRect.topLeft()) / devicePixelRatio, image);
+        }
+
+        painter->restore();
+        return;
+    }
+
     QColor color;
 
     // Draw all triangles
@@ -1377,6 +1650,7 @@ void PDFMesh::addMesh(std::vector<QPointF>&& vertices, std::vector<PDFMesh::Tria
     {
         m_vertices = qMove(vertices);
         m_triangles = qMove(triangles);
+        m_triangleVertexColors.clear();
     }
     else
     {
@@ -1391,7 +1665,44 @@ void PDFMesh::addMesh(std::vector<QPointF>&& vertices, std::vector<PDFMesh::Tria
         }
 
         m_triangles.insert(m_triangles.cend(), triangles.cbegin(), triangles.cend());
+
+        if (!m_triangleVertexColors.empty())
+        {
+            for (const Triangle& triangle : triangles)
+            {
+                m_triangleVertexColors.push_back({ triangle.color, triangle.color, triangle.color });
+            }
+        }
+    }
+}
+
+uint32_t PDFMesh::addGouraudTriangle(const Triangle& triangle, const std::array<QRgb, 3>& vertexColors)
+{
+    if (m_triangleVertexColors.empty())
+    {
+        // Previously added triangles are flat
+        m_triangleVertexColors.reserve(m_triangles.capacity());
+        for (const Triangle& flatTriangle : m_triangles)
+        {
+            m_triangleVertexColors.push_back({ flatTriangle.color, flatTriangle.color, flatTriangle.color });
+        }
     }
+
+    const size_t index = m_triangles.size();
+    m_triangles.emplace_back(triangle);
+    m_triangleVertexColors.push_back(vertexColors);
+    return static_cast<uint32_t>(index);
+}
+
+std::array<QRgb, 3> PDFMesh::getTriangleVertexColors(size_t index) const
+{
+    if (!m_triangleVertexColors.empty())
+    {
+        return m_triangleVertexColors[index];
+    }
+
+    const QRgb color = m_triangles[index].color;
+    return { color, color, color };
 }
 
 QPointF PDFMesh::getTriangleCenter(const PDFMesh::Triangle& triangle) const
@@ -1399,11 +1710,116 @@ QPointF PDFMesh::getTriangleCenter(const PDFMesh::Triangle& triangle) const
     return (m_vertices[triangle.v1] + m_vertices[triangle.v2] + m_vertices[triangle.v3]) / 3.0;
 }
 
+QRectF PDFMesh::getBoundingRect() const
+{
+    QRectF boundingRect;
+
+    if (!m_vertices.empty())
+    {
+        PDFReal xMin = m_vertices.front().x();
+        PDFReal xMax = xMin;
+        PDFReal yMin = m_vertices.front().y();
+        PDFReal yMax = yMin;
+
+        for (const QPointF& vertex : m_vertices)
+        {
+            xMin = qMin(xMin, vertex.x());
+            xMax = qMax(xMax, vertex.x());
+            yMin = qMin(yMin, vertex.y());
+            yMax = qMax(yMax, vertex.y());
+        }
+
+        boundingRect = QRectF(xMin, yMin, xMax - xMin, yMax - yMin);
+    }
+
+    if (!m_backgroundPath.isEmpty() && m_backgroundColor.isValid())
+    {
+        boundingRect = boundingRect.isNull() ? m_backgroundPath.controlPointRect() : boundingRect.united(m_backgroundPath.controlPointRect());
+    }
+
+    if (!m_boundingPath.isEmpty() && !boundingRect.isNull())
+    {
+        boundingRect = boundingRect.intersected(m_boundingPath.controlPointRect());
+    }
+
+    // Triangles are also painted with pen of unit width
+    return boundingRect.isNull() ? boundingRect : boundingRect.adjusted(-1.0, -1.0, 1.0, 1.0);
+}
+
+QDataStream& operator<<(QDataStream& stream, const PDFMesh& mesh)
+{
+    stream << mesh.m_vertices;
+    stream << quint64(mesh.m_triangles.size());
+    for (const PDFMesh::Triangle& triangle : mesh.m_triangles)
+    {
+        stream << triangle.v1 << triangle.v2 << triangle.v3 << triangle.color;
+    }
+    stream << quint64(mesh.m_triangleVertexColors.size());
+    for (const std::array<QRgb, 3>& vertexColors : mesh.m_triangleVertexColors)
+    {
+        stream << vertexColors[0] << vertexColors[1] << vertexColors[2];
+    }
+    stream << mesh.m_boundingPath;
+    stream << mesh.m_backgroundPath;
+    stream << mesh.m_backgroundColor;
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, PDFMesh& mesh)
+{
+    stream >> mesh.m_vertices;
+
+    quint64 triangleCount = 0;
+    stream >> triangleCount;
+
+    mesh.m_triangles.clear();
+    mesh.m_triangles.reserve(qMin<quint64>(triangleCount, 1 << 20));
+    for (quint64 i = 0; i < triangleCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        PDFMesh::Triangle triangle;
+        stream >> triangle.v1 >> triangle.v2 >> triangle.v3 >> triangle.color;
+
+        // Check vertex indices, so corrupted data can't cause
+        // accessing vertices outside of the vertex array.
+        const size_t vertexCount = mesh.m_vertices.size();
+        if (triangle.v1 >= vertexCount || triangle.v2 >= vertexCount || triangle.v3 >= vertexCount)
+        {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+
+        mesh.m_triangles.push_back(triangle);
+    }
+
+    quint64 vertexColorsCount = 0;
+    stream >> vertexColorsCount;
+
+    mesh.m_triangleVertexColors.clear();
+    if (vertexColorsCount != 0 && vertexColorsCount != mesh.m_triangles.size())
+    {
+        stream.setStatus(QDataStream::ReadCorruptData);
+    }
+
+    mesh.m_triangleVertexColors.reserve(qMin<quint64>(vertexColorsCount, 1 << 20));
+    for (quint64 i = 0; i < vertexColorsCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        std::array<QRgb, 3> vertexColors = { };
+        stream >> vertexColors[0] >> vertexColors[1] >> vertexColors[2];
+        mesh.m_triangleVertexColors.push_back(vertexColors);
+    }
+
+    stream >> mesh.m_boundingPath;
+    stream >> mesh.m_backgroundPath;
+    stream >> mesh.m_backgroundColor;
+    return stream;
+}
+
 qint64 PDFMesh::getMemoryConsumptionEstimate() const
 {
     qint64 memoryConsumption = sizeof(*this);
     memoryConsumption += sizeof(QPointF) * m_vertices.capacity();
     memoryConsumption += sizeof(Triangle) * m_triangles.capacity();
+    memoryConsumption += sizeof(std::array<QRgb, 3>) * m_triangleVertexColors.capacity();
     memoryConsumption += sizeof(QPainterPath::Element) * m_boundingPath.capacity();
     memoryConsumption += sizeof(QPainterPath::Element) * m_backgroundPath.capacity();
     return memoryConsumption;
@@ -1418,6 +1834,14 @@ void PDFMesh::convertColors(const PDFColorConvertor& colorConvertor)
         triangle.color = adjustedColor.rgb();
     }
 
+    for (std::array<QRgb, 3>& vertexColors : m_triangleVertexColors)
+    {
+        for (QRgb& vertexColor : vertexColors)
+        {
+            vertexColor = colorConvertor.convert(QColor::fromRgb(vertexColor), false, false).rgb();
+        }
+    }
+
     m_backgroundColor = colorConvertor.convert(m_backgroundColor, true, false);
 }
 
@@ -1797,6 +2221,106 @@ public:
 
         QPointF mappedPoint = m_p1p2GCS.map(devicePoint);
 
+        PDFReal t = 0.0;
+        if (!computeParameter(mappedPoint, t))
+        {
+            return false;
+        }
+
+        const auto& functions = m_radialShadingPattern->getFunctions();
+        std::array<PDFReal, PDF_MAX_COLOR_COMPONENTS> colorBuffer = { };
+
+        if (colorBuffer.size() < outputBuffer.size())
+        {
+            // Jakub Melka: Too much colors - we cant process it
+            return false;
+        }
+
+        if (functions.size() == 1)
+        {
+            Q_ASSERT(outputBuffer.size() <= colorBuffer.size());
+            PDFFunction::FunctionResult result = functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + outputBuffer.size());
+
+            if (!result)
+            {
+                // Function call failed
+                return false;
+            }
+        }
+        else
+        {
+            if (functions.size() != outputBuffer.size())
+            {
+                // Invalid number of functions
+                return false;
+            }
+
+            Q_ASSERT(outputBuffer.size() <= colorBuffer.size());
+            for (size_t i = 0, count = outputBuffer.size(); i < count; ++i)
+            {
+                PDFFunction::FunctionResult result = functions[i]->apply(&t, &t + 1, colorBuffer.data() + i, colorBuffer.data() + i + 1);
+
+                if (!result)
+                {
+                    // Function call failed
+                    return false;
+                }
+            }
+        }
+
+        for (size_t i = 0, count = outputBuffer.size(); i < count; ++i)
+        {
+            outputBuffer[i] = colorBuffer[i];
+        }
+
+        return true;
+    }
+
+    virtual void sampleRow(PDFReal x, PDFReal y, int count, PDFColorBuffer outputBuffer, size_t stride, bool* sampled, int limit) const override
+    {
+        const size_t colorComponentCount = m_pattern->getColorSpace() ? m_pattern->getColorSpace()->getColorComponentCount() : 0;
+        if (colorComponentCount == 0 || colorComponentCount > PDF_MAX_COLOR_COMPONENTS)
+        {
+            std::fill(sampled, sampled + count, false);
+            return;
+        }
+
+        std::vector<PDFReal> parameters;
+        std::vector<int> indices;
+        parameters.reserve(count);
+        indices.reserve(count);
+
+        // Mapped point depends linearly on the device x coordinate, so we step it incrementally
+        const QPointF mappedStartPoint = m_p1p2GCS.map(QPointF(x, y));
+        const QPointF mappedStep(m_p1p2GCS.m11(), m_p1p2GCS.m12());
+
+        for (int i = 0; i < count; ++i)
+        {
+            PDFReal t = 0.0;
+            sampled[i] = computeParameter(mappedStartPoint + i * mappedStep, t);
+
+            if (sampled[i])
+            {
+                parameters.push_back(t);
+                indices.push_back(i);
+            }
+        }
+
+        if (!m_radialShadingPattern->evaluateFunctions(parameters, indices, outputBuffer, stride))
+        {
+            // Functions can't be evaluated in batch, sample each point separately
+            PDFShadingSampler::sampleRow(x, y, count, outputBuffer, stride, sampled, limit);
+        }
+    }
+
+private:
+    /// Computes shading function parameter t for the point mapped to the coordinate
+    /// system, where shading axis is the x-axis. Returns false, if point is not
+    /// covered by the shading.
+    /// \param mappedPoint Mapped point
+    /// \param t Shading function parameter
+    bool computeParameter(const QPointF& mappedPoint, PDFReal& t) const
+    {
         // Well, how to proceed with sampling? We would like to find parameter s for point (x_p, y_p),
         // where (x_p, y_p) is mappedPoint. According to the formulas in the PDF 2.0 specification, we want
         // to find variable s:
@@ -1921,59 +2445,11 @@ public:
             return false;
         }
 
-        PDFReal t = interpolate(s, 0.0, 1.0, m_tAtStart, m_tAtEnd);
+        t = interpolate(s, 0.0, 1.0, m_tAtStart, m_tAtEnd);
         t = qBound(m_tMin, t, m_tMax);
-
-        const auto& functions = m_radialShadingPattern->getFunctions();
-        std::array<PDFReal, PDF_MAX_COLOR_COMPONENTS> colorBuffer = { };
-
-        if (colorBuffer.size() < outputBuffer.size())
-        {
-            // Jakub Melka: Too much colors - we cant process it
-            return false;
-        }
-
-        if (functions.size() == 1)
-        {
-            Q_ASSERT(outputBuffer.size() <= colorBuffer.size());
-            PDFFunction::FunctionResult result = functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + outputBuffer.size());
-
-            if (!result)
-            {
-                // Function call failed
-                return false;
-            }
-        }
-        else
-        {
-            if (functions.size() != outputBuffer.size())
-            {
-                // Invalid number of functions
-                return false;
-            }
-
-            Q_ASSERT(outputBuffer.size() <= colorBuffer.size());
-            for (size_t i = 0, count = outputBuffer.size(); i < count; ++i)
-            {
-                PDFFunction::FunctionResult result = functions[i]->apply(&t, &t + 1, colorBuffer.data() + i, colorBuffer.data() + i + 1);
-
-                if (!result)
-                {
-                    // Function call failed
-                    return false;
-                }
-            }
-        }
-
-        for (size_t i = 0, count = outputBuffer.size(); i < count; ++i)
-        {
-            outputBuffer[i] = colorBuffer[i];
-        }
-
         return true;
     }
 
-private:
     const PDFRadialShading* m_radialShadingPattern;
     QTransform m_p1p2GCS;
     PDFReal m_xStart;
@@ -1991,6 +2467,41 @@ PDFShadingSampler* PDFRadialShading::createSampler(QTransform userSpaceToDeviceS
     return new PDFRadialShadingSampler(this, userSpaceToDeviceSpaceMatrix);
 }
 
+QBrush PDFRadialShading::createGradientBrush(const QTransform& userSpaceToDeviceSpaceMatrix,
+                                             const PDFMeshQualitySettings& settings,
+                                             const PDFCMS* cms,
+                                             RenderingIntent intent,
+                                             PDFRenderErrorReporter* reporter) const
+{
+    // Only radial shadings, where starting circle is a point inside
+    // the ending circle, are painted using native gradient (focal point gradient).
+    // Paint engines do not support general two circle gradients consistently.
+    const QTransform patternSpaceToDeviceSpace = getPatternSpaceToDeviceSpaceMatrix(userSpaceToDeviceSpaceMatrix);
+    if (!isGradientBrushSupported() ||
+        !isZero(m_r0) ||
+        m_r1 <= 0.0 ||
+        QLineF(m_startPoint, m_endPoint).length() >= m_r1 ||
+        !patternSpaceToDeviceSpace.isInvertible())
+    {
+        return QBrush();
+    }
+
+    const PDFReal deviceLength = QLineF(patternSpaceToDeviceSpace.map(m_endPoint), patternSpaceToDeviceSpace.map(m_endPoint + QPointF(m_r1, 0.0))).length();
+    QGradientStops stops = createGradientStops(deviceLength, settings.gradientStopCount, cms, intent, reporter);
+    if (stops.isEmpty())
+    {
+        return QBrush();
+    }
+
+    QRadialGradient gradient(m_endPoint, m_r1, m_startPoint);
+    gradient.setSpread(QGradient::PadSpread);
+    gradient.setStops(stops);
+
+    QBrush brush(gradient);
+    brush.setTransform(patternSpaceToDeviceSpace);
+    return brush;
+}
+
 class PDFTriangleShadingSampler : public PDFShadingSampler
 {
 private:
@@ -2169,14 +2680,20 @@ bool PDFFreeFormGouradTriangleShading::processTriangles(InitializeFunction initi
 
     auto readVertex = [this, &vertices, &patternSpaceToDeviceSpaceMatrix, &meshVertices, bytesPerVertex, xScaleRatio, yScaleRatio, colorScaleRatio, convertColors](size_t index)
     {
-        PDFBitReader reader(&m_data, 8);
+        PDFBufferedBitReader reader(&m_data);
         reader.seek(index * bytesPerVertex);
 
+        std::array<PDFBufferedBitReader::Value, 2> coordinates = { };
+        std::array<PDFBufferedBitReader::Value, PDF_MAX_COLOR_COMPONENTS> components = { };
+
         VertexData data;
         data.index = static_cast<uint32_t>(index);
         data.flags = reader.read(m_bitsPerFlag);
-        const PDFReal x = m_xmin + (reader.read(m_bitsPerCoordinate)) * xScaleRatio;
-        const PDFReal y = m_ymin + (reader.read(m_bitsPerCoordinate)) * yScaleRatio;
+        reader.readArray(m_bitsPerCoordinate, coordinates.data(), coordinates.size());
+        reader.readArray(m_bitsPerComponent, components.data(), m_colorComponentCount);
+
+        const PDFReal x = m_xmin + coordinates[0] * xScaleRatio;
+        const PDFReal y = m_ymin + coordinates[1] * yScaleRatio;
         data.position = patternSpaceToDeviceSpaceMatrix.map(QPointF(x, y));
         data.color.resize(m_colorComponentCount);
         meshVertices[index] = data.position;
@@ -2185,7 +2702,7 @@ bool PDFFreeFormGouradTriangleShading::processTriangles(InitializeFunction initi
         {
             const double cMin = m_limits[2 * i + 0];
             const double cMax = m_limits[2 * i + 1];
-            data.color[i] = cMin + (reader.read(m_bitsPerComponent)) * (cMax - cMin) * colorScaleRatio;
+            data.color[i] = cMin + components[i] * (cMax - cMin) * colorScaleRatio;
         }
 
         if (convertColors)
@@ -2367,13 +2884,19 @@ bool PDFLatticeFormGouradTriangleShading::processTriangles(InitializeFunction in
 
     auto readVertex = [this, &vertices, &patternSpaceToDeviceSpaceMatrix, &meshVertices, bytesPerVertex, xScaleRatio, yScaleRatio, colorScaleRatio, convertColors](size_t index)
     {
-        PDFBitReader reader(&m_data, 8);
+        PDFBufferedBitReader reader(&m_data);
         reader.seek(index * bytesPerVertex);
 
+        std::array<PDFBufferedBitReader::Value, 2> coordinates = { };
+        std::array<PDFBufferedBitReader::Value, PDF_MAX_COLOR_COMPONENTS> components = { };
+
         VertexData data;
         data.index = static_cast<uint32_t>(index);
-        const PDFReal x = m_xmin + (reader.read(m_bitsPerCoordinate)) * xScaleRatio;
-        const PDFReal y = m_ymin + (reader.read(m_bitsPerCoordinate)) * yScaleRatio;
+        reader.readArray(m_bitsPerCoordinate, coordinates.data(), coordinates.size());
+        reader.readArray(m_bitsPerComponent, components.data(), m_colorComponentCount);
+
+        const PDFReal x = m_xmin + coordinates[0] * xScaleRatio;
+        const PDFReal y = m_ymin + coordinates[1] * yScaleRatio;
         data.position = patternSpaceToDeviceSpaceMatrix.map(QPointF(x, y));
         data.color.resize(m_colorComponentCount);
         meshVertices[index] = data.position;
@@ -2382,7 +2905,7 @@ bool PDFLatticeFormGouradTriangleShading::processTriangles(InitializeFunction in
         {
             const double cMin = m_limits[2 * i + 0];
             const double cMax = m_limits[2 * i + 1];
-            data.color[i] = cMin + (reader.read(m_bitsPerComponent)) * (cMax - cMin) * colorScaleRatio;
+            data.color[i] = cMin + components[i] * (cMax - cMin) * colorScaleRatio;
         }
 
         if (convertColors)
@@ -2608,7 +3131,13 @@ void PDFType4567Shading::addSubdividedTriangles(const PDFMeshQualitySettings& se
         triangle.v2 = v2;
         triangle.v3 = v3;
         triangle.color = transformedColor.rgb();
-        mesh.addTriangle(triangle);
+
+        // Colors of the vertices are used, when triangle is rasterized with
+        // interpolated colors (Gouraud shading).
+        const std::array<QRgb, 3> vertexColors = { m_colorSpace->getColor(c1, cms, intent, reporter, true).rgb(),
+                                                   m_colorSpace->getColor(c2, cms, intent, reporter, true).rgb(),
+                                                   m_colorSpace->getColor(c3, cms, intent, reporter, true).rgb() };
+        mesh.addGouraudTriangle(triangle, vertexColors);
     }
 }
 
@@ -2897,7 +3426,7 @@ PDFTensorPatches PDFTensorProductPatchShading::createPatches(QTransform userSpac
     PDFTensorPatches patches;
     patches.reserve(patchCountEstimate);
 
-    PDFBitReader reader(&m_data, 8);
+    PDFBufferedBitReader reader(&m_data);
 
     auto readFlags = [this, &reader]() -> uint8_t
     {
@@ -2906,13 +3435,19 @@ PDFTensorPatches PDFTensorProductPatchShading::createPatches(QTransform userSpac
 
     auto readPoint = [this, &reader, &patternSpaceToDeviceSpaceMatrix, xScaleRatio, yScaleRatio]() -> QPointF
     {
-        const PDFReal x = m_xmin + (reader.read(m_bitsPerCoordinate)) * xScaleRatio;
-        const PDFReal y = m_ymin + (reader.read(m_bitsPerCoordinate)) * yScaleRatio;
+        std::array<PDFBufferedBitReader::Value, 2> coordinates = { };
+        reader.readArray(m_bitsPerCoordinate, coordinates.data(), coordinates.size());
+
+        const PDFReal x = m_xmin + coordinates[0] * xScaleRatio;
+        const PDFReal y = m_ymin + coordinates[1] * yScaleRatio;
         return patternSpaceToDeviceSpaceMatrix.map(QPointF(x, y));
     };
 
     auto readColor = [this, &reader, colorScaleRatio, transformColor]() -> PDFColor
     {
+        std::array<PDFBufferedBitReader::Value, PDF_MAX_COLOR_COMPONENTS> components = { };
+        reader.readArray(m_bitsPerComponent, components.data(), m_colorComponentCount);
+
         PDFColor color;
         color.resize(m_colorComponentCount);
 
@@ -2920,7 +3455,7 @@ PDFTensorPatches PDFTensorProductPatchShading::createPatches(QTransform userSpac
         {
             const double cMin = m_limits[2 * i + 0];
             const double cMax = m_limits[2 * i + 1];
-            color[i] = cMin + (reader.read(m_bitsPerComponent)) * (cMax - cMin) * colorScaleRatio;
+            color[i] = cMin + components[i] * (cMax - cMin) * colorScaleRatio;
         }
 
         return transformColor ? getColor(color) : color;
@@ -3518,7 +4053,7 @@ PDFTensorPatches PDFCoonsPatchShading::createPatches(QTransform userSpaceToDevic
     PDFTensorPatches patches;
     patches.reserve(patchCountEstimate);
 
-    PDFBitReader reader(&m_data, 8);
+    PDFBufferedBitReader reader(&m_data);
 
     auto readFlags = [this, &reader]() -> uint8_t
     {
@@ -3527,13 +4062,19 @@ PDFTensorPatches PDFCoonsPatchShading::createPatches(QTransform userSpaceToDevic
 
     auto readPoint = [this, &reader, &patternSpaceToDeviceSpaceMatrix, xScaleRatio, yScaleRatio]() -> QPointF
     {
-        const PDFReal x = m_xmin + (reader.read(m_bitsPerCoordinate)) * xScaleRatio;
-        const PDFReal y = m_ymin + (reader.read(m_bitsPerCoordinate)) * yScaleRatio;
+        std::array<PDFBufferedBitReader::Value, 2> coordinates = { };
+        reader.readArray(m_bitsPerCoordinate, coordinates.data(), coordinates.size());
+
+        const PDFReal x = m_xmin + coordinates[0] * xScaleRatio;
+        const PDFReal y = m_ymin + coordinates[1] * yScaleRatio;
         return patternSpaceToDeviceSpaceMatrix.map(QPointF(x, y));
     };
 
     auto readColor = [this, &reader, colorScaleRatio, transformColor]() -> PDFColor
     {
+        std::array<PDFBufferedBitReader::Value, PDF_MAX_COLOR_COMPONENTS> components = { };
+        reader.readArray(m_bitsPerComponent, components.data(), m_colorComponentCount);
+
         PDFColor color;
         color.resize(m_colorComponentCount);
 
@@ -3541,7 +4082,7 @@ PDFTensorPatches PDFCoonsPatchShading::createPatches(QTransform userSpaceToDevic
         {
             const double cMin = m_limits[2 * i + 0];
             const double cMax = m_limits[2 * i + 1];
-            color[i] = cMin + (reader.read(m_bitsPerComponent)) * (cMax - cMin) * colorScaleRatio;
+            color[i] = cMin + components[i] * (cMax - cMin) * colorScaleRatio;
         }
 
         return transformColor ? getColor(color) : color;
@@ -3715,6 +4256,16 @@ PDFMesh PDFCoonsPatchShading::createMesh(const PDFMeshQualitySettings& settings,
     return mesh;
 }
 
+void PDFShadingSampler::sampleRow(PDFReal x, PDFReal y, int count, PDFColorBuffer outputBuffer, size_t stride, bool* sampled, int limit) const
+{
+    const size_t colorComponentCount = m_pattern->getColorSpace() ? m_pattern->getColorSpace()->getColorComponentCount() : 0;
+    for (int i = 0; i < count; ++i)
+    {
+        PDFColorBuffer buffer(outputBuffer.begin() + i * stride, colorComponentCount);
+        sampled[i] = sample(QPointF(x + i, y), buffer, limit);
+    }
+}
+
 bool PDFShadingSampler::fillBackgroundColor(PDFColorBuffer outputBuffer) const
 {
     const auto& originalBackgroundColor = m_pattern->getOriginalBackgroundColor();
@@ -24,9 +24,11 @@
 #include "pdfmeshqualitysettings.h"
 #include "pdfcolorconvertor.h"
 
+#include <QBrush>
 #include <QTransform>
 #include <QPainterPath>
 
+#include <array>
 #include <memory>
 
 namespace pdf
@@ -79,7 +81,15 @@ public:
     /// Adds triangle. Returns index of added triangle.
     /// \param triangle Triangle to be added
     /// \returns Index of the added vertex
-    inline uint32_t addTriangle(const Triangle& triangle) { const size_t index = m_triangles.size(); m_triangles.emplace_back(triangle); return static_cast<uint32_t>(index); }
+    inline uint32_t addTriangle(const Triangle& triangle) { const size_t index = m_triangles.size(); m_triangles.emplace_back(triangle); addFlatTriangleVertexColors(); return static_cast<uint32_t>(index); }
+
+    /// Adds triangle with colors of its vertices. Color of the triangle is interpolated
+    /// from the vertex colors (Gouraud shading), if mesh is painted by the rasterizer,
+    /// otherwise triangle is painted using its flat color. Returns index of added triangle.
+    /// \param triangle Triangle to be added
+    /// \param vertexColors Colors of the vertices v1, v2 and v3
+    /// \returns Index of the added triangle
+    uint32_t addGouraudTriangle(const Triangle& triangle, const std::array<QRgb, 3>& vertexColors);
 
     /// Adds quad. Vertices are in clockwise order (so, we have edges v1-v2, v2-v3, v3-v4, v4-v1).
     /// \param v1 First vertex (for example, topleft)
@@ -89,7 +99,9 @@ public:
     /// \param color Color of the quad.
     inline void addQuad(uint32_t v1, uint32_t v2, uint32_t v3, uint32_t v4, QRgb color) { addTriangle({v1, v2, v3, color}); addTriangle({ v1, v3, v4, color}); }
 
-    /// Paints the mesh on the painter
+    /// Paints the mesh on the painter. If painter paints on the raster device,
+    /// then triangles are rasterized directly into the image by the mesh
+    /// rasterizer, otherwise each triangle is painted by the painter.
     /// \param painter Painter, onto which is mesh drawn
     /// \param alpha Opacity factor
     void paint(QPainter* painter, PDFReal alpha) const;
@@ -113,7 +125,7 @@ public:
 
     /// Sets the triangle array to the mesh
     /// \param triangles New triangle array
-    void setTriangles(std::vector<Triangle>&& triangles) { m_triangles = qMove(triangles); }
+    void setTriangles(std::vector<Triangle>&& triangles) { m_triangles = qMove(triangles); m_triangleVertexColors.clear(); }
 
     /// Merges the vertices/triangles (renumbers triangle indices) to this mesh.
     /// Algorithm assumes that vertices/triangles are numbered from zero.
@@ -125,6 +137,20 @@ public:
     /// \param index Index of the vertex
     const QPointF& getVertex(size_t index) const { return m_vertices[index]; }
 
+    /// Returns vertex array
+    const std::vector<QPointF>& getVertices() const { return m_vertices; }
+
+    /// Returns triangle array
+    const std::vector<Triangle>& getTriangles() const { return m_triangles; }
+
+    /// Returns true, if some triangle has vertex colors (Gouraud shading)
+    bool hasVertexColors() const { return !m_triangleVertexColors.empty(); }
+
+    /// Returns colors of vertices of the triangle. If triangle doesn't
+    /// have vertex colors, its flat color is returned for all vertices.
+    /// \param index Index of the triangle
+    std::array<QRgb, 3> getTriangleVertexColors(size_t index) const;
+
     /// Returns triangle center. Triangles vertice indices must be valid.
     /// \param triangle Triangle
     QPointF getTriangleCenter(const Triangle& triangle) const;
@@ -134,23 +160,43 @@ public:
     /// \param path Background path
     void setBackgroundPath(QPainterPath path) { m_backgroundPath = qMove(path); }
 
+    /// Returns the background path
+    const QPainterPath& getBackgroundPath() const { return m_backgroundPath; }
+
     /// Sets the background color (background path is then painted with this color, if it is not
     /// empty), if color is invalid, it turns off background painting.
     /// \param backgroundColor Background color
     void setBackgroundColor(QColor backgroundColor) { m_backgroundColor = backgroundColor; }
 
+    /// Returns the background color (invalid, if background is not painted)
+    const QColor& getBackgroundColor() const { return m_backgroundColor; }
+
     /// Returns true, if mesh is empty
     bool isEmpty() const { return m_vertices.empty(); }
 
+    /// Returns bounding rectangle of the painted area of the mesh, including
+    /// the background. If mesh is empty, then empty rectangle is returned.
+    QRectF getBoundingRect() const;
+
     /// Returns estimate of number of bytes, which this mesh occupies in memory
     qint64 getMemoryConsumptionEstimate() const;
 
     /// Apply color conversion
     void convertColors(const PDFColorConvertor& colorConvertor);
 
+    friend QDataStream& operator<<(QDataStream& stream, const PDFMesh& mesh);
+    friend QDataStream& operator>>(QDataStream& stream, PDFMesh& mesh);
+
 private:
+    /// Adds vertex colors of the last added triangle (flat color), if mesh has vertex colors
+    inline void addFlatTriangleVertexColors() { if (!m_triangleVertexColors.empty()) { const QRgb color = m_triangles.back().color; m_triangleVertexColors.push_back({ color, color, color }); } }
+
     std::vector<QPointF> m_vertices;
     std::vector<Triangle> m_triangles;
+
+    /// Vertex colors of the triangles. It is either empty (all triangles
+    /// are flat), or it has the same size, as the triangle array.
+    std::vector<std::array<QRgb, 3>> m_triangleVertexColors;
     QPainterPath m_boundingPath;
     QPainterPath m_backgroundPath;
     QColor m_backgroundColor;
@@ -286,6 +332,19 @@ public:
     /// \param limit Maximal number of the steps of numerical calculation algorithms (for type 6/7 shading only)
     virtual bool sample(const QPointF& devicePoint, PDFColorBuffer outputBuffer, int limit) const = 0;
 
+    /// Computes colors of the row of points (x + i, y), where i = 0, ..., count - 1, in device
+    /// space coordinates. Color of i-th point is stored in the output buffer at offset i * stride,
+    /// and flag, whether color of i-th point was computed, is stored in \p sampled. Default
+    /// implementation samples each point separately.
+    /// \param x Horizontal coordinate of the first point in device space coordinates
+    /// \param y Vertical coordinate of the row in device space coordinates
+    /// \param count Number of points in the row
+    /// \param outputBuffer Color output buffer (must have space for \p count colors)
+    /// \param stride Offset between colors of two adjacent points in the output buffer
+    /// \param sampled Output flags, whether point was sampled (must have space for \p count items)
+    /// \param limit Maximal number of the steps of numerical calculation algorithms (for type 6/7 shading only)
+    virtual void sampleRow(PDFReal x, PDFReal y, int count, PDFColorBuffer outputBuffer, size_t stride, bool* sampled, int limit) const;
+
     /// Fill background color to the output buffer. If the background color is not filled,
     /// or is invalid, then false is returned, otherwise true is returned.
     bool fillBackgroundColor(PDFColorBuffer outputBuffer) const;
@@ -350,6 +409,24 @@ public:
     ///        (user space is target space of the shading) to the device space of the paint device.
     virtual PDFShadingSampler* createSampler(QTransform userSpaceToDeviceSpaceMatrix) const;
 
+    /// Creates native gradient brush (linear or radial gradient), which can be painted directly
+    /// by the paint engine instead of the mesh. Colors of the shading are precomputed into the
+    /// gradient stops (color lookup table), count of the stops is derived from the device size
+    /// of the shading. Gradient is defined in the pattern space, brush transform maps pattern space
+    /// to the device space. If shading can't be painted using native gradient, then brush
+    /// with no style is returned.
+    /// \param userSpaceToDeviceSpaceMatrix Matrix, which transforms user space points
+    ///        (user space is target space of the shading) to the device space of the paint device.
+    /// \param settings Mesh quality settings (maximal count of color stops is used)
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    virtual QBrush createGradientBrush(const QTransform& userSpaceToDeviceSpaceMatrix,
+                                       const PDFMeshQualitySettings& settings,
+                                       const PDFCMS* cms,
+                                       RenderingIntent intent,
+                                       PDFRenderErrorReporter* reporter) const;
+
 protected:
     friend class PDFPattern;
 
@@ -373,9 +450,40 @@ public:
     bool isExtendStart() const { return m_extendStart; }
     bool isExtendEnd() const { return m_extendEnd; }
 
+    /// Evaluates shading functions (either single function with n outputs, or n functions
+    /// with single output) for all parameters at once. Color for i-th parameter is stored
+    /// in the output buffer at offset indices[i] * stride. If functions can't be evaluated,
+    /// then false is returned.
+    /// \param parameters Function parameters
+    /// \param indices Indices of the output colors
+    /// \param outputBuffer Color output buffer
+    /// \param stride Offset between colors of two adjacent points in the output buffer
+    bool evaluateFunctions(const std::vector<PDFReal>& parameters,
+                           const std::vector<int>& indices,
+                           PDFColorBuffer outputBuffer,
+                           size_t stride) const;
+
 protected:
     friend class PDFPattern;
 
+    /// Returns true, if shading can be painted using native gradient, i.e.
+    /// shading is extended at both ends and has no background color.
+    bool isGradientBrushSupported() const;
+
+    /// Creates gradient stops (color lookup table) of the shading. Stops are uniformly
+    /// distributed over the shading domain. If colors can't be computed, then
+    /// empty list is returned.
+    /// \param deviceLength Length of the gradient in device space
+    /// \param maximalStopCount Maximal count of color stops
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    QGradientStops createGradientStops(PDFReal deviceLength,
+                                       PDFInteger maximalStopCount,
+                                       const PDFCMS* cms,
+                                       RenderingIntent intent,
+                                       PDFRenderErrorReporter* reporter) const;
+
     std::vector<PDFFunctionPtr> m_functions;
     QPointF m_startPoint;
     QPointF m_endPoint;
@@ -422,6 +530,11 @@ public:
                                PDFRenderErrorReporter* reporter,
                                const PDFOperationControl* operationControl) const override;
     virtual PDFShadingSampler* createSampler(QTransform userSpaceToDeviceSpaceMatrix) const override;
+    virtual QBrush createGradientBrush(const QTransform& userSpaceToDeviceSpaceMatrix,
+                                       const PDFMeshQualitySettings& settings,
+                                       const PDFCMS* cms,
+                                       RenderingIntent intent,
+                                       PDFRenderErrorReporter* reporter) const override;
 
 private:
     friend class PDFPattern;
@@ -439,6 +552,11 @@ public:
                                PDFRenderErrorReporter* reporter,
                                const PDFOperationControl* operationControl) const override;
     virtual PDFShadingSampler* createSampler(QTransform userSpaceToDeviceSpaceMatrix) const override;
+    virtual QBrush createGradientBrush(const QTransform& userSpaceToDeviceSpaceMatrix,
+                                       const PDFMeshQualitySettings& settings,
+                                       const PDFCMS* cms,
+                                       RenderingIntent intent,
+                                       PDFRenderErrorReporter* reporter) const override;
 
     PDFReal getR0() const { return m_r0; }
     PDFReal getR1() const { return m_r1; }
@@ -458,6 +576,10 @@ public:
     /// Returns color for given color or function parameter
     PDFColor getColor(PDFColor colorOrFunctionParameter) const;
 
+    /// Returns reference to the shading stream. Reference is invalid,
+    /// if shading was not created from the indirect object.
+    PDFObjectReference getShadingReference() const { return m_shadingReference; }
+
 protected:
     friend class PDFPattern;
 
@@ -489,6 +611,9 @@ protected:
 
     /// Data of the shading, containing triangles and colors
     QByteArray m_data;
+
+    /// Reference to the shading stream
+    PDFObjectReference m_shadingReference;
 };
 
 class PDFFreeFormGouradTriangleShading : public PDFType4567Shading
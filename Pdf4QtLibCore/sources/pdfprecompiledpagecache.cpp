@@ -0,0 +1,336 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfprecompiledpagecache.h"
+#include "pdfpainter.h"
+#include "pdfdocument.h"
+#include "pdfcms.h"
+#include "pdfoptionalcontent.h"
+#include "pdfmeshqualitysettings.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+static constexpr const char* PRECOMPILED_PAGE_CACHE_MAGIC = "PDF4QTPC";
+static constexpr const char* PRECOMPILED_PAGE_CACHE_SUFFIX = "pdfpage";
+
+PDFPrecompiledPageCache::PDFPrecompiledPageCache(QString directory, qint64 sizeLimit) :
+    m_directory(std::move(directory)),
+    m_sizeLimit(sizeLimit),
+    m_size(0)
+{
+    QDir().mkpath(m_directory);
+
+    qint64 size = 0;
+    const QFileInfoList fileInfos = QDir(m_directory).entryInfoList({ QString("*.%1").arg(PRECOMPILED_PAGE_CACHE_SUFFIX) }, QDir::Files);
+    for (const QFileInfo& fileInfo : fileInfos)
+    {
+        size += fileInfo.size();
+    }
+    m_size = size;
+
+    if (m_size > m_sizeLimit)
+    {
+        prune();
+    }
+}
+
+QString PDFPrecompiledPageCache::getDefaultDirectory()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("precompiledpages");
+}
+
+QByteArray PDFPrecompiledPageCache::createRendererKey(const PDFDocument* document,
+                                                      PDFRenderer::Features features,
+                                                      const PDFCMSSettings& cmsSettings,
+                                                      const PDFMeshQualitySettings& meshQualitySettings,
+                                                      const PDFOptionalContentActivity* optionalContentActivity)
+{
+    if (!document || document->getSourceDataHash().isEmpty())
+    {
+        // Document has no source data, so we can't identify it
+        return QByteArray();
+    }
+
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+
+        stream << VERSION;
+        stream << qint32(features);
+
+        stream << qint32(cmsSettings.system);
+        stream << qint32(cmsSettings.accuracy);
+        stream << qint32(cmsSettings.intent);
+        stream << qint32(cmsSettings.proofingIntent);
+        stream << qint32(cmsSettings.colorAdaptationXYZ);
+        stream << cmsSettings.isBlackPointCompensationActive;
+        stream << cmsSettings.isWhitePaperColorTransformed;
+        stream << cmsSettings.isGamutChecking;
+        stream << cmsSettings.isSoftProofing;
+        stream << cmsSettings.isConsiderOutputIntent;
+        stream << cmsSettings.outOfGamutColor;
+        stream << cmsSettings.outputCS;
+        stream << cmsSettings.deviceGray;
+        stream << cmsSettings.deviceRGB;
+        stream << cmsSettings.deviceCMYK;
+        stream << cmsSettings.softProofingProfile;
+        stream << cmsSettings.profileDirectory;
+        stream << cmsSettings.transformCacheDirectory;
+        stream << cmsSettings.foregroundColor;
+        stream << cmsSettings.backgroundColor;
+        stream << cmsSettings.bitonalThreshold;
+        stream << cmsSettings.sigmoidSlopeFactor;
+
+        stream << meshQualitySettings.minimalMeshResolutionRatio;
+        stream << meshQualitySettings.preferredMeshResolutionRatio;
+        stream << meshQualitySettings.userSpaceToDeviceSpaceMatrix;
+        stream << meshQualitySettings.deviceSpaceMeshingArea;
+        stream << meshQualitySettings.preferredMeshResolution;
+        stream << meshQualitySettings.minimalMeshResolution;
+        stream << meshQualitySettings.tolerance;
+        stream << meshQualitySettings.patchTestPoints;
+        stream << meshQualitySettings.patchResolutionMappingRatioLow;
+        stream << meshQualitySettings.patchResolutionMappingRatioHigh;
+        stream << meshQualitySettings.gradientStopCount;
+
+        // Page content depends on the state of optional content groups
+        const PDFOptionalContentProperties* properties = document->getCatalog()->getOptionalContentProperties();
+        if (!features.testFlag(PDFRenderer::IgnoreOptionalContent) && properties->isValid())
+        {
+            if (!optionalContentActivity)
+            {
+                return QByteArray();
+            }
+
+            for (const PDFObjectReference& reference : properties->getAllOptionalContentGroups())
+            {
+                stream << reference.objectNumber << reference.generation << qint32(optionalContentActivity->getState(reference));
+            }
+        }
+    }
+
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+bool PDFPrecompiledPageCache::load(const PDFDocument* document, const QByteArray& rendererKey, PDFInteger pageIndex, PDFPrecompiledPage* precompiledPage) const
+{
+    Q_ASSERT(precompiledPage);
+
+    if (!document || rendererKey.isEmpty())
+    {
+        return false;
+    }
+
+    const QByteArray& documentHash = document->getSourceDataHash();
+    const QString fileName = getFileName(documentHash, rendererKey, pageIndex);
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    QByteArray magic(8, Qt::Uninitialized);
+    qint32 version = 0;
+    QByteArray storedDocumentHash;
+    QByteArray storedRendererKey;
+    qint64 storedPageIndex = -1;
+    QByteArray payload;
+    QByteArray payloadHash;
+
+    if (stream.readRawData(magic.data(), magic.size()) != magic.size() || magic != PRECOMPILED_PAGE_CACHE_MAGIC)
+    {
+        return false;
+    }
+
+    stream >> version;
+    if (version != VERSION)
+    {
+        return false;
+    }
+
+    stream >> storedDocumentHash;
+    stream >> storedRendererKey;
+    stream >> storedPageIndex;
+    stream >> payload;
+    stream >> payloadHash;
+
+    if (stream.status() != QDataStream::Ok ||
+        storedDocumentHash != documentHash ||
+        storedRendererKey != rendererKey ||
+        storedPageIndex != pageIndex ||
+        QCryptographicHash::hash(payload, QCryptographicHash::Sha1) != payloadHash)
+    {
+        return false;
+    }
+
+    file.close();
+
+    PDFPrecompiledPage page;
+    QDataStream payloadStream(payload);
+    payloadStream.setVersion(QDataStream::Qt_6_0);
+    payloadStream >> page;
+
+    if (payloadStream.status() != QDataStream::Ok || !page.isValid())
+    {
+        return false;
+    }
+
+    // Mark file as recently used, so it is not removed by the pruning
+    if (file.open(QFile::ReadWrite))
+    {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        file.close();
+    }
+
+    *precompiledPage = std::move(page);
+    return true;
+}
+
+void PDFPrecompiledPageCache::store(const PDFDocument* document, const QByteArray& rendererKey, PDFInteger pageIndex, const PDFPrecompiledPage& precompiledPage)
+{
+    if (!document || rendererKey.isEmpty() || !precompiledPage.isValid())
+    {
+        return;
+    }
+
+    const QByteArray& documentHash = document->getSourceDataHash();
+
+    QByteArray payload;
+    {
+        QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+        payloadStream.setVersion(QDataStream::Qt_6_0);
+        payloadStream << precompiledPage;
+    }
+
+    if (payload.size() > m_sizeLimit)
+    {
+        // Page is too big to be stored in the cache
+        return;
+    }
+
+    const QString fileName = getFileName(documentHash, rendererKey, pageIndex);
+    const qint64 oldSize = QFileInfo(fileName).size();
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly))
+    {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.writeRawData(PRECOMPILED_PAGE_CACHE_MAGIC, 8);
+    stream << VERSION;
+    stream << documentHash;
+    stream << rendererKey;
+    stream << qint64(pageIndex);
+    stream << payload;
+    stream << QCryptographicHash::hash(payload, QCryptographicHash::Sha1);
+
+    const qint64 newSize = file.size();
+    if (stream.status() != QDataStream::Ok || !file.commit())
+    {
+        return;
+    }
+
+    m_size += newSize - oldSize;
+    if (m_size > m_sizeLimit)
+    {
+        prune();
+    }
+}
+
+void PDFPrecompiledPageCache::clear()
+{
+    QMutexLocker lock(&m_pruneMutex);
+
+    QDir directory(m_directory);
+    const QStringList fileNames = directory.entryList({ QString("*.%1").arg(PRECOMPILED_PAGE_CACHE_SUFFIX) }, QDir::Files);
+    for (const QString& fileName : fileNames)
+    {
+        directory.remove(fileName);
+    }
+
+    m_size = 0;
+}
+
+QString PDFPrecompiledPageCache::getFileName(const QByteArray& documentHash, const QByteArray& rendererKey, PDFInteger pageIndex) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(documentHash);
+    hash.addData(rendererKey);
+    const QString baseName = QString::fromLatin1(hash.result().toHex());
+    return QDir(m_directory).filePath(QString("%1_%2.%3").arg(baseName).arg(pageIndex).arg(PRECOMPILED_PAGE_CACHE_SUFFIX));
+}
+
+void PDFPrecompiledPageCache::prune()
+{
+    QMutexLocker lock(&m_pruneMutex);
+
+    QDir directory(m_directory);
+    QFileInfoList fileInfos = directory.entryInfoList({ QString("*.%1").arg(PRECOMPILED_PAGE_CACHE_SUFFIX) }, QDir::Files);
+
+    qint64 size = 0;
+    for (const QFileInfo& fileInfo : fileInfos)
+    {
+        size += fileInfo.size();
+    }
+
+    if (size > m_sizeLimit)
+    {
+        // Remove least recently used files first. We prune the cache
+        // to 3/4 of the limit, so pruning is not performed too often.
+        std::sort(fileInfos.begin(), fileInfos.end(), [](const QFileInfo& l, const QFileInfo& r) { return l.lastModified() < r.lastModified(); });
+
+        const qint64 targetSize = m_sizeLimit / 4 * 3;
+        for (const QFileInfo& fileInfo : fileInfos)
+        {
+            if (size <= targetSize)
+            {
+                break;
+            }
+
+            if (directory.remove(fileInfo.fileName()))
+            {
+                size -= fileInfo.size();
+            }
+        }
+    }
+
+    m_size = size;
+}
+
+}   // namespace pdf
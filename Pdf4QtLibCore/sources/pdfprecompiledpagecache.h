@@ -0,0 +1,121 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFPRECOMPILEDPAGECACHE_H
+#define PDFPRECOMPILEDPAGECACHE_H
+
+#include "pdfglobal.h"
+#include "pdfrenderer.h"
+
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+
+#include <atomic>
+
+namespace pdf
+{
+class PDFDocument;
+class PDFPrecompiledPage;
+class PDFOptionalContentActivity;
+struct PDFCMSSettings;
+struct PDFMeshQualitySettings;
+
+/// Persistent (on-disk) cache of precompiled pages. Each page is stored in its
+/// own file, identified by the document hash, renderer key (describing all settings,
+/// which affect the page compilation) and page index. Files also contain version
+/// tag of the format, files with different version are ignored. Cache is thread safe.
+/// Size of the cache directory is limited, least recently used files are removed
+/// first, when limit is exceeded.
+class PDF4QTLIBCORESHARED_EXPORT PDFPrecompiledPageCache
+{
+public:
+    /// Version of the cache file format. Increase this number, whenever
+    /// serialization format of precompiled page is changed.
+    static constexpr const qint32 VERSION = 5;
+
+    /// Default size limit of the cache directory (in bytes)
+    static constexpr const qint64 DEFAULT_SIZE_LIMIT = 512 * 1024 * 1024;
+
+    /// Creates cache in given directory. Directory is created, if it doesn't exist.
+    /// \param directory Cache directory
+    /// \param sizeLimit Size limit of the cache directory [bytes]
+    explicit PDFPrecompiledPageCache(QString directory, qint64 sizeLimit = DEFAULT_SIZE_LIMIT);
+
+    PDFPrecompiledPageCache(const PDFPrecompiledPageCache&) = delete;
+    PDFPrecompiledPageCache& operator=(const PDFPrecompiledPageCache&) = delete;
+
+    /// Returns default cache directory (in the user's cache location)
+    static QString getDefaultDirectory();
+
+    /// Creates renderer key, which identifies settings used to compile the page.
+    /// Pages compiled with different settings have different keys. If the page
+    /// can't be cached (for example, optional content is used without activity),
+    /// then empty key is returned.
+    /// \param document Document
+    /// \param features Renderer features
+    /// \param cmsSettings Color management system settings
+    /// \param meshQualitySettings Mesh quality settings
+    /// \param optionalContentActivity Optional content activity (can be nullptr)
+    static QByteArray createRendererKey(const PDFDocument* document,
+                                        PDFRenderer::Features features,
+                                        const PDFCMSSettings& cmsSettings,
+                                        const PDFMeshQualitySettings& meshQualitySettings,
+                                        const PDFOptionalContentActivity* optionalContentActivity);
+
+    /// Tries to load precompiled page from the cache. If page is not
+    /// found or it can't be read, false is returned.
+    /// \param document Document (source data hash is used as a document key)
+    /// \param rendererKey Renderer key
+    /// \param pageIndex Page index
+    /// \param[out] precompiledPage Loaded precompiled page
+    bool load(const PDFDocument* document, const QByteArray& rendererKey, PDFInteger pageIndex, PDFPrecompiledPage* precompiledPage) const;
+
+    /// Stores precompiled page into the cache. Invalid pages
+    /// (for example, pages with no instructions) are not stored.
+    /// \param document Document (source data hash is used as a document key)
+    /// \param rendererKey Renderer key
+    /// \param pageIndex Page index
+    /// \param precompiledPage Precompiled page
+    void store(const PDFDocument* document, const QByteArray& rendererKey, PDFInteger pageIndex, const PDFPrecompiledPage& precompiledPage);
+
+    /// Removes all files from the cache
+    void clear();
+
+    /// Returns cache directory
+    const QString& getDirectory() const { return m_directory; }
+
+    /// Returns size limit of the cache directory [bytes]
+    qint64 getSizeLimit() const { return m_sizeLimit; }
+
+private:
+    /// Returns file name of the cached page
+    QString getFileName(const QByteArray& documentHash, const QByteArray& rendererKey, PDFInteger pageIndex) const;
+
+    /// Removes least recently used files, until size of the cache is below the limit
+    void prune();
+
+    QString m_directory;
+    qint64 m_sizeLimit;
+    std::atomic<qint64> m_size;
+    QMutex m_pruneMutex;
+};
+
+}   // namespace pdf
+
+#endif // PDFPRECOMPILEDPAGECACHE_H
@@ -0,0 +1,597 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfpresentation.h"
+#include "pdfdocument.h"
+#include "pdfpainter.h"
+#include "pdfcms.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QPainter>
+#include <QRegion>
+#include <QtMath>
+#include <QtConcurrent/QtConcurrent>
+
+#include "pdfdbgheap.h"
+
+#include <random>
+#include <algorithm>
+
+namespace pdf
+{
+
+PDFPresentationFrameCache::PDFPresentationFrameCache(const PDFDocument* document,
+                                                     const PDFFontCache* fontCache,
+                                                     const PDFCMSManager* cmsManager,
+                                                     const PDFOptionalContentActivity* optionalContentActivity,
+                                                     PDFRenderer::Features features,
+                                                     PDFMeshQualitySettings meshQualitySettings,
+                                                     QObject* parent) :
+    BaseClass(parent),
+    m_document(document),
+    m_fontCache(fontCache),
+    m_cmsManager(cmsManager),
+    m_optionalContentActivity(optionalContentActivity),
+    m_features(features),
+    m_meshQualitySettings(qMove(meshQualitySettings))
+{
+    Q_ASSERT(document);
+    Q_ASSERT(cmsManager);
+
+    m_threadPool.setMaxThreadCount(qMax(PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Page), 1));
+}
+
+PDFPresentationFrameCache::~PDFPresentationFrameCache()
+{
+    waitForRendering();
+}
+
+void PDFPresentationFrameCache::setFrameSize(QSize frameSize)
+{
+    PDFInteger currentPageIndex = -1;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_frameSize == frameSize)
+        {
+            return;
+        }
+
+        // Renderings of the old size are discarded, when they are finished
+        m_frameSize = frameSize;
+        m_frames.clear();
+        m_renderings.clear();
+        currentPageIndex = m_currentPageIndex;
+    }
+
+    if (currentPageIndex >= 0)
+    {
+        setCurrentPage(currentPageIndex);
+    }
+}
+
+void PDFPresentationFrameCache::setCurrentPage(PDFInteger pageIndex)
+{
+    QMutexLocker lock(&m_mutex);
+    m_currentPageIndex = pageIndex;
+
+    const std::vector<PDFInteger> prefetchedPages = getPrefetchedPages(pageIndex);
+    auto isPrefetched = [&prefetchedPages](PDFInteger index) { return std::find(prefetchedPages.cbegin(), prefetchedPages.cend(), index) != prefetchedPages.cend(); };
+
+    // Remove frames of the slides far from the current slide
+    for (auto it = m_frames.begin(); it != m_frames.end();)
+    {
+        if (!isPrefetched(it->first))
+        {
+            it = m_frames.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (auto it = m_renderings.begin(); it != m_renderings.end();)
+    {
+        if (it->second.isFinished())
+        {
+            it = m_renderings.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (m_frameSize.isEmpty())
+    {
+        return;
+    }
+
+    // Render neighbouring slides in the background. Tasks are started in the
+    // order of the prefetched pages, so next slide is rendered first.
+    for (const PDFInteger prefetchedPageIndex : prefetchedPages)
+    {
+        if (m_frames.count(prefetchedPageIndex) || m_renderings.count(prefetchedPageIndex))
+        {
+            continue;
+        }
+
+        const QSize frameSize = m_frameSize;
+        auto renderPrefetchedFrame = [this, prefetchedPageIndex, frameSize]()
+        {
+            auto isFrameNeeded = [this, prefetchedPageIndex, frameSize]()
+            {
+                const std::vector<PDFInteger> pages = getPrefetchedPages(m_currentPageIndex);
+                return m_frameSize == frameSize && std::find(pages.cbegin(), pages.cend(), prefetchedPageIndex) != pages.cend();
+            };
+
+            {
+                // Slide can be far from the current slide, before rendering is started
+                QMutexLocker lock(&m_mutex);
+                if (!isFrameNeeded())
+                {
+                    return;
+                }
+            }
+
+            QImage frame = renderFrame(prefetchedPageIndex, frameSize);
+
+            {
+                QMutexLocker lock(&m_mutex);
+                if (!isFrameNeeded())
+                {
+                    return;
+                }
+                m_frames[prefetchedPageIndex] = qMove(frame);
+            }
+
+            Q_EMIT frameRendered(prefetchedPageIndex);
+        };
+
+        m_renderings[prefetchedPageIndex] = QtConcurrent::run(&m_threadPool, renderPrefetchedFrame);
+    }
+}
+
+QImage PDFPresentationFrameCache::getFrame(PDFInteger pageIndex)
+{
+    QFuture<void> rendering;
+    QSize frameSize;
+
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto it = m_frames.find(pageIndex);
+        if (it != m_frames.cend())
+        {
+            return it->second;
+        }
+
+        auto renderingIt = m_renderings.find(pageIndex);
+        if (renderingIt != m_renderings.cend())
+        {
+            rendering = renderingIt->second;
+        }
+
+        frameSize = m_frameSize;
+    }
+
+    if (rendering.isValid())
+    {
+        rendering.waitForFinished();
+
+        QMutexLocker lock(&m_mutex);
+        auto it = m_frames.find(pageIndex);
+        if (it != m_frames.cend())
+        {
+            return it->second;
+        }
+    }
+
+    // Frame is not prefetched, we must render it now
+    QImage frame = renderFrame(pageIndex, frameSize);
+
+    QMutexLocker lock(&m_mutex);
+    const std::vector<PDFInteger> prefetchedPages = getPrefetchedPages(m_currentPageIndex);
+    if (m_frameSize == frameSize && std::find(prefetchedPages.cbegin(), prefetchedPages.cend(), pageIndex) != prefetchedPages.cend())
+    {
+        m_frames[pageIndex] = frame;
+    }
+
+    return frame;
+}
+
+bool PDFPresentationFrameCache::hasFrame(PDFInteger pageIndex) const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_frames.count(pageIndex);
+}
+
+PDFReal PDFPresentationFrameCache::getAutoAdvanceDuration(PDFInteger pageIndex) const
+{
+    if (const PDFPage* page = m_document->getCatalog()->getPage(pageIndex))
+    {
+        return qMax(PDFReal(page->getDuration()), 0.0);
+    }
+
+    return 0.0;
+}
+
+std::vector<PDFInteger> PDFPresentationFrameCache::getPrefetchedPages(PDFInteger pageIndex) const
+{
+    std::vector<PDFInteger> pages;
+
+    const PDFInteger pageCount = PDFInteger(m_document->getCatalog()->getPageCount());
+    if (pageIndex < 0 || pageIndex >= pageCount)
+    {
+        return pages;
+    }
+
+    pages.push_back(pageIndex);
+
+    // If slides are advanced automatically, user will probably not go
+    // back, so render the slides ahead first.
+    PDFInteger lastPageIndex = pageIndex + 1;
+    if (getAutoAdvanceDuration(pageIndex) > 0.0)
+    {
+        lastPageIndex = pageIndex + AUTO_ADVANCE_LOOK_AHEAD;
+    }
+
+    for (PDFInteger nextPageIndex = pageIndex + 1; nextPageIndex <= lastPageIndex && nextPageIndex < pageCount; ++nextPageIndex)
+    {
+        pages.push_back(nextPageIndex);
+    }
+
+    if (pageIndex > 0)
+    {
+        pages.push_back(pageIndex - 1);
+    }
+
+    return pages;
+}
+
+QImage PDFPresentationFrameCache::renderFrame(PDFInteger pageIndex, QSize frameSize) const
+{
+    if (frameSize.isEmpty())
+    {
+        return QImage();
+    }
+
+    QImage frame(frameSize, QImage::Format_ARGB32_Premultiplied);
+    frame.fill(Qt::black);
+
+    const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        return frame;
+    }
+
+    // Slide is centered on the screen
+    const QRectF frameRect(QPointF(0, 0), QSizeF(frameSize));
+    QRectF pageRect(QPointF(0, 0), page->getRotatedMediaBox().size().scaled(frameRect.size(), Qt::KeepAspectRatio));
+    pageRect.moveCenter(frameRect.center());
+
+    PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
+    PDFPrecompiledPage compiledPage;
+    PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
+    renderer.compile(&compiledPage, pageIndex);
+
+    QPainter painter(&frame);
+    painter.fillRect(pageRect, Qt::white);
+    compiledPage.draw(&painter, page->getCropBox(), PDFRenderer::createPagePointToDevicePointMatrix(page, pageRect), m_features, 1.0);
+    painter.end();
+
+    return frame;
+}
+
+void PDFPresentationFrameCache::waitForRendering()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_currentPageIndex = -1;
+        m_renderings.clear();
+    }
+
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+PDFPageTransitionComposer::PDFPageTransitionComposer(const PDFPageTransition& transition, QImage oldFrame, QImage newFrame) :
+    m_transition(transition),
+    m_oldFrame(qMove(oldFrame)),
+    m_newFrame(qMove(newFrame))
+{
+    const PDFPageTransition::Style style = m_transition.getStyle();
+    if (style != PDFPageTransition::Style::Dissolve && style != PDFPageTransition::Style::Glitter)
+    {
+        return;
+    }
+
+    // Thresholds of the blocks are computed only once, so each frame
+    // is composed only by drawing visible blocks of the new slide.
+    m_blockColumns = qMax((m_newFrame.width() + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+    m_blockRows = qMax((m_newFrame.height() + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+    m_blockThresholds.resize(m_blockColumns * m_blockRows, 0.0);
+
+    std::minstd_rand generator(m_blockColumns * m_blockRows);
+    std::uniform_real_distribution<PDFReal> distribution(0.0, 1.0);
+
+    const QPointF motion = getMotionVector();
+    const PDFReal minPosition = qMin(motion.x(), 0.0) + qMin(motion.y(), 0.0);
+    const PDFReal maxPosition = qMax(motion.x(), 0.0) + qMax(motion.y(), 0.0);
+
+    for (int row = 0; row < m_blockRows; ++row)
+    {
+        for (int column = 0; column < m_blockColumns; ++column)
+        {
+            PDFReal threshold = distribution(generator);
+
+            if (style == PDFPageTransition::Style::Glitter && !qFuzzyCompare(minPosition, maxPosition))
+            {
+                // Glitter - blocks are revealed gradually in the direction of the transition
+                const PDFReal u = (column + 0.5) / m_blockColumns;
+                const PDFReal v = (row + 0.5) / m_blockRows;
+                const PDFReal position = (motion.x() * u + motion.y() * v - minPosition) / (maxPosition - minPosition);
+                threshold = 0.75 * position + 0.25 * threshold;
+            }
+
+            m_blockThresholds[row * m_blockColumns + column] = threshold;
+        }
+    }
+}
+
+void PDFPageTransitionComposer::drawFrame(QPainter* painter, const QRect& rect, PDFReal progress) const
+{
+    progress = qBound(0.0, progress, 1.0);
+
+    const QPointF motion = getMotionVector();
+    const QPointF offset(motion.x() * rect.width(), motion.y() * rect.height());
+
+    painter->save();
+
+    switch (m_transition.getStyle())
+    {
+        case PDFPageTransition::Style::R:
+        {
+            painter->drawImage(rect, progress > 0.0 ? m_newFrame : m_oldFrame);
+            break;
+        }
+
+        case PDFPageTransition::Style::Fade:
+        {
+            painter->drawImage(rect, m_oldFrame);
+            painter->setOpacity(progress);
+            painter->drawImage(rect, m_newFrame);
+            break;
+        }
+
+        case PDFPageTransition::Style::Push:
+        {
+            painter->drawImage(rect.translated((offset * progress).toPoint()), m_oldFrame);
+            painter->drawImage(rect.translated((offset * (progress - 1.0)).toPoint()), m_newFrame);
+            break;
+        }
+
+        case PDFPageTransition::Style::Cover:
+        {
+            painter->drawImage(rect, m_oldFrame);
+            painter->drawImage(rect.translated((offset * (progress - 1.0)).toPoint()), m_newFrame);
+            break;
+        }
+
+        case PDFPageTransition::Style::Uncover:
+        {
+            painter->drawImage(rect, m_newFrame);
+            painter->drawImage(rect.translated((offset * progress).toPoint()), m_oldFrame);
+            break;
+        }
+
+        case PDFPageTransition::Style::Fly:
+        {
+            // Inward - new slide flies in, outward - old slide flies out
+            const bool isInward = m_transition.getDirection() == PDFPageTransition::Direction::Inward;
+            const QImage& background = isInward ? m_oldFrame : m_newFrame;
+            const QImage& foreground = isInward ? m_newFrame : m_oldFrame;
+            const PDFReal position = isInward ? progress : 1.0 - progress;
+            const PDFReal scale = m_transition.getScale() + (1.0 - m_transition.getScale()) * position;
+
+            QRectF targetRect(QPointF(0, 0), QSizeF(rect.size()) * scale);
+            targetRect.moveCenter(QRectF(rect).center() + offset * (position - 1.0));
+
+            painter->drawImage(rect, background);
+            painter->drawImage(targetRect, foreground);
+            break;
+        }
+
+        case PDFPageTransition::Style::Dissolve:
+        case PDFPageTransition::Style::Glitter:
+        {
+            painter->drawImage(rect, m_oldFrame);
+
+            const PDFReal scaleX = PDFReal(rect.width()) / qMax(m_newFrame.width(), 1);
+            const PDFReal scaleY = PDFReal(rect.height()) / qMax(m_newFrame.height(), 1);
+
+            for (int row = 0; row < m_blockRows; ++row)
+            {
+                for (int column = 0; column < m_blockColumns; ++column)
+                {
+                    if (m_blockThresholds[row * m_blockColumns + column] >= progress)
+                    {
+                        continue;
+                    }
+
+                    const QRect sourceRect = QRect(column * BLOCK_SIZE, row * BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE).intersected(m_newFrame.rect());
+                    const QRectF targetRect(rect.left() + sourceRect.left() * scaleX, rect.top() + sourceRect.top() * scaleY, sourceRect.width() * scaleX, sourceRect.height() * scaleY);
+                    painter->drawImage(targetRect, m_newFrame, sourceRect);
+                }
+            }
+            break;
+        }
+
+        default:
+        {
+            painter->drawImage(rect, m_oldFrame);
+            painter->setClipRegion(getNewFrameRegion(rect, progress));
+            painter->drawImage(rect, m_newFrame);
+            break;
+        }
+    }
+
+    painter->restore();
+}
+
+QPointF PDFPageTransitionComposer::getMotionVector() const
+{
+    // Angle is measured counterclockwise, zero means from left to right,
+    // and y axis of the device is pointing down.
+    const PDFReal angle = qDegreesToRadians(m_transition.getAngle());
+    PDFReal x = qCos(angle);
+    PDFReal y = -qSin(angle);
+
+    if (qAbs(x) < 1e-6)
+    {
+        x = 0.0;
+    }
+    if (qAbs(y) < 1e-6)
+    {
+        y = 0.0;
+    }
+
+    return QPointF(x, y);
+}
+
+QRegion PDFPageTransitionComposer::getNewFrameRegion(const QRect& rect, PDFReal progress) const
+{
+    const bool isHorizontal = m_transition.getOrientation() == PDFPageTransition::Orientation::Horizontal;
+    const bool isInward = m_transition.getDirection() == PDFPageTransition::Direction::Inward;
+
+    switch (m_transition.getStyle())
+    {
+        case PDFPageTransition::Style::Split:
+        {
+            // Two lines sweep across the screen, inward from the edges, or outward from the center
+            const int size = isHorizontal ? rect.height() : rect.width();
+            const int revealed = qRound(size * progress);
+
+            QRect first = rect;
+            QRect second = rect;
+
+            if (isInward)
+            {
+                const int halfRevealed = revealed / 2;
+                if (isHorizontal)
+                {
+                    first.setBottom(rect.top() + halfRevealed);
+                    second.setTop(rect.bottom() - halfRevealed);
+                }
+                else
+                {
+                    first.setRight(rect.left() + halfRevealed);
+                    second.setLeft(rect.right() - halfRevealed);
+                }
+
+                return QRegion(first).united(QRegion(second));
+            }
+
+            if (isHorizontal)
+            {
+                first.setHeight(revealed);
+                first.moveCenter(rect.center());
+            }
+            else
+            {
+                first.setWidth(revealed);
+                first.moveCenter(rect.center());
+            }
+
+            return QRegion(first);
+        }
+
+        case PDFPageTransition::Style::Blinds:
+        {
+            QRegion region;
+            for (int i = 0; i < BLINDS_COUNT; ++i)
+            {
+                if (isHorizontal)
+                {
+                    const int top = rect.top() + rect.height() * i / BLINDS_COUNT;
+                    const int bottom = rect.top() + rect.height() * (i + 1) / BLINDS_COUNT;
+                    region += QRect(rect.left(), top, rect.width(), qRound((bottom - top) * progress));
+                }
+                else
+                {
+                    const int left = rect.left() + rect.width() * i / BLINDS_COUNT;
+                    const int right = rect.left() + rect.width() * (i + 1) / BLINDS_COUNT;
+                    region += QRect(left, rect.top(), qRound((right - left) * progress), rect.height());
+                }
+            }
+            return region;
+        }
+
+        case PDFPageTransition::Style::Box:
+        {
+            // Rectangular box sweeps inward from the edges, or outward from the center
+            const PDFReal scale = isInward ? 1.0 - progress : progress;
+            QRect box(QPoint(0, 0), (QSizeF(rect.size()) * scale).toSize());
+            box.moveCenter(rect.center());
+
+            return isInward ? QRegion(rect).subtracted(QRegion(box)) : QRegion(box);
+        }
+
+        case PDFPageTransition::Style::Wipe:
+        {
+            // Single line sweeps across the screen in the direction of the transition
+            const QPointF motion = getMotionVector();
+            QRect revealed = rect;
+
+            if (qAbs(motion.x()) >= qAbs(motion.y()))
+            {
+                const int width = qRound(rect.width() * progress);
+                if (motion.x() >= 0.0)
+                {
+                    revealed.setWidth(width);
+                }
+                else
+                {
+                    revealed.setLeft(rect.right() - width + 1);
+                }
+            }
+            else
+            {
+                const int height = qRound(rect.height() * progress);
+                if (motion.y() >= 0.0)
+                {
+                    revealed.setHeight(height);
+                }
+                else
+                {
+                    revealed.setTop(rect.bottom() - height + 1);
+                }
+            }
+
+            return QRegion(revealed);
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QRegion(rect);
+}
+
+}   // namespace pdf
@@ -0,0 +1,181 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFPRESENTATION_H
+#define PDFPRESENTATION_H
+
+#include "pdfrenderer.h"
+#include "pdfpagetransition.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QImage>
+#include <QFuture>
+#include <QThreadPool>
+
+#include <map>
+#include <vector>
+
+class QPainter;
+
+namespace pdf
+{
+
+/// Cache of pre-rendered frames of the slides for the presentation mode. Frames
+/// are rendered at the resolution of the screen in the background, when current
+/// slide is changed, next and previous slides are rendered ahead, so transition
+/// to them doesn't need to compile and render the page. If current page is
+/// automatically advanced (it has display duration), slides after the next
+/// slide are rendered ahead too. Only frames near the current slide are kept.
+class PDF4QTLIBCORESHARED_EXPORT PDFPresentationFrameCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    /// Creates frame cache
+    /// \param document Document
+    /// \param fontCache Font cache
+    /// \param cmsManager Color management system manager
+    /// \param optionalContentActivity Optional content activity
+    /// \param features Renderer features
+    /// \param meshQualitySettings Mesh quality settings
+    /// \param parent Parent object
+    explicit PDFPresentationFrameCache(const PDFDocument* document,
+                                       const PDFFontCache* fontCache,
+                                       const PDFCMSManager* cmsManager,
+                                       const PDFOptionalContentActivity* optionalContentActivity,
+                                       PDFRenderer::Features features,
+                                       PDFMeshQualitySettings meshQualitySettings,
+                                       QObject* parent);
+    virtual ~PDFPresentationFrameCache() override;
+
+    /// Sets size of the frames (size of the screen in device pixels). All
+    /// frames are rendered again, if size is changed.
+    /// \param frameSize Frame size
+    void setFrameSize(QSize frameSize);
+
+    /// Sets current slide. Frames of the neighbouring slides are rendered
+    /// in the background, frames of other slides are removed from the cache.
+    /// \param pageIndex Index of the current page
+    void setCurrentPage(PDFInteger pageIndex);
+
+    /// Returns frame of the slide. If frame is not yet rendered, it is rendered
+    /// synchronously (or, if it is being rendered in the background, function
+    /// waits for the result).
+    /// \param pageIndex Page index
+    QImage getFrame(PDFInteger pageIndex);
+
+    /// Returns true, if frame of the slide is already rendered
+    /// \param pageIndex Page index
+    bool hasFrame(PDFInteger pageIndex) const;
+
+    /// Returns display duration of the page in seconds (automatic advance
+    /// to the next page), or zero, if page is not advanced automatically.
+    /// \param pageIndex Page index
+    PDFReal getAutoAdvanceDuration(PDFInteger pageIndex) const;
+
+signals:
+    /// Frame of the slide was rendered in the background. This
+    /// signal is emitted from the background thread.
+    void frameRendered(PDFInteger pageIndex);
+
+private:
+    /// Count of slides after the current slide rendered ahead,
+    /// if current slide is automatically advanced.
+    static constexpr PDFInteger AUTO_ADVANCE_LOOK_AHEAD = 2;
+
+    /// Returns indices of pages, which frames should be kept in
+    /// the cache, in the order, in which they should be rendered.
+    std::vector<PDFInteger> getPrefetchedPages(PDFInteger pageIndex) const;
+
+    /// Renders frame of the slide
+    QImage renderFrame(PDFInteger pageIndex, QSize frameSize) const;
+
+    /// Cancels renderings, which were not yet started,
+    /// and waits for all running background renderings.
+    void waitForRendering();
+
+    const PDFDocument* m_document;
+    const PDFFontCache* m_fontCache;
+    const PDFCMSManager* m_cmsManager;
+    const PDFOptionalContentActivity* m_optionalContentActivity;
+    PDFRenderer::Features m_features;
+    PDFMeshQualitySettings m_meshQualitySettings;
+
+    mutable QMutex m_mutex;
+    QSize m_frameSize;
+    PDFInteger m_currentPageIndex = -1;
+    std::map<PDFInteger, QImage> m_frames;
+    std::map<PDFInteger, QFuture<void>> m_renderings;
+
+    /// Thread pool of background renderings, so all renderings (including
+    /// discarded ones) can be waited for, when this object is destroyed.
+    QThreadPool m_threadPool;
+};
+
+/// Composes frames of the page transition from the frames of the old and new
+/// slide. Each transition frame is composed only by clipping, translating and
+/// blending of the two frames, so it is cheap enough to be composed for each
+/// refresh of the screen.
+class PDF4QTLIBCORESHARED_EXPORT PDFPageTransitionComposer
+{
+public:
+    /// Creates transition composer
+    /// \param transition Page transition
+    /// \param oldFrame Frame of the old slide
+    /// \param newFrame Frame of the new slide
+    explicit PDFPageTransitionComposer(const PDFPageTransition& transition, QImage oldFrame, QImage newFrame);
+
+    /// Returns duration of the transition in seconds
+    PDFReal getDuration() const { return m_transition.getDuration(); }
+
+    /// Draws frame of the transition
+    /// \param painter Painter
+    /// \param rect Target rectangle
+    /// \param progress Progress of the transition in range [0, 1]
+    void drawFrame(QPainter* painter, const QRect& rect, PDFReal progress) const;
+
+private:
+    /// Size of the block of dissolve and glitter transitions (in pixels)
+    static constexpr int BLOCK_SIZE = 16;
+
+    /// Count of the lines of the blinds transition
+    static constexpr int BLINDS_COUNT = 8;
+
+    /// Returns unit motion vector for the direction angle of the transition
+    QPointF getMotionVector() const;
+
+    /// Returns region of the new slide visible in the transition
+    QRegion getNewFrameRegion(const QRect& rect, PDFReal progress) const;
+
+    PDFPageTransition m_transition;
+    QImage m_oldFrame;
+    QImage m_newFrame;
+
+    /// Thresholds of the blocks for dissolve and glitter transitions,
+    /// block is visible, if progress is greater than its threshold.
+    std::vector<PDFReal> m_blockThresholds;
+    int m_blockColumns = 0;
+    int m_blockRows = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFPRESENTATION_H
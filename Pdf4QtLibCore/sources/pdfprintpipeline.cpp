@@ -0,0 +1,251 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfprintpipeline.h"
+#include "pdfdocument.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QThread>
+#include <QPainter>
+
+#include "pdfdbgheap.h"
+
+#include <numeric>
+
+namespace pdf
+{
+
+PDFPrintPipeline::PDFPrintPipeline(const PDFDocument* document,
+                                   const PDFFontCache* fontCache,
+                                   const PDFCMS* cms,
+                                   const PDFOptionalContentActivity* optionalContentActivity,
+                                   PDFRenderer::Features features,
+                                   PDFMeshQualitySettings meshQualitySettings,
+                                   QObject* parent) :
+    BaseClass(parent),
+    m_document(document),
+    m_fontCache(fontCache),
+    m_cms(cms),
+    m_optionalContentActivity(optionalContentActivity),
+    m_features(features),
+    m_meshQualitySettings(qMove(meshQualitySettings))
+{
+    Q_ASSERT(document);
+}
+
+PDFPrintPipeline::~PDFPrintPipeline()
+{
+    cancel();
+    waitForWorkers();
+}
+
+void PDFPrintPipeline::setRasterizationEnabled(bool enabled, int bandHeight)
+{
+    m_isRasterizationEnabled = enabled;
+    m_bandHeight = qMax(bandHeight, 1);
+}
+
+void PDFPrintPipeline::start(std::vector<PDFInteger> pageIndices, PageRectangleGetter pageRectangleGetter)
+{
+    Q_ASSERT(m_workers.empty());
+
+    m_pageIndices = qMove(pageIndices);
+    m_pageRectangleGetter = qMove(pageRectangleGetter);
+
+    if (m_pageIndices.empty())
+    {
+        return;
+    }
+
+    auto worker = [this]()
+    {
+        while (!isOperationCancelled())
+        {
+            size_t index = 0;
+
+            {
+                QMutexLocker lock(&m_mutex);
+
+                // Do not prepare too many pages ahead of the print device
+                while (!isOperationCancelled() && m_nextPreparedPage < m_pageIndices.size() && m_nextPreparedPage >= m_nextTakenPage + m_lookAhead)
+                {
+                    m_pageTaken.wait(&m_mutex);
+                }
+
+                if (isOperationCancelled() || m_nextPreparedPage >= m_pageIndices.size())
+                {
+                    break;
+                }
+
+                index = m_nextPreparedPage++;
+            }
+
+            PreparedPage page = preparePage(m_pageIndices[index]);
+
+            if (isOperationCancelled())
+            {
+                break;
+            }
+
+            {
+                QMutexLocker lock(&m_mutex);
+                m_preparedPages[index] = qMove(page);
+            }
+
+            Q_EMIT pageReady();
+        }
+    };
+
+    // Each worker prepares whole page, so pages are prepared in parallel. Raster bands
+    // of the page are painted by the content execution policy.
+    const size_t idealWorkerCount = size_t(PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Page));
+    const size_t workerCount = qBound(size_t(1), idealWorkerCount, qMin(m_lookAhead, m_pageIndices.size()));
+
+    m_workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        m_workers.emplace_back(QThread::create(worker));
+        m_workers.back()->start();
+    }
+}
+
+void PDFPrintPipeline::cancel()
+{
+    QMutexLocker lock(&m_mutex);
+    m_isCancelled.store(true, std::memory_order_relaxed);
+    m_preparedPages.clear();
+    m_pageTaken.wakeAll();
+}
+
+std::optional<PDFPrintPipeline::PreparedPage> PDFPrintPipeline::takeNextPage()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (isOperationCancelled())
+    {
+        return std::nullopt;
+    }
+
+    auto it = m_preparedPages.find(m_nextTakenPage);
+    if (it == m_preparedPages.end())
+    {
+        return std::nullopt;
+    }
+
+    PreparedPage page = qMove(it->second);
+    m_preparedPages.erase(it);
+    ++m_nextTakenPage;
+    m_pageTaken.wakeAll();
+
+    if (m_nextTakenPage == m_pageIndices.size())
+    {
+        lock.unlock();
+        waitForWorkers();
+    }
+
+    return page;
+}
+
+bool PDFPrintPipeline::isFinished() const
+{
+    QMutexLocker lock(&m_mutex);
+    return isOperationCancelled() || m_nextTakenPage >= m_pageIndices.size();
+}
+
+void PDFPrintPipeline::drawPage(QPainter* painter, const PreparedPage& page) const
+{
+    if (page.compiledPage)
+    {
+        page.compiledPage->draw(painter, page.cropBox, page.matrix, m_features, 1.0);
+        return;
+    }
+
+    for (const auto& band : page.bands)
+    {
+        painter->drawImage(band.first, band.second);
+    }
+}
+
+PDFPrintPipeline::PreparedPage PDFPrintPipeline::preparePage(PDFInteger pageIndex) const
+{
+    PreparedPage preparedPage;
+    preparedPage.pageIndex = pageIndex;
+
+    const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        preparedPage.errors.push_back(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Page %1 doesn't exist.").arg(pageIndex + 1)));
+        return preparedPage;
+    }
+
+    const QRectF rectangle = m_pageRectangleGetter(page);
+    preparedPage.matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, rectangle);
+    preparedPage.cropBox = page->getCropBox();
+
+    auto compiledPage = std::make_unique<PDFPrecompiledPage>();
+    PDFRenderer renderer(m_document, m_fontCache, m_cms, m_optionalContentActivity, m_features, m_meshQualitySettings);
+    renderer.setOperationControl(this);
+    renderer.compile(compiledPage.get(), pageIndex);
+    preparedPage.errors = compiledPage->getErrors();
+
+    if (!m_isRasterizationEnabled || isOperationCancelled())
+    {
+        preparedPage.compiledPage = qMove(compiledPage);
+        return preparedPage;
+    }
+
+    // Rasterize the page in bands at the resolution of the device. Bands are
+    // aligned to the device pixels, so they are drawn without resampling.
+    const QRect deviceRect = rectangle.toAlignedRect();
+    const int bandCount = (deviceRect.height() + m_bandHeight - 1) / m_bandHeight;
+    preparedPage.bands.resize(bandCount);
+
+    std::vector<int> bands(bandCount, 0);
+    std::iota(bands.begin(), bands.end(), 0);
+
+    auto renderBand = [&](int band)
+    {
+        const int top = band * m_bandHeight;
+        const int bandHeight = qMin(m_bandHeight, deviceRect.height() - top);
+        const QPoint bandPosition(deviceRect.left(), deviceRect.top() + top);
+
+        QImage bandImage(deviceRect.width(), bandHeight, QImage::Format_ARGB32_Premultiplied);
+        bandImage.fill(Qt::white);
+
+        QTransform bandMatrix = preparedPage.matrix * QTransform::fromTranslate(-bandPosition.x(), -bandPosition.y());
+
+        QPainter painter(&bandImage);
+        compiledPage->draw(&painter, preparedPage.cropBox, bandMatrix, m_features, 1.0);
+        painter.end();
+
+        preparedPage.bands[band] = std::make_pair(bandPosition, qMove(bandImage));
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bands.cbegin(), bands.cend(), renderBand);
+    return preparedPage;
+}
+
+void PDFPrintPipeline::waitForWorkers()
+{
+    for (const auto& worker : m_workers)
+    {
+        worker->wait();
+    }
+    m_workers.clear();
+}
+
+}   // namespace pdf
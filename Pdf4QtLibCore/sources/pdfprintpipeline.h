@@ -0,0 +1,171 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFPRINTPIPELINE_H
+#define PDFPRINTPIPELINE_H
+
+#include "pdfrenderer.h"
+#include "pdfpainter.h"
+#include "pdfoperationcontrol.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QImage>
+#include <QWaitCondition>
+
+#include <map>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <optional>
+#include <functional>
+
+class QThread;
+
+namespace pdf
+{
+
+/// Prepares pages for printing ahead of the print device. Pages are compiled
+/// (and optionally rasterized in horizontal bands at the resolution of the print
+/// device) by worker threads, while the print device, which must be used from
+/// the thread owning it, takes prepared pages in order from the queue. Only
+/// a limited count of pages is prepared ahead (look-ahead), so memory consumption
+/// doesn't depend on the count of printed pages. Preparing of pages can be cancelled.
+class PDF4QTLIBCORESHARED_EXPORT PDFPrintPipeline : public QObject, public PDFOperationControl
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    /// Page prepared for printing
+    struct PreparedPage
+    {
+        PDFInteger pageIndex = -1;
+
+        /// Page point to device point matrix
+        QTransform matrix;
+
+        /// Crop box of the page
+        QRectF cropBox;
+
+        /// Compiled page (used, if page is not rasterized)
+        std::unique_ptr<PDFPrecompiledPage> compiledPage;
+
+        /// Rasterized bands of the page with their positions in device coordinates
+        std::vector<std::pair<QPoint, QImage>> bands;
+
+        /// Errors occured during page compilation
+        QList<PDFRenderError> errors;
+    };
+
+    /// Returns target rectangle of the page in device coordinates.
+    /// It is called from the worker threads.
+    using PageRectangleGetter = std::function<QRectF(const PDFPage*)>;
+
+    /// Creates print pipeline
+    /// \param document Document
+    /// \param fontCache Font cache
+    /// \param cms Color management system
+    /// \param optionalContentActivity Optional content activity
+    /// \param features Renderer features
+    /// \param meshQualitySettings Mesh quality settings
+    /// \param parent Parent object
+    explicit PDFPrintPipeline(const PDFDocument* document,
+                              const PDFFontCache* fontCache,
+                              const PDFCMS* cms,
+                              const PDFOptionalContentActivity* optionalContentActivity,
+                              PDFRenderer::Features features,
+                              PDFMeshQualitySettings meshQualitySettings,
+                              QObject* parent);
+    virtual ~PDFPrintPipeline() override;
+
+    /// Sets maximal count of pages prepared ahead of the print device
+    void setLookAhead(size_t lookAhead) { m_lookAhead = qMax(lookAhead, size_t(1)); }
+
+    /// Enables rasterization of pages. Pages are rasterized in horizontal
+    /// bands of given height in device coordinates (pixels).
+    /// \param enabled Rasterize pages
+    /// \param bandHeight Height of the band in pixels
+    void setRasterizationEnabled(bool enabled, int bandHeight = DEFAULT_BAND_HEIGHT);
+
+    /// Starts preparing of pages in worker threads
+    /// \param pageIndices Indices of printed pages
+    /// \param pageRectangleGetter Getter of target rectangle of the page
+    void start(std::vector<PDFInteger> pageIndices, PageRectangleGetter pageRectangleGetter);
+
+    /// Cancels preparing of pages. Pages, which are being prepared,
+    /// are abandoned, and no more pages are returned.
+    void cancel();
+
+    /// Takes next prepared page, if it is available. If next page is not yet
+    /// prepared, std::nullopt is returned. Pages are returned in order.
+    std::optional<PreparedPage> takeNextPage();
+
+    /// Returns true, if all pages were taken, or pipeline was cancelled
+    bool isFinished() const;
+
+    /// Draws prepared page onto the painter
+    /// \param painter Painter of the print device
+    /// \param page Prepared page
+    void drawPage(QPainter* painter, const PreparedPage& page) const;
+
+    /// Default height of the band of rasterized page (in pixels)
+    static constexpr int DEFAULT_BAND_HEIGHT = 512;
+
+    /// Default count of pages prepared ahead of the print device
+    static constexpr size_t DEFAULT_LOOK_AHEAD = 8;
+
+    virtual bool isOperationCancelled() const override { return m_isCancelled.load(std::memory_order_relaxed); }
+
+signals:
+    /// Next page is prepared. This signal is emitted from the worker thread.
+    void pageReady();
+
+private:
+    /// Prepares page with given index (compiles it and rasterizes it, if enabled)
+    PreparedPage preparePage(PDFInteger pageIndex) const;
+
+    /// Waits for all worker threads to finish
+    void waitForWorkers();
+
+    const PDFDocument* m_document;
+    const PDFFontCache* m_fontCache;
+    const PDFCMS* m_cms;
+    const PDFOptionalContentActivity* m_optionalContentActivity;
+    PDFRenderer::Features m_features;
+    PDFMeshQualitySettings m_meshQualitySettings;
+    size_t m_lookAhead = DEFAULT_LOOK_AHEAD;
+    bool m_isRasterizationEnabled = false;
+    int m_bandHeight = DEFAULT_BAND_HEIGHT;
+
+    std::vector<PDFInteger> m_pageIndices;
+    PageRectangleGetter m_pageRectangleGetter;
+    std::vector<std::unique_ptr<QThread>> m_workers;
+    std::atomic_bool m_isCancelled = false;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_pageTaken;
+    std::map<size_t, PreparedPage> m_preparedPages;
+    size_t m_nextPreparedPage = 0;
+    size_t m_nextTakenPage = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFPRINTPIPELINE_H
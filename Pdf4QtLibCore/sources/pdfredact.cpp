@@ -19,6 +19,8 @@
 #include "pdfpainter.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfoptimizer.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfexception.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -42,73 +44,130 @@ PDFRedact::PDFRedact(const PDFDocument* document,
 
 PDFDocument PDFRedact::perform(Options options)
 {
+    const size_t pageCount = m_document->getCatalog()->getPageCount();
+
+    // Collect redaction regions of all pages
+    std::vector<QPainterPath> redactPaths(pageCount);
+    std::vector<PDFInteger> redactedPages;
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        if (getRedactPath(m_document->getCatalog()->getPage(i), redactPaths[i]))
+        {
+            redactedPages.push_back(i);
+        }
+    }
+
+    // Pages without redact annotations are copied verbatim, without
+    // interpretation of their content. Pages with redact annotations are replaced
+    // by blank pages (with the same page boxes and rotation) in temporary builder
+    // before copying, and their annotations are removed. So no unredacted content
+    // is copied into the new document, even if the old page is referenced
+    // from other objects (for example, from link annotations).
+    PDFDocumentBuilder temporaryBuilder(m_document);
+    temporaryBuilder.flattenPageTree();
+    std::vector<PDFObjectReference> pageReferences = temporaryBuilder.getPages();
+
+    if (pageReferences.size() != pageCount)
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid page tree."));
+    }
+
+    for (PDFInteger pageIndex : redactedPages)
+    {
+        const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+
+        for (const PDFObjectReference& annotationReference : page->getAnnotations())
+        {
+            temporaryBuilder.setObject(annotationReference, PDFObject());
+        }
+
+        temporaryBuilder.setObject(pageReferences[pageIndex], createBlankPageObject(page));
+    }
+
     PDFDocumentBuilder builder;
     builder.createDocument();
 
-    PDFRenderer renderer(m_document,
-                         m_fontCache,
-                         m_cms,
-                         m_optionalContentActivity,
-                         PDFRenderer::None,
-                         *m_meshQualitySettings);
+    std::vector<PDFObjectReference> newPageReferences = PDFDocumentBuilder::createReferencesFromObjects(builder.copyFrom(PDFDocumentBuilder::createObjectsFromReferences(pageReferences), *temporaryBuilder.getStorage(), true));
+    builder.setPages(newPageReferences);
+
+    // Correct page tree (parents of copied pages are invalid)
+    builder.flattenPageTree();
 
     std::map<PDFObjectReference, PDFObjectReference> mapOldPageRefToNewPageRef;
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        mapOldPageRefToNewPageRef[m_document->getCatalog()->getPage(i)->getPageReference()] = newPageReferences[i];
+    }
 
-    for (size_t i = 0; i < m_document->getCatalog()->getPageCount(); ++i)
+    // Redacted pages are compiled and drawn in parallel, in batches, so we do not
+    // hold compiled pages of the whole document in memory. Content streams are
+    // then copied into the new document sequentially, because builder is not thread safe.
+    const size_t batchSize = size_t(qMax(PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Page), 1)) * 4;
+    for (auto batchIt = redactedPages.cbegin(); batchIt != redactedPages.cend();)
     {
-        const PDFPage* page = m_document->getCatalog()->getPage(i);
+        auto batchEndIt = std::next(batchIt, qMin<ptrdiff_t>(batchSize, std::distance(batchIt, redactedPages.cend())));
 
-        PDFPrecompiledPage compiledPage;
-        renderer.compile(&compiledPage, i);
+        struct RedactedPage
+        {
+            PDFInteger pageIndex = -1;
+            PDFContentStreamBuilder::ContentStream contentStream;
+        };
 
-        PDFObjectReference newPageReference = builder.appendPage(page->getMediaBox());
-        mapOldPageRefToNewPageRef[page->getPageReference()] = newPageReference;
+        std::vector<RedactedPage> batch;
+        batch.reserve(std::distance(batchIt, batchEndIt));
+        std::transform(batchIt, batchEndIt, std::back_inserter(batch), [](PDFInteger pageIndex) { return RedactedPage{ pageIndex, PDFContentStreamBuilder::ContentStream() }; });
 
-        if (!page->getCropBox().isEmpty())
-        {
-            builder.setPageCropBox(newPageReference, page->getCropBox());
-        }
-        if (!page->getBleedBox().isEmpty())
+        auto redactPage = [&, this](RedactedPage& redactedPage)
         {
-            builder.setPageBleedBox(newPageReference, page->getBleedBox());
-        }
-        if (!page->getTrimBox().isEmpty())
-        {
-            builder.setPageTrimBox(newPageReference, page->getTrimBox());
-        }
-        if (!page->getArtBox().isEmpty())
-        {
-            builder.setPageArtBox(newPageReference, page->getArtBox());
-        }
-        builder.setPageRotation(newPageReference, page->getPageRotation());
+            const PDFInteger pageIndex = redactedPage.pageIndex;
+            const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
 
-        PDFPageContentStreamBuilder contentStreamBuilder(&builder);
+            PDFRenderer renderer(m_document,
+                                 m_fontCache,
+                                 m_cms,
+                                 m_optionalContentActivity,
+                                 PDFRenderer::None,
+                                 *m_meshQualitySettings);
 
-        QPainterPath redactPath;
+            PDFPrecompiledPage compiledPage;
+            renderer.compile(&compiledPage, pageIndex);
 
-        for (const PDFObjectReference& annotationReference : page->getAnnotations())
+            QTransform matrix;
+            matrix.translate(0, page->getMediaBox().height());
+            matrix.scale(1.0, -1.0);
+
+            PDFContentStreamBuilder contentStreamBuilder(page->getMediaBox().size(), PDFContentStreamBuilder::CoordinateSystem::Qt);
+            QPainter* painter = contentStreamBuilder.begin();
+            compiledPage.redact(redactPaths[pageIndex], matrix, m_redactFillColor);
+            compiledPage.draw(painter, QRectF(), matrix, PDFRenderer::None, 1.0);
+            redactedPage.contentStream = contentStreamBuilder.end(painter);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, batch.begin(), batch.end(), redactPage);
+
+        for (const RedactedPage& redactedPage : batch)
         {
-            PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_document->getStorage(), annotationReference);
-            if (!annotation || annotation->getType() != AnnotationType::Redact)
-            {
-                continue;
-            }
+            const PDFContentStreamBuilder::ContentStream& contentStream = redactedPage.contentStream;
+            std::vector<PDFObject> copiedObjects = builder.copyFrom({ contentStream.resources, contentStream.contents }, contentStream.document.getStorage(), true);
+            Q_ASSERT(copiedObjects.size() == 2);
 
-            // We have redact annotation here
-            const PDFRedactAnnotation* redactAnnotation = dynamic_cast<const PDFRedactAnnotation*>(annotation.get());
-            Q_ASSERT(redactAnnotation);
+            PDFObjectFactory pageUpdateFactory;
 
-            redactPath = redactPath.united(redactAnnotation->getRedactionRegion().getPath());
-        }
+            pageUpdateFactory.beginDictionary();
+
+            pageUpdateFactory.beginDictionaryItem("Contents");
+            pageUpdateFactory << copiedObjects[1].getReference();
+            pageUpdateFactory.endDictionaryItem();
 
-        QTransform matrix;
-        matrix.translate(0, page->getMediaBox().height());
-        matrix.scale(1.0, -1.0);
+            pageUpdateFactory.beginDictionaryItem("Resources");
+            pageUpdateFactory << copiedObjects[0].getReference();
+            pageUpdateFactory.endDictionaryItem();
 
-        QPainter* painter = contentStreamBuilder.begin(newPageReference);
-        compiledPage.redact(redactPath, matrix, m_redactFillColor);
-        compiledPage.draw(painter, QRectF(), matrix, PDFRenderer::None, 1.0);
-        contentStreamBuilder.end(painter);
+            pageUpdateFactory.endDictionary();
+
+            builder.mergeTo(newPageReferences[redactedPage.pageIndex], pageUpdateFactory.takeObject());
+        }
+
+        batchIt = batchEndIt;
     }
 
     if (options.testFlag(CopyTitle))
@@ -178,4 +237,62 @@ PDFDocument PDFRedact::perform(Options options)
     return optimizer.takeOptimizedDocument();
 }
 
+bool PDFRedact::getRedactPath(const PDFPage* page, QPainterPath& redactPath) const
+{
+    bool hasRedactAnnotation = false;
+
+    for (const PDFObjectReference& annotationReference : page->getAnnotations())
+    {
+        PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_document->getStorage(), annotationReference);
+        if (!annotation || annotation->getType() != AnnotationType::Redact)
+        {
+            continue;
+        }
+
+        // We have redact annotation here
+        const PDFRedactAnnotation* redactAnnotation = dynamic_cast<const PDFRedactAnnotation*>(annotation.get());
+        Q_ASSERT(redactAnnotation);
+
+        redactPath = redactPath.united(redactAnnotation->getRedactionRegion().getPath());
+        hasRedactAnnotation = true;
+    }
+
+    return hasRedactAnnotation;
+}
+
+PDFObject PDFRedact::createBlankPageObject(const PDFPage* page)
+{
+    PDFObjectFactory factory;
+
+    factory.beginDictionary();
+
+    factory.beginDictionaryItem("Type");
+    factory << WrapName("Page");
+    factory.endDictionaryItem();
+
+    factory.beginDictionaryItem("MediaBox");
+    factory << page->getMediaBox();
+    factory.endDictionaryItem();
+
+    for (auto [key, box] : { std::make_pair("CropBox", page->getCropBox()),
+                             std::make_pair("BleedBox", page->getBleedBox()),
+                             std::make_pair("TrimBox", page->getTrimBox()),
+                             std::make_pair("ArtBox", page->getArtBox()) })
+    {
+        if (!box.isEmpty())
+        {
+            factory.beginDictionaryItem(key);
+            factory << box;
+            factory.endDictionaryItem();
+        }
+    }
+
+    factory.beginDictionaryItem("Rotate");
+    factory << page->getPageRotation();
+    factory.endDictionaryItem();
+
+    factory.endDictionary();
+    return factory.takeObject();
+}
+
 }   // namespace pdf
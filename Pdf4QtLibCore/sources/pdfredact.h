@@ -47,9 +47,24 @@ public:
     Q_DECLARE_FLAGS(Options, Option)
 
 
+    /// Creates redacted document. Pages without redact annotations are copied
+    /// verbatim (their content is not interpreted), pages with redact annotations
+    /// are compiled and redacted in parallel.
+    /// \param options Options
     pdf::PDFDocument perform(Options options);
 
 private:
+    /// Computes union of redaction regions of all redact annotations
+    /// of the page. Returns true, if page has redact annotations.
+    /// \param page Page
+    /// \param[out] redactPath Union of redaction regions
+    bool getRedactPath(const PDFPage* page, QPainterPath& redactPath) const;
+
+    /// Creates page object without content and annotations, with the same
+    /// page boxes and rotation as the page
+    /// \param page Page
+    static PDFObject createBlankPageObject(const PDFPage* page);
+
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
     const PDFCMS* m_cms;
@@ -22,6 +22,8 @@
 #include "pdfprogress.h"
 #include "pdfannotation.h"
 #include "pdfblpainter.h"
+#include "pdfprecompiledpagecache.h"
+#include "pdfinstrumentation.h"
 
 #include <QDir>
 #include <QElapsedTimer>
@@ -143,6 +145,50 @@ void PDFRenderer::applyFeaturesToColorConvertor(const Features& features, PDFCol
     }
 }
 
+void PDFRenderer::applyFidelity(Fidelity fidelity, Features& features, PDFMeshQualitySettings& meshQualitySettings)
+{
+    features &= ~getDraftFeatures();
+
+    switch (fidelity)
+    {
+        case Fidelity::Draft:
+        {
+            features |= getDraftFeatures();
+            features |= TilingPatternCache;
+            features &= ~Features(SmoothImages);
+
+            meshQualitySettings.minimalMeshResolutionRatio = 0.02;
+            meshQualitySettings.preferredMeshResolutionRatio = 0.05;
+            meshQualitySettings.tolerance = 0.05;
+            meshQualitySettings.patchTestPoints = 16;
+            meshQualitySettings.gradientStopCount = 32;
+            break;
+        }
+
+        case Fidelity::Normal:
+            break;
+
+        case Fidelity::High:
+        {
+            features |= Antialiasing;
+            features |= TextAntialiasing;
+            features |= SmoothImages;
+            features &= ~Features(TilingPatternCache);
+
+            meshQualitySettings.minimalMeshResolutionRatio = 0.0025;
+            meshQualitySettings.preferredMeshResolutionRatio = 0.01;
+            meshQualitySettings.tolerance = 0.005;
+            meshQualitySettings.patchTestPoints = 128;
+            meshQualitySettings.gradientStopCount = 256;
+            break;
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+}
+
 const PDFOperationControl* PDFRenderer::getOperationControl() const
 {
     return m_operationControl;
@@ -189,7 +235,7 @@ QList<PDFRenderError> PDFRenderer::render(QPainter* painter, const QTransform& m
     return processor.processContents();
 }
 
-void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex) const
+void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex, bool isDraftImagesEnabled) const
 {
     const PDFCatalog* catalog = m_document->getCatalog();
     if (pageIndex >= catalog->getPageCount() || !catalog->getPage(pageIndex))
@@ -202,11 +248,16 @@ void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex)
     const PDFPage* page = catalog->getPage(pageIndex);
     Q_ASSERT(page);
 
+    PDFInstrumentationPageScope instrumentationPageScope(PDFInteger(pageIndex));
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::PageCompilation);
+
     QElapsedTimer timer;
     timer.start();
 
     PDFPrecompiledPageGenerator generator(precompiledPage, m_features, page, m_document, m_fontCache, m_cms, m_optionalContentActivity, m_meshQualitySettings);
     generator.setOperationControl(m_operationControl);
+    generator.setDraftImagesEnabled(isDraftImagesEnabled);
+    generator.setOptionalContentRecordingEnabled(m_isOptionalContentRecordingEnabled);
     QList<PDFRenderError> errors = generator.processContents();
 
     PDFColorConvertor colorConvertor = m_cms->getColorConvertor();
@@ -233,6 +284,18 @@ PDFRasterizer::~PDFRasterizer()
 void PDFRasterizer::reset(RendererEngine rendererEngine)
 {
     m_rendererEngine = rendererEngine;
+    m_blPaintDevice.reset();
+    m_targetImage = QImage();
+}
+
+void PDFRasterizer::prepareTargetImage(QSize size)
+{
+    // If the caller still holds previously rendered image, then we can't
+    // paint into its memory, because it would be detached (copied).
+    if (m_targetImage.size() != size || !m_targetImage.isDetached())
+    {
+        m_targetImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    }
 }
 
 QImage PDFRasterizer::render(PDFInteger pageIndex,
@@ -242,21 +305,46 @@ QImage PDFRasterizer::render(PDFInteger pageIndex,
                              PDFRenderer::Features features,
                              const PDFAnnotationManager* annotationManager,
                              const PDFCMS* cms,
-                             PageRotation extraRotation)
+                             PageRotation extraRotation,
+                             const PDFOptionalContentActivity* optionalContentActivity)
 {
-    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    return renderBand(pageIndex, page, compiledPage, size, QRect(QPoint(0, 0), size), features, annotationManager, cms, extraRotation, optionalContentActivity);
+}
+
+QImage PDFRasterizer::renderBand(PDFInteger pageIndex,
+                                 const PDFPage* page,
+                                 const PDFPrecompiledPage* compiledPage,
+                                 QSize size,
+                                 QRect band,
+                                 PDFRenderer::Features features,
+                                 const PDFAnnotationManager* annotationManager,
+                                 const PDFCMS* cms,
+                                 PageRotation extraRotation,
+                                 const PDFOptionalContentActivity* optionalContentActivity)
+{
+    PDFInstrumentationPageScope instrumentationPageScope(pageIndex);
+    PDFInstrumentationTimer instrumentationTimer(PDFInstrumentationStage::PageRasterization);
+
+    prepareTargetImage(band.size());
+    QImage& image = m_targetImage;
 
     PDFColorConvertor convertor = cms->getColorConvertor();
     PDFRenderer::applyFeaturesToColorConvertor(features, convertor);
     QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), size), extraRotation);
+    matrix = matrix * QTransform::fromTranslate(-band.left(), -band.top());
 
     if (m_rendererEngine == RendererEngine::Blend2D_MultiThread ||
         m_rendererEngine == RendererEngine::Blend2D_SingleThread)
     {
-        PDFBLPaintDevice blPaintDevice(image, false);
+        // Paint device refers to the target image, which is a member
+        // of this object, so it can be kept for the next pages.
+        if (!m_blPaintDevice)
+        {
+            m_blPaintDevice = std::make_unique<PDFBLPaintDevice>(m_targetImage, false);
+        }
 
-        QPainter painter(&blPaintDevice);
-        compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0);
+        QPainter painter(m_blPaintDevice.get());
+        compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0, optionalContentActivity);
 
         if (annotationManager)
         {
@@ -270,11 +358,19 @@ QImage PDFRasterizer::render(PDFInteger pageIndex,
         // Use standard software rasterizer.
         image.fill(Qt::white);
 
-        QPainter painter(&image);
-        compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0);
+        if (isBandRenderingUsed(band.size()))
+        {
+            renderBands(image, page, compiledPage, matrix, features, optionalContentActivity);
+        }
+        else
+        {
+            QPainter painter(&image);
+            compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0, optionalContentActivity);
+        }
 
         if (annotationManager)
         {
+            QPainter painter(&image);
             QList<PDFRenderError> errors;
             PDFTextLayoutGetter textLayoutGetter(nullptr, pageIndex);
             annotationManager->drawPage(&painter, pageIndex, compiledPage, textLayoutGetter, matrix, convertor, errors);
@@ -283,7 +379,7 @@ QImage PDFRasterizer::render(PDFInteger pageIndex,
 
     // Calculate image DPI
     QSizeF rotatedSizeInMeters = page->getRotatedMediaBoxMM().size() / 1000.0;
-    QSizeF rotatedSizeInPixels = image.size();
+    QSizeF rotatedSizeInPixels = size;
     qreal dpiX = rotatedSizeInPixels.width() / rotatedSizeInMeters.width();
     qreal dpiY = rotatedSizeInPixels.height() / rotatedSizeInMeters.height();
     image.setDotsPerMeterX(qCeil(dpiX));
@@ -292,6 +388,57 @@ QImage PDFRasterizer::render(PDFInteger pageIndex,
     return image;
 }
 
+bool PDFRasterizer::isBandRenderingUsed(QSize size) const
+{
+    return (m_rendererEngine == RendererEngine::QPainter || m_rendererEngine == RendererEngine::QRhi) &&
+           qint64(size.width()) * qint64(size.height()) >= BAND_RENDERING_MIN_PIXELS &&
+           size.height() >= 2 * BAND_MIN_HEIGHT &&
+           PDFExecutionPolicy::isParallelizing(PDFExecutionPolicy::Scope::Content);
+}
+
+void PDFRasterizer::renderBands(QImage& image,
+                                const PDFPage* page,
+                                const PDFPrecompiledPage* compiledPage,
+                                const QTransform& matrix,
+                                PDFRenderer::Features features,
+                                const PDFOptionalContentActivity* optionalContentActivity) const
+{
+    const int height = image.height();
+    const int idealBandCount = 2 * PDFExecutionPolicy::getIdealThreadCount(PDFExecutionPolicy::Scope::Content);
+    const int bandHeight = qMax(BAND_MIN_HEIGHT, (height + idealBandCount - 1) / qMax(idealBandCount, 1));
+    const int bandCount = (height + bandHeight - 1) / bandHeight;
+
+    // Bands are painted directly into the rows of the target image, so the
+    // image must be detached before the painting threads are started.
+    uchar* bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    const QRectF cropBox = page->getCropBox();
+
+    std::vector<int> bands(bandCount, 0);
+    std::iota(bands.begin(), bands.end(), 0);
+
+    // Bands are painted in other threads, so page of the instrumentation must be set there
+    const PDFInteger instrumentationPageIndex = PDFInstrumentation::getCurrentPageIndex();
+
+    auto renderBand = [&](int band)
+    {
+        PDFInstrumentationPageScope instrumentationPageScope(instrumentationPageIndex);
+
+        const int top = band * bandHeight;
+        const int currentBandHeight = qMin(bandHeight, height - top);
+
+        // Band image shares memory with the target image
+        QImage bandImage(bits + top * bytesPerLine, image.width(), currentBandHeight, bytesPerLine, image.format());
+
+        QTransform bandMatrix = matrix * QTransform::fromTranslate(0.0, -top);
+
+        QPainter painter(&bandImage);
+        compiledPage->draw(&painter, cropBox, bandMatrix, features, 1.0, optionalContentActivity);
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bands.cbegin(), bands.cend(), renderBand);
+}
+
 PDFRasterizer* PDFRasterizerPool::acquire()
 {
     m_semaphore.acquire();
@@ -339,7 +486,13 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         info.text = PDFTranslationContext::tr("Rendering document into images.");
         progress->start(pageIndices.size(), qMove(info));
     }
-    auto processPage = [this, progress, &imageSizeGetter, &processImage](const PDFInteger pageIndex)
+    QByteArray rendererKey;
+    if (m_precompiledPageCache)
+    {
+        rendererKey = PDFPrecompiledPageCache::createRendererKey(m_document, m_features, m_cmsManager->getSettings(), m_meshQualitySettings, m_optionalContentActivity);
+    }
+
+    auto processPage = [this, progress, &imageSizeGetter, &processImage, &rendererKey](const PDFInteger pageIndex)
     {
         const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
 
@@ -362,8 +515,16 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         // Precompile the page
         PDFPrecompiledPage precompiledPage;
         PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
-        PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
-        renderer.compile(&precompiledPage, pageIndex);
+        if (!m_precompiledPageCache || !m_precompiledPageCache->load(m_document, rendererKey, pageIndex, &precompiledPage))
+        {
+            PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
+            renderer.compile(&precompiledPage, pageIndex);
+
+            if (m_precompiledPageCache)
+            {
+                m_precompiledPageCache->store(m_document, rendererKey, pageIndex, precompiledPage);
+            }
+        }
 
         qint64 pageCompileTime = pageTimer.restart();
 
@@ -380,23 +541,46 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         PDFAnnotationManager annotationManager(m_fontCache, m_cmsManager, m_optionalContentActivity, m_meshQualitySettings, m_features, PDFAnnotationManager::Target::Print, nullptr);
         annotationManager.setDocument(modifiedDocument);
 
-        // Render page to image
+        // Render page to image. If the page image is too large, then it is rendered
+        // in bands, rasterizer is held, until the last band is rendered.
+        const QSize imageSize = imageSizeGetter(page);
+        const int bandHeight = (m_bandHeight > 0 && imageSize.height() > m_bandHeight) ? m_bandHeight : imageSize.height();
+
         pageTimer.restart();
         PDFRasterizer* rasterizer = acquire();
         qint64 pageWaitTime = pageTimer.restart();
-        QImage image = rasterizer->render(pageIndex, page, &precompiledPage, imageSizeGetter(page), m_features, &annotationManager, cms.data(), PageRotation::None);
-        qint64 pageRenderTime = pageTimer.elapsed();
-        release(rasterizer);
-
-        // Now, process the image
-        PDFRenderedPageImage renderedPageImage;
-        renderedPageImage.pageIndex = pageIndex;
-        renderedPageImage.pageImage = qMove(image);
-        renderedPageImage.pageCompileTime = pageCompileTime;
-        renderedPageImage.pageWaitTime = pageWaitTime;
-        renderedPageImage.pageRenderTime = pageRenderTime;
-        renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
-        processImage(renderedPageImage);
+        qint64 pageRenderTime = 0;
+        int bandIndex = 0;
+        int bandTop = 0;
+
+        do
+        {
+            const QRect band(0, bandTop, imageSize.width(), qMin(bandHeight, imageSize.height() - bandTop));
+            pageTimer.restart();
+            QImage image = rasterizer->renderBand(pageIndex, page, &precompiledPage, imageSize, band, m_features, &annotationManager, cms.data(), PageRotation::None);
+            pageRenderTime += pageTimer.elapsed();
+            bandTop += band.height();
+
+            const bool isLastBand = bandTop >= imageSize.height();
+            if (isLastBand)
+            {
+                release(rasterizer);
+            }
+
+            // Now, process the image
+            PDFRenderedPageImage renderedPageImage;
+            renderedPageImage.pageIndex = pageIndex;
+            renderedPageImage.pageImage = qMove(image);
+            renderedPageImage.pageSize = imageSize;
+            renderedPageImage.bandIndex = bandIndex++;
+            renderedPageImage.bandTop = band.top();
+            renderedPageImage.isLastBand = isLastBand;
+            renderedPageImage.pageCompileTime = pageCompileTime;
+            renderedPageImage.pageWaitTime = pageWaitTime;
+            renderedPageImage.pageRenderTime = pageRenderTime;
+            renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
+            processImage(renderedPageImage);
+        } while (bandTop < imageSize.height());
 
         if (progress)
         {
@@ -30,6 +30,8 @@
 #include <QImageWriter>
 #include <QImage>
 
+#include <memory>
+
 class QPainter;
 
 namespace pdf
@@ -41,6 +43,8 @@ class PDFCMSManager;
 class PDFPrecompiledPage;
 class PDFAnnotationManager;
 class PDFOptionalContentActivity;
+class PDFPrecompiledPageCache;
+class PDFBLPaintDevice;
 
 /// Renders the PDF page on the painter, or onto an image.
 class PDF4QTLIBCORESHARED_EXPORT PDFRenderer
@@ -67,10 +71,46 @@ public:
         ColorAdjust_HighContrast    = 0x2000,   ///< Convert colors to high constrast colors
         ColorAdjust_Bitonal         = 0x4000,   ///< Convert colors to bitonal (monochromatic)
         ColorAdjust_CustomColors    = 0x8000,   ///< Convert colors to custom color settings
+        TilingPatternCache          = 0x10000,  ///< Paint dense tiling patterns using cached image of the pattern cell
+
+        Draft_Images                = 0x20000,  ///< Decode JPEG and JPEG 2000 images in lower resolution (not lower than resolution of the page space)
+        Draft_SoftMasks             = 0x40000,  ///< Ignore soft masks of small images (smaller than \p DRAFT_SOFT_MASK_SIZE_LIMIT), images are painted as opaque
+        Draft_TransparencyGroups    = 0x80000,  ///< Do not isolate opaque transparency groups (groups with opaque alpha and normal blend mode)
+        Draft_Type3Glyphs           = 0x100000, ///< Approximate Type 3 glyphs by cached outlines (strokes are converted to outlines, clipping is ignored)
     };
 
     Q_DECLARE_FLAGS(Features, Feature)
 
+    /// Fidelity profile of the rendered output. Profile trades quality of the output
+    /// for the speed of rendering across the whole rendering pipeline (image decoding,
+    /// shadings, transparency and Type 3 fonts). Profile is applied to the renderer
+    /// features and mesh quality settings using \p applyFidelity.
+    ///
+    /// Draft: images are transformed without smoothing, JPEG and JPEG 2000 images are
+    /// decoded in lower resolution (at least 72 DPI), shadings are meshed coarsely (5 %
+    /// color tolerance, 2.5 times longer mesh edges) and native gradients have at most
+    /// 32 color stops, soft masks of images smaller than 16 points are ignored, opaque
+    /// transparency groups are not isolated, Type 3 glyphs are approximated by outlines
+    /// and tiling patterns are painted using cached cell image. Antialiasing is unchanged,
+    /// so text remains readable. Output is intended for previews, thumbnails and indexing.
+    ///
+    /// Normal: default quality, features and mesh quality settings are not changed
+    /// (except that draft features are turned off).
+    ///
+    /// High: antialiasing and smooth images are turned on, tiling patterns are always
+    /// replayed (cell image is not used), shadings are meshed with two times shorter
+    /// mesh edges and 0.5 % color tolerance. Rendering of shadings is slower.
+    enum class Fidelity
+    {
+        Draft,
+        Normal,
+        High
+    };
+
+    /// Soft masks of images smaller than this size (in device space units, i.e. page space
+    /// points, when page is compiled) are ignored, if feature \p Draft_SoftMasks is turned on.
+    static constexpr PDFReal DRAFT_SOFT_MASK_SIZE_LIMIT = 16.0;
+
     explicit PDFRenderer(const PDFDocument* document,
                          const PDFFontCache* fontCache,
                          const PDFCMS* cms,
@@ -96,7 +136,8 @@ public:
     /// to the compiled page.
     /// \param precompiledPage Precompiled page pointer
     /// \param pageIndex Index of page to be compiled
-    void compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex) const;
+    /// \param isDraftImagesEnabled Decode JPEG and JPEG 2000 images in lower resolution (page is then marked as draft)
+    void compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex, bool isDraftImagesEnabled = false) const;
 
     /// Creates page point to device point matrix for the given rectangle. It creates transformation
     /// from page's media box to the target rectangle.
@@ -119,14 +160,31 @@ public:
     static void applyFeaturesToColorConvertor(const Features& features, PDFColorConvertor& convertor);
 
     /// Returns default renderer features
-    static constexpr Features getDefaultFeatures() { return Features(Antialiasing | TextAntialiasing | ClipToCropBox | DisplayAnnotations); }
+    static constexpr Features getDefaultFeatures() { return Features(Antialiasing | TextAntialiasing | ClipToCropBox | DisplayAnnotations | TilingPatternCache); }
 
     /// Returns color transformation features
     static constexpr Features getColorFeatures() { return Features(ColorAdjust_Invert | ColorAdjust_Grayscale | ColorAdjust_HighContrast | ColorAdjust_Bitonal | ColorAdjust_CustomColors); }
 
+    /// Returns draft features, which are turned on by draft fidelity profile
+    static constexpr Features getDraftFeatures() { return Features(Draft_Images | Draft_SoftMasks | Draft_TransparencyGroups | Draft_Type3Glyphs); }
+
+    /// Applies fidelity profile to the renderer features and mesh quality settings,
+    /// see \p Fidelity for description of the profiles.
+    /// \param fidelity Fidelity profile
+    /// \param features Renderer features
+    /// \param meshQualitySettings Mesh quality settings
+    static void applyFidelity(Fidelity fidelity, Features& features, PDFMeshQualitySettings& meshQualitySettings);
+
     const PDFOperationControl* getOperationControl() const;
     void setOperationControl(const PDFOperationControl* newOperationControl);
 
+    /// Enables recording of optional content into compiled pages. Compiled page
+    /// then contains also hidden optional content, and it must be drawn using
+    /// the optional content activity, so page needn't to be compiled again,
+    /// when state of optional content is changed.
+    /// \sa PDFPrecompiledPageGenerator::setOptionalContentRecordingEnabled
+    void setOptionalContentRecordingEnabled(bool optionalContentRecordingEnabled) { m_isOptionalContentRecordingEnabled = optionalContentRecordingEnabled; }
+
 private:
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
@@ -135,6 +193,7 @@ private:
     const PDFOperationControl* m_operationControl;
     Features m_features;
     PDFMeshQualitySettings m_meshQualitySettings;
+    bool m_isOptionalContentRecordingEnabled = false;
 };
 
 /// Renders PDF pages to bitmap images (QImage).
@@ -166,6 +225,7 @@ public:
     /// \param annotationManager Annotation manager (can be nullptr)
     /// \param cms Color management system
     /// \param extraRotation Extra page rotation
+    /// \param optionalContentActivity Optional content activity used to draw the compiled page (can be nullptr)
     QImage render(PDFInteger pageIndex,
                   const PDFPage* page,
                   const PDFPrecompiledPage* compiledPage,
@@ -173,13 +233,82 @@ public:
                   PDFRenderer::Features features,
                   const PDFAnnotationManager* annotationManager,
                   const PDFCMS* cms,
-                  PageRotation extraRotation);
+                  PageRotation extraRotation,
+                  const PDFOptionalContentActivity* optionalContentActivity = nullptr);
+
+    /// Renders horizontal band of the page image of given size. Only the band
+    /// is allocated, so very large page images can be rendered band by band
+    /// with bounded memory. Parameters are the same as in \p render function.
+    /// \param pageIndex Page index
+    /// \param page Page
+    /// \param compiledPage Compiled page contents
+    /// \param size Size of the whole page image
+    /// \param band Rectangle of the band in the page image
+    /// \param features Renderer features
+    /// \param annotationManager Annotation manager (can be nullptr)
+    /// \param cms Color management system
+    /// \param extraRotation Extra page rotation
+    /// \param optionalContentActivity Optional content activity used to draw the compiled page (can be nullptr)
+    QImage renderBand(PDFInteger pageIndex,
+                      const PDFPage* page,
+                      const PDFPrecompiledPage* compiledPage,
+                      QSize size,
+                      QRect band,
+                      PDFRenderer::Features features,
+                      const PDFAnnotationManager* annotationManager,
+                      const PDFCMS* cms,
+                      PageRotation extraRotation,
+                      const PDFOptionalContentActivity* optionalContentActivity = nullptr);
 
 private:
+    /// Minimal number of pixels of the target image, for which
+    /// page is rendered in parallel in horizontal bands
+    static constexpr qint64 BAND_RENDERING_MIN_PIXELS = 2048 * 2048;
+
+    /// Minimal height of the band (in pixels)
+    static constexpr int BAND_MIN_HEIGHT = 128;
+
+    /// Returns true, if image of given size should be rendered in bands
+    /// \param size Size of the target image
+    bool isBandRenderingUsed(QSize size) const;
+
+    /// Renders page contents into horizontal bands of the target image
+    /// in parallel, using the content execution policy. Each band is painted
+    /// by its own painter from the shared compiled page directly into
+    /// the rows of the target image, which must be already cleared.
+    /// \param image Target image
+    /// \param page Page
+    /// \param compiledPage Compiled page contents
+    /// \param matrix Page point to device point matrix of the whole image
+    /// \param features Renderer features
+    /// \param optionalContentActivity Optional content activity (can be nullptr)
+    void renderBands(QImage& image,
+                     const PDFPage* page,
+                     const PDFPrecompiledPage* compiledPage,
+                     const QTransform& matrix,
+                     PDFRenderer::Features features,
+                     const PDFOptionalContentActivity* optionalContentActivity) const;
+
+    /// Prepares target image of given size. Memory of the image rendered
+    /// previously is reused, if it has the same size and the caller
+    /// doesn't hold the previously rendered image anymore.
+    /// \param size Size of the target image
+    void prepareTargetImage(QSize size);
+
     RendererEngine m_rendererEngine;
+
+    /// Target image, it is kept between rendered pages to avoid
+    /// allocation of page sized images (thumbnails, tiles).
+    QImage m_targetImage;
+
+    /// Blend2D paint device drawing into the target image. It is kept
+    /// between rendered pages, so cached glyph paths are reused.
+    std::unique_ptr<PDFBLPaintDevice> m_blPaintDevice;
 };
 
-/// Simple structure for storing rendered page images
+/// Simple structure for storing rendered page images. If page is rendered
+/// in bands, then page image contains only the band, render and total
+/// times are accumulated over the bands rendered so far.
 struct PDFRenderedPageImage
 {
     qint64 pageCompileTime = 0;
@@ -188,6 +317,10 @@ struct PDFRenderedPageImage
     qint64 pageTotalTime = 0;
     PDFInteger pageIndex;
     QImage pageImage;
+    QSize pageSize;             ///< Size of the whole page image
+    int bandIndex = 0;          ///< Index of the band
+    int bandTop = 0;            ///< Top row of the band in the whole page image
+    bool isLastBand = true;     ///< Is it last band of the page?
 };
 
 /// Pool of page image renderers. It can use predefined number of renderers to
@@ -257,6 +390,19 @@ public:
     /// \returns Corrected number of rasterizers
     static int getCorrectedRasterizerCount(int rasterizerCount);
 
+    /// Sets persistent cache of precompiled pages. If page is found
+    /// in the cache, it is not compiled again. Newly compiled pages
+    /// are stored into the cache. Pass nullptr to disable the cache.
+    /// \param precompiledPageCache Precompiled page cache (can be nullptr)
+    void setPrecompiledPageCache(PDFPrecompiledPageCache* precompiledPageCache) { m_precompiledPageCache = precompiledPageCache; }
+
+    /// Sets maximal height of the rendered image. Pages, whose images are higher,
+    /// are rendered in horizontal bands of this height, and process image method
+    /// is called for each band (in the top to bottom order). Pass zero to render
+    /// whole page images.
+    /// \param bandHeight Band height in pixels
+    void setBandHeight(int bandHeight) { m_bandHeight = qMax(bandHeight, 0); }
+
 signals:
     void renderError(PDFInteger pageIndex, PDFRenderError error);
 
@@ -267,6 +413,8 @@ private:
     const PDFOptionalContentActivity* m_optionalContentActivity;
     PDFRenderer::Features m_features;
     const PDFMeshQualitySettings& m_meshQualitySettings;
+    PDFPrecompiledPageCache* m_precompiledPageCache = nullptr;
+    int m_bandHeight = 0;
 
     QSemaphore m_semaphore;
     QMutex m_mutex;
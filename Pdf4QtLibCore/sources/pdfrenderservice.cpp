@@ -0,0 +1,335 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfrenderservice.h"
+#include "pdfdocument.h"
+#include "pdfpainter.h"
+#include "pdfannotation.h"
+#include "pdfprecompiledpagecache.h"
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+bool PDFRenderRequest::isSameImage(const PDFRenderRequest& other) const
+{
+    return pageIndex == other.pageIndex &&
+           size == other.size &&
+           features == other.features &&
+           rotation == other.rotation;
+}
+
+/// Operation control of the job, job is cancelled, if all its requesters cancelled it
+class PDFRenderService::JobOperationControl : public PDFOperationControl
+{
+public:
+    explicit JobOperationControl(const PDFRenderService* service, const Job* job) :
+        m_service(service),
+        m_job(job)
+    {
+
+    }
+
+    virtual bool isOperationCancelled() const override
+    {
+        QMutexLocker lock(&m_service->m_mutex);
+        return m_job->isCancelled();
+    }
+
+private:
+    const PDFRenderService* m_service;
+    const Job* m_job;
+};
+
+bool PDFRenderService::Requester::isCancelled() const
+{
+    return promise->isCanceled() || PDFOperationControl::isOperationCancelled(operationControl);
+}
+
+bool PDFRenderService::Job::isCancelled() const
+{
+    return std::all_of(requesters.cbegin(), requesters.cend(), [](const Requester& requester) { return requester.isCancelled(); });
+}
+
+void PDFRenderService::Job::finish(const QImage* image)
+{
+    for (Requester& requester : requesters)
+    {
+        if (image && !requester.isCancelled())
+        {
+            requester.promise->addResult(*image);
+        }
+        else
+        {
+            requester.promise->future().cancel();
+        }
+        requester.promise->finish();
+    }
+    requesters.clear();
+}
+
+PDFRenderService::PDFRenderService(const PDFDocument* document,
+                                   const PDFCMSSettings& cmsSettings,
+                                   int rasterizerCount,
+                                   RendererEngine rendererEngine,
+                                   QObject* parent) :
+    BaseClass(parent),
+    m_document(document),
+    m_optionalContentActivity(document, OCUsage::View, nullptr),
+    m_cmsManager(nullptr),
+    m_fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT)
+{
+    rasterizerCount = PDFRasterizerPool::getCorrectedRasterizerCount(rasterizerCount);
+
+    m_cmsManager.setDocument(document);
+    m_cmsManager.setSettings(cmsSettings);
+
+    // We can const-cast here, because we do not modify the document
+    m_fontCache.setDocument(PDFModifiedDocument(const_cast<PDFDocument*>(document), &m_optionalContentActivity));
+
+    m_rasterizerPool = std::make_unique<PDFRasterizerPool>(m_document, &m_fontCache, &m_cmsManager, &m_optionalContentActivity,
+                                                           PDFRenderer::getDefaultFeatures(), m_meshQualitySettings,
+                                                           rasterizerCount, rendererEngine, nullptr);
+    m_threadPool.setMaxThreadCount(rasterizerCount);
+}
+
+PDFRenderService::~PDFRenderService()
+{
+    cancelAll();
+    m_threadPool.waitForDone();
+}
+
+QFuture<QImage> PDFRenderService::render(const PDFRenderRequest& request, const PDFOperationControl* operationControl)
+{
+    Requester requester;
+    requester.promise = std::make_shared<QPromise<QImage>>();
+    requester.operationControl = operationControl;
+    requester.promise->start();
+    QFuture<QImage> future = requester.promise->future();
+
+    QMutexLocker lock(&m_mutex);
+
+    // Coalesce the request with the same pending or running request. Running job
+    // can't be already finished, because finished job is removed under the lock.
+    auto isSameImage = [&request](const std::shared_ptr<Job>& job) { return job->request.isSameImage(request); };
+    auto pendingIt = std::find_if(m_pendingJobs.begin(), m_pendingJobs.end(), isSameImage);
+    if (pendingIt != m_pendingJobs.end())
+    {
+        Job* job = pendingIt->get();
+        job->request.priority = qMax(job->request.priority, request.priority);
+        job->requesters.push_back(qMove(requester));
+        return future;
+    }
+
+    auto runningIt = std::find_if(m_runningJobs.begin(), m_runningJobs.end(), isSameImage);
+    if (runningIt != m_runningJobs.end())
+    {
+        (*runningIt)->requesters.push_back(qMove(requester));
+        return future;
+    }
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->request = request;
+    job->sequenceNumber = m_sequenceNumber++;
+    job->requesters.push_back(qMove(requester));
+    m_pendingJobs.push_back(qMove(job));
+
+    // Each started task renders the pending job with the highest priority
+    // at the time, when it is started, not the job created here.
+    m_threadPool.start([this]() { processNextJob(); });
+    return future;
+}
+
+void PDFRenderService::cancelAll()
+{
+    std::vector<std::shared_ptr<Job>> pendingJobs;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        pendingJobs = qMove(m_pendingJobs);
+        m_pendingJobs.clear();
+
+        for (const std::shared_ptr<Job>& job : m_runningJobs)
+        {
+            for (Requester& requester : job->requesters)
+            {
+                requester.promise->future().cancel();
+            }
+        }
+    }
+
+    for (const std::shared_ptr<Job>& job : pendingJobs)
+    {
+        job->finish(nullptr);
+    }
+}
+
+void PDFRenderService::waitForFinished()
+{
+    m_threadPool.waitForDone();
+}
+
+void PDFRenderService::setPrecompiledPageCache(PDFPrecompiledPageCache* precompiledPageCache)
+{
+    QMutexLocker lock(&m_mutex);
+    m_precompiledPageCache = precompiledPageCache;
+}
+
+void PDFRenderService::processNextJob()
+{
+    std::shared_ptr<Job> job;
+
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto compareJobs = [](const std::shared_ptr<Job>& left, const std::shared_ptr<Job>& right)
+        {
+            return std::make_pair(-left->request.priority, left->sequenceNumber) < std::make_pair(-right->request.priority, right->sequenceNumber);
+        };
+
+        auto it = std::min_element(m_pendingJobs.begin(), m_pendingJobs.end(), compareJobs);
+        if (it == m_pendingJobs.end())
+        {
+            // Jobs were cancelled
+            return;
+        }
+
+        job = *it;
+        m_pendingJobs.erase(it);
+        m_runningJobs.push_back(job);
+    }
+
+    QImage image = renderJob(job);
+
+    {
+        // Requesters can't be added after the job is removed from running jobs
+        QMutexLocker lock(&m_mutex);
+        m_runningJobs.erase(std::find(m_runningJobs.begin(), m_runningJobs.end(), job));
+    }
+
+    job->finish(!image.isNull() ? &image : nullptr);
+}
+
+QImage PDFRenderService::renderJob(const std::shared_ptr<Job>& job)
+{
+    JobOperationControl operationControl(this, job.get());
+    const PDFRenderRequest& request = job->request;
+
+    if (operationControl.isOperationCancelled())
+    {
+        return QImage();
+    }
+
+    const PDFPage* page = m_document->getCatalog()->getPage(request.pageIndex);
+    if (!page || request.size.isEmpty())
+    {
+        Q_EMIT renderError(request.pageIndex, PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Page %1 not found.").arg(request.pageIndex + 1)));
+        return QImage();
+    }
+
+    // Font cache must not be shrinked, while fonts are used by the page compiler
+    m_fontCache.setCacheShrinkEnabled(job.get(), false);
+    std::shared_ptr<const PDFPrecompiledPage> compiledPage = getCompiledPage(request.pageIndex, request.features, &operationControl);
+    m_fontCache.setCacheShrinkEnabled(job.get(), true);
+
+    if (!compiledPage || operationControl.isOperationCancelled())
+    {
+        return QImage();
+    }
+
+    // We can const-cast here, because we do not modify the document in annotation manager.
+    // Annotations are just rendered to the target picture.
+    PDFModifiedDocument modifiedDocument(const_cast<PDFDocument*>(m_document), &m_optionalContentActivity);
+    PDFAnnotationManager annotationManager(&m_fontCache, &m_cmsManager, &m_optionalContentActivity, m_meshQualitySettings, request.features, PDFAnnotationManager::Target::View, nullptr);
+    annotationManager.setDocument(modifiedDocument);
+
+    PDFCMSPointer cms = m_cmsManager.getCurrentCMS();
+    PDFRasterizer* rasterizer = m_rasterizerPool->acquire();
+    QImage image = rasterizer->render(request.pageIndex, page, compiledPage.get(), request.size, request.features, &annotationManager, cms.data(), request.rotation, &m_optionalContentActivity);
+    m_rasterizerPool->release(rasterizer);
+
+    return image;
+}
+
+std::shared_ptr<const PDFPrecompiledPage> PDFRenderService::getCompiledPage(PDFInteger pageIndex,
+                                                                            PDFRenderer::Features features,
+                                                                            const PDFOperationControl* operationControl)
+{
+    PDFPrecompiledPageCache* precompiledPageCache = nullptr;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        auto it = std::find_if(m_compiledPages.begin(), m_compiledPages.end(), [&](const CompiledPage& item) { return item.pageIndex == pageIndex && item.features == features; });
+        if (it != m_compiledPages.end())
+        {
+            m_compiledPages.splice(m_compiledPages.begin(), m_compiledPages, it);
+            return m_compiledPages.front().page;
+        }
+
+        precompiledPageCache = m_precompiledPageCache;
+    }
+
+    std::shared_ptr<PDFPrecompiledPage> compiledPage = std::make_shared<PDFPrecompiledPage>();
+    PDFCMSPointer cms = m_cmsManager.getCurrentCMS();
+    QByteArray rendererKey;
+
+    if (precompiledPageCache)
+    {
+        rendererKey = PDFPrecompiledPageCache::createRendererKey(m_document, features, m_cmsManager.getSettings(), m_meshQualitySettings, &m_optionalContentActivity);
+    }
+
+    if (!precompiledPageCache || !precompiledPageCache->load(m_document, rendererKey, pageIndex, compiledPage.get()))
+    {
+        PDFRenderer renderer(m_document, &m_fontCache, cms.data(), &m_optionalContentActivity, features, m_meshQualitySettings);
+        renderer.setOperationControl(operationControl);
+        renderer.compile(compiledPage.get(), pageIndex);
+
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            // Compiled page is incomplete, it can't be cached
+            return nullptr;
+        }
+
+        if (precompiledPageCache)
+        {
+            precompiledPageCache->store(m_document, rendererKey, pageIndex, *compiledPage);
+        }
+    }
+
+    for (const PDFRenderError& error : compiledPage->getErrors())
+    {
+        Q_EMIT renderError(pageIndex, error);
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_compiledPages.push_front(CompiledPage{ pageIndex, features, compiledPage });
+    m_compiledPagesMemory += compiledPage->getMemoryConsumptionEstimate();
+
+    // Remove least recently used pages, the most recent page is always kept
+    while (m_compiledPagesMemory > COMPILED_PAGE_CACHE_LIMIT && m_compiledPages.size() > 1)
+    {
+        m_compiledPagesMemory -= m_compiledPages.back().page->getMemoryConsumptionEstimate();
+        m_compiledPages.pop_back();
+    }
+
+    return compiledPage;
+}
+
+}   // namespace pdf
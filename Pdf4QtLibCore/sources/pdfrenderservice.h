@@ -0,0 +1,179 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFRENDERSERVICE_H
+#define PDFRENDERSERVICE_H
+
+#include "pdfrenderer.h"
+#include "pdffont.h"
+#include "pdfcms.h"
+#include "pdfoptionalcontent.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QImage>
+#include <QFuture>
+#include <QPromise>
+#include <QThreadPool>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace pdf
+{
+class PDFPrecompiledPageCache;
+
+/// Request to render the page image
+struct PDFRenderRequest
+{
+    PDFInteger pageIndex = 0;
+    QSize size;
+    PDFRenderer::Features features = PDFRenderer::getDefaultFeatures();
+    PageRotation rotation = PageRotation::None;
+
+    /// Requests with higher priority are rendered first, requests
+    /// with the same priority are rendered in the order of arrival.
+    int priority = 0;
+
+    /// Returns true, if both requests render the same image
+    /// (they differ at most in the priority).
+    bool isSameImage(const PDFRenderRequest& other) const;
+};
+
+/// Asynchronous page rendering service for applications embedding the library.
+/// Service owns everything needed to render pages of the document (font cache,
+/// color management, optional content activity, rasterizers and cache of compiled
+/// pages), requests are rendered in the background thread pool and results are
+/// returned as futures. Pending requests are rendered in the order of their priority.
+/// Requests of the same image are coalesced, so the image is rendered only once,
+/// each requester gets its own future. Request is cancelled, if all its requesters
+/// cancelled it - either by cancelling the returned future, or by their operation
+/// control. Cancelled request is not rendered, or its compilation is stopped,
+/// and future is finished without a result.
+/// \note Construct this object only in main GUI thread
+class PDF4QTLIBCORESHARED_EXPORT PDFRenderService : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    /// Creates new render service. Document must exist, until the service is destroyed.
+    /// \param document Document
+    /// \param cmsSettings Color management system settings
+    /// \param rasterizerCount Number of rasterizers (and rendering threads)
+    /// \param rendererEngine Renderer engine
+    /// \param parent Parent object
+    explicit PDFRenderService(const PDFDocument* document,
+                              const PDFCMSSettings& cmsSettings,
+                              int rasterizerCount,
+                              RendererEngine rendererEngine,
+                              QObject* parent);
+
+    /// Cancels all requests and waits for the running renderings
+    virtual ~PDFRenderService() override;
+
+    /// Requests rendering of the page image. This function is thread safe.
+    /// \param request Render request
+    /// \param operationControl Operation control, which can cancel the request (can be nullptr),
+    ///        it must exist, until returned future is finished
+    QFuture<QImage> render(const PDFRenderRequest& request, const PDFOperationControl* operationControl = nullptr);
+
+    /// Cancels all requests, which are not yet rendered
+    void cancelAll();
+
+    /// Waits, until all requests are finished
+    void waitForFinished();
+
+    /// Sets persistent cache of precompiled pages, which is used, if
+    /// page is not found in the memory cache (pass nullptr to disable it).
+    /// \param precompiledPageCache Precompiled page cache
+    void setPrecompiledPageCache(PDFPrecompiledPageCache* precompiledPageCache);
+
+signals:
+    void renderError(PDFInteger pageIndex, PDFRenderError error);
+
+private:
+    /// Memory limit of the compiled pages kept in the memory
+    static constexpr qint64 COMPILED_PAGE_CACHE_LIMIT = 128 * 1024 * 1024;
+
+    class JobOperationControl;
+
+    struct Requester
+    {
+        std::shared_ptr<QPromise<QImage>> promise;
+        const PDFOperationControl* operationControl = nullptr;
+
+        bool isCancelled() const;
+    };
+
+    struct Job
+    {
+        PDFRenderRequest request;
+        quint64 sequenceNumber = 0;
+        std::vector<Requester> requesters;
+
+        bool isCancelled() const;
+        void finish(const QImage* image);
+    };
+
+    struct CompiledPage
+    {
+        PDFInteger pageIndex = 0;
+        PDFRenderer::Features features;
+        std::shared_ptr<const PDFPrecompiledPage> page;
+    };
+
+    /// Takes the pending job with the highest priority and renders it
+    void processNextJob();
+
+    /// Renders the image of the job, returns null image, if job was cancelled
+    QImage renderJob(const std::shared_ptr<Job>& job);
+
+    /// Returns compiled page from the cache, or compiles it
+    std::shared_ptr<const PDFPrecompiledPage> getCompiledPage(PDFInteger pageIndex,
+                                                              PDFRenderer::Features features,
+                                                              const PDFOperationControl* operationControl);
+
+    const PDFDocument* m_document;
+    PDFMeshQualitySettings m_meshQualitySettings;
+    PDFOptionalContentActivity m_optionalContentActivity;
+    PDFCMSManager m_cmsManager;
+    PDFFontCache m_fontCache;
+    std::unique_ptr<PDFRasterizerPool> m_rasterizerPool;
+    PDFPrecompiledPageCache* m_precompiledPageCache = nullptr;
+
+    /// Mutex protecting jobs and compiled pages
+    mutable QMutex m_mutex;
+    quint64 m_sequenceNumber = 0;
+    std::vector<std::shared_ptr<Job>> m_pendingJobs;
+    std::vector<std::shared_ptr<Job>> m_runningJobs;
+
+    /// Compiled pages, most recently used is the first one
+    std::list<CompiledPage> m_compiledPages;
+    qint64 m_compiledPagesMemory = 0;
+
+    /// Thread pool, it must be destroyed first, because running jobs
+    /// use other members of this object.
+    QThreadPool m_threadPool;
+};
+
+}   // namespace pdf
+
+#endif // PDFRENDERSERVICE_H
@@ -204,7 +204,7 @@ void PDFDecryptOrEncryptObjectVisitor::visitStream(const PDFStream* stream)
 
     if (isMetadata && !m_securityHandler->isMetadataEncrypted())
     {
-        m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(PDFDictionary(*dictionary), QByteArray(*stream->getContent()))));
+        m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(PDFDictionary(*dictionary), QByteArray(*stream->getContent()), stream->getContentOwner())));
         return;
     }
 
@@ -265,7 +265,9 @@ void PDFDecryptOrEncryptObjectVisitor::visitStream(const PDFStream* stream)
 
     }
 
-    m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(qMove(processedDictionary), qMove(processedData))));
+    // Processed data can still reference original data (for example, if data
+    // were not decrypted), so we must keep the content owner.
+    m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(qMove(processedDictionary), qMove(processedData), stream->getContentOwner())));
 }
 
 void PDFDecryptOrEncryptObjectVisitor::visitReference(const PDFObjectReference reference)
@@ -854,56 +856,117 @@ std::vector<uint8_t> PDFStandardOrPublicSecurityHandler::createAESV2_ObjectEncry
     return objectEncryptionKey;
 }
 
-QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArray& data, CryptFilter filter, PDFObjectReference reference) const
+bool PDFStandardOrPublicSecurityHandler::transformAES_CBC(const unsigned char* key, int keyLength, const unsigned char* initializationVector, const char* data, int size, bool encrypt, bool padding, QByteArray& output)
 {
-    QByteArray decryptedData;
+    const EVP_CIPHER* cipher = nullptr;
+    switch (keyLength)
+    {
+        case 16:
+            cipher = EVP_aes_128_cbc();
+            break;
 
-    Q_ASSERT(m_authorizationData.isAuthorized());
+        case 24:
+            cipher = EVP_aes_192_cbc();
+            break;
+
+        case 32:
+            cipher = EVP_aes_256_cbc();
+            break;
+
+        default:
+            return false;
+    }
 
-    struct AES_data
+    // EVP interface uses hardware accelerated implementation
+    // of AES (for example, AES-NI), if it is available. Padding of the EVP
+    // interface (PKCS#5) is the same, as padding required by the specification.
+    openssl_ptr<EVP_CIPHER_CTX> context(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+    if (!context || !EVP_CipherInit_ex(context.get(), cipher, nullptr, key, initializationVector, encrypt ? 1 : 0))
     {
-        QByteArray initializationVector;
-        QByteArray paddedData;
-    };
+        return false;
+    }
 
-    auto prepareAES_data = [](const QByteArray& data)
+    EVP_CIPHER_CTX_set_padding(context.get(), padding ? 1 : 0);
+
+    const int offset = output.size();
+    output.resize(offset + size + AES_BLOCK_SIZE);
+    unsigned char* outputData = convertByteArrayToUcharPtr(output) + offset;
+
+    int outputLength = 0;
+    int finalLength = 0;
+    if (!EVP_CipherUpdate(context.get(), outputData, &outputLength, reinterpret_cast<const unsigned char*>(data), size) ||
+        !EVP_CipherFinal_ex(context.get(), outputData + outputLength, &finalLength))
     {
-        AES_data result;
+        output.resize(offset);
+        return false;
+    }
 
-        result.initializationVector = data.left(AES_BLOCK_SIZE);
+    output.resize(offset + outputLength + finalLength);
+    return true;
+}
 
-        // This is an error. But to handle it, we resize the vector
-        // with arbitrary data.
-        if (result.initializationVector.size() < AES_BLOCK_SIZE)
-        {
-            result.initializationVector.resize(AES_BLOCK_SIZE);
-        }
+QByteArray PDFStandardOrPublicSecurityHandler::encryptAES(const unsigned char* key, int keyLength, const QByteArray& data)
+{
+    // Generator is seeded only once per thread, because secure seeding is expensive
+    // and we encrypt each string and stream separately (in parallel).
+    thread_local QRandomGenerator randomNumberGenerator = QRandomGenerator::securelySeeded();
 
-        result.paddedData = data.mid(AES_BLOCK_SIZE);
+    std::array<unsigned char, AES_BLOCK_SIZE> initializationVector = { };
+    for (unsigned char& value : initializationVector)
+    {
+        value = uint8_t(randomNumberGenerator.generate());
+    }
+
+    // Encrypted data are written directly after the initialization vector
+    QByteArray result;
+    result.reserve(AES_BLOCK_SIZE + data.size() + AES_BLOCK_SIZE);
+    result.append(reinterpret_cast<const char*>(initializationVector.data()), AES_BLOCK_SIZE);
+
+    if (!transformAES_CBC(key, keyLength, initializationVector.data(), data.constData(), data.size(), true, true, result))
+    {
+        return QByteArray();
+    }
+
+    return result;
+}
+
+QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArray& data, CryptFilter filter, PDFObjectReference reference) const
+{
+    QByteArray decryptedData;
+
+    Q_ASSERT(m_authorizationData.isAuthorized());
+
+    // Decrypts data, initialization vector is stored in the first 16 bytes. Data
+    // are not copied, they are decrypted directly from the source buffer.
+    auto decryptAES = [&data](const unsigned char* key, int keyLength)
+    {
+        std::array<unsigned char, AES_BLOCK_SIZE> initializationVector = { };
+
+        // If initialization vector is incomplete, it is an error. But to handle it,
+        // we pad the vector with zeroes.
+        std::copy_n(data.constData(), qMin<int>(data.size(), AES_BLOCK_SIZE), initializationVector.begin());
 
         // Remove errorneous data - we must have a data of multiple of AES_BLOCK_SIZE
-        const int remainder = result.paddedData.size() % AES_BLOCK_SIZE;
-        if (remainder != 0)
+        const int paddedDataSize = qMax(int(data.size()) - AES_BLOCK_SIZE, 0);
+        const int alignedDataSize = paddedDataSize - paddedDataSize % AES_BLOCK_SIZE;
+        if (alignedDataSize == 0)
         {
-            result.paddedData = result.paddedData.left(result.paddedData.size() - remainder);
+            return QByteArray();
         }
 
-        return result;
-    };
+        QByteArray result;
+        transformAES_CBC(key, keyLength, initializationVector.data(), data.constData() + AES_BLOCK_SIZE, alignedDataSize, false, false, result);
 
-    auto removeAES_padding = [](const QByteArray& data)
-    {
-        if (data.isEmpty())
+        if (!result.isEmpty())
         {
-            return data;
+            // If padding doesnt fit from 1 to AES_BLOCK_SIZE, then it is
+            // an error, but just clamp the value.
+            const int padding = static_cast<unsigned char>(result.back());
+            const int clampedPadding = qBound(1, padding, AES_BLOCK_SIZE);
+            result.chop(clampedPadding);
         }
 
-        // If padding doesnt fit from 1 to AES_BLOCK_SIZE, then it is
-        // an error, but just clamp the value.
-        const int padding = data.back();
-        const int clampedPadding = qBound(1, padding, AES_BLOCK_SIZE);
-
-        return data.left(data.size() - clampedPadding);
+        return result;
     };
 
     switch (filter.type)
@@ -918,6 +981,8 @@ QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArr
 
         case CryptFilterType::V2:         // Use file encryption key for RC4 algorithm
         {
+            // RC4 is available only in the legacy provider of OpenSSL 3 EVP interface,
+            // so we use the low level interface.
             std::vector<uint8_t> objectEncryptionKey = createV2_ObjectEncryptionKey(reference, filter);
             decryptedData.resize(data.size());
 
@@ -930,38 +995,16 @@ QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArr
 
         case CryptFilterType::AESV2:      // Use file encryption key for AES algorithm
         {
-            std::vector<uint8_t> objectEncryptionKey = createAESV2_ObjectEncryptionKey(reference);
-
             // For AES algorithm, always use 16 bytes key (128 bit encryption mode)
-
-            AES_KEY key = { };
-            AES_set_decrypt_key(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                decryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(decryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_DECRYPT);
-                decryptedData = removeAES_padding(decryptedData);
-            }
-
+            std::vector<uint8_t> objectEncryptionKey = createAESV2_ObjectEncryptionKey(reference);
+            decryptedData = decryptAES(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()));
             break;
         }
 
         case CryptFilterType::AESV3:      // Use file encryption key for AES 256 bit algorithm
         {
             Q_ASSERT(m_authorizationData.fileEncryptionKey.size() == 32);
-            AES_KEY key = { };
-            AES_set_decrypt_key(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                decryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(decryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_DECRYPT);
-                decryptedData = removeAES_padding(decryptedData);
-            }
-
+            decryptedData = decryptAES(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()));
             break;
         }
 
@@ -981,39 +1024,6 @@ QByteArray PDFStandardOrPublicSecurityHandler::encryptUsingFilter(const QByteArr
 
     Q_ASSERT(m_authorizationData.isAuthorized());
 
-    struct AES_data
-    {
-        QByteArray initializationVector;
-        QByteArray paddedData;
-    };
-
-    auto prepareAES_data = [](const QByteArray& data)
-    {
-        AES_data result;
-
-        QRandomGenerator randomNumberGenerator = QRandomGenerator::securelySeeded();
-
-        result.initializationVector.resize(AES_BLOCK_SIZE);
-        for (int i = 0; i < AES_BLOCK_SIZE; ++i)
-        {
-            result.initializationVector[i] = uint8_t(randomNumberGenerator.generate());
-        }
-
-        result.paddedData = data;
-
-        // Add padding remainder according to the specification
-        int size = data.size();
-        const int paddingRemainder = AES_BLOCK_SIZE - (size % AES_BLOCK_SIZE);
-
-        result.initializationVector.reserve(result.initializationVector.size() + paddingRemainder);
-        for (int i = 0; i < paddingRemainder; ++i)
-        {
-            result.paddedData.push_back(paddingRemainder);
-        }
-
-        return result;
-    };
-
     switch (filter.type)
     {
         case CryptFilterType::None:       // The application shall encrypt the data using the security handler
@@ -1039,40 +1049,16 @@ QByteArray PDFStandardOrPublicSecurityHandler::encryptUsingFilter(const QByteArr
 
         case CryptFilterType::AESV2:      // Use file encryption key for AES algorithm
         {
-            std::vector<uint8_t> objectEncryptionKey = createAESV2_ObjectEncryptionKey(reference);
-
             // For AES algorithm, always use 16 bytes key (128 bit encryption mode)
-
-            AES_KEY key = { };
-            AES_set_encrypt_key(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                QByteArray initializationVectorCopy = aes_data.initializationVector;
-                encryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(encryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_ENCRYPT);
-                encryptedData.prepend(initializationVectorCopy);
-            }
-
+            std::vector<uint8_t> objectEncryptionKey = createAESV2_ObjectEncryptionKey(reference);
+            encryptedData = encryptAES(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()), data);
             break;
         }
 
         case CryptFilterType::AESV3:      // Use file encryption key for AES 256 bit algorithm
         {
             Q_ASSERT(m_authorizationData.fileEncryptionKey.size() == 32);
-            AES_KEY key = { };
-            AES_set_encrypt_key(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                QByteArray initializationVectorCopy = aes_data.initializationVector;
-                encryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(encryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_ENCRYPT);
-                encryptedData.prepend(initializationVectorCopy);
-            }
-
+            encryptedData = encryptAES(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()), data);
             break;
         }
 
@@ -305,6 +305,27 @@ protected:
     /// \returns Encrypted data
     QByteArray encryptUsingFilter(const QByteArray& data, CryptFilter filter, PDFObjectReference reference) const;
 
+    /// Encrypts or decrypts data using AES algorithm in CBC mode and appends the
+    /// result to the \p output. If padding is not used, size of the data must be
+    /// multiple of the block size. AES variant (128, 192 or 256 bit) is determined
+    /// by the key length. Returns false, if transformation fails.
+    /// \param key Key
+    /// \param keyLength Length of the key in bytes
+    /// \param initializationVector Initialization vector (16 bytes)
+    /// \param data Data to be encrypted or decrypted
+    /// \param size Size of the data
+    /// \param encrypt Encrypt (true), or decrypt (false)
+    /// \param padding Add (when encrypting) padding according to the PDF specification
+    /// \param output Output buffer, to which result is appended
+    static bool transformAES_CBC(const unsigned char* key, int keyLength, const unsigned char* initializationVector, const char* data, int size, bool encrypt, bool padding, QByteArray& output);
+
+    /// Encrypts data using AES algorithm with random initialization vector.
+    /// Result contains initialization vector followed by encrypted padded data.
+    /// \param key Key
+    /// \param keyLength Length of the key in bytes
+    /// \param data Data to be encrypted
+    static QByteArray encryptAES(const unsigned char* key, int keyLength, const QByteArray& data);
+
     /// Returns true, if character with unicode code is non-ascii space character
     /// according the RFC 3454, section C.1.2
     /// \param unicode Unicode code to be tested
@@ -0,0 +1,161 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfsharedcontentcache.h"
+#include "pdfpainter.h"
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+bool PDFSharedContentCache::Key::isSameContent(const Key& other) const
+{
+    return stream == other.stream &&
+           cmsSerialNumber == other.cmsSerialNumber &&
+           features == other.features &&
+           isDraftImagesEnabled == other.isDraftImagesEnabled &&
+           isOptionalContentRecordingEnabled == other.isOptionalContentRecordingEnabled &&
+           meshQualityRatios == other.meshQualityRatios &&
+           meshColorTolerance == other.meshColorTolerance &&
+           meshPatchTestPoints == other.meshPatchTestPoints &&
+           meshGradientStopCount == other.meshGradientStopCount &&
+           optionalContentReferences == other.optionalContentReferences &&
+           state.getDifferenceFlags(other.state) == PDFPageContentProcessorState::StateUnchanged;
+}
+
+PDFSharedContentCache::PDFSharedContentCache(qint64 memoryLimit) :
+    PDFMemoryBudgetClient("shared-content-cache", 2, memoryLimit)
+{
+    registerMemoryBudgetClient();
+}
+
+PDFSharedContentCache::~PDFSharedContentCache()
+{
+    unregisterMemoryBudgetClient();
+}
+
+std::shared_ptr<const PDFPrecompiledPage> PDFSharedContentCache::find(const Key& key) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = findItem(key);
+    if (it == m_itemMap.cend())
+    {
+        return nullptr;
+    }
+
+    // Move item to the front, it is now most recently used
+    m_items.splice(m_items.begin(), m_items, it->second);
+    return it->second->content;
+}
+
+void PDFSharedContentCache::insert(Key key, std::shared_ptr<const void> owner, std::shared_ptr<const PDFPrecompiledPage> content)
+{
+    if (!owner || !content)
+    {
+        return;
+    }
+
+    const qint64 memoryConsumption = content->getMemoryConsumptionEstimate();
+    const PDFStream* stream = key.stream;
+
+    QMutexLocker lock(&m_mutex);
+
+    if (memoryConsumption > getMemoryLimit() ||
+        m_itemMap.count(stream) >= MAX_VARIANT_COUNT ||
+        findItem(key) != m_itemMap.cend())
+    {
+        return;
+    }
+
+    m_items.push_front(Item{ qMove(key), qMove(owner), qMove(content), memoryConsumption });
+    m_itemMap.emplace(stream, m_items.begin());
+    m_memoryConsumption += memoryConsumption;
+    shrink();
+
+    const qint64 totalMemoryConsumption = m_memoryConsumption;
+    lock.unlock();
+
+    reportMemoryConsumption(totalMemoryConsumption);
+}
+
+void PDFSharedContentCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_itemMap.clear();
+    m_items.clear();
+    m_memoryConsumption = 0;
+    lock.unlock();
+
+    setMemoryConsumption(0);
+}
+
+qint64 PDFSharedContentCache::getMemoryConsumption() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryConsumption;
+}
+
+PDFSharedContentCache::ItemMap::const_iterator PDFSharedContentCache::findItem(const Key& key) const
+{
+    auto range = m_itemMap.equal_range(key.stream);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->key.isSameContent(key))
+        {
+            return it;
+        }
+    }
+
+    return m_itemMap.cend();
+}
+
+void PDFSharedContentCache::shrink()
+{
+    while (m_memoryConsumption > getMemoryLimit() && !m_items.empty())
+    {
+        auto itemIt = std::prev(m_items.end());
+        auto range = m_itemMap.equal_range(itemIt->key.stream);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == itemIt)
+            {
+                m_itemMap.erase(it);
+                break;
+            }
+        }
+
+        m_memoryConsumption -= itemIt->memoryConsumption;
+        m_items.erase(itemIt);
+    }
+}
+
+void PDFSharedContentCache::trimMemory()
+{
+    qint64 memoryConsumption = 0;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        shrink();
+        memoryConsumption = m_memoryConsumption;
+    }
+
+    setMemoryConsumption(memoryConsumption);
+}
+
+}   // namespace pdf
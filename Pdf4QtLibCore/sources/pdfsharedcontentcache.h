@@ -0,0 +1,132 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFSHAREDCONTENTCACHE_H
+#define PDFSHAREDCONTENTCACHE_H
+
+#include "pdfglobal.h"
+#include "pdfmemorybudget.h"
+#include "pdfpagecontentprocessor.h"
+
+#include <QMutex>
+
+#include <list>
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+namespace pdf
+{
+class PDFStream;
+class PDFPrecompiledPage;
+
+/// Thread safe cache of compiled content of form XObjects, which are placed
+/// on many pages at the same place (for example, headers, footers, logos or
+/// watermarks). Content of the form is compiled only once, other pages copy
+/// the compiled drawing instructions. Compiled content depends on the graphic
+/// state, in which the form is painted, so the graphic state (including current
+/// transformation matrix) is part of the key, together with settings of the
+/// page compiler. Each stream can have a few variants of compiled content.
+/// Items hold the stream of the form, so an item can't be mistaken for
+/// another stream allocated at the same address. Memory consumption is limited,
+/// least recently used items are removed first. Memory limit is assigned
+/// by the global memory budget, if the budget is set.
+class PDF4QTLIBCORESHARED_EXPORT PDFSharedContentCache : public PDFMemoryBudgetClient
+{
+public:
+    /// Default memory limit of the cache (in bytes)
+    static constexpr const qint64 DEFAULT_MEMORY_LIMIT = 32 * 1024 * 1024;
+
+    /// Maximal number of variants of compiled content of one stream
+    static constexpr const size_t MAX_VARIANT_COUNT = 8;
+
+    explicit PDFSharedContentCache(qint64 memoryLimit = DEFAULT_MEMORY_LIMIT);
+    virtual ~PDFSharedContentCache() override;
+
+    PDFSharedContentCache(const PDFSharedContentCache&) = delete;
+    PDFSharedContentCache& operator=(const PDFSharedContentCache&) = delete;
+
+    /// Identification of the compiled content of the form
+    struct Key
+    {
+        /// Returns true, if compiled content of both keys is the same
+        bool isSameContent(const Key& other) const;
+
+        const PDFStream* stream = nullptr;
+        quint64 cmsSerialNumber = 0;
+        qint32 features = 0;
+        bool isDraftImagesEnabled = false;
+        bool isOptionalContentRecordingEnabled = false;
+        std::array<PDFReal, 4> meshQualityRatios = { };
+        PDFReal meshColorTolerance = 0.0;
+        PDFInteger meshPatchTestPoints = 0;
+        PDFInteger meshGradientStopCount = 0;
+        std::vector<PDFObjectReference> optionalContentReferences;
+        PDFPageContentProcessorState state;
+    };
+
+    /// Tries to find compiled content identified by \p key. If content
+    /// is not found, nullptr is returned.
+    /// \param key Key
+    std::shared_ptr<const PDFPrecompiledPage> find(const Key& key) const;
+
+    /// Inserts compiled content into the cache. If owner is nullptr, stream has
+    /// too many variants, or compiled content is too large, then nothing is inserted.
+    /// \param key Key
+    /// \param owner Object, which keeps the stream alive
+    /// \param content Compiled content
+    void insert(Key key, std::shared_ptr<const void> owner, std::shared_ptr<const PDFPrecompiledPage> content);
+
+    /// Removes all items from the cache
+    void clear();
+
+    /// Returns memory consumption of the cache (in bytes)
+    qint64 getMemoryConsumption() const;
+
+protected:
+    virtual void trimMemory() override;
+
+private:
+    struct Item
+    {
+        Key key;
+        std::shared_ptr<const void> owner;
+        std::shared_ptr<const PDFPrecompiledPage> content;
+        qint64 memoryConsumption = 0;
+    };
+
+    using Items = std::list<Item>;
+    using ItemMap = std::unordered_multimap<const PDFStream*, Items::iterator>;
+
+    /// Removes least recently used items, until memory limit is met
+    void shrink();
+
+    /// Returns iterator to the item map, which refers to the item with
+    /// the same content as \p key, or end iterator, if item is not found.
+    ItemMap::const_iterator findItem(const Key& key) const;
+
+    mutable QMutex m_mutex;
+    mutable Items m_items;
+    ItemMap m_itemMap;
+    qint64 m_memoryConsumption = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFSHAREDCONTENTCACHE_H
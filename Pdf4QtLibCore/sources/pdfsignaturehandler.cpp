@@ -21,6 +21,7 @@
 #include "pdfform.h"
 #include "pdfutils.h"
 #include "pdfsignaturehandler_impl.h"
+#include "pdfexecutionpolicy.h"
 
 #if defined(PDF4QT_COMPILER_MINGW) || defined(PDF4QT_COMPILER_GCC)
 #pragma GCC diagnostic push
@@ -200,13 +201,16 @@ std::vector<PDFSignatureVerificationResult> PDFSignatureHandler::verifySignature
             }
         };
         form.apply(getSignatureFields);
-        result.reserve(signatureFields.size());
+        result.resize(signatureFields.size());
 
-        for (const PDFFormFieldSignature* signatureField : signatureFields)
+        // Signatures are independent, so we verify them in parallel.
+        // Trusted certificate store is shared between them.
+        auto verifySignature = [&](size_t index)
         {
+            const PDFFormFieldSignature* signatureField = signatureFields[index];
             if (const PDFSignatureHandler* signatureHandler = createHandler(signatureField, sourceData, parameters))
             {
-                result.emplace_back(signatureHandler->verify());
+                result[index] = signatureHandler->verify();
                 delete signatureHandler;
             }
             else
@@ -215,9 +219,12 @@ std::vector<PDFSignatureVerificationResult> PDFSignatureHandler::verifySignature
                 QString qualifiedName = signatureField->getName(PDFFormField::NameType::FullyQualified);
                 PDFSignatureVerificationResult verificationResult(signatureField->getSignature().getType(), signatureFieldReference, qMove(qualifiedName));
                 verificationResult.addNoHandlerError(signatureField->getSignature().getSubfilter());
-                result.emplace_back(qMove(verificationResult));
+                result[index] = qMove(verificationResult);
             }
-        }
+        };
+
+        PDFIntegerRange<size_t> indices(0, signatureFields.size());
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, indices.begin(), indices.end(), verifySignature);
     }
 
     return result;
@@ -531,7 +538,7 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
-        X509_STORE* store = X509_STORE_new();
+        X509_STORE* store = getTrustedCertificateStore();
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
         // Above functions can fail only if not enough memory. But in this
@@ -539,8 +546,6 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
         Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         STACK_OF(PKCS7_SIGNER_INFO)* signerInfo = PKCS7_get_signer_info(pkcs7);
         const int signerInfoCount = sk_PKCS7_SIGNER_INFO_num(signerInfo);
         STACK_OF(X509)* certificates = getCertificates(pkcs7);
@@ -653,7 +658,152 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
     }
 }
 
+namespace
+{
+
+/// State of the BIO reading signed data ranges in place
+struct PDFSignedDataBIOState
+{
+    std::vector<std::pair<const char*, int>> ranges;
+    size_t rangeIndex = 0;
+    int rangeOffset = 0;
+};
+
+int signedDataBIORead(BIO* bio, char* buffer, int length)
+{
+    PDFSignedDataBIOState* state = static_cast<PDFSignedDataBIOState*>(BIO_get_data(bio));
+
+    int bytesRead = 0;
+    while (bytesRead < length && state->rangeIndex < state->ranges.size())
+    {
+        const auto& range = state->ranges[state->rangeIndex];
+        const int bytesToCopy = qMin(length - bytesRead, range.second - state->rangeOffset);
+        std::copy(range.first + state->rangeOffset, range.first + state->rangeOffset + bytesToCopy, buffer + bytesRead);
+        bytesRead += bytesToCopy;
+        state->rangeOffset += bytesToCopy;
+
+        if (state->rangeOffset == range.second)
+        {
+            ++state->rangeIndex;
+            state->rangeOffset = 0;
+        }
+    }
+
+    return bytesRead;
+}
+
+long signedDataBIOControl(BIO* bio, int command, long number, void* pointer)
+{
+    Q_UNUSED(number);
+    Q_UNUSED(pointer);
+
+    PDFSignedDataBIOState* state = static_cast<PDFSignedDataBIOState*>(BIO_get_data(bio));
+
+    switch (command)
+    {
+        case BIO_CTRL_EOF:
+            return state->rangeIndex >= state->ranges.size() ? 1 : 0;
+
+        case BIO_CTRL_PENDING:
+        {
+            long pending = 0;
+            for (size_t i = state->rangeIndex; i < state->ranges.size(); ++i)
+            {
+                pending += state->ranges[i].second;
+            }
+            return pending - state->rangeOffset;
+        }
+
+        case BIO_CTRL_FLUSH:
+            return 1;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+int signedDataBIODestroy(BIO* bio)
+{
+    delete static_cast<PDFSignedDataBIOState*>(BIO_get_data(bio));
+    BIO_set_data(bio, nullptr);
+    BIO_set_init(bio, 0);
+    return 1;
+}
+
+const BIO_METHOD* getSignedDataBIOMethod()
+{
+    static BIO_METHOD* method = []()
+    {
+        BIO_METHOD* bioMethod = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "PDF signed data");
+        BIO_meth_set_read(bioMethod, &signedDataBIORead);
+        BIO_meth_set_ctrl(bioMethod, &signedDataBIOControl);
+        BIO_meth_set_destroy(bioMethod, &signedDataBIODestroy);
+        return bioMethod;
+    }();
+
+    return method;
+}
+
+}   // namespace
+
+BIO* PDFPublicKeySignatureHandler::createSignedDataBIO(const SignedDataRanges& ranges)
+{
+    BIO* bio = BIO_new(getSignedDataBIOMethod());
+
+    if (bio)
+    {
+        PDFSignedDataBIOState* state = new PDFSignedDataBIOState();
+        state->ranges = ranges;
+        BIO_set_data(bio, state);
+        BIO_set_init(bio, 1);
+    }
+
+    return bio;
+}
+
+bool PDFPublicKeySignatureHandler::getSignedDataDigest(const SignedDataRanges& ranges, const EVP_MD* md, QByteArray& digest)
+{
+    openssl_ptr<EVP_MD_CTX> context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    if (!context || !EVP_DigestInit_ex(context.get(), md, nullptr))
+    {
+        return false;
+    }
+
+    for (const SignedDataRange& range : ranges)
+    {
+        if (!EVP_DigestUpdate(context.get(), range.first, range.second))
+        {
+            return false;
+        }
+    }
+
+    unsigned int digestSize = EVP_MD_size(md);
+    digest.resize(digestSize);
+    if (!EVP_DigestFinal_ex(context.get(), convertByteArrayToUcharPtr(digest), &digestSize))
+    {
+        return false;
+    }
+
+    digest.resize(digestSize);
+    return true;
+}
+
 BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
+{
+    Q_UNUSED(outputBuffer);
+
+    SignedDataRanges ranges;
+    if (!getSignedDataRanges(result, ranges))
+    {
+        return nullptr;
+    }
+
+    return createSignedDataBIO(ranges);
+}
+
+bool PDFPublicKeySignatureHandler::getSignedDataRanges(PDFSignatureVerificationResult& result, SignedDataRanges& ranges) const
 {
     const PDFSignature& signature = m_signatureField->getSignature();
     const QByteArray& contents = signature.getContents();
@@ -670,12 +820,15 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
     if (size > sourceData.size())
     {
         result.addSignatureDataCoveredBySignatureMissingError();
-        return nullptr;
+        return false;
     }
 
     PDFClosedIntervalSet bytesCoveredBySignature;
 
-    outputBuffer.reserve(size);
+    // Signed data are not copied, we just remember the ranges
+    // in the source data, digest is calculated from them incrementally.
+    ranges.clear();
+    ranges.reserve(byteRanges.size());
     for (const PDFSignature::ByteRange& byteRange : byteRanges)
     {
         PDFInteger startOffset = byteRange.offset; // Offset to the first data byte
@@ -690,11 +843,11 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
         if (startOffset > endOffset || startOffset < 0 || endOffset < 0 || startOffset >= m_sourceData.size() || endOffset > m_sourceData.size())
         {
             result.addSignatureDataCoveredBySignatureMissingError();
-            return nullptr;
+            return false;
         }
 
         const int length = endOffset - startOffset;
-        outputBuffer.append(sourceData.constData() + startOffset, length);
+        ranges.emplace_back(sourceData.constData() + startOffset, length);
         bytesCoveredBySignature.addInterval(startOffset, endOffset - 1);
     }
 
@@ -732,7 +885,7 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
 
     result.setBytesCoveredBySignature(qMove(bytesCoveredBySignature));
 
-    return BIO_new_mem_buf(outputBuffer.data(), outputBuffer.length());
+    return true;
 }
 
 void PDFPublicKeySignatureHandler::verifySignature(PDFSignatureVerificationResult& result) const
@@ -880,14 +1033,12 @@ void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVeri
         QByteArray buffer;
         if (BIO* inputBuffer = getSignedDataBuffer(result, buffer))
         {
-            X509_STORE* store = X509_STORE_new();
+            X509_STORE* store = getTrustedCertificateStore();
 
             // Above function can fail only if not enough memory. But in this
             // case, this library will crash anyway.
             Q_ASSERT(store);
 
-            addTrustedCertificates(store);
-
             // Add certificates from DSS store
             STACK_OF(X509)* certificatesFromPkcs7 = getCertificates(pkcs7);
             STACK_OF(X509)* usedCertificates = sk_X509_new_null();
@@ -972,8 +1123,9 @@ void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVeri
     }
 }
 
-// This is protected by global mutex, but it is ugly
-static PDFSignatureVerificationResult* s_ETSI_currentResult = nullptr;
+// Verification callback has no user data, so current result is stored
+// per thread (signatures can be verified in parallel).
+static thread_local PDFSignatureVerificationResult* s_ETSI_currentResult = nullptr;
 
 int PDFSignatureHandler_ETSI_base::verifyCallback(int ok, X509_STORE_CTX* context)
 {
@@ -1064,7 +1216,7 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
-        X509_STORE* store = X509_STORE_new();
+        X509_STORE* store = getTrustedCertificateStore();
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
         // Above functions can fail only if not enough memory. But in this
@@ -1072,8 +1224,6 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
         Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         STACK_OF(PKCS7_SIGNER_INFO)* signerInfo = PKCS7_get_signer_info(pkcs7);
         const int signerInfoCount = sk_PKCS7_SIGNER_INFO_num(signerInfo);
         STACK_OF(X509)* certificates = getCertificates(pkcs7);
@@ -1102,7 +1252,9 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
             }
             STACK_OF(X509)* usedCertificates = allCertificates ? allCertificates : certificates;
 
-            // Jakub Melka: add certificate revocation lists
+            // Add certificate revocation lists. Trusted certificate store
+            // is shared, so lists are added to the verification context instead.
+            STACK_OF(X509_CRL)* crls = sk_X509_CRL_new_null();
             if (m_parameters.dss && !m_parameters.dss->getMasterItem()->CRL.empty())
             {
                 for (const QByteArray& crlData : m_parameters.dss->getMasterItem()->CRL)
@@ -1110,8 +1262,7 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
                     const unsigned char* crlDataBuffer = convertByteArrayToUcharPtr(crlData);
                     if (X509_CRL* crl = d2i_X509_CRL(nullptr, &crlDataBuffer, crlData.size()))
                     {
-                        X509_STORE_add_crl(store, crl);
-                        X509_CRL_free(crl);
+                        sk_X509_CRL_push(crls, crl);
                     }
                 }
             }
@@ -1134,6 +1285,8 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
                     break;
                 }
 
+                X509_STORE_CTX_set0_crls(context, crls);
+
                 if (!X509_STORE_CTX_set_purpose(context, purpose))
                 {
                     result.addCertificateGenericError();
@@ -1203,6 +1356,8 @@ void PDFSignatureHandler_ETSI_base::verifyCertificateCAdES(PDFSignatureVerificat
                 X509_STORE_CTX_cleanup(context);
             }
 
+            sk_X509_CRL_pop_free(crls, X509_CRL_free);
+
             if (allCertificates)
             {
                 for (int i = sk_X509_num(certificates); i < sk_X509_num(allCertificates); ++i)
@@ -1260,7 +1415,7 @@ X509* PDFSignatureHandler_adbe_pkcs7_rsa_sha1::createCertificate(size_t index) c
     return nullptr;
 }
 
-bool PDFSignatureHandler_adbe_pkcs7_rsa_sha1::getMessageDigest(const QByteArray& message,
+bool PDFSignatureHandler_adbe_pkcs7_rsa_sha1::getMessageDigest(const SignedDataRanges& ranges,
                                                                ASN1_OCTET_STRING* encryptedString,
                                                                RSA* rsa,
                                                                int& algorithmNID,
@@ -1273,18 +1428,7 @@ bool PDFSignatureHandler_adbe_pkcs7_rsa_sha1::getMessageDigest(const QByteArray&
 
     if (const EVP_MD* md = EVP_get_digestbynid(algorithmNID))
     {
-        unsigned int messageDigestSize = EVP_MD_size(md);
-        digest.resize(messageDigestSize);
-
-        EVP_MD_CTX* context = EVP_MD_CTX_new();
-        Q_ASSERT(context);
-
-        EVP_DigestInit(context, md);
-        EVP_DigestUpdate(context, message.constData(), message.size());
-        EVP_DigestFinal(context, convertByteArrayToUcharPtr(digest), &messageDigestSize);
-
-        EVP_MD_CTX_free(context);
-        return true;
+        return getSignedDataDigest(ranges, md, digest);
     }
 
     return false;
@@ -1343,7 +1487,7 @@ void PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verifyRSACertificate(PDFSignatureV
             }
         }
 
-        X509_STORE* store = X509_STORE_new();
+        X509_STORE* store = getTrustedCertificateStore();
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
         // Above functions can fail only if not enough memory. But in this
@@ -1351,8 +1495,6 @@ void PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verifyRSACertificate(PDFSignatureV
         Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         X509* signer = certificate;
         if (!X509_STORE_CTX_init(context, store, signer, certificates))
         {
@@ -1469,9 +1611,8 @@ void PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verifyRSASignature(PDFSignatureVer
         return;
     }
 
-    QByteArray outputBuffer;
-    openssl_ptr<BIO> bio(this->getSignedDataBuffer(result, outputBuffer), BIO_free_all);
-    if (bio)
+    SignedDataRanges ranges;
+    if (getSignedDataRanges(result, ranges))
     {
         const PDFSignature& signature = m_signatureField->getSignature();
         const QByteArray& signKey = signature.getContents();
@@ -1484,7 +1625,7 @@ void PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verifyRSASignature(PDFSignatureVer
         {
             int algorithmNID = NID_undef;
             QByteArray digestBuffer;
-            if (!getMessageDigest(outputBuffer, encryptedString.get(), rsa.get(), algorithmNID, digestBuffer))
+            if (!getMessageDigest(ranges, encryptedString.get(), rsa.get(), algorithmNID, digestBuffer))
             {
                 result.addSignatureDataOtherError();
                 return;
@@ -1540,13 +1681,15 @@ PDFSignatureVerificationResult PDFSignatureHandler_adbe_pkcs7_sha1::verify() con
 
 BIO* PDFSignatureHandler_adbe_pkcs7_sha1::getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
 {
-    QByteArray temporaryBuffer;
-    if (BIO* bio = PDFPublicKeySignatureHandler::getSignedDataBuffer(result, temporaryBuffer))
+    SignedDataRanges ranges;
+    if (getSignedDataRanges(result, ranges))
     {
-        // Calculate SHA1
-        outputBuffer.resize(SHA_DIGEST_LENGTH);
-        SHA1(convertByteArrayToUcharPtr(temporaryBuffer), temporaryBuffer.length(), convertByteArrayToUcharPtr(outputBuffer));
-        BIO_free(bio);
+        // Calculate SHA1, signed data are SHA1 digest of the byte ranges
+        if (!getSignedDataDigest(ranges, EVP_sha1(), outputBuffer))
+        {
+            result.addSignatureDataOtherError();
+            return nullptr;
+        }
 
         return BIO_new_mem_buf(outputBuffer.data(), outputBuffer.length());
     }
@@ -1680,6 +1823,67 @@ void PDFPublicKeySignatureHandler::addSignatureDateFromSignerInfoStack(STACK_OF(
 #endif
 #endif
 
+namespace
+{
+
+/// Cache of the trusted certificate store. Building of the store (parsing of the
+/// certificates and enumerating of system certificates) is expensive, so store
+/// is built only once for the same set of certificates and then shared. Store
+/// is never modified after it is built.
+struct PDFTrustedCertificateStoreCache
+{
+    ~PDFTrustedCertificateStoreCache()
+    {
+        if (store)
+        {
+            X509_STORE_free(store);
+        }
+    }
+
+    QMutex mutex;
+    std::vector<QByteArray> certificates;
+    bool useSystemCertificateStore = false;
+    X509_STORE* store = nullptr;
+};
+
+}   // namespace
+
+X509_STORE* pdf::PDFPublicKeySignatureHandler::getTrustedCertificateStore() const
+{
+    static PDFTrustedCertificateStoreCache cache;
+
+    std::vector<QByteArray> certificates;
+    if (m_parameters.store)
+    {
+        const PDFCertificateEntries& entries = m_parameters.store->getCertificates();
+        certificates.reserve(entries.size());
+        for (const auto& entry : entries)
+        {
+            certificates.push_back(entry.info.getCertificateData());
+        }
+    }
+
+    QMutexLocker lock(&cache.mutex);
+    if (!cache.store || cache.certificates != certificates || cache.useSystemCertificateStore != m_parameters.useSystemCertificateStore)
+    {
+        X509_STORE* store = X509_STORE_new();
+        Q_ASSERT(store);
+        addTrustedCertificates(store);
+
+        if (cache.store)
+        {
+            X509_STORE_free(cache.store);
+        }
+
+        cache.store = store;
+        cache.certificates = qMove(certificates);
+        cache.useSystemCertificateStore = m_parameters.useSystemCertificateStore;
+    }
+
+    X509_STORE_up_ref(cache.store);
+    return cache.store;
+}
+
 void pdf::PDFPublicKeySignatureHandler::addTrustedCertificates(X509_STORE* store) const
 {
     if (m_parameters.store)
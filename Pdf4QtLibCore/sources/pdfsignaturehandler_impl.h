@@ -44,8 +44,38 @@ protected:
     void verifySignature(PDFSignatureVerificationResult& result) const;
     void addTrustedCertificates(X509_STORE* store) const;
 
+    /// Returns store with trusted certificates. Store is built only once for the
+    /// same set of trusted certificates and then it is shared, so it must not be
+    /// modified. Caller owns the returned reference and must free it using X509_STORE_free.
+    X509_STORE* getTrustedCertificateStore() const;
+
+    /// Byte range of the source data covered by the signature (pointer to the data and length)
+    using SignedDataRange = std::pair<const char*, int>;
+    using SignedDataRanges = std::vector<SignedDataRange>;
+
+    /// Checks byte ranges covered by the signature and returns pointers to these
+    /// ranges in the source data (data are not copied). If byte ranges are invalid,
+    /// then error is added to the result and false is returned.
+    /// \param result Verification result
+    /// \param ranges Ranges of the source data covered by the signature
+    bool getSignedDataRanges(PDFSignatureVerificationResult& result, SignedDataRanges& ranges) const;
+
+    /// Returns BIO, which reads signed data. Base implementation reads byte ranges
+    /// covered by the signature directly from the source data.
+    /// \param result Verification result
+    /// \param outputBuffer Buffer, which can be used to store signed data (must outlive the BIO)
     virtual BIO* getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const;
 
+    /// Creates read only BIO, which reads given ranges in place, as if they were concatenated
+    /// \param ranges Ranges of data
+    static BIO* createSignedDataBIO(const SignedDataRanges& ranges);
+
+    /// Calculates digest of the given ranges incrementally
+    /// \param ranges Ranges of data
+    /// \param md Message digest algorithm
+    /// \param digest Calculated digest
+    static bool getSignedDataDigest(const SignedDataRanges& ranges, const EVP_MD* md, QByteArray& digest);
+
 public:
     /// Return a list of certificates from PKCS7 object
     static STACK_OF(X509)* getCertificates(PKCS7* pkcs7);
@@ -108,7 +138,7 @@ public:
 
 private:
     X509* createCertificate(size_t index) const;
-    bool getMessageDigest(const QByteArray& message, ASN1_OCTET_STRING* encryptedString, RSA* rsa, int& algorithmNID, QByteArray& digest) const;
+    bool getMessageDigest(const SignedDataRanges& ranges, ASN1_OCTET_STRING* encryptedString, RSA* rsa, int& algorithmNID, QByteArray& digest) const;
     bool getMessageDigestAlgorithm(ASN1_OCTET_STRING* encryptedString, RSA* rsa, int& algorithmNID) const;
 
     void verifyRSACertificate(PDFSignatureVerificationResult& result) const;
@@ -0,0 +1,115 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfsimd.h"
+
+#include <atomic>
+
+#if defined(PDF4QT_SIMD_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+static std::atomic<int> s_instructionSetLimit = static_cast<int>(PDFSimd::InstructionSet::NEON);
+
+PDFSimd::InstructionSet PDFSimd::getInstructionSet()
+{
+    static const InstructionSet detectedInstructionSet = detectInstructionSet();
+
+    const InstructionSet limit = static_cast<InstructionSet>(s_instructionSetLimit.load(std::memory_order_relaxed));
+    if (limit == InstructionSet::Scalar)
+    {
+        return InstructionSet::Scalar;
+    }
+
+    if (detectedInstructionSet == InstructionSet::AVX2 && limit == InstructionSet::SSE2)
+    {
+        return InstructionSet::SSE2;
+    }
+
+    return detectedInstructionSet;
+}
+
+bool PDFSimd::isAvailable(InstructionSet instructionSet)
+{
+    const InstructionSet currentInstructionSet = getInstructionSet();
+
+    switch (instructionSet)
+    {
+        case InstructionSet::Scalar:
+            return true;
+
+        case InstructionSet::SSE2:
+            return currentInstructionSet == InstructionSet::SSE2 || currentInstructionSet == InstructionSet::AVX2;
+
+        case InstructionSet::AVX2:
+            return currentInstructionSet == InstructionSet::AVX2;
+
+        case InstructionSet::NEON:
+            return currentInstructionSet == InstructionSet::NEON;
+    }
+
+    return false;
+}
+
+void PDFSimd::setInstructionSetLimit(InstructionSet instructionSet)
+{
+    s_instructionSetLimit.store(static_cast<int>(instructionSet), std::memory_order_relaxed);
+}
+
+PDFSimd::InstructionSet PDFSimd::detectInstructionSet()
+{
+#if defined(PDF4QT_SIMD_SSE2)
+#if defined(PDF4QT_SIMD_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return InstructionSet::AVX2;
+    }
+#elif defined(PDF4QT_SIMD_AVX2) && defined(_MSC_VER)
+    // Check AVX2 support of the CPU, and also check, that
+    // operating system saves AVX registers (OSXSAVE and XCR0).
+    int info[4] = { };
+    __cpuid(info, 0);
+    if (info[0] >= 7)
+    {
+        __cpuid(info, 1);
+        const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+        const bool hasAVX = (info[2] & (1 << 28)) != 0;
+
+        __cpuidex(info, 7, 0);
+        const bool hasAVX2 = (info[1] & (1 << 5)) != 0;
+
+        if (hasOSXSAVE && hasAVX && hasAVX2 && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            return InstructionSet::AVX2;
+        }
+    }
+#endif
+    return InstructionSet::SSE2;
+#elif defined(PDF4QT_SIMD_NEON)
+    return InstructionSet::NEON;
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+}   // namespace pdf
@@ -0,0 +1,84 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFSIMD_H
+#define PDFSIMD_H
+
+#include "pdfglobal.h"
+
+// SSE2 is always available on x86-64, for 32-bit x86 it must be enabled by the compiler
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF4QT_SIMD_SSE2
+#include <immintrin.h>
+
+// AVX2 functions are compiled for the target CPU using the function attribute
+// and they are used only, if CPU supports AVX2 (it is detected at runtime).
+#if defined(__GNUC__) || defined(__clang__)
+#define PDF4QT_SIMD_AVX2
+#define PDF4QT_SIMD_AVX2_FUNCTION __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#define PDF4QT_SIMD_AVX2
+#define PDF4QT_SIMD_AVX2_FUNCTION
+#endif
+#endif
+
+// NEON is always available on AArch64
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define PDF4QT_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace pdf
+{
+
+/// Runtime detection of SIMD instruction sets. SIMD kernels check
+/// available instruction set and use scalar code, if no instruction
+/// set, for which kernel exists, is available.
+class PDF4QTLIBCORESHARED_EXPORT PDFSimd
+{
+public:
+    enum class InstructionSet
+    {
+        Scalar,     ///< No SIMD instructions are used
+        SSE2,       ///< SSE2 (x86)
+        AVX2,       ///< AVX2 (x86)
+        NEON        ///< NEON (ARM)
+    };
+
+    /// Returns best instruction set supported by the CPU (and the build),
+    /// limited by the instruction set limit.
+    static InstructionSet getInstructionSet();
+
+    /// Returns true, if instruction set can be used
+    /// \param instructionSet Instruction set
+    static bool isAvailable(InstructionSet instructionSet);
+
+    /// Limits instruction sets, which can be used. If limit is set to
+    /// Scalar, then no SIMD instructions are used, if it is set to SSE2,
+    /// then AVX2 is not used. This is intended for testing and benchmarking
+    /// of the SIMD kernels.
+    /// \param instructionSet Instruction set limit
+    static void setInstructionSetLimit(InstructionSet instructionSet);
+
+private:
+    /// Detects best instruction set supported by the CPU
+    static InstructionSet detectInstructionSet();
+};
+
+}   // namespace pdf
+
+#endif // PDFSIMD_H
@@ -22,11 +22,156 @@
 
 #include <QPainter>
 
+#include <cmath>
+#include <iterator>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
 {
 
+void PDFSnapPointIndex::build(std::vector<QPointF> points)
+{
+    clear();
+
+    if (points.empty())
+    {
+        return;
+    }
+
+    m_points = std::move(points);
+
+    PDFReal minX = m_points.front().x();
+    PDFReal maxX = minX;
+    PDFReal minY = m_points.front().y();
+    PDFReal maxY = minY;
+
+    for (const QPointF& point : m_points)
+    {
+        minX = qMin(minX, point.x());
+        maxX = qMax(maxX, point.x());
+        minY = qMin(minY, point.y());
+        maxY = qMax(maxY, point.y());
+    }
+
+    m_boundingRect = QRectF(minX, minY, maxX - minX, maxY - minY);
+
+    const int gridSize = qBound(1, int(std::sqrt(PDFReal(m_points.size() / POINTS_PER_CELL))), MAX_GRID_SIZE);
+    m_gridWidth = gridSize;
+    m_gridHeight = gridSize;
+
+    // Counting sort of the points into the cells
+    std::vector<int> cells(m_points.size(), 0);
+    m_cellStart.assign(m_gridWidth * m_gridHeight + 1, 0);
+    for (size_t i = 0; i < m_points.size(); ++i)
+    {
+        const int cell = getCellY(m_points[i].y()) * m_gridWidth + getCellX(m_points[i].x());
+        cells[i] = cell;
+        ++m_cellStart[cell + 1];
+    }
+
+    for (size_t i = 1; i < m_cellStart.size(); ++i)
+    {
+        m_cellStart[i] += m_cellStart[i - 1];
+    }
+
+    std::vector<uint32_t> position(m_cellStart.begin(), std::prev(m_cellStart.end()));
+    m_cellItems.resize(m_points.size());
+    for (size_t i = 0; i < m_points.size(); ++i)
+    {
+        m_cellItems[position[cells[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+void PDFSnapPointIndex::clear()
+{
+    m_points.clear();
+    m_cellStart.clear();
+    m_cellItems.clear();
+    m_boundingRect = QRectF();
+    m_gridWidth = 0;
+    m_gridHeight = 0;
+}
+
+std::optional<size_t> PDFSnapPointIndex::findNearestPoint(const QPointF& point, PDFReal tolerance, const std::function<bool(size_t)>& filter) const
+{
+    if (m_points.empty())
+    {
+        return std::nullopt;
+    }
+
+    const QRectF toleranceRect(point.x() - tolerance, point.y() - tolerance, 2.0 * tolerance, 2.0 * tolerance);
+    if (toleranceRect.right() < m_boundingRect.left() || toleranceRect.left() > m_boundingRect.right() ||
+        toleranceRect.bottom() < m_boundingRect.top() || toleranceRect.top() > m_boundingRect.bottom())
+    {
+        return std::nullopt;
+    }
+
+    const int x1 = getCellX(toleranceRect.left());
+    const int x2 = getCellX(toleranceRect.right());
+    const int y1 = getCellY(toleranceRect.top());
+    const int y2 = getCellY(toleranceRect.bottom());
+
+    std::optional<size_t> result;
+    PDFReal nearestDistanceSquared = tolerance * tolerance;
+
+    for (int y = y1; y <= y2; ++y)
+    {
+        for (int x = x1; x <= x2; ++x)
+        {
+            const int cell = y * m_gridWidth + x;
+            for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i)
+            {
+                const uint32_t index = m_cellItems[i];
+                const QPointF difference = point - m_points[index];
+                const PDFReal distanceSquared = QPointF::dotProduct(difference, difference);
+
+                if (distanceSquared < nearestDistanceSquared && (!filter || filter(index)))
+                {
+                    nearestDistanceSquared = distanceSquared;
+                    result = index;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int PDFSnapPointIndex::getCellX(PDFReal x) const
+{
+    if (m_boundingRect.width() <= 0.0)
+    {
+        return 0;
+    }
+
+    return qBound(0, int((x - m_boundingRect.left()) / m_boundingRect.width() * m_gridWidth), m_gridWidth - 1);
+}
+
+int PDFSnapPointIndex::getCellY(PDFReal y) const
+{
+    if (m_boundingRect.height() <= 0.0)
+    {
+        return 0;
+    }
+
+    return qBound(0, int((y - m_boundingRect.top()) / m_boundingRect.height() * m_gridHeight), m_gridHeight - 1);
+}
+
+void PDFSnapInfo::buildSpatialIndex()
+{
+    std::vector<QPointF> points;
+    points.reserve(m_snapPoints.size());
+    std::transform(m_snapPoints.cbegin(), m_snapPoints.cend(), std::back_inserter(points), [](const SnapPoint& snapPoint) { return snapPoint.point; });
+    m_snapPointIndex.build(std::move(points));
+}
+
+bool PDFSnapInfo::containsSnapPoint(const QPointF& point, PDFReal tolerance) const
+{
+    return m_snapPointIndex.findNearestPoint(point, tolerance).has_value();
+}
+
 void PDFSnapInfo::addPageMediaBox(const QRectF& mediaBox)
 {
     QPointF tl = mediaBox.topLeft();
@@ -158,23 +303,18 @@ void PDFSnapper::updateSnappedPoint(const QPointF& mousePoint)
     m_snappedImage = std::nullopt;
     m_mousePoint = mousePoint;
 
-    // Iterate trough all points, check, if some satisfies condition
-    const PDFReal toleranceSquared = m_snapPointTolerance * m_snapPointTolerance;
-    for (const ViewportSnapPoint& snapPoint : m_snapPoints)
+    // Find nearest snap point using the spatial index
+    auto isPointAllowed = [this](size_t index) { return isSnappingAllowed(m_snapPoints[index].pageIndex); };
+    std::optional<size_t> snapPointIndex = m_snapPointIndex.findNearestPoint(mousePoint, m_snapPointTolerance, isPointAllowed);
+    if (snapPointIndex.has_value())
     {
-        QPointF difference = mousePoint - snapPoint.viewportPoint;
-        PDFReal distanceSquared = QPointF::dotProduct(difference, difference);
-        if (distanceSquared < toleranceSquared && isSnappingAllowed(snapPoint.pageIndex))
-        {
-            m_snappedPoint = snapPoint;
-            break;
-        }
+        m_snappedPoint = m_snapPoints[*snapPointIndex];
     }
 
     // Iterate trough all images, check, if some is under mouse cursor
     for (const ViewportSnapImage& snapImage : m_snapImages)
     {
-        if (snapImage.viewportPath.contains(mousePoint))
+        if (snapImage.viewportBoundingRect.contains(mousePoint) && snapImage.viewportPath.contains(mousePoint))
         {
             m_snappedImage = snapImage;
             break;
@@ -186,6 +326,7 @@ void PDFSnapper::buildSnapPoints(const PDFWidgetSnapshot& snapshot)
 {
     // First, clear all snap points
     m_snapPoints.clear();
+    m_snapPointIndex.clear();
 
     // Second, create snapping points from snapshot
     for (const PDFWidgetSnapshot::SnapshotItem& item : snapshot.items)
@@ -195,6 +336,10 @@ void PDFSnapper::buildSnapPoints(const PDFWidgetSnapshot& snapshot)
             continue;
         }
 
+        // Generated points are tested against snap points of this page, snap
+        // points of the page info are tested using its spatial index.
+        const size_t firstPageSnapPointIndex = m_snapPoints.size();
+
         const PDFSnapInfo* info = item.compiledPage->getSnapInfo();
         for (const PDFSnapInfo::SnapPoint& snapPoint : info->getSnapPoints())
         {
@@ -242,7 +387,10 @@ void PDFSnapper::buildSnapPoints(const PDFWidgetSnapshot& snapshot)
                     {
                         return isFuzzyComparedPointsSame(projectedSnapPoint, testedSnapPoint.point, squaredTolerance);
                     };
-                    if (m_snapPoints.cend() == std::find_if(m_snapPoints.cbegin(), m_snapPoints.cend(), testSamePoints))
+                    const size_t pageInfoSnapPointCount = info->getSnapPoints().size();
+                    auto generatedPointsBegin = std::next(m_snapPoints.cbegin(), firstPageSnapPointIndex + pageInfoSnapPointCount);
+                    if (!info->containsSnapPoint(projectedSnapPoint, tolerance) &&
+                        m_snapPoints.cend() == std::find_if(generatedPointsBegin, m_snapPoints.cend(), testSamePoints))
                     {
                         ViewportSnapPoint viewportSnapPoint;
                         viewportSnapPoint.type = SnapType::GeneratedLineProjection;
@@ -256,7 +404,12 @@ void PDFSnapper::buildSnapPoints(const PDFWidgetSnapshot& snapshot)
         }
     }
 
-    // Third, update snap shot position
+    // Third, build spatial index and update snap shot position
+    std::vector<QPointF> viewportPoints;
+    viewportPoints.reserve(m_snapPoints.size());
+    std::transform(m_snapPoints.cbegin(), m_snapPoints.cend(), std::back_inserter(viewportPoints), [](const ViewportSnapPoint& snapPoint) { return snapPoint.viewportPoint; });
+    m_snapPointIndex.build(std::move(viewportPoints));
+
     updateSnappedPoint(m_mousePoint);
 }
 
@@ -281,6 +434,7 @@ void PDFSnapper::buildSnapImages(const PDFWidgetSnapshot& snapshot)
             viewportSnapImage.imagePath = snapImage.imagePath;
             viewportSnapImage.pageIndex = item.pageIndex;
             viewportSnapImage.viewportPath = item.pageToDeviceMatrix.map(snapImage.imagePath);
+            viewportSnapImage.viewportBoundingRect = viewportSnapImage.viewportPath.controlPointRect();
             m_snapImages.emplace_back(qMove(viewportSnapImage));
         }
     }
@@ -341,6 +495,7 @@ void PDFSnapper::clear()
 
     m_customSnapPoints.clear();
     m_snapPoints.clear();
+    m_snapPointIndex.clear();
     m_snapImages.clear();
     m_snappedPoint = std::nullopt;
     m_snappedImage = std::nullopt;
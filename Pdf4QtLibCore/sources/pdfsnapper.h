@@ -25,6 +25,7 @@
 
 #include <array>
 #include <optional>
+#include <functional>
 
 class QPainter;
 
@@ -45,6 +46,47 @@ enum class SnapType
     Custom  ///< Custom snap point
 };
 
+/// Spatial index of points. Points are distributed into the cells of uniform
+/// grid over their bounding rectangle, so nearest point query visits only
+/// cells overlapping the tolerance square, instead of testing all points.
+class PDF4QTLIBCORESHARED_EXPORT PDFSnapPointIndex
+{
+public:
+    explicit inline PDFSnapPointIndex() = default;
+
+    /// Builds the index from the points. Indices of the points in the vector
+    /// are the indices returned by queries.
+    /// \param points Points
+    void build(std::vector<QPointF> points);
+
+    /// Clears the index
+    void clear();
+
+    /// Finds nearest point, which distance from \p point is lesser than tolerance.
+    /// If no such point exists, then std::nullopt is returned.
+    /// \param point Point
+    /// \param tolerance Tolerance
+    /// \param filter Filter of the points (if set, only points accepted by the filter are returned)
+    std::optional<size_t> findNearestPoint(const QPointF& point, PDFReal tolerance, const std::function<bool(size_t)>& filter = nullptr) const;
+
+private:
+    /// Average number of points in one cell of the grid
+    static constexpr size_t POINTS_PER_CELL = 4;
+
+    /// Maximal grid size in one dimension
+    static constexpr int MAX_GRID_SIZE = 256;
+
+    int getCellX(PDFReal x) const;
+    int getCellY(PDFReal y) const;
+
+    std::vector<QPointF> m_points;
+    std::vector<uint32_t> m_cellStart;  ///< Start of cell items, last item is end of the last cell
+    std::vector<uint32_t> m_cellItems;  ///< Point indices sorted by the cells
+    QRectF m_boundingRect;
+    int m_gridWidth = 0;
+    int m_gridHeight = 0;
+};
+
 /// Contain informations for snap points in the pdf page. Snap points
 /// can be for example image centers, rectangle corners, line start/end
 /// points, page boundary boxes etc. All coordinates are in page coordinates.
@@ -99,10 +141,23 @@ public:
     /// in which image is painted).
     const std::vector<SnapImage>& getSnapImages() const { return m_snapImages; }
 
+    /// Builds spatial index of snap points. Must be called after all
+    /// snap points are added, compiled page builds it, when it is finalized.
+    void buildSpatialIndex();
+
+    /// Returns true, if some snap point is closer than tolerance
+    /// to the given point. Spatial index must be built.
+    /// \param point Point in page coordinates
+    /// \param tolerance Tolerance in page coordinates
+    bool containsSnapPoint(const QPointF& point, PDFReal tolerance) const;
+
 private:
+    friend class PDFPrecompiledPage;
+
     std::vector<SnapPoint> m_snapPoints;
     std::vector<QLineF> m_snapLines;
     std::vector<SnapImage> m_snapImages;
+    PDFSnapPointIndex m_snapPointIndex;
 };
 
 /// Snap engine, which handles snapping of points on the page.
@@ -121,6 +176,7 @@ public:
     {
         PDFInteger pageIndex;
         QPainterPath viewportPath;
+        QRectF viewportBoundingRect;
     };
 
     /// Sets snap point pixel size
@@ -201,6 +257,7 @@ private:
     };
 
     std::vector<ViewportSnapPoint> m_snapPoints;
+    PDFSnapPointIndex m_snapPointIndex; ///< Spatial index of viewport snap points
     std::vector<ViewportSnapImage> m_snapImages;
     std::vector<QPointF> m_customSnapPoints;
     std::optional<ViewportSnapPoint> m_snappedPoint;
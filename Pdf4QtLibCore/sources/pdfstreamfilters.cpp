@@ -21,9 +21,17 @@
 #include "pdfparser.h"
 #include "pdfsecurityhandler.h"
 #include "pdfutils.h"
+#include "pdfsimd.h"
 
 #include <zlib.h>
 
+#ifdef PDF4QT_USE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#include <cstring>
+#include <algorithm>
+
 #include <QtEndian>
 
 #include "pdfdbgheap.h"
@@ -31,6 +39,131 @@
 namespace pdf
 {
 
+PDFStreamDecoder::PDFStreamDecoder(PDFStreamDecoderSink sink) :
+    m_sink(qMove(sink))
+{
+
+}
+
+PDFStreamDecoder::~PDFStreamDecoder()
+{
+
+}
+
+void PDFStreamDecoder::push(const char* data, qsizetype size)
+{
+    pushImpl(data, size);
+    flush();
+}
+
+void PDFStreamDecoder::finish()
+{
+    finishImpl();
+    flush();
+
+    if (m_next)
+    {
+        m_next->finish();
+    }
+}
+
+void PDFStreamDecoder::appendDecoder(std::unique_ptr<PDFStreamDecoder> decoder)
+{
+    PDFStreamDecoder* lastDecoder = this;
+    while (lastDecoder->m_next)
+    {
+        lastDecoder = lastDecoder->m_next.get();
+    }
+
+    lastDecoder->m_next = qMove(decoder);
+}
+
+QByteArray PDFStreamDecoder::decode(const QByteArray& data, const std::function<std::unique_ptr<PDFStreamDecoder>(PDFStreamDecoderSink)>& factory)
+{
+    QByteArray result;
+    std::unique_ptr<PDFStreamDecoder> decoder = factory([&result](const char* decodedData, qsizetype size) { result.append(decodedData, size); });
+    decoder->push(data.constData(), data.size());
+    decoder->finish();
+    return result;
+}
+
+void PDFStreamDecoder::write(const char* data, qsizetype size)
+{
+    if (m_buffer.isEmpty() && size >= CHUNK_SIZE)
+    {
+        // Avoid unnecessary copying of large blocks
+        m_sink(data, size);
+        return;
+    }
+
+    m_buffer.append(data, size);
+    if (m_buffer.size() >= CHUNK_SIZE)
+    {
+        flush();
+    }
+}
+
+void PDFStreamDecoder::flush()
+{
+    if (!m_buffer.isEmpty())
+    {
+        m_sink(m_buffer.constData(), m_buffer.size());
+        m_buffer.resize(0);
+    }
+}
+
+/// Decoder for filters without incremental decoding support. It collects
+/// all pushed data and decodes them at once using the filter.
+class PDFBufferedStreamDecoder : public PDFStreamDecoder
+{
+public:
+    explicit PDFBufferedStreamDecoder(PDFStreamDecoderSink sink,
+                                      const PDFStreamFilter* filter,
+                                      PDFObjectFetcher objectFetcher,
+                                      PDFObject parameters,
+                                      const PDFSecurityHandler* securityHandler) :
+        PDFStreamDecoder(qMove(sink)),
+        m_filter(filter),
+        m_objectFetcher(qMove(objectFetcher)),
+        m_parameters(qMove(parameters)),
+        m_securityHandler(securityHandler)
+    {
+
+    }
+
+protected:
+    virtual void pushImpl(const char* data, qsizetype size) override { m_data.append(data, size); }
+    virtual void finishImpl() override
+    {
+        QByteArray decodedData = m_filter->apply(m_data, m_objectFetcher, m_parameters, m_securityHandler);
+        m_data.clear();
+        write(decodedData.constData(), decodedData.size());
+    }
+
+private:
+    const PDFStreamFilter* m_filter;
+    PDFObjectFetcher m_objectFetcher;
+    PDFObject m_parameters;
+    const PDFSecurityHandler* m_securityHandler;
+    QByteArray m_data;
+};
+
+PDFStreamDecoderPointer PDFStreamFilter::createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                       const PDFObject& parameters,
+                                                       const PDFSecurityHandler* securityHandler,
+                                                       PDFStreamDecoderSink sink) const
+{
+    return std::make_unique<PDFBufferedStreamDecoder>(qMove(sink), this, objectFetcher, parameters, securityHandler);
+}
+
+QByteArray PDFStreamFilter::applyDecoder(const QByteArray& data,
+                                         const PDFObjectFetcher& objectFetcher,
+                                         const PDFObject& parameters,
+                                         const PDFSecurityHandler* securityHandler) const
+{
+    return PDFStreamDecoder::decode(data, [&](PDFStreamDecoderSink sink) { return createDecoder(objectFetcher, parameters, securityHandler, qMove(sink)); });
+}
+
 QByteArray PDFAsciiHexDecodeFilter::apply(const QByteArray& data,
                                           const PDFObjectFetcher& objectFetcher,
                                           const PDFObject& parameters,
@@ -60,103 +193,126 @@ QByteArray PDFAsciiHexDecodeFilter::apply(const QByteArray& data,
     return QByteArray::fromHex(QByteArray::fromRawData(data.constData(), size));
 }
 
-QByteArray PDFAscii85DecodeFilter::apply(const QByteArray& data,
-                                         const PDFObjectFetcher& objectFetcher,
-                                         const PDFObject& parameters,
-                                         const PDFSecurityHandler* securityHandler) const
+class PDFAscii85StreamDecoder : public PDFStreamDecoder
 {
-    Q_UNUSED(objectFetcher);
-    Q_UNUSED(parameters);
-    Q_UNUSED(securityHandler);
+public:
+    explicit PDFAscii85StreamDecoder(PDFStreamDecoderSink sink) :
+        PDFStreamDecoder(qMove(sink))
+    {
+        m_scannedChars.fill(84);
+    }
+
+protected:
+    virtual void pushImpl(const char* data, qsizetype size) override;
+    virtual void finishImpl() override;
+
+private:
+    /// Decodes scanned characters, writes \p validBytes bytes
+    void decodeScannedChars(std::size_t validBytes);
 
-    const unsigned char* dataBegin = reinterpret_cast<const unsigned char*>(data.constData());
-    const unsigned char* dataEnd = reinterpret_cast<const unsigned char*>(data.constData() + data.size());
+    std::array<uint32_t, 5> m_scannedChars;
+    std::size_t m_scannedCharCount = 0;
+    bool m_isEndOfStream = false;
+};
 
-    const unsigned char* it = dataBegin;
-    const constexpr uint32_t STREAM_END = 0xFFFFFFFF;
+void PDFAscii85StreamDecoder::pushImpl(const char* data, qsizetype size)
+{
+    const unsigned char* it = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* itEnd = it + size;
 
-    auto getChar = [&it, dataEnd]() -> uint32_t
+    for (; it != itEnd && !m_isEndOfStream; ++it)
     {
-        // Skip whitespace characters
-        while (it != dataEnd && PDFLexicalAnalyzer::isWhitespace(*it))
-        {
-            ++it;
-        }
+        const uint32_t scannedChar = *it;
 
-        if (it == dataEnd || (*it == '~'))
+        // Skip whitespace characters
+        if (PDFLexicalAnalyzer::isWhitespace(scannedChar))
         {
-            return STREAM_END;
+            continue;
         }
 
-        return *it++;
-    };
-
-    QByteArray result;
-    result.reserve(data.size() * 4 / 5);
-
-    while (true)
-    {
-        const uint32_t scannedChar = getChar();
-        if (scannedChar == STREAM_END)
+        if (scannedChar == '~')
         {
-            break;
+            m_isEndOfStream = true;
         }
-        else if (scannedChar == 'z')
+        else if (scannedChar == 'z' && m_scannedCharCount == 0)
         {
-            result.append(4, static_cast<char>(0));
+            const std::array<char, 4> zeroBytes = { };
+            write(zeroBytes.data(), zeroBytes.size());
         }
         else
         {
-            // Scan all 5 characters, some of then can be equal to STREAM_END constant. We will
-            // treat all these characters as last character.
-            std::array<uint32_t, 5> scannedChars;
-            scannedChars.fill(84);
-            scannedChars[0] = scannedChar - 33;
-            std::size_t validBytes = 0;
-            for (auto it2 = std::next(scannedChars.begin()); it2 != scannedChars.end(); ++it2)
+            m_scannedChars[m_scannedCharCount++] = scannedChar - 33;
+            if (m_scannedCharCount == m_scannedChars.size())
             {
-                uint32_t character = getChar();
-                if (character == STREAM_END)
-                {
-                    break;
-                }
-                *it2 = character - 33;
-                ++validBytes;
+                decodeScannedChars(m_scannedChars.size() - 1);
             }
+        }
+    }
+}
 
-            // Decode bytes using 85 base
-            uint32_t decodedBytesPacked = 0;
-            for (const uint32_t value : scannedChars)
-            {
-                decodedBytesPacked = decodedBytesPacked * 85 + value;
-            }
+void PDFAscii85StreamDecoder::finishImpl()
+{
+    // Some characters can be missing at the end of the stream. We
+    // will treat all these characters as last character.
+    if (m_scannedCharCount > 0)
+    {
+        decodeScannedChars(m_scannedCharCount - 1);
+    }
+}
 
-            // Decode bytes into byte array
-            std::array<char, 4> decodedBytesUnpacked;
-            decodedBytesUnpacked.fill(0);
-            for (auto byteIt = decodedBytesUnpacked.rbegin(); byteIt != decodedBytesUnpacked.rend(); ++byteIt)
-            {
-                *byteIt = static_cast<char>(decodedBytesPacked & 0xFF);
-                decodedBytesPacked = decodedBytesPacked >> 8;
-            }
+void PDFAscii85StreamDecoder::decodeScannedChars(std::size_t validBytes)
+{
+    // Decode bytes using 85 base
+    uint32_t decodedBytesPacked = 0;
+    for (const uint32_t value : m_scannedChars)
+    {
+        decodedBytesPacked = decodedBytesPacked * 85 + value;
+    }
 
-            Q_ASSERT(validBytes <= decodedBytesUnpacked.size());
-            for (std::size_t i = 0; i < validBytes; ++i)
-            {
-                result.push_back(decodedBytesUnpacked[i]);
-            }
-        }
+    // Decode bytes into byte array
+    std::array<char, 4> decodedBytesUnpacked;
+    decodedBytesUnpacked.fill(0);
+    for (auto byteIt = decodedBytesUnpacked.rbegin(); byteIt != decodedBytesUnpacked.rend(); ++byteIt)
+    {
+        *byteIt = static_cast<char>(decodedBytesPacked & 0xFF);
+        decodedBytesPacked = decodedBytesPacked >> 8;
     }
 
-    return result;
+    Q_ASSERT(validBytes <= decodedBytesUnpacked.size());
+    write(decodedBytesUnpacked.data(), validBytes);
+
+    m_scannedChars.fill(84);
+    m_scannedCharCount = 0;
+}
+
+QByteArray PDFAscii85DecodeFilter::apply(const QByteArray& data,
+                                         const PDFObjectFetcher& objectFetcher,
+                                         const PDFObject& parameters,
+                                         const PDFSecurityHandler* securityHandler) const
+{
+    return applyDecoder(data, objectFetcher, parameters, securityHandler);
 }
 
-class PDFLzwStreamDecoder
+PDFStreamDecoderPointer PDFAscii85DecodeFilter::createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                              const PDFObject& parameters,
+                                                              const PDFSecurityHandler* securityHandler,
+                                                              PDFStreamDecoderSink sink) const
+{
+    Q_UNUSED(objectFetcher);
+    Q_UNUSED(parameters);
+    Q_UNUSED(securityHandler);
+
+    return std::make_unique<PDFAscii85StreamDecoder>(qMove(sink));
+}
+
+class PDFLzwStreamDecoder : public PDFStreamDecoder
 {
 public:
-    explicit PDFLzwStreamDecoder(const QByteArray& inputByteArray, uint32_t early);
+    explicit PDFLzwStreamDecoder(PDFStreamDecoderSink sink, uint32_t early);
 
-    QByteArray decompress();
+protected:
+    virtual void pushImpl(const char* data, qsizetype size) override;
+    virtual void finishImpl() override { }
 
 private:
     static constexpr const uint32_t CODE_TABLE_RESET = 256;
@@ -171,8 +327,8 @@ private:
     /// Clears the input data table
     void clearTable();
 
-    /// Returns a newly scanned code
-    uint32_t getCode();
+    /// Decodes the code
+    void processCode(uint32_t code);
 
     struct TableItem
     {
@@ -188,14 +344,15 @@ private:
     uint32_t m_early;           ///< Early (see PDF 1.7 Specification, this constant is 0 or 1, based on the dictionary value)
     uint32_t m_inputBuffer;     ///< Input buffer, containing bits, which were read from the input byte array
     uint32_t m_inputBits;       ///< Number of bits in the input buffer.
+    uint32_t m_previousCode;    ///< Previous code
     std::array<char, TABLE_SIZE>::iterator m_currentSequenceEnd;
     bool m_first;               ///< Are we reading from stream for first time after the reset
+    bool m_isEndOfStream;       ///< End of stream code has been read
     char m_newCharacter;        ///< New character to be written
-    int m_position;             ///< Position in the input array
-    const QByteArray& m_inputByteArray;
 };
 
-PDFLzwStreamDecoder::PDFLzwStreamDecoder(const QByteArray& inputByteArray, uint32_t early) :
+PDFLzwStreamDecoder::PDFLzwStreamDecoder(PDFStreamDecoderSink sink, uint32_t early) :
+    PDFStreamDecoder(qMove(sink)),
     m_table(),
     m_sequence(),
     m_nextCode(0),
@@ -203,11 +360,11 @@ PDFLzwStreamDecoder::PDFLzwStreamDecoder(const QByteArray& inputByteArray, uint3
     m_early(early),
     m_inputBuffer(0),
     m_inputBits(0),
+    m_previousCode(TABLE_SIZE),
     m_currentSequenceEnd(m_sequence.begin()),
     m_first(false),
-    m_newCharacter(0),
-    m_position(0),
-    m_inputByteArray(inputByteArray)
+    m_isEndOfStream(false),
+    m_newCharacter(0)
 {
     for (size_t i = 0; i < 256; ++i)
     {
@@ -218,99 +375,106 @@ PDFLzwStreamDecoder::PDFLzwStreamDecoder(const QByteArray& inputByteArray, uint3
     clearTable();
 }
 
-QByteArray PDFLzwStreamDecoder::decompress()
+void PDFLzwStreamDecoder::pushImpl(const char* data, qsizetype size)
 {
-    QByteArray result;
-
-    // Guess output byte array size - assume compress ratio is 2:1
-    result.reserve(m_inputByteArray.size() * 2);
-
-    uint32_t previousCode = TABLE_SIZE;
-    while (true)
+    for (qsizetype i = 0; i < size && !m_isEndOfStream; ++i)
     {
-        const uint32_t code = getCode();
+        m_inputBuffer = (m_inputBuffer << 8) | static_cast<unsigned char>(data[i]);
+        m_inputBits += 8;
 
-        if (code == CODE_END_OF_STREAM)
+        if (m_inputBits >= m_nextBits)
         {
-            // We are at end of stream
-            break;
-        }
-        else if (code == CODE_TABLE_RESET)
-        {
-            // Just reset the table
-            clearTable();
-            continue;
+            // We must omit bits from left (old ones) and right (newly scanned ones) and
+            // read just m_nextBits bits. Mask should omit the old ones and shift (m_inputBits - m_nextBits)
+            // should omit the new ones.
+            const uint32_t mask = ((1 << m_nextBits) - 1);
+            const uint32_t code = (m_inputBuffer >> (m_inputBits - m_nextBits)) & mask;
+            m_inputBits -= m_nextBits;
+            processCode(code);
         }
+    }
+}
 
-        // Normal operation code
-        if (code < m_nextCode)
-        {
-            m_currentSequenceEnd = m_sequence.begin();
+void PDFLzwStreamDecoder::processCode(uint32_t code)
+{
+    if (code == CODE_END_OF_STREAM)
+    {
+        // We are at end of stream
+        m_isEndOfStream = true;
+        return;
+    }
+    else if (code == CODE_TABLE_RESET)
+    {
+        // Just reset the table
+        clearTable();
+        return;
+    }
 
-            for (uint32_t currentCode = code; currentCode != TABLE_SIZE; currentCode = m_table[currentCode].previous)
-            {
-                *m_currentSequenceEnd++ = m_table[currentCode].character;
-            }
+    // Normal operation code
+    if (code < m_nextCode)
+    {
+        m_currentSequenceEnd = m_sequence.begin();
 
-            // We must reverse the sequence, because we stored it in the
-            // linked list, which we traversed from last to first item.
-            std::reverse(m_sequence.begin(), m_currentSequenceEnd);
-        }
-        else if (code == m_nextCode)
+        for (uint32_t currentCode = code; currentCode != TABLE_SIZE; currentCode = m_table[currentCode].previous)
         {
-            // We use the buffer from previous run, just add a new
-            // character to the end.
-            *m_currentSequenceEnd++ = m_newCharacter;
+            *m_currentSequenceEnd++ = m_table[currentCode].character;
         }
-        else
-        {
-            // Unknown code
-            throw PDFException(PDFTranslationContext::tr("Invalid code in the LZW stream."));
-        }
-        m_newCharacter = m_sequence.front();
 
-        if (m_first)
+        // We must reverse the sequence, because we stored it in the
+        // linked list, which we traversed from last to first item.
+        std::reverse(m_sequence.begin(), m_currentSequenceEnd);
+    }
+    else if (code == m_nextCode)
+    {
+        // We use the buffer from previous run, just add a new
+        // character to the end.
+        *m_currentSequenceEnd++ = m_newCharacter;
+    }
+    else
+    {
+        // Unknown code
+        throw PDFException(PDFTranslationContext::tr("Invalid code in the LZW stream."));
+    }
+    m_newCharacter = m_sequence.front();
+
+    if (m_first)
+    {
+        m_first = false;
+    }
+    else
+    {
+        // Add a new word in the dictionary, if we have it
+        if (m_nextCode < TABLE_SIZE)
         {
-            m_first = false;
+            m_table[m_nextCode].character = m_newCharacter;
+            m_table[m_nextCode].previous = m_previousCode;
+            ++m_nextCode;
         }
-        else
-        {
-            // Add a new word in the dictionary, if we have it
-            if (m_nextCode < TABLE_SIZE)
-            {
-                m_table[m_nextCode].character = m_newCharacter;
-                m_table[m_nextCode].previous = previousCode;
-                ++m_nextCode;
-            }
 
-            // Change bit size of the code, if it is neccessary
-            switch (m_nextCode + m_early)
-            {
-                case 512:
-                    m_nextBits = 10;
-                    break;
+        // Change bit size of the code, if it is neccessary
+        switch (m_nextCode + m_early)
+        {
+            case 512:
+                m_nextBits = 10;
+                break;
 
-                case 1024:
-                    m_nextBits = 11;
-                    break;
+            case 1024:
+                m_nextBits = 11;
+                break;
 
-                case 2048:
-                    m_nextBits = 12;
-                    break;
+            case 2048:
+                m_nextBits = 12;
+                break;
 
-                default:
-                    break;
-            }
+            default:
+                break;
         }
-
-        previousCode = code;
-
-        // Copy the input array to the buffer
-        std::copy(m_sequence.begin(), m_currentSequenceEnd, std::back_inserter(result));
     }
 
-    result.shrink_to_fit();
-    return result;
+    m_previousCode = code;
+
+    // Copy the sequence to the output
+    write(m_sequence.data(), std::distance(m_sequence.begin(), m_currentSequenceEnd));
 }
 
 void PDFLzwStreamDecoder::clearTable()
@@ -324,33 +488,18 @@ void PDFLzwStreamDecoder::clearTable()
     m_newCharacter = 0;
 }
 
-uint32_t PDFLzwStreamDecoder::getCode()
-{
-    while (m_inputBits < m_nextBits)
-    {
-        // Did we reach end of array?
-        if (m_position == m_inputByteArray.size())
-        {
-            return CODE_END_OF_STREAM;
-        }
-
-        m_inputBuffer = (m_inputBuffer << 8) | static_cast<unsigned char>(m_inputByteArray[m_position++]);
-        m_inputBits += 8;
-    }
-
-    // We must omit bits from left (old ones) and right (newly scanned ones) and
-    // read just m_nextBits bits. Mask should omit the old ones and shift (m_inputBits - m_nextBits)
-    // should omit the new ones.
-    const uint32_t mask = ((1 << m_nextBits) - 1);
-    const uint32_t code = (m_inputBuffer >> (m_inputBits - m_nextBits)) & mask;
-    m_inputBits -= m_nextBits;
-    return code;
-}
-
 QByteArray PDFLzwDecodeFilter::apply(const QByteArray& data,
                                      const PDFObjectFetcher& objectFetcher,
                                      const PDFObject& parameters,
                                      const PDFSecurityHandler* securityHandler) const
+{
+    return applyDecoder(data, objectFetcher, parameters, securityHandler);
+}
+
+PDFStreamDecoderPointer PDFLzwDecodeFilter::createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                          const PDFObject& parameters,
+                                                          const PDFSecurityHandler* securityHandler,
+                                                          PDFStreamDecoderSink sink) const
 {
     Q_UNUSED(securityHandler);
 
@@ -369,133 +518,293 @@ QByteArray PDFLzwDecodeFilter::apply(const QByteArray& data,
     }
 
     PDFStreamPredictor predictor = PDFStreamPredictor::createPredictor(objectFetcher, parameters);
-    PDFLzwStreamDecoder decoder(data, early);
-    return predictor.apply(decoder.decompress());
+    return predictor.createDecoderWithPredictor(qMove(sink), [early](PDFStreamDecoderSink decoderSink) { return std::make_unique<PDFLzwStreamDecoder>(qMove(decoderSink), early); });
 }
 
-QByteArray PDFFlateDecodeFilter::apply(const QByteArray& data,
-                                       const PDFObjectFetcher& objectFetcher,
-                                       const PDFObject& parameters,
-                                       const PDFSecurityHandler* securityHandler) const
+class PDFFlateStreamDecoder : public PDFStreamDecoder
 {
-    Q_UNUSED(securityHandler);
-
-    PDFStreamPredictor predictor = PDFStreamPredictor::createPredictor(objectFetcher, parameters);
-    return predictor.apply(uncompress(data));
-}
+public:
+    explicit PDFFlateStreamDecoder(PDFStreamDecoderSink sink);
+    virtual ~PDFFlateStreamDecoder() override;
 
-QByteArray PDFFlateDecodeFilter::compress(const QByteArray& decompressedData)
-{
-    QByteArray result;
+protected:
+    virtual void pushImpl(const char* data, qsizetype size) override;
+    virtual void finishImpl() override;
 
-    z_stream stream = { };
-    stream.next_in = const_cast<Bytef*>(convertByteArrayToUcharPtr(decompressedData));
-    stream.avail_in = decompressedData.size();
+private:
+    /// Throws an exception for the zlib error, unless error can be ignored
+    void handleError(int error);
 
-    std::array<Bytef, 1024> outputBuffer = { };
+    z_stream m_stream;
+    bool m_isEndOfStream = false;
+};
 
-    int error = deflateInit(&stream, Z_BEST_COMPRESSION);
+PDFFlateStreamDecoder::PDFFlateStreamDecoder(PDFStreamDecoderSink sink) :
+    PDFStreamDecoder(qMove(sink)),
+    m_stream()
+{
+    int error = inflateInit(&m_stream);
     if (error != Z_OK)
     {
-        throw PDFException(PDFTranslationContext::tr("Failed to initialize flate compression stream."));
+        throw PDFException(PDFTranslationContext::tr("Failed to initialize flate decompression stream."));
     }
+}
 
-    do
-    {
-        stream.next_out = outputBuffer.data();
-        stream.avail_out = static_cast<uInt>(outputBuffer.size());
-
-        error = deflate(&stream, Z_FINISH);
+PDFFlateStreamDecoder::~PDFFlateStreamDecoder()
+{
+    inflateEnd(&m_stream);
+}
 
-        int bytesWritten = int(outputBuffer.size()) - stream.avail_out;
-        result.append(reinterpret_cast<const char*>(outputBuffer.data()), bytesWritten);
-    } while (error == Z_OK);
+void PDFFlateStreamDecoder::pushImpl(const char* data, qsizetype size)
+{
+    std::array<Bytef, 16384> outputBuffer = { };
 
-    QString errorMessage;
-    if (stream.msg)
+    while (size > 0 && !m_isEndOfStream)
     {
-        errorMessage = QString::fromLatin1(stream.msg);
-    }
+        const uInt inputSize = static_cast<uInt>(qMin<qsizetype>(size, std::numeric_limits<uInt>::max()));
+        m_stream.next_in = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(data));
+        m_stream.avail_in = inputSize;
 
-    deflateEnd(&stream);
+        do
+        {
+            m_stream.next_out = outputBuffer.data();
+            m_stream.avail_out = static_cast<uInt>(outputBuffer.size());
 
-    switch (error)
-    {
-        case Z_STREAM_END:
-            break; // No error, normal behaviour
+            int error = inflate(&m_stream, Z_NO_FLUSH);
 
-        default:
-        {
-            if (errorMessage.isEmpty())
+            int bytesWritten = int(outputBuffer.size()) - m_stream.avail_out;
+            write(reinterpret_cast<const char*>(outputBuffer.data()), bytesWritten);
+
+            if (error == Z_STREAM_END)
             {
-                errorMessage = PDFTranslationContext::tr("zlib code: %1").arg(error);
+                // No error, normal behaviour, remaining data are ignored
+                m_isEndOfStream = true;
+            }
+            else if (error == Z_BUF_ERROR)
+            {
+                // No progress is possible, more input data are needed
+                break;
+            }
+            else if (error != Z_OK)
+            {
+                handleError(error);
             }
+        } while (!m_isEndOfStream && (m_stream.avail_in > 0 || m_stream.avail_out == 0));
 
-            throw PDFException(PDFTranslationContext::tr("Error compressing by flate method: %1").arg(errorMessage));
-        }
+        data += inputSize;
+        size -= inputSize;
     }
 
-    return result;
+    m_stream.next_in = nullptr;
+    m_stream.avail_in = 0;
 }
 
-QByteArray PDFFlateDecodeFilter::recompress(const QByteArray& data)
+void PDFFlateStreamDecoder::finishImpl()
 {
-    QByteArray decompressedData = uncompress(data);
-    return compress(decompressedData);
+    if (!m_isEndOfStream)
+    {
+        // Stream is truncated
+        handleError(Z_BUF_ERROR);
+    }
 }
 
-PDFInteger PDFFlateDecodeFilter::getStreamDataLength(const QByteArray& data, PDFInteger offset) const
+void PDFFlateStreamDecoder::handleError(int error)
 {
-    if (offset < 0 || offset >= data.size())
+    QString errorMessage;
+    if (m_stream.msg)
     {
-        return -1;
+        errorMessage = QString::fromLatin1(m_stream.msg);
     }
 
-    z_stream stream = { };
-    stream.next_in = const_cast<Bytef*>(convertByteArrayToUcharPtr(data) + offset);
-    stream.avail_in = data.size() - offset;
-
-    std::array<Bytef, 1024> outputBuffer = { };
+    const bool ignoreError = error == Z_DATA_ERROR && errorMessage == "incorrect data check";
+    if (ignoreError)
+    {
+        m_isEndOfStream = true;
+        return;
+    }
 
-    int error = inflateInit(&stream);
-    if (error != Z_OK)
+    if (errorMessage.isEmpty())
     {
-        return -1;
+        errorMessage = PDFTranslationContext::tr("zlib code: %1").arg(error);
     }
 
-    do
+    throw PDFException(PDFTranslationContext::tr("Error decompressing by flate method: %1").arg(errorMessage));
+}
+
+/// Backend for flate compression and decompression at once. Backend is chosen
+/// at build time, it is either zlib or libdeflate. Incremental decoding always
+/// uses zlib (libdeflate doesn't support it).
+class PDFFlateBackend
+{
+public:
+    /// Decompresses data at once. Size hint is used to allocate output buffer. Returns
+    /// false, if data can't be decompressed by the backend, then incremental decoder
+    /// should be used (it also correctly handles damaged data).
+    /// \param data Compressed data
+    /// \param decodedSizeHint Expected size of decompressed data, or -1, if unknown
+    /// \param[out] result Decompressed data
+    static bool decompress(const QByteArray& data, qsizetype decodedSizeHint, QByteArray& result);
+
+    /// Compresses data with maximal compress ratio possible.
+    /// \param decompressedData Data to be compressed
+    static QByteArray compress(const QByteArray& decompressedData);
+
+private:
+    /// Returns maximal size of decompressed data (deflate
+    /// can't compress data better than approximately 1:1032)
+    static qsizetype getMaximalDecodedSize(const QByteArray& data) { return qMin<qsizetype>(data.size() * 1032 + 1024, std::numeric_limits<int>::max()); }
+
+    /// Returns size of the output buffer allocated before decompression. Size hint
+    /// is not trusted (damaged stream can declare huge size), so buffer is at most
+    /// a few times larger than compressed data, and it grows during decompression.
+    static qsizetype getInitialDecodedSize(const QByteArray& data, qsizetype decodedSizeHint) { return qMin<qsizetype>(decodedSizeHint, qMin<qsizetype>(data.size() * 16 + 1024, getMaximalDecodedSize(data))); }
+};
+
+#ifdef PDF4QT_USE_LIBDEFLATE
+bool PDFFlateBackend::decompress(const QByteArray& data, qsizetype decodedSizeHint, QByteArray& result)
+{
+    struct DecompressorDeleter
     {
-        stream.next_out = outputBuffer.data();
-        stream.avail_out = static_cast<uInt>(outputBuffer.size());
+        void operator()(libdeflate_decompressor* decompressor) const { libdeflate_free_decompressor(decompressor); }
+    };
 
-        error = inflate(&stream, Z_NO_FLUSH);
-    } while (error == Z_OK);
+    // Decompressor allocation is not cheap, so reuse it in each thread
+    thread_local std::unique_ptr<libdeflate_decompressor, DecompressorDeleter> decompressor(libdeflate_alloc_decompressor());
+    if (!decompressor)
+    {
+        return false;
+    }
 
-    PDFInteger dataLength = stream.total_in;
-    inflateEnd(&stream);
+    const qsizetype maximalSize = getMaximalDecodedSize(data);
+    qsizetype bufferSize = (decodedSizeHint >= 0) ? getInitialDecodedSize(data, decodedSizeHint) : qMin(data.size() * 4 + 1024, maximalSize);
 
-    if (error == Z_STREAM_END)
+    // If size is not known, then we must guess the buffer size, and
+    // if it is too small, we try larger buffer.
+    for (int attempt = 0; attempt < 4; ++attempt)
     {
-        return dataLength;
+        result.resize(bufferSize);
+
+        size_t decodedSize = 0;
+        libdeflate_result decompressResult = libdeflate_zlib_decompress(decompressor.get(), data.constData(), data.size(), result.data(), result.size(), &decodedSize);
+
+        switch (decompressResult)
+        {
+            case LIBDEFLATE_SUCCESS:
+                result.resize(qsizetype(decodedSize));
+                return true;
+
+            case LIBDEFLATE_INSUFFICIENT_SPACE:
+                if (bufferSize >= maximalSize)
+                {
+                    result.clear();
+                    return false;
+                }
+                bufferSize = qMin(bufferSize * 4, maximalSize);
+                break;
+
+            default:
+                result.clear();
+                return false;
+        }
     }
 
-    return -1;
+    result.clear();
+    return false;
 }
 
-QByteArray PDFFlateDecodeFilter::uncompress(const QByteArray& data)
+QByteArray PDFFlateBackend::compress(const QByteArray& decompressedData)
 {
+    struct CompressorDeleter
+    {
+        void operator()(libdeflate_compressor* compressor) const { libdeflate_free_compressor(compressor); }
+    };
+
+    std::unique_ptr<libdeflate_compressor, CompressorDeleter> compressor(libdeflate_alloc_compressor(12));
+    if (!compressor)
+    {
+        throw PDFException(PDFTranslationContext::tr("Failed to initialize flate compression stream."));
+    }
+
     QByteArray result;
+    result.resize(qsizetype(libdeflate_zlib_compress_bound(compressor.get(), decompressedData.size())));
+
+    const size_t compressedSize = libdeflate_zlib_compress(compressor.get(), decompressedData.constData(), decompressedData.size(), result.data(), result.size());
+    if (compressedSize == 0)
+    {
+        throw PDFException(PDFTranslationContext::tr("Error compressing by flate method: %1").arg(PDFTranslationContext::tr("output buffer is too small")));
+    }
+
+    result.resize(qsizetype(compressedSize));
+    return result;
+}
+#else
+bool PDFFlateBackend::decompress(const QByteArray& data, qsizetype decodedSizeHint, QByteArray& result)
+{
+    if (decodedSizeHint < 0 || decodedSizeHint > getMaximalDecodedSize(data) || data.size() > std::numeric_limits<uInt>::max())
+    {
+        // Incremental decoder is as fast as one-shot decompression, if size is unknown
+        return false;
+    }
+
+    // We allocate one more byte, so stream of expected size
+    // is decoded without enlarging the buffer.
+    const qsizetype maximalSize = getMaximalDecodedSize(data);
+    result.resize(getInitialDecodedSize(data, decodedSizeHint) + 1);
 
     z_stream stream = { };
     stream.next_in = const_cast<Bytef*>(convertByteArrayToUcharPtr(data));
-    stream.avail_in = data.size();
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    if (inflateInit(&stream) != Z_OK)
+    {
+        result.clear();
+        return false;
+    }
+
+    int error = Z_OK;
+    while (true)
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(result.data()) + stream.total_out;
+        stream.avail_out = static_cast<uInt>(result.size() - qsizetype(stream.total_out));
+
+        // Z_BUF_ERROR is returned, when output buffer is full, then
+        // we enlarge the buffer and continue the decompression.
+        error = inflate(&stream, Z_FINISH);
+        if (error != Z_BUF_ERROR || stream.avail_out > 0 || result.size() >= maximalSize)
+        {
+            break;
+        }
+
+        result.resize(qMin(result.size() * 2, maximalSize));
+    }
+
+    const qsizetype decodedSize = qsizetype(stream.total_out);
+    inflateEnd(&stream);
+
+    if (error != Z_STREAM_END)
+    {
+        result.clear();
+        return false;
+    }
+
+    result.resize(decodedSize);
+    return true;
+}
+
+QByteArray PDFFlateBackend::compress(const QByteArray& decompressedData)
+{
+    QByteArray result;
+
+    z_stream stream = { };
+    stream.next_in = const_cast<Bytef*>(convertByteArrayToUcharPtr(decompressedData));
+    stream.avail_in = decompressedData.size();
 
     std::array<Bytef, 1024> outputBuffer = { };
 
-    int error = inflateInit(&stream);
+    int error = deflateInit(&stream, Z_BEST_COMPRESSION);
     if (error != Z_OK)
     {
-        throw PDFException(PDFTranslationContext::tr("Failed to initialize flate decompression stream."));
+        throw PDFException(PDFTranslationContext::tr("Failed to initialize flate compression stream."));
     }
 
     do
@@ -503,7 +812,7 @@ QByteArray PDFFlateDecodeFilter::uncompress(const QByteArray& data)
         stream.next_out = outputBuffer.data();
         stream.avail_out = static_cast<uInt>(outputBuffer.size());
 
-        error = inflate(&stream, Z_NO_FLUSH);
+        error = deflate(&stream, Z_FINISH);
 
         int bytesWritten = int(outputBuffer.size()) - stream.avail_out;
         result.append(reinterpret_cast<const char*>(outputBuffer.data()), bytesWritten);
@@ -515,7 +824,7 @@ QByteArray PDFFlateDecodeFilter::uncompress(const QByteArray& data)
         errorMessage = QString::fromLatin1(stream.msg);
     }
 
-    inflateEnd(&stream);
+    deflateEnd(&stream);
 
     switch (error)
     {
@@ -524,61 +833,218 @@ QByteArray PDFFlateDecodeFilter::uncompress(const QByteArray& data)
 
         default:
         {
-            const bool ignoreError = error == Z_DATA_ERROR && errorMessage == "incorrect data check";
+            if (errorMessage.isEmpty())
+            {
+                errorMessage = PDFTranslationContext::tr("zlib code: %1").arg(error);
+            }
+
+            throw PDFException(PDFTranslationContext::tr("Error compressing by flate method: %1").arg(errorMessage));
+        }
+    }
+
+    return result;
+}
+#endif
+
+QByteArray PDFFlateDecodeFilter::apply(const QByteArray& data,
+                                       const PDFObjectFetcher& objectFetcher,
+                                       const PDFObject& parameters,
+                                       const PDFSecurityHandler* securityHandler) const
+{
+    Q_UNUSED(securityHandler);
+
+    return decode(data, objectFetcher, parameters, -1);
+}
+
+QByteArray PDFFlateDecodeFilter::decode(const QByteArray& data,
+                                        const PDFObjectFetcher& objectFetcher,
+                                        const PDFObject& parameters,
+                                        PDFInteger decodedLength) const
+{
+    PDFStreamPredictor predictor = PDFStreamPredictor::createPredictor(objectFetcher, parameters);
+    const qsizetype decodedSizeHint = (decodedLength >= 0) ? predictor.getEncodedSize(decodedLength) : -1;
+    return predictor.apply(uncompress(data, decodedSizeHint));
+}
+
+PDFStreamDecoderPointer PDFFlateDecodeFilter::createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                            const PDFObject& parameters,
+                                                            const PDFSecurityHandler* securityHandler,
+                                                            PDFStreamDecoderSink sink) const
+{
+    Q_UNUSED(securityHandler);
+
+    PDFStreamPredictor predictor = PDFStreamPredictor::createPredictor(objectFetcher, parameters);
+    return predictor.createDecoderWithPredictor(qMove(sink), [](PDFStreamDecoderSink decoderSink) { return std::make_unique<PDFFlateStreamDecoder>(qMove(decoderSink)); });
+}
+
+QByteArray PDFFlateDecodeFilter::compress(const QByteArray& decompressedData)
+{
+    return PDFFlateBackend::compress(decompressedData);
+}
+
+QByteArray PDFFlateDecodeFilter::recompress(const QByteArray& data)
+{
+    QByteArray decompressedData = uncompress(data);
+    return compress(decompressedData);
+}
+
+PDFInteger PDFFlateDecodeFilter::getStreamDataLength(const QByteArray& data, PDFInteger offset) const
+{
+    if (offset < 0 || offset >= data.size())
+    {
+        return -1;
+    }
+
+    z_stream stream = { };
+    stream.next_in = const_cast<Bytef*>(convertByteArrayToUcharPtr(data) + offset);
+    stream.avail_in = data.size() - offset;
+
+    std::array<Bytef, 1024> outputBuffer = { };
+
+    int error = inflateInit(&stream);
+    if (error != Z_OK)
+    {
+        return -1;
+    }
+
+    do
+    {
+        stream.next_out = outputBuffer.data();
+        stream.avail_out = static_cast<uInt>(outputBuffer.size());
+
+        error = inflate(&stream, Z_NO_FLUSH);
+    } while (error == Z_OK);
+
+    PDFInteger dataLength = stream.total_in;
+    inflateEnd(&stream);
+
+    if (error == Z_STREAM_END)
+    {
+        return dataLength;
+    }
+
+    return -1;
+}
+
+QByteArray PDFFlateDecodeFilter::uncompress(const QByteArray& data, qsizetype decodedSizeHint)
+{
+    QByteArray result;
+    if (PDFFlateBackend::decompress(data, decodedSizeHint, result))
+    {
+        return result;
+    }
+
+    return PDFStreamDecoder::decode(data, [](PDFStreamDecoderSink sink) { return std::make_unique<PDFFlateStreamDecoder>(qMove(sink)); });
+}
+
+class PDFRunLengthStreamDecoder : public PDFStreamDecoder
+{
+public:
+    explicit PDFRunLengthStreamDecoder(PDFStreamDecoderSink sink) :
+        PDFStreamDecoder(qMove(sink))
+    {
+
+    }
+
+protected:
+    virtual void pushImpl(const char* data, qsizetype size) override;
+    virtual void finishImpl() override { }
+
+private:
+    enum class State
+    {
+        Length,     ///< Length byte is expected
+        Literal,    ///< Characters are copied literally
+        Repeat,     ///< Character to be repeated is expected
+        End         ///< End of stream marker has been read
+    };
+
+    State m_state = State::Length;
+    int m_count = 0;
+};
+
+void PDFRunLengthStreamDecoder::pushImpl(const char* data, qsizetype size)
+{
+    const char* it = data;
+    const char* itEnd = data + size;
+
+    while (it != itEnd && m_state != State::End)
+    {
+        switch (m_state)
+        {
+            case State::Length:
+            {
+                const unsigned char current = *it++;
+                if (current == 128)
+                {
+                    // End of stream marker
+                    m_state = State::End;
+                }
+                else if (current < 128)
+                {
+                    // Copy n + 1 characters from the input array literally
+                    m_count = static_cast<int>(current) + 1;
+                    m_state = State::Literal;
+                }
+                else
+                {
+                    // Copy 257 - n copies of single character
+                    m_count = 257 - current;
+                    m_state = State::Repeat;
+                }
+                break;
+            }
 
-            if (!ignoreError)
+            case State::Literal:
             {
-                if (errorMessage.isEmpty())
+                const int count = static_cast<int>(qMin<qsizetype>(m_count, std::distance(it, itEnd)));
+                write(it, count);
+                std::advance(it, count);
+
+                m_count -= count;
+                if (m_count == 0)
                 {
-                    errorMessage = PDFTranslationContext::tr("zlib code: %1").arg(error);
+                    m_state = State::Length;
                 }
+                break;
+            }
 
-                throw PDFException(PDFTranslationContext::tr("Error decompressing by flate method: %1").arg(errorMessage));
+            case State::Repeat:
+            {
+                const char toBeCopied = *it++;
+                for (int i = 0; i < m_count; ++i)
+                {
+                    write(toBeCopied);
+                }
+                m_state = State::Length;
+                break;
             }
+
+            case State::End:
+                Q_ASSERT(false);
+                break;
         }
     }
-
-    return result;
 }
 
 QByteArray PDFRunLengthDecodeFilter::apply(const QByteArray& data,
                                            const PDFObjectFetcher& objectFetcher,
                                            const PDFObject& parameters,
                                            const PDFSecurityHandler* securityHandler) const
+{
+    return applyDecoder(data, objectFetcher, parameters, securityHandler);
+}
+
+PDFStreamDecoderPointer PDFRunLengthDecodeFilter::createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                                const PDFObject& parameters,
+                                                                const PDFSecurityHandler* securityHandler,
+                                                                PDFStreamDecoderSink sink) const
 {
     Q_UNUSED(objectFetcher);
     Q_UNUSED(parameters);
     Q_UNUSED(securityHandler);
 
-    QByteArray result;
-    result.reserve(data.size() * 2);
-
-    auto itEnd = data.cend();
-    for (auto it = data.cbegin(); it != itEnd;)
-    {
-        const unsigned char current = *it++;
-        if (current == 128)
-        {
-            // End of stream marker
-            break;
-        }
-        else if (current < 128)
-        {
-            // Copy n + 1 characters from the input array literally (and advance iterators)
-            const int count = static_cast<int>(current) + 1;
-            std::copy(it, std::next(it, count), std::back_inserter(result));
-            std::advance(it, count);
-        }
-        else if (current > 128)
-        {
-            // Copy 257 - n copies of single character
-            const int count = 257 - current;
-            const char toBeCopied = *it++;
-            std::fill_n(std::back_inserter(result), count, toBeCopied);
-        }
-    }
-
-    return result;
+    return std::make_unique<PDFRunLengthStreamDecoder>(qMove(sink));
 }
 
 const PDFStreamFilter* PDFStreamFilterStorage::getFilter(const QByteArray& filterName)
@@ -684,15 +1150,41 @@ QByteArray PDFStreamFilterStorage::getDecodedStream(const PDFStream* stream, con
         return QByteArray();
     }
 
-    for (size_t i = 0, count = streamFilters.filterObjects.size(); i < count; ++i)
+    const PDFStreamFilter* flateFilter = getFilter("FlateDecode");
+    auto isActiveFilter = [](const PDFStreamFilter* filter) { return filter != nullptr; };
+    if (std::count_if(streamFilters.filterObjects.cbegin(), streamFilters.filterObjects.cend(), isActiveFilter) == 1)
     {
-        const PDFStreamFilter* streamFilter = streamFilters.filterObjects[i];
-        const PDFObject& streamFilterParameters = streamFilters.filterParameterObjects[i];
+        // Most common case - stream is compressed only by flate method. Then we decode
+        // whole data at once, so fast one-shot decompression can be used.
+        auto it = std::find_if(streamFilters.filterObjects.cbegin(), streamFilters.filterObjects.cend(), isActiveFilter);
+        if (*it == flateFilter)
+        {
+            const size_t index = std::distance(streamFilters.filterObjects.cbegin(), it);
+            const PDFInteger decodedLength = getDecodedLengthHint(stream, objectFetcher);
+            return static_cast<const PDFFlateDecodeFilter*>(flateFilter)->decode(result, objectFetcher, streamFilters.filterParameterObjects[index], decodedLength);
+        }
+    }
 
-        if (streamFilter)
+    // Filters are applied incrementally, so intermediate
+    // results of the filters are not held in memory.
+    QByteArray decodedData;
+    PDFStreamDecoderPointer decoder = createDecoder(streamFilters, objectFetcher, securityHandler, [&decodedData](const char* data, qsizetype size) { decodedData.append(data, size); });
+    if (decoder)
+    {
+        for (qsizetype offset = 0; offset < result.size(); offset += PDFStreamDecoder::CHUNK_SIZE)
         {
-            result = streamFilter->apply(result, objectFetcher, streamFilterParameters, securityHandler);
+            decoder->push(result.constData() + offset, qMin(PDFStreamDecoder::CHUNK_SIZE, result.size() - offset));
         }
+        decoder->finish();
+        result = qMove(decodedData);
+    }
+
+    // If content of the stream is referenced (for example, from memory mapped file),
+    // and no filter has been applied, then we must slice the data out of the source,
+    // because decoded data can outlive the source.
+    if (stream->isContentReferenced() && result.constData() == stream->getContent()->constData())
+    {
+        result.detach();
     }
 
     return result;
@@ -703,25 +1195,161 @@ QByteArray PDFStreamFilterStorage::getDecodedStream(const PDFStream* stream, con
     return getDecodedStream(stream, [](const PDFObject& object) -> const PDFObject& { return object; }, securityHandler);
 }
 
-PDFInteger PDFStreamFilterStorage::getStreamDataLength(const QByteArray& data, const QByteArray& filterName, PDFInteger offset)
+bool PDFStreamFilterStorage::decodeStream(const PDFStream* stream, const PDFObjectFetcher& objectFetcher, const PDFSecurityHandler* securityHandler, PDFStreamDecoderSink sink)
 {
-    if (const PDFStreamFilter* filter = getFilter(filterName))
+    StreamFilters streamFilters = getStreamFilters(stream, objectFetcher);
+    if (!streamFilters.valid)
     {
-        return filter->getStreamDataLength(data, offset);
+        // Stream filters are invalid
+        return false;
     }
 
-    return -1;
+    const QByteArray* content = stream->getContent();
+    PDFStreamDecoderPointer decoder = createDecoder(streamFilters, objectFetcher, securityHandler, sink);
+    for (qsizetype offset = 0; offset < content->size(); offset += PDFStreamDecoder::CHUNK_SIZE)
+    {
+        const qsizetype size = qMin(PDFStreamDecoder::CHUNK_SIZE, content->size() - offset);
+        if (decoder)
+        {
+            decoder->push(content->constData() + offset, size);
+        }
+        else
+        {
+            sink(content->constData() + offset, size);
+        }
+    }
+
+    if (decoder)
+    {
+        decoder->finish();
+    }
+
+    return true;
 }
 
-PDFStreamFilterStorage::PDFStreamFilterStorage()
+PDFInteger PDFStreamFilterStorage::getDecodedLengthHint(const PDFStream* stream, const PDFObjectFetcher& objectFetcher)
 {
-    // Initialize map with the filters
-    m_filters["ASCIIHexDecode"] = std::make_unique<PDFAsciiHexDecodeFilter>();
-    m_filters["ASCII85Decode"] = std::make_unique<PDFAscii85DecodeFilter>();
-    m_filters["LZWDecode"] = std::make_unique<PDFLzwDecodeFilter>();
-    m_filters["FlateDecode"] = std::make_unique<PDFFlateDecodeFilter>();
-    m_filters["RunLengthDecode"] = std::make_unique<PDFRunLengthDecodeFilter>();
-    m_filters["Crypt"] = std::make_unique<PDFCryptFilter>();
+    const PDFDictionary* dictionary = stream->getDictionary();
+
+    auto getInteger = [dictionary, &objectFetcher](const char* key) -> PDFInteger
+    {
+        const PDFObject& object = objectFetcher(dictionary->get(key));
+        return object.isInt() ? object.getInteger() : -1;
+    };
+
+    auto getName = [dictionary, &objectFetcher](const char* key) -> QByteArray
+    {
+        const PDFObject& object = objectFetcher(dictionary->get(key));
+        return object.isName() ? object.getString() : QByteArray();
+    };
+
+    const PDFInteger decodedLength = getInteger(PDF_STREAM_DICT_DECODED_LENGTH);
+    if (decodedLength >= 0)
+    {
+        return decodedLength;
+    }
+
+    if (getName("Subtype") != "Image")
+    {
+        return -1;
+    }
+
+    const PDFInteger width = getInteger("Width");
+    const PDFInteger height = getInteger("Height");
+    PDFInteger bitsPerComponent = getInteger("BitsPerComponent");
+    PDFInteger components = -1;
+
+    const PDFObject& imageMaskObject = objectFetcher(dictionary->get("ImageMask"));
+    if (imageMaskObject.isBool() && imageMaskObject.getBool())
+    {
+        components = 1;
+        bitsPerComponent = 1;
+    }
+    else
+    {
+        const QByteArray colorSpaceName = getName("ColorSpace");
+        if (colorSpaceName == "DeviceGray" || colorSpaceName == "G")
+        {
+            components = 1;
+        }
+        else if (colorSpaceName == "DeviceRGB" || colorSpaceName == "RGB")
+        {
+            components = 3;
+        }
+        else if (colorSpaceName == "DeviceCMYK" || colorSpaceName == "CMYK")
+        {
+            components = 4;
+        }
+    }
+
+    // Avoid overflows for damaged images
+    constexpr PDFInteger MAX_DIMENSION = 1 << 20;
+    if (width <= 0 || height <= 0 || width > MAX_DIMENSION || height > MAX_DIMENSION ||
+        bitsPerComponent <= 0 || bitsPerComponent > 16 || components <= 0)
+    {
+        return -1;
+    }
+
+    const PDFInteger stride = (width * components * bitsPerComponent + 7) / 8;
+    return stride * height;
+}
+
+PDFStreamDecoderPointer PDFStreamFilterStorage::createDecoder(const StreamFilters& streamFilters,
+                                                              const PDFObjectFetcher& objectFetcher,
+                                                              const PDFSecurityHandler* securityHandler,
+                                                              PDFStreamDecoderSink sink)
+{
+    PDFStreamDecoderPointer decoder;
+
+    // Create decoders from the last one, because each decoder
+    // must push decoded data to the decoder of the next filter.
+    for (size_t i = streamFilters.filterObjects.size(); i > 0; --i)
+    {
+        const PDFStreamFilter* streamFilter = streamFilters.filterObjects[i - 1];
+        const PDFObject& streamFilterParameters = streamFilters.filterParameterObjects[i - 1];
+
+        if (!streamFilter)
+        {
+            continue;
+        }
+
+        PDFStreamDecoderSink filterSink = sink;
+        if (decoder)
+        {
+            PDFStreamDecoder* nextDecoder = decoder.get();
+            filterSink = [nextDecoder](const char* data, qsizetype size) { nextDecoder->push(data, size); };
+        }
+
+        PDFStreamDecoderPointer filterDecoder = streamFilter->createDecoder(objectFetcher, streamFilterParameters, securityHandler, qMove(filterSink));
+        if (decoder)
+        {
+            filterDecoder->appendDecoder(qMove(decoder));
+        }
+        decoder = qMove(filterDecoder);
+    }
+
+    return decoder;
+}
+
+PDFInteger PDFStreamFilterStorage::getStreamDataLength(const QByteArray& data, const QByteArray& filterName, PDFInteger offset)
+{
+    if (const PDFStreamFilter* filter = getFilter(filterName))
+    {
+        return filter->getStreamDataLength(data, offset);
+    }
+
+    return -1;
+}
+
+PDFStreamFilterStorage::PDFStreamFilterStorage()
+{
+    // Initialize map with the filters
+    m_filters["ASCIIHexDecode"] = std::make_unique<PDFAsciiHexDecodeFilter>();
+    m_filters["ASCII85Decode"] = std::make_unique<PDFAscii85DecodeFilter>();
+    m_filters["LZWDecode"] = std::make_unique<PDFLzwDecodeFilter>();
+    m_filters["FlateDecode"] = std::make_unique<PDFFlateDecodeFilter>();
+    m_filters["RunLengthDecode"] = std::make_unique<PDFRunLengthDecodeFilter>();
+    m_filters["Crypt"] = std::make_unique<PDFCryptFilter>();
 
     m_abbreviations["AHx"] = "ASCIIHexDecode";
     m_abbreviations["A85"] = "ASCII85Decode";
@@ -778,160 +1406,675 @@ PDFStreamPredictor PDFStreamPredictor::createPredictor(const PDFObjectFetcher& o
     return PDFStreamPredictor();
 }
 
-QByteArray PDFStreamPredictor::apply(const QByteArray& data) const
+PDFStreamPredictor::PDFStreamPredictor(Predictor predictor, int components, int bitsPerComponent, int columns) :
+    m_predictor(predictor),
+    m_components(components),
+    m_bitsPerComponent(bitsPerComponent),
+    m_columns(columns),
+    m_stride(0)
 {
-    switch (m_predictor)
+    // Stride is computed in 64-bit arithmetic, because columns are read from
+    // the stream dictionary and invalid value can overflow the integer.
+    const qint64 stride = (qint64(m_columns) * qint64(m_components) * qint64(m_bitsPerComponent) + 7) / 8;
+    if (stride <= 0 || stride > MAX_STRIDE)
     {
-        case NoPredictor:
-            return data;
+        throw PDFException(PDFTranslationContext::tr("Invalid line length %1 of the stream predictor.").arg(stride));
+    }
 
-        case TIFF:
-            return applyTIFFPredictor(data);
+    m_stride = int(stride);
+}
 
-        default:
+/// Kernels for undoing PNG predictors on one line of 8-bit samples. Each kernel
+/// decodes \p size bytes of \p raw data into \p current line, \p previous line
+/// is the decoded line above. Bytes before the start of the lines (\p pixelBytes bytes)
+/// must be readable and must be zero.
+class PDFStreamPredictorKernels
+{
+public:
+    /// Undoes PNG predictor. Returns false, if no SIMD kernel
+    /// exists for given predictor and pixel size.
+    static bool decodePNG(int predictor, int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+
+    /// Undoes "Sub" predictor (it is also TIFF predictor for 8-bit samples).
+    /// Returns false, if no SIMD kernel exists for given pixel size.
+    static bool decodeSub(int pixelBytes, const uint8_t* raw, uint8_t* current, int size);
+
+private:
+#if defined(PDF4QT_SIMD_SSE2)
+    static __m128i loadPixelSSE2(const uint8_t* data, int pixelBytes)
+    {
+        uint32_t value = 0;
+        std::memcpy(&value, data, pixelBytes);
+        return _mm_cvtsi32_si128(static_cast<int>(value));
+    }
+
+    static void storePixelSSE2(uint8_t* data, __m128i value, int pixelBytes)
+    {
+        const uint32_t storedValue = static_cast<uint32_t>(_mm_cvtsi128_si32(value));
+        std::memcpy(data, &storedValue, pixelBytes);
+    }
+
+    static __m128i abs16SSE2(__m128i value) { return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value)); }
+    static __m128i selectSSE2(__m128i mask, __m128i a, __m128i b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+    static int decodeUpSSE2(const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size, int i);
+    static int decodeSubSSE2(int pixelBytes, const uint8_t* raw, uint8_t* current, int size);
+    static int decodeAverageSSE2(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+    static int decodePaethSSE2(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static int decodeUpAVX2(const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static uint8x8_t loadPixelNEON(const uint8_t* data, int pixelBytes)
+    {
+        uint64_t value = 0;
+        std::memcpy(&value, data, pixelBytes);
+        return vcreate_u8(value);
+    }
+
+    static void storePixelNEON(uint8_t* data, uint8x8_t value, int pixelBytes)
+    {
+        const uint32_t storedValue = vget_lane_u32(vreinterpret_u32_u8(value), 0);
+        std::memcpy(data, &storedValue, pixelBytes);
+    }
+
+    static int decodeUpNEON(const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+    static int decodeSubNEON(int pixelBytes, const uint8_t* raw, uint8_t* current, int size);
+    static int decodeAverageNEON(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+    static int decodePaethNEON(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size);
+#endif
+
+    /// Decodes remaining bytes of the line, starting from \p i, using scalar code
+    static void decodeTail(int predictor, int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size, int i);
+};
+
+bool PDFStreamPredictorKernels::decodePNG(int predictor, int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    const PDFSimd::InstructionSet instructionSet = PDFSimd::getInstructionSet();
+    if (instructionSet == PDFSimd::InstructionSet::Scalar)
+    {
+        return false;
+    }
+
+    // Sub, Average and Paeth predictors depend on the previous pixel, so
+    // we can compute in parallel only components of single pixel. Up predictor
+    // can be computed in parallel for whole line.
+    const bool isPixelKernel = pixelBytes == 3 || pixelBytes == 4;
+    int i = -1;
+
+    switch (predictor)
+    {
+        case 12: // PNG_Up
         {
-            if (m_predictor >= 10)
+#if defined(PDF4QT_SIMD_AVX2)
+            if (instructionSet == PDFSimd::InstructionSet::AVX2)
             {
-                return applyPNGPredictor(data);
+                i = decodeUpSSE2(raw, previous, current, size, decodeUpAVX2(raw, previous, current, size));
+                break;
             }
+#endif
+#if defined(PDF4QT_SIMD_SSE2)
+            i = decodeUpSSE2(raw, previous, current, size, 0);
+#elif defined(PDF4QT_SIMD_NEON)
+            i = decodeUpNEON(raw, previous, current, size);
+#endif
             break;
         }
+
+        case 11: // PNG_Sub
+        {
+            if (isPixelKernel)
+            {
+#if defined(PDF4QT_SIMD_SSE2)
+                i = decodeSubSSE2(pixelBytes, raw, current, size);
+#elif defined(PDF4QT_SIMD_NEON)
+                i = decodeSubNEON(pixelBytes, raw, current, size);
+#endif
+            }
+            break;
+        }
+
+        case 13: // PNG_Average
+        {
+            if (isPixelKernel)
+            {
+#if defined(PDF4QT_SIMD_SSE2)
+                i = decodeAverageSSE2(pixelBytes, raw, previous, current, size);
+#elif defined(PDF4QT_SIMD_NEON)
+                i = decodeAverageNEON(pixelBytes, raw, previous, current, size);
+#endif
+            }
+            break;
+        }
+
+        case 14: // PNG_Paeth
+        {
+            if (isPixelKernel)
+            {
+#if defined(PDF4QT_SIMD_SSE2)
+                i = decodePaethSSE2(pixelBytes, raw, previous, current, size);
+#elif defined(PDF4QT_SIMD_NEON)
+                i = decodePaethNEON(pixelBytes, raw, previous, current, size);
+#endif
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    if (i < 0)
+    {
+        return false;
+    }
+
+    decodeTail(predictor, pixelBytes, raw, previous, current, size, i);
+    return true;
+}
+
+bool PDFStreamPredictorKernels::decodeSub(int pixelBytes, const uint8_t* raw, uint8_t* current, int size)
+{
+    return decodePNG(11, pixelBytes, raw, nullptr, current, size);
+}
+
+void PDFStreamPredictorKernels::decodeTail(int predictor, int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size, int i)
+{
+    for (; i < size; ++i)
+    {
+        switch (predictor)
+        {
+            case 11:
+                current[i] = current[i - pixelBytes] + raw[i];
+                break;
+
+            case 12:
+                current[i] = previous[i] + raw[i];
+                break;
+
+            case 13:
+                current[i] = (current[i - pixelBytes] + previous[i]) / 2 + raw[i];
+                break;
+
+            case 14:
+            {
+                const int a = current[i - pixelBytes];
+                const int b = previous[i];
+                const int c = previous[i - pixelBytes];
+                const int p = a + b - c;
+                const int pa = std::abs(p - a);
+                const int pb = std::abs(p - b);
+                const int pc = std::abs(p - c);
+                if (pa <= pb && pa <= pc)
+                {
+                    current[i] = a + raw[i];
+                }
+                else if (pb <= pc)
+                {
+                    current[i] = b + raw[i];
+                }
+                else
+                {
+                    current[i] = c + raw[i];
+                }
+                break;
+            }
+
+            default:
+                Q_ASSERT(false);
+                break;
+        }
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+int PDFStreamPredictorKernels::decodeUpSSE2(const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size, int i)
+{
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i rawData = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i));
+        const __m128i previousData = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(current + i), _mm_add_epi8(rawData, previousData));
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid predictor algorithm."));
+    return i;
 }
 
-QByteArray PDFStreamPredictor::applyPNGPredictor(const QByteArray& data) const
+int PDFStreamPredictorKernels::decodeSubSSE2(int pixelBytes, const uint8_t* raw, uint8_t* current, int size)
 {
-    QByteArray outputData;
-    outputData.reserve(data.size());
+    __m128i a = _mm_setzero_si128();
 
-    auto it = data.cbegin();
-    auto itEnd = data.cend();
+    int i = 0;
+    for (; i + pixelBytes <= size; i += pixelBytes)
+    {
+        a = _mm_add_epi8(a, loadPixelSSE2(raw + i, pixelBytes));
+        storePixelSSE2(current + i, a, pixelBytes);
+    }
+
+    return i;
+}
+
+int PDFStreamPredictorKernels::decodeAverageSSE2(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + pixelBytes <= size; i += pixelBytes)
+    {
+        // Average instruction rounds up, so we must correct the result
+        const __m128i b = loadPixelSSE2(previous + i, pixelBytes);
+        __m128i average = _mm_avg_epu8(a, b);
+        average = _mm_sub_epi8(average, _mm_and_si128(_mm_xor_si128(a, b), one));
+
+        a = _mm_add_epi8(loadPixelSSE2(raw + i, pixelBytes), average);
+        storePixelSSE2(current + i, a, pixelBytes);
+    }
+
+    return i;
+}
+
+int PDFStreamPredictorKernels::decodePaethSSE2(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    // We compute in 16-bit integers, to avoid overflows
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi16(0xFF);
+    __m128i a = zero;
+    __m128i c = zero;
+
+    int i = 0;
+    for (; i + pixelBytes <= size; i += pixelBytes)
+    {
+        const __m128i b = _mm_unpacklo_epi8(loadPixelSSE2(previous + i, pixelBytes), zero);
+        const __m128i x = _mm_unpacklo_epi8(loadPixelSSE2(raw + i, pixelBytes), zero);
+
+        // p = a + b - c, so pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+        const __m128i bc = _mm_sub_epi16(b, c);
+        const __m128i ac = _mm_sub_epi16(a, c);
+        const __m128i pa = abs16SSE2(bc);
+        const __m128i pb = abs16SSE2(ac);
+        const __m128i pc = abs16SSE2(_mm_add_epi16(bc, ac));
+        const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+        // Ties are broken in the order a, b, c
+        const __m128i nearest = selectSSE2(_mm_cmpeq_epi16(smallest, pa), a, selectSSE2(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+        a = _mm_and_si128(_mm_add_epi16(nearest, x), mask);
+        c = b;
+        storePixelSSE2(current + i, _mm_packus_epi16(a, a), pixelBytes);
+    }
+
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+PDF4QT_SIMD_AVX2_FUNCTION int PDFStreamPredictorKernels::decodeUpAVX2(const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    int i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i rawData = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(raw + i));
+        const __m256i previousData = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(current + i), _mm256_add_epi8(rawData, previousData));
+    }
+
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+int PDFStreamPredictorKernels::decodeUpNEON(const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    int i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        vst1q_u8(current + i, vaddq_u8(vld1q_u8(raw + i), vld1q_u8(previous + i)));
+    }
+
+    return i;
+}
+
+int PDFStreamPredictorKernels::decodeSubNEON(int pixelBytes, const uint8_t* raw, uint8_t* current, int size)
+{
+    uint8x8_t a = vdup_n_u8(0);
+
+    int i = 0;
+    for (; i + pixelBytes <= size; i += pixelBytes)
+    {
+        a = vadd_u8(a, loadPixelNEON(raw + i, pixelBytes));
+        storePixelNEON(current + i, a, pixelBytes);
+    }
+
+    return i;
+}
+
+int PDFStreamPredictorKernels::decodeAverageNEON(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    uint8x8_t a = vdup_n_u8(0);
 
-    int pixelBytes = (m_components * m_bitsPerComponent + 7) / 8;
+    int i = 0;
+    for (; i + pixelBytes <= size; i += pixelBytes)
+    {
+        // Halving add rounds down, as required
+        a = vadd_u8(loadPixelNEON(raw + i, pixelBytes), vhadd_u8(a, loadPixelNEON(previous + i, pixelBytes)));
+        storePixelNEON(current + i, a, pixelBytes);
+    }
+
+    return i;
+}
+
+int PDFStreamPredictorKernels::decodePaethNEON(int pixelBytes, const uint8_t* raw, const uint8_t* previous, uint8_t* current, int size)
+{
+    uint8x8_t a = vdup_n_u8(0);
+    uint8x8_t c = vdup_n_u8(0);
 
-    auto readByte = [&it, &itEnd]() -> uint8_t
+    int i = 0;
+    for (; i + pixelBytes <= size; i += pixelBytes)
     {
-        if (it != itEnd)
+        const uint8x8_t b = loadPixelNEON(previous + i, pixelBytes);
+
+        // p = a + b - c, so pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+        const uint16x8_t pa = vabdl_u8(b, c);
+        const uint16x8_t pb = vabdl_u8(a, c);
+        const int16x8_t bc = vreinterpretq_s16_u16(vsubl_u8(b, c));
+        const int16x8_t ac = vreinterpretq_s16_u16(vsubl_u8(a, c));
+        const uint16x8_t pc = vreinterpretq_u16_s16(vabsq_s16(vaddq_s16(bc, ac)));
+        const uint16x8_t smallest = vminq_u16(pc, vminq_u16(pa, pb));
+
+        // Ties are broken in the order a, b, c
+        const uint8x8_t useA = vmovn_u16(vceqq_u16(smallest, pa));
+        const uint8x8_t useB = vmovn_u16(vceqq_u16(smallest, pb));
+        const uint8x8_t nearest = vbsl_u8(useA, a, vbsl_u8(useB, b, c));
+
+        a = vadd_u8(loadPixelNEON(raw + i, pixelBytes), nearest);
+        c = b;
+        storePixelNEON(current + i, a, pixelBytes);
+    }
+
+    return i;
+}
+#endif
+
+class PDFStreamPredictorDecoder : public PDFStreamDecoder
+{
+public:
+    explicit PDFStreamPredictorDecoder(PDFStreamDecoderSink sink, const PDFStreamPredictor& predictor);
+
+protected:
+    virtual void pushImpl(const char* data, qsizetype size) override;
+    virtual void finishImpl() override;
+
+private:
+    /// Decodes one line of the data. Data of the line are in the line buffer.
+    void decodeLine();
+
+    /// Applies PNG predictor to the line
+    void decodePNGLine();
+
+    /// Applies TIFF predictor to the line
+    void decodeTIFFLine();
+
+    PDFStreamPredictor m_predictor;
+    int m_pixelBytes = 0;
+
+    /// Buffer for encoded line data, for PNG
+    /// predictor, first byte is the line predictor.
+    QByteArray m_lineBuffer;
+    qsizetype m_lineBufferSize = 0;
+
+    // Idea: to avoid using if for many cases, we use larger buffer filled with zeros
+    std::vector<uint8_t> m_line;
+    std::vector<uint8_t> m_lineOld;
+};
+
+PDFStreamPredictorDecoder::PDFStreamPredictorDecoder(PDFStreamDecoderSink sink, const PDFStreamPredictor& predictor) :
+    PDFStreamDecoder(qMove(sink)),
+    m_predictor(predictor)
+{
+    if (m_predictor.m_predictor == PDFStreamPredictor::TIFF)
+    {
+        m_lineBuffer.resize(m_predictor.m_stride);
+
+        // Line for decoding 8-bit components, first pixel is zero
+        m_line.resize(m_predictor.m_components + m_predictor.m_stride, 0);
+    }
+    else if (m_predictor.m_predictor >= PDFStreamPredictor::PNG_None)
+    {
+        m_pixelBytes = (m_predictor.m_components * m_predictor.m_bitsPerComponent + 7) / 8;
+
+        const int totalBytes = m_predictor.m_stride + m_pixelBytes;
+        m_line.resize(totalBytes, 0);
+        m_lineOld.resize(totalBytes, 0);
+        m_lineBuffer.resize(m_predictor.m_stride + 1);
+    }
+    else
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid predictor algorithm."));
+    }
+}
+
+void PDFStreamPredictorDecoder::pushImpl(const char* data, qsizetype size)
+{
+    while (size > 0)
+    {
+        const qsizetype count = qMin(size, m_lineBuffer.size() - m_lineBufferSize);
+        if (count <= 0)
         {
-            return static_cast<uint8_t>(*it++);
+            // Line buffer can't accept any data
+            throw PDFException(PDFTranslationContext::tr("Invalid line length of the stream predictor."));
         }
 
-        // According to the PDF specification, incomplete line is completed. For this
-        // reason, we behave as we have zero data in the buffer.
-        return 0;
-    };
+        std::copy(data, data + count, m_lineBuffer.data() + m_lineBufferSize);
+        m_lineBufferSize += count;
+        data += count;
+        size -= count;
 
-    // Idea: to avoid using if for many cases, we use larger buffer filled with zeros
-    const int totalBytes = m_stride + pixelBytes;
-    std::vector<uint8_t> line(totalBytes, 0);
-    std::vector<uint8_t> lineOld(totalBytes, 0);
+        if (m_lineBufferSize == m_lineBuffer.size())
+        {
+            decodeLine();
+        }
+    }
+}
+
+void PDFStreamPredictorDecoder::finishImpl()
+{
+    if (m_lineBufferSize > 0)
+    {
+        if (m_predictor.m_predictor == PDFStreamPredictor::TIFF)
+        {
+            // Line is incomplete, bit reader will report an error
+            m_lineBuffer.resize(m_lineBufferSize);
+        }
+        else
+        {
+            // According to the PDF specification, incomplete line is completed. For this
+            // reason, we behave as we have zero data in the buffer.
+            std::fill(m_lineBuffer.begin() + m_lineBufferSize, m_lineBuffer.end(), 0);
+        }
+
+        decodeLine();
+    }
+}
 
-    Predictor currentPredictor = m_predictor;
-    while (it != itEnd)
+void PDFStreamPredictorDecoder::decodeLine()
+{
+    if (m_predictor.m_predictor == PDFStreamPredictor::TIFF)
     {
-        // First, read the predictor data for current line
-        currentPredictor = static_cast<Predictor>(readByte() + 10);
+        decodeTIFFLine();
+    }
+    else
+    {
+        decodePNGLine();
+    }
 
-        for (int i = 0; i < m_stride; ++i)
+    m_lineBufferSize = 0;
+}
+
+void PDFStreamPredictorDecoder::decodePNGLine()
+{
+    using Predictor = PDFStreamPredictor::Predictor;
+
+    const uint8_t* lineData = reinterpret_cast<const uint8_t*>(m_lineBuffer.constData());
+    const int stride = m_predictor.m_stride;
+
+    // First, read the predictor data for current line
+    const Predictor currentPredictor = static_cast<Predictor>(lineData[0] + 10);
+
+    const bool isDecoded = currentPredictor != PDFStreamPredictor::PNG_None &&
+                           PDFStreamPredictorKernels::decodePNG(currentPredictor, m_pixelBytes, lineData + 1, m_lineOld.data() + m_pixelBytes, m_line.data() + m_pixelBytes, stride);
+
+    for (int i = 0; i < stride && !isDecoded; ++i)
+    {
+        uint8_t currentByte = lineData[i + 1];
+
+        int lineIndex = i + m_pixelBytes;
+        switch (currentPredictor)
         {
-            uint8_t currentByte = readByte();
+            case PDFStreamPredictor::PNG_Sub:
+            {
+                m_line[lineIndex] = m_line[i] + currentByte;
+                break;
+            }
 
-            int lineIndex = i + pixelBytes;
-            switch (currentPredictor)
+            case PDFStreamPredictor::PNG_Up:
             {
-                case PNG_Sub:
-                {
-                    line[lineIndex] = line[i] + currentByte;
-                    break;
-                }
+                m_line[lineIndex] = m_lineOld[lineIndex] + currentByte;
+                break;
+            }
 
-                case PNG_Up:
-                {
-                    line[lineIndex] = lineOld[lineIndex] + currentByte;
-                    break;
-                }
+            case PDFStreamPredictor::PNG_Average:
+            {
+                m_line[lineIndex] = (m_lineOld[lineIndex] + m_line[i]) / 2 + currentByte;
+                break;
+            }
 
-                case PNG_Average:
+            case PDFStreamPredictor::PNG_Paeth:
+            {
+                // a = left,
+                // b = upper,
+                // c = upper left
+                const int a = m_line[i];
+                const int b = m_lineOld[lineIndex];
+                const int c = m_lineOld[i];
+                const int p = a + b - c;
+                const int pa = std::abs(p - a);
+                const int pb = std::abs(p - b);
+                const int pc = std::abs(p - c);
+                if (pa <= pb && pa <= pc)
                 {
-                    line[lineIndex] = (lineOld[lineIndex] + line[i]) / 2 + currentByte;
-                    break;
+                    m_line[lineIndex] = a + currentByte;
                 }
-
-                case PNG_Paeth:
+                else if (pb <= pc)
                 {
-                    // a = left,
-                    // b = upper,
-                    // c = upper left
-                    const int a = line[i];
-                    const int b = lineOld[lineIndex];
-                    const int c = lineOld[i];
-                    const int p = a + b - c;
-                    const int pa = std::abs(p - a);
-                    const int pb = std::abs(p - b);
-                    const int pc = std::abs(p - c);
-                    if (pa <= pb && pa <= pc)
-                    {
-                        line[lineIndex] = a + currentByte;
-                    }
-                    else if (pb <= pc)
-                    {
-                        line[lineIndex] = b + currentByte;
-                    }
-                    else
-                    {
-                        line[lineIndex] = c + currentByte;
-                    }
-                    break;
+                    m_line[lineIndex] = b + currentByte;
                 }
-
-                case PNG_None:
-                default:
+                else
                 {
-                    line[lineIndex] = currentByte;
-                    break;
+                    m_line[lineIndex] = c + currentByte;
                 }
+                break;
             }
 
-            // Fill the output buffer
-            outputData.push_back(static_cast<char>(line[lineIndex]));
+            case PDFStreamPredictor::PNG_None:
+            default:
+            {
+                m_line[lineIndex] = currentByte;
+                break;
+            }
         }
-
-        // Swap the buffers
-        std::swap(line, lineOld);
     }
 
-    return outputData;
+    // Fill the output buffer
+    write(reinterpret_cast<const char*>(m_line.data() + m_pixelBytes), stride);
+
+    // Swap the buffers
+    std::swap(m_line, m_lineOld);
 }
 
-QByteArray PDFStreamPredictor::applyTIFFPredictor(const QByteArray& data) const
+void PDFStreamPredictorDecoder::decodeTIFFLine()
 {
-    Q_UNUSED(data);
+    const int components = m_predictor.m_components;
+    const int bitsPerComponent = m_predictor.m_bitsPerComponent;
 
-    PDFBitWriter writer(m_bitsPerComponent);
-    PDFBitReader reader(&data, m_bitsPerComponent);
+    if (bitsPerComponent == 8 && m_lineBuffer.size() == m_predictor.m_stride)
+    {
+        // For 8-bit components, TIFF predictor is the same as PNG "Sub" predictor
+        const uint8_t* lineData = reinterpret_cast<const uint8_t*>(m_lineBuffer.constData());
+        if (PDFStreamPredictorKernels::decodeSub(components, lineData, m_line.data() + components, m_predictor.m_stride))
+        {
+            write(reinterpret_cast<const char*>(m_line.data() + components), m_predictor.m_stride);
+            return;
+        }
+    }
+
+    PDFBitWriter writer(bitsPerComponent);
+    PDFBitReader reader(&m_lineBuffer, bitsPerComponent);
 
-    writer.reserve(data.size());
-    std::vector<uint32_t> leftValues(m_components, 0);
+    writer.reserve(int(m_lineBuffer.size()));
+    std::vector<uint32_t> leftValues(components, 0);
 
-    while (!reader.isAtEnd())
+    for (int i = 0; i < m_predictor.m_columns; ++i)
     {
-        for (int i = 0; i < m_columns; ++i)
+        for (int componentIndex = 0; componentIndex < components; ++componentIndex)
         {
-            for (int componentIndex = 0; componentIndex < m_components; ++componentIndex)
-            {
-                leftValues[componentIndex] = (leftValues[componentIndex] + reader.read()) & reader.max();
-                writer.write(leftValues[componentIndex]);
-            }
+            leftValues[componentIndex] = (leftValues[componentIndex] + reader.read()) & reader.max();
+            writer.write(leftValues[componentIndex]);
         }
+    }
+    writer.finishLine();
+
+    QByteArray line = writer.takeByteArray();
+    write(line.constData(), line.size());
+}
+
+QByteArray PDFStreamPredictor::apply(const QByteArray& data) const
+{
+    if (m_predictor == NoPredictor)
+    {
+        return data;
+    }
+
+    return PDFStreamDecoder::decode(data, [this](PDFStreamDecoderSink sink) { return createDecoder(qMove(sink)); });
+}
 
-        std::fill(leftValues.begin(), leftValues.end(), 0);
-        reader.alignToBytes();
-        writer.finishLine();
+qsizetype PDFStreamPredictor::getEncodedSize(qsizetype decodedSize) const
+{
+    if (m_predictor >= PNG_None && m_stride > 0)
+    {
+        // Each line starts with the line predictor
+        const qsizetype lines = (decodedSize + m_stride - 1) / m_stride;
+        return lines * (m_stride + 1);
+    }
+
+    return decodedSize;
+}
+
+PDFStreamDecoderPointer PDFStreamPredictor::createDecoder(PDFStreamDecoderSink sink) const
+{
+    if (m_predictor == NoPredictor)
+    {
+        return nullptr;
+    }
+
+    return std::make_unique<PDFStreamPredictorDecoder>(qMove(sink), *this);
+}
+
+PDFStreamDecoderPointer PDFStreamPredictor::createDecoderWithPredictor(PDFStreamDecoderSink sink, const std::function<PDFStreamDecoderPointer(PDFStreamDecoderSink)>& factory) const
+{
+    PDFStreamDecoderPointer predictorDecoder = createDecoder(sink);
+    if (!predictorDecoder)
+    {
+        return factory(qMove(sink));
     }
 
-    return writer.takeByteArray();
+    PDFStreamDecoder* predictorDecoderPointer = predictorDecoder.get();
+    PDFStreamDecoderPointer decoder = factory([predictorDecoderPointer](const char* data, qsizetype size) { predictorDecoderPointer->push(data, size); });
+    decoder->appendDecoder(qMove(predictorDecoder));
+    return decoder;
 }
 
 QByteArray PDFCryptFilter::apply(const QByteArray& data,
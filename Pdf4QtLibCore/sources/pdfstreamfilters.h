@@ -32,6 +32,76 @@ class PDFSecurityHandler;
 
 using PDFObjectFetcher = std::function<const PDFObject&(const PDFObject&)>;
 
+/// Sink receiving decoded data of the incremental stream decoder
+using PDFStreamDecoderSink = std::function<void(const char*, qsizetype)>;
+
+/// Incremental (streaming) decoder of the stream data. Encoded data are pushed
+/// into the decoder in chunks of arbitrary size, decoded data are passed to the sink
+/// in chunks of bounded size. So memory consumption of the decoder is bounded by the chunk
+/// size, not by the size of the decoded data. Decoders can be chained, decoded data of
+/// the decoder are then pushed into the next decoder. If error occurs, exception is thrown.
+class PDF4QTLIBCORESHARED_EXPORT PDFStreamDecoder
+{
+public:
+    /// Maximal size of the chunk passed to the sink
+    static constexpr const qsizetype CHUNK_SIZE = 64 * 1024;
+
+    explicit PDFStreamDecoder(PDFStreamDecoderSink sink);
+    virtual ~PDFStreamDecoder();
+
+    PDFStreamDecoder(const PDFStreamDecoder&) = delete;
+    PDFStreamDecoder& operator=(const PDFStreamDecoder&) = delete;
+
+    /// Pushes encoded data into the decoder
+    /// \param data Encoded data
+    /// \param size Size of the encoded data
+    void push(const char* data, qsizetype size);
+
+    /// Finishes decoding. Remaining decoded data are passed to the sink,
+    /// and chained decoders are finished too.
+    void finish();
+
+    /// Appends decoder at the end of the decoder chain. Decoder should
+    /// receive decoded data of the last decoder in the chain (through the sink).
+    /// \param decoder Decoder
+    void appendDecoder(std::unique_ptr<PDFStreamDecoder> decoder);
+
+    /// Decodes all data at once using the decoder created by \p factory
+    /// \param data Encoded data
+    /// \param factory Creates decoder with given sink
+    static QByteArray decode(const QByteArray& data, const std::function<std::unique_ptr<PDFStreamDecoder>(PDFStreamDecoderSink)>& factory);
+
+protected:
+    /// Decodes pushed data
+    virtual void pushImpl(const char* data, qsizetype size) = 0;
+
+    /// Decodes remaining data, no more data will be pushed
+    virtual void finishImpl() = 0;
+
+    /// Writes decoded byte
+    void write(char value)
+    {
+        m_buffer.push_back(value);
+        if (m_buffer.size() >= CHUNK_SIZE)
+        {
+            flush();
+        }
+    }
+
+    /// Writes decoded data
+    void write(const char* data, qsizetype size);
+
+private:
+    /// Passes buffered decoded data to the sink
+    void flush();
+
+    PDFStreamDecoderSink m_sink;
+    QByteArray m_buffer;
+    std::unique_ptr<PDFStreamDecoder> m_next;
+};
+
+using PDFStreamDecoderPointer = std::unique_ptr<PDFStreamDecoder>;
+
 /// Storage for stream filters. Can retrieve stream filters by name. Using singleton
 /// design pattern. Use static methods to retrieve filters.
 class PDFStreamFilterStorage
@@ -54,6 +124,15 @@ public:
     /// \param securityHandler Security handler for Crypt filters
     static QByteArray getDecodedStream(const PDFStream* stream, const PDFSecurityHandler* securityHandler);
 
+    /// Decodes data of the stream incrementally. Decoded data are passed to the sink
+    /// in chunks, so whole decoded stream is never held in memory. Returns false, if stream
+    /// filters are invalid. If error occurs during decoding, exception is thrown.
+    /// \param stream Stream containing the data
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    /// \param securityHandler Security handler for Crypt filters
+    /// \param sink Sink receiving decoded data
+    static bool decodeStream(const PDFStream* stream, const PDFObjectFetcher& objectFetcher, const PDFSecurityHandler* securityHandler, PDFStreamDecoderSink sink);
+
     /// Tries to find stream data length using given filter. Stream will
     /// start at given \p offset in \p data. If stream length cannot be determined,
     /// then -1 is returned.
@@ -77,6 +156,20 @@ public:
 private:
     explicit PDFStreamFilterStorage();
 
+    /// Returns expected size of decoded data of the stream. It is taken from the /DL
+    /// entry, or it is computed from image dimensions, if stream is an image with
+    /// device color space. If it can't be determined, -1 is returned.
+    /// \param stream Stream
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    static PDFInteger getDecodedLengthHint(const PDFStream* stream, const PDFObjectFetcher& objectFetcher);
+
+    /// Creates decoder chain for the stream filters. If stream
+    /// has no filters, then nullptr is returned.
+    static PDFStreamDecoderPointer createDecoder(const StreamFilters& streamFilters,
+                                                 const PDFObjectFetcher& objectFetcher,
+                                                 const PDFSecurityHandler* securityHandler,
+                                                 PDFStreamDecoderSink sink);
+
     static const PDFStreamFilterStorage* getInstance();
 
     /// Maps names to the instances of the stream filters
@@ -99,7 +192,24 @@ public:
     /// \param data Data to be decoded using predictor
     QByteArray apply(const QByteArray& data) const;
 
+    /// Returns size of the data before the predictor is applied, if size
+    /// of the data after the predictor is applied is \p decodedSize.
+    /// \param decodedSize Size of decoded data
+    qsizetype getEncodedSize(qsizetype decodedSize) const;
+
+    /// Creates incremental decoder applying the predictor. If no
+    /// predictor is used, then nullptr is returned.
+    /// \param sink Sink receiving decoded data
+    PDFStreamDecoderPointer createDecoder(PDFStreamDecoderSink sink) const;
+
+    /// Creates incremental decoder \p decoder, followed by the predictor, if
+    /// predictor is used. Decoder is created by the \p factory.
+    /// \param sink Sink receiving decoded data
+    /// \param factory Creates decoder with given sink
+    PDFStreamDecoderPointer createDecoderWithPredictor(PDFStreamDecoderSink sink, const std::function<PDFStreamDecoderPointer(PDFStreamDecoderSink)>& factory) const;
+
 private:
+    friend class PDFStreamPredictorDecoder;
 
     enum Predictor
     {
@@ -114,21 +224,11 @@ private:
 
     inline explicit PDFStreamPredictor() = default;
 
-    inline explicit PDFStreamPredictor(Predictor predictor, int components, int bitsPerComponent, int columns) :
-        m_predictor(predictor),
-        m_components(components),
-        m_bitsPerComponent(bitsPerComponent),
-        m_columns(columns),
-        m_stride(0)
-    {
-        m_stride = (m_columns * m_components * m_bitsPerComponent + 7) / 8;
-    }
-
-    /// Applies PNG predictor
-    QByteArray applyPNGPredictor(const QByteArray& data) const;
+    /// Creates predictor. If line of the predictor is too long, then exception is thrown.
+    explicit PDFStreamPredictor(Predictor predictor, int components, int bitsPerComponent, int columns);
 
-    /// Applies TIFF predictor
-    QByteArray applyTIFFPredictor(const QByteArray& data) const;
+    /// Maximal length of the line (in bytes), longer lines are considered to be invalid
+    static constexpr qint64 MAX_STRIDE = 64 * 1024 * 1024;
 
     Predictor m_predictor = NoPredictor;
     int m_components = 0;
@@ -162,6 +262,29 @@ public:
     /// \param data Buffer data
     /// \param offset Offset to buffer, at which stream data starts
     virtual PDFInteger getStreamDataLength(const QByteArray& data, PDFInteger offset) const;
+
+    /// Creates incremental decoder for this filter. Default implementation
+    /// collects all pushed data and decodes them at once using apply function,
+    /// filters supporting incremental decoding override this function.
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    /// \param parameters Stream parameters
+    /// \param securityHandler Security handler
+    /// \param sink Sink receiving decoded data
+    virtual PDFStreamDecoderPointer createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                  const PDFObject& parameters,
+                                                  const PDFSecurityHandler* securityHandler,
+                                                  PDFStreamDecoderSink sink) const;
+
+protected:
+    /// Decodes data at once using the incremental decoder
+    /// \param data Stream data to be decoded
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    /// \param parameters Stream parameters
+    /// \param securityHandler Security handler
+    QByteArray applyDecoder(const QByteArray& data,
+                            const PDFObjectFetcher& objectFetcher,
+                            const PDFObject& parameters,
+                            const PDFSecurityHandler* securityHandler) const;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFAsciiHexDecodeFilter : public PDFStreamFilter
@@ -186,6 +309,11 @@ public:
                              const PDFObjectFetcher& objectFetcher,
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
+
+    virtual PDFStreamDecoderPointer createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                  const PDFObject& parameters,
+                                                  const PDFSecurityHandler* securityHandler,
+                                                  PDFStreamDecoderSink sink) const override;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFLzwDecodeFilter : public PDFStreamFilter
@@ -198,6 +326,11 @@ public:
                              const PDFObjectFetcher& objectFetcher,
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
+
+    virtual PDFStreamDecoderPointer createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                  const PDFObject& parameters,
+                                                  const PDFSecurityHandler* securityHandler,
+                                                  PDFStreamDecoderSink sink) const override;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFFlateDecodeFilter : public PDFStreamFilter
@@ -211,6 +344,11 @@ public:
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
 
+    virtual PDFStreamDecoderPointer createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                  const PDFObject& parameters,
+                                                  const PDFSecurityHandler* securityHandler,
+                                                  PDFStreamDecoderSink sink) const override;
+
     virtual PDFInteger getStreamDataLength(const QByteArray& data, PDFInteger offset) const override;
 
     /// Recompresses data. So, first, data are decompressed, and then
@@ -222,8 +360,20 @@ public:
     /// \param data Compressed data to be recompressed
     static QByteArray recompress(const QByteArray& data);
 
+    /// Decodes data at once. If decoded length is known (for example, from /DL
+    /// entry of the stream dictionary), then output buffer is allocated
+    /// at once and faster one-shot decompression can be used.
+    /// \param data Stream data to be decoded
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    /// \param parameters Stream parameters
+    /// \param decodedLength Decoded length (after predictor is applied), or -1, if unknown
+    QByteArray decode(const QByteArray& data,
+                      const PDFObjectFetcher& objectFetcher,
+                      const PDFObject& parameters,
+                      PDFInteger decodedLength) const;
+
 private:
-    static QByteArray uncompress(const QByteArray& data);
+    static QByteArray uncompress(const QByteArray& data, qsizetype decodedSizeHint = -1);
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFRunLengthDecodeFilter : public PDFStreamFilter
@@ -236,6 +386,11 @@ public:
                              const PDFObjectFetcher& objectFetcher,
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
+
+    virtual PDFStreamDecoderPointer createDecoder(const PDFObjectFetcher& objectFetcher,
+                                                  const PDFObject& parameters,
+                                                  const PDFSecurityHandler* securityHandler,
+                                                  PDFStreamDecoderSink sink) const override;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFCryptFilter : public PDFStreamFilter
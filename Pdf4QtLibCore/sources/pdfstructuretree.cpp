@@ -494,8 +494,68 @@ void PDFStructureTreeAttribute::parseAttributeDictionary(const PDFObjectStorage*
     }
 }
 
+/// Parent tree entry, used when parsing the parent tree (number tree)
+struct PDFStructureTreeParentTreeParseEntry
+{
+    PDFInteger id = 0;
+    std::vector<PDFObjectReference> references;
+
+    bool operator<(const PDFStructureTreeParentTreeParseEntry& other) const
+    {
+        return id < other.id;
+    }
+
+    static PDFStructureTreeParentTreeParseEntry parse(PDFInteger id, const PDFObjectStorage* storage, const PDFObject& object)
+    {
+        const PDFObject& dereferencedObject = storage->getObject(object);
+
+        if (dereferencedObject.isArray())
+        {
+            std::vector<PDFObjectReference> references;
+            for (const PDFObject& objectInArray : *dereferencedObject.getArray())
+            {
+                if (objectInArray.isReference())
+                {
+                    references.emplace_back(objectInArray.getReference());
+                }
+            }
+
+            return PDFStructureTreeParentTreeParseEntry{ id, qMove(references) };
+        }
+        else if (object.isReference())
+        {
+            return PDFStructureTreeParentTreeParseEntry{ id, { object.getReference() } };
+        }
+
+        return PDFStructureTreeParentTreeParseEntry{ id, { } };
+    }
+};
+
+const std::vector<PDFObjectReference>& PDFStructureTree::getParentsOnDemand(PDFInteger id) const
+{
+    auto it = m_parentTreeIndex->entries.find(id);
+    if (it == m_parentTreeIndex->entries.cend())
+    {
+        std::vector<PDFObjectReference> references;
+        if (std::optional<PDFStructureTreeParentTreeParseEntry> entry = PDFNumberTreeLoader<PDFStructureTreeParentTreeParseEntry>::find(m_storage, m_parentTree, id))
+        {
+            references = qMove(entry->references);
+        }
+
+        it = m_parentTreeIndex->entries.emplace(id, qMove(references)).first;
+    }
+
+    return it->second;
+}
+
 std::vector<PDFObjectReference> PDFStructureTree::getParents(PDFInteger id) const
 {
+    if (m_loadMode == LoadMode::OnDemand)
+    {
+        QMutexLocker lock(&m_parentTreeIndex->mutex);
+        return getParentsOnDemand(id);
+    }
+
     std::vector<PDFObjectReference> result;
     ParentTreeEntry entry{ id, PDFObjectReference() };
 
@@ -508,6 +568,17 @@ std::vector<PDFObjectReference> PDFStructureTree::getParents(PDFInteger id) cons
 
 PDFObjectReference PDFStructureTree::getParent(PDFInteger id, PDFInteger index) const
 {
+    if (m_loadMode == LoadMode::OnDemand)
+    {
+        QMutexLocker lock(&m_parentTreeIndex->mutex);
+        const std::vector<PDFObjectReference>& parents = getParentsOnDemand(id);
+        if (index >= 0 && index < PDFInteger(parents.size()))
+        {
+            return parents[index];
+        }
+        return PDFObjectReference();
+    }
+
     Q_ASSERT(std::is_sorted(m_parentTreeEntries.cbegin(), m_parentTreeEntries.cend()));
     ParentTreeEntry entry{ id, PDFObjectReference() };
     auto [it, itEnd] = std::equal_range(m_parentTreeEntries.cbegin(), m_parentTreeEntries.cend(), entry);
@@ -542,60 +613,40 @@ const std::vector<PDFStructureTreeAttribute>& PDFStructureTree::getClassAttribut
     return dummy;
 }
 
-PDFStructureTree PDFStructureTree::parse(const PDFObjectStorage* storage, PDFObject object)
+PDFStructureTree PDFStructureTree::parse(const PDFObjectStorage* storage, PDFObject object, LoadMode loadMode)
 {
     PDFStructureTree tree;
+    tree.m_loadMode = loadMode;
+    tree.m_storage = storage;
+    tree.m_parentTreeIndex = std::make_shared<ParentTreeIndex>();
 
     if (const PDFDictionary* dictionary = storage->getDictionaryFromObject(object))
     {
         PDFDocumentDataLoaderDecorator loader(storage);
 
-        PDFMarkedObjectsContext context;
-        parseKids(storage, &tree, dictionary, &context);
+        if (loadMode == LoadMode::OnDemand)
+        {
+            tree.m_kids = dictionary->get("K");
+        }
+        else
+        {
+            PDFMarkedObjectsContext context;
+            parseKids(storage, &tree, dictionary->get("K"), &context);
+        }
 
         if (dictionary->hasKey("IDTree"))
         {
             tree.m_idTreeMap = PDFNameTreeLoader<PDFObjectReference>::parse(storage, dictionary->get("IDTree"), [](const PDFObjectStorage*, const PDFObject& object) { return object.isReference() ? object.getReference() : PDFObjectReference(); });
         }
 
-        if (dictionary->hasKey("ParentTree"))
+        if (loadMode == LoadMode::OnDemand)
         {
-            struct ParentTreeParseEntry
-            {
-                PDFInteger id = 0;
-                std::vector<PDFObjectReference> references;
-
-                bool operator<(const ParentTreeParseEntry& other) const
-                {
-                    return id < other.id;
-                }
-
-                static ParentTreeParseEntry parse(PDFInteger id, const PDFObjectStorage* storage, const PDFObject& object)
-                {
-                    const PDFObject& dereferencedObject = storage->getObject(object);
-
-                    if (dereferencedObject.isArray())
-                    {
-                        std::vector<PDFObjectReference> references;
-                        for (const PDFObject& objectInArray : *dereferencedObject.getArray())
-                        {
-                            if (objectInArray.isReference())
-                            {
-                                references.emplace_back(objectInArray.getReference());
-                            }
-                        }
-
-                        return ParentTreeParseEntry{ id, qMove(references) };
-                    }
-                    else if (object.isReference())
-                    {
-                        return ParentTreeParseEntry{ id, { object.getReference() } };
-                    }
-
-                    return ParentTreeParseEntry{ id, { } };
-                }
-            };
-            auto entries = PDFNumberTreeLoader<ParentTreeParseEntry>::parse(storage, dictionary->get("ParentTree"));
+            // Parent tree entries are loaded, when they are requested
+            tree.m_parentTree = dictionary->get("ParentTree");
+        }
+        else if (dictionary->hasKey("ParentTree"))
+        {
+            auto entries = PDFNumberTreeLoader<PDFStructureTreeParentTreeParseEntry>::parse(storage, dictionary->get("ParentTree"));
             for (const auto& entry : entries)
             {
                 for (const PDFObjectReference& reference : entry.references)
@@ -692,12 +743,38 @@ PDFStructureItem::Type PDFStructureItem::getTypeFromName(const QByteArray& name)
     return Invalid;
 }
 
-void PDFStructureItem::parseKids(const PDFObjectStorage* storage, PDFStructureItem* parentItem, const PDFDictionary* dictionary, PDFMarkedObjectsContext* context)
+void PDFStructureItem::releaseChildren() const
+{
+    if (!m_kids.isNull())
+    {
+        m_children.clear();
+        m_children.shrink_to_fit();
+        m_childrenLoaded = false;
+    }
+}
+
+void PDFStructureItem::loadChildrenImpl() const
 {
-    PDFObject kids = dictionary->get("K");
-    if (kids.isArray())
+    // Mark the item and its ancestors, so cycles in the structure tree are detected
+    PDFMarkedObjectsContext context;
+    for (const PDFStructureItem* item = this; item; item = item->getParent())
     {
-        const PDFArray* kidsArray = kids.getArray();
+        if (item->getSelfReference().isValid())
+        {
+            context.mark(item->getSelfReference());
+        }
+    }
+
+    m_childrenLoaded = true;
+    parseKids(m_root->getStorage(), const_cast<PDFStructureItem*>(this), m_kids, &context);
+}
+
+void PDFStructureItem::parseKids(const PDFObjectStorage* storage, PDFStructureItem* parentItem, const PDFObject& kids, PDFMarkedObjectsContext* context)
+{
+    const PDFObject& dereferencedKids = storage->getObject(kids);
+    if (dereferencedKids.isArray())
+    {
+        const PDFArray* kidsArray = dereferencedKids.getArray();
         for (const PDFObject& object : *kidsArray)
         {
             PDFStructureItemPointer item = PDFStructureItem::parse(storage, object, context, parentItem);
@@ -865,7 +942,14 @@ PDFStructureItemPointer PDFStructureElement::parseElement(const PDFObjectStorage
             item->m_namespace = loader.readReferenceFromDictionary(dictionary, "NS");
             item->m_phoneticAlphabet = loader.readNameFromDictionary(dictionary, "PhoneticAlphabet");
 
-            parseKids(storage, item, dictionary, context);
+            if (root->getLoadMode() == PDFStructureTree::LoadMode::OnDemand)
+            {
+                item->m_kids = dictionary->get("K");
+            }
+            else
+            {
+                parseKids(storage, item, dictionary->get("K"), context);
+            }
         }
     }
 
@@ -18,6 +18,7 @@
 #ifndef PDFSTRUCTURETREE_H
 #define PDFSTRUCTURETREE_H
 
+#include <QMutex>
 #include <QSharedPointer>
 
 #include "pdfobject.h"
@@ -313,8 +314,14 @@ public:
     const PDFStructureTree* getTree() const { return m_root; }
     PDFStructureTree* getTree() { return m_root; }
     PDFObjectReference getSelfReference() const { return m_selfReference; }
-    std::size_t getChildCount() const { return m_children.size(); }
-    const PDFStructureItem* getChild(size_t i) const { return m_children.at(i).get(); }
+    std::size_t getChildCount() const { loadChildren(); return m_children.size(); }
+    const PDFStructureItem* getChild(size_t i) const { loadChildren(); return m_children.at(i).get(); }
+
+    /// Releases children of the item, if structure tree is loaded on demand,
+    /// so memory occupied by the subtree is freed. Children are loaded again,
+    /// when they are accessed. Pointers to the items of the subtree become invalid.
+    /// If structure tree is loaded at once, nothing happens.
+    void releaseChildren() const;
 
     /// Parses structure tree item from the object. If error occurs,
     /// null pointer is returned.
@@ -333,17 +340,35 @@ protected:
     /// to the kid list.
     /// \param storage Storage
     /// \param parentItem Parent item, where children are inserted
-    /// \param dictionary Dictionary
+    /// \param kids Kids object (single kid or array of kids)
     /// \param context Context
     static void parseKids(const PDFObjectStorage* storage,
                           PDFStructureItem* parentItem,
-                          const PDFDictionary* dictionary,
+                          const PDFObject& kids,
                           PDFMarkedObjectsContext* context);
 
+    /// Loads children, if structure tree is loaded on demand,
+    /// and children were not loaded yet.
+    void loadChildren() const
+    {
+        if (!m_childrenLoaded && !m_kids.isNull())
+        {
+            loadChildrenImpl();
+        }
+    }
+
+    /// Loads children of the item from kids object
+    void loadChildrenImpl() const;
+
     PDFStructureItem* m_parent;
     PDFStructureTree* m_root;
     PDFObjectReference m_selfReference;
-    std::vector<PDFStructureItemPointer> m_children;
+    mutable std::vector<PDFStructureItemPointer> m_children;
+
+    /// Kids object, from which children are loaded on demand (if
+    /// structure tree is loaded on demand, otherwise it is null)
+    PDFObject m_kids;
+    mutable bool m_childrenLoaded = false;
 };
 
 /// Structure tree namespace
@@ -368,12 +393,23 @@ private:
 
 using PDFStructureTreeNamespaces = std::vector<PDFStructureTreeNamespace>;
 
-/// Structure tree, contains structure element hierarchy
+/// Structure tree, contains structure element hierarchy. Structure tree
+/// can be loaded at once, or on demand. If it is loaded on demand, then children
+/// of structure items are loaded, when they are accessed for the first time, and
+/// parent tree entries are loaded, when they are requested. Structure tree loaded
+/// on demand must not be traversed from multiple threads at once, but parent tree
+/// functions are thread safe.
 class PDF4QTLIBCORESHARED_EXPORT PDFStructureTree : public PDFStructureItem
 {
 public:
     explicit inline PDFStructureTree() : PDFStructureItem(nullptr, this) { }
 
+    enum class LoadMode
+    {
+        Full,       ///< Whole structure tree is loaded at once
+        OnDemand    ///< Subtrees and parent tree entries are loaded on demand
+    };
+
     virtual PDFStructureTree* asStructureTree() override { return this; }
     virtual const PDFStructureTree* asStructureTree() const override { return this; }
 
@@ -413,11 +449,18 @@ public:
     /// Returns true, if structure tree is valid
     bool isValid() const { return getChildCount() > 0; }
 
+    /// Returns load mode of the structure tree
+    LoadMode getLoadMode() const { return m_loadMode; }
+
+    /// Returns storage, from which structure tree is loaded
+    const PDFObjectStorage* getStorage() const { return m_storage; }
+
     /// Parses structure tree from the object. If error occurs, empty structure
     /// tree is returned.
     /// \param storage Storage
     /// \param object Structure tree root object
-    static PDFStructureTree parse(const PDFObjectStorage* storage, PDFObject object);
+    /// \param loadMode Load mode
+    static PDFStructureTree parse(const PDFObjectStorage* storage, PDFObject object, LoadMode loadMode = LoadMode::Full);
 
     struct ParentTreeEntry
     {
@@ -430,14 +473,35 @@ public:
         }
     };
 
-    /// Returns given page tree entry. If index is invalid,
-    /// empty parent tree entry is returned.
+    /// Returns given page tree entry. If index is invalid, empty parent tree
+    /// entry is returned. If structure tree is loaded on demand, parent tree
+    /// is not loaded at once, and empty parent tree entry is returned.
     /// \param index Index
     ParentTreeEntry getParentTreeEntry(PDFInteger index) const;
 
 private:
     using ParentTreeEntries = std::vector<ParentTreeEntry>;
 
+    /// Index of parent tree entries loaded on demand, key is structural
+    /// parent key (of page or other content stream), value is array
+    /// of parents indexed by marked content identifier.
+    struct ParentTreeIndex
+    {
+        QMutex mutex;
+        std::map<PDFInteger, std::vector<PDFObjectReference>> entries;
+    };
+
+    /// Returns parents for structural parent key, loads them from
+    /// parent tree, if they are not loaded yet. Parent tree index mutex
+    /// must be locked.
+    /// \param id Structural parent key
+    const std::vector<PDFObjectReference>& getParentsOnDemand(PDFInteger id) const;
+
+    LoadMode m_loadMode = LoadMode::Full;
+    const PDFObjectStorage* m_storage = nullptr;
+    PDFObject m_parentTree;
+    std::shared_ptr<ParentTreeIndex> m_parentTreeIndex;
+
     std::map<QByteArray, PDFObjectReference> m_idTreeMap;
     ParentTreeEntries m_parentTreeEntries;
     PDFInteger m_parentNextKey = 0;
@@ -0,0 +1,309 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftextindex.h"
+#include "pdftextlayout.h"
+#include "pdfutils.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+namespace
+{
+
+/// Word in the text, given by range [start, end) of UTF-16 code units
+struct PDFTextIndexWord
+{
+    int start = 0;
+    int end = 0;
+};
+
+/// Splits text to words. Word is a maximal sequence of letters and digits,
+/// all other characters (including marks and surrogate pairs of non-letter
+/// characters) are treated as word separators.
+std::vector<PDFTextIndexWord> splitWords(const QString& text)
+{
+    std::vector<PDFTextIndexWord> words;
+
+    const int length = text.length();
+    int wordStart = -1;
+    int i = 0;
+    while (i < length)
+    {
+        char32_t codePoint = text[i].unicode();
+        int codePointLength = 1;
+
+        if (text[i].isHighSurrogate() && i + 1 < length && text[i + 1].isLowSurrogate())
+        {
+            codePoint = QChar::surrogateToUcs4(text[i], text[i + 1]);
+            codePointLength = 2;
+        }
+
+        const bool isWordCharacter = QChar::isLetterOrNumber(codePoint);
+        if (isWordCharacter && wordStart == -1)
+        {
+            wordStart = i;
+        }
+        else if (!isWordCharacter && wordStart != -1)
+        {
+            words.push_back({ wordStart, i });
+            wordStart = -1;
+        }
+
+        i += codePointLength;
+    }
+
+    if (wordStart != -1)
+    {
+        words.push_back({ wordStart, length });
+    }
+
+    return words;
+}
+
+}   // namespace
+
+PDFCharacterPointer PDFTextIndex::Posting::getCharacterPointer() const
+{
+    PDFCharacterPointer pointer;
+    pointer.pageIndex = pageIndex;
+    pointer.blockIndex = blockIndex;
+    pointer.lineIndex = lineIndex;
+    pointer.characterIndex = characterIndex;
+    return pointer;
+}
+
+void PDFTextIndex::addPage(PDFInteger pageIndex, const PDFTextLayout& layout, QMutex* mutex)
+{
+    std::map<QString, Postings> pageTerms;
+
+    // We use single text flow with soft hyphens preserved. Text of this
+    // flow differs from text of flows created with other flags only in whitespace
+    // characters, soft hyphens and block separation, so it consists of the same words.
+    // Words hyphenated at the end of line are also stored as joined word, because
+    // soft hyphen can be removed from the searched text flow.
+    PDFTextFlows textFlows = PDFTextFlow::createTextFlows(layout, PDFTextFlow::None, pageIndex);
+
+    quint32 wordPosition = 0;
+    for (const PDFTextFlow& textFlow : textFlows)
+    {
+        const QString text = textFlow.getText();
+        const std::vector<PDFCharacterPointer>& characterPointers = textFlow.getCharacterPointers();
+        const std::vector<PDFTextIndexWord> words = splitWords(text);
+
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            const PDFTextIndexWord& word = words[i];
+            const PDFCharacterPointer& pointer = characterPointers[word.start];
+            const QString wordText = text.mid(word.start, word.end - word.start);
+
+            Posting posting;
+            posting.pageIndex = static_cast<qint32>(pageIndex);
+            posting.firstWord = wordPosition + static_cast<quint32>(i);
+            posting.lastWord = posting.firstWord;
+            posting.blockIndex = static_cast<quint32>(pointer.blockIndex);
+            posting.lineIndex = static_cast<quint32>(pointer.lineIndex);
+            posting.characterIndex = static_cast<quint32>(pointer.characterIndex);
+            pageTerms[normalize(wordText)].push_back(posting);
+
+            // Word hyphenated at the end of line is followed by soft hyphen and line break
+            if (i + 1 < words.size() &&
+                words[i + 1].start == word.end + 2 &&
+                text[word.end] == QChar(QChar::SoftHyphen) &&
+                text[word.end + 1].isSpace())
+            {
+                const PDFTextIndexWord& nextWord = words[i + 1];
+                posting.lastWord = posting.firstWord + 1;
+                pageTerms[normalize(wordText + text.mid(nextWord.start, nextWord.end - nextWord.start))].push_back(posting);
+            }
+        }
+
+        wordPosition += static_cast<quint32>(words.size());
+    }
+
+    QMutexLocker lock(mutex);
+    for (auto& [term, postings] : pageTerms)
+    {
+        Postings& termPostings = m_terms[term];
+        termPostings.insert(termPostings.end(), postings.cbegin(), postings.cend());
+    }
+}
+
+std::optional<std::vector<PDFInteger>> PDFTextIndex::getCandidatePages(const QString& text, bool wholeWords) const
+{
+    const QString normalizedText = normalize(text);
+    const std::vector<PDFTextIndexWord> words = splitWords(normalizedText);
+
+    if (words.empty())
+    {
+        // Text doesn't contain any word, we can't use the index
+        return std::nullopt;
+    }
+
+    // Positions, where next word of the phrase must start,
+    // pairs of page index and word position on the page.
+    using WordPosition = std::pair<qint32, quint32>;
+    std::vector<WordPosition> positions;
+
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        const PDFTextIndexWord& word = words[i];
+        const QString term = normalizedText.mid(word.start, word.end - word.start);
+
+        // First (last) word of the text can be the end (beginning) of the word
+        // in the document, if it is not separated from the rest of the text.
+        const bool isCharacterBeforeAllowed = !wholeWords && i == 0 && word.start == 0;
+        const bool isCharacterAfterAllowed = !wholeWords && i + 1 == words.size() && word.end == normalizedText.length();
+
+        std::vector<WordPosition> nextPositions;
+        auto addPostings = [i, &positions, &nextPositions](const Postings& postings)
+        {
+            for (const Posting& posting : postings)
+            {
+                if (i == 0 || std::binary_search(positions.cbegin(), positions.cend(), WordPosition(posting.pageIndex, posting.firstWord)))
+                {
+                    nextPositions.emplace_back(posting.pageIndex, posting.lastWord + 1);
+                }
+            }
+        };
+
+        if (!isCharacterBeforeAllowed && !isCharacterAfterAllowed)
+        {
+            auto it = m_terms.find(term);
+            if (it != m_terms.cend())
+            {
+                addPostings(it->second);
+            }
+        }
+        else if (!isCharacterBeforeAllowed)
+        {
+            for (auto it = m_terms.lower_bound(term); it != m_terms.cend() && it->first.startsWith(term); ++it)
+            {
+                addPostings(it->second);
+            }
+        }
+        else
+        {
+            for (const auto& [indexedTerm, postings] : m_terms)
+            {
+                if (isCharacterAfterAllowed ? indexedTerm.contains(term) : indexedTerm.endsWith(term))
+                {
+                    addPostings(postings);
+                }
+            }
+        }
+
+        std::sort(nextPositions.begin(), nextPositions.end());
+        nextPositions.erase(std::unique(nextPositions.begin(), nextPositions.end()), nextPositions.end());
+        positions = std::move(nextPositions);
+
+        if (positions.empty())
+        {
+            break;
+        }
+    }
+
+    std::vector<PDFInteger> pages;
+    pages.reserve(positions.size());
+    for (const WordPosition& position : positions)
+    {
+        if (pages.empty() || pages.back() != position.first)
+        {
+            pages.push_back(position.first);
+        }
+    }
+
+    return pages;
+}
+
+const PDFTextIndex::Postings* PDFTextIndex::getPostings(const QString& term) const
+{
+    auto it = m_terms.find(normalize(term));
+    if (it != m_terms.cend())
+    {
+        return &it->second;
+    }
+
+    return nullptr;
+}
+
+QString PDFTextIndex::normalize(const QString& term)
+{
+    return term.toCaseFolded();
+}
+
+QDataStream& operator<<(QDataStream& stream, const PDFTextIndex::Posting& posting)
+{
+    stream << posting.pageIndex;
+    stream << posting.firstWord;
+    stream << posting.lastWord;
+    stream << posting.blockIndex;
+    stream << posting.lineIndex;
+    stream << posting.characterIndex;
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, PDFTextIndex::Posting& posting)
+{
+    stream >> posting.pageIndex;
+    stream >> posting.firstWord;
+    stream >> posting.lastWord;
+    stream >> posting.blockIndex;
+    stream >> posting.lineIndex;
+    stream >> posting.characterIndex;
+    return stream;
+}
+
+QDataStream& operator<<(QDataStream& stream, const PDFTextIndex& index)
+{
+    stream << quint64(index.m_terms.size());
+    for (const auto& [term, postings] : index.m_terms)
+    {
+        stream << term;
+        stream << postings;
+    }
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, PDFTextIndex& index)
+{
+    index.m_terms.clear();
+
+    quint64 count = 0;
+    stream >> count;
+
+    for (quint64 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString term;
+        PDFTextIndex::Postings postings;
+        stream >> term;
+        stream >> postings;
+        index.m_terms.emplace_hint(index.m_terms.cend(), std::move(term), std::move(postings));
+    }
+
+    return stream;
+}
+
+}   // namespace pdf
@@ -0,0 +1,109 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFTEXTINDEX_H
+#define PDFTEXTINDEX_H
+
+#include "pdfglobal.h"
+
+#include <QString>
+#include <QDataStream>
+
+#include <map>
+#include <vector>
+#include <optional>
+
+class QMutex;
+
+namespace pdf
+{
+class PDFTextLayout;
+struct PDFCharacterPointer;
+
+/// Inverted full-text index of the document. Text of each page is split
+/// into words (sequences of letters and digits), which are normalized (case folded)
+/// and stored as terms. For each term, list of its occurences (postings) is stored.
+/// Posting contains page index, word position on the page (used to answer phrase
+/// queries) and character pointer of the first character of the word. Index is
+/// used to select candidate pages for text search, it can return more pages, than
+/// really contain searched text, but it never omits a page containing the text.
+/// Index is built incrementally, page by page.
+class PDF4QTLIBCORESHARED_EXPORT PDFTextIndex
+{
+public:
+    explicit inline PDFTextIndex() = default;
+
+    struct Posting
+    {
+        /// Returns character pointer to the first character of the word
+        PDFCharacterPointer getCharacterPointer() const;
+
+        qint32 pageIndex = -1;
+        quint32 firstWord = 0;      ///< Position of the first word on the page
+        quint32 lastWord = 0;       ///< Position of the last word on the page (differs from first word, if word is hyphenated)
+        quint32 blockIndex = 0;
+        quint32 lineIndex = 0;
+        quint32 characterIndex = 0;
+
+        friend QDataStream& operator<<(QDataStream& stream, const Posting& posting);
+        friend QDataStream& operator>>(QDataStream& stream, Posting& posting);
+    };
+    using Postings = std::vector<Posting>;
+
+    /// Adds words of the page text layout to the index. Page should
+    /// not be added twice. Function can be called from multiple threads,
+    /// if mutex is provided.
+    /// \param pageIndex Page index
+    /// \param layout Text layout of the page
+    /// \param mutex Mutex for locking (calls of addPage from multiple threads)
+    void addPage(PDFInteger pageIndex, const PDFTextLayout& layout, QMutex* mutex);
+
+    /// Returns candidate pages, which can contain the text (sorted by page index).
+    /// If text doesn't contain any word character, index can't be used, and
+    /// std::nullopt is returned. Words at the beginning and at the end of the
+    /// text can be only part of a word in the document, unless \p wholeWords
+    /// is set to true.
+    /// \param text Text (word or phrase) to be found
+    /// \param wholeWords Match whole words only
+    std::optional<std::vector<PDFInteger>> getCandidatePages(const QString& text, bool wholeWords) const;
+
+    /// Returns postings of the term. Term is normalized before lookup.
+    /// If term is not found, nullptr is returned.
+    /// \param term Term
+    const Postings* getPostings(const QString& term) const;
+
+    /// Returns number of distinct terms in the index
+    size_t getTermCount() const { return m_terms.size(); }
+
+    /// Returns true, if index is empty
+    bool isEmpty() const { return m_terms.empty(); }
+
+    /// Returns normalized form of the term
+    /// \param term Term
+    static QString normalize(const QString& term);
+
+    friend QDataStream& operator<<(QDataStream& stream, const PDFTextIndex& index);
+    friend QDataStream& operator>>(QDataStream& stream, PDFTextIndex& index);
+
+private:
+    std::map<QString, Postings> m_terms;
+};
+
+}   // namespace pdf
+
+#endif // PDFTEXTINDEX_H
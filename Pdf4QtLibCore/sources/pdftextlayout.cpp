@@ -19,21 +19,28 @@
 #include "pdfutils.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfcms.h"
+#include "pdfoperationcontrol.h"
 
 #include <QtMath>
 #include <QMutex>
 #include <QPainter>
 #include <QIODevice>
+#include <QSaveFile>
 #include <QMutexLocker>
 #include <QRegularExpression>
+#include <QCryptographicHash>
 
 #include "pdfdbgheap.h"
 
+#include <numeric>
 #include <execution>
 
 namespace pdf
 {
 
+static constexpr const char* TEXT_LAYOUT_STORAGE_MAGIC = "PDF4QTTL";
+static constexpr const qint32 TEXT_LAYOUT_STORAGE_VERSION = 1;
+
 /// Spatial 2D index for indexing of text characters. It is a R-tree like structure,
 /// build over an array of text characters. Array is modified (structure is build over
 /// array).
@@ -256,6 +263,167 @@ size_t PDFTextCharacterSpatialIndex::queryImpl(size_t nodeIndex, const QRectF& r
     }
 }
 
+void PDFTextLayoutSpatialIndex::build(const PDFTextBlocks& blocks)
+{
+    clear();
+
+    for (size_t blockIndex = 0; blockIndex < blocks.size(); ++blockIndex)
+    {
+        const PDFTextBlock& block = blocks[blockIndex];
+        m_blocks.items.push_back({ block.getBoundingBox().controlPointRect(), blockIndex, 0, 0 });
+
+        const PDFTextLines& lines = block.getLines();
+        for (size_t lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
+        {
+            const PDFTextLine& line = lines[lineIndex];
+            m_lines.items.push_back({ line.getBoundingBox().controlPointRect(), blockIndex, lineIndex, 0 });
+
+            const TextCharacters& characters = line.getCharacters();
+            for (size_t characterIndex = 0; characterIndex < characters.size(); ++characterIndex)
+            {
+                m_characters.items.push_back({ characters[characterIndex].boundingBox.controlPointRect(), blockIndex, lineIndex, characterIndex });
+            }
+        }
+    }
+
+    for (Tree* tree : { &m_blocks, &m_lines, &m_characters })
+    {
+        if (!tree->items.empty())
+        {
+            tree->nodes.reserve(2 * tree->items.size() / LEAF_SIZE + 1);
+            buildTree(*tree, 0, tree->items.size());
+        }
+    }
+
+    m_isBuilt = true;
+}
+
+void PDFTextLayoutSpatialIndex::clear()
+{
+    m_isBuilt = false;
+    m_blocks = Tree();
+    m_lines = Tree();
+    m_characters = Tree();
+}
+
+void PDFTextLayoutSpatialIndex::query(Level level, const QRectF& rect, Items* result) const
+{
+    Q_ASSERT(result);
+
+    const Tree& tree = getTree(level);
+    if (!tree.nodes.empty())
+    {
+        queryTree(tree, 0, rect.normalized(), result);
+    }
+}
+
+size_t PDFTextLayoutSpatialIndex::buildTree(Tree& tree, size_t first, size_t last)
+{
+    const size_t nodeIndex = tree.nodes.size();
+    tree.nodes.push_back(Node());
+
+    // We do not use QRectF::united, because it ignores
+    // empty rectangles, and characters can have empty bounding box.
+    qreal xMin = std::numeric_limits<qreal>::infinity();
+    qreal xMax = -std::numeric_limits<qreal>::infinity();
+    qreal yMin = std::numeric_limits<qreal>::infinity();
+    qreal yMax = -std::numeric_limits<qreal>::infinity();
+    for (size_t i = first; i < last; ++i)
+    {
+        const QRectF& boundingBox = tree.items[i].boundingBox;
+        xMin = qMin(xMin, boundingBox.left());
+        xMax = qMax(xMax, boundingBox.right());
+        yMin = qMin(yMin, boundingBox.top());
+        yMax = qMax(yMax, boundingBox.bottom());
+    }
+    const QRectF boundingBox(QPointF(xMin, yMin), QPointF(xMax, yMax));
+
+    if (last - first <= LEAF_SIZE)
+    {
+        Node& node = tree.nodes[nodeIndex];
+        node.isLeaf = true;
+        node.index1 = first;
+        node.index2 = last;
+        node.boundingBox = boundingBox;
+        return nodeIndex;
+    }
+
+    // Split items by median of centers along the larger side
+    auto itFirst = std::next(tree.items.begin(), first);
+    auto itMid = std::next(tree.items.begin(), first + (last - first) / 2);
+    auto itLast = std::next(tree.items.begin(), last);
+    if (boundingBox.width() > boundingBox.height())
+    {
+        std::nth_element(itFirst, itMid, itLast, [](const Item& l, const Item& r) { return l.boundingBox.center().x() < r.boundingBox.center().x(); });
+    }
+    else
+    {
+        std::nth_element(itFirst, itMid, itLast, [](const Item& l, const Item& r) { return l.boundingBox.center().y() < r.boundingBox.center().y(); });
+    }
+
+    const size_t mid = first + (last - first) / 2;
+    const size_t index1 = buildTree(tree, first, mid);
+    const size_t index2 = buildTree(tree, mid, last);
+
+    Node& node = tree.nodes[nodeIndex];
+    node.isLeaf = false;
+    node.index1 = index1;
+    node.index2 = index2;
+    node.boundingBox = boundingBox;
+    return nodeIndex;
+}
+
+void PDFTextLayoutSpatialIndex::queryTree(const Tree& tree, size_t nodeIndex, const QRectF& rect, Items* result)
+{
+    // Rectangles can be empty (query can be a single point),
+    // so we test intersection including boundaries.
+    auto isIntersecting = [&rect](const QRectF& boundingBox)
+    {
+        return boundingBox.left() <= rect.right() && rect.left() <= boundingBox.right() &&
+               boundingBox.top() <= rect.bottom() && rect.top() <= boundingBox.bottom();
+    };
+
+    const Node& node = tree.nodes[nodeIndex];
+    if (!isIntersecting(node.boundingBox))
+    {
+        return;
+    }
+
+    if (!node.isLeaf)
+    {
+        queryTree(tree, node.index1, rect, result);
+        queryTree(tree, node.index2, rect, result);
+    }
+    else
+    {
+        for (size_t i = node.index1; i < node.index2; ++i)
+        {
+            if (isIntersecting(tree.items[i].boundingBox))
+            {
+                result->push_back(tree.items[i]);
+            }
+        }
+    }
+}
+
+const PDFTextLayoutSpatialIndex::Tree& PDFTextLayoutSpatialIndex::getTree(Level level) const
+{
+    switch (level)
+    {
+        case Level::Block:
+            return m_blocks;
+
+        case Level::Line:
+            return m_lines;
+
+        case Level::Character:
+            return m_characters;
+    }
+
+    Q_ASSERT(false);
+    return m_blocks;
+}
+
 PDFTextLayout::PDFTextLayout()
 {
 
@@ -289,15 +457,42 @@ void PDFTextLayout::addCharacter(const PDFTextCharacterInfo& info)
 
 void PDFTextLayout::perform()
 {
-    for (PDFReal angle : m_angles)
+    m_spatialIndex.clear();
+
+    // Divide characters by angles in one pass, so pages containing
+    // text in many rotations don't scan all characters for each angle. Layout of
+    // each angle is independent on other angles, so angles are processed in parallel,
+    // and blocks are appended in the order of angles.
+    std::vector<PDFReal> angles(m_angles.cbegin(), m_angles.cend());
+    std::vector<TextCharacters> angleCharacters(angles.size());
+    for (const TextCharacter& character : m_characters)
     {
-        performDoLayout(angle);
+        auto it = std::lower_bound(angles.cbegin(), angles.cend(), character.angle);
+        if (it != angles.cend() && *it == character.angle)
+        {
+            angleCharacters[std::distance(angles.cbegin(), it)].push_back(character);
+        }
+    }
+
+    std::vector<PDFTextBlocks> angleBlocks(angles.size());
+    auto performLayout = [this, &angles, &angleCharacters, &angleBlocks](size_t angleIndex)
+    {
+        angleBlocks[angleIndex] = performDoLayout(angles[angleIndex], qMove(angleCharacters[angleIndex]));
+    };
+
+    auto range = PDFIntegerRange<size_t>(0, angles.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), performLayout);
+
+    for (PDFTextBlocks& blocks : angleBlocks)
+    {
+        m_blocks.insert(m_blocks.end(), std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
     }
 }
 
 void PDFTextLayout::optimize()
 {
     m_characters.shrink_to_fit();
+    m_spatialIndex.build(m_blocks);
 }
 
 qint64 PDFTextLayout::getMemoryConsumptionEstimate() const
@@ -310,6 +505,13 @@ qint64 PDFTextLayout::getMemoryConsumptionEstimate() const
 
 bool PDFTextLayout::isHoveringOverTextBlock(const QPointF& point) const
 {
+    if (m_spatialIndex.isBuilt())
+    {
+        PDFTextLayoutSpatialIndex::Items items;
+        m_spatialIndex.query(PDFTextLayoutSpatialIndex::Level::Block, QRectF(point, QSizeF(0.0, 0.0)), &items);
+        return std::any_of(items.cbegin(), items.cend(), [this, &point](const auto& item) { return m_blocks[item.blockIndex].getBoundingBox().contains(point); });
+    }
+
     for (const PDFTextBlock& block : m_blocks)
     {
         if (block.getBoundingBox().contains(point))
@@ -321,6 +523,97 @@ bool PDFTextLayout::isHoveringOverTextBlock(const QPointF& point) const
     return false;
 }
 
+PDFCharacterPointer PDFTextLayout::getCharacterAt(PDFInteger pageIndex, const QPointF& point) const
+{
+    PDFCharacterPointer pointer;
+
+    auto checkCharacter = [this, pageIndex, &point, &pointer](size_t blockIndex, size_t lineIndex, size_t characterIndex)
+    {
+        const TextCharacter& character = m_blocks[blockIndex].getLines()[lineIndex].getCharacters()[characterIndex];
+        if (!pointer.isValid() && character.boundingBox.contains(point))
+        {
+            pointer.pageIndex = pageIndex;
+            pointer.blockIndex = blockIndex;
+            pointer.lineIndex = lineIndex;
+            pointer.characterIndex = characterIndex;
+        }
+    };
+
+    if (m_spatialIndex.isBuilt())
+    {
+        PDFTextLayoutSpatialIndex::Items items;
+        m_spatialIndex.query(PDFTextLayoutSpatialIndex::Level::Character, QRectF(point, QSizeF(0.0, 0.0)), &items);
+        for (const PDFTextLayoutSpatialIndex::Item& item : items)
+        {
+            checkCharacter(item.blockIndex, item.lineIndex, item.characterIndex);
+        }
+    }
+    else
+    {
+        for (size_t blockIndex = 0; blockIndex < m_blocks.size(); ++blockIndex)
+        {
+            const PDFTextLines& lines = m_blocks[blockIndex].getLines();
+            for (size_t lineIndex = 0; lineIndex < lines.size(); ++lineIndex)
+            {
+                for (size_t characterIndex = 0; characterIndex < lines[lineIndex].getCharacters().size(); ++characterIndex)
+                {
+                    checkCharacter(blockIndex, lineIndex, characterIndex);
+                }
+            }
+        }
+    }
+
+    return pointer;
+}
+
+std::vector<size_t> PDFTextLayout::getCandidateBlocks(const QPointF& point1, const QPointF& point2) const
+{
+    std::vector<size_t> blockIndices;
+
+    if (!m_spatialIndex.isBuilt())
+    {
+        blockIndices.resize(m_blocks.size(), 0);
+        std::iota(blockIndices.begin(), blockIndices.end(), 0);
+        return blockIndices;
+    }
+
+    // Selection rectangle is axis-aligned in the coordinate system
+    // of the block, which is rotated by the block angle. So, for each angle, we map
+    // the rectangle back to the page coordinate system and query its bounding rectangle.
+    std::set<PDFReal> angles = m_angles;
+    angles.insert(0.0);
+
+    PDFTextLayoutSpatialIndex::Items items;
+    for (PDFReal angle : angles)
+    {
+        QTransform angleMatrix;
+        angleMatrix.rotate(angle);
+
+        QPointF pointA = angleMatrix.map(point1);
+        QPointF pointB = angleMatrix.map(point2);
+        QRectF rect(QPointF(qMin(pointA.x(), pointB.x()), qMin(pointA.y(), pointB.y())),
+                    QPointF(qMax(pointA.x(), pointB.x()), qMax(pointA.y(), pointB.y())));
+
+        constexpr PDFReal epsilon = 0.001;
+        QRectF queryRect = angleMatrix.inverted().map(QPolygonF(rect)).boundingRect();
+        queryRect.adjust(-epsilon, -epsilon, epsilon, epsilon);
+
+        items.clear();
+        m_spatialIndex.query(PDFTextLayoutSpatialIndex::Level::Block, queryRect, &items);
+        for (const PDFTextLayoutSpatialIndex::Item& item : items)
+        {
+            if (m_blocks[item.blockIndex].getAngle() == angle)
+            {
+                blockIndices.push_back(item.blockIndex);
+            }
+        }
+    }
+
+    std::sort(blockIndices.begin(), blockIndices.end());
+    blockIndices.erase(std::unique(blockIndices.begin(), blockIndices.end()), blockIndices.end());
+    return blockIndices;
+}
+
 PDFTextSelection PDFTextLayout::createTextSelection(PDFInteger pageIndex, const QPointF& point1, const QPointF& point2, QColor selectionColor, bool strictSelection)
 {
     PDFTextSelection selection;
@@ -328,9 +621,10 @@ PDFTextSelection PDFTextLayout::createTextSelection(PDFInteger pageIndex, const
     // Jakub Melka: We must treat each block in its own coordinate system. Because texts can
     // have different angles, we will treat each block separately.
 
-    size_t blockId = 0;
-    for (PDFTextBlock& block : m_blocks)
+    for (size_t blockId : getCandidateBlocks(point1, point2))
     {
+        PDFTextBlock& block = m_blocks[blockId];
+
         QTransform angleMatrix;
         angleMatrix.rotate(block.getAngle());
         block.applyTransform(angleMatrix);
@@ -475,9 +769,6 @@ PDFTextSelection PDFTextLayout::createTextSelection(PDFInteger pageIndex, const
             }
         }
 
-        // Increment block index
-        ++blockId;
-
         // Apply backward transformation to restore original coordinate system
         block.applyTransform(angleMatrix.inverted());
     }
@@ -583,6 +874,7 @@ QDataStream& operator>>(QDataStream& stream, PDFTextLayout& layout)
     stream >> layout.m_angles;
     stream >> layout.m_settings;
     stream >> layout.m_blocks;
+    layout.m_spatialIndex.clear();
     return stream;
 }
 
@@ -603,7 +895,7 @@ struct NearestCharacterInfo
     inline bool operator<(const NearestCharacterInfo& other) const { return distance < other.distance; }
 };
 
-void PDFTextLayout::performDoLayout(PDFReal angle)
+PDFTextBlocks PDFTextLayout::performDoLayout(PDFReal angle, TextCharacters characters) const
 {
     // We will implement variation of 'docstrum' algorithm, we have divided characters by angles,
     // for each angle we get characters for that particular angle, and run 'docstrum' algorithm.
@@ -617,7 +909,6 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
     //      4) Merge text lines into text blocks using various criteria, such as overlap,
     //         distance between the lines, and also using again, transitive closure.
     //      5) Sort blocks using topological ordering
-    TextCharacters characters = getCharactersForAngle(angle);
 
     // Step 1) - rotate blocks
     QTransform angleMatrix;
@@ -735,13 +1026,34 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
 
     // Step 4) - detect text blocks
     const size_t lineCount = lines.size();
+    std::vector<QRectF> lineBoundingBoxes;
+    lineBoundingBoxes.reserve(lineCount);
+    PDFReal maximalLineHeight = 0.0;
+    for (const PDFTextLine& line : lines)
+    {
+        lineBoundingBoxes.push_back(line.getBoundingBox().boundingRect());
+        maximalLineHeight = qMax(maximalLineHeight, lineBoundingBoxes.back().height());
+    }
+
+    // We use sweep line over the lines sorted by the top coordinate. Height
+    // of the union of two bounding boxes is at least the difference of their top coordinates,
+    // so only lines, whose top coordinate is below the top of the current line by less
+    // than the height limit (estimated using maximal line height), can be joined.
+    std::vector<size_t> lineOrder(lineCount, 0);
+    std::iota(lineOrder.begin(), lineOrder.end(), 0);
+    std::stable_sort(lineOrder.begin(), lineOrder.end(), [&lineBoundingBoxes](const size_t l, const size_t r) { return lineBoundingBoxes[l].top() < lineBoundingBoxes[r].top(); });
+
     PDFUnionFindAlgorithm<size_t> textBlocksUF(lineCount);
-    for (size_t i = 0; i < lineCount; ++i)
+    for (size_t k = 0; k < lineCount; ++k)
     {
-        for (size_t j = i + 1; j < lineCount; ++j)
+        const size_t i = lineOrder[k];
+        const QRectF& bb1 = lineBoundingBoxes[i];
+        const PDFReal topLimit = bb1.top() + (bb1.height() + maximalLineHeight) * m_settings.blockVerticalSensitivity;
+
+        for (size_t l = k + 1; l < lineCount && lineBoundingBoxes[lineOrder[l]].top() <= topLimit; ++l)
         {
-            QRectF bb1 = lines[i].getBoundingBox().boundingRect();
-            QRectF bb2 = lines[j].getBoundingBox().boundingRect();
+            const size_t j = lineOrder[l];
+            const QRectF& bb2 = lineBoundingBoxes[j];
 
             // Jakub Melka: we will join two blocks, if these two conditions both holds:
             //     1) bounding boxes overlap horizontally by large portion
@@ -785,32 +1097,49 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
     //    - there doesn't exist block c, which is between a,b in y-axis
     //      and moreover, overlaps both a and b in x-axis.
 
-    auto isBeforeByRule1 = [&blocks](const size_t aIndex, const size_t bIndex)
+    const size_t blockCount = blocks.size();
+    std::vector<QRectF> blockBoundingBoxes;
+    blockBoundingBoxes.reserve(blockCount);
+    for (const PDFTextBlock& block : blocks)
+    {
+        blockBoundingBoxes.push_back(block.getBoundingBox().boundingRect());
+    }
+
+    // Blocks sorted by the top coordinate, so candidates for block 'c'
+    // in the rule 2 can be found using binary search.
+    std::vector<size_t> blockOrder(blockCount, 0);
+    std::iota(blockOrder.begin(), blockOrder.end(), 0);
+    std::stable_sort(blockOrder.begin(), blockOrder.end(), [&blockBoundingBoxes](const size_t l, const size_t r) { return blockBoundingBoxes[l].top() < blockBoundingBoxes[r].top(); });
+
+    auto isBeforeByRule1 = [&blockBoundingBoxes](const size_t aIndex, const size_t bIndex)
     {
-        QRectF aBB = blocks[aIndex].getBoundingBox().boundingRect();
-        QRectF bBB = blocks[bIndex].getBoundingBox().boundingRect();
+        const QRectF& aBB = blockBoundingBoxes[aIndex];
+        const QRectF& bBB = blockBoundingBoxes[bIndex];
 
         const bool isOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(aBB, bBB);
         const bool isAoverB = aBB.bottom() > bBB.top();
         return isOverlappedOnHorizontalAxis && isAoverB;
     };
-    auto isBeforeByRule2 = [&blocks](const size_t aIndex, const size_t bIndex)
+    auto isBeforeByRule2 = [&blockBoundingBoxes, &blockOrder](const size_t aIndex, const size_t bIndex)
     {
-        QRectF aBB = blocks[aIndex].getBoundingBox().boundingRect();
-        QRectF bBB = blocks[bIndex].getBoundingBox().boundingRect();
+        const QRectF& aBB = blockBoundingBoxes[aIndex];
+        const QRectF& bBB = blockBoundingBoxes[bIndex];
         QRectF abBB = aBB.united(bBB);
 
         if (aBB.right() < bBB.left())
         {
-            // Check, if 'c' block doesn't exist
-            for (size_t i = 0, count = blocks.size(); i < count; ++i)
+            // Check, if 'c' block doesn't exist. Block 'c' must have top coordinate
+            // in the range [top, bottom] of the union of blocks 'a' and 'b'.
+            auto it = std::lower_bound(blockOrder.cbegin(), blockOrder.cend(), abBB.top(), [&blockBoundingBoxes](const size_t index, const PDFReal top) { return blockBoundingBoxes[index].top() < top; });
+            for (; it != blockOrder.cend() && blockBoundingBoxes[*it].top() <= abBB.bottom(); ++it)
             {
+                const size_t i = *it;
                 if (i == aIndex || i == bIndex)
                 {
                     continue;
                 }
 
-                QRectF cBB = blocks[i].getBoundingBox().boundingRect();
+                const QRectF& cBB = blockBoundingBoxes[i];
                 if (cBB.top() >= abBB.top() && cBB.bottom() <= abBB.bottom())
                 {
                     const bool isAOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(aBB, cBB);
@@ -829,44 +1158,53 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
     };
 
     // Order blocks using topological sort (https://en.wikipedia.org/wiki/Topological_sorting,
-    // Kahn's algorithm is used)
-    std::set<size_t> workBlocks;
-    std::vector<size_t> ordering;
-    std::vector<std::set<size_t>> orderingEdges(blocks.size(), std::set<size_t>());
-    ordering.reserve(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-        workBlocks.insert(workBlocks.end(), i);
-        for (size_t j = 0; j < blocks.size(); ++j)
+    // Kahn's algorithm is used). Block with the least count of unordered predecessors
+    // is always selected (block with lesser index, if counts are equal), so work blocks
+    // are kept in the set ordered by the predecessor count and the index.
+    std::vector<size_t> predecessorCounts(blockCount, 0);
+    std::vector<std::vector<size_t>> successors(blockCount);
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+        for (size_t j = 0; j < blockCount; ++j)
         {
             if (i != j && (isBeforeByRule1(j, i) || isBeforeByRule2(j, i)))
             {
-                orderingEdges[i].insert(j);
+                ++predecessorCounts[i];
+                successors[j].push_back(i);
             }
         }
     }
 
+    std::set<std::pair<size_t, size_t>> workBlocks;
+    std::vector<bool> isOrdered(blockCount, false);
+    for (size_t i = 0; i < blockCount; ++i)
+    {
+        workBlocks.emplace(predecessorCounts[i], i);
+    }
+
     // Topological sort
+    PDFTextBlocks result;
+    result.reserve(blockCount);
     QTransform invertedAngleMatrix = angleMatrix.inverted();
     while (!workBlocks.empty())
     {
-        auto it = std::min_element(workBlocks.begin(), workBlocks.end(), [&orderingEdges](const size_t l, const size_t r) { return orderingEdges[l].size() < orderingEdges[r].size(); });
-        ordering.push_back(*it);
-        for (std::set<size_t>& edges : orderingEdges)
+        const size_t blockIndex = workBlocks.begin()->second;
+        workBlocks.erase(workBlocks.begin());
+        isOrdered[blockIndex] = true;
+
+        for (const size_t successor : successors[blockIndex])
         {
-            edges.erase(*it);
+            if (!isOrdered[successor])
+            {
+                workBlocks.erase(std::make_pair(predecessorCounts[successor], successor));
+                workBlocks.emplace(--predecessorCounts[successor], successor);
+            }
         }
 
-        blocks[*it].applyTransform(invertedAngleMatrix);
-        m_blocks.emplace_back(qMove(blocks[*it]));
-        workBlocks.erase(it);
+        blocks[blockIndex].applyTransform(invertedAngleMatrix);
+        result.emplace_back(qMove(blocks[blockIndex]));
     }
-}
 
-TextCharacters PDFTextLayout::getCharactersForAngle(PDFReal angle) const
-{
-    TextCharacters result;
-    std::copy_if(m_characters.cbegin(), m_characters.cend(), std::back_inserter(result), [angle](const TextCharacter& character) { return character.angle == angle; });
     return result;
 }
 
@@ -1097,7 +1435,7 @@ PDFTextLayout PDFTextLayoutStorage::getTextLayout(PDFInteger pageIndex) const
 {
     PDFTextLayout result;
 
-    if (pageIndex >= 0 && pageIndex < static_cast<PDFInteger>(m_offsets.size()))
+    if (pageIndex >= 0 && pageIndex < static_cast<PDFInteger>(m_offsets.size()) && m_offsets[pageIndex] >= 0)
     {
         QDataStream layoutStream(const_cast<QByteArray*>(&m_textLayouts), QIODevice::ReadOnly);
         layoutStream.skipRawData(m_offsets[pageIndex]);
@@ -1122,6 +1460,9 @@ void PDFTextLayoutStorage::setTextLayout(PDFInteger pageIndex, const PDFTextLayo
     }
     result = qCompress(result, 9);
 
+    m_textIndex.addPage(pageIndex, layout, mutex);
+    m_textLayoutViews.setTextLayout(pageIndex, layout, mutex);
+
     QMutexLocker lock(mutex);
     m_offsets[pageIndex] = m_textLayouts.size();
 
@@ -1131,45 +1472,88 @@ void PDFTextLayoutStorage::setTextLayout(PDFInteger pageIndex, const PDFTextLayo
 
 PDFFindResults PDFTextLayoutStorage::find(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const
 {
-    PDFFindResults results;
+    return find(getCandidatePages(text, false), text, caseSensitivity, flowFlags, nullptr);
+}
 
-    QMutex resultsMutex;
-    auto findImpl = [this, flowFlags, caseSensitivity, &results, &resultsMutex, &text](size_t pageIndex)
+PDFFindResults PDFTextLayoutStorage::findWholeWords(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const
+{
+    return findWholeWords(getCandidatePages(text, true), text, caseSensitivity, flowFlags, nullptr);
+}
+
+PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const
+{
+    return find(getAllPages(), expression, flowFlags, nullptr);
+}
+
+PDFFindResults PDFTextLayoutStorage::find(const std::vector<PDFInteger>& pageIndices,
+                                          const QString& text,
+                                          Qt::CaseSensitivity caseSensitivity,
+                                          PDFTextFlow::FlowFlags flowFlags,
+                                          const PDFOperationControl* operationControl) const
+{
+    auto findInFlow = [&text, caseSensitivity](const PDFTextFlow& textFlow)
     {
-        PDFTextLayout textLayout = getTextLayout(pageIndex);
-        PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, flowFlags, pageIndex);
-        for (const PDFTextFlow& textFlow : textFlows)
-        {
-            PDFFindResults flowResults = textFlow.find(text, caseSensitivity);
+        return textFlow.find(text, caseSensitivity);
+    };
 
-            // Jakub Melka: Do not lock mutex, if we didn't find anything. In that case, just skip to next flow.
-            if (!flowResults.empty())
-            {
-                QMutexLocker lock(&resultsMutex);
-                results.insert(results.end(), flowResults.begin(), flowResults.end());
-            }
-        }
+    return findImpl(pageIndices, flowFlags, findInFlow, operationControl);
+}
+
+PDFFindResults PDFTextLayoutStorage::findWholeWords(const std::vector<PDFInteger>& pageIndices,
+                                                    const QString& text,
+                                                    Qt::CaseSensitivity caseSensitivity,
+                                                    PDFTextFlow::FlowFlags flowFlags,
+                                                    const PDFOperationControl* operationControl) const
+{
+    QRegularExpression::PatternOptions patternOptions = QRegularExpression::UseUnicodePropertiesOption;
+    if (caseSensitivity == Qt::CaseInsensitive)
+    {
+        patternOptions |= QRegularExpression::CaseInsensitiveOption;
+    }
+
+    QRegularExpression expression(QString("\\b%1\\b").arg(QRegularExpression::escape(text)), patternOptions);
+    auto findInFlow = [&expression](const PDFTextFlow& textFlow)
+    {
+        return textFlow.find(expression);
     };
 
-    auto range = PDFIntegerRange<size_t>(0, m_offsets.size());
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findImpl);
+    return findImpl(pageIndices, flowFlags, findInFlow, operationControl);
+}
 
-    std::sort(results.begin(), results.end());
-    return results;
+PDFFindResults PDFTextLayoutStorage::find(const std::vector<PDFInteger>& pageIndices,
+                                          const QRegularExpression& expression,
+                                          PDFTextFlow::FlowFlags flowFlags,
+                                          const PDFOperationControl* operationControl) const
+{
+    auto findInFlow = [&expression](const PDFTextFlow& textFlow)
+    {
+        return textFlow.find(expression);
+    };
+
+    return findImpl(pageIndices, flowFlags, findInFlow, operationControl);
 }
 
-PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const
+PDFFindResults PDFTextLayoutStorage::findImpl(const std::vector<PDFInteger>& pageIndices,
+                                              PDFTextFlow::FlowFlags flowFlags,
+                                              const std::function<PDFFindResults(const PDFTextFlow&)>& findInFlow,
+                                              const PDFOperationControl* operationControl) const
 {
     PDFFindResults results;
 
     QMutex resultsMutex;
-    auto findImpl = [this, flowFlags, &results, &resultsMutex, &expression](size_t pageIndex)
+    auto findOnPage = [this, flowFlags, &findInFlow, &results, &resultsMutex, operationControl](PDFInteger pageIndex)
     {
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            // Search was cancelled, skip remaining pages
+            return;
+        }
+
         PDFTextLayout textLayout = getTextLayout(pageIndex);
         PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, flowFlags, pageIndex);
         for (const PDFTextFlow& textFlow : textFlows)
         {
-            PDFFindResults flowResults = textFlow.find(expression);
+            PDFFindResults flowResults = findInFlow(textFlow);
 
             // Jakub Melka: Do not lock mutex, if we didn't find anything. In that case, just skip to next flow.
             if (!flowResults.empty())
@@ -1180,13 +1564,135 @@ PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression,
         }
     };
 
-    auto range = PDFIntegerRange<size_t>(0, m_offsets.size());
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findImpl);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageIndices.cbegin(), pageIndices.cend(), findOnPage);
 
     std::sort(results.begin(), results.end());
     return results;
 }
 
+std::vector<PDFInteger> PDFTextLayoutStorage::getCandidatePages(const QString& text, bool wholeWords) const
+{
+    if (std::optional<std::vector<PDFInteger>> candidatePages = m_textIndex.getCandidatePages(text, wholeWords))
+    {
+        return std::move(*candidatePages);
+    }
+
+    // Index can't be used, search all pages
+    return getAllPages();
+}
+
+std::vector<PDFInteger> PDFTextLayoutStorage::getAllPages() const
+{
+    std::vector<PDFInteger> pageIndices(m_offsets.size(), 0);
+    std::iota(pageIndices.begin(), pageIndices.end(), 0);
+    return pageIndices;
+}
+
+bool PDFTextLayoutStorage::save(const QString& fileName, const QByteArray& documentHash) const
+{
+    if (documentHash.isEmpty())
+    {
+        return false;
+    }
+
+    QByteArray payload;
+    {
+        QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+        payloadStream.setVersion(QDataStream::Qt_6_0);
+        payloadStream << m_offsets;
+        payloadStream << m_textLayouts;
+        payloadStream << m_textIndex;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.writeRawData(TEXT_LAYOUT_STORAGE_MAGIC, 8);
+    stream << TEXT_LAYOUT_STORAGE_VERSION;
+    stream << documentHash;
+    stream << payload;
+    stream << QCryptographicHash::hash(payload, QCryptographicHash::Sha1);
+
+    return stream.status() == QDataStream::Ok && file.commit() && m_textLayoutViews.save(getTextLayoutViewsFileName(fileName), documentHash);
+}
+
+bool PDFTextLayoutStorage::load(const QString& fileName, const QByteArray& documentHash)
+{
+    if (documentHash.isEmpty())
+    {
+        return false;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    QByteArray magic(8, Qt::Uninitialized);
+    qint32 version = 0;
+    QByteArray storedDocumentHash;
+    QByteArray payload;
+    QByteArray payloadHash;
+
+    if (stream.readRawData(magic.data(), magic.size()) != magic.size() || magic != TEXT_LAYOUT_STORAGE_MAGIC)
+    {
+        return false;
+    }
+
+    stream >> version;
+    if (version != TEXT_LAYOUT_STORAGE_VERSION)
+    {
+        return false;
+    }
+
+    stream >> storedDocumentHash;
+    stream >> payload;
+    stream >> payloadHash;
+
+    if (stream.status() != QDataStream::Ok ||
+        storedDocumentHash != documentHash ||
+        QCryptographicHash::hash(payload, QCryptographicHash::Sha1) != payloadHash)
+    {
+        return false;
+    }
+
+    std::vector<int> offsets;
+    QByteArray textLayouts;
+    PDFTextIndex textIndex;
+
+    QDataStream payloadStream(payload);
+    payloadStream.setVersion(QDataStream::Qt_6_0);
+    payloadStream >> offsets;
+    payloadStream >> textLayouts;
+    payloadStream >> textIndex;
+
+    if (payloadStream.status() != QDataStream::Ok)
+    {
+        return false;
+    }
+
+    PDFTextLayoutViewStorage textLayoutViews;
+    if (!textLayoutViews.map(getTextLayoutViewsFileName(fileName), documentHash) || textLayoutViews.getCount() != offsets.size())
+    {
+        return false;
+    }
+
+    m_offsets = std::move(offsets);
+    m_textLayouts = std::move(textLayouts);
+    m_textIndex = std::move(textIndex);
+    m_textLayoutViews = std::move(textLayoutViews);
+    return true;
+}
+
 QDataStream& operator<<(QDataStream& stream, const PDFTextLayoutSettings& settings)
 {
     stream << settings.samples;
@@ -1518,19 +2024,25 @@ void PDFTextSelectionPainter::draw(QPainter* painter,
 {
     Q_ASSERT(painter);
 
+    draw(painter, preparePageGeometry(pageIndex, textLayoutGetter), matrix, convertor);
+}
+
+PDFTextSelectionPainter::PageGeometry PDFTextSelectionPainter::preparePageGeometry(PDFInteger pageIndex, PDFTextLayoutGetter& textLayoutGetter) const
+{
+    PageGeometry geometry;
+
     auto it = m_selection->begin(pageIndex);
     auto itEnd = m_selection->end(pageIndex);
 
     if (it == itEnd)
     {
         // Jakub Melka: no text is selected on current page; do nothing
-        return;
+        return geometry;
     }
 
-    painter->save();
-
     const PDFTextLayout& layout = textLayoutGetter;
     const PDFTextBlocks& blocks = layout.getTextBlocks();
+    geometry.reserve(std::distance(it, itEnd));
     for (; it != itEnd; ++it)
     {
         const PDFTextSelectionColoredItem& item = *it;
@@ -1547,15 +2059,32 @@ void PDFTextSelectionPainter::draw(QPainter* painter,
         }
 
         const PDFTextBlock& block = blocks[start.blockIndex];
-        QPainterPath path = block.getCharacterRangeBoundingPath(start, end, matrix, HEIGHT_INCREASE_FACTOR);
+        geometry.push_back(PageGeometryItem{ block.getCharacterRangeBoundingPath(start, end, QTransform(), HEIGHT_INCREASE_FACTOR), item.color });
+    }
+
+    return geometry;
+}
+
+void PDFTextSelectionPainter::draw(QPainter* painter, const PageGeometry& geometry, const QTransform& matrix, const PDFColorConvertor& convertor)
+{
+    Q_ASSERT(painter);
 
+    if (geometry.empty())
+    {
+        return;
+    }
+
+    painter->save();
+
+    for (const PageGeometryItem& item : geometry)
+    {
         QColor penColor = item.color.darker();
         QColor brushColor = item.color;
         brushColor.setAlphaF(SELECTION_ALPHA);
 
         painter->setPen(convertor.convert(QPen(penColor)));
         painter->setBrush(convertor.convert(QBrush(brushColor, Qt::SolidPattern)));
-        painter->drawPath(path);
+        painter->drawPath(matrix.map(item.path));
     }
 
     painter->restore();
@@ -1697,6 +2226,9 @@ const PDFTextLayout& PDFTextLayoutCache::getTextLayout(PDFInteger pageIndex)
     {
         m_pageIndex = pageIndex;
         m_layout = m_textLayoutGetter(pageIndex);
+
+        // Layout is used repeatedly for hit testing, so build the spatial index
+        m_layout.optimize();
     }
 
     return m_layout;
@@ -20,6 +20,8 @@
 
 #include "pdfglobal.h"
 #include "pdfutils.h"
+#include "pdftextindex.h"
+#include "pdftextlayoutview.h"
 
 #include <QColor>
 #include <QDataStream>
@@ -27,6 +29,7 @@
 
 #include <set>
 #include <compare>
+#include <functional>
 
 class QMutex;
 
@@ -36,6 +39,7 @@ class PDFTextLayout;
 class PDFTextLayoutStorage;
 struct PDFCharacterPointer;
 class PDFColorConvertor;
+class PDFOperationControl;
 
 struct PDFTextCharacterInfo
 {
@@ -181,6 +185,83 @@ private:
 
 using PDFTextBlocks = std::vector<PDFTextBlock>;
 
+/// Spatial index of text layout. It is a bounding volume hierarchy over
+/// axis-aligned bounding boxes of text blocks, text lines and characters,
+/// so point and rectangle queries are logarithmic. Query returns candidate
+/// items, whose exact bounding boxes (which can be rotated) must be tested for
+/// intersection by the caller.
+class PDFTextLayoutSpatialIndex
+{
+public:
+    explicit inline PDFTextLayoutSpatialIndex() = default;
+
+    enum class Level
+    {
+        Block,
+        Line,
+        Character
+    };
+
+    struct Item
+    {
+        QRectF boundingBox;
+        size_t blockIndex = 0;
+        size_t lineIndex = 0;
+        size_t characterIndex = 0;
+    };
+    using Items = std::vector<Item>;
+
+    /// Builds the index over text blocks
+    /// \param blocks Text blocks
+    void build(const PDFTextBlocks& blocks);
+
+    /// Clears the index
+    void clear();
+
+    /// Returns true, if index was built
+    bool isBuilt() const { return m_isBuilt; }
+
+    /// Finds all items of given level, whose bounding box intersects the rectangle
+    /// (rectangle can be empty, for example, it can be a single point). Items
+    /// are appended to the result.
+    /// \param level Level of items
+    /// \param rect Query rectangle
+    /// \param result Result of query
+    void query(Level level, const QRectF& rect, Items* result) const;
+
+private:
+    /// Maximal number of items in leaf node
+    static constexpr const size_t LEAF_SIZE = 8;
+
+    struct Node
+    {
+        bool isLeaf = false;
+        size_t index1 = 0;
+        size_t index2 = 0;
+        QRectF boundingBox;
+    };
+    using Nodes = std::vector<Node>;
+
+    struct Tree
+    {
+        Items items;
+        Nodes nodes;
+    };
+
+    /// Builds tree over items of range [first, last), returns node index
+    static size_t buildTree(Tree& tree, size_t first, size_t last);
+
+    /// Queries tree node
+    static void queryTree(const Tree& tree, size_t nodeIndex, const QRectF& rect, Items* result);
+
+    const Tree& getTree(Level level) const;
+
+    bool m_isBuilt = false;
+    Tree m_blocks;
+    Tree m_lines;
+    Tree m_characters;
+};
+
 /// Character pointer points to some character in text layout.
 /// It also has page index to decide, which page the pointer points to.
 struct PDFCharacterPointer
@@ -316,6 +397,11 @@ public:
     /// Returns character bounding boxes
     std::vector<QRectF> getBoundingBoxes() const { return m_characterBoundingBoxes; }
 
+    /// Returns character pointers for each character of the text. Characters,
+    /// which have no counterpart in the text layout (for example, line breaks),
+    /// have invalid character pointer.
+    const std::vector<PDFCharacterPointer>& getCharacterPointers() const { return m_characterPointers; }
+
     /// Returns text form character pointers
     /// \param begin Begin character
     /// \param end End character
@@ -366,6 +452,7 @@ public:
     void perform();
 
     /// Optimizes layout memory allocation to contain less space
+    /// and builds spatial index for hit testing and text selection.
     void optimize();
 
     /// Returns estimate of number of bytes, which this mesh occupies in memory
@@ -377,6 +464,12 @@ public:
     /// Returns true, if given point is pointing to some text block
     bool isHoveringOverTextBlock(const QPointF& point) const;
 
+    /// Returns pointer to the character, whose bounding box contains the
+    /// given point. If there is no such character, invalid pointer is returned.
+    /// \param pageIndex Page index
+    /// \param point Point
+    PDFCharacterPointer getCharacterAt(PDFInteger pageIndex, const QPointF& point) const;
+
     /// Creates text selection. This function needs to modify the layout contents,
     /// so do not use this function from multiple threads (it is not thread-safe).
     /// Text selection is created from rectangle using two points.
@@ -419,23 +512,29 @@ public:
     friend QDataStream& operator>>(QDataStream& stream, PDFTextLayout& layout);
 
 private:
-    /// Makes layout for particular angle
-    void performDoLayout(PDFReal angle);
-
-    /// Returns a list of characters for particular angle. Exact match is used
-    /// for angle, even if angle is floating point number.
+    /// Makes layout for particular angle and returns text blocks
+    /// (in page coordinates) in reading order.
     /// \param angle Angle
-    TextCharacters getCharactersForAngle(PDFReal angle) const;
+    /// \param characters Characters having given angle (exact match is used)
+    PDFTextBlocks performDoLayout(PDFReal angle, TextCharacters characters) const;
 
     /// Applies transform to text characters (positions and bounding boxes)
     /// \param characters Characters
     /// \param matrix Transform matrix
     static void applyTransform(TextCharacters& characters, const QTransform& matrix);
 
+    /// Returns indices of blocks, which can intersect the rectangle. If spatial
+    /// index is not built, then all blocks are returned. Rectangle is given
+    /// in the coordinate system of the block rotated by block angle.
+    /// \param point1 First point of the rectangle (in page coordinates)
+    /// \param point2 Second point of the rectangle (in page coordinates)
+    std::vector<size_t> getCandidateBlocks(const QPointF& point1, const QPointF& point2) const;
+
     TextCharacters m_characters;
     std::set<PDFReal> m_angles;
     PDFTextLayoutSettings m_settings;
     PDFTextBlocks m_blocks;
+    PDFTextLayoutSpatialIndex m_spatialIndex;
 };
 
 /// Cache for storing single text layout
@@ -532,6 +631,31 @@ public:
     /// \param matrix Matrix which translates from page space to device space
     QPainterPath prepareGeometry(PDFInteger pageIndex, PDFTextLayoutGetter& textLayoutGetter, const QTransform& matrix, QPolygonF* quadrilaterals);
 
+    /// Selected item geometry in page space, with its color
+    struct PageGeometryItem
+    {
+        QPainterPath path;
+        QColor color;
+    };
+
+    /// Geometry of the text selection on the page, in page space. It doesn't
+    /// depend on the page to device matrix, so it can be cached and drawn
+    /// repeatedly, for example, when zoom is being changed.
+    using PageGeometry = std::vector<PageGeometryItem>;
+
+    /// Prepares geometry of the text selection on the page in page space. If current text selection
+    /// doesn't contain items from active page, then text layout is not accessed.
+    /// \param pageIndex Page index
+    /// \param textLayoutGetter Text layout getter
+    PageGeometry preparePageGeometry(PDFInteger pageIndex, PDFTextLayoutGetter& textLayoutGetter) const;
+
+    /// Draws page geometry of text selection (prepared by \p preparePageGeometry) on the painter
+    /// \param painter Painter
+    /// \param geometry Page geometry
+    /// \param matrix Matrix which translates from page space to device space
+    /// \param convertor Color convertor
+    static void draw(QPainter* painter, const PageGeometry& geometry, const QTransform& matrix, const PDFColorConvertor& convertor);
+
 private:
     static constexpr const PDFReal HEIGHT_INCREASE_FACTOR = 0.40;
     static constexpr const PDFReal SELECTION_ALPHA = 0.25;
@@ -542,20 +666,24 @@ private:
 /// Storage for text layouts. For reading and writing, this object is thread safe.
 /// For writing, mutex is used to synchronize asynchronous writes, for reading
 /// no mutex is used at all. For this reason, both reading/writing at the same time
-/// is prohibited, it is not thread safe.
+/// is prohibited, it is not thread safe. Full-text index is built together
+/// with the storage and it is used to restrict text search only to pages,
+/// which can contain searched text.
 class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutStorage
 {
 public:
     explicit inline PDFTextLayoutStorage() = default;
     explicit inline PDFTextLayoutStorage(PDFInteger pageCount) :
-        m_offsets(pageCount, 0)
+        m_offsets(pageCount, -1),
+        m_textLayoutViews(pageCount)
     {
 
     }
 
     /// Returns text layout for particular page. If page index is invalid,
-    /// then empty text layout is returned. Function is not thread safe, if
-    /// function \p setTextLayout is called from another thread.
+    /// or text layout of the page was not set yet, then empty text layout
+    /// is returned. Function is not thread safe, if function \p setTextLayout
+    /// is called from another thread.
     /// \param pageIndex Page index
     PDFTextLayout getTextLayout(PDFInteger pageIndex) const;
 
@@ -565,6 +693,13 @@ public:
     /// \param pageIndex Page index
     PDFTextLayoutStorageGetter getTextLayoutLazy(PDFInteger pageIndex) const { return PDFTextLayoutStorageGetter(this, pageIndex); }
 
+    /// Returns flat text layout of particular page, which can be queried
+    /// without decompression (for example, for hit testing). If page index
+    /// is invalid, then invalid view is returned. View is valid as long as
+    /// this storage (or its copy) exists.
+    /// \param pageIndex Page index
+    PDFTextLayoutView getTextLayoutView(PDFInteger pageIndex) const { return m_textLayoutViews.getTextLayoutView(pageIndex); }
+
     /// Sets text layout to the particular index. Index must be valid and from
     /// range 0 to \p pageCount - 1. Function is not thread safe.
     /// \param pageIndex Page index
@@ -578,17 +713,111 @@ public:
     /// \param flowFlags Text flow flags
     PDFFindResults find(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const;
 
+    /// Finds whole words (or phrase consisting of whole words) in all pages.
+    /// All text occurences are returned.
+    /// \param text Text to be found
+    /// \param caseSensitivity Case sensitivity
+    /// \param flowFlags Text flow flags
+    PDFFindResults findWholeWords(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const;
+
     /// Finds regular expression matches in current text flow. All text occurences are returned.
+    /// Text index can't be used for regular expressions, so pages are decompressed
+    /// and searched one by one.
     /// \param expression Regular expression to be matched
     /// \param flowFlags Text flow flags
     PDFFindResults find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const;
 
+    /// Finds simple text in given pages. Search is stopped, if operation is
+    /// cancelled, in that case, results are incomplete.
+    /// \param pageIndices Page indices (see \p getCandidatePages)
+    /// \param text Text to be found
+    /// \param caseSensitivity Case sensitivity
+    /// \param flowFlags Text flow flags
+    /// \param operationControl Operation control (can be nullptr)
+    PDFFindResults find(const std::vector<PDFInteger>& pageIndices,
+                        const QString& text,
+                        Qt::CaseSensitivity caseSensitivity,
+                        PDFTextFlow::FlowFlags flowFlags,
+                        const PDFOperationControl* operationControl) const;
+
+    /// Finds whole words (or phrase consisting of whole words) in given pages.
+    /// Search is stopped, if operation is cancelled, in that case, results are incomplete.
+    /// \param pageIndices Page indices (see \p getCandidatePages)
+    /// \param text Text to be found
+    /// \param caseSensitivity Case sensitivity
+    /// \param flowFlags Text flow flags
+    /// \param operationControl Operation control (can be nullptr)
+    PDFFindResults findWholeWords(const std::vector<PDFInteger>& pageIndices,
+                                  const QString& text,
+                                  Qt::CaseSensitivity caseSensitivity,
+                                  PDFTextFlow::FlowFlags flowFlags,
+                                  const PDFOperationControl* operationControl) const;
+
+    /// Finds regular expression matches in given pages. Search is stopped,
+    /// if operation is cancelled, in that case, results are incomplete.
+    /// \param pageIndices Page indices
+    /// \param expression Regular expression to be matched
+    /// \param flowFlags Text flow flags
+    /// \param operationControl Operation control (can be nullptr)
+    PDFFindResults find(const std::vector<PDFInteger>& pageIndices,
+                        const QRegularExpression& expression,
+                        PDFTextFlow::FlowFlags flowFlags,
+                        const PDFOperationControl* operationControl) const;
+
+    /// Returns pages, on which simple text (or whole words) can be found. Full-text
+    /// index is used, if possible, otherwise all pages are returned.
+    /// \param text Text to be found
+    /// \param wholeWords Search whole words only
+    std::vector<PDFInteger> getCandidatePages(const QString& text, bool wholeWords) const;
+
+    /// Returns indices of all pages
+    std::vector<PDFInteger> getAllPages() const;
+
+    /// Returns true, if text layout of the page was already set (partially
+    /// created storage doesn't contain text layouts of all pages).
+    /// \param pageIndex Page index
+    bool hasTextLayout(PDFInteger pageIndex) const { return pageIndex >= 0 && pageIndex < PDFInteger(m_offsets.size()) && m_offsets[pageIndex] != -1; }
+
     /// Returns number of pages
     size_t getCount() const { return m_offsets.size(); }
 
+    /// Returns full-text index of all pages
+    const PDFTextIndex& getTextIndex() const { return m_textIndex; }
+
+    /// Saves text layouts and text index to the file, so they can be reused,
+    /// when document is opened next time. Flat text layouts are saved to the
+    /// sidecar file (see \p getTextLayoutViewsFileName), from which they are
+    /// memory mapped when loading. Returns true, if storage was saved.
+    /// \param fileName File name
+    /// \param documentHash Hash of the document source data
+    bool save(const QString& fileName, const QByteArray& documentHash) const;
+
+    /// Loads text layouts and text index from the file. File is accepted only,
+    /// if it was saved for the document with the same hash and has the same
+    /// format version. Returns true, if storage was loaded.
+    /// \param fileName File name
+    /// \param documentHash Hash of the document source data
+    bool load(const QString& fileName, const QByteArray& documentHash);
+
+    /// Returns file name of the sidecar file with flat text layouts
+    /// \param fileName File name of the storage
+    static QString getTextLayoutViewsFileName(const QString& fileName) { return fileName + QLatin1String(".views"); }
+
 private:
+    /// Finds text in text flows of given pages
+    /// \param pageIndices Page indices
+    /// \param flowFlags Text flow flags
+    /// \param findInFlow Function, which finds text in the text flow
+    /// \param operationControl Operation control (can be nullptr)
+    PDFFindResults findImpl(const std::vector<PDFInteger>& pageIndices,
+                            PDFTextFlow::FlowFlags flowFlags,
+                            const std::function<PDFFindResults(const PDFTextFlow&)>& findInFlow,
+                            const PDFOperationControl* operationControl) const;
+
     std::vector<int> m_offsets;
     QByteArray m_textLayouts;
+    PDFTextIndex m_textIndex;
+    PDFTextLayoutViewStorage m_textLayoutViews;
 };
 
 }   // namespace pdf
@@ -16,6 +16,7 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdftextlayoutgenerator.h"
+#include "pdfinstrumentation.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -23,6 +24,7 @@ namespace pdf
 
 PDFTextLayout PDFTextLayoutGenerator::createTextLayout()
 {
+    PDFTraceScope traceScope("text-layout", "text");
     m_textLayout.perform();
     m_textLayout.optimize();
     return qMove(m_textLayout);
@@ -51,6 +53,9 @@ bool PDFTextLayoutGenerator::isContentKindSuppressed(ContentKind kind) const
         case ContentKind::Tiling:
             return false; // Tiling can have text
 
+        case ContentKind::Forms:
+            return false; // Forms can have text
+
         default:
         {
             Q_ASSERT(false);
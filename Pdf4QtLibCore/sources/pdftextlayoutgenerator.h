@@ -36,7 +36,8 @@ public:
         BaseClass(page, document, fontCache, cms, optionalContentActivity, pagePointToDevicePointMatrix, meshQualitySettings),
         m_features(features)
     {
-
+        // Only characters are used to create text layout
+        setTextOnlyProcessing(true);
     }
 
     /// Creates text layout from the text
@@ -0,0 +1,414 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftextlayoutview.h"
+#include "pdftextlayout.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QSaveFile>
+#include <QPainterPath>
+#include <QMutexLocker>
+
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+static constexpr const quint32 TEXT_LAYOUT_VIEW_MAGIC = 0x564C5450; // "PTLV" in little endian
+static constexpr const char* TEXT_LAYOUT_VIEW_FILE_MAGIC = "PDF4QTLV";
+static constexpr const quint32 TEXT_LAYOUT_VIEW_BYTE_ORDER_MARK = 0x01020304;
+
+/// Rounds size up to multiple of 8 bytes
+static constexpr qint64 alignTo8(qint64 size)
+{
+    return (size + 7) & ~qint64(7);
+}
+
+namespace
+{
+
+struct PDFTextLayoutViewHeader
+{
+    quint32 magic = TEXT_LAYOUT_VIEW_MAGIC;
+    quint32 blockCount = 0;
+    quint32 lineCount = 0;
+    quint32 characterCount = 0;
+};
+
+/// Offsets of the columns in flat text layout data
+struct PDFTextLayoutViewSections
+{
+    explicit PDFTextLayoutViewSections(qint64 blockCount, qint64 lineCount, qint64 characterCount)
+    {
+        blockBoundingBoxes = sizeof(PDFTextLayoutViewHeader);
+        lineBoundingBoxes = blockBoundingBoxes + blockCount * qint64(sizeof(PDFTextLayoutQuad));
+        characterBoundingBoxes = lineBoundingBoxes + lineCount * qint64(sizeof(PDFTextLayoutQuad));
+        blockLineOffsets = characterBoundingBoxes + characterCount * qint64(sizeof(PDFTextLayoutQuad));
+        lineCharacterOffsets = blockLineOffsets + (blockCount + 1) * qint64(sizeof(quint32));
+        characters = lineCharacterOffsets + (lineCount + 1) * qint64(sizeof(quint32));
+        size = alignTo8(characters + characterCount * qint64(sizeof(char16_t)));
+    }
+
+    qint64 blockBoundingBoxes = 0;
+    qint64 lineBoundingBoxes = 0;
+    qint64 characterBoundingBoxes = 0;
+    qint64 blockLineOffsets = 0;
+    qint64 lineCharacterOffsets = 0;
+    qint64 characters = 0;
+    qint64 size = 0;
+};
+
+struct PDFTextLayoutViewFileHeader
+{
+    char magic[8] = { };
+    quint32 byteOrderMark = TEXT_LAYOUT_VIEW_BYTE_ORDER_MARK;
+    quint32 version = PDFTextLayoutViewStorage::VERSION;
+    quint32 pageCount = 0;
+    quint32 documentHashSize = 0;
+};
+
+struct PDFTextLayoutViewFilePage
+{
+    qint64 offset = 0;
+    qint64 size = 0;
+};
+
+}   // namespace
+
+PDFTextLayoutQuad PDFTextLayoutQuad::create(const QPainterPath& path)
+{
+    PDFTextLayoutQuad quad;
+
+    // Bounding boxes are created from rectangles (which are transformed),
+    // so they are closed polygons with four vertices (closing element is optional).
+    const int elementCount = path.elementCount();
+    if (elementCount == 4 || (elementCount == 5 && QPointF(path.elementAt(0)) == QPointF(path.elementAt(4))))
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            const QPainterPath::Element& element = path.elementAt(i);
+            quad.x[i] = float(element.x);
+            quad.y[i] = float(element.y);
+        }
+    }
+    else
+    {
+        const QRectF rect = path.controlPointRect();
+        quad.x[0] = float(rect.left());
+        quad.y[0] = float(rect.top());
+        quad.x[1] = float(rect.right());
+        quad.y[1] = float(rect.top());
+        quad.x[2] = float(rect.right());
+        quad.y[2] = float(rect.bottom());
+        quad.x[3] = float(rect.left());
+        quad.y[3] = float(rect.bottom());
+    }
+
+    return quad;
+}
+
+bool PDFTextLayoutQuad::contains(const QPointF& point) const
+{
+    const PDFReal px = point.x();
+    const PDFReal py = point.y();
+
+    bool isInside = false;
+    for (int i = 0, j = 3; i < 4; j = i++)
+    {
+        const PDFReal xi = x[i];
+        const PDFReal yi = y[i];
+        const PDFReal xj = x[j];
+        const PDFReal yj = y[j];
+
+        if ((yi > py) != (yj > py) && px < (xj - xi) * (py - yi) / (yj - yi) + xi)
+        {
+            isInside = !isInside;
+        }
+    }
+
+    return isInside;
+}
+
+QRectF PDFTextLayoutQuad::getBoundingRect() const
+{
+    auto [minX, maxX] = std::minmax_element(std::begin(x), std::end(x));
+    auto [minY, maxY] = std::minmax_element(std::begin(y), std::end(y));
+    return QRectF(QPointF(*minX, *minY), QPointF(*maxX, *maxY));
+}
+
+PDFTextLayoutView::PDFTextLayoutView(const char* data, qint64 size)
+{
+    if (!data || size < qint64(sizeof(PDFTextLayoutViewHeader)) || reinterpret_cast<quintptr>(data) % alignof(PDFTextLayoutQuad) != 0)
+    {
+        return;
+    }
+
+    const PDFTextLayoutViewHeader* header = reinterpret_cast<const PDFTextLayoutViewHeader*>(data);
+    if (header->magic != TEXT_LAYOUT_VIEW_MAGIC)
+    {
+        return;
+    }
+
+    PDFTextLayoutViewSections sections(header->blockCount, header->lineCount, header->characterCount);
+    if (sections.size > size)
+    {
+        return;
+    }
+
+    m_isValid = true;
+    m_blockCount = header->blockCount;
+    m_lineCount = header->lineCount;
+    m_characterCount = header->characterCount;
+    m_blockBoundingBoxes = reinterpret_cast<const PDFTextLayoutQuad*>(data + sections.blockBoundingBoxes);
+    m_lineBoundingBoxes = reinterpret_cast<const PDFTextLayoutQuad*>(data + sections.lineBoundingBoxes);
+    m_characterBoundingBoxes = reinterpret_cast<const PDFTextLayoutQuad*>(data + sections.characterBoundingBoxes);
+    m_blockLineOffsets = reinterpret_cast<const quint32*>(data + sections.blockLineOffsets);
+    m_lineCharacterOffsets = reinterpret_cast<const quint32*>(data + sections.lineCharacterOffsets);
+    m_characters = reinterpret_cast<const char16_t*>(data + sections.characters);
+}
+
+QByteArray PDFTextLayoutView::createData(const PDFTextLayout& layout)
+{
+    const PDFTextBlocks& blocks = layout.getTextBlocks();
+
+    size_t lineCount = 0;
+    size_t characterCount = 0;
+    for (const PDFTextBlock& block : blocks)
+    {
+        lineCount += block.getLines().size();
+        for (const PDFTextLine& line : block.getLines())
+        {
+            characterCount += line.getCharacters().size();
+        }
+    }
+
+    PDFTextLayoutViewSections sections(blocks.size(), lineCount, characterCount);
+    QByteArray result(sections.size, '\0');
+    char* data = result.data();
+
+    PDFTextLayoutViewHeader* header = reinterpret_cast<PDFTextLayoutViewHeader*>(data);
+    header->magic = TEXT_LAYOUT_VIEW_MAGIC;
+    header->blockCount = quint32(blocks.size());
+    header->lineCount = quint32(lineCount);
+    header->characterCount = quint32(characterCount);
+
+    PDFTextLayoutQuad* blockBoundingBoxes = reinterpret_cast<PDFTextLayoutQuad*>(data + sections.blockBoundingBoxes);
+    PDFTextLayoutQuad* lineBoundingBoxes = reinterpret_cast<PDFTextLayoutQuad*>(data + sections.lineBoundingBoxes);
+    PDFTextLayoutQuad* characterBoundingBoxes = reinterpret_cast<PDFTextLayoutQuad*>(data + sections.characterBoundingBoxes);
+    quint32* blockLineOffsets = reinterpret_cast<quint32*>(data + sections.blockLineOffsets);
+    quint32* lineCharacterOffsets = reinterpret_cast<quint32*>(data + sections.lineCharacterOffsets);
+    char16_t* characters = reinterpret_cast<char16_t*>(data + sections.characters);
+
+    size_t lineIndex = 0;
+    size_t characterIndex = 0;
+    for (size_t blockIndex = 0; blockIndex < blocks.size(); ++blockIndex)
+    {
+        const PDFTextBlock& block = blocks[blockIndex];
+        blockBoundingBoxes[blockIndex] = PDFTextLayoutQuad::create(block.getBoundingBox());
+        blockLineOffsets[blockIndex] = quint32(lineIndex);
+
+        for (const PDFTextLine& line : block.getLines())
+        {
+            lineBoundingBoxes[lineIndex] = PDFTextLayoutQuad::create(line.getBoundingBox());
+            lineCharacterOffsets[lineIndex] = quint32(characterIndex);
+
+            for (const TextCharacter& character : line.getCharacters())
+            {
+                characterBoundingBoxes[characterIndex] = PDFTextLayoutQuad::create(character.boundingBox);
+                characters[characterIndex] = character.character.unicode();
+                ++characterIndex;
+            }
+
+            ++lineIndex;
+        }
+    }
+
+    blockLineOffsets[blocks.size()] = quint32(lineIndex);
+    lineCharacterOffsets[lineCount] = quint32(characterIndex);
+
+    return result;
+}
+
+bool PDFTextLayoutView::isHoveringOverTextBlock(const QPointF& point) const
+{
+    return getBlockIndex(point) != -1;
+}
+
+PDFInteger PDFTextLayoutView::getBlockIndex(const QPointF& point) const
+{
+    for (size_t i = 0, blockCount = getBlockCount(); i < blockCount; ++i)
+    {
+        if (m_blockBoundingBoxes[i].contains(point))
+        {
+            return PDFInteger(i);
+        }
+    }
+
+    return -1;
+}
+
+QString PDFTextLayoutView::getLineText(size_t lineIndex) const
+{
+    auto [first, last] = getLineCharacters(lineIndex);
+    return QString(reinterpret_cast<const QChar*>(m_characters + first), qsizetype(last - first));
+}
+
+PDFTextLayoutViewStorage::PDFTextLayoutViewStorage(PDFInteger pageCount) :
+    m_pages(pageCount)
+{
+
+}
+
+void PDFTextLayoutViewStorage::setTextLayout(PDFInteger pageIndex, const PDFTextLayout& layout, QMutex* mutex)
+{
+    Q_ASSERT(!isMapped());
+
+    QByteArray data = PDFTextLayoutView::createData(layout);
+
+    QMutexLocker lock(mutex);
+    m_pages[pageIndex].offset = m_data.size();
+    m_pages[pageIndex].size = data.size();
+    m_data.append(data);
+}
+
+PDFTextLayoutView PDFTextLayoutViewStorage::getTextLayoutView(PDFInteger pageIndex) const
+{
+    if (pageIndex >= 0 && pageIndex < PDFInteger(m_pages.size()) && m_pages[pageIndex].size > 0)
+    {
+        const Page& page = m_pages[pageIndex];
+        return PDFTextLayoutView(getData() + page.offset, page.size);
+    }
+
+    return PDFTextLayoutView();
+}
+
+bool PDFTextLayoutViewStorage::save(const QString& fileName, const QByteArray& documentHash) const
+{
+    if (documentHash.isEmpty())
+    {
+        return false;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly))
+    {
+        return false;
+    }
+
+    PDFTextLayoutViewFileHeader header;
+    std::memcpy(header.magic, TEXT_LAYOUT_VIEW_FILE_MAGIC, sizeof(header.magic));
+    header.pageCount = quint32(m_pages.size());
+    header.documentHashSize = quint32(documentHash.size());
+
+    QByteArray hashData = documentHash;
+    hashData.append(alignTo8(hashData.size()) - hashData.size(), '\0');
+
+    std::vector<PDFTextLayoutViewFilePage> pages;
+    pages.reserve(m_pages.size());
+    for (const Page& page : m_pages)
+    {
+        pages.push_back({ page.offset, page.size });
+    }
+
+    const qint64 dataSize = isMapped() ? m_mappedSize : m_data.size();
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(hashData);
+    file.write(reinterpret_cast<const char*>(pages.data()), qint64(pages.size() * sizeof(PDFTextLayoutViewFilePage)));
+    file.write(getData(), dataSize);
+    return file.commit();
+}
+
+bool PDFTextLayoutViewStorage::map(const QString& fileName, const QByteArray& documentHash)
+{
+    if (documentHash.isEmpty())
+    {
+        return false;
+    }
+
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(fileName);
+    if (!file->open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    const qint64 fileSize = file->size();
+    if (fileSize < qint64(sizeof(PDFTextLayoutViewFileHeader)))
+    {
+        return false;
+    }
+
+    const char* fileData = reinterpret_cast<const char*>(file->map(0, fileSize));
+    if (!fileData)
+    {
+        return false;
+    }
+
+    PDFTextLayoutViewFileHeader header;
+    std::memcpy(&header, fileData, sizeof(header));
+    if (std::memcmp(header.magic, TEXT_LAYOUT_VIEW_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.byteOrderMark != TEXT_LAYOUT_VIEW_BYTE_ORDER_MARK ||
+        header.version != VERSION)
+    {
+        return false;
+    }
+
+    const qint64 hashOffset = sizeof(PDFTextLayoutViewFileHeader);
+    const qint64 pagesOffset = hashOffset + alignTo8(header.documentHashSize);
+    const qint64 dataOffset = pagesOffset + qint64(header.pageCount) * qint64(sizeof(PDFTextLayoutViewFilePage));
+    if (dataOffset > fileSize ||
+        QByteArray::fromRawData(fileData + hashOffset, header.documentHashSize) != documentHash)
+    {
+        return false;
+    }
+
+    const qint64 dataSize = fileSize - dataOffset;
+    std::vector<Page> pages(header.pageCount);
+    for (quint32 i = 0; i < header.pageCount; ++i)
+    {
+        PDFTextLayoutViewFilePage filePage;
+        std::memcpy(&filePage, fileData + pagesOffset + i * qint64(sizeof(PDFTextLayoutViewFilePage)), sizeof(filePage));
+
+        if (filePage.offset < 0 || filePage.size < 0 || filePage.offset % 8 != 0 || filePage.offset + filePage.size > dataSize)
+        {
+            return false;
+        }
+
+        pages[i].offset = filePage.offset;
+        pages[i].size = filePage.size;
+    }
+
+    m_pages = std::move(pages);
+    m_data.clear();
+    m_file = std::move(file);
+    m_mappedData = fileData + dataOffset;
+    m_mappedSize = dataSize;
+    return true;
+}
+
+const char* PDFTextLayoutViewStorage::getData() const
+{
+    return isMapped() ? m_mappedData : m_data.constData();
+}
+
+}   // namespace pdf
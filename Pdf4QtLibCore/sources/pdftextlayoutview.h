@@ -0,0 +1,205 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFTEXTLAYOUTVIEW_H
+#define PDFTEXTLAYOUTVIEW_H
+
+#include "pdfglobal.h"
+
+#include <QRectF>
+#include <QString>
+#include <QByteArray>
+
+#include <memory>
+#include <vector>
+
+class QFile;
+class QMutex;
+class QPainterPath;
+
+namespace pdf
+{
+class PDFTextLayout;
+
+/// Quadrilateral (typically rotated rectangle), used as bounding box
+/// of text blocks, lines and characters in flat text layout.
+struct PDFTextLayoutQuad
+{
+    /// Creates quadrilateral from bounding box path. If path is not
+    /// a polygon having four vertices, its bounding rectangle is used.
+    /// \param path Bounding box path
+    static PDFTextLayoutQuad create(const QPainterPath& path);
+
+    /// Returns true, if point lies inside the quadrilateral (odd-even rule is used)
+    /// \param point Point
+    bool contains(const QPointF& point) const;
+
+    /// Returns bounding rectangle of the quadrilateral
+    QRectF getBoundingRect() const;
+
+    float x[4] = { };
+    float y[4] = { };
+};
+
+/// Read-only view of the text layout of single page, stored in the flat,
+/// offset-based columnar format. Data can be queried in place (no per-access
+/// allocation, no deserialization), so they can be memory mapped from the file.
+/// View doesn't own the data, data must outlive the view. Lines and characters
+/// are indexed globally in the page, block contains range of lines and line contains
+/// range of characters. Format uses native byte order.
+class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutView
+{
+public:
+    explicit inline PDFTextLayoutView() = default;
+
+    /// Creates view over the data. If data are not valid
+    /// flat text layout, then invalid view is created.
+    /// \param data Data of flat text layout (must be aligned at least to 4 bytes)
+    /// \param size Size of the data
+    explicit PDFTextLayoutView(const char* data, qint64 size);
+
+    /// Creates data of flat text layout from the text layout. Size of
+    /// the data is always multiple of 8 bytes.
+    /// \param layout Text layout
+    static QByteArray createData(const PDFTextLayout& layout);
+
+    /// Returns true, if view refers to valid data
+    bool isValid() const { return m_isValid; }
+
+    /// Returns number of text blocks
+    size_t getBlockCount() const { return m_blockCount; }
+
+    /// Returns number of text lines (in all blocks)
+    size_t getLineCount() const { return m_lineCount; }
+
+    /// Returns number of characters (in all lines)
+    size_t getCharacterCount() const { return m_characterCount; }
+
+    /// Returns range [first, last) of lines of the text block
+    /// \param blockIndex Block index
+    std::pair<size_t, size_t> getBlockLines(size_t blockIndex) const { return { m_blockLineOffsets[blockIndex], m_blockLineOffsets[blockIndex + 1] }; }
+
+    /// Returns range [first, last) of characters of the text line
+    /// \param lineIndex Line index (global in the page)
+    std::pair<size_t, size_t> getLineCharacters(size_t lineIndex) const { return { m_lineCharacterOffsets[lineIndex], m_lineCharacterOffsets[lineIndex + 1] }; }
+
+    /// Returns bounding box of text block
+    /// \param blockIndex Block index
+    const PDFTextLayoutQuad& getBlockBoundingBox(size_t blockIndex) const { return m_blockBoundingBoxes[blockIndex]; }
+
+    /// Returns bounding box of text line
+    /// \param lineIndex Line index (global in the page)
+    const PDFTextLayoutQuad& getLineBoundingBox(size_t lineIndex) const { return m_lineBoundingBoxes[lineIndex]; }
+
+    /// Returns bounding box of character
+    /// \param characterIndex Character index (global in the page)
+    const PDFTextLayoutQuad& getCharacterBoundingBox(size_t characterIndex) const { return m_characterBoundingBoxes[characterIndex]; }
+
+    /// Returns character
+    /// \param characterIndex Character index (global in the page)
+    QChar getCharacter(size_t characterIndex) const { return QChar(m_characters[characterIndex]); }
+
+    /// Returns true, if given point is pointing to some text block
+    /// \param point Point
+    bool isHoveringOverTextBlock(const QPointF& point) const;
+
+    /// Returns index of the text block under the point, or -1,
+    /// if point doesn't point to any text block.
+    /// \param point Point
+    PDFInteger getBlockIndex(const QPointF& point) const;
+
+    /// Returns text of the text line (line is not interpreted, just characters are returned)
+    /// \param lineIndex Line index (global in the page)
+    QString getLineText(size_t lineIndex) const;
+
+private:
+    bool m_isValid = false;
+    size_t m_blockCount = 0;
+    size_t m_lineCount = 0;
+    size_t m_characterCount = 0;
+    const PDFTextLayoutQuad* m_blockBoundingBoxes = nullptr;
+    const PDFTextLayoutQuad* m_lineBoundingBoxes = nullptr;
+    const PDFTextLayoutQuad* m_characterBoundingBoxes = nullptr;
+    const quint32* m_blockLineOffsets = nullptr;
+    const quint32* m_lineCharacterOffsets = nullptr;
+    const char16_t* m_characters = nullptr;
+};
+
+/// Storage of flat text layouts of all pages. Flat text layouts are either stored
+/// in the memory, or they are memory mapped from the file. Storing of text layouts
+/// can be done from multiple threads, if mutex is used, but reading and writing at
+/// the same time is prohibited.
+class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutViewStorage
+{
+public:
+    explicit inline PDFTextLayoutViewStorage() = default;
+    explicit PDFTextLayoutViewStorage(PDFInteger pageCount);
+
+    /// Version of the file format. Increase this number,
+    /// whenever flat text layout format is changed.
+    static constexpr const quint32 VERSION = 1;
+
+    /// Creates flat text layout of the page and stores it.
+    /// \param pageIndex Page index
+    /// \param layout Text layout
+    /// \param mutex Mutex for locking (calls of setTextLayout from multiple threads)
+    void setTextLayout(PDFInteger pageIndex, const PDFTextLayout& layout, QMutex* mutex);
+
+    /// Returns view of the text layout of the page. If page index is invalid,
+    /// or page doesn't have text layout, then invalid view is returned.
+    /// \param pageIndex Page index
+    PDFTextLayoutView getTextLayoutView(PDFInteger pageIndex) const;
+
+    /// Returns number of pages
+    size_t getCount() const { return m_pages.size(); }
+
+    /// Returns true, if flat text layouts are memory mapped from the file
+    bool isMapped() const { return m_file != nullptr; }
+
+    /// Saves flat text layouts of all pages to the file, which can be memory mapped.
+    /// Returns true, if file was saved.
+    /// \param fileName File name
+    /// \param documentHash Hash of the document source data
+    bool save(const QString& fileName, const QByteArray& documentHash) const;
+
+    /// Memory maps flat text layouts from the file. File is accepted only, if it
+    /// was saved for the document with the same hash, has the same format version
+    /// and the same byte order. Returns true, if file was mapped.
+    /// \param fileName File name
+    /// \param documentHash Hash of the document source data
+    bool map(const QString& fileName, const QByteArray& documentHash);
+
+private:
+    struct Page
+    {
+        qint64 offset = 0;
+        qint64 size = 0;
+    };
+
+    const char* getData() const;
+
+    std::vector<Page> m_pages;
+    QByteArray m_data;
+    std::shared_ptr<QFile> m_file;
+    const char* m_mappedData = nullptr;
+    qint64 m_mappedSize = 0;
+};
+
+}   // namespace pdf
+
+#endif // PDFTEXTLAYOUTVIEW_H
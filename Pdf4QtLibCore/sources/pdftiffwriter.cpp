@@ -0,0 +1,357 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftiffwriter.h"
+
+#include <QtEndian>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+namespace
+{
+
+// Tags and field types of the TIFF specification, BigTIFF extension
+// uses 64-bit offsets and counts, so large images can be stored.
+enum TiffTag : quint16
+{
+    TagImageWidth = 256,
+    TagImageLength = 257,
+    TagBitsPerSample = 258,
+    TagCompression = 259,
+    TagPhotometricInterpretation = 262,
+    TagStripOffsets = 273,
+    TagSamplesPerPixel = 277,
+    TagRowsPerStrip = 278,
+    TagStripByteCounts = 279,
+    TagXResolution = 282,
+    TagYResolution = 283,
+    TagPlanarConfiguration = 284,
+    TagResolutionUnit = 296,
+    TagInkSet = 332,
+    TagInkNames = 333,
+    TagNumberOfInks = 334,
+    TagExtraSamples = 338
+};
+
+enum TiffType : quint16
+{
+    TypeAscii = 2,
+    TypeShort = 3,
+    TypeLong = 4,
+    TypeRational = 5,
+    TypeLong8 = 16
+};
+
+constexpr quint16 TIFF_COMPRESSION_NONE = 1;
+constexpr quint16 TIFF_COMPRESSION_DEFLATE = 8;
+constexpr quint16 TIFF_PHOTOMETRIC_RGB = 2;
+constexpr quint16 TIFF_PHOTOMETRIC_SEPARATED = 5;
+constexpr quint16 TIFF_INK_SET_CMYK = 1;
+constexpr quint16 TIFF_INK_SET_NOT_CMYK = 2;
+constexpr quint16 TIFF_RESOLUTION_UNIT_CENTIMETER = 3;
+constexpr quint16 TIFF_EXTRA_SAMPLE_ASSOCIATED_ALPHA = 1;
+constexpr qint64 BIGTIFF_HEADER_SIZE = 16;
+constexpr qint64 BIGTIFF_DIRECTORY_OFFSET_POSITION = 8;
+
+template<typename T>
+void appendLittleEndian(QByteArray& data, T value)
+{
+    const T littleEndianValue = qToLittleEndian(value);
+    data.append(reinterpret_cast<const char*>(&littleEndianValue), sizeof(T));
+}
+
+}   // namespace
+
+PDFTiffStripWriter::PDFTiffStripWriter(QString fileName, QSize size, int rowsPerStrip, QSize dotsPerMeter, Compression compression) :
+    m_fileName(qMove(fileName)),
+    m_size(size),
+    m_rowsPerStrip(qMax(rowsPerStrip, 1)),
+    m_dotsPerMeter(dotsPerMeter),
+    m_compression(compression)
+{
+    const int stripCount = (m_size.height() + m_rowsPerStrip - 1) / m_rowsPerStrip;
+    m_stripOffsets.resize(stripCount, 0);
+    m_stripByteCounts.resize(stripCount, 0);
+}
+
+PDFTiffStripWriter::~PDFTiffStripWriter()
+{
+    m_file.close();
+}
+
+void PDFTiffStripWriter::setSeparated(int bitsPerSample, QStringList inkNames)
+{
+    Q_ASSERT(!m_file.isOpen());
+    Q_ASSERT(bitsPerSample == 8 || bitsPerSample == 16);
+
+    m_colorModel = ColorModel::Separated;
+    m_bitsPerSample = bitsPerSample;
+    m_inkNames = qMove(inkNames);
+}
+
+bool PDFTiffStripWriter::open()
+{
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    // Offset of the image directory is written, when image is finished
+    QByteArray header;
+    header.append("II", 2);
+    appendLittleEndian<quint16>(header, 43);
+    appendLittleEndian<quint16>(header, 8);
+    appendLittleEndian<quint16>(header, 0);
+    appendLittleEndian<quint64>(header, 0);
+    Q_ASSERT(header.size() == BIGTIFF_HEADER_SIZE);
+
+    if (m_file.write(header) != header.size())
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_fileSize = header.size();
+    return true;
+}
+
+QByteArray PDFTiffStripWriter::encodeStrip(const QImage& image, Compression compression)
+{
+    QImage rgbaImage = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+    const qsizetype rowSize = qsizetype(rgbaImage.width()) * 4;
+
+    QByteArray data;
+    data.reserve(rowSize * rgbaImage.height());
+    for (int y = 0; y < rgbaImage.height(); ++y)
+    {
+        data.append(reinterpret_cast<const char*>(rgbaImage.constScanLine(y)), rowSize);
+    }
+
+    return encodeSamples(qMove(data), compression);
+}
+
+QByteArray PDFTiffStripWriter::encodeSamples(QByteArray samples, Compression compression)
+{
+    switch (compression)
+    {
+        case Compression::None:
+            return samples;
+
+        case Compression::Deflate:
+        {
+            // qCompress produces zlib stream prefixed by 4-byte uncompressed size,
+            // TIFF deflate compression uses the zlib stream only.
+            QByteArray compressedData = qCompress(samples);
+            compressedData.remove(0, 4);
+            return compressedData;
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return samples;
+}
+
+bool PDFTiffStripWriter::writeStrip(int stripIndex, const QByteArray& stripData)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (stripIndex < 0 || stripIndex >= getStripCount() || m_stripByteCounts[stripIndex] > 0)
+    {
+        m_errorString = PDFTranslationContext::tr("Invalid strip %1.").arg(stripIndex);
+        return false;
+    }
+
+    if (!m_file.isOpen() || m_file.write(stripData) != stripData.size())
+    {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_stripOffsets[stripIndex] = quint64(m_fileSize);
+    m_stripByteCounts[stripIndex] = quint64(stripData.size());
+    m_fileSize += stripData.size();
+    ++m_writtenStripCount;
+    return true;
+}
+
+bool PDFTiffStripWriter::isComplete() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_writtenStripCount == getStripCount();
+}
+
+bool PDFTiffStripWriter::finish()
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (!m_file.isOpen())
+    {
+        return false;
+    }
+
+    if (m_writtenStripCount != getStripCount())
+    {
+        m_errorString = PDFTranslationContext::tr("Only %1 of %2 strips were written.").arg(m_writtenStripCount).arg(getStripCount());
+        m_file.close();
+        return false;
+    }
+
+    // Arrays of strip offsets and byte counts are written before the directory,
+    // directory must start at word boundary, we align it to 8 bytes.
+    QByteArray data;
+    auto align = [&data, this]()
+    {
+        while ((m_fileSize + data.size()) % 8 != 0)
+        {
+            data.append('\0');
+        }
+    };
+
+    // Returns value of the entry - values, which fit into 8 bytes, are stored
+    // directly in the entry, otherwise, they are written before the directory
+    // and value of the entry is their offset.
+    auto appendValue = [&](QByteArray value) -> quint64
+    {
+        if (value.size() <= 8)
+        {
+            value.append(8 - value.size(), '\0');
+            return qFromLittleEndian<quint64>(value.constData());
+        }
+
+        align();
+        const quint64 offset = quint64(m_fileSize + data.size());
+        data.append(value);
+        return offset;
+    };
+
+    auto appendArray = [&](const std::vector<quint64>& values) -> quint64
+    {
+        QByteArray value;
+        for (quint64 item : values)
+        {
+            appendLittleEndian<quint64>(value, item);
+        }
+        return appendValue(qMove(value));
+    };
+
+    const bool isSeparated = m_colorModel == ColorModel::Separated;
+    const quint16 samplesPerPixel = quint16(getSamplesPerPixel());
+
+    QByteArray bitsPerSampleValue;
+    for (quint16 i = 0; i < samplesPerPixel; ++i)
+    {
+        appendLittleEndian<quint16>(bitsPerSampleValue, quint16(m_bitsPerSample));
+    }
+
+    // Ink names are stored as null terminated strings
+    QByteArray inkNamesValue;
+    for (const QString& inkName : m_inkNames)
+    {
+        inkNamesValue.append(inkName.toLatin1());
+        inkNamesValue.append('\0');
+    }
+
+    const quint64 stripOffsetsValue = appendArray(m_stripOffsets);
+    const quint64 stripByteCountsValue = appendArray(m_stripByteCounts);
+    const quint64 inkNamesCount = quint64(inkNamesValue.size());
+    const quint64 bitsPerSampleEntryValue = appendValue(qMove(bitsPerSampleValue));
+    const quint64 inkNamesEntryValue = isSeparated ? appendValue(qMove(inkNamesValue)) : 0;
+
+    struct Entry
+    {
+        quint16 tag;
+        quint16 type;
+        quint64 count;
+        quint64 value;
+    };
+
+    // Values, which fit into 8 bytes, are stored directly in the entry
+    std::vector<Entry> entries;
+    entries.push_back({ TagImageWidth, TypeLong, 1, quint64(m_size.width()) });
+    entries.push_back({ TagImageLength, TypeLong, 1, quint64(m_size.height()) });
+    entries.push_back({ TagBitsPerSample, TypeShort, samplesPerPixel, bitsPerSampleEntryValue });
+    entries.push_back({ TagCompression, TypeShort, 1, m_compression == Compression::Deflate ? TIFF_COMPRESSION_DEFLATE : TIFF_COMPRESSION_NONE });
+    entries.push_back({ TagPhotometricInterpretation, TypeShort, 1, isSeparated ? TIFF_PHOTOMETRIC_SEPARATED : TIFF_PHOTOMETRIC_RGB });
+    entries.push_back({ TagStripOffsets, TypeLong8, quint64(m_stripOffsets.size()), stripOffsetsValue });
+    entries.push_back({ TagSamplesPerPixel, TypeShort, 1, samplesPerPixel });
+    entries.push_back({ TagRowsPerStrip, TypeLong, 1, quint64(m_rowsPerStrip) });
+    entries.push_back({ TagStripByteCounts, TypeLong8, quint64(m_stripByteCounts.size()), stripByteCountsValue });
+
+    if (m_dotsPerMeter.width() > 0 && m_dotsPerMeter.height() > 0)
+    {
+        // Rational number is stored as numerator and denominator, resolution is in pixels per centimeter
+        entries.push_back({ TagXResolution, TypeRational, 1, quint64(m_dotsPerMeter.width()) | (quint64(100) << 32) });
+        entries.push_back({ TagYResolution, TypeRational, 1, quint64(m_dotsPerMeter.height()) | (quint64(100) << 32) });
+    }
+
+    entries.push_back({ TagPlanarConfiguration, TypeShort, 1, 1 });
+
+    if (m_dotsPerMeter.width() > 0 && m_dotsPerMeter.height() > 0)
+    {
+        entries.push_back({ TagResolutionUnit, TypeShort, 1, TIFF_RESOLUTION_UNIT_CENTIMETER });
+    }
+
+    if (isSeparated)
+    {
+        // Ink set is CMYK only, if there are no spot colors
+        entries.push_back({ TagInkSet, TypeShort, 1, samplesPerPixel == 4 ? TIFF_INK_SET_CMYK : TIFF_INK_SET_NOT_CMYK });
+        entries.push_back({ TagInkNames, TypeAscii, inkNamesCount, inkNamesEntryValue });
+        entries.push_back({ TagNumberOfInks, TypeShort, 1, samplesPerPixel });
+    }
+    else
+    {
+        entries.push_back({ TagExtraSamples, TypeShort, 1, TIFF_EXTRA_SAMPLE_ASSOCIATED_ALPHA });
+    }
+
+    align();
+    const quint64 directoryOffset = quint64(m_fileSize + data.size());
+    appendLittleEndian<quint64>(data, quint64(entries.size()));
+    for (const Entry& entry : entries)
+    {
+        appendLittleEndian<quint16>(data, entry.tag);
+        appendLittleEndian<quint16>(data, entry.type);
+        appendLittleEndian<quint64>(data, entry.count);
+        appendLittleEndian<quint64>(data, entry.value);
+    }
+    appendLittleEndian<quint64>(data, 0);
+
+    QByteArray directoryOffsetData;
+    appendLittleEndian<quint64>(directoryOffsetData, directoryOffset);
+
+    const bool isWritten = m_file.write(data) == data.size() &&
+                           m_file.seek(BIGTIFF_DIRECTORY_OFFSET_POSITION) &&
+                           m_file.write(directoryOffsetData) == directoryOffsetData.size();
+
+    if (!isWritten)
+    {
+        m_errorString = m_file.errorString();
+    }
+
+    m_fileSize += data.size();
+    m_file.close();
+    return isWritten;
+}
+
+}   // namespace pdf
@@ -0,0 +1,133 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTIFFWRITER_H
+#define PDFTIFFWRITER_H
+
+#include "pdfglobal.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QImage>
+#include <QStringList>
+
+#include <vector>
+
+namespace pdf
+{
+
+/// Streaming writer of large images into BigTIFF files. Image is not held
+/// in the memory as a whole, it is written strip by strip (strip is a band
+/// of image rows), so it can be used for images, which are larger, than
+/// available memory. Strips are encoded independently by \p encodeStrip
+/// (it can be done in parallel) and then written in any order. Directory
+/// of the image is written, when all strips were written. By default, pixels
+/// are stored as 8-bit RGBA samples with premultiplied (associated) alpha.
+/// Writer can also store separated images (8-bit or 16-bit ink samples
+/// of CMYK process colors, optionally followed by spot colors).
+class PDF4QTLIBCORESHARED_EXPORT PDFTiffStripWriter
+{
+public:
+
+    enum class Compression
+    {
+        None,
+        Deflate
+    };
+
+    enum class ColorModel
+    {
+        RGBA,       ///< 8-bit RGBA samples with premultiplied alpha
+        Separated   ///< Ink samples, first four inks are cyan, magenta, yellow and black
+    };
+
+    /// Creates new writer
+    /// \param fileName File name
+    /// \param size Size of the whole image
+    /// \param rowsPerStrip Rows per strip, all strips except the last one must have this height
+    /// \param dotsPerMeter Resolution of the image (can be empty)
+    /// \param compression Compression of the strips
+    explicit PDFTiffStripWriter(QString fileName, QSize size, int rowsPerStrip, QSize dotsPerMeter, Compression compression);
+    ~PDFTiffStripWriter();
+
+    /// Sets separated color model, it must be called before the file is opened.
+    /// Samples of the pixel are interleaved in the order of the inks, 16-bit
+    /// samples are stored in little endian byte order.
+    /// \param bitsPerSample Bits per sample (8 or 16)
+    /// \param inkNames Names of the inks (cyan, magenta, yellow, black and spot colors)
+    void setSeparated(int bitsPerSample, QStringList inkNames);
+
+    /// Opens the file and writes the header. Returns true, if file was opened.
+    bool open();
+
+    /// Encodes strip image (it must be strip of the image, which was passed
+    /// to the writer) into the strip data. This function is thread safe,
+    /// it doesn't access the writer.
+    /// \param image Strip image
+    /// \param compression Compression
+    static QByteArray encodeStrip(const QImage& image, Compression compression);
+
+    /// Encodes raw interleaved samples of the strip (rows without padding)
+    /// into the strip data. This function is thread safe, it doesn't access
+    /// the writer.
+    /// \param samples Samples of the strip
+    /// \param compression Compression
+    static QByteArray encodeSamples(QByteArray samples, Compression compression);
+
+    /// Writes encoded strip data into the file. Strips can be written
+    /// in any order, but each strip must be written exactly once.
+    /// This function is thread safe.
+    /// \param stripIndex Strip index
+    /// \param stripData Encoded strip data
+    bool writeStrip(int stripIndex, const QByteArray& stripData);
+
+    /// Writes image directory and closes the file. All strips must be written.
+    bool finish();
+
+    /// Returns true, if all strips were written
+    bool isComplete() const;
+
+    int getStripCount() const { return int(m_stripOffsets.size()); }
+    Compression getCompression() const { return m_compression; }
+    ColorModel getColorModel() const { return m_colorModel; }
+    int getBitsPerSample() const { return m_bitsPerSample; }
+    int getSamplesPerPixel() const { return m_colorModel == ColorModel::RGBA ? 4 : int(m_inkNames.size()); }
+    qint64 getFileSize() const { return m_fileSize; }
+    const QString& getErrorString() const { return m_errorString; }
+
+private:
+    QString m_fileName;
+    QSize m_size;
+    int m_rowsPerStrip;
+    QSize m_dotsPerMeter;
+    Compression m_compression;
+    ColorModel m_colorModel = ColorModel::RGBA;
+    int m_bitsPerSample = 8;
+    QStringList m_inkNames;
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    qint64 m_fileSize = 0;
+    int m_writtenStripCount = 0;
+    std::vector<quint64> m_stripOffsets;
+    std::vector<quint64> m_stripByteCounts;
+    QString m_errorString;
+};
+
+}   // namespace pdf
+
+#endif // PDFTIFFWRITER_H
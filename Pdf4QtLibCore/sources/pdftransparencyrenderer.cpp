@@ -21,14 +21,575 @@
 #include "pdfexecutionpolicy.h"
 #include "pdfimage.h"
 #include "pdfpattern.h"
+#include "pdfsimd.h"
 #include "pdfdbgheap.h"
 
 #include <QtMath>
+#include <QtEndian>
+#include <random>
 #include <iterator>
+#include <numeric>
 
 namespace pdf
 {
 
+/// Row kernels for float bitmaps. Bitmap pixels are stored interleaved, kernels
+/// work with rows in planar layout (each channel of the row has its own array),
+/// so colors of the row can be processed using SIMD instructions.
+class PDFFloatBitmapRowKernels
+{
+public:
+    /// Weights of the compositing formula for pixels of the row. Resulting color
+    /// is C_i = previous * C_i_1 + backdrop * C_b + source * C_s + blended * B,
+    /// where weights already contain division by resulting alpha.
+    struct CompositingWeights
+    {
+        explicit CompositingWeights(size_t count) :
+            previous(count, 1.0f),
+            backdrop(count, 0.0f),
+            source(count, 0.0f),
+            blended(count, 0.0f)
+        {
+
+        }
+
+        /// Sets weights of the pixel so, that previous color is preserved
+        void setIdentity(size_t i)
+        {
+            previous[i] = 1.0f;
+            backdrop[i] = 0.0f;
+            source[i] = 0.0f;
+            blended[i] = 0.0f;
+        }
+
+        std::vector<PDFColorComponent> previous;
+        std::vector<PDFColorComponent> backdrop;
+        std::vector<PDFColorComponent> source;
+        std::vector<PDFColorComponent> blended;
+    };
+
+    /// Copies channel of interleaved pixels into planar row
+    static void gatherChannel(const PDFColorComponent* pixels, size_t pixelSize, size_t channel, PDFColorComponent* values, size_t count)
+    {
+        pixels += channel;
+        for (size_t i = 0; i < count; ++i, pixels += pixelSize)
+        {
+            values[i] = *pixels;
+        }
+    }
+
+    /// Copies planar row into channel of interleaved pixels
+    static void scatterChannel(const PDFColorComponent* values, size_t pixelSize, size_t channel, PDFColorComponent* pixels, size_t count)
+    {
+        pixels += channel;
+        for (size_t i = 0; i < count; ++i, pixels += pixelSize)
+        {
+            *pixels = values[i];
+        }
+    }
+
+    /// Computes result = 1.0 - value for each value of the row,
+    /// result can be the same buffer as values.
+    static void invert(const PDFColorComponent* values, PDFColorComponent* result, size_t count);
+
+    /// Composites colors of the row using compositing weights. Result
+    /// is stored in C_i, which contains previous colors on input.
+    static void composite(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count);
+
+    /// Converts values to 16-bit unsigned normalized integers,
+    /// values are clamped to the range [0, 1].
+    static void packUNorm16(const PDFColorComponent* values, uint16_t* result, size_t count);
+
+    /// Converts 16-bit unsigned normalized integers to values
+    static void unpackUNorm16(const uint16_t* values, PDFColorComponent* result, size_t count);
+
+private:
+    static constexpr PDFColorComponent UNORM16_MAXIMUM = 65535.0f;
+
+#if defined(PDF4QT_SIMD_SSE2)
+    static size_t invertSSE2(const PDFColorComponent* values, PDFColorComponent* result, size_t count);
+    static size_t packUNorm16SSE2(const PDFColorComponent* values, uint16_t* result, size_t count);
+    static size_t unpackUNorm16SSE2(const uint16_t* values, PDFColorComponent* result, size_t count);
+    static size_t compositeSSE2(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count, size_t i);
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+    PDF4QT_SIMD_AVX2_FUNCTION static size_t compositeAVX2(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count);
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+    static size_t invertNEON(const PDFColorComponent* values, PDFColorComponent* result, size_t count);
+    static size_t packUNorm16NEON(const PDFColorComponent* values, uint16_t* result, size_t count);
+    static size_t unpackUNorm16NEON(const uint16_t* values, PDFColorComponent* result, size_t count);
+    static size_t compositeNEON(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count);
+#endif
+};
+
+void PDFFloatBitmapRowKernels::invert(const PDFColorComponent* values, PDFColorComponent* result, size_t count)
+{
+    size_t i = 0;
+
+    if (PDFSimd::getInstructionSet() != PDFSimd::InstructionSet::Scalar)
+    {
+#if defined(PDF4QT_SIMD_SSE2)
+        i = invertSSE2(values, result, count);
+#elif defined(PDF4QT_SIMD_NEON)
+        i = invertNEON(values, result, count);
+#endif
+    }
+
+    for (; i < count; ++i)
+    {
+        result[i] = 1.0f - values[i];
+    }
+}
+
+void PDFFloatBitmapRowKernels::composite(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count)
+{
+    size_t i = 0;
+
+    const PDFSimd::InstructionSet instructionSet = PDFSimd::getInstructionSet();
+    if (instructionSet != PDFSimd::InstructionSet::Scalar)
+    {
+#if defined(PDF4QT_SIMD_AVX2)
+        if (instructionSet == PDFSimd::InstructionSet::AVX2)
+        {
+            i = compositeAVX2(weights, C_b, C_s, B, C_i, count);
+        }
+#endif
+#if defined(PDF4QT_SIMD_SSE2)
+        i = compositeSSE2(weights, C_b, C_s, B, C_i, count, i);
+#elif defined(PDF4QT_SIMD_NEON)
+        i = compositeNEON(weights, C_b, C_s, B, C_i, count);
+#endif
+    }
+
+    for (; i < count; ++i)
+    {
+        C_i[i] = weights.previous[i] * C_i[i] + weights.backdrop[i] * C_b[i] + weights.source[i] * C_s[i] + weights.blended[i] * B[i];
+    }
+}
+
+void PDFFloatBitmapRowKernels::packUNorm16(const PDFColorComponent* values, uint16_t* result, size_t count)
+{
+    size_t i = 0;
+
+    if (PDFSimd::getInstructionSet() != PDFSimd::InstructionSet::Scalar)
+    {
+#if defined(PDF4QT_SIMD_SSE2)
+        i = packUNorm16SSE2(values, result, count);
+#elif defined(PDF4QT_SIMD_NEON)
+        i = packUNorm16NEON(values, result, count);
+#endif
+    }
+
+    for (; i < count; ++i)
+    {
+        result[i] = static_cast<uint16_t>(qBound(0.0f, values[i], 1.0f) * UNORM16_MAXIMUM + 0.5f);
+    }
+}
+
+void PDFFloatBitmapRowKernels::unpackUNorm16(const uint16_t* values, PDFColorComponent* result, size_t count)
+{
+    size_t i = 0;
+
+    if (PDFSimd::getInstructionSet() != PDFSimd::InstructionSet::Scalar)
+    {
+#if defined(PDF4QT_SIMD_SSE2)
+        i = unpackUNorm16SSE2(values, result, count);
+#elif defined(PDF4QT_SIMD_NEON)
+        i = unpackUNorm16NEON(values, result, count);
+#endif
+    }
+
+    constexpr PDFColorComponent scale = 1.0f / UNORM16_MAXIMUM;
+    for (; i < count; ++i)
+    {
+        result[i] = values[i] * scale;
+    }
+}
+
+#if defined(PDF4QT_SIMD_SSE2)
+size_t PDFFloatBitmapRowKernels::invertSSE2(const PDFColorComponent* values, PDFColorComponent* result, size_t count)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_ps(result + i, _mm_sub_ps(one, _mm_loadu_ps(values + i)));
+    }
+
+    return i;
+}
+
+size_t PDFFloatBitmapRowKernels::packUNorm16SSE2(const PDFColorComponent* values, uint16_t* result, size_t count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 maximum = _mm_set1_ps(UNORM16_MAXIMUM);
+
+    // SSE2 has only signed saturation of 32-bit integers to 16-bit integers,
+    // so values are shifted to the signed range and shifted back after packing.
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i signBit = _mm_set1_epi16(short(0x8000));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128 low = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + i), zero), one), maximum);
+        const __m128 high = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + i + 4), zero), one), maximum);
+        const __m128i lowIntegers = _mm_sub_epi32(_mm_cvtps_epi32(low), bias);
+        const __m128i highIntegers = _mm_sub_epi32(_mm_cvtps_epi32(high), bias);
+        const __m128i packed = _mm_xor_si128(_mm_packs_epi32(lowIntegers, highIntegers), signBit);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), packed);
+    }
+
+    return i;
+}
+
+size_t PDFFloatBitmapRowKernels::unpackUNorm16SSE2(const uint16_t* values, PDFColorComponent* result, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / UNORM16_MAXIMUM);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i integers = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        _mm_storeu_ps(result + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(integers, zero)), scale));
+        _mm_storeu_ps(result + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(integers, zero)), scale));
+    }
+
+    return i;
+}
+
+size_t PDFFloatBitmapRowKernels::compositeSSE2(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count, size_t i)
+{
+    const PDFColorComponent* previous = weights.previous.data();
+    const PDFColorComponent* backdrop = weights.backdrop.data();
+    const PDFColorComponent* source = weights.source.data();
+    const PDFColorComponent* blended = weights.blended.data();
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 result = _mm_mul_ps(_mm_loadu_ps(previous + i), _mm_loadu_ps(C_i + i));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(backdrop + i), _mm_loadu_ps(C_b + i)));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(source + i), _mm_loadu_ps(C_s + i)));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(blended + i), _mm_loadu_ps(B + i)));
+        _mm_storeu_ps(C_i + i, result);
+    }
+
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_AVX2)
+PDF4QT_SIMD_AVX2_FUNCTION size_t PDFFloatBitmapRowKernels::compositeAVX2(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count)
+{
+    const PDFColorComponent* previous = weights.previous.data();
+    const PDFColorComponent* backdrop = weights.backdrop.data();
+    const PDFColorComponent* source = weights.source.data();
+    const PDFColorComponent* blended = weights.blended.data();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 result = _mm256_mul_ps(_mm256_loadu_ps(previous + i), _mm256_loadu_ps(C_i + i));
+        result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_loadu_ps(backdrop + i), _mm256_loadu_ps(C_b + i)));
+        result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_loadu_ps(source + i), _mm256_loadu_ps(C_s + i)));
+        result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_loadu_ps(blended + i), _mm256_loadu_ps(B + i)));
+        _mm256_storeu_ps(C_i + i, result);
+    }
+
+    return i;
+}
+#endif
+
+#if defined(PDF4QT_SIMD_NEON)
+size_t PDFFloatBitmapRowKernels::invertNEON(const PDFColorComponent* values, PDFColorComponent* result, size_t count)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_f32(result + i, vsubq_f32(one, vld1q_f32(values + i)));
+    }
+
+    return i;
+}
+
+size_t PDFFloatBitmapRowKernels::packUNorm16NEON(const PDFColorComponent* values, uint16_t* result, size_t count)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t maximum = vdupq_n_f32(UNORM16_MAXIMUM);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const float32x4_t value = vminq_f32(vmaxq_f32(vld1q_f32(values + i), zero), one);
+        vst1_u16(result + i, vmovn_u32(vcvtq_u32_f32(vmlaq_f32(half, value, maximum))));
+    }
+
+    return i;
+}
+
+size_t PDFFloatBitmapRowKernels::unpackUNorm16NEON(const uint16_t* values, PDFColorComponent* result, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1.0f / UNORM16_MAXIMUM);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_f32(result + i, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(values + i))), scale));
+    }
+
+    return i;
+}
+
+size_t PDFFloatBitmapRowKernels::compositeNEON(const CompositingWeights& weights, const PDFColorComponent* C_b, const PDFColorComponent* C_s, const PDFColorComponent* B, PDFColorComponent* C_i, size_t count)
+{
+    const PDFColorComponent* previous = weights.previous.data();
+    const PDFColorComponent* backdrop = weights.backdrop.data();
+    const PDFColorComponent* source = weights.source.data();
+    const PDFColorComponent* blended = weights.blended.data();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t result = vmulq_f32(vld1q_f32(previous + i), vld1q_f32(C_i + i));
+        result = vaddq_f32(result, vmulq_f32(vld1q_f32(backdrop + i), vld1q_f32(C_b + i)));
+        result = vaddq_f32(result, vmulq_f32(vld1q_f32(source + i), vld1q_f32(C_s + i)));
+        result = vaddq_f32(result, vmulq_f32(vld1q_f32(blended + i), vld1q_f32(B + i)));
+        vst1q_f32(C_i + i, result);
+    }
+
+    return i;
+}
+#endif
+
+/// Compositing kernels specialized at compile time. Kernel is selected once
+/// per blend operation by its parameters, so the inner loops do not contain
+/// branches on the blend mode, group type, soft mask or color count.
+class PDFFloatBitmapCompositingKernels
+{
+public:
+    /// Row of pixels, for which compositing weights are computed
+    struct WeightsRow
+    {
+        const PDFColorComponent* sourceRow = nullptr;
+        const PDFColorComponent* targetRow = nullptr;
+        const PDFColorComponent* initialBackdropRow = nullptr;
+        const PDFColorComponent* softMaskRow = nullptr;
+        size_t pixelSize = 0;
+        uint8_t shapeChannel = 0;
+        uint8_t opacityChannel = 0;
+        PDFColorComponent constantAlpha = 1.0f;
+        size_t count = 0;
+    };
+
+    /// Computes resulting shape and opacity of the pixels and weights of the compositing formula
+    using ComputeWeightsFunction = void (*)(const WeightsRow& row, PDFColorComponent* f_g, PDFColorComponent* alpha_g, PDFFloatBitmapRowKernels::CompositingWeights& weights);
+
+    /// Blends process colors using non-separable blend mode, result is in planar layout
+    using BlendNonseparableFunction = void (*)(const PDFColorComponent* backdropRow, const PDFColorComponent* sourceRow, size_t pixelSize, size_t channelStart, PDFColorComponent* B, size_t count);
+
+    /// Returns kernel computing compositing weights
+    /// \param alphaIsShape Soft mask and constant alpha are shapes
+    /// \param knockoutGroup Knockout group
+    /// \param isSoftMaskOpaque Soft mask is opaque (all its values are 1.0)
+    static ComputeWeightsFunction getComputeWeightsFunction(bool alphaIsShape, bool knockoutGroup, bool isSoftMaskOpaque);
+
+    /// Returns kernel blending process colors using non-separable blend mode,
+    /// or nullptr, if blend mode or process color count is not supported.
+    /// \param mode Non-separable blend mode
+    /// \param processColorChannelCount Process color channel count
+    static BlendNonseparableFunction getBlendNonseparableFunction(BlendMode mode, uint8_t processColorChannelCount);
+
+private:
+    template<bool AlphaIsShape, bool KnockoutGroup, bool IsSoftMaskOpaque>
+    static void computeWeights(const WeightsRow& row, PDFColorComponent* f_g, PDFColorComponent* alpha_g, PDFFloatBitmapRowKernels::CompositingWeights& weights);
+
+    template<BlendMode Mode, typename Color>
+    static Color blendNonseparableColor(const Color& Cb, const Color& Cs);
+
+    template<BlendMode Mode, size_t ChannelCount>
+    static void blendNonseparable(const PDFColorComponent* backdropRow, const PDFColorComponent* sourceRow, size_t pixelSize, size_t channelStart, PDFColorComponent* B, size_t count);
+
+    template<BlendMode Mode>
+    static BlendNonseparableFunction getBlendNonseparableFunction(uint8_t processColorChannelCount);
+};
+
+template<bool AlphaIsShape, bool KnockoutGroup, bool IsSoftMaskOpaque>
+void PDFFloatBitmapCompositingKernels::computeWeights(const WeightsRow& row, PDFColorComponent* f_g, PDFColorComponent* alpha_g, PDFFloatBitmapRowKernels::CompositingWeights& weights)
+{
+    const size_t pixelSize = row.pixelSize;
+    const uint8_t shapeChannel = row.shapeChannel;
+    const uint8_t opacityChannel = row.opacityChannel;
+    const PDFColorComponent f_k_i = AlphaIsShape ? row.constantAlpha : 1.0f;
+    const PDFColorComponent q_k_i = !AlphaIsShape ? row.constantAlpha : 1.0f;
+
+    for (size_t i = 0; i < row.count; ++i)
+    {
+        const PDFColorComponent* sourceColor = row.sourceRow + i * pixelSize;
+        const PDFColorComponent* targetColor = row.targetRow + i * pixelSize;
+
+        const PDFColorComponent softMaskValue = IsSoftMaskOpaque ? 1.0f : row.softMaskRow[i];
+        const PDFColorComponent f_j_i = sourceColor[shapeChannel];
+        const PDFColorComponent f_m_i = AlphaIsShape ? softMaskValue : 1.0f;
+        const PDFColorComponent q_m_i = !AlphaIsShape ? softMaskValue : 1.0f;
+        const PDFColorComponent f_s_i = f_j_i * f_m_i * f_k_i;
+        const PDFColorComponent alpha_j_i = sourceColor[opacityChannel];
+        const PDFColorComponent alpha_s_i = alpha_j_i * (f_m_i * q_m_i) * (f_k_i * q_k_i);
+
+        // Old alpha (alpha_g_i_1) is stored in target (immediate) buffer
+        const PDFColorComponent alpha_g_i_1 = targetColor[opacityChannel];
+
+        // alpha_g_0 == 0.0f according to the specification, otherwise select alpha_g_i_1 from target color
+        const PDFColorComponent alpha_g_b = KnockoutGroup ? 0.0f : alpha_g_i_1;
+
+        // alpha_0 is taken from initial backdrop color buffer
+        const PDFColorComponent alpha_0 = row.initialBackdropRow[i * pixelSize + opacityChannel];
+
+        // f_g_i_1 is stored in target (immediate) buffer
+        const PDFColorComponent f_g_i_1 = targetColor[shapeChannel];
+
+        const PDFColorComponent f_g_i = PDFBlendFunction::blend_Union(f_g_i_1, f_s_i);
+        const PDFColorComponent alpha_g_i = (1.0f - f_s_i) * alpha_g_i_1 + (f_s_i - alpha_s_i) * alpha_g_b + alpha_s_i;
+        const PDFColorComponent alpha_i_1 = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i_1);
+        const PDFColorComponent alpha_i = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i);
+
+        // alpha_b is either alpha_0 (for knockout group) or alpha_i_1
+        const PDFColorComponent alpha_b = KnockoutGroup ? alpha_0 : alpha_i_1;
+
+        f_g[i] = f_g_i;
+        alpha_g[i] = alpha_g_i;
+
+        if (qFuzzyIsNull(alpha_g_i))
+        {
+            // If alpha_i is zero, then color is undefined, just fill shape/opacity
+            weights.setIdentity(i);
+            continue;
+        }
+
+        // C_i = ((1 - f_s_i) * alpha_i_1 * C_i_1 + (f_s_i - alpha_s_i) * alpha_b * C_b + alpha_s_i * ((1 - alpha_b) * C_s_i + alpha_b * B_i)) / alpha_i
+        weights.previous[i] = (1.0f - f_s_i) * alpha_i_1 / alpha_i;
+        weights.backdrop[i] = (f_s_i - alpha_s_i) * alpha_b / alpha_i;
+        weights.source[i] = alpha_s_i * (1.0f - alpha_b) / alpha_i;
+        weights.blended[i] = alpha_s_i * alpha_b / alpha_i;
+    }
+}
+
+PDFFloatBitmapCompositingKernels::ComputeWeightsFunction PDFFloatBitmapCompositingKernels::getComputeWeightsFunction(bool alphaIsShape, bool knockoutGroup, bool isSoftMaskOpaque)
+{
+    static constexpr ComputeWeightsFunction functions[2][2][2] =
+    {
+        { { &computeWeights<false, false, false>, &computeWeights<false, false, true> },
+          { &computeWeights<false, true, false>, &computeWeights<false, true, true> } },
+        { { &computeWeights<true, false, false>, &computeWeights<true, false, true> },
+          { &computeWeights<true, true, false>, &computeWeights<true, true, true> } }
+    };
+
+    return functions[alphaIsShape][knockoutGroup][isSoftMaskOpaque];
+}
+
+template<BlendMode Mode, typename Color>
+Color PDFFloatBitmapCompositingKernels::blendNonseparableColor(const Color& Cb, const Color& Cs)
+{
+    if constexpr (Mode == BlendMode::Hue)
+    {
+        return PDFBlendFunction::blend_Hue(Cb, Cs);
+    }
+    else if constexpr (Mode == BlendMode::Saturation)
+    {
+        return PDFBlendFunction::blend_Saturation(Cb, Cs);
+    }
+    else if constexpr (Mode == BlendMode::Color)
+    {
+        return PDFBlendFunction::blend_Color(Cb, Cs);
+    }
+    else
+    {
+        static_assert(Mode == BlendMode::Luminosity, "Blend mode must be non-separable.");
+        return PDFBlendFunction::blend_Luminosity(Cb, Cs);
+    }
+}
+
+template<BlendMode Mode, size_t ChannelCount>
+void PDFFloatBitmapCompositingKernels::blendNonseparable(const PDFColorComponent* backdropRow, const PDFColorComponent* sourceRow, size_t pixelSize, size_t channelStart, PDFColorComponent* B, size_t count)
+{
+    const PDFColorComponent* backdropColor = backdropRow + channelStart;
+    const PDFColorComponent* sourceColor = sourceRow + channelStart;
+
+    for (size_t i = 0; i < count; ++i, backdropColor += pixelSize, sourceColor += pixelSize)
+    {
+        if constexpr (ChannelCount == 1)
+        {
+            B[i] = blendNonseparableColor<Mode, PDFGray>(backdropColor[0], sourceColor[0]);
+        }
+        else
+        {
+            std::array<PDFColorComponent, ChannelCount> Cb = { };
+            std::array<PDFColorComponent, ChannelCount> Cs = { };
+            std::copy(backdropColor, backdropColor + ChannelCount, Cb.begin());
+            std::copy(sourceColor, sourceColor + ChannelCount, Cs.begin());
+
+            const std::array<PDFColorComponent, ChannelCount> blended = blendNonseparableColor<Mode>(Cb, Cs);
+            for (size_t k = 0; k < ChannelCount; ++k)
+            {
+                B[k * count + i] = blended[k];
+            }
+        }
+    }
+}
+
+template<BlendMode Mode>
+PDFFloatBitmapCompositingKernels::BlendNonseparableFunction PDFFloatBitmapCompositingKernels::getBlendNonseparableFunction(uint8_t processColorChannelCount)
+{
+    switch (processColorChannelCount)
+    {
+        case 1:
+            return &blendNonseparable<Mode, 1>;
+
+        case 3:
+            return &blendNonseparable<Mode, 3>;
+
+        case 4:
+            return &blendNonseparable<Mode, 4>;
+
+        default:
+            break;
+    }
+
+    return nullptr;
+}
+
+PDFFloatBitmapCompositingKernels::BlendNonseparableFunction PDFFloatBitmapCompositingKernels::getBlendNonseparableFunction(BlendMode mode, uint8_t processColorChannelCount)
+{
+    switch (mode)
+    {
+        case BlendMode::Hue:
+            return getBlendNonseparableFunction<BlendMode::Hue>(processColorChannelCount);
+
+        case BlendMode::Saturation:
+            return getBlendNonseparableFunction<BlendMode::Saturation>(processColorChannelCount);
+
+        case BlendMode::Color:
+            return getBlendNonseparableFunction<BlendMode::Color>(processColorChannelCount);
+
+        case BlendMode::Luminosity:
+            return getBlendNonseparableFunction<BlendMode::Luminosity>(processColorChannelCount);
+
+        default:
+            break;
+    }
+
+    return nullptr;
+}
+
 PDFFloatBitmap::PDFFloatBitmap() :
     m_width(0),
     m_height(0),
@@ -96,14 +657,18 @@ PDFFloatBitmap PDFFloatBitmap::getInkCoverageBitmap() const
 {
     PDFFloatBitmap result(getWidth(), getHeight(), PDFPixelFormat::createFormat(1, 0, false, true, false));
 
-    for (size_t y = 0; y < getHeight(); ++y)
+    const uint8_t colorChannelIndexStart = m_format.getColorChannelIndexStart();
+    const uint8_t colorChannelIndexEnd = m_format.getColorChannelIndexEnd();
+
+    PDFColorComponent* targetPixel = result.begin();
+    for (const PDFColorComponent* sourcePixel = begin(); sourcePixel != end(); sourcePixel += m_pixelSize, ++targetPixel)
     {
-        for (size_t x = 0; x < getWidth(); ++x)
+        PDFColorComponent inkCoverage = 0.0;
+        for (uint8_t i = colorChannelIndexStart; i < colorChannelIndexEnd; ++i)
         {
-            PDFColorComponent coverage = getPixelInkCoverage(x, y);
-            PDFColorBuffer targetProcessColorBuffer = result.getPixel(x, y);
-            targetProcessColorBuffer[0] = coverage;
+            inkCoverage += sourcePixel[i];
         }
+        *targetPixel = inkCoverage;
     }
 
     return result;
@@ -230,16 +795,19 @@ PDFFloatBitmap PDFFloatBitmap::extractProcessColors() const
     PDFPixelFormat format = PDFPixelFormat::createFormat(m_format.getProcessColorChannelCount(), 0, false, m_format.hasProcessColorsSubtractive(), false);
     PDFFloatBitmap result(getWidth(), getHeight(), format);
 
-    for (size_t x = 0; x < getWidth(); ++x)
+    const size_t processColorCount = result.getPixelSize();
+    Q_ASSERT(m_pixelSize >= processColorCount);
+
+    if (processColorCount == m_pixelSize)
     {
-        for (size_t y = 0; y < getHeight(); ++y)
-        {
-            PDFConstColorBuffer sourceProcessColorBuffer = getPixel(x, y);
-            PDFColorBuffer targetProcessColorBuffer = result.getPixel(x, y);
+        std::copy(begin(), end(), result.begin());
+        return result;
+    }
 
-            Q_ASSERT(sourceProcessColorBuffer.size() >= targetProcessColorBuffer.size());
-            std::copy(sourceProcessColorBuffer.cbegin(), std::next(sourceProcessColorBuffer.cbegin(), targetProcessColorBuffer.size()), targetProcessColorBuffer.begin());
-        }
+    PDFColorComponent* targetPixel = result.begin();
+    for (const PDFColorComponent* sourcePixel = begin(); sourcePixel != end(); sourcePixel += m_pixelSize, targetPixel += processColorCount)
+    {
+        std::copy(sourcePixel, sourcePixel + processColorCount, targetPixel);
     }
 
     return result;
@@ -254,17 +822,7 @@ PDFFloatBitmap PDFFloatBitmap::extractSpotChannel(uint8_t channel) const
     Q_ASSERT(m_format.getSpotColorChannelIndexStart() <= channel);
     Q_ASSERT(m_format.getSpotColorChannelIndexEnd() > channel);
 
-    for (size_t x = 0; x < getWidth(); ++x)
-    {
-        for (size_t y = 0; y < getHeight(); ++y)
-        {
-            PDFConstColorBuffer sourceProcessColorBuffer = getPixel(x, y);
-            PDFColorBuffer targetProcessColorBuffer = result.getPixel(x, y);
-
-            targetProcessColorBuffer[0] = sourceProcessColorBuffer[channel];
-        }
-    }
-
+    PDFFloatBitmapRowKernels::gatherChannel(begin(), m_pixelSize, channel, result.begin(), getWidth() * getHeight());
     return result;
 }
 
@@ -274,17 +832,7 @@ PDFFloatBitmap PDFFloatBitmap::extractOpacityChannel() const
 
     if (m_format.hasOpacityChannel())
     {
-        const uint8_t opacityChannel = m_format.getOpacityChannelIndex();
-        for (size_t x = 0; x < getWidth(); ++x)
-        {
-            for (size_t y = 0; y < getHeight(); ++y)
-            {
-                PDFConstColorBuffer sourceProcessColorBuffer = getPixel(x, y);
-                PDFColorBuffer targetProcessColorBuffer = result.getPixel(x, y);
-
-                targetProcessColorBuffer[0] = sourceProcessColorBuffer[opacityChannel];
-            }
-        }
+        PDFFloatBitmapRowKernels::gatherChannel(begin(), m_pixelSize, m_format.getOpacityChannelIndex(), result.begin(), getWidth() * getHeight());
     }
     else
     {
@@ -387,14 +935,31 @@ void PDFFloatBitmap::copyChannel(const PDFFloatBitmap& sourceBitmap, uint8_t cha
     Q_ASSERT(getWidth() == sourceBitmap.getWidth());
     Q_ASSERT(getHeight() == sourceBitmap.getHeight());
 
-    for (size_t x = 0; x < getWidth(); ++x)
+    PDFColorComponent* targetPixel = begin();
+    for (const PDFColorComponent* sourcePixel = sourceBitmap.begin(); sourcePixel != sourceBitmap.end(); sourcePixel += sourceBitmap.getPixelSize(), targetPixel += m_pixelSize)
     {
-        for (size_t y = 0; y < getHeight(); ++y)
-        {
-            PDFConstColorBuffer sourceProcessColorBuffer = sourceBitmap.getPixel(x, y);
-            PDFColorBuffer targetProcessColorBuffer = getPixel(x, y);
+        targetPixel[channelTo] = sourcePixel[channelFrom];
+    }
+}
+
+void PDFFloatBitmap::copyBitmap(const PDFFloatBitmap& sourceBitmap, QPoint position)
+{
+    Q_ASSERT(getPixelFormat() == sourceBitmap.getPixelFormat());
+    Q_ASSERT(position.x() >= 0 && position.y() >= 0);
+    Q_ASSERT(size_t(position.x()) + sourceBitmap.getWidth() <= getWidth());
+    Q_ASSERT(size_t(position.y()) + sourceBitmap.getHeight() <= getHeight());
 
-            targetProcessColorBuffer[channelTo] = sourceProcessColorBuffer[channelFrom];
+    const size_t rowLength = sourceBitmap.getWidth() * m_pixelSize;
+    for (size_t y = 0; y < sourceBitmap.getHeight(); ++y)
+    {
+        const PDFColorComponent* sourceRow = sourceBitmap.begin() + sourceBitmap.getPixelIndex(0, y);
+        std::copy(sourceRow, sourceRow + rowLength, begin() + getPixelIndex(position.x(), position.y() + y));
+
+        if (hasActiveColorMask() && sourceBitmap.hasActiveColorMask())
+        {
+            auto sourceMaskRow = std::next(sourceBitmap.m_activeColorMask.cbegin(), y * sourceBitmap.getWidth());
+            auto targetMaskRow = std::next(m_activeColorMask.begin(), (position.y() + y) * m_width + position.x());
+            std::copy(sourceMaskRow, std::next(sourceMaskRow, sourceBitmap.getWidth()), targetMaskRow);
         }
     }
 }
@@ -511,6 +1076,7 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
                            const PDFFloatBitmap& backdrop,
                            const PDFFloatBitmap& initialBackdrop,
                            const PDFFloatBitmap& blendSoftMask,
+                           bool isSoftMaskOpaque,
                            bool alphaIsShape,
                            PDFColorComponent constantAlpha,
                            BlendMode mode,
@@ -539,7 +1105,6 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
     const uint8_t processColorChannelEnd = pixelFormat.getProcessColorChannelIndexEnd();
     const uint8_t spotColorChannelStart = pixelFormat.getSpotColorChannelIndexStart();
     const uint8_t spotColorChannelEnd = pixelFormat.getSpotColorChannelIndexEnd();
-    std::vector<PDFColorComponent> B_i(source.getPixelSize(), 0.0f);
     std::vector<BlendMode> channelBlendModes(source.getPixelSize(), mode);
 
     // For blending spot colors, only white preserving blend modes are possible.
@@ -629,209 +1194,138 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
         return channelBlendModes[channel];
     };
 
-    for (int x = blendRegion.left(); x <= blendRegion.right(); ++x)
-    {
-        for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
+    // Blend mode of the channel depends on the pixel only, if overprinting
+    // is used and source has active color mask. Otherwise, we can blend
+    // whole row of the channel using the same blend mode.
+    const bool isBlendModeSameForRow = overprintMode == OverprintMode::NoOveprint || !source.hasActiveColorMask();
+    const bool isNonseparableProcessColorBlending = !PDFBlendModeInfo::isSeparable(mode) && pixelFormat.hasProcessColors();
+
+    // Row is processed in planar layout, i.e. each channel is processed
+    // separately for all pixels in the row.
+    const size_t pixelSize = pixelFormat.getChannelCount();
+    const size_t rowLength = blendRegion.width();
+    const uint8_t processColorChannelCount = pixelFormat.getProcessColorChannelCount();
+    PDFFloatBitmapRowKernels::CompositingWeights weights(rowLength);
+    std::vector<PDFColorComponent> f_g(rowLength, 0.0f);
+    std::vector<PDFColorComponent> alpha_g(rowLength, 0.0f);
+    std::vector<PDFColorComponent> C_b(rowLength, 0.0f);
+    std::vector<PDFColorComponent> C_s(rowLength, 0.0f);
+    std::vector<PDFColorComponent> C_i(rowLength, 0.0f);
+    std::vector<PDFColorComponent> B(rowLength, 0.0f);
+    std::vector<PDFColorComponent> C_b_inverted(rowLength, 0.0f);
+    std::vector<PDFColorComponent> C_s_inverted(rowLength, 0.0f);
+    std::vector<PDFColorComponent> B_nonseparable(isNonseparableProcessColorBlending ? processColorChannelCount * rowLength : 0, 0.0f);
+
+    // Kernels are selected once for the whole blend region. If process color
+    // count is not supported, blended buffer remains unchanged (zero).
+    const auto computeWeights = PDFFloatBitmapCompositingKernels::getComputeWeightsFunction(alphaIsShape, knockoutGroup, isSoftMaskOpaque);
+    const auto blendNonseparable = isNonseparableProcessColorBlending ? PDFFloatBitmapCompositingKernels::getBlendNonseparableFunction(mode, processColorChannelCount) : nullptr;
+    Q_ASSERT(!isNonseparableProcessColorBlending || blendNonseparable);
+
+    PDFFloatBitmapCompositingKernels::WeightsRow weightsRow;
+    weightsRow.pixelSize = pixelSize;
+    weightsRow.shapeChannel = shapeChannel;
+    weightsRow.opacityChannel = opacityChannel;
+    weightsRow.constantAlpha = constantAlpha;
+    weightsRow.count = rowLength;
+
+    for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
+    {
+        const size_t left = blendRegion.left();
+        const PDFColorComponent* sourceRow = source.begin() + source.getPixelIndex(left, y);
+        PDFColorComponent* targetRow = target.begin() + target.getPixelIndex(left, y);
+        const PDFColorComponent* backdropRow = backdrop.begin() + backdrop.getPixelIndex(left, y);
+        const PDFColorComponent* initialBackdropRow = initialBackdrop.begin() + initialBackdrop.getPixelIndex(left, y);
+        const PDFColorComponent* softMaskRow = blendSoftMask.begin() + blendSoftMask.getPixelIndex(left, y);
+
+        // Calculate shape and opacity, and weights of the colors in compositing formula
+        weightsRow.sourceRow = sourceRow;
+        weightsRow.targetRow = targetRow;
+        weightsRow.initialBackdropRow = initialBackdropRow;
+        weightsRow.softMaskRow = softMaskRow;
+        computeWeights(weightsRow, f_g.data(), alpha_g.data(), weights);
+
+        if (target.hasActiveColorMask())
         {
-            PDFConstColorBuffer sourceColor = source.getPixel(x, y);
-            PDFColorBuffer targetColor = target.getPixel(x, y);
-            PDFConstColorBuffer backdropColor = backdrop.getPixel(x, y);
-            PDFConstColorBuffer initialBackdropColor = initialBackdrop.getPixel(x, y);
-            PDFConstColorBuffer alphaColorBuffer = blendSoftMask.getPixel(x, y);
-
-            const PDFColorComponent softMaskValue = alphaColorBuffer[0];
-            const PDFColorComponent f_j_i = sourceColor[shapeChannel];
-            const PDFColorComponent f_m_i = alphaIsShape ? softMaskValue : 1.0f;
-            const PDFColorComponent f_k_i = alphaIsShape ? constantAlpha : 1.0f;
-            const PDFColorComponent q_m_i = !alphaIsShape ? softMaskValue : 1.0f;
-            const PDFColorComponent q_k_i = !alphaIsShape ? constantAlpha : 1.0f;
-            const PDFColorComponent f_s_i = f_j_i * f_m_i * f_k_i;
-            const PDFColorComponent alpha_j_i = sourceColor[opacityChannel];
-            const PDFColorComponent alpha_s_i = alpha_j_i * (f_m_i * q_m_i) * (f_k_i * q_k_i);
-
-            // Old alpha (alpha_g_i_1) is stored in target (immediate) buffer
-            const PDFColorComponent alpha_g_i_1 = targetColor[opacityChannel];
-
-            // alpha_g_0 == 0.0f according to the specification, otherwise select alpha_g_i_1 from target color
-            const PDFColorComponent alpha_g_b = knockoutGroup ? 0.0f : alpha_g_i_1;
-
-            // alpha_0 is taken from initial backdrop color buffer
-            const PDFColorComponent alpha_0 = initialBackdropColor[opacityChannel];
-
-            // f_g_i_1 is stored in target (immediate) buffer
-            const PDFColorComponent f_g_i_1 = targetColor[shapeChannel];
-
-            // Formulas taken from
-            const PDFColorComponent f_g_i = PDFBlendFunction::blend_Union(f_g_i_1, f_s_i);
-            const PDFColorComponent alpha_g_i = (1.0f - f_s_i) * alpha_g_i_1 + (f_s_i - alpha_s_i) * alpha_g_b + alpha_s_i;
-            const PDFColorComponent alpha_i_1 = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i_1);
-            const PDFColorComponent alpha_i = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i);
-
-            // alpha_b is either alpha_0 (for knockout group) or alpha_i_1
-            const PDFColorComponent alpha_b = knockoutGroup ? alpha_0 : alpha_i_1;
-
-            if (qFuzzyIsNull(alpha_g_i))
-            {
-                // If alpha_i is zero, then color is undefined, just fill shape/opacity
-                targetColor[shapeChannel] = f_g_i;
-                targetColor[opacityChannel] = alpha_g_i;
-                continue;
-            }
-
-            if (target.hasActiveColorMask())
+            for (size_t i = 0; i < rowLength; ++i)
             {
-                const uint32_t activeColorChannels = source.hasActiveColorMask() ? source.getPixelActiveColorMask(x, y) : PDFPixelFormat::getAllColorsMask();
-                target.markPixelActiveColorMask(x, y, activeColorChannels);
+                if (!qFuzzyIsNull(alpha_g[i]))
+                {
+                    const uint32_t activeColorChannels = source.hasActiveColorMask() ? source.getPixelActiveColorMask(left + i, y) : PDFPixelFormat::getAllColorsMask();
+                    target.markPixelActiveColorMask(left + i, y, activeColorChannels);
+                }
             }
+        }
 
-            std::fill(B_i.begin(), B_i.end(), 0.0f);
-
-            // Calculate blended pixel
-            if (PDFBlendModeInfo::isSeparable(mode))
-            {
-                // Separable blend mode - process each color separately
-                const bool isProcessColorSubtractive = pixelFormat.hasProcessColorsSubtractive();
-                const bool isSpotColorSubtractive = pixelFormat.hasSpotColorsSubtractive();
+        // Nonseparable blend mode - process colors are blended together
+        if (blendNonseparable)
+        {
+            blendNonseparable(backdropRow, sourceRow, pixelSize, processColorChannelStart, B_nonseparable.data(), rowLength);
+        }
 
-                if (pixelFormat.hasProcessColors())
-                {
-                    if (!isProcessColorSubtractive)
-                    {
-                        for (uint8_t i = processColorChannelStart; i < processColorChannelEnd; ++i)
-                        {
-                            const BlendMode pixelBlendMode = getBlendModeForPixel(x, y, i);
-                            B_i[i] = PDFBlendFunction::blend(pixelBlendMode, backdropColor[i], sourceColor[i]);
-                        }
-                    }
-                    else
-                    {
-                        for (uint8_t i = processColorChannelStart; i < processColorChannelEnd; ++i)
-                        {
-                            const BlendMode pixelBlendMode = getBlendModeForPixel(x, y, i);
-                            B_i[i] = 1.0f - PDFBlendFunction::blend(pixelBlendMode, 1.0f - backdropColor[i], 1.0f - sourceColor[i]);
-                        }
-                    }
-                }
+        // Blend and composite colors, one channel at a time
+        for (uint8_t channel = colorChannelStart; channel < colorChannelEnd; ++channel)
+        {
+            PDFFloatBitmapRowKernels::gatherChannel(backdropRow, pixelSize, channel, C_b.data(), rowLength);
+            PDFFloatBitmapRowKernels::gatherChannel(sourceRow, pixelSize, channel, C_s.data(), rowLength);
+            PDFFloatBitmapRowKernels::gatherChannel(targetRow, pixelSize, channel, C_i.data(), rowLength);
 
-                if (pixelFormat.hasSpotColors())
-                {
+            const bool isProcessColorChannel = channel >= processColorChannelStart && channel < processColorChannelEnd;
+            const bool isSpotColorChannel = channel >= spotColorChannelStart && channel < spotColorChannelEnd;
 
-                    if (!isSpotColorSubtractive)
-                    {
-                        for (uint8_t i = spotColorChannelStart; i < spotColorChannelEnd; ++i)
-                        {
-                            const BlendMode pixelBlendMode = getBlendModeForPixel(x, y, i);
-                            B_i[i] = PDFBlendFunction::blend(pixelBlendMode, backdropColor[i], sourceColor[i]);
-                        }
-                    }
-                    else
-                    {
-                        for (uint8_t i = spotColorChannelStart; i < spotColorChannelEnd; ++i)
-                        {
-                            const BlendMode pixelBlendMode = getBlendModeForPixel(x, y, i);
-                            B_i[i] = 1.0f - PDFBlendFunction::blend(pixelBlendMode, 1.0f - backdropColor[i], 1.0f - sourceColor[i]);
-                        }
-                    }
-                }
+            if (isProcessColorChannel && isNonseparableProcessColorBlending)
+            {
+                const auto it = std::next(B_nonseparable.cbegin(), (channel - processColorChannelStart) * rowLength);
+                std::copy(it, std::next(it, rowLength), B.begin());
             }
-            else
+            else if (isProcessColorChannel || isSpotColorChannel)
             {
-                // Nonseparable blend mode - process colors together
-                if (pixelFormat.hasProcessColors())
-                {
-                    switch (pixelFormat.getProcessColorChannelCount())
-                    {
-                        case 1:
-                        {
-                            // Gray
-                            const PDFGray Cb = backdropColor[processColorChannelStart];
-                            const PDFGray Cs = sourceColor[processColorChannelStart];
-                            const PDFGray blended = PDFBlendFunction::blend_Nonseparable(mode, Cb, Cs);
-                            B_i[pixelFormat.getProcessColorChannelIndexStart()] = blended;
-                            break;
-                        }
-
-                        case 3:
-                        {
-                            // RGB
-                            const PDFRGB Cb = { backdropColor[processColorChannelStart + 0],
-                                                backdropColor[processColorChannelStart + 1],
-                                                backdropColor[processColorChannelStart + 2] };
-                            const PDFRGB Cs = { sourceColor[processColorChannelStart + 0],
-                                                sourceColor[processColorChannelStart + 1],
-                                                sourceColor[processColorChannelStart + 2] };
-                            const PDFRGB blended = PDFBlendFunction::blend_Nonseparable(mode, Cb, Cs);
-                            B_i[processColorChannelStart + 0] = blended[0];
-                            B_i[processColorChannelStart + 1] = blended[1];
-                            B_i[processColorChannelStart + 2] = blended[2];
-                            break;
-                        }
+                const bool isSubtractive = isProcessColorChannel ? pixelFormat.hasProcessColorsSubtractive() : pixelFormat.hasSpotColorsSubtractive();
 
-                        case 4:
-                        {
-                            // CMYK
-                            const PDFCMYK Cb = { backdropColor[processColorChannelStart + 0],
-                                                 backdropColor[processColorChannelStart + 1],
-                                                 backdropColor[processColorChannelStart + 2],
-                                                 backdropColor[processColorChannelStart + 3] };
-                            const PDFCMYK Cs = { sourceColor[processColorChannelStart + 0],
-                                                 sourceColor[processColorChannelStart + 1],
-                                                 sourceColor[processColorChannelStart + 2],
-                                                 sourceColor[processColorChannelStart + 3] };
-                            const PDFCMYK blended = PDFBlendFunction::blend_Nonseparable(mode, Cb, Cs);
-                            B_i[processColorChannelStart + 0] = blended[0];
-                            B_i[processColorChannelStart + 1] = blended[1];
-                            B_i[processColorChannelStart + 2] = blended[2];
-                            B_i[processColorChannelStart + 3] = blended[3];
-                            break;
-                        }
+                if (isBlendModeSameForRow)
+                {
+                    const BlendMode channelBlendMode = getBlendModeForPixel(left, y, channel);
 
-                        default:
-                        {
-                            // This is a serious error. Blended buffer remains unchanged (zero)
-                            Q_ASSERT(false);
-                            break;
-                        }
+                    if (!isSubtractive)
+                    {
+                        PDFBlendFunction::blendRow(channelBlendMode, C_b.data(), C_s.data(), B.data(), rowLength);
+                    }
+                    else
+                    {
+                        PDFFloatBitmapRowKernels::invert(C_b.data(), C_b_inverted.data(), rowLength);
+                        PDFFloatBitmapRowKernels::invert(C_s.data(), C_s_inverted.data(), rowLength);
+                        PDFBlendFunction::blendRow(channelBlendMode, C_b_inverted.data(), C_s_inverted.data(), B.data(), rowLength);
+                        PDFFloatBitmapRowKernels::invert(B.data(), B.data(), rowLength);
                     }
                 }
-
-                if (pixelFormat.hasSpotColors())
+                else
                 {
-                    const bool isSpotColorSubtractive = pixelFormat.hasSpotColorsSubtractive();
-                    if (!isSpotColorSubtractive)
+                    for (size_t i = 0; i < rowLength; ++i)
                     {
-                        for (uint8_t i = spotColorChannelStart; i < spotColorChannelEnd; ++i)
+                        const BlendMode pixelBlendMode = getBlendModeForPixel(left + i, y, channel);
+
+                        if (!isSubtractive)
                         {
-                            const BlendMode pixelBlendMode = getBlendModeForPixel(x, y, i);
-                            B_i[i] = PDFBlendFunction::blend(pixelBlendMode, backdropColor[i], sourceColor[i]);
+                            B[i] = PDFBlendFunction::blend(pixelBlendMode, C_b[i], C_s[i]);
                         }
-                    }
-                    else
-                    {
-                        for (uint8_t i = spotColorChannelStart; i < spotColorChannelEnd; ++i)
+                        else
                         {
-                            const BlendMode pixelBlendMode = getBlendModeForPixel(x, y, i);
-                            B_i[i] = 1.0f - PDFBlendFunction::blend(pixelBlendMode, 1.0f - backdropColor[i], 1.0f - sourceColor[i]);
+                            B[i] = 1.0f - PDFBlendFunction::blend(pixelBlendMode, 1.0f - C_b[i], 1.0f - C_s[i]);
                         }
                     }
                 }
             }
-
-            for (uint8_t i = colorChannelStart; i < colorChannelEnd; ++i)
+            else
             {
-                const PDFColorComponent C_s_i = sourceColor[i];
-                const PDFColorComponent C_b = backdropColor[i];
-                const PDFColorComponent C_i_1 = targetColor[i];
-
-                PDFColorComponent C_t = (f_s_i - alpha_s_i) * alpha_b * C_b + alpha_s_i * ((1.0f - alpha_b) * C_s_i + alpha_b * B_i[i]);
-                PDFColorComponent C_i = ((1.0f - f_s_i) * alpha_i_1 * C_i_1 + C_t) / alpha_i;
-
-                targetColor[i] = C_i;
+                std::fill(B.begin(), B.end(), 0.0f);
             }
 
-            targetColor[shapeChannel] = f_g_i;
-            targetColor[opacityChannel] = alpha_g_i;
+            PDFFloatBitmapRowKernels::composite(weights, C_b.data(), C_s.data(), B.data(), C_i.data(), rowLength);
+            PDFFloatBitmapRowKernels::scatterChannel(C_i.data(), pixelSize, channel, targetRow, rowLength);
         }
+
+        PDFFloatBitmapRowKernels::scatterChannel(f_g.data(), pixelSize, shapeChannel, targetRow, rowLength);
+        PDFFloatBitmapRowKernels::scatterChannel(alpha_g.data(), pixelSize, opacityChannel, targetRow, rowLength);
     }
 }
 
@@ -927,6 +1421,48 @@ void PDFFloatBitmapWithColorSpace::setColorSpace(const PDFColorSpacePointer& col
     m_colorSpace = colorSpace;
 }
 
+PDFPackedFloatBitmap PDFPackedFloatBitmap::pack(const PDFFloatBitmap& bitmap)
+{
+    PDFPackedFloatBitmap result;
+    result.m_format = bitmap.m_format;
+    result.m_width = bitmap.m_width;
+    result.m_height = bitmap.m_height;
+    result.m_data.resize(bitmap.m_data.size());
+    result.m_activeColorMask = bitmap.m_activeColorMask;
+
+    // Bitmap is converted by rows, so large bitmaps can be converted in parallel
+    const size_t rowSize = bitmap.m_width * bitmap.m_pixelSize;
+    auto packRow = [&](size_t y)
+    {
+        const size_t offset = y * rowSize;
+        PDFFloatBitmapRowKernels::packUNorm16(bitmap.m_data.data() + offset, result.m_data.data() + offset, rowSize);
+    };
+
+    PDFIntegerRange<size_t> rows(0, rowSize > 0 ? bitmap.m_height : 0);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, rows.begin(), rows.end(), packRow);
+    return result;
+}
+
+void PDFPackedFloatBitmap::unpack(PDFFloatBitmap& bitmap) const
+{
+    bitmap.m_format = m_format;
+    bitmap.m_width = m_width;
+    bitmap.m_height = m_height;
+    bitmap.m_pixelSize = m_format.getChannelCount();
+    bitmap.m_data.resize(m_data.size());
+    bitmap.m_activeColorMask = m_activeColorMask;
+
+    const size_t rowSize = m_width * bitmap.m_pixelSize;
+    auto unpackRow = [&](size_t y)
+    {
+        const size_t offset = y * rowSize;
+        PDFFloatBitmapRowKernels::unpackUNorm16(m_data.data() + offset, bitmap.m_data.data() + offset, rowSize);
+    };
+
+    PDFIntegerRange<size_t> rows(0, rowSize > 0 ? m_height : 0);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, rows.begin(), rows.end(), unpackRow);
+}
+
 void PDFFloatBitmapWithColorSpace::convertToColorSpace(const PDFCMS* cms,
                                                        RenderingIntent intent,
                                                        const PDFColorSpacePointer& targetColorSpace,
@@ -952,9 +1488,9 @@ void PDFFloatBitmapWithColorSpace::convertToColorSpace(const PDFCMS* cms,
     }
 
     PDFFloatBitmapWithColorSpace temporary(getWidth(), getHeight(), newFormat, targetColorSpace);
-    for (size_t x = 0; x < getWidth(); ++x)
+    for (size_t y = 0; y < getHeight(); ++y)
     {
-        for (size_t y = 0; y < getHeight(); ++y)
+        for (size_t x = 0; x < getWidth(); ++x)
         {
             PDFColorBuffer sourceProcessColorBuffer = targetProcessColors.getPixel(x, y);
             PDFColorBuffer sourceSpotColorAndOpacityBuffer = getPixel(x, y);
@@ -1025,6 +1561,7 @@ void PDFTransparencyRenderer::beginPaint(QSize pixelSize)
     Q_ASSERT(m_processColorSpace);
 
     m_originalProcessBitmap = PDFFloatBitmapWithColorSpace();
+    m_packedOriginalProcessBitmap = PDFPackedFloatBitmap();
     m_transparencyGroupDataStack.clear();
     m_painterStateStack.push(PDFTransparencyPainterState());
 
@@ -1151,6 +1688,18 @@ QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace&
     return image;
 }
 
+PDFFloatBitmapWithColorSpace PDFTransparencyRenderer::getOriginalProcessBitmap() const
+{
+    PDFFloatBitmapWithColorSpace bitmap = m_originalProcessBitmap;
+
+    if (!m_packedOriginalProcessBitmap.isEmpty())
+    {
+        m_packedOriginalProcessBitmap.unpack(bitmap);
+    }
+
+    return bitmap;
+}
+
 QImage PDFTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const
 {
     QImage image;
@@ -1173,7 +1722,7 @@ QImage PDFTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFR
         createOpaqueSoftMask(imageSoftMask, paperImage.getWidth(), paperImage.getHeight());
 
         QRect blendRegion(0, 0, int(floatImage.getWidth()), int(floatImage.getHeight()));
-        PDFFloatBitmapWithColorSpace::blend(floatImage, paperImage, paperImage, paperImage, imageSoftMask, false, 1.0f, BlendMode::Normal, false, PDFFloatBitmap::OverprintMode::NoOveprint, blendRegion);
+        PDFFloatBitmapWithColorSpace::blend(floatImage, paperImage, paperImage, paperImage, imageSoftMask, true, false, 1.0f, BlendMode::Normal, false, PDFFloatBitmap::OverprintMode::NoOveprint, blendRegion);
 
         return toImageImpl(paperImage, use16Bit);
     }
@@ -1181,6 +1730,63 @@ QImage PDFTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFR
     return image;
 }
 
+QByteArray PDFTransparencyRenderer::toSamples(int bitsPerSample) const
+{
+    QByteArray samples;
+
+    if (m_transparencyGroupDataStack.size() != 1 || (bitsPerSample != 8 && bitsPerSample != 16))
+    {
+        // Painting is not finished, or invalid number of bits
+        return samples;
+    }
+
+    const PDFFloatBitmapWithColorSpace& floatImage = *getImmediateBackdrop();
+    const PDFPixelFormat pixelFormat = floatImage.getPixelFormat();
+    Q_ASSERT(pixelFormat.hasOpacityChannel());
+
+    const size_t width = floatImage.getWidth();
+    const size_t height = floatImage.getHeight();
+    const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
+    const uint8_t processColorChannelCount = pixelFormat.getProcessColorChannelCount();
+    const uint8_t opacityChannel = pixelFormat.getOpacityChannelIndex();
+    const bool isProcessColorSubtractive = pixelFormat.hasProcessColorsSubtractive();
+    const size_t bytesPerSample = bitsPerSample / 8;
+    const float scale = bitsPerSample == 16 ? std::numeric_limits<quint16>::max() : std::numeric_limits<quint8>::max();
+
+    samples.resize(width * height * colorChannelCount * bytesPerSample);
+    uchar* data = reinterpret_cast<uchar*>(samples.data());
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            PDFConstColorBuffer colorBuffer = floatImage.getPixel(x, y);
+            const PDFColorComponent opacity = colorBuffer[opacityChannel];
+
+            for (uint8_t channel = 0; channel < colorChannelCount; ++channel)
+            {
+                // White paper has no ink, spot colors are always subtractive
+                const bool isSubtractive = channel >= processColorChannelCount || isProcessColorSubtractive;
+                const PDFColorComponent paper = isSubtractive ? 0.0f : 1.0f;
+                const PDFColorComponent value = qBound(0.0f, colorBuffer[channel] * opacity + paper * (1.0f - opacity), 1.0f);
+                const quint16 sample = quint16(value * scale + 0.5f);
+
+                if (bytesPerSample == 2)
+                {
+                    qToLittleEndian<quint16>(sample, data);
+                }
+                else
+                {
+                    *data = uchar(sample);
+                }
+                data += bytesPerSample;
+            }
+        }
+    }
+
+    return samples;
+}
+
 void PDFTransparencyRenderer::clearColor(const PDFColor& color)
 {
     PDFFloatBitmapWithColorSpace* backdrop = getImmediateBackdrop();
@@ -1430,7 +2036,15 @@ PDFFloatBitmapWithColorSpace PDFTransparencyRenderer::getImage(const PDFImage& s
 
             bitmap = PDFFloatBitmapWithColorSpace(imageData.getWidth(), imageData.getHeight(), m_drawBuffer.getPixelFormat(), getBlendColorSpace());
             const bool flip01 = !imageData.getDecode().empty() && qFuzzyCompare(imageData.getDecode().front(), 1.0);
-            PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
+
+            // Rows of the mask are read directly from the data, so we check the size of the data first
+            const QByteArray& data = imageData.getData();
+            const qsizetype stride = imageData.getStride();
+            const qsizetype rowSize = (qsizetype(imageData.getWidth()) + 7) / 8;
+            if (data.size() < stride * (qsizetype(imageData.getHeight()) - 1) + rowSize)
+            {
+                throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Not enough data to read %1-bit value.").arg(1));
+            }
 
             PDFPixelFormat pixelFormat = bitmap.getPixelFormat();
             const PDFMappedColor& fillColor = getMappedFillColor();
@@ -1451,13 +2065,13 @@ PDFFloatBitmapWithColorSpace PDFTransparencyRenderer::getImage(const PDFImage& s
 
             for (unsigned int i = 0, rowCount = imageData.getHeight(); i < rowCount; ++i)
             {
-                reader.seek(i * imageData.getStride());
+                const uchar* row = reinterpret_cast<const uchar*>(data.constData()) + i * stride;
 
                 for (unsigned int j = 0, colCount = imageData.getWidth(); j < colCount; ++j)
                 {
                     PDFColorBuffer buffer = bitmap.getPixel(j, i);
 
-                    const bool transparent = flip01 != static_cast<bool>(reader.read());
+                    const bool transparent = flip01 != static_cast<bool>((row[j >> 3] >> (7 - (j & 7))) & 1);
 
                     if (alphaIsShape)
                     {
@@ -2003,6 +2617,32 @@ void PDFTransparencyRenderer::processSoftMask(const PDFDictionary* softMask)
     }
     else
     {
+        // Soft mask is painted using current transformation matrix, so same soft mask
+        // used with the same matrix (for example, by many objects) is rendered only once.
+        const QTransform softMaskMatrix = getGraphicState()->getCurrentTransformationMatrix();
+        if (isTransparencyCacheEnabled())
+        {
+            auto it = std::find_if(m_softMaskCache.cbegin(), m_softMaskCache.cend(), [softMask, &softMaskMatrix](const PDFCachedSoftMask& item)
+            {
+                return item.softMask == softMask && item.matrix == softMaskMatrix;
+            });
+
+            if (it != m_softMaskCache.cend())
+            {
+                if (!it->packedResult.isEmpty())
+                {
+                    PDFFloatBitmap cachedSoftMask;
+                    it->packedResult.unpack(cachedSoftMask);
+                    getPainterState()->softMask = PDFTransparencySoftMask(false, qMove(cachedSoftMask));
+                }
+                else
+                {
+                    getPainterState()->softMask = it->result;
+                }
+                return;
+            }
+        }
+
         PDFSoftMaskDefinition softMaskDefinition = PDFSoftMaskDefinition::parse(softMask, this);
 
         if (!softMaskDefinition.getFormStream())
@@ -2084,8 +2724,51 @@ void PDFTransparencyRenderer::processSoftMask(const PDFDictionary* softMask)
             }
         }
 
-        getPainterState()->softMask = PDFTransparencySoftMask(false, qMove(createdSoftMask));
+        if (isTransparencyCacheEnabled() && reserveTransparencyCache(createdSoftMask))
+        {
+            PDFCachedSoftMask cachedSoftMask;
+            cachedSoftMask.softMask = softMask;
+            cachedSoftMask.matrix = softMaskMatrix;
+
+            if (isReducedPrecisionStorageEnabled())
+            {
+                cachedSoftMask.packedResult = PDFPackedFloatBitmap::pack(createdSoftMask);
+                getPainterState()->softMask = PDFTransparencySoftMask(false, qMove(createdSoftMask));
+            }
+            else
+            {
+                cachedSoftMask.result = PDFTransparencySoftMask(false, qMove(createdSoftMask));
+                getPainterState()->softMask = cachedSoftMask.result;
+            }
+
+            m_softMaskCache.emplace_back(qMove(cachedSoftMask));
+        }
+        else
+        {
+            getPainterState()->softMask = PDFTransparencySoftMask(false, qMove(createdSoftMask));
+        }
+    }
+}
+
+bool PDFTransparencyRenderer::reserveTransparencyCache(const PDFFloatBitmap& bitmap)
+{
+    const size_t componentSize = isReducedPrecisionStorageEnabled() ? sizeof(uint16_t) : sizeof(PDFColorComponent);
+    const qint64 size = qint64(bitmap.getWidth() * bitmap.getHeight() * bitmap.getPixelSize() * componentSize);
+    const qint64 limit = qint64(m_settings.transparencyCacheSize) * 1024 * 1024;
+
+    if (m_transparencyCacheSize + size > limit)
+    {
+        // Cache is full, item will not be cached
+        return false;
     }
+
+    m_transparencyCacheSize += size;
+    return true;
+}
+
+bool PDFTransparencyRenderer::isTransparencyGroupContentSkipped() const
+{
+    return !m_transparencyGroupDataStack.empty() && m_transparencyGroupDataStack.back().cachedGroupIndex >= 0;
 }
 
 void PDFTransparencyRenderer::createOpaqueBitmap(PDFFloatBitmap& bitmap)
@@ -2294,46 +2977,33 @@ bool PDFTransparencyRenderer::performPathPaintingUsingShading(const QPainterPath
     uint8_t textureShapeChannel = texturePixelFormat.getShapeChannelIndex();
     uint8_t textureOpacityChannel = texturePixelFormat.getOpacityChannelIndex();
 
-    if (fillRect.width() > fillRect.height())
-    {
-        // Columns
-        PDFIntegerRange<int> range(fillRect.left(), fillRect.right() + 1);
-        auto processEntry = [&, this](int x)
-        {
-            for (int y = fillRect.top(); y <= fillRect.bottom(); ++y)
-            {
-                const int texelCoordinateX = x - fillRect.left();
-                const int texelCoordinateY = y - fillRect.top();
+    // Texture is sampled by row segments, so the sampler can step along the row
+    // incrementally and evaluate the shading functions in batch. Both wide and tall areas
+    // are split into enough segments to be processed in parallel.
+    constexpr int SEGMENT_SIZE = 256;
+    const int segmentsPerRow = (fillRect.width() + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+    const size_t texturePixelSize = texture.getPixelSize();
 
-                PDFColorBuffer buffer = texture.getPixel(texelCoordinateX, texelCoordinateY);
-                bool isSampled = sampler->sample(QPointF(x, y) + offset, buffer.resized(shadingColorComponentCount), m_settings.shadingAlgorithmLimit);
-                const PDFColorComponent textureSampleShape = isSampled ? 1.0f : 0.0f;
-                buffer[textureShapeChannel] = textureSampleShape;
-                buffer[textureOpacityChannel] = textureSampleShape;
-            }
-        };
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), processEntry);
-    }
-    else
+    PDFIntegerRange<int> range(0, fillRect.height() * segmentsPerRow);
+    auto processEntry = [&, this](int index)
     {
-        // Rows
-        PDFIntegerRange<int> range(fillRect.top(), fillRect.bottom() + 1);
-        auto processEntry = [&, this](int y)
-        {
-            for (int x = fillRect.left(); x <= fillRect.right(); ++x)
-            {
-                const int texelCoordinateX = x - fillRect.left();
-                const int texelCoordinateY = y - fillRect.top();
+        const int texelCoordinateY = index / segmentsPerRow;
+        const int texelCoordinateXStart = (index % segmentsPerRow) * SEGMENT_SIZE;
+        const int count = qMin(SEGMENT_SIZE, fillRect.width() - texelCoordinateXStart);
 
-                PDFColorBuffer buffer = texture.getPixel(texelCoordinateX, texelCoordinateY);
-                bool isSampled = sampler->sample(QPointF(x, y) + offset, buffer.resized(shadingColorComponentCount), m_settings.shadingAlgorithmLimit);
-                const PDFColorComponent textureSampleShape = isSampled ? 1.0f : 0.0f;
-                buffer[textureShapeChannel] = textureSampleShape;
-                buffer[textureOpacityChannel] = textureSampleShape;
-            }
-        };
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), processEntry);
-    }
+        std::array<bool, SEGMENT_SIZE> sampled = { };
+        PDFColorBuffer buffer(texture.getPixel(texelCoordinateXStart, texelCoordinateY).begin(), count * texturePixelSize);
+        const QPointF startPoint = QPointF(fillRect.left() + texelCoordinateXStart, fillRect.top() + texelCoordinateY) + offset;
+        sampler->sampleRow(startPoint.x(), startPoint.y(), count, buffer, texturePixelSize, sampled.data(), m_settings.shadingAlgorithmLimit);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const PDFColorComponent textureSampleShape = sampled[i] ? 1.0f : 0.0f;
+            buffer[i * texturePixelSize + textureShapeChannel] = textureSampleShape;
+            buffer[i * texturePixelSize + textureOpacityChannel] = textureSampleShape;
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), processEntry);
 
     // Convert image to a blend color space
     texture = convertImageToBlendSpace(texture);
@@ -2514,6 +3184,26 @@ void PDFTransparencyRenderer::performBeginTransparencyGroup(ProcessOrder order,
         // Prepare soft mask
         data.softMask = getPainterState()->softMask;
 
+        // Result of isolated group form can be taken from the cache
+        if (transparencyGroup.stream && transparencyGroup.isolated && isTransparencyCacheEnabled())
+        {
+            data.cacheKey.stream = transparencyGroup.stream;
+            data.cacheKey.matrix = getGraphicState()->getCurrentTransformationMatrix();
+            data.cacheKey.fillColor = getGraphicState()->getFillColor().rgba();
+            data.cacheKey.strokeColor = getGraphicState()->getStrokeColor().rgba();
+            data.cacheKey.clipPath = getPainterState()->clipPath;
+
+            auto it = std::find_if(m_transparencyGroupCache.cbegin(), m_transparencyGroupCache.cend(), [&data](const PDFCachedTransparencyGroup& item) { return item.isSameGroup(data.cacheKey); });
+            if (it != m_transparencyGroupCache.cend())
+            {
+                data.cachedGroupIndex = int(std::distance(m_transparencyGroupCache.cbegin(), it));
+            }
+            else
+            {
+                data.storeToCache = true;
+            }
+        }
+
         data.initialBackdrop.convertToColorSpace(getCMS(), data.renderingIntent, data.blendColorSpace, this);
         data.immediateBackdrop = data.initialBackdrop;
 
@@ -2536,8 +3226,40 @@ void PDFTransparencyRenderer::performEndTransparencyGroup(ProcessOrder order, co
 
     if (order == ProcessOrder::AfterOperation)
     {
-        // "Unblend" the initial backdrop from immediate backdrop, according to 11.4.8
-        removeInitialBackdrop();
+        PDFTransparencyGroupPainterData& groupData = m_transparencyGroupDataStack.back();
+        if (groupData.cachedGroupIndex >= 0)
+        {
+            // Content of the group was not processed, use cached result
+            const PDFCachedTransparencyGroup& cachedGroup = m_transparencyGroupCache[groupData.cachedGroupIndex];
+            groupData.immediateBackdrop = cachedGroup.result;
+
+            if (!cachedGroup.packedResult.isEmpty())
+            {
+                cachedGroup.packedResult.unpack(groupData.immediateBackdrop);
+            }
+        }
+        else
+        {
+            // "Unblend" the initial backdrop from immediate backdrop, according to 11.4.8
+            removeInitialBackdrop();
+
+            if (groupData.storeToCache && !isProcessingCancelled() && reserveTransparencyCache(groupData.immediateBackdrop))
+            {
+                PDFCachedTransparencyGroup cachedGroup = qMove(groupData.cacheKey);
+
+                if (isReducedPrecisionStorageEnabled())
+                {
+                    cachedGroup.result.setColorSpace(groupData.immediateBackdrop.getColorSpace());
+                    cachedGroup.packedResult = PDFPackedFloatBitmap::pack(groupData.immediateBackdrop);
+                }
+                else
+                {
+                    cachedGroup.result = groupData.immediateBackdrop;
+                }
+
+                m_transparencyGroupCache.emplace_back(qMove(cachedGroup));
+            }
+        }
 
         PDFTransparencyGroupPainterData sourceData = qMove(m_transparencyGroupDataStack.back());
         m_transparencyGroupDataStack.pop_back();
@@ -2566,7 +3288,16 @@ void PDFTransparencyRenderer::performEndTransparencyGroup(ProcessOrder order, co
 
         if (sourceData.saveOriginalImage)
         {
-            m_originalProcessBitmap = sourceData.immediateBackdrop;
+            if (isReducedPrecisionStorageEnabled())
+            {
+                m_originalProcessBitmap = PDFFloatBitmapWithColorSpace();
+                m_originalProcessBitmap.setColorSpace(sourceData.immediateBackdrop.getColorSpace());
+                m_packedOriginalProcessBitmap = PDFPackedFloatBitmap::pack(sourceData.immediateBackdrop);
+            }
+            else
+            {
+                m_originalProcessBitmap = sourceData.immediateBackdrop;
+            }
         }
 
         // Collapse spot colors
@@ -2589,7 +3320,7 @@ void PDFTransparencyRenderer::performEndTransparencyGroup(ProcessOrder order, co
         }
 
         PDFFloatBitmap::blend(sourceData.immediateBackdrop, targetData.immediateBackdrop, *getBackdrop(), *getInitialBackdrop(), *sourceData.softMask.getSoftMask(),
-                              sourceData.alphaIsShape, sourceData.alphaFill, sourceData.blendMode, sourceData.group.knockout, selectedOverprintMode, getPaintRect());
+                              sourceData.softMask.isOpaque(), sourceData.alphaIsShape, sourceData.alphaFill, sourceData.blendMode, sourceData.group.knockout, selectedOverprintMode, getPaintRect());
 
         // Create draw buffer
         PDFFloatBitmapWithColorSpace* backdrop = getImmediateBackdrop();
@@ -3027,7 +3758,7 @@ void PDFTransparencyRenderer::flushDrawBuffer()
         }
 
         PDFFloatBitmap::blend(m_drawBuffer, *getImmediateBackdrop(), *getBackdrop(), *getInitialBackdrop(), *getPainterState()->softMask.getSoftMask(),
-                              getGraphicState()->getAlphaIsShape(), 1.0f, getGraphicState()->getBlendMode(), isTransparencyGroupKnockout(),
+                              getPainterState()->softMask.isOpaque(), getGraphicState()->getAlphaIsShape(), 1.0f, getGraphicState()->getBlendMode(), isTransparencyGroupKnockout(),
                               selectedOverprintMode, m_drawBuffer.getModifiedRect());
 
 
@@ -3855,6 +4586,103 @@ void PDFTransparencyRenderer::PDFTransparencySoftMask::makeOpaque()
     }
 }
 
+PDFTransparencyTileRenderer::PDFTransparencyTileRenderer(const PDFPage* page,
+                                                         const PDFDocument* document,
+                                                         const PDFFontCache* fontCache,
+                                                         const PDFCMS* cms,
+                                                         const PDFOptionalContentActivity* optionalContentActivity,
+                                                         const PDFInkMapper* inkMapper,
+                                                         PDFTransparencyRendererSettings settings,
+                                                         QTransform pagePointToDevicePointMatrix) :
+    m_page(page),
+    m_document(document),
+    m_fontCache(fontCache),
+    m_cms(cms),
+    m_optionalContentActivity(optionalContentActivity),
+    m_inkMapper(inkMapper),
+    m_settings(settings),
+    m_pagePointToDevicePointMatrix(pagePointToDevicePointMatrix)
+{
+
+}
+
+QList<PDFRenderError> PDFTransparencyTileRenderer::render(QSize pixelSize, const TileCallback& callback) const
+{
+    return render(createTiles(pixelSize, m_settings.tileSize), callback);
+}
+
+QList<PDFRenderError> PDFTransparencyTileRenderer::render(const std::vector<QRect>& tiles, const TileCallback& callback) const
+{
+    std::vector<QList<PDFRenderError>> tileErrors(tiles.size());
+    std::vector<size_t> tileIndices(tiles.size(), 0);
+    std::iota(tileIndices.begin(), tileIndices.end(), 0);
+
+    auto renderTile = [&, this](size_t tileIndex)
+    {
+        const QRect& tileRect = tiles[tileIndex];
+
+        // Tile origin is moved to the origin of the device space
+        const QTransform tileMatrix = m_pagePointToDevicePointMatrix * QTransform::fromTranslate(-tileRect.left(), -tileRect.top());
+        PDFTransparencyRenderer renderer(m_page, m_document, m_fontCache, m_cms, m_optionalContentActivity, m_inkMapper, m_settings, tileMatrix);
+
+        if (m_deviceColorSpace)
+        {
+            renderer.setDeviceColorSpace(m_deviceColorSpace);
+        }
+
+        renderer.beginPaint(tileRect.size());
+        tileErrors[tileIndex] = renderer.processContents();
+        renderer.endPaint();
+
+        callback(tileRect, renderer);
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, tileIndices.cbegin(), tileIndices.cend(), renderTile);
+
+    // Each tile processes the same content, so the same errors
+    // are usually reported by all tiles.
+    QList<PDFRenderError> errors;
+    for (const QList<PDFRenderError>& currentTileErrors : tileErrors)
+    {
+        for (const PDFRenderError& error : currentTileErrors)
+        {
+            auto isSameError = [&error](const PDFRenderError& other) { return error.isSameError(other); };
+            if (std::none_of(errors.cbegin(), errors.cend(), isSameError))
+            {
+                errors.push_back(error);
+            }
+        }
+    }
+
+    return errors;
+}
+
+std::vector<QRect> PDFTransparencyTileRenderer::createTiles(QSize pixelSize, int tileSize)
+{
+    std::vector<QRect> tiles;
+
+    if (pixelSize.isEmpty())
+    {
+        return tiles;
+    }
+
+    if (tileSize <= 0)
+    {
+        tiles.emplace_back(QPoint(0, 0), pixelSize);
+        return tiles;
+    }
+
+    for (int top = 0; top < pixelSize.height(); top += tileSize)
+    {
+        for (int left = 0; left < pixelSize.width(); left += tileSize)
+        {
+            tiles.emplace_back(left, top, qMin(tileSize, pixelSize.width() - left), qMin(tileSize, pixelSize.height() - top));
+        }
+    }
+
+    return tiles;
+}
+
 PDFInkCoverageCalculator::PDFInkCoverageCalculator(const PDFDocument* document,
                                                    const PDFFontCache* fontCache,
                                                    const PDFCMSManager* cmsManager,
@@ -3915,6 +4743,7 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
 
         pdf::PDFTransparencyRendererSettings settings;
         settings.flags.setFlag(PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+        settings.flags.setFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage, true);
 
         // Jakub Melka: debug is very slow, use multithreading
 #ifdef QT_DEBUG
@@ -3924,46 +4753,114 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
         settings.flags.setFlag(PDFTransparencyRendererSettings::ActiveColorMask, false);
         settings.flags.setFlag(PDFTransparencyRendererSettings::SeparationSimulation, true);
         settings.activeColorMask = PDFPixelFormat::getAllColorsMask();
+        settings.tileSize = m_settings.tileSize;
 
-        QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
-        pdf::PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
-        pdf::PDFTransparencyRenderer renderer(page, m_document, m_fontCache, cms.data(), m_optionalContentActivity,
-                                              m_inkMapper, settings, pagePointToDevicePoint);
+        std::vector<QRect> tiles = PDFTransparencyTileRenderer::createTiles(imageSize, settings.tileSize);
+        const size_t tileCount = tiles.size();
 
-        renderer.beginPaint(imageSize);
-        renderer.processContents();
-        renderer.endPaint();
+        // In fast estimation mode, render only randomly selected tiles. At least
+        // two tiles are needed to estimate variance of the coverage.
+        if (m_tileSampleRatio < 1.0 && tileCount > 2)
+        {
+            const size_t sampleCount = qBound<size_t>(2, size_t(std::ceil(m_tileSampleRatio * tileCount)), tileCount);
+            if (sampleCount < tileCount)
+            {
+                std::vector<QRect> sampledTiles;
+                sampledTiles.reserve(sampleCount);
 
-        PDFFloatBitmapWithColorSpace originalProcessImage = renderer.getOriginalProcessBitmap();
-        QSizeF pageSizeMM = page->getRotatedMediaBoxMM().size();
+                std::mt19937 generator(static_cast<std::mt19937::result_type>(pageIndex));
+                std::sample(tiles.cbegin(), tiles.cend(), std::back_inserter(sampledTiles), sampleCount, generator);
+                tiles = qMove(sampledTiles);
+            }
+        }
 
-        pdf::PDFPixelFormat pixelFormat = originalProcessImage.getPixelFormat();
-        pdf::PDFColorComponent totalArea = pageSizeMM.width() * pageSizeMM.height();
-        pdf::PDFColorComponent pixelArea = totalArea / pdf::PDFColorComponent(originalProcessImage.getWidth() * originalProcessImage.getHeight());
+        QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
+        pdf::PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
+        pdf::PDFTransparencyTileRenderer renderer(page, m_document, m_fontCache, cms.data(), m_optionalContentActivity,
+                                                  m_inkMapper, settings, pagePointToDevicePoint);
 
-        std::vector<PDFColorComponent> pageCoverage;
-        const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
-        pageCoverage.resize(colorChannelCount, 0.0f);
+        // Coverage is accumulated tile by tile, so we do not need whole page image.
+        // Coverage of each tile is kept for the estimation of the error bound.
+        struct TileCoverage
+        {
+            PDFReal pixelCount = 0.0;
+            std::vector<PDFColorComponent> coverage;
+        };
 
-        for (size_t y = 0; y < originalProcessImage.getHeight(); ++y)
+        QMutex coverageMutex;
+        pdf::PDFPixelFormat pixelFormat;
+        std::vector<TileCoverage> tileCoverages;
+
+        auto accumulateTileCoverage = [&](const QRect& tileRect, const PDFTransparencyRenderer& tileRenderer)
         {
-            for (size_t x = 0; x < originalProcessImage.getWidth(); ++x)
+            PDFFloatBitmapWithColorSpace originalProcessImage = tileRenderer.getOriginalProcessBitmap();
+            const pdf::PDFPixelFormat tilePixelFormat = originalProcessImage.getPixelFormat();
+            const uint8_t colorChannelCount = tilePixelFormat.getColorChannelCount();
+            const size_t pixelSize = originalProcessImage.getPixelSize();
+
+            std::vector<PDFColorComponent> tileCoverage(colorChannelCount, 0.0f);
+            for (const PDFColorComponent* pixel = originalProcessImage.begin(); pixel != originalProcessImage.end(); pixel += pixelSize)
             {
-                const pdf::PDFColorBuffer buffer = originalProcessImage.getPixel(x, y);
-                const pdf::PDFColorComponent alpha = pixelFormat.hasOpacityChannel() ? buffer[pixelFormat.getOpacityChannelIndex()] : 1.0f;
+                const pdf::PDFColorComponent alpha = tilePixelFormat.hasOpacityChannel() ? pixel[tilePixelFormat.getOpacityChannelIndex()] : 1.0f;
 
                 for (uint8_t i = 0; i < colorChannelCount; ++i)
                 {
-                    pageCoverage[i] += buffer[i] * alpha;
+                    tileCoverage[i] += pixel[i] * alpha;
                 }
             }
+
+            QMutexLocker lock(&coverageMutex);
+            Q_ASSERT(tileCoverages.empty() || pixelFormat == tilePixelFormat);
+            pixelFormat = tilePixelFormat;
+            tileCoverages.push_back(TileCoverage{ PDFReal(tileRect.width()) * PDFReal(tileRect.height()), qMove(tileCoverage) });
+        };
+
+        renderer.render(tiles, accumulateTileCoverage);
+
+        if (tileCoverages.empty())
+        {
+            return;
         }
 
-        std::vector<PDFColorComponent> pageRatioCoverage = pageCoverage;
+        QSizeF pageSizeMM = page->getRotatedMediaBoxMM().size();
+        const PDFReal totalArea = pageSizeMM.width() * pageSizeMM.height();
+        const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
+
+        // Coverage ratio is estimated using ratio estimator (sum of tile
+        // coverages divided by sum of tile areas). If all tiles are rendered, it is
+        // exact ratio. Otherwise, error bound is half-width of 95 % confidence interval
+        // of the ratio estimator (with finite population correction).
+        const PDFReal sampleCount = PDFReal(tileCoverages.size());
+        const PDFReal sampledPixelCount = std::accumulate(tileCoverages.cbegin(), tileCoverages.cend(), 0.0, [](PDFReal value, const TileCoverage& tileCoverage) { return value + tileCoverage.pixelCount; });
+        const PDFReal samplingFraction = sampleCount / PDFReal(tileCount);
+
+        std::vector<PDFReal> pageRatioCoverage(colorChannelCount, 0.0);
+        std::vector<PDFReal> pageRatioError(colorChannelCount, 0.0);
         for (uint8_t i = 0; i < colorChannelCount; ++i)
         {
-            pageCoverage[i] *= pixelArea;
-            pageRatioCoverage[i] *= pixelArea / totalArea;
+            PDFReal coverage = 0.0;
+            for (const TileCoverage& tileCoverage : tileCoverages)
+            {
+                coverage += tileCoverage.coverage[i];
+            }
+
+            const PDFReal ratio = coverage / sampledPixelCount;
+            pageRatioCoverage[i] = ratio;
+
+            if (samplingFraction < 1.0)
+            {
+                PDFReal variance = 0.0;
+                for (const TileCoverage& tileCoverage : tileCoverages)
+                {
+                    const PDFReal residual = tileCoverage.coverage[i] - ratio * tileCoverage.pixelCount;
+                    variance += residual * residual;
+                }
+                variance /= sampleCount - 1.0;
+
+                const PDFReal meanPixelCount = sampledPixelCount / sampleCount;
+                const PDFReal standardError = std::sqrt((1.0 - samplingFraction) * variance / sampleCount) / meanPixelCount;
+                pageRatioError[i] = 1.96 * standardError;
+            }
         }
 
         std::vector<PDFInkMapper::ColorInfo> separations = m_inkMapper->getSeparations(pixelFormat.getProcessColorChannelCount());
@@ -3981,8 +4878,10 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
             info.name = colorInfo.name;
             info.textName = colorInfo.textName;
             info.isSpot = colorInfo.isSpot;
-            info.coveredArea = pageCoverage[i];
+            info.coveredArea = pageRatioCoverage[i] * totalArea;
             info.ratio = pageRatioCoverage[i];
+            info.coveredAreaError = pageRatioError[i] * totalArea;
+            info.ratioError = pageRatioError[i];
             results.emplace_back(qMove(info));
         }
 
@@ -3991,6 +4890,11 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
             m_progress->step();
         }
 
+        if (m_pageCallback)
+        {
+            m_pageCallback(pageIndex, results);
+        }
+
         QMutexLocker lock(&m_mutex);
         m_inkCoverageResults[pageIndex] = qMove(results);
     };
@@ -27,6 +27,8 @@
 
 #include <QImage>
 
+#include <functional>
+
 namespace pdf
 {
 
@@ -255,6 +257,13 @@ public:
     /// \param channelTo Target channel
     void copyChannel(const PDFFloatBitmap& sourceBitmap, uint8_t channelFrom, uint8_t channelTo);
 
+    /// Copies source bitmap into this bitmap, so top left corner of the source
+    /// bitmap is placed at given position. Pixel formats must match and source
+    /// bitmap must fit into this bitmap.
+    /// \param sourceBitmap Source bitmap
+    /// \param position Position of the source bitmap in this bitmap
+    void copyBitmap(const PDFFloatBitmap& sourceBitmap, QPoint position);
+
     /// Resize the bitmap using given transformation mode. Fast transformation mode
     /// uses nearest neighbour mapping, smooth transformation mode uses weighted
     /// averaging algorithm.
@@ -279,6 +288,7 @@ public:
     /// \param backdrop Backdrop
     /// \param initialBackdrop Initial backdrop
     /// \param softMask Soft mask
+    /// \param isSoftMaskOpaque Soft mask is opaque (all its values are 1.0), it is not read
     /// \param alphaIsShape Both soft mask and constant alpha are shapes and not opacity?
     /// \param constantAlpha Constant alpha, can mean shape or opacity
     /// \param mode Blend mode
@@ -289,6 +299,7 @@ public:
                       const PDFFloatBitmap& backdrop,
                       const PDFFloatBitmap& initialBackdrop,
                       const PDFFloatBitmap& softMask,
+                      bool isSoftMaskOpaque,
                       bool alphaIsShape,
                       PDFColorComponent constantAlpha,
                       BlendMode mode,
@@ -310,6 +321,8 @@ public:
     static PDFFloatBitmap createOpaqueSoftMask(size_t width, size_t height);
 
 private:
+    friend class PDFPackedFloatBitmap;
+
     PDFPixelFormat m_format;
     std::size_t m_width;
     std::size_t m_height;
@@ -341,6 +354,39 @@ private:
     PDFColorSpacePointer m_colorSpace;
 };
 
+/// Float bitmap stored with reduced precision. Color components are stored
+/// as 16-bit unsigned normalized integers, so bitmap needs half of the memory
+/// of the float bitmap. Values are clamped to the range [0, 1]. Packed bitmap
+/// can't be modified, it is intended for bitmaps, which are kept in the memory
+/// for a long time (cached results), and it must be unpacked to be used in
+/// the compositing.
+class PDF4QTLIBCORESHARED_EXPORT PDFPackedFloatBitmap
+{
+public:
+    explicit PDFPackedFloatBitmap() = default;
+
+    /// Packs float bitmap into reduced precision storage
+    /// \param bitmap Bitmap
+    static PDFPackedFloatBitmap pack(const PDFFloatBitmap& bitmap);
+
+    /// Unpacks bitmap into float bitmap. Only bitmap data are replaced,
+    /// so, for example, color space of the bitmap is preserved.
+    /// \param bitmap Target bitmap
+    void unpack(PDFFloatBitmap& bitmap) const;
+
+    bool isEmpty() const { return m_data.empty(); }
+
+    /// Returns size of the bitmap data in bytes
+    qint64 getDataSize() const { return qint64(m_data.size() * sizeof(uint16_t)); }
+
+private:
+    PDFPixelFormat m_format;
+    std::size_t m_width = 0;
+    std::size_t m_height = 0;
+    std::vector<uint16_t> m_data;
+    std::vector<uint32_t> m_activeColorMask;
+};
+
 /// Ink mapping
 struct PDFInkMapping
 {
@@ -573,6 +619,10 @@ struct PDFTransparencyRendererSettings
     /// used when some shadings are being sampled.
     int shadingAlgorithmLimit = 64;
 
+    /// Tile size (in pixels) used by tiled transparency renderer.
+    /// If it is zero, whole page is rendered as a single tile.
+    int tileSize = 1024;
+
     enum Flag
     {
         None               = 0x0000,
@@ -617,12 +667,26 @@ struct PDFTransparencyRendererSettings
         /// and before separation simulation is applied. Active color mask
         /// is still applied to this image.
         SaveOriginalProcessImage    = 0x0400,
+
+        /// Cache rendered soft masks and results of isolated transparency
+        /// group forms, so they are not rendered again, when they are used
+        /// multiple times with the same transformation.
+        CacheTransparencyResults    = 0x0800,
+
+        /// Store cached transparency results and original process image
+        /// with 16-bit precision instead of 32-bit float precision. Bitmaps
+        /// are converted, when they are stored or used in compositing.
+        ReducedPrecisionStorage     = 0x1000,
     };
 
     Q_DECLARE_FLAGS(Flags, Flag)
 
     /// Flags
-    Flags flags = static_cast<Flags>(DisplayImages | DisplayText | DisplayVectorGraphics | DisplayShadings | DisplayTilingPatterns);
+    Flags flags = static_cast<Flags>(DisplayImages | DisplayText | DisplayVectorGraphics | DisplayShadings | DisplayTilingPatterns | CacheTransparencyResults);
+
+    /// Maximal size (in megabytes) of cached soft masks and transparency
+    /// group results of single renderer.
+    int transparencyCacheSize = 256;
 
     /// Active color mask
     uint32_t activeColorMask = PDFPixelFormat::getAllColorsMask();
@@ -679,6 +743,15 @@ public:
     /// \param paperColor Paper color
     QImage toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const;
 
+    /// This function should be called only after call to \p endPaint. Converts
+    /// result float image (in device color space, with spot colors) to integer
+    /// samples of color channels, which are interleaved, rows are stored without
+    /// padding. Image is painted onto the white paper, so opacity is not stored.
+    /// 16-bit samples are stored in little endian byte order. If error occurs,
+    /// empty data are returned.
+    /// \param bitsPerSample Bits per sample (8 or 16)
+    QByteArray toSamples(int bitsPerSample) const;
+
     /// Clear color buffer with given color (this affects all process colors). If a number
     /// of process colors are different from a number of colors in color, then error is triggered,
     /// and most min(process color count, colors in color) process color channels are filled
@@ -689,7 +762,7 @@ public:
     /// Returns original process bitmap, before it is transformed into device space,
     /// and before separation simulation is being processed. Active color mask is still
     /// applied to this image.
-    PDFFloatBitmapWithColorSpace getOriginalProcessBitmap() const { return m_originalProcessBitmap; }
+    PDFFloatBitmapWithColorSpace getOriginalProcessBitmap() const;
 
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
     virtual void performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule) override;
@@ -701,9 +774,11 @@ public:
     virtual void performRestoreGraphicState(ProcessOrder order) override;
     virtual void performBeginTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup) override;
     virtual void performEndTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup) override;
+    virtual bool isTransparencyGroupContentSkipped() const override;
     virtual void performTextBegin(ProcessOrder order) override;
     virtual void performTextEnd(ProcessOrder order) override;
     virtual bool performOriginalImagePainting(const PDFImage& image, const PDFStream* stream) override;
+    virtual bool isOriginalImagePaintingUsed() const override { return true; }
     virtual void performImagePainting(const QImage& image) override;
     virtual void performMeshPainting(const PDFMesh& mesh) override;
 
@@ -743,6 +818,35 @@ private:
         QSharedDataPointer<PDFTransparencySoftMaskImpl> m_data;
     };
 
+    /// Cached soft mask, soft mask is rendered with current transformation matrix
+    struct PDFCachedSoftMask
+    {
+        const PDFDictionary* softMask = nullptr;
+        QTransform matrix;
+        PDFTransparencySoftMask result;
+        PDFPackedFloatBitmap packedResult; ///< Packed result, if reduced precision storage is used
+    };
+
+    /// Cached result of isolated transparency group form. Result of isolated
+    /// group doesn't depend on the backdrop, only on the group content, current
+    /// transformation matrix, clipping path and inherited colors.
+    struct PDFCachedTransparencyGroup
+    {
+        bool isSameGroup(const PDFCachedTransparencyGroup& other) const
+        {
+            return stream == other.stream && matrix == other.matrix && fillColor == other.fillColor &&
+                   strokeColor == other.strokeColor && clipPath == other.clipPath;
+        }
+
+        const PDFStream* stream = nullptr;
+        QTransform matrix;
+        QRgb fillColor = 0;
+        QRgb strokeColor = 0;
+        QPainterPath clipPath;
+        PDFFloatBitmapWithColorSpace result; ///< Result, only color space is set, if result is packed
+        PDFPackedFloatBitmap packedResult; ///< Packed result, if reduced precision storage is used
+    };
+
     struct PDFTransparencyGroupPainterData
     {
         void makeInitialBackdropTransparent();
@@ -763,6 +867,9 @@ private:
         uint32_t activeColorMask = PDFPixelFormat::getAllColorsMask();
         bool transformSpotsToDevice = false;
         bool saveOriginalImage = false;
+        int cachedGroupIndex = -1; ///< Index of cached group result (content of the group is not processed)
+        bool storeToCache = false; ///< Store group result to the cache, when group is finished
+        PDFCachedTransparencyGroup cacheKey; ///< Key of the group in the cache
     };
 
     struct PDFTransparencyPainterState
@@ -906,6 +1013,17 @@ private:
     /// \param softMask Soft mask
     void processSoftMask(const PDFDictionary* softMask);
 
+    /// Returns true, if soft masks and transparency group results are cached
+    bool isTransparencyCacheEnabled() const { return m_settings.flags.testFlag(PDFTransparencyRendererSettings::CacheTransparencyResults); }
+
+    /// Returns true, if long-lived bitmaps are stored with reduced precision
+    bool isReducedPrecisionStorageEnabled() const { return m_settings.flags.testFlag(PDFTransparencyRendererSettings::ReducedPrecisionStorage); }
+
+    /// Reserves space for the bitmap in the transparency cache. If there
+    /// is not enough space in the cache, then false is returned.
+    /// \param bitmap Bitmap to be inserted into the cache
+    bool reserveTransparencyCache(const PDFFloatBitmap& bitmap);
+
     static void createOpaqueBitmap(PDFFloatBitmap& bitmap);
     static void createPaperBitmap(PDFFloatBitmap& bitmap, const PDFRGB& paperColor);
     static void createOpaqueSoftMask(PDFFloatBitmap& softMask, size_t width, size_t height) { softMask = PDFFloatBitmap::createOpaqueSoftMask(width, height); }
@@ -923,6 +1041,68 @@ private:
     PDFTransparencyRendererSettings m_settings;
     PDFDrawBuffer m_drawBuffer;
     PDFFloatBitmapWithColorSpace m_originalProcessBitmap;
+    PDFPackedFloatBitmap m_packedOriginalProcessBitmap;
+    std::vector<PDFCachedSoftMask> m_softMaskCache;
+    std::vector<PDFCachedTransparencyGroup> m_transparencyGroupCache;
+    qint64 m_transparencyCacheSize = 0;
+};
+
+/// Renders page using transparency renderer in tiles of fixed size. Each tile
+/// is rendered by its own transparency renderer with its own transparency group
+/// stack, so memory used for rendering is bounded by the tile size instead
+/// of the page size. Tiles are rendered in parallel, page content is processed
+/// for each tile separately.
+class PDF4QTLIBCORESHARED_EXPORT PDFTransparencyTileRenderer
+{
+public:
+    PDFTransparencyTileRenderer(const PDFPage* page,
+                                const PDFDocument* document,
+                                const PDFFontCache* fontCache,
+                                const PDFCMS* cms,
+                                const PDFOptionalContentActivity* optionalContentActivity,
+                                const PDFInkMapper* inkMapper,
+                                PDFTransparencyRendererSettings settings,
+                                QTransform pagePointToDevicePointMatrix);
+
+    /// Callback, which is called for each tile after painting of the tile is
+    /// finished. Renderer of the tile can be used to obtain tile images. Callback
+    /// can be called from multiple threads simultaneously.
+    using TileCallback = std::function<void(const QRect& tileRect, const PDFTransparencyRenderer& renderer)>;
+
+    /// Renders page in tiles and returns rendering errors. Errors, which
+    /// are reported by multiple tiles, are returned only once.
+    /// \param pixelSize Size of the whole page in pixels
+    /// \param callback Callback called for each rendered tile
+    QList<PDFRenderError> render(QSize pixelSize, const TileCallback& callback) const;
+
+    /// Renders given tiles of the page and returns rendering errors. Tiles
+    /// can be a subset of tiles covering the page (for example, when only
+    /// sampled tiles are needed).
+    /// \param tiles Tiles (in device pixels)
+    /// \param callback Callback called for each rendered tile
+    QList<PDFRenderError> render(const std::vector<QRect>& tiles, const TileCallback& callback) const;
+
+    /// Splits area of given size into tiles. If tile size is zero,
+    /// then single tile covering whole area is returned.
+    /// \param pixelSize Size of the area in pixels
+    /// \param tileSize Tile size
+    static std::vector<QRect> createTiles(QSize pixelSize, int tileSize);
+
+    /// Sets device color space of tile renderers (if it is not set,
+    /// default device color space of the renderer is used).
+    /// \param colorSpace Color space
+    void setDeviceColorSpace(PDFColorSpacePointer colorSpace) { m_deviceColorSpace = qMove(colorSpace); }
+
+private:
+    const PDFPage* m_page;
+    const PDFDocument* m_document;
+    const PDFFontCache* m_fontCache;
+    const PDFCMS* m_cms;
+    const PDFOptionalContentActivity* m_optionalContentActivity;
+    const PDFInkMapper* m_inkMapper;
+    PDFTransparencyRendererSettings m_settings;
+    QTransform m_pagePointToDevicePointMatrix;
+    PDFColorSpacePointer m_deviceColorSpace;
 };
 
 /// Ink coverage calculator. Calculates ink coverage for a given
@@ -946,8 +1126,29 @@ public:
         QColor color;
         PDFColorComponent coveredArea = 0.0f;
         PDFColorComponent ratio = 0.0f;
+        PDFColorComponent coveredAreaError = 0.0f;  ///< Error bound of covered area (95 % confidence), nonzero only if tiles are sampled
+        PDFColorComponent ratioError = 0.0f;        ///< Error bound of ratio (95 % confidence), nonzero only if tiles are sampled
     };
 
+    /// Callback, which is called, when ink coverage of the page is calculated.
+    /// Callback can be called from multiple threads simultaneously, and pages
+    /// are not reported in any particular order.
+    using PageCallback = std::function<void(PDFInteger pageIndex, const std::vector<InkCoverageChannelInfo>& coverage)>;
+
+    /// Sets ratio of page tiles, which are rendered (fast estimation mode). If ratio
+    /// is lower than 1.0, then only randomly selected tiles are rendered, and ink
+    /// coverage of the page is estimated from the rendered tiles. Error bound
+    /// of the estimation is stored in the results. Tiles are selected using
+    /// generator seeded by page index, so results are reproducible.
+    /// \param tileSampleRatio Ratio of rendered tiles (in range (0, 1])
+    void setTileSampleRatio(PDFReal tileSampleRatio) { m_tileSampleRatio = qBound(0.0, tileSampleRatio, 1.0); }
+
+    /// Sets callback, which is called, when ink coverage of the page is calculated.
+    /// So, results can be processed (for example, written) while other pages
+    /// are still being calculated.
+    /// \param callback Callback
+    void setPageCallback(PageCallback callback) { m_pageCallback = std::move(callback); }
+
     /// Perform ink coverage calculations on given pages. Results are stored
     /// in this object. Page images are rendered using \p size resolution,
     /// and in this resolution, ink coverage is calculated.
@@ -985,6 +1186,8 @@ private:
     const PDFInkMapper* m_inkMapper;
     PDFProgress* m_progress;
     PDFTransparencyRendererSettings m_settings;
+    PDFReal m_tileSampleRatio = 1.0;
+    PageCallback m_pageCallback;
 
     QMutex m_mutex;
     std::map<pdf::PDFInteger, std::vector<InkCoverageChannelInfo>> m_inkCoverageResults;
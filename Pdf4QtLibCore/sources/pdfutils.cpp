@@ -21,8 +21,12 @@
 
 #include <QtGlobal>
 #include <QtMath>
+#include <QtEndian>
 #include "pdfdbgheap.h"
 
+#include <cmath>
+#include <limits>
+
 #include <jpeglib.h>
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -74,7 +78,7 @@ PDFBitReader::PDFBitReader(const QByteArray* stream, Value bitsPerComponent) :
     Q_ASSERT(bitsPerComponent < 56);
 }
 
-PDFBitReader::Value PDFBitReader::read(PDFBitReader::Value bits)
+PDFBitReader::Value PDFBitReader::readWithRefill(PDFBitReader::Value bits)
 {
     while (m_bitsInBuffer < bits)
     {
@@ -98,22 +102,27 @@ PDFBitReader::Value PDFBitReader::read(PDFBitReader::Value bits)
 
 PDFBitReader::Value PDFBitReader::look(Value bits) const
 {
-    PDFBitReader temp(*this);
+    Value buffer = m_buffer;
+    Value bitsInBuffer = m_bitsInBuffer;
+    int position = m_position;
 
-    Value result = 0;
-    for (Value i = 0; i < bits; ++i)
+    while (bitsInBuffer < bits)
     {
-        if (!temp.isAtEnd())
+        if (position < m_stream->size())
         {
-            result = (result << 1) | temp.read(1);
+            uint8_t currentByte = static_cast<uint8_t>((*m_stream)[position++]);
+            buffer = (buffer << 8) | currentByte;
+            bitsInBuffer += 8;
         }
         else
         {
-            result = (result << 1);
+            // Missing bits at the end of the stream are zero
+            buffer = buffer << (bits - bitsInBuffer);
+            bitsInBuffer = bits;
         }
     }
 
-    return result;
+    return (buffer >> (bitsInBuffer - bits)) & ((static_cast<Value>(1) << bits) - static_cast<Value>(1));
 }
 
 void PDFBitReader::seek(qint64 position)
@@ -197,6 +206,69 @@ QByteArray PDFBitReader::readSubstream(int length)
     return result;
 }
 
+PDFBufferedBitReader::PDFBufferedBitReader(const QByteArray* stream) :
+    m_stream(stream),
+    m_position(0),
+    m_buffer(0),
+    m_bitsInBuffer(0)
+{
+
+}
+
+void PDFBufferedBitReader::refill(Value bits)
+{
+    const qint64 size = m_stream->size();
+
+    if (m_position + 8 <= size)
+    {
+        // Load eight bytes at once, but take only whole bytes, which fit into the
+        // buffer. Bits of the partially taken byte are the same, as the bits, which
+        // will be loaded by the next refill, so they can remain in the buffer.
+        const Value word = qFromBigEndian<quint64>(m_stream->constData() + m_position);
+        const Value bytes = (63 - m_bitsInBuffer) / 8;
+        m_buffer |= word >> m_bitsInBuffer;
+        m_position += bytes;
+        m_bitsInBuffer += bytes * 8;
+    }
+    else
+    {
+        while (m_bitsInBuffer <= MAX_BITS && m_position < size)
+        {
+            const uint8_t currentByte = static_cast<uint8_t>((*m_stream)[m_position++]);
+            m_buffer |= static_cast<Value>(currentByte) << (MAX_BITS - m_bitsInBuffer);
+            m_bitsInBuffer += 8;
+        }
+    }
+
+    if (m_bitsInBuffer < bits)
+    {
+        throw PDFException(PDFTranslationContext::tr("Not enough data to read %1-bit value.").arg(bits));
+    }
+}
+
+void PDFBufferedBitReader::seek(qint64 position)
+{
+    if (position >= 0 && position <= m_stream->size())
+    {
+        m_position = position;
+        m_buffer = 0;
+        m_bitsInBuffer = 0;
+    }
+    else
+    {
+        throw PDFException(PDFTranslationContext::tr("Can't seek to position %1.").arg(position));
+    }
+}
+
+void PDFBufferedBitReader::alignToBytes()
+{
+    // Whole bytes are loaded into the buffer, so bits of the partially
+    // read byte are the remainder of the bits in the buffer.
+    const Value remainder = m_bitsInBuffer % 8;
+    m_buffer <<= remainder;
+    m_bitsInBuffer -= remainder;
+}
+
 PDFBitWriter::PDFBitWriter(Value bitsPerComponent) :
     m_bitsPerComponent(bitsPerComponent),
     m_mask((static_cast<Value>(1) << m_bitsPerComponent) - static_cast<Value>(1)),
@@ -214,6 +286,17 @@ void PDFBitWriter::write(Value value)
     flush(false);
 }
 
+void PDFBitWriter::write(Value value, Value bits)
+{
+    Q_ASSERT(bits <= 32);
+
+    const Value mask = (static_cast<Value>(1) << bits) - static_cast<Value>(1);
+    m_buffer = (m_buffer << bits) | (value & mask);
+    m_bitsInBuffer += bits;
+
+    flush(false);
+}
+
 void PDFBitWriter::flush(bool alignToByteBoundary)
 {
     if (m_bitsInBuffer >= 8)
@@ -560,6 +643,138 @@ QString PDFSysUtils::getUserName()
     return userName;
 }
 
+void PDFSpatialIndex::build(const std::vector<std::optional<QRectF>>& rectangles)
+{
+    m_bounds = QRectF();
+    m_columns = 0;
+    m_rows = 0;
+    m_cells.clear();
+    m_unboundedIndices.clear();
+
+    PDFReal minX = std::numeric_limits<PDFReal>::infinity();
+    PDFReal minY = std::numeric_limits<PDFReal>::infinity();
+    PDFReal maxX = -std::numeric_limits<PDFReal>::infinity();
+    PDFReal maxY = -std::numeric_limits<PDFReal>::infinity();
+    size_t boundedCount = 0;
+
+    for (size_t i = 0; i < rectangles.size(); ++i)
+    {
+        if (!rectangles[i])
+        {
+            m_unboundedIndices.push_back(i);
+            continue;
+        }
+
+        // Rectangle can be empty (zero width or height), so we do not use QRectF::united
+        const QRectF rectangle = rectangles[i]->normalized();
+        minX = qMin(minX, rectangle.left());
+        minY = qMin(minY, rectangle.top());
+        maxX = qMax(maxX, rectangle.right());
+        maxY = qMax(maxY, rectangle.bottom());
+        ++boundedCount;
+    }
+
+    if (boundedCount == 0)
+    {
+        return;
+    }
+
+    const int gridSize = qBound(1, int(std::ceil(std::sqrt(PDFReal(boundedCount) / ITEMS_PER_CELL))), MAX_GRID_SIZE);
+    m_bounds = QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+    m_columns = gridSize;
+    m_rows = gridSize;
+    m_cells.resize(size_t(m_columns) * size_t(m_rows));
+
+    const PDFReal cellWidth = m_bounds.width() / m_columns;
+    const PDFReal cellHeight = m_bounds.height() / m_rows;
+
+    for (size_t i = 0; i < rectangles.size(); ++i)
+    {
+        if (!rectangles[i])
+        {
+            continue;
+        }
+
+        const QRectF rectangle = rectangles[i]->normalized();
+        const auto [firstColumn, lastColumn] = getCellRange(rectangle.left(), rectangle.right(), m_bounds.left(), cellWidth, m_columns);
+        const auto [firstRow, lastRow] = getCellRange(rectangle.top(), rectangle.bottom(), m_bounds.top(), cellHeight, m_rows);
+
+        for (int row = firstRow; row <= lastRow; ++row)
+        {
+            for (int column = firstColumn; column <= lastColumn; ++column)
+            {
+                m_cells[size_t(row) * m_columns + column].push_back(i);
+            }
+        }
+    }
+}
+
+std::vector<size_t> PDFSpatialIndex::query(const QPointF& point) const
+{
+    return query(QRectF(point, point));
+}
+
+std::vector<size_t> PDFSpatialIndex::query(const QRectF& rectangle) const
+{
+    const QRectF queryRectangle = rectangle.normalized();
+
+    if (m_cells.empty() ||
+        queryRectangle.right() < m_bounds.left() || queryRectangle.left() > m_bounds.right() ||
+        queryRectangle.bottom() < m_bounds.top() || queryRectangle.top() > m_bounds.bottom())
+    {
+        return m_unboundedIndices;
+    }
+
+    const auto [firstColumn, lastColumn] = getCellRange(queryRectangle.left(), queryRectangle.right(), m_bounds.left(), m_bounds.width() / m_columns, m_columns);
+    const auto [firstRow, lastRow] = getCellRange(queryRectangle.top(), queryRectangle.bottom(), m_bounds.top(), m_bounds.height() / m_rows, m_rows);
+
+    if (firstColumn == lastColumn && firstRow == lastRow)
+    {
+        // Indices in one cell are already sorted
+        return merge(m_cells[size_t(firstRow) * m_columns + firstColumn]);
+    }
+
+    std::vector<size_t> indices;
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+        for (int column = firstColumn; column <= lastColumn; ++column)
+        {
+            const std::vector<size_t>& cell = m_cells[size_t(row) * m_columns + column];
+            indices.insert(indices.end(), cell.cbegin(), cell.cend());
+        }
+    }
+
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    return merge(indices);
+}
+
+std::pair<int, int> PDFSpatialIndex::getCellRange(PDFReal min, PDFReal max, PDFReal gridMin, PDFReal cellSize, int cellCount) const
+{
+    if (cellSize <= 0.0)
+    {
+        // All rectangles have the same coordinate in this axis
+        return std::make_pair(0, cellCount - 1);
+    }
+
+    const int first = qBound(0, int(std::floor((min - gridMin) / cellSize)), cellCount - 1);
+    const int last = qBound(0, int(std::floor((max - gridMin) / cellSize)), cellCount - 1);
+    return std::make_pair(first, last);
+}
+
+std::vector<size_t> PDFSpatialIndex::merge(const std::vector<size_t>& indices) const
+{
+    if (m_unboundedIndices.empty())
+    {
+        return indices;
+    }
+
+    std::vector<size_t> result;
+    result.reserve(indices.size() + m_unboundedIndices.size());
+    std::set_union(indices.cbegin(), indices.cend(), m_unboundedIndices.cbegin(), m_unboundedIndices.cend(), std::back_inserter(result));
+    return result;
+}
+
 PDFColorScale::PDFColorScale() :
     m_min(0.0),
     m_max(0.0)
@@ -26,7 +26,15 @@
 #include <QDataStream>
 
 #include <set>
+#include <bit>
+#include <array>
+#include <limits>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
 #include <vector>
+#include <optional>
+#include <algorithm>
 #include <iterator>
 #include <functional>
 #include <type_traits>
@@ -131,7 +139,17 @@ public:
 
     /// Reads single n-bit value from the stream. If stream hasn't enough data,
     /// then exception is thrown.
-    Value read(Value bits);
+    inline Value read(Value bits)
+    {
+        if (m_bitsInBuffer >= bits)
+        {
+            // Fast path - all bits are already in the buffer
+            m_bitsInBuffer -= bits;
+            return (m_buffer >> m_bitsInBuffer) & ((static_cast<Value>(1) << bits) - static_cast<Value>(1));
+        }
+
+        return readWithRefill(bits);
+    }
 
     /// Reads single n-bit value from the stream. If stream hasn't enough data,
     /// then exception is thrown. State of the stream is not changed, i.e., read
@@ -179,6 +197,10 @@ public:
     QByteArray readSubstream(int length);
 
 private:
+    /// Reads bytes from the stream into the buffer, until it contains
+    /// enough bits, and then reads the value.
+    Value readWithRefill(Value bits);
+
     const QByteArray* m_stream;
     int m_position;
 
@@ -189,6 +211,100 @@ private:
     Value m_bitsInBuffer;
 };
 
+/// Buffered bit-reader, which reads n-bit unsigned integers from the stream,
+/// number of bits can be different for each value. Unlike \p PDFBitReader, it
+/// reads as many whole bytes of the stream, as fits into the 64-bit buffer,
+/// at once, so most of the reads just take the bits from the buffer. It is
+/// intended for parsing of large bit streams, such as mesh shading data.
+/// Values up to 56 bits can be read.
+class PDF4QTLIBCORESHARED_EXPORT PDFBufferedBitReader
+{
+public:
+    using Value = uint64_t;
+
+    /// Maximal number of bits of the single value
+    static constexpr Value MAX_BITS = 56;
+
+    explicit PDFBufferedBitReader(const QByteArray* stream);
+
+    /// Reads single n-bit value from the stream. If stream hasn't enough data,
+    /// then exception is thrown.
+    /// \param bits Number of bits (1-56)
+    inline Value read(Value bits)
+    {
+        Q_ASSERT(bits > 0 && bits <= MAX_BITS);
+
+        if (m_bitsInBuffer < bits)
+        {
+            refill(bits);
+        }
+
+        // Bits of the buffer are aligned to the most significant bit
+        const Value value = m_buffer >> (64 - bits);
+        m_buffer <<= bits;
+        m_bitsInBuffer -= bits;
+        return value;
+    }
+
+    /// Reads single value with fixed number of bits from the stream. If stream
+    /// hasn't enough data, then exception is thrown.
+    template<Value Bits>
+    inline Value read()
+    {
+        static_assert(Bits > 0 && Bits <= MAX_BITS, "Invalid number of bits.");
+        return read(Bits);
+    }
+
+    /// Reads array of n-bit values from the stream. If stream hasn't enough
+    /// data, then exception is thrown.
+    /// \param bits Number of bits of each value (1-56)
+    /// \param values Output values
+    /// \param count Number of values
+    template<typename T>
+    inline void readArray(Value bits, T* values, size_t count)
+    {
+        Q_ASSERT(bits > 0 && bits <= MAX_BITS);
+
+        size_t i = 0;
+        while (i < count)
+        {
+            if (m_bitsInBuffer < bits)
+            {
+                refill(bits);
+            }
+
+            for (; i < count && m_bitsInBuffer >= bits; ++i)
+            {
+                values[i] = static_cast<T>(m_buffer >> (64 - bits));
+                m_buffer <<= bits;
+                m_bitsInBuffer -= bits;
+            }
+        }
+    }
+
+    /// Seeks the desired position in the data stream. If position can't be seeked,
+    /// then exception is thrown.
+    void seek(qint64 position);
+
+    /// Seeks data to the byte boundary (number of processed bits is divisible by 8)
+    void alignToBytes();
+
+    /// Returns true, if we are at the end of the data stream (no more data can be read)
+    bool isAtEnd() const { return m_bitsInBuffer == 0 && m_position >= m_stream->size(); }
+
+private:
+    /// Reads bytes from the stream into the buffer, so it contains
+    /// at least given number of bits. If stream hasn't enough data,
+    /// then exception is thrown.
+    void refill(Value bits);
+
+    const QByteArray* m_stream;
+    qint64 m_position;
+
+    Value m_buffer;
+    Value m_bitsInBuffer;
+};
+
 /// Bit writer
 class PDF4QTLIBCORESHARED_EXPORT PDFBitWriter
 {
@@ -200,6 +316,12 @@ public:
     /// Writes value to the output stream
     void write(Value value);
 
+    /// Writes value with given number of bits to the output stream. Number of
+    /// bits must not exceed 32 (zero bits means nothing is written).
+    /// \param value Value
+    /// \param bits Number of bits
+    void write(Value value, Value bits);
+
     /// Finish line - align to byte boundary
     void finishLine() { flush(true); }
 
@@ -574,6 +696,309 @@ private:
     value_ptr m_end;
 };
 
+/// Vector of items stored in chunks of fixed size, which are shared between copies
+/// of the vector. Copying of the vector copies only pointers to the chunks. Chunk is
+/// copied, when it is being modified and it is shared with another vector (copy on write).
+/// So snapshots of the vector are cheap, and modification of the snapshot costs only
+/// the copy of the modified chunks. This class is not thread safe for writing.
+template<typename T, size_t ChunkSize = 256>
+class PDFPersistentVector
+{
+public:
+    using value_type = T;
+
+    inline PDFPersistentVector() = default;
+
+    inline size_t size() const { return m_size; }
+    inline bool empty() const { return m_size == 0; }
+
+    inline const T& operator[](size_t index) const { return (*m_chunks[index / ChunkSize])[index % ChunkSize]; }
+
+    /// Returns modifiable item. If chunk containing the item is shared
+    /// with another vector, it is copied.
+    /// \param index Index of the item
+    inline T& getModifiable(size_t index) { return detach(index / ChunkSize)[index % ChunkSize]; }
+
+    /// Appends item to the end of the vector
+    /// \param value Item
+    void push_back(T value)
+    {
+        if (m_size % ChunkSize == 0)
+        {
+            m_chunks.push_back(std::make_shared<Chunk>());
+            m_chunks.back()->reserve(ChunkSize);
+        }
+
+        detach(m_chunks.size() - 1).push_back(std::move(value));
+        ++m_size;
+    }
+
+    /// Sets items of the vector. Chunks, whose items are equal to the
+    /// current items, are preserved, so they remain shared with the copies.
+    /// \param values Items
+    void assign(std::vector<T>&& values)
+    {
+        const size_t chunkCount = (values.size() + ChunkSize - 1) / ChunkSize;
+
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        chunks.reserve(chunkCount);
+
+        for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+        {
+            auto first = std::next(values.begin(), chunkIndex * ChunkSize);
+            auto last = std::next(values.begin(), std::min((chunkIndex + 1) * ChunkSize, values.size()));
+
+            if (chunkIndex < m_chunks.size() && std::equal(first, last, m_chunks[chunkIndex]->cbegin(), m_chunks[chunkIndex]->cend()))
+            {
+                chunks.push_back(m_chunks[chunkIndex]);
+            }
+            else
+            {
+                chunks.push_back(std::make_shared<Chunk>(std::make_move_iterator(first), std::make_move_iterator(last)));
+            }
+        }
+
+        m_chunks = std::move(chunks);
+        m_size = values.size();
+    }
+
+    /// Returns items of the vector as standard vector
+    std::vector<T> toVector() const
+    {
+        std::vector<T> result;
+        result.reserve(m_size);
+
+        for (const std::shared_ptr<Chunk>& chunk : m_chunks)
+        {
+            result.insert(result.end(), chunk->cbegin(), chunk->cend());
+        }
+
+        return result;
+    }
+
+    bool operator==(const PDFPersistentVector& other) const
+    {
+        if (m_size != other.m_size)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            // Shared chunks are equal, we do not need to compare the items
+            if (m_chunks[i] != other.m_chunks[i] && *m_chunks[i] != *other.m_chunks[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator!=(const PDFPersistentVector& other) const { return !(*this == other); }
+
+private:
+    using Chunk = std::vector<T>;
+
+    Chunk& detach(size_t chunkIndex)
+    {
+        std::shared_ptr<Chunk>& chunk = m_chunks[chunkIndex];
+        if (chunk.use_count() > 1)
+        {
+            std::shared_ptr<Chunk> copiedChunk = std::make_shared<Chunk>();
+            copiedChunk->reserve(ChunkSize);
+            copiedChunk->insert(copiedChunk->end(), chunk->cbegin(), chunk->cend());
+            chunk = std::move(copiedChunk);
+        }
+
+        return *chunk;
+    }
+
+    std::vector<std::shared_ptr<Chunk>> m_chunks;
+    size_t m_size = 0;
+};
+
+/// Perfect hash of the static set of keys, which is constructed at compile time
+/// using hash and displace algorithm. Keys are distributed into buckets, and for each
+/// bucket (the largest buckets first) a displacement is found, which maps all keys
+/// of the bucket into free slots of the table. Lookup of the key reads just one
+/// displacement and one slot, so no search is needed. Key found in the slot must
+/// be compared with the searched key, because searched key may not be in the set.
+/// Keys are passed as their 64-bit hashes (see \p getHash functions). Construction
+/// of large sets can exceed compile time evaluation limits of some compilers, so
+/// tables of large sets should be generated offline (see \p getSlots and
+/// \p getDisplacements) and passed to the constructor.
+/// \param Count Maximal number of the keys
+template<size_t Count>
+class PDFStaticPerfectHash
+{
+public:
+    static_assert(Count < std::numeric_limits<uint16_t>::max(), "Too many keys for perfect hash.");
+
+    static constexpr size_t INVALID_INDEX = std::numeric_limits<uint16_t>::max();
+    static constexpr size_t SLOT_COUNT = std::bit_ceil(Count + Count / 4 + 1);
+    static constexpr size_t BUCKET_COUNT = Count / 4 + 1;
+
+    /// Constructs perfect hash of the keys. If keys have the same hash, or if
+    /// displacement of some bucket can't be found, construction fails (so it can't
+    /// be evaluated at compile time).
+    /// \param hashes Hashes of the keys
+    /// \param count Number of valid keys (only first \p count hashes are used)
+    constexpr explicit PDFStaticPerfectHash(const std::array<uint64_t, Count>& hashes, size_t count = Count)
+    {
+        m_slots.fill(uint16_t(INVALID_INDEX));
+        m_displacements.fill(0);
+
+        // Sort keys by the buckets (counting sort)
+        std::array<size_t, BUCKET_COUNT + 1> bucketStart = { };
+        for (size_t i = 0; i < count; ++i)
+        {
+            ++bucketStart[getBucket(hashes[i]) + 1];
+        }
+
+        size_t maximalBucketSize = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            maximalBucketSize = std::max(maximalBucketSize, bucketStart[i + 1]);
+            bucketStart[i + 1] += bucketStart[i];
+        }
+
+        std::array<uint16_t, Count> bucketKeys = { };
+        std::array<size_t, BUCKET_COUNT> bucketFill = { };
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t bucket = getBucket(hashes[i]);
+            bucketKeys[bucketStart[bucket] + bucketFill[bucket]++] = uint16_t(i);
+        }
+
+        // Place buckets, the largest buckets first
+        for (size_t bucketSize = maximalBucketSize; bucketSize > 0; --bucketSize)
+        {
+            for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+            {
+                if (bucketStart[bucket + 1] - bucketStart[bucket] != bucketSize)
+                {
+                    continue;
+                }
+
+                const uint16_t* keys = bucketKeys.data() + bucketStart[bucket];
+                bool isPlaced = false;
+
+                for (size_t displacement = 0; displacement < std::numeric_limits<uint16_t>::max() && !isPlaced; ++displacement)
+                {
+                    isPlaced = true;
+
+                    for (size_t i = 0; i < bucketSize; ++i)
+                    {
+                        uint16_t& slot = m_slots[getSlot(hashes[keys[i]], displacement)];
+                        if (slot != INVALID_INDEX)
+                        {
+                            // Slot is occupied, remove already placed keys of the bucket
+                            for (size_t j = 0; j < i; ++j)
+                            {
+                                m_slots[getSlot(hashes[keys[j]], displacement)] = uint16_t(INVALID_INDEX);
+                            }
+
+                            isPlaced = false;
+                            break;
+                        }
+
+                        slot = keys[i];
+                    }
+
+                    if (isPlaced)
+                    {
+                        m_displacements[bucket] = uint16_t(displacement);
+                    }
+                }
+
+                if (!isPlaced)
+                {
+                    throw std::logic_error("Perfect hash can't be constructed.");
+                }
+            }
+        }
+    }
+
+    /// Constructs perfect hash from tables generated offline
+    /// \param slots Slots of the table (indices of the keys)
+    /// \param displacements Displacements of the buckets
+    constexpr explicit PDFStaticPerfectHash(const std::array<uint16_t, SLOT_COUNT>& slots,
+                                            const std::array<uint16_t, BUCKET_COUNT>& displacements) :
+        m_slots(slots),
+        m_displacements(displacements)
+    {
+
+    }
+
+    /// Returns slots of the table (indices of the keys)
+    constexpr const std::array<uint16_t, SLOT_COUNT>& getSlots() const { return m_slots; }
+
+    /// Returns displacements of the buckets
+    constexpr const std::array<uint16_t, BUCKET_COUNT>& getDisplacements() const { return m_displacements; }
+
+    /// Returns index of the only key, which can be equal to the key with the
+    /// given hash, or INVALID_INDEX, if key is not in the set.
+    /// \param hash Hash of the key
+    constexpr size_t find(uint64_t hash) const
+    {
+        return m_slots[getSlot(hash, m_displacements[getBucket(hash)])];
+    }
+
+    /// Returns hash of the null terminated string (64-bit FNV-1a hash)
+    /// \param string String
+    static constexpr uint64_t getHash(const char* string)
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        for (; *string; ++string)
+        {
+            hash = (hash ^ static_cast<unsigned char>(*string)) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    /// Returns hash of the string (64-bit FNV-1a hash)
+    /// \param data Data of the string
+    /// \param length Length of the string
+    static constexpr uint64_t getHash(const char* data, size_t length)
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    /// Returns hash of the integer value (finalizer of the SplitMix64 generator)
+    /// \param value Value
+    static constexpr uint64_t getHash(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+private:
+    static constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+    static constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    static constexpr size_t getBucket(uint64_t hash)
+    {
+        return static_cast<size_t>(hash >> 32) % BUCKET_COUNT;
+    }
+
+    static constexpr size_t getSlot(uint64_t hash, size_t displacement)
+    {
+        // Step is odd, so all slots are visited, when displacement is incremented
+        const uint64_t step = (hash >> 16) | 1;
+        return static_cast<size_t>(hash + displacement * step) & (SLOT_COUNT - 1);
+    }
+
+    std::array<uint16_t, SLOT_COUNT> m_slots = { };
+    std::array<uint16_t, BUCKET_COUNT> m_displacements = { };
+};
+
 /// Storage for result of some operation. Stores, if operation was successful, or not and
 /// also error message, why operation has failed. Can be converted explicitly to bool.
 class PDFOperationResult
@@ -825,6 +1250,51 @@ QDataStream& operator<<(QDataStream& stream, const std::set<T>& set)
     return stream;
 }
 
+/// Spatial index of rectangles (for example, bounding boxes of annotations or
+/// page content elements), used for hit testing. Bounding box of all rectangles
+/// is divided into uniform grid of cells, and each cell contains indices of
+/// rectangles, which intersect the cell. So only items near the queried point
+/// (or rectangle) are tested, instead of all items. Items, which don't have
+/// fixed rectangle (for example, annotations, which are not zoomed or rotated
+/// with the page), are always returned by the queries.
+class PDF4QTLIBCORESHARED_EXPORT PDFSpatialIndex
+{
+public:
+    /// Builds the index from rectangles of the items
+    /// \param rectangles Rectangles of the items, std::nullopt means, that item
+    ///                   doesn't have fixed rectangle, and it is returned by all queries
+    void build(const std::vector<std::optional<QRectF>>& rectangles);
+
+    /// Returns indices of items, which rectangles can contain given point.
+    /// Indices are returned in increasing order.
+    /// \param point Point
+    std::vector<size_t> query(const QPointF& point) const;
+
+    /// Returns indices of items, which rectangles can intersect given rectangle.
+    /// Indices are returned in increasing order.
+    /// \param rectangle Rectangle
+    std::vector<size_t> query(const QRectF& rectangle) const;
+
+private:
+    /// Maximal count of grid columns (and rows)
+    static constexpr int MAX_GRID_SIZE = 32;
+
+    /// Average count of items in one cell of the grid
+    static constexpr size_t ITEMS_PER_CELL = 4;
+
+    /// Returns range of cells [first, last] intersecting the interval in one axis
+    std::pair<int, int> getCellRange(PDFReal min, PDFReal max, PDFReal gridMin, PDFReal cellSize, int cellCount) const;
+
+    /// Returns union of sorted indices and indices of items without rectangle
+    std::vector<size_t> merge(const std::vector<size_t>& indices) const;
+
+    QRectF m_bounds;
+    int m_columns = 0;
+    int m_rows = 0;
+    std::vector<std::vector<size_t>> m_cells;
+    std::vector<size_t> m_unboundedIndices;
+};
+
 /// Color scale represents hot-to-cold color scale. It maps value
 /// to the color from blue trough green to red.
 class PDF4QTLIBCORESHARED_EXPORT PDFColorScale
@@ -146,6 +146,19 @@ void PDFStatisticsCollector::visitReference(const PDFObjectReference reference)
     collectStatisticsOfSimpleObject(PDFObject::Type::Reference);
 }
 
+void PDFStatisticsCollector::merge(const PDFStatisticsCollector* other)
+{
+    for (size_t i = 0; i < m_statistics.size(); ++i)
+    {
+        const Statistics& otherStatistics = other->m_statistics[i];
+        Statistics& statistics = m_statistics[i];
+
+        statistics.count += otherStatistics.count.load(std::memory_order_relaxed);
+        statistics.memoryConsumptionEstimate += otherStatistics.memoryConsumptionEstimate.load(std::memory_order_relaxed);
+        statistics.memoryOverheadEstimate += otherStatistics.memoryOverheadEstimate.load(std::memory_order_relaxed);
+    }
+}
+
 void PDFStatisticsCollector::collectStatisticsOfDictionary(Statistics& statistics, const PDFDictionary* dictionary)
 {
     statistics.count += 1;
@@ -265,7 +278,7 @@ void PDFUpdateObjectVisitor::visitStream(const PDFStream* stream)
     m_objectStack.pop_back();
 
     PDFDictionary newDictionary(*dictionaryObject.getDictionary());
-    m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(qMove(newDictionary), QByteArray(*stream->getContent()))));
+    m_objectStack.push_back(PDFObject::createStream(std::make_shared<PDFStream>(qMove(newDictionary), QByteArray(*stream->getContent()), stream->getContentOwner())));
 }
 
 void PDFUpdateObjectVisitor::visitReference(const PDFObjectReference reference)
@@ -130,6 +130,11 @@ public:
 
     qint64 getObjectCount(PDFObject::Type type) const { return m_statistics[size_t(type)].count; }
 
+    /// Merges statistics collected by other collector (for example, collector
+    /// used by another thread) to this collector.
+    /// \param other Other collector
+    void merge(const PDFStatisticsCollector* other);
+
 private:
     void collectStatisticsOfSimpleObject(PDFObject::Type type);
     void collectStatisticsOfString(const PDFString* string, Statistics& statistics);
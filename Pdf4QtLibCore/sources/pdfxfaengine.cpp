@@ -30,6 +30,7 @@
 #include <QTextBlock>
 #include <QFontDatabase>
 #include <QAbstractTextDocumentLayout>
+#include <QCryptographicHash>
 #include <QtMath>
 
 #include "pdfdbgheap.h"
@@ -9684,11 +9685,20 @@ public:
     };
 
     using LayoutItems = std::vector<LayoutItem>;
+    using SharedLayoutItems = std::shared_ptr<const LayoutItems>;
+
+    /// Layout items of the single page. Items of the page area (master page)
+    /// are shared between all pages using the same page area.
+    struct PageLayoutItems
+    {
+        SharedLayoutItems pageAreaItems;
+        LayoutItems contentItems;
+    };
 
     std::vector<QSizeF> getPageSizes() const { return m_layout.pageSizes; }
 
     inline void setPageSizes(std::vector<QSizeF> pageSizes) { m_layout.pageSizes = std::move(pageSizes); }
-    inline void setLayoutItems(PDFInteger pageIndex, LayoutItems layoutItems) { m_layout.layoutItems[pageIndex] = std::move(layoutItems); }
+    inline void setLayoutItems(PDFInteger pageIndex, PageLayoutItems layoutItems) { m_layout.layoutItems[pageIndex] = std::move(layoutItems); }
     inline void setParagraphSettings(std::vector<xfa::XFA_ParagraphSettings> paragraphSettings) { m_layout.paragraphSettings = std::move(paragraphSettings); }
 
     void draw(const QTransform& pagePointToDevicePointMatrix,
@@ -9701,13 +9711,23 @@ private:
     struct Layout
     {
         std::vector<QSizeF> pageSizes;
-        std::map<PDFInteger, LayoutItems> layoutItems;
+        std::map<PDFInteger, PageLayoutItems> layoutItems;
         std::vector<xfa::XFA_ParagraphSettings> paragraphSettings;
     };
 
     void updateResources(const PDFObject& resources);
     void clear();
 
+    /// Reads XFA data (packets) from the XFA object of the form
+    /// \param xfaObject XFA object
+    std::map<QByteArray, QByteArray> readXFAData(const PDFObject& xfaObject) const;
+
+    /// Creates key identifying the template, so template parsing and layout
+    /// can be skipped, if template is not changed. Empty key is returned,
+    /// if XFA data doesn't contain template.
+    /// \param xfaData XFA data
+    static QByteArray createTemplateKey(const std::map<QByteArray, QByteArray>& xfaData);
+
     QMarginsF createMargin(const xfa::XFA_margin* margin);
 
     QColor createColor(const xfa::XFA_color* color) const;
@@ -9854,6 +9874,7 @@ private:
                          QPainter* painter);
 
     xfa::XFA_Node<xfa::XFA_template> m_template;
+    QByteArray m_templateKey;
     const PDFDocument* m_document;
     Layout m_layout;
     std::map<int, QByteArray> m_fonts;
@@ -10872,15 +10893,9 @@ void PDFXFALayoutEngine::performLayout(PDFXFAEngineImpl* engine, const xfa::XFA_
 
     pageSizes.reserve(layoutPerPage.size());
 
-    PDFInteger pageIndex = 0;
-    for (const auto& layoutSinglePage : layoutPerPage)
+    auto addLayoutItems = [](const std::vector<Layout>& layouts, PDFXFAEngineImpl::LayoutItems& layoutItems)
     {
-        PDFXFAEngineImpl::LayoutItems layoutItems;
-
-        const PageInfo& pageInfo = m_pages.at(layoutSinglePage.first);
-        pageSizes.push_back(pageInfo.mediaBox.size());
-
-        for (const Layout& layout : m_pageLayouts[pageInfo.pageArea])
+        for (const Layout& layout : layouts)
         {
             for (const LayoutItem& layoutItem : layout.items)
             {
@@ -10901,29 +10916,31 @@ void PDFXFALayoutEngine::performLayout(PDFXFAEngineImpl* engine, const xfa::XFA_
                 layoutItems.emplace_back(std::move(engineLayoutItem));
             }
         }
+    };
 
-        for (const Layout& layout : layoutSinglePage.second)
-        {
-            for (const LayoutItem& layoutItem : layout.items)
-            {
-                // Invisible item?
-                if (layoutItem.presence != xfa::XFA_BaseNode::PRESENCE::Visible)
-                {
-                    continue;
-                }
+    // Page areas are usually shared by many pages (large forms
+    // can have hundreds of pages with the same page area), so we create
+    // their layout items only once.
+    std::map<const xfa::XFA_pageArea*, PDFXFAEngineImpl::SharedLayoutItems> pageAreaLayoutItems;
 
-                PDFXFAEngineImpl::LayoutItem engineLayoutItem;
-                engineLayoutItem.nominalExtent = layoutItem.nominalExtent;
-                engineLayoutItem.draw = layoutItem.draw;
-                engineLayoutItem.field = layoutItem.field;
-                engineLayoutItem.subform = layoutItem.subform;
-                engineLayoutItem.exclGroup = layoutItem.exclGroup;
-                engineLayoutItem.paragraphSettingsIndex = layoutItem.paragraphSettingsIndex;
-                engineLayoutItem.captionParagraphSettingsIndex = layoutItem.captionParagraphSettingsIndex;
-                layoutItems.emplace_back(std::move(engineLayoutItem));
-            }
+    PDFInteger pageIndex = 0;
+    for (const auto& layoutSinglePage : layoutPerPage)
+    {
+        PDFXFAEngineImpl::PageLayoutItems layoutItems;
+
+        const PageInfo& pageInfo = m_pages.at(layoutSinglePage.first);
+        pageSizes.push_back(pageInfo.mediaBox.size());
+
+        PDFXFAEngineImpl::SharedLayoutItems& pageAreaItems = pageAreaLayoutItems[pageInfo.pageArea];
+        if (!pageAreaItems)
+        {
+            PDFXFAEngineImpl::LayoutItems items;
+            addLayoutItems(m_pageLayouts[pageInfo.pageArea], items);
+            pageAreaItems = std::make_shared<const PDFXFAEngineImpl::LayoutItems>(std::move(items));
         }
 
+        layoutItems.pageAreaItems = pageAreaItems;
+        addLayoutItems(layoutSinglePage.second, layoutItems.contentItems);
         engine->setLayoutItems(pageIndex++, std::move(layoutItems));
     }
 
@@ -11640,36 +11657,36 @@ void PDFXFAEngineImpl::setDocument(const PDFModifiedDocument& document, PDFForm*
 
         if (document.hasReset())
         {
-            clear();
-
+            std::map<QByteArray, QByteArray> xfaData;
             if (form->getFormType() == PDFForm::FormType::XFAForm)
             {
                 try
                 {
-                    const PDFObject& xfaObject = m_document->getObject(form->getXFA());
-                    updateResources(m_document->getObject(form->getResources()));
+                    xfaData = readXFAData(m_document->getObject(form->getXFA()));
+                }
+                catch (const PDFException&)
+                {
+                    xfaData.clear();
+                }
+            }
 
-                    std::map<QByteArray, QByteArray> xfaData;
-                    if (xfaObject.isArray())
-                    {
-                        const PDFArray* xfaArrayData = xfaObject.getArray();
-                        const size_t pairCount = xfaArrayData->getCount() / 2;
+            // Document is often reset, even if XFA data were not changed (for example,
+            // when document is modified by some tool). Parsing of the template
+            // and layout is expensive, so we reuse them, if XFA data are the same.
+            const QByteArray templateKey = createTemplateKey(xfaData);
+            if (!templateKey.isEmpty() && templateKey == m_templateKey)
+            {
+                updateResources(m_document->getObject(form->getResources()));
+                return;
+            }
 
-                        for (size_t i = 0; i < pairCount; ++i)
-                        {
-                            const PDFObject& itemName = m_document->getObject(xfaArrayData->getItem(2 * i + 0));
-                            const PDFObject& streamObject = m_document->getObject(xfaArrayData->getItem(2 * i + 1));
+            clear();
 
-                            if (itemName.isString() && streamObject.isStream())
-                            {
-                                xfaData[itemName.getString()] = m_document->getDecodedStream(streamObject.getStream());
-                            }
-                        }
-                    }
-                    else if (xfaObject.isStream())
-                    {
-                        xfaData["template"] = m_document->getDecodedStream(xfaObject.getStream());
-                    }
+            if (!xfaData.empty())
+            {
+                try
+                {
+                    updateResources(m_document->getObject(form->getResources()));
 
                     QDomDocument templateDocument;
                     if (templateDocument.setContent(xfaData["template"]))
@@ -11690,11 +11707,52 @@ void PDFXFAEngineImpl::setDocument(const PDFModifiedDocument& document, PDFForm*
             {
                 PDFXFALayoutEngine layoutEngine;
                 layoutEngine.performLayout(this, m_template.getValue());
+                m_templateKey = templateKey;
             }
         }
     }
 }
 
+std::map<QByteArray, QByteArray> PDFXFAEngineImpl::readXFAData(const PDFObject& xfaObject) const
+{
+    std::map<QByteArray, QByteArray> xfaData;
+
+    if (xfaObject.isArray())
+    {
+        const PDFArray* xfaArrayData = xfaObject.getArray();
+        const size_t pairCount = xfaArrayData->getCount() / 2;
+
+        for (size_t i = 0; i < pairCount; ++i)
+        {
+            const PDFObject& itemName = m_document->getObject(xfaArrayData->getItem(2 * i + 0));
+            const PDFObject& streamObject = m_document->getObject(xfaArrayData->getItem(2 * i + 1));
+
+            if (itemName.isString() && streamObject.isStream())
+            {
+                xfaData[itemName.getString()] = m_document->getDecodedStream(streamObject.getStream());
+            }
+        }
+    }
+    else if (xfaObject.isStream())
+    {
+        xfaData["template"] = m_document->getDecodedStream(xfaObject.getStream());
+    }
+
+    return xfaData;
+}
+
+QByteArray PDFXFAEngineImpl::createTemplateKey(const std::map<QByteArray, QByteArray>& xfaData)
+{
+    auto it = xfaData.find("template");
+    if (it == xfaData.cend())
+    {
+        return QByteArray();
+    }
+
+    // Only template is used for the layout
+    return QCryptographicHash::hash(it->second, QCryptographicHash::Sha256);
+}
+
 void PDFXFAEngineImpl::draw(const QTransform& pagePointToDevicePointMatrix,
                             const PDFPage* page,
                             QList<PDFRenderError>& errors,
@@ -11721,15 +11779,24 @@ void PDFXFAEngineImpl::draw(const QTransform& pagePointToDevicePointMatrix,
     painter->scale(1.0, -1.0);
     painter->fillRect(page->getMediaBox(), Qt::white);
 
-    const LayoutItems& items = it->second;
-    for (const LayoutItem& item : items)
+    auto drawItems = [&](const LayoutItems& items)
+    {
+        for (const LayoutItem& item : items)
+        {
+            PDFPainterStateGuard guard2(painter);
+            drawItemDraw(item.draw, errors, item.nominalExtent, item.paragraphSettingsIndex, item.captionParagraphSettingsIndex, painter);
+            drawItemField(item.field, errors, item.nominalExtent, item.paragraphSettingsIndex, item.captionParagraphSettingsIndex, painter);
+            drawItemSubform(item.subform, errors, item.nominalExtent, painter);
+            drawItemExclGroup(item.exclGroup, errors, item.nominalExtent, painter);
+        }
+    };
+
+    const PageLayoutItems& pageLayoutItems = it->second;
+    if (pageLayoutItems.pageAreaItems)
     {
-        PDFPainterStateGuard guard2(painter);
-        drawItemDraw(item.draw, errors, item.nominalExtent, item.paragraphSettingsIndex, item.captionParagraphSettingsIndex, painter);
-        drawItemField(item.field, errors, item.nominalExtent, item.paragraphSettingsIndex, item.captionParagraphSettingsIndex, painter);
-        drawItemSubform(item.subform, errors, item.nominalExtent, painter);
-        drawItemExclGroup(item.exclGroup, errors, item.nominalExtent, painter);
+        drawItems(*pageLayoutItems.pageAreaItems);
     }
+    drawItems(pageLayoutItems.contentItems);
 }
 
 void PDFXFAEngineImpl::updateResources(const PDFObject& resources)
@@ -13138,6 +13205,7 @@ void PDFXFAEngineImpl::clear()
 {
     // Clear the template
     m_template = xfa::XFA_Node<xfa::XFA_template>();
+    m_templateKey.clear();
     m_layout = Layout();
 
     for (const auto& font : m_fonts)
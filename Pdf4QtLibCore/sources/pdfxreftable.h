@@ -81,6 +81,10 @@ public:
     /// then free entry is returned.
     const Entry& getEntry(PDFObjectReference reference) const;
 
+    /// Returns entry for given object number (generation is not checked)
+    /// \param objectNumber Object number, must be valid
+    const Entry& getEntryByObjectNumber(PDFInteger objectNumber) const { return m_entries[objectNumber]; }
+
     /// Returns the trailer dictionary
     const PDFObject& getTrailerDictionary() const { return m_trailerDictionary; }
 
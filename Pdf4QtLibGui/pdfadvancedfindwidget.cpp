@@ -24,6 +24,7 @@
 #include "pdfdrawspacecontroller.h"
 
 #include <QMessageBox>
+#include <QtConcurrent/QtConcurrent>
 
 #include "pdfdbgheap.h"
 
@@ -40,8 +41,15 @@ PDFAdvancedFindWidget::PDFAdvancedFindWidget(pdf::PDFDrawWidgetProxy* proxy, QWi
 
     ui->resultsTableWidget->setHorizontalHeaderLabels({ tr("Page No."), tr("Phrase"), tr("Context") });
 
+    m_searchPhraseEditTimer.setSingleShot(true);
+    m_searchPhraseEditTimer.setInterval(SEARCH_PHRASE_EDIT_DELAY);
+
     connect(ui->regularExpressionsCheckbox, &QCheckBox::clicked, this, &PDFAdvancedFindWidget::updateUI);
-    connect(m_proxy, &pdf::PDFDrawWidgetProxy::textLayoutChanged, this, &PDFAdvancedFindWidget::performSearch);
+    connect(ui->searchPhraseEdit, &QLineEdit::textEdited, this, &PDFAdvancedFindWidget::onSearchPhraseEdited);
+    connect(&m_searchPhraseEditTimer, &QTimer::timeout, this, [this]() { startSearch(false); });
+    connect(&m_searchFutureWatcher, &QFutureWatcher<SearchChunkResult>::resultsReadyAt, this, &PDFAdvancedFindWidget::onSearchResultsReady);
+    connect(m_proxy, &pdf::PDFDrawWidgetProxy::textLayoutChanged, this, &PDFAdvancedFindWidget::onTextLayoutChanged);
+    connect(m_proxy->getTextLayoutCompiler(), &pdf::PDFAsynchronousTextLayoutCompiler::textLayoutPartiallyChanged, this, &PDFAdvancedFindWidget::onTextLayoutChanged);
     connect(ui->resultsTableWidget, &QTableWidget::cellDoubleClicked, this, &PDFAdvancedFindWidget::onResultItemDoubleClicked);
     connect(ui->resultsTableWidget, &QTableWidget::itemSelectionChanged, this, &PDFAdvancedFindWidget::onSelectionChanged);
     updateUI();
@@ -49,6 +57,8 @@ PDFAdvancedFindWidget::PDFAdvancedFindWidget(pdf::PDFDrawWidgetProxy* proxy, QWi
 
 PDFAdvancedFindWidget::~PDFAdvancedFindWidget()
 {
+    cancelSearch();
+    m_searchFutureWatcher.waitForFinished();
     delete ui;
 }
 
@@ -62,7 +72,8 @@ void PDFAdvancedFindWidget::setDocument(const pdf::PDFModifiedDocument& document
         // so, there is no need to clear the results.
         if (document.hasReset() || document.hasPageContentsChanged())
         {
-            m_findResults.clear();
+            clearResults();
+            m_textLayoutStorage.reset();
             updateUI();
             updateResultsUI();
         }
@@ -94,6 +105,27 @@ pdf::PDFTextSelection PDFAdvancedFindWidget::getSelectedText() const
 }
 
 void PDFAdvancedFindWidget::on_searchButton_clicked()
+{
+    m_searchPhraseEditTimer.stop();
+    startSearch(true);
+}
+
+void PDFAdvancedFindWidget::onSearchPhraseEdited()
+{
+    // Running search is cancelled immediately, new search is started,
+    // when user stops typing for a while.
+    cancelSearch();
+    m_searchPhraseEditTimer.start();
+}
+
+void PDFAdvancedFindWidget::onTextLayoutChanged()
+{
+    m_textLayoutStorage.reset();
+    m_pageGeometryCache.clear();
+    performSearch();
+}
+
+void PDFAdvancedFindWidget::startSearch(bool showErrors)
 {
     m_parameters.phrase = ui->searchPhraseEdit->text();
     m_parameters.isCaseSensitive = ui->caseSensitiveCheckBox->isChecked();
@@ -107,6 +139,7 @@ void PDFAdvancedFindWidget::on_searchButton_clicked()
     if (m_parameters.isSearchFinished)
     {
         // We have nothing to search for
+        cancelSearch();
         return;
     }
 
@@ -117,39 +150,43 @@ void PDFAdvancedFindWidget::on_searchButton_clicked()
         if (!expression.isValid())
         {
             m_parameters.isSearchFinished = true;
-            const int patternErrorOffset = expression.patternErrorOffset();
-            QMessageBox::critical(this, tr("Search error"), tr("Search phrase regular expression has error '%1' near symbol %2.").arg(expression.errorString()).arg(patternErrorOffset));
-            ui->searchPhraseEdit->setFocus();
-            ui->searchPhraseEdit->setSelection(patternErrorOffset, 1);
+            cancelSearch();
+
+            if (showErrors)
+            {
+                const int patternErrorOffset = expression.patternErrorOffset();
+                QMessageBox::critical(this, tr("Search error"), tr("Search phrase regular expression has error '%1' near symbol %2.").arg(expression.errorString()).arg(patternErrorOffset));
+                ui->searchPhraseEdit->setFocus();
+                ui->searchPhraseEdit->setSelection(patternErrorOffset, 1);
+            }
             return;
         }
     }
 
-    m_findResults.clear();
-    m_textSelection.dirty();
+    clearResults();
     updateResultsUI();
 
     pdf::PDFAsynchronousTextLayoutCompiler* compiler = m_proxy->getTextLayoutCompiler();
-    if (compiler->isTextLayoutReady())
-    {
-        performSearch();
-    }
-    else
+    if (!compiler->isTextLayoutReady())
     {
         compiler->makeTextLayout();
     }
+
+    // Search in already processed pages, if text layout is not ready yet
+    performSearch();
 }
 
 void PDFAdvancedFindWidget::on_clearButton_clicked()
 {
+    m_searchPhraseEditTimer.stop();
     m_parameters = SearchParameters();
-    m_findResults.clear();
+    clearResults();
     updateResultsUI();
 }
 
 void PDFAdvancedFindWidget::onSelectionChanged()
 {
-    m_textSelection.dirty();
+    invalidateTextSelection();
     m_proxy->repaintNeeded();
 }
 
@@ -175,23 +212,33 @@ void PDFAdvancedFindWidget::updateUI()
 
 void PDFAdvancedFindWidget::updateResultsUI()
 {
-    ui->tabWidget->setTabText(ui->tabWidget->indexOf(ui->resultsTab), !m_findResults.empty() ? tr("Results (%1)").arg(m_findResults.size()) : tr("Results"));
     ui->resultsTableWidget->setRowCount(static_cast<int>(m_findResults.size()));
 
     for (int i = 0, rowCount = int(m_findResults.size()); i < rowCount; ++i)
     {
-        const pdf::PDFFindResult& findResult = m_findResults[i];
-        ui->resultsTableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(findResult.textSelectionItems.front().first.pageIndex + 1)));
-        ui->resultsTableWidget->setItem(i, 1, new QTableWidgetItem(findResult.matched));
-        ui->resultsTableWidget->setItem(i, 2, new QTableWidgetItem(findResult.context));
+        setResultRowUI(i, m_findResults[i]);
     }
 
+    updateResultsTabUI();
+}
+
+void PDFAdvancedFindWidget::updateResultsTabUI()
+{
+    ui->tabWidget->setTabText(ui->tabWidget->indexOf(ui->resultsTab), !m_findResults.empty() ? tr("Results (%1)").arg(m_findResults.size()) : tr("Results"));
+
     if (!m_findResults.empty())
     {
         ui->tabWidget->setCurrentWidget(ui->resultsTab);
     }
 }
 
+void PDFAdvancedFindWidget::setResultRowUI(int row, const pdf::PDFFindResult& findResult)
+{
+    ui->resultsTableWidget->setItem(row, 0, new QTableWidgetItem(QString::number(findResult.textSelectionItems.front().first.pageIndex + 1)));
+    ui->resultsTableWidget->setItem(row, 1, new QTableWidgetItem(findResult.matched));
+    ui->resultsTableWidget->setItem(row, 2, new QTableWidgetItem(findResult.context));
+}
+
 void PDFAdvancedFindWidget::drawPage(QPainter* painter,
                                      pdf::PDFInteger pageIndex,
                                      const pdf::PDFPrecompiledPage* compiledPage,
@@ -203,9 +250,15 @@ void PDFAdvancedFindWidget::drawPage(QPainter* painter,
     Q_UNUSED(compiledPage);
     Q_UNUSED(errors);
 
-    const pdf::PDFTextSelection& textSelection = getTextSelection();
-    pdf::PDFTextSelectionPainter textSelectionPainter(&textSelection);
-    textSelectionPainter.draw(painter, pageIndex, layoutGetter, pagePointToDevicePointMatrix, convertor);
+    auto it = m_pageGeometryCache.find(pageIndex);
+    if (it == m_pageGeometryCache.end())
+    {
+        const pdf::PDFTextSelection& textSelection = getTextSelection();
+        pdf::PDFTextSelectionPainter textSelectionPainter(&textSelection);
+        it = m_pageGeometryCache.emplace(pageIndex, textSelectionPainter.preparePageGeometry(pageIndex, layoutGetter)).first;
+    }
+
+    pdf::PDFTextSelectionPainter::draw(painter, it->second, pagePointToDevicePointMatrix, convertor);
 }
 
 void PDFAdvancedFindWidget::performSearch()
@@ -215,30 +268,36 @@ void PDFAdvancedFindWidget::performSearch()
         return;
     }
 
-    m_parameters.isSearchFinished = true;
-
     pdf::PDFAsynchronousTextLayoutCompiler* compiler = m_proxy->getTextLayoutCompiler();
-    if (!compiler->isTextLayoutReady())
+    if (!m_textLayoutStorage)
     {
-        // Text layout is not ready yet
-        return;
+        const pdf::PDFTextLayoutStorage* textLayoutStorage = compiler->getTextLayoutStorage();
+        if (!textLayoutStorage)
+        {
+            // Text layout is not ready yet
+            return;
+        }
+
+        // Background search uses its own copy, so text layout
+        // compiler can replace its storage, while search is running.
+        m_textLayoutStorage = std::make_shared<const pdf::PDFTextLayoutStorage>(*textLayoutStorage);
     }
 
+    // If text layout is only partial (some pages are not processed yet),
+    // then search is performed again, when text layout is ready.
+    m_parameters.isSearchFinished = compiler->isTextLayoutReady();
+
+    // Pages, which were not searched by the running search, are searched
+    // by the new search, results found so far are kept.
+    cancelSearch();
+
     // Prepare string to search
     bool useRegularExpression = m_parameters.isRegularExpression;
     QString expression = m_parameters.phrase;
 
-    if (m_parameters.isWholeWordsOnly)
+    if (m_parameters.isWholeWordsOnly && useRegularExpression)
     {
-        if (useRegularExpression)
-        {
-            expression = QString("\\b%1\\b").arg(expression);
-        }
-        else
-        {
-            expression = QString("\\b%1\\b").arg(QRegularExpression::escape(expression));
-        }
-        useRegularExpression = true;
+        expression = QString("\\b%1\\b").arg(expression);
     }
 
     pdf::PDFTextFlow::FlowFlags flowFlags = pdf::PDFTextFlow::SeparateBlocks;
@@ -251,12 +310,29 @@ void PDFAdvancedFindWidget::performSearch()
         flowFlags |= pdf::PDFTextFlow::AddLineBreaks;
     }
 
-    const pdf::PDFTextLayoutStorage* textLayoutStorage = compiler->getTextLayoutStorage();
+    std::vector<pdf::PDFInteger> pageIndices;
+    std::function<pdf::PDFFindResults(const pdf::PDFTextLayoutStorage&, const std::vector<pdf::PDFInteger>&, const pdf::PDFOperationControl*)> find;
+
     if (!useRegularExpression)
     {
-        // Use simple text search
+        // Use simple text search (whole words search, if enabled)
         Qt::CaseSensitivity caseSensitivity = m_parameters.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-        m_findResults = textLayoutStorage->find(expression, caseSensitivity, flowFlags);
+        pageIndices = m_textLayoutStorage->getCandidatePages(expression, m_parameters.isWholeWordsOnly);
+
+        if (m_parameters.isWholeWordsOnly)
+        {
+            find = [expression, caseSensitivity, flowFlags](const pdf::PDFTextLayoutStorage& storage, const std::vector<pdf::PDFInteger>& pages, const pdf::PDFOperationControl* operationControl)
+            {
+                return storage.findWholeWords(pages, expression, caseSensitivity, flowFlags, operationControl);
+            };
+        }
+        else
+        {
+            find = [expression, caseSensitivity, flowFlags](const pdf::PDFTextLayoutStorage& storage, const std::vector<pdf::PDFInteger>& pages, const pdf::PDFOperationControl* operationControl)
+            {
+                return storage.find(pages, expression, caseSensitivity, flowFlags, operationControl);
+            };
+        }
     }
     else
     {
@@ -276,13 +352,146 @@ void PDFAdvancedFindWidget::performSearch()
         }
 
         QRegularExpression regularExpression(expression, patternOptions);
-        m_findResults = textLayoutStorage->find(regularExpression, flowFlags);
+        pageIndices = m_textLayoutStorage->getAllPages();
+        find = [regularExpression, flowFlags](const pdf::PDFTextLayoutStorage& storage, const std::vector<pdf::PDFInteger>& pages, const pdf::PDFOperationControl* operationControl)
+        {
+            return storage.find(pages, regularExpression, flowFlags, operationControl);
+        };
     }
 
-    m_textSelection.dirty();
+    // Skip pages, which were already searched, and pages, whose
+    // text layout is not ready yet (they are searched later).
+    m_searchedPages.resize(m_textLayoutStorage->getCount(), false);
+    auto isSkipped = [this](pdf::PDFInteger pageIndex) { return m_searchedPages[pageIndex] || !m_textLayoutStorage->hasTextLayout(pageIndex); };
+    pageIndices.erase(std::remove_if(pageIndices.begin(), pageIndices.end(), isSkipped), pageIndices.end());
+
+    if (pageIndices.empty())
+    {
+        return;
+    }
+
+    // Search pages near the visible pages first
+    std::vector<pdf::PDFInteger> activePages = m_proxy->getActivePages();
+    if (!activePages.empty())
+    {
+        auto [firstIt, lastIt] = std::minmax_element(activePages.cbegin(), activePages.cend());
+        const pdf::PDFInteger firstPage = *firstIt;
+        const pdf::PDFInteger lastPage = *lastIt;
+
+        auto getDistance = [firstPage, lastPage](pdf::PDFInteger pageIndex) -> pdf::PDFInteger
+        {
+            if (pageIndex < firstPage)
+            {
+                return firstPage - pageIndex;
+            }
+            if (pageIndex > lastPage)
+            {
+                return pageIndex - lastPage;
+            }
+            return 0;
+        };
+
+        std::stable_sort(pageIndices.begin(), pageIndices.end(), [&getDistance](pdf::PDFInteger l, pdf::PDFInteger r) { return getDistance(l) < getDistance(r); });
+    }
+
+    std::shared_ptr<SearchOperationControl> operationControl = std::make_shared<SearchOperationControl>();
+    m_searchOperationControl = operationControl;
+
+    auto search = [storage = m_textLayoutStorage, pageIndices = std::move(pageIndices), find = std::move(find), operationControl](QPromise<SearchChunkResult>& promise)
+    {
+        for (size_t i = 0; i < pageIndices.size() && !operationControl->isOperationCancelled(); i += SEARCH_CHUNK_PAGE_COUNT)
+        {
+            const size_t chunkEnd = qMin(i + SEARCH_CHUNK_PAGE_COUNT, pageIndices.size());
+
+            SearchChunkResult chunk;
+            chunk.pageIndices.assign(std::next(pageIndices.cbegin(), i), std::next(pageIndices.cbegin(), chunkEnd));
+            chunk.results = find(*storage, chunk.pageIndices, operationControl.get());
+
+            // Results of the cancelled search can be incomplete, discard them
+            if (!operationControl->isOperationCancelled())
+            {
+                promise.addResult(std::move(chunk));
+            }
+        }
+    };
+
+    m_searchFutureWatcher.setFuture(QtConcurrent::run(std::move(search)));
+}
+
+void PDFAdvancedFindWidget::cancelSearch()
+{
+    if (m_searchOperationControl)
+    {
+        m_searchOperationControl->cancel();
+        m_searchOperationControl.reset();
+    }
+}
+
+void PDFAdvancedFindWidget::clearResults()
+{
+    cancelSearch();
+    m_findResults.clear();
+    m_searchedPages.assign(m_searchedPages.size(), false);
+    invalidateTextSelection();
+    m_proxy->repaintNeeded();
+}
+
+void PDFAdvancedFindWidget::onSearchResultsReady(int beginIndex, int endIndex)
+{
+    for (int i = beginIndex; i < endIndex; ++i)
+    {
+        const SearchChunkResult chunk = m_searchFutureWatcher.resultAt(i);
+        addResults(chunk.pageIndices, chunk.results);
+    }
+
+    updateResultsTabUI();
     m_proxy->repaintNeeded();
+}
 
-    updateResultsUI();
+void PDFAdvancedFindWidget::addResults(const std::vector<pdf::PDFInteger>& pageIndices, const pdf::PDFFindResults& results)
+{
+    // Pages can be already searched, if search was restarted,
+    // while results of the previous search were pending.
+    std::vector<pdf::PDFInteger> newPageIndices;
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        if (pageIndex < pdf::PDFInteger(m_searchedPages.size()) && !m_searchedPages[pageIndex])
+        {
+            m_searchedPages[pageIndex] = true;
+            newPageIndices.push_back(pageIndex);
+            m_pageGeometryCache.erase(pageIndex);
+        }
+    }
+    std::sort(newPageIndices.begin(), newPageIndices.end());
+
+    bool hasNewResults = false;
+    for (const pdf::PDFFindResult& findResult : results)
+    {
+        const pdf::PDFInteger pageIndex = findResult.textSelectionItems.front().first.pageIndex;
+        if (!std::binary_search(newPageIndices.cbegin(), newPageIndices.cend(), pageIndex))
+        {
+            continue;
+        }
+
+        // Results are kept sorted, rows are inserted, so selection of the rows is preserved
+        auto it = std::upper_bound(m_findResults.begin(), m_findResults.end(), findResult);
+        const int row = static_cast<int>(std::distance(m_findResults.begin(), it));
+        m_findResults.insert(it, findResult);
+        ui->resultsTableWidget->insertRow(row);
+        setResultRowUI(row, findResult);
+        hasNewResults = true;
+    }
+
+    if (hasNewResults)
+    {
+        m_textSelection.dirty();
+    }
+}
+
+void PDFAdvancedFindWidget::invalidateTextSelection()
+{
+    m_textSelection.dirty();
+    m_pageGeometryCache.clear();
 }
 
 pdf::PDFTextSelection PDFAdvancedFindWidget::getTextSelectionImpl() const
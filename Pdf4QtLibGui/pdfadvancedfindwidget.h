@@ -21,8 +21,15 @@
 #include "pdfglobal.h"
 #include "pdfdrawspacecontroller.h"
 #include "pdftextlayout.h"
+#include "pdfoperationcontrol.h"
 
+#include <QTimer>
 #include <QWidget>
+#include <QFutureWatcher>
+
+#include <map>
+#include <atomic>
+#include <memory>
 
 namespace Ui
 {
@@ -71,17 +78,69 @@ private slots:
     void on_searchButton_clicked();
     void onSelectionChanged();
     void onResultItemDoubleClicked(int row, int column);
+    void onSearchPhraseEdited();
+    void onTextLayoutChanged();
+    void onSearchResultsReady(int beginIndex, int endIndex);
 
     void on_clearButton_clicked();
 
 private:
     void updateUI();
     void updateResultsUI();
+    void updateResultsTabUI();
+    void setResultRowUI(int row, const pdf::PDFFindResult& findResult);
+
+    /// Starts new search using parameters from the UI
+    /// \param showErrors Show errors of the search phrase to the user
+    void startSearch(bool showErrors);
+
+    /// Searches pages, which were not searched yet, in the background.
+    /// Pages near the visible pages are searched first, results are added
+    /// to the result table as they are found.
     void performSearch();
 
+    /// Cancels running background search, results found so far are kept
+    void cancelSearch();
+
+    /// Cancels running search and removes all results
+    void clearResults();
+
+    /// Adds results of the searched pages to the result table
+    /// \param pageIndices Searched pages
+    /// \param results Results found on these pages
+    void addResults(const std::vector<pdf::PDFInteger>& pageIndices, const pdf::PDFFindResults& results);
+
+    /// Invalidates text selection of the results and cached highlight geometry
+    void invalidateTextSelection();
+
     pdf::PDFTextSelection getTextSelection() const { return m_textSelection.get(this, &PDFAdvancedFindWidget::getTextSelectionImpl); }
     pdf::PDFTextSelection getTextSelectionImpl() const;
 
+    /// Number of pages searched at once by the background search,
+    /// results are added to the result table after each chunk.
+    static constexpr size_t SEARCH_CHUNK_PAGE_COUNT = 8;
+
+    /// Delay of the search after search phrase is edited [ms]
+    static constexpr int SEARCH_PHRASE_EDIT_DELAY = 250;
+
+    /// Operation control of the background search, each search has its own,
+    /// so newly started search isn't affected by cancelling the old one.
+    class SearchOperationControl : public pdf::PDFOperationControl
+    {
+    public:
+        void cancel() { m_isCancelled = true; }
+        virtual bool isOperationCancelled() const override { return m_isCancelled; }
+
+    private:
+        std::atomic_bool m_isCancelled = false;
+    };
+
+    struct SearchChunkResult
+    {
+        std::vector<pdf::PDFInteger> pageIndices;
+        pdf::PDFFindResults results;
+    };
+
     struct SearchParameters
     {
         QString phrase;
@@ -101,6 +160,18 @@ private:
     SearchParameters m_parameters;
     pdf::PDFFindResults m_findResults;
     mutable pdf::PDFCachedItem<pdf::PDFTextSelection> m_textSelection;
+
+    /// Highlight geometry of the results in page space, it is created,
+    /// when page is drawn for the first time, and reused for other zooms.
+    mutable std::map<pdf::PDFInteger, pdf::PDFTextSelectionPainter::PageGeometry> m_pageGeometryCache;
+
+    /// Snapshot of the text layout storage used by the background search
+    /// (it is replaced, when text layout is changed).
+    std::shared_ptr<const pdf::PDFTextLayoutStorage> m_textLayoutStorage;
+    std::shared_ptr<SearchOperationControl> m_searchOperationControl;
+    QFutureWatcher<SearchChunkResult> m_searchFutureWatcher;
+    std::vector<bool> m_searchedPages;
+    QTimer m_searchPhraseEditTimer;
 };
 
 }   // namespace pdfviewer
@@ -26,6 +26,7 @@
 #include "pdfimageconversion.h"
 #include "pdfstreamfilters.h"
 #include "pdfutils.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QCheckBox>
 #include <QPushButton>
@@ -38,6 +39,8 @@
 #include <QMouseEvent>
 #include <QToolTip>
 
+#include <cstring>
+
 #include "pdfdbgheap.h"
 
 namespace pdfviewer
@@ -285,7 +288,11 @@ void PDFCreateBitonalDocumentDialog::createBitonalDocument()
     pdf::PDFCMSGeneric genericCms;
     pdf::PDFRenderErrorReporterDummy errorReporter;
 
-    for (int i = 0; i < imagesToBeConverted.size(); ++i)
+    // Images are converted in parallel, converted image objects
+    // are then stored into the object storage in single thread.
+    std::vector<pdf::PDFObject> imageObjects(imagesToBeConverted.size());
+
+    auto convertImage = [&](size_t i)
     {
         pdf::PDFObjectReference reference = imagesToBeConverted[i].imageReference;
         std::optional<pdf::PDFImage> pdfImage = getImageFromReference(reference);
@@ -303,7 +310,8 @@ void PDFCreateBitonalDocumentDialog::createBitonalDocument()
         // Just for code safety - this should never occur in here.
         if (image.isNull())
         {
-            continue;
+            m_progress->step();
+            return;
         }
 
         pdf::PDFImageConversion imageConversion;
@@ -316,22 +324,16 @@ void PDFCreateBitonalDocumentDialog::createBitonalDocument()
             QImage bitonalImage = imageConversion.getConvertedImage();
             Q_ASSERT(bitonalImage.format() == QImage::Format_Mono);
 
-            pdf::PDFBitWriter bitWriter(1);
-            bitWriter.reserve(bitonalImage.sizeInBytes());
+            // Scanlines of Format_Mono image are already packed, most significant
+            // bit first, with value 1 for white color (color table is black/white),
+            // so we just copy them without the scanline alignment.
+            const int bytesPerLine = (bitonalImage.width() + 7) / 8;
+            QByteArray imageData(bytesPerLine * bitonalImage.height(), Qt::Uninitialized);
             for (int row = 0; row < bitonalImage.height(); ++row)
             {
-                for (int col = 0; col < bitonalImage.width(); ++col)
-                {
-                    QRgb pixelValue = bitonalImage.pixel(col, row);
-                    QRgb withoutAlphaValue = pixelValue & 0xFFFFFF;
-                    int value = withoutAlphaValue > 0 ? 1 : 0;
-                    bitWriter.write(value);
-                }
-
-                bitWriter.finishLine();
+                std::memcpy(imageData.data() + row * bytesPerLine, bitonalImage.constScanLine(row), bytesPerLine);
             }
 
-            QByteArray imageData = bitWriter.takeByteArray();
             QByteArray compressedData = pdf::PDFFlateDecodeFilter::compress(imageData);
 
             pdf::PDFArray array;
@@ -348,11 +350,21 @@ void PDFCreateBitonalDocumentDialog::createBitonalDocument()
             dictionary.setEntry(pdf::PDFInplaceOrMemoryString("Length"), pdf::PDFObject::createInteger(compressedData.size()));
             dictionary.setEntry(pdf::PDFInplaceOrMemoryString("Filter"), pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(qMove(array))));
 
-            pdf::PDFObject imageObject = pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(compressedData)));
-            storage.setObject(reference, std::move(imageObject));
+            imageObjects[i] = pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(compressedData)));
         }
 
         m_progress->step();
+    };
+
+    auto range = pdf::PDFIntegerRange<size_t>(0, imagesToBeConverted.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), convertImage);
+
+    for (size_t i = 0; i < imagesToBeConverted.size(); ++i)
+    {
+        if (!imageObjects[i].isNull())
+        {
+            storage.setObject(imagesToBeConverted[i].imageReference, std::move(imageObjects[i]));
+        }
     }
 
     m_bitonalDocument = pdf::PDFDocument(std::move(storage), m_document->getInfo()->version, QByteArray());
@@ -56,6 +56,13 @@ PDFOptimizeDocumentDialog::PDFOptimizeDocumentDialog(const pdf::PDFDocument* doc
     addCheckBox(tr("Merge identical objects"), pdf::PDFOptimizer::MergeIdenticalObjects);
     addCheckBox(tr("Shrink object storage (squeeze free entries)"), pdf::PDFOptimizer::ShrinkObjectStorage);
     addCheckBox(tr("Recompress flate streams by maximal compression"), pdf::PDFOptimizer::RecompressFlateStreams);
+    addCheckBox(tr("Merge images with identical pixels"), pdf::PDFOptimizer::MergeIdenticalImages);
+    addCheckBox(tr("Downsample images above %1 DPI to %2 DPI").arg(m_optimizer.getImageSettings().thresholdDpi).arg(m_optimizer.getImageSettings().targetDpi), pdf::PDFOptimizer::DownsampleImages);
+    addCheckBox(tr("Recompress photographic images to JPEG (quality %1)").arg(m_optimizer.getImageSettings().jpegQuality), pdf::PDFOptimizer::RecompressImagesToJPEG);
+    addCheckBox(tr("Store black and white images as 1-bit images"), pdf::PDFOptimizer::CompressBilevelImages);
+    addCheckBox(tr("Merge identical embedded fonts"), pdf::PDFOptimizer::MergeIdenticalFonts);
+    addCheckBox(tr("Subset embedded TrueType fonts to used glyphs"), pdf::PDFOptimizer::SubsetFonts);
+    addCheckBox(tr("Optimize content streams"), pdf::PDFOptimizer::OptimizeContentStreams);
 
     m_optimizeButton = ui->buttonBox->addButton(tr("Optimize"), QDialogButtonBox::ActionRole);
 
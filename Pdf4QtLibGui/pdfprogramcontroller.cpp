@@ -44,9 +44,13 @@
 #include "pdfwidgetannotation.h"
 #include "pdfwidgetformmanager.h"
 #include "pdfactioncombobox.h"
+#include "pdfmemorybudget.h"
+#include "pdfprintpipeline.h"
 
 #include <QMenu>
 #include <QPrinter>
+#include <QEventLoop>
+#include <QProgressDialog>
 #include <QPrintDialog>
 #include <QMessageBox>
 #include <QDesktopServices>
@@ -59,6 +63,11 @@
 #include <QXmlStreamWriter>
 #include <QMenuBar>
 #include <QComboBox>
+#include <QPluginLoader>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QLocale>
 
 #include "pdfdbgheap.h"
 
@@ -371,12 +380,17 @@ PDFProgramController::PDFProgramController(QObject* parent) :
     m_formManager(nullptr),
     m_bookmarkManager(nullptr),
     m_actionComboBox(nullptr),
+    m_hibernationTimer(new QTimer(this)),
     m_isBusy(false),
     m_isFactorySettingsBeingRestored(false),
     m_progress(nullptr),
     m_loadAllPlugins(false)
 {
+    m_startupTimer.start();
     connect(&m_fileWatcher, &QFileSystemWatcher::fileChanged, this, &PDFProgramController::onFileChanged);
+
+    m_hibernationTimer->setSingleShot(true);
+    connect(m_hibernationTimer, &QTimer::timeout, this, &PDFProgramController::onHibernationTimeout);
 }
 
 PDFProgramController::~PDFProgramController()
@@ -624,12 +638,16 @@ void PDFProgramController::initialize(Features features,
         }
     }
 
+    addStartupStage(tr("Actions"));
     readSettings(Settings(GeneralSettings | PluginsSettings | RecentFileSettings | CertificateSettings));
+    addStartupStage(tr("Settings"));
 
     m_pdfWidget = new pdf::PDFWidget(m_CMSManager, m_settings->getRendererEngine(), m_mainWindow);
     m_pdfWidget->setObjectName("pdfWidget");
     m_pdfWidget->updateCacheLimits(m_settings->getCompiledPageCacheLimit() * 1024, m_settings->getThumbnailsCacheLimit(), m_settings->getFontCacheLimit(), m_settings->getInstancedFontCacheLimit());
+    pdf::PDFMemoryBudget::getInstance()->setBudget(qint64(m_settings->getMemoryBudget()) * 1024 * 1024);
     m_pdfWidget->getDrawWidgetProxy()->setProgress(m_progress);
+    m_mainWindow->installEventFilter(this);
 
     connect(this, &PDFProgramController::queryPasswordRequest, this, &PDFProgramController::onQueryPasswordRequest, Qt::BlockingQueuedConnection);
     connect(m_pdfWidget->getDrawWidgetProxy(), &pdf::PDFDrawWidgetProxy::drawSpaceChanged, this, &PDFProgramController::onDrawSpaceChanged);
@@ -645,6 +663,7 @@ void PDFProgramController::initialize(Features features,
         m_textToSpeech->setSettings(m_settings);
     }
 
+    addStartupStage(tr("Widget"));
     initializeAnnotationManager();
     initializeBookmarkManager();
 
@@ -669,9 +688,12 @@ void PDFProgramController::initialize(Features features,
         updateUndoRedoSettings();
     }
 
+    addStartupStage(tr("Managers"));
+
     if (features.testFlag(Plugins))
     {
         loadPlugins();
+        addStartupStage(tr("Plugins"));
     }
 }
 
@@ -706,6 +728,25 @@ void PDFProgramController::finishInitialization()
     m_mainWindowInterface->updateUI(true);
     onViewerSettingsChanged();
     updateActionsAvailability();
+    addStartupStage(tr("Finish initialization"));
+}
+
+void PDFProgramController::addStartupStage(const QString& stage)
+{
+    const qint64 time = m_startupTimer.elapsed();
+    m_startupStages.emplace_back(stage, time - m_lastStartupStageTime);
+    m_lastStartupStageTime = time;
+}
+
+QString PDFProgramController::getStartupReport() const
+{
+    QString report = tr("Startup time report") + "\n";
+    for (const auto& stage : m_startupStages)
+    {
+        report += QString("%1: %2 ms\n").arg(stage.first, -32).arg(stage.second, 6);
+    }
+    report += QString("%1: %2 ms\n").arg(tr("Total"), -32).arg(m_lastStartupStageTime, 6);
+    return report;
 }
 
 void PDFProgramController::performPrint()
@@ -770,45 +811,81 @@ void PDFProgramController::performPrint()
             return;
         }
 
-        pdf::ProgressStartupInfo info;
-        info.showDialog = true;
-        info.text = tr("Printing document");
-        m_progress->start(pageIndices.size(), qMove(info));
         printer.setFullPage(true);
         QPainter painter(&printer);
 
-        const pdf::PDFCatalog* catalog = m_pdfDocument->getCatalog();
         pdf::PDFDrawWidgetProxy* proxy = m_pdfWidget->getDrawWidgetProxy();
         pdf::PDFOptionalContentActivity optionalContentActivity(m_pdfDocument.data(), pdf::OCUsage::Print, nullptr);
         pdf::PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
-        pdf::PDFRenderer renderer(m_pdfDocument.get(), proxy->getFontCache(), cms.data(), &optionalContentActivity, proxy->getFeatures(), proxy->getMeshQualitySettings());
 
-        const pdf::PDFInteger lastPage = pageIndices.back();
-        for (const pdf::PDFInteger pageIndex : pageIndices)
+        const QRectF paperRect = printer.pageLayout().fullRectPixels(printer.resolution());
+        auto getPageRectangle = [paperRect](const pdf::PDFPage* page)
         {
-            const pdf::PDFPage* page = catalog->getPage(pageIndex);
-            Q_ASSERT(page);
-
             QRectF mediaBox = page->getRotatedMediaBox();
-            QRectF paperRect = printer.pageLayout().fullRectPixels(printer.resolution());
             QSizeF scaledSize = mediaBox.size().scaled(paperRect.size(), Qt::KeepAspectRatio);
             mediaBox.setSize(scaledSize);
             mediaBox.moveCenter(paperRect.center());
+            return mediaBox;
+        };
 
-            renderer.render(&painter, mediaBox, pageIndex);
-            m_progress->step();
+        QProgressDialog progressDialog(tr("Printing document..."), tr("Cancel"), 0, int(pageIndices.size()), m_mainWindow);
+        progressDialog.setWindowModality(Qt::WindowModal);
+        progressDialog.setMinimumDuration(0);
+        progressDialog.setValue(0);
 
-            if (pageIndex != lastPage)
+        // Pages are compiled (and rasterized, if enabled) ahead in worker threads,
+        // printer is fed with prepared pages in order from the event loop, so
+        // user interface is responsive and printing can be cancelled.
+        pdf::PDFPrintPipeline pipeline(m_pdfDocument.get(), proxy->getFontCache(), cms.data(), &optionalContentActivity, proxy->getFeatures(), proxy->getMeshQualitySettings(), nullptr);
+        pipeline.setRasterizationEnabled(m_settings->getSettings().m_printPagesAsImages);
+
+        QEventLoop eventLoop;
+        bool isFirstPage = true;
+        bool isCancelled = false;
+        int printedPageCount = 0;
+
+        auto printPreparedPages = [&]()
+        {
+            while (std::optional<pdf::PDFPrintPipeline::PreparedPage> page = pipeline.takeNextPage())
             {
-                if (!printer.newPage())
+                if (!isFirstPage && !printer.newPage())
                 {
+                    isCancelled = true;
+                    pipeline.cancel();
                     break;
                 }
+
+                isFirstPage = false;
+                pipeline.drawPage(&painter, *page);
+                ++printedPageCount;
+            }
+
+            if (pipeline.isFinished())
+            {
+                eventLoop.quit();
             }
+
+            progressDialog.setValue(printedPageCount);
+        };
+
+        auto cancelPrinting = [&]()
+        {
+            isCancelled = true;
+            pipeline.cancel();
+            eventLoop.quit();
+        };
+
+        connect(&pipeline, &pdf::PDFPrintPipeline::pageReady, &eventLoop, printPreparedPages, Qt::QueuedConnection);
+        connect(&progressDialog, &QProgressDialog::canceled, &eventLoop, cancelPrinting);
+        pipeline.start(qMove(pageIndices), getPageRectangle);
+        eventLoop.exec();
+
+        if (isCancelled)
+        {
+            printer.abort();
         }
 
         painter.end();
-        m_progress->finish();
     }
 }
 
@@ -1694,6 +1771,16 @@ void PDFProgramController::updateActionsAvailability()
     m_actionManager->setEnabled(PDFActionManager::SaveAs, hasValidDocument);
     m_actionManager->setEnabled(PDFActionManager::Properties, hasDocument);
     m_actionManager->setEnabled(PDFActionManager::SendByMail, hasDocument);
+
+    // Real state of plugin actions is not known until the plugin is loaded
+    for (const auto& pluginProxyActions : m_pluginProxyActions)
+    {
+        for (QAction* action : pluginProxyActions.second)
+        {
+            action->setEnabled(hasValidDocument || action->property("isEnabledWithoutDocument").toBool());
+        }
+    }
+
     m_mainWindow->setEnabled(!isBusy);
     updateUndoRedoActions();
 }
@@ -1702,6 +1789,7 @@ void PDFProgramController::onViewerSettingsChanged()
 {
     m_pdfWidget->updateRenderer(m_settings->getRendererEngine());
     m_pdfWidget->updateCacheLimits(m_settings->getCompiledPageCacheLimit() * 1024, m_settings->getThumbnailsCacheLimit(), m_settings->getFontCacheLimit(), m_settings->getInstancedFontCacheLimit());
+    pdf::PDFMemoryBudget::getInstance()->setBudget(qint64(m_settings->getMemoryBudget()) * 1024 * 1024);
     m_pdfWidget->getDrawWidgetProxy()->setFeatures(m_settings->getFeatures());
     m_pdfWidget->getDrawWidgetProxy()->setPreferredMeshResolutionRatio(m_settings->getPreferredMeshResolutionRatio());
     m_pdfWidget->getDrawWidgetProxy()->setMinimalMeshResolutionRatio(m_settings->getMinimalMeshResolutionRatio());
@@ -1711,6 +1799,58 @@ void PDFProgramController::onViewerSettingsChanged()
     pdf::PDFExecutionPolicy::setStrategy(m_settings->getMultithreadingStrategy());
 
     updateRenderingOptionActions();
+    updateHibernationTimer();
+}
+
+bool PDFProgramController::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == m_mainWindow)
+    {
+        switch (event->type())
+        {
+            case QEvent::WindowActivate:
+            {
+                // Warm up the document, visible pages are compiled first
+                m_hibernationTimer->stop();
+                m_pdfWidget->getDrawWidgetProxy()->setHibernated(false);
+                break;
+            }
+
+            case QEvent::WindowDeactivate:
+                updateHibernationTimer();
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return BaseClass::eventFilter(watched, event);
+}
+
+void PDFProgramController::updateHibernationTimer()
+{
+    const int hibernationTimeout = m_settings->getHibernationTimeout();
+    if (hibernationTimeout > 0 && m_pdfDocument && !m_mainWindow->isActiveWindow())
+    {
+        m_hibernationTimer->start(hibernationTimeout * 60 * 1000);
+    }
+    else
+    {
+        m_hibernationTimer->stop();
+    }
+}
+
+void PDFProgramController::onHibernationTimeout()
+{
+    if (m_isBusy || !m_pdfDocument || m_mainWindow->isActiveWindow())
+    {
+        // Document is being used, try it again later
+        updateHibernationTimer();
+        return;
+    }
+
+    m_pdfWidget->getDrawWidgetProxy()->setHibernated(true);
 }
 
 void PDFProgramController::onColorManagementSystemChanged()
@@ -2181,71 +2321,321 @@ void PDFProgramController::loadPlugins()
     static_assert(false, "Implement this for another OS!");
 #endif
 
+    PluginActionCache actionCache = readPluginActionCache();
+    bool isActionCacheChanged = false;
+    const QString locale = QLocale().name();
+
+    pdf::PDFPluginInfos enabledPlugins;
     for (const QString& availablePlugin : availablePlugins)
     {
+        // Metadata are read from the plugin file, library is not loaded
         QString pluginFileName = directory.absoluteFilePath(availablePlugin);
         QPluginLoader loader(pluginFileName);
-        if (loader.load())
+        QJsonObject metaData = loader.metaData();
+        if (metaData.isEmpty())
         {
-            QJsonObject metaData = loader.metaData();
-            m_plugins.emplace_back(pdf::PDFPluginInfo::loadFromJson(&metaData));
-            m_plugins.back().pluginFile = availablePlugin;
-            m_plugins.back().pluginFileWithPath = pluginFileName;
+            continue;
+        }
 
-            QString pluginName = m_plugins.back().name;
-            if (!m_enabledPlugins.contains(pluginName) && !m_loadAllPlugins)
-            {
-                loader.unload();
-                continue;
-            }
+        m_plugins.emplace_back(pdf::PDFPluginInfo::loadFromJson(&metaData));
+        m_plugins.back().pluginFile = availablePlugin;
+        m_plugins.back().pluginFileWithPath = pluginFileName;
 
-            if (m_loadAllPlugins)
-            {
-                m_enabledPlugins << pluginName;
-            }
+        QString pluginName = m_plugins.back().name;
+        if (!m_enabledPlugins.contains(pluginName) && !m_loadAllPlugins)
+        {
+            continue;
+        }
 
-            pdf::PDFPlugin* plugin = qobject_cast<pdf::PDFPlugin*>(loader.instance());
-            if (plugin)
-            {
-                m_loadedPlugins.push_back(std::make_pair(m_plugins.back(), plugin));
-            }
+        if (m_loadAllPlugins)
+        {
+            m_enabledPlugins << pluginName;
         }
+
+        enabledPlugins.push_back(m_plugins.back());
     }
     m_loadAllPlugins = false;
 
-    auto comparator = [](const std::pair<pdf::PDFPluginInfo, pdf::PDFPlugin*>& l, const std::pair<pdf::PDFPluginInfo, pdf::PDFPlugin*>& r)
+    auto comparator = [](const pdf::PDFPluginInfo& l, const pdf::PDFPluginInfo& r)
     {
-        return l.first.name < r.first.name;
+        return l.name < r.name;
     };
-    std::sort(m_loadedPlugins.begin(), m_loadedPlugins.end(), comparator);
+    std::sort(enabledPlugins.begin(), enabledPlugins.end(), comparator);
 
-    for (const auto& plugin : m_loadedPlugins)
+    for (const pdf::PDFPluginInfo& pluginInfo : enabledPlugins)
     {
-        plugin.second->setDataExchangeInterface(this);
-        plugin.second->setWidget(m_pdfWidget);
-        plugin.second->setCMSManager(m_CMSManager);
-        std::vector<QAction*> actions = plugin.second->getActions();
+        QFileInfo pluginFileInfo(pluginInfo.pluginFileWithPath);
 
-        if (!actions.empty())
+        auto it = actionCache.find(pluginInfo.pluginFileWithPath);
+        if (it != actionCache.cend() &&
+            it->second.lastModified == pluginFileInfo.lastModified() &&
+            it->second.fileSize == pluginFileInfo.size() &&
+            it->second.locale == locale)
         {
-            QToolBar* toolBar = m_mainWindow->addToolBar(plugin.first.name);
-            toolBar->setObjectName(QString("Plugin_Toolbar_%1").arg(plugin.first.name));
-            m_mainWindowInterface->adjustToolbar(toolBar);
-            QMenu* menu = m_mainWindowInterface->addToolMenu(plugin.second->getPluginMenuName());
-            for (QAction* action : actions)
+            // Plugin is loaded, when some of its actions is used for the first time
+            std::vector<QAction*> proxyActions;
+            for (const PluginActionInfo& actionInfo : it->second.actions)
             {
-                if (!action)
+                if (actionInfo.isSeparator)
                 {
-                    menu->addSeparator();
-                    toolBar->addSeparator();
+                    proxyActions.push_back(nullptr);
                     continue;
                 }
 
-                m_actionManager->addAdditionalAction(action);
+                QAction* proxyAction = new QAction(actionInfo.icon, actionInfo.text, this);
+                proxyAction->setObjectName(actionInfo.objectName);
+                proxyAction->setToolTip(actionInfo.toolTip);
+                proxyAction->setCheckable(actionInfo.isCheckable);
+                proxyAction->setProperty("pluginName", pluginInfo.name);
+                proxyAction->setProperty("isEnabledWithoutDocument", actionInfo.isEnabledWithoutDocument);
+                connect(proxyAction, &QAction::triggered, this, [this, proxyAction]() { onPluginProxyActionTriggered(proxyAction); });
+                proxyActions.push_back(proxyAction);
+                m_pluginProxyActions[pluginInfo.name].push_back(proxyAction);
+            }
+
+            addPluginActions(pluginInfo.name, it->second.menuName, proxyActions);
+            continue;
+        }
+
+        pdf::PDFPlugin* plugin = instantiatePlugin(pluginInfo);
+        if (!plugin)
+        {
+            continue;
+        }
+
+        std::vector<QAction*> actions = plugin->getActions();
+        addPluginActions(pluginInfo.name, plugin->getPluginMenuName(), actions);
+
+        // Remember actions of the plugin, so plugin need not be loaded next time
+        PluginActionCacheEntry entry;
+        entry.lastModified = pluginFileInfo.lastModified();
+        entry.fileSize = pluginFileInfo.size();
+        entry.locale = locale;
+        entry.menuName = plugin->getPluginMenuName();
+
+        for (const QAction* action : actions)
+        {
+            PluginActionInfo actionInfo;
+            actionInfo.isSeparator = !action;
+
+            if (action)
+            {
+                actionInfo.isCheckable = action->isCheckable();
+                actionInfo.isEnabledWithoutDocument = action->isEnabled();
+                actionInfo.objectName = action->objectName();
+                actionInfo.text = action->text();
+                actionInfo.toolTip = action->toolTip();
+                actionInfo.icon = action->icon();
+            }
+
+            entry.actions.push_back(qMove(actionInfo));
+        }
+
+        actionCache[pluginInfo.pluginFileWithPath] = qMove(entry);
+        isActionCacheChanged = true;
+    }
+
+    if (isActionCacheChanged)
+    {
+        writePluginActionCache(actionCache);
+    }
+}
+
+pdf::PDFPlugin* PDFProgramController::instantiatePlugin(const pdf::PDFPluginInfo& pluginInfo)
+{
+    QPluginLoader loader(pluginInfo.pluginFileWithPath);
+    pdf::PDFPlugin* plugin = qobject_cast<pdf::PDFPlugin*>(loader.instance());
+
+    if (!plugin)
+    {
+        return nullptr;
+    }
+
+    m_loadedPlugins.push_back(std::make_pair(pluginInfo, plugin));
+
+    plugin->setDataExchangeInterface(this);
+    plugin->setWidget(m_pdfWidget);
+    plugin->setCMSManager(m_CMSManager);
+
+    if (m_pdfDocument)
+    {
+        plugin->setDocument(pdf::PDFModifiedDocument(m_pdfDocument, m_optionalContentActivity));
+    }
+
+    return plugin;
+}
+
+void PDFProgramController::addPluginActions(const QString& pluginName, const QString& menuName, const std::vector<QAction*>& actions)
+{
+    if (actions.empty())
+    {
+        return;
+    }
+
+    QToolBar* toolBar = m_mainWindow->addToolBar(pluginName);
+    toolBar->setObjectName(QString("Plugin_Toolbar_%1").arg(pluginName));
+    m_mainWindowInterface->adjustToolbar(toolBar);
+    QMenu* menu = m_mainWindowInterface->addToolMenu(menuName);
+    for (QAction* action : actions)
+    {
+        if (!action)
+        {
+            menu->addSeparator();
+            toolBar->addSeparator();
+            continue;
+        }
+
+        m_actionManager->addAdditionalAction(action);
+
+        menu->addAction(action);
+        toolBar->addAction(action);
+    }
+}
+
+void PDFProgramController::onPluginProxyActionTriggered(QAction* proxyAction)
+{
+    const QString pluginName = proxyAction->property("pluginName").toString();
+
+    auto isPlugin = [&pluginName](const auto& plugin) { return plugin.first.name == pluginName; };
+    auto it = std::find_if(m_loadedPlugins.cbegin(), m_loadedPlugins.cend(), isPlugin);
+    pdf::PDFPlugin* plugin = it != m_loadedPlugins.cend() ? it->second : nullptr;
+
+    if (!plugin)
+    {
+        auto pluginInfoIt = std::find_if(m_plugins.cbegin(), m_plugins.cend(), [&pluginName](const auto& info) { return info.name == pluginName; });
+        if (pluginInfoIt != m_plugins.cend())
+        {
+            plugin = instantiatePlugin(*pluginInfoIt);
+        }
+
+        if (!plugin)
+        {
+            QMessageBox::critical(m_mainWindow, QApplication::applicationDisplayName(), tr("Plugin '%1' can't be loaded.").arg(pluginName));
+            return;
+        }
+
+        // Proxy actions now mirror the state of the plugin actions
+        const std::vector<QAction*> proxyActions = qMove(m_pluginProxyActions[pluginName]);
+        m_pluginProxyActions.erase(pluginName);
+
+        for (QAction* action : plugin->getActions())
+        {
+            auto proxyIt = std::find_if(proxyActions.cbegin(), proxyActions.cend(), [action](QAction* proxy) { return action && proxy->objectName() == action->objectName(); });
+            if (proxyIt == proxyActions.cend())
+            {
+                continue;
+            }
+
+            QAction* proxy = *proxyIt;
+            auto updateProxy = [action, proxy]()
+            {
+                proxy->setEnabled(action->isEnabled());
+                proxy->setChecked(action->isChecked());
+                proxy->setVisible(action->isVisible());
+                proxy->setText(action->text());
+                proxy->setToolTip(action->toolTip());
+            };
+            connect(action, &QAction::changed, proxy, updateProxy);
+            updateProxy();
+        }
+    }
 
-                menu->addAction(action);
-                toolBar->addAction(action);
+    for (QAction* action : plugin->getActions())
+    {
+        if (action && action->objectName() == proxyAction->objectName())
+        {
+            if (action->isEnabled())
+            {
+                action->trigger();
             }
+            else
+            {
+                proxyAction->setChecked(action->isChecked());
+            }
+            break;
+        }
+    }
+}
+
+QString PDFProgramController::getPluginActionCacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/plugin-actions.cache";
+}
+
+PDFProgramController::PluginActionCache PDFProgramController::readPluginActionCache()
+{
+    PluginActionCache cache;
+
+    QFile file(getPluginActionCacheFileName());
+    if (!file.open(QFile::ReadOnly))
+    {
+        return cache;
+    }
+
+    QDataStream stream(&file);
+    QString version;
+    stream >> version;
+
+    // Cache of another version is ignored, plugins can be different
+    if (version != pdf::PDF_LIBRARY_VERSION)
+    {
+        return cache;
+    }
+
+    quint32 entryCount = 0;
+    stream >> entryCount;
+
+    for (quint32 i = 0; i < entryCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString pluginFileName;
+        PluginActionCacheEntry entry;
+        quint32 actionCount = 0;
+        stream >> pluginFileName >> entry.lastModified >> entry.fileSize >> entry.locale >> entry.menuName >> actionCount;
+
+        for (quint32 j = 0; j < actionCount && stream.status() == QDataStream::Ok; ++j)
+        {
+            PluginActionInfo actionInfo;
+            stream >> actionInfo.isSeparator >> actionInfo.isCheckable >> actionInfo.isEnabledWithoutDocument;
+            stream >> actionInfo.objectName >> actionInfo.text >> actionInfo.toolTip >> actionInfo.icon;
+            entry.actions.push_back(qMove(actionInfo));
+        }
+
+        cache[pluginFileName] = qMove(entry);
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        // Cache is corrupted, plugins are loaded and cache is created again
+        cache.clear();
+    }
+
+    return cache;
+}
+
+void PDFProgramController::writePluginActionCache(const PluginActionCache& cache)
+{
+    QString fileName = getPluginActionCacheFileName();
+    QDir().mkpath(QFileInfo(fileName).path());
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << QString(pdf::PDF_LIBRARY_VERSION);
+    stream << quint32(cache.size());
+
+    for (const auto& item : cache)
+    {
+        const PluginActionCacheEntry& entry = item.second;
+        stream << item.first << entry.lastModified << entry.fileSize << entry.locale << entry.menuName << quint32(entry.actions.size());
+
+        for (const PluginActionInfo& actionInfo : entry.actions)
+        {
+            stream << actionInfo.isSeparator << actionInfo.isCheckable << actionInfo.isEnabledWithoutDocument;
+            stream << actionInfo.objectName << actionInfo.text << actionInfo.toolTip << actionInfo.icon;
         }
     }
 }
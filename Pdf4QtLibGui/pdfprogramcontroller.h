@@ -31,7 +31,12 @@
 #include <QToolButton>
 #include <QActionGroup>
 #include <QFileSystemWatcher>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QDateTime>
+#include <QIcon>
 
+#include <map>
 #include <array>
 
 class QMainWindow;
@@ -295,6 +300,14 @@ public:
                     pdf::PDFProgress* progress);
     void initActionComboBox(PDFActionComboBox* comboBox);
     void finishInitialization();
+
+    /// Records the end of the startup stage. Duration of the stage
+    /// is the time elapsed since the end of the previous stage.
+    /// \param stage Stage name
+    void addStartupStage(const QString& stage);
+
+    /// Returns report of durations of the startup stages
+    QString getStartupReport() const;
     void writeSettings();
     void resetSettings();
 
@@ -319,6 +332,8 @@ public:
 
     bool isFactorySettingsBeingRestored() const;
 
+    virtual bool eventFilter(QObject* watched, QEvent* event) override;
+
 signals:
     void queryPasswordRequest(QString* password, bool* ok);
 
@@ -390,6 +405,7 @@ private:
     void onColorManagementSystemChanged();
     void onFileChanged(const QString& fileName);
     void onBookmarkActivated(int index, PDFBookmarkManager::Bookmark bookmark);
+    void onHibernationTimeout();
 
     void updateMagnifierToolSettings();
     void updateUndoRedoSettings();
@@ -399,6 +415,11 @@ private:
     void updateRenderingOptionActions();
     void updateBookmarkSettings();
 
+    /// Starts the hibernation timer, if main window is not active,
+    /// document is opened and hibernation is enabled, otherwise
+    /// stops the timer.
+    void updateHibernationTimer();
+
     void setPageLayout(pdf::PageLayout pageLayout);
     void updateFileInfo(const QString& fileName);
     void updateFileWatcher(bool forceDisable = false);
@@ -415,7 +436,51 @@ private:
     };
     Q_DECLARE_FLAGS(Settings, SettingFlag)
 
+    /// Action of the plugin, as it is stored in the plugin action cache
+    struct PluginActionInfo
+    {
+        bool isSeparator = false;
+        bool isCheckable = false;
+        bool isEnabledWithoutDocument = false;
+        QString objectName;
+        QString text;
+        QString toolTip;
+        QIcon icon;
+    };
+
+    /// Actions of the plugin file, they are valid only for the same
+    /// plugin file and the same locale (texts are translated).
+    struct PluginActionCacheEntry
+    {
+        QDateTime lastModified;
+        qint64 fileSize = 0;
+        QString locale;
+        QString menuName;
+        std::vector<PluginActionInfo> actions;
+    };
+
+    using PluginActionCache = std::map<QString, PluginActionCacheEntry>;
+
+    /// Loads metadata of the plugins. Plugins, whose actions are known from
+    /// the plugin action cache, are not loaded, their actions are represented
+    /// by proxy actions, and plugin is loaded, when some of them is triggered.
     void loadPlugins();
+
+    /// Loads the plugin library and creates the plugin instance
+    /// \param pluginInfo Plugin info
+    pdf::PDFPlugin* instantiatePlugin(const pdf::PDFPluginInfo& pluginInfo);
+
+    /// Adds actions of the plugin into the plugin menu and toolbar
+    void addPluginActions(const QString& pluginName, const QString& menuName, const std::vector<QAction*>& actions);
+
+    /// Loads the plugin of the proxy action (if it is not loaded)
+    /// and triggers the real action of the plugin.
+    void onPluginProxyActionTriggered(QAction* proxyAction);
+
+    static QString getPluginActionCacheFileName();
+    static PluginActionCache readPluginActionCache();
+    static void writePluginActionCache(const PluginActionCache& cache);
+
     void readSettings(Settings settings);
 
     void saveDocument(const QString& fileName);
@@ -444,6 +509,7 @@ private:
 
     PDFFileInfo m_fileInfo;
     QFileSystemWatcher m_fileWatcher;
+    QTimer* m_hibernationTimer;
     pdf::PDFCertificateStore m_certificateStore;
     std::vector<pdf::PDFSignatureVerificationResult> m_signatures;
 
@@ -455,6 +521,13 @@ private:
     bool m_loadAllPlugins;
     pdf::PDFPluginInfos m_plugins;
     std::vector<std::pair<pdf::PDFPluginInfo, pdf::PDFPlugin*>> m_loadedPlugins;
+
+    /// Proxy actions of plugins, which are not loaded yet
+    std::map<QString, std::vector<QAction*>> m_pluginProxyActions;
+
+    QElapsedTimer m_startupTimer;
+    qint64 m_lastStartupStageTime = 0;
+    std::vector<std::pair<QString, qint64>> m_startupStages;
 };
 
 }   // namespace pdfviewer
@@ -59,6 +59,14 @@ PDFRenderToImagesDialog::PDFRenderToImagesDialog(const pdf::PDFDocument* documen
         ui->formatComboBox->addItem(QString::fromLatin1(format), format);
     }
 
+    ui->fidelityComboBox->addItem(tr("Draft"), int(pdf::PDFRenderer::Fidelity::Draft));
+    ui->fidelityComboBox->addItem(tr("Normal"), int(pdf::PDFRenderer::Fidelity::Normal));
+    ui->fidelityComboBox->addItem(tr("High"), int(pdf::PDFRenderer::Fidelity::High));
+    ui->fidelityComboBox->setItemData(0, tr("Fastest rendering for previews - images in lower resolution, coarse shadings, soft masks of small images are ignored, simplified transparency and Type 3 glyphs."), Qt::ToolTipRole);
+    ui->fidelityComboBox->setItemData(1, tr("Rendering quality used for the view."), Qt::ToolTipRole);
+    ui->fidelityComboBox->setItemData(2, tr("Slowest rendering - smooth images, antialiasing and fine shadings."), Qt::ToolTipRole);
+    ui->fidelityComboBox->setCurrentIndex(ui->fidelityComboBox->findData(int(pdf::PDFRenderer::Fidelity::Normal)));
+
     connect(ui->pagesAllButton, &QRadioButton::clicked, this, &PDFRenderToImagesDialog::onPagesButtonClicked);
     connect(ui->pagesSelectButton, &QRadioButton::clicked, this, &PDFRenderToImagesDialog::onPagesButtonClicked);
     connect(ui->selectedPagesEdit, &QLineEdit::textChanged, this, &PDFRenderToImagesDialog::onSelectedPagesChanged);
@@ -253,11 +261,11 @@ void PDFRenderToImagesDialog::onRenderError(pdf::PDFInteger pageIndex, pdf::PDFR
 
     if (pageIndex != pdf::PDFCatalog::INVALID_PAGE_INDEX)
     {
-        text = tr("%1\nPage %2: %3").arg(ui->progressMessagesEdit->toPlainText(), QString::number(pageIndex + 1), error.message);
+        text = tr("%1\nPage %2: %3").arg(ui->progressMessagesEdit->toPlainText(), QString::number(pageIndex + 1), error.getMessage());
     }
     else
     {
-        text = QString("%1\n%2").arg(ui->progressMessagesEdit->toPlainText(), error.message);
+        text = QString("%1\n%2").arg(ui->progressMessagesEdit->toPlainText(), error.getMessage());
     }
     ui->progressMessagesEdit->setPlainText(text);
 }
@@ -297,8 +305,14 @@ void PDFRenderToImagesDialog::on_buttonBox_clicked(QAbstractButton* button)
             m_pageIndices = m_imageExportSettings.getPages();
             m_optionalContentActivity = new pdf::PDFOptionalContentActivity(m_document, pdf::OCUsage::Export, this);
             m_cms = m_proxy->getCMSManager()->getCurrentCMS();
+
+            // Rasterizer pool references mesh quality settings, so they must be kept in the dialog
+            pdf::PDFRenderer::Features features = m_proxy->getFeatures();
+            m_meshQualitySettings = m_proxy->getMeshQualitySettings();
+            pdf::PDFRenderer::applyFidelity(static_cast<pdf::PDFRenderer::Fidelity>(ui->fidelityComboBox->currentData().toInt()), features, m_meshQualitySettings);
+
             m_rasterizerPool = new pdf::PDFRasterizerPool(m_document, m_proxy->getFontCache(), m_proxy->getCMSManager(),
-                                                          m_optionalContentActivity, m_proxy->getFeatures(), m_proxy->getMeshQualitySettings(),
+                                                          m_optionalContentActivity, features, m_meshQualitySettings,
                                                           pdf::PDFRasterizerPool::getDefaultRasterizerCount(), m_proxy->getRendererEngine(), this);
             connect(m_rasterizerPool, &pdf::PDFRasterizerPool::renderError, this, &PDFRenderToImagesDialog::onRenderError);
 
@@ -791,6 +791,9 @@ void PDFSidebarWidget::onOutlineSearchText()
     {
         m_outlineSortProxyTreeModel->setFilterFixedString(text);
     }
+
+    // Items are created on demand, so matching items must be fetched to be found by the filter
+    m_outlineTreeModel->fetchMatchingItems(m_outlineSortProxyTreeModel->filterRegularExpression());
 }
 
 void PDFSidebarWidget::onNotesSearchText()
@@ -857,13 +860,26 @@ void PDFSidebarWidget::onAttachmentCustomContextMenuRequested(const QPoint& pos)
                 {
                     try
                     {
-                        QByteArray data = m_document->getDecodedStream(platformFile->getStream());
-
                         QFile file(saveFileName);
                         if (file.open(QFile::WriteOnly | QFile::Truncate))
                         {
-                            file.write(data);
+                            // Decode the attachment in chunks directly into the file, so
+                            // large attachments are never held in memory as a whole.
+                            auto writeData = [&file](const char* data, qsizetype size)
+                            {
+                                if (file.write(data, size) != size)
+                                {
+                                    throw pdf::PDFException(file.errorString());
+                                }
+                            };
+
+                            const bool isDecoded = m_document->decodeStream(platformFile->getStream(), writeData);
                             file.close();
+
+                            if (!isDecoded)
+                            {
+                                QMessageBox::critical(this, tr("Error"), tr("Failed to save attachment to file. Attachment is corrupted."));
+                            }
                         }
                         else
                         {
@@ -1117,10 +1133,8 @@ void PDFSidebarWidget::onOutlineTreeViewContextMenuRequested(const QPoint& pos)
         };
 
         QStringList items;
-        for (const auto& namedDestination : m_document->getCatalog()->getNamedDestinations())
-        {
-            items << QString::fromLatin1(namedDestination.first);
-        }
+        m_document->getCatalog()->enumerateNamedDestinations([&items](const QByteArray& name, const pdf::PDFDestination&) { items << QString::fromLatin1(name); });
+        items.sort();
 
         SelectNamedDestinationDialog dialog(items, m_proxy->getWidget());
         if (dialog.exec() == QDialog::Accepted)
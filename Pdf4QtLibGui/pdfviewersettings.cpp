@@ -45,6 +45,7 @@ void PDFViewerSettings::readSettings(QSettings& settings, const pdf::PDFCMSSetti
     m_settings.m_features = static_cast<pdf::PDFRenderer::Features>(settings.value("rendererFeaturesv2", static_cast<int>(pdf::PDFRenderer::getDefaultFeatures())).toInt());
     m_settings.m_rendererEngine = static_cast<pdf::RendererEngine>(settings.value("renderingEngine", static_cast<int>(pdf::RendererEngine::Blend2D_MultiThread)).toInt());
     m_settings.m_prefetchPages = settings.value("prefetchPages", defaultSettings.m_prefetchPages).toBool();
+    m_settings.m_printPagesAsImages = settings.value("printPagesAsImages", defaultSettings.m_printPagesAsImages).toBool();
     m_settings.m_preferredMeshResolutionRatio = settings.value("preferredMeshResolutionRatio", defaultSettings.m_preferredMeshResolutionRatio).toDouble();
     m_settings.m_minimalMeshResolutionRatio = settings.value("minimalMeshResolutionRatio", defaultSettings.m_minimalMeshResolutionRatio).toDouble();
     m_settings.m_colorTolerance = settings.value("colorTolerance", defaultSettings.m_colorTolerance).toDouble();
@@ -52,6 +53,8 @@ void PDFViewerSettings::readSettings(QSettings& settings, const pdf::PDFCMSSetti
     m_settings.m_thumbnailsCacheLimit = settings.value("thumbnailsCacheLimit", defaultSettings.m_thumbnailsCacheLimit).toInt();
     m_settings.m_fontCacheLimit = settings.value("fontCacheLimit", defaultSettings.m_fontCacheLimit).toInt();
     m_settings.m_instancedFontCacheLimit = settings.value("instancedFontCacheLimit", defaultSettings.m_instancedFontCacheLimit).toInt();
+    m_settings.m_memoryBudget = settings.value("memoryBudget", defaultSettings.m_memoryBudget).toInt();
+    m_settings.m_hibernationTimeout = settings.value("hibernationTimeout", defaultSettings.m_hibernationTimeout).toInt();
     m_settings.m_allowLaunchApplications = settings.value("allowLaunchApplications", defaultSettings.m_allowLaunchApplications).toBool();
     m_settings.m_allowLaunchURI = settings.value("allowLaunchURI", defaultSettings.m_allowLaunchURI).toBool();
     m_settings.m_allowDeveloperMode = settings.value("allowDeveloperMode", defaultSettings.m_allowDeveloperMode).toBool();
@@ -78,6 +81,7 @@ void PDFViewerSettings::readSettings(QSettings& settings, const pdf::PDFCMSSetti
     m_colorManagementSystemSettings.proofingIntent = static_cast<pdf::RenderingIntent>(settings.value("proofingIntent", int(defaultCMSSettings.proofingIntent)).toInt());
     m_colorManagementSystemSettings.outOfGamutColor = settings.value("outOfGamutColor", defaultCMSSettings.outOfGamutColor).value<QColor>();
     m_colorManagementSystemSettings.profileDirectory = settings.value("profileDirectory", defaultCMSSettings.profileDirectory).toString();
+    m_colorManagementSystemSettings.transformCacheDirectory = settings.value("transformCacheDirectory", defaultCMSSettings.transformCacheDirectory).toString();
     m_colorManagementSystemSettings.foregroundColor = settings.value("foregroundColor", defaultCMSSettings.foregroundColor).value<QColor>();
     m_colorManagementSystemSettings.backgroundColor = settings.value("backgroundColor", defaultCMSSettings.backgroundColor).value<QColor>();
     m_colorManagementSystemSettings.sigmoidSlopeFactor = settings.value("sigmoidSlopeFactor", defaultCMSSettings.sigmoidSlopeFactor).toDouble();
@@ -118,6 +122,7 @@ void PDFViewerSettings::writeSettings(QSettings& settings)
     settings.setValue("rendererFeaturesv2", static_cast<int>(m_settings.m_features));
     settings.setValue("renderingEngine", static_cast<int>(m_settings.m_rendererEngine));
     settings.setValue("prefetchPages", m_settings.m_prefetchPages);
+    settings.setValue("printPagesAsImages", m_settings.m_printPagesAsImages);
     settings.setValue("preferredMeshResolutionRatio", m_settings.m_preferredMeshResolutionRatio);
     settings.setValue("minimalMeshResolutionRatio", m_settings.m_minimalMeshResolutionRatio);
     settings.setValue("colorTolerance", m_settings.m_colorTolerance);
@@ -125,6 +130,8 @@ void PDFViewerSettings::writeSettings(QSettings& settings)
     settings.setValue("thumbnailsCacheLimit", m_settings.m_thumbnailsCacheLimit);
     settings.setValue("fontCacheLimit", m_settings.m_fontCacheLimit);
     settings.setValue("instancedFontCacheLimit", m_settings.m_instancedFontCacheLimit);
+    settings.setValue("memoryBudget", m_settings.m_memoryBudget);
+    settings.setValue("hibernationTimeout", m_settings.m_hibernationTimeout);
     settings.setValue("allowLaunchApplications", m_settings.m_allowLaunchApplications);
     settings.setValue("allowLaunchURI", m_settings.m_allowLaunchURI);
     settings.setValue("allowDeveloperMode", m_settings.m_allowDeveloperMode);
@@ -151,6 +158,7 @@ void PDFViewerSettings::writeSettings(QSettings& settings)
     settings.setValue("proofingIntent", int(m_colorManagementSystemSettings.proofingIntent));
     settings.setValue("outOfGamutColor", m_colorManagementSystemSettings.outOfGamutColor);
     settings.setValue("profileDirectory", m_colorManagementSystemSettings.profileDirectory);
+    settings.setValue("transformCacheDirectory", m_colorManagementSystemSettings.transformCacheDirectory);
     settings.setValue("foregroundColor", m_colorManagementSystemSettings.foregroundColor);
     settings.setValue("backgroundColor", m_colorManagementSystemSettings.backgroundColor);
     settings.setValue("sigmoidSlopeFactor", m_colorManagementSystemSettings.sigmoidSlopeFactor);
@@ -255,6 +263,7 @@ PDFViewerSettings::Settings::Settings() :
     m_features(pdf::PDFRenderer::getDefaultFeatures()),
     m_rendererEngine(pdf::RendererEngine::Blend2D_MultiThread),
     m_prefetchPages(true),
+    m_printPagesAsImages(false),
     m_preferredMeshResolutionRatio(0.02),
     m_minimalMeshResolutionRatio(0.005),
     m_colorTolerance(0.01),
@@ -266,6 +275,8 @@ PDFViewerSettings::Settings::Settings() :
     m_thumbnailsCacheLimit(64 * 1024),
     m_fontCacheLimit(pdf::DEFAULT_FONT_CACHE_LIMIT),
     m_instancedFontCacheLimit(pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT),
+    m_memoryBudget(0),
+    m_hibernationTimeout(0),
     m_speechRate(0.0),
     m_speechPitch(0.0),
     m_speechVolume(1.0),
@@ -53,6 +53,7 @@ public:
         QString m_directory;
         pdf::RendererEngine m_rendererEngine;
         bool m_prefetchPages;
+        bool m_printPagesAsImages; ///< Rasterize printed pages at the resolution of the printer
         pdf::PDFReal m_preferredMeshResolutionRatio;
         pdf::PDFReal m_minimalMeshResolutionRatio;
         pdf::PDFReal m_colorTolerance;
@@ -66,6 +67,8 @@ public:
         int m_thumbnailsCacheLimit;
         int m_fontCacheLimit;
         int m_instancedFontCacheLimit;
+        int m_memoryBudget; ///< Global memory budget of caches [MB], zero means no budget
+        int m_hibernationTimeout; ///< Inactivity time, after which caches of the document are released [min], zero means never
 
         // Speech settings
         QString m_speechEngine;
@@ -126,6 +129,8 @@ public:
     int getThumbnailsCacheLimit() const { return m_settings.m_thumbnailsCacheLimit; }
     int getFontCacheLimit() const { return m_settings.m_fontCacheLimit; }
     int getInstancedFontCacheLimit() const { return m_settings.m_instancedFontCacheLimit; }
+    int getMemoryBudget() const { return m_settings.m_memoryBudget; }
+    int getHibernationTimeout() const { return m_settings.m_hibernationTimeout; }
 
     const pdf::PDFCMSSettings& getColorManagementSystemSettings() const { return m_colorManagementSystemSettings; }
     void setColorManagementSystemSettings(const pdf::PDFCMSSettings& settings) { m_colorManagementSystemSettings = settings; }
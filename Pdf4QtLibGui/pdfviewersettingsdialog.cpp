@@ -21,6 +21,7 @@
 #include "pdfglobal.h"
 #include "pdfutils.h"
 #include "pdfwidgetutils.h"
+#include "pdfdrawwidget.h"
 #include "pdfrecentfilemanager.h"
 #include "pdfcolorconvertor.h"
 
@@ -106,6 +107,11 @@ PDFViewerSettingsDialog::PDFViewerSettingsDialog(const PDFViewerSettings::Settin
     ui->renderingEngineComboBox->addItem(tr("Software | Blend2D | Parallel"), static_cast<int>(pdf::RendererEngine::Blend2D_MultiThread));
     ui->renderingEngineComboBox->addItem(tr("Software | Blend2D | Sequential"), static_cast<int>(pdf::RendererEngine::Blend2D_SingleThread));
 
+    if (pdf::PDFWidget::isRhiRendererSupported())
+    {
+        ui->renderingEngineComboBox->addItem(tr("Hardware | QRhi"), static_cast<int>(pdf::RendererEngine::QRhi));
+    }
+
     ui->multithreadingComboBox->addItem(tr("Single thread"), static_cast<int>(pdf::PDFExecutionPolicy::Strategy::SingleThreaded));
     ui->multithreadingComboBox->addItem(tr("Multithreading (load balanced)"), static_cast<int>(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded));
     ui->multithreadingComboBox->addItem(tr("Multithreading (maximum threads)"), static_cast<int>(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded));
@@ -271,6 +277,7 @@ void PDFViewerSettingsDialog::loadData()
 
     // Engine
     ui->prefetchPagesCheckBox->setChecked(m_settings.m_prefetchPages);
+    ui->printPagesAsImagesCheckBox->setChecked(m_settings.m_printPagesAsImages);
     ui->multithreadingComboBox->setCurrentIndex(ui->multithreadingComboBox->findData(static_cast<int>(m_settings.m_multithreadingStrategy)));
 
     // Rendering
@@ -292,6 +299,8 @@ void PDFViewerSettingsDialog::loadData()
     ui->thumbnailCacheSizeEdit->setValue(m_settings.m_thumbnailsCacheLimit);
     ui->cachedFontLimitEdit->setValue(m_settings.m_fontCacheLimit);
     ui->cachedInstancedFontLimitEdit->setValue(m_settings.m_instancedFontCacheLimit);
+    ui->memoryBudgetEdit->setValue(m_settings.m_memoryBudget);
+    ui->hibernationTimeoutEdit->setValue(m_settings.m_hibernationTimeout);
 
     // Security
     ui->allowLaunchCheckBox->setChecked(m_settings.m_allowLaunchApplications);
@@ -404,6 +413,10 @@ void PDFViewerSettingsDialog::saveData()
     {
         m_settings.m_prefetchPages = ui->prefetchPagesCheckBox->isChecked();
     }
+    else if (sender == ui->printPagesAsImagesCheckBox)
+    {
+        m_settings.m_printPagesAsImages = ui->printPagesAsImagesCheckBox->isChecked();
+    }
     else if (sender == ui->antialiasingCheckBox)
     {
         m_settings.m_features.setFlag(pdf::PDFRenderer::Antialiasing, ui->antialiasingCheckBox->isChecked());
@@ -472,6 +485,14 @@ void PDFViewerSettingsDialog::saveData()
     {
         m_settings.m_instancedFontCacheLimit = ui->cachedInstancedFontLimitEdit->value();
     }
+    else if (sender == ui->memoryBudgetEdit)
+    {
+        m_settings.m_memoryBudget = ui->memoryBudgetEdit->value();
+    }
+    else if (sender == ui->hibernationTimeoutEdit)
+    {
+        m_settings.m_hibernationTimeout = ui->hibernationTimeoutEdit->value();
+    }
     else if (sender == ui->cmsTypeComboBox)
     {
         m_cmsSettings.system = static_cast<pdf::PDFCMSSettings::System>(ui->cmsTypeComboBox->currentData().toInt());
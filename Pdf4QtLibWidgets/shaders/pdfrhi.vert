@@ -0,0 +1,21 @@
+#version 440
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec4 color;
+
+layout(location = 0) out vec2 v_texCoord;
+layout(location = 1) out vec4 v_color;
+
+layout(std140, binding = 0) uniform buf
+{
+    mat4 matrix;
+    float opacity;
+};
+
+void main()
+{
+    v_texCoord = texCoord;
+    v_color = color * opacity;
+    gl_Position = matrix * vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 440
+
+layout(location = 0) in vec2 v_texCoord;
+layout(location = 1) in vec4 v_color;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    fragColor = v_color;
+}
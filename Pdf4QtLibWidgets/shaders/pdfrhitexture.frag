@@ -0,0 +1,13 @@
+#version 440
+
+layout(location = 0) in vec2 v_texCoord;
+layout(location = 1) in vec4 v_color;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(binding = 1) uniform sampler2D imageTexture;
+
+void main()
+{
+    fragColor = texture(imageTexture, v_texCoord) * v_color;
+}
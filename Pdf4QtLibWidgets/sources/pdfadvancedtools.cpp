@@ -1049,14 +1049,14 @@ void PDFCreateHighlightTextTool::mouseMoveEvent(QWidget* widget, QMouseEvent* ev
 
     QPointF pagePoint;
     const PDFInteger pageIndex = getProxy()->getPageUnderPoint(event->pos(), &pagePoint);
-    PDFTextLayout textLayout = getProxy()->getTextLayoutCompiler()->getTextLayoutLazy(pageIndex);
-    m_isCursorOverText = textLayout.isHoveringOverTextBlock(pagePoint);
+    m_isCursorOverText = getProxy()->getTextLayoutCompiler()->isHoveringOverTextBlock(pageIndex, pagePoint);
 
     if (m_selectionInfo.pageIndex != -1)
     {
         if (m_selectionInfo.pageIndex == pageIndex)
         {
             // Jakub Melka: handle the selection
+            PDFTextLayout textLayout = getProxy()->getTextLayoutCompiler()->getTextLayoutLazy(pageIndex);
             setSelection(textLayout.createTextSelection(pageIndex, m_selectionInfo.selectionStartPoint, pagePoint));
         }
         else
@@ -1266,14 +1266,14 @@ void PDFCreateRedactTextTool::mouseMoveEvent(QWidget* widget, QMouseEvent* event
 
     QPointF pagePoint;
     const PDFInteger pageIndex = getProxy()->getPageUnderPoint(event->pos(), &pagePoint);
-    PDFTextLayout textLayout = getProxy()->getTextLayoutCompiler()->getTextLayoutLazy(pageIndex);
-    m_isCursorOverText = textLayout.isHoveringOverTextBlock(pagePoint);
+    m_isCursorOverText = getProxy()->getTextLayoutCompiler()->isHoveringOverTextBlock(pageIndex, pagePoint);
 
     if (m_selectionInfo.pageIndex != -1)
     {
         if (m_selectionInfo.pageIndex == pageIndex)
         {
             // Jakub Melka: handle the selection
+            PDFTextLayout textLayout = getProxy()->getTextLayoutCompiler()->getTextLayoutLazy(pageIndex);
             setSelection(textLayout.createTextSelection(pageIndex, m_selectionInfo.selectionStartPoint, pagePoint, Qt::black));
         }
         else
@@ -21,8 +21,23 @@
 #include "pdfexecutionpolicy.h"
 #include "pdftextlayoutgenerator.h"
 #include "pdfdrawspacecontroller.h"
-
+#include "pdfblpainter.h"
+#include "pdfprecompiledpagecache.h"
+#include "pdfannotation.h"
+#include "pdfimage.h"
+#include "pdfdrawwidget.h"
+#include "pdfwidgetannotation.h"
+
+#include <QDir>
+#include <QBuffer>
 #include <QCache>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QtMath>
+#include <QPainter>
 #include <QtConcurrent/QtConcurrent>
 
 #include "pdfdbgheap.h"
@@ -32,6 +47,28 @@
 namespace pdf
 {
 
+/// Operation control of the single compile task. Task is cancelled, if
+/// compiler is being stopped, or if task itself is cancelled.
+class PDFCompileTaskOperationControl : public PDFOperationControl
+{
+public:
+    explicit PDFCompileTaskOperationControl(const PDFOperationControl* compiler, const std::atomic_bool* cancelled) :
+        m_compiler(compiler),
+        m_cancelled(cancelled)
+    {
+
+    }
+
+    virtual bool isOperationCancelled() const override
+    {
+        return *m_cancelled || m_compiler->isOperationCancelled();
+    }
+
+private:
+    const PDFOperationControl* m_compiler;
+    const std::atomic_bool* m_cancelled;
+};
+
 PDFAsynchronousPageCompilerWorkerThread::PDFAsynchronousPageCompilerWorkerThread(PDFAsynchronousPageCompiler* parent) :
     QThread(parent),
     m_compiler(parent),
@@ -50,10 +87,24 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
         {
             while (!isInterruptionRequested())
             {
+                // Compile only tasks with the highest priority. Tasks
+                // with lower priority are compiled in the next batch, if they are
+                // not cancelled meanwhile (or another tasks with higher priority
+                // are not requested meanwhile).
                 std::vector<PDFAsynchronousPageCompiler::CompileTask> tasks;
                 for (auto& task : m_compiler->m_tasks)
                 {
-                    if (!task.second.finished)
+                    if (task.second.finished)
+                    {
+                        continue;
+                    }
+
+                    if (!tasks.empty() && tasks.front().priority > task.second.priority)
+                    {
+                        tasks.clear();
+                    }
+
+                    if (tasks.empty() || tasks.front().priority == task.second.priority)
                     {
                         tasks.push_back(task.second);
                     }
@@ -61,20 +112,51 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
 
                 if (!tasks.empty())
                 {
+                    std::shared_ptr<PDFPrecompiledPageCache> precompiledPageCache = m_compiler->m_precompiledPageCache;
                     locker.unlock();
 
                     // Perform page compilation
                     auto proxy = m_compiler->getProxy();
                     proxy->getFontCache()->setCacheShrinkEnabled(this, false);
 
-                    auto compilePage = [this, proxy](PDFAsynchronousPageCompiler::CompileTask& task) -> PDFPrecompiledPage
+                    QByteArray rendererKey;
+                    if (precompiledPageCache)
+                    {
+                        rendererKey = PDFPrecompiledPageCache::createRendererKey(proxy->getDocument(), proxy->getFeatures(), proxy->getCMSManager()->getSettings(), proxy->getMeshQualitySettings(), proxy->getOptionalContentActivity());
+                    }
+
+                    auto compilePage = [this, proxy, &precompiledPageCache, &rendererKey](PDFAsynchronousPageCompiler::CompileTask& task) -> PDFPrecompiledPage
                     {
                         PDFPrecompiledPage compiledPage;
+                        task.dependencies = PDFPageContentDependencies::create(proxy->getDocument(), task.pageIndex);
+
+                        if (precompiledPageCache && precompiledPageCache->load(proxy->getDocument(), rendererKey, task.pageIndex, &task.precompiledPage))
+                        {
+                            task.finished = true;
+                            return compiledPage;
+                        }
+
+                        if (task.isCancelled())
+                        {
+                            // Page is no longer needed
+                            task.finished = true;
+                            return compiledPage;
+                        }
+
+                        PDFCompileTaskOperationControl operationControl(m_compiler, task.cancelled.get());
                         PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
                         PDFRenderer renderer(proxy->getDocument(), proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(), proxy->getFeatures(), proxy->getMeshQualitySettings());
-                        renderer.setOperationControl(m_compiler);
-                        renderer.compile(&task.precompiledPage, task.pageIndex);
+                        renderer.setOperationControl(&operationControl);
+                        renderer.setOptionalContentRecordingEnabled(true);
+                        renderer.compile(&task.precompiledPage, task.pageIndex, task.isDraft);
                         task.finished = true;
+
+                        // Do not store partially compiled pages (operation was cancelled) and draft pages
+                        if (precompiledPageCache && !operationControl.isOperationCancelled() && !task.precompiledPage.isDraft())
+                        {
+                            precompiledPageCache->store(proxy->getDocument(), rendererKey, task.pageIndex, task.precompiledPage);
+                        }
+
                         return compiledPage;
                     };
                     PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, tasks.begin(), tasks.end(), compilePage);
@@ -88,6 +170,14 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
                     bool isSomethingWritten = false;
                     for (auto& task : tasks)
                     {
+                        if (task.isCancelled())
+                        {
+                            // Task was cancelled, page can be partially compiled, so throw it
+                            // away. Task was already removed, but the page can be requested
+                            // again meanwhile (new task with the same page index was created).
+                            continue;
+                        }
+
                         if (task.finished)
                         {
                             isSomethingWritten = true;
@@ -116,14 +206,17 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
 
 PDFAsynchronousPageCompiler::PDFAsynchronousPageCompiler(PDFDrawWidgetProxy* proxy) :
     BaseClass(proxy),
+    PDFMemoryBudgetClient("compiled-page-cache", 4, 128 * 1024 * 1024),
     m_proxy(proxy),
-    m_cache(new QCache<PDFInteger, PDFPrecompiledPage>())
+    m_cache(new QCache<PDFInteger, CachedPage>())
 {
-    m_cache->setMaxCost(128 * 1024 * 1024);
+    m_cache->setMaxCost(getMemoryLimit());
+    registerMemoryBudgetClient();
 }
 
 PDFAsynchronousPageCompiler::~PDFAsynchronousPageCompiler()
 {
+    unregisterMemoryBudgetClient();
     stop(true);
 
     delete m_cache;
@@ -190,6 +283,7 @@ void PDFAsynchronousPageCompiler::stop(bool clearCache)
             if (clearCache)
             {
                 m_cache->clear();
+                setMemoryConsumption(0);
             }
 
             m_state = State::Inactive;
@@ -211,12 +305,46 @@ void PDFAsynchronousPageCompiler::reset()
     start();
 }
 
+void PDFAsynchronousPageCompiler::removeModifiedPages(const PDFDocument* document)
+{
+    Q_ASSERT(m_state == State::Inactive);
+
+    const QList<PDFInteger> pageIndices = m_cache->keys();
+    for (const PDFInteger pageIndex : pageIndices)
+    {
+        const CachedPage* cachedPage = m_cache->object(pageIndex);
+        if (!document || !cachedPage || !cachedPage->dependencies.isUpToDate(document, pageIndex))
+        {
+            m_cache->remove(pageIndex);
+        }
+    }
+}
+
 void PDFAsynchronousPageCompiler::setCacheLimit(int limit)
 {
-    m_cache->setMaxCost(limit);
+    setDefaultMemoryLimit(limit);
+    m_cache->setMaxCost(getMemoryLimit());
+    setMemoryConsumption(m_cache->totalCost());
+}
+
+void PDFAsynchronousPageCompiler::trimMemory()
+{
+    // Cache is accessed only from the main thread, but budget can
+    // be rebalanced from any thread, so the cache is trimmed later.
+    QMetaObject::invokeMethod(this, [this]()
+    {
+        m_cache->setMaxCost(getMemoryLimit());
+        setMemoryConsumption(m_cache->totalCost());
+    }, Qt::QueuedConnection);
+}
+
+void PDFAsynchronousPageCompiler::setPrecompiledPageCache(std::shared_ptr<PDFPrecompiledPageCache> precompiledPageCache)
+{
+    QMutexLocker locker(&m_mutex);
+    m_precompiledPageCache = std::move(precompiledPageCache);
 }
 
-const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFInteger pageIndex, bool compile)
+const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFInteger pageIndex, bool compile, Priority priority)
 {
     if (m_state != State::Active || !m_proxy->getDocument())
     {
@@ -224,16 +352,23 @@ const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFIntege
         return nullptr;
     }
 
-    PDFPrecompiledPage* page = m_cache->object(pageIndex);
+    CachedPage* cachedPage = getCachedPage(pageIndex);
+    PDFPrecompiledPage* page = cachedPage ? cachedPage->precompiledPage.get() : nullptr;
 
     if (!page && compile)
     {
         QMutexLocker locker(&m_mutex);
-        if (!m_tasks.count(pageIndex))
+        auto it = m_tasks.find(pageIndex);
+        if (it == m_tasks.end())
         {
-            m_tasks.insert(std::make_pair(pageIndex, CompileTask(pageIndex)));
+            m_tasks.insert(std::make_pair(pageIndex, CompileTask(pageIndex, true, priority)));
             m_waitCondition.wakeOne();
         }
+        else if (it->second.priority > priority)
+        {
+            // Page is requested with higher priority (for example, thumbnail became visible)
+            it->second.priority = priority;
+        }
     }
 
     if (page)
@@ -244,6 +379,75 @@ const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFIntege
     return page;
 }
 
+void PDFAsynchronousPageCompiler::cancelStaleTasks(const std::vector<PDFInteger>& activePages)
+{
+    Q_ASSERT(std::is_sorted(activePages.cbegin(), activePages.cend()));
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_tasks.begin(); it != m_tasks.end();)
+    {
+        const CompileTask& task = it->second;
+        const bool isStale = !task.finished &&
+                             task.priority != Priority::Thumbnail &&
+                             !std::binary_search(activePages.cbegin(), activePages.cend(), task.pageIndex);
+
+        if (isStale)
+        {
+            // Task can be just compiled by the worker thread, so
+            // interrupt the compilation using the cancel flag.
+            *task.cancelled = true;
+            it = m_tasks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<const PDFPrecompiledPage> PDFAsynchronousPageCompiler::getCompiledPagePointer(PDFInteger pageIndex)
+{
+    if (m_state != State::Active || !m_proxy->getDocument())
+    {
+        return nullptr;
+    }
+
+    if (CachedPage* cachedPage = getCachedPage(pageIndex))
+    {
+        return cachedPage->precompiledPage;
+    }
+
+    return nullptr;
+}
+
+PDFAsynchronousPageCompiler::CachedPage* PDFAsynchronousPageCompiler::getCachedPage(PDFInteger pageIndex)
+{
+    CachedPage* cachedPage = m_cache->object(pageIndex);
+    if (!cachedPage || cachedPage->precompiledPage)
+    {
+        return cachedPage;
+    }
+
+    // Page is compacted, restore it and insert it again into the cache with new cost
+    cachedPage = m_cache->take(pageIndex);
+    std::shared_ptr<PDFPrecompiledPage> page = std::make_shared<PDFPrecompiledPage>();
+    if (!page->expand(cachedPage->compactedPage))
+    {
+        delete cachedPage;
+        reportMemoryConsumption(m_cache->totalCost());
+        return nullptr;
+    }
+
+    page->setGlyphCache(m_proxy->getFontCache()->getGlyphCache());
+    page->markAccessed();
+    cachedPage->precompiledPage = std::move(page);
+    cachedPage->compactedPage.clear();
+
+    const bool isInserted = m_cache->insert(pageIndex, cachedPage, cachedPage->precompiledPage->getMemoryConsumptionEstimate());
+    reportMemoryConsumption(m_cache->totalCost());
+    return isInserted ? cachedPage : nullptr;
+}
+
 void PDFAsynchronousPageCompiler::smartClearCache(const int milisecondsLimit, const std::vector<PDFInteger>& activePages)
 {
     if (m_state != State::Active)
@@ -265,22 +469,47 @@ void PDFAsynchronousPageCompiler::smartClearCache(const int milisecondsLimit, co
             continue;
         }
 
-        const PDFPrecompiledPage* page = m_cache->object(pageIndex);
-        if (page && page->hasExpired(milisecondsLimit))
+        CachedPage* page = m_cache->object(pageIndex);
+        if (!page)
         {
-            m_cache->remove(pageIndex);
+            continue;
+        }
+
+        if (!page->precompiledPage)
+        {
+            if (page->compactionTimer.hasExpired(qint64(milisecondsLimit) * COMPACTED_PAGE_EXPIRATION_FACTOR))
+            {
+                m_cache->remove(pageIndex);
+            }
+        }
+        else if (page->precompiledPage->hasExpired(milisecondsLimit))
+        {
+            // Compact the page and insert it again into the cache with new cost
+            page = m_cache->take(pageIndex);
+            page->compactedPage = page->precompiledPage->compact();
+            page->compactionTimer.start();
+            page->precompiledPage.reset();
+            m_cache->insert(pageIndex, page, page->compactedPage.size());
         }
     }
+
+    const qint64 memoryConsumption = m_cache->totalCost();
+    locker.unlock();
+    reportMemoryConsumption(memoryConsumption);
 }
 
 void PDFAsynchronousPageCompiler::onPageCompiled()
 {
     std::vector<PDFInteger> compiledPages;
+    std::vector<std::pair<PDFInteger, Priority>> draftPages;
     std::map<PDFInteger, PDFRenderError> errors;
 
     {
         QMutexLocker locker(&m_mutex);
 
+        // Memory limit can be changed by the memory budget
+        m_cache->setMaxCost(getMemoryLimit());
+
         // Search all tasks for finished tasks
         for (auto it = m_tasks.begin(); it != m_tasks.end();)
         {
@@ -290,12 +519,20 @@ void PDFAsynchronousPageCompiler::onPageCompiled()
                 if (m_state == State::Active)
                 {
                     // If we are in active state, try to store precompiled page
-                    PDFPrecompiledPage* page = new PDFPrecompiledPage(std::move(task.precompiledPage));
-                    page->markAccessed();
-                    qint64 memoryConsumptionEstimate = page->getMemoryConsumptionEstimate();
+                    CachedPage* page = new CachedPage();
+                    page->precompiledPage = std::make_shared<PDFPrecompiledPage>(std::move(task.precompiledPage));
+                    page->dependencies = std::move(task.dependencies);
+                    page->precompiledPage->markAccessed();
+                    qint64 memoryConsumptionEstimate = page->precompiledPage->getMemoryConsumptionEstimate();
+                    const bool isDraft = page->precompiledPage->isDraft();
                     if (m_cache->insert(it->first, page, memoryConsumptionEstimate))
                     {
                         compiledPages.push_back(it->first);
+
+                        if (isDraft)
+                        {
+                            draftPages.emplace_back(it->first, task.priority);
+                        }
                     }
                     else
                     {
@@ -314,8 +551,22 @@ void PDFAsynchronousPageCompiler::onPageCompiled()
                 ++it;
             }
         }
+
+        // Compile draft pages again with full resolution images,
+        // draft page is displayed meanwhile.
+        for (const auto& [pageIndex, priority] : draftPages)
+        {
+            m_tasks.insert(std::make_pair(pageIndex, CompileTask(pageIndex, false, priority)));
+        }
+
+        if (!draftPages.empty())
+        {
+            m_waitCondition.wakeOne();
+        }
     }
 
+    reportMemoryConsumption(m_cache->totalCost());
+
     for (const auto& error : errors)
     {
         Q_EMIT renderingError(error.first, { error.second });
@@ -334,7 +585,7 @@ PDFAsynchronousTextLayoutCompiler::PDFAsynchronousTextLayoutCompiler(PDFDrawWidg
     m_isRunning(false),
     m_cache(std::bind(&PDFAsynchronousTextLayoutCompiler::createTextLayout, this, std::placeholders::_1))
 {
-    connect(&m_textLayoutCompileFutureWatcher, &QFutureWatcher<PDFTextLayoutStorage>::finished, this, &PDFAsynchronousTextLayoutCompiler::onTextLayoutCreated);
+    connect(&m_textLayoutCompileFutureWatcher, &QFutureWatcher<TextLayoutResult>::finished, this, &PDFAsynchronousTextLayoutCompiler::onTextLayoutCreated);
 }
 
 void PDFAsynchronousTextLayoutCompiler::start()
@@ -372,9 +623,15 @@ void PDFAsynchronousTextLayoutCompiler::stop(bool clearCache)
             m_state = State::Stopping;
             m_textLayoutCompileFutureWatcher.waitForFinished();
 
+            // Results of running tasks are discarded
+            ++m_generation;
+            m_partialTextLayouts = std::nullopt;
+
             if (clearCache)
             {
                 m_textLayouts = std::nullopt;
+                m_textLayoutDependencies.clear();
+                m_previousTextLayouts.reset();
                 m_cache.clear();
             }
 
@@ -397,6 +654,23 @@ void PDFAsynchronousTextLayoutCompiler::reset()
     start();
 }
 
+void PDFAsynchronousTextLayoutCompiler::invalidateTextLayouts()
+{
+    Q_ASSERT(m_state == State::Inactive);
+
+    if (m_textLayouts)
+    {
+        auto previousTextLayouts = std::make_shared<TextLayoutResult>();
+        previousTextLayouts->textLayouts = std::move(*m_textLayouts);
+        previousTextLayouts->dependencies = std::move(m_textLayoutDependencies);
+        m_previousTextLayouts = std::move(previousTextLayouts);
+    }
+
+    m_textLayouts = std::nullopt;
+    m_textLayoutDependencies.clear();
+    m_cache.clear();
+}
+
 PDFTextLayout PDFAsynchronousTextLayoutCompiler::createTextLayout(PDFInteger pageIndex)
 {
     PDFTextLayout result;
@@ -462,6 +736,21 @@ PDFTextLayoutGetter PDFAsynchronousTextLayoutCompiler::getTextLayoutLazy(PDFInte
     return PDFTextLayoutGetter(&m_cache, pageIndex);
 }
 
+bool PDFAsynchronousTextLayoutCompiler::isHoveringOverTextBlock(PDFInteger pageIndex, const QPointF& point)
+{
+    if (m_state == State::Active && m_textLayouts)
+    {
+        PDFTextLayoutView textLayoutView = m_textLayouts->getTextLayoutView(pageIndex);
+        if (textLayoutView.isValid())
+        {
+            return textLayoutView.isHoveringOverTextBlock(point);
+        }
+    }
+
+    const PDFTextLayout& textLayout = m_cache.getTextLayout(pageIndex);
+    return textLayout.isHoveringOverTextBlock(point);
+}
+
 PDFTextSelection PDFAsynchronousTextLayoutCompiler::getTextSelectionAll(QColor color) const
 {
     PDFTextSelection result;
@@ -547,31 +836,140 @@ void PDFAsynchronousTextLayoutCompiler::makeTextLayout()
     m_proxy->getProgress()->start(catalog->getPageCount(), qMove(info));
 
     PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
+    QString fileName = m_textLayoutStorageFileName;
+    QByteArray documentHash = m_proxy->getDocument()->getSourceDataHash();
+    std::shared_ptr<const TextLayoutResult> previousTextLayouts = std::move(m_previousTextLayouts);
+    const quint64 generation = m_generation;
+
+    // Pages visible in the widget are processed first
+    std::vector<PDFInteger> activePages;
+    if (m_proxy->getWidget())
+    {
+        const PDFInteger pageCount = catalog->getPageCount();
+        activePages = m_proxy->getActivePages();
+        activePages.erase(std::remove_if(activePages.begin(), activePages.end(), [pageCount](PDFInteger pageIndex) { return pageIndex < 0 || pageIndex >= pageCount; }), activePages.end());
+    }
 
-    auto createTextLayout = [this, cms, catalog]() -> PDFTextLayoutStorage
+    auto createTextLayout = [this, cms, catalog, fileName, documentHash, previousTextLayouts, generation, activePages]() -> TextLayoutResult
     {
-        PDFTextLayoutStorage result(catalog->getPageCount());
+        const PDFDocument* document = m_proxy->getDocument();
+        const PDFInteger pageCount = catalog->getPageCount();
+
+        TextLayoutResult result;
+        result.generation = generation;
+        result.textLayouts = PDFTextLayoutStorage(pageCount);
+        result.dependencies.resize(pageCount);
+
+        auto pageRange = PDFIntegerRange<PDFInteger>(0, pageCount);
+        auto createDependencies = [document, &result](PDFInteger pageIndex)
+        {
+            result.dependencies[pageIndex] = PDFPageContentDependencies::create(document, pageIndex);
+        };
+
+        // Try to reuse text layouts persisted for this document (but only
+        // if document was not modified, persisted layouts are for original document)
+        const bool isPersistent = !fileName.isEmpty() && !documentHash.isEmpty() && !previousTextLayouts;
+        if (isPersistent)
+        {
+            PDFTextLayoutStorage storedResult;
+            if (storedResult.load(fileName, documentHash) && storedResult.getCount() == result.textLayouts.getCount())
+            {
+                result.textLayouts = std::move(storedResult);
+                PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), createDependencies);
+                return result;
+            }
+        }
+
         QMutex mutex;
-        auto generateTextLayout = [this, &result, &mutex, cms, catalog](PDFInteger pageIndex)
+        QElapsedTimer partialTextLayoutTimer;
+        partialTextLayoutTimer.start();
+
+        auto publishPartialTextLayout = [this, &result, &mutex, generation]()
+        {
+            PDFTextLayoutStorage textLayouts;
+            {
+                QMutexLocker lock(&mutex);
+                textLayouts = result.textLayouts;
+            }
+
+            QMetaObject::invokeMethod(this, [this, generation, textLayouts]() { onTextLayoutPartiallyCreated(generation, textLayouts); }, Qt::QueuedConnection);
+        };
+
+        auto generateTextLayout = [this, document, &result, &mutex, &partialTextLayoutTimer, &publishPartialTextLayout, &previousTextLayouts, cms, catalog](PDFInteger pageIndex)
         {
             if (!catalog->getPage(pageIndex))
             {
                 // Invalid page index
-                result.setTextLayout(pageIndex, PDFTextLayout(), &mutex);
+                result.textLayouts.setTextLayout(pageIndex, PDFTextLayout(), &mutex);
                 return;
             }
 
             const PDFPage* page = catalog->getPage(pageIndex);
             Q_ASSERT(page);
 
-            PDFTextLayoutGenerator generator(m_proxy->getFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
-            generator.processContents();
-            result.setTextLayout(pageIndex, generator.createTextLayout(), &mutex);
+            PDFPageContentDependencies dependencies = PDFPageContentDependencies::create(document, pageIndex);
+
+            // Text layout of page, whose content was not modified, is reused
+            const bool isTextLayoutReused = previousTextLayouts &&
+                                            pageIndex < PDFInteger(previousTextLayouts->dependencies.size()) &&
+                                            previousTextLayouts->dependencies[pageIndex].isValid() &&
+                                            previousTextLayouts->dependencies[pageIndex] == dependencies;
+
+            if (isTextLayoutReused)
+            {
+                result.textLayouts.setTextLayout(pageIndex, previousTextLayouts->textLayouts.getTextLayout(pageIndex), &mutex);
+            }
+            else
+            {
+                PDFTextLayoutGenerator generator(m_proxy->getFeatures(), page, document, m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
+                generator.processContents();
+                result.textLayouts.setTextLayout(pageIndex, generator.createTextLayout(), &mutex);
+            }
+
+            result.dependencies[pageIndex] = std::move(dependencies);
             m_proxy->getProgress()->step();
+
+            bool isPartialTextLayoutPublished = false;
+            {
+                QMutexLocker lock(&mutex);
+                if (partialTextLayoutTimer.hasExpired(PARTIAL_TEXT_LAYOUT_INTERVAL))
+                {
+                    partialTextLayoutTimer.restart();
+                    isPartialTextLayoutPublished = true;
+                }
+            }
+
+            if (isPartialTextLayoutPublished)
+            {
+                publishPartialTextLayout();
+            }
         };
 
-        auto pageRange = PDFIntegerRange<PDFInteger>(0, catalog->getPageCount());
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), generateTextLayout);
+        // Process active pages first, so they are searchable
+        // as soon as possible, then process remaining pages.
+        std::vector<PDFInteger> remainingPages;
+        remainingPages.reserve(pageCount);
+        for (const PDFInteger pageIndex : pageRange)
+        {
+            if (!std::binary_search(activePages.cbegin(), activePages.cend(), pageIndex))
+            {
+                remainingPages.push_back(pageIndex);
+            }
+        }
+
+        if (!activePages.empty())
+        {
+            PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, activePages.begin(), activePages.end(), generateTextLayout);
+            publishPartialTextLayout();
+        }
+
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, remainingPages.begin(), remainingPages.end(), generateTextLayout);
+
+        if (!fileName.isEmpty() && !documentHash.isEmpty() && !previousTextLayouts)
+        {
+            result.textLayouts.save(fileName, documentHash);
+        }
+
         return result;
     };
 
@@ -580,15 +978,1105 @@ void PDFAsynchronousTextLayoutCompiler::makeTextLayout()
     m_textLayoutCompileFutureWatcher.setFuture(m_textLayoutCompileFuture);
 }
 
+const PDFTextLayoutStorage* PDFAsynchronousTextLayoutCompiler::getTextLayoutStorage() const
+{
+    if (m_textLayouts)
+    {
+        return &m_textLayouts.value();
+    }
+
+    if (m_partialTextLayouts)
+    {
+        return &m_partialTextLayouts.value();
+    }
+
+    return nullptr;
+}
+
 void PDFAsynchronousTextLayoutCompiler::onTextLayoutCreated()
 {
     m_proxy->getFontCache()->setCacheShrinkEnabled(this, true);
     m_proxy->getProgress()->finish();
-    m_cache.clear();
-
-    m_textLayouts = m_textLayoutCompileFuture.result();
     m_isRunning = false;
+
+    TextLayoutResult result = m_textLayoutCompileFuture.result();
+    if (result.generation != m_generation)
+    {
+        // Text layout was created for the old document
+        return;
+    }
+
+    m_cache.clear();
+    m_partialTextLayouts = std::nullopt;
+    m_textLayouts = std::move(result.textLayouts);
+    m_textLayoutDependencies = std::move(result.dependencies);
     Q_EMIT textLayoutChanged();
 }
 
+void PDFAsynchronousTextLayoutCompiler::onTextLayoutPartiallyCreated(quint64 generation, PDFTextLayoutStorage textLayouts)
+{
+    if (generation != m_generation || !m_isRunning || m_textLayouts)
+    {
+        // Partial text layout is no longer valid
+        return;
+    }
+
+    m_partialTextLayouts = std::move(textLayouts);
+    Q_EMIT textLayoutPartiallyChanged();
+}
+
+PDFAsynchronousTileRenderer::PDFAsynchronousTileRenderer(PDFDrawWidgetProxy* proxy) :
+    BaseClass(proxy),
+    m_proxy(proxy),
+    m_cache(new QCache<TileKey, QImage>())
+{
+    m_cache->setMaxCost(128 * 1024 * 1024);
+    connect(&m_renderFutureWatcher, &QFutureWatcher<std::vector<RenderTask>>::finished, this, &PDFAsynchronousTileRenderer::onTilesRendered);
+}
+
+PDFAsynchronousTileRenderer::~PDFAsynchronousTileRenderer()
+{
+    stop(true);
+
+    delete m_cache;
+    m_cache = nullptr;
+}
+
+void PDFAsynchronousTileRenderer::start()
+{
+    switch (m_state)
+    {
+        case State::Inactive:
+        {
+            m_state = State::Active;
+            break;
+        }
+
+        case State::Active:
+            break; // We have nothing to do...
+
+        case State::Stopping:
+        {
+            // We shouldn't call this function while stopping!
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+void PDFAsynchronousTileRenderer::stop(bool clearCache)
+{
+    switch (m_state)
+    {
+        case State::Inactive:
+            break; // We have nothing to do...
+
+        case State::Active:
+        {
+            // Stop the engine. Running tasks are cancelled and their results
+            // are discarded, because generation is changed.
+            m_state = State::Stopping;
+            m_renderFutureWatcher.waitForFinished();
+            m_renderFuture = QFuture<std::vector<RenderTask>>();
+            m_isRendering = false;
+            m_requestedTasks.clear();
+            m_renderedTiles.clear();
+            ++m_generation;
+
+            if (clearCache)
+            {
+                m_cache->clear();
+            }
+
+            m_state = State::Inactive;
+            break;
+        }
+
+        case State::Stopping:
+        {
+            // We shouldn't call this function while stopping!
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+void PDFAsynchronousTileRenderer::reset()
+{
+    stop(true);
+    start();
+}
+
+void PDFAsynchronousTileRenderer::setCacheLimit(qint64 limit)
+{
+    m_cache->setMaxCost(limit);
+}
+
+void PDFAsynchronousTileRenderer::beginDraw()
+{
+    m_requestedTasks.clear();
+}
+
+void PDFAsynchronousTileRenderer::finishDraw()
+{
+    startRendering();
+}
+
+bool PDFAsynchronousTileRenderer::drawPage(QPainter* painter,
+                                           PDFInteger pageIndex,
+                                           const PDFPage* page,
+                                           const QRect& placedRect,
+                                           const QRect& clipRect,
+                                           PDFRenderer::Features features,
+                                           PDFReal opacity)
+{
+    if (m_state != State::Active || painter->worldTransform().type() > QTransform::TxTranslate || placedRect.isEmpty())
+    {
+        return false;
+    }
+
+    std::shared_ptr<const PDFPrecompiledPage> compiledPage = m_proxy->getCompiler()->getCompiledPagePointer(pageIndex);
+    if (!compiledPage)
+    {
+        return false;
+    }
+
+    const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+    const QSize pageSize = (QSizeF(placedRect.size()) * devicePixelRatio).toSize();
+    const QRect visibleRect = placedRect.intersected(clipRect);
+
+    if (pageSize.isEmpty() || visibleRect.isEmpty())
+    {
+        return false;
+    }
+
+    TileKey baseKey;
+    baseKey.pageIndex = pageIndex;
+    baseKey.pageRotation = static_cast<int>(m_proxy->getPageRotation());
+    baseKey.features = features.toInt();
+
+    // Preview doesn't depend on the zoom, so it can be also used, when zoom is changed
+    TileKey previewKey = baseKey;
+    QSize previewSize = pageSize.scaled(PREVIEW_SIZE, PREVIEW_SIZE, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+    previewKey.pageWidth = previewSize.width();
+    previewKey.pageHeight = previewSize.height();
+
+    const QImage* previewImage = m_cache->object(previewKey);
+    if (!previewImage)
+    {
+        requestTile(previewKey, compiledPage, page);
+    }
+
+    // Determine visible tiles (in device pixels relative to the page)
+    const QRectF visiblePageRect = QRectF(visibleRect.translated(-placedRect.topLeft()));
+    const int firstTileX = qMax(qFloor(visiblePageRect.left() * devicePixelRatio / TILE_SIZE), 0);
+    const int firstTileY = qMax(qFloor(visiblePageRect.top() * devicePixelRatio / TILE_SIZE), 0);
+    const int lastTileX = qMin(qCeil(visiblePageRect.right() * devicePixelRatio / TILE_SIZE) - 1, (pageSize.width() - 1) / TILE_SIZE);
+    const int lastTileY = qMin(qCeil(visiblePageRect.bottom() * devicePixelRatio / TILE_SIZE) - 1, (pageSize.height() - 1) / TILE_SIZE);
+
+    std::vector<std::pair<TileKey, const QImage*>> tiles;
+    bool isMissingTile = false;
+    for (int tileY = firstTileY; tileY <= lastTileY; ++tileY)
+    {
+        for (int tileX = firstTileX; tileX <= lastTileX; ++tileX)
+        {
+            TileKey key = baseKey;
+            key.pageWidth = pageSize.width();
+            key.pageHeight = pageSize.height();
+            key.tileX = tileX;
+            key.tileY = tileY;
+
+            const QImage* image = m_cache->object(key);
+            if (!image)
+            {
+                requestTile(key, compiledPage, page);
+                isMissingTile = true;
+            }
+            tiles.emplace_back(key, image);
+        }
+    }
+
+    if (isMissingTile && !previewImage)
+    {
+        // We can't replace missing tiles by the preview, page
+        // must be drawn directly.
+        return false;
+    }
+
+    painter->save();
+    painter->setClipRect(visibleRect, Qt::IntersectClip);
+    painter->setOpacity(opacity);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+
+    const QPointF pageTopLeft = placedRect.topLeft();
+    const qreal tileSize = TILE_SIZE / devicePixelRatio;
+    for (const auto& tile : tiles)
+    {
+        const TileKey& key = tile.first;
+        QRectF targetRect(pageTopLeft.x() + key.tileX * tileSize, pageTopLeft.y() + key.tileY * tileSize, tileSize, tileSize);
+        targetRect = targetRect.intersected(QRectF(placedRect));
+
+        if (const QImage* image = tile.second)
+        {
+            QRectF sourceRect(QPointF(0, 0), targetRect.size() * devicePixelRatio);
+            painter->drawImage(targetRect, *image, sourceRect);
+        }
+        else
+        {
+            // Draw scaled part of the low resolution preview
+            const qreal scaleX = qreal(previewImage->width()) / placedRect.width();
+            const qreal scaleY = qreal(previewImage->height()) / placedRect.height();
+            QRectF sourceRect((targetRect.left() - pageTopLeft.x()) * scaleX, (targetRect.top() - pageTopLeft.y()) * scaleY, targetRect.width() * scaleX, targetRect.height() * scaleY);
+            painter->drawImage(targetRect, *previewImage, sourceRect);
+        }
+    }
+
+    painter->restore();
+    return true;
+}
+
+void PDFAsynchronousTileRenderer::onPageImageChanged(bool all, const std::vector<PDFInteger>& pages)
+{
+    if (all)
+    {
+        ++m_generation;
+        m_cache->clear();
+        m_requestedTasks.clear();
+        return;
+    }
+
+    Q_ASSERT(std::is_sorted(pages.cbegin(), pages.cend()));
+
+    for (PDFInteger pageIndex : pages)
+    {
+        ++m_pageGenerations[pageIndex];
+    }
+
+    auto isInvalidated = [&pages](const TileKey& key) { return std::binary_search(pages.cbegin(), pages.cend(), key.pageIndex); };
+
+    const QList<TileKey> keys = m_cache->keys();
+    for (const TileKey& key : keys)
+    {
+        if (isInvalidated(key))
+        {
+            m_cache->remove(key);
+        }
+    }
+
+    for (auto it = m_requestedTasks.begin(); it != m_requestedTasks.end();)
+    {
+        if (isInvalidated(it->first))
+        {
+            it = m_requestedTasks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+quint64 PDFAsynchronousTileRenderer::getGeneration(PDFInteger pageIndex) const
+{
+    // Both generations are only increased, so their sum is changed,
+    // whenever any of them is changed.
+    auto it = m_pageGenerations.find(pageIndex);
+    return m_generation + (it != m_pageGenerations.cend() ? it->second : 0);
+}
+
+void PDFAsynchronousTileRenderer::requestTile(const TileKey& key, const std::shared_ptr<const PDFPrecompiledPage>& compiledPage, const PDFPage* page)
+{
+    if (m_renderedTiles.count(key) || m_requestedTasks.count(key))
+    {
+        return;
+    }
+
+    RenderTask task;
+    task.key = key;
+    task.generation = getGeneration(key.pageIndex);
+    task.compiledPage = compiledPage;
+    task.cropBox = page->getCropBox();
+    task.rendererEngine = m_proxy->getRendererEngine();
+    task.optionalContentActivity = m_proxy->getOptionalContentActivity();
+
+    QTransform matrix = m_proxy->createPagePointToDevicePointMatrix(page, QRectF(0, 0, key.pageWidth, key.pageHeight));
+    if (key.isPreview())
+    {
+        task.size = QSize(key.pageWidth, key.pageHeight);
+    }
+    else
+    {
+        const int left = key.tileX * TILE_SIZE;
+        const int top = key.tileY * TILE_SIZE;
+        task.size = QSize(qMin(TILE_SIZE, key.pageWidth - left), qMin(TILE_SIZE, key.pageHeight - top));
+        matrix = matrix * QTransform::fromTranslate(-left, -top);
+    }
+    task.pagePointToDevicePointMatrix = matrix;
+
+    m_requestedTasks[key] = std::move(task);
+}
+
+void PDFAsynchronousTileRenderer::startRendering()
+{
+    if (m_state != State::Active || m_requestedTasks.empty() || m_isRendering)
+    {
+        return;
+    }
+
+    // Previews are rendered first, so missing tiles
+    // can be replaced by the preview as soon as possible.
+    std::vector<RenderTask> tasks;
+    for (auto it = m_requestedTasks.begin(); it != m_requestedTasks.end();)
+    {
+        if (it->first.isPreview())
+        {
+            m_renderedTiles.insert(it->first);
+            tasks.push_back(std::move(it->second));
+            it = m_requestedTasks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (tasks.empty())
+    {
+        for (auto& item : m_requestedTasks)
+        {
+            m_renderedTiles.insert(item.first);
+            tasks.push_back(std::move(item.second));
+        }
+        m_requestedTasks.clear();
+    }
+
+    auto renderTiles = [this, tasks = std::move(tasks)]() -> std::vector<RenderTask>
+    {
+        std::vector<RenderTask> renderedTasks = tasks;
+        auto renderTile = [this](RenderTask& task)
+        {
+            if (m_state != State::Active)
+            {
+                // Rendering was cancelled
+                return;
+            }
+
+            QImage image(task.size, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+
+            if (task.rendererEngine == RendererEngine::Blend2D_MultiThread ||
+                task.rendererEngine == RendererEngine::Blend2D_SingleThread)
+            {
+                PDFBLPaintDevice blPaintDevice(image, false);
+                QPainter painter(&blPaintDevice);
+                task.compiledPage->draw(&painter, task.cropBox, task.pagePointToDevicePointMatrix, PDFRenderer::Features(task.key.features), 1.0, task.optionalContentActivity);
+            }
+            else
+            {
+                QPainter painter(&image);
+                task.compiledPage->draw(&painter, task.cropBox, task.pagePointToDevicePointMatrix, PDFRenderer::Features(task.key.features), 1.0, task.optionalContentActivity);
+            }
+
+            task.image = std::move(image);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, renderedTasks.begin(), renderedTasks.end(), renderTile);
+        return renderedTasks;
+    };
+
+    m_isRendering = true;
+    m_renderFuture = QtConcurrent::run(std::move(renderTiles));
+    m_renderFutureWatcher.setFuture(m_renderFuture);
+}
+
+void PDFAsynchronousTileRenderer::onTilesRendered()
+{
+    if (!m_isRendering || !m_renderFuture.isFinished())
+    {
+        // Rendering was stopped and results were discarded, or this
+        // is a late notification from the previous rendering.
+        return;
+    }
+
+    std::vector<RenderTask> tasks = m_renderFuture.result();
+    m_renderFuture = QFuture<std::vector<RenderTask>>();
+    m_isRendering = false;
+
+    bool isSomethingWritten = false;
+    for (RenderTask& task : tasks)
+    {
+        m_renderedTiles.erase(task.key);
+
+        if (m_state == State::Active && !task.image.isNull() && task.generation == getGeneration(task.key.pageIndex))
+        {
+            const qint64 cost = task.image.sizeInBytes();
+            isSomethingWritten = m_cache->insert(task.key, new QImage(std::move(task.image)), cost) || isSomethingWritten;
+        }
+    }
+
+    if (isSomethingWritten)
+    {
+        Q_EMIT tilesRendered();
+    }
+
+    startRendering();
+}
+
+static constexpr const char* THUMBNAIL_ATLAS_MAGIC = "PDF4QTTA";
+static constexpr const char* THUMBNAIL_ATLAS_SUFFIX = "pdfthumbs";
+
+PDFAsynchronousThumbnailRenderer::PDFAsynchronousThumbnailRenderer(PDFDrawWidgetProxy* proxy) :
+    BaseClass(proxy),
+    m_proxy(proxy),
+    m_atlasDirectory(getDefaultAtlasDirectory())
+{
+    // Thumbnails are rendered in single low priority thread, so
+    // they don't slow down the compilation of visible pages.
+    m_threadPool.setMaxThreadCount(1);
+    m_threadPool.setThreadPriority(QThread::LowPriority);
+
+    connect(&m_renderFutureWatcher, &QFutureWatcher<std::vector<RenderTask>>::finished, this, &PDFAsynchronousThumbnailRenderer::onThumbnailsRendered);
+}
+
+PDFAsynchronousThumbnailRenderer::~PDFAsynchronousThumbnailRenderer()
+{
+    stop(true);
+}
+
+void PDFAsynchronousThumbnailRenderer::start()
+{
+    switch (m_state)
+    {
+        case State::Inactive:
+        {
+            m_state = State::Active;
+            startRendering();
+            break;
+        }
+
+        case State::Active:
+            break; // We have nothing to do...
+
+        case State::Stopping:
+        {
+            // We shouldn't call this function while stopping!
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::stop(bool clearCache)
+{
+    switch (m_state)
+    {
+        case State::Inactive:
+            break; // We have nothing to do...
+
+        case State::Active:
+        {
+            // Stop the engine. Running tasks are cancelled and their results
+            // are discarded. Thumbnails, which were being rendered, are
+            // requested again, so they are rendered, when engine is started.
+            m_state = State::Stopping;
+            m_renderFutureWatcher.waitForFinished();
+            m_renderFuture = QFuture<std::vector<RenderTask>>();
+            m_isRendering = false;
+
+            for (PDFInteger pageIndex : m_renderedPages)
+            {
+                RenderTask& task = m_requestedTasks[pageIndex];
+                task.pageIndex = pageIndex;
+                task.order = ++m_requestCounter;
+            }
+            m_renderedPages.clear();
+
+            if (clearCache)
+            {
+                storeAtlas();
+
+                ++m_generation;
+                m_requestedTasks.clear();
+                m_thumbnails.clear();
+                m_embeddedThumbnails.clear();
+                m_atlas.clear();
+                m_atlasKey.clear();
+                m_isAtlasLoaded = false;
+                m_isAtlasInvalidated = false;
+            }
+
+            m_state = State::Inactive;
+            break;
+        }
+
+        case State::Stopping:
+        {
+            // We shouldn't call this function while stopping!
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::reset()
+{
+    stop(true);
+    start();
+}
+
+void PDFAsynchronousThumbnailRenderer::invalidateThumbnails()
+{
+    Q_ASSERT(m_state == State::Inactive);
+
+    // Thumbnails rendered so far belong to the original document,
+    // so they can be still stored in the atlas.
+    storeAtlas();
+
+    ++m_generation;
+    m_embeddedThumbnails.clear();
+    m_atlas.clear();
+    m_atlasKey.clear();
+    m_isAtlasLoaded = false;
+    m_isAtlasInvalidated = true;
+
+    Q_EMIT thumbnailsChanged(true, { });
+}
+
+void PDFAsynchronousThumbnailRenderer::setAtlasDirectory(QString directory, qint64 sizeLimit)
+{
+    storeAtlas();
+
+    m_atlasDirectory = std::move(directory);
+    m_atlasSizeLimit = sizeLimit;
+    m_atlas.clear();
+    m_atlasKey.clear();
+    m_isAtlasLoaded = false;
+}
+
+QString PDFAsynchronousThumbnailRenderer::getDefaultAtlasDirectory()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("thumbnails");
+}
+
+QImage PDFAsynchronousThumbnailRenderer::getThumbnail(PDFInteger pageIndex, int pixelSize)
+{
+    if (m_pixelSize != pixelSize)
+    {
+        // Atlas is stored for each thumbnail size separately, previously
+        // rendered thumbnails are used as stale thumbnails (scaled).
+        storeAtlas();
+
+        m_pixelSize = pixelSize;
+        ++m_generation;
+        m_requestedTasks.clear();
+        m_atlas.clear();
+        m_atlasKey.clear();
+        m_isAtlasLoaded = false;
+    }
+
+    const QSize size = getThumbnailSize(pageIndex);
+    if (!size.isValid())
+    {
+        return QImage();
+    }
+
+    auto it = m_thumbnails.find(pageIndex);
+    if (it != m_thumbnails.cend() && it->second.generation == m_generation && it->second.image.size() == size)
+    {
+        return it->second.image;
+    }
+
+    loadAtlas();
+
+    auto atlasIt = m_atlas.find(pageIndex);
+    if (atlasIt != m_atlas.cend())
+    {
+        QImage image = QImage::fromData(atlasIt->second, "JPG");
+        if (image.size() == size)
+        {
+            m_thumbnails[pageIndex] = Thumbnail{ image, m_generation };
+            return image;
+        }
+
+        // Invalid atlas entry, render the thumbnail again
+        m_atlas.erase(atlasIt);
+    }
+
+    requestThumbnail(pageIndex, size);
+
+    // Provide substitute image, until thumbnail is rendered
+    QImage image;
+    if (it != m_thumbnails.cend())
+    {
+        image = it->second.image;
+    }
+
+    if (image.isNull())
+    {
+        image = getEmbeddedThumbnail(pageIndex);
+    }
+
+    if (image.isNull())
+    {
+        image = QImage(size, QImage::Format_RGBA8888_Premultiplied);
+        image.fill(Qt::white);
+    }
+    else if (image.size() != size)
+    {
+        image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    return image;
+}
+
+void PDFAsynchronousThumbnailRenderer::onPageImageChanged(bool all, const std::vector<PDFInteger>& pages)
+{
+    Q_UNUSED(pages);
+
+    if (!all)
+    {
+        // Pages have been compiled, but their image remains the same
+        return;
+    }
+
+    // Renderer settings have been changed, so atlas with different
+    // renderer key must be used and thumbnails must be rendered again.
+    storeAtlas();
+
+    ++m_generation;
+    m_atlas.clear();
+    m_atlasKey.clear();
+    m_isAtlasLoaded = false;
+
+    Q_EMIT thumbnailsChanged(true, { });
+}
+
+QSize PDFAsynchronousThumbnailRenderer::getThumbnailSize(PDFInteger pageIndex) const
+{
+    const PDFDocument* document = m_proxy->getDocument();
+    if (!document || m_pixelSize <= 0)
+    {
+        return QSize();
+    }
+
+    if (const PDFPage* page = document->getCatalog()->getPage(pageIndex))
+    {
+        QSizeF pageSize = page->getRotatedMediaBox().size();
+        pageSize.scale(m_pixelSize, m_pixelSize, Qt::KeepAspectRatio);
+        return pageSize.toSize();
+    }
+
+    return QSize();
+}
+
+QImage PDFAsynchronousThumbnailRenderer::getEmbeddedThumbnail(PDFInteger pageIndex) const
+{
+    auto it = m_embeddedThumbnails.find(pageIndex);
+    if (it != m_embeddedThumbnails.cend())
+    {
+        return it->second;
+    }
+
+    QImage image;
+    const PDFDocument* document = m_proxy->getDocument();
+    const PDFPage* page = document ? document->getCatalog()->getPage(pageIndex) : nullptr;
+    if (page && page->getThumbnailReference().isValid())
+    {
+        try
+        {
+            const PDFObject& thumbnailObject = document->getObjectByReference(page->getThumbnailReference());
+            if (thumbnailObject.isStream())
+            {
+                const PDFStream* stream = thumbnailObject.getStream();
+                const PDFDictionary* dictionary = stream->getDictionary();
+
+                PDFColorSpacePointer colorSpace;
+                const PDFObject& colorSpaceObject = document->getObject(dictionary->get("ColorSpace"));
+                if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+                {
+                    PDFDictionary dummyColorSpaceDictionary;
+                    colorSpace = PDFAbstractColorSpace::createColorSpace(&dummyColorSpaceDictionary, document, colorSpaceObject);
+                }
+
+                PDFRenderErrorReporterDummy dummyErrorReporter;
+                PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
+                PDFImage pdfImage = PDFImage::createImage(document, stream, qMove(colorSpace), false, RenderingIntent::Perceptual, &dummyErrorReporter);
+                image = pdfImage.getImage(cms.data(), &dummyErrorReporter, nullptr);
+            }
+        }
+        catch (const PDFException&)
+        {
+            // Embedded thumbnail is invalid, we will wait for the rendered one
+            image = QImage();
+        }
+    }
+
+    m_embeddedThumbnails[pageIndex] = image;
+    return image;
+}
+
+void PDFAsynchronousThumbnailRenderer::requestThumbnail(PDFInteger pageIndex, QSize size)
+{
+    if (m_renderedPages.count(pageIndex))
+    {
+        return;
+    }
+
+    // Most recently requested thumbnails (usually visible ones)
+    // are rendered first, so we update the order of the task.
+    RenderTask& task = m_requestedTasks[pageIndex];
+    task.pageIndex = pageIndex;
+    task.size = size;
+    task.order = ++m_requestCounter;
+
+    if (!m_isRenderingScheduled)
+    {
+        // Rendering is started after all thumbnails of the view are requested
+        m_isRenderingScheduled = true;
+        QMetaObject::invokeMethod(this, [this]() { m_isRenderingScheduled = false; startRendering(); }, Qt::QueuedConnection);
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::startRendering()
+{
+    if (m_state != State::Active || m_requestedTasks.empty() || m_isRendering)
+    {
+        return;
+    }
+
+    const PDFDocument* document = m_proxy->getDocument();
+    if (!document)
+    {
+        m_requestedTasks.clear();
+        return;
+    }
+
+    std::vector<RenderTask> tasks;
+    tasks.reserve(m_requestedTasks.size());
+    for (auto& item : m_requestedTasks)
+    {
+        tasks.push_back(std::move(item.second));
+    }
+    m_requestedTasks.clear();
+
+    std::sort(tasks.begin(), tasks.end(), [](const RenderTask& l, const RenderTask& r) { return l.order > r.order; });
+
+    if (tasks.size() > BATCH_SIZE)
+    {
+        for (auto it = std::next(tasks.begin(), BATCH_SIZE); it != tasks.end(); ++it)
+        {
+            m_requestedTasks[it->pageIndex] = std::move(*it);
+        }
+        tasks.resize(BATCH_SIZE);
+    }
+
+    for (RenderTask& task : tasks)
+    {
+        // Size of the thumbnail can be changed, when task was stopped and requested again
+        task.size = getThumbnailSize(task.pageIndex);
+        task.generation = m_generation;
+
+        // Use already compiled page, if it is available
+        std::shared_ptr<const PDFPrecompiledPage> compiledPage = m_proxy->getCompiler()->getCompiledPagePointer(task.pageIndex);
+        if (compiledPage && compiledPage->isValid() && !compiledPage->isDraft())
+        {
+            task.compiledPage = std::move(compiledPage);
+        }
+
+        m_renderedPages.insert(task.pageIndex);
+    }
+
+    PDFFontCache* fontCache = m_proxy->getFontCache();
+    PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
+    const PDFOptionalContentActivity* optionalContentActivity = m_proxy->getOptionalContentActivity();
+    PDFRenderer::Features features = m_proxy->getFeatures();
+    PDFMeshQualitySettings meshQualitySettings = m_proxy->getMeshQualitySettings();
+    RendererEngine rendererEngine = m_proxy->getRendererEngine();
+
+    auto renderThumbnails = [this, tasks = std::move(tasks), document, fontCache, cms, optionalContentActivity, features, meshQualitySettings, rendererEngine]() -> std::vector<RenderTask>
+    {
+        std::vector<RenderTask> renderedTasks = tasks;
+        fontCache->setCacheShrinkEnabled(this, false);
+
+        for (RenderTask& task : renderedTasks)
+        {
+            const PDFPage* page = document->getCatalog()->getPage(task.pageIndex);
+            if (m_state != State::Active || !page || !task.size.isValid())
+            {
+                // Rendering was cancelled, or page doesn't exist
+                continue;
+            }
+
+            if (!task.compiledPage)
+            {
+                std::shared_ptr<PDFPrecompiledPage> compiledPage = std::make_shared<PDFPrecompiledPage>();
+                PDFRenderer renderer(document, fontCache, cms.data(), optionalContentActivity, features, meshQualitySettings);
+                renderer.compile(compiledPage.get(), task.pageIndex);
+                task.compiledPage = std::move(compiledPage);
+            }
+
+            QImage image(task.size, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::white);
+
+            QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), task.size), PageRotation::None);
+            if (rendererEngine == RendererEngine::Blend2D_MultiThread ||
+                rendererEngine == RendererEngine::Blend2D_SingleThread)
+            {
+                PDFBLPaintDevice blPaintDevice(image, false);
+                QPainter painter(&blPaintDevice);
+                task.compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0, optionalContentActivity);
+            }
+            else
+            {
+                QPainter painter(&image);
+                task.compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0, optionalContentActivity);
+            }
+
+            task.image = std::move(image);
+        }
+
+        fontCache->setCacheShrinkEnabled(this, true);
+        return renderedTasks;
+    };
+
+    m_isRendering = true;
+    m_renderFuture = QtConcurrent::run(&m_threadPool, std::move(renderThumbnails));
+    m_renderFutureWatcher.setFuture(m_renderFuture);
+}
+
+void PDFAsynchronousThumbnailRenderer::onThumbnailsRendered()
+{
+    if (!m_isRendering || !m_renderFuture.isFinished())
+    {
+        // Rendering was stopped and results were discarded, or this
+        // is a late notification from the previous rendering.
+        return;
+    }
+
+    std::vector<RenderTask> tasks = m_renderFuture.result();
+    m_renderFuture = QFuture<std::vector<RenderTask>>();
+    m_isRendering = false;
+
+    const PDFDocument* document = m_proxy->getDocument();
+    const PDFAnnotationManager* annotationManager = m_proxy->getWidget() ? m_proxy->getWidget()->getAnnotationManager() : nullptr;
+    PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
+    PDFColorConvertor convertor = cms->getColorConvertor();
+    PDFRenderer::applyFeaturesToColorConvertor(m_proxy->getFeatures(), convertor);
+
+    std::vector<PDFInteger> pages;
+    for (RenderTask& task : tasks)
+    {
+        m_renderedPages.erase(task.pageIndex);
+
+        if (m_state != State::Active || task.image.isNull() || task.generation != m_generation || task.size != getThumbnailSize(task.pageIndex))
+        {
+            continue;
+        }
+
+        // Annotations are drawn in the main thread, because annotation
+        // manager of the widget isn't designed to be used from other threads.
+        if (annotationManager)
+        {
+            const PDFPage* page = document->getCatalog()->getPage(task.pageIndex);
+            QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), task.size), PageRotation::None);
+
+            QPainter painter(&task.image);
+            QList<PDFRenderError> errors;
+            PDFTextLayoutGetter textLayoutGetter(nullptr, task.pageIndex);
+            annotationManager->drawPage(&painter, task.pageIndex, task.compiledPage.get(), textLayoutGetter, matrix, convertor, errors);
+        }
+
+        if (!m_atlasKey.isEmpty())
+        {
+            QByteArray data;
+            QBuffer buffer(&data);
+            buffer.open(QBuffer::WriteOnly);
+            if (task.image.convertToFormat(QImage::Format_RGB32).save(&buffer, "JPG", 90))
+            {
+                m_atlas[task.pageIndex] = std::move(data);
+                m_isAtlasModified = true;
+            }
+        }
+
+        m_thumbnails[task.pageIndex] = Thumbnail{ std::move(task.image), task.generation };
+        pages.push_back(task.pageIndex);
+    }
+
+    if (!pages.empty())
+    {
+        std::sort(pages.begin(), pages.end());
+        Q_EMIT thumbnailsChanged(false, pages);
+    }
+
+    startRendering();
+}
+
+QByteArray PDFAsynchronousThumbnailRenderer::createAtlasKey() const
+{
+    const PDFDocument* document = m_proxy->getDocument();
+    if (m_atlasDirectory.isEmpty() || m_isAtlasInvalidated || m_pixelSize <= 0 || !document)
+    {
+        return QByteArray();
+    }
+
+    const QByteArray rendererKey = PDFPrecompiledPageCache::createRendererKey(document,
+                                                                              m_proxy->getFeatures(),
+                                                                              m_proxy->getCMSManager()->getSettings(),
+                                                                              m_proxy->getMeshQualitySettings(),
+                                                                              m_proxy->getOptionalContentActivity());
+    if (rendererKey.isEmpty())
+    {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(ATLAS_VERSION));
+    hash.addData(document->getSourceDataHash());
+    hash.addData(rendererKey);
+    hash.addData(QByteArray::number(m_pixelSize));
+    return hash.result();
+}
+
+QString PDFAsynchronousThumbnailRenderer::getAtlasFileName(const QByteArray& atlasKey) const
+{
+    return QDir(m_atlasDirectory).filePath(QString("%1.%2").arg(QString::fromLatin1(atlasKey.toHex()), THUMBNAIL_ATLAS_SUFFIX));
+}
+
+void PDFAsynchronousThumbnailRenderer::loadAtlas()
+{
+    if (m_isAtlasLoaded)
+    {
+        return;
+    }
+
+    m_isAtlasLoaded = true;
+    m_isAtlasModified = false;
+    m_atlas.clear();
+    m_atlasKey = createAtlasKey();
+
+    if (m_atlasKey.isEmpty())
+    {
+        return;
+    }
+
+    QFile file(getAtlasFileName(m_atlasKey));
+    if (!file.open(QFile::ReadOnly))
+    {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    QByteArray magic(8, Qt::Uninitialized);
+    qint32 version = 0;
+    QByteArray storedAtlasKey;
+    qint64 count = 0;
+
+    if (stream.readRawData(magic.data(), magic.size()) != magic.size() || magic != THUMBNAIL_ATLAS_MAGIC)
+    {
+        return;
+    }
+
+    stream >> version;
+    stream >> storedAtlasKey;
+    stream >> count;
+
+    if (stream.status() != QDataStream::Ok || version != ATLAS_VERSION || storedAtlasKey != m_atlasKey)
+    {
+        return;
+    }
+
+    std::map<PDFInteger, QByteArray> atlas;
+    for (qint64 i = 0; i < count; ++i)
+    {
+        qint64 pageIndex = -1;
+        QByteArray data;
+        stream >> pageIndex;
+        stream >> data;
+
+        if (stream.status() != QDataStream::Ok)
+        {
+            return;
+        }
+
+        atlas[pageIndex] = std::move(data);
+    }
+
+    file.close();
+    m_atlas = std::move(atlas);
+
+    // Mark file as recently used, so it is not removed by the pruning
+    if (file.open(QFile::ReadWrite))
+    {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        file.close();
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::storeAtlas()
+{
+    if (!m_isAtlasModified || m_atlasKey.isEmpty())
+    {
+        return;
+    }
+
+    m_isAtlasModified = false;
+    QDir().mkpath(m_atlasDirectory);
+
+    QSaveFile file(getAtlasFileName(m_atlasKey));
+    if (!file.open(QFile::WriteOnly))
+    {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.writeRawData(THUMBNAIL_ATLAS_MAGIC, 8);
+    stream << ATLAS_VERSION;
+    stream << m_atlasKey;
+    stream << qint64(m_atlas.size());
+
+    for (const auto& item : m_atlas)
+    {
+        stream << qint64(item.first);
+        stream << item.second;
+    }
+
+    if (stream.status() == QDataStream::Ok && file.commit())
+    {
+        pruneAtlasDirectory();
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::pruneAtlasDirectory()
+{
+    QDir directory(m_atlasDirectory);
+    QFileInfoList fileInfos = directory.entryInfoList({ QString("*.%1").arg(THUMBNAIL_ATLAS_SUFFIX) }, QDir::Files);
+
+    qint64 size = 0;
+    for (const QFileInfo& fileInfo : fileInfos)
+    {
+        size += fileInfo.size();
+    }
+
+    if (size > m_atlasSizeLimit)
+    {
+        // Remove least recently used atlases first
+        std::sort(fileInfos.begin(), fileInfos.end(), [](const QFileInfo& l, const QFileInfo& r) { return l.lastModified() < r.lastModified(); });
+
+        for (const QFileInfo& fileInfo : fileInfos)
+        {
+            if (size <= m_atlasSizeLimit)
+            {
+                break;
+            }
+
+            if (directory.remove(fileInfo.fileName()))
+            {
+                size -= fileInfo.size();
+            }
+        }
+    }
+}
+
 }   // namespace pdf
@@ -23,10 +23,17 @@
 #include "pdfrenderer.h"
 #include "pdfpainter.h"
 #include "pdftextlayout.h"
+#include "pdfmemorybudget.h"
 
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QWaitCondition>
+#include <QThreadPool>
+#include <QHashFunctions>
+
+#include <set>
+#include <map>
+#include <atomic>
 
 template <class Key, class T>
 class QCache;
@@ -57,8 +64,9 @@ private:
 
 /// Asynchronous page compiler compiles pages asynchronously, and stores them in the
 /// cache. Cache size can be set. This object is designed to cooperate with
-/// draw widget proxy.
-class PDFAsynchronousPageCompiler : public QObject, public PDFOperationControl
+/// draw widget proxy. If the global memory budget is set, cache size is
+/// assigned by the budget.
+class PDFAsynchronousPageCompiler : public QObject, public PDFOperationControl, public PDFMemoryBudgetClient
 {
     Q_OBJECT
 
@@ -85,10 +93,23 @@ public:
     /// Resets the engine - calls stop and then calls start.
     void reset();
 
+    /// Removes pages, whose content was modified in the new document, from the cache.
+    /// Page content is modified, if some object, on which page content depends (content
+    /// streams, resources, fonts, images, ...), is changed. Other pages remain in the cache.
+    /// Call this function only if engine is stopped.
+    /// \param document Modified document
+    void removeModifiedPages(const PDFDocument* document);
+
     /// Sets cache limit in bytes
     /// \param limit Cache limit [bytes]
     void setCacheLimit(int limit);
 
+    /// Sets persistent (on-disk) cache of precompiled pages. Pages are loaded from
+    /// this cache, if they were already compiled using the same settings, and newly
+    /// compiled pages are stored into the cache. Pass nullptr to disable the cache.
+    /// \param precompiledPageCache Precompiled page cache (can be nullptr)
+    void setPrecompiledPageCache(std::shared_ptr<PDFPrecompiledPageCache> precompiledPageCache);
+
     enum class State
     {
         Inactive,
@@ -96,6 +117,15 @@ public:
         Stopping
     };
 
+    /// Priority of the compile task. Tasks with higher priority
+    /// (lower value) are compiled first.
+    enum class Priority
+    {
+        Visible,    ///< Page is visible in the widget
+        Prefetch,   ///< Page will be probably visible soon (scrolling)
+        Thumbnail   ///< Page is needed for thumbnail
+    };
+
     /// Returns current state of compiler
     State getState() const { return m_state; }
 
@@ -108,18 +138,38 @@ public:
     /// task is performed.
     /// \param pageIndex Index of page
     /// \param compile Compile the page, if it is not found in the cache
-    const PDFPrecompiledPage* getCompiledPage(PDFInteger pageIndex, bool compile);
-
-    /// Performs smart cache clear. Too old pages are removed from the cache,
-    /// but only if these pages are not in active pages. Use this function to
-    /// clear cache to avoid huge memory consumption.
-    /// \param milisecondsLimit Pages with access time above this limit will be erased
+    /// \param priority Priority of the compile task
+    const PDFPrecompiledPage* getCompiledPage(PDFInteger pageIndex, bool compile, Priority priority = Priority::Visible);
+
+    /// Cancels compile tasks of visible and prefetched pages, which are no
+    /// longer needed (for example, pages which left the viewport during fast
+    /// scrolling). Tasks being compiled are interrupted. Thumbnail tasks
+    /// are not cancelled.
+    /// \param activePages Sorted vector of pages, which are still needed
+    void cancelStaleTasks(const std::vector<PDFInteger>& activePages);
+
+    /// Returns shared pointer to the precompiled page from the cache, or nullptr,
+    /// if page is not found. Page is never compiled by this function. Returned
+    /// page stays valid even if it is removed from the cache, so it can be used
+    /// by asynchronous tasks.
+    /// \param pageIndex Index of page
+    std::shared_ptr<const PDFPrecompiledPage> getCompiledPagePointer(PDFInteger pageIndex);
+
+    /// Performs smart cache clear. Too old pages are compacted (compressed),
+    /// so more pages fit into the cache, but only if these pages are not in
+    /// active pages. Compacted pages, which are not used for a long time,
+    /// are removed from the cache. Compacted page is restored, when it is
+    /// accessed again. Use this function to avoid huge memory consumption.
+    /// \param milisecondsLimit Pages with access time above this limit will be compacted
     /// \param activePages Sorted vector of active pages, which should remain in cache
     void smartClearCache(const int milisecondsLimit, const std::vector<PDFInteger>& activePages);
 
     /// Is operation being cancelled?
     virtual bool isOperationCancelled() const override;
 
+protected:
+    virtual void trimMemory() override;
+
 signals:
     void pageImageChanged(bool all, const std::vector<pdf::PDFInteger>& pages);
     void renderingError(pdf::PDFInteger pageIndex, const QList<pdf::PDFRenderError>& errors);
@@ -129,23 +179,64 @@ private:
 
     void onPageCompiled();
 
+    /// Compile task. Pages are first compiled with draft images (JPEG and
+    /// JPEG 2000 images in lower resolution), so they can be displayed quickly.
+    /// If page contains draft images, it is compiled again with full resolution
+    /// images, and draft page is replaced, when compilation is finished.
     struct CompileTask
     {
         CompileTask() = default;
-        CompileTask(PDFInteger pageIndex) : pageIndex(pageIndex) { }
+        CompileTask(PDFInteger pageIndex, bool isDraft, Priority priority) :
+            pageIndex(pageIndex),
+            isDraft(isDraft),
+            priority(priority),
+            cancelled(std::make_shared<std::atomic_bool>(false))
+        {
+
+        }
+
+        bool isCancelled() const { return cancelled && *cancelled; }
 
         PDFInteger pageIndex = 0;
+        bool isDraft = false;
         bool finished = false;
+        Priority priority = Priority::Visible;
+
+        /// Cancel flag, it is shared between copies of the task,
+        /// so task can be cancelled while it is being compiled.
+        std::shared_ptr<std::atomic_bool> cancelled;
+
         PDFPrecompiledPage precompiledPage;
+        PDFPageContentDependencies dependencies;
     };
 
+    struct CachedPage
+    {
+        std::shared_ptr<PDFPrecompiledPage> precompiledPage; ///< Precompiled page (nullptr, if page is compacted)
+        QByteArray compactedPage; ///< Compact data of the page, if page is compacted
+        QElapsedTimer compactionTimer; ///< Time elapsed since page was compacted
+        PDFPageContentDependencies dependencies;
+    };
+
+    /// Compacted pages are removed from the cache, if they are not used
+    /// for the page expiration time multiplied by this factor.
+    static constexpr int COMPACTED_PAGE_EXPIRATION_FACTOR = 10;
+
+    /// Returns cached page, compacted page is restored. If page is not
+    /// found in the cache, or it can't be restored, nullptr is returned.
+    /// \param pageIndex Index of page
+    CachedPage* getCachedPage(PDFInteger pageIndex);
+
     State m_state = State::Inactive;
     QMutex m_mutex;
     QWaitCondition m_waitCondition;
     PDFAsynchronousPageCompilerWorkerThread* m_thread = nullptr;
 
     PDFDrawWidgetProxy* m_proxy;
-    QCache<PDFInteger, PDFPrecompiledPage>* m_cache;
+    QCache<PDFInteger, CachedPage>* m_cache;
+
+    /// Persistent cache of precompiled pages, it is protected by mutex
+    std::shared_ptr<PDFPrecompiledPageCache> m_precompiledPageCache;
 
     /// This task is protected by mutex. Every access to this
     /// variable must be done with locked mutex.
@@ -177,6 +268,11 @@ public:
     /// Resets the engine - calls stop and then calls start.
     void reset();
 
+    /// Invalidates text layouts after page contents were modified. Text layouts
+    /// are created again, when needed, but text layouts of pages, whose content
+    /// was not modified, are reused. Call this function only if engine is stopped.
+    void invalidateTextLayouts();
+
     enum class State
     {
         Inactive,
@@ -200,34 +296,386 @@ public:
     /// \param pageIndex Page index
     PDFTextLayoutGetter getTextLayoutLazy(PDFInteger pageIndex);
 
+    /// Returns true, if given point on the page is pointing to some text block.
+    /// If text layout of the document is ready, flat text layout is used for
+    /// hit testing, so text layout of the page is not decompressed.
+    /// \param pageIndex Page index
+    /// \param point Point on the page
+    bool isHoveringOverTextBlock(PDFInteger pageIndex, const QPointF& point);
+
     /// Select all texts on all pages using \p color color.
     /// \param color Color to be used for text selection
     PDFTextSelection getTextSelectionAll(QColor color) const;
 
     /// Create text layout for the document. Function is asynchronous,
-    /// it returns immediately. After text layout is created, signal
+    /// it returns immediately. Pages visible in the widget are processed first.
+    /// While text layout is being created, signal \p textLayoutPartiallyChanged
+    /// is emitted periodically. After text layout is created, signal
     /// \p textLayoutChanged is emitted.
     void makeTextLayout();
 
     /// Returns true, if text layout is ready
     bool isTextLayoutReady() const { return m_textLayouts.has_value(); }
 
-    /// Returns text layout storage (if it is ready), or nullptr
-    const PDFTextLayoutStorage* getTextLayoutStorage() const { return isTextLayoutReady() ? &m_textLayouts.value() : nullptr; }
+    /// Returns text layout storage. If text layout is not ready, but it is
+    /// being created, then partial text layout storage is returned (text layouts
+    /// of pages, which were not processed yet, are empty). If text layout is not
+    /// being created, then nullptr is returned.
+    const PDFTextLayoutStorage* getTextLayoutStorage() const;
+
+    /// Sets file name, where text layouts and full-text index of the document
+    /// are persisted (typically, file next to the document). If file exists and
+    /// it was created for the same document, text layouts are loaded from it
+    /// instead of being created, otherwise file is written after text layouts
+    /// are created. Empty file name disables the persistence. Only documents
+    /// read from the file (having source data hash) are persisted.
+    /// \param fileName File name
+    void setTextLayoutStorageFileName(QString fileName) { m_textLayoutStorageFileName = std::move(fileName); }
 
 signals:
     void textLayoutChanged();
+    void textLayoutPartiallyChanged();
 
 private:
+    /// Interval of publishing of partial text layouts [ms]
+    static constexpr qint64 PARTIAL_TEXT_LAYOUT_INTERVAL = 500;
+
+    struct TextLayoutResult
+    {
+        quint64 generation = 0;
+        PDFTextLayoutStorage textLayouts;
+        std::vector<PDFPageContentDependencies> dependencies;
+    };
+
     void onTextLayoutCreated();
+    void onTextLayoutPartiallyCreated(quint64 generation, PDFTextLayoutStorage textLayouts);
 
     PDFDrawWidgetProxy* m_proxy;
     State m_state = State::Inactive;
     bool m_isRunning;
     std::optional<PDFTextLayoutStorage> m_textLayouts;
-    QFuture<PDFTextLayoutStorage> m_textLayoutCompileFuture;
-    QFutureWatcher<PDFTextLayoutStorage> m_textLayoutCompileFutureWatcher;
+    std::optional<PDFTextLayoutStorage> m_partialTextLayouts;
+    std::vector<PDFPageContentDependencies> m_textLayoutDependencies;
+
+    /// Text layouts before page contents were modified, text layouts
+    /// of unmodified pages are reused, when text layout is created again.
+    std::shared_ptr<const TextLayoutResult> m_previousTextLayouts;
+
+    /// Generation of text layouts, it is incremented whenever engine is stopped,
+    /// so results of asynchronous tasks for the old document are discarded.
+    quint64 m_generation = 0;
+
+    QFuture<TextLayoutResult> m_textLayoutCompileFuture;
+    QFutureWatcher<TextLayoutResult> m_textLayoutCompileFutureWatcher;
     PDFTextLayoutCache m_cache;
+    QString m_textLayoutStorageFileName;
+};
+
+/// Asynchronous renderer of page raster tiles. Pages are divided into square
+/// tiles of fixed pixel size, which are rendered in the background from precompiled
+/// pages, and stored in the cache. When page is painted, cached tiles are just
+/// blitted. Tiles are identified by page, page size in pixels (which is given
+/// by the zoom level), tile coordinates and renderer features. While sharp tiles
+/// are being rendered, low resolution preview of the page is displayed instead.
+class PDFAsynchronousTileRenderer : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    explicit PDFAsynchronousTileRenderer(PDFDrawWidgetProxy* proxy);
+    virtual ~PDFAsynchronousTileRenderer() override;
+
+    /// Size of the tile in device pixels
+    static constexpr int TILE_SIZE = 256;
+
+    /// Size of the larger side of the low resolution page preview in device pixels
+    static constexpr int PREVIEW_SIZE = 384;
+
+    /// Starts the engine. Call this function only if the engine
+    /// is stopped.
+    void start();
+
+    /// Stops the engine and waits for running tasks. Cache is cleared
+    /// only, if \p clearCache parameter is being set to true.
+    /// \param clearCache Clear cache
+    void stop(bool clearCache);
+
+    /// Resets the engine - calls stop and then calls start.
+    void reset();
+
+    /// Sets cache limit in bytes
+    /// \param limit Cache limit [bytes]
+    void setCacheLimit(qint64 limit);
+
+    enum class State
+    {
+        Inactive,
+        Active,
+        Stopping
+    };
+
+    /// Returns current state of tile renderer
+    State getState() const { return m_state; }
+
+    /// Starts drawing of new frame. Tiles requested in previous frames,
+    /// which rendering hasn't started yet, are discarded (they may not be
+    /// visible anymore).
+    void beginDraw();
+
+    /// Finishes drawing of the frame and starts rendering of requested tiles
+    void finishDraw();
+
+    /// Draws page using cached tiles. Tiles, which are not in the cache, are
+    /// requested for rendering, and low resolution preview of the page is drawn
+    /// instead of them. Returns false, if page can't be drawn using tiles (for
+    /// example, painter transformation is not a simple translation, or page
+    /// preview is not rendered yet). In that case, nothing is drawn and page
+    /// should be drawn directly.
+    /// \param painter Painter
+    /// \param pageIndex Page index
+    /// \param page Page
+    /// \param placedRect Page rectangle in the widget
+    /// \param clipRect Painted rectangle
+    /// \param features Renderer features
+    /// \param opacity Opacity of page graphics
+    bool drawPage(QPainter* painter,
+                  PDFInteger pageIndex,
+                  const PDFPage* page,
+                  const QRect& placedRect,
+                  const QRect& clipRect,
+                  PDFRenderer::Features features,
+                  PDFReal opacity);
+
+    /// Invalidates tiles of pages, which image has been changed
+    /// \param all All pages are invalidated
+    /// \param pages Sorted list of invalidated pages
+    void onPageImageChanged(bool all, const std::vector<PDFInteger>& pages);
+
+signals:
+    void tilesRendered();
+
+private:
+    struct TileKey
+    {
+        auto operator<=>(const TileKey&) const = default;
+
+        /// Is this a low resolution preview of the whole page?
+        bool isPreview() const { return tileX < 0; }
+
+        PDFInteger pageIndex = -1;
+        int pageWidth = 0;
+        int pageHeight = 0;
+        int tileX = -1;
+        int tileY = -1;
+        int pageRotation = 0;
+        PDFRenderer::Features::Int features = 0;
+
+        friend size_t qHash(const TileKey& key, size_t seed) { return qHashMulti(seed, key.pageIndex, key.pageWidth, key.pageHeight, key.tileX, key.tileY, key.pageRotation, key.features); }
+    };
+
+    struct RenderTask
+    {
+        TileKey key;
+        quint64 generation = 0;
+        std::shared_ptr<const PDFPrecompiledPage> compiledPage;
+        QRectF cropBox;
+        QTransform pagePointToDevicePointMatrix;
+        QSize size;
+        RendererEngine rendererEngine = RendererEngine::QPainter;
+        const PDFOptionalContentActivity* optionalContentActivity = nullptr;
+        QImage image;
+    };
+
+    /// Returns current generation of the page. Generation is changed,
+    /// when the page is invalidated, so tiles rendered from previous
+    /// generation can be discarded.
+    quint64 getGeneration(PDFInteger pageIndex) const;
+
+    /// Requests tile rendering, if it is not already requested or being rendered
+    void requestTile(const TileKey& key, const std::shared_ptr<const PDFPrecompiledPage>& compiledPage, const PDFPage* page);
+
+    /// Starts rendering of requested tiles, if no rendering is running.
+    /// Page previews are rendered before sharp tiles.
+    void startRendering();
+
+    void onTilesRendered();
+
+    PDFDrawWidgetProxy* m_proxy;
+    std::atomic<State> m_state = State::Inactive; ///< Read by rendering threads to cancel the rendering
+    QCache<TileKey, QImage>* m_cache;
+    std::map<TileKey, RenderTask> m_requestedTasks;
+    std::set<TileKey> m_renderedTiles;
+    quint64 m_generation = 0;
+    std::map<PDFInteger, quint64> m_pageGenerations;
+    bool m_isRendering = false;
+    QFuture<std::vector<RenderTask>> m_renderFuture;
+    QFutureWatcher<std::vector<RenderTask>> m_renderFutureWatcher;
+};
+
+/// Asynchronous thumbnail renderer. Renders page thumbnails in the background
+/// thread with low priority, and notifies about rendered thumbnails, so thumbnail
+/// view can be updated progressively. Until thumbnail is rendered, embedded page
+/// thumbnail (/Thumb entry of the page) or previous (stale) thumbnail is provided
+/// instead. Rendered thumbnails of unmodified documents are stored in the thumbnail
+/// atlas on the disk (one file per document, renderer settings and thumbnail size),
+/// so they are available immediately, when document is opened again.
+class PDFAsynchronousThumbnailRenderer : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    explicit PDFAsynchronousThumbnailRenderer(PDFDrawWidgetProxy* proxy);
+    virtual ~PDFAsynchronousThumbnailRenderer() override;
+
+    /// Version of the thumbnail atlas file format
+    static constexpr const qint32 ATLAS_VERSION = 1;
+
+    /// Default size limit of the thumbnail atlas directory (in bytes)
+    static constexpr const qint64 DEFAULT_ATLAS_SIZE_LIMIT = 64 * 1024 * 1024;
+
+    /// Maximal number of thumbnails rendered in one batch. Rendered
+    /// thumbnails are provided after each batch is finished.
+    static constexpr const size_t BATCH_SIZE = 8;
+
+    /// Starts the engine. Call this function only if the engine
+    /// is stopped.
+    void start();
+
+    /// Stops the engine and waits for running tasks. Thumbnails
+    /// are cleared only, if \p clearCache parameter is being set
+    /// to true. Modified thumbnail atlas is stored to the disk.
+    /// \param clearCache Clear cache
+    void stop(bool clearCache);
+
+    /// Resets the engine - calls stop and then calls start.
+    void reset();
+
+    enum class State
+    {
+        Inactive,
+        Active,
+        Stopping
+    };
+
+    /// Returns current state of thumbnail renderer
+    State getState() const { return m_state; }
+
+    /// Marks all thumbnails as stale (they are rendered again, when requested,
+    /// but they are provided until then). Thumbnail atlas is no longer used for
+    /// current document, because the document differs from its source data.
+    /// Call this function only if the engine is stopped.
+    void invalidateThumbnails();
+
+    /// Sets thumbnail atlas directory. If directory is empty, then
+    /// thumbnails are not stored on the disk.
+    /// \param directory Atlas directory
+    /// \param sizeLimit Size limit of the atlas directory [bytes]
+    void setAtlasDirectory(QString directory, qint64 sizeLimit = DEFAULT_ATLAS_SIZE_LIMIT);
+
+    /// Returns default thumbnail atlas directory (in the user's cache location)
+    static QString getDefaultAtlasDirectory();
+
+    /// Returns thumbnail of the page. If thumbnail of given size isn't rendered yet,
+    /// then it is requested for rendering, and substitute image is returned instead
+    /// (embedded thumbnail, stale thumbnail, or blank page). Null image is returned
+    /// only, if page doesn't exist.
+    /// \param pageIndex Page index
+    /// \param pixelSize Size of the larger side of the thumbnail in device pixels
+    QImage getThumbnail(PDFInteger pageIndex, int pixelSize);
+
+    /// Handles change of the page images. If all pages are changed (renderer
+    /// settings has been changed), then all thumbnails are marked as stale.
+    /// Changes of individual pages (pages have been compiled) are ignored,
+    /// document modifications are handled when document is set.
+    /// \param all All pages are invalidated
+    /// \param pages Sorted list of invalidated pages
+    void onPageImageChanged(bool all, const std::vector<PDFInteger>& pages);
+
+signals:
+    /// Thumbnails of given pages have been changed
+    /// \param all All thumbnails have been changed
+    /// \param pages Sorted list of pages
+    void thumbnailsChanged(bool all, const std::vector<pdf::PDFInteger>& pages);
+
+private:
+    struct Thumbnail
+    {
+        QImage image;
+        quint64 generation = 0;
+    };
+
+    struct RenderTask
+    {
+        PDFInteger pageIndex = -1;
+        quint64 generation = 0;
+        quint64 order = 0;
+        QSize size;
+        std::shared_ptr<const PDFPrecompiledPage> compiledPage;
+        QImage image;
+    };
+
+    /// Returns size of the thumbnail of the page (or invalid size, if page doesn't exist)
+    QSize getThumbnailSize(PDFInteger pageIndex) const;
+
+    /// Decodes embedded thumbnail of the page, returns null image,
+    /// if page doesn't have embedded thumbnail, or it can't be decoded.
+    QImage getEmbeddedThumbnail(PDFInteger pageIndex) const;
+
+    /// Requests thumbnail rendering, if it is not already requested or being rendered
+    void requestThumbnail(PDFInteger pageIndex, QSize size);
+
+    /// Starts rendering of requested thumbnails, if no rendering is running.
+    /// Most recently requested thumbnails are rendered first.
+    void startRendering();
+
+    void onThumbnailsRendered();
+
+    /// Returns key of the thumbnail atlas of the current document (it identifies
+    /// the document, renderer settings and thumbnail size). If atlas can't be used,
+    /// then empty key is returned.
+    QByteArray createAtlasKey() const;
+
+    /// Returns file name of the thumbnail atlas with given key
+    QString getAtlasFileName(const QByteArray& atlasKey) const;
+
+    /// Loads thumbnail atlas of the current document, if it is not loaded yet
+    void loadAtlas();
+
+    /// Stores thumbnail atlas of the current document, if it has been modified
+    void storeAtlas();
+
+    /// Removes least recently used atlases, until size of the
+    /// atlas directory is below the limit.
+    void pruneAtlasDirectory();
+
+    PDFDrawWidgetProxy* m_proxy;
+    std::atomic<State> m_state = State::Inactive; ///< Read by rendering thread to cancel the rendering
+    int m_pixelSize = 0;
+    quint64 m_generation = 0;
+    quint64 m_requestCounter = 0;
+    std::map<PDFInteger, Thumbnail> m_thumbnails;
+    std::map<PDFInteger, RenderTask> m_requestedTasks;
+    std::set<PDFInteger> m_renderedPages;
+    bool m_isRendering = false;
+    bool m_isRenderingScheduled = false;
+    QThreadPool m_threadPool;
+    QFuture<std::vector<RenderTask>> m_renderFuture;
+    QFutureWatcher<std::vector<RenderTask>> m_renderFutureWatcher;
+
+    QString m_atlasDirectory;
+    qint64 m_atlasSizeLimit = DEFAULT_ATLAS_SIZE_LIMIT;
+    bool m_isAtlasInvalidated = false;
+    bool m_isAtlasLoaded = false;
+    bool m_isAtlasModified = false;
+    QByteArray m_atlasKey;
+    std::map<PDFInteger, QByteArray> m_atlas;
+    mutable std::map<PDFInteger, QImage> m_embeddedThumbnails;
 };
 
 }   // namespace pdf
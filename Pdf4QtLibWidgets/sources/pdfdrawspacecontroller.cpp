@@ -25,6 +25,9 @@
 #include "pdfdrawwidget.h"
 #include "pdfwidgetannotation.h"
 #include "pdfpainterutils.h"
+#include "pdfdecodedstreamcache.h"
+#include "pdfmemorybudget.h"
+#include "pdfgpugeometry.h"
 
 #include <QTimer>
 #include <QPainter>
@@ -32,6 +35,8 @@
 #include <QScreen>
 #include <QGuiApplication>
 
+#include <numeric>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -91,10 +96,8 @@ QRectF PDFDrawSpaceController::getBlockBoundingRectangle(size_t blockIndex) cons
     return QRectF();
 }
 
-PDFDrawSpaceController::LayoutItems PDFDrawSpaceController::getLayoutItems(size_t blockIndex) const
+PDFDrawSpaceController::LayoutItemsView PDFDrawSpaceController::getLayoutItems(size_t blockIndex) const
 {
-    LayoutItems result;
-
     auto comparator = [](const LayoutItem& l, const LayoutItem& r)
     {
         return l.blockIndex < r.blockIndex;
@@ -104,28 +107,21 @@ PDFDrawSpaceController::LayoutItems PDFDrawSpaceController::getLayoutItems(size_
     LayoutItem templateItem;
     templateItem.blockIndex = blockIndex;
 
+    // Items are sorted by the block index, so items of the block are contiguous
     auto range = std::equal_range(m_layoutItems.cbegin(), m_layoutItems.cend(), templateItem, comparator);
-    result.reserve(std::distance(range.first, range.second));
-    std::copy(range.first, range.second, std::back_inserter(result));
-
-    return result;
+    return LayoutItemsView(range.first, range.second);
 }
 
 PDFDrawSpaceController::LayoutItem PDFDrawSpaceController::getLayoutItemForPage(PDFInteger pageIndex) const
 {
     LayoutItem result;
 
-    if (pageIndex >= 0 && pageIndex < static_cast<PDFInteger>(m_layoutItems.size()) && m_layoutItems[pageIndex].pageIndex == pageIndex)
-    {
-        result = m_layoutItems[pageIndex];
-    }
-
-    if (!result.isValid())
+    if (pageIndex >= 0 && pageIndex < static_cast<PDFInteger>(m_pageLayoutItemIndices.size()))
     {
-        auto it = std::find_if(m_layoutItems.cbegin(), m_layoutItems.cend(), [pageIndex](const LayoutItem& item) { return item.pageIndex == pageIndex; });
-        if (it != m_layoutItems.cend())
+        const PDFInteger layoutItemIndex = m_pageLayoutItemIndices[pageIndex];
+        if (layoutItemIndex != -1)
         {
-            result = *it;
+            result = m_layoutItems[layoutItemIndex];
         }
     }
 
@@ -134,21 +130,7 @@ PDFDrawSpaceController::LayoutItem PDFDrawSpaceController::getLayoutItemForPage(
 
 QSizeF PDFDrawSpaceController::getReferenceBoundingBox() const
 {
-    QRectF rect;
-
-    for (const LayoutItem& item : m_layoutItems)
-    {
-        QRectF pageRect = item.pageRectMM;
-        pageRect.translate(0, -pageRect.top());
-        rect = rect.united(pageRect);
-    }
-
-    if (rect.isValid())
-    {
-        rect.adjust(0, 0, m_horizontalSpacingMM, m_verticalSpacingMM);
-    }
-
-    return rect.size();
+    return m_referenceBoundingBox.size();
 }
 
 void PDFDrawSpaceController::setPageRotation(PageRotation pageRotation)
@@ -436,6 +418,28 @@ void PDFDrawSpaceController::recalculate()
         }
     }
 
+    // Build page index and reference bounding box, so they are not
+    // computed again from all layout items, when they are requested.
+    m_pageLayoutItemIndices.assign(pageCount, -1);
+    for (size_t i = 0; i < m_layoutItems.size(); ++i)
+    {
+        const LayoutItem& item = m_layoutItems[i];
+
+        if (item.pageIndex >= 0 && item.pageIndex < static_cast<PDFInteger>(pageCount) && m_pageLayoutItemIndices[item.pageIndex] == -1)
+        {
+            m_pageLayoutItemIndices[item.pageIndex] = static_cast<PDFInteger>(i);
+        }
+
+        QRectF pageRect = item.pageRectMM;
+        pageRect.translate(0, -pageRect.top());
+        m_referenceBoundingBox = m_referenceBoundingBox.united(pageRect);
+    }
+
+    if (m_referenceBoundingBox.isValid())
+    {
+        m_referenceBoundingBox.adjust(0, 0, m_horizontalSpacingMM, m_verticalSpacingMM);
+    }
+
     Q_EMIT drawSpaceChanged();
 }
 
@@ -443,6 +447,8 @@ void PDFDrawSpaceController::clear(bool emitSignal)
 {
     m_layoutItems.clear();
     m_blockItems.clear();
+    m_pageLayoutItemIndices.clear();
+    m_referenceBoundingBox = QRectF();
 
     if (emitSignal)
     {
@@ -467,6 +473,8 @@ PDFDrawWidgetProxy::PDFDrawWidgetProxy(QObject* parent) :
     m_features(PDFRenderer::getDefaultFeatures()),
     m_compiler(new PDFAsynchronousPageCompiler(this)),
     m_textLayoutCompiler(new PDFAsynchronousTextLayoutCompiler(this)),
+    m_tileRenderer(new PDFAsynchronousTileRenderer(this)),
+    m_thumbnailRenderer(new PDFAsynchronousThumbnailRenderer(this)),
     m_rasterizer(new PDFRasterizer(this)),
     m_progress(nullptr),
     m_cacheClearTimer(new QTimer(this)),
@@ -480,6 +488,9 @@ PDFDrawWidgetProxy::PDFDrawWidgetProxy(QObject* parent) :
     connect(m_compiler, &PDFAsynchronousPageCompiler::pageImageChanged, this, &PDFDrawWidgetProxy::pageImageChanged);
     connect(m_textLayoutCompiler, &PDFAsynchronousTextLayoutCompiler::textLayoutChanged, this, &PDFDrawWidgetProxy::onTextLayoutChanged);
     connect(m_cacheClearTimer, &QTimer::timeout, this, &PDFDrawWidgetProxy::performPageCacheClear);
+    connect(this, &PDFDrawWidgetProxy::pageImageChanged, m_tileRenderer, &PDFAsynchronousTileRenderer::onPageImageChanged);
+    connect(m_tileRenderer, &PDFAsynchronousTileRenderer::tilesRendered, this, &PDFDrawWidgetProxy::repaintNeeded);
+    connect(this, &PDFDrawWidgetProxy::pageImageChanged, m_thumbnailRenderer, &PDFAsynchronousThumbnailRenderer::onPageImageChanged);
 }
 
 PDFDrawWidgetProxy::~PDFDrawWidgetProxy()
@@ -491,9 +502,30 @@ void PDFDrawWidgetProxy::setDocument(const PDFModifiedDocument& document)
 {
     if (getDocument() != document)
     {
+        setHibernated(false);
+
         m_cacheClearTimer->stop();
-        m_compiler->stop(document.hasReset() || document.hasPageContentsChanged());
-        m_textLayoutCompiler->stop(document.hasReset() || document.hasPageContentsChanged());
+        m_tileRenderer->stop(true);
+        m_thumbnailRenderer->stop(document.hasReset());
+        if (!document.hasReset() && (document.hasPageContentsChanged() ||
+                                     document.hasFlag(PDFModifiedDocument::Annotation) ||
+                                     document.hasFlag(PDFModifiedDocument::FormField)))
+        {
+            // Stale thumbnails are displayed, until they are rendered again
+            m_thumbnailRenderer->invalidateThumbnails();
+        }
+        m_compiler->stop(document.hasReset());
+        if (!document.hasReset() && document.hasPageContentsChanged())
+        {
+            // Only pages, whose content was modified, are compiled again
+            m_compiler->removeModifiedPages(document);
+        }
+        m_textLayoutCompiler->stop(document.hasReset());
+        if (!document.hasReset() && document.hasPageContentsChanged())
+        {
+            // Text layouts of unmodified pages are reused
+            m_textLayoutCompiler->invalidateTextLayouts();
+        }
         m_controller->setDocument(document);
 
         if (PDFOptionalContentActivity* optionalContentActivity = document.getOptionalContentActivity())
@@ -503,6 +535,8 @@ void PDFDrawWidgetProxy::setDocument(const PDFModifiedDocument& document)
 
         m_compiler->start();
         m_textLayoutCompiler->start();
+        m_tileRenderer->start();
+        m_thumbnailRenderer->start();
 
         if (document)
         {
@@ -511,6 +545,53 @@ void PDFDrawWidgetProxy::setDocument(const PDFModifiedDocument& document)
     }
 }
 
+void PDFDrawWidgetProxy::setHibernated(bool hibernated)
+{
+    if (m_isHibernated == hibernated)
+    {
+        return;
+    }
+
+    m_isHibernated = hibernated;
+
+    if (hibernated)
+    {
+        // Engines are stopped, so they don't use fonts and other cached
+        // data, when caches are released.
+        m_cacheClearTimer->stop();
+        m_tileRenderer->stop(true);
+        m_thumbnailRenderer->stop(true);
+        m_compiler->stop(true);
+        m_textLayoutCompiler->stop(true);
+
+        const PDFDocument* document = getDocument();
+        if (PDFDecodedStreamCache* decodedStreamCache = document ? document->getStorage().getDecodedStreamCache() : nullptr)
+        {
+            decodedStreamCache->clear();
+        }
+    }
+
+    getFontCache()->setHibernated(hibernated);
+    PDFMemoryBudget::getInstance()->setHibernated({ m_compiler }, hibernated);
+
+    if (!hibernated)
+    {
+        m_compiler->start();
+        m_textLayoutCompiler->start();
+        m_tileRenderer->start();
+        m_thumbnailRenderer->start();
+
+        if (getDocument())
+        {
+            m_cacheClearTimer->start(CACHE_CLEAR_TIMEOUT);
+        }
+
+        // Visible pages are compiled, when they are drawn, then
+        // neighbouring pages are prefetched.
+        Q_EMIT repaintNeeded();
+    }
+}
+
 void PDFDrawWidgetProxy::init(PDFWidget* widget)
 {
     m_widget = widget;
@@ -588,7 +669,7 @@ void PDFDrawWidgetProxy::update()
     if (rectangle.isValid())
     {
         // We must have a valid block
-        PDFDrawSpaceController::LayoutItems items = m_controller->getLayoutItems(m_currentBlock);
+        PDFDrawSpaceController::LayoutItemsView items = m_controller->getLayoutItems(m_currentBlock);
 
         m_layout.items.reserve(items.size());
         for (const PDFDrawSpaceController::LayoutItem& item : items)
@@ -597,6 +678,7 @@ void PDFDrawWidgetProxy::update()
         }
 
         m_layout.blockRect = fromDeviceSpace(rectangle).toRect();
+        m_layout.buildIndex();
     }
 
     QSize blockSize = m_layout.blockRect.size();
@@ -756,7 +838,114 @@ QTransform PDFDrawWidgetProxy::createPagePointToDevicePointMatrix(const PDFPage*
 
 void PDFDrawWidgetProxy::draw(QPainter* painter, QRect rect)
 {
-    drawPages(painter, rect, m_features);
+    draw(painter, rect, rect);
+}
+
+void PDFDrawWidgetProxy::draw(QPainter* painter, QRect rect, QRect dirtyRect)
+{
+    setHibernated(false);
+
+    m_tileRenderer->beginDraw();
+    drawPagesImpl(painter, dirtyRect, m_features, true, true);
+    m_tileRenderer->finishDraw();
+    updateCompileTasks(rect);
+
+    for (IDocumentDrawInterface* drawInterface : m_drawInterfaces)
+    {
+        painter->save();
+        drawInterface->drawPostRendering(painter, rect);
+        painter->restore();
+    }
+}
+
+void PDFDrawWidgetProxy::repaintRect(const QRectF& rect)
+{
+    const QRect widgetRect = m_widget->rect();
+    const QRect repaintedRect = rect.toAlignedRect().adjusted(-REPAINT_RECT_MARGIN, -REPAINT_RECT_MARGIN, REPAINT_RECT_MARGIN, REPAINT_RECT_MARGIN).intersected(widgetRect);
+
+    if (!repaintedRect.isEmpty())
+    {
+        Q_EMIT repaintRectNeeded(repaintedRect);
+    }
+}
+
+void PDFDrawWidgetProxy::repaintPageRect(PDFInteger pageIndex, const QRectF& pageRect)
+{
+    const PDFDocument* document = getDocument();
+    const PDFPage* page = document ? document->getCatalog()->getPage(pageIndex) : nullptr;
+    if (!page)
+    {
+        Q_EMIT repaintNeeded();
+        return;
+    }
+
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(m_widget->rect()))
+    {
+        const LayoutItem& item = m_layout.items[layoutItemIndex];
+        if (item.pageIndex == pageIndex)
+        {
+            QRect placedRect = item.pageRect.translated(m_horizontalOffset - m_layout.blockRect.left(), m_verticalOffset - m_layout.blockRect.top());
+            repaintRect(createPagePointToDevicePointMatrix(page, placedRect).mapRect(pageRect));
+        }
+    }
+}
+
+std::vector<PDFDrawWidgetProxy::PageContentItem> PDFDrawWidgetProxy::getPageContentItems(QRect rect)
+{
+    setHibernated(false);
+
+    std::vector<PageContentItem> items;
+
+    if (!m_controller->getDocument())
+    {
+        return items;
+    }
+
+    const QColor paperColor = getPaperColor();
+
+    bool isPageContentDrawSuppressed = false;
+    for (IDocumentDrawInterface* drawInterface : m_drawInterfaces)
+    {
+        isPageContentDrawSuppressed = isPageContentDrawSuppressed || drawInterface->isPageContentDrawSuppressed();
+    }
+
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(rect))
+    {
+        const LayoutItem& layoutItem = m_layout.items[layoutItemIndex];
+        QRect placedRect = layoutItem.pageRect.translated(m_horizontalOffset - m_layout.blockRect.left(), m_verticalOffset - m_layout.blockRect.top());
+
+        GroupInfo groupInfo = getGroupInfo(layoutItem.groupIndex);
+        const PDFPage* page = m_controller->getDocument()->getCatalog()->getPage(layoutItem.pageIndex);
+
+        PageContentItem item;
+        item.pageIndex = layoutItem.pageIndex;
+        item.placedRect = placedRect;
+        item.pagePointToDevicePointMatrix = createPagePointToDevicePointMatrix(page, placedRect);
+        item.paperColor = groupInfo.drawPaper ? paperColor : QColor();
+        item.opacity = groupInfo.transparency;
+        item.isContentDrawSuppressed = isPageContentDrawSuppressed;
+
+        // Request compilation, if page is not compiled yet
+        const PDFPrecompiledPage* compiledPage = m_compiler->getCompiledPage(layoutItem.pageIndex, true);
+        if (compiledPage && compiledPage->isValid())
+        {
+            item.compiledPage = m_compiler->getCompiledPagePointer(layoutItem.pageIndex);
+            item.optionalContentVisibility = compiledPage->getOptionalContentVisibility(m_features, getOptionalContentActivity());
+
+            // Contents of unsupported pages are drawn in the overlay, see drawOverlay
+            item.isContentDrawSuppressed = item.isContentDrawSuppressed || !PDFGpuPageGeometry::isPageSupported(*compiledPage);
+        }
+
+        items.push_back(qMove(item));
+    }
+
+    updateCompileTasks(rect);
+    return items;
+}
+
+void PDFDrawWidgetProxy::drawOverlay(QPainter* painter, QRect rect)
+{
+    drawPagesImpl(painter, rect, m_features, false, false);
 
     for (IDocumentDrawInterface* drawInterface : m_drawInterfaces)
     {
@@ -778,7 +967,17 @@ QColor PDFDrawWidgetProxy::getPaperColor()
 
 void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::Features features)
 {
-    painter->fillRect(rect, Qt::lightGray);
+    setHibernated(false);
+    drawPagesImpl(painter, rect, features, false, true);
+}
+
+void PDFDrawWidgetProxy::drawPagesImpl(QPainter* painter, QRect rect, PDFRenderer::Features features, bool useTiles, bool drawContent)
+{
+    if (drawContent)
+    {
+        painter->fillRect(rect, Qt::lightGray);
+    }
+
     QTransform baseMatrix = painter->worldTransform();
 
     // Use current paper color (it can be a bit different from white)
@@ -790,8 +989,10 @@ void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::F
     PDFRenderer::applyFeaturesToColorConvertor(features, convertor);
 
     // Iterate trough pages and display them on the painter device
-    for (const LayoutItem& item : m_layout.items)
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(rect))
     {
+        const LayoutItem& item = m_layout.items[layoutItemIndex];
+
         // The offsets m_horizontalOffset and m_verticalOffset are offsets to the
         // topleft point of the block. But block maybe doesn't start at (0, 0),
         // so we must also use translation from the block beginning.
@@ -799,15 +1000,20 @@ void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::F
         if (placedRect.intersects(rect))
         {
             GroupInfo groupInfo = getGroupInfo(item.groupIndex);
+            const PDFPrecompiledPage* compiledPage = m_compiler->getCompiledPage(item.pageIndex, true);
+            const bool isCompiled = compiledPage && compiledPage->isValid();
+
+            // Page contents, which can't be drawn on the GPU, are drawn
+            // together with the overlay (including the paper).
+            const bool drawPageContent = drawContent || (isCompiled && !PDFGpuPageGeometry::isPageSupported(*compiledPage));
 
             // Clear the page space by paper color
-            if (groupInfo.drawPaper)
+            if (drawPageContent && groupInfo.drawPaper)
             {
                 painter->fillRect(placedRect, paperColor);
             }
 
-            const PDFPrecompiledPage* compiledPage = m_compiler->getCompiledPage(item.pageIndex, true);
-            if (compiledPage && compiledPage->isValid())
+            if (isCompiled)
             {
                 QElapsedTimer timer;
                 timer.start();
@@ -822,9 +1028,14 @@ void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::F
                     isPageContentDrawSuppressed = isPageContentDrawSuppressed || drawInterface->isPageContentDrawSuppressed();
                 }
 
-                if (!isPageContentDrawSuppressed)
+                if (drawPageContent && !isPageContentDrawSuppressed)
                 {
-                    compiledPage->draw(painter, page->getCropBox(), matrix, features, groupInfo.transparency);
+                    // Use cached raster tiles, if possible, so heavy pages are not
+                    // rasterized again on every repaint.
+                    if (!useTiles || !m_tileRenderer->drawPage(painter, item.pageIndex, page, placedRect, rect, features, groupInfo.transparency))
+                    {
+                        compiledPage->draw(painter, page->getCropBox(), matrix, features, groupInfo.transparency, getOptionalContentActivity());
+                    }
                 }
 
                 // Draw text blocks/text lines, if it is enabled
@@ -954,12 +1165,12 @@ QImage PDFDrawWidgetProxy::drawThumbnailImage(PDFInteger pageIndex, int pixelSiz
 
         if (imageSize.isValid())
         {
-            const PDFPrecompiledPage* compiledPage = m_compiler->getCompiledPage(pageIndex, true);
+            const PDFPrecompiledPage* compiledPage = m_compiler->getCompiledPage(pageIndex, true, PDFAsynchronousPageCompiler::Priority::Thumbnail);
             if (compiledPage && compiledPage->isValid())
             {
                 // Rasterize the image.
                 PDFCMSPointer cms = getCMSManager()->getCurrentCMS();
-                image = m_rasterizer->render(pageIndex, page, compiledPage, imageSize, m_features, m_widget->getAnnotationManager(), cms.data(), PageRotation::None);
+                image = m_rasterizer->render(pageIndex, page, compiledPage, imageSize, m_features, m_widget->getAnnotationManager(), cms.data(), PageRotation::None, getOptionalContentActivity());
             }
 
             if (image.isNull())
@@ -973,6 +1184,55 @@ QImage PDFDrawWidgetProxy::drawThumbnailImage(PDFInteger pageIndex, int pixelSiz
     return image;
 }
 
+void PDFDrawWidgetProxy::Layout::buildIndex()
+{
+    itemsByTop.resize(items.size());
+    std::iota(itemsByTop.begin(), itemsByTop.end(), 0);
+
+    // Pages of the standard layouts are already sorted from top to bottom
+    auto comparator = [this](size_t l, size_t r) { return items[l].pageRect.top() < items[r].pageRect.top(); };
+    if (!std::is_sorted(itemsByTop.cbegin(), itemsByTop.cend(), comparator))
+    {
+        std::stable_sort(itemsByTop.begin(), itemsByTop.end(), comparator);
+    }
+
+    maxBottoms.resize(items.size());
+    int maxBottom = std::numeric_limits<int>::min();
+    for (size_t i = 0; i < itemsByTop.size(); ++i)
+    {
+        maxBottom = qMax(maxBottom, items[itemsByTop[i]].pageRect.bottom());
+        maxBottoms[i] = maxBottom;
+    }
+}
+
+std::vector<size_t> PDFDrawWidgetProxy::getLayoutItemsIntersectingRect(QRect rect) const
+{
+    std::vector<size_t> result;
+
+    // Transform the rectangle to the block coordinates, so we can
+    // compare it with page rectangles in the layout directly.
+    const QRect blockRect = rect.translated(m_layout.blockRect.left() - m_horizontalOffset, m_layout.blockRect.top() - m_verticalOffset);
+
+    // Pages, whose top edge is below the rectangle, can't intersect it.
+    // Pages before the first page, whose maximal bottom edge is under
+    // the top of the rectangle, also can't intersect it.
+    auto itEnd = std::upper_bound(m_layout.itemsByTop.cbegin(), m_layout.itemsByTop.cend(), blockRect.bottom(), [this](int value, size_t index) { return value < m_layout.items[index].pageRect.top(); });
+    auto itMaxBottomEnd = std::next(m_layout.maxBottoms.cbegin(), std::distance(m_layout.itemsByTop.cbegin(), itEnd));
+    auto itMaxBottom = std::lower_bound(m_layout.maxBottoms.cbegin(), itMaxBottomEnd, blockRect.top());
+    auto itBegin = std::next(m_layout.itemsByTop.cbegin(), std::distance(m_layout.maxBottoms.cbegin(), itMaxBottom));
+
+    for (auto it = itBegin; it != itEnd; ++it)
+    {
+        if (m_layout.items[*it].pageRect.intersects(blockRect))
+        {
+            result.push_back(*it);
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
 std::vector<PDFInteger> PDFDrawWidgetProxy::getPagesIntersectingRect(QRect rect) const
 {
     std::vector<PDFInteger> pages;
@@ -980,17 +1240,9 @@ std::vector<PDFInteger> PDFDrawWidgetProxy::getPagesIntersectingRect(QRect rect)
     // We assume, that no more, than 32 pages will be displayed in the rectangle
     pages.reserve(32);
 
-    // Iterate trough pages, place them and test, if they intersects with rectangle
-    for (const LayoutItem& item : m_layout.items)
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(rect))
     {
-        // The offsets m_horizontalOffset and m_verticalOffset are offsets to the
-        // topleft point of the block. But block maybe doesn't start at (0, 0),
-        // so we must also use translation from the block beginning.
-        QRect placedRect = item.pageRect.translated(m_horizontalOffset - m_layout.blockRect.left(), m_verticalOffset - m_layout.blockRect.top());
-        if (placedRect.intersects(rect))
-        {
-            pages.push_back(item.pageIndex);
-        }
+        pages.push_back(m_layout.items[layoutItemIndex].pageIndex);
     }
     std::sort(pages.begin(), pages.end());
 
@@ -1022,9 +1274,11 @@ std::vector<PDFInteger> PDFDrawWidgetProxy::getActivePages() const
 
 PDFInteger PDFDrawWidgetProxy::getPageUnderPoint(QPoint point, QPointF* pagePoint) const
 {
-    // Iterate trough pages, place them and test, if they intersects with rectangle
-    for (const LayoutItem& item : m_layout.items)
+    // Iterate trough pages near the point, place them and test, if they contain the point
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(QRect(point - QPoint(1, 1), QSize(2, 2))))
     {
+        const LayoutItem& item = m_layout.items[layoutItemIndex];
+
         // The offsets m_horizontalOffset and m_verticalOffset are offsets to the
         // topleft point of the block. But block maybe doesn't start at (0, 0),
         // so we must also use translation from the block beginning.
@@ -1054,23 +1308,22 @@ PDFWidgetSnapshot PDFDrawWidgetProxy::getSnapshot() const
     QRect viewport = getWidget()->rect();
 
     // Iterate trough pages, place them and test, if they intersects with rectangle
-    for (const LayoutItem& item : m_layout.items)
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(viewport))
     {
+        const LayoutItem& item = m_layout.items[layoutItemIndex];
+
         // The offsets m_horizontalOffset and m_verticalOffset are offsets to the
         // topleft point of the block. But block maybe doesn't start at (0, 0),
         // so we must also use translation from the block beginning.
         QRect placedRect = item.pageRect.translated(m_horizontalOffset - m_layout.blockRect.left(), m_verticalOffset - m_layout.blockRect.top());
-        if (placedRect.intersects(viewport))
-        {
-            const PDFPage* page = m_controller->getDocument()->getCatalog()->getPage(item.pageIndex);
-
-            PDFWidgetSnapshot::SnapshotItem snapshotItem;
-            snapshotItem.rect = placedRect;
-            snapshotItem.pageIndex = item.pageIndex;
-            snapshotItem.compiledPage = m_compiler->getCompiledPage(item.pageIndex, false);
-            snapshotItem.pageToDeviceMatrix = createPagePointToDevicePointMatrix(page, placedRect);
-            snapshot.items.emplace_back(qMove(snapshotItem));
-        }
+        const PDFPage* page = m_controller->getDocument()->getCatalog()->getPage(item.pageIndex);
+
+        PDFWidgetSnapshot::SnapshotItem snapshotItem;
+        snapshotItem.rect = placedRect;
+        snapshotItem.pageIndex = item.pageIndex;
+        snapshotItem.compiledPage = m_compiler->getCompiledPage(item.pageIndex, false);
+        snapshotItem.pageToDeviceMatrix = createPagePointToDevicePointMatrix(page, placedRect);
+        snapshot.items.emplace_back(qMove(snapshotItem));
     }
 
     return snapshot;
@@ -1097,16 +1350,13 @@ QRect PDFDrawWidgetProxy::getPagesIntersectingRectBoundingBox(QRect rect) const
     QRect resultRect;
 
     // Iterate trough pages, place them and test, if they intersects with rectangle
-    for (const LayoutItem& item : m_layout.items)
+    for (size_t layoutItemIndex : getLayoutItemsIntersectingRect(rect))
     {
         // The offsets m_horizontalOffset and m_verticalOffset are offsets to the
         // topleft point of the block. But block maybe doesn't start at (0, 0),
         // so we must also use translation from the block beginning.
-        QRect placedRect = item.pageRect.translated(m_horizontalOffset - m_layout.blockRect.left(), m_verticalOffset - m_layout.blockRect.top());
-        if (placedRect.intersects(rect))
-        {
-            resultRect = resultRect.united(placedRect);
-        }
+        const LayoutItem& item = m_layout.items[layoutItemIndex];
+        resultRect = resultRect.united(item.pageRect.translated(m_horizontalOffset - m_layout.blockRect.left(), m_verticalOffset - m_layout.blockRect.top()));
     }
 
     return resultRect;
@@ -1446,8 +1696,10 @@ void PDFDrawWidgetProxy::updateRenderer(RendererEngine rendererEngine)
     m_rasterizer->reset(m_rendererEngine);
 }
 
-void PDFDrawWidgetProxy::prefetchPages(PDFInteger pageIndex)
+std::vector<PDFInteger> PDFDrawWidgetProxy::prefetchPages(const std::vector<PDFInteger>& visiblePages)
 {
+    std::vector<PDFInteger> prefetchedPages;
+
     // Determine number of pages, which should be prefetched. In case of two or more pages,
     // we need to prefetch more pages (for example, two for two columns/two pages display mode).
     int prefetchCount = 0;
@@ -1474,15 +1726,51 @@ void PDFDrawWidgetProxy::prefetchPages(PDFInteger pageIndex)
             break;
     }
 
-    if (const PDFDocument* document = getDocument())
+    const PDFDocument* document = getDocument();
+    if (!document || visiblePages.empty())
     {
-        const PDFInteger pageCount = document->getCatalog()->getPageCount();
-        const PDFInteger pageEnd = qMin(pageCount, pageIndex + prefetchCount + 1);
-        for (PDFInteger i = pageIndex + 1; i < pageEnd; ++i)
+        return prefetchedPages;
+    }
+
+    const PDFInteger pageCount = document->getCatalog()->getPageCount();
+    if (m_scrollDirection > 0)
+    {
+        const PDFInteger pageEnd = qMin(pageCount, visiblePages.back() + prefetchCount + 1);
+        for (PDFInteger i = visiblePages.back() + 1; i < pageEnd; ++i)
+        {
+            prefetchedPages.push_back(i);
+        }
+    }
+    else
+    {
+        const PDFInteger pageStart = qMax(PDFInteger(0), visiblePages.front() - prefetchCount);
+        for (PDFInteger i = pageStart; i < visiblePages.front(); ++i)
         {
-            m_compiler->getCompiledPage(i, true);
+            prefetchedPages.push_back(i);
         }
     }
+
+    for (const PDFInteger pageIndex : prefetchedPages)
+    {
+        m_compiler->getCompiledPage(pageIndex, true, PDFAsynchronousPageCompiler::Priority::Prefetch);
+    }
+
+    return prefetchedPages;
+}
+
+void PDFDrawWidgetProxy::updateCompileTasks(QRect rect)
+{
+    if (!getDocument())
+    {
+        return;
+    }
+
+    std::vector<PDFInteger> activePages = getPagesIntersectingRect(rect);
+    std::vector<PDFInteger> prefetchedPages = prefetchPages(activePages);
+    activePages.insert(activePages.end(), prefetchedPages.cbegin(), prefetchedPages.cend());
+    std::sort(activePages.begin(), activePages.end());
+
+    m_compiler->cancelStaleTasks(activePages);
 }
 
 void PDFDrawWidgetProxy::onHorizontalScrollbarValueChanged(int value)
@@ -1526,6 +1814,8 @@ void PDFDrawWidgetProxy::setVerticalOffset(int value)
 
     if (m_verticalOffset != verticalOffset)
     {
+        // Offset is decreasing, when we are scrolling down
+        m_scrollDirection = verticalOffset < m_verticalOffset ? 1 : -1;
         m_verticalOffset = verticalOffset;
         updateVerticalScrollbarFromOffset();
         Q_EMIT drawSpaceChanged();
@@ -1536,6 +1826,11 @@ void PDFDrawWidgetProxy::setBlockIndex(int index)
 {
     if (m_currentBlock != index)
     {
+        if (m_currentBlock != INVALID_BLOCK_INDEX)
+        {
+            m_scrollDirection = static_cast<size_t>(index) > m_currentBlock ? 1 : -1;
+        }
+
         m_currentBlock = static_cast<size_t>(index);
         update();
     }
@@ -1639,7 +1934,8 @@ void PDFDrawWidgetProxy::onColorManagementSystemChanged()
 
 void PDFDrawWidgetProxy::onOptionalContentGroupStateChanged()
 {
-    m_compiler->reset();
+    // Compiled pages contain all optional content, hidden optional
+    // content is skipped, when page is drawn, so just redraw the pages.
     m_textLayoutCompiler->reset();
     Q_EMIT pageImageChanged(true, { });
 }
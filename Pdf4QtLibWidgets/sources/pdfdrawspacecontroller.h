@@ -30,6 +30,8 @@
 #include <QObject>
 #include <QMarginsF>
 
+#include <span>
+
 class QPainter;
 class QScrollBar;
 class QTimer;
@@ -43,6 +45,8 @@ class PDFTextLayoutGetter;
 class PDFWidgetAnnotationManager;
 class PDFAsynchronousPageCompiler;
 class PDFAsynchronousTextLayoutCompiler;
+class PDFAsynchronousTileRenderer;
+class PDFAsynchronousThumbnailRenderer;
 
 /// This class controls draw space - page layout. Pages are divided into blocks
 /// each block can contain one or multiple pages. Units are in milimeters.
@@ -95,11 +99,13 @@ public:
     };
 
     using LayoutItems = std::vector<LayoutItem>;
+    using LayoutItemsView = std::span<const LayoutItem>;
 
     /// Returns the layout items for desired block. If block doesn't exist,
-    /// then empty array is returned.
+    /// then empty view is returned. View is valid until the draw
+    /// space is recalculated.
     /// \param blockIndex Index of the block
-    LayoutItems getLayoutItems(size_t blockIndex) const;
+    LayoutItemsView getLayoutItems(size_t blockIndex) const;
 
     /// Returns layout for single page. If page index is invalid,
     /// or page layout cannot be found, then invalid layout item is returned.
@@ -167,6 +173,13 @@ private:
     PageLayout m_pageLayoutMode;
     LayoutItems m_layoutItems;
     BlockItems m_blockItems;
+
+    /// Index of the first layout item of each page (or -1,
+    /// if page is not in the layout).
+    std::vector<PDFInteger> m_pageLayoutItemIndices;
+
+    /// Bounding box of the layout items, moved to the top
+    QRectF m_referenceBoundingBox;
     PDFReal m_verticalSpacingMM;
     PDFReal m_horizontalSpacingMM;
     PageRotation m_pageRotation;
@@ -212,6 +225,27 @@ public:
     /// \param rect Rectangle in which the content is painted
     void draw(QPainter* painter, QRect rect);
 
+    /// Draws part of the actually visible pages on the painter. Only pages (and
+    /// graphics of draw interfaces on them) intersecting the dirty rectangle are
+    /// drawn, page contents are drawn using cached raster tiles. Painter must be
+    /// clipped to the dirty rectangle, rest of the widget is not changed.
+    /// \param painter Painter to paint the PDF pages
+    /// \param rect Rectangle in which the content is painted
+    /// \param dirtyRect Rectangle, which is repainted
+    void draw(QPainter* painter, QRect rect, QRect dirtyRect);
+
+    /// Requests repaint of the rectangle of the widget. Only this part
+    /// of the widget is repainted (see \p draw with dirty rectangle).
+    /// \param rect Rectangle in the widget coordinates
+    void repaintRect(const QRectF& rect);
+
+    /// Requests repaint of the rectangle on the page. Only this part of
+    /// the widget is repainted. If page is not visible, nothing is repainted,
+    /// if page index is invalid, whole widget is repainted.
+    /// \param pageIndex Page index
+    /// \param pageRect Rectangle in the page coordinate system
+    void repaintPageRect(PDFInteger pageIndex, const QRectF& pageRect);
+
     /// Draws the actually visible pages on the painter using the rectangle.
     /// Rectangle is space in the widget, which is used for painting the PDF.
     /// \param painter Painter to paint the PDF pages
@@ -219,6 +253,39 @@ public:
     /// \param features Rendering features
     void drawPages(QPainter* painter, QRect rect, PDFRenderer::Features features);
 
+    /// Visible page, which content is drawn by other means than by the painter
+    /// (for example, by the GPU renderer).
+    struct PageContentItem
+    {
+        PDFInteger pageIndex = -1;
+        std::shared_ptr<const PDFPrecompiledPage> compiledPage; ///< Compiled page (can be nullptr, if page is not yet compiled)
+        QRect placedRect;                                       ///< Page rectangle in the widget
+        QTransform pagePointToDevicePointMatrix;
+        QColor paperColor;                                      ///< Paper color (invalid, if paper is not drawn)
+        PDFReal opacity = 1.0;
+        bool isContentDrawSuppressed = false;
+        std::vector<bool> optionalContentVisibility;             ///< Visibility of optional content of the compiled page (empty, if all content is visible)
+    };
+
+    /// Returns visible pages in the rectangle, which contents are then drawn
+    /// by other means than by the painter. Compilation of pages, which are not
+    /// compiled yet, is requested. Graphics other than page contents should be
+    /// drawn using \p drawOverlay function.
+    /// \param rect Rectangle in which the content is painted
+    /// \sa drawOverlay
+    std::vector<PageContentItem> getPageContentItems(QRect rect);
+
+    /// Draws the graphics over the actually visible pages (annotations, tools,
+    /// debug information, ...), but not the background, paper and page contents.
+    /// It is used together with \p getPageContentItems, when page contents
+    /// are drawn by other means than by the painter. Pages, which can't be
+    /// drawn on the GPU (see PDFGpuPageGeometry::isPageSupported), are drawn
+    /// including their paper and contents.
+    /// \param painter Painter to paint the overlay
+    /// \param rect Rectangle in which the content is painted
+    /// \sa getPageContentItems
+    void drawOverlay(QPainter* painter, QRect rect);
+
     /// Draws thumbnail image of the given size (so larger of the page size
     /// width or height equals to pixel size and the latter size is rescaled
     /// using the aspect ratio)
@@ -321,9 +388,16 @@ public:
     /// \param rendererEngine Renderer engine
     void updateRenderer(RendererEngine rendererEngine);
 
-    /// Prefetches (prerenders) pages after page with pageIndex, i.e., prepares
-    /// for non-flickering scroll operation.
-    void prefetchPages(PDFInteger pageIndex);
+    /// Prefetches (precompiles) pages after the visible pages in the scroll
+    /// direction, i.e., prepares for non-flickering scroll operation.
+    /// Returns indices of prefetched pages.
+    /// \param visiblePages Sorted vector of visible pages
+    std::vector<PDFInteger> prefetchPages(const std::vector<PDFInteger>& visiblePages);
+
+    /// Prefetches pages and cancels compilation of pages, which are
+    /// neither visible nor prefetched (for example, during fast scrolling).
+    /// \param rect Visible rectangle of the widget
+    void updateCompileTasks(QRect rect);
 
     static constexpr PDFReal ZOOM_STEP = 1.2;
 
@@ -337,6 +411,8 @@ public:
     PDFProgress* getProgress() const { return m_progress; }
     void setProgress(PDFProgress* progress) { m_progress = progress; }
     PDFAsynchronousTextLayoutCompiler* getTextLayoutCompiler() const { return m_textLayoutCompiler; }
+    PDFAsynchronousTileRenderer* getTileRenderer() const { return m_tileRenderer; }
+    PDFAsynchronousThumbnailRenderer* getThumbnailRenderer() const { return m_thumbnailRenderer; }
     PDFWidget* getWidget() const { return m_widget; }
     RendererEngine getRendererEngine() const { return m_rendererEngine; }
     PageRotation getPageRotation() const { return m_controller->getPageRotation(); }
@@ -375,11 +451,23 @@ public:
     
     PDFWidgetAnnotationManager* getAnnotationManager() const;
 
+    /// Hibernates the proxy, or wakes it up. Hibernated proxy releases compiled
+    /// pages, text layouts, rendered tiles, thumbnails, fonts and decoded data
+    /// of the document, only the document itself is kept. Proxy wakes up
+    /// automatically, when pages are drawn, then visible pages are compiled
+    /// first and neighbouring pages are prefetched afterwards.
+    /// \param hibernated Hibernate (true) or wake up (false) the proxy
+    void setHibernated(bool hibernated);
+
+    /// Returns true, if proxy is hibernated
+    bool isHibernated() const { return m_isHibernated; }
+
 signals:
     void drawSpaceChanged();
     void pageLayoutChanged();
     void renderingError(pdf::PDFInteger pageIndex, const QList<pdf::PDFRenderError>& errors);
     void repaintNeeded();
+    void repaintRectNeeded(QRect rect);
     void pageImageChanged(bool all, const std::vector<PDFInteger>& pages);
     void textLayoutChanged();
 
@@ -402,10 +490,23 @@ private:
         {
             items.clear();
             blockRect = QRect();
+            itemsByTop.clear();
+            maxBottoms.clear();
         }
 
+        /// Builds index for fast search of the items intersecting
+        /// given rectangle (it must be called, when items are changed).
+        void buildIndex();
+
         std::vector<LayoutItem> items;
         QRect blockRect;
+
+        /// Indices of the items, sorted by the top edge of the page rectangle
+        std::vector<size_t> itemsByTop;
+
+        /// Maximal bottom edge of the page rectangles of the items sorted by
+        /// the top edge (prefix maximum, so it is nondecreasing).
+        std::vector<int> maxBottoms;
     };
 
     struct GroupInfo
@@ -424,12 +525,33 @@ private:
     static constexpr PDFReal MIN_ZOOM = 8.0 / 100.0;
     static constexpr PDFReal MAX_ZOOM = 6400.0 / 100.0;
 
+    /// Margin of the repainted rectangles (in pixels), so frames
+    /// and antialiased edges around them are repainted too.
+    static constexpr int REPAINT_RECT_MARGIN = 4;
+
     static constexpr qint64 CACHE_CLEAR_TIMEOUT = 5000;
     static constexpr qint64 CACHE_PAGE_EXPIRATION_TIMEOUT = 30000;
 
     /// Converts rectangle from device space to the pixel space
     QRectF fromDeviceSpace(const QRectF& rect) const;
 
+    /// Returns indices of the layout items, which page rectangle placed in the
+    /// widget intersects given rectangle. Indices are sorted, so items are in
+    /// the layout order. Binary search is used, so only items near the
+    /// rectangle are examined.
+    /// \param rect Rectangle in the widget
+    std::vector<size_t> getLayoutItemsIntersectingRect(QRect rect) const;
+
+    /// Draws the actually visible pages on the painter using the rectangle.
+    /// If \p useTiles is true, then page contents are drawn using cached
+    /// raster tiles, if possible.
+    /// \param painter Painter to paint the PDF pages
+    /// \param rect Rectangle in which the content is painted
+    /// \param features Rendering features
+    /// \param useTiles Use tile renderer
+    /// \param drawContent Draw background, paper and page contents
+    void drawPagesImpl(QPainter* painter, QRect rect, PDFRenderer::Features features, bool useTiles, bool drawContent);
+
     void performPageCacheClear();
 
     void onTextLayoutChanged();
@@ -484,6 +606,10 @@ private:
     /// with this vertical offset)
     PDFInteger m_verticalOffset;
 
+    /// Direction of the last scroll (1 forward, -1 backward), it
+    /// is used to determine pages, which should be prefetched.
+    int m_scrollDirection = 1;
+
     /// Range of vertical offset
     Range<PDFInteger> m_verticalOffsetRange;
 
@@ -521,6 +647,12 @@ private:
     /// Text layout compiler
     PDFAsynchronousTextLayoutCompiler* m_textLayoutCompiler;
 
+    /// Raster tile renderer (and cache) for page contents
+    PDFAsynchronousTileRenderer* m_tileRenderer;
+
+    /// Background renderer (and persistent cache) of page thumbnails
+    PDFAsynchronousThumbnailRenderer* m_thumbnailRenderer;
+
     /// Page image rasterizer for thumbnails
     PDFRasterizer* m_rasterizer;
 
@@ -536,6 +668,9 @@ private:
     /// Renderer engine
     RendererEngine m_rendererEngine;
 
+    /// Is proxy hibernated (caches are released)?
+    bool m_isHibernated = false;
+
     /// Page group info for rendering. Group of pages
     /// can be rendered with transparency or without paper
     /// as overlay.
@@ -25,6 +25,10 @@
 #include "pdfblpainter.h"
 #include "pdfpagecontentelements.h"
 
+#ifdef PDF4QT_ENABLE_RHI_RENDERER
+#include "pdfrhidrawwidget.h"
+#endif
+
 #include <QPainter>
 #include <QGridLayout>
 #include <QKeyEvent>
@@ -49,7 +53,7 @@ PDFWidget::PDFWidget(const PDFCMSManager* cmsManager, RendererEngine engine, QWi
     m_proxy(nullptr),
     m_rendererEngine(engine)
 {
-    m_drawWidget = new PDFDrawWidget(this, this);
+    m_drawWidget = createDrawWidget(engine);
     m_horizontalScrollBar = new QScrollBar(Qt::Horizontal, this);
     m_verticalScrollBar = new QScrollBar(Qt::Vertical, this);
 
@@ -68,6 +72,7 @@ PDFWidget::PDFWidget(const PDFCMSManager* cmsManager, RendererEngine engine, QWi
     m_proxy->updateRenderer(m_rendererEngine);
     connect(m_proxy, &PDFDrawWidgetProxy::renderingError, this, &PDFWidget::onRenderingError);
     connect(m_proxy, &PDFDrawWidgetProxy::repaintNeeded, m_drawWidget->getWidget(), QOverload<>::of(&QWidget::update));
+    connect(m_proxy, &PDFDrawWidgetProxy::repaintRectNeeded, m_drawWidget->getWidget(), QOverload<const QRect&>::of(&QWidget::update));
     connect(m_proxy, &PDFDrawWidgetProxy::pageImageChanged, this, &PDFWidget::onPageImageChanged);
 }
 
@@ -95,8 +100,61 @@ void PDFWidget::setDocument(const PDFModifiedDocument& document)
 
 void PDFWidget::updateRenderer(RendererEngine engine)
 {
+    const bool isDrawWidgetChanged = isRhiDrawWidgetUsed(m_rendererEngine) != isRhiDrawWidgetUsed(engine);
+
     m_rendererEngine = engine;
     m_proxy->updateRenderer(m_rendererEngine);
+
+    if (isDrawWidgetChanged)
+    {
+        // Draw widget must be replaced by the widget of the other type
+        IDrawWidget* oldDrawWidget = m_drawWidget;
+        m_drawWidget = createDrawWidget(engine);
+
+        QWidget* oldWidget = oldDrawWidget->getWidget();
+        QWidget* newWidget = m_drawWidget->getWidget();
+        const bool hasFocus = oldWidget->hasFocus();
+
+        delete layout()->replaceWidget(oldWidget, newWidget);
+        setFocusProxy(newWidget);
+        connect(m_proxy, &PDFDrawWidgetProxy::repaintNeeded, newWidget, QOverload<>::of(&QWidget::update));
+        connect(m_proxy, &PDFDrawWidgetProxy::repaintRectNeeded, newWidget, QOverload<const QRect&>::of(&QWidget::update));
+
+        if (hasFocus)
+        {
+            newWidget->setFocus();
+        }
+
+        oldWidget->hide();
+        oldWidget->deleteLater();
+        m_proxy->update();
+    }
+}
+
+bool PDFWidget::isRhiRendererSupported()
+{
+#ifdef PDF4QT_ENABLE_RHI_RENDERER
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PDFWidget::isRhiDrawWidgetUsed(RendererEngine engine)
+{
+    return engine == RendererEngine::QRhi && isRhiRendererSupported();
+}
+
+IDrawWidget* PDFWidget::createDrawWidget(RendererEngine engine)
+{
+#ifdef PDF4QT_ENABLE_RHI_RENDERER
+    if (isRhiDrawWidgetUsed(engine))
+    {
+        return new PDFRhiDrawWidget(this, this);
+    }
+#endif
+
+    return new PDFDrawWidget(this, this);
 }
 
 void PDFWidget::updateCacheLimits(int compiledPageCacheLimit, int thumbnailsCacheLimit, int fontCacheLimit, int instancedFontCacheLimit)
@@ -226,7 +284,8 @@ void PDFWidget::setAnnotationManager(PDFWidgetAnnotationManager* annotationManag
     addInputInterface(m_annotationManager);
 }
 
-PDFDrawWidget::PDFDrawWidget(PDFWidget* widget, QWidget* parent) :
+template<typename BaseWidget>
+PDFDrawWidgetBase<BaseWidget>::PDFDrawWidgetBase(PDFWidget* widget, QWidget* parent) :
     BaseClass(parent),
     m_widget(widget),
     m_mouseOperation(MouseOperation::None)
@@ -234,20 +293,23 @@ PDFDrawWidget::PDFDrawWidget(PDFWidget* widget, QWidget* parent) :
     this->setFocusPolicy(Qt::StrongFocus);
     this->setMouseTracking(true);
 
-    QObject::connect(&m_autoScrollTimer, &QTimer::timeout, this, &PDFDrawWidget::onAutoScrollTimeout);
+    QObject::connect(&m_autoScrollTimer, &QTimer::timeout, this, &PDFDrawWidgetBase::onAutoScrollTimeout);
 }
 
-std::vector<PDFInteger> PDFDrawWidget::getCurrentPages() const
+template<typename BaseWidget>
+std::vector<PDFInteger> PDFDrawWidgetBase<BaseWidget>::getCurrentPages() const
 {
     return this->m_widget->getDrawWidgetProxy()->getPagesIntersectingRect(this->rect());
 }
 
-QSize PDFDrawWidget::minimumSizeHint() const
+template<typename BaseWidget>
+QSize PDFDrawWidgetBase<BaseWidget>::minimumSizeHint() const
 {
     return QSize(200, 200);
 }
 
-bool PDFDrawWidget::event(QEvent* event)
+template<typename BaseWidget>
+bool PDFDrawWidgetBase<BaseWidget>::event(QEvent* event)
 {
     if (event->type() == QEvent::ShortcutOverride)
     {
@@ -257,7 +319,8 @@ bool PDFDrawWidget::event(QEvent* event)
     return BaseClass::event(event);
 }
 
-void PDFDrawWidget::performMouseOperation(QPoint currentMousePosition)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::performMouseOperation(QPoint currentMousePosition)
 {
     switch (m_mouseOperation)
     {
@@ -285,8 +348,9 @@ void PDFDrawWidget::performMouseOperation(QPoint currentMousePosition)
     }
 }
 
+template<typename BaseWidget>
 template<typename Event, void (IDrawWidgetInputInterface::* Function)(QWidget*, Event*)>
-bool PDFDrawWidget::processEvent(Event* event)
+bool PDFDrawWidgetBase<BaseWidget>::processEvent(Event* event)
 {
     QString tooltip;
     for (IDrawWidgetInputInterface* inputInterface : m_widget->getInputInterfaces())
@@ -312,7 +376,8 @@ bool PDFDrawWidget::processEvent(Event* event)
     return false;
 }
 
-void PDFDrawWidget::keyPressEvent(QKeyEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::keyPressEvent(QKeyEvent* event)
 {
     event->ignore();
 
@@ -348,7 +413,8 @@ void PDFDrawWidget::keyPressEvent(QKeyEvent* event)
     updateCursor();
 }
 
-void PDFDrawWidget::keyReleaseEvent(QKeyEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::keyReleaseEvent(QKeyEvent* event)
 {
     event->ignore();
 
@@ -360,7 +426,8 @@ void PDFDrawWidget::keyReleaseEvent(QKeyEvent* event)
     event->accept();
 }
 
-void PDFDrawWidget::mousePressEvent(QMouseEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::mousePressEvent(QMouseEvent* event)
 {
     event->ignore();
 
@@ -400,7 +467,8 @@ void PDFDrawWidget::mousePressEvent(QMouseEvent* event)
     event->accept();
 }
 
-void PDFDrawWidget::mouseDoubleClickEvent(QMouseEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::mouseDoubleClickEvent(QMouseEvent* event)
 {
     event->ignore();
 
@@ -410,7 +478,8 @@ void PDFDrawWidget::mouseDoubleClickEvent(QMouseEvent* event)
     }
 }
 
-void PDFDrawWidget::mouseReleaseEvent(QMouseEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::mouseReleaseEvent(QMouseEvent* event)
 {
     event->ignore();
 
@@ -447,7 +516,8 @@ void PDFDrawWidget::mouseReleaseEvent(QMouseEvent* event)
     event->accept();
 }
 
-void PDFDrawWidget::mouseMoveEvent(QMouseEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::mouseMoveEvent(QMouseEvent* event)
 {
     event->ignore();
 
@@ -461,7 +531,8 @@ void PDFDrawWidget::mouseMoveEvent(QMouseEvent* event)
     event->accept();
 }
 
-void PDFDrawWidget::updateCursor()
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::updateCursor()
 {
     std::optional<QCursor> cursor;
 
@@ -508,7 +579,8 @@ void PDFDrawWidget::updateCursor()
     }
 }
 
-void PDFDrawWidget::onAutoScrollTimeout()
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::onAutoScrollTimeout()
 {
     if (m_mouseOperation != MouseOperation::AutoScroll)
     {
@@ -532,7 +604,8 @@ void PDFDrawWidget::onAutoScrollTimeout()
     proxy->scrollByPixels(QPoint(scrollX, scrollY));
 }
 
-void PDFDrawWidget::wheelEvent(QWheelEvent* event)
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::wheelEvent(QWheelEvent* event)
 {
     event->ignore();
 
@@ -611,9 +684,26 @@ void PDFDrawWidget::wheelEvent(QWheelEvent* event)
     event->accept();
 }
 
+template<typename BaseWidget>
+void PDFDrawWidgetBase<BaseWidget>::resizeEvent(QResizeEvent* event)
+{
+    BaseClass::resizeEvent(event);
+
+    getPDFWidget()->getDrawWidgetProxy()->update();
+}
+
+PDFDrawWidget::PDFDrawWidget(PDFWidget* widget, QWidget* parent) :
+    BaseClass(widget, parent)
+{
+
+}
+
 void PDFDrawWidget::paintEvent(QPaintEvent* event)
 {
-    Q_UNUSED(event);
+    // Only dirty part of the widget is repainted, for example, when
+    // form field is being edited, or annotation is being hovered.
+    const QRect rect = this->rect();
+    QRect dirtyRect = event->rect().intersected(rect);
 
     RendererEngine rendererEngine = getPDFWidget()->getDrawWidgetProxy()->getRendererEngine();
     switch (rendererEngine)
@@ -621,7 +711,6 @@ void PDFDrawWidget::paintEvent(QPaintEvent* event)
         case RendererEngine::Blend2D_MultiThread:
         case RendererEngine::Blend2D_SingleThread:
         {
-            QRect rect = this->rect();
 
             qreal devicePixelRatio = devicePixelRatioF();
             m_blend2DframeBuffer.setDevicePixelRatio(devicePixelRatio);
@@ -634,7 +723,9 @@ void PDFDrawWidget::paintEvent(QPaintEvent* event)
             QSize requiredSize = rect.size() * devicePixelRatio;
             if (m_blend2DframeBuffer.size() != requiredSize)
             {
+                // Frame buffer content is lost, it must be repainted entirely
                 m_blend2DframeBuffer = QImage(requiredSize, QImage::Format_ARGB32_Premultiplied);
+                dirtyRect = rect;
             }
 
             const bool multithreaded = rendererEngine == RendererEngine::Blend2D_MultiThread;
@@ -643,7 +734,12 @@ void PDFDrawWidget::paintEvent(QPaintEvent* event)
 
             if (blPainter.begin(&blPaintDevice))
             {
-                getPDFWidget()->getDrawWidgetProxy()->draw(&blPainter, rect);
+                if (dirtyRect != rect)
+                {
+                    blPainter.setClipRect(dirtyRect);
+                }
+
+                getPDFWidget()->getDrawWidgetProxy()->draw(&blPainter, rect, dirtyRect);
                 blPainter.end();
             }
 
@@ -653,9 +749,11 @@ void PDFDrawWidget::paintEvent(QPaintEvent* event)
         }
 
         case RendererEngine::QPainter:
+        case RendererEngine::QRhi: // GPU widget is not available, use QPainter
         {
+            // Painter is clipped to the dirty region by the widget
             QPainter painter(this);
-            getPDFWidget()->getDrawWidgetProxy()->draw(&painter, this->rect());
+            getPDFWidget()->getDrawWidgetProxy()->draw(&painter, rect, dirtyRect);
             m_blend2DframeBuffer = QImage();
             break;
         }
@@ -666,11 +764,10 @@ void PDFDrawWidget::paintEvent(QPaintEvent* event)
     }
 }
 
-void PDFDrawWidget::resizeEvent(QResizeEvent* event)
-{
-    BaseClass::resizeEvent(event);
+template class PDFDrawWidgetBase<QWidget>;
 
-    getPDFWidget()->getDrawWidgetProxy()->update();
-}
+#ifdef PDF4QT_ENABLE_RHI_RENDERER
+template class PDFDrawWidgetBase<QRhiWidget>;
+#endif
 
 }   // namespace pdf
@@ -79,6 +79,10 @@ public:
     /// \param engine Engine type
     void updateRenderer(RendererEngine engine);
 
+    /// Returns true, if GPU renderer (RendererEngine::QRhi) is available. If it
+    /// is not available, then pages are rendered using QPainter instead.
+    static bool isRhiRendererSupported();
+
     /// Updates cache limits
     /// \param compiledPageCacheLimit Compiled page cache limit [bytes]
     /// \param thumbnailsCacheLimit Thumbnail image cache limit [kB]
@@ -118,6 +122,12 @@ private:
     void onPageImageChanged(bool all, const std::vector<PDFInteger>& pages);
     void onSceneActiveStateChanged(bool);
 
+    /// Returns true, if draw widget, which renders pages on the GPU, is used for the engine
+    static bool isRhiDrawWidgetUsed(RendererEngine engine);
+
+    /// Creates draw widget for given renderer engine
+    IDrawWidget* createDrawWidget(RendererEngine engine);
+
     const PDFCMSManager* m_cmsManager;
     PDFToolManager* m_toolManager;
     PDFWidgetAnnotationManager* m_annotationManager;
@@ -132,16 +142,15 @@ private:
     RendererEngine m_rendererEngine;
 };
 
-class PDFDrawWidget : public QWidget, public IDrawWidget
+template<typename BaseWidget>
+class PDFDrawWidgetBase : public BaseWidget, public IDrawWidget
 {
-    Q_OBJECT
-
 private:
-    using BaseClass = QWidget;
+    using BaseClass = BaseWidget;
 
 public:
-    explicit PDFDrawWidget(PDFWidget* widget, QWidget* parent);
-    virtual ~PDFDrawWidget() override = default;
+    explicit PDFDrawWidgetBase(PDFWidget* widget, QWidget* parent);
+    virtual ~PDFDrawWidgetBase() override = default;
 
     /// Returns page indices, which are currently displayed in the widget
     virtual std::vector<PDFInteger> getCurrentPages() const override;
@@ -159,7 +168,6 @@ protected:
     virtual void mouseReleaseEvent(QMouseEvent* event) override;
     virtual void mouseMoveEvent(QMouseEvent* event) override;
     virtual void wheelEvent(QWheelEvent* event) override;
-    virtual void paintEvent(QPaintEvent* event) override;
     virtual void resizeEvent(QResizeEvent* event) override;
 
     PDFWidget* getPDFWidget() const { return m_widget; }
@@ -189,9 +197,30 @@ private:
     QTimer m_autoScrollTimer;
     QPointF m_autoScrollOffset;
     QElapsedTimer m_autoScrollLastElapsedTimer;
+};
+
+/// Draw widget, which paints pages using software renderers
+/// (QPainter or Blend2D).
+class PDFDrawWidget : public PDFDrawWidgetBase<QWidget>
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = PDFDrawWidgetBase<QWidget>;
+
+public:
+    explicit PDFDrawWidget(PDFWidget* widget, QWidget* parent);
+    virtual ~PDFDrawWidget() override = default;
+
+protected:
+    virtual void paintEvent(QPaintEvent* event) override;
+
+private:
     QImage m_blend2DframeBuffer;
 };
 
+extern template class PDFDrawWidgetBase<QWidget>;
+
 }   // namespace pdf
 
 #endif // PDFDRAWWIDGET_H
@@ -19,6 +19,7 @@
 #include "pdfdocument.h"
 #include "pdfdrawspacecontroller.h"
 #include "pdfdrawwidget.h"
+#include "pdfcompiler.h"
 
 #include <QFont>
 #include <QStyle>
@@ -26,6 +27,7 @@
 #include <QMimeDatabase>
 #include <QFileIconProvider>
 #include <QMimeData>
+#include <QtConcurrent/QtConcurrent>
 
 #include "pdfdbgheap.h"
 
@@ -352,6 +354,18 @@ PDFOutlineTreeItem::PDFOutlineTreeItem(PDFOutlineTreeItem* parent, QSharedPointe
     PDFTreeItem(parent),
     m_outlineItem(qMove(outlineItem))
 {
+
+}
+
+void PDFOutlineTreeItem::fetchChildren()
+{
+    if (m_isChildrenFetched)
+    {
+        return;
+    }
+
+    m_isChildrenFetched = true;
+
     size_t childCount = m_outlineItem->getChildCount();
     for (size_t i = 0; i < childCount; ++i)
     {
@@ -359,12 +373,145 @@ PDFOutlineTreeItem::PDFOutlineTreeItem(PDFOutlineTreeItem* parent, QSharedPointe
     }
 }
 
+PDFOutlineTreeItemModel::PDFOutlineTreeItemModel(QIcon icon, bool editable, QObject* parent) :
+    PDFTreeItemModel(parent),
+    m_icon(qMove(icon)),
+    m_editable(editable)
+{
+    connect(&m_searchIndexWatcher, &QFutureWatcher<PDFOutlineSearchIndex>::finished, this, &PDFOutlineTreeItemModel::onSearchIndexBuilt);
+}
+
 int PDFOutlineTreeItemModel::columnCount(const QModelIndex& parent) const
 {
     Q_UNUSED(parent);
     return 1;
 }
 
+bool PDFOutlineTreeItemModel::hasChildren(const QModelIndex& parent) const
+{
+    const PDFOutlineTreeItem* item = getTreeItem(parent);
+    if (!item)
+    {
+        return false;
+    }
+
+    if (item->isChildrenFetched())
+    {
+        return item->getChildCount() > 0;
+    }
+
+    return item->getOutlineItem()->hasChildren();
+}
+
+bool PDFOutlineTreeItemModel::canFetchMore(const QModelIndex& parent) const
+{
+    const PDFOutlineTreeItem* item = getTreeItem(parent);
+    return item && !item->isChildrenFetched() && item->getOutlineItem()->hasChildren();
+}
+
+void PDFOutlineTreeItemModel::fetchMore(const QModelIndex& parent)
+{
+    fetchChildren(parent);
+}
+
+PDFOutlineTreeItem* PDFOutlineTreeItemModel::getTreeItem(const QModelIndex& index) const
+{
+    if (index.isValid())
+    {
+        return static_cast<PDFOutlineTreeItem*>(index.internalPointer());
+    }
+
+    return static_cast<PDFOutlineTreeItem*>(m_rootItem.get());
+}
+
+void PDFOutlineTreeItemModel::fetchChildren(const QModelIndex& parent)
+{
+    PDFOutlineTreeItem* item = getTreeItem(parent);
+    if (!item || item->isChildrenFetched())
+    {
+        return;
+    }
+
+    const int childCount = int(item->getOutlineItem()->getChildCount());
+    if (childCount > 0)
+    {
+        beginInsertRows(parent, 0, childCount - 1);
+        item->fetchChildren();
+        endInsertRows();
+    }
+    else
+    {
+        item->fetchChildren();
+    }
+}
+
+void PDFOutlineTreeItemModel::fetchAllChildren(const QModelIndex& parent)
+{
+    fetchChildren(parent);
+
+    for (int i = 0, count = rowCount(parent); i < count; ++i)
+    {
+        fetchAllChildren(index(i, 0, parent));
+    }
+}
+
+void PDFOutlineTreeItemModel::fetchMatchingItems(const QRegularExpression& expression)
+{
+    m_searchExpression = expression;
+
+    if (!m_rootItem || m_searchExpression.pattern().isEmpty())
+    {
+        return;
+    }
+
+    if (m_editable)
+    {
+        // Editable outline can differ from the document, so search
+        // index can't be used, and we must fetch all items.
+        fetchAllChildren(QModelIndex());
+        return;
+    }
+
+    fetchSearchResults();
+}
+
+void PDFOutlineTreeItemModel::fetchSearchResults()
+{
+    if (!m_searchIndex || m_searchExpression.pattern().isEmpty())
+    {
+        return;
+    }
+
+    for (const PDFOutlineSearchIndex::Path& path : m_searchIndex->find(m_searchExpression))
+    {
+        // Fetch all ancestors of the found item
+        QModelIndex parent;
+        for (size_t row : path)
+        {
+            fetchChildren(parent);
+
+            if (int(row) >= rowCount(parent))
+            {
+                break;
+            }
+
+            parent = index(int(row), 0, parent);
+        }
+    }
+}
+
+void PDFOutlineTreeItemModel::onSearchIndexBuilt()
+{
+    if (!m_searchIndexWatcher.future().isResultReadyAt(0))
+    {
+        // Index of the previous document was discarded
+        return;
+    }
+
+    m_searchIndex = m_searchIndexWatcher.result();
+    fetchSearchResults();
+}
+
 QVariant PDFOutlineTreeItemModel::data(const QModelIndex& index, int role) const
 {
     if (!index.isValid())
@@ -412,6 +559,11 @@ void PDFOutlineTreeItemModel::update()
 {
     beginResetModel();
 
+    // Search index of the previous document is discarded, if it is
+    // still being built, its result is not used.
+    m_searchIndex.reset();
+    m_searchIndexWatcher.setFuture(QFuture<PDFOutlineSearchIndex>());
+
     QSharedPointer<PDFOutlineItem> outlineRoot;
     if (m_document)
     {
@@ -424,15 +576,25 @@ void PDFOutlineTreeItemModel::update()
         {
             outlineRoot = outlineRoot->clone();
         }
+        else
+        {
+            // Index is built from the document, it holds the root item, so
+            // outline data are kept alive, until index is finished.
+            m_searchIndexWatcher.setFuture(QtConcurrent::run([outlineRoot]() { return PDFOutlineSearchIndex::build(outlineRoot.data()); }));
+        }
 
-        m_rootItem.reset(new PDFOutlineTreeItem(nullptr, qMove(outlineRoot)));
+        PDFOutlineTreeItem* rootItem = new PDFOutlineTreeItem(nullptr, qMove(outlineRoot));
+        rootItem->fetchChildren();
+        m_rootItem.reset(rootItem);
     }
     else
     {
         if (m_editable && m_document)
         {
             outlineRoot.reset(new pdf::PDFOutlineItem());
-            m_rootItem.reset(new PDFOutlineTreeItem(nullptr, qMove(outlineRoot)));
+            PDFOutlineTreeItem* rootItem = new PDFOutlineTreeItem(nullptr, qMove(outlineRoot));
+            rootItem->fetchChildren();
+            m_rootItem.reset(rootItem);
         }
         else
         {
@@ -652,6 +814,9 @@ bool PDFOutlineTreeItemModel::dropMimeData(const QMimeData* data, Qt::DropAction
 
 bool PDFOutlineTreeItemModel::insertRows(int row, int count, const QModelIndex& parent)
 {
+    // Tree items of the existing children must be created first
+    fetchChildren(parent);
+
     if (!m_editable || row < 0 || count <= 0 || row > rowCount(parent))
     {
         return false;
@@ -734,6 +899,8 @@ bool PDFOutlineTreeItemModel::moveRows(const QModelIndex& sourceParent, int sour
         return false;
     }
 
+    fetchChildren(destinationParent);
+
     if (destinationChild < 0)
     {
         destinationChild = 0;
@@ -940,7 +1107,7 @@ PDFThumbnailsItemModel::PDFThumbnailsItemModel(const PDFDrawWidgetProxy* proxy,
     m_pageCount(0),
     m_document(nullptr)
 {
-    connect(proxy, &PDFDrawWidgetProxy::pageImageChanged, this, &PDFThumbnailsItemModel::onPageImageChanged);
+    connect(proxy->getThumbnailRenderer(), &PDFAsynchronousThumbnailRenderer::thumbnailsChanged, this, &PDFThumbnailsItemModel::onThumbnailsChanged);
 }
 
 bool PDFThumbnailsItemModel::isEmpty() const
@@ -1000,8 +1167,10 @@ QVariant PDFThumbnailsItemModel::data(const QModelIndex& index, int role) const
             QPixmap pixmap;
             if (!m_thumbnailCache.find(key, &pixmap))
             {
+                // Thumbnail is rendered in the background, until then,
+                // substitute image is provided by the thumbnail renderer.
                 const qreal devicePixelRatio = m_proxy->getWidget()->devicePixelRatioF();
-                QImage thumbnail = m_proxy->drawThumbnailImage(index.row(), m_thumbnailSize * devicePixelRatio);
+                QImage thumbnail = m_proxy->getThumbnailRenderer()->getThumbnail(index.row(), m_thumbnailSize * devicePixelRatio);
                 if (!thumbnail.isNull())
                 {
                     thumbnail.setDevicePixelRatio(devicePixelRatio);
@@ -1075,11 +1244,8 @@ PDFInteger PDFThumbnailsItemModel::getPageIndex(const QModelIndex& index) const
     return index.row();
 }
 
-void PDFThumbnailsItemModel::onPageImageChanged(bool all, const std::vector<PDFInteger>& pages)
+void PDFThumbnailsItemModel::onThumbnailsChanged(bool all, const std::vector<PDFInteger>& pages)
 {
-    Q_UNUSED(all);
-    Q_UNUSED(pages);
-
     if (all)
     {
         m_thumbnailCache.clear();
@@ -1144,6 +1310,9 @@ void PDFSelectableOutlineTreeItemModel::update()
 {
     BaseClass::update();
     m_selectedItems.clear();
+
+    // Items are selected in the whole tree, so all items are needed
+    fetchAllChildren(QModelIndex());
 }
 
 Qt::ItemFlags PDFSelectableOutlineTreeItemModel::flags(const QModelIndex& index) const
@@ -21,12 +21,15 @@
 #include "pdfwidgetsglobal.h"
 #include "pdfglobal.h"
 #include "pdfobject.h"
+#include "pdfoutline.h"
 
 #include <QIcon>
 #include <QPixmapCache>
+#include <QFutureWatcher>
 #include <QAbstractItemModel>
 
 #include <set>
+#include <optional>
 
 namespace pdf
 {
@@ -156,6 +159,9 @@ private:
     PDFOptionalContentActivity* m_activity;
 };
 
+/// Tree item of the outline. Tree items of the children are created
+/// on demand (when item is expanded), so outline items are loaded
+/// only if they are needed.
 class PDFOutlineTreeItem : public PDFTreeItem
 {
 public:
@@ -164,23 +170,27 @@ public:
     const PDFOutlineItem* getOutlineItem() const { return m_outlineItem.data(); }
     PDFOutlineItem* getOutlineItem() { return m_outlineItem.data(); }
 
+    /// Returns true, if tree items of the children were created
+    bool isChildrenFetched() const { return m_isChildrenFetched; }
+
+    /// Creates tree items of the children of the outline item
+    void fetchChildren();
+
 private:
     QSharedPointer<PDFOutlineItem> m_outlineItem;
+    bool m_isChildrenFetched = false;
 };
 
 class PDF4QTLIBWIDGETSSHARED_EXPORT PDFOutlineTreeItemModel : public PDFTreeItemModel
 {
     Q_OBJECT
 public:
-    PDFOutlineTreeItemModel(QIcon icon, bool editable, QObject* parent) :
-        PDFTreeItemModel(parent),
-        m_icon(qMove(icon)),
-        m_editable(editable)
-    {
-
-    }
+    PDFOutlineTreeItemModel(QIcon icon, bool editable, QObject* parent);
 
     virtual int columnCount(const QModelIndex& parent) const override;
+    virtual bool hasChildren(const QModelIndex& parent) const override;
+    virtual bool canFetchMore(const QModelIndex& parent) const override;
+    virtual void fetchMore(const QModelIndex& parent) override;
     virtual QVariant data(const QModelIndex& index, int role) const override;
     virtual void update() override;
     virtual Qt::ItemFlags flags(const QModelIndex& index) const override;
@@ -216,10 +226,36 @@ public:
 
     bool isEditable() const { return m_editable; }
 
+    /// Fetches items, whose title matches the expression, so they can be
+    /// found by the filter proxy model. Items are found using the search
+    /// index, which is built in the background. If index is not yet built,
+    /// items are fetched, when it is finished. Editable model fetches all items.
+    /// \param expression Expression
+    void fetchMatchingItems(const QRegularExpression& expression);
+
+protected:
+    /// Creates tree items of all descendants of the item
+    void fetchAllChildren(const QModelIndex& parent);
+
 private:
+    /// Returns tree item for the given index (root item for invalid index)
+    PDFOutlineTreeItem* getTreeItem(const QModelIndex& index) const;
+
+    /// Creates tree items of the children of the item, if they are not created
+    void fetchChildren(const QModelIndex& parent);
+
+    /// Fetches items matching search expression using the search index
+    void fetchSearchResults();
+
+    void onSearchIndexBuilt();
+
     QIcon m_icon;
     bool m_editable;
     mutable QSharedPointer<PDFOutlineItem> m_dragDropItem;
+
+    QRegularExpression m_searchExpression;
+    std::optional<PDFOutlineSearchIndex> m_searchIndex;
+    QFutureWatcher<PDFOutlineSearchIndex> m_searchIndexWatcher;
 };
 
 class PDF4QTLIBWIDGETSSHARED_EXPORT PDFSelectableOutlineTreeItemModel : public PDFOutlineTreeItemModel
@@ -314,7 +350,7 @@ public:
     PDFInteger getPageIndex(const QModelIndex& index) const;
 
 private:
-    void onPageImageChanged(bool all, const std::vector<PDFInteger>& pages);
+    void onThumbnailsChanged(bool all, const std::vector<PDFInteger>& pages);
 
     /// Returns generated key for page index
     QString getKey(int pageIndex) const;
@@ -24,6 +24,7 @@
 #include "pdfcms.h"
 #include "pdfpagecontenteditorprocessor.h"
 
+#include <QtMath>
 #include <QBuffer>
 #include <QPainter>
 #include <QKeyEvent>
@@ -359,6 +360,8 @@ void PDFPageContentScene::addElement(PDFPageContentElement* element)
 {
     element->setElementId(m_firstFreeId++);
     m_elements.emplace_back(element);
+    m_elementsById[element->getElementId()] = element;
+    invalidateElement(element);
     Q_EMIT sceneChanged(false);
 }
 
@@ -370,7 +373,10 @@ void PDFPageContentScene::replaceElement(PDFPageContentElement* element)
     {
         if (m_elements[i]->getElementId() == element->getElementId())
         {
+            invalidateElement(m_elements[i].get());
             m_elements[i] = std::move(elementPtr);
+            m_elementsById[element->getElementId()] = element;
+            invalidateElement(element);
             Q_EMIT sceneChanged(false);
             break;
         }
@@ -379,10 +385,10 @@ void PDFPageContentScene::replaceElement(PDFPageContentElement* element)
 
 PDFPageContentElement* PDFPageContentScene::getElementById(PDFInteger id) const
 {
-    auto it = std::find_if(m_elements.cbegin(), m_elements.cend(), [id](const auto& element) { return element->getElementId() == id; });
-    if (it != m_elements.cend())
+    auto it = m_elementsById.find(id);
+    if (it != m_elementsById.cend())
     {
-        return it->get();
+        return it->second;
     }
 
     return nullptr;
@@ -394,6 +400,9 @@ void PDFPageContentScene::clear()
     {
         m_manipulator.reset();
         m_elements.clear();
+        m_elementsById.clear();
+        m_pageElementIndices.clear();
+        m_pageRenderCaches.clear();
         m_firstFreeId = 1;
         Q_EMIT sceneChanged(false);
     }
@@ -667,15 +676,167 @@ void PDFPageContentScene::drawElements(QPainter* painter,
                                        const PDFColorConvertor& convertor,
                                        QList<PDFRenderError>& errors) const
 {
-    for (const auto& element : m_elements)
+    const PageElementIndex* pageElementIndex = getPageElementIndex(pageIndex);
+    if (!pageElementIndex)
     {
-        if (element->getPageIndex() != pageIndex)
+        return;
+    }
+
+    // Draw only elements in the clipped area of the painter
+    bool isInvertible = false;
+    const QTransform devicePointToPagePointMatrix = pagePointToDevicePointMatrix.inverted(&isInvertible);
+    if (painter->hasClipping() && isInvertible)
+    {
+        const QRectF clipRect = devicePointToPagePointMatrix.mapRect(painter->clipBoundingRect());
+        for (size_t index : pageElementIndex->spatialIndex.query(clipRect))
         {
-            continue;
+            pageElementIndex->elements[index]->drawPage(painter, this, pageIndex, compiledPage, layoutGetter, pagePointToDevicePointMatrix, convertor, errors);
+        }
+    }
+    else
+    {
+        for (const PDFPageContentElement* element : pageElementIndex->elements)
+        {
+            element->drawPage(painter, this, pageIndex, compiledPage, layoutGetter, pagePointToDevicePointMatrix, convertor, errors);
+        }
+    }
+}
+
+bool PDFPageContentScene::drawCachedElements(QPainter* painter,
+                                             PDFInteger pageIndex,
+                                             PDFTextLayoutGetter& layoutGetter,
+                                             const QTransform& pagePointToDevicePointMatrix,
+                                             const PDFPrecompiledPage* compiledPage,
+                                             const PDFColorConvertor& convertor,
+                                             QList<PDFRenderError>& errors) const
+{
+    const PageElementIndex* pageElementIndex = getPageElementIndex(pageIndex);
+    if (!pageElementIndex)
+    {
+        m_pageRenderCaches.erase(pageIndex);
+        return true;
+    }
+
+    if (painter->worldTransform().type() > QTransform::TxTranslate)
+    {
+        // Cached image would be resampled
+        return false;
+    }
+
+    // Cached image covers whole page, so it is not rendered again,
+    // when elements are moved on the page.
+    QRectF pageRect = pageElementIndex->paintedBoundingBox;
+    if (const PDFDocument* document = getDocument())
+    {
+        if (const PDFPage* page = document->getCatalog()->getPage(pageIndex))
+        {
+            pageRect = pageRect.united(page->getMediaBox());
         }
+    }
+
+    const QRect deviceRect = pagePointToDevicePointMatrix.mapRect(pageRect).toAlignedRect().adjusted(-1, -1, 1, 1);
+    const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+    if (qint64(deviceRect.width()) * qint64(deviceRect.height()) * devicePixelRatio * devicePixelRatio > MAX_CACHED_IMAGE_PIXELS)
+    {
+        m_pageRenderCaches.erase(pageIndex);
+        return false;
+    }
+
+    PageRenderCache& cache = m_pageRenderCaches[pageIndex];
+
+    // Translation of the matrix by whole pixels (scrolling) only moves the image
+    const QTransform& matrix = pagePointToDevicePointMatrix;
+    const PDFReal dx = matrix.dx() - cache.matrix.dx();
+    const PDFReal dy = matrix.dy() - cache.matrix.dy();
+    const bool isTranslatedByWholePixels = qAbs(dx - qRound(dx)) < PDF_EPSILON && qAbs(dy - qRound(dy)) < PDF_EPSILON;
+    const bool isCacheValid = !cache.image.isNull() &&
+                              isTranslatedByWholePixels &&
+                              cache.matrix.m11() == matrix.m11() &&
+                              cache.matrix.m12() == matrix.m12() &&
+                              cache.matrix.m21() == matrix.m21() &&
+                              cache.matrix.m22() == matrix.m22() &&
+                              cache.pageRect == pageRect &&
+                              cache.devicePixelRatio == devicePixelRatio &&
+                              cache.convertor == convertor;
+
+    if (isCacheValid)
+    {
+        cache.deviceRect.translate(qRound(dx), qRound(dy));
+        cache.matrix = matrix;
+    }
+    else
+    {
+        cache.matrix = matrix;
+        cache.deviceRect = deviceRect;
+        cache.pageRect = pageRect;
+        cache.devicePixelRatio = devicePixelRatio;
+        cache.convertor = convertor;
+        cache.image = QImage(deviceRect.size() * devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+        cache.image.setDevicePixelRatio(devicePixelRatio);
+        cache.image.fill(Qt::transparent);
+        cache.dirtyRectangles.assign(1, pageRect);
+    }
+
+    if (!cache.dirtyRectangles.empty())
+    {
+        // Render again only areas painted by changed elements
+        const QTransform imageMatrix = cache.matrix * QTransform::fromTranslate(-cache.deviceRect.left(), -cache.deviceRect.top());
+        const QRect imageRect(QPoint(0, 0), cache.deviceRect.size());
+
+        QRegion dirtyRegion;
+        if (cache.dirtyRectangles.size() > MAX_DIRTY_RECTANGLES)
+        {
+            dirtyRegion = imageRect;
+        }
+        else
+        {
+            for (const QRectF& dirtyRectangle : cache.dirtyRectangles)
+            {
+                // Enlarge the area by antialiased pixels
+                dirtyRegion += imageMatrix.mapRect(dirtyRectangle).toAlignedRect().adjusted(-2, -2, 2, 2).intersected(imageRect);
+            }
+        }
+        cache.dirtyRectangles.clear();
+
+        if (!dirtyRegion.isEmpty())
+        {
+            QPainter imagePainter(&cache.image);
+            imagePainter.setCompositionMode(QPainter::CompositionMode_Source);
+            for (const QRect& rect : dirtyRegion)
+            {
+                imagePainter.fillRect(rect, Qt::transparent);
+            }
+            imagePainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            imagePainter.setClipRegion(dirtyRegion);
+
+            const QRectF dirtyPageRect = imageMatrix.inverted().mapRect(QRectF(dirtyRegion.boundingRect()));
+            for (size_t index : pageElementIndex->spatialIndex.query(dirtyPageRect))
+            {
+                pageElementIndex->elements[index]->drawPage(&imagePainter, this, pageIndex, compiledPage, layoutGetter, imageMatrix, convertor, errors);
+            }
+        }
+    }
 
-        element->drawPage(painter, this, pageIndex, compiledPage, layoutGetter, pagePointToDevicePointMatrix, convertor, errors);
+    painter->drawImage(cache.deviceRect.topLeft(), cache.image);
+
+    // Do not keep images of pages, which are no longer visible
+    if (m_pageRenderCaches.size() > MAX_CACHED_PAGES && m_widget)
+    {
+        const std::vector<PDFInteger> currentPages = m_widget->getDrawWidget()->getCurrentPages();
+        for (auto it = m_pageRenderCaches.begin(); it != m_pageRenderCaches.end();)
+        {
+            if (it->first != pageIndex && std::find(currentPages.cbegin(), currentPages.cend(), it->first) == currentPages.cend())
+            {
+                it = m_pageRenderCaches.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
     }
+
+    return true;
 }
 
 void PDFPageContentScene::drawPage(QPainter* painter,
@@ -691,7 +852,10 @@ void PDFPageContentScene::drawPage(QPainter* painter,
         return;
     }
 
-    drawElements(painter, pageIndex, layoutGetter, pagePointToDevicePointMatrix, compiledPage, convertor, errors);
+    if (!drawCachedElements(painter, pageIndex, layoutGetter, pagePointToDevicePointMatrix, compiledPage, convertor, errors))
+    {
+        drawElements(painter, pageIndex, layoutGetter, pagePointToDevicePointMatrix, compiledPage, convertor, errors);
+    }
     m_manipulator.drawPage(painter, pageIndex, compiledPage, layoutGetter, pagePointToDevicePointMatrix, convertor, errors);
 }
 
@@ -714,16 +878,18 @@ PDFPageContentScene::MouseEventInfo PDFPageContentScene::getMouseEventInfo(QWidg
     result.timer = m_mouseGrabInfo.info.timer;
     result.pageIndex = m_widget->getDrawWidgetProxy()->getPageUnderPoint(point, &result.pagePos);
 
-    const PDFReal threshold = getSnapPointDistanceThreshold();
-    for (const auto& elementItem : m_elements)
+    const PageElementIndex* pageElementIndex = getPageElementIndex(result.pageIndex);
+    if (!pageElementIndex)
     {
-        PDFPageContentElement* element = elementItem.get();
+        return result;
+    }
 
-        if (element->getPageIndex() != result.pageIndex)
-        {
-            // Different page
-            continue;
-        }
+    // Test only elements near the mouse cursor
+    const PDFReal threshold = getSnapPointDistanceThreshold();
+    const QRectF hitRect(result.pagePos - QPointF(threshold, threshold), QSizeF(2.0 * threshold, 2.0 * threshold));
+    for (size_t index : pageElementIndex->spatialIndex.query(hitRect))
+    {
+        PDFPageContentElement* element = pageElementIndex->elements[index];
 
         if (element->getManipulationMode(result.pagePos, threshold) != 0)
         {
@@ -842,6 +1008,68 @@ void PDFPageContentScene::onSelectionChanged()
     Q_EMIT selectionChanged();
 }
 
+const PDFPageContentScene::PageElementIndex* PDFPageContentScene::getPageElementIndex(PDFInteger pageIndex) const
+{
+    auto it = m_pageElementIndices.find(pageIndex);
+    if (it == m_pageElementIndices.end())
+    {
+        PageElementIndex pageElementIndex;
+        std::vector<std::optional<QRectF>> paintedBoundingBoxes;
+
+        for (const auto& element : m_elements)
+        {
+            if (element->getPageIndex() == pageIndex)
+            {
+                const QRectF paintedBoundingBox = getPaintedBoundingBox(element.get());
+                pageElementIndex.elements.push_back(element.get());
+                pageElementIndex.paintedBoundingBox = pageElementIndex.paintedBoundingBox.united(paintedBoundingBox);
+                paintedBoundingBoxes.emplace_back(paintedBoundingBox);
+            }
+        }
+
+        pageElementIndex.spatialIndex.build(paintedBoundingBoxes);
+        it = m_pageElementIndices.emplace(pageIndex, qMove(pageElementIndex)).first;
+    }
+
+    return !it->second.elements.empty() ? &it->second : nullptr;
+}
+
+void PDFPageContentScene::invalidateElement(const PDFPageContentElement* element)
+{
+    const PDFInteger pageIndex = element->getPageIndex();
+    m_pageElementIndices.erase(pageIndex);
+
+    auto it = m_pageRenderCaches.find(pageIndex);
+    if (it != m_pageRenderCaches.end())
+    {
+        it->second.dirtyRectangles.push_back(getPaintedBoundingBox(element));
+    }
+}
+
+QRectF PDFPageContentScene::getPaintedBoundingBox(const PDFPageContentElement* element)
+{
+    PDFReal strokeWidth = 0.0;
+    PDFReal miterLimit = 2.0;
+
+    if (const PDFPageContentStyledElement* styledElement = dynamic_cast<const PDFPageContentStyledElement*>(element))
+    {
+        strokeWidth = styledElement->getPen().widthF();
+        miterLimit = styledElement->getPen().miterLimit();
+    }
+    else if (const PDFPageContentElementEdited* editedElement = element->asElementEdited())
+    {
+        const PDFEditedPageContentElement* contentElement = editedElement->getElement();
+        const PDFPageContentProcessorState& state = contentElement->getState();
+        strokeWidth = state.getLineWidth() * qSqrt(qAbs(contentElement->getTransform().determinant()));
+        miterLimit = state.getMitterLimit();
+    }
+
+    // Stroke can exceed the outline by half of the stroke width, miter
+    // joins by half of the stroke width multiplied by miter limit.
+    const PDFReal margin = 0.5 * strokeWidth * qMax(miterLimit, 2.0);
+    return element->getBoundingBox().adjusted(-margin, -margin, margin, margin);
+}
+
 void PDFPageContentScene::setIsPageContentDrawSuppressed(bool newIsPageContentDrawSuppressed)
 {
     m_isPageContentDrawSuppressed = newIsPageContentDrawSuppressed;
@@ -872,6 +1100,7 @@ void PDFPageContentScene::setActive(bool newIsActive)
         {
             m_mouseGrabInfo = MouseGrabInfo();
             m_manipulator.reset();
+            m_pageRenderCaches.clear();
         }
 
         Q_EMIT sceneChanged(false);
@@ -934,9 +1163,9 @@ QRectF PDFPageContentScene::getBoundingBox(PDFInteger pageIndex) const
 {
     QRectF rect;
 
-    for (const auto& element : m_elements)
+    if (const PageElementIndex* pageElementIndex = getPageElementIndex(pageIndex))
     {
-        if (element->getPageIndex() == pageIndex)
+        for (const PDFPageContentElement* element : pageElementIndex->elements)
         {
             rect = rect.united(element->getBoundingBox());
         }
@@ -952,8 +1181,18 @@ void PDFPageContentScene::setSelectedElementIds(const std::set<PDFInteger>& sele
 
 void PDFPageContentScene::removeElementsById(const std::vector<PDFInteger>& selection)
 {
+    for (const PDFInteger id : selection)
+    {
+        auto it = m_elementsById.find(id);
+        if (it != m_elementsById.end())
+        {
+            invalidateElement(it->second);
+            m_elementsById.erase(it);
+        }
+    }
+
     const size_t oldSize = m_elements.size();
-    m_elements.erase(std::remove_if(m_elements.begin(), m_elements.end(), [&selection](const auto& element){ return std::find(selection.cbegin(), selection.cend(), element->getElementId()) != selection.cend(); }), m_elements.end());
+    m_elements.erase(std::remove_if(m_elements.begin(), m_elements.end(), [this](const auto& element){ return !m_elementsById.count(element->getElementId()); }), m_elements.end());
     const size_t newSize = m_elements.size();
 
     if (newSize < oldSize)
@@ -20,15 +20,19 @@
 
 #include "pdfwidgetsglobal.h"
 #include "pdfdocumentdrawinterface.h"
+#include "pdfcolorconvertor.h"
+#include "pdfutils.h"
 
 #include <QPen>
 #include <QFont>
 #include <QBrush>
+#include <QImage>
 #include <QCursor>
 #include <QPainterPath>
 #include <QElapsedTimer>
 
 #include <set>
+#include <map>
 
 class QSvgRenderer;
 
@@ -692,11 +696,75 @@ private:
     /// Reaction on selection changed
     void onSelectionChanged();
 
+    /// Elements of the page in drawing order with spatial index
+    /// of the areas painted by the elements
+    struct PageElementIndex
+    {
+        std::vector<PDFPageContentElement*> elements;
+        PDFSpatialIndex spatialIndex;
+        QRectF paintedBoundingBox;
+    };
+
+    /// Elements of the page rendered into the image in device pixels. Image is
+    /// valid for the page to device matrix, translation of the matrix by whole
+    /// pixels (scrolling) doesn't invalidate the image. When elements are changed,
+    /// only areas painted by changed elements are rendered again.
+    struct PageRenderCache
+    {
+        QTransform matrix;
+        QRect deviceRect;
+        QRectF pageRect;
+        qreal devicePixelRatio = 1.0;
+        PDFColorConvertor convertor;
+        QImage image;
+        std::vector<QRectF> dirtyRectangles;
+    };
+
+    /// Maximal count of pixels of the cached image of the page. If elements
+    /// of the page are zoomed to larger image, they are drawn directly.
+    static constexpr qint64 MAX_CACHED_IMAGE_PIXELS = 4096 * 4096;
+
+    /// Maximal count of dirty areas of the cached image, if there are
+    /// more dirty areas, whole image is rendered again.
+    static constexpr size_t MAX_DIRTY_RECTANGLES = 64;
+
+    /// Count of cached images of pages, above which images
+    /// of pages, which are not visible, are removed.
+    static constexpr size_t MAX_CACHED_PAGES = 4;
+
+    /// Returns index of elements of the page, index is built, if it
+    /// doesn't exist. If page doesn't have any element, nullptr is returned.
+    /// \param pageIndex Page index
+    const PageElementIndex* getPageElementIndex(PDFInteger pageIndex) const;
+
+    /// Invalidates index of the page of the element and marks area
+    /// painted by the element as dirty in the cached image of the page.
+    /// \param element Element
+    void invalidateElement(const PDFPageContentElement* element);
+
+    /// Returns bounding box of the area painted by the element (bounding box
+    /// of the element enlarged by the width of the stroke)
+    /// \param element Element
+    static QRectF getPaintedBoundingBox(const PDFPageContentElement* element);
+
+    /// Draws elements of the page using cached image. Returns false, if
+    /// cached image can't be used, and elements must be drawn directly.
+    bool drawCachedElements(QPainter* painter,
+                            PDFInteger pageIndex,
+                            PDFTextLayoutGetter& layoutGetter,
+                            const QTransform& pagePointToDevicePointMatrix,
+                            const PDFPrecompiledPage* compiledPage,
+                            const PDFColorConvertor& convertor,
+                            QList<PDFRenderError>& errors) const;
+
     PDFInteger m_firstFreeId;
     bool m_isActive;
     bool m_isPageContentDrawSuppressed;
     PDFWidget* m_widget;
     std::vector<std::unique_ptr<PDFPageContentElement>> m_elements;
+    std::map<PDFInteger, PDFPageContentElement*> m_elementsById;
+    mutable std::map<PDFInteger, PageElementIndex> m_pageElementIndices;
+    mutable std::map<PDFInteger, PageRenderCache> m_pageRenderCaches;
     std::optional<QCursor> m_cursor;
     PDFPageContentElementManipulator m_manipulator;
     MouseGrabInfo m_mouseGrabInfo;
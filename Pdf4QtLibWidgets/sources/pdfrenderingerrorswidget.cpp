@@ -20,6 +20,11 @@
 #include "ui_pdfrenderingerrorswidget.h"
 
 #include "pdfwidgetutils.h"
+#include "pdfinstrumentation.h"
+
+#include <QClipboard>
+#include <QGuiApplication>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -83,7 +88,13 @@ PDFRenderingErrorsWidget::PDFRenderingErrorsWidget(QWidget* parent, PDFWidget* p
                 }
             }
 
-            new QTreeWidgetItem(root, QStringList() << QString() << typeString << error.message);
+            QString message = error.getMessage();
+            if (error.count > 1)
+            {
+                message = tr("%1 (%2 times)").arg(message).arg(error.count);
+            }
+
+            new QTreeWidgetItem(root, QStringList() << QString() << typeString << message);
         }
 
         bool isCurrentPage = std::binary_search(currentPages.cbegin(), currentPages.cend(), pageIndex);
@@ -100,6 +111,13 @@ PDFRenderingErrorsWidget::PDFRenderingErrorsWidget(QWidget* parent, PDFWidget* p
         ui->renderErrorsTreeWidget->scrollToItem(scrollToItem, QAbstractItemView::EnsureVisible);
     }
 
+    // Rendering stage statistics are collected from all pages rendered
+    // while collecting is enabled, statistics can be copied as JSON.
+    ui->collectStatisticsCheckBox->setChecked(PDFInstrumentation::isEnabled());
+    connect(ui->collectStatisticsCheckBox, &QCheckBox::toggled, this, &PDFInstrumentation::setEnabled);
+    connect(ui->clearStatisticsButton, &QPushButton::clicked, this, &PDFInstrumentation::clear);
+    connect(ui->copyStatisticsButton, &QPushButton::clicked, this, []() { QGuiApplication::clipboard()->setText(QString::fromUtf8(PDFInstrumentation::toJson())); });
+
     pdf::PDFWidgetUtils::style(this);
 }
 
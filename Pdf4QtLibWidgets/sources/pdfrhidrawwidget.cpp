@@ -0,0 +1,635 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfrhidrawwidget.h"
+#include "pdfpainter.h"
+
+#include <QFile>
+#include <QPainter>
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+void PDFRhiPageRenderer::initialize(QRhi* rhi, QRhiRenderPassDescriptor* renderPassDescriptor, int sampleCount)
+{
+    if (m_rhi != rhi)
+    {
+        release();
+        m_rhi = rhi;
+
+        if (!m_rhi)
+        {
+            return;
+        }
+
+        m_vertexShader = loadShader(QLatin1String(":/shaders/pdfrhi.vert.qsb"));
+        m_colorFragmentShader = loadShader(QLatin1String(":/shaders/pdfrhicolor.frag.qsb"));
+        m_textureFragmentShader = loadShader(QLatin1String(":/shaders/pdfrhitexture.frag.qsb"));
+
+        m_sampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+        m_sampler->create();
+
+        // Tiling pattern cell images are repeated
+        m_repeatSampler.reset(m_rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::Repeat, QRhiSampler::Repeat));
+        m_repeatSampler->create();
+
+        m_overlayUniformBuffer.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, UNIFORM_BUFFER_SIZE));
+        m_overlayUniformBuffer->create();
+
+        m_overlayVertexBuffer.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, 6 * sizeof(Vertex)));
+        m_overlayVertexBuffer->create();
+
+        m_overlayTexture.reset(m_rhi->newTexture(QRhiTexture::RGBA8, QSize(1, 1)));
+        m_overlayTexture->create();
+        m_overlayBindings = createTextureBindings(m_overlayUniformBuffer.get(), m_overlayTexture.get(), m_sampler.get());
+
+        m_colorLayoutBindings.reset(m_rhi->newShaderResourceBindings());
+        m_colorLayoutBindings->setBindings({ QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, m_overlayUniformBuffer.get()) });
+        m_colorLayoutBindings->create();
+    }
+
+    if (m_renderPassDescriptor != renderPassDescriptor || m_sampleCount != sampleCount)
+    {
+        m_renderPassDescriptor = renderPassDescriptor;
+        m_sampleCount = sampleCount;
+        createPipelines();
+    }
+}
+
+void PDFRhiPageRenderer::release()
+{
+    m_pages.clear();
+
+    for (std::unique_ptr<QRhiGraphicsPipeline>& pipeline : m_pipelines)
+    {
+        pipeline.reset();
+    }
+
+    m_colorLayoutBindings.reset();
+    m_overlayBindings.reset();
+    m_overlayTexture.reset();
+    m_overlayVertexBuffer.reset();
+    m_overlayUniformBuffer.reset();
+    m_sampler.reset();
+    m_repeatSampler.reset();
+
+    m_rhi = nullptr;
+    m_renderPassDescriptor = nullptr;
+    m_sampleCount = 1;
+}
+
+void PDFRhiPageRenderer::render(QRhiCommandBuffer* commandBuffer,
+                                QRhiRenderTarget* renderTarget,
+                                const PageContentItems& items,
+                                const QImage& overlay,
+                                QSizeF logicalSize)
+{
+    Q_ASSERT(m_rhi);
+
+    ++m_frame;
+    QRhiResourceUpdateBatch* resourceUpdates = m_rhi->nextResourceUpdateBatch();
+
+    QMatrix4x4 projection = m_rhi->clipSpaceCorrMatrix();
+    projection.ortho(0.0f, float(logicalSize.width()), float(logicalSize.height()), 0.0f, -1.0f, 1.0f);
+
+    auto writeQuad = [](Vertex* vertices, const QPolygonF& polygon, const std::array<quint8, 4>& color, bool isTextured)
+    {
+        // Polygon of the rectangle contains five points (last point is the first one)
+        constexpr std::array<int, 6> indices = { 0, 1, 2, 0, 2, 3 };
+        constexpr std::array<QPointF, 4> texCoords = { QPointF(0.0, 0.0), QPointF(1.0, 0.0), QPointF(1.0, 1.0), QPointF(0.0, 1.0) };
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            const int index = indices[i];
+            Vertex& vertex = vertices[i];
+            vertex.x = float(polygon[index].x());
+            vertex.y = float(polygon[index].y());
+            vertex.u = isTextured ? float(texCoords[index].x()) : 0.0f;
+            vertex.v = isTextured ? float(texCoords[index].y()) : 0.0f;
+            vertex.color = color;
+        }
+    };
+
+    auto writeUniforms = [resourceUpdates](QRhiBuffer* buffer, const QMatrix4x4& matrix, PDFReal opacity)
+    {
+        std::array<float, UNIFORM_BUFFER_SIZE / sizeof(float)> data = { };
+        std::copy(matrix.constData(), matrix.constData() + 16, data.begin());
+        data[16] = float(opacity);
+        resourceUpdates->updateDynamicBuffer(buffer, 0, UNIFORM_BUFFER_SIZE, data.data());
+    };
+
+    std::vector<const PageResources*> pageResources;
+    pageResources.reserve(items.size());
+
+    for (const PDFDrawWidgetProxy::PageContentItem& item : items)
+    {
+        PageResources* resources = getPageResources(item, resourceUpdates);
+        pageResources.push_back(resources);
+
+        if (!resources)
+        {
+            continue;
+        }
+
+        resources->lastFrame = m_frame;
+        writeUniforms(resources->uniformBuffer.get(), projection * QMatrix4x4(item.pagePointToDevicePointMatrix), item.opacity);
+
+        // Frame geometry is in page space, because it uses page's matrix
+        const QPolygonF pagePolygon = item.pagePointToDevicePointMatrix.inverted().map(QPolygonF(QRectF(item.placedRect)));
+        std::array<quint8, 4> paperColor = { };
+        if (item.paperColor.isValid())
+        {
+            paperColor = { quint8(item.paperColor.red()), quint8(item.paperColor.green()), quint8(item.paperColor.blue()), 255 };
+        }
+
+        std::array<Vertex, FRAME_VERTEX_COUNT> frameVertices;
+        writeQuad(frameVertices.data() + PAPER_QUAD_FIRST_VERTEX, pagePolygon, paperColor, false);
+        writeQuad(frameVertices.data() + TRANSPARENT_QUAD_FIRST_VERTEX, pagePolygon, { }, false);
+        resourceUpdates->updateDynamicBuffer(resources->frameVertexBuffer.get(), 0, quint32(sizeof(frameVertices)), frameVertices.data());
+    }
+
+    const bool isOverlayDrawn = !overlay.isNull();
+    if (isOverlayDrawn)
+    {
+        if (m_overlayTexture->pixelSize() != overlay.size())
+        {
+            m_overlayTexture->setPixelSize(overlay.size());
+            m_overlayTexture->create();
+        }
+
+        resourceUpdates->uploadTexture(m_overlayTexture.get(), overlay);
+        writeUniforms(m_overlayUniformBuffer.get(), projection, 1.0);
+
+        std::array<Vertex, 6> overlayVertices;
+        writeQuad(overlayVertices.data(), QPolygonF(QRectF(QPointF(0.0, 0.0), logicalSize)), { 255, 255, 255, 255 }, true);
+        resourceUpdates->updateDynamicBuffer(m_overlayVertexBuffer.get(), 0, quint32(sizeof(overlayVertices)), overlayVertices.data());
+    }
+
+    const QSize pixelSize = renderTarget->pixelSize();
+    commandBuffer->beginPass(renderTarget, QColor(Qt::lightGray), { 1.0f, 0 }, resourceUpdates);
+    commandBuffer->setViewport(QRhiViewport(0, 0, float(pixelSize.width()), float(pixelSize.height())));
+
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (pageResources[i])
+        {
+            drawPage(commandBuffer, *pageResources[i], items[i]);
+        }
+    }
+
+    if (isOverlayDrawn)
+    {
+        draw(commandBuffer, Pipeline::Overlay, m_overlayBindings.get(), m_overlayVertexBuffer.get(), 0, 6, 0);
+    }
+
+    commandBuffer->endPass();
+
+    removeUnusedPages();
+}
+
+PDFRhiPageRenderer::PageResources* PDFRhiPageRenderer::getPageResources(const PDFDrawWidgetProxy::PageContentItem& item, QRhiResourceUpdateBatch* resourceUpdates)
+{
+    std::unique_ptr<PageResources>& resources = m_pages[item.pageIndex];
+
+    if (!resources)
+    {
+        resources = std::make_unique<PageResources>();
+
+        resources->uniformBuffer.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, UNIFORM_BUFFER_SIZE));
+        resources->frameVertexBuffer.reset(m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, FRAME_VERTEX_COUNT * sizeof(Vertex)));
+
+        if (!resources->uniformBuffer->create() || !resources->frameVertexBuffer->create())
+        {
+            m_pages.erase(item.pageIndex);
+            return nullptr;
+        }
+
+        resources->colorBindings.reset(m_rhi->newShaderResourceBindings());
+        resources->colorBindings->setBindings({ QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, resources->uniformBuffer.get()) });
+        resources->colorBindings->create();
+    }
+
+    // Page is tessellated only, if it has been changed (recompiled), or visibility
+    // of its optional content has been changed. Page, which is not compiled yet,
+    // uses old geometry, if it exists.
+    if (item.compiledPage && (resources->compiledPage.lock() != item.compiledPage || resources->optionalContentVisibility != item.optionalContentVisibility))
+    {
+        uploadPageGeometry(resources.get(), item.compiledPage.get(), item.optionalContentVisibility, resourceUpdates);
+        resources->compiledPage = item.compiledPage;
+        resources->optionalContentVisibility = item.optionalContentVisibility;
+    }
+
+    return resources.get();
+}
+
+void PDFRhiPageRenderer::uploadPageGeometry(PageResources* resources,
+                                            const PDFPrecompiledPage* compiledPage,
+                                            const std::vector<bool>& optionalContentVisibility,
+                                            QRhiResourceUpdateBatch* resourceUpdates)
+{
+    resources->commands.clear();
+    resources->vertexBuffer.reset();
+    resources->imageBindings.clear();
+    resources->textures.clear();
+
+    PDFGpuPageGeometry geometry = PDFGpuPageGeometry::createGeometry(*compiledPage, optionalContentVisibility);
+    const std::vector<Vertex>& vertices = geometry.getVertices();
+
+    if (geometry.isEmpty() || vertices.empty())
+    {
+        return;
+    }
+
+    resources->vertexBuffer.reset(m_rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, quint32(vertices.size() * sizeof(Vertex))));
+    if (!resources->vertexBuffer->create())
+    {
+        resources->vertexBuffer.reset();
+        return;
+    }
+    resourceUpdates->uploadStaticBuffer(resources->vertexBuffer.get(), vertices.data());
+
+    // Images of texture cover commands are repeated
+    const std::vector<QImage>& images = geometry.getImages();
+    std::vector<bool> isImageRepeated(images.size(), false);
+    for (const PDFGpuPageGeometry::Command& command : geometry.getCommands())
+    {
+        if (command.type == PDFGpuPageGeometry::CommandType::TextureCover && command.imageIndex < images.size())
+        {
+            isImageRepeated[command.imageIndex] = true;
+        }
+    }
+
+    const int maximalTextureSize = m_rhi->resourceLimit(QRhi::TextureSizeMax);
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        QImage image = images[i];
+        if (image.width() > maximalTextureSize || image.height() > maximalTextureSize)
+        {
+            image = image.scaled(maximalTextureSize, maximalTextureSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        image.convertTo(QImage::Format_RGBA8888_Premultiplied);
+
+        std::unique_ptr<QRhiTexture> texture(m_rhi->newTexture(QRhiTexture::RGBA8, image.size()));
+        if (texture->create())
+        {
+            resourceUpdates->uploadTexture(texture.get(), image);
+            QRhiSampler* sampler = isImageRepeated[i] ? m_repeatSampler.get() : m_sampler.get();
+            resources->imageBindings.push_back(createTextureBindings(resources->uniformBuffer.get(), texture.get(), sampler));
+        }
+        else
+        {
+            // Image will not be drawn
+            resources->imageBindings.push_back(nullptr);
+        }
+
+        resources->textures.push_back(qMove(texture));
+    }
+
+    resources->commands = geometry.getCommands();
+}
+
+void PDFRhiPageRenderer::removeUnusedPages()
+{
+    size_t unusedPageCount = 0;
+    for (const auto& page : m_pages)
+    {
+        if (page.second->lastFrame != m_frame)
+        {
+            ++unusedPageCount;
+        }
+    }
+
+    while (unusedPageCount > MAXIMAL_CACHED_PAGE_COUNT)
+    {
+        auto it = std::min_element(m_pages.begin(), m_pages.end(), [](const auto& l, const auto& r) { return l.second->lastFrame < r.second->lastFrame; });
+        m_pages.erase(it);
+        --unusedPageCount;
+    }
+}
+
+void PDFRhiPageRenderer::drawPage(QRhiCommandBuffer* commandBuffer, const PageResources& resources, const PDFDrawWidgetProxy::PageContentItem& item)
+{
+    QRhiShaderResourceBindings* colorBindings = resources.colorBindings.get();
+    QRhiBuffer* frameBuffer = resources.frameVertexBuffer.get();
+
+    // Draw paper and set clip mask to the page rectangle
+    draw(commandBuffer, Pipeline::ClipReset, colorBindings, frameBuffer, PAPER_QUAD_FIRST_VERTEX, 6, STENCIL_CLIP_MASK);
+
+    if (resources.vertexBuffer && !item.isContentDrawSuppressed)
+    {
+        QRhiBuffer* vertexBuffer = resources.vertexBuffer.get();
+
+        for (const PDFGpuPageGeometry::Command& command : resources.commands)
+        {
+            const bool isEvenOdd = command.fillRule == Qt::OddEvenFill;
+
+            switch (command.type)
+            {
+                case PDFGpuPageGeometry::CommandType::Stencil:
+                    draw(commandBuffer, isEvenOdd ? Pipeline::StencilEvenOdd : Pipeline::StencilNonZero, colorBindings, vertexBuffer, command.firstVertex, command.vertexCount, STENCIL_CLIP_MASK);
+                    break;
+
+                case PDFGpuPageGeometry::CommandType::Cover:
+                    draw(commandBuffer, isEvenOdd ? Pipeline::CoverEvenOdd : Pipeline::CoverNonZero, colorBindings, vertexBuffer, command.firstVertex, command.vertexCount, 0);
+                    break;
+
+                case PDFGpuPageGeometry::CommandType::TextureCover:
+                {
+                    if (command.imageIndex < resources.imageBindings.size())
+                    {
+                        draw(commandBuffer, isEvenOdd ? Pipeline::TextureCoverEvenOdd : Pipeline::TextureCoverNonZero, resources.imageBindings[command.imageIndex].get(), vertexBuffer, command.firstVertex, command.vertexCount, 0);
+                    }
+                    break;
+                }
+
+                case PDFGpuPageGeometry::CommandType::ClipIntersect:
+                    draw(commandBuffer, isEvenOdd ? Pipeline::ClipIntersectEvenOdd : Pipeline::ClipIntersectNonZero, colorBindings, frameBuffer, TRANSPARENT_QUAD_FIRST_VERTEX, 6, 0);
+                    draw(commandBuffer, Pipeline::ClearWinding, colorBindings, frameBuffer, TRANSPARENT_QUAD_FIRST_VERTEX, 6, 0);
+                    break;
+
+                case PDFGpuPageGeometry::CommandType::ClipReset:
+                    draw(commandBuffer, Pipeline::ClipReset, colorBindings, frameBuffer, TRANSPARENT_QUAD_FIRST_VERTEX, 6, STENCIL_CLIP_MASK);
+                    break;
+
+                case PDFGpuPageGeometry::CommandType::Triangles:
+                    draw(commandBuffer, Pipeline::Triangles, colorBindings, vertexBuffer, command.firstVertex, command.vertexCount, STENCIL_CLIP_MASK);
+                    break;
+
+                case PDFGpuPageGeometry::CommandType::Image:
+                {
+                    if (command.imageIndex < resources.imageBindings.size())
+                    {
+                        draw(commandBuffer, Pipeline::Image, resources.imageBindings[command.imageIndex].get(), vertexBuffer, command.firstVertex, command.vertexCount, STENCIL_CLIP_MASK);
+                    }
+                    break;
+                }
+
+                default:
+                    Q_ASSERT(false);
+                    break;
+            }
+        }
+    }
+
+    // Clear the stencil, so next pages are not affected
+    draw(commandBuffer, Pipeline::ClipReset, colorBindings, frameBuffer, TRANSPARENT_QUAD_FIRST_VERTEX, 6, 0);
+}
+
+void PDFRhiPageRenderer::draw(QRhiCommandBuffer* commandBuffer,
+                              Pipeline pipeline,
+                              QRhiShaderResourceBindings* bindings,
+                              QRhiBuffer* vertexBuffer,
+                              quint32 firstVertex,
+                              quint32 vertexCount,
+                              quint32 stencilReference)
+{
+    QRhiGraphicsPipeline* graphicsPipeline = m_pipelines[size_t(pipeline)].get();
+    if (!graphicsPipeline || !bindings || vertexCount == 0)
+    {
+        return;
+    }
+
+    const QRhiCommandBuffer::VertexInput vertexInput(vertexBuffer, 0);
+
+    commandBuffer->setGraphicsPipeline(graphicsPipeline);
+    commandBuffer->setShaderResources(bindings);
+    commandBuffer->setVertexInput(0, 1, &vertexInput);
+    commandBuffer->setStencilRef(stencilReference);
+    commandBuffer->draw(vertexCount, 1, firstVertex, 0);
+}
+
+void PDFRhiPageRenderer::createPipelines()
+{
+    for (size_t i = 0; i < m_pipelines.size(); ++i)
+    {
+        m_pipelines[i] = createPipeline(Pipeline(i));
+    }
+}
+
+std::unique_ptr<QRhiGraphicsPipeline> PDFRhiPageRenderer::createPipeline(Pipeline pipeline) const
+{
+    if (!m_rhi || !m_renderPassDescriptor || !m_vertexShader.isValid() || !m_colorFragmentShader.isValid() || !m_textureFragmentShader.isValid())
+    {
+        return nullptr;
+    }
+
+    using StencilOpState = QRhiGraphicsPipeline::StencilOpState;
+
+    bool isTextured = false;
+    bool isColorWritten = true;
+    bool isStencilUsed = true;
+    StencilOpState front = { QRhiGraphicsPipeline::Keep, QRhiGraphicsPipeline::Keep, QRhiGraphicsPipeline::Keep, QRhiGraphicsPipeline::Equal };
+    StencilOpState back = front;
+    quint32 readMask = STENCIL_CLIP_MASK;
+    quint32 writeMask = 0;
+
+    switch (pipeline)
+    {
+        case Pipeline::StencilNonZero:
+            // Front faces increment and back faces decrement winding number, inside clip mask
+            isColorWritten = false;
+            front.passOp = QRhiGraphicsPipeline::IncrementAndWrap;
+            back.passOp = QRhiGraphicsPipeline::DecrementAndWrap;
+            writeMask = STENCIL_WINDING_MASK;
+            break;
+
+        case Pipeline::StencilEvenOdd:
+            isColorWritten = false;
+            front.passOp = QRhiGraphicsPipeline::Invert;
+            back.passOp = QRhiGraphicsPipeline::Invert;
+            writeMask = STENCIL_PARITY_MASK;
+            break;
+
+        case Pipeline::CoverNonZero:
+        case Pipeline::CoverEvenOdd:
+        case Pipeline::TextureCoverNonZero:
+        case Pipeline::TextureCoverEvenOdd:
+            // Paint, where winding number is nonzero, and reset the winding number
+            isTextured = pipeline == Pipeline::TextureCoverNonZero || pipeline == Pipeline::TextureCoverEvenOdd;
+            front.compareOp = QRhiGraphicsPipeline::NotEqual;
+            front.passOp = QRhiGraphicsPipeline::StencilZero;
+            back = front;
+            readMask = (pipeline == Pipeline::CoverEvenOdd || pipeline == Pipeline::TextureCoverEvenOdd) ? STENCIL_PARITY_MASK : STENCIL_WINDING_MASK;
+            writeMask = STENCIL_WINDING_MASK;
+            break;
+
+        case Pipeline::ClipIntersectNonZero:
+        case Pipeline::ClipIntersectEvenOdd:
+            // Clear clip mask, where winding number is zero
+            isColorWritten = false;
+            front.passOp = QRhiGraphicsPipeline::StencilZero;
+            back = front;
+            readMask = pipeline == Pipeline::ClipIntersectEvenOdd ? STENCIL_PARITY_MASK : STENCIL_WINDING_MASK;
+            writeMask = 0xFF;
+            break;
+
+        case Pipeline::ClearWinding:
+            isColorWritten = false;
+            front.compareOp = QRhiGraphicsPipeline::Always;
+            front.passOp = QRhiGraphicsPipeline::StencilZero;
+            back = front;
+            writeMask = STENCIL_WINDING_MASK;
+            break;
+
+        case Pipeline::ClipReset:
+            front.compareOp = QRhiGraphicsPipeline::Always;
+            front.passOp = QRhiGraphicsPipeline::Replace;
+            back = front;
+            writeMask = 0xFF;
+            break;
+
+        case Pipeline::Triangles:
+            break;
+
+        case Pipeline::Image:
+            isTextured = true;
+            break;
+
+        case Pipeline::Overlay:
+            isTextured = true;
+            isStencilUsed = false;
+            break;
+
+        default:
+            Q_ASSERT(false);
+            return nullptr;
+    }
+
+    std::unique_ptr<QRhiGraphicsPipeline> graphicsPipeline(m_rhi->newGraphicsPipeline());
+
+    // Premultiplied alpha blending
+    QRhiGraphicsPipeline::TargetBlend blend;
+    blend.enable = isColorWritten;
+    blend.srcColor = QRhiGraphicsPipeline::One;
+    blend.dstColor = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+    blend.srcAlpha = QRhiGraphicsPipeline::One;
+    blend.dstAlpha = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+    if (!isColorWritten)
+    {
+        blend.colorWrite = QRhiGraphicsPipeline::ColorMask();
+    }
+
+    graphicsPipeline->setTargetBlends({ blend });
+    graphicsPipeline->setCullMode(QRhiGraphicsPipeline::None);
+    graphicsPipeline->setDepthTest(false);
+    graphicsPipeline->setDepthWrite(false);
+    graphicsPipeline->setSampleCount(m_sampleCount);
+
+    if (isStencilUsed)
+    {
+        graphicsPipeline->setFlags(QRhiGraphicsPipeline::UsesStencilRef);
+        graphicsPipeline->setStencilTest(true);
+        graphicsPipeline->setStencilFront(front);
+        graphicsPipeline->setStencilBack(back);
+        graphicsPipeline->setStencilReadMask(readMask);
+        graphicsPipeline->setStencilWriteMask(writeMask);
+    }
+
+    graphicsPipeline->setShaderStages({ { QRhiShaderStage::Vertex, m_vertexShader },
+                                        { QRhiShaderStage::Fragment, isTextured ? m_textureFragmentShader : m_colorFragmentShader } });
+
+    QRhiVertexInputLayout inputLayout;
+    inputLayout.setBindings({ { quint32(sizeof(Vertex)) } });
+    inputLayout.setAttributes({ { 0, 0, QRhiVertexInputAttribute::Float2, quint32(offsetof(Vertex, x)) },
+                                { 0, 1, QRhiVertexInputAttribute::Float2, quint32(offsetof(Vertex, u)) },
+                                { 0, 2, QRhiVertexInputAttribute::UNormByte4, quint32(offsetof(Vertex, color)) } });
+    graphicsPipeline->setVertexInputLayout(inputLayout);
+    graphicsPipeline->setShaderResourceBindings(isTextured ? m_overlayBindings.get() : m_colorLayoutBindings.get());
+    graphicsPipeline->setRenderPassDescriptor(m_renderPassDescriptor);
+
+    if (!graphicsPipeline->create())
+    {
+        return nullptr;
+    }
+
+    return graphicsPipeline;
+}
+
+std::unique_ptr<QRhiShaderResourceBindings> PDFRhiPageRenderer::createTextureBindings(QRhiBuffer* uniformBuffer, QRhiTexture* texture, QRhiSampler* sampler) const
+{
+    std::unique_ptr<QRhiShaderResourceBindings> bindings(m_rhi->newShaderResourceBindings());
+    bindings->setBindings({ QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, uniformBuffer),
+                            QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, texture, sampler) });
+
+    if (!bindings->create())
+    {
+        return nullptr;
+    }
+
+    return bindings;
+}
+
+QShader PDFRhiPageRenderer::loadShader(const QString& fileName)
+{
+    QFile file(fileName);
+    if (file.open(QFile::ReadOnly))
+    {
+        return QShader::fromSerialized(file.readAll());
+    }
+
+    return QShader();
+}
+
+PDFRhiDrawWidget::PDFRhiDrawWidget(PDFWidget* widget, QWidget* parent) :
+    BaseClass(widget, parent)
+{
+    setSampleCount(MSAA_SAMPLE_COUNT);
+}
+
+void PDFRhiDrawWidget::initialize(QRhiCommandBuffer* commandBuffer)
+{
+    Q_UNUSED(commandBuffer);
+
+    m_renderer.initialize(rhi(), renderTarget()->renderPassDescriptor(), renderTarget()->sampleCount());
+}
+
+void PDFRhiDrawWidget::render(QRhiCommandBuffer* commandBuffer)
+{
+    PDFDrawWidgetProxy* proxy = getPDFWidget()->getDrawWidgetProxy();
+    const QRect rect = this->rect();
+    const qreal devicePixelRatio = devicePixelRatioF();
+
+    PDFRhiPageRenderer::PageContentItems items = proxy->getPageContentItems(rect);
+
+    // Graphics over the pages is painted by QPainter
+    const QSize overlaySize = rect.size() * devicePixelRatio;
+    if (m_overlayImage.size() != overlaySize)
+    {
+        m_overlayImage = QImage(overlaySize, QImage::Format_RGBA8888_Premultiplied);
+    }
+    m_overlayImage.setDevicePixelRatio(devicePixelRatio);
+    m_overlayImage.fill(Qt::transparent);
+
+    {
+        QPainter painter(&m_overlayImage);
+        proxy->drawOverlay(&painter, rect);
+    }
+
+    m_renderer.render(commandBuffer, renderTarget(), items, m_overlayImage, rect.size());
+}
+
+void PDFRhiDrawWidget::releaseResources()
+{
+    m_renderer.release();
+}
+
+}   // namespace pdf
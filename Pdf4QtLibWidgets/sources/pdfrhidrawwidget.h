@@ -0,0 +1,201 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFRHIDRAWWIDGET_H
+#define PDFRHIDRAWWIDGET_H
+
+#include "pdfdrawwidget.h"
+#include "pdfdrawspacecontroller.h"
+#include "pdfgpugeometry.h"
+
+#include <QRhiWidget>
+#include <rhi/qrhi.h>
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+namespace pdf
+{
+
+/// Renders precompiled pages on the GPU using QRhi. Pages are tessellated only
+/// once (see PDFGpuPageGeometry) and uploaded into vertex buffers and textures.
+/// Then, zooming or scrolling only redraws the geometry with different matrix.
+class PDFRhiPageRenderer
+{
+public:
+    explicit PDFRhiPageRenderer() = default;
+
+    using PageContentItems = std::vector<PDFDrawWidgetProxy::PageContentItem>;
+
+    /// Initializes the renderer for given render target. Pipelines are
+    /// recreated, if render pass descriptor or sample count has changed,
+    /// all resources are recreated, if QRhi has been changed.
+    /// \param rhi Rendering hardware interface
+    /// \param renderPassDescriptor Render pass descriptor of the render target
+    /// \param sampleCount Sample count of the render target
+    void initialize(QRhi* rhi, QRhiRenderPassDescriptor* renderPassDescriptor, int sampleCount);
+
+    /// Releases all graphics resources
+    void release();
+
+    /// Renders pages and the overlay image onto the render target. Render
+    /// target must have stencil buffer.
+    /// \param commandBuffer Command buffer
+    /// \param renderTarget Render target
+    /// \param items Visible pages
+    /// \param overlay Overlay image (it is drawn over the pages)
+    /// \param logicalSize Size of render target in logical pixels
+    void render(QRhiCommandBuffer* commandBuffer,
+                QRhiRenderTarget* renderTarget,
+                const PageContentItems& items,
+                const QImage& overlay,
+                QSizeF logicalSize);
+
+    /// Maximal number of pages, which resources are kept, when they are not visible
+    static constexpr size_t MAXIMAL_CACHED_PAGE_COUNT = 32;
+
+private:
+    using Vertex = PDFGpuPageGeometry::Vertex;
+
+    /// Stencil bit used as clip mask, other bits are used for winding number
+    static constexpr quint32 STENCIL_CLIP_MASK = 0x80;
+    static constexpr quint32 STENCIL_WINDING_MASK = 0x7F;
+    static constexpr quint32 STENCIL_PARITY_MASK = 0x01;
+
+    /// Size of the uniform buffer (matrix and opacity)
+    static constexpr quint32 UNIFORM_BUFFER_SIZE = 16 * sizeof(float) + 4 * sizeof(float);
+
+    /// Number of vertices of the per-frame page geometry (paper quad and transparent quad)
+    static constexpr int FRAME_VERTEX_COUNT = 12;
+    static constexpr int PAPER_QUAD_FIRST_VERTEX = 0;
+    static constexpr int TRANSPARENT_QUAD_FIRST_VERTEX = 6;
+
+    enum class Pipeline
+    {
+        StencilNonZero,
+        StencilEvenOdd,
+        CoverNonZero,
+        CoverEvenOdd,
+        TextureCoverNonZero,
+        TextureCoverEvenOdd,
+        ClipIntersectNonZero,
+        ClipIntersectEvenOdd,
+        ClearWinding,
+        ClipReset,
+        Triangles,
+        Image,
+        Overlay,
+        LastPipeline
+    };
+
+    struct PageResources
+    {
+        std::weak_ptr<const PDFPrecompiledPage> compiledPage;
+        std::vector<bool> optionalContentVisibility;
+        std::vector<PDFGpuPageGeometry::Command> commands;
+        std::unique_ptr<QRhiBuffer> uniformBuffer;
+        std::unique_ptr<QRhiBuffer> frameVertexBuffer;
+        std::unique_ptr<QRhiBuffer> vertexBuffer;
+        std::unique_ptr<QRhiShaderResourceBindings> colorBindings;
+        std::vector<std::unique_ptr<QRhiTexture>> textures;
+        std::vector<std::unique_ptr<QRhiShaderResourceBindings>> imageBindings;
+        quint64 lastFrame = 0;
+    };
+
+    /// Returns resources of the page, creates them (or uploads page geometry), if needed
+    PageResources* getPageResources(const PDFDrawWidgetProxy::PageContentItem& item, QRhiResourceUpdateBatch* resourceUpdates);
+
+    /// Tessellates compiled page and uploads its geometry
+    void uploadPageGeometry(PageResources* resources,
+                            const PDFPrecompiledPage* compiledPage,
+                            const std::vector<bool>& optionalContentVisibility,
+                            QRhiResourceUpdateBatch* resourceUpdates);
+
+    /// Removes resources of pages, which were not drawn for the longest time
+    void removeUnusedPages();
+
+    /// Records draw commands of the page
+    void drawPage(QRhiCommandBuffer* commandBuffer, const PageResources& resources, const PDFDrawWidgetProxy::PageContentItem& item);
+
+    void draw(QRhiCommandBuffer* commandBuffer,
+              Pipeline pipeline,
+              QRhiShaderResourceBindings* bindings,
+              QRhiBuffer* vertexBuffer,
+              quint32 firstVertex,
+              quint32 vertexCount,
+              quint32 stencilReference);
+
+    void createPipelines();
+
+    std::unique_ptr<QRhiGraphicsPipeline> createPipeline(Pipeline pipeline) const;
+
+    std::unique_ptr<QRhiShaderResourceBindings> createTextureBindings(QRhiBuffer* uniformBuffer, QRhiTexture* texture, QRhiSampler* sampler) const;
+
+    static QShader loadShader(const QString& fileName);
+
+    QRhi* m_rhi = nullptr;
+    QRhiRenderPassDescriptor* m_renderPassDescriptor = nullptr;
+    int m_sampleCount = 1;
+    quint64 m_frame = 0;
+    QShader m_vertexShader;
+    QShader m_colorFragmentShader;
+    QShader m_textureFragmentShader;
+    std::unique_ptr<QRhiSampler> m_sampler;
+    std::unique_ptr<QRhiSampler> m_repeatSampler;
+    std::unique_ptr<QRhiBuffer> m_overlayUniformBuffer;
+    std::unique_ptr<QRhiBuffer> m_overlayVertexBuffer;
+    std::unique_ptr<QRhiTexture> m_overlayTexture;
+    std::unique_ptr<QRhiShaderResourceBindings> m_overlayBindings;
+    std::unique_ptr<QRhiShaderResourceBindings> m_colorLayoutBindings;
+    std::array<std::unique_ptr<QRhiGraphicsPipeline>, size_t(Pipeline::LastPipeline)> m_pipelines;
+    std::unordered_map<PDFInteger, std::unique_ptr<PageResources>> m_pages;
+};
+
+/// Draw widget, which paints page contents on the GPU using QRhi. Graphics
+/// over the pages (annotations, tools, ...) is painted by QPainter into the
+/// overlay image, which is composited over the pages.
+class PDFRhiDrawWidget : public PDFDrawWidgetBase<QRhiWidget>
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = PDFDrawWidgetBase<QRhiWidget>;
+
+public:
+    explicit PDFRhiDrawWidget(PDFWidget* widget, QWidget* parent);
+    virtual ~PDFRhiDrawWidget() override = default;
+
+    /// Sample count used for antialiasing
+    static constexpr int MSAA_SAMPLE_COUNT = 4;
+
+protected:
+    virtual void initialize(QRhiCommandBuffer* commandBuffer) override;
+    virtual void render(QRhiCommandBuffer* commandBuffer) override;
+    virtual void releaseResources() override;
+
+private:
+    PDFRhiPageRenderer m_renderer;
+    QImage m_overlayImage;
+};
+
+extern template class PDFDrawWidgetBase<QRhiWidget>;
+
+}   // namespace pdf
+
+#endif // PDFRHIDRAWWIDGET_H
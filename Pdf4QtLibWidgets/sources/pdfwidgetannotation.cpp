@@ -35,6 +35,9 @@
 #include <QLabel>
 #include <QStyleOptionButton>
 
+#include <numeric>
+#include <algorithm>
+
 namespace pdf
 {
 
@@ -196,18 +199,52 @@ void PDFWidgetAnnotationManager::updateFromMouseEvent(QMouseEvent* event)
 
     m_tooltip = QString();
     m_cursor = std::nullopt;
-    bool appearanceChanged = false;
+    QRectF appearanceChangedRect;
 
     // We must update appearance states, and update tooltip
     PDFWidgetSnapshot snapshot = m_proxy->getSnapshot();
     const bool isDown = event->buttons().testFlag(Qt::LeftButton);
     const PDFAppeareanceStreams::Appearance hoverAppearance = isDown ? PDFAppeareanceStreams::Appearance::Down : PDFAppeareanceStreams::Appearance::Rollover;
 
+    std::map<PDFInteger, std::vector<size_t>> hoveredAnnotations;
     for (const PDFWidgetSnapshot::SnapshotItem& snapshotItem : snapshot.items)
     {
         PageAnnotations& pageAnnotations = getPageAnnotations(snapshotItem.pageIndex);
-        for (PageAnnotation& pageAnnotation : pageAnnotations.annotations)
+
+        // Test only annotations near the mouse cursor. Annotations hovered
+        // previously are tested too, so their appearance is reset.
+        std::vector<size_t> annotationIndices;
+        bool isInvertible = false;
+        const QTransform deviceToPageMatrix = snapshotItem.pageToDeviceMatrix.inverted(&isInvertible);
+        if (isInvertible)
+        {
+            annotationIndices = pageAnnotations.spatialIndex.query(deviceToPageMatrix.map(QPointF(event->pos())));
+
+            auto it = m_hoveredAnnotations.find(snapshotItem.pageIndex);
+            if (it != m_hoveredAnnotations.cend())
+            {
+                for (size_t annotationIndex : it->second)
+                {
+                    if (annotationIndex < pageAnnotations.annotations.size())
+                    {
+                        annotationIndices.push_back(annotationIndex);
+                    }
+                }
+
+                std::sort(annotationIndices.begin(), annotationIndices.end());
+                annotationIndices.erase(std::unique(annotationIndices.begin(), annotationIndices.end()), annotationIndices.end());
+            }
+        }
+        else
         {
+            annotationIndices.resize(pageAnnotations.annotations.size());
+            std::iota(annotationIndices.begin(), annotationIndices.end(), 0);
+        }
+
+        for (size_t annotationIndex : annotationIndices)
+        {
+            PageAnnotation& pageAnnotation = pageAnnotations.annotations[annotationIndex];
+
             if (pageAnnotation.annotation->isReplyTo())
             {
                 // Annotation is reply to another annotation, do not interact with it
@@ -225,6 +262,7 @@ void PDFWidgetAnnotationManager::updateFromMouseEvent(QMouseEvent* event)
             {
                 pageAnnotation.appearance = hoverAppearance;
                 pageAnnotation.isHovered = true;
+                hoveredAnnotations[snapshotItem.pageIndex].push_back(annotationIndex);
 
                 // Generate tooltip
                 if (m_tooltip.isEmpty())
@@ -323,15 +361,17 @@ void PDFWidgetAnnotationManager::updateFromMouseEvent(QMouseEvent* event)
             {
                 // We have changed appearance - we must mark stream as dirty
                 pageAnnotation.appearanceStream.dirty();
-                appearanceChanged = true;
+                appearanceChangedRect = appearanceChangedRect.united(path.boundingRect());
             }
         }
     }
 
-    // If appearance has changed, then we must redraw the page
-    if (appearanceChanged)
+    m_hoveredAnnotations = qMove(hoveredAnnotations);
+
+    // If appearance has changed, then we must redraw the annotations
+    if (!appearanceChangedRect.isNull())
     {
-        Q_EMIT widget->getDrawWidgetProxy()->repaintNeeded();
+        widget->getDrawWidgetProxy()->repaintRect(appearanceChangedRect);
     }
 }
 
@@ -106,6 +106,7 @@ private:
     QPoint m_editableAnnotationGlobalPosition; ///< Position, where action on annotation was executed
     PDFObjectReference m_editableAnnotation;    ///< Annotation to be edited or deleted
     PDFObjectReference m_editableAnnotationPage;    ///< Page of annotation above
+    std::map<PDFInteger, std::vector<size_t>> m_hoveredAnnotations; ///< Indices of hovered annotations of pages
 };
 
 }   // namespace pdf
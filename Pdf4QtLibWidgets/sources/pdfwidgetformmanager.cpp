@@ -31,6 +31,9 @@
 #include <QClipboard>
 #include <QStyleOption>
 
+#include <numeric>
+#include <algorithm>
+
 namespace pdf
 {
 
@@ -344,6 +347,7 @@ PDFWidgetFormManager::PDFWidgetFormManager(PDFDrawWidgetProxy* proxy, QObject* p
     BaseClass(parent),
     m_annotationManager(nullptr),
     m_proxy(proxy),
+    m_isAllEditorsCreated(false),
     m_focusedEditor(nullptr)
 {
     Q_ASSERT(proxy);
@@ -359,6 +363,25 @@ void PDFWidgetFormManager::setAnnotationManager(PDFWidgetAnnotationManager* anno
     m_annotationManager = annotationManager;
 }
 
+bool PDFWidgetFormManager::repaintFormWidgetRect(const PDFFormWidget& formWidget, const QRectF& rectangle)
+{
+    const PDFDocument* document = getDocument();
+    if (!document || !rectangle.isValid())
+    {
+        return false;
+    }
+
+    const size_t pageIndex = document->getCatalog()->getPageIndexFromPageReference(formWidget.getPage());
+    if (pageIndex == PDFCatalog::INVALID_PAGE_INDEX)
+    {
+        return false;
+    }
+
+    Q_ASSERT(m_proxy);
+    m_proxy->repaintPageRect(PDFInteger(pageIndex), rectangle);
+    return true;
+}
+
 void PDFWidgetFormManager::shortcutOverrideEvent(QWidget* widget, QKeyEvent* event)
 {
     if (m_focusedEditor)
@@ -561,8 +584,44 @@ PDFWidgetFormManager::MouseEventInfo PDFWidgetFormManager::getMouseEventInfo(QWi
     for (const PDFWidgetSnapshot::SnapshotItem& snapshotItem : snapshot.items)
     {
         const PDFAnnotationManager::PageAnnotations& pageAnnotations = m_annotationManager->getPageAnnotations(snapshotItem.pageIndex);
-        for (const PDFAnnotationManager::PageAnnotation& pageAnnotation : pageAnnotations.annotations)
+
+        // Test only widget annotations near the point. Focused editor can have active
+        // rectangle larger than its annotation (for example, expanded list of combo box),
+        // so its annotation must be tested too.
+        std::vector<size_t> annotationIndices;
+        bool isInvertible = false;
+        const QTransform deviceToPageMatrix = snapshotItem.pageToDeviceMatrix.inverted(&isInvertible);
+        if (isInvertible)
+        {
+            annotationIndices = pageAnnotations.spatialIndex.query(deviceToPageMatrix.map(QPointF(point)));
+
+            if (m_focusedEditor && m_focusedEditor->getActiveEditorRectangle().isValid())
+            {
+                const PDFObjectReference focusedWidgetAnnotation = m_focusedEditor->getWidgetAnnotation();
+                for (size_t i = 0; i < pageAnnotations.annotations.size(); ++i)
+                {
+                    if (pageAnnotations.annotations[i].annotation->getSelfReference() == focusedWidgetAnnotation)
+                    {
+                        auto it = std::lower_bound(annotationIndices.begin(), annotationIndices.end(), i);
+                        if (it == annotationIndices.end() || *it != i)
+                        {
+                            annotationIndices.insert(it, i);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        else
         {
+            annotationIndices.resize(pageAnnotations.annotations.size());
+            std::iota(annotationIndices.begin(), annotationIndices.end(), 0);
+        }
+
+        for (size_t annotationIndex : annotationIndices)
+        {
+            const PDFAnnotationManager::PageAnnotation& pageAnnotation = pageAnnotations.annotations[annotationIndex];
+
             if (pageAnnotation.annotation->isReplyTo())
             {
                 // Annotation is reply to another annotation, do not interact with it
@@ -642,6 +701,9 @@ QString PDFWidgetFormManager::getTooltip() const
 
 bool PDFWidgetFormManager::focusNextPrevFormField(bool next)
 {
+    // Focus chain contains all form fields of the document
+    createAllEditors();
+
     if (m_widgetEditors.empty())
     {
         return false;
@@ -694,81 +756,146 @@ void PDFWidgetFormManager::clearEditors()
 {
     qDeleteAll(m_widgetEditors);
     m_widgetEditors.clear();
+    m_formFieldToEditor.clear();
+    m_isAllEditorsCreated = false;
 }
 
 void PDFWidgetFormManager::updateFormWidgetEditors()
 {
+    // Editors are created on demand, when their form fields are requested
     setFocusToEditor(nullptr);
     clearEditors();
+}
 
-    for (const PDFFormWidget& widget : getWidgets())
+PDFFormFieldWidgetEditor* PDFWidgetFormManager::createEditor(const PDFFormWidget& widget) const
+{
+    // We can const-cast here, editors are created lazily, when they are requested
+    PDFWidgetFormManager* formManager = const_cast<PDFWidgetFormManager*>(this);
+
+    const PDFFormField* formField = widget.getParent();
+    switch (formField->getFieldType())
     {
-        const PDFFormField* formField = widget.getParent();
-        switch (formField->getFieldType())
+        case PDFFormField::FieldType::Button:
         {
-            case PDFFormField::FieldType::Button:
+            Q_ASSERT(dynamic_cast<const PDFFormFieldButton*>(formField));
+            const PDFFormFieldButton* formFieldButton = static_cast<const PDFFormFieldButton*>(formField);
+            switch (formFieldButton->getButtonType())
             {
-                Q_ASSERT(dynamic_cast<const PDFFormFieldButton*>(formField));
-                const PDFFormFieldButton* formFieldButton = static_cast<const PDFFormFieldButton*>(formField);
-                switch (formFieldButton->getButtonType())
+                case PDFFormFieldButton::ButtonType::PushButton:
                 {
-                    case PDFFormFieldButton::ButtonType::PushButton:
-                    {
-                        m_widgetEditors.push_back(new PDFFormFieldPushButtonEditor(this, widget));
-                        break;
-                    }
-
-                    case PDFFormFieldButton::ButtonType::RadioButton:
-                    case PDFFormFieldButton::ButtonType::CheckBox:
-                    {
-                        m_widgetEditors.push_back(new PDFFormFieldCheckableButtonEditor(this, widget));
-                        break;
-                    }
+                    return new PDFFormFieldPushButtonEditor(formManager, widget);
+                }
 
-                    default:
-                        Q_ASSERT(false);
-                        break;
+                case PDFFormFieldButton::ButtonType::RadioButton:
+                case PDFFormFieldButton::ButtonType::CheckBox:
+                {
+                    return new PDFFormFieldCheckableButtonEditor(formManager, widget);
                 }
 
-                break;
+                default:
+                    Q_ASSERT(false);
+                    break;
             }
 
-            case PDFFormField::FieldType::Text:
+            break;
+        }
+
+        case PDFFormField::FieldType::Text:
+        {
+            return new PDFFormFieldTextBoxEditor(formManager, widget);
+        }
+
+        case PDFFormField::FieldType::Choice:
+        {
+            Q_ASSERT(dynamic_cast<const PDFFormFieldChoice*>(formField));
+            const PDFFormFieldChoice* formFieldChoice = static_cast<const PDFFormFieldChoice*>(formField);
+            if (formFieldChoice->isComboBox())
             {
-                m_widgetEditors.push_back(new PDFFormFieldTextBoxEditor(this, widget));
-                break;
+                return new PDFFormFieldComboBoxEditor(formManager, widget);
             }
-
-            case PDFFormField::FieldType::Choice:
+            else if (formFieldChoice->isListBox())
             {
-                Q_ASSERT(dynamic_cast<const PDFFormFieldChoice*>(formField));
-                const PDFFormFieldChoice* formFieldChoice = static_cast<const PDFFormFieldChoice*>(formField);
-                if (formFieldChoice->isComboBox())
-                {
-                    m_widgetEditors.push_back(new PDFFormFieldComboBoxEditor(this, widget));
-                }
-                else if (formFieldChoice->isListBox())
-                {
-                    m_widgetEditors.push_back(new PDFFormFieldListBoxEditor(this, widget));
-                }
-                else
-                {
-                    // Uknown field choice
-                    Q_ASSERT(false);
-                }
+                return new PDFFormFieldListBoxEditor(formManager, widget);
+            }
+            else
+            {
+                // Uknown field choice
+                Q_ASSERT(false);
+            }
 
-                break;
+            break;
+        }
+
+        case PDFFormField::FieldType::Signature:
+            // Signature fields doesn't have editor
+            break;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return nullptr;
+}
+
+void PDFWidgetFormManager::createEditors(const PDFFormField* formField) const
+{
+    PDFFormFieldWidgetEditor* formFieldEditor = nullptr;
+
+    for (const PDFFormWidget& widget : formField->getWidgets())
+    {
+        if (PDFFormFieldWidgetEditor* editor = createEditor(widget))
+        {
+            m_widgetEditors.push_back(editor);
+
+            if (!formFieldEditor)
+            {
+                formFieldEditor = editor;
             }
+        }
+    }
 
-            case PDFFormField::FieldType::Signature:
-                // Signature fields doesn't have editor
-                break;
+    m_formFieldToEditor[formField] = formFieldEditor;
+}
 
-            default:
-                Q_ASSERT(false);
-                break;
+void PDFWidgetFormManager::createAllEditors()
+{
+    if (m_isAllEditorsCreated)
+    {
+        return;
+    }
+
+    auto createFormFieldEditors = [this](const PDFFormField* formField)
+    {
+        if (!formField->getWidgets().empty() && !m_formFieldToEditor.count(formField))
+        {
+            createEditors(formField);
         }
+    };
+    apply(createFormFieldEditors);
+
+    // Editors must be in the order of the form widgets (focus chain order)
+    std::map<PDFObjectReference, PDFFormFieldWidgetEditor*> widgetToEditor;
+    for (PDFFormFieldWidgetEditor* editor : m_widgetEditors)
+    {
+        widgetToEditor[editor->getWidgetAnnotation()] = editor;
     }
+
+    std::vector<PDFFormFieldWidgetEditor*> widgetEditors;
+    widgetEditors.reserve(m_widgetEditors.size());
+    for (const PDFFormWidget& widget : getWidgets())
+    {
+        auto it = widgetToEditor.find(widget.getWidget());
+        if (it != widgetToEditor.cend())
+        {
+            widgetEditors.push_back(it->second);
+            widgetToEditor.erase(it);
+        }
+    }
+
+    Q_ASSERT(widgetToEditor.empty());
+    m_widgetEditors = qMove(widgetEditors);
+    m_isAllEditorsCreated = true;
 }
 
 void PDFWidgetFormManager::setFocusToEditor(PDFFormFieldWidgetEditor* editor)
@@ -823,15 +950,19 @@ void PDFWidgetFormManager::updateFieldValues()
 
 PDFFormFieldWidgetEditor* PDFWidgetFormManager::getEditor(const PDFFormField* formField) const
 {
-    for (PDFFormFieldWidgetEditor* editor : m_widgetEditors)
+    if (!formField)
     {
-        if (editor->getFormField() == formField)
-        {
-            return editor;
-        }
+        return nullptr;
     }
 
-    return nullptr;
+    auto it = m_formFieldToEditor.find(formField);
+    if (it == m_formFieldToEditor.cend())
+    {
+        createEditors(formField);
+        it = m_formFieldToEditor.find(formField);
+    }
+
+    return it->second;
 }
 
 PDFFormFieldWidgetEditor::PDFFormFieldWidgetEditor(PDFWidgetFormManager* formManager, PDFFormWidget formWidget) :
@@ -910,6 +1041,19 @@ void PDFFormFieldWidgetEditor::draw(AnnotationDrawParameters& parameters, bool e
     Q_UNUSED(edit)
 }
 
+void PDFFormFieldWidgetEditor::repaintEditor(QWidget* widget)
+{
+    // Previously active editor area must be repainted too, because it can be hidden now
+    const QRectF activeEditorRectangle = getActiveEditorRectangle();
+    const QRectF rectangle = m_formManager->getWidgetRectangle(m_formWidget).united(activeEditorRectangle).united(m_repaintedEditorRectangle);
+    m_repaintedEditorRectangle = activeEditorRectangle;
+
+    if (!m_formManager->repaintFormWidgetRect(m_formWidget, rectangle))
+    {
+        widget->update();
+    }
+}
+
 void PDFFormFieldWidgetEditor::performKeypadNavigation(QWidget* widget, QKeyEvent* event)
 {
     int key = event->key();
@@ -1196,7 +1340,7 @@ void PDFFormFieldComboBoxEditor::keyPressEvent(QWidget* widget, QKeyEvent* event
 
     if (event->isAccepted())
     {
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1234,7 +1378,7 @@ void PDFFormFieldComboBoxEditor::mousePressEvent(QWidget* widget, QMouseEvent* e
         }
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1248,7 +1392,7 @@ void PDFFormFieldComboBoxEditor::mouseDoubleClickEvent(QWidget* widget, QMouseEv
         m_textEdit.setCursorPosition(m_textEdit.getCursorWordForward(), true);
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1262,7 +1406,7 @@ void PDFFormFieldComboBoxEditor::mouseMoveEvent(QWidget* widget, QMouseEvent* ev
         m_textEdit.setCursorPosition(cursorPosition, true);
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1281,7 +1425,7 @@ void PDFFormFieldComboBoxEditor::wheelEvent(QWidget* widget, QWheelEvent* event,
             m_listBox.scrollTo(m_listBox.getValidIndex(m_listBox.getTopItemIndex() - 1));
         }
 
-        widget->update();
+        repaintEditor(widget);
         event->accept();
     }
 }
@@ -1513,7 +1657,7 @@ void PDFFormFieldTextBoxEditor::keyPressEvent(QWidget* widget, QKeyEvent* event)
 
     if (event->isAccepted())
     {
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1525,7 +1669,7 @@ void PDFFormFieldTextBoxEditor::mousePressEvent(QWidget* widget, QMouseEvent* ev
         m_textEdit.setCursorPosition(cursorPosition, event->modifiers() & Qt::ShiftModifier);
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1539,7 +1683,7 @@ void PDFFormFieldTextBoxEditor::mouseDoubleClickEvent(QWidget* widget, QMouseEve
         m_textEdit.setCursorPosition(m_textEdit.getCursorWordForward(), true);
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1553,7 +1697,7 @@ void PDFFormFieldTextBoxEditor::mouseMoveEvent(QWidget* widget, QMouseEvent* eve
         m_textEdit.setCursorPosition(cursorPosition, true);
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1958,7 +2102,7 @@ void PDFFormFieldListBoxEditor::keyPressEvent(QWidget* widget, QKeyEvent* event)
 
     if (event->isAccepted())
     {
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -1987,7 +2131,7 @@ void PDFFormFieldListBoxEditor::mousePressEvent(QWidget* widget, QMouseEvent* ev
         }
 
         event->accept();
-        widget->update();
+        repaintEditor(widget);
     }
 }
 
@@ -2002,7 +2146,7 @@ void PDFFormFieldListBoxEditor::mouseMoveEvent(QWidget* widget, QMouseEvent* eve
             m_listBox.setCurrentItem(index, event->modifiers());
 
             event->accept();
-            widget->update();
+            repaintEditor(widget);
         }
     }
 }
@@ -2022,7 +2166,7 @@ void PDFFormFieldListBoxEditor::wheelEvent(QWidget* widget, QWheelEvent* event,
             m_listBox.scrollTo(m_listBox.getValidIndex(m_listBox.getTopItemIndex() - 1));
         }
 
-        widget->update();
+        repaintEditor(widget);
         event->accept();
     }
 }
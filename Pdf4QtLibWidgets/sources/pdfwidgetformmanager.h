@@ -69,9 +69,19 @@ protected:
 
     void performKeypadNavigation(QWidget* widget, QKeyEvent* event);
 
+    /// Repaints the form widget and active area of the editor (for example,
+    /// popup list box), rest of the draw widget is not repainted. If page
+    /// of the form widget is unknown, whole draw widget is repainted.
+    /// \param widget Draw widget
+    void repaintEditor(QWidget* widget);
+
     PDFWidgetFormManager* m_formManager;
     PDFFormWidget m_formWidget;
     bool m_hasFocus;
+
+    /// Active editor rectangle, when editor was repainted last time (it must
+    /// be repainted again, when active editor area is hidden).
+    QRectF m_repaintedEditorRectangle;
 };
 
 class PDF4QTLIBWIDGETSSHARED_EXPORT PDFWidgetFormManager : public PDFFormManager, public IDrawWidgetInputInterface
@@ -113,7 +123,9 @@ public:
     /// \param widget Widget annotation reference
     virtual bool isFocused(PDFObjectReference widget) const override;
 
-    /// Returns editor for form field
+    /// Returns editor for form field. Editors are created on demand, when
+    /// editor of the form field is requested for the first time (usually,
+    /// when form field is drawn on the visible page, or it is under the mouse).
     PDFFormFieldWidgetEditor* getEditor(const PDFFormField* formField) const;
 
     struct MouseEventInfo
@@ -144,6 +156,12 @@ public:
     PDFWidgetAnnotationManager* getAnnotationManager() const;
     void setAnnotationManager(PDFWidgetAnnotationManager* annotationManager);
 
+    /// Requests repaint of the rectangle on the page of the form widget. Returns
+    /// false, if page of the form widget is unknown (then nothing is repainted).
+    /// \param formWidget Form widget
+    /// \param rectangle Rectangle in the page coordinate system
+    bool repaintFormWidgetRect(const PDFFormWidget& formWidget, const QRectF& rectangle);
+
 protected:
     virtual void updateFieldValues() override;
     virtual void onDocumentReset() override;
@@ -151,6 +169,19 @@ protected:
 private:
     void updateFormWidgetEditors();
 
+    /// Creates editor for the form widget, returns nullptr,
+    /// if form widget can't be edited (for example, signature).
+    /// \param widget Form widget
+    PDFFormFieldWidgetEditor* createEditor(const PDFFormWidget& widget) const;
+
+    /// Creates editors for all widgets of the form field
+    /// \param formField Form field
+    void createEditors(const PDFFormField* formField) const;
+
+    /// Creates editors of all form fields (if they are not already
+    /// created) and sorts them in the order of the form fields.
+    void createAllEditors();
+
     /// Releases all form widget editors
     void clearEditors();
 
@@ -182,7 +213,9 @@ private:
     PDFDrawWidgetProxy* m_proxy;
     MouseGrabInfo m_mouseGrabInfo;
     std::optional<QCursor> m_mouseCursor;
-    std::vector<PDFFormFieldWidgetEditor*> m_widgetEditors;
+    mutable std::vector<PDFFormFieldWidgetEditor*> m_widgetEditors;
+    mutable std::map<const PDFFormField*, PDFFormFieldWidgetEditor*> m_formFieldToEditor;
+    bool m_isAllEditorsCreated;
     PDFFormFieldWidgetEditor* m_focusedEditor;
 };
 
@@ -336,6 +336,7 @@ PDFFindTextTool::PDFFindTextTool(PDFDrawWidgetProxy* proxy, QAction* prevAction,
 {
     PDFAsynchronousTextLayoutCompiler* compiler = getProxy()->getTextLayoutCompiler();
     connect(compiler, &PDFAsynchronousTextLayoutCompiler::textLayoutChanged, this, &PDFFindTextTool::performSearch);
+    connect(compiler, &PDFAsynchronousTextLayoutCompiler::textLayoutPartiallyChanged, this, &PDFFindTextTool::performSearch);
     connect(m_prevAction, &QAction::triggered, this, &PDFFindTextTool::onActionPrevious);
     connect(m_nextAction, &QAction::triggered, this, &PDFFindTextTool::onActionNext);
 
@@ -500,14 +501,13 @@ void PDFFindTextTool::onSearchText()
     }
 
     pdf::PDFAsynchronousTextLayoutCompiler* compiler = getProxy()->getTextLayoutCompiler();
-    if (compiler->isTextLayoutReady())
-    {
-        performSearch();
-    }
-    else
+    if (!compiler->isTextLayoutReady())
     {
         compiler->makeTextLayout();
     }
+
+    // Search in already processed pages, if text layout is not ready yet
+    performSearch();
 }
 
 void PDFFindTextTool::onActionFirst()
@@ -567,50 +567,40 @@ void PDFFindTextTool::performSearch()
     }
 
     clearResults();
-    m_parameters.isSearchFinished = true;
 
     if (m_parameters.phrase.isEmpty())
     {
+        m_parameters.isSearchFinished = true;
         return;
     }
 
     PDFAsynchronousTextLayoutCompiler* compiler = getProxy()->getTextLayoutCompiler();
-    if (!compiler->isTextLayoutReady())
+    const pdf::PDFTextLayoutStorage* textLayoutStorage = compiler->getTextLayoutStorage();
+    if (!textLayoutStorage)
     {
         // Text layout is not ready yet
         return;
     }
 
+    // If text layout is only partial (some pages are not processed yet),
+    // then search is performed again, when text layout is ready.
+    m_parameters.isSearchFinished = compiler->isTextLayoutReady();
+
     // Prepare string to search
     QString expression = m_parameters.phrase;
 
-    bool useRegularExpression = false;
-    if (m_parameters.isWholeWordsOnly)
-    {
-        expression = QString("\\b%1\\b").arg(QRegularExpression::escape(expression));
-        useRegularExpression = true;
-    }
-
     pdf::PDFTextFlow::FlowFlags flowFlags = pdf::PDFTextFlow::SeparateBlocks;
 
-    const pdf::PDFTextLayoutStorage* textLayoutStorage = compiler->getTextLayoutStorage();
-    if (!useRegularExpression)
+    Qt::CaseSensitivity caseSensitivity = m_parameters.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (!m_parameters.isWholeWordsOnly)
     {
         // Use simple text search
-        Qt::CaseSensitivity caseSensitivity = m_parameters.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
         m_findResults = textLayoutStorage->find(expression, caseSensitivity, flowFlags);
     }
     else
     {
-        // Use regular expression search
-        QRegularExpression::PatternOptions patternOptions = QRegularExpression::UseUnicodePropertiesOption;
-        if (!m_parameters.isCaseSensitive)
-        {
-            patternOptions |= QRegularExpression::CaseInsensitiveOption;
-        }
-
-        QRegularExpression regularExpression(expression, patternOptions);
-        m_findResults = textLayoutStorage->find(regularExpression, flowFlags);
+        // Use whole words search
+        m_findResults = textLayoutStorage->findWholeWords(expression, caseSensitivity, flowFlags);
     }
 
     std::sort(m_findResults.begin(), m_findResults.end());
@@ -789,14 +779,14 @@ void PDFSelectTextTool::mouseMoveEvent(QWidget* widget, QMouseEvent* event)
 
     QPointF pagePoint;
     const PDFInteger pageIndex = getProxy()->getPageUnderPoint(event->pos(), &pagePoint);
-    PDFTextLayout textLayout = getProxy()->getTextLayoutCompiler()->getTextLayoutLazy(pageIndex);
-    m_isCursorOverText = textLayout.isHoveringOverTextBlock(pagePoint);
+    m_isCursorOverText = getProxy()->getTextLayoutCompiler()->isHoveringOverTextBlock(pageIndex, pagePoint);
 
     if (m_selectionInfo.pageIndex != -1)
     {
         if (m_selectionInfo.pageIndex == pageIndex)
         {
             // Jakub Melka: handle the selection
+            PDFTextLayout textLayout = getProxy()->getTextLayoutCompiler()->getTextLayoutLazy(pageIndex);
             setSelection(textLayout.createTextSelection(pageIndex, m_selectionInfo.selectionStartPoint, pagePoint));
         }
         else
@@ -1199,11 +1189,19 @@ void PDFMagnifierTool::mouseMoveEvent(QWidget* widget, QMouseEvent* event)
     QPoint mousePos = event->pos();
     if (m_mousePos != mousePos)
     {
+        // Repaint only old and new area of the magnifier
+        QRect repaintRect = !m_mousePos.isNull() ? getMagnifierRect() : QRect();
         m_mousePos = mousePos;
-        Q_EMIT getProxy()->repaintNeeded();
+        repaintRect = repaintRect.united(getMagnifierRect());
+        getProxy()->repaintRect(repaintRect);
     }
 }
 
+QRect PDFMagnifierTool::getMagnifierRect() const
+{
+    return QRect(m_mousePos - QPoint(m_magnifierSize, m_magnifierSize), QSize(2 * m_magnifierSize, 2 * m_magnifierSize));
+}
+
 void PDFMagnifierTool::drawPostRendering(QPainter* painter, QRect rect) const
 {
     if (!m_mousePos.isNull())
@@ -1228,7 +1226,11 @@ void PDFMagnifierTool::drawPostRendering(QPainter* painter, QRect rect) const
         // because origin at (100, 100) is now at position (50, 50) after scale. So, if it has to remain
         // the same, we must translate by -(50, 50).
         painter->translate(m_mousePos * (1.0 / m_magnifierZoom - 1.0));
-        getProxy()->drawPages(painter, rect, getProxy()->getFeatures());
+
+        // Draw only pages under the magnifier, magnifier radius is scaled too
+        const qreal sourceRadius = m_magnifierSize / m_magnifierZoom;
+        const QRect sourceRect = QRectF(m_mousePos.x() - sourceRadius, m_mousePos.y() - sourceRadius, 2.0 * sourceRadius, 2.0 * sourceRadius).toAlignedRect();
+        getProxy()->drawPages(painter, sourceRect.intersected(rect), getProxy()->getFeatures());
         painter->restore();
 
         painter->setPen(Qt::black);
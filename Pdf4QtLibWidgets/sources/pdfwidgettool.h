@@ -328,6 +328,9 @@ protected:
     virtual void setActiveImpl(bool active) override;
 
 private:
+    /// Returns bounding rectangle of the magnifier in the widget
+    QRect getMagnifierRect() const;
+
     QPoint m_mousePos;
     int m_magnifierSize;
     PDFReal m_magnifierZoom;
@@ -41,6 +41,10 @@
 #include <QDropEvent>
 #include <QSettings>
 #include <QMimeData>
+#include <QEventLoop>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
 
 namespace pdfpagemaster
 {
@@ -58,6 +62,12 @@ MainWindow::MainWindow(QWidget* parent) :
 
     ui->documentItemsView->setModel(m_model);
     ui->documentItemsView->setItemDelegate(m_delegate);
+
+    // All items have the same size, so view doesn't need to query
+    // size hint of each item, and layout of huge jobs is done in batches.
+    ui->documentItemsView->setUniformItemSizes(true);
+    ui->documentItemsView->setLayoutMode(QListView::Batched);
+    connect(m_delegate, &PageItemDelegate::thumbnailRendered, ui->documentItemsView->viewport(), QOverload<>::of(&QWidget::update));
     connect(ui->documentItemsView, &QListView::customContextMenuRequested, this, &MainWindow::onWorkspaceCustomContextMenuRequested);
 
     setMinimumSize(pdf::PDFWidgetUtils::scaleDPI(this, QSize(800, 600)));
@@ -509,6 +519,150 @@ bool MainWindow::canPerformOperation(Operation operation) const
     return false;
 }
 
+std::vector<int> MainWindow::getStreamedDocuments(const pdf::PDFDocumentManipulator::AssembledPages& pages,
+                                                  pdf::PDFDocumentManipulator::OutlineMode outlineMode) const
+{
+    std::vector<int> documentIndices;
+
+    // Streaming assembly doesn't create outlines
+    if (outlineMode != pdf::PDFDocumentManipulator::OutlineMode::NoOutline)
+    {
+        return documentIndices;
+    }
+
+    const auto& documents = m_model->getDocuments();
+
+    auto it = pages.cbegin();
+    while (it != pages.cend())
+    {
+        auto documentIt = documents.find(int(it->documentIndex));
+        if (!it->isDocumentPage() || documentIt == documents.cend())
+        {
+            return { };
+        }
+
+        // Pages must form the whole document in the original order and with original rotation
+        const pdf::PDFCatalog* catalog = documentIt->second.document.getCatalog();
+        const size_t pageCount = catalog->getPageCount();
+        for (size_t i = 0; i < pageCount; ++i, ++it)
+        {
+            if (it == pages.cend() ||
+                it->documentIndex != documentIt->first ||
+                it->pageIndex != pdf::PDFInteger(i) ||
+                it->pageRotation != catalog->getPage(i)->getPageRotation())
+            {
+                return { };
+            }
+        }
+
+        documentIndices.push_back(documentIt->first);
+    }
+
+    return documentIndices;
+}
+
+pdf::PDFOperationResult MainWindow::assembleDocuments(const std::vector<AssembleJob>& jobs,
+                                                      pdf::PDFDocumentManipulator::OutlineMode outlineMode)
+{
+    QProgressDialog progressDialog(tr("Assembling documents..."), QString(), 0, int(jobs.size()), this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(0);
+    progressDialog.setValue(0);
+
+    if (jobs.size() == 1)
+    {
+        // Busy indicator
+        progressDialog.setRange(0, 0);
+    }
+
+    // Model can't be modified while progress dialog is shown,
+    // so documents and images can be accessed from the background thread.
+    auto assemble = [this, &jobs, &progressDialog, outlineMode]() -> QString
+    {
+        const auto& documents = m_model->getDocuments();
+
+        pdf::PDFDocumentManipulator manipulator;
+        manipulator.setOutlineMode(outlineMode);
+
+        // Add documents and images
+        for (const auto& documentItem : documents)
+        {
+            manipulator.addDocument(documentItem.first, &documentItem.second.document);
+        }
+        for (const auto& imageItem : m_model->getImages())
+        {
+            manipulator.addImage(imageItem.first, imageItem.second.image);
+        }
+
+        int processedJobs = 0;
+        for (const AssembleJob& job : jobs)
+        {
+            if (!job.streamedDocuments.empty())
+            {
+                // Whole documents are streamed directly into the file, without
+                // creating the assembled document in the memory.
+                std::vector<pdf::PDFDocumentManipulator::DocumentLoader> loaders;
+                for (int documentIndex : job.streamedDocuments)
+                {
+                    const pdf::PDFDocument* document = &documents.at(documentIndex).document;
+                    loaders.emplace_back([document]() { return *document; });
+                }
+
+                QFile file(job.fileName);
+                if (!file.open(QFile::WriteOnly | QFile::Truncate))
+                {
+                    return tr("Cannot open file '%1' for writing.").arg(job.fileName);
+                }
+
+                pdf::PDFOperationResult result = pdf::PDFDocumentManipulator::assembleToDevice(&file, loaders);
+                file.close();
+
+                if (!result)
+                {
+                    file.remove();
+                    return result.getErrorMessage();
+                }
+            }
+            else
+            {
+                pdf::PDFOperationResult result = manipulator.assemble(job.pages);
+                if (!result)
+                {
+                    return result.getErrorMessage();
+                }
+
+                pdf::PDFDocument document = manipulator.takeAssembledDocument();
+                pdf::PDFDocumentWriter writer(nullptr);
+                pdf::PDFOperationResult writeResult = writer.write(job.fileName, &document, job.isFileAlreadyExisting);
+
+                if (!writeResult)
+                {
+                    return writeResult.getErrorMessage();
+                }
+            }
+
+            ++processedJobs;
+            QMetaObject::invokeMethod(&progressDialog, [&progressDialog, processedJobs]() { progressDialog.setValue(processedJobs); }, Qt::QueuedConnection);
+        }
+
+        return QString();
+    };
+
+    QFutureWatcher<QString> futureWatcher;
+    QEventLoop eventLoop;
+    connect(&futureWatcher, &QFutureWatcher<QString>::finished, &eventLoop, &QEventLoop::quit);
+    futureWatcher.setFuture(QtConcurrent::run(assemble));
+    eventLoop.exec();
+
+    QString errorMessage = futureWatcher.result();
+    if (!errorMessage.isEmpty())
+    {
+        return errorMessage;
+    }
+
+    return true;
+}
+
 void MainWindow::performOperation(Operation operation)
 {
     switch (operation)
@@ -719,22 +873,6 @@ void MainWindow::performOperation(Operation operation)
             AssembleOutputSettingsDialog dialog(m_settings.directory, this);
             if (dialog.exec() == QDialog::Accepted)
             {
-                pdf::PDFDocumentManipulator manipulator;
-
-                // Add documents and images
-                for (const auto& documentItem : m_model->getDocuments())
-                {
-                    manipulator.addDocument(documentItem.first, &documentItem.second.document);
-                }
-                for (const auto& imageItem : m_model->getImages())
-                {
-                    manipulator.addImage(imageItem.first, imageItem.second.image);
-                }
-
-                // Jakub Melka: create assembled documents
-                pdf::PDFOperationResult result(true);
-                std::vector<std::pair<QString, pdf::PDFDocument>> assembledDocumentStorage;
-
                 int sourceDocumentIndex = 1;
                 int assembledDocumentIndex = 1;
                 int sourcePageIndex = 1;
@@ -744,7 +882,6 @@ void MainWindow::performOperation(Operation operation)
                 QString fileNameTemplate = dialog.getFileName();
                 const bool isOverwriteEnabled = dialog.isOverwriteFiles();
                 pdf::PDFDocumentManipulator::OutlineMode outlineMode = dialog.getOutlineMode();
-                manipulator.setOutlineMode(outlineMode);
 
                 if (!directory.endsWith('/'))
                 {
@@ -767,15 +904,11 @@ void MainWindow::performOperation(Operation operation)
                     }
                 };
 
-                for (const std::vector<pdf::PDFDocumentManipulator::AssembledPage>& assembledPages : assembledDocuments)
+                // Determine file names of assembled documents first,
+                // so we do not assemble anything, if some file can't be written.
+                std::vector<AssembleJob> assembleJobs;
+                for (std::vector<pdf::PDFDocumentManipulator::AssembledPage>& assembledPages : assembledDocuments)
                 {
-                    pdf::PDFOperationResult currentResult = manipulator.assemble(assembledPages);
-                    if (!currentResult && result)
-                    {
-                        result = currentResult;
-                        break;
-                    }
-
                     pdf::PDFDocumentManipulator::AssembledPage samplePage = assembledPages.front();
                     sourceDocumentIndex = samplePage.documentIndex == -1 ? documentCount + samplePage.imageIndex : samplePage.documentIndex;
                     sourcePageIndex = qMax(int(samplePage.pageIndex + 1), 1);
@@ -792,37 +925,27 @@ void MainWindow::performOperation(Operation operation)
                     }
                     fileName.prepend(directory);
 
-                    assembledDocumentStorage.emplace_back(std::make_pair(std::move(fileName), manipulator.takeAssembledDocument()));
-                    ++assembledDocumentIndex;
-                }
-
-                if (!result)
-                {
-                    QMessageBox::critical(this, tr("Error"), result.getErrorMessage());
-                    return;
-                }
-
-                // Now, try to save files
-                for (const auto& assembledDocumentItem : assembledDocumentStorage)
-                {
-                    QString filename = assembledDocumentItem.first;
-                    const pdf::PDFDocument* document = &assembledDocumentItem.second;
-
-                    const bool isDocumentFileAlreadyExisting = QFile::exists(filename);
+                    const bool isDocumentFileAlreadyExisting = QFile::exists(fileName);
                     if (!isOverwriteEnabled && isDocumentFileAlreadyExisting)
                     {
                         QMessageBox::critical(this, tr("Error"), tr("Document with given filename already exists."));
                         return;
                     }
 
-                    pdf::PDFDocumentWriter writer(nullptr);
-                    pdf::PDFOperationResult writeResult = writer.write(filename, document, isDocumentFileAlreadyExisting);
+                    AssembleJob job;
+                    job.fileName = std::move(fileName);
+                    job.isFileAlreadyExisting = isDocumentFileAlreadyExisting;
+                    job.streamedDocuments = getStreamedDocuments(assembledPages, outlineMode);
+                    job.pages = std::move(assembledPages);
+                    assembleJobs.emplace_back(std::move(job));
+                    ++assembledDocumentIndex;
+                }
 
-                    if (!writeResult)
-                    {
-                        QMessageBox::critical(this, tr("Error"), writeResult.getErrorMessage());
-                        return;
-                    }
+                pdf::PDFOperationResult result = assembleDocuments(assembleJobs, outlineMode);
+                if (!result)
+                {
+                    QMessageBox::critical(this, tr("Error"), result.getErrorMessage());
+                    return;
                 }
             }
 
@@ -124,6 +124,33 @@ private:
         QString directory;
     };
 
+    /// One assembled output document
+    struct AssembleJob
+    {
+        QString fileName;
+        bool isFileAlreadyExisting = false;
+        pdf::PDFDocumentManipulator::AssembledPages pages;
+
+        /// If not empty, output document consists of these whole documents in
+        /// the given order, and it can be streamed directly to the file.
+        std::vector<int> streamedDocuments;
+    };
+
+    /// Returns indices of documents, if assembled pages are formed from whole
+    /// unmodified documents, and thus can be assembled by streaming documents
+    /// directly into the file. Otherwise empty vector is returned.
+    /// \param pages Assembled pages
+    /// \param outlineMode Outline mode
+    std::vector<int> getStreamedDocuments(const pdf::PDFDocumentManipulator::AssembledPages& pages,
+                                          pdf::PDFDocumentManipulator::OutlineMode outlineMode) const;
+
+    /// Assembles documents and writes them to files. Assembling is performed
+    /// in the background, while progress dialog is being displayed.
+    /// \param jobs Output documents
+    /// \param outlineMode Outline mode
+    pdf::PDFOperationResult assembleDocuments(const std::vector<AssembleJob>& jobs,
+                                              pdf::PDFDocumentManipulator::OutlineMode outlineMode);
+
     Ui::MainWindow* ui;
 
     pdf::PDFIconTheme m_iconTheme;
@@ -25,6 +25,7 @@
 
 #include <QPainter>
 #include <QPixmapCache>
+#include <QThread>
 
 namespace pdfpagemaster
 {
@@ -36,11 +37,28 @@ PageItemDelegate::PageItemDelegate(PageItemModel* model, QObject* parent) :
 {
     m_rasterizer = new pdf::PDFRasterizer(this);
     m_rasterizer->reset(pdf::RendererEngine::Blend2D_SingleThread);
+
+    // Keep one core free for the user interface
+    m_threadPool.setMaxThreadCount(qMax(QThread::idealThreadCount() - 1, 1));
+
+    connect(m_model, &PageItemModel::modelAboutToBeReset, this, &PageItemDelegate::clearRenderContexts);
 }
 
 PageItemDelegate::~PageItemDelegate()
 {
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
 
+PageItemDelegate::DocumentRenderContext::DocumentRenderContext(const pdf::PDFDocument* document) :
+    document(document),
+    fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT),
+    cmsManager(nullptr),
+    optionalContentActivity(document, pdf::OCUsage::View, nullptr)
+{
+    fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(document), &optionalContentActivity));
+    cmsManager.setDocument(document);
+    cms = cmsManager.getCurrentCMS();
 }
 
 void PageItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
@@ -158,45 +176,20 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
 
     if (!QPixmapCache::find(key, &pixmap))
     {
+        if (groupItem.pageType == PT_DocumentPage)
+        {
+            // Document pages are rendered in the background, only
+            // for visible items. Until the thumbnail is ready, empty page is drawn.
+            requestPageThumbnail(key, groupItem, rect.size() * m_dpiScaleRatio);
+            return pixmap;
+        }
+
         // We must draw the pixmap
         pixmap = QPixmap(rect.width(), rect.height());
         pixmap.fill(Qt::transparent);
 
         switch (groupItem.pageType)
         {
-            case pdfpagemaster::PT_DocumentPage:
-            {
-                const auto& documents = m_model->getDocuments();
-                auto it = documents.find(groupItem.documentIndex);
-                if (it != documents.cend())
-                {
-                    const pdf::PDFDocument& document = it->second.document;
-                    const pdf::PDFInteger pageIndex = groupItem.pageIndex - 1;
-                    if (pageIndex >= 0 && pageIndex < pdf::PDFInteger(document.getCatalog()->getPageCount()))
-                    {
-                        const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
-                        Q_ASSERT(page);
-
-                        pdf::PDFPrecompiledPage compiledPage;
-                        pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-                        pdf::PDFCMSManager cmsManager(nullptr);
-                        pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::View, nullptr);
-
-                        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(&document), &optionalContentActivity));
-                        cmsManager.setDocument(&document);
-
-                        pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
-                        pdf::PDFRenderer renderer(&document, &fontCache, cms.data(), &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
-                        renderer.compile(&compiledPage, pageIndex);
-
-                        QSize imageSize = rect.size() * m_dpiScaleRatio;
-                        QImage pageImage = m_rasterizer->render(pageIndex, page, &compiledPage, imageSize, pdf::PDFRenderer::getDefaultFeatures(), nullptr, cms.data(), groupItem.pageAdditionalRotation);
-                        pixmap = QPixmap::fromImage(qMove(pageImage));
-                    }
-                }
-                break;
-            }
-
             case pdfpagemaster::PT_Image:
             {
                 const auto& images = m_model->getImages();
@@ -221,6 +214,7 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
                 break;
             }
 
+            case pdfpagemaster::PT_DocumentPage:
             case pdfpagemaster::PT_Empty:
                 Q_ASSERT(false);
                 break;
@@ -236,4 +230,80 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
     return pixmap;
 }
 
+void PageItemDelegate::requestPageThumbnail(const QString& key, const PageGroupItem::GroupItem& groupItem, QSize imageSize) const
+{
+    if (m_pendingThumbnails.count(key))
+    {
+        // Thumbnail is already being rendered
+        return;
+    }
+
+    const auto& documents = m_model->getDocuments();
+    auto it = documents.find(groupItem.documentIndex);
+    if (it == documents.cend())
+    {
+        return;
+    }
+
+    const pdf::PDFDocument* document = &it->second.document;
+    const pdf::PDFInteger pageIndex = groupItem.pageIndex - 1;
+    if (pageIndex < 0 || pageIndex >= pdf::PDFInteger(document->getCatalog()->getPageCount()))
+    {
+        return;
+    }
+
+    DocumentRenderContextPointer& context = m_renderContexts[groupItem.documentIndex];
+    if (!context)
+    {
+        context = std::make_shared<DocumentRenderContext>(document);
+    }
+
+    m_pendingThumbnails.insert(key);
+
+    PageItemDelegate* delegate = const_cast<PageItemDelegate*>(this);
+    const pdf::PageRotation pageAdditionalRotation = groupItem.pageAdditionalRotation;
+    const int generation = m_renderContextGeneration;
+    auto renderThumbnail = [delegate, context, key, generation, pageIndex, imageSize, pageAdditionalRotation]()
+    {
+        const pdf::PDFPage* page = context->document->getCatalog()->getPage(pageIndex);
+        Q_ASSERT(page);
+
+        pdf::PDFPrecompiledPage compiledPage;
+        pdf::PDFRenderer renderer(context->document, &context->fontCache, context->cms.data(), &context->optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
+        renderer.compile(&compiledPage, pageIndex);
+
+        // Blend2D rasterizer has no state, so it can be used from multiple threads
+        QImage pageImage = delegate->m_rasterizer->render(pageIndex, page, &compiledPage, imageSize, pdf::PDFRenderer::getDefaultFeatures(), nullptr, context->cms.data(), pageAdditionalRotation);
+
+        QMetaObject::invokeMethod(delegate, [delegate, key, generation, pageImage]() mutable
+        {
+            delegate->onPageThumbnailRendered(key, generation, qMove(pageImage));
+        }, Qt::QueuedConnection);
+    };
+
+    // Most recently requested thumbnails (visible items) are rendered first
+    m_threadPool.start(std::move(renderThumbnail), ++m_thumbnailRequestCounter);
+}
+
+void PageItemDelegate::onPageThumbnailRendered(QString key, int generation, QImage image)
+{
+    if (generation != m_renderContextGeneration || !m_pendingThumbnails.erase(key))
+    {
+        // Request was cancelled
+        return;
+    }
+
+    QPixmapCache::insert(key, QPixmap::fromImage(qMove(image)));
+    Q_EMIT thumbnailRendered();
+}
+
+void PageItemDelegate::clearRenderContexts()
+{
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+    m_pendingThumbnails.clear();
+    m_renderContexts.clear();
+    ++m_renderContextGeneration;
+}
+
 }   // namespace pdfpagemaster
@@ -18,17 +18,21 @@
 #ifndef PDFPAGEMASTER_PAGEITEMDELEGATE_H
 #define PDFPAGEMASTER_PAGEITEMDELEGATE_H
 
+#include "pageitemmodel.h"
 #include "pdfrenderer.h"
 #include "pdfcms.h"
+#include "pdffont.h"
+#include "pdfoptionalcontent.h"
 
+#include <QThreadPool>
 #include <QAbstractItemDelegate>
 
+#include <set>
+#include <memory>
+
 namespace pdfpagemaster
 {
 
-class PageItemModel;
-struct PageGroupItem;
-
 class PageItemDelegate : public QAbstractItemDelegate
 {
     Q_OBJECT
@@ -46,16 +50,58 @@ public:
     QSize getPageImageSize() const;
     void setPageImageSize(QSize pageImageSize);
 
+signals:
+    /// Emitted when page thumbnail was rendered in the background,
+    /// and view should be repainted.
+    void thumbnailRendered();
+
 private:
     static constexpr int getVerticalSpacing() { return 5; }
     static constexpr int getHorizontalSpacing() { return 5; }
 
+    /// Rendering objects shared by all thumbnails of one document,
+    /// so fonts and color management are not created again for each page.
+    struct DocumentRenderContext
+    {
+        explicit DocumentRenderContext(const pdf::PDFDocument* document);
+
+        const pdf::PDFDocument* document;
+        pdf::PDFFontCache fontCache;
+        pdf::PDFCMSManager cmsManager;
+        pdf::PDFOptionalContentActivity optionalContentActivity;
+        pdf::PDFCMSPointer cms;
+    };
+
+    using DocumentRenderContextPointer = std::shared_ptr<DocumentRenderContext>;
+
     QPixmap getPageImagePixmap(const PageGroupItem* item, QRect rect) const;
 
+    /// Requests background rendering of the document page thumbnail. When
+    /// thumbnail is rendered, it is inserted into the pixmap cache.
+    /// \param key Pixmap cache key
+    /// \param groupItem Item with document page
+    /// \param imageSize Thumbnail image size
+    void requestPageThumbnail(const QString& key, const PageGroupItem::GroupItem& groupItem, QSize imageSize) const;
+
+    /// Thumbnail was rendered in the background, insert it into the pixmap cache
+    /// \param key Pixmap cache key
+    /// \param generation Generation of render contexts used for rendering
+    /// \param image Thumbnail image
+    void onPageThumbnailRendered(QString key, int generation, QImage image);
+
+    /// Cancels pending thumbnails and releases document render contexts,
+    /// called before documents are removed from the model.
+    void clearRenderContexts();
+
     PageItemModel* m_model;
     QSize m_pageImageSize;
     pdf::PDFRasterizer* m_rasterizer;
     mutable double m_dpiScaleRatio = 1.0;
+    mutable QThreadPool m_threadPool;
+    mutable std::map<int, DocumentRenderContextPointer> m_renderContexts;
+    mutable std::set<QString> m_pendingThumbnails;
+    mutable int m_thumbnailRequestCounter = 0;
+    int m_renderContextGeneration = 0;
 };
 
 }   // namespace pdfpagemaster
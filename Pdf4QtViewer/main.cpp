@@ -22,6 +22,9 @@
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QTimer>
+
+#include <iostream>
 
 int main(int argc, char *argv[])
 {
@@ -36,12 +39,14 @@ int main(int argc, char *argv[])
     QCommandLineOption noDrm("no-drm", "Disable DRM settings of documents.");
     QCommandLineOption lightGui("theme-light", "Use a light theme for the GUI.");
     QCommandLineOption darkGui("theme-dark", "Use a dark theme for the GUI.");
+    QCommandLineOption startupReport("startup-report", "Print time spent in the stages of the startup.");
 
     QCommandLineParser parser;
     parser.setApplicationDescription(QCoreApplication::applicationName());
     parser.addOption(noDrm);
     parser.addOption(lightGui);
     parser.addOption(darkGui);
+    parser.addOption(startupReport);
     parser.addHelpOption();
     parser.addVersionOption();
     parser.addPositionalArgument("file", "The PDF file to open.");
@@ -68,6 +73,17 @@ int main(int argc, char *argv[])
     pdfviewer::PDFViewerMainWindow mainWindow;
     mainWindow.show();
 
+    if (parser.isSet(startupReport))
+    {
+        // Report is printed, when event loop processes first events
+        QTimer::singleShot(0, &mainWindow, [&mainWindow]()
+        {
+            pdfviewer::PDFProgramController* programController = mainWindow.getProgramController();
+            programController->addStartupStage(QApplication::translate("Application", "First event loop"));
+            std::cerr << programController->getStartupReport().toStdString() << std::flush;
+        });
+    }
+
     QStringList arguments = parser.positionalArguments();
     if (arguments.size() > 0)
     {
@@ -55,5 +55,5 @@ int main(int argc, char *argv[])
     parser.addVersionOption();
     parser.process(arguments);
 
-    return application->execute(application->getOptions(&parser));
+    return application->run(application->getOptions(&parser));
 }
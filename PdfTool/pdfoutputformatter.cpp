@@ -22,9 +22,15 @@
 #include <QXmlStreamWriter>
 #include <QCoreApplication>
 #include <QDataStream>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QStringList>
 #include <QStringEncoder>
 
 #include <stack>
+#include <vector>
+#include <utility>
 
 #ifdef Q_OS_WIN
 #include "Windows.h"
@@ -57,6 +63,9 @@ public:
     /// Get result string in unicode.
     virtual QString getString() const = 0;
 
+    /// Returns string written so far and removes it
+    virtual QString takeString() = 0;
+
     /// Ends current line (for formatters, that support it)
     virtual void endl() { }
 };
@@ -69,6 +78,7 @@ public:
     virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
     virtual void endElement() override;
     virtual QString getString() const override;
+    virtual QString takeString() override;
     virtual void endl() override;
 
 private:
@@ -99,6 +109,7 @@ public:
     virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
     virtual void endElement() override;
     virtual QString getString() const override;
+    virtual QString takeString() override;
 
 private:
     QString m_string;
@@ -117,6 +128,7 @@ public:
     virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
     virtual void endElement() override;
     virtual QString getString() const override;
+    virtual QString takeString() override;
     virtual void endl() override;
 
 private:
@@ -124,6 +136,50 @@ private:
     QXmlStreamWriter m_streamWriter;
     int m_depth;
     int m_headerDepth;
+    bool m_isStringTaken;
+    std::stack<PDFOutputFormatter::Element> m_elementStack;
+};
+
+class PDFJsonOutputFormatterImpl : public PDFOutputFormatterImpl
+{
+public:
+    PDFJsonOutputFormatterImpl() = default;
+
+    virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
+    virtual void endElement() override;
+    virtual QString getString() const override;
+    virtual QString takeString() override;
+
+private:
+    struct Node
+    {
+        PDFOutputFormatter::Element type = PDFOutputFormatter::Element::Root;
+        QString name;
+        QString description;
+        QJsonObject object;
+        QJsonArray children;
+    };
+
+    QString m_string;
+    std::vector<Node> m_nodeStack;
+};
+
+class PDFCsvOutputFormatterImpl : public PDFOutputFormatterImpl
+{
+public:
+    PDFCsvOutputFormatterImpl() = default;
+
+    virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
+    virtual void endElement() override;
+    virtual QString getString() const override;
+    virtual QString takeString() override;
+
+private:
+    static QString escape(const QString& value);
+
+    QString m_string;
+    QStringList m_cells;
+    bool m_isTableWritten = false;
     std::stack<PDFOutputFormatter::Element> m_elementStack;
 };
 
@@ -285,6 +341,12 @@ QString PDFTextOutputFormatterImpl::getString() const
     return m_string;
 }
 
+QString PDFTextOutputFormatterImpl::takeString()
+{
+    m_streamWriter.flush();
+    return std::exchange(m_string, QString());
+}
+
 void PDFTextOutputFormatterImpl::endl()
 {
     m_streamWriter << Qt::endl;
@@ -316,6 +378,7 @@ PDFHtmlOutputFormatterImpl::PDFHtmlOutputFormatterImpl() :
     m_streamWriter(&m_string),
     m_depth(0),
     m_headerDepth(1),
+    m_isStringTaken(false),
     m_elementStack()
 {
 
@@ -480,6 +543,16 @@ QString PDFHtmlOutputFormatterImpl::getString() const
     return html;
 }
 
+QString PDFHtmlOutputFormatterImpl::takeString()
+{
+    // Document type is replaced only in the first part of the string,
+    // next parts don't contain the xml declaration.
+    QString html = m_isStringTaken ? m_string : getString();
+    m_string.clear();
+    m_isStringTaken = true;
+    return html;
+}
+
 void PDFHtmlOutputFormatterImpl::endl()
 {
     m_streamWriter.writeStartElement("br");
@@ -588,6 +661,189 @@ QString PDFXmlOutputFormatterImpl::getString() const
     return m_string;
 }
 
+QString PDFXmlOutputFormatterImpl::takeString()
+{
+    return std::exchange(m_string, QString());
+}
+
+void PDFJsonOutputFormatterImpl::beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference)
+{
+    Q_UNUSED(alignment);
+
+    Node node;
+    node.type = type;
+    node.name = qMove(name);
+    node.description = qMove(description);
+
+    if (reference != 0)
+    {
+        node.object["ref"] = reference;
+    }
+
+    m_nodeStack.push_back(qMove(node));
+}
+
+void PDFJsonOutputFormatterImpl::endElement()
+{
+    Node node = qMove(m_nodeStack.back());
+    m_nodeStack.pop_back();
+
+    if (node.type == PDFOutputFormatter::Element::Root)
+    {
+        Q_ASSERT(m_nodeStack.empty());
+
+        node.object["name"] = node.name;
+        node.object["description"] = node.description;
+        node.object["items"] = node.children;
+        m_string += QString::fromUtf8(QJsonDocument(node.object).toJson(QJsonDocument::Indented));
+        return;
+    }
+
+    Q_ASSERT(!m_nodeStack.empty());
+    Node& parent = m_nodeStack.back();
+
+    switch (node.type)
+    {
+        case PDFOutputFormatter::Element::Header:
+        case PDFOutputFormatter::Element::Table:
+        {
+            const bool isTable = node.type == PDFOutputFormatter::Element::Table;
+            node.object["type"] = isTable ? "table" : "header";
+            node.object["name"] = node.name;
+            node.object["description"] = node.description;
+            node.object[isTable ? "rows" : "items"] = node.children;
+            parent.children.append(node.object);
+            break;
+        }
+
+        case PDFOutputFormatter::Element::Text:
+        {
+            node.object["type"] = "text";
+            node.object["name"] = node.name;
+            node.object["text"] = node.description;
+            parent.children.append(node.object);
+            break;
+        }
+
+        case PDFOutputFormatter::Element::TableHeaderRow:
+        {
+            // Header row describes the columns of the table
+            parent.object["columns"] = node.object;
+            break;
+        }
+
+        case PDFOutputFormatter::Element::TableRow:
+        {
+            parent.children.append(node.object);
+            break;
+        }
+
+        case PDFOutputFormatter::Element::TableHeaderColumn:
+        case PDFOutputFormatter::Element::TableColumn:
+        {
+            parent.object[node.name] = node.description;
+            break;
+        }
+
+        default:
+        {
+            Q_ASSERT(false);
+            break;
+        }
+    }
+}
+
+QString PDFJsonOutputFormatterImpl::getString() const
+{
+    return m_string;
+}
+
+QString PDFJsonOutputFormatterImpl::takeString()
+{
+    // Json document can't be written progressively, it is available after the root element is finished
+    return std::exchange(m_string, QString());
+}
+
+void PDFCsvOutputFormatterImpl::beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference)
+{
+    Q_UNUSED(alignment);
+    Q_UNUSED(reference);
+
+    m_elementStack.push(type);
+
+    switch (type)
+    {
+        case PDFOutputFormatter::Element::Table:
+        {
+            // Tables are separated by empty line
+            if (m_isTableWritten)
+            {
+                m_string += "\r\n";
+            }
+            m_isTableWritten = true;
+            break;
+        }
+
+        case PDFOutputFormatter::Element::TableHeaderRow:
+        case PDFOutputFormatter::Element::TableRow:
+        {
+            m_cells.clear();
+            break;
+        }
+
+        case PDFOutputFormatter::Element::TableHeaderColumn:
+        {
+            // Column names are used in the header, because they are stable across languages
+            m_cells << escape(name);
+            break;
+        }
+
+        case PDFOutputFormatter::Element::TableColumn:
+        {
+            m_cells << escape(description);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void PDFCsvOutputFormatterImpl::endElement()
+{
+    PDFOutputFormatter::Element type = m_elementStack.top();
+    m_elementStack.pop();
+
+    if (type == PDFOutputFormatter::Element::TableHeaderRow || type == PDFOutputFormatter::Element::TableRow)
+    {
+        m_string += m_cells.join(',');
+        m_string += "\r\n";
+        m_cells.clear();
+    }
+}
+
+QString PDFCsvOutputFormatterImpl::getString() const
+{
+    return m_string;
+}
+
+QString PDFCsvOutputFormatterImpl::takeString()
+{
+    return std::exchange(m_string, QString());
+}
+
+QString PDFCsvOutputFormatterImpl::escape(const QString& value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n') && !value.contains('\r'))
+    {
+        return value;
+    }
+
+    QString escapedValue = value;
+    escapedValue.replace("\"", "\"\"");
+    return QString("\"%1\"").arg(escapedValue);
+}
+
 PDFOutputFormatter::PDFOutputFormatter(Style style) :
     m_impl(nullptr)
 {
@@ -604,6 +860,14 @@ PDFOutputFormatter::PDFOutputFormatter(Style style) :
         case Style::Html:
             m_impl = new PDFHtmlOutputFormatterImpl();
             break;
+
+        case Style::Json:
+            m_impl = new PDFJsonOutputFormatterImpl();
+            break;
+
+        case Style::Csv:
+            m_impl = new PDFCsvOutputFormatterImpl();
+            break;
     }
 
     Q_ASSERT(m_impl);
@@ -634,8 +898,17 @@ QString PDFOutputFormatter::getString() const
     return m_impl->getString();
 }
 
+QString PDFOutputFormatter::takeString()
+{
+    return m_impl->takeString();
+}
+
+QMutex s_writeTextMutex;
+
 void PDFConsole::writeText(QString text, QStringConverter::Encoding encoding)
 {
+    QMutexLocker lock(&s_writeTextMutex);
+
 #ifdef Q_OS_WIN
     HANDLE outputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
     if (!WriteConsoleW(outputHandle, text.utf16(), text.size(), nullptr, nullptr))
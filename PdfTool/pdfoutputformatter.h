@@ -25,7 +25,7 @@ namespace pdftool
 {
 class PDFOutputFormatterImpl;
 
-/// Output formatter for text output in various format (text, xml, html...)
+/// Output formatter for text output in various format (text, xml, html, json, csv)
 /// to the output console. Text output is in form of a structure tree,
 /// for example, xml format.
 class PDFOutputFormatter
@@ -35,7 +35,9 @@ public:
     {
         Text,
         Xml,
-        Html
+        Html,
+        Json,   ///< Structure tree as json document, table rows are objects with column values
+        Csv     ///< Only tables are written, tables are separated by empty line
     };
 
     explicit PDFOutputFormatter(Style style);
@@ -89,6 +91,11 @@ public:
     /// Get result string in unicode.
     QString getString() const;
 
+    /// Returns string written so far and removes it from the formatter, so
+    /// output can be written progressively. Concatenation of the taken strings
+    /// is the same, as the result string.
+    QString takeString();
+
 private:
     PDFOutputFormatterImpl* m_impl;
 };
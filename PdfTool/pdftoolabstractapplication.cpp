@@ -17,11 +17,18 @@
 
 #include "pdftoolabstractapplication.h"
 #include "pdfdocumentreader.h"
+#include "pdfexception.h"
 #include "pdfutils.h"
+#include "pdfinstrumentation.h"
 
+#include <QFile>
 #include <QFileInfo>
+#include <QTextStream>
 #include <QCommandLineParser>
 
+#include <atomic>
+#include <thread>
+
 namespace pdftool
 {
 
@@ -149,8 +156,9 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
 
     if (optionFlags.testFlag(ConsoleFormat))
     {
-        parser->addOption(QCommandLineOption("console-format", "Console output text format (valid values: text|xml|html).", "format", "text"));
+        parser->addOption(QCommandLineOption("console-format", "Console output text format (valid values: text|xml|html|json|csv).", "format", "text"));
         parser->addOption(QCommandLineOption("text-codec", QString("Text codec used when writing text output to redirected standard output. UTF-8 is default."), "text codec", "UTF-8"));
+        parser->addOption(QCommandLineOption("trace-file", "Write trace of page processing (compilation, rendering, decoding, waiting for locks) in Chrome trace event format (viewable in Perfetto UI) to the file.", "file"));
     }
 
     if (optionFlags.testFlag(DateFormat))
@@ -163,6 +171,9 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("pswd", "Password for encrypted document.", "password"));
         parser->addPositionalArgument("document", "Processed document.");
         parser->addOption(QCommandLineOption("no-permissive-reading", "Do not attempt to fix damaged documents."));
+        parser->addOption(QCommandLineOption("lazy-loading", "Map document into memory and load objects and pages on demand."));
+        parser->addOption(QCommandLineOption("batch", "Process documents listed in the file (one document per line, '-' reads the list from standard input) instead of a single document.", "list"));
+        parser->addOption(QCommandLineOption("batch-jobs", "Number of documents processed in parallel in batch mode.", "count", "1"));
     }
 
     if (optionFlags.testFlag(Separate))
@@ -174,12 +185,50 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
     {
         parser->addPositionalArgument("source", "Documents to be merged into single document.", "file1.pdf [file2.pdf, ...]");
         parser->addPositionalArgument("target", "Merged document filename.");
+        parser->addOption(QCommandLineOption("unite-streaming", "Write merged document directly to the target file, without holding all documents in memory. Outlines, names and document parts are not created."));
+    }
+
+    if (optionFlags.testFlag(InkCoverage))
+    {
+        parser->addOption(QCommandLineOption("ink-resolution", "Resolution (size of the page in pixels), in which ink coverage is calculated. Lower resolution is faster, but less accurate.", "pixels", "1920"));
+        parser->addOption(QCommandLineOption("ink-tile-size", "Size of the tile in pixels. Smaller tiles give finer sampling in fast mode, but page content is processed for each tile.", "pixels", "1024"));
+        parser->addOption(QCommandLineOption("ink-sample-ratio", "Fast estimation mode - ratio of randomly selected tiles, which are rendered (0-1, default is 1, i.e. all tiles). Error bound (95 % confidence) of the estimation is reported.", "ratio", "1"));
+        parser->addOption(QCommandLineOption("ink-report", "Write per-page report into the file as soon as pages are calculated.", "file"));
+        parser->addOption(QCommandLineOption("ink-report-format", "Format of the per-page report (valid values: csv|json). JSON report contains one JSON object per line.", "format", "csv"));
+    }
+
+    if (optionFlags.testFlag(Benchmark))
+    {
+        parser->addPositionalArgument("documents", "Additional documents or directories (all pdf files in the directory and its subdirectories are benchmarked).", "[documents...]");
+        parser->addOption(QCommandLineOption("bench-repeat", "Number of measured runs of each document.", "count", "1"));
+        parser->addOption(QCommandLineOption("bench-cache", "Cache modes of measured runs, separated by comma (valid values: cold|warm). In cold run, nothing is reused from previous runs, warm runs follow unmeasured warm-up run and reuse its font cache.", "modes", "cold"));
+        parser->addOption(QCommandLineOption("bench-engines", "Renderer engines, separated by comma (valid values: qpainter|blend2d|blend2d-mt). Default engine is selected by render flags.", "engines"));
+    }
+
+    if (optionFlags.testFlag(Redact))
+    {
+        parser->addPositionalArgument("target", "Redacted document filename.");
+        parser->addOption(QCommandLineOption("redact-color", "Fill color of redacted areas (default is black).", "color", "black"));
+        parser->addOption(QCommandLineOption("redact-copy-title", "Copy document title into redacted document."));
+        parser->addOption(QCommandLineOption("redact-copy-metadata", "Copy document information into redacted document."));
+        parser->addOption(QCommandLineOption("redact-copy-outline", "Copy document outline into redacted document."));
+    }
+
+    if (optionFlags.testFlag(FormFill))
+    {
+        parser->addPositionalArgument("pattern", "Output file name pattern, must contain '%' character, which is replaced by record number.");
+        parser->addOption(QCommandLineOption("fill-records", "File with records of form field values (JSON array of objects, JSON lines, or CSV with field names in the header row; '-' reads JSON lines from standard input).", "records"));
+        parser->addOption(QCommandLineOption("fill-incremental", "Write filled documents as incremental updates of the template document."));
+        parser->addOption(QCommandLineOption("fill-jobs", "Number of records filled in parallel (default is ideal thread count).", "count"));
     }
 
     if (optionFlags.testFlag(Diff))
     {
         parser->addPositionalArgument("left", "Left (old) document to be compared.");
         parser->addPositionalArgument("right", "Right (new) document to be compared.");
+        parser->addOption(QCommandLineOption("diff-manifest", "Compare document pairs listed in the file (one pair per line, left and right document separated by tabulator, '-' reads the list from standard input) instead of a single pair.", "manifest"));
+        parser->addOption(QCommandLineOption("diff-jobs", "Number of document pairs compared in parallel in manifest mode.", "count", "1"));
+        parser->addOption(QCommandLineOption("diff-stop-at-first", "Stop comparation of document pair, when first difference is found."));
     }
 
     if (optionFlags.testFlag(SignatureVerification))
@@ -236,6 +285,20 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("text-show-phoneme", "Show phoneme extracted from structure tree."));
     }
 
+    if (optionFlags.testFlag(TextStream))
+    {
+        parser->addOption(QCommandLineOption("text-stream", "Extract text page by page in parallel and write text of each page as soon as it is extracted (document text is not held in the memory)."));
+        parser->addOption(QCommandLineOption("text-stream-pages", "Maximal number of pages extracted at once in text stream mode (default is four times the ideal thread count).", "count"));
+        parser->addOption(QCommandLineOption("text-jsonl", "Write text as JSON lines, one JSON object per page (implies text stream mode)."));
+    }
+
+    if (optionFlags.testFlag(DocumentWriter))
+    {
+        parser->addOption(QCommandLineOption("object-streams", "Pack objects into compressed object streams and write cross-reference stream (produces smaller files, requires PDF 1.5)."));
+        parser->addOption(QCommandLineOption("objects-per-stream", QString("Maximal number of objects stored in one object stream (default is %1).").arg(pdf::PDFDocumentWriter::DEFAULT_OBJECTS_PER_STREAM), "count"));
+        parser->addOption(QCommandLineOption("linearize", "Write linearized document (fast web view), so pages can be displayed while document is being downloaded."));
+    }
+
     if (optionFlags.testFlag(VoiceSelector))
     {
         parser->addOption(QCommandLineOption("voice-name", "Choose voice name for text-to-speech engine.", "name"));
@@ -276,6 +339,11 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("image-template-fn", "Template file name, must contain '%' character, must not contain suffix.", "template file name", "Image_%"));
     }
 
+    if (optionFlags.testFlag(ImageRawExport))
+    {
+        parser->addOption(QCommandLineOption("image-raw", "Write JPEG and JPEG 2000 images as they are stored in the document, without decoding them."));
+    }
+
     if (optionFlags.testFlag(ImageExportSettingsResolution))
     {
         parser->addOption(QCommandLineOption("image-res-mode", "Image resolution mode (valid values are dpi|pixel). Dpi is default.", "mode", "dpi"));
@@ -297,6 +365,7 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("cms-profile-rgb", "RGB color profile for RGB device.", "profile"));
         parser->addOption(QCommandLineOption("cms-profile-cmyk", "CMYK color profile for CMYK device.", "profile"));
         parser->addOption(QCommandLineOption("cms-profile-dir", "External directory containing color profiles.", "directory"));
+        parser->addOption(QCommandLineOption("cms-transform-cache", "Directory, where precomputed color transforms are stored and reused between runs.", "directory"));
     }
 
     if (optionFlags.testFlag(RenderFlags))
@@ -307,10 +376,23 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
             parser->addOption(QCommandLineOption(info.option, info.description, "bool", defaultFeatures.testFlag(info.feature) ? "1" : "0"));
         }
 
+        parser->addOption(QCommandLineOption("render-fidelity", "Fidelity profile of the rendered output. Valid values are draft|normal|high. Draft decodes JPEG images in lower resolution, "
+                                                                "uses coarse shadings, ignores soft masks of small images, doesn't isolate opaque transparency groups and approximates "
+                                                                "Type 3 glyphs by outlines - it is fastest, intended for previews and thumbnails. Normal is the default quality. "
+                                                                "High uses smooth images, finer shadings and doesn't cache tiling patterns - it is slowest.", "fidelity", "normal"));
         parser->addOption(QCommandLineOption("render-hw-accel", "Use hardware acceleration (using GPU).", "bool", "1"));
-        parser->addOption(QCommandLineOption("render-show-page-stat", "Show page rendering statistics."));
+        parser->addOption(QCommandLineOption("render-show-page-stat", "Show page rendering statistics (including time spent in rendering stages)."));
+        parser->addOption(QCommandLineOption("render-stat-json", "Write rendering stage statistics (total, per page and per resource) to JSON file.", "file"));
         parser->addOption(QCommandLineOption("render-msaa-samples", "MSAA sample count for GPU rendering.", "samples", "4"));
         parser->addOption(QCommandLineOption("render-rasterizers", "Number of rasterizer contexts.", "rasterizers", QString::number(pdf::PDFRasterizerPool::getDefaultRasterizerCount())));
+        parser->addOption(QCommandLineOption("render-encoders", "Number of threads encoding and writing rendered images.", "encoders", QString::number(qMax(QThread::idealThreadCount() / 2, 1))));
+        parser->addOption(QCommandLineOption("render-page-cache", "Directory of persistent cache of compiled pages (cache is not used, if not set).", "directory"));
+        parser->addOption(QCommandLineOption("render-band-height", "Render pages in horizontal bands of given height and stream them as strips into BigTIFF files, so memory is bounded for large pages (disabled, if zero).", "rows", "0"));
+        parser->addOption(QCommandLineOption("render-separations", "Render separations instead of RGB image into BigTIFF files. Valid values are none|cmyk|cmyk-spots.", "separations", "none"));
+        parser->addOption(QCommandLineOption("render-separation-bits", "Bits per sample of rendered separations. Valid values are 8|16.", "bits", "8"));
+        parser->addOption(QCommandLineOption("render-shard", "Render only i-th of n shards of selected pages (1 <= i <= n). Pages are assigned to shards deterministically, shards are balanced by estimated page rendering cost.", "i/n"));
+        parser->addOption(QCommandLineOption("render-manifest", "Write manifest of rendered pages (page, file, checksum, timings) to JSON file.", "file"));
+        parser->addOption(QCommandLineOption("render-merge", "Do not render, merge manifest of the shard instead and validate, that all selected pages were rendered (can be specified multiple times).", "manifest"));
     }
 
     if (optionFlags.testFlag(Optimize))
@@ -319,6 +401,12 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         {
             parser->addOption(QCommandLineOption(info.option, info.description));
         }
+
+        pdf::PDFOptimizer::ImageSettings defaultImageSettings;
+        parser->addOption(QCommandLineOption("opt-image-dpi", "Target resolution of downsampled images.", "dpi", QString::number(defaultImageSettings.targetDpi)));
+        parser->addOption(QCommandLineOption("opt-image-threshold-dpi", "Images above this resolution are downsampled.", "dpi", QString::number(defaultImageSettings.thresholdDpi)));
+        parser->addOption(QCommandLineOption("opt-jpeg-quality", "Quality of JPEG images (1-100).", "quality", QString::number(defaultImageSettings.jpegQuality)));
+        parser->addOption(QCommandLineOption("opt-content-precision", "Number of decimal places of real numbers in optimized content streams (0-10).", "precision", QString::number(3)));
     }
 
     if (optionFlags.testFlag(CertStore))
@@ -340,6 +428,8 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("enc-owner-password", "Owner password.", "owner password"));
         parser->addOption(QCommandLineOption("enc-permissions", "Document permissions (flags represented as a number).", "permissions"));
     }
+
+    initializeApplicationCommandLineParser(parser);
 }
 
 PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser) const
@@ -364,6 +454,14 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         {
             options.outputStyle = PDFOutputFormatter::Style::Html;
         }
+        else if (consoleFormat == "json")
+        {
+            options.outputStyle = PDFOutputFormatter::Style::Json;
+        }
+        else if (consoleFormat == "csv")
+        {
+            options.outputStyle = PDFOutputFormatter::Style::Csv;
+        }
         else
         {
             if (!consoleFormat.isEmpty())
@@ -375,6 +473,7 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         }
 
         options.outputCodec = getEncoding(parser->value("text-codec"));
+        options.traceFile = parser->value("trace-file");
     }
 
     if (optionFlags.testFlag(DateFormat))
@@ -407,6 +506,9 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.document = positionalArguments.isEmpty() ? QString() : positionalArguments.front();
         options.password = parser->isSet("pswd") ? parser->value("pswd") : QString();
         options.permissiveReading = !parser->isSet("no-permissive-reading");
+        options.lazyLoading = parser->isSet("lazy-loading");
+        options.batchList = parser->value("batch");
+        options.batchJobs = qMax(parser->value("batch-jobs").toInt(), 1);
     }
 
     if (optionFlags.testFlag(Separate))
@@ -488,6 +590,50 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.textShowStructPhoneme = parser->isSet("text-show-phoneme");
     }
 
+    if (optionFlags.testFlag(TextStream))
+    {
+        options.textJsonLines = parser->isSet("text-jsonl");
+        options.textStream = parser->isSet("text-stream") || options.textJsonLines;
+
+        if (parser->isSet("text-stream-pages"))
+        {
+            QString valueText = parser->value("text-stream-pages");
+
+            bool ok = false;
+            int value = valueText.toInt(&ok);
+            if (ok && value > 0)
+            {
+                options.textStreamPages = value;
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid page count '%1' for text stream mode.").arg(valueText), options.outputCodec);
+            }
+        }
+    }
+
+    if (optionFlags.testFlag(DocumentWriter))
+    {
+        options.writeObjectStreams = parser->isSet("object-streams");
+        options.writeLinearized = parser->isSet("linearize");
+
+        if (parser->isSet("objects-per-stream"))
+        {
+            QString valueText = parser->value("objects-per-stream");
+
+            bool ok = false;
+            int value = valueText.toInt(&ok);
+            if (ok && value > 0)
+            {
+                options.writeObjectsPerStream = value;
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid object count '%1' for object streams.").arg(valueText), options.outputCodec);
+            }
+        }
+    }
+
     if (optionFlags.testFlag(VoiceSelector))
     {
         options.textVoiceName = parser->isSet("voice-name") ? parser->value("voice-name") : QString();
@@ -635,6 +781,11 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.imageExportSettings.setFileTemplate(parser->value("image-template-fn"));
     }
 
+    if (optionFlags.testFlag(ImageRawExport))
+    {
+        options.imageRawExport = parser->isSet("image-raw");
+    }
+
     if (optionFlags.testFlag(ImageExportSettingsResolution))
     {
         QString resMode = parser->value("image-res-mode").toLower();
@@ -826,6 +977,7 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         setProfile("cms-profile-rgb", options.cmsSettings.deviceRGB);
         setProfile("cms-profile-cmyk", options.cmsSettings.deviceCMYK);
         setProfile("cms-profile-dir", options.cmsSettings.profileDirectory);
+        setProfile("cms-transform-cache", options.cmsSettings.transformCacheDirectory);
     }
 
     if (optionFlags.testFlag(RenderFlags))
@@ -859,6 +1011,20 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
             PDFConsole::writeError(PDFToolTranslationContext::tr("Uknown bool value '%1'. GPU rendering is used as default.").arg(textValue), options.outputCodec);
         }
 
+        textValue = parser->value("render-fidelity");
+        if (textValue == "draft")
+        {
+            options.renderFidelity = pdf::PDFRenderer::Fidelity::Draft;
+        }
+        else if (textValue == "high")
+        {
+            options.renderFidelity = pdf::PDFRenderer::Fidelity::High;
+        }
+        else if (textValue != "normal")
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown fidelity '%1'. Normal fidelity is used.").arg(textValue), options.outputCodec);
+        }
+
         textValue = parser->value("render-msaa-samples");
         options.renderMSAAsamples = textValue.toInt(&ok);
         if (!ok)
@@ -881,17 +1047,232 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
             options.renderRasterizerCount = correctedRasterizerCount;
         }
 
+        textValue = parser->value("render-encoders");
+        options.renderEncoderCount = textValue.toInt(&ok);
+        if (!ok || options.renderEncoderCount < 1)
+        {
+            options.renderEncoderCount = qMax(QThread::idealThreadCount() / 2, 1);
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid encoder count '%1'. %2 encoders are used as default.").arg(textValue).arg(options.renderEncoderCount), options.outputCodec);
+        }
+
+        textValue = parser->value("render-band-height");
+        options.renderBandHeight = textValue.toInt(&ok);
+        if (!ok || options.renderBandHeight < 0)
+        {
+            options.renderBandHeight = 0;
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid band height '%1'. Pages are rendered without bands.").arg(textValue), options.outputCodec);
+        }
+
+        textValue = parser->value("render-separations");
+        if (textValue == "cmyk" || textValue == "cmyk-spots")
+        {
+            options.renderSeparations = true;
+            options.renderSpotSeparations = textValue == "cmyk-spots";
+        }
+        else if (textValue != "none")
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown separations '%1'. RGB images are rendered.").arg(textValue), options.outputCodec);
+        }
+
+        textValue = parser->value("render-separation-bits");
+        options.renderSeparationBits = textValue.toInt(&ok);
+        if (!ok || (options.renderSeparationBits != 8 && options.renderSeparationBits != 16))
+        {
+            options.renderSeparationBits = 8;
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid bits per sample of separations '%1'. 8 bits are used as default.").arg(textValue), options.outputCodec);
+        }
+
         options.renderShowPageStatistics = parser->isSet("render-show-page-stat");
+        options.renderStatisticsJsonFile = parser->value("render-stat-json");
+        options.renderPageCacheDirectory = parser->value("render-page-cache");
+        options.renderManifestFile = parser->value("render-manifest");
+        options.renderMergeManifests = parser->values("render-merge");
+
+        if (parser->isSet("render-shard"))
+        {
+            textValue = parser->value("render-shard");
+            QStringList shardParts = textValue.split('/');
+
+            bool isIndexValid = false;
+            bool isCountValid = false;
+            const int shardIndex = shardParts.size() == 2 ? shardParts.front().toInt(&isIndexValid) : 0;
+            const int shardCount = shardParts.size() == 2 ? shardParts.back().toInt(&isCountValid) : 0;
+
+            if (isIndexValid && isCountValid && shardCount >= 1 && shardIndex >= 1 && shardIndex <= shardCount)
+            {
+                options.renderShardIndex = shardIndex - 1;
+                options.renderShardCount = shardCount;
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid shard '%1', all pages are rendered.").arg(textValue), options.outputCodec);
+            }
+        }
     }
 
     if (optionFlags.testFlag(Unite))
     {
         options.uniteFiles = positionalArguments;
+        options.uniteStreaming = parser->isSet("unite-streaming");
     }
 
     if (optionFlags.testFlag(Diff))
     {
         options.diffFiles = positionalArguments;
+        options.diffManifest = parser->value("diff-manifest");
+        options.diffStopAtFirstDifference = parser->isSet("diff-stop-at-first");
+
+        QString valueText = parser->value("diff-jobs");
+        bool ok = false;
+        int value = valueText.toInt(&ok);
+        if (ok && value > 0)
+        {
+            options.diffJobs = value;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid job count '%1' for diff.").arg(valueText), options.outputCodec);
+        }
+    }
+
+    if (optionFlags.testFlag(InkCoverage))
+    {
+        bool ok = false;
+        int resolution = parser->value("ink-resolution").toInt(&ok);
+        if (ok && resolution > 0)
+        {
+            options.inkCoverageResolution = resolution;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid ink coverage resolution '%1'.").arg(parser->value("ink-resolution")), options.outputCodec);
+        }
+
+        int tileSize = parser->value("ink-tile-size").toInt(&ok);
+        if (ok && tileSize >= 16)
+        {
+            options.inkCoverageTileSize = tileSize;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid ink coverage tile size '%1'.").arg(parser->value("ink-tile-size")), options.outputCodec);
+        }
+
+        double sampleRatio = parser->value("ink-sample-ratio").toDouble(&ok);
+        if (ok && sampleRatio > 0.0 && sampleRatio <= 1.0)
+        {
+            options.inkCoverageSampleRatio = sampleRatio;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid ink coverage sample ratio '%1'.").arg(parser->value("ink-sample-ratio")), options.outputCodec);
+        }
+
+        options.inkCoverageReportFile = parser->value("ink-report");
+        options.inkCoverageReportFormat = parser->value("ink-report-format");
+    }
+
+    if (optionFlags.testFlag(Benchmark))
+    {
+        options.benchmarkDocuments = positionalArguments;
+
+        bool ok = false;
+        int repeatCount = parser->value("bench-repeat").toInt(&ok);
+        if (ok && repeatCount > 0)
+        {
+            options.benchmarkRepeatCount = repeatCount;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid repeat count '%1'. Each document is measured once.").arg(parser->value("bench-repeat")), options.outputCodec);
+        }
+
+        options.benchmarkColdCache = false;
+        options.benchmarkWarmCache = false;
+        for (const QString& cacheMode : parser->value("bench-cache").split(',', Qt::SkipEmptyParts))
+        {
+            const QString mode = cacheMode.trimmed();
+            if (mode == "cold")
+            {
+                options.benchmarkColdCache = true;
+            }
+            else if (mode == "warm")
+            {
+                options.benchmarkWarmCache = true;
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown cache mode '%1'.").arg(mode), options.outputCodec);
+            }
+        }
+
+        if (!options.benchmarkColdCache && !options.benchmarkWarmCache)
+        {
+            options.benchmarkColdCache = true;
+        }
+
+        for (const QString& engineName : parser->value("bench-engines").split(',', Qt::SkipEmptyParts))
+        {
+            const QString engine = engineName.trimmed();
+            if (engine == "qpainter")
+            {
+                options.benchmarkEngines.push_back(pdf::RendererEngine::QPainter);
+            }
+            else if (engine == "blend2d")
+            {
+                options.benchmarkEngines.push_back(pdf::RendererEngine::Blend2D_SingleThread);
+            }
+            else if (engine == "blend2d-mt")
+            {
+                options.benchmarkEngines.push_back(pdf::RendererEngine::Blend2D_MultiThread);
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown renderer engine '%1'.").arg(engine), options.outputCodec);
+            }
+        }
+    }
+
+    if (optionFlags.testFlag(Redact))
+    {
+        options.redactTarget = positionalArguments.size() >= 2 ? positionalArguments[1] : QString();
+        options.redactCopyTitle = parser->isSet("redact-copy-title");
+        options.redactCopyMetadata = parser->isSet("redact-copy-metadata");
+        options.redactCopyOutline = parser->isSet("redact-copy-outline");
+
+        QString colorName = parser->value("redact-color");
+        QColor color = QColor::fromString(colorName);
+        if (color.isValid())
+        {
+            options.redactFillColor = color;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown redact color '%1'. Defaulting to black.").arg(colorName), options.outputCodec);
+        }
+    }
+
+    if (optionFlags.testFlag(FormFill))
+    {
+        options.formFillOutputPattern = positionalArguments.size() >= 2 ? positionalArguments[1] : QString();
+        options.formFillRecords = parser->value("fill-records");
+        options.formFillIncremental = parser->isSet("fill-incremental");
+
+        if (parser->isSet("fill-jobs"))
+        {
+            QString valueText = parser->value("fill-jobs");
+
+            bool ok = false;
+            int value = valueText.toInt(&ok);
+            if (ok && value > 0)
+            {
+                options.formFillJobs = value;
+            }
+            else
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid job count '%1' for form fill.").arg(valueText), options.outputCodec);
+            }
+        }
     }
 
     if (optionFlags.testFlag(Optimize))
@@ -904,6 +1285,47 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
                 options.optimizeFlags |= info.flag;
             }
         }
+
+        bool ok = false;
+        pdf::PDFReal targetDpi = parser->value("opt-image-dpi").toDouble(&ok);
+        if (ok && targetDpi > 0.0)
+        {
+            options.optimizeImageSettings.targetDpi = targetDpi;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid image resolution '%1'.").arg(parser->value("opt-image-dpi")), options.outputCodec);
+        }
+
+        pdf::PDFReal thresholdDpi = parser->value("opt-image-threshold-dpi").toDouble(&ok);
+        if (ok && thresholdDpi > 0.0)
+        {
+            options.optimizeImageSettings.thresholdDpi = qMax(thresholdDpi, options.optimizeImageSettings.targetDpi);
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid image resolution '%1'.").arg(parser->value("opt-image-threshold-dpi")), options.outputCodec);
+        }
+
+        int jpegQuality = parser->value("opt-jpeg-quality").toInt(&ok);
+        if (ok && jpegQuality >= 1 && jpegQuality <= 100)
+        {
+            options.optimizeImageSettings.jpegQuality = jpegQuality;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid JPEG quality '%1'. Valid values are 1-100.").arg(parser->value("opt-jpeg-quality")), options.outputCodec);
+        }
+
+        int contentStreamPrecision = parser->value("opt-content-precision").toInt(&ok);
+        if (ok && contentStreamPrecision >= 0 && contentStreamPrecision <= 10)
+        {
+            options.optimizeContentStreamPrecision = contentStreamPrecision;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid content stream precision '%1'. Valid values are 0-10.").arg(parser->value("opt-content-precision")), options.outputCodec);
+        }
     }
 
     if (optionFlags.testFlag(CertStore))
@@ -970,6 +1392,7 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.encryptionPermissions = parser->value("enc-permissions").toUInt();
     }
 
+    readApplicationOptions(parser, options);
     return options;
 }
 
@@ -993,6 +1416,112 @@ QString PDFToolAbstractApplication::convertDateTimeToString(const QDateTime& dat
     return QLocale::system().toString(dateTime, QLocale::ShortFormat);
 }
 
+int PDFToolAbstractApplication::run(const PDFToolOptions& options)
+{
+    if (!options.traceFile.isEmpty())
+    {
+        pdf::PDFTrace::start();
+    }
+
+    const int result = !options.batchList.isEmpty() ? executeBatch(options) : execute(options);
+
+    if (!options.traceFile.isEmpty())
+    {
+        pdf::PDFTrace::stop();
+        if (!pdf::PDFTrace::writeToFile(options.traceFile))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write trace to the file '%1'.").arg(options.traceFile), options.outputCodec);
+        }
+    }
+
+    return result;
+}
+
+int PDFToolAbstractApplication::executeBatch(const PDFToolOptions& options)
+{
+    QFile file;
+    bool isOpened = false;
+    if (options.batchList == "-")
+    {
+        isOpened = file.open(stdin, QFile::ReadOnly | QFile::Text);
+    }
+    else
+    {
+        file.setFileName(options.batchList);
+        isOpened = file.open(QFile::ReadOnly | QFile::Text);
+    }
+
+    if (!isOpened)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open batch list '%1'.").arg(options.batchList), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QStringList documents;
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+    {
+        QString document = stream.readLine().trimmed();
+        if (!document.isEmpty())
+        {
+            documents << qMove(document);
+        }
+    }
+    file.close();
+
+    // Applications, which store state during the execution,
+    // must process the documents one by one.
+    const size_t documentCount = documents.size();
+    const size_t jobCount = isConcurrentExecutionSupported() ? qBound<size_t>(1, options.batchJobs, qMax<size_t>(documentCount, 1)) : 1;
+
+    std::atomic<size_t> nextDocument = 0;
+    std::atomic_bool isFailed = false;
+    auto worker = [&]()
+    {
+        for (size_t i = nextDocument++; i < documentCount; i = nextDocument++)
+        {
+            PDFToolOptions documentOptions = options;
+            documentOptions.document = documents[i];
+            documentOptions.batchList.clear();
+
+            int exitCode = ErrorUnknown;
+            try
+            {
+                exitCode = execute(documentOptions);
+            }
+            catch (const pdf::PDFException& exception)
+            {
+                PDFConsole::writeError(exception.getMessage(), options.outputCodec);
+            }
+
+            if (exitCode != ExitSuccess)
+            {
+                isFailed = true;
+            }
+
+            // Result record: status, exit code and document, separated by tabulators
+            QString record = QString("%1\t%2\t%3\n").arg(exitCode == ExitSuccess ? "OK" : "FAILED").arg(exitCode).arg(documents[i]);
+            PDFConsole::writeText(record, options.outputCodec);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobCount - 1);
+    for (size_t i = 1; i < jobCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    return isFailed ? ExitFailure : ExitSuccess;
+}
+
 bool PDFToolAbstractApplication::readDocument(const PDFToolOptions& options, pdf::PDFDocument& document, QByteArray* sourceData, bool authorizeOwnerOnly)
 {
     bool isFirstPasswordAttempt = true;
@@ -1003,6 +1532,11 @@ bool PDFToolAbstractApplication::readDocument(const PDFToolOptions& options, pdf
         return options.password;
     };
     pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, authorizeOwnerOnly);
+    if (options.lazyLoading)
+    {
+        reader.setReadingMode(pdf::PDFDocumentReader::ReadingMode::MemoryMapped);
+        reader.setObjectLoadingMode(pdf::PDFDocumentReader::ObjectLoadingMode::OnDemand);
+    }
     document = reader.readFromFile(options.document);
 
     switch (reader.getReadingResult())
@@ -1012,6 +1546,12 @@ bool PDFToolAbstractApplication::readDocument(const PDFToolOptions& options, pdf
             if (sourceData)
             {
                 *sourceData = reader.getSource();
+
+                if (options.lazyLoading)
+                {
+                    // Source data are only a view of the mapped file
+                    sourceData->detach();
+                }
             }
             break;
         }
@@ -1173,7 +1713,8 @@ std::vector<PDFToolOptions::RenderFeatureInfo> PDFToolOptions::getRenderFeatures
         RenderFeatureInfo{ "render-high-contrast", "Color conversion: high contrast colors", pdf::PDFRenderer::ColorAdjust_HighContrast },
         RenderFeatureInfo{ "render-bitonal", "Color conversion: bitonal page image", pdf::PDFRenderer::ColorAdjust_Bitonal },
         RenderFeatureInfo{ "render-custom-colors", "Color conversion: custom colors", pdf::PDFRenderer::ColorAdjust_CustomColors },
-        RenderFeatureInfo{ "render-display-annot", "Display annotations.", pdf::PDFRenderer::DisplayAnnotations }
+        RenderFeatureInfo{ "render-display-annot", "Display annotations.", pdf::PDFRenderer::DisplayAnnotations },
+        RenderFeatureInfo{ "render-tiling-pattern-cache", "Paint dense tiling patterns using cached image of the pattern cell.", pdf::PDFRenderer::TilingPatternCache }
     };
 }
 
@@ -1186,6 +1727,13 @@ std::vector<PDFToolOptions::OptimizeFeatureInfo> PDFToolOptions::getOptimizeFlag
         OptimizeFeatureInfo{ "opt-merge-identical", "Merge identical objects.", pdf::PDFOptimizer::MergeIdenticalObjects },
         OptimizeFeatureInfo{ "opt-shrink-storage", "Shrink object storage by renumbering objects.", pdf::PDFOptimizer::ShrinkObjectStorage },
         OptimizeFeatureInfo{ "opt-recompress-flate", "Recompress flate streams with maximal compression.", pdf::PDFOptimizer::RecompressFlateStreams },
+        OptimizeFeatureInfo{ "opt-merge-images", "Merge images with identical decoded pixels.", pdf::PDFOptimizer::MergeIdenticalImages },
+        OptimizeFeatureInfo{ "opt-downsample-images", "Downsample images above threshold resolution to target resolution.", pdf::PDFOptimizer::DownsampleImages },
+        OptimizeFeatureInfo{ "opt-jpeg-images", "Recompress photographic images to JPEG.", pdf::PDFOptimizer::RecompressImagesToJPEG },
+        OptimizeFeatureInfo{ "opt-bilevel-images", "Store black and white images as 1-bit images.", pdf::PDFOptimizer::CompressBilevelImages },
+        OptimizeFeatureInfo{ "opt-merge-fonts", "Merge identical embedded font programs.", pdf::PDFOptimizer::MergeIdenticalFonts },
+        OptimizeFeatureInfo{ "opt-subset-fonts", "Subset embedded TrueType fonts to used glyphs.", pdf::PDFOptimizer::SubsetFonts },
+        OptimizeFeatureInfo{ "opt-content-streams", "Rewrite content streams to smaller equivalent form.", pdf::PDFOptimizer::OptimizeContentStreams },
         OptimizeFeatureInfo{ "opt-all", "Use all optimization algorithms.", pdf::PDFOptimizer::All }
     };
 }
@@ -25,9 +25,12 @@
 #include "pdfrenderer.h"
 #include "pdfcms.h"
 #include "pdfoptimizer.h"
+#include "pdfdocumentwriter.h"
 
 #include <QtGlobal>
 #include <QString>
+#include <QThread>
+#include <QColor>
 #include <QDateTime>
 #include <QCoreApplication>
 #include <QStringConverter>
@@ -57,6 +60,7 @@ struct PDFToolOptions
     // For option 'ConsoleFormat'
     PDFOutputFormatter::Style outputStyle = PDFOutputFormatter::Style::Text;
     QStringConverter::Encoding outputCodec = QStringConverter::Utf8;
+    QString traceFile;
 
     // For option 'DateFormat'
     DateFormat outputDateFormat = LocaleShortDate;
@@ -65,6 +69,9 @@ struct PDFToolOptions
     QString document;
     QString password;
     bool permissiveReading = true;
+    bool lazyLoading = false;
+    QString batchList;
+    int batchJobs = 1;
 
     // For option 'SignatureVerification'
     bool verificationUseUserCertificates = true;
@@ -106,6 +113,16 @@ struct PDFToolOptions
     bool textShowStructActualText = false;
     bool textShowStructPhoneme = false;
 
+    // For option 'TextStream'
+    bool textStream = false;
+    bool textJsonLines = false;
+    int textStreamPages = 0;
+
+    // For option 'DocumentWriter'
+    bool writeObjectStreams = false;
+    bool writeLinearized = false;
+    int writeObjectsPerStream = pdf::PDFDocumentWriter::DEFAULT_OBJECTS_PER_STREAM;
+
     // For option 'VoiceSelector'
     QString textVoiceName;
     QString textVoiceGender;
@@ -130,27 +147,85 @@ struct PDFToolOptions
     // For option 'ImageExportSettings'
     pdf::PDFPageImageExportSettings imageExportSettings;
 
+    // For option 'ImageRawExport'
+    bool imageRawExport = false;
+
     // For option 'ColorManagementSystem'
     pdf::PDFCMSSettings cmsSettings;
 
     // For option 'RenderFlags'
     pdf::PDFRenderer::Features renderFeatures = pdf::PDFRenderer::getDefaultFeatures();
+    pdf::PDFRenderer::Fidelity renderFidelity = pdf::PDFRenderer::Fidelity::Normal; ///< Fidelity profile applied to render features and mesh quality
     bool renderUseSoftwareRendering = true;
     bool renderShowPageStatistics = false;
+    QString renderStatisticsJsonFile;
     int renderMSAAsamples = 4;
     int renderRasterizerCount = pdf::PDFRasterizerPool::getDefaultRasterizerCount();
+    int renderEncoderCount = qMax(QThread::idealThreadCount() / 2, 1);
+    QString renderPageCacheDirectory;
+    int renderBandHeight = 0;       ///< Pages higher than this are rendered in bands into BigTIFF (zero = disabled)
+    bool renderSeparations = false;     ///< Render CMYK separations into BigTIFF instead of RGB images
+    bool renderSpotSeparations = false; ///< Add spot color separations to CMYK separations
+    int renderSeparationBits = 8;       ///< Bits per sample of separations (8 or 16)
+    int renderShardIndex = 0;       ///< Zero based index of the shard
+    int renderShardCount = 1;
+    QString renderManifestFile;
+    QStringList renderMergeManifests;
 
     // For option 'Separate'
     QString separatePagePattern;
 
     // For option 'Unite'
     QStringList uniteFiles;
+    bool uniteStreaming = false;
 
     // For option 'Diff'
     QStringList diffFiles;
+    QString diffManifest;
+    int diffJobs = 1;
+    bool diffStopAtFirstDifference = false;
+
+    // For option 'FormFill'
+    QString formFillRecords;
+    QString formFillOutputPattern;
+    bool formFillIncremental = false;
+    int formFillJobs = QThread::idealThreadCount();
+
+    // For option 'InkCoverage'
+    int inkCoverageResolution = 1920;
+    int inkCoverageTileSize = 1024;
+    double inkCoverageSampleRatio = 1.0;
+    QString inkCoverageReportFile;
+    QString inkCoverageReportFormat;
+
+    // For option 'Benchmark'
+    QStringList benchmarkDocuments;     ///< Documents or directories (all pdf files in directory are benchmarked)
+    int benchmarkRepeatCount = 1;
+    bool benchmarkColdCache = true;     ///< Measure runs, in which nothing is reused from previous runs
+    bool benchmarkWarmCache = false;    ///< Measure runs after warm-up run, font cache is reused between runs
+    std::vector<pdf::RendererEngine> benchmarkEngines;
+
+    // For application 'sign'
+    QString signCertificateFile;        ///< PKCS#12 file with the private key and certificate
+    QString signPassword;
+    QString signFieldName;
+    QString signReason;
+    QString signContactInfo;
+    QString signOutputDirectory;        ///< Output directory (empty = directory of the document)
+    bool signInPlace = false;           ///< Append signature to the original file
+    int signReservedSize = 8192;        ///< Bytes reserved for the signature in the document
+
+    // For option 'Redact'
+    QString redactTarget;
+    QColor redactFillColor = Qt::black;
+    bool redactCopyTitle = false;
+    bool redactCopyMetadata = false;
+    bool redactCopyOutline = false;
 
     // For option 'Optimize'
     pdf::PDFOptimizer::OptimizationFlags optimizeFlags = pdf::PDFOptimizer::None;
+    pdf::PDFOptimizer::ImageSettings optimizeImageSettings;
+    int optimizeContentStreamPrecision = 3;
 
     // For option 'CertStore'
     bool certStoreEnumerateSystemCertificates = false;
@@ -252,6 +327,13 @@ public:
         CertStoreInstall                = 0x00400000,       ///< Settings for certificate store install certificate tool
         Encrypt                         = 0x00800000,       ///< Encryption settings
         Diff                            = 0x01000000,       ///< Diff settings (compare documents)
+        TextStream                      = 0x02000000,       ///< Text stream options (extract and write text page by page)
+        DocumentWriter                  = 0x04000000,       ///< Document writer options (object streams)
+        FormFill                        = 0x08000000,       ///< Settings for form fill tool
+        ImageRawExport                  = 0x10000000,       ///< Export images without decoding (if possible)
+        Redact                          = 0x20000000,       ///< Settings for redact tool
+        InkCoverage                     = 0x40000000,       ///< Settings for ink coverage tool (resolution, sampling, report)
+        Benchmark                       = 0x80000000,       ///< Settings for benchmark tool (documents, repetitions, cache modes, renderer engines)
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -259,12 +341,31 @@ public:
     virtual int execute(const PDFToolOptions& options) = 0;
     virtual Options getOptionsFlags() const = 0;
 
+    /// Returns true, if application can execute multiple documents concurrently
+    /// (i.e. it doesn't store any state during the execution)
+    virtual bool isConcurrentExecutionSupported() const { return true; }
+
     void initializeCommandLineParser(QCommandLineParser* parser) const;
     PDFToolOptions getOptions(QCommandLineParser* parser) const;
 
+    /// Executes the application. If batch list is specified in the options, application
+    /// is executed for each document in the list, otherwise it is executed once.
+    /// \param options Options
+    int run(const PDFToolOptions& options);
+
     static QString convertDateTimeToString(const QDateTime& dateTime, PDFToolOptions::DateFormat dateFormat);
 
 protected:
+    /// Adds command line options, which are used only by this application, so
+    /// they don't need option flag (option flags are shared by all applications).
+    /// \param parser Command line parser
+    virtual void initializeApplicationCommandLineParser(QCommandLineParser* parser) const { Q_UNUSED(parser); }
+
+    /// Reads command line options added by \p initializeApplicationCommandLineParser
+    /// \param parser Command line parser
+    /// \param options Options
+    virtual void readApplicationOptions(QCommandLineParser* parser, PDFToolOptions& options) const { Q_UNUSED(parser); Q_UNUSED(options); }
+
     /// Tries to read the document. If document is successfully read, true is returned,
     /// if error occurs, then false is returned. Optionally, original document content
     /// can also be retrieved.
@@ -274,6 +375,13 @@ protected:
     /// \param authorizeOwnerOnly Require to authorize as owner
     bool readDocument(const PDFToolOptions& options, pdf::PDFDocument& document, QByteArray* sourceData, bool authorizeOwnerOnly);
 
+    /// Executes the application for each document in the batch list. Documents are
+    /// processed in one process (so process-wide caches, such as system fonts,
+    /// character maps or trusted certificates, are reused), using given number of
+    /// worker threads. For each document, one result record is written.
+    /// \param options Options
+    int executeBatch(const PDFToolOptions& options);
+
     /// Returns a list of available encodings
     static QList<QByteArray> getAvailableEncodings();
 
@@ -17,6 +17,7 @@
 
 #include "pdftoolattachments.h"
 #include "pdfexception.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QFile>
 #include <QMimeDatabase>
@@ -157,15 +158,24 @@ int PDFToolAttachmentsApplication::execute(const PDFToolOptions& options)
             return ErrorInvalidArguments;
         }
 
+        // Saved files (and error messages of saving)
+        std::vector<std::pair<const FileInfo*, QString>> savedFiles;
         for (const FileInfo& info : embeddedFiles)
         {
-            if (!info.isSaved)
+            if (info.isSaved)
             {
-                // This file is not marked to be saved
-                continue;
+                savedFiles.emplace_back(&info, QString());
             }
+        }
+
+        // Files are decoded in chunks directly into the target file,
+        // so the whole decoded file is never held in memory.
+        auto saveFile = [&](std::pair<const FileInfo*, QString>& savedFile)
+        {
+            const FileInfo* info = savedFile.first;
+            QString& error = savedFile.second;
 
-            QString outputFile = info.fileName;
+            QString outputFile = info->fileName;
             if (!options.attachmentsTargetFile.isEmpty())
             {
                 outputFile = options.attachmentsTargetFile;
@@ -178,25 +188,48 @@ int PDFToolAttachmentsApplication::execute(const PDFToolOptions& options)
 
             try
             {
-                QByteArray data = document.getDecodedStream(info.specification->getPlatformFile()->getStream());
-
                 QFile file(outputFile);
                 if (file.open(QFile::WriteOnly | QFile::Truncate))
                 {
-                    file.write(data);
+                    auto writeData = [&file](const char* data, qsizetype size)
+                    {
+                        if (file.write(data, size) != size)
+                        {
+                            throw pdf::PDFException(file.errorString());
+                        }
+                    };
+
+                    if (!document.decodeStream(info->specification->getPlatformFile()->getStream(), writeData))
+                    {
+                        error = PDFToolTranslationContext::tr("Failed to save attachment to file. Attachment is corrupted.");
+                    }
                     file.close();
                 }
                 else
                 {
-                    PDFConsole::writeError(PDFToolTranslationContext::tr("Failed to save attachment to file. %1").arg(file.errorString()), options.outputCodec);
-                    return ErrorFailedWriteToFile;
+                    error = PDFToolTranslationContext::tr("Failed to save attachment to file. %1").arg(file.errorString());
                 }
             }
             catch (const pdf::PDFException &e)
             {
-                PDFConsole::writeError(PDFToolTranslationContext::tr("Failed to save attachment to file. %1").arg(e.getMessage()), options.outputCodec);
-                return ErrorFailedWriteToFile;
+                error = PDFToolTranslationContext::tr("Failed to save attachment to file. %1").arg(e.getMessage());
             }
+        };
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, savedFiles.begin(), savedFiles.end(), saveFile);
+
+        bool isError = false;
+        for (const auto& savedFile : savedFiles)
+        {
+            if (!savedFile.second.isEmpty())
+            {
+                PDFConsole::writeError(savedFile.second, options.outputCodec);
+                isError = true;
+            }
+        }
+
+        if (isError)
+        {
+            return ErrorFailedWriteToFile;
         }
     }
 
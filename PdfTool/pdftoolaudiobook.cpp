@@ -16,10 +16,13 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdftoolaudiobook.h"
+#include "pdfaudiobookwriter.h"
+#include "pdfexecutionpolicy.h"
 
 #ifdef Q_OS_WIN
 
 #include <QFileInfo>
+#include <QStandardPaths>
 
 #include <windows.h>
 #include <sapi.h>
@@ -34,6 +37,51 @@ namespace pdftool
 static PDFToolAudioBook s_audioBookApplication;
 static PDFToolAudioBookVoices s_audioBookVoicesApplication;
 
+/// Synthesizes text to raw PCM audio data in the memory
+/// \param voice Voice
+/// \param waveFormat Format of the audio data
+/// \param text Text to be synthesized
+/// \param audioData Audio data
+static bool synthesizeText(ISpVoice* voice, const WAVEFORMATEX& waveFormat, const QString& text, QByteArray& audioData)
+{
+    IStream* memoryStream = nullptr;
+    if (!SUCCEEDED(::CreateStreamOnHGlobal(NULL, TRUE, &memoryStream)))
+    {
+        return false;
+    }
+
+    ISpStream* stream = nullptr;
+    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpStream, NULL, CLSCTX_ALL, __uuidof(ISpStream), (LPVOID*)&stream)))
+    {
+        memoryStream->Release();
+        return false;
+    }
+
+    bool result = false;
+    if (SUCCEEDED(stream->SetBaseStream(memoryStream, SPDFID_WaveFormatEx, &waveFormat)) &&
+        SUCCEEDED(voice->SetOutput(stream, FALSE)) &&
+        SUCCEEDED(voice->Speak((LPCWSTR)text.utf16(), SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL)))
+    {
+        STATSTG statistics = { };
+        HGLOBAL global = NULL;
+        if (SUCCEEDED(memoryStream->Stat(&statistics, STATFLAG_NONAME)) && SUCCEEDED(::GetHGlobalFromStream(memoryStream, &global)))
+        {
+            if (const char* data = static_cast<const char*>(::GlobalLock(global)))
+            {
+                audioData = QByteArray(data, qsizetype(statistics.cbSize.QuadPart));
+                ::GlobalUnlock(global);
+                result = true;
+            }
+        }
+    }
+
+    voice->SetOutput(NULL, FALSE);
+    stream->Release();
+    memoryStream->Release();
+
+    return result;
+}
+
 PDFVoiceInfo::PDFVoiceInfo(std::map<QString, QString> properties, ISpObjectToken* voiceToken) :
     m_properties(qMove(properties)),
     m_voiceToken(voiceToken)
@@ -358,14 +406,16 @@ int PDFToolAudioBook::getDocumentTextFlow(const PDFToolOptions& options, pdf::PD
 
 int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDocumentTextFlow& flow)
 {
-    QString audioString;
-    QTextStream textStream(&audioString);
+    // Each text item is a segment, which is synthesized separately
+    // (and in parallel), bookmark is put before the first segment of the page.
+    std::vector<QString> segments;
+    QString pageBookmark;
 
     for (const pdf::PDFDocumentTextFlow::Item& item : flow.getItems())
     {
         if (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart) && options.textSpeechMarkPageNumbers)
         {
-            textStream << QString("<bookmark mark=\"%1\"/>").arg(item.text) << Qt::endl;
+            pageBookmark = QString("<bookmark mark=\"%1\"/>").arg(item.text);
         }
 
         if (!item.text.isEmpty())
@@ -380,7 +430,8 @@ int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDoc
 
             if (showText)
             {
-                textStream << item.text << Qt::endl;
+                segments.emplace_back(pageBookmark + item.text);
+                pageBookmark.clear();
             }
         }
     }
@@ -400,48 +451,102 @@ int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDoc
         PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid voice."), options.outputCodec);
         return ErrorSAPI;
     }
+    voices.clear();
 
     QFileInfo info(options.document);
     QString outputFile = QString("%1/%2.%3").arg(info.path(), info.completeBaseName(), options.textSpeechAudioFormat);
-    BSTR outputFileName = (BSTR)outputFile.utf16();
 
-    ISpeechFileStream* stream = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpFileStream, NULL, CLSCTX_ALL, __uuidof(ISpeechFileStream), (LPVOID*)&stream)))
-    {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create output stream '%1'.").arg(outputFile), options.outputCodec);
-        return ErrorSAPI;
-    }
+    pdf::PDFAudioBookWriter::AudioFormat format;
+
+    WAVEFORMATEX waveFormat = { };
+    waveFormat.wFormatTag = WAVE_FORMAT_PCM;
+    waveFormat.nChannels = WORD(format.channelCount);
+    waveFormat.nSamplesPerSec = DWORD(format.sampleRate);
+    waveFormat.wBitsPerSample = WORD(format.bitsPerSample);
+    waveFormat.nBlockAlign = WORD(format.channelCount * format.bitsPerSample / 8);
+    waveFormat.nAvgBytesPerSec = waveFormat.nSamplesPerSec * waveFormat.nBlockAlign;
+    waveFormat.cbSize = 0;
+
+    const QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/AudioBookSegments";
+    const QByteArray cacheKey = QString("%1;%2;%3;%4").arg(options.textVoiceName, options.textVoiceGender, options.textVoiceAge, options.textVoiceLangCode).toUtf8();
+    const size_t workerCount = pdf::PDFExecutionPolicy::getIdealThreadCount(pdf::PDFExecutionPolicy::Scope::Unknown);
+
+    // Each worker has its own COM apartment and voice instance
+    std::vector<ISpVoice*> workerVoices(workerCount, nullptr);
+    std::vector<char> isComInitialized(workerCount, false);
 
-    ISpVoice* voice = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
+    auto startWorker = [&](size_t workerIndex, QString& errorMessage)
     {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create voice."), options.outputCodec);
-        stream->Release();
-        return ErrorSAPI;
-    }
+        if (!SUCCEEDED(::CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+        {
+            errorMessage = PDFToolTranslationContext::tr("COM cannot be initialized.");
+            return false;
+        }
+        isComInitialized[workerIndex] = true;
+
+        PDFVoiceInfoList currentVoices;
+        fillVoices(options, currentVoices, true);
+        if (currentVoices.empty() || !currentVoices.front().getVoiceToken())
+        {
+            errorMessage = PDFToolTranslationContext::tr("Invalid voice.");
+            return false;
+        }
+
+        ISpVoice* voice = nullptr;
+        if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
+        {
+            errorMessage = PDFToolTranslationContext::tr("Cannot create voice.");
+            return false;
+        }
 
-    if (!SUCCEEDED(stream->Open(outputFileName, SSFMCreateForWrite)))
+        workerVoices[workerIndex] = voice;
+
+        if (!SUCCEEDED(voice->SetVoice(currentVoices.front().getVoiceToken())))
+        {
+            errorMessage = PDFToolTranslationContext::tr("Failed to set requested voice.");
+            return false;
+        }
+
+        return true;
+    };
+
+    auto finishWorker = [&](size_t workerIndex, QString&)
     {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create output stream '%1'.").arg(outputFile), options.outputCodec);
-        voice->Release();
-        stream->Release();
-        return ErrorSAPI;
-    }
+        if (workerVoices[workerIndex])
+        {
+            workerVoices[workerIndex]->Release();
+            workerVoices[workerIndex] = nullptr;
+        }
 
-    ISpObjectToken* voiceToken = voices.front().getVoiceToken();
-    if (!SUCCEEDED(voice->SetVoice(voiceToken)))
+        if (isComInitialized[workerIndex])
+        {
+            ::CoUninitialize();
+        }
+
+        return true;
+    };
+
+    auto synthesize = [&](size_t workerIndex, const QString& text, QByteArray& audioData, QString& errorMessage)
     {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Failed to set requested voice. Default voice will be used."), options.outputCodec);
-    }
-    voices.clear();
+        if (!synthesizeText(workerVoices[workerIndex], waveFormat, text, audioData))
+        {
+            errorMessage = PDFToolTranslationContext::tr("Cannot synthesize text '%1'.").arg(text.left(64));
+            return false;
+        }
 
-    LPCWSTR stringToSpeak = (LPCWSTR)audioString.utf16();
+        return true;
+    };
 
-    voice->SetOutput(stream, FALSE);
-    voice->Speak(stringToSpeak, SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL);
+    pdf::PDFAudioBookWriter writer(format, cacheDirectory, cacheKey);
+    writer.setWorkerCount(workerCount);
+    writer.setWorkerFunctions(startWorker, finishWorker);
 
-    voice->Release();
-    stream->Release();
+    pdf::PDFOperationResult result = writer.write(outputFile, segments, synthesize);
+    if (!result)
+    {
+        PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+        return ErrorSAPI;
+    }
 
     return ExitSuccess;
 }
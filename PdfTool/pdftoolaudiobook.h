@@ -87,6 +87,7 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+    virtual bool isConcurrentExecutionSupported() const override { return false; }
 
 private:
     int getDocumentTextFlow(const PDFToolOptions& options, pdf::PDFDocumentTextFlow& flow);
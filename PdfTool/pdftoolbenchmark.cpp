@@ -0,0 +1,629 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftoolbenchmark.h"
+#include "pdftoolrender.h"
+#include "pdffont.h"
+#include "pdfdocumentreader.h"
+#include "pdftextlayoutgenerator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QElapsedTimer>
+
+#include <map>
+#include <tuple>
+#include <atomic>
+#include <optional>
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+
+#if defined(PDF4QT_USE_PRAGMA_LIB)
+#pragma comment(lib, "psapi")
+#endif
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace pdftool
+{
+
+static PDFToolBenchmark s_toolBenchmarkApplication;
+
+QString PDFToolBenchmark::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "benchmark";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Benchmark documents");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Benchmark documents of the corpus (measure opening, object loading, page compilation and rendering, text layout and peak memory).");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+PDFToolAbstractApplication::Options PDFToolBenchmark::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument | PageSelector | ImageExportSettingsResolution | ColorManagementSystem | RenderFlags | Benchmark;
+}
+
+int PDFToolBenchmark::execute(const PDFToolOptions& options)
+{
+    const QStringList documents = getDocuments(options);
+    if (documents.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No document to benchmark."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QString errorMessage;
+    if (!options.imageExportSettings.validate(&errorMessage, false, false, true))
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    std::vector<RunResult> results;
+    for (const QString& fileName : documents)
+    {
+        if (options.benchmarkColdCache)
+        {
+            for (int run = 0; run < options.benchmarkRepeatCount; ++run)
+            {
+                RunResult result = benchmark(options, fileName, nullptr, nullptr);
+                result.run = run + 1;
+                results.push_back(qMove(result));
+            }
+        }
+
+        if (options.benchmarkWarmCache)
+        {
+            // Warm-up run is not measured, it fills the font cache (which
+            // also holds parsed content streams and decoded images) and file system cache.
+            pdf::PDFDocument warmDocument;
+            RunResult warmUpResult;
+            warmUpResult.document = fileName;
+            warmUpResult.isWarm = true;
+            warmUpResult.run = 1;
+
+            if (!readBenchmarkedDocument(options, fileName, warmDocument, warmUpResult))
+            {
+                results.push_back(qMove(warmUpResult));
+                continue;
+            }
+
+            pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+            benchmark(options, fileName, &fontCache, &warmDocument);
+
+            for (int run = 0; run < options.benchmarkRepeatCount; ++run)
+            {
+                RunResult result = benchmark(options, fileName, &fontCache, &warmDocument);
+                result.run = run + 1;
+                results.push_back(qMove(result));
+            }
+        }
+    }
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("benchmark", PDFToolTranslationContext::tr("Benchmark of %1 document(s)").arg(documents.size()));
+    formatter.endl();
+
+    writeRuns(formatter, results);
+    writeEngines(formatter, results);
+
+    if (options.benchmarkRepeatCount > 1)
+    {
+        writeSummary(formatter, results);
+    }
+
+    if (options.renderShowPageStatistics)
+    {
+        writePages(formatter, results);
+    }
+
+    formatter.endDocument();
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+
+    const bool isFailed = std::any_of(results.cbegin(), results.cend(), [](const RunResult& result) { return !result.errorMessage.isEmpty(); });
+    return isFailed ? ExitFailure : ExitSuccess;
+}
+
+QStringList PDFToolBenchmark::getDocuments(const PDFToolOptions& options)
+{
+    QStringList documents;
+
+    for (const QString& path : options.benchmarkDocuments)
+    {
+        if (!QFileInfo(path).isDir())
+        {
+            documents << path;
+            continue;
+        }
+
+        // Documents of the directory are sorted, so order of runs is deterministic
+        QStringList directoryDocuments;
+        QDirIterator it(path, QStringList() << "*.pdf" << "*.PDF", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+        {
+            directoryDocuments << it.next();
+        }
+        directoryDocuments.sort();
+        documents << directoryDocuments;
+    }
+
+    return documents;
+}
+
+bool PDFToolBenchmark::readBenchmarkedDocument(const PDFToolOptions& options, const QString& fileName, pdf::PDFDocument& document, RunResult& result)
+{
+    bool isFirstPasswordAttempt = true;
+    auto passwordCallback = [&options, &isFirstPasswordAttempt](bool* ok) -> QString
+    {
+        *ok = isFirstPasswordAttempt;
+        isFirstPasswordAttempt = false;
+        return options.password;
+    };
+
+    // Objects are loaded on demand, so reading of the cross reference table
+    // can be measured separately from the parsing of the objects.
+    pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, false);
+    reader.setObjectLoadingMode(pdf::PDFDocumentReader::ObjectLoadingMode::OnDemand);
+    if (options.lazyLoading)
+    {
+        reader.setReadingMode(pdf::PDFDocumentReader::ReadingMode::MemoryMapped);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    document = reader.readFromFile(fileName);
+    result.openTime = timer.restart();
+
+    switch (reader.getReadingResult())
+    {
+        case pdf::PDFDocumentReader::Result::OK:
+            break;
+
+        case pdf::PDFDocumentReader::Result::Cancelled:
+            result.errorMessage = PDFToolTranslationContext::tr("Invalid password provided.");
+            return false;
+
+        default:
+            result.errorMessage = PDFToolTranslationContext::tr("Error occured during document reading. %1").arg(reader.getErrorMessage());
+            return false;
+    }
+
+    // All objects are parsed (and decrypted) at once
+    document.getStorage().getObjects();
+    result.objectLoadTime = timer.elapsed();
+    return true;
+}
+
+PDFToolBenchmark::RunResult PDFToolBenchmark::benchmark(const PDFToolOptions& options,
+                                                        const QString& fileName,
+                                                        pdf::PDFFontCache* warmFontCache,
+                                                        pdf::PDFDocument* warmDocument)
+{
+    RunResult result;
+    result.document = fileName;
+    result.isWarm = warmFontCache != nullptr;
+
+    resetPeakMemoryUsage();
+
+    pdf::PDFDocument benchmarkedDocument;
+    if (!readBenchmarkedDocument(options, fileName, benchmarkedDocument, result))
+    {
+        result.peakMemory = getPeakMemoryUsage();
+        return result;
+    }
+
+    // Font cache of the warm runs belongs to the document of the warm-up
+    // run, so pages are processed using this document (it is the same file).
+    pdf::PDFDocument* document = warmDocument ? warmDocument : &benchmarkedDocument;
+
+    QString parseError;
+    std::vector<pdf::PDFInteger> pageIndices = options.getPageRange(document->getCatalog()->getPageCount(), parseError, true);
+    if (!parseError.isEmpty())
+    {
+        result.errorMessage = parseError;
+        result.peakMemory = getPeakMemoryUsage();
+        return result;
+    }
+    result.pageCount = int(pageIndices.size());
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(document);
+    cmsManager.setSettings(options.cmsSettings);
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+    pdf::PDFRenderer::Features renderFeatures = options.renderFeatures;
+    pdf::PDFRenderer::applyFidelity(options.renderFidelity, renderFeatures, meshQualitySettings);
+
+    std::optional<pdf::PDFFontCache> coldFontCache;
+    pdf::PDFFontCache* fontCache = warmFontCache;
+    if (!fontCache)
+    {
+        coldFontCache.emplace(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+        fontCache = &*coldFontCache;
+    }
+    fontCache->setDocument(pdf::PDFModifiedDocument(document, &optionalContentActivity));
+    fontCache->setCacheShrinkEnabled(nullptr, false);
+
+    std::vector<pdf::RendererEngine> engines = options.benchmarkEngines;
+    if (engines.empty())
+    {
+        engines.push_back(options.renderUseSoftwareRendering ? pdf::RendererEngine::QPainter : pdf::RendererEngine::Blend2D_SingleThread);
+    }
+
+    auto imageSizeGetter = [&options](const pdf::PDFPage* page) -> QSize
+    {
+        return PDFToolRenderBase::getPageImageSize(options, page);
+    };
+
+    for (pdf::RendererEngine engine : engines)
+    {
+        EngineResult engineResult;
+        engineResult.engine = engine;
+
+        pdf::PDFRasterizerPool rasterizerPool(document, fontCache, &cmsManager, &optionalContentActivity,
+                                              renderFeatures, meshQualitySettings,
+                                              pdf::PDFRasterizerPool::getCorrectedRasterizerCount(options.renderRasterizerCount),
+                                              engine, nullptr);
+
+        std::atomic<int> errorCount = 0;
+        QObject holder;
+        QObject::connect(&rasterizerPool, &pdf::PDFRasterizerPool::renderError, &holder, [&errorCount](pdf::PDFInteger, pdf::PDFRenderError) { ++errorCount; }, Qt::DirectConnection);
+
+        QMutex mutex;
+        auto onPageRendered = [&mutex, &engineResult](pdf::PDFRenderedPageImage& renderedPageImage)
+        {
+            // Only timings are kept, image is discarded immediately
+            renderedPageImage.pageImage = QImage();
+
+            QMutexLocker lock(&mutex);
+            engineResult.pages.push_back(renderedPageImage);
+        };
+
+        QElapsedTimer timer;
+        timer.start();
+        rasterizerPool.render(pageIndices, imageSizeGetter, onPageRendered, nullptr);
+        engineResult.wallTime = timer.elapsed();
+        engineResult.errorCount = errorCount;
+
+        std::sort(engineResult.pages.begin(), engineResult.pages.end(), [](const pdf::PDFRenderedPageImage& l, const pdf::PDFRenderedPageImage& r) { return l.pageIndex < r.pageIndex; });
+        for (const pdf::PDFRenderedPageImage& page : engineResult.pages)
+        {
+            engineResult.compileTime += page.pageCompileTime;
+            engineResult.renderTime += page.pageRenderTime;
+        }
+        engineResult.pagesRendered = int(engineResult.pages.size());
+
+        result.engines.push_back(qMove(engineResult));
+    }
+
+    // Text layouts are created in one thread, so time is comparable with page compile time
+    pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
+    QElapsedTimer textLayoutTimer;
+    textLayoutTimer.start();
+
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        const pdf::PDFPage* page = document->getCatalog()->getPage(pageIndex);
+        if (!page)
+        {
+            continue;
+        }
+
+        pdf::PDFTextLayoutGenerator generator(options.renderFeatures, page, document, fontCache, cms.data(), &optionalContentActivity, QTransform(), meshQualitySettings);
+        generator.processContents();
+        generator.createTextLayout();
+    }
+
+    result.textLayoutTime = textLayoutTimer.elapsed();
+    fontCache->setCacheShrinkEnabled(nullptr, true);
+    result.peakMemory = getPeakMemoryUsage();
+    return result;
+}
+
+void PDFToolBenchmark::writeRuns(PDFOutputFormatter& formatter, const std::vector<RunResult>& results)
+{
+    formatter.beginTable("runs", PDFToolTranslationContext::tr("Document Runs"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("document", PDFToolTranslationContext::tr("Document"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("cache", PDFToolTranslationContext::tr("Cache"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("run", PDFToolTranslationContext::tr("Run"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("pages", PDFToolTranslationContext::tr("Pages"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("open-time", PDFToolTranslationContext::tr("Open Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("object-load-time", PDFToolTranslationContext::tr("Object Load Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("text-layout-time", PDFToolTranslationContext::tr("Text Layout Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("peak-memory", PDFToolTranslationContext::tr("Peak Memory [kB]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("error", PDFToolTranslationContext::tr("Error"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (const RunResult& result : results)
+    {
+        formatter.beginTableRow("run", result.run);
+        formatter.writeTableColumn("document", result.document);
+        formatter.writeTableColumn("cache", result.isWarm ? "warm" : "cold");
+        formatter.writeTableColumn("run", QString::number(result.run), Qt::AlignRight);
+        formatter.writeTableColumn("pages", QString::number(result.pageCount), Qt::AlignRight);
+        formatter.writeTableColumn("open-time", QString::number(result.openTime), Qt::AlignRight);
+        formatter.writeTableColumn("object-load-time", QString::number(result.objectLoadTime), Qt::AlignRight);
+        formatter.writeTableColumn("text-layout-time", QString::number(result.textLayoutTime), Qt::AlignRight);
+        formatter.writeTableColumn("peak-memory", result.peakMemory >= 0 ? QString::number(result.peakMemory / 1024) : QString(), Qt::AlignRight);
+        formatter.writeTableColumn("error", result.errorMessage);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+    formatter.endl();
+}
+
+void PDFToolBenchmark::writeEngines(PDFOutputFormatter& formatter, const std::vector<RunResult>& results)
+{
+    formatter.beginTable("engines", PDFToolTranslationContext::tr("Renderer Engine Runs"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("document", PDFToolTranslationContext::tr("Document"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("cache", PDFToolTranslationContext::tr("Cache"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("run", PDFToolTranslationContext::tr("Run"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("engine", PDFToolTranslationContext::tr("Engine"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("pages-rendered", PDFToolTranslationContext::tr("Pages Rendered"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("compile-time", PDFToolTranslationContext::tr("Compile Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("render-time", PDFToolTranslationContext::tr("Render Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("wall-time", PDFToolTranslationContext::tr("Wall Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("errors", PDFToolTranslationContext::tr("Errors"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (const RunResult& result : results)
+    {
+        for (const EngineResult& engineResult : result.engines)
+        {
+            formatter.beginTableRow("engine-run", result.run);
+            formatter.writeTableColumn("document", result.document);
+            formatter.writeTableColumn("cache", result.isWarm ? "warm" : "cold");
+            formatter.writeTableColumn("run", QString::number(result.run), Qt::AlignRight);
+            formatter.writeTableColumn("engine", getEngineName(engineResult.engine));
+            formatter.writeTableColumn("pages-rendered", QString::number(engineResult.pagesRendered), Qt::AlignRight);
+            formatter.writeTableColumn("compile-time", QString::number(engineResult.compileTime), Qt::AlignRight);
+            formatter.writeTableColumn("render-time", QString::number(engineResult.renderTime), Qt::AlignRight);
+            formatter.writeTableColumn("wall-time", QString::number(engineResult.wallTime), Qt::AlignRight);
+            formatter.writeTableColumn("errors", QString::number(engineResult.errorCount), Qt::AlignRight);
+            formatter.endTableRow();
+        }
+    }
+
+    formatter.endTable();
+    formatter.endl();
+}
+
+void PDFToolBenchmark::writeSummary(PDFOutputFormatter& formatter, const std::vector<RunResult>& results)
+{
+    struct SummaryValues
+    {
+        std::vector<qint64> openTime;
+        std::vector<qint64> objectLoadTime;
+        std::vector<qint64> textLayoutTime;
+        std::vector<qint64> compileTime;
+        std::vector<qint64> renderTime;
+        std::vector<qint64> wallTime;
+    };
+
+    // Key is document, cache mode and renderer engine
+    std::map<std::tuple<QString, bool, int>, SummaryValues> summary;
+    for (const RunResult& result : results)
+    {
+        if (!result.errorMessage.isEmpty())
+        {
+            continue;
+        }
+
+        for (const EngineResult& engineResult : result.engines)
+        {
+            SummaryValues& values = summary[std::make_tuple(result.document, result.isWarm, int(engineResult.engine))];
+            values.openTime.push_back(result.openTime);
+            values.objectLoadTime.push_back(result.objectLoadTime);
+            values.textLayoutTime.push_back(result.textLayoutTime);
+            values.compileTime.push_back(engineResult.compileTime);
+            values.renderTime.push_back(engineResult.renderTime);
+            values.wallTime.push_back(engineResult.wallTime);
+        }
+    }
+
+    auto getMedian = [](std::vector<qint64> values) -> QString
+    {
+        if (values.empty())
+        {
+            return QString();
+        }
+
+        auto it = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), it, values.end());
+        return QString::number(*it);
+    };
+
+    formatter.beginTable("summary", PDFToolTranslationContext::tr("Summary (Median of Runs)"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("document", PDFToolTranslationContext::tr("Document"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("cache", PDFToolTranslationContext::tr("Cache"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("engine", PDFToolTranslationContext::tr("Engine"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("runs", PDFToolTranslationContext::tr("Runs"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("open-time", PDFToolTranslationContext::tr("Open Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("object-load-time", PDFToolTranslationContext::tr("Object Load Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("text-layout-time", PDFToolTranslationContext::tr("Text Layout Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("compile-time", PDFToolTranslationContext::tr("Compile Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("render-time", PDFToolTranslationContext::tr("Render Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("wall-time", PDFToolTranslationContext::tr("Wall Time [msec]"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (const auto& item : summary)
+    {
+        const SummaryValues& values = item.second;
+
+        formatter.beginTableRow("summary");
+        formatter.writeTableColumn("document", std::get<0>(item.first));
+        formatter.writeTableColumn("cache", std::get<1>(item.first) ? "warm" : "cold");
+        formatter.writeTableColumn("engine", getEngineName(pdf::RendererEngine(std::get<2>(item.first))));
+        formatter.writeTableColumn("runs", QString::number(values.wallTime.size()), Qt::AlignRight);
+        formatter.writeTableColumn("open-time", getMedian(values.openTime), Qt::AlignRight);
+        formatter.writeTableColumn("object-load-time", getMedian(values.objectLoadTime), Qt::AlignRight);
+        formatter.writeTableColumn("text-layout-time", getMedian(values.textLayoutTime), Qt::AlignRight);
+        formatter.writeTableColumn("compile-time", getMedian(values.compileTime), Qt::AlignRight);
+        formatter.writeTableColumn("render-time", getMedian(values.renderTime), Qt::AlignRight);
+        formatter.writeTableColumn("wall-time", getMedian(values.wallTime), Qt::AlignRight);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+    formatter.endl();
+}
+
+void PDFToolBenchmark::writePages(PDFOutputFormatter& formatter, const std::vector<RunResult>& results)
+{
+    formatter.beginTable("page-statistics", PDFToolTranslationContext::tr("Page Statistics"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("document", PDFToolTranslationContext::tr("Document"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("cache", PDFToolTranslationContext::tr("Cache"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("run", PDFToolTranslationContext::tr("Run"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("engine", PDFToolTranslationContext::tr("Engine"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("page-no", PDFToolTranslationContext::tr("Page No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("compile-time", PDFToolTranslationContext::tr("Compile Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("render-time", PDFToolTranslationContext::tr("Render Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("wait-time", PDFToolTranslationContext::tr("Wait Time [msec]"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (const RunResult& result : results)
+    {
+        for (const EngineResult& engineResult : result.engines)
+        {
+            for (const pdf::PDFRenderedPageImage& page : engineResult.pages)
+            {
+                formatter.beginTableRow("page", page.pageIndex + 1);
+                formatter.writeTableColumn("document", result.document);
+                formatter.writeTableColumn("cache", result.isWarm ? "warm" : "cold");
+                formatter.writeTableColumn("run", QString::number(result.run), Qt::AlignRight);
+                formatter.writeTableColumn("engine", getEngineName(engineResult.engine));
+                formatter.writeTableColumn("page-no", QString::number(page.pageIndex + 1), Qt::AlignRight);
+                formatter.writeTableColumn("compile-time", QString::number(page.pageCompileTime), Qt::AlignRight);
+                formatter.writeTableColumn("render-time", QString::number(page.pageRenderTime), Qt::AlignRight);
+                formatter.writeTableColumn("wait-time", QString::number(page.pageWaitTime), Qt::AlignRight);
+                formatter.endTableRow();
+            }
+        }
+    }
+
+    formatter.endTable();
+    formatter.endl();
+}
+
+QString PDFToolBenchmark::getEngineName(pdf::RendererEngine engine)
+{
+    switch (engine)
+    {
+        case pdf::RendererEngine::Blend2D_MultiThread:
+            return "blend2d-mt";
+
+        case pdf::RendererEngine::Blend2D_SingleThread:
+            return "blend2d";
+
+        case pdf::RendererEngine::QPainter:
+            return "qpainter";
+
+        case pdf::RendererEngine::QRhi:
+            return "qrhi";
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+void PDFToolBenchmark::resetPeakMemoryUsage()
+{
+#if defined(Q_OS_LINUX)
+    // Writing value 5 to this file resets peak resident set size of the process
+    QFile file("/proc/self/clear_refs");
+    if (file.open(QFile::WriteOnly))
+    {
+        file.write("5");
+        file.close();
+    }
+#endif
+}
+
+qint64 PDFToolBenchmark::getPeakMemoryUsage()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters = { };
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return qint64(counters.PeakWorkingSetSize);
+    }
+#elif defined(Q_OS_LINUX)
+    // File in proc file system has zero size, so it must be read at once
+    QFile file("/proc/self/status");
+    if (file.open(QFile::ReadOnly))
+    {
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        for (const QByteArray& line : lines)
+        {
+            // Line has format 'VmHWM:     1234 kB'
+            if (line.startsWith("VmHWM:"))
+            {
+                bool ok = false;
+                const qint64 value = line.mid(6).simplified().split(' ').value(0).toLongLong(&ok);
+                return ok ? value * 1024 : -1;
+            }
+        }
+    }
+#elif defined(Q_OS_UNIX)
+    rusage usage = { };
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#if defined(Q_OS_MACOS)
+        return qint64(usage.ru_maxrss);
+#else
+        return qint64(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+
+    return -1;
+}
+
+}   // namespace pdftool
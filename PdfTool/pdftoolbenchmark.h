@@ -0,0 +1,110 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFTOOLBENCHMARK_H
+#define PDFTOOLBENCHMARK_H
+
+#include "pdftoolabstractapplication.h"
+
+namespace pdf
+{
+class PDFFontCache;
+}
+
+namespace pdftool
+{
+
+/// Benchmarks whole documents of the corpus. For each document and each run,
+/// time of document opening (reading of cross reference table), loading of all
+/// objects, compilation and rendering of selected pages by each renderer engine,
+/// and creation of text layouts is measured, together with peak memory usage.
+/// Documents can be measured repeatedly, in cold runs (nothing is reused from
+/// previous runs) and warm runs (font cache of the unmeasured warm-up run is reused).
+/// Results are written by the output formatter, so json or csv output can be
+/// used to compare results of two builds.
+class PDFToolBenchmark : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+    virtual bool isConcurrentExecutionSupported() const override { return false; }
+
+private:
+    struct EngineResult
+    {
+        pdf::RendererEngine engine = pdf::RendererEngine::QPainter;
+        int pagesRendered = 0;
+        int errorCount = 0;
+        qint64 compileTime = 0;
+        qint64 renderTime = 0;
+        qint64 wallTime = 0;
+        std::vector<pdf::PDFRenderedPageImage> pages; ///< Timings of rendered pages (images are not stored)
+    };
+
+    struct RunResult
+    {
+        QString document;
+        bool isWarm = false;
+        int run = 0;
+        int pageCount = 0;
+        qint64 openTime = 0;
+        qint64 objectLoadTime = 0;
+        qint64 textLayoutTime = 0;
+        qint64 peakMemory = -1;
+        QString errorMessage;
+        std::vector<EngineResult> engines;
+    };
+
+    /// Returns list of benchmarked documents, directories are expanded
+    /// to all pdf files in them (including subdirectories).
+    /// \param options Options
+    static QStringList getDocuments(const PDFToolOptions& options);
+
+    /// Performs single run of the document
+    /// \param options Options
+    /// \param document Benchmarked document file name
+    /// \param warmFontCache Font cache reused between warm runs (nullptr for cold run)
+    /// \param warmDocument Document, to which font cache belongs (nullptr for cold run)
+    RunResult benchmark(const PDFToolOptions& options, const QString& document, pdf::PDFFontCache* warmFontCache, pdf::PDFDocument* warmDocument);
+
+    /// Reads the document, opening and object loading times are measured
+    /// \param options Options
+    /// \param fileName Document file name
+    /// \param document Read document
+    /// \param result Result of the run
+    bool readBenchmarkedDocument(const PDFToolOptions& options, const QString& fileName, pdf::PDFDocument& document, RunResult& result);
+
+    void writeRuns(PDFOutputFormatter& formatter, const std::vector<RunResult>& results);
+    void writeEngines(PDFOutputFormatter& formatter, const std::vector<RunResult>& results);
+    void writeSummary(PDFOutputFormatter& formatter, const std::vector<RunResult>& results);
+    void writePages(PDFOutputFormatter& formatter, const std::vector<RunResult>& results);
+
+    static QString getEngineName(pdf::RendererEngine engine);
+
+    /// Resets peak memory usage of the process (if it is supported by the platform)
+    static void resetPeakMemoryUsage();
+
+    /// Returns peak memory usage of the process in bytes, or -1, if it can't be determined.
+    /// If peak memory usage can't be reset, it is the peak usage since the process start.
+    static qint64 getPeakMemoryUsage();
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLBENCHMARK_H
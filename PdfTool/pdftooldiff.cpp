@@ -19,6 +19,16 @@
 
 #include "pdfdiff.h"
 #include "pdfdocumentreader.h"
+#include "pdfexception.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QXmlStreamWriter>
+
+#include <atomic>
+#include <thread>
 
 namespace pdftool
 {
@@ -48,6 +58,11 @@ QString PDFToolDiff::getStandardString(PDFToolAbstractApplication::StandardStrin
 
 int PDFToolDiff::execute(const PDFToolOptions& options)
 {
+    if (!options.diffManifest.isEmpty())
+    {
+        return executeManifest(options);
+    }
+
     if (options.diffFiles.size() != 2)
     {
         PDFConsole::writeError(PDFToolTranslationContext::tr("Exactly two documents must be specified."), options.outputCodec);
@@ -78,10 +93,53 @@ int PDFToolDiff::execute(const PDFToolOptions& options)
 
     pdf::PDFDiff diff(nullptr);
     diff.setOption(pdf::PDFDiff::Asynchronous, false);
+    diff.setOption(pdf::PDFDiff::StopAtFirstDifference, options.diffStopAtFirstDifference);
     diff.setLeftDocument(&leftDocument);
     diff.setRightDocument(&rightDocument);
     diff.setPagesForLeftDocument(std::move(leftPages));
     diff.setPagesForRightDocument(std::move(rightPages));
+
+    // XML report is written progressively, differences are written
+    // as they are found (in the order of pages), so the first differences are
+    // available before the whole documents are compared.
+    const bool isXmlWrittenProgressively = options.outputStyle == PDFOutputFormatter::Style::Xml;
+    QString xml;
+    QXmlStreamWriter xmlStream(&xml);
+    QMutex xmlMutex;
+    bool isXmlStarted = false;
+    size_t xmlDifferencesCount = 0;
+
+    auto writeXmlDifferences = [&]()
+    {
+        QMutexLocker lock(&xmlMutex);
+
+        if (!isXmlStarted)
+        {
+            isXmlStarted = true;
+            xmlStream.setAutoFormatting(true);
+            xmlStream.setAutoFormattingIndent(2);
+            xmlStream.writeStartDocument();
+            xmlStream.writeNamespace("https://github.com/JakubMelka/PDF4QT", "pdf4qt");
+            xmlStream.writeStartElement("difference-report");
+            xmlStream.writeStartElement("differences");
+        }
+
+        pdf::PDFDiffResult partialResult = diff.getPartialResult();
+        for (; xmlDifferencesCount < partialResult.getDifferencesCount(); ++xmlDifferencesCount)
+        {
+            partialResult.saveDifferenceToXML(&xmlStream, xmlDifferencesCount);
+        }
+
+        PDFConsole::writeText(xml, options.outputCodec);
+        xml.clear();
+    };
+
+    if (isXmlWrittenProgressively)
+    {
+        // Signal is emitted from the comparation thread, we must use direct connection
+        QObject::connect(&diff, &pdf::PDFDiff::partialResultAvailable, &diff, writeXmlDifferences, Qt::DirectConnection);
+    }
+
     diff.start();
 
     QLocale locale;
@@ -124,10 +182,14 @@ int PDFToolDiff::execute(const PDFToolOptions& options)
         formatter.endTable();
         formatter.endDocument();
 
-        if (options.outputStyle == PDFOutputFormatter::Style::Xml)
+        if (isXmlWrittenProgressively)
         {
-            QString xml;
-            result.saveToXML(&xml);
+            writeXmlDifferences();
+
+            xmlStream.writeEndElement();
+            result.savePageSequenceToXML(&xmlStream);
+            xmlStream.writeEndElement();
+            xmlStream.writeEndDocument();
             PDFConsole::writeText(xml, options.outputCodec);
         }
         else
@@ -144,6 +206,146 @@ int PDFToolDiff::execute(const PDFToolOptions& options)
     return ExitSuccess;
 }
 
+int PDFToolDiff::executeManifest(const PDFToolOptions& options)
+{
+    QFile file;
+    bool isOpened = false;
+    if (options.diffManifest == "-")
+    {
+        isOpened = file.open(stdin, QFile::ReadOnly | QFile::Text);
+    }
+    else
+    {
+        file.setFileName(options.diffManifest);
+        isOpened = file.open(QFile::ReadOnly | QFile::Text);
+    }
+
+    if (!isOpened)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open diff manifest '%1'.").arg(options.diffManifest), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    std::vector<std::pair<QString, QString>> pairs;
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+    {
+        QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+        {
+            continue;
+        }
+
+        QStringList files = line.split('\t', Qt::SkipEmptyParts);
+        if (files.size() != 2)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid diff manifest line '%1', exactly two documents must be specified.").arg(line), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+
+        pairs.emplace_back(files.front().trimmed(), files.back().trimmed());
+    }
+    file.close();
+
+    const size_t pairCount = pairs.size();
+    const size_t jobCount = qBound<size_t>(1, options.diffJobs, qMax<size_t>(pairCount, 1));
+
+    std::atomic<size_t> nextPair = 0;
+    std::atomic_bool isFailed = false;
+    auto worker = [&]()
+    {
+        for (size_t i = nextPair++; i < pairCount; i = nextPair++)
+        {
+            const QString& leftFileName = pairs[i].first;
+            const QString& rightFileName = pairs[i].second;
+
+            QString errorMessage;
+            pdf::PDFDiffResult result;
+
+            try
+            {
+                pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, options.permissiveReading, false);
+
+                pdf::PDFDocument leftDocument = reader.readFromFile(leftFileName);
+                if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+                {
+                    throw pdf::PDFException(PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(leftFileName));
+                }
+
+                pdf::PDFDocument rightDocument = reader.readFromFile(rightFileName);
+                if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+                {
+                    throw pdf::PDFException(PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(rightFileName));
+                }
+
+                pdf::PDFClosedIntervalSet leftPages;
+                leftPages.addInterval(0, leftDocument.getCatalog()->getPageCount() - 1);
+
+                pdf::PDFClosedIntervalSet rightPages;
+                rightPages.addInterval(0, rightDocument.getCatalog()->getPageCount() - 1);
+
+                pdf::PDFDiff diff(nullptr);
+                diff.setOption(pdf::PDFDiff::Asynchronous, false);
+                diff.setOption(pdf::PDFDiff::StopAtFirstDifference, options.diffStopAtFirstDifference);
+                diff.setLeftDocument(&leftDocument);
+                diff.setRightDocument(&rightDocument);
+                diff.setPagesForLeftDocument(std::move(leftPages));
+                diff.setPagesForRightDocument(std::move(rightPages));
+                diff.start();
+
+                result = diff.getResult();
+                if (!result.getResult())
+                {
+                    errorMessage = result.getResult().getErrorMessage();
+                }
+            }
+            catch (const pdf::PDFException& exception)
+            {
+                errorMessage = exception.getMessage();
+            }
+
+            // Summary record: status, number of differences, page numbers of the first
+            // difference (or '-'), left and right document, separated by tabulators
+            QString record;
+            if (errorMessage.isEmpty())
+            {
+                auto getPageNumber = [](pdf::PDFInteger pageIndex) { return pageIndex != -1 ? QString::number(pageIndex + 1) : QString("-"); };
+
+                const bool isChanged = result.isChanged();
+                record = QString("%1\t%2\t%3\t%4\t%5\t%6\n").arg(isChanged ? "CHANGED" : "SAME")
+                                                               .arg(result.getDifferencesCount())
+                                                               .arg(isChanged ? getPageNumber(result.getLeftPage(0)) : QString("-"))
+                                                               .arg(isChanged ? getPageNumber(result.getRightPage(0)) : QString("-"))
+                                                               .arg(leftFileName, rightFileName);
+            }
+            else
+            {
+                isFailed = true;
+                PDFConsole::writeError(errorMessage, options.outputCodec);
+                record = QString("FAILED\t-\t-\t-\t%1\t%2\n").arg(leftFileName, rightFileName);
+            }
+
+            PDFConsole::writeText(record, options.outputCodec);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobCount - 1);
+    for (size_t i = 1; i < jobCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    return isFailed ? ExitFailure : ExitSuccess;
+}
+
 PDFToolAbstractApplication::Options PDFToolDiff::getOptionsFlags() const
 {
     return ConsoleFormat | Diff;
@@ -29,6 +29,14 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+
+private:
+    /// Compares document pairs listed in the manifest. Pairs are compared
+    /// in one process (so process-wide caches, such as system fonts
+    /// or character maps, are reused), using given number of worker
+    /// threads. For each pair, one summary record is written.
+    /// \param options Options
+    int executeManifest(const PDFToolOptions& options);
 };
 
 }   // namespace pdftool
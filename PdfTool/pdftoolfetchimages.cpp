@@ -20,6 +20,7 @@
 #include "pdfconstants.h"
 #include "pdfexecutionpolicy.h"
 
+#include <QFile>
 #include <QCryptographicHash>
 
 namespace pdftool
@@ -53,10 +54,12 @@ protected:
     virtual bool isContentSuppressedByOC(pdf::PDFObjectReference ocgOrOcmd) override;
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
     virtual void performImagePainting(const QImage& image) override;
+    virtual bool isImageXObjectSkipped(pdf::PDFObjectReference reference, const pdf::PDFStream* stream) override;
 
 private:
     pdf::PDFInteger m_pageIndex;
     pdf::PDFInteger m_order;
+    pdf::PDFObjectReference m_reference;
     PDFToolFetchImages* m_tool;
 };
 
@@ -92,7 +95,22 @@ bool PDFImageContentExtractorProcessor::isContentKindSuppressed(ContentKind kind
 
 void PDFImageContentExtractorProcessor::performImagePainting(const QImage& image)
 {
-    m_tool->onImageExtracted(m_pageIndex, m_order++, image);
+    m_tool->onImageExtracted(m_pageIndex, m_order++, m_reference, image);
+    m_reference = pdf::PDFObjectReference();
+}
+
+bool PDFImageContentExtractorProcessor::isImageXObjectSkipped(pdf::PDFObjectReference reference, const pdf::PDFStream* stream)
+{
+    if (m_tool->onImageXObjectFound(m_pageIndex, m_order, reference, stream))
+    {
+        m_reference = pdf::PDFObjectReference();
+        ++m_order;
+        return true;
+    }
+
+    // Image will be decoded and painted, remember its reference
+    m_reference = reference;
+    return false;
 }
 
 QString PDFToolFetchImages::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
@@ -160,6 +178,12 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
     fontCache.setDocument(md);
     fontCache.setCacheShrinkEnabled(nullptr, false);
 
+    m_document = &document;
+    m_isRawExport = options.imageRawExport;
+    m_images.clear();
+    m_extractedReferences.clear();
+    m_extractedHashes.clear();
+
     auto processPageContents = [&, this](pdf::PDFInteger pageIndex)
     {
         const pdf::PDFCatalog* catalog = document.getCatalog();
@@ -177,14 +201,31 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
         processor.processContents();
     };
 
-    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, pageIndices.begin(), pageIndices.end(), processPageContents);
-    fontCache.setCacheShrinkEnabled(nullptr, true);
-
-    auto comparator = [](const Image& left, const Image& right) -> bool
+    // Store images to the disk file
+    auto saveImage = [&options](const Image& image)
     {
-        return std::make_pair(left.pageIndex, left.order) < std::make_pair(right.pageIndex, right.order);
+        if (!image.rawData.isEmpty())
+        {
+            QFile file(image.fileName);
+            if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(image.rawData) != image.rawData.size())
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(image.fileName).arg(file.errorString()), options.outputCodec);
+            }
+            return;
+        }
+
+        QImageWriter imageWriter(image.fileName, options.imageWriterSettings.getCurrentFormat());
+        imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
+        imageWriter.setCompression(options.imageWriterSettings.getCompression());
+        imageWriter.setQuality(options.imageWriterSettings.getQuality());
+        imageWriter.setOptimizedWrite(options.imageWriterSettings.hasOptimizedWrite());
+        imageWriter.setProgressiveScanWrite(options.imageWriterSettings.hasProgressiveScanWrite());
+
+        if (!imageWriter.write(image.image))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(image.fileName).arg(imageWriter.errorString()), options.outputCodec);
+        }
     };
-    std::sort(m_images.begin(), m_images.end(), comparator);
 
     // Write information about images
     PDFOutputFormatter formatter(options.outputStyle);
@@ -204,84 +245,167 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
 
     QLocale locale;
 
-    for (size_t i = 0; i < m_images.size(); ++i)
+    // Pages are processed in batches, and images found in the batch
+    // are written to the disk, before next batch is processed, so decoded images
+    // of the whole document are never held in memory at once. Images are sorted
+    // in the batch, so image numbering doesn't depend on thread scheduling.
+    const size_t batchSize = size_t(qMax(QThread::idealThreadCount(), 1)) * PAGE_BATCH_SIZE_PER_THREAD;
+    size_t imageCount = 0;
+
+    for (size_t batchStart = 0; batchStart < pageIndices.size(); batchStart += batchSize)
     {
-        Image& image = m_images[i];
-        image.fileName = options.imageExportSettings.getOutputFileName(pdf::PDFInteger(i), options.imageWriterSettings.getCurrentFormat());
+        auto batchBegin = std::next(pageIndices.begin(), batchStart);
+        auto batchEnd = std::next(pageIndices.begin(), qMin(batchStart + batchSize, pageIndices.size()));
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, batchBegin, batchEnd, processPageContents);
 
-        formatter.beginTableRow("image", int(i));
+        auto comparator = [](const Image& left, const Image& right) -> bool
+        {
+            return std::make_pair(left.pageIndex, left.order) < std::make_pair(right.pageIndex, right.order);
+        };
+        std::sort(m_images.begin(), m_images.end(), comparator);
 
-        formatter.writeTableColumn("item-no", locale.toString(i + 1), Qt::AlignRight);
-        formatter.writeTableColumn("page-no", locale.toString(image.pageIndex + 1), Qt::AlignRight);
-        formatter.writeTableColumn("width", locale.toString(image.image.width()), Qt::AlignRight);
-        formatter.writeTableColumn("height", locale.toString(image.image.height()), Qt::AlignRight);
-        formatter.writeTableColumn("size", locale.toString(image.image.sizeInBytes()), Qt::AlignRight);
-        formatter.writeTableColumn("stored-to", image.fileName);
+        Images images;
+        for (Image& image : m_images)
+        {
+            // Deduplicate images - by reference first, then by hash of pixels
+            if (image.reference.isValid() && !m_extractedReferences.insert(image.reference).second)
+            {
+                continue;
+            }
+
+            if (m_extractedHashes.contains(image.hash))
+            {
+                continue;
+            }
+            m_extractedHashes.insert(image.hash);
+
+            const QByteArray format = !image.rawData.isEmpty() ? image.rawFormat : options.imageWriterSettings.getCurrentFormat();
+            image.fileName = options.imageExportSettings.getOutputFileName(pdf::PDFInteger(imageCount), format);
+            const qint64 size = !image.rawData.isEmpty() ? image.rawData.size() : image.image.sizeInBytes();
+
+            formatter.beginTableRow("image", int(imageCount));
+
+            formatter.writeTableColumn("item-no", locale.toString(imageCount + 1), Qt::AlignRight);
+            formatter.writeTableColumn("page-no", locale.toString(image.pageIndex + 1), Qt::AlignRight);
+            formatter.writeTableColumn("width", locale.toString(image.size.width()), Qt::AlignRight);
+            formatter.writeTableColumn("height", locale.toString(image.size.height()), Qt::AlignRight);
+            formatter.writeTableColumn("size", locale.toString(size), Qt::AlignRight);
+            formatter.writeTableColumn("stored-to", image.fileName);
+
+            formatter.endTableRow();
+
+            ++imageCount;
+            images.emplace_back(qMove(image));
+        }
+        m_images.clear();
 
-        formatter.endTableRow();
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, images.cbegin(), images.cend(), saveImage);
     }
 
+    fontCache.setCacheShrinkEnabled(nullptr, true);
+    m_document = nullptr;
+
     formatter.endTable();
 
     formatter.endDocument();
     PDFConsole::writeText(formatter.getString(), options.outputCodec);
 
-    // Store images to the disk file
-    auto saveImage = [this, &options](size_t index)
-    {
-        Image& image = m_images[index];
-
-        QImageWriter imageWriter(image.fileName, options.imageWriterSettings.getCurrentFormat());
-        imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
-        imageWriter.setCompression(options.imageWriterSettings.getCompression());
-        imageWriter.setQuality(options.imageWriterSettings.getQuality());
-        imageWriter.setOptimizedWrite(options.imageWriterSettings.hasOptimizedWrite());
-        imageWriter.setProgressiveScanWrite(options.imageWriterSettings.hasProgressiveScanWrite());
-
-        if (!imageWriter.write(image.image))
-        {
-            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(image.fileName).arg(imageWriter.errorString()), options.outputCodec);
-        }
-    };
-
-    auto imageRange = pdf::PDFIntegerRange<size_t>(0, m_images.size());
-    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, imageRange.begin(), imageRange.end(), saveImage);
-
     return ExitSuccess;
 }
 
 PDFToolAbstractApplication::Options PDFToolFetchImages::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | PageSelector | ImageWriterSettings | ImageExportSettingsFiles | ColorManagementSystem;
+    return ConsoleFormat | OpenDocument | PageSelector | ImageWriterSettings | ImageExportSettingsFiles | ImageRawExport | ColorManagementSystem;
 }
 
-void PDFToolFetchImages::onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, const QImage& image)
+QByteArray PDFToolFetchImages::computeHash(const QImage& image)
 {
-    QCryptographicHash hasher(QCryptographicHash::Sha512);
-    QByteArrayView imageData(image.bits(), image.sizeInBytes());
-    hasher.addData(imageData);
-    QByteArray hash = hasher.result();
+    QCryptographicHash hasher(QCryptographicHash::Md5);
+    const int header[] = { image.width(), image.height(), int(image.format()) };
+    hasher.addData(QByteArrayView(reinterpret_cast<const char*>(header), sizeof(header)));
+    hasher.addData(QByteArrayView(image.bits(), image.sizeInBytes()));
+    return hasher.result();
+}
+
+void PDFToolFetchImages::onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, pdf::PDFObjectReference reference, const QImage& image)
+{
+    Image imageStructure;
+    imageStructure.hash = computeHash(image);
+    imageStructure.reference = reference;
+    imageStructure.pageIndex = pageIndex;
+    imageStructure.order = order;
+    imageStructure.image = image;
+    imageStructure.size = image.size();
 
     QMutexLocker lock(&m_mutex);
-    auto it = std::find_if(m_images.begin(), m_images.end(), [&hash](const Image& image) { return image.hash == hash; });
-    if (it == m_images.cend())
+    m_images.emplace_back(qMove(imageStructure));
+}
+
+bool PDFToolFetchImages::onImageXObjectFound(pdf::PDFInteger pageIndex, pdf::PDFInteger order, pdf::PDFObjectReference reference, const pdf::PDFStream* stream)
+{
+    if (reference.isValid() && m_extractedReferences.count(reference))
     {
-        Image imageStructure;
-        imageStructure.hash = hash;
-        imageStructure.pageIndex = pageIndex;
-        imageStructure.order = order;
-        imageStructure.image = image;
-        m_images.emplace_back(qMove(imageStructure));
+        // Image was already extracted from some of the previous pages
+        return true;
     }
-    else
+
+    if (!m_isRawExport)
     {
-        Image& imageStructure = *it;
-        if (imageStructure.pageIndex > pageIndex)
+        return false;
+    }
+
+    // Find the image filter (last filter of the stream)
+    const pdf::PDFDictionary* dictionary = stream->getDictionary();
+    const pdf::PDFObject& filterObject = m_document->getObject(dictionary->get("Filter"));
+    QByteArray filterName;
+    if (filterObject.isName())
+    {
+        filterName = filterObject.getString();
+    }
+    else if (filterObject.isArray() && filterObject.getArray()->getCount() > 0)
+    {
+        const pdf::PDFArray* filterArray = filterObject.getArray();
+        const pdf::PDFObject& lastFilterObject = m_document->getObject(filterArray->getItem(filterArray->getCount() - 1));
+        if (lastFilterObject.isName())
         {
-            imageStructure.pageIndex = pageIndex;
-            imageStructure.order = order;
+            filterName = lastFilterObject.getString();
         }
     }
+
+    QByteArray rawFormat;
+    if (filterName == "DCTDecode" || filterName == "DCT")
+    {
+        rawFormat = "jpg";
+    }
+    else if (filterName == "JPXDecode")
+    {
+        rawFormat = "jp2";
+    }
+    else
+    {
+        // Image must be decoded
+        return false;
+    }
+
+    // Other filters than the image filter are decoded, image data are written as they are
+    pdf::PDFDocumentDataLoaderDecorator loader(m_document);
+    Image imageStructure;
+    imageStructure.rawData = m_document->getDecodedStream(stream);
+    imageStructure.rawFormat = rawFormat;
+    imageStructure.hash = QCryptographicHash::hash(imageStructure.rawData, QCryptographicHash::Md5);
+    imageStructure.reference = reference;
+    imageStructure.pageIndex = pageIndex;
+    imageStructure.order = order;
+    imageStructure.size = QSize(int(loader.readIntegerFromDictionary(dictionary, "Width", 0)), int(loader.readIntegerFromDictionary(dictionary, "Height", 0)));
+
+    if (imageStructure.rawData.isEmpty())
+    {
+        return false;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_images.emplace_back(qMove(imageStructure));
+    return true;
 }
 
 }   // namespace pdftool
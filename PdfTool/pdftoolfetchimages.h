@@ -20,8 +20,11 @@
 
 #include "pdftoolabstractapplication.h"
 
+#include <QSet>
 #include <QMutex>
 
+#include <set>
+
 namespace pdftool
 {
 
@@ -31,22 +34,53 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+    virtual bool isConcurrentExecutionSupported() const override { return false; }
+
+    void onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, pdf::PDFObjectReference reference, const QImage& image);
 
-    void onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, const QImage& image);
+    /// Called, when image XObject is found in the page content. Returns true,
+    /// if image should be skipped (it was already extracted, or it is
+    /// written without decoding).
+    /// \param pageIndex Page index
+    /// \param order Order of the image on the page
+    /// \param reference Reference of the image XObject
+    /// \param stream Image stream
+    bool onImageXObjectFound(pdf::PDFInteger pageIndex, pdf::PDFInteger order, pdf::PDFObjectReference reference, const pdf::PDFStream* stream);
 
 private:
     struct Image
     {
         QByteArray hash;
+        pdf::PDFObjectReference reference;
         pdf::PDFInteger pageIndex = 0;
         pdf::PDFInteger order = 0;
         QImage image;
+        QByteArray rawData;     ///< Image data written without decoding
+        QByteArray rawFormat;   ///< Format of raw data (file suffix)
+        QSize size;
         QString fileName;
     };
     using Images = std::vector<Image>;
 
+    /// Number of pages processed at once. Images found on these pages are
+    /// written to the disk, before next pages are processed.
+    static constexpr size_t PAGE_BATCH_SIZE_PER_THREAD = 4;
+
+    /// Computes hash of image pixels
+    static QByteArray computeHash(const QImage& image);
+
+    const pdf::PDFDocument* m_document = nullptr;
+    bool m_isRawExport = false;
+
     QMutex m_mutex;
-    Images m_images;
+    Images m_images;  ///< Images found in the currently processed pages
+
+    /// References of already extracted images. It is not modified,
+    /// while pages are processed, so it can be read without a lock.
+    std::set<pdf::PDFObjectReference> m_extractedReferences;
+
+    /// Hashes of already extracted images
+    QSet<QByteArray> m_extractedHashes;
 };
 
 }   // namespace pdftool
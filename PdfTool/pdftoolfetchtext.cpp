@@ -17,6 +17,10 @@
 
 #include "pdftoolfetchtext.h"
 #include "pdfdocumenttextflow.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QJsonObject>
+#include <QJsonDocument>
 
 namespace pdftool
 {
@@ -69,35 +73,112 @@ int PDFToolFetchTextApplication::execute(const PDFToolOptions& options)
     }
 
     pdf::PDFDocumentTextFlowFactory factory;
-    pdf::PDFDocumentTextFlow documentTextFlow = factory.create(&document, pages, options.textAnalysisAlgorithm);
 
-    PDFOutputFormatter formatter(options.outputStyle);
-    formatter.beginDocument("text-extraction", QString());
-    formatter.endl();
+    if (!options.textStream)
+    {
+        pdf::PDFDocumentTextFlow documentTextFlow = factory.create(&document, pages, options.textAnalysisAlgorithm);
+
+        PDFOutputFormatter formatter(options.outputStyle);
+        formatter.beginDocument("text-extraction", QString());
+        formatter.endl();
+        writeTextFlow(formatter, documentTextFlow, options);
+        formatter.endDocument();
+
+        for (const pdf::PDFRenderError& error : factory.getErrors())
+        {
+            PDFConsole::writeError(error.getMessage(), options.outputCodec);
+        }
+
+        PDFConsole::writeText(formatter.getString(), options.outputCodec);
+        return ExitSuccess;
+    }
+
+    // In stream mode, text is extracted page by page, and text of each page
+    // is written as soon as the page (and all previous pages) are processed. So memory
+    // consumption doesn't depend on the page count of the document.
+    const size_t maxPagesInFlight = options.textStreamPages > 0 ? size_t(options.textStreamPages)
+                                                                : size_t(4 * pdf::PDFExecutionPolicy::getIdealThreadCount(pdf::PDFExecutionPolicy::Scope::Page));
+
+    if (options.textJsonLines)
+    {
+        auto writePageTextFlow = [&options](pdf::PDFInteger pageIndex, pdf::PDFDocumentTextFlow&& textFlow)
+        {
+            QString jsonLines;
+
+            if (pageIndex == -1)
+            {
+                // Text flow of the whole document, split it to the pages
+                for (const auto& [splitPageIndex, pageTextFlow] : textFlow.split(pdf::PDFDocumentTextFlow::Flags(0xFFFF)))
+                {
+                    jsonLines += getJsonLine(splitPageIndex, pageTextFlow, options);
+                }
+            }
+            else
+            {
+                jsonLines = getJsonLine(pageIndex, textFlow, options);
+            }
+
+            PDFConsole::writeText(jsonLines, options.outputCodec);
+        };
+
+        factory.createPageByPage(&document, pages, options.textAnalysisAlgorithm, maxPagesInFlight, writePageTextFlow);
+    }
+    else
+    {
+        PDFOutputFormatter formatter(options.outputStyle);
+        formatter.beginDocument("text-extraction", QString());
+        formatter.endl();
+
+        auto writePageTextFlow = [&formatter, &options](pdf::PDFInteger, pdf::PDFDocumentTextFlow&& textFlow)
+        {
+            writeTextFlow(formatter, textFlow, options);
+            PDFConsole::writeText(formatter.takeString(), options.outputCodec);
+        };
+
+        factory.createPageByPage(&document, pages, options.textAnalysisAlgorithm, maxPagesInFlight, writePageTextFlow);
+
+        formatter.endDocument();
+        PDFConsole::writeText(formatter.takeString(), options.outputCodec);
+    }
+
+    for (const pdf::PDFRenderError& error : factory.getErrors())
+    {
+        PDFConsole::writeError(error.getMessage(), options.outputCodec);
+    }
+
+    return ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolFetchTextApplication::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument | PageSelector | TextAnalysis | TextShow | TextStream;
+}
 
-    for (const pdf::PDFDocumentTextFlow::Item& item : documentTextFlow.getItems())
+bool PDFToolFetchTextApplication::isTextShown(const pdf::PDFDocumentTextFlow::Item& item, const PDFToolOptions& options)
+{
+    return (item.flags.testFlag(pdf::PDFDocumentTextFlow::Text)) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart) && options.textShowPageNumbers) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageEnd) && options.textShowPageNumbers) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureTitle) && options.textShowStructTitles) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureLanguage) && options.textShowStructLanguage) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureAlternativeDescription) && options.textShowStructAlternativeDescription) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureExpandedForm) && options.textShowStructExpandedForm) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureActualText) && options.textShowStructActualText) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructurePhoneme) && options.textShowStructPhoneme);
+}
+
+void PDFToolFetchTextApplication::writeTextFlow(PDFOutputFormatter& formatter, const pdf::PDFDocumentTextFlow& textFlow, const PDFToolOptions& options)
+{
+    for (const pdf::PDFDocumentTextFlow::Item& item : textFlow.getItems())
     {
         if (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureItemStart))
         {
             formatter.beginHeader("item", item.text);
         }
 
-        if (!item.text.isEmpty())
+        if (!item.text.isEmpty() && isTextShown(item, options))
         {
-            bool showText = (item.flags.testFlag(pdf::PDFDocumentTextFlow::Text)) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart) && options.textShowPageNumbers) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageEnd) && options.textShowPageNumbers) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureTitle) && options.textShowStructTitles) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureLanguage) && options.textShowStructLanguage) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureAlternativeDescription) && options.textShowStructAlternativeDescription) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureExpandedForm) && options.textShowStructExpandedForm) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureActualText) && options.textShowStructActualText) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructurePhoneme) && options.textShowStructPhoneme);
-
-            if (showText)
-            {
-                formatter.writeText("text", item.text);
-            }
+            formatter.writeText("text", item.text);
         }
 
         if (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureItemEnd))
@@ -110,22 +191,25 @@ int PDFToolFetchTextApplication::execute(const PDFToolOptions& options)
             formatter.endl();
         }
     }
+}
 
-    formatter.endDocument();
-
-    for (const pdf::PDFRenderError& error : factory.getErrors())
+QString PDFToolFetchTextApplication::getJsonLine(pdf::PDFInteger pageIndex, const pdf::PDFDocumentTextFlow& textFlow, const PDFToolOptions& options)
+{
+    QStringList texts;
+    for (const pdf::PDFDocumentTextFlow::Item& item : textFlow.getItems())
     {
-        PDFConsole::writeError(error.message, options.outputCodec);
+        // Page number is stored in the separate value
+        if (!item.text.isEmpty() && isTextShown(item, options) && !item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart))
+        {
+            texts << item.text;
+        }
     }
 
-    PDFConsole::writeText(formatter.getString(), options.outputCodec);
-
-    return ExitSuccess;
-}
+    QJsonObject object;
+    object["page"] = pageIndex + 1;
+    object["text"] = texts.join(QChar('\n'));
 
-PDFToolAbstractApplication::Options PDFToolFetchTextApplication::getOptionsFlags() const
-{
-    return ConsoleFormat | OpenDocument | PageSelector | TextAnalysis | TextShow;
+    return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact)) + QChar('\n');
 }
 
 }   // namespace pdftool
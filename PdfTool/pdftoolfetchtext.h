@@ -29,6 +29,16 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+
+private:
+    /// Returns true, if text of the item should be written to the output
+    static bool isTextShown(const pdf::PDFDocumentTextFlow::Item& item, const PDFToolOptions& options);
+
+    /// Writes items of the text flow to the formatter
+    static void writeTextFlow(PDFOutputFormatter& formatter, const pdf::PDFDocumentTextFlow& textFlow, const PDFToolOptions& options);
+
+    /// Returns JSON line (compact JSON object terminated by new line) with text of the page
+    static QString getJsonLine(pdf::PDFInteger pageIndex, const pdf::PDFDocumentTextFlow& textFlow, const PDFToolOptions& options);
 };
 
 }   // namespace pdftool
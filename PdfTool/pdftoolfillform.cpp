@@ -0,0 +1,538 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolfillform.h"
+#include "pdfform.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfdocumentwriter.h"
+#include "pdfexception.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include <map>
+#include <atomic>
+#include <thread>
+
+namespace pdftool
+{
+
+static PDFToolFillForm s_fillFormApplication;
+
+QString PDFToolFillForm::getStandardString(StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "fill-form";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Fill form");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Fill form fields of the template document using records and write one document per record.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolFillForm::execute(const PDFToolOptions& options)
+{
+    if (options.formFillRecords.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No records have been specified."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    if (!options.formFillOutputPattern.contains("%"))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("File template must contain character '%' for record number."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    pdf::PDFDocument document;
+    QByteArray sourceData;
+    if (!readDocument(options, document, &sourceData, false))
+    {
+        return ErrorDocumentReading;
+    }
+
+    if (!document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::ModifyFormFields))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Document doesn't allow to fill interactive forms."), options.outputCodec);
+        return ErrorPermissions;
+    }
+
+    QString errorMessage;
+    std::vector<Record> records = readRecords(options, errorMessage);
+    if (!errorMessage.isEmpty())
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    // Template document is shared by all workers, each record creates
+    // a shallow copy of it, so unchanged objects are shared between outputs.
+    const size_t recordCount = records.size();
+    const size_t jobCount = qBound<size_t>(1, options.formFillJobs, qMax<size_t>(recordCount, 1));
+
+    std::atomic<size_t> nextRecord = 0;
+    std::atomic_bool isFailed = false;
+    auto worker = [&]()
+    {
+        for (size_t i = nextRecord++; i < recordCount; i = nextRecord++)
+        {
+            QString fileName = options.formFillOutputPattern;
+            fileName.replace('%', QString::number(i + 1));
+
+            QString recordErrorMessage;
+            bool isFilled = false;
+            try
+            {
+                isFilled = fillRecord(options, document, sourceData, records[i], fileName, recordErrorMessage);
+            }
+            catch (const pdf::PDFException& exception)
+            {
+                recordErrorMessage = exception.getMessage();
+            }
+
+            if (!isFilled)
+            {
+                isFailed = true;
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Record %1: %2").arg(i + 1).arg(recordErrorMessage), options.outputCodec);
+            }
+
+            // Result record: status, record number and file name, separated by tabulators
+            QString result = QString("%1\t%2\t%3\n").arg(isFilled ? "OK" : "FAILED").arg(i + 1).arg(fileName);
+            PDFConsole::writeText(result, options.outputCodec);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobCount - 1);
+    for (size_t i = 1; i < jobCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    return isFailed ? ExitFailure : ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolFillForm::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument | FormFill | DocumentWriter;
+}
+
+std::vector<PDFToolFillForm::Record> PDFToolFillForm::readRecords(const PDFToolOptions& options, QString& errorMessage)
+{
+    std::vector<Record> records;
+
+    QFile file;
+    bool isOpened = false;
+    if (options.formFillRecords == "-")
+    {
+        isOpened = file.open(stdin, QFile::ReadOnly);
+    }
+    else
+    {
+        file.setFileName(options.formFillRecords);
+        isOpened = file.open(QFile::ReadOnly);
+    }
+
+    if (!isOpened)
+    {
+        errorMessage = PDFToolTranslationContext::tr("Cannot open records file '%1'.").arg(options.formFillRecords);
+        return records;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    if (QFileInfo(options.formFillRecords).suffix().compare("csv", Qt::CaseInsensitive) == 0)
+    {
+        return parseCsvRecords(QString::fromUtf8(data));
+    }
+
+    auto addRecord = [&records](const QJsonObject& object)
+    {
+        Record record;
+        record.reserve(object.size());
+
+        for (auto it = object.constBegin(); it != object.constEnd(); ++it)
+        {
+            const QJsonValue& value = it.value();
+            switch (value.type())
+            {
+                case QJsonValue::Bool:
+                    record.emplace_back(it.key(), value.toBool() ? QString("true") : QString("false"));
+                    break;
+
+                case QJsonValue::Double:
+                    record.emplace_back(it.key(), value.toVariant().toString());
+                    break;
+
+                case QJsonValue::Null:
+                    record.emplace_back(it.key(), QString());
+                    break;
+
+                default:
+                    record.emplace_back(it.key(), value.toString());
+                    break;
+            }
+        }
+
+        records.emplace_back(qMove(record));
+    };
+
+    QByteArray trimmedData = data.trimmed();
+    if (trimmedData.startsWith('['))
+    {
+        // JSON array of objects
+        QJsonParseError parseError;
+        QJsonDocument jsonDocument = QJsonDocument::fromJson(trimmedData, &parseError);
+        if (parseError.error != QJsonParseError::NoError)
+        {
+            errorMessage = PDFToolTranslationContext::tr("Invalid JSON records: %1.").arg(parseError.errorString());
+            return records;
+        }
+
+        const QJsonArray array = jsonDocument.array();
+        for (const QJsonValue& value : array)
+        {
+            addRecord(value.toObject());
+        }
+    }
+    else
+    {
+        // JSON lines, one object per line
+        const QList<QByteArray> lines = trimmedData.split('\n');
+        for (const QByteArray& line : lines)
+        {
+            QByteArray trimmedLine = line.trimmed();
+            if (trimmedLine.isEmpty())
+            {
+                continue;
+            }
+
+            QJsonParseError parseError;
+            QJsonDocument jsonDocument = QJsonDocument::fromJson(trimmedLine, &parseError);
+            if (parseError.error != QJsonParseError::NoError || !jsonDocument.isObject())
+            {
+                errorMessage = PDFToolTranslationContext::tr("Invalid JSON record %1.").arg(records.size() + 1);
+                return records;
+            }
+
+            addRecord(jsonDocument.object());
+        }
+    }
+
+    return records;
+}
+
+std::vector<PDFToolFillForm::Record> PDFToolFillForm::parseCsvRecords(const QString& data)
+{
+    std::vector<QStringList> rows;
+
+    QStringList row;
+    QString cell;
+    bool isQuoted = false;
+
+    auto finishRow = [&]()
+    {
+        row << cell;
+        cell.clear();
+
+        // Skip empty lines
+        if (row.size() > 1 || !row.front().isEmpty())
+        {
+            rows.emplace_back(qMove(row));
+        }
+
+        row = QStringList();
+    };
+
+    for (int i = 0; i < data.size(); ++i)
+    {
+        const QChar character = data[i];
+
+        if (isQuoted)
+        {
+            if (character == '"')
+            {
+                if (i + 1 < data.size() && data[i + 1] == '"')
+                {
+                    // Escaped quote
+                    cell += character;
+                    ++i;
+                }
+                else
+                {
+                    isQuoted = false;
+                }
+            }
+            else
+            {
+                cell += character;
+            }
+
+            continue;
+        }
+
+        if (character == '"')
+        {
+            isQuoted = true;
+        }
+        else if (character == ',')
+        {
+            row << cell;
+            cell.clear();
+        }
+        else if (character == '\n')
+        {
+            finishRow();
+        }
+        else if (character != '\r')
+        {
+            cell += character;
+        }
+    }
+
+    if (!cell.isEmpty() || !row.isEmpty())
+    {
+        finishRow();
+    }
+
+    std::vector<Record> records;
+    if (rows.empty())
+    {
+        return records;
+    }
+
+    const QStringList& header = rows.front();
+    records.reserve(rows.size() - 1);
+    for (auto it = std::next(rows.cbegin()); it != rows.cend(); ++it)
+    {
+        const QStringList& values = *it;
+
+        Record record;
+        const qsizetype count = qMin(header.size(), values.size());
+        for (qsizetype i = 0; i < count; ++i)
+        {
+            record.emplace_back(header[i], values[i]);
+        }
+
+        records.emplace_back(qMove(record));
+    }
+
+    return records;
+}
+
+bool PDFToolFillForm::fillRecord(const PDFToolOptions& options,
+                                 const pdf::PDFDocument& templateDocument,
+                                 const QByteArray& sourceData,
+                                 const Record& record,
+                                 const QString& fileName,
+                                 QString& errorMessage)
+{
+    if (QFileInfo::exists(fileName))
+    {
+        errorMessage = PDFToolTranslationContext::tr("File '%1' already exists.").arg(fileName);
+        return false;
+    }
+
+    // Copy of the document is shallow, objects are shared with the template
+    pdf::PDFDocument document = templateDocument;
+    pdf::PDFDocumentPointer filledDocument;
+
+    pdf::PDFFormManager formManager(nullptr);
+    formManager.setDocument(pdf::PDFModifiedDocument(&document, nullptr));
+    QObject::connect(&formManager, &pdf::PDFFormManager::documentModified, &formManager, [&filledDocument](pdf::PDFModifiedDocument modifiedDocument) { filledDocument = modifiedDocument; });
+
+    if (!formManager.hasAcroForm())
+    {
+        errorMessage = PDFToolTranslationContext::tr("Document doesn't contain interactive form.");
+        return false;
+    }
+
+    std::map<QString, pdf::PDFFormField*> formFields;
+    formManager.modify([&formFields](pdf::PDFFormField* formField)
+    {
+        if (!formField->getWidgets().empty())
+        {
+            formFields[formField->getName(pdf::PDFFormField::FullyQualified)] = formField;
+        }
+    });
+
+    {
+        // All fields are set in one batch, so appearances of changed
+        // fields are regenerated only once and only one document is created.
+        pdf::PDFFormBatchUpdateGuard batchUpdateGuard(&formManager);
+
+        for (const auto& [name, value] : record)
+        {
+            auto it = formFields.find(name);
+            if (it == formFields.cend())
+            {
+                errorMessage = PDFToolTranslationContext::tr("Form field '%1' not found.").arg(name);
+                return false;
+            }
+
+            pdf::PDFFormField* formField = it->second;
+
+            pdf::PDFFormField::SetValueParameters parameters;
+            parameters.invokingFormField = formField;
+            parameters.invokingWidget = formField->getWidgets().front().getWidget();
+
+            switch (formField->getFieldType())
+            {
+                case pdf::PDFFormField::FieldType::Text:
+                {
+                    parameters.value = pdf::PDFObjectFactory::createTextString(value);
+                    break;
+                }
+
+                case pdf::PDFFormField::FieldType::Choice:
+                {
+                    const pdf::PDFFormFieldChoice* choiceField = dynamic_cast<const pdf::PDFFormFieldChoice*>(formField);
+                    Q_ASSERT(choiceField);
+
+                    if (choiceField->isListBox())
+                    {
+                        const pdf::PDFFormFieldChoice::Options& choiceOptions = choiceField->getOptions();
+                        for (size_t i = 0; i < choiceOptions.size(); ++i)
+                        {
+                            if (choiceOptions[i].userString == value || choiceOptions[i].exportString == value)
+                            {
+                                parameters.listboxChoices.push_back(pdf::PDFInteger(i));
+                                parameters.listboxTopIndex = pdf::PDFInteger(i);
+                                break;
+                            }
+                        }
+
+                        if (parameters.listboxChoices.empty() && !value.isEmpty())
+                        {
+                            errorMessage = PDFToolTranslationContext::tr("Value '%1' is not an option of form field '%2'.").arg(value, name);
+                            return false;
+                        }
+                    }
+
+                    parameters.value = pdf::PDFObjectFactory::createTextString(value);
+                    break;
+                }
+
+                case pdf::PDFFormField::FieldType::Button:
+                {
+                    // Value is either appearance state of the widget, or boolean
+                    // value for check boxes (then first widget's state is used).
+                    const QString lowerValue = value.toLower();
+                    const bool isOff = value.isEmpty() || lowerValue == "false" || lowerValue == "0" || lowerValue == "no" || lowerValue == "off";
+                    const bool isOn = lowerValue == "true" || lowerValue == "1" || lowerValue == "yes" || lowerValue == "on";
+
+                    QByteArray state = isOff ? QByteArray("Off") : QByteArray();
+                    if (!isOff)
+                    {
+                        const QByteArray requestedState = value.toLatin1();
+                        for (const pdf::PDFFormWidget& widget : formField->getWidgets())
+                        {
+                            QByteArray onState = pdf::PDFFormFieldButton::getOnAppearanceState(&formManager, &widget);
+                            if (onState == requestedState || (isOn && state.isEmpty() && !onState.isEmpty()))
+                            {
+                                state = onState;
+                                parameters.invokingWidget = widget.getWidget();
+
+                                if (onState == requestedState)
+                                {
+                                    break;
+                                }
+                            }
+                        }
+                    }
+
+                    if (state.isEmpty())
+                    {
+                        errorMessage = PDFToolTranslationContext::tr("Value '%1' is not a state of form field '%2'.").arg(value, name);
+                        return false;
+                    }
+
+                    parameters.value = pdf::PDFObject::createName(state);
+                    break;
+                }
+
+                default:
+                    errorMessage = PDFToolTranslationContext::tr("Value of form field '%1' can't be set.").arg(name);
+                    return false;
+            }
+
+            // Skip fields, which already have the value, so their appearance is not regenerated
+            if (parameters.value == formField->getValue())
+            {
+                continue;
+            }
+
+            formManager.setFormFieldValue(parameters);
+        }
+    }
+
+    const pdf::PDFDocument* outputDocument = filledDocument ? filledDocument.data() : &document;
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    pdf::PDFOperationResult result(true);
+
+    if (options.formFillIncremental)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadWrite | QFile::Truncate) || file.write(sourceData) != sourceData.size())
+        {
+            errorMessage = PDFToolTranslationContext::tr("Can't write file '%1'.").arg(fileName);
+            return false;
+        }
+
+        result = writer.writeIncremental(&file, outputDocument);
+        file.close();
+    }
+    else
+    {
+        writer.setObjectStreamsEnabled(options.writeObjectStreams);
+        writer.setObjectsPerStream(options.writeObjectsPerStream);
+        writer.setLinearizationEnabled(options.writeLinearized);
+        result = writer.write(fileName, outputDocument, false);
+    }
+
+    if (!result)
+    {
+        errorMessage = result.getErrorMessage();
+        return false;
+    }
+
+    return true;
+}
+
+}   // namespace pdftool
@@ -0,0 +1,71 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTOOLFILLFORM_H
+#define PDFTOOLFILLFORM_H
+
+#include "pdftoolabstractapplication.h"
+
+#include <utility>
+
+namespace pdftool
+{
+
+/// Fills form fields of the template document using values from records. Template
+/// document is read only once, filled documents share all unchanged objects
+/// with the template, and only appearances of changed fields are regenerated.
+/// Records are filled in parallel, each record produces one output document.
+class PDFToolFillForm : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+
+private:
+    /// Record - list of pairs (fully qualified field name, value)
+    using Record = std::vector<std::pair<QString, QString>>;
+
+    /// Reads records from the file (or standard input). If error occurs,
+    /// then error message is set.
+    /// \param options Options
+    /// \param[out] errorMessage Error message
+    static std::vector<Record> readRecords(const PDFToolOptions& options, QString& errorMessage);
+
+    /// Parses records from CSV data, first row contains field names
+    /// \param data CSV data
+    static std::vector<Record> parseCsvRecords(const QString& data);
+
+    /// Fills the record and writes filled document to the file. Returns
+    /// false and sets error message, if record can't be filled or written.
+    /// \param options Options
+    /// \param templateDocument Template document
+    /// \param sourceData Source data of the template document (for incremental update)
+    /// \param record Record
+    /// \param fileName Output file name
+    /// \param[out] errorMessage Error message
+    static bool fillRecord(const PDFToolOptions& options,
+                           const pdf::PDFDocument& templateDocument,
+                           const QByteArray& sourceData,
+                           const Record& record,
+                           const QString& fileName,
+                           QString& errorMessage);
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLFILLFORM_H
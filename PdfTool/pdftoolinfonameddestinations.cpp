@@ -23,6 +23,9 @@ namespace pdftool
 
 static PDFToolInfoNamedDestinationsApplication s_infoNamedDestinationsApplication;
 
+/// Count of destinations, after which formatted output is written to the console
+static constexpr int DESTINATIONS_PER_OUTPUT_CHUNK = 256;
+
 QString PDFToolInfoNamedDestinationsApplication::getStandardString(StandardString standardString) const
 {
     switch (standardString)
@@ -47,8 +50,7 @@ QString PDFToolInfoNamedDestinationsApplication::getStandardString(StandardStrin
 int PDFToolInfoNamedDestinationsApplication::execute(const PDFToolOptions& options)
 {
     pdf::PDFDocument document;
-    QByteArray sourceData;
-    if (!readDocument(options, document, &sourceData, false))
+    if (!readDocument(options, document, nullptr, false))
     {
         return ErrorDocumentReading;
     }
@@ -82,22 +84,14 @@ int PDFToolInfoNamedDestinationsApplication::execute(const PDFToolOptions& optio
 
     QLocale locale;
 
-    struct DestinationItem
-    {
-        pdf::PDFInteger pageIndex = 0;
-        QString name;
-        pdf::PDFDestination destination;
-    };
-    std::vector<DestinationItem> destinationItems;
-
-    for (const auto& destinationItem : document.getCatalog()->getNamedDestinations())
+    // Destinations are written in the order of the name tree as they are
+    // resolved, so whole destination list is never held in the memory.
+    int ref = 1;
+    auto writeDestination = [&](const QByteArray& name, const pdf::PDFDestination& destination)
     {
-        const QByteArray& name = destinationItem.first;
-        const pdf::PDFDestination& destination = destinationItem.second;
-
         if (destination.getDestinationType() == pdf::DestinationType::Invalid)
         {
-            continue;
+            return;
         }
 
         // Search for page...
@@ -112,24 +106,11 @@ int PDFToolInfoNamedDestinationsApplication::execute(const PDFToolOptions& optio
         if (!std::binary_search(pages.cbegin(), pages.cend(), pageIndex))
         {
             // This page is skipped
-            continue;
+            return;
         }
 
-        DestinationItem item;
-        item.pageIndex = pageIndex;
-        item.name = pdf::PDFEncoding::convertSmartFromByteStringToUnicode(name, nullptr);
-        item.destination = destination;
-        destinationItems.emplace_back(qMove(item));
-    }
-
-    std::stable_sort(destinationItems.begin(), destinationItems.end(), [](const auto& l, const auto& r) { return l.pageIndex < r.pageIndex; });
-
-    int ref = 1;
-    for (const auto& destinationItem : destinationItems)
-    {
         QString type, left, top, right, bottom, zoom;
 
-        const pdf::PDFDestination& destination = destinationItem.destination;
         switch (destination.getDestinationType())
         {
             case pdf::DestinationType::Invalid:
@@ -214,23 +195,31 @@ int PDFToolInfoNamedDestinationsApplication::execute(const PDFToolOptions& optio
         formatter.beginTableRow("destination", ref);
 
         formatter.writeTableColumn("no", locale.toString(ref), Qt::AlignRight);
-        formatter.writeTableColumn("page-number", locale.toString(destinationItem.pageIndex), Qt::AlignRight);
+        formatter.writeTableColumn("page-number", locale.toString(pageIndex), Qt::AlignRight);
         formatter.writeTableColumn("type", type, Qt::AlignRight);
         formatter.writeTableColumn("left", left, Qt::AlignRight);
         formatter.writeTableColumn("top", top, Qt::AlignRight);
         formatter.writeTableColumn("right", right, Qt::AlignRight);
         formatter.writeTableColumn("bottom", bottom, Qt::AlignRight);
         formatter.writeTableColumn("zoom", zoom, Qt::AlignRight);
-        formatter.writeTableColumn("name", destinationItem.name);
+        formatter.writeTableColumn("name", pdf::PDFEncoding::convertSmartFromByteStringToUnicode(name, nullptr));
 
         formatter.endTableRow();
+
+        if (ref % DESTINATIONS_PER_OUTPUT_CHUNK == 0)
+        {
+            PDFConsole::writeText(formatter.takeString(), options.outputCodec);
+        }
+
         ++ref;
-    }
+    };
+
+    document.getCatalog()->enumerateNamedDestinations(writeDestination);
 
     formatter.endTable();
 
     formatter.endDocument();
-    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    PDFConsole::writeText(formatter.takeString(), options.outputCodec);
 
     return ExitSuccess;
 }
@@ -18,6 +18,14 @@
 #include "pdftoolinkcoverage.h"
 #include "pdftransparencyrenderer.h"
 
+#include <QFile>
+#include <QMutex>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include <map>
+
 namespace pdftool
 {
 
@@ -62,6 +70,28 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
+    const bool isJsonReport = options.inkCoverageReportFormat == "json";
+    if (!options.inkCoverageReportFile.isEmpty() && !isJsonReport && options.inkCoverageReportFormat != "csv")
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown ink coverage report format '%1'.").arg(options.inkCoverageReportFormat), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QFile reportFile(options.inkCoverageReportFile);
+    if (!options.inkCoverageReportFile.isEmpty())
+    {
+        if (!reportFile.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open ink coverage report file '%1'.").arg(options.inkCoverageReportFile), options.outputCodec);
+            return ErrorFailedWriteToFile;
+        }
+
+        if (!isJsonReport)
+        {
+            reportFile.write("page,ink,name,ratio,ratio-error,covered-area,covered-area-error\n");
+        }
+    }
+
     // We are ready to calculate the document's ink coverage
     pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Print, nullptr);
     pdf::PDFCMSManager cmsManager(nullptr);
@@ -76,14 +106,99 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
     pdf::PDFInkMapper inkMapper(&cmsManager, &document);
     inkMapper.createSpotColors(true);
 
+    pdf::PDFTransparencyRendererSettings settings;
+    settings.tileSize = options.inkCoverageTileSize;
+
     pdf::PDFInkCoverageCalculator calculator(&document,
                                              &fontCache,
                                              &cmsManager,
                                              &optionalContentActivity,
                                              &inkMapper,
                                              nullptr,
-                                             pdf::PDFTransparencyRendererSettings());
-    calculator.perform(QSize(1920, 1920), pageIndices);
+                                             settings);
+    calculator.setTileSampleRatio(options.inkCoverageSampleRatio);
+
+    // Pages are calculated in parallel in arbitrary order, but report is written
+    // in order of the pages. Calculated pages are held until all preceding
+    // pages are written.
+    QMutex reportMutex;
+    size_t nextReportedPage = 0;
+    std::map<pdf::PDFInteger, std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>> pendingPages;
+
+    auto writePageReport = [&](pdf::PDFInteger pageIndex, const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>& coverage)
+    {
+        QByteArray data;
+
+        if (isJsonReport)
+        {
+            QJsonArray inksArray;
+            for (const auto& info : coverage)
+            {
+                QJsonObject inkObject;
+                inkObject["ink"] = QString::fromLatin1(info.name);
+                inkObject["name"] = info.textName;
+                inkObject["ratio"] = info.ratio;
+                inkObject["ratio-error"] = info.ratioError;
+                inkObject["covered-area"] = info.coveredArea;
+                inkObject["covered-area-error"] = info.coveredAreaError;
+                inksArray.append(inkObject);
+            }
+
+            QJsonObject pageObject;
+            pageObject["page"] = pageIndex + 1;
+            pageObject["inks"] = inksArray;
+            data = QJsonDocument(pageObject).toJson(QJsonDocument::Compact);
+            data.append('\n');
+        }
+        else
+        {
+            for (const auto& info : coverage)
+            {
+                QString textName = info.textName;
+                textName.replace("\"", "\"\"");
+
+                data.append(QString("%1,%2,\"%3\",%4,%5,%6,%7\n").arg(pageIndex + 1).arg(QString::fromLatin1(info.name), textName)
+                                                                 .arg(info.ratio, 0, 'g', 6).arg(info.ratioError, 0, 'g', 6)
+                                                                 .arg(info.coveredArea, 0, 'g', 6).arg(info.coveredAreaError, 0, 'g', 6).toUtf8());
+            }
+        }
+
+        reportFile.write(data);
+    };
+
+    if (reportFile.isOpen())
+    {
+        calculator.setPageCallback([&](pdf::PDFInteger pageIndex, const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>& coverage)
+        {
+            QMutexLocker lock(&reportMutex);
+            pendingPages[pageIndex] = coverage;
+
+            while (nextReportedPage < pageIndices.size())
+            {
+                auto it = pendingPages.find(pageIndices[nextReportedPage]);
+                if (it == pendingPages.end())
+                {
+                    break;
+                }
+
+                writePageReport(it->first, it->second);
+                pendingPages.erase(it);
+                ++nextReportedPage;
+            }
+
+            reportFile.flush();
+        });
+    }
+
+    calculator.perform(QSize(options.inkCoverageResolution, options.inkCoverageResolution), pageIndices);
+
+    // Pages, which were not calculated (for example, invalid pages), are not reported,
+    // so pages following them are written now.
+    for (const auto& [pageIndex, coverage] : pendingPages)
+    {
+        writePageReport(pageIndex, coverage);
+    }
+    reportFile.close();
 
     fontCache.setCacheShrinkEnabled(nullptr, true);
 
@@ -115,11 +230,18 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
         }
     }
 
+    // Error bounds are shown only in the fast estimation mode
+    const bool isSampling = options.inkCoverageSampleRatio < 1.0;
+
     formatter.beginTableHeaderRow("header");
     formatter.writeTableHeaderColumn("page-no", PDFToolTranslationContext::tr("Page No."), Qt::AlignLeft);
     for (const pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo& info : headerCoverage)
     {
         formatter.writeTableHeaderColumn(QString("%1-ratio").arg(QString::fromLatin1(info.name)), PDFToolTranslationContext::tr("%1 Ratio [%]").arg(info.textName), Qt::AlignLeft);
+        if (isSampling)
+        {
+            formatter.writeTableHeaderColumn(QString("%1-ratio-error").arg(QString::fromLatin1(info.name)), PDFToolTranslationContext::tr("%1 Ratio Error [%]").arg(info.textName), Qt::AlignLeft);
+        }
         formatter.writeTableHeaderColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), PDFToolTranslationContext::tr("%1 Covered [mm^2]").arg(info.textName), Qt::AlignLeft);
     }
     formatter.endTableHeaderRow();
@@ -145,12 +267,20 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
             if (channelInfo)
             {
                 formatter.writeTableColumn(QString("%1-ratio").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->ratio * 100.0, 'f', 2), Qt::AlignRight);
+                if (isSampling)
+                {
+                    formatter.writeTableColumn(QString("%1-ratio-error").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->ratioError * 100.0, 'f', 2), Qt::AlignRight);
+                }
                 formatter.writeTableColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->coveredArea, 'f', 2), Qt::AlignRight);
                 sumChannelInfo->coveredArea += channelInfo->coveredArea;
             }
             else
             {
                 formatter.writeTableColumn(QString("%1-ratio").arg(QString::fromLatin1(info.name)), QString(), Qt::AlignRight);
+                if (isSampling)
+                {
+                    formatter.writeTableColumn(QString("%1-ratio-error").arg(QString::fromLatin1(info.name)), QString(), Qt::AlignRight);
+                }
                 formatter.writeTableColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), QString(), Qt::AlignRight);
             }
         }
@@ -166,6 +296,10 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
     {
         const pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* channelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(headerCoverage, info.name);
         formatter.writeTableColumn(QString("%1-ratio").arg(QString::fromLatin1(info.name)), QString(), Qt::AlignRight);
+        if (isSampling)
+        {
+            formatter.writeTableColumn(QString("%1-ratio-error").arg(QString::fromLatin1(info.name)), QString(), Qt::AlignRight);
+        }
         formatter.writeTableColumn(QString("%1-area").arg(QString::fromLatin1(info.name)), locale.toString(channelInfo->coveredArea, 'f', 2), Qt::AlignRight);
     }
 
@@ -181,7 +315,7 @@ int PDFToolInkCoverageApplication::execute(const PDFToolOptions& options)
 
 PDFToolAbstractApplication::Options PDFToolInkCoverageApplication::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | PageSelector | ColorManagementSystem;
+    return ConsoleFormat | OpenDocument | PageSelector | ColorManagementSystem | InkCoverage;
 }
 
 }   // namespace pdftool
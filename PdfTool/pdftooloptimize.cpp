@@ -62,11 +62,16 @@ int PDFToolOptimize::execute(const PDFToolOptions& options)
 
     pdf::PDFOptimizer optimizer(options.optimizeFlags, nullptr);
     QObject::connect(&optimizer, &pdf::PDFOptimizer::optimizationProgress, &optimizer, [&options](QString text) { PDFConsole::writeError(text, options.outputCodec); }, Qt::DirectConnection);
+    optimizer.setImageSettings(options.optimizeImageSettings);
+    optimizer.setContentStreamPrecision(options.optimizeContentStreamPrecision);
     optimizer.setDocument(&document);
     optimizer.optimize();
     document = optimizer.takeOptimizedDocument();
 
     pdf::PDFDocumentWriter writer(nullptr);
+    writer.setObjectStreamsEnabled(options.writeObjectStreams);
+    writer.setObjectsPerStream(options.writeObjectsPerStream);
+    writer.setLinearizationEnabled(options.writeLinearized);
     pdf::PDFOperationResult result = writer.write(options.document, &document, true);
     if (!result)
     {
@@ -79,7 +84,7 @@ int PDFToolOptimize::execute(const PDFToolOptions& options)
 
 PDFToolAbstractApplication::Options PDFToolOptimize::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | Optimize;
+    return ConsoleFormat | OpenDocument | Optimize | DocumentWriter;
 }
 
 }   // namespace pdftool
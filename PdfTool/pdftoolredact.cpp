@@ -0,0 +1,114 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftoolredact.h"
+#include "pdfredact.h"
+#include "pdfexception.h"
+#include "pdfdocumentwriter.h"
+#include "pdfoptionalcontent.h"
+
+namespace pdftool
+{
+
+static PDFToolRedact s_redactApplication;
+
+QString PDFToolRedact::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "redact";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Redact");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Create redacted document, in which content marked by redact annotations is removed.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolRedact::execute(const PDFToolOptions& options)
+{
+    if (options.redactTarget.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Redacted document filename is not set."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    pdf::PDFDocument document;
+    if (!readDocument(options, document, nullptr, false))
+    {
+        return ErrorDocumentReading;
+    }
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(&document);
+    cmsManager.setSettings(options.cmsSettings);
+    pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    pdf::PDFModifiedDocument md(&document, &optionalContentActivity);
+    fontCache.setDocument(md);
+    fontCache.setCacheShrinkEnabled(nullptr, false);
+
+    pdf::PDFRedact::Options redactOptions = pdf::PDFRedact::None;
+    redactOptions.setFlag(pdf::PDFRedact::CopyTitle, options.redactCopyTitle);
+    redactOptions.setFlag(pdf::PDFRedact::CopyMetadata, options.redactCopyMetadata);
+    redactOptions.setFlag(pdf::PDFRedact::CopyOutline, options.redactCopyOutline);
+
+    pdf::PDFDocument redactedDocument;
+    try
+    {
+        pdf::PDFRedact redact(&document, &fontCache, cms.data(), &optionalContentActivity, &meshQualitySettings, options.redactFillColor);
+        redactedDocument = redact.perform(redactOptions);
+    }
+    catch (const pdf::PDFException& exception)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Failed to redact document. %1").arg(exception.getMessage()), options.outputCodec);
+        return ErrorUnknown;
+    }
+
+    fontCache.setCacheShrinkEnabled(nullptr, true);
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    writer.setObjectStreamsEnabled(options.writeObjectStreams);
+    writer.setObjectsPerStream(options.writeObjectsPerStream);
+    writer.setLinearizationEnabled(options.writeLinearized);
+    pdf::PDFOperationResult result = writer.write(options.redactTarget, &redactedDocument, true);
+    if (!result)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Failed to write redacted document. %1").arg(result.getErrorMessage()), options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+
+    return ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolRedact::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument | ColorManagementSystem | Redact | DocumentWriter;
+}
+
+}   // namespace pdftool
@@ -18,15 +18,31 @@
 #include "pdftoolrender.h"
 #include "pdffont.h"
 #include "pdfconstants.h"
-
+#include "pdfprecompiledpagecache.h"
+#include "pdfinstrumentation.h"
+#include "pdftransparencyrenderer.h"
+
+#include <QFile>
+#include <QtMath>
+#include <QBuffer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
 #include <QColorSpace>
+#include <QJsonDocument>
 #include <QElapsedTimer>
+#include <QCryptographicHash>
+
+#include <set>
+#include <map>
+#include <atomic>
+#include <optional>
+#include <functional>
 
 namespace pdftool
 {
 
 static PDFToolRender s_toolRenderApplication;
-static PDFToolBenchmark s_toolBenchmarkApplication;
 
 QString PDFToolRender::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
 {
@@ -64,83 +80,222 @@ void PDFToolRender::finish(const PDFToolOptions& options)
     if (options.renderShowPageStatistics)
     {
         writePageStatistics(formatter);
+        writeStageStatistics(formatter);
     }
     writeErrors(formatter);
 
     formatter.endDocument();
     PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    writeStageStatisticsJson(options);
 }
 
 void PDFToolRender::onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage)
 {
+    Q_UNUSED(options);
+
     writePageInfoStatistics(renderedPageImage);
-    QString fileName = options.imageExportSettings.getOutputFileName(renderedPageImage.pageIndex, options.imageWriterSettings.getCurrentFormat());
 
-    QElapsedTimer imageWriterTimer;
-    imageWriterTimer.start();
+    QElapsedTimer queueTimer;
+    queueTimer.start();
+
+    // Queue is bounded, so rasterizers can't run too far
+    // ahead of encoders (each queued image can take a lot of memory).
+    QMutexLocker lock(&m_encoderMutex);
+    while (m_encoderQueue.size() >= m_encoderQueueLimit)
+    {
+        m_jobTaken.wait(&m_encoderMutex);
+    }
+
+    m_pageInfo[renderedPageImage.pageIndex].pageQueueTime = queueTimer.elapsed();
+    m_encoderQueue.push_back(EncoderJob{ renderedPageImage.pageIndex, qMove(renderedPageImage.pageImage), renderedPageImage.pageSize, renderedPageImage.bandIndex });
+    m_jobAvailable.wakeOne();
+}
+
+void PDFToolRender::beginRendering(const PDFToolOptions& options)
+{
+    Q_ASSERT(m_encoderThreads.empty());
+
+    m_renderingFinished = false;
+    m_encoderQueueLimit = 2 * size_t(options.renderEncoderCount);
+
+    for (int i = 0; i < options.renderEncoderCount; ++i)
+    {
+        m_encoderThreads.emplace_back(&PDFToolRender::runEncoder, this, std::cref(options));
+    }
+}
+
+void PDFToolRender::endRendering()
+{
+    {
+        QMutexLocker lock(&m_encoderMutex);
+        m_renderingFinished = true;
+        m_jobAvailable.wakeAll();
+    }
+
+    for (std::thread& thread : m_encoderThreads)
+    {
+        thread.join();
+    }
+    m_encoderThreads.clear();
+    m_tiffWriters.clear();
+}
+
+void PDFToolRender::runEncoder(const PDFToolOptions& options)
+{
+    while (true)
+    {
+        EncoderJob job;
+
+        {
+            QMutexLocker lock(&m_encoderMutex);
+            while (m_encoderQueue.empty() && !m_renderingFinished)
+            {
+                m_jobAvailable.wait(&m_encoderMutex);
+            }
+
+            if (m_encoderQueue.empty())
+            {
+                // Rendering is finished and all images were processed
+                return;
+            }
+
+            job = qMove(m_encoderQueue.front());
+            m_encoderQueue.pop_front();
+            m_jobTaken.wakeOne();
+        }
+
+        if (options.renderBandHeight > 0)
+        {
+            encodeBand(options, job);
+        }
+        else
+        {
+            encodePage(options, job);
+        }
+    }
+}
 
-    QImageWriter imageWriter(fileName, options.imageWriterSettings.getCurrentFormat());
+void PDFToolRender::encodePage(const PDFToolOptions& options, const EncoderJob& job)
+{
+    QString fileName = options.imageExportSettings.getOutputFileName(job.pageIndex, options.imageWriterSettings.getCurrentFormat());
+    PageInfo& info = m_pageInfo[job.pageIndex];
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Encode the image into memory first, so encoding and writing times can be measured separately
+    QByteArray imageData;
+    QBuffer buffer(&imageData);
+    buffer.open(QBuffer::WriteOnly);
+
+    QImageWriter imageWriter(&buffer, options.imageWriterSettings.getCurrentFormat());
     imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
     imageWriter.setCompression(options.imageWriterSettings.getCompression());
     imageWriter.setQuality(options.imageWriterSettings.getQuality());
     imageWriter.setOptimizedWrite(options.imageWriterSettings.hasOptimizedWrite());
     imageWriter.setProgressiveScanWrite(options.imageWriterSettings.hasProgressiveScanWrite());
 
-    if (!imageWriter.write(renderedPageImage.pageImage))
+    if (!imageWriter.write(job.image))
     {
-        m_pageInfo[renderedPageImage.pageIndex].errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(imageWriter.errorString())));
+        info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(imageWriter.errorString())));
+        info.pageEncodeTime = timer.elapsed();
+        return;
     }
 
-    m_pageInfo[renderedPageImage.pageIndex].pageWriteTime = imageWriterTimer.elapsed();
+    buffer.close();
+    info.pageEncodeTime = timer.restart();
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(imageData) != imageData.size())
+    {
+        info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(file.errorString())));
+    }
+    else
+    {
+        info.fileName = fileName;
+        info.fileSize = imageData.size();
+        info.checksum = QCryptographicHash::hash(imageData, QCryptographicHash::Sha256);
+    }
+    file.close();
+
+    info.pageWriteTime = timer.elapsed();
 }
 
-QString PDFToolBenchmark::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+void PDFToolRender::encodeBand(const PDFToolOptions& options, const EncoderJob& job)
 {
-    switch (standardString)
+    PageInfo& info = m_pageInfo[job.pageIndex];
+    QString fileName = options.imageExportSettings.getOutputFileName(job.pageIndex, "tiff");
+    std::shared_ptr<pdf::PDFTiffStripWriter> writer;
+
     {
-        case Command:
-            return "benchmark";
+        // Writer is created by the encoder, which gets the first band of the page
+        QMutexLocker lock(&m_tiffWriterMutex);
+        auto it = m_tiffWriters.find(job.pageIndex);
+        if (it == m_tiffWriters.end())
+        {
+            const pdf::PDFTiffStripWriter::Compression compression = options.imageWriterSettings.getCompression() > 0 ? pdf::PDFTiffStripWriter::Compression::Deflate
+                                                                                                                      : pdf::PDFTiffStripWriter::Compression::None;
+            const QSize dotsPerMeter(job.image.dotsPerMeterX(), job.image.dotsPerMeterY());
+            writer = std::make_shared<pdf::PDFTiffStripWriter>(fileName, job.pageSize, options.renderBandHeight, dotsPerMeter, compression);
 
-        case Name:
-            return PDFToolTranslationContext::tr("Benchmark rendering");
+            if (!writer->open())
+            {
+                info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName, writer->getErrorString())));
+                writer.reset();
+            }
 
-        case Description:
-            return PDFToolTranslationContext::tr("Benchmark page rendering (measure time, detect errors).");
+            it = m_tiffWriters.emplace(job.pageIndex, writer).first;
+        }
+        writer = it->second;
+    }
 
-        default:
-            Q_ASSERT(false);
-            break;
+    if (!writer)
+    {
+        // Error was already reported
+        return;
     }
 
-    return QString();
-}
+    QElapsedTimer timer;
+    timer.start();
 
-PDFToolAbstractApplication::Options PDFToolBenchmark::getOptionsFlags() const
-{
-    return ConsoleFormat | OpenDocument | PageSelector | ImageExportSettingsResolution | ColorManagementSystem | RenderFlags;
-}
+    QByteArray stripData = pdf::PDFTiffStripWriter::encodeStrip(job.image, writer->getCompression());
+    const qint64 encodeTime = timer.restart();
+    const bool isWritten = writer->writeStrip(job.bandIndex, stripData);
+    const qint64 writeTime = timer.restart();
 
-void PDFToolBenchmark::finish(const PDFToolOptions& options)
-{
-    PDFOutputFormatter formatter(options.outputStyle);
-    formatter.beginDocument("benchmark", PDFToolTranslationContext::tr("Benchmark rendering of document %1").arg(options.document));
-    formatter.endl();
+    QMutexLocker lock(&m_tiffWriterMutex);
+    info.pageEncodeTime += encodeTime;
+    info.pageWriteTime += writeTime;
 
-    writeStatistics(formatter);
-    if (options.renderShowPageStatistics)
+    if (!isWritten)
     {
-        writePageStatistics(formatter);
+        info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName, writer->getErrorString())));
+        return;
     }
-    writeErrors(formatter);
 
-    formatter.endDocument();
-    PDFConsole::writeText(formatter.getString(), options.outputCodec);
-}
+    if (!writer->isComplete() || !m_tiffWriters.erase(job.pageIndex))
+    {
+        return;
+    }
 
-void PDFToolBenchmark::onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage)
-{
-    Q_UNUSED(options);
-    writePageInfoStatistics(renderedPageImage);
+    if (!writer->finish())
+    {
+        info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName, writer->getErrorString())));
+        return;
+    }
+
+    info.fileName = fileName;
+    info.fileSize = writer->getFileSize();
+
+    // Checksum is calculated from the finished file, because header is written last
+    QFile file(fileName);
+    if (!options.renderManifestFile.isEmpty() && file.open(QFile::ReadOnly))
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&file);
+        info.checksum = hash.result();
+    }
+    info.pageWriteTime += timer.elapsed();
 }
 
 int PDFToolRenderBase::execute(const PDFToolOptions& options)
@@ -169,6 +324,17 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
+    if (!options.renderMergeManifests.isEmpty())
+    {
+        return mergeManifests(options, document, pageIndices);
+    }
+
+    m_pageInfo.resize(document.getCatalog()->getPageCount());
+    if (options.renderShardCount > 1)
+    {
+        pageIndices = getShardPages(document, pageIndices, options.renderShardIndex, options.renderShardCount);
+    }
+
     // We are ready to render the document
     pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
     pdf::PDFCMSManager cmsManager(nullptr);
@@ -180,12 +346,37 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
     fontCache.setDocument(md);
     fontCache.setCacheShrinkEnabled(nullptr, false);
 
-    m_pageInfo.resize(document.getCatalog()->getPageCount());
+    if (options.renderSeparations)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        renderSeparations(options, document, pageIndices, &fontCache, &cmsManager, &optionalContentActivity);
+        m_wallTime = timer.elapsed();
+
+        fontCache.setCacheShrinkEnabled(nullptr, true);
+
+        finish(options);
+        writeManifest(options);
+        return ExitSuccess;
+    }
+
+    pdf::PDFRenderer::Features renderFeatures = options.renderFeatures;
+    pdf::PDFRenderer::applyFidelity(options.renderFidelity, renderFeatures, meshQualitySettings);
+
     pdf::PDFRasterizerPool rasterizerPool(&document, &fontCache, &cmsManager,
-                                          &optionalContentActivity, options.renderFeatures, meshQualitySettings,
+                                          &optionalContentActivity, renderFeatures, meshQualitySettings,
                                           pdf::PDFRasterizerPool::getCorrectedRasterizerCount(options.renderRasterizerCount),
                                           options.renderUseSoftwareRendering ? pdf::RendererEngine::QPainter : pdf::RendererEngine::Blend2D_SingleThread, nullptr);
 
+    rasterizerPool.setBandHeight(options.renderBandHeight);
+
+    std::optional<pdf::PDFPrecompiledPageCache> precompiledPageCache;
+    if (!options.renderPageCacheDirectory.isEmpty())
+    {
+        precompiledPageCache.emplace(options.renderPageCacheDirectory);
+        rasterizerPool.setPrecompiledPageCache(&*precompiledPageCache);
+    }
+
     auto onRenderError = [this](pdf::PDFInteger pageIndex, pdf::PDFRenderError error)
     {
         if (pageIndex != pdf::PDFCatalog::INVALID_PAGE_INDEX)
@@ -198,44 +389,470 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
 
     auto imageSizeGetter = [&options](const pdf::PDFPage* page) -> QSize
     {
-        Q_ASSERT(page);
+        return getPageImageSize(options, page);
+    };
+
+    // Stage statistics are collected only when requested, because instrumentation has some overhead
+    const bool isInstrumented = options.renderShowPageStatistics || !options.renderStatisticsJsonFile.isEmpty();
+    if (isInstrumented)
+    {
+        pdf::PDFInstrumentation::clear();
+        pdf::PDFInstrumentation::setEnabled(true);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    beginRendering(options);
+    rasterizerPool.render(pageIndices, imageSizeGetter, std::bind(&PDFToolRenderBase::onPageRendered, this, options, std::placeholders::_1), nullptr);
+    endRendering();
+
+    m_wallTime = timer.elapsed();
+
+    if (isInstrumented)
+    {
+        pdf::PDFInstrumentation::setEnabled(false);
+    }
+
+    fontCache.setCacheShrinkEnabled(nullptr, true);
+
+    finish(options);
+    writeManifest(options);
+    return ExitSuccess;
+}
+
+void PDFToolRenderBase::renderSeparations(const PDFToolOptions& options,
+                                          const pdf::PDFDocument& document,
+                                          const std::vector<pdf::PDFInteger>& pageIndices,
+                                          const pdf::PDFFontCache* fontCache,
+                                          const pdf::PDFCMSManager* cmsManager,
+                                          const pdf::PDFOptionalContentActivity* optionalContentActivity)
+{
+    // Strips must be small enough, so tiles rendered in parallel
+    // do not take too much memory (each sample is a float).
+    constexpr int DEFAULT_ROWS_PER_STRIP = 256;
+
+    pdf::PDFInkMapper inkMapper(cmsManager, &document);
+    inkMapper.createSpotColors(options.renderSpotSeparations);
+
+    QStringList inkNames;
+    for (const pdf::PDFInkMapper::ColorInfo& colorInfo : inkMapper.getSeparations(4))
+    {
+        inkNames << QString::fromLatin1(colorInfo.name);
+    }
+
+    pdf::PDFTransparencyRendererSettings settings;
+    settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::ReducedPrecisionStorage, true);
+    settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::ActiveColorMask, false);
+    settings.flags.setFlag(pdf::PDFTransparencyRendererSettings::SeparationSimulation, !options.renderSpotSeparations);
+    settings.activeColorMask = pdf::PDFPixelFormat::getAllColorsMask();
+
+    const int rowsPerStrip = options.renderBandHeight > 0 ? options.renderBandHeight : DEFAULT_ROWS_PER_STRIP;
+    const pdf::PDFTiffStripWriter::Compression compression = options.imageWriterSettings.getCompression() > 0 ? pdf::PDFTiffStripWriter::Compression::Deflate
+                                                                                                              : pdf::PDFTiffStripWriter::Compression::None;
+    pdf::PDFCMSPointer cms = cmsManager->getCurrentCMS();
+
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
+        PageInfo& info = m_pageInfo[pageIndex];
+        info.pageIndex = pageIndex;
+
+        const QSize imageSize = page ? getPageImageSize(options, page) : QSize();
+        if (imageSize.isEmpty())
+        {
+            info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Page %1 can't be rendered.").arg(pageIndex + 1)));
+            continue;
+        }
 
-        switch (options.imageExportSettings.getResolutionMode())
+        QElapsedTimer timer;
+        timer.start();
+
+        const QSizeF sizeInMeters = page->getRotatedMediaBoxMM().size() / 1000.0;
+        const QSize dotsPerMeter(qCeil(imageSize.width() / sizeInMeters.width()), qCeil(imageSize.height() / sizeInMeters.height()));
+        const QString fileName = options.imageExportSettings.getOutputFileName(pageIndex, "tiff");
+
+        pdf::PDFTiffStripWriter writer(fileName, imageSize, rowsPerStrip, dotsPerMeter, compression);
+        writer.setSeparated(options.renderSeparationBits, inkNames);
+
+        if (!writer.open())
         {
-            case pdf::PDFPageImageExportSettings::ResolutionMode::DPI:
+            info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName, writer.getErrorString())));
+            continue;
+        }
+
+        // Tiles are whole rows of strips
+        std::vector<QRect> tiles;
+        for (int i = 0; i < writer.getStripCount(); ++i)
+        {
+            const int top = i * rowsPerStrip;
+            tiles.emplace_back(0, top, imageSize.width(), qMin(rowsPerStrip, imageSize.height() - top));
+        }
+
+        QMutex infoMutex;
+        std::atomic_bool isWritten = true;
+        auto writeStrip = [&](const QRect& tileRect, const pdf::PDFTransparencyRenderer& renderer)
+        {
+            QElapsedTimer stripTimer;
+            stripTimer.start();
+
+            QByteArray stripData = pdf::PDFTiffStripWriter::encodeSamples(renderer.toSamples(options.renderSeparationBits), compression);
+            const qint64 encodeTime = stripTimer.restart();
+
+            if (!writer.writeStrip(tileRect.top() / rowsPerStrip, stripData))
             {
-                QSizeF size = page->getRotatedMediaBox().size() * pdf::PDF_POINT_TO_INCH * options.imageExportSettings.getDpiResolution();
-                return size.toSize();
+                isWritten = false;
             }
 
-            case pdf::PDFPageImageExportSettings::ResolutionMode::Pixels:
+            QMutexLocker lock(&infoMutex);
+            info.pageEncodeTime += encodeTime;
+            info.pageWriteTime += stripTimer.elapsed();
+        };
+
+        const QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
+        pdf::PDFTransparencyTileRenderer renderer(page, &document, fontCache, cms.data(), optionalContentActivity, &inkMapper, settings, pagePointToDevicePoint);
+        renderer.setDeviceColorSpace(pdf::PDFColorSpacePointer(new pdf::PDFDeviceCMYKColorSpace()));
+
+        for (const pdf::PDFRenderError& error : renderer.render(tiles, writeStrip))
+        {
+            info.errors.push_back(error);
+        }
+
+        if (!isWritten || !writer.finish())
+        {
+            info.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName, writer.getErrorString())));
+            continue;
+        }
+
+        // Strips are encoded and written by rendering threads, total time
+        // of the page is split into rendering, encoding and writing.
+        info.isRendered = true;
+        info.pageRenderTime = qMax<qint64>(timer.elapsed() - info.pageEncodeTime - info.pageWriteTime, 0);
+        info.pageTotalTime = info.pageRenderTime;
+        info.fileName = fileName;
+        info.fileSize = writer.getFileSize();
+
+        QFile file(fileName);
+        if (!options.renderManifestFile.isEmpty() && file.open(QFile::ReadOnly))
+        {
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            hash.addData(&file);
+            info.checksum = hash.result();
+        }
+    }
+}
+
+QSize PDFToolRenderBase::getPageImageSize(const PDFToolOptions& options, const pdf::PDFPage* page)
+{
+    Q_ASSERT(page);
+
+    switch (options.imageExportSettings.getResolutionMode())
+    {
+        case pdf::PDFPageImageExportSettings::ResolutionMode::DPI:
+        {
+            QSizeF size = page->getRotatedMediaBox().size() * pdf::PDF_POINT_TO_INCH * options.imageExportSettings.getDpiResolution();
+            return size.toSize();
+        }
+
+        case pdf::PDFPageImageExportSettings::ResolutionMode::Pixels:
+        {
+            int pixelResolution = options.imageExportSettings.getPixelResolution();
+            QSizeF size = page->getRotatedMediaBox().size().scaled(pixelResolution, pixelResolution, Qt::KeepAspectRatio);
+            return size.toSize();
+        }
+
+        default:
+        {
+            Q_ASSERT(false);
+            break;
+        }
+    }
+
+    return QSize();
+}
+
+qint64 PDFToolRenderBase::estimatePageRenderCost(const pdf::PDFDocument& document, pdf::PDFInteger pageIndex)
+{
+    // Cost is measured in bytes of content streams, image pixel
+    // is counted as a quarter of the byte (decoding and drawing of image pixel
+    // is much cheaper, than interpretation of content stream byte). Each page
+    // has also some base cost (page image must be cleared and encoded).
+    constexpr qint64 PAGE_BASE_COST = 16384;
+    constexpr qint64 IMAGE_PIXELS_PER_COST_UNIT = 4;
+
+    const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        return PAGE_BASE_COST;
+    }
+
+    pdf::PDFDocumentDataLoaderDecorator loader(&document);
+    std::set<pdf::PDFObjectReference> visitedReferences;
+    qint64 cost = PAGE_BASE_COST;
+
+    auto addStreamLength = [&](const pdf::PDFStream* stream)
+    {
+        cost += qMax<pdf::PDFInteger>(loader.readIntegerFromDictionary(stream->getDictionary(), "Length", 0), 0);
+    };
+
+    std::function<void(const pdf::PDFObject&)> addResources = [&](const pdf::PDFObject& resourcesObject)
+    {
+        const pdf::PDFDictionary* resources = document.getDictionaryFromObject(resourcesObject);
+        const pdf::PDFDictionary* xobjects = resources ? document.getDictionaryFromObject(resources->get("XObject")) : nullptr;
+        if (!xobjects)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < xobjects->getCount(); ++i)
+        {
+            const pdf::PDFObject& xobjectReference = xobjects->getValue(i);
+            if (xobjectReference.isReference() && !visitedReferences.insert(xobjectReference.getReference()).second)
+            {
+                // Object was already processed (it is shared by multiple forms)
+                continue;
+            }
+
+            const pdf::PDFObject& xobject = document.getObject(xobjectReference);
+            if (!xobject.isStream())
+            {
+                continue;
+            }
+
+            const pdf::PDFStream* stream = xobject.getStream();
+            const pdf::PDFDictionary* dictionary = stream->getDictionary();
+            const QByteArray subtype = loader.readNameFromDictionary(dictionary, "Subtype");
+
+            if (subtype == "Image")
             {
-                int pixelResolution = options.imageExportSettings.getPixelResolution();
-                QSizeF size = page->getRotatedMediaBox().size().scaled(pixelResolution, pixelResolution, Qt::KeepAspectRatio);
-                return size.toSize();
+                const qint64 width = qMax<pdf::PDFInteger>(loader.readIntegerFromDictionary(dictionary, "Width", 0), 0);
+                const qint64 height = qMax<pdf::PDFInteger>(loader.readIntegerFromDictionary(dictionary, "Height", 0), 0);
+                cost += width * height / IMAGE_PIXELS_PER_COST_UNIT;
             }
+            else if (subtype == "Form")
+            {
+                addStreamLength(stream);
+                addResources(dictionary->get("Resources"));
+            }
+        }
+    };
 
-            default:
+    const pdf::PDFObject& contents = document.getObject(page->getContents());
+    if (contents.isStream())
+    {
+        addStreamLength(contents.getStream());
+    }
+    else if (contents.isArray())
+    {
+        const pdf::PDFArray* contentsArray = contents.getArray();
+        for (size_t i = 0; i < contentsArray->getCount(); ++i)
+        {
+            const pdf::PDFObject& contentStream = document.getObject(contentsArray->getItem(i));
+            if (contentStream.isStream())
             {
-                Q_ASSERT(false);
-                break;
+                addStreamLength(contentStream.getStream());
             }
         }
+    }
+
+    addResources(page->getResources());
+    return cost;
+}
+
+std::vector<pdf::PDFInteger> PDFToolRenderBase::getShardPages(const pdf::PDFDocument& document,
+                                                              const std::vector<pdf::PDFInteger>& pageIndices,
+                                                              int shardIndex,
+                                                              int shardCount)
+{
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        m_pageInfo[pageIndex].pageCost = estimatePageRenderCost(document, pageIndex);
+    }
 
-        return QSize();
+    std::vector<pdf::PDFInteger> sortedPageIndices = pageIndices;
+    auto compareCost = [this](pdf::PDFInteger left, pdf::PDFInteger right)
+    {
+        return std::make_pair(-m_pageInfo[left].pageCost, left) < std::make_pair(-m_pageInfo[right].pageCost, right);
     };
+    std::sort(sortedPageIndices.begin(), sortedPageIndices.end(), compareCost);
 
-    QElapsedTimer timer;
-    timer.start();
+    // Shards are ordered by total cost and then by index
+    std::set<std::pair<qint64, int>> shards;
+    for (int i = 0; i < shardCount; ++i)
+    {
+        shards.insert(std::make_pair(0, i));
+    }
 
-    rasterizerPool.render(pageIndices, imageSizeGetter, std::bind(&PDFToolRenderBase::onPageRendered, this, options, std::placeholders::_1), nullptr);
+    std::vector<pdf::PDFInteger> result;
+    for (pdf::PDFInteger pageIndex : sortedPageIndices)
+    {
+        std::pair<qint64, int> shard = *shards.begin();
+        shards.erase(shards.begin());
 
-    m_wallTime = timer.elapsed();
+        if (shard.second == shardIndex)
+        {
+            result.push_back(pageIndex);
+        }
 
-    fontCache.setCacheShrinkEnabled(nullptr, true);
+        shard.first += m_pageInfo[pageIndex].pageCost;
+        shards.insert(shard);
+    }
 
-    finish(options);
-    return ExitSuccess;
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void PDFToolRenderBase::writeManifest(const PDFToolOptions& options)
+{
+    if (options.renderManifestFile.isEmpty())
+    {
+        return;
+    }
+
+    QJsonArray pages;
+    for (const PageInfo& info : m_pageInfo)
+    {
+        if (!info.isRendered)
+        {
+            continue;
+        }
+
+        QJsonObject page;
+        page["page"] = info.pageIndex + 1;
+        page["file"] = info.fileName;
+        page["size"] = info.fileSize;
+        page["sha256"] = QString::fromLatin1(info.checksum.toHex());
+        page["cost"] = info.pageCost;
+        page["compile-time"] = info.pageCompileTime;
+        page["render-time"] = info.pageRenderTime;
+        page["encode-time"] = info.pageEncodeTime;
+        page["write-time"] = info.pageWriteTime;
+        page["errors"] = int(info.errors.size());
+        pages.append(page);
+    }
+
+    QJsonObject manifest;
+    manifest["document"] = options.document;
+    manifest["page-count"] = int(m_pageInfo.size());
+    manifest["shard"] = options.renderShardIndex + 1;
+    manifest["shard-count"] = options.renderShardCount;
+    manifest["wall-time"] = m_wallTime;
+    manifest["pages"] = pages;
+
+    QFile file(options.renderManifestFile);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(QJsonDocument(manifest).toJson(QJsonDocument::Indented)) < 0)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write manifest to file '%1', because: %2.").arg(options.renderManifestFile, file.errorString()), options.outputCodec);
+    }
+}
+
+int PDFToolRenderBase::mergeManifests(const PDFToolOptions& options, const pdf::PDFDocument& document, const std::vector<pdf::PDFInteger>& pageIndices)
+{
+    const int pageCount = int(document.getCatalog()->getPageCount());
+    std::map<int, QJsonObject> pages;
+    QStringList errors;
+    int shardCount = 0;
+    std::set<int> shards;
+
+    for (const QString& manifestFile : options.renderMergeManifests)
+    {
+        QFile file(manifestFile);
+        if (!file.open(QFile::ReadOnly))
+        {
+            errors << PDFToolTranslationContext::tr("Cannot read manifest '%1', because: %2.").arg(manifestFile, file.errorString());
+            continue;
+        }
+
+        QJsonParseError parseError;
+        QJsonObject manifest = QJsonDocument::fromJson(file.readAll(), &parseError).object();
+        if (parseError.error != QJsonParseError::NoError)
+        {
+            errors << PDFToolTranslationContext::tr("Cannot parse manifest '%1', because: %2.").arg(manifestFile, parseError.errorString());
+            continue;
+        }
+
+        if (manifest["page-count"].toInt() != pageCount)
+        {
+            errors << PDFToolTranslationContext::tr("Manifest '%1' was created for a document with different page count.").arg(manifestFile);
+            continue;
+        }
+
+        const int manifestShardCount = manifest["shard-count"].toInt(1);
+        if (shardCount != 0 && shardCount != manifestShardCount)
+        {
+            errors << PDFToolTranslationContext::tr("Manifest '%1' has different shard count.").arg(manifestFile);
+        }
+        shardCount = manifestShardCount;
+
+        if (!shards.insert(manifest["shard"].toInt(1)).second)
+        {
+            errors << PDFToolTranslationContext::tr("Shard %1 is contained in multiple manifests.").arg(manifest["shard"].toInt(1));
+        }
+
+        const QJsonArray manifestPages = manifest["pages"].toArray();
+        for (const QJsonValue& value : manifestPages)
+        {
+            QJsonObject page = value.toObject();
+            const int pageNumber = page["page"].toInt();
+
+            if (pages.count(pageNumber))
+            {
+                errors << PDFToolTranslationContext::tr("Page %1 was rendered multiple times.").arg(pageNumber);
+            }
+            else if (page["errors"].toInt() > 0)
+            {
+                errors << PDFToolTranslationContext::tr("Page %1 was rendered with errors.").arg(pageNumber);
+            }
+            else
+            {
+                const QString fileName = page["file"].toString();
+                QFileInfo fileInfo(fileName);
+                if (fileName.isEmpty() || !fileInfo.exists() || fileInfo.size() != page["size"].toInteger())
+                {
+                    errors << PDFToolTranslationContext::tr("Image file of page %1 is missing or it has invalid size.").arg(pageNumber);
+                }
+            }
+
+            pages[pageNumber] = qMove(page);
+        }
+    }
+
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        if (!pages.count(int(pageIndex + 1)))
+        {
+            errors << PDFToolTranslationContext::tr("Page %1 was not rendered.").arg(pageIndex + 1);
+        }
+    }
+
+    if (!options.renderManifestFile.isEmpty())
+    {
+        QJsonArray mergedPages;
+        for (const auto& page : pages)
+        {
+            mergedPages.append(page.second);
+        }
+
+        QJsonObject manifest;
+        manifest["document"] = options.document;
+        manifest["page-count"] = pageCount;
+        manifest["shard"] = 1;
+        manifest["shard-count"] = 1;
+        manifest["pages"] = mergedPages;
+
+        QFile file(options.renderManifestFile);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(QJsonDocument(manifest).toJson(QJsonDocument::Indented)) < 0)
+        {
+            errors << PDFToolTranslationContext::tr("Cannot write manifest to file '%1', because: %2.").arg(options.renderManifestFile, file.errorString());
+        }
+    }
+
+    for (const QString& error : errors)
+    {
+        PDFConsole::writeError(error, options.outputCodec);
+    }
+
+    return errors.isEmpty() ? ExitSuccess : ExitFailure;
 }
 
 void PDFToolRenderBase::writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage)
@@ -257,6 +874,8 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
     qint64 pageWaitTime = 0;
     qint64 pageRenderTime = 0;
     qint64 pageTotalTime = 0;
+    qint64 pageQueueTime = 0;
+    qint64 pageEncodeTime = 0;
     qint64 pageWriteTime = 0;
 
     for (const PageInfo& info : m_pageInfo)
@@ -270,7 +889,9 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
         pageCompileTime += info.pageCompileTime;
         pageWaitTime += info.pageWaitTime;
         pageRenderTime += info.pageRenderTime;
-        pageTotalTime += info.pageTotalTime + info.pageWriteTime;
+        pageTotalTime += info.pageTotalTime + info.pageQueueTime + info.pageEncodeTime + info.pageWriteTime;
+        pageQueueTime += info.pageQueueTime;
+        pageEncodeTime += info.pageEncodeTime;
         pageWriteTime += info.pageWriteTime;
     }
 
@@ -284,6 +905,8 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
         double compileRatio = 100.0 * double(pageCompileTime) / double(pageTotalTime);
         double waitRatio = 100.0 * double(pageWaitTime) / double(pageTotalTime);
         double renderRatio = 100.0 * double(pageRenderTime) / double(pageTotalTime);
+        double queueRatio = 100.0 * double(pageQueueTime) / double(pageTotalTime);
+        double encodeRatio = 100.0 * double(pageEncodeTime) / double(pageTotalTime);
         double writeRatio = 100.0 * double(pageWriteTime) / double(pageTotalTime);
 
         formatter.beginTable("statistics", PDFToolTranslationContext::tr("Statistics"));
@@ -307,6 +930,8 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
         writeValue("compile-time", PDFToolTranslationContext::tr("Total compile time"), locale.toString(pageCompileTime), PDFToolTranslationContext::tr("msec"));
         writeValue("render-time", PDFToolTranslationContext::tr("Total render time"), locale.toString(pageRenderTime), PDFToolTranslationContext::tr("msec"));
         writeValue("wait-time", PDFToolTranslationContext::tr("Total wait time"), locale.toString(pageWaitTime), PDFToolTranslationContext::tr("msec"));
+        writeValue("queue-time", PDFToolTranslationContext::tr("Total encoder queue wait time"), locale.toString(pageQueueTime), PDFToolTranslationContext::tr("msec"));
+        writeValue("encode-time", PDFToolTranslationContext::tr("Total encode time"), locale.toString(pageEncodeTime), PDFToolTranslationContext::tr("msec"));
         writeValue("write-time", PDFToolTranslationContext::tr("Total write time"), locale.toString(pageWriteTime), PDFToolTranslationContext::tr("msec"));
         writeValue("total-time", PDFToolTranslationContext::tr("Total time"), locale.toString(pageTotalTime), PDFToolTranslationContext::tr("msec"));
         writeValue("wall-time", PDFToolTranslationContext::tr("Wall time"), locale.toString(m_wallTime), PDFToolTranslationContext::tr("msec"));
@@ -315,6 +940,8 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
         writeValue("compile-time-ratio", PDFToolTranslationContext::tr("Compile time ratio"), locale.toString(compileRatio, 'f', 2), PDFToolTranslationContext::tr("%"));
         writeValue("render-time-ratio", PDFToolTranslationContext::tr("Render time ratio"), locale.toString(renderRatio, 'f', 2), PDFToolTranslationContext::tr("%"));
         writeValue("wait-time-ratio", PDFToolTranslationContext::tr("Wait time ratio"), locale.toString(waitRatio, 'f', 2), PDFToolTranslationContext::tr("%"));
+        writeValue("queue-time-ratio", PDFToolTranslationContext::tr("Encoder queue wait time ratio"), locale.toString(queueRatio, 'f', 2), PDFToolTranslationContext::tr("%"));
+        writeValue("encode-time-ratio", PDFToolTranslationContext::tr("Encode time ratio"), locale.toString(encodeRatio, 'f', 2), PDFToolTranslationContext::tr("%"));
         writeValue("write-time-ratio", PDFToolTranslationContext::tr("Write time ratio"), locale.toString(writeRatio, 'f', 2), PDFToolTranslationContext::tr("%"));
 
         formatter.endTable();
@@ -331,6 +958,8 @@ void PDFToolRenderBase::writePageStatistics(PDFOutputFormatter& formatter)
     formatter.writeTableHeaderColumn("compile-time", PDFToolTranslationContext::tr("Compile Time [msec]"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("render-time", PDFToolTranslationContext::tr("Render Time [msec]"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("wait-time", PDFToolTranslationContext::tr("Wait Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("queue-time", PDFToolTranslationContext::tr("Queue Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("encode-time", PDFToolTranslationContext::tr("Encode Time [msec]"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("write-time", PDFToolTranslationContext::tr("Write Time [msec]"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("total-time", PDFToolTranslationContext::tr("Total Time [msec]"), Qt::AlignLeft);
     formatter.endTableHeaderRow();
@@ -349,8 +978,38 @@ void PDFToolRenderBase::writePageStatistics(PDFOutputFormatter& formatter)
         formatter.writeTableColumn("compile-time", locale.toString(info.pageCompileTime), Qt::AlignRight);
         formatter.writeTableColumn("render-time", locale.toString(info.pageRenderTime), Qt::AlignRight);
         formatter.writeTableColumn("wait-time", locale.toString(info.pageWaitTime), Qt::AlignRight);
+        formatter.writeTableColumn("queue-time", locale.toString(info.pageQueueTime), Qt::AlignRight);
+        formatter.writeTableColumn("encode-time", locale.toString(info.pageEncodeTime), Qt::AlignRight);
         formatter.writeTableColumn("write-time", locale.toString(info.pageWriteTime), Qt::AlignRight);
-        formatter.writeTableColumn("total-time", locale.toString(info.pageTotalTime), Qt::AlignRight);
+        formatter.writeTableColumn("total-time", locale.toString(info.pageTotalTime + info.pageQueueTime + info.pageEncodeTime + info.pageWriteTime), Qt::AlignRight);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+    formatter.endl();
+}
+
+void PDFToolRenderBase::writeStageStatistics(PDFOutputFormatter& formatter)
+{
+    formatter.beginTable("stage-statistics", PDFToolTranslationContext::tr("Stage Statistics"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("stage", PDFToolTranslationContext::tr("Stage"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("count", PDFToolTranslationContext::tr("Count"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("time", PDFToolTranslationContext::tr("Time [msec]"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    QLocale locale;
+
+    const pdf::PDFInstrumentation::StageValues values = pdf::PDFInstrumentation::getTotalValues();
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const QString stageName = QString::fromLatin1(pdf::PDFInstrumentation::getStageName(pdf::PDFInstrumentationStage(i)));
+
+        formatter.beginTableRow(stageName);
+        formatter.writeTableColumn("stage", stageName);
+        formatter.writeTableColumn("count", locale.toString(values[i].count), Qt::AlignRight);
+        formatter.writeTableColumn("time", locale.toString(double(values[i].time) / 1000000.0, 'f', 3), Qt::AlignRight);
         formatter.endTableRow();
     }
 
@@ -358,6 +1017,20 @@ void PDFToolRenderBase::writePageStatistics(PDFOutputFormatter& formatter)
     formatter.endl();
 }
 
+void PDFToolRenderBase::writeStageStatisticsJson(const PDFToolOptions& options)
+{
+    if (options.renderStatisticsJsonFile.isEmpty())
+    {
+        return;
+    }
+
+    QFile file(options.renderStatisticsJsonFile);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(pdf::PDFInstrumentation::toJson()) < 0)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write statistics to file '%1', because: %2.").arg(options.renderStatisticsJsonFile, file.errorString()), options.outputCodec);
+    }
+}
+
 void PDFToolRenderBase::writeErrors(PDFOutputFormatter& formatter)
 {
     formatter.beginTable("rendering-errors", PDFToolTranslationContext::tr("Rendering Errors"));
@@ -366,6 +1039,7 @@ void PDFToolRenderBase::writeErrors(PDFOutputFormatter& formatter)
     formatter.writeTableHeaderColumn("page-no", PDFToolTranslationContext::tr("Page No."), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("type", PDFToolTranslationContext::tr("Type"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("message", PDFToolTranslationContext::tr("Message"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("count", PDFToolTranslationContext::tr("Count"), Qt::AlignLeft);
     formatter.endTableHeaderRow();
 
     QLocale locale;
@@ -410,7 +1084,8 @@ void PDFToolRenderBase::writeErrors(PDFOutputFormatter& formatter)
             formatter.beginTableRow("page", info.pageIndex + 1);
             formatter.writeTableColumn("page-no", locale.toString(info.pageIndex + 1), Qt::AlignRight);
             formatter.writeTableColumn("type", type, Qt::AlignLeft);
-            formatter.writeTableColumn("message", error.message, Qt::AlignLeft);
+            formatter.writeTableColumn("message", error.getMessage(), Qt::AlignLeft);
+            formatter.writeTableColumn("count", locale.toString(error.count), Qt::AlignRight);
             formatter.endTableRow();
         }
     }
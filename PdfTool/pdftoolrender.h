@@ -20,6 +20,15 @@
 
 #include "pdftoolabstractapplication.h"
 #include "pdfexception.h"
+#include "pdftiffwriter.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <thread>
 
 namespace pdftool
 {
@@ -28,17 +37,77 @@ class PDFToolRenderBase : public PDFToolAbstractApplication
 {
 public:
     virtual int execute(const PDFToolOptions& options) override;
+    virtual bool isConcurrentExecutionSupported() const override { return false; }
+
+    /// Returns size of the page image, which is determined by resolution settings
+    /// \param options Options
+    /// \param page Page
+    static QSize getPageImageSize(const PDFToolOptions& options, const pdf::PDFPage* page);
 
 protected:
     virtual void finish(const PDFToolOptions& options) = 0;
     virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage) = 0;
 
+    /// Called before first page is rendered
+    virtual void beginRendering(const PDFToolOptions& options) { Q_UNUSED(options); }
+
+    /// Called after all pages are rendered, must wait for all pending work
+    virtual void endRendering() { }
+
     void writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage);
 
+    /// Renders separations (CMYK and optionally spot colors) of the pages using
+    /// tiled transparency renderer. Each tile is a strip of the BigTIFF file,
+    /// so strips are converted to integer samples and written, as soon as they
+    /// are rendered, and whole page image is never held in the memory.
+    /// \param options Options
+    /// \param document Document
+    /// \param pageIndices Pages to be rendered
+    /// \param fontCache Font cache
+    /// \param cmsManager Color management system manager
+    /// \param optionalContentActivity Optional content activity
+    void renderSeparations(const PDFToolOptions& options,
+                           const pdf::PDFDocument& document,
+                           const std::vector<pdf::PDFInteger>& pageIndices,
+                           const pdf::PDFFontCache* fontCache,
+                           const pdf::PDFCMSManager* cmsManager,
+                           const pdf::PDFOptionalContentActivity* optionalContentActivity);
+
     void writeStatistics(PDFOutputFormatter& formatter);
     void writePageStatistics(PDFOutputFormatter& formatter);
+    void writeStageStatistics(PDFOutputFormatter& formatter);
+    void writeStageStatisticsJson(const PDFToolOptions& options);
     void writeErrors(PDFOutputFormatter& formatter);
 
+    /// Writes manifest of rendered pages to the JSON file (if it is requested)
+    /// \param options Options
+    void writeManifest(const PDFToolOptions& options);
+
+    /// Merges manifests of the shards and checks, that each selected page was rendered
+    /// exactly once and its file exists. Merged manifest is written to the manifest file.
+    /// \param options Options
+    /// \param document Document
+    /// \param pageIndices Selected pages
+    int mergeManifests(const PDFToolOptions& options, const pdf::PDFDocument& document, const std::vector<pdf::PDFInteger>& pageIndices);
+
+    /// Returns pages of the shard. Each page is assigned to the shard with the lowest total
+    /// cost, pages are processed from the most expensive one (ties are resolved by page
+    /// index), so assignment is deterministic and shards are balanced by estimated cost.
+    /// \param document Document
+    /// \param pageIndices Selected pages
+    /// \param shardIndex Zero based shard index
+    /// \param shardCount Shard count
+    std::vector<pdf::PDFInteger> getShardPages(const pdf::PDFDocument& document,
+                                               const std::vector<pdf::PDFInteger>& pageIndices,
+                                               int shardIndex,
+                                               int shardCount);
+
+    /// Estimates cost of the page rendering from the size of content streams
+    /// (including form XObjects) and from the pixel count of images.
+    /// \param document Document
+    /// \param pageIndex Page index
+    static qint64 estimatePageRenderCost(const pdf::PDFDocument& document, pdf::PDFInteger pageIndex);
+
     struct PageInfo
     {
         bool isRendered = false;
@@ -47,7 +116,13 @@ protected:
         qint64 pageWaitTime = 0;
         qint64 pageRenderTime = 0;
         qint64 pageTotalTime = 0;
+        qint64 pageQueueTime = 0;
+        qint64 pageEncodeTime = 0;
         qint64 pageWriteTime = 0;
+        qint64 pageCost = 0;
+        qint64 fileSize = 0;
+        QString fileName;
+        QByteArray checksum;
         std::vector<pdf::PDFRenderError> errors;
     };
 
@@ -55,6 +130,11 @@ protected:
     qint64 m_wallTime = 0;
 };
 
+/// Renders pages to image files. Rendered images are passed to the
+/// bounded queue, from which they are taken by encoder threads, which
+/// encode images and write them to files. So rendering, encoding and
+/// writing of different pages overlap. Large pages can be rendered
+/// in bands, which are encoded as strips of BigTIFF file independently.
 class PDFToolRender : public PDFToolRenderBase
 {
 public:
@@ -64,17 +144,36 @@ public:
 protected:
     virtual void finish(const PDFToolOptions& options) override;
     virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage) override;
-};
+    virtual void beginRendering(const PDFToolOptions& options) override;
+    virtual void endRendering() override;
 
-class PDFToolBenchmark : public PDFToolRenderBase
-{
-public:
-    virtual QString getStandardString(StandardString standardString) const override;
-    virtual Options getOptionsFlags() const override;
+private:
+    struct EncoderJob
+    {
+        pdf::PDFInteger pageIndex = 0;
+        QImage image;
+        QSize pageSize;
+        int bandIndex = 0;
+    };
 
-protected:
-    virtual void finish(const PDFToolOptions& options) override;
-    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage) override;
+    void runEncoder(const PDFToolOptions& options);
+    void encodePage(const PDFToolOptions& options, const EncoderJob& job);
+
+    /// Encodes band of the page as a strip of the BigTIFF file. When
+    /// all strips of the page are written, file is finished.
+    void encodeBand(const PDFToolOptions& options, const EncoderJob& job);
+
+    QMutex m_encoderMutex;
+    QWaitCondition m_jobAvailable;
+    QWaitCondition m_jobTaken;
+    std::deque<EncoderJob> m_encoderQueue;
+    size_t m_encoderQueueLimit = 0;
+    bool m_renderingFinished = false;
+    std::vector<std::thread> m_encoderThreads;
+
+    /// Writers of pages rendered in bands (nullptr, if file can't be opened)
+    QMutex m_tiffWriterMutex;
+    std::map<pdf::PDFInteger, std::shared_ptr<pdf::PDFTiffStripWriter>> m_tiffWriters;
 };
 
 }   // namespace pdftool
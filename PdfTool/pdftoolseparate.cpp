@@ -18,8 +18,10 @@
 #include "pdftoolseparate.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfexception.h"
-#include "pdfoptimizer.h"
 #include "pdfdocumentwriter.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfobjectutils.h"
+#include "pdfutils.h"
 
 #include <QFileInfo>
 
@@ -85,57 +87,223 @@ int PDFToolSeparate::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
-    for (pdf::PDFInteger pageIndex : pageIndices)
+    // Page tree is flattened only once (inheritable attributes are
+    // copied to the pages), then object graph of the document is parsed. Each
+    // output document is assembled directly from the objects reachable from
+    // the page, so shared resources (fonts, images) are parsed only once,
+    // and their objects are shared by all output documents.
+    pdf::PDFDocumentBuilder documentBuilder(&document);
+    documentBuilder.flattenPageTree();
+    std::vector<pdf::PDFObjectReference> pageReferences = documentBuilder.getPages();
+    pdf::PDFDocument flattenedDocument = documentBuilder.build();
+
+    const pdf::PDFObjectStorage& storage = flattenedDocument.getStorage();
+    const size_t objectCount = storage.getObjectCount();
+
+    // Direct references of each object (object graph)
+    std::vector<std::vector<pdf::PDFObjectReference>> directReferences(objectCount);
+    auto collectDirectReferences = [&storage, &directReferences](size_t objectNumber)
     {
-        try
+        pdf::PDFObjectStorage::ObjectMetadata metadata = storage.getObjectMetadata(pdf::PDFInteger(objectNumber));
+        if (metadata.isOccupied)
+        {
+            const pdf::PDFObject& object = storage.getObjectByReference(pdf::PDFObjectReference(pdf::PDFInteger(objectNumber), metadata.generation));
+            std::set<pdf::PDFObjectReference> references = pdf::PDFObjectUtils::getDirectReferences(object);
+            directReferences[objectNumber].assign(references.cbegin(), references.cend());
+        }
+    };
+    pdf::PDFIntegerRange<size_t> objectNumbers(0, objectCount);
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, objectNumbers.begin(), objectNumbers.end(), collectDirectReferences);
+
+    // Objects of the document structure (catalog, page tree and pages) are not
+    // copied into output documents, references to them are replaced by null.
+    const pdf::PDFDictionary* trailerDictionary = flattenedDocument.getTrailerDictionary();
+    const pdf::PDFObjectReference catalogReference = trailerDictionary->get("Root").isReference() ? trailerDictionary->get("Root").getReference() : pdf::PDFObjectReference();
+    const pdf::PDFDictionary* catalogDictionary = storage.getDictionaryFromObject(storage.getObjectByReference(catalogReference));
+    if (!catalogDictionary || !catalogDictionary->get("Pages").isReference())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid document catalog."), options.outputCodec);
+        return ErrorDocumentReading;
+    }
+
+    std::vector<uint8_t> isStructureObject(objectCount, 0);
+    auto markStructureObject = [&isStructureObject](pdf::PDFObjectReference reference)
+    {
+        if (reference.objectNumber >= 0 && size_t(reference.objectNumber) < isStructureObject.size())
         {
-            pdf::PDFDocumentBuilder documentBuilder(&document);
-            documentBuilder.flattenPageTree();
-            std::vector<pdf::PDFObjectReference> pageReferences = documentBuilder.getPages();
-            std::vector<pdf::PDFObjectReference> singlePageRef = { pageReferences[pageIndex] };
-            documentBuilder.setPages(singlePageRef);
-            documentBuilder.removeOutline();
-            documentBuilder.removeThreads();
-            documentBuilder.removeDocumentActions();
-            documentBuilder.removeStructureTree();
-
-            pdf::PDFDocument singlePageDocument = documentBuilder.build();
-
-            // Optimize document - remove unused objects and shrink object storage
-            pdf::PDFOptimizer optimizer(pdf::PDFOptimizer::RemoveUnusedObjects | pdf::PDFOptimizer::ShrinkObjectStorage, nullptr);
-            optimizer.setDocument(&singlePageDocument);
-            optimizer.optimize();
-            singlePageDocument = optimizer.takeOptimizedDocument();
+            isStructureObject[reference.objectNumber] = 1;
+        }
+    };
+    markStructureObject(catalogReference);
+    markStructureObject(catalogDictionary->get("Pages").getReference());
+    std::for_each(pageReferences.cbegin(), pageReferences.cend(), markStructureObject);
+
+    // Catalog of output documents, without document level structures
+    pdf::PDFDictionary outputCatalogDictionary = *catalogDictionary;
+    for (const char* key : { "Pages", "Outlines", "Threads", "OpenAction", "AA", "StructTreeRoot", "MarkInfo" })
+    {
+        outputCatalogDictionary.removeEntry(key);
+    }
+
+    pdf::PDFSecurityHandlerPointer securityHandler(storage.getSecurityHandler()->clone());
+    pdf::PDFVersion version = flattenedDocument.getInfo()->version;
 
+    auto separatePage = [&](pdf::PDFInteger pageIndex)
+    {
+        try
+        {
             QString fileName = options.separatePagePattern;
             fileName.replace('%', QString::number(pageIndex + 1));
 
             if (QFileInfo::exists(fileName))
             {
                 PDFConsole::writeError(PDFToolTranslationContext::tr("File '%1' already exists. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1), options.outputCodec);
+                return;
+            }
+
+            const pdf::PDFObjectReference pageReference = pageReferences.at(pageIndex);
+
+            // Object numbers of the output document: 0 is free object, 1 is catalog,
+            // 2 is page tree root, 3 is page, then follow objects reachable from the
+            // page, catalog and trailer, in the order, in which they were found.
+            constexpr pdf::PDFInteger FIRST_OBJECT_NUMBER = 4;
+            const pdf::PDFObjectReference outputCatalogReference(1, 0);
+            const pdf::PDFObjectReference outputPageTreeRootReference(2, 0);
+            const pdf::PDFObjectReference outputPageReference(3, 0);
+
+            std::map<pdf::PDFObjectReference, pdf::PDFObjectReference> referenceMapping;
+            referenceMapping[pageReference] = outputPageReference;
+
+            std::vector<pdf::PDFObjectReference> copiedReferences;
+            std::vector<pdf::PDFObjectReference> nullReferences;
+            std::vector<pdf::PDFObjectReference> stack;
+
+            auto visit = [&](pdf::PDFObjectReference reference)
+            {
+                if (reference.objectNumber < 0 || size_t(reference.objectNumber) >= objectCount || referenceMapping.count(reference))
+                {
+                    return;
+                }
+
+                if (isStructureObject[reference.objectNumber])
+                {
+                    referenceMapping[reference] = pdf::PDFObjectReference();
+                    nullReferences.push_back(reference);
+                    return;
+                }
+
+                referenceMapping[reference] = pdf::PDFObjectReference(FIRST_OBJECT_NUMBER + pdf::PDFInteger(copiedReferences.size()), 0);
+                copiedReferences.push_back(reference);
+                stack.push_back(reference);
+            };
+
+            std::vector<pdf::PDFObjectReference> rootReferences = directReferences[pageReference.objectNumber];
+            for (const pdf::PDFObject& object : { pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(outputCatalogDictionary)), trailerDictionary->get("Info"), trailerDictionary->get("Encrypt") })
+            {
+                std::set<pdf::PDFObjectReference> references = pdf::PDFObjectUtils::getDirectReferences(object);
+                rootReferences.insert(rootReferences.end(), references.cbegin(), references.cend());
+            }
+
+            std::for_each(rootReferences.cbegin(), rootReferences.cend(), visit);
+            while (!stack.empty())
+            {
+                pdf::PDFObjectReference reference = stack.back();
+                stack.pop_back();
+                std::for_each(directReferences[reference.objectNumber].cbegin(), directReferences[reference.objectNumber].cend(), visit);
+            }
+
+            // References to the document structure objects are replaced by single null object
+            const pdf::PDFObjectReference nullReference(FIRST_OBJECT_NUMBER + pdf::PDFInteger(copiedReferences.size()), 0);
+            for (const pdf::PDFObjectReference& reference : nullReferences)
+            {
+                referenceMapping[reference] = nullReference;
+            }
+
+            pdf::PDFObjectStorage::PDFObjects objects;
+            objects.reserve(nullReference.objectNumber + 1);
+            objects.emplace_back();
+
+            pdf::PDFObject catalogObject = pdf::PDFObjectUtils::replaceReferences(pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(outputCatalogDictionary)), referenceMapping);
+            pdf::PDFDictionary catalog = *catalogObject.getDictionary();
+            catalog.setEntry(pdf::PDFInplaceOrMemoryString("Pages"), pdf::PDFObject::createReference(outputPageTreeRootReference));
+            objects.emplace_back(0, pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(qMove(catalog))));
+
+            pdf::PDFObjectFactory objectFactory;
+            objectFactory.beginDictionary();
+            objectFactory.beginDictionaryItem("Type");
+            objectFactory << pdf::WrapName("Pages");
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("Kids");
+            objectFactory.beginArray();
+            objectFactory << outputPageReference;
+            objectFactory.endArray();
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("Count");
+            objectFactory << pdf::PDFInteger(1);
+            objectFactory.endDictionaryItem();
+            objectFactory.endDictionary();
+            objects.emplace_back(0, objectFactory.takeObject());
+
+            referenceMapping[catalogDictionary->get("Pages").getReference()] = outputPageTreeRootReference;
+            objects.emplace_back(0, pdf::PDFObjectUtils::replaceReferences(storage.getObjectByReference(pageReference), referenceMapping));
+            referenceMapping[catalogDictionary->get("Pages").getReference()] = nullReference;
+
+            for (const pdf::PDFObjectReference& reference : copiedReferences)
+            {
+                objects.emplace_back(0, pdf::PDFObjectUtils::replaceReferences(storage.getObjectByReference(reference), referenceMapping));
             }
-            else
+
+            objects.emplace_back(0, pdf::PDFObject::createNull());
+
+            objectFactory.beginDictionary();
+            objectFactory.beginDictionaryItem("Size");
+            objectFactory << pdf::PDFInteger(objects.size());
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("Root");
+            objectFactory << outputCatalogReference;
+            objectFactory.endDictionaryItem();
+            objectFactory.endDictionary();
+            pdf::PDFObject outputTrailerDictionaryObject = objectFactory.takeObject();
+
+            pdf::PDFDictionary outputTrailerDictionary = *outputTrailerDictionaryObject.getDictionary();
+            for (const char* key : { "Info", "Encrypt", "ID" })
             {
-                pdf::PDFDocumentWriter writer(nullptr);
-                pdf::PDFOperationResult result = writer.write(fileName, &singlePageDocument, false);
-                if (!result)
+                const pdf::PDFObject& value = trailerDictionary->get(key);
+                if (!value.isNull())
                 {
-                    PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+                    outputTrailerDictionary.setEntry(pdf::PDFInplaceOrMemoryString(key), pdf::PDFObjectUtils::replaceReferences(value, referenceMapping));
                 }
             }
+
+            pdf::PDFObjectStorage outputStorage(qMove(objects),
+                                                pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(qMove(outputTrailerDictionary))),
+                                                pdf::PDFSecurityHandlerPointer(securityHandler->clone()));
+            pdf::PDFDocument singlePageDocument(qMove(outputStorage), version, QByteArray());
+
+            pdf::PDFDocumentWriter writer(nullptr);
+            writer.setObjectStreamsEnabled(options.writeObjectStreams);
+            writer.setObjectsPerStream(options.writeObjectsPerStream);
+            writer.setLinearizationEnabled(options.writeLinearized);
+            pdf::PDFOperationResult result = writer.write(fileName, &singlePageDocument, false);
+            if (!result)
+            {
+                PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+            }
         }
         catch (const pdf::PDFException &exception)
         {
             PDFConsole::writeError(exception.getMessage(), options.outputCodec);
         }
-    }
+    };
+
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, pageIndices.cbegin(), pageIndices.cend(), separatePage);
 
     return ExitSuccess;
 }
 
 PDFToolAbstractApplication::Options PDFToolSeparate::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | PageSelector | Separate;
+    return ConsoleFormat | OpenDocument | PageSelector | Separate | DocumentWriter;
 }
 
 
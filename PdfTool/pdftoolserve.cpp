@@ -0,0 +1,508 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolserve.h"
+#include "pdfdocumentreader.h"
+#include "pdfdocumenttextflow.h"
+#include "pdfexception.h"
+#include "pdfconstants.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QBuffer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QImageWriter>
+#include <QJsonDocument>
+
+#include <numeric>
+
+namespace pdftool
+{
+
+static PDFToolServe s_serveApplication;
+
+PDFToolServe::DocumentEntry::DocumentEntry() = default;
+
+QString PDFToolServe::getStandardString(StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "serve";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Server");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Process JSON requests (one per line) from standard input, keeping opened documents in memory.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+PDFToolAbstractApplication::Options PDFToolServe::getOptionsFlags() const
+{
+    return ImageWriterSettings | ColorManagementSystem | RenderFlags | TextAnalysis;
+}
+
+int PDFToolServe::execute(const PDFToolOptions& options)
+{
+    QFile input;
+    QFile output;
+    if (!input.open(stdin, QFile::ReadOnly) || !output.open(stdout, QFile::WriteOnly))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open standard input/output."), options.outputCodec);
+        return ErrorUnknown;
+    }
+
+    bool quit = false;
+    while (!quit)
+    {
+        QByteArray line = input.readLine();
+        if (line.isEmpty())
+        {
+            // End of input
+            break;
+        }
+
+        line = line.trimmed();
+        if (line.isEmpty())
+        {
+            continue;
+        }
+
+        QJsonObject response;
+        QJsonParseError parseError;
+        QJsonDocument requestDocument = QJsonDocument::fromJson(line, &parseError);
+        if (parseError.error != QJsonParseError::NoError || !requestDocument.isObject())
+        {
+            response["status"] = "error";
+            response["error"] = PDFToolTranslationContext::tr("Invalid request: %1").arg(parseError.errorString());
+        }
+        else
+        {
+            const QJsonObject request = requestDocument.object();
+
+            try
+            {
+                response = processRequest(options, request, quit);
+            }
+            catch (const pdf::PDFException& exception)
+            {
+                response = QJsonObject();
+                response["status"] = "error";
+                response["error"] = exception.getMessage();
+            }
+
+            if (request.contains("id"))
+            {
+                response["id"] = request["id"];
+            }
+        }
+
+        output.write(QJsonDocument(response).toJson(QJsonDocument::Compact));
+        output.write("\n");
+        output.flush();
+    }
+
+    m_documents.clear();
+    return ExitSuccess;
+}
+
+QJsonObject PDFToolServe::processRequest(const PDFToolOptions& options, const QJsonObject& request, bool& quit)
+{
+    QJsonObject response;
+    const QString command = request["command"].toString();
+
+    auto setError = [&response](QString errorMessage)
+    {
+        response["status"] = "error";
+        response["error"] = qMove(errorMessage);
+    };
+
+    if (command == "quit")
+    {
+        quit = true;
+        response["status"] = "ok";
+        return response;
+    }
+
+    if (command == "close")
+    {
+        const QString fileName = QFileInfo(request["document"].toString()).canonicalFilePath();
+        m_documents.erase(fileName);
+        response["status"] = "ok";
+        return response;
+    }
+
+    if (command != "open" && command != "info" && command != "render" && command != "text")
+    {
+        setError(PDFToolTranslationContext::tr("Unknown command '%1'.").arg(command));
+        return response;
+    }
+
+    QString errorMessage;
+    DocumentEntry* entry = getDocument(options, request, errorMessage);
+    if (!entry)
+    {
+        setError(errorMessage);
+        return response;
+    }
+
+    if (command == "open")
+    {
+        response["status"] = "ok";
+        response["pageCount"] = qint64(entry->document.getCatalog()->getPageCount());
+        return response;
+    }
+
+    if (command == "info")
+    {
+        return processInfo(entry);
+    }
+
+    if (command == "render")
+    {
+        return processRender(options, entry, request);
+    }
+
+    return processText(options, entry, request);
+}
+
+PDFToolServe::DocumentEntry* PDFToolServe::getDocument(const PDFToolOptions& options, const QJsonObject& request, QString& errorMessage)
+{
+    QFileInfo fileInfo(request["document"].toString());
+    if (!fileInfo.exists())
+    {
+        errorMessage = PDFToolTranslationContext::tr("Document '%1' doesn't exist.").arg(fileInfo.filePath());
+        return nullptr;
+    }
+
+    const QString fileName = fileInfo.canonicalFilePath();
+    const QDateTime lastModified = fileInfo.lastModified();
+
+    auto it = m_documents.find(fileName);
+    if (it != m_documents.cend() && it->second->lastModified == lastModified)
+    {
+        it->second->lastUsed = ++m_useCounter;
+        return it->second.get();
+    }
+
+    // Document is not opened, or it was modified, open it
+    // and prepare all objects needed for rendering (they are kept warm).
+    const QString password = request["password"].toString();
+    bool isFirstPasswordAttempt = true;
+    auto passwordCallback = [&password, &isFirstPasswordAttempt](bool* ok) -> QString
+    {
+        *ok = isFirstPasswordAttempt;
+        isFirstPasswordAttempt = false;
+        return password;
+    };
+
+    pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, false);
+    if (options.lazyLoading)
+    {
+        reader.setReadingMode(pdf::PDFDocumentReader::ReadingMode::MemoryMapped);
+        reader.setObjectLoadingMode(pdf::PDFDocumentReader::ObjectLoadingMode::OnDemand);
+    }
+    pdf::PDFDocument document = reader.readFromFile(fileName);
+
+    switch (reader.getReadingResult())
+    {
+        case pdf::PDFDocumentReader::Result::OK:
+            break;
+
+        case pdf::PDFDocumentReader::Result::Cancelled:
+            errorMessage = PDFToolTranslationContext::tr("Invalid password provided.");
+            return nullptr;
+
+        case pdf::PDFDocumentReader::Result::Failed:
+        default:
+            errorMessage = PDFToolTranslationContext::tr("Error occured during document reading. %1").arg(reader.getErrorMessage());
+            return nullptr;
+    }
+
+    if (m_documents.size() >= DOCUMENT_CACHE_LIMIT && it == m_documents.cend())
+    {
+        auto leastRecentlyUsed = std::min_element(m_documents.begin(), m_documents.end(), [](const auto& l, const auto& r) { return l.second->lastUsed < r.second->lastUsed; });
+        m_documents.erase(leastRecentlyUsed);
+    }
+
+    std::unique_ptr<DocumentEntry> entry = std::make_unique<DocumentEntry>();
+    entry->lastModified = lastModified;
+    entry->lastUsed = ++m_useCounter;
+    entry->document = qMove(document);
+    entry->optionalContentActivity = std::make_unique<pdf::PDFOptionalContentActivity>(&entry->document, pdf::OCUsage::Export, nullptr);
+    entry->cmsManager = std::make_unique<pdf::PDFCMSManager>(nullptr);
+    entry->cmsManager->setDocument(&entry->document);
+    entry->cmsManager->setSettings(options.cmsSettings);
+    entry->fontCache = std::make_unique<pdf::PDFFontCache>(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    entry->fontCache->setDocument(pdf::PDFModifiedDocument(&entry->document, entry->optionalContentActivity.get()));
+    entry->fontCache->setCacheShrinkEnabled(nullptr, false);
+
+    pdf::PDFRenderer::Features renderFeatures = options.renderFeatures;
+    pdf::PDFRenderer::applyFidelity(options.renderFidelity, renderFeatures, entry->meshQualitySettings);
+    entry->rasterizerPool = std::make_unique<pdf::PDFRasterizerPool>(&entry->document, entry->fontCache.get(), entry->cmsManager.get(),
+                                                                     entry->optionalContentActivity.get(), renderFeatures, entry->meshQualitySettings,
+                                                                     pdf::PDFRasterizerPool::getCorrectedRasterizerCount(options.renderRasterizerCount),
+                                                                     options.renderUseSoftwareRendering ? pdf::RendererEngine::QPainter : pdf::RendererEngine::Blend2D_SingleThread, nullptr);
+
+    DocumentEntry* result = entry.get();
+    m_documents[fileName] = qMove(entry);
+    return result;
+}
+
+std::vector<pdf::PDFInteger> PDFToolServe::getPageIndices(const DocumentEntry* entry, const QJsonObject& request, QString& errorMessage)
+{
+    const pdf::PDFInteger pageCount = entry->document.getCatalog()->getPageCount();
+    std::vector<pdf::PDFInteger> pageIndices;
+
+    if (request.contains("pages"))
+    {
+        // Page numbers in the request are one based, as in other commands
+        for (const QJsonValue& value : request["pages"].toArray())
+        {
+            const pdf::PDFInteger pageNumber = value.toInteger();
+            if (pageNumber < 1 || pageNumber > pageCount)
+            {
+                errorMessage = PDFToolTranslationContext::tr("Invalid page number %1.").arg(pageNumber);
+                return { };
+            }
+            pageIndices.push_back(pageNumber - 1);
+        }
+    }
+    else
+    {
+        pageIndices.resize(pageCount);
+        std::iota(pageIndices.begin(), pageIndices.end(), 0);
+    }
+
+    return pageIndices;
+}
+
+QJsonObject PDFToolServe::processInfo(DocumentEntry* entry)
+{
+    const pdf::PDFDocument& document = entry->document;
+    const pdf::PDFDocumentInfo* info = document.getInfo();
+    const pdf::PDFCatalog* catalog = document.getCatalog();
+
+    QJsonObject response;
+    response["status"] = "ok";
+    response["version"] = QString::fromLatin1(document.getVersion());
+    response["title"] = info->title;
+    response["author"] = info->author;
+    response["subject"] = info->subject;
+    response["keywords"] = info->keywords;
+    response["creator"] = info->creator;
+    response["producer"] = info->producer;
+    response["pageCount"] = qint64(catalog->getPageCount());
+
+    QJsonArray pages;
+    for (size_t i = 0, pageCount = catalog->getPageCount(); i < pageCount; ++i)
+    {
+        const pdf::PDFPage* page = catalog->getPage(i);
+        const QSizeF size = page->getRotatedMediaBox().size();
+
+        QJsonObject pageObject;
+        pageObject["width"] = size.width();
+        pageObject["height"] = size.height();
+        pages.append(pageObject);
+    }
+    response["pages"] = pages;
+
+    return response;
+}
+
+QJsonObject PDFToolServe::processRender(const PDFToolOptions& options, DocumentEntry* entry, const QJsonObject& request)
+{
+    QJsonObject response;
+
+    QString errorMessage;
+    std::vector<pdf::PDFInteger> pageIndices = getPageIndices(entry, request, errorMessage);
+    if (!errorMessage.isEmpty())
+    {
+        response["status"] = "error";
+        response["error"] = errorMessage;
+        return response;
+    }
+
+    // Image size is given either by resolution (in DPI), or by
+    // maximal size in pixels (aspect ratio is preserved).
+    const double dpi = request["dpi"].toDouble(72.0);
+    const int pixels = request["pixels"].toInt(0);
+    auto imageSizeGetter = [dpi, pixels](const pdf::PDFPage* page) -> QSize
+    {
+        Q_ASSERT(page);
+
+        if (pixels > 0)
+        {
+            return page->getRotatedMediaBox().size().scaled(pixels, pixels, Qt::KeepAspectRatio).toSize();
+        }
+
+        return (page->getRotatedMediaBox().size() * pdf::PDF_POINT_TO_INCH * dpi).toSize();
+    };
+
+    // If output file pattern is given, images are written to the files (%1 is replaced
+    // by the page number), otherwise images are returned as base64 encoded data.
+    const QString outputPattern = request["output"].toString();
+    const QByteArray format = options.imageWriterSettings.getCurrentFormat();
+
+    QMutex mutex;
+    std::map<pdf::PDFInteger, QJsonObject> renderedPages;
+    auto processImage = [&](pdf::PDFRenderedPageImage& renderedPageImage)
+    {
+        QJsonObject pageObject;
+        pageObject["page"] = renderedPageImage.pageIndex + 1;
+
+        QByteArray imageData;
+        QBuffer buffer(&imageData);
+        const QString fileName = !outputPattern.isEmpty() ? outputPattern.arg(renderedPageImage.pageIndex + 1) : QString();
+
+        QImageWriter imageWriter;
+        if (!fileName.isEmpty())
+        {
+            imageWriter.setFileName(fileName);
+        }
+        else
+        {
+            buffer.open(QBuffer::WriteOnly);
+            imageWriter.setDevice(&buffer);
+        }
+
+        imageWriter.setFormat(format);
+        imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
+        imageWriter.setCompression(options.imageWriterSettings.getCompression());
+        imageWriter.setQuality(options.imageWriterSettings.getQuality());
+        imageWriter.setOptimizedWrite(options.imageWriterSettings.hasOptimizedWrite());
+        imageWriter.setProgressiveScanWrite(options.imageWriterSettings.hasProgressiveScanWrite());
+
+        if (imageWriter.write(renderedPageImage.pageImage))
+        {
+            if (!fileName.isEmpty())
+            {
+                pageObject["file"] = fileName;
+            }
+            else
+            {
+                pageObject["data"] = QString::fromLatin1(imageData.toBase64());
+            }
+        }
+        else
+        {
+            pageObject["error"] = imageWriter.errorString();
+        }
+
+        QMutexLocker lock(&mutex);
+        renderedPages[renderedPageImage.pageIndex] = qMove(pageObject);
+    };
+
+    QJsonArray errors;
+    QObject holder;
+    auto onRenderError = [&mutex, &errors](pdf::PDFInteger pageIndex, pdf::PDFRenderError error)
+    {
+        QMutexLocker lock(&mutex);
+        errors.append(PDFToolTranslationContext::tr("Page %1: %2").arg(pageIndex + 1).arg(error.getMessage()));
+    };
+    QObject::connect(entry->rasterizerPool.get(), &pdf::PDFRasterizerPool::renderError, &holder, onRenderError, Qt::DirectConnection);
+
+    entry->rasterizerPool->render(pageIndices, imageSizeGetter, processImage, nullptr);
+
+    QJsonArray pages;
+    for (auto& renderedPage : renderedPages)
+    {
+        pages.append(qMove(renderedPage.second));
+    }
+
+    response["status"] = "ok";
+    response["format"] = QString::fromLatin1(format);
+    response["pages"] = pages;
+    if (!errors.isEmpty())
+    {
+        response["errors"] = errors;
+    }
+
+    return response;
+}
+
+QJsonObject PDFToolServe::processText(const PDFToolOptions& options, DocumentEntry* entry, const QJsonObject& request)
+{
+    QJsonObject response;
+
+    if (!entry->document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::CopyContent))
+    {
+        response["status"] = "error";
+        response["error"] = PDFToolTranslationContext::tr("Document doesn't allow to copy content.");
+        return response;
+    }
+
+    QString errorMessage;
+    std::vector<pdf::PDFInteger> pageIndices = getPageIndices(entry, request, errorMessage);
+    if (!errorMessage.isEmpty())
+    {
+        response["status"] = "error";
+        response["error"] = errorMessage;
+        return response;
+    }
+
+    pdf::PDFDocumentTextFlowFactory factory;
+    pdf::PDFDocumentTextFlow textFlow = factory.create(&entry->document, pageIndices, options.textAnalysisAlgorithm);
+
+    std::map<pdf::PDFInteger, QString> pageTexts;
+    for (const pdf::PDFDocumentTextFlow::Item& item : textFlow.getItems())
+    {
+        if (item.isText())
+        {
+            QString& text = pageTexts[item.pageIndex];
+            if (!text.isEmpty())
+            {
+                text += "\n";
+            }
+            text += item.text;
+        }
+    }
+
+    QJsonArray pages;
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        QJsonObject pageObject;
+        pageObject["page"] = pageIndex + 1;
+        pageObject["text"] = pageTexts[pageIndex];
+        pages.append(pageObject);
+    }
+
+    response["status"] = "ok";
+    response["pages"] = pages;
+
+    QJsonArray errors;
+    for (const pdf::PDFRenderError& error : factory.getErrors())
+    {
+        errors.append(error.getMessage());
+    }
+    if (!errors.isEmpty())
+    {
+        response["errors"] = errors;
+    }
+
+    return response;
+}
+
+}   // namespace pdftool
@@ -0,0 +1,92 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTOOLSERVE_H
+#define PDFTOOLSERVE_H
+
+#include "pdftoolabstractapplication.h"
+#include "pdfoptionalcontent.h"
+#include "pdffont.h"
+
+#include <QJsonObject>
+
+#include <map>
+#include <memory>
+
+namespace pdftool
+{
+
+/// Long running server. Requests are read from the standard input, one JSON
+/// object per line, and responses are written to the standard output, also one
+/// JSON object per line. Opened documents (together with their font caches,
+/// color management and rasterizers) are kept in memory, so requests to already
+/// opened documents don't parse the document again. Supported requests:
+///     - open, close (open/close document),
+///     - info (document information and page sizes),
+///     - render (render pages to files or base64 encoded images),
+///     - text (extract text of pages),
+///     - quit (stop the server).
+class PDFToolServe : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+    virtual bool isConcurrentExecutionSupported() const override { return false; }
+
+private:
+    /// Maximal number of documents kept opened. If limit is exceeded,
+    /// least recently used document is closed.
+    static constexpr size_t DOCUMENT_CACHE_LIMIT = 16;
+
+    struct DocumentEntry
+    {
+        DocumentEntry();
+
+        QDateTime lastModified;
+        quint64 lastUsed = 0;
+        pdf::PDFDocument document;
+        std::unique_ptr<pdf::PDFOptionalContentActivity> optionalContentActivity;
+        std::unique_ptr<pdf::PDFCMSManager> cmsManager;
+        std::unique_ptr<pdf::PDFFontCache> fontCache;
+        pdf::PDFMeshQualitySettings meshQualitySettings; ///< Rasterizer pool references these settings
+        std::unique_ptr<pdf::PDFRasterizerPool> rasterizerPool;
+    };
+
+    /// Processes single request and returns the response
+    QJsonObject processRequest(const PDFToolOptions& options, const QJsonObject& request, bool& quit);
+
+    /// Returns opened document. If document is not opened, or it was modified
+    /// since it was opened, then it is (re)opened. If document can't be opened,
+    /// then nullptr is returned and error message is set.
+    DocumentEntry* getDocument(const PDFToolOptions& options, const QJsonObject& request, QString& errorMessage);
+
+    /// Returns selected page indices (zero based). If no pages are
+    /// selected in the request, all pages are returned.
+    static std::vector<pdf::PDFInteger> getPageIndices(const DocumentEntry* entry, const QJsonObject& request, QString& errorMessage);
+
+    QJsonObject processInfo(DocumentEntry* entry);
+    QJsonObject processRender(const PDFToolOptions& options, DocumentEntry* entry, const QJsonObject& request);
+    QJsonObject processText(const PDFToolOptions& options, DocumentEntry* entry, const QJsonObject& request);
+
+    std::map<QString, std::unique_ptr<DocumentEntry>> m_documents;
+    quint64 m_useCounter = 0;
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLSERVE_H
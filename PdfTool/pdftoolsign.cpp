@@ -0,0 +1,343 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftoolsign.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfdocumentwriter.h"
+
+#include <QDir>
+#include <QFile>
+#include <QBuffer>
+#include <QFileInfo>
+#include <QDateTime>
+
+namespace pdftool
+{
+
+static PDFToolSign s_signApplication;
+
+QString PDFToolSign::getStandardString(StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "sign";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Sign");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Digitally sign the document using certificate from PKCS#12 file (signature is appended as incremental update).");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolSign::execute(const PDFToolOptions& options)
+{
+    if (options.signCertificateFile.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No certificate file has been specified."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    if (options.signReservedSize <= 0)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid size of the reserved space for the signature: %1.").arg(options.signReservedSize), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QString errorMessage;
+    const pdf::PDFSigningKey* signingKey = getSigningKey(options, errorMessage);
+    if (!signingKey)
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+        return ErrorCertificateReading;
+    }
+
+    pdf::PDFDocument document;
+    QByteArray sourceData;
+    if (!readDocument(options, document, &sourceData, false))
+    {
+        return ErrorDocumentReading;
+    }
+
+    if (document.getCatalog()->getPageCount() == 0)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Document doesn't contain any page."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QByteArray signedData = signDocument(options, document, sourceData, signingKey, errorMessage);
+    if (signedData.isEmpty())
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+
+    const QString fileName = getOutputFileName(options);
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(signedData) != signedData.size())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Can't write file '%1'.").arg(fileName), options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+    file.close();
+
+    return ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolSign::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument;
+}
+
+void PDFToolSign::initializeApplicationCommandLineParser(QCommandLineParser* parser) const
+{
+    parser->addOption(QCommandLineOption("sign-cert", "PKCS#12 file with private key and certificate used for signing.", "file"));
+    parser->addOption(QCommandLineOption("sign-password", "Password of the private key.", "password"));
+    parser->addOption(QCommandLineOption("sign-name", "Name of the signature form field (default is generated).", "name"));
+    parser->addOption(QCommandLineOption("sign-reason", "Reason of the signature.", "reason"));
+    parser->addOption(QCommandLineOption("sign-contact", "Contact information of the signer.", "contact"));
+    parser->addOption(QCommandLineOption("sign-output-dir", "Output directory of signed documents (default is directory of the document).", "directory"));
+    parser->addOption(QCommandLineOption("sign-in-place", "Append signature to the original file instead of creating a new file."));
+    parser->addOption(QCommandLineOption("sign-reserve", "Number of bytes reserved for the signature (default is 8192).", "bytes"));
+}
+
+void PDFToolSign::readApplicationOptions(QCommandLineParser* parser, PDFToolOptions& options) const
+{
+    options.signCertificateFile = parser->value("sign-cert");
+    options.signPassword = parser->value("sign-password");
+    options.signFieldName = parser->value("sign-name");
+    options.signReason = parser->value("sign-reason");
+    options.signContactInfo = parser->value("sign-contact");
+    options.signOutputDirectory = parser->value("sign-output-dir");
+    options.signInPlace = parser->isSet("sign-in-place");
+
+    if (parser->isSet("sign-reserve"))
+    {
+        bool ok = false;
+        options.signReservedSize = parser->value("sign-reserve").toInt(&ok);
+
+        if (!ok)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid size of the reserved space for the signature: %1.").arg(parser->value("sign-reserve")), options.outputCodec);
+            options.signReservedSize = 0;
+        }
+    }
+}
+
+const pdf::PDFSigningKey* PDFToolSign::getSigningKey(const PDFToolOptions& options, QString& errorMessage)
+{
+    // Documents in the batch are signed in parallel, but
+    // certificate file is read and private key is decoded only once.
+    std::call_once(m_signingKeyLoadedFlag, [this, &options]()
+    {
+        QFile file(options.signCertificateFile);
+        if (!file.open(QFile::ReadOnly))
+        {
+            m_signingKeyErrorMessage = PDFToolTranslationContext::tr("Cannot open certificate file '%1'.").arg(options.signCertificateFile);
+            return;
+        }
+
+        if (!m_signingKey.load(file.readAll(), options.signPassword))
+        {
+            m_signingKeyErrorMessage = PDFToolTranslationContext::tr("Cannot read private key from certificate file '%1' (invalid file or password).").arg(options.signCertificateFile);
+        }
+        file.close();
+    });
+
+    if (!m_signingKey.isValid())
+    {
+        errorMessage = m_signingKeyErrorMessage;
+        return nullptr;
+    }
+
+    return &m_signingKey;
+}
+
+QByteArray PDFToolSign::signDocument(const PDFToolOptions& options,
+                                     const pdf::PDFDocument& document,
+                                     const QByteArray& sourceData,
+                                     const pdf::PDFSigningKey* signingKey,
+                                     QString& errorMessage)
+{
+    // Offset mark is placeholder of the byte range items, it is replaced
+    // by actual offsets, when the document is written. Contents are filled
+    // with characters '(', so they are written as hexadecimal string
+    // of known value, which is replaced by the signature.
+    constexpr pdf::PDFInteger offsetMark = 123456789123;
+    const QByteArray offsetMarkString = QByteArray::number(offsetMark);
+    const QByteArray reservedContents(options.signReservedSize, '(');
+    const QByteArray reservedContentsHex = reservedContents.toHex();
+
+    QString signatureName = options.signFieldName;
+    if (signatureName.isEmpty())
+    {
+        signatureName = QString("pdf4qt_signature_%1").arg(QDateTime::currentMSecsSinceEpoch());
+    }
+
+    const pdf::PDFObjectStorage& storage = document.getStorage();
+    const pdf::PDFObjectReference pageReference = document.getCatalog()->getPage(0)->getPageReference();
+
+    pdf::PDFDocumentBuilder builder(&document);
+    pdf::PDFObjectReference signatureDictionary = builder.createSignatureDictionary("Adobe.PPKLite", "adbe.pkcs7.detached", reservedContents, QDateTime::currentDateTime(), offsetMark);
+    pdf::PDFObjectReference formField = builder.createFormFieldSignature(signatureName, { }, signatureDictionary);
+    builder.createInvisibleFormFieldWidget(formField, pageReference);
+
+    // Signature field is added to the existing form fields, existing
+    // signatures must remain in the form, so they are still valid.
+    pdf::PDFObjectReferenceVector fields;
+    const pdf::PDFDictionary* trailerDictionary = storage.getDictionaryFromObject(storage.getTrailerDictionary());
+    const pdf::PDFDictionary* catalogDictionary = trailerDictionary ? storage.getDictionaryFromObject(trailerDictionary->get("Root")) : nullptr;
+    const pdf::PDFObject acroFormObject = catalogDictionary ? catalogDictionary->get("AcroForm") : pdf::PDFObject();
+    const pdf::PDFObject acroForm = storage.getObject(acroFormObject);
+
+    if (const pdf::PDFDictionary* acroFormDictionary = storage.getDictionaryFromObject(acroForm))
+    {
+        const pdf::PDFObject& fieldsObject = storage.getObject(acroFormDictionary->get("Fields"));
+        if (fieldsObject.isArray())
+        {
+            const pdf::PDFArray* fieldsArray = fieldsObject.getArray();
+            for (size_t i = 0; i < fieldsArray->getCount(); ++i)
+            {
+                const pdf::PDFObject& field = fieldsArray->getItem(i);
+                if (field.isReference())
+                {
+                    fields.push_back(field.getReference());
+                }
+            }
+        }
+    }
+    fields.push_back(formField);
+
+    pdf::PDFObjectFactory objectFactory;
+    objectFactory.beginDictionary();
+    objectFactory.beginDictionaryItem("Fields");
+    objectFactory << fields;
+    objectFactory.endDictionaryItem();
+    objectFactory.beginDictionaryItem("SigFlags");
+    objectFactory << 3;
+    objectFactory.endDictionaryItem();
+    objectFactory.endDictionary();
+    pdf::PDFObject updatedAcroForm = objectFactory.takeObject();
+
+    if (acroFormObject.isReference())
+    {
+        builder.mergeTo(acroFormObject.getReference(), qMove(updatedAcroForm));
+    }
+    else
+    {
+        updatedAcroForm = pdf::PDFObjectManipulator::merge(acroForm, qMove(updatedAcroForm), pdf::PDFObjectManipulator::NoFlag);
+        builder.setCatalogAcroForm(builder.addObject(qMove(updatedAcroForm)));
+    }
+
+    if (!options.signReason.isEmpty())
+    {
+        builder.setSignatureReason(signatureDictionary, options.signReason);
+    }
+
+    if (!options.signContactInfo.isEmpty())
+    {
+        builder.setSignatureContactInfo(signatureDictionary, options.signContactInfo);
+    }
+
+    pdf::PDFDocument signedDocument = builder.build();
+
+    // 1) Append modified objects to the original data
+    QByteArray data = sourceData;
+    QBuffer buffer(&data);
+    buffer.open(QBuffer::ReadWrite);
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    pdf::PDFOperationResult result = writer.writeIncremental(&buffer, &signedDocument);
+    buffer.close();
+
+    if (!result)
+    {
+        errorMessage = result.getErrorMessage();
+        return QByteArray();
+    }
+
+    const qsizetype indexOfContents = data.indexOf(reservedContentsHex, sourceData.size());
+    if (indexOfContents == -1 || indexOfContents == 0 || data[indexOfContents - 1] != '<')
+    {
+        errorMessage = PDFToolTranslationContext::tr("Failed to reserve space for the signature.");
+        return QByteArray();
+    }
+
+    // 2) Write byte ranges, they exclude the contents including delimiters
+    const pdf::PDFInteger i1 = 0;
+    const pdf::PDFInteger i2 = indexOfContents - 1;
+    const pdf::PDFInteger i3 = i2 + reservedContentsHex.size() + 2;
+    const pdf::PDFInteger i4 = data.size() - i3;
+
+    for (pdf::PDFInteger offset : { i4, i3, i2, i1 })
+    {
+        const qsizetype index = data.lastIndexOf(offsetMarkString, indexOfContents);
+        if (index < sourceData.size())
+        {
+            errorMessage = PDFToolTranslationContext::tr("Failed to reserve space for the signature.");
+            return QByteArray();
+        }
+
+        QByteArray offsetString = QByteArray::number(offset).leftJustified(offsetMarkString.size(), ' ', true);
+        data.replace(index, offsetString.size(), offsetString);
+    }
+
+    // 3) Sign the byte ranges and write the signature, unused
+    //    space reserved for the signature is filled by zeroes.
+    QByteArray dataToBeSigned = data.mid(i1, i2);
+    dataToBeSigned.append(data.mid(i3, i4));
+
+    QByteArray signature;
+    if (!signingKey->sign(dataToBeSigned, signature))
+    {
+        errorMessage = PDFToolTranslationContext::tr("Failed to create digital signature.");
+        return QByteArray();
+    }
+
+    QByteArray signatureHex = signature.toHex();
+    if (signatureHex.size() > reservedContentsHex.size())
+    {
+        errorMessage = PDFToolTranslationContext::tr("Signature requires %1 bytes, but only %2 bytes are reserved.").arg(signature.size()).arg(options.signReservedSize);
+        return QByteArray();
+    }
+
+    signatureHex = signatureHex.leftJustified(reservedContentsHex.size(), '0');
+    data.replace(indexOfContents, signatureHex.size(), signatureHex);
+    return data;
+}
+
+QString PDFToolSign::getOutputFileName(const PDFToolOptions& options)
+{
+    if (options.signInPlace)
+    {
+        return options.document;
+    }
+
+    QFileInfo fileInfo(options.document);
+    QDir directory = options.signOutputDirectory.isEmpty() ? fileInfo.dir() : QDir(options.signOutputDirectory);
+    return directory.filePath(fileInfo.completeBaseName() + "_signed.pdf");
+}
+
+}   // namespace pdftool
@@ -0,0 +1,78 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT. If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFTOOLSIGN_H
+#define PDFTOOLSIGN_H
+
+#include "pdftoolabstractapplication.h"
+#include "pdfcertificatemanager.h"
+
+#include <mutex>
+
+namespace pdftool
+{
+
+/// Signs documents using private key and certificate from PKCS#12 file.
+/// Signature is appended to the document using incremental update, so
+/// the original content (and existing signatures) remain valid. Space for
+/// the signature is reserved in the signature dictionary, and only byte
+/// ranges around it are signed. Certificate file is read only once, so
+/// large batches of documents (option --batch) can be signed in parallel.
+class PDFToolSign : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+
+protected:
+    virtual void initializeApplicationCommandLineParser(QCommandLineParser* parser) const override;
+    virtual void readApplicationOptions(QCommandLineParser* parser, PDFToolOptions& options) const override;
+
+private:
+    /// Returns signing key, which is loaded only once. If key can't be loaded,
+    /// then nullptr is returned and error message is set.
+    /// \param options Options
+    /// \param[out] errorMessage Error message
+    const pdf::PDFSigningKey* getSigningKey(const PDFToolOptions& options, QString& errorMessage);
+
+    /// Signs the document and returns signed document data. If error
+    /// occurs, empty data are returned and error message is set.
+    /// \param options Options
+    /// \param document Document
+    /// \param sourceData Source data of the document
+    /// \param signingKey Signing key
+    /// \param[out] errorMessage Error message
+    static QByteArray signDocument(const PDFToolOptions& options,
+                                   const pdf::PDFDocument& document,
+                                   const QByteArray& sourceData,
+                                   const pdf::PDFSigningKey* signingKey,
+                                   QString& errorMessage);
+
+    /// Returns output file name of the signed document
+    /// \param options Options
+    static QString getOutputFileName(const PDFToolOptions& options);
+
+    std::once_flag m_signingKeyLoadedFlag;
+    pdf::PDFSigningKey m_signingKey;
+    QString m_signingKeyErrorMessage;
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLSIGN_H
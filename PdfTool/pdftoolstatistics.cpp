@@ -47,15 +47,19 @@ QString PDFToolStatisticsApplication::getStandardString(StandardString standardS
 int PDFToolStatisticsApplication::execute(const PDFToolOptions& options)
 {
     pdf::PDFDocument document;
-    QByteArray sourceData;
-    if (!readDocument(options, document, &sourceData, false))
+    if (!readDocument(options, document, nullptr, false))
     {
         return ErrorDocumentReading;
     }
 
+    // With lazy loading, object sizes are taken from the cross reference table,
+    // so objects (and stream data) need not to be loaded and parsed.
+    const pdf::PDFObjectClassifier::StatisticsMode statisticsMode = options.lazyLoading ? pdf::PDFObjectClassifier::StatisticsMode::Metadata
+                                                                                       : pdf::PDFObjectClassifier::StatisticsMode::Full;
+
     pdf::PDFObjectClassifier classifier;
     classifier.classify(&document);
-    pdf::PDFObjectClassifier::Statistics statistics = classifier.calculateStatistics(&document);
+    pdf::PDFObjectClassifier::Statistics statistics = classifier.calculateStatistics(&document, statisticsMode);
 
     QLocale locale;
 
@@ -91,7 +95,7 @@ int PDFToolStatisticsApplication::execute(const PDFToolOptions& options)
 
             const pdf::PDFObjectClassifier::StatisticsItem& statisticsItem = it->second;
 
-            qreal percentage = qreal(100.0) * qreal(statisticsItem.bytes) / qreal(totalBytesCount);
+            qreal percentage = totalBytesCount > 0 ? qreal(100.0) * qreal(statisticsItem.bytes) / qreal(totalBytesCount) : qreal(0.0);
 
             formatter.beginTableRow("item", int(type));
             formatter.writeTableColumn("class", classText);
@@ -20,7 +20,9 @@
 #include "pdfdocumentreader.h"
 #include "pdfoptimizer.h"
 #include "pdfdocumentwriter.h"
+#include "pdfdocumentmanipulator.h"
 
+#include <QFile>
 #include <QFileInfo>
 
 namespace pdftool
@@ -67,6 +69,11 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
         return ErrorFailedWriteToFile;
     }
 
+    if (options.uniteStreaming)
+    {
+        return executeStreaming(options, files, targetFile);
+    }
+
     try
     {
         pdf::PDFDocumentBuilder documentBuilder;
@@ -206,6 +213,9 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
         mergedDocument = finalBuilder.build();
 
         pdf::PDFDocumentWriter writer(nullptr);
+        writer.setObjectStreamsEnabled(options.writeObjectStreams);
+        writer.setObjectsPerStream(options.writeObjectsPerStream);
+        writer.setLinearizationEnabled(options.writeLinearized);
         pdf::PDFOperationResult result = writer.write(targetFile, &mergedDocument, false);
         if (!result)
         {
@@ -222,9 +232,52 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
     return ExitSuccess;
 }
 
+int PDFToolUnite::executeStreaming(const PDFToolOptions& options, const QStringList& files, const QString& targetFile)
+{
+    std::vector<pdf::PDFDocumentManipulator::DocumentLoader> loaders;
+    for (const QString& fileName : files)
+    {
+        loaders.emplace_back([&options, fileName]()
+        {
+            pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, options.permissiveReading, false);
+            pdf::PDFDocument document = reader.readFromFile(fileName);
+            if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+            {
+                throw pdf::PDFException(PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(fileName));
+            }
+
+            if (!document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::Assemble))
+            {
+                throw pdf::PDFException(PDFToolTranslationContext::tr("Document doesn't allow to assemble pages."));
+            }
+
+            return document;
+        });
+    }
+
+    QFile file(targetFile);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open file '%1' for writing.").arg(targetFile), options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+
+    pdf::PDFOperationResult result = pdf::PDFDocumentManipulator::assembleToDevice(&file, loaders);
+    file.close();
+
+    if (!result)
+    {
+        file.remove();
+        PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+
+    return ExitSuccess;
+}
+
 PDFToolAbstractApplication::Options PDFToolUnite::getOptionsFlags() const
 {
-    return ConsoleFormat | Unite;
+    return ConsoleFormat | Unite | DocumentWriter;
 }
 
 }   // namespace pdftool
@@ -29,6 +29,9 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+
+private:
+    int executeStreaming(const PDFToolOptions& options, const QStringList& files, const QString& targetFile);
 };
 
 }   // namespace pdftool
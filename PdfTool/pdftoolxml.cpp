@@ -19,8 +19,14 @@
 #include "pdfvisitor.h"
 #include "pdfencoding.h"
 #include "pdfexception.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfstreamfilters.h"
 
 #include <QXmlStreamWriter>
+#include <QStringDecoder>
+
+#include <optional>
+#include <functional>
 
 namespace pdftool
 {
@@ -30,10 +36,11 @@ static PDFToolXmlApplication s_xmlApplication;
 class PDFXmlExportVisitor : public pdf::PDFAbstractVisitor
 {
 public:
-    PDFXmlExportVisitor(QXmlStreamWriter* writer, const pdf::PDFDocument* document, const PDFToolOptions* options) :
+    PDFXmlExportVisitor(QXmlStreamWriter* writer, const pdf::PDFDocument* document, const PDFToolOptions* options, std::function<void()> flush = nullptr) :
         m_writer(writer),
         m_options(options),
-        m_document(document)
+        m_document(document),
+        m_flush(std::move(flush))
     {
 
     }
@@ -50,11 +57,38 @@ public:
     virtual void visitReference(const pdf::PDFObjectReference reference) override;
 
 private:
+    /// Size of the chunk of stream data, which is converted and written at once
+    static constexpr qsizetype CHUNK_SIZE = 64 * 1024;
+
+    enum class TextEncoding
+    {
+        Binary,
+        Utf16BE,
+        Utf16LE,
+        Utf8,
+        PDFDoc
+    };
+
     void writeTextOrBinary(const QByteArray& stream, QString name);
 
+    /// Writes decoded stream data as text, if data can be interpreted as text.
+    /// Stream is decoded twice in chunks - first time, text encoding is determined,
+    /// second time, text is written. So whole decoded stream is never held in memory.
+    void writeStreamText(const pdf::PDFStream* stream);
+
+    /// Determines text encoding of the decoded stream data, using the same rules
+    /// as PDFEncoding::convertSmartFromByteStringToUnicode.
+    TextEncoding getStreamTextEncoding(const pdf::PDFStream* stream) const;
+
+    /// Decodes stream data incrementally, returns false, if stream can't be decoded
+    bool decodeStream(const pdf::PDFStream* stream, pdf::PDFStreamDecoderSink sink) const;
+
+    void flush();
+
     QXmlStreamWriter* m_writer;
     const PDFToolOptions* m_options;
     const pdf::PDFDocument* m_document;
+    std::function<void()> m_flush;
 };
 
 void PDFXmlExportVisitor::visitNull()
@@ -117,30 +151,133 @@ void PDFXmlExportVisitor::visitStream(const pdf::PDFStream* stream)
 
     if (m_options->xmlExportStreams)
     {
-        m_writer->writeTextElement("data", QString::fromLatin1(stream->getContent()->toHex()).toUpper());
+        const QByteArray* content = stream->getContent();
+
+        m_writer->writeStartElement("data");
+        for (qsizetype offset = 0; offset < content->size(); offset += CHUNK_SIZE)
+        {
+            m_writer->writeCharacters(QString::fromLatin1(content->mid(offset, CHUNK_SIZE).toHex()).toUpper());
+            flush();
+        }
+        m_writer->writeEndElement();
     }
 
     if (m_options->xmlExportStreamsAsText)
     {
-        try
+        writeStreamText(stream);
+    }
+
+    m_writer->writeEndElement();
+}
+
+void PDFXmlExportVisitor::writeStreamText(const pdf::PDFStream* stream)
+{
+    try
+    {
+        // Attempt to decode the stream. Exception can be thrown.
+        const TextEncoding encoding = getStreamTextEncoding(stream);
+
+        std::optional<QStringDecoder> decoder;
+        switch (encoding)
         {
-            // Attempt to decode the stream. Exception can be thrown.
-            QByteArray decodedData = m_document->getDecodedStream(stream);
+            case TextEncoding::Binary:
+                return;
 
-            bool isBinary = true;
-            QString text = pdf::PDFEncoding::convertSmartFromByteStringToUnicode(decodedData, &isBinary);
-            if (!isBinary)
-            {
-                m_writer->writeTextElement("text", text);
-            }
+            case TextEncoding::Utf16BE:
+                decoder.emplace(QStringDecoder::Utf16BE);
+                break;
+
+            case TextEncoding::Utf16LE:
+                decoder.emplace(QStringDecoder::Utf16LE);
+                break;
+
+            case TextEncoding::Utf8:
+                decoder.emplace(QStringDecoder::Utf8);
+                break;
+
+            case TextEncoding::PDFDoc:
+                break;
         }
-        catch (const pdf::PDFException &)
+
+        m_writer->writeStartElement("text");
+
+        auto writeChunk = [this, &decoder](const char* data, qsizetype size)
+        {
+            const QByteArray chunk = QByteArray::fromRawData(data, size);
+            m_writer->writeCharacters(decoder ? QString(decoder->decode(chunk)) : pdf::PDFEncoding::convert(chunk, pdf::PDFEncoding::Encoding::PDFDoc));
+            flush();
+        };
+        decodeStream(stream, writeChunk);
+
+        m_writer->writeEndElement();
+    }
+    catch (const pdf::PDFException &)
+    {
+        // Do nothing
+    }
+}
+
+PDFXmlExportVisitor::TextEncoding PDFXmlExportVisitor::getStreamTextEncoding(const pdf::PDFStream* stream) const
+{
+    QByteArray leadBytes;
+    QStringDecoder decoderUtf16BE(QStringDecoder::Utf16BE);
+    QStringDecoder decoderUtf16LE(QStringDecoder::Utf16LE);
+    QStringDecoder decoderUtf8(QStringDecoder::Utf8);
+    bool isPDFDocEncoding = true;
+
+    auto checkChunk = [&](const char* data, qsizetype size)
+    {
+        const QByteArray chunk = QByteArray::fromRawData(data, size);
+
+        if (leadBytes.size() < 3)
         {
-            // Do nothing
+            leadBytes.append(chunk.left(3 - leadBytes.size()));
         }
+
+        decoderUtf16BE.decode(chunk);
+        decoderUtf16LE.decode(chunk);
+        decoderUtf8.decode(chunk);
+        isPDFDocEncoding = isPDFDocEncoding && pdf::PDFEncoding::canConvertFromEncoding(chunk, pdf::PDFEncoding::Encoding::PDFDoc);
+    };
+
+    if (!decodeStream(stream, checkChunk))
+    {
+        return TextEncoding::Binary;
     }
 
-    m_writer->writeEndElement();
+    if (pdf::PDFEncoding::hasUnicodeLeadMarkings(leadBytes))
+    {
+        if (!decoderUtf16BE.hasError())
+        {
+            return TextEncoding::Utf16BE;
+        }
+
+        if (!decoderUtf16LE.hasError())
+        {
+            return TextEncoding::Utf16LE;
+        }
+    }
+
+    if (pdf::PDFEncoding::hasUTF8LeadMarkings(leadBytes) && !decoderUtf8.hasError())
+    {
+        return TextEncoding::Utf8;
+    }
+
+    return isPDFDocEncoding ? TextEncoding::PDFDoc : TextEncoding::Binary;
+}
+
+bool PDFXmlExportVisitor::decodeStream(const pdf::PDFStream* stream, pdf::PDFStreamDecoderSink sink) const
+{
+    auto objectFetcher = [this](const pdf::PDFObject& object) -> const pdf::PDFObject& { return m_document->getObject(object); };
+    return pdf::PDFStreamFilterStorage::decodeStream(stream, objectFetcher, m_document->getStorage().getSecurityHandler(), std::move(sink));
+}
+
+void PDFXmlExportVisitor::flush()
+{
+    if (m_flush)
+    {
+        m_flush();
+    }
 }
 
 void PDFXmlExportVisitor::visitReference(const pdf::PDFObjectReference reference)
@@ -201,46 +338,131 @@ int PDFToolXmlApplication::execute(const PDFToolOptions& options)
         return ErrorDocumentReading;
     }
 
-    QString xmlString;
-    QXmlStreamWriter writer(&xmlString);
-
-    if (options.xmlUseIndent)
+    // Objects are written in the order of object numbers, each object is serialized
+    // into its own xml fragment, so fragments can be serialized in parallel (in batches) and
+    // written in order. Large streams are serialized alone and written in chunks. So memory
+    // consumption doesn't depend on the size of the document.
+    auto initializeWriter = [&options](QXmlStreamWriter& writer)
     {
-        writer.setAutoFormatting(true);
-        writer.setAutoFormattingIndent(2);
-    }
+        if (options.xmlUseIndent)
+        {
+            writer.setAutoFormatting(true);
+            writer.setAutoFormattingIndent(2);
+        }
+    };
+
+    QString headerString;
+    QXmlStreamWriter headerWriter(&headerString);
+    initializeWriter(headerWriter);
 
     QString comment = QString("Processed by %1 %2").arg(QCoreApplication::applicationName(), QCoreApplication::applicationVersion());
-    writer.writeStartDocument();
-    writer.writeComment(comment);
-    writer.writeStartElement("document");
+    headerWriter.writeStartDocument();
+    headerWriter.writeComment(comment);
+    headerString += options.xmlUseIndent ? "\n<document>" : "<document>";
+    PDFConsole::writeText(headerString, options.outputCodec);
 
-    PDFXmlExportVisitor visitor(&writer, &document, &options);
-    writer.writeStartElement("trailer");
-    document.getStorage().getTrailerDictionary().accept(&visitor);
-    writer.writeEndElement();
+    const pdf::PDFObjectStorage& storage = document.getStorage();
 
-    pdf::PDFObjectStorage::PDFObjects entries = document.getStorage().getObjects();
-    for (pdf::PDFInteger i = 0; i < pdf::PDFInteger(entries.size()); ++i)
+    // Serializes object into xml fragment. Fragment is written as a child of the document
+    // element, so indentation is the same as if whole document were written by one writer.
+    const qsizetype fragmentPrefixLength = QLatin1String("<document>").size();
+    auto serialize = [&](const QString& name, const pdf::PDFObject& object, pdf::PDFInteger id, pdf::PDFInteger generation, std::function<void(QString&&)> flush)
     {
-        const pdf::PDFObjectStorage::Entry& entry = entries[i];
+        QString fragment;
+        QXmlStreamWriter writer(&fragment);
+        initializeWriter(writer);
+        writer.writeStartElement("document");
+
+        qsizetype prefixLength = fragmentPrefixLength;
+        auto flushFragment = [&]()
+        {
+            if (flush)
+            {
+                flush(fragment.mid(prefixLength));
+                fragment.clear();
+                prefixLength = 0;
+            }
+        };
 
-        if (entry.object.isNull())
+        PDFXmlExportVisitor visitor(&writer, &document, &options, flush ? std::function<void()>(flushFragment) : nullptr);
+        writer.writeStartElement(name);
+        if (id >= 0)
+        {
+            writer.writeAttribute("id", QString::number(id));
+            writer.writeAttribute("gen", QString::number(generation));
+        }
+        object.accept(&visitor);
+        writer.writeEndElement();
+
+        return fragment.mid(prefixLength);
+    };
+
+    auto writeFragment = [&options](QString&& fragment)
+    {
+        PDFConsole::writeText(fragment, options.outputCodec);
+    };
+
+    PDFConsole::writeText(serialize("trailer", storage.getTrailerDictionary(), -1, 0, nullptr), options.outputCodec);
+
+    const bool isStreamDataExported = options.xmlExportStreams || options.xmlExportStreamsAsText;
+    const size_t maxBatchSize = size_t(16 * pdf::PDFExecutionPolicy::getIdealThreadCount(pdf::PDFExecutionPolicy::Scope::Unknown));
+    constexpr pdf::PDFInteger LARGE_STREAM_SIZE = 256 * 1024;
+
+    // Batch of objects serialized in parallel (object reference and its xml fragment)
+    std::vector<std::pair<pdf::PDFObjectReference, QString>> batch;
+    batch.reserve(maxBatchSize);
+
+    auto writeBatch = [&]()
+    {
+        auto serializeObject = [&](std::pair<pdf::PDFObjectReference, QString>& item)
+        {
+            const pdf::PDFObjectReference reference = item.first;
+            item.second = serialize("pdfobject", storage.getObject(reference), reference.objectNumber, reference.generation, nullptr);
+        };
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, batch.begin(), batch.end(), serializeObject);
+
+        for (const auto& item : batch)
+        {
+            PDFConsole::writeText(item.second, options.outputCodec);
+        }
+
+        batch.clear();
+    };
+
+    const pdf::PDFInteger objectCount = pdf::PDFInteger(storage.getObjectCount());
+    for (pdf::PDFInteger i = 0; i < objectCount; ++i)
+    {
+        const pdf::PDFObjectStorage::ObjectMetadata metadata = storage.getObjectMetadata(i);
+        if (!metadata.isOccupied)
         {
             continue;
         }
 
-        writer.writeStartElement("pdfobject");
-        writer.writeAttribute("id", QString::number(i));
-        writer.writeAttribute("gen", QString::number(entry.generation));
-        entry.object.accept(&visitor);
-        writer.writeEndElement();
-    }
+        const pdf::PDFObjectReference reference(i, metadata.generation);
+        const pdf::PDFObject& object = storage.getObject(reference);
+
+        if (object.isNull())
+        {
+            continue;
+        }
+
+        if (isStreamDataExported && object.isStream() && object.getStream()->getContent()->size() > LARGE_STREAM_SIZE)
+        {
+            // Large stream is serialized alone, in chunks
+            writeBatch();
+            writeFragment(serialize("pdfobject", object, reference.objectNumber, reference.generation, writeFragment));
+            continue;
+        }
 
-    writer.writeEndElement();
-    writer.writeEndDocument();
+        batch.emplace_back(reference, QString());
+        if (batch.size() >= maxBatchSize)
+        {
+            writeBatch();
+        }
+    }
+    writeBatch();
 
-    PDFConsole::writeText(xmlString, options.outputCodec);
+    PDFConsole::writeText(options.xmlUseIndent ? "\n</document>\n" : "</document>\n", options.outputCodec);
     return ExitSuccess;
 }
 
@@ -27,8 +27,22 @@
 #include "pdfdocument.h"
 #include "pdfexception.h"
 #include "pdfjbig2decoder.h"
+#include "pdfsimd.h"
+#include "pdfpainter.h"
+#include "pdfgpugeometry.h"
+#include "pdfnametable.h"
+#include "pdfnametounicode.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfdocumentreader.h"
+#include "pdfdocumentwriter.h"
+#include "pdfutils.h"
+
+#include <QBuffer>
 
 #include <regex>
+#include <set>
+#include <thread>
+#include <tuple>
 
 #ifdef PDF4QT_COMPILER_MSVC
 #pragma warning(push)
@@ -46,26 +60,53 @@ public:
 private slots:
     void test_null();
     void test_numbers();
+    void test_numbers_fast_path();
     void test_strings();
     void test_name();
     void test_bool();
     void test_ad();
     void test_command();
+    void test_content_tokens();
     void test_invalid_input();
     void test_header_regexp();
     void test_flat_map();
     void test_lzw_filter();
+    void test_incremental_filters();
+    void test_predictor_kernels();
+    void test_predictor_invalid_columns();
     void test_sampled_function();
     void test_exponential_function();
     void test_stitching_function();
     void test_postscript_function();
+    void test_baked_function();
     void test_jbig2_arithmetic_decoder();
+    void test_decoded_stream_cache();
+    void test_object_arena();
+    void test_name_table();
+    void test_glyph_name_to_unicode();
+    void test_precompiled_page_serialization();
+    void test_gpu_page_geometry();
+    void test_document_writer_incremental();
+    void test_document_writer_object_streams();
+    void test_document_writer_linearized();
+    void test_buffered_bit_reader();
 
 private:
     void scanWholeStream(const char* stream);
     void testTokens(const char* stream, const std::vector<pdf::PDFLexicalAnalyzer::Token>& tokens);
 
     QString getStringFromTokens(const std::vector<pdf::PDFLexicalAnalyzer::Token>& tokens);
+
+    void compareWrittenObjects(const pdf::PDFDocument& expected, const pdf::PDFDocument& actual);
+    void compareWrittenPages(const pdf::PDFDocument& expected, const pdf::PDFDocument& actual);
+
+    pdf::PDFDocument createWriterTestDocument();
+    pdf::PDFDocument readWrittenDocument(const QByteArray& data);
+    pdf::PDFObject createContentStream(QByteArray content);
+    pdf::PDFInteger getObjectNumberAt(const QByteArray& data, qint64 offset);
+    pdf::PDFInteger getStartXRef(const QByteArray& data);
+
+    static constexpr int WRITER_TEST_PAGE_COUNT = 4;
 };
 
 LexicalAnalyzerTest::LexicalAnalyzerTest()
@@ -101,6 +142,41 @@ void LexicalAnalyzerTest::test_numbers()
     testTokens("1000000000000000000000000000", { Token(Type::Real, 1e27) });
 }
 
+void LexicalAnalyzerTest::test_numbers_fast_path()
+{
+    using Token = pdf::PDFLexicalAnalyzer::Token;
+    using Type = pdf::PDFLexicalAnalyzer::TokenType;
+
+    auto real = [](const char* text) { return Token(Type::Real, QByteArray(text).toDouble()); };
+
+    // Long fractional parts
+    testTokens("0.123456789012345", { real("0.123456789012345") });
+    testTokens("0.1234567890123456", { real("0.1234567890123456") });
+    testTokens("3.14159265358979323846", { real("3.14159265358979323846") });
+    testTokens("-0.000000000000000000001", { real("-0.000000000000000000001") });
+    testTokens("123456789.987654321", { real("123456789.987654321") });
+
+    // Leading and trailing dot
+    testTokens(".5 -.5 +.25 -.0 5.", { real(".5"), real("-.5"), real("+.25"), real("-.0"), real("5.") });
+    testTokens("[.5]", { Token(Type::ArrayStart), real(".5"), Token(Type::ArrayEnd) });
+
+    // Values beyond the integer range
+    testTokens("92233720368547758", { Token(Type::Integer, pdf::PDFInteger(92233720368547758)) });
+    testTokens("92233720368547759", { real("92233720368547759") });
+    testTokens("-9223372036854775808", { real("-9223372036854775808") });
+    testTokens("18446744073709551616", { real("18446744073709551616") });
+    testTokens("123456789012345678901234567890", { real("123456789012345678901234567890") });
+
+    // Exponents and other garbage are not valid numbers in PDF
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("1e5"));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("1.5E-3"));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("2.3.4"));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("--5"));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("5-"));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("-."));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream("0x10"));
+}
+
 void LexicalAnalyzerTest::test_strings()
 {
     using Token = pdf::PDFLexicalAnalyzer::Token;
@@ -215,6 +291,27 @@ void LexicalAnalyzerTest::test_command()
     testTokens("command1 command2", { Token(Type::Command, QByteArray("command1")), Token(Type::Command, QByteArray("command2")) });
 }
 
+void LexicalAnalyzerTest::test_content_tokens()
+{
+    QByteArray stream("q 1 0 0 -1.5 .5 +3 cm /Name /Na#20me (string (nested) \\(escaped\\)) <414243> [1 true false null] << /Key 2 >> BT ET Q");
+
+    pdf::PDFLexicalAnalyzer analyzer(stream.constBegin(), stream.constEnd());
+    pdf::PDFLexicalAnalyzer contentAnalyzer(stream.constBegin(), stream.constEnd());
+
+    while (!analyzer.isAtEnd())
+    {
+        pdf::PDFLexicalAnalyzer::Token token = analyzer.fetch();
+        pdf::PDFLexicalAnalyzer::ContentToken contentToken = contentAnalyzer.fetchContentToken();
+
+        QCOMPARE(contentToken.type, token.type);
+        QCOMPARE(pdf::PDFLexicalAnalyzer::toToken(contentToken), token);
+        QCOMPARE(contentAnalyzer.pos(), analyzer.pos());
+    }
+
+    QVERIFY(contentAnalyzer.isAtEnd());
+    QCOMPARE(contentAnalyzer.fetchContentToken().type, pdf::PDFLexicalAnalyzer::TokenType::EndOfFile);
+}
+
 void LexicalAnalyzerTest::test_invalid_input()
 {
     QByteArray bigNumber(500, '0');
@@ -322,6 +419,120 @@ void LexicalAnalyzerTest::test_lzw_filter()
     QCOMPARE(decoded, valid);
 }
 
+void LexicalAnalyzerTest::test_incremental_filters()
+{
+    auto fetcher = [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; };
+
+    // Decode data pushed byte by byte, result must be the same as decoding all data at once
+    auto decodeIncrementally = [&fetcher](const pdf::PDFStreamFilter& filter, const QByteArray& data)
+    {
+        QByteArray result;
+        pdf::PDFStreamDecoderPointer decoder = filter.createDecoder(fetcher, pdf::PDFObject(), nullptr, [&result](const char* decodedData, qsizetype size) { result.append(decodedData, size); });
+        for (const char byte : data)
+        {
+            decoder->push(&byte, 1);
+        }
+        decoder->finish();
+        return result;
+    };
+
+    QByteArray data;
+    for (int i = 0; i < 100000; ++i)
+    {
+        data.push_back(static_cast<char>((i * 7) % 13 + (i / 1000)));
+    }
+
+    pdf::PDFFlateDecodeFilter flateFilter;
+    QByteArray compressedData = pdf::PDFFlateDecodeFilter::compress(data);
+    QCOMPARE(flateFilter.apply(compressedData, fetcher, pdf::PDFObject(), nullptr), data);
+    QCOMPARE(decodeIncrementally(flateFilter, compressedData), data);
+
+    // Size hint (/DL entry) is not trusted, wrong hints must not change the result
+    QCOMPARE(pdf::PDFFlateDecodeFilter::uncompress(compressedData, data.size()), data);
+    QCOMPARE(pdf::PDFFlateDecodeFilter::uncompress(compressedData, 10), data);
+    QCOMPARE(pdf::PDFFlateDecodeFilter::uncompress(compressedData, compressedData.size() * 1000), data);
+    QCOMPARE(pdf::PDFFlateDecodeFilter::uncompress(compressedData, std::numeric_limits<int>::max()), data);
+
+    pdf::PDFLzwDecodeFilter lzwFilter;
+    QCOMPARE(decodeIncrementally(lzwFilter, QByteArray::fromHex("800B6050220C0C8501")), QByteArray("-----A---B"));
+
+    pdf::PDFAscii85DecodeFilter ascii85Filter;
+    QByteArray ascii85Data = "87cURD_*#FDI[]uD.RU,@;I'1 DfTZ)+T~>";
+    QCOMPARE(decodeIncrementally(ascii85Filter, ascii85Data), QByteArray("Hello, incremental world!"));
+
+    pdf::PDFRunLengthDecodeFilter runLengthFilter;
+    QByteArray runLengthData = QByteArray::fromHex("02414243FD44004580");
+    QCOMPARE(decodeIncrementally(runLengthFilter, runLengthData), QByteArray("ABCDDDDE"));
+}
+
+void LexicalAnalyzerTest::test_predictor_kernels()
+{
+    auto fetcher = [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; };
+
+    auto createParameters = [](int predictor, int colors)
+    {
+        std::shared_ptr<pdf::PDFDictionary> dictionary = std::make_shared<pdf::PDFDictionary>();
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("Predictor"), pdf::PDFObject::createInteger(predictor));
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("Colors"), pdf::PDFObject::createInteger(colors));
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("Columns"), pdf::PDFObject::createInteger(37));
+        return pdf::PDFObject::createDictionary(qMove(dictionary));
+    };
+
+    // Data contain lines with all PNG predictors (line predictor is the first byte of the line)
+    QByteArray data;
+    for (int i = 0; i < 4 * 37 * 20 + 20; ++i)
+    {
+        data.push_back(static_cast<char>((i * 31 + i / 7) % 251));
+    }
+
+    for (const int colors : { 1, 3, 4 })
+    {
+        for (const int predictor : { 2, 15 })
+        {
+            const qsizetype lineSize = (predictor == 2) ? colors * 37 : colors * 37 + 1;
+            QByteArray predictedData = data.left(lineSize * 20);
+            for (int line = 0; line < 20 && predictor != 2; ++line)
+            {
+                predictedData[line * lineSize] = static_cast<char>(line % 5);
+            }
+
+            pdf::PDFStreamPredictor streamPredictor = pdf::PDFStreamPredictor::createPredictor(fetcher, createParameters(predictor, colors));
+
+            pdf::PDFSimd::setInstructionSetLimit(pdf::PDFSimd::InstructionSet::Scalar);
+            QByteArray scalarResult = streamPredictor.apply(predictedData);
+            pdf::PDFSimd::setInstructionSetLimit(pdf::PDFSimd::InstructionSet::NEON); // No limit
+            QByteArray simdResult = streamPredictor.apply(predictedData);
+
+            QCOMPARE(scalarResult.size(), colors * 37 * 20);
+            QCOMPARE(simdResult, scalarResult);
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_predictor_invalid_columns()
+{
+    auto fetcher = [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; };
+
+    auto createParameters = [](int predictor, int colors, int bitsPerComponent, pdf::PDFInteger columns)
+    {
+        std::shared_ptr<pdf::PDFDictionary> dictionary = std::make_shared<pdf::PDFDictionary>();
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("Predictor"), pdf::PDFObject::createInteger(predictor));
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("Colors"), pdf::PDFObject::createInteger(colors));
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("BitsPerComponent"), pdf::PDFObject::createInteger(bitsPerComponent));
+        dictionary->addEntry(pdf::PDFInplaceOrMemoryString("Columns"), pdf::PDFObject::createInteger(columns));
+        return pdf::PDFObject::createDictionary(qMove(dictionary));
+    };
+
+    // Line length overflows 32-bit integer (stride was zero or negative), or it is too long
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, pdf::PDFStreamPredictor::createPredictor(fetcher, createParameters(2, 1, 8, 536870912)));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, pdf::PDFStreamPredictor::createPredictor(fetcher, createParameters(2, 1, 16, 268435456)));
+    QVERIFY_THROWS_EXCEPTION(pdf::PDFException, pdf::PDFStreamPredictor::createPredictor(fetcher, createParameters(15, 32, 16, std::numeric_limits<int>::max())));
+
+    // Valid predictor decodes data without hanging
+    pdf::PDFStreamPredictor streamPredictor = pdf::PDFStreamPredictor::createPredictor(fetcher, createParameters(2, 1, 8, 4));
+    QCOMPARE(streamPredictor.apply(QByteArray("\x01\x01\x01\x01", 4)), QByteArray("\x01\x02\x03\x04", 4));
+}
+
 void LexicalAnalyzerTest::test_sampled_function()
 {
     {
@@ -1063,6 +1274,77 @@ void LexicalAnalyzerTest::test_postscript_function()
     test01("2.0 1 index exch div exch pop", [](double x) { return x / 2.0; });
 }
 
+void LexicalAnalyzerTest::test_baked_function()
+{
+    auto createFunction = [](const char* domain, const char* range, const char* program) -> pdf::PDFFunctionPtr
+    {
+        QByteArray data = QString(" << /FunctionType 4 /Domain [ %1 ] /Range [ %2 ] /Length %3 >> stream\n%4 endstream")
+                              .arg(QString::fromLatin1(domain), QString::fromLatin1(range))
+                              .arg(std::strlen(program))
+                              .arg(QString::fromLatin1(program)).toLatin1();
+
+        pdf::PDFDocument document;
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::AllowStreams);
+        return pdf::PDFFunction::createFunction(&document, parser.getObject());
+    };
+
+    // Baked function must give the same results as the exact one
+    auto compare = [](const pdf::PDFFunctionPtr& function, const pdf::PDFFunctionPtr& bakedFunction)
+    {
+        const uint32_t m = function->getInputVariableCount();
+        const uint32_t n = function->getOutputVariableCount();
+        constexpr size_t count = 1000;
+
+        std::vector<double> inputs(count * m, 0.0);
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            inputs[i] = -0.25 + 1.5 * double((i * 7919) % 1000) / 999.0;
+        }
+
+        std::vector<double> expected(count * n, 0.0);
+        std::vector<double> actual(count * n, 0.0);
+        QVERIFY(function->applyBatch(inputs.data(), expected.data(), count));
+        QVERIFY(bakedFunction->applyBatch(inputs.data(), actual.data(), count));
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            QVERIFY(std::abs(expected[i] - actual[i]) < 1e-9);
+        }
+    };
+
+    constexpr size_t evaluationCount = 1 << 20;
+
+    // Linear functions of one and two variables are baked
+    for (auto [domain, range, program] : { std::make_tuple("0 1", "0 1 0 1 0 1", "{ dup 0.5 mul exch dup neg 1 add exch 4 div 0.25 add }"),
+                                           std::make_tuple("0 1 0 1", "0 1 0 1", "{ 2 copy add 0.5 mul 3 1 roll sub 0.5 mul 0.5 add }") })
+    {
+        pdf::PDFFunctionPtr function = createFunction(domain, range, program);
+        QVERIFY(function);
+        QVERIFY(function->isLinear());
+
+        pdf::PDFFunctionPtr bakedFunction = pdf::PDFFunction::createBakedFunction(function, evaluationCount);
+        QVERIFY(bakedFunction != function);
+        compare(function, bakedFunction);
+    }
+
+    // Non-linear functions, functions with clamped outputs and functions,
+    // which are evaluated only a few times, are not baked.
+    for (auto [domain, range, program] : { std::make_tuple("0 1", "0 1", "{ dup mul }"),
+                                           std::make_tuple("0 1", "0 1", "{ 2 mul }"),
+                                           std::make_tuple("0 1", "0 1", "{ dup 0.5 gt { 1.0 exch sub } if }"),
+                                           std::make_tuple("0 1 0 1", "0 1", "{ mul }") })
+    {
+        pdf::PDFFunctionPtr function = createFunction(domain, range, program);
+        QVERIFY(function);
+        QVERIFY(!function->isLinear());
+        QVERIFY(pdf::PDFFunction::createBakedFunction(function, evaluationCount) == function);
+    }
+
+    pdf::PDFFunctionPtr function = createFunction("0 1", "0 1", "{ 0.5 mul }");
+    QVERIFY(function->isLinear());
+    QVERIFY(pdf::PDFFunction::createBakedFunction(function, 16) == function);
+}
+
 void LexicalAnalyzerTest::test_jbig2_arithmetic_decoder()
 {
     std::vector<uint8_t> compressed = { 0x84, 0xC7, 0x3B, 0xFC, 0xE1, 0xA1, 0x43, 0x04, 0x02, 0x20, 0x00, 0x00, 0x41, 0x0D, 0xBB, 0x86, 0xF4, 0x31, 0x7F, 0xFF, 0x88, 0xFF, 0x37, 0x47, 0x1A, 0xDB, 0x6A, 0xDF, 0xFF, 0xAC };
@@ -1102,6 +1384,788 @@ void LexicalAnalyzerTest::test_jbig2_arithmetic_decoder()
     QVERIFY(decompressed == decompressedByAD);
 }
 
+void LexicalAnalyzerTest::test_decoded_stream_cache()
+{
+    auto createStream = [](int size)
+    {
+        return std::make_shared<pdf::PDFStream>(pdf::PDFDictionary(), QByteArray(size, 'x'));
+    };
+
+    pdf::PDFDecodedStreamCache cache(100);
+    std::shared_ptr<pdf::PDFStream> stream1 = createStream(40);
+    std::shared_ptr<pdf::PDFStream> stream2 = createStream(40);
+    std::shared_ptr<pdf::PDFStream> stream3 = createStream(40);
+
+    QByteArray data;
+    QVERIFY(!cache.find(stream1.get(), data));
+
+    cache.insert(stream1.get(), *stream1->getContent());
+    cache.insert(stream2.get(), *stream2->getContent());
+    QVERIFY(cache.find(stream1.get(), data));
+    QCOMPARE(data, *stream1->getContent());
+
+    // Stream 2 is least recently used, it must be removed
+    cache.insert(stream3.get(), *stream3->getContent());
+    QVERIFY(cache.find(stream1.get(), data));
+    QVERIFY(!cache.find(stream2.get(), data));
+    QVERIFY(cache.find(stream3.get(), data));
+
+    // Too large data and streams not owned by the shared pointer are not cached
+    pdf::PDFStream temporaryStream(pdf::PDFDictionary(), QByteArray(10, 'x'));
+    cache.insert(&temporaryStream, *temporaryStream.getContent());
+    QVERIFY(!cache.find(&temporaryStream, data));
+
+    std::shared_ptr<pdf::PDFStream> largeStream = createStream(200);
+    cache.insert(largeStream.get(), *largeStream->getContent());
+    QVERIFY(!cache.find(largeStream.get(), data));
+
+    pdf::PDFDecodedStreamCache::Statistics statistics = cache.getStatistics();
+    QCOMPARE(statistics.hits, quint64(3));
+    QCOMPARE(statistics.misses, quint64(4));
+    QCOMPARE(statistics.itemCount, size_t(2));
+    QCOMPARE(statistics.memoryConsumption, qint64(80));
+
+    cache.setMemoryLimit(50);
+    QCOMPARE(cache.getStatistics().itemCount, size_t(1));
+
+    cache.clear();
+    QCOMPARE(cache.getStatistics().memoryConsumption, qint64(0));
+
+    // Storages cache decoded streams only, when cache is explicitly created
+    pdf::PDFObjectStorage storage;
+    QVERIFY(!storage.getDecodedStreamCache());
+    storage.createDecodedStreamCache();
+    QVERIFY(storage.getDecodedStreamCache());
+    pdf::PDFObjectStorage storageCopy = storage;
+    QCOMPARE(storageCopy.getDecodedStreamCache(), storage.getDecodedStreamCache());
+}
+
+void LexicalAnalyzerTest::test_object_arena()
+{
+    const char data[] = "<< /Type /Test /Items [ 1 2 (a string longer than inplace strings can hold) /Name ] /Sub << /Key 3 0 R >> >>";
+
+    pdf::PDFObject object;
+    std::weak_ptr<pdf::PDFObjectArena> weakArena;
+
+    {
+        pdf::PDFObjectArenaPointer arena = pdf::PDFObjectArena::createArena();
+        weakArena = arena;
+
+        pdf::PDFParser parser(data, data + std::strlen(data), nullptr, pdf::PDFParser::None);
+        parser.setObjectArena(arena.get());
+        object = parser.getObject();
+
+        pdf::PDFObjectStorage storage;
+        storage.setObjectArena(arena);
+    }
+
+    // Storage owning the arena is released, but parsed objects remain valid
+    QVERIFY(weakArena.expired());
+    QVERIFY(object.isDictionary());
+
+    const pdf::PDFDictionary* dictionary = object.getDictionary();
+    QCOMPARE(dictionary->get("Type").getString(), QByteArray("Test"));
+
+    const pdf::PDFObject& itemsObject = dictionary->get("Items");
+    QVERIFY(itemsObject.isArray());
+    QCOMPARE(itemsObject.getArray()->getCount(), size_t(4));
+    QCOMPARE(itemsObject.getArray()->getItem(2).getString(), QByteArray("a string longer than inplace strings can hold"));
+
+    const pdf::PDFObject& subObject = dictionary->get("Sub");
+    QVERIFY(subObject.isDictionary());
+    QCOMPARE(subObject.getDictionary()->get("Key").getReference(), pdf::PDFObjectReference(3, 0));
+
+    // Pool of the arena is released, when last object is destroyed
+    object = pdf::PDFObject();
+}
+
+void LexicalAnalyzerTest::test_name_table()
+{
+    pdf::PDFNameTable* nameTable = pdf::PDFNameTable::getInstance();
+
+    QCOMPARE(nameTable->intern("Type"), pdf::PDFNameAtom(pdf::PDFNames::Type));
+    QCOMPARE(nameTable->getName(pdf::PDFNames::Resources), QByteArrayView("Resources"));
+    QCOMPARE(nameTable->intern(""), pdf::PDFNameAtom(pdf::PDFNames::Invalid));
+    QCOMPARE(nameTable->intern(QByteArray(100, 'x')), pdf::PDFNameAtom(pdf::PDFNames::Invalid));
+    QCOMPARE(nameTable->find("NameTableTestNotInterned"), pdf::PDFNameAtom(pdf::PDFNames::Invalid));
+
+    constexpr int THREAD_COUNT = 8;
+    constexpr int NAME_COUNT = 2000;
+
+    std::vector<QByteArray> names;
+    for (int i = 0; i < NAME_COUNT; ++i)
+    {
+        names.push_back(QByteArray("NameTableTest") + QByteArray::number(i));
+    }
+
+    // Intern names from several threads, each thread in different order,
+    // so names are interned concurrently to all shards.
+    std::vector<std::vector<pdf::PDFNameAtom>> atoms(THREAD_COUNT, std::vector<pdf::PDFNameAtom>(NAME_COUNT, pdf::PDFNames::Invalid));
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < THREAD_COUNT; ++threadIndex)
+    {
+        threads.emplace_back([&, threadIndex]()
+        {
+            for (int i = 0; i < NAME_COUNT; ++i)
+            {
+                const int index = (threadIndex % 2 == 0) ? i : NAME_COUNT - 1 - i;
+                atoms[threadIndex][index] = nameTable->intern(names[index]);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::set<pdf::PDFNameAtom> uniqueAtoms;
+    for (int i = 0; i < NAME_COUNT; ++i)
+    {
+        const pdf::PDFNameAtom atom = atoms.front()[i];
+        QVERIFY(atom != pdf::PDFNames::Invalid);
+
+        for (int threadIndex = 1; threadIndex < THREAD_COUNT; ++threadIndex)
+        {
+            QCOMPARE(atoms[threadIndex][i], atom);
+        }
+
+        QCOMPARE(nameTable->getName(atom), QByteArrayView(names[i]));
+        QCOMPARE(nameTable->find(names[i]), atom);
+        uniqueAtoms.insert(atom);
+    }
+
+    QCOMPARE(uniqueAtoms.size(), size_t(NAME_COUNT));
+}
+
+void LexicalAnalyzerTest::test_glyph_name_to_unicode()
+{
+    // Every glyph name must be found using perfect hash tables
+    const QByteArrayList names = pdf::PDFNameToUnicode::getNames();
+    QCOMPARE(names.size(), qsizetype(4285));
+    QCOMPARE(std::set<QByteArray>(names.cbegin(), names.cend()).size(), size_t(names.size()));
+    for (const QByteArray& name : names)
+    {
+        QVERIFY2(!pdf::PDFNameToUnicode::getUnicodeForName(name).isNull(), name.constData());
+    }
+
+    const QByteArrayList zapfDingbatsNames = pdf::PDFNameToUnicode::getNamesZapfDingbats();
+    QCOMPARE(zapfDingbatsNames.size(), qsizetype(201));
+    for (const QByteArray& name : zapfDingbatsNames)
+    {
+        QVERIFY2(!pdf::PDFNameToUnicode::getUnicodeForNameZapfDingbats(name).isNull(), name.constData());
+    }
+
+    QCOMPARE(pdf::PDFNameToUnicode::getUnicodeForName("A"), QChar(0x0041));
+    QCOMPARE(pdf::PDFNameToUnicode::getUnicodeForName("space"), QChar(0x0020));
+    QCOMPARE(pdf::PDFNameToUnicode::getUnicodeForName("Euro"), QChar(0x20AC));
+    QCOMPARE(pdf::PDFNameToUnicode::getUnicodeForNameZapfDingbats("a99"), QChar(0x275D));
+
+    // Names, which are not in the tables
+    for (const QByteArray& name : { QByteArray(), QByteArray("NotAGlyphName"), QByteArray("Aacute2"), QByteArray("AACUTE"), QByteArray("a0"), QByteArray(100, 'a') })
+    {
+        QVERIFY2(pdf::PDFNameToUnicode::getUnicodeForName(name).isNull(), name.constData());
+        QVERIFY2(pdf::PDFNameToUnicode::getUnicodeForNameZapfDingbats(name).isNull(), name.constData());
+    }
+
+    QCOMPARE(pdf::PDFNameToUnicode::getUnicodeUsingResolvedName("uni20AC"), QChar(0x20AC));
+}
+
+void LexicalAnalyzerTest::test_precompiled_page_serialization()
+{
+    QImage image(4, 4, QImage::Format_ARGB32);
+    image.fill(Qt::red);
+    image.setPixel(1, 2, qRgb(0, 0, 255));
+
+    QPainterPath path;
+    path.addRect(QRectF(10, 10, 30, 20));
+
+    QTransform imageMatrix;
+    imageMatrix.translate(50, 50);
+    imageMatrix.scale(20, 20);
+
+    pdf::PDFPrecompiledPage page;
+    page.addPath(QPen(Qt::black, 2.0), QBrush(Qt::green), path, false);
+    page.addSaveGraphicState();
+    page.addClip(path);
+    page.addSetWorldMatrix(imageMatrix);
+    page.addImage(image);
+    page.addRestoreGraphicState();
+    page.finalize(0, { });
+
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << page;
+    }
+
+    pdf::PDFPrecompiledPage deserializedPage;
+    {
+        QDataStream stream(data);
+        stream >> deserializedPage;
+        QCOMPARE(stream.status(), QDataStream::Ok);
+    }
+    QVERIFY(deserializedPage.isValid());
+
+    auto paint = [](const pdf::PDFPrecompiledPage& precompiledPage)
+    {
+        QImage target(100, 100, QImage::Format_ARGB32_Premultiplied);
+        target.fill(Qt::white);
+        QPainter painter(&target);
+        precompiledPage.draw(&painter, QRectF(), QTransform(), pdf::PDFRenderer::None, 1.0);
+        painter.end();
+        return target;
+    };
+
+    QCOMPARE(paint(deserializedPage), paint(page));
+
+    // Truncated data must be rejected
+    {
+        pdf::PDFPrecompiledPage truncatedPage;
+        QDataStream stream(data.left(data.size() / 2));
+        stream >> truncatedPage;
+        QVERIFY(stream.status() != QDataStream::Ok);
+        QVERIFY(!truncatedPage.isValid());
+    }
+}
+
+void LexicalAnalyzerTest::test_gpu_page_geometry()
+{
+    using CommandType = pdf::PDFGpuPageGeometry::CommandType;
+
+    QImage image(4, 4, QImage::Format_ARGB32);
+    image.fill(Qt::red);
+
+    QPainterPath path;
+    path.addRect(QRectF(10, 10, 30, 20));
+
+    QTransform imageMatrix;
+    imageMatrix.translate(50, 50);
+    imageMatrix.scale(20, 20);
+
+    pdf::PDFPrecompiledPage page;
+    page.addPath(QPen(Qt::NoPen), QBrush(Qt::green), path, false);
+    page.addSaveGraphicState();
+    page.addClip(path);
+    page.addSetWorldMatrix(imageMatrix);
+    page.addImage(image);
+    page.addRestoreGraphicState();
+    page.finalize(0, { });
+
+    pdf::PDFGpuPageGeometry geometry = pdf::PDFGpuPageGeometry::createGeometry(page);
+    const std::vector<pdf::PDFGpuPageGeometry::Command>& commands = geometry.getCommands();
+
+    const std::vector<CommandType> expectedTypes = { CommandType::Stencil, CommandType::Cover,
+                                                     CommandType::Stencil, CommandType::ClipIntersect,
+                                                     CommandType::Image, CommandType::ClipReset };
+    QCOMPARE(commands.size(), expectedTypes.size());
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        QCOMPARE(commands[i].type, expectedTypes[i]);
+        QVERIFY(commands[i].firstVertex + commands[i].vertexCount <= geometry.getVertices().size());
+    }
+
+    QVERIFY(commands[0].vertexCount > 0);
+    QCOMPARE(commands[0].vertexCount % 3, 0u);
+    QCOMPARE(commands[1].vertexCount, 6u);
+    QCOMPARE(commands[4].vertexCount, 6u);
+    QCOMPARE(geometry.getImages().size(), size_t(1));
+
+    // Image quad is mapped by the world matrix
+    const pdf::PDFGpuPageGeometry::Vertex& imageVertex = geometry.getVertices()[commands[4].firstVertex];
+    QCOMPARE(imageVertex.x, 50.0f);
+    QCOMPARE(imageVertex.y, 50.0f);
+
+    // Cover quad has premultiplied fill color
+    const pdf::PDFGpuPageGeometry::Vertex& coverVertex = geometry.getVertices()[commands[1].firstVertex];
+    QCOMPARE(coverVertex.color[1], quint8(255));
+    QCOMPARE(coverVertex.color[3], quint8(255));
+
+    // Linear gradient is covered by strips split at the stops
+    {
+        QLinearGradient gradient(QPointF(10, 0), QPointF(40, 0));
+        gradient.setStops({ QGradientStop(0.0, Qt::black), QGradientStop(0.5, Qt::red), QGradientStop(1.0, Qt::white) });
+
+        pdf::PDFPrecompiledPage gradientPage;
+        gradientPage.addPath(QPen(Qt::NoPen), QBrush(gradient), path, false);
+        gradientPage.finalize(0, { });
+
+        pdf::PDFGpuPageGeometry gradientGeometry = pdf::PDFGpuPageGeometry::createGeometry(gradientPage);
+        const std::vector<pdf::PDFGpuPageGeometry::Command>& gradientCommands = gradientGeometry.getCommands();
+        QCOMPARE(gradientCommands.size(), size_t(2));
+        QCOMPARE(gradientCommands[1].type, CommandType::Cover);
+        QCOMPARE(gradientCommands[1].vertexCount, 12u);
+
+        const pdf::PDFGpuPageGeometry::Vertex& startVertex = gradientGeometry.getVertices()[gradientCommands[1].firstVertex];
+        const pdf::PDFGpuPageGeometry::Vertex& middleVertex = gradientGeometry.getVertices()[gradientCommands[1].firstVertex + 1];
+        QCOMPARE(startVertex.x, 10.0f);
+        QCOMPARE(middleVertex.x, 25.0f);
+        QVERIFY((startVertex.color == std::array<quint8, 4>{ 0, 0, 0, 255 }));
+        QVERIFY((middleVertex.color == std::array<quint8, 4>{ 255, 0, 0, 255 }));
+    }
+
+    // Radial gradient is covered by rings around the focal point
+    {
+        QRadialGradient gradient(QPointF(25, 20), 10, QPointF(27, 20));
+        gradient.setStops({ QGradientStop(0.0, Qt::white), QGradientStop(1.0, Qt::blue) });
+
+        pdf::PDFPrecompiledPage gradientPage;
+        gradientPage.addPath(QPen(Qt::NoPen), QBrush(gradient), path, false);
+        gradientPage.finalize(0, { });
+
+        pdf::PDFGpuPageGeometry gradientGeometry = pdf::PDFGpuPageGeometry::createGeometry(gradientPage);
+        const std::vector<pdf::PDFGpuPageGeometry::Command>& gradientCommands = gradientGeometry.getCommands();
+        QCOMPARE(gradientCommands.size(), size_t(2));
+        QCOMPARE(gradientCommands[1].type, CommandType::Cover);
+        QVERIFY(gradientCommands[1].vertexCount > 6);
+        QCOMPARE(gradientCommands[1].vertexCount % 3, 0u);
+
+        const pdf::PDFGpuPageGeometry::Vertex& focalVertex = gradientGeometry.getVertices()[gradientCommands[1].firstVertex];
+        QCOMPARE(focalVertex.x, 27.0f);
+        QCOMPARE(focalVertex.y, 20.0f);
+        QVERIFY((focalVertex.color == std::array<quint8, 4>{ 255, 255, 255, 255 }));
+
+        // Cover must reach beyond the corners of the path bounding box
+        float maximalX = 0.0f;
+        for (quint32 i = 0; i < gradientCommands[1].vertexCount; ++i)
+        {
+            maximalX = qMax(maximalX, gradientGeometry.getVertices()[gradientCommands[1].firstVertex + i].x);
+        }
+        QVERIFY(maximalX >= 40.0f);
+    }
+
+    // Tiling pattern cell image is repeated using texture coordinates
+    {
+        QTransform brushMatrix;
+        brushMatrix.translate(10, 10);
+        brushMatrix.scale(5, 5);
+
+        QBrush brush(image);
+        brush.setTransform(brushMatrix);
+
+        pdf::PDFPrecompiledPage patternPage;
+        patternPage.addPath(QPen(Qt::NoPen), brush, path, false);
+        patternPage.finalize(0, { });
+
+        pdf::PDFGpuPageGeometry patternGeometry = pdf::PDFGpuPageGeometry::createGeometry(patternPage);
+        const std::vector<pdf::PDFGpuPageGeometry::Command>& patternCommands = patternGeometry.getCommands();
+        QCOMPARE(patternCommands.size(), size_t(2));
+        QCOMPARE(patternCommands[1].type, CommandType::TextureCover);
+        QCOMPARE(patternCommands[1].vertexCount, 6u);
+        QCOMPARE(patternGeometry.getImages().size(), size_t(1));
+
+        // Vertices are top left and top right corners of the path bounding box
+        const pdf::PDFGpuPageGeometry::Vertex& topLeftVertex = patternGeometry.getVertices()[patternCommands[1].firstVertex];
+        const pdf::PDFGpuPageGeometry::Vertex& topRightVertex = patternGeometry.getVertices()[patternCommands[1].firstVertex + 1];
+        QCOMPARE(topLeftVertex.u, 0.0f);
+        QCOMPARE(topLeftVertex.v, 0.0f);
+        QCOMPARE(topRightVertex.u, 1.5f);
+        QCOMPARE(topRightVertex.v, 0.0f);
+    }
+
+    // Pages with blend modes must be painted by QPainter
+    QVERIFY(pdf::PDFGpuPageGeometry::isPageSupported(page));
+    {
+        pdf::PDFPrecompiledPage blendedPage;
+        blendedPage.addSetCompositionMode(QPainter::CompositionMode_SourceOver);
+        blendedPage.addPath(QPen(Qt::NoPen), QBrush(Qt::green), path, false);
+        blendedPage.finalize(0, { });
+        QVERIFY(pdf::PDFGpuPageGeometry::isPageSupported(blendedPage));
+
+        blendedPage.addSetCompositionMode(QPainter::CompositionMode_Multiply);
+        QVERIFY(!pdf::PDFGpuPageGeometry::isPageSupported(blendedPage));
+    }
+}
+
+void LexicalAnalyzerTest::test_document_writer_incremental()
+{
+    pdf::PDFDocumentWriter writer(nullptr);
+    const pdf::PDFDocument document = createWriterTestDocument();
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QBuffer::ReadWrite));
+    QVERIFY(writer.write(&buffer, &document));
+    const QByteArray originalData = buffer.data();
+
+    // First update - content stream of the first page is changed and new object is added
+    pdf::PDFDocument originalDocument = readWrittenDocument(originalData);
+    QCOMPARE(originalDocument.getCatalog()->getPageCount(), size_t(WRITER_TEST_PAGE_COUNT));
+    compareWrittenObjects(document, originalDocument);
+
+    const pdf::PDFObjectReference contentReference = originalDocument.getCatalog()->getPage(0)->getContents().getReference();
+    pdf::PDFDocumentBuilder builder(&originalDocument);
+    builder.setObject(contentReference, createContentStream("BT /F1 12 Tf 72 720 Td (First update) Tj ET"));
+    const pdf::PDFObjectReference addedReference = builder.addObject(pdf::PDFObject::createString("Added object"));
+    const pdf::PDFDocument firstUpdateDocument = builder.build();
+
+    QVERIFY(writer.writeIncremental(&buffer, &firstUpdateDocument));
+    const QByteArray firstUpdateData = buffer.data();
+    QVERIFY(firstUpdateData.startsWith(originalData));
+    QVERIFY(getStartXRef(firstUpdateData) > originalData.size());
+
+    pdf::PDFDocument firstUpdateReadDocument = readWrittenDocument(firstUpdateData);
+    compareWrittenObjects(firstUpdateDocument, firstUpdateReadDocument);
+    QCOMPARE(firstUpdateReadDocument.getTrailerDictionary()->get("Prev").getInteger(), getStartXRef(originalData));
+    QCOMPARE(firstUpdateReadDocument.getObjectByReference(addedReference).getString(), QByteArray("Added object"));
+
+    // Second update - added object is removed, previous cross-reference
+    // section is the one written by the first update.
+    builder.setDocument(&firstUpdateReadDocument);
+    builder.setObject(addedReference, pdf::PDFObject());
+    builder.setObject(contentReference, createContentStream("BT /F1 12 Tf 72 720 Td (Second update) Tj ET"));
+    const pdf::PDFDocument secondUpdateDocument = builder.build();
+
+    QVERIFY(writer.writeIncremental(&buffer, &secondUpdateDocument));
+    const QByteArray secondUpdateData = buffer.data();
+    QVERIFY(secondUpdateData.startsWith(firstUpdateData));
+
+    pdf::PDFDocument secondUpdateReadDocument = readWrittenDocument(secondUpdateData);
+    compareWrittenObjects(secondUpdateDocument, secondUpdateReadDocument);
+    QCOMPARE(secondUpdateReadDocument.getTrailerDictionary()->get("Prev").getInteger(), getStartXRef(firstUpdateData));
+    QVERIFY(secondUpdateReadDocument.getObjectByReference(addedReference).isNull());
+
+    const pdf::PDFObject& content = secondUpdateReadDocument.getObject(secondUpdateReadDocument.getCatalog()->getPage(0)->getContents());
+    QCOMPARE(secondUpdateReadDocument.getDecodedStream(content.getStream()), QByteArray("BT /F1 12 Tf 72 720 Td (Second update) Tj ET"));
+
+    // Document without modifications doesn't change the file
+    QVERIFY(writer.writeIncremental(&buffer, &secondUpdateReadDocument));
+    QCOMPARE(buffer.data(), secondUpdateData);
+}
+
+void LexicalAnalyzerTest::test_document_writer_object_streams()
+{
+    const pdf::PDFDocument document = createWriterTestDocument();
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    writer.setObjectStreamsEnabled(true);
+    writer.setObjectsPerStream(0);
+    QCOMPARE(writer.getObjectsPerStream(), 1);
+    writer.setObjectsPerStream(100000);
+    QCOMPARE(writer.getObjectsPerStream(), pdf::PDFDocumentWriter::MAX_OBJECTS_PER_STREAM);
+    writer.setObjectsPerStream(2);
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QBuffer::WriteOnly));
+    QVERIFY(writer.write(&buffer, &document));
+    buffer.close();
+    const QByteArray data = buffer.data();
+
+    pdf::PDFDocument readDocument = readWrittenDocument(data);
+    QCOMPARE(readDocument.getCatalog()->getPageCount(), size_t(WRITER_TEST_PAGE_COUNT));
+    compareWrittenObjects(document, readDocument);
+
+    // Objects, which are not streams, are packed into object streams
+    // (two objects per stream), object streams are added after them.
+    const pdf::PDFObjectStorage& storage = document.getStorage();
+    const size_t objectCount = storage.getObjectCount();
+    size_t packedObjectCount = 0;
+    for (size_t i = 1; i < objectCount; ++i)
+    {
+        const pdf::PDFObject& object = storage.getObjects()[i].object;
+        if (!object.isNull() && !object.isStream())
+        {
+            ++packedObjectCount;
+        }
+    }
+
+    const size_t objectStreamCount = (packedObjectCount + 1) / 2;
+    QCOMPARE(readDocument.getStorage().getObjectCount(), objectCount + objectStreamCount + 1);
+    for (size_t i = 0; i < objectStreamCount; ++i)
+    {
+        const pdf::PDFObject& objectStream = readDocument.getObjectByReference(pdf::PDFObjectReference(pdf::PDFInteger(objectCount + i), 0));
+        QVERIFY(objectStream.isStream());
+        QCOMPARE(objectStream.getStream()->getDictionary()->get("Type").getString(), QByteArray("ObjStm"));
+    }
+
+    // Cross-reference stream is used instead of cross-reference table
+    QVERIFY(!data.contains("trailer"));
+    const pdf::PDFInteger xrefStreamObjectNumber = getObjectNumberAt(data, getStartXRef(data));
+    QCOMPARE(xrefStreamObjectNumber, pdf::PDFInteger(objectCount + objectStreamCount));
+    const pdf::PDFObject& xrefStream = readDocument.getObjectByReference(pdf::PDFObjectReference(xrefStreamObjectNumber, 0));
+    QVERIFY(xrefStream.isStream());
+    QCOMPARE(xrefStream.getStream()->getDictionary()->get("Type").getString(), QByteArray("XRef"));
+    QCOMPARE(xrefStream.getStream()->getDictionary()->get("Size").getInteger(), pdf::PDFInteger(objectCount + objectStreamCount + 1));
+}
+
+void LexicalAnalyzerTest::test_document_writer_linearized()
+{
+    const pdf::PDFDocument document = createWriterTestDocument();
+
+    for (const bool objectStreams : { false, true })
+    {
+        pdf::PDFDocumentWriter writer(nullptr);
+        writer.setLinearizationEnabled(true);
+        writer.setObjectStreamsEnabled(objectStreams);
+
+        QBuffer buffer;
+        QVERIFY(buffer.open(QBuffer::WriteOnly));
+        QVERIFY(writer.write(&buffer, &document));
+        buffer.close();
+        const QByteArray data = buffer.data();
+
+        // Objects are renumbered, so only pages are compared
+        pdf::PDFDocument readDocument = readWrittenDocument(data);
+        compareWrittenPages(document, readDocument);
+
+        std::vector<pdf::PDFInteger> pageObjectNumbers;
+        for (size_t i = 0; i < WRITER_TEST_PAGE_COUNT; ++i)
+        {
+            pageObjectNumbers.push_back(readDocument.getCatalog()->getPage(i)->getPageReference().objectNumber);
+        }
+
+        // Linearization parameter dictionary is the first object in the file
+        const qint64 firstObjectHeaderEnd = data.indexOf(" 0 obj");
+        const pdf::PDFInteger linearizationDictionaryNumber = getObjectNumberAt(data, data.lastIndexOf('\n', firstObjectHeaderEnd) + 1);
+        const pdf::PDFDictionary* linearizationDictionary = readDocument.getDictionaryFromObject(readDocument.getObjectByReference(pdf::PDFObjectReference(linearizationDictionaryNumber, 0)));
+        QVERIFY(linearizationDictionary);
+        QCOMPARE(linearizationDictionary->get("Linearized").getInteger(), pdf::PDFInteger(1));
+        QCOMPARE(linearizationDictionary->get("L").getInteger(), pdf::PDFInteger(data.size()));
+        QCOMPARE(linearizationDictionary->get("N").getInteger(), pdf::PDFInteger(WRITER_TEST_PAGE_COUNT));
+        QCOMPARE(linearizationDictionary->get("O").getInteger(), pageObjectNumbers.front());
+
+        // Hint stream is followed by the first page, and the first page by the second page
+        const pdf::PDFArray* hintStreamArray = linearizationDictionary->get("H").getArray();
+        QVERIFY(hintStreamArray && hintStreamArray->getCount() == 2);
+        const pdf::PDFInteger hintStreamOffset = hintStreamArray->getItem(0).getInteger();
+        const pdf::PDFInteger hintStreamLength = hintStreamArray->getItem(1).getInteger();
+        const pdf::PDFInteger hintStreamNumber = getObjectNumberAt(data, hintStreamOffset);
+        QVERIFY(hintStreamNumber > 0);
+        QCOMPARE(getObjectNumberAt(data, hintStreamOffset + hintStreamLength), pageObjectNumbers.front());
+
+        const pdf::PDFInteger endOfFirstPage = linearizationDictionary->get("E").getInteger();
+        QCOMPARE(getObjectNumberAt(data, endOfFirstPage), pageObjectNumbers[1]);
+
+        // Main cross-reference section
+        const pdf::PDFInteger mainXRefEntryOffset = linearizationDictionary->get("T").getInteger();
+        if (objectStreams)
+        {
+            const pdf::PDFInteger mainXRefNumber = getObjectNumberAt(data, mainXRefEntryOffset);
+            const pdf::PDFObject& mainXRefStream = readDocument.getObjectByReference(pdf::PDFObjectReference(mainXRefNumber, 0));
+            QVERIFY(mainXRefStream.isStream());
+            QCOMPARE(mainXRefStream.getStream()->getDictionary()->get("Type").getString(), QByteArray("XRef"));
+        }
+        else
+        {
+            QCOMPARE(data.mid(mainXRefEntryOffset, 19), QByteArray("\n0000000000 65535 f"));
+        }
+
+        // Offsets in the hint tables are computed as if the hint stream was not present
+        const pdf::PDFObject& hintStream = readDocument.getObjectByReference(pdf::PDFObjectReference(hintStreamNumber, 0));
+        QVERIFY(hintStream.isStream());
+        const QByteArray hintData = readDocument.getDecodedStream(hintStream.getStream());
+        const pdf::PDFInteger sharedObjectHintTableOffset = hintStream.getStream()->getDictionary()->get("S").getInteger();
+        QVERIFY(sharedObjectHintTableOffset > 0 && sharedObjectHintTableOffset < hintData.size());
+
+        // Page offset hint table
+        pdf::PDFBitReader reader(&hintData, 32);
+        const pdf::PDFInteger minObjectCount = reader.read(32);
+        const pdf::PDFInteger firstPageOffset = reader.read(32);
+        const pdf::PDFInteger objectCountBits = reader.read(16);
+        const pdf::PDFInteger minPageLength = reader.read(32);
+        const pdf::PDFInteger pageLengthBits = reader.read(16);
+        reader.read(32);
+        reader.read(16);
+        reader.read(32);
+        reader.read(16);
+        reader.read(16);
+        reader.read(16);
+        reader.read(16);
+        reader.read(16);
+
+        std::vector<pdf::PDFInteger> pageObjectCounts;
+        for (size_t i = 0; i < WRITER_TEST_PAGE_COUNT; ++i)
+        {
+            pageObjectCounts.push_back(minObjectCount + pdf::PDFInteger(reader.read(objectCountBits)));
+        }
+        reader.alignToBytes();
+
+        std::vector<pdf::PDFInteger> pageLengths;
+        for (size_t i = 0; i < WRITER_TEST_PAGE_COUNT; ++i)
+        {
+            pageLengths.push_back(minPageLength + pdf::PDFInteger(reader.read(pageLengthBits)));
+        }
+
+        QCOMPARE(firstPageOffset, hintStreamOffset);
+        QCOMPARE(firstPageOffset + pageLengths.front() + hintStreamLength, endOfFirstPage);
+
+        pdf::PDFInteger pageOffset = firstPageOffset;
+        for (size_t i = 0; i < WRITER_TEST_PAGE_COUNT; ++i)
+        {
+            QCOMPARE(getObjectNumberAt(data, pageOffset + hintStreamLength), pageObjectNumbers[i]);
+            pageOffset += pageLengths[i];
+        }
+
+        // Objects of the pages (except the first page) are numbered consecutively
+        for (size_t i = 1; i + 1 < WRITER_TEST_PAGE_COUNT; ++i)
+        {
+            QCOMPARE(pageObjectNumbers[i] + pageObjectCounts[i], pageObjectNumbers[i + 1]);
+        }
+
+        // Shared object hint table. Second font is shared by all pages
+        // except the first one, so shared objects section is not empty.
+        reader.seek(sharedObjectHintTableOffset);
+        const pdf::PDFInteger firstSharedObjectNumber = reader.read(32);
+        const pdf::PDFInteger firstSharedObjectOffset = reader.read(32);
+        const pdf::PDFInteger firstPageGroupCount = reader.read(32);
+        const pdf::PDFInteger groupCount = reader.read(32);
+        QVERIFY(firstPageGroupCount > 0);
+        QVERIFY(groupCount > firstPageGroupCount);
+        QCOMPARE(firstSharedObjectOffset, pageOffset);
+
+        const pdf::PDFInteger sharedObjectNumber = getObjectNumberAt(data, firstSharedObjectOffset + hintStreamLength);
+        if (objectStreams)
+        {
+            // First shared object is packed in the object stream
+            const pdf::PDFObject& objectStream = readDocument.getObjectByReference(pdf::PDFObjectReference(sharedObjectNumber, 0));
+            QVERIFY(objectStream.isStream());
+            QCOMPARE(objectStream.getStream()->getDictionary()->get("Type").getString(), QByteArray("ObjStm"));
+            QVERIFY(sharedObjectNumber > firstSharedObjectNumber);
+        }
+        else
+        {
+            QCOMPARE(sharedObjectNumber, firstSharedObjectNumber);
+        }
+
+        const pdf::PDFDictionary* sharedFont = readDocument.getDictionaryFromObject(readDocument.getObjectByReference(pdf::PDFObjectReference(firstSharedObjectNumber, 0)));
+        QVERIFY(sharedFont);
+        QCOMPARE(sharedFont->get("BaseFont").getString(), QByteArray("Courier"));
+    }
+}
+
+void LexicalAnalyzerTest::test_buffered_bit_reader()
+{
+    using Value = pdf::PDFBufferedBitReader::Value;
+
+    // Pseudo-random data (xorshift), size is not divisible by eight, so the
+    // tail of the stream is loaded by the buffered reader byte by byte.
+    QByteArray data;
+    uint32_t state = 2463534242;
+    for (int i = 0; i < 1021; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data.push_back(static_cast<char>(state >> 24));
+    }
+    const qint64 totalBits = data.size() * 8;
+
+    // Mixed bit widths with occasional alignment to bytes, up to the end of the stream
+    {
+        pdf::PDFBitReader reader(&data, 8);
+        pdf::PDFBufferedBitReader bufferedReader(&data);
+
+        qint64 bitPosition = 0;
+        for (int i = 0; !reader.isAtEnd(); ++i)
+        {
+            QVERIFY(!bufferedReader.isAtEnd());
+
+            if (i % 11 == 10)
+            {
+                reader.alignToBytes();
+                bufferedReader.alignToBytes();
+                bitPosition = (bitPosition + 7) / 8 * 8;
+                continue;
+            }
+
+            const Value bits = qMin<qint64>((i * 37) % pdf::PDFBufferedBitReader::MAX_BITS + 1, totalBits - bitPosition);
+            QCOMPARE(bufferedReader.read(bits), reader.read(bits));
+            bitPosition += bits;
+        }
+
+        QCOMPARE(bitPosition, totalBits);
+        QVERIFY(bufferedReader.isAtEnd());
+        QVERIFY_THROWS_EXCEPTION(pdf::PDFException, reader.read(1));
+        QVERIFY_THROWS_EXCEPTION(pdf::PDFException, bufferedReader.read(1));
+    }
+
+    // Reads with fixed number of bits
+    {
+        pdf::PDFBitReader reader(&data, 8);
+        pdf::PDFBufferedBitReader bufferedReader(&data);
+
+        QCOMPARE(bufferedReader.read<1>(), reader.read(1));
+        QCOMPARE(bufferedReader.read<7>(), reader.read(7));
+        QCOMPARE(bufferedReader.read<56>(), reader.read(56));
+        QCOMPARE(bufferedReader.read<13>(), reader.read(13));
+    }
+
+    // Array reads give the same values as single reads, also when the array
+    // doesn't start at the byte boundary. Remaining bits at the tail of the
+    // stream are not enough for another value.
+    for (const Value bits : { 1, 3, 8, 13, 24, 32, 56 })
+    {
+        for (const Value offset : { 0, 5, 8, 53 })
+        {
+            pdf::PDFBitReader reader(&data, 8);
+            pdf::PDFBufferedBitReader bufferedReader(&data);
+
+            if (offset > 0)
+            {
+                QCOMPARE(bufferedReader.read(offset), reader.read(offset));
+            }
+
+            std::vector<uint64_t> values((totalBits - offset) / bits);
+            bufferedReader.readArray(bits, values.data(), values.size());
+            for (const uint64_t value : values)
+            {
+                QCOMPARE(value, reader.read(bits));
+            }
+
+            QCOMPARE(bufferedReader.isAtEnd(), reader.isAtEnd());
+            QVERIFY_THROWS_EXCEPTION(pdf::PDFException, reader.read(bits));
+            QVERIFY_THROWS_EXCEPTION(pdf::PDFException, bufferedReader.read(bits));
+        }
+    }
+
+    // Array of narrow values, array longer than the stream
+    {
+        pdf::PDFBitReader reader(&data, 8);
+        pdf::PDFBufferedBitReader bufferedReader(&data);
+
+        std::vector<uint8_t> values(data.size());
+        bufferedReader.readArray(8, values.data(), values.size());
+        for (const uint8_t value : values)
+        {
+            QCOMPARE(value, reader.readUnsignedByte());
+        }
+
+        pdf::PDFBufferedBitReader overflowReader(&data);
+        std::vector<uint16_t> overflowValues(data.size() / 2 + 1);
+        QVERIFY_THROWS_EXCEPTION(pdf::PDFException, overflowReader.readArray(16, overflowValues.data(), overflowValues.size()));
+    }
+
+    // Seek discards buffered bits
+    {
+        pdf::PDFBitReader reader(&data, 8);
+        pdf::PDFBufferedBitReader bufferedReader(&data);
+
+        for (const qint64 position : { 17, 0, 1000, 1013, 1020 })
+        {
+            reader.read(5);
+            bufferedReader.read(5);
+            reader.seek(position);
+            bufferedReader.seek(position);
+
+            const Value bits = qMin<qint64>(pdf::PDFBufferedBitReader::MAX_BITS, (data.size() - position) * 8 - 3);
+            QCOMPARE(bufferedReader.read(3), reader.read(3));
+            QCOMPARE(bufferedReader.read(bits), reader.read(bits));
+        }
+
+        bufferedReader.seek(data.size());
+        QVERIFY(bufferedReader.isAtEnd());
+        QVERIFY_THROWS_EXCEPTION(pdf::PDFException, bufferedReader.seek(data.size() + 1));
+        QVERIFY_THROWS_EXCEPTION(pdf::PDFException, bufferedReader.seek(-1));
+    }
+
+    // Empty stream
+    {
+        QByteArray emptyData;
+        pdf::PDFBufferedBitReader bufferedReader(&emptyData);
+        QVERIFY(bufferedReader.isAtEnd());
+        QVERIFY_THROWS_EXCEPTION(pdf::PDFException, bufferedReader.read(1));
+    }
+}
+
 void LexicalAnalyzerTest::scanWholeStream(const char* stream)
 {
     pdf::PDFLexicalAnalyzer analyzer(stream, stream + strlen(stream));
@@ -1158,6 +2222,124 @@ QString LexicalAnalyzerTest::getStringFromTokens(const std::vector<pdf::PDFLexic
     return QString("{ %1 }").arg(stringTokens.join(", "));
 }
 
+void LexicalAnalyzerTest::compareWrittenObjects(const pdf::PDFDocument& expected, const pdf::PDFDocument& actual)
+{
+    const pdf::PDFObjectStorage::PDFObjects& objects = expected.getStorage().getObjects();
+    QVERIFY(actual.getStorage().getObjectCount() >= objects.size());
+
+    for (size_t i = 1; i < objects.size(); ++i)
+    {
+        const pdf::PDFObjectReference reference(pdf::PDFInteger(i), objects[i].generation);
+        QVERIFY2(actual.getObjectByReference(reference) == objects[i].object, qPrintable(QString("Object %1 differs.").arg(i)));
+    }
+}
+
+void LexicalAnalyzerTest::compareWrittenPages(const pdf::PDFDocument& expected, const pdf::PDFDocument& actual)
+{
+    const size_t pageCount = expected.getCatalog()->getPageCount();
+    QCOMPARE(actual.getCatalog()->getPageCount(), pageCount);
+
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        const pdf::PDFPage* expectedPage = expected.getCatalog()->getPage(i);
+        const pdf::PDFPage* actualPage = actual.getCatalog()->getPage(i);
+        QCOMPARE(actualPage->getMediaBox(), expectedPage->getMediaBox());
+
+        const pdf::PDFObject& expectedContent = expected.getObject(expectedPage->getContents());
+        const pdf::PDFObject& actualContent = actual.getObject(actualPage->getContents());
+        QVERIFY(actualContent.isStream());
+        QCOMPARE(actual.getDecodedStream(actualContent.getStream()), expected.getDecodedStream(expectedContent.getStream()));
+
+        const pdf::PDFDictionary* expectedFonts = expected.getDictionaryFromObject(expected.getDictionaryFromObject(expectedPage->getResources())->get("Font"));
+        const pdf::PDFDictionary* actualFonts = actual.getDictionaryFromObject(actual.getDictionaryFromObject(actualPage->getResources())->get("Font"));
+        QVERIFY(actualFonts);
+        QCOMPARE(actualFonts->getCount(), expectedFonts->getCount());
+
+        for (size_t j = 0; j < expectedFonts->getCount(); ++j)
+        {
+            const QByteArray key = expectedFonts->getKey(j).getString();
+            QVERIFY(actual.getObject(actualFonts->get(key)) == expected.getObject(expectedFonts->getValue(j)));
+        }
+    }
+}
+
+pdf::PDFDocument LexicalAnalyzerTest::createWriterTestDocument()
+{
+    pdf::PDFDocumentBuilder builder;
+
+    auto createFont = [&builder](const char* baseFont)
+    {
+        pdf::PDFDictionary dictionary;
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Type"), pdf::PDFObject::createName("Font"));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Subtype"), pdf::PDFObject::createName("Type1"));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("BaseFont"), pdf::PDFObject::createName(baseFont));
+        return builder.addObject(pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(std::move(dictionary))));
+    };
+
+    // First font is used by all pages, second font is shared by all pages except the first one
+    const pdf::PDFObjectReference firstFont = createFont("Helvetica");
+    const pdf::PDFObjectReference secondFont = createFont("Courier");
+
+    std::vector<pdf::PDFAppendedPage> pages;
+    for (int i = 0; i < WRITER_TEST_PAGE_COUNT; ++i)
+    {
+        pdf::PDFDictionary fonts;
+        fonts.addEntry(pdf::PDFInplaceOrMemoryString("F1"), pdf::PDFObject::createReference(firstFont));
+        if (i > 0)
+        {
+            fonts.addEntry(pdf::PDFInplaceOrMemoryString("F2"), pdf::PDFObject::createReference(secondFont));
+        }
+
+        pdf::PDFDictionary resources;
+        resources.addEntry(pdf::PDFInplaceOrMemoryString("Font"), pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(std::move(fonts))));
+
+        pdf::PDFAppendedPage page;
+        page.mediaBox = QRectF(0, 0, 612, 792);
+        page.resources = pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(std::move(resources)));
+        page.contents = { createContentStream(QString("BT /F1 12 Tf 72 720 Td (Page %1) Tj ET").arg(i + 1).toLatin1()) };
+        pages.push_back(std::move(page));
+    }
+    builder.appendPages(std::move(pages));
+
+    // Object, which is not used by any page
+    builder.addObject(pdf::PDFObject::createString("Unused object"));
+
+    return builder.build();
+}
+
+pdf::PDFDocument LexicalAnalyzerTest::readWrittenDocument(const QByteArray& data)
+{
+    pdf::PDFDocumentReader reader(nullptr, nullptr, false, false);
+    pdf::PDFDocument document = reader.readFromBuffer(data);
+
+    if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+    {
+        qWarning() << "Written document can't be read:" << reader.getErrorMessage();
+    }
+
+    return document;
+}
+
+pdf::PDFObject LexicalAnalyzerTest::createContentStream(QByteArray content)
+{
+    pdf::PDFDictionary dictionary;
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Length"), pdf::PDFObject::createInteger(content.size()));
+    return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(std::move(dictionary), std::move(content)));
+}
+
+pdf::PDFInteger LexicalAnalyzerTest::getObjectNumberAt(const QByteArray& data, qint64 offset)
+{
+    // Object header has form "number generation obj"
+    const QList<QByteArray> tokens = data.mid(offset, 32).simplified().split(' ');
+    return (tokens.size() >= 3 && tokens[2] == "obj") ? tokens[0].toLongLong() : -1;
+}
+
+pdf::PDFInteger LexicalAnalyzerTest::getStartXRef(const QByteArray& data)
+{
+    const qsizetype position = data.lastIndexOf("startxref");
+    return (position != -1) ? data.mid(position + 9, 32).simplified().split(' ').front().toLongLong() : -1;
+}
+
 #ifdef PDF4QT_COMPILER_MSVC
 #pragma warning(pop)
 #endif